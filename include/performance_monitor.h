@@ -1,40 +1,267 @@
+/*-------------------------------------------------------------------------
+ *
+ * performance_monitor.h
+ *		Fixed-size history of system samples with rolling statistics
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A ring of the most recent samples, allocated once, with averages and
+ * percentiles over any suffix of it.  Taking the samples is up to the
+ * caller (ramd_sysmon.c in ramd), as is locking: none of these functions
+ * synchronize.  A figure a sample could not measure is negative and is
+ * left out of every statistic.
+ *
+ *-------------------------------------------------------------------------
+ */
+
 #ifndef PERFORMANCE_MONITOR_H
 #define PERFORMANCE_MONITOR_H
 
-#include <time.h>
-#include <sys/time.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Load, on the 0-100 scale of performance_metrics_saturation, past which a host is saturated */
+#define PERFORMANCE_SATURATED_PERCENT     80.0
+/* Average I/O latency that counts as a fully saturated device */
+#define PERFORMANCE_DISK_LATENCY_SATURATED_MS 50.0
+/* Samples is_healthy averages over */
+#define PERFORMANCE_HEALTH_WINDOW         10
 
-/* Performance metrics */
-typedef struct {
-    double cpu_usage;
-    double memory_usage;
-    double disk_io;
-    double network_io;
-    long long timestamp;
+typedef struct performance_metrics_t
+{
+	long long timestamp;      /* milliseconds since the epoch */
+	double cpu_usage;         /* host, percent busy */
+	double process_cpu_usage; /* this process, percent of one CPU */
+	double memory_usage;      /* host, percent not available */
+	double cpu_pressure;      /* PSI "some" avg10, percent of time stalled */
+	double io_pressure;
+	double memory_pressure;
+	double disk_io;           /* data directory's device, percent busy */
+	double disk_latency_ms;   /* same device, per completed request */
+	double network_rtt_ms;    /* slowest peer's last round trip */
 } performance_metrics_t;
 
-/* Performance monitor */
-typedef struct {
-    performance_metrics_t* metrics;
-    size_t count;
-    size_t capacity;
-    pthread_mutex_t mutex;
+/* The statistics cover these members, all doubles */
+static const size_t performance_metrics_fields[] = {
+	offsetof(performance_metrics_t, cpu_usage),
+	offsetof(performance_metrics_t, process_cpu_usage),
+	offsetof(performance_metrics_t, memory_usage),
+	offsetof(performance_metrics_t, cpu_pressure),
+	offsetof(performance_metrics_t, io_pressure),
+	offsetof(performance_metrics_t, memory_pressure),
+	offsetof(performance_metrics_t, disk_io),
+	offsetof(performance_metrics_t, disk_latency_ms),
+	offsetof(performance_metrics_t, network_rtt_ms),
+};
+
+#define PERFORMANCE_METRICS_FIELD_COUNT \
+	(sizeof(performance_metrics_fields) / sizeof(performance_metrics_fields[0]))
+
+#define PERFORMANCE_METRICS_FIELD(m, i) \
+	(*(double*) ((char*) (m) + performance_metrics_fields[i]))
+
+typedef struct performance_monitor_t
+{
+	performance_metrics_t* metrics; /* capacity slots, oldest overwritten first */
+	size_t count;
+	size_t capacity;
+	size_t next;     /* slot the next sample goes to */
+	double* scratch; /* capacity values, for percentiles */
 } performance_monitor_t;
 
-/* Performance functions */
-performance_monitor_t* performance_monitor_create(size_t capacity);
-void performance_monitor_destroy(performance_monitor_t* monitor);
-void performance_monitor_add_metrics(performance_monitor_t* monitor, performance_metrics_t* metrics);
-performance_metrics_t* performance_monitor_get_latest(performance_monitor_t* monitor);
-performance_metrics_t* performance_monitor_get_average(performance_monitor_t* monitor, size_t count);
-bool performance_monitor_is_healthy(performance_monitor_t* monitor);
-
-/* System monitoring */
-performance_metrics_t* performance_get_system_metrics(void);
-double performance_get_cpu_usage(void);
-double performance_get_memory_usage(void);
-double performance_get_disk_io(void);
-double performance_get_network_io(void);
+static inline performance_monitor_t*
+performance_monitor_create(size_t capacity)
+{
+	performance_monitor_t* monitor;
+
+	if (capacity == 0 || capacity > ((size_t) -1) / sizeof(performance_metrics_t))
+		return NULL;
+
+	monitor = calloc(1, sizeof(*monitor));
+	if (!monitor)
+		return NULL;
+	monitor->metrics = calloc(capacity, sizeof(performance_metrics_t));
+	monitor->scratch = calloc(capacity, sizeof(double));
+	if (!monitor->metrics || !monitor->scratch)
+	{
+		free(monitor->metrics);
+		free(monitor->scratch);
+		free(monitor);
+		return NULL;
+	}
+	monitor->capacity = capacity;
+	return monitor;
+}
+
+static inline void
+performance_monitor_destroy(performance_monitor_t* monitor)
+{
+	if (!monitor)
+		return;
+	free(monitor->metrics);
+	free(monitor->scratch);
+	free(monitor);
+}
+
+static inline void
+performance_monitor_add_metrics(performance_monitor_t* monitor,
+                                const performance_metrics_t* metrics)
+{
+	if (!monitor || !metrics)
+		return;
+	monitor->metrics[monitor->next] = *metrics;
+	monitor->next = (monitor->next + 1) % monitor->capacity;
+	if (monitor->count < monitor->capacity)
+		monitor->count++;
+}
+
+/* The i-th most recent sample, 0 being the latest; i < count */
+static inline const performance_metrics_t*
+performance_monitor_recent(const performance_monitor_t* monitor, size_t i)
+{
+	return &monitor->metrics[(monitor->next + monitor->capacity - 1 - i) % monitor->capacity];
+}
+
+/* NULL until the first sample */
+static inline const performance_metrics_t*
+performance_monitor_get_latest(const performance_monitor_t* monitor)
+{
+	if (!monitor || monitor->count == 0)
+		return NULL;
+	return performance_monitor_recent(monitor, 0);
+}
+
+/*
+ * Mean of each figure over the last count samples (all of them if count
+ * is 0 or more than are held); the timestamp is the latest one's.  False
+ * with no samples.
+ */
+static inline bool
+performance_monitor_get_average(const performance_monitor_t* monitor, size_t count,
+                                performance_metrics_t* average)
+{
+	if (!monitor || !average || monitor->count == 0)
+		return false;
+	if (count == 0 || count > monitor->count)
+		count = monitor->count;
+
+	memset(average, 0, sizeof(*average));
+	average->timestamp = performance_monitor_recent(monitor, 0)->timestamp;
+	for (size_t f = 0; f < PERFORMANCE_METRICS_FIELD_COUNT; f++)
+	{
+		double sum = 0.0;
+		size_t n = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			double value = PERFORMANCE_METRICS_FIELD(performance_monitor_recent(monitor, i), f);
+
+			if (value >= 0.0)
+			{
+				sum += value;
+				n++;
+			}
+		}
+		PERFORMANCE_METRICS_FIELD(average, f) = n > 0 ? sum / (double) n : -1.0;
+	}
+	return true;
+}
+
+static inline int
+performance_monitor_compare_double(const void* a, const void* b)
+{
+	double x = *(const double*) a;
+	double y = *(const double*) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile (0-100) of each figure over the last count samples */
+static inline bool
+performance_monitor_get_percentile(performance_monitor_t* monitor, size_t count,
+                                   double percentile, performance_metrics_t* result)
+{
+	if (!monitor || !result || monitor->count == 0)
+		return false;
+	if (count == 0 || count > monitor->count)
+		count = monitor->count;
+	if (percentile < 0.0)
+		percentile = 0.0;
+	if (percentile > 100.0)
+		percentile = 100.0;
+
+	memset(result, 0, sizeof(*result));
+	result->timestamp = performance_monitor_recent(monitor, 0)->timestamp;
+	for (size_t f = 0; f < PERFORMANCE_METRICS_FIELD_COUNT; f++)
+	{
+		size_t n = 0;
+		size_t rank;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			double value = PERFORMANCE_METRICS_FIELD(performance_monitor_recent(monitor, i), f);
+
+			if (value >= 0.0)
+				monitor->scratch[n++] = value;
+		}
+		if (n == 0)
+		{
+			PERFORMANCE_METRICS_FIELD(result, f) = -1.0;
+			continue;
+		}
+		qsort(monitor->scratch, n, sizeof(double), performance_monitor_compare_double);
+		rank = (size_t) (percentile / 100.0 * (double) n + 0.999999);
+		rank = rank == 0 ? 0 : rank - 1;
+		PERFORMANCE_METRICS_FIELD(result, f) = monitor->scratch[rank < n ? rank : n - 1];
+	}
+	return true;
+}
+
+/*
+ * How close the host is to running out of something, 0-100: the worst
+ * of CPU busy time, the three stall pressures, and the data device's busy
+ * time and latency.  Memory in use and round trips are left out; a full
+ * page cache is not a shortage, and a slow link says nothing of the host.
+ */
+static inline double
+performance_metrics_saturation(const performance_metrics_t* metrics)
+{
+	double worst = 0.0;
+	double latency;
+
+	if (!metrics)
+		return -1.0;
+
+	if (metrics->cpu_usage > worst)
+		worst = metrics->cpu_usage;
+	if (metrics->cpu_pressure > worst)
+		worst = metrics->cpu_pressure;
+	if (metrics->io_pressure > worst)
+		worst = metrics->io_pressure;
+	if (metrics->memory_pressure > worst)
+		worst = metrics->memory_pressure;
+	if (metrics->disk_io > worst)
+		worst = metrics->disk_io;
+	if (metrics->disk_latency_ms >= 0.0)
+	{
+		latency = metrics->disk_latency_ms * 100.0 / PERFORMANCE_DISK_LATENCY_SATURATED_MS;
+		if (latency > worst)
+			worst = latency;
+	}
+	return worst > 100.0 ? 100.0 : worst;
+}
+
+/* Not saturated on average over the last PERFORMANCE_HEALTH_WINDOW samples */
+static inline bool
+performance_monitor_is_healthy(const performance_monitor_t* monitor)
+{
+	performance_metrics_t average;
+
+	if (!performance_monitor_get_average(monitor, PERFORMANCE_HEALTH_WINDOW, &average))
+		return true; /* nothing says otherwise */
+	return performance_metrics_saturation(&average) < PERFORMANCE_SATURATED_PERCENT;
+}
 
 #endif /* PERFORMANCE_MONITOR_H */
@@ -0,0 +1,216 @@
+/*-------------------------------------------------------------------------
+ *
+ * ram_conf.h
+ *		Schema-driven "key = value" file parser shared by ramd and ramctrl
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A program describes its settings once, as a table of field descriptors
+ * giving each key's type and where it lives in the target struct.  The
+ * table is indexed by key hash once, so a file is parsed in a single pass
+ * with one hash probe per line, and values are stored straight into the
+ * struct with no intermediate key/value list.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAM_CONF_H
+#define RAM_CONF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* Index size; a power of two, kept at least twice the largest schema */
+#define RAM_CONF_INDEX_SLOTS 512
+
+typedef enum
+{
+	RAM_CONF_INT,    /* int32_t or int */
+	RAM_CONF_SIZE,   /* size_t */
+	RAM_CONF_BOOL,   /* "true" (any case) or "1" */
+	RAM_CONF_DOUBLE,
+	RAM_CONF_STRING, /* char array, truncated and always terminated */
+	RAM_CONF_CUSTOM  /* converted by the field's parse function */
+} ram_conf_type_t;
+
+/* Store value into the field at member; false rejects the value */
+typedef bool (*ram_conf_parse_fn)(void* member, const char* value);
+
+typedef struct ram_conf_field_t
+{
+	const char* key;
+	ram_conf_type_t type;
+	size_t offset;
+	size_t size;
+	ram_conf_parse_fn parse;
+} ram_conf_field_t;
+
+/* A field whose key is the member's own name */
+#define RAM_CONF_FIELD(kind, struct_type, member)                              \
+	{ #member, RAM_CONF_##kind, offsetof(struct_type, member),                 \
+	  sizeof(((struct_type*) 0)->member), NULL }
+
+#define RAM_CONF_FIELD_AS(key, kind, struct_type, member)                      \
+	{ key, RAM_CONF_##kind, offsetof(struct_type, member),                     \
+	  sizeof(((struct_type*) 0)->member), NULL }
+
+#define RAM_CONF_FIELD_CUSTOM(struct_type, member, fn)                         \
+	{ #member, RAM_CONF_CUSTOM, offsetof(struct_type, member),                 \
+	  sizeof(((struct_type*) 0)->member), fn }
+
+#define RAM_CONF_FIELD_CUSTOM_AS(key, struct_type, member, fn)                 \
+	{ key, RAM_CONF_CUSTOM, offsetof(struct_type, member),                     \
+	  sizeof(((struct_type*) 0)->member), fn }
+
+typedef struct ram_conf_schema_t
+{
+	const ram_conf_field_t* fields;
+	size_t count;
+	uint16_t slots[RAM_CONF_INDEX_SLOTS]; /* field index + 1; 0 is empty */
+} ram_conf_schema_t;
+
+static inline uint32_t
+ram_conf_hash(const char* key, size_t length)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ (uint8_t) key[i]) * 16777619u;
+	return hash;
+}
+
+/*
+ * Index fields by key.  False if there are too many for the index or a key
+ * is listed twice, either of which is a mistake in the table itself.
+ */
+static inline bool
+ram_conf_schema_init(ram_conf_schema_t* schema, const ram_conf_field_t* fields,
+					 size_t count)
+{
+	memset(schema, 0, sizeof(*schema));
+	if (count > RAM_CONF_INDEX_SLOTS / 2)
+		return false;
+
+	schema->fields = fields;
+	schema->count = count;
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t length = strlen(fields[i].key);
+		uint32_t slot = ram_conf_hash(fields[i].key, length) & (RAM_CONF_INDEX_SLOTS - 1);
+
+		while (schema->slots[slot] != 0)
+		{
+			if (strcmp(fields[schema->slots[slot] - 1].key, fields[i].key) == 0)
+				return false;
+			slot = (slot + 1) & (RAM_CONF_INDEX_SLOTS - 1);
+		}
+		schema->slots[slot] = (uint16_t) (i + 1);
+	}
+	return true;
+}
+
+static inline const ram_conf_field_t*
+ram_conf_lookup(const ram_conf_schema_t* schema, const char* key)
+{
+	size_t length = strlen(key);
+	uint32_t slot = ram_conf_hash(key, length) & (RAM_CONF_INDEX_SLOTS - 1);
+
+	while (schema->slots[slot] != 0)
+	{
+		const ram_conf_field_t* field = &schema->fields[schema->slots[slot] - 1];
+
+		if (strcmp(field->key, key) == 0)
+			return field;
+		slot = (slot + 1) & (RAM_CONF_INDEX_SLOTS - 1);
+	}
+	return NULL;
+}
+
+static inline bool
+ram_conf_parse_bool(const char* value)
+{
+	return strcasecmp(value, "true") == 0 || strcmp(value, "1") == 0;
+}
+
+/* Convert value and store it in target; false for an unknown key or bad value */
+static inline bool
+ram_conf_set(const ram_conf_schema_t* schema, void* target, const char* key,
+			 const char* value)
+{
+	const ram_conf_field_t* field = ram_conf_lookup(schema, key);
+	char* member;
+
+	if (!field)
+		return false;
+
+	member = (char*) target + field->offset;
+	switch (field->type)
+	{
+		case RAM_CONF_INT:
+			if (field->size == sizeof(int64_t))
+				*(int64_t*) member = strtoll(value, NULL, 10);
+			else
+				*(int32_t*) member = (int32_t) strtol(value, NULL, 10);
+			return true;
+		case RAM_CONF_SIZE:
+			*(size_t*) member = (size_t) strtoull(value, NULL, 10);
+			return true;
+		case RAM_CONF_BOOL:
+			*(bool*) member = ram_conf_parse_bool(value);
+			return true;
+		case RAM_CONF_DOUBLE:
+			*(double*) member = strtod(value, NULL);
+			return true;
+		case RAM_CONF_STRING:
+			strncpy(member, value, field->size - 1);
+			member[field->size - 1] = '\0';
+			return true;
+		case RAM_CONF_CUSTOM:
+			return field->parse && field->parse(member, value);
+	}
+	return false;
+}
+
+/*
+ * Split a line in place into its trimmed key and value.  False for blank
+ * lines, comments and lines without "="; *key is NULL for the first two.
+ */
+static inline bool
+ram_conf_split(char* line, char** key, char** value)
+{
+	char* equals;
+	char* end;
+
+	*key = *value = NULL;
+	while (*line == ' ' || *line == '\t')
+		line++;
+	if (*line == '\0' || *line == '\n' || *line == '\r' || *line == '#')
+		return false;
+
+	*key = line;
+	equals = strchr(line, '=');
+	if (!equals)
+		return false;
+	*equals = '\0';
+
+	for (end = equals; end > line && (end[-1] == ' ' || end[-1] == '\t'); end--)
+		;
+	*end = '\0';
+
+	line = equals + 1;
+	while (*line == ' ' || *line == '\t')
+		line++;
+	*value = line;
+	for (end = line + strlen(line);
+		 end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r');
+		 end--)
+		;
+	*end = '\0';
+	return true;
+}
+
+#endif /* RAM_CONF_H */
@@ -0,0 +1,1040 @@
+/*-------------------------------------------------------------------------
+ *
+ * ram_json.h
+ *		Streaming JSON writer and tokenizing reader shared by ramd and ramctrl
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Neither side allocates.  The writer fills a caller-provided buffer and,
+ * when one is given, hands it to a flush callback each time it fills up;
+ * without one, running out of room is reported instead of truncating.
+ * The reader makes one pass over the input and records where each value
+ * starts and ends in a caller-provided token array, so looking a member
+ * up or copying it into a struct never rescans the text.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAM_JSON_H
+#define RAM_JSON_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Deepest nesting either side accepts */
+#define RAM_JSON_MAX_DEPTH 32
+
+/* ---------------------------------------------------------------------
+ * Writer
+ * ---------------------------------------------------------------------
+ */
+
+/* Take length bytes of output; returning false fails the writer */
+typedef bool (*ram_json_flush_fn)(void* context, const char* data, size_t length);
+
+typedef struct ram_json_writer_t
+{
+	char* buf;
+	size_t size;   /* one byte is kept back for the terminator */
+	size_t length;
+	ram_json_flush_fn flush; /* NULL: buf is all the room there is */
+	void* flush_context;
+	bool failed;   /* sticky; set on overflow or a failed flush */
+	bool after_key;
+	int32_t depth;
+	bool has_items[RAM_JSON_MAX_DEPTH + 1];
+} ram_json_writer_t;
+
+static inline void
+ram_json_writer_init(ram_json_writer_t* w, char* buf, size_t size,
+					 ram_json_flush_fn flush, void* flush_context)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = size > 0 ? buf : NULL;
+	w->size = size > 0 ? size - 1 : 0;
+	w->flush = flush;
+	w->flush_context = flush_context;
+	w->failed = size == 0;
+}
+
+static inline bool
+ram_json_write_raw(ram_json_writer_t* w, const char* data, size_t length)
+{
+	if (w->failed)
+		return false;
+
+	if (length > w->size - w->length)
+	{
+		if (!w->flush)
+		{
+			w->failed = true;
+			return false;
+		}
+		if (w->length > 0 && !w->flush(w->flush_context, w->buf, w->length))
+		{
+			w->failed = true;
+			return false;
+		}
+		w->length = 0;
+
+		/* Too big to stage at all: pass it straight through */
+		if (length > w->size)
+		{
+			if (!w->flush(w->flush_context, data, length))
+				w->failed = true;
+			return !w->failed;
+		}
+	}
+
+	memcpy(w->buf + w->length, data, length);
+	w->length += length;
+	return true;
+}
+
+static inline bool
+ram_json_write_char(ram_json_writer_t* w, char c)
+{
+	if (!w->failed && w->length < w->size)
+	{
+		w->buf[w->length++] = c;
+		return true;
+	}
+	return ram_json_write_raw(w, &c, 1);
+}
+
+/* Comma before the next member or element, unless it follows a key */
+static inline bool
+ram_json_separate(ram_json_writer_t* w)
+{
+	if (w->after_key)
+	{
+		w->after_key = false;
+		return !w->failed;
+	}
+	if (w->has_items[w->depth] && !ram_json_write_char(w, ','))
+		return false;
+	w->has_items[w->depth] = true;
+	return !w->failed;
+}
+
+static inline bool
+ram_json_open(ram_json_writer_t* w, char c)
+{
+	if (!ram_json_separate(w))
+		return false;
+	if (w->depth >= RAM_JSON_MAX_DEPTH)
+	{
+		w->failed = true;
+		return false;
+	}
+	w->has_items[++w->depth] = false;
+	return ram_json_write_char(w, c);
+}
+
+static inline bool
+ram_json_close(ram_json_writer_t* w, char c)
+{
+	if (w->depth <= 0 || w->after_key)
+	{
+		w->failed = true;
+		return false;
+	}
+	w->depth--;
+	return ram_json_write_char(w, c);
+}
+
+static inline bool
+ram_json_object_begin(ram_json_writer_t* w)
+{
+	return ram_json_open(w, '{');
+}
+
+static inline bool
+ram_json_object_end(ram_json_writer_t* w)
+{
+	return ram_json_close(w, '}');
+}
+
+static inline bool
+ram_json_array_begin(ram_json_writer_t* w)
+{
+	return ram_json_open(w, '[');
+}
+
+static inline bool
+ram_json_array_end(ram_json_writer_t* w)
+{
+	return ram_json_close(w, ']');
+}
+
+/*
+ * Escape a run of bytes.  With length SIZE_MAX s is a C string and stops
+ * at its NUL; with an explicit length every byte is written, an embedded
+ * NUL as \u0000.
+ */
+static inline bool
+ram_json_write_escaped(ram_json_writer_t* w, const char* s, size_t length)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char* run = s;
+	size_t i;
+
+	if (!ram_json_write_char(w, '"'))
+		return false;
+
+	if (length == SIZE_MAX)
+		length = strlen(s);
+	for (i = 0; i < length; i++)
+	{
+		unsigned char c = (unsigned char) s[i];
+		char escape[6] = {'\\', 0, '0', '0', 0, 0};
+		size_t escape_length = 2;
+
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		switch (c)
+		{
+			case '"':
+			case '\\':
+				escape[1] = (char) c;
+				break;
+			case '\n':
+				escape[1] = 'n';
+				break;
+			case '\r':
+				escape[1] = 'r';
+				break;
+			case '\t':
+				escape[1] = 't';
+				break;
+			case '\b':
+				escape[1] = 'b';
+				break;
+			case '\f':
+				escape[1] = 'f';
+				break;
+			default:
+				escape[1] = 'u';
+				escape[4] = hex[c >> 4];
+				escape[5] = hex[c & 0x0f];
+				escape_length = 6;
+				break;
+		}
+
+		if (!ram_json_write_raw(w, run, (size_t) (s + i - run)) ||
+			!ram_json_write_raw(w, escape, escape_length))
+			return false;
+		run = s + i + 1;
+	}
+
+	return ram_json_write_raw(w, run, (size_t) (s + i - run)) &&
+		   ram_json_write_char(w, '"');
+}
+
+/*
+ * Keys are written as given, without escaping; ram_json_key() accepts
+ * only a string literal so its length is known at compile time.
+ */
+static inline bool
+ram_json_key_n(ram_json_writer_t* w, const char* key, size_t length)
+{
+	if (w->after_key || !ram_json_separate(w))
+	{
+		w->failed = true;
+		return false;
+	}
+	if (!ram_json_write_char(w, '"') || !ram_json_write_raw(w, key, length) ||
+		!ram_json_write_raw(w, "\":", 2))
+		return false;
+	w->after_key = true;
+	return true;
+}
+
+#define ram_json_key(w, key) ram_json_key_n((w), "" key "", sizeof(key) - 1)
+
+static inline bool
+ram_json_string(ram_json_writer_t* w, const char* value)
+{
+	if (!value)
+		return ram_json_separate(w) && ram_json_write_raw(w, "null", 4);
+	return ram_json_separate(w) && ram_json_write_escaped(w, value, SIZE_MAX);
+}
+
+static inline bool
+ram_json_string_n(ram_json_writer_t* w, const char* value, size_t length)
+{
+	return ram_json_separate(w) && ram_json_write_escaped(w, value, length);
+}
+
+static inline bool
+ram_json_uint(ram_json_writer_t* w, uint64_t value)
+{
+	char digits[20];
+	size_t n = sizeof(digits);
+
+	do
+	{
+		digits[--n] = (char) ('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	return ram_json_separate(w) &&
+		   ram_json_write_raw(w, digits + n, sizeof(digits) - n);
+}
+
+static inline bool
+ram_json_int(ram_json_writer_t* w, int64_t value)
+{
+	char digits[21];
+	size_t n = sizeof(digits);
+	uint64_t magnitude = value < 0 ? (uint64_t) 0 - (uint64_t) value : (uint64_t) value;
+
+	do
+	{
+		digits[--n] = (char) ('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+	if (value < 0)
+		digits[--n] = '-';
+
+	return ram_json_separate(w) &&
+		   ram_json_write_raw(w, digits + n, sizeof(digits) - n);
+}
+
+/* JSON has no NaN or infinity; those are written as null */
+static inline bool
+ram_json_double(ram_json_writer_t* w, double value, int precision)
+{
+	char text[48];
+	int length;
+
+	if (!isfinite(value))
+		return ram_json_separate(w) && ram_json_write_raw(w, "null", 4);
+
+	length = snprintf(text, sizeof(text), "%.*f", precision, value);
+	if (length < 0 || (size_t) length >= sizeof(text))
+		length = snprintf(text, sizeof(text), "%.17g", value);
+	return ram_json_separate(w) && length > 0 &&
+		   ram_json_write_raw(w, text, (size_t) length);
+}
+
+static inline bool
+ram_json_bool(ram_json_writer_t* w, bool value)
+{
+	return ram_json_separate(w) &&
+		   ram_json_write_raw(w, value ? "true" : "false", value ? 4 : 5);
+}
+
+static inline bool
+ram_json_null(ram_json_writer_t* w)
+{
+	return ram_json_separate(w) && ram_json_write_raw(w, "null", 4);
+}
+
+/* A value that is already JSON, such as a stored response, copied as is */
+static inline bool
+ram_json_raw(ram_json_writer_t* w, const char* json, size_t length)
+{
+	return ram_json_separate(w) && ram_json_write_raw(w, json, length);
+}
+
+/* Members; each writes the key and then the value */
+#define ram_json_kv_string(w, key, v)  (ram_json_key(w, key) && ram_json_string((w), (v)))
+#define ram_json_kv_int(w, key, v)     (ram_json_key(w, key) && ram_json_int((w), (int64_t) (v)))
+#define ram_json_kv_uint(w, key, v)    (ram_json_key(w, key) && ram_json_uint((w), (uint64_t) (v)))
+#define ram_json_kv_bool(w, key, v)    (ram_json_key(w, key) && ram_json_bool((w), (v)))
+#define ram_json_kv_double(w, key, v, p) \
+	(ram_json_key(w, key) && ram_json_double((w), (double) (v), (p)))
+
+/*
+ * Push out whatever is staged and NUL-terminate buf.  Returns false if
+ * anything failed or a container was left open.
+ */
+static inline bool
+ram_json_writer_finish(ram_json_writer_t* w)
+{
+	if (!w->failed && w->depth != 0)
+		w->failed = true;
+	if (!w->failed && w->flush && w->length > 0)
+	{
+		if (!w->flush(w->flush_context, w->buf, w->length))
+			w->failed = true;
+		w->length = 0;
+	}
+	if (w->buf)
+		w->buf[w->length] = '\0';
+	return !w->failed;
+}
+
+/* ---------------------------------------------------------------------
+ * Reader
+ * ---------------------------------------------------------------------
+ */
+
+typedef enum
+{
+	RAM_JSON_NONE = 0,
+	RAM_JSON_OBJECT,
+	RAM_JSON_ARRAY,
+	RAM_JSON_STRING,
+	RAM_JSON_NUMBER,
+	RAM_JSON_TRUE,
+	RAM_JSON_FALSE,
+	RAM_JSON_NULL
+} ram_json_type_t;
+
+/* ram_json_parse() results below zero */
+#define RAM_JSON_ERROR_NOMEM   (-1) /* more tokens than max_tokens */
+#define RAM_JSON_ERROR_INVALID (-2)
+#define RAM_JSON_ERROR_PARTIAL (-3) /* input ended mid-document */
+
+/*
+ * One value.  start and end are byte offsets; for a string they bound
+ * the text between the quotes.  An object's members are its key and
+ * value tokens in turn, and size counts members or elements.  next is
+ * the index just past this value and everything inside it.
+ */
+typedef struct ram_json_token_t
+{
+	ram_json_type_t type;
+	int32_t start;
+	int32_t end;
+	int32_t size;
+	int32_t next;
+	bool escaped; /* string holds a backslash escape */
+} ram_json_token_t;
+
+static inline int32_t
+ram_json_add_token(ram_json_token_t* tokens, int32_t* count, int32_t max_tokens,
+				   ram_json_type_t type, size_t start, size_t end)
+{
+	ram_json_token_t* t;
+
+	if (*count >= max_tokens)
+		return RAM_JSON_ERROR_NOMEM;
+
+	t = &tokens[*count];
+	t->type = type;
+	t->start = (int32_t) start;
+	t->end = (int32_t) end;
+	t->size = 0;
+	t->next = *count + 1;
+	t->escaped = false;
+	return (*count)++;
+}
+
+static inline bool
+ram_json_is_hex(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/* Scan a string starting at its opening quote; returns the closing quote */
+static inline int32_t
+ram_json_scan_string(const char* js, size_t length, size_t pos, bool* escaped)
+{
+	for (pos++; pos < length; pos++)
+	{
+		unsigned char c = (unsigned char) js[pos];
+
+		if (c == '"')
+			return (int32_t) pos;
+		if (c < 0x20)
+			return RAM_JSON_ERROR_INVALID;
+		if (c != '\\')
+			continue;
+
+		*escaped = true;
+		if (++pos >= length)
+			return RAM_JSON_ERROR_PARTIAL;
+		switch (js[pos])
+		{
+			case '"':
+			case '\\':
+			case '/':
+			case 'b':
+			case 'f':
+			case 'n':
+			case 'r':
+			case 't':
+				break;
+			case 'u':
+				for (int i = 0; i < 4; i++)
+				{
+					if (++pos >= length)
+						return RAM_JSON_ERROR_PARTIAL;
+					if (!ram_json_is_hex(js[pos]))
+						return RAM_JSON_ERROR_INVALID;
+				}
+				break;
+			default:
+				return RAM_JSON_ERROR_INVALID;
+		}
+	}
+	return RAM_JSON_ERROR_PARTIAL;
+}
+
+/*
+ * Tokenize length bytes of js into tokens.  Returns the number of tokens
+ * used, tokens[0] being the top-level value, or a RAM_JSON_ERROR_* code.
+ */
+static inline int32_t
+ram_json_parse(const char* js, size_t length, ram_json_token_t* tokens, int32_t max_tokens)
+{
+	enum
+	{
+		WANT_VALUE,
+		WANT_VALUE_OR_END,
+		WANT_KEY,
+		WANT_KEY_OR_END,
+		WANT_COLON,
+		WANT_COMMA_OR_END,
+		WANT_NOTHING
+	} state = WANT_VALUE;
+	int32_t stack[RAM_JSON_MAX_DEPTH];
+	int32_t depth = 0;
+	int32_t count = 0;
+	size_t pos = 0;
+
+	if (!js || !tokens || length >= (size_t) INT32_MAX)
+		return RAM_JSON_ERROR_INVALID;
+
+	while (pos < length)
+	{
+		char c = js[pos];
+		int32_t token;
+		int32_t end;
+		bool escaped = false;
+
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+		{
+			pos++;
+			continue;
+		}
+
+		switch (state)
+		{
+			case WANT_COLON:
+				if (c != ':')
+					return RAM_JSON_ERROR_INVALID;
+				state = WANT_VALUE;
+				pos++;
+				continue;
+
+			case WANT_COMMA_OR_END:
+				if (c == ',')
+				{
+					state = tokens[stack[depth - 1]].type == RAM_JSON_OBJECT ? WANT_KEY : WANT_VALUE;
+					pos++;
+					continue;
+				}
+				break;
+
+			case WANT_KEY:
+			case WANT_KEY_OR_END:
+				if (c == '"')
+				{
+					end = ram_json_scan_string(js, length, pos, &escaped);
+					if (end < 0)
+						return end;
+					token = ram_json_add_token(tokens, &count, max_tokens, RAM_JSON_STRING,
+											   pos + 1, (size_t) end);
+					if (token < 0)
+						return token;
+					tokens[token].escaped = escaped;
+					tokens[stack[depth - 1]].size++;
+					state = WANT_COLON;
+					pos = (size_t) end + 1;
+					continue;
+				}
+				if (state == WANT_KEY || c != '}')
+					return RAM_JSON_ERROR_INVALID;
+				break;
+
+			case WANT_NOTHING:
+				return RAM_JSON_ERROR_INVALID;
+
+			case WANT_VALUE:
+			case WANT_VALUE_OR_END:
+				if (c == ']' && state == WANT_VALUE_OR_END)
+					break;
+				if (c == '}' || c == ']')
+					return RAM_JSON_ERROR_INVALID;
+				break;
+		}
+
+		/* Closing the innermost container */
+		if (c == '}' || c == ']')
+		{
+			ram_json_type_t want = c == '}' ? RAM_JSON_OBJECT : RAM_JSON_ARRAY;
+
+			if (depth == 0 || tokens[stack[depth - 1]].type != want)
+				return RAM_JSON_ERROR_INVALID;
+			token = stack[--depth];
+			tokens[token].end = (int32_t) pos + 1;
+			tokens[token].next = count;
+			state = depth == 0 ? WANT_NOTHING : WANT_COMMA_OR_END;
+			pos++;
+			continue;
+		}
+		if (state == WANT_COMMA_OR_END)
+			return RAM_JSON_ERROR_INVALID;
+
+		/* A value; inside an array it counts as an element */
+		if (depth > 0 && tokens[stack[depth - 1]].type == RAM_JSON_ARRAY)
+			tokens[stack[depth - 1]].size++;
+
+		if (c == '{' || c == '[')
+		{
+			if (depth >= RAM_JSON_MAX_DEPTH)
+				return RAM_JSON_ERROR_INVALID;
+			token = ram_json_add_token(tokens, &count, max_tokens,
+									   c == '{' ? RAM_JSON_OBJECT : RAM_JSON_ARRAY, pos, pos);
+			if (token < 0)
+				return token;
+			stack[depth++] = token;
+			state = c == '{' ? WANT_KEY_OR_END : WANT_VALUE_OR_END;
+			pos++;
+			continue;
+		}
+
+		if (c == '"')
+		{
+			end = ram_json_scan_string(js, length, pos, &escaped);
+			if (end < 0)
+				return end;
+			token = ram_json_add_token(tokens, &count, max_tokens, RAM_JSON_STRING,
+									   pos + 1, (size_t) end);
+			if (token < 0)
+				return token;
+			tokens[token].escaped = escaped;
+			pos = (size_t) end + 1;
+		}
+		else if (c == '-' || (c >= '0' && c <= '9'))
+		{
+			size_t start = pos;
+			bool digits = false;
+
+			for (pos++; pos < length; pos++)
+			{
+				c = js[pos];
+				if (c >= '0' && c <= '9')
+					digits = true;
+				else if (c != '.' && c != 'e' && c != 'E' && c != '+' && c != '-')
+					break;
+			}
+			if (!digits && js[start] == '-')
+				return pos < length ? RAM_JSON_ERROR_INVALID : RAM_JSON_ERROR_PARTIAL;
+			token = ram_json_add_token(tokens, &count, max_tokens, RAM_JSON_NUMBER, start, pos);
+			if (token < 0)
+				return token;
+		}
+		else
+		{
+			static const char* const words[] = {"true", "false", "null"};
+			static const ram_json_type_t types[] = {RAM_JSON_TRUE, RAM_JSON_FALSE, RAM_JSON_NULL};
+			int word;
+			size_t word_length;
+			size_t available = length - pos;
+
+			word = c == 't' ? 0 : c == 'f' ? 1 : c == 'n' ? 2 : -1;
+			if (word < 0)
+				return RAM_JSON_ERROR_INVALID;
+			word_length = strlen(words[word]);
+			if (available < word_length)
+				return strncmp(js + pos, words[word], available) == 0 ?
+					RAM_JSON_ERROR_PARTIAL : RAM_JSON_ERROR_INVALID;
+			if (strncmp(js + pos, words[word], word_length) != 0)
+				return RAM_JSON_ERROR_INVALID;
+			token = ram_json_add_token(tokens, &count, max_tokens, types[word],
+									   pos, pos + word_length);
+			if (token < 0)
+				return token;
+			pos += word_length;
+		}
+
+		state = depth == 0 ? WANT_NOTHING : WANT_COMMA_OR_END;
+	}
+
+	return state == WANT_NOTHING ? count : RAM_JSON_ERROR_PARTIAL;
+}
+
+/* True if a key or string token, as written, equals s */
+static inline bool
+ram_json_token_eq(const char* js, const ram_json_token_t* t, const char* s)
+{
+	size_t length = (size_t) (t->end - t->start);
+
+	return t->type == RAM_JSON_STRING && strncmp(js + t->start, s, length) == 0 &&
+		   s[length] == '\0';
+}
+
+/* Index of key's value in the object at tokens[object], or -1 */
+static inline int32_t
+ram_json_object_get(const char* js, const ram_json_token_t* tokens, int32_t object,
+					const char* key)
+{
+	int32_t i;
+	int32_t member;
+
+	if (object < 0 || tokens[object].type != RAM_JSON_OBJECT)
+		return -1;
+
+	for (member = 0, i = object + 1; member < tokens[object].size; member++)
+	{
+		if (ram_json_token_eq(js, &tokens[i], key))
+			return i + 1;
+		i = tokens[i + 1].next;
+	}
+	return -1;
+}
+
+/*
+ * Walk an array: for (i = ram_json_array_first(tokens, a); i >= 0;
+ * i = ram_json_array_next(tokens, a, i)).
+ */
+static inline int32_t
+ram_json_array_first(const ram_json_token_t* tokens, int32_t array)
+{
+	if (array < 0 || tokens[array].type != RAM_JSON_ARRAY || tokens[array].size == 0)
+		return -1;
+	return array + 1;
+}
+
+static inline int32_t
+ram_json_array_next(const ram_json_token_t* tokens, int32_t array, int32_t element)
+{
+	int32_t next = tokens[element].next;
+
+	return next < tokens[array].next ? next : -1;
+}
+
+static inline uint32_t
+ram_json_hex4(const char* p)
+{
+	uint32_t value = 0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		char c = p[i];
+
+		value <<= 4;
+		if (c >= '0' && c <= '9')
+			value |= (uint32_t) (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			value |= (uint32_t) (c - 'a' + 10);
+		else
+			value |= (uint32_t) (c - 'A' + 10);
+	}
+	return value;
+}
+
+/*
+ * Copy a string token, unescaped, into out.  Returns false if it is not a
+ * string or did not fit; out is still terminated, holding what fitted.
+ */
+static inline bool
+ram_json_get_string(const char* js, const ram_json_token_t* tokens, int32_t index,
+					char* out, size_t out_size)
+{
+	const ram_json_token_t* t;
+	const char* p;
+	const char* end;
+	size_t n = 0;
+
+	if (!out || out_size == 0)
+		return false;
+	out[0] = '\0';
+	if (index < 0 || tokens[index].type != RAM_JSON_STRING)
+		return false;
+
+	t = &tokens[index];
+	p = js + t->start;
+	end = js + t->end;
+
+	if (!t->escaped)
+	{
+		size_t length = (size_t) (end - p);
+		bool fits = length < out_size;
+
+		if (!fits)
+			length = out_size - 1;
+		memcpy(out, p, length);
+		out[length] = '\0';
+		return fits;
+	}
+
+	while (p < end)
+	{
+		char utf8[4];
+		size_t utf8_length = 1;
+		uint32_t cp;
+
+		if (*p != '\\')
+			utf8[0] = *p++;
+		else
+		{
+			p++;
+			switch (*p)
+			{
+				case 'b': utf8[0] = '\b'; break;
+				case 'f': utf8[0] = '\f'; break;
+				case 'n': utf8[0] = '\n'; break;
+				case 'r': utf8[0] = '\r'; break;
+				case 't': utf8[0] = '\t'; break;
+				case 'u':
+					cp = ram_json_hex4(p + 1);
+					p += 4;
+					if (cp >= 0xD800 && cp <= 0xDBFF && end - p >= 7 && p[1] == '\\' && p[2] == 'u')
+					{
+						uint32_t low = ram_json_hex4(p + 3);
+
+						if (low >= 0xDC00 && low <= 0xDFFF)
+						{
+							cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+							p += 6;
+						}
+					}
+					if (cp >= 0xD800 && cp <= 0xDFFF)
+						cp = '?';
+
+					if (cp < 0x80)
+						utf8[0] = (char) cp;
+					else if (cp < 0x800)
+					{
+						utf8[0] = (char) (0xC0 | (cp >> 6));
+						utf8[1] = (char) (0x80 | (cp & 0x3F));
+						utf8_length = 2;
+					}
+					else if (cp < 0x10000)
+					{
+						utf8[0] = (char) (0xE0 | (cp >> 12));
+						utf8[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+						utf8[2] = (char) (0x80 | (cp & 0x3F));
+						utf8_length = 3;
+					}
+					else
+					{
+						utf8[0] = (char) (0xF0 | (cp >> 18));
+						utf8[1] = (char) (0x80 | ((cp >> 12) & 0x3F));
+						utf8[2] = (char) (0x80 | ((cp >> 6) & 0x3F));
+						utf8[3] = (char) (0x80 | (cp & 0x3F));
+						utf8_length = 4;
+					}
+					break;
+				default:
+					utf8[0] = *p;
+					break;
+			}
+			p++;
+		}
+
+		if (n + utf8_length >= out_size)
+		{
+			out[n] = '\0';
+			return false;
+		}
+		memcpy(out + n, utf8, utf8_length);
+		n += utf8_length;
+	}
+
+	out[n] = '\0';
+	return true;
+}
+
+/* Integer tokens only; false for fractions, exponents or overflow */
+static inline bool
+ram_json_get_int64(const char* js, const ram_json_token_t* tokens, int32_t index,
+				   int64_t* out)
+{
+	const char* p;
+	const char* end;
+	bool negative;
+	uint64_t magnitude = 0;
+
+	if (index < 0 || tokens[index].type != RAM_JSON_NUMBER)
+		return false;
+
+	p = js + tokens[index].start;
+	end = js + tokens[index].end;
+	negative = *p == '-';
+	if (negative)
+		p++;
+	if (p == end)
+		return false;
+
+	for (; p < end; p++)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		if (magnitude > (UINT64_MAX - 9) / 10)
+			return false;
+		magnitude = magnitude * 10 + (uint64_t) (*p - '0');
+	}
+
+	if (negative ? magnitude > (uint64_t) INT64_MAX + 1 : magnitude > (uint64_t) INT64_MAX)
+		return false;
+	*out = negative ? (int64_t) (0 - magnitude) : (int64_t) magnitude;
+	return true;
+}
+
+static inline bool
+ram_json_get_uint64(const char* js, const ram_json_token_t* tokens, int32_t index,
+					uint64_t* out)
+{
+	const char* p;
+	const char* end;
+	uint64_t value = 0;
+
+	if (index < 0 || tokens[index].type != RAM_JSON_NUMBER)
+		return false;
+
+	p = js + tokens[index].start;
+	end = js + tokens[index].end;
+	if (p == end)
+		return false;
+
+	for (; p < end; p++)
+	{
+		if (*p < '0' || *p > '9')
+			return false;
+		if (value > (UINT64_MAX - (uint64_t) (*p - '0')) / 10)
+			return false;
+		value = value * 10 + (uint64_t) (*p - '0');
+	}
+	*out = value;
+	return true;
+}
+
+static inline bool
+ram_json_get_int32(const char* js, const ram_json_token_t* tokens, int32_t index,
+				   int32_t* out)
+{
+	int64_t value;
+
+	if (!ram_json_get_int64(js, tokens, index, &value) || value < INT32_MIN ||
+		value > INT32_MAX)
+		return false;
+	*out = (int32_t) value;
+	return true;
+}
+
+static inline bool
+ram_json_get_double(const char* js, const ram_json_token_t* tokens, int32_t index,
+					double* out)
+{
+	char text[64];
+	size_t length;
+	char* parse_end;
+
+	if (index < 0 || tokens[index].type != RAM_JSON_NUMBER)
+		return false;
+
+	length = (size_t) (tokens[index].end - tokens[index].start);
+	if (length >= sizeof(text))
+		return false;
+	memcpy(text, js + tokens[index].start, length);
+	text[length] = '\0';
+	*out = strtod(text, &parse_end);
+	return *parse_end == '\0';
+}
+
+static inline bool
+ram_json_get_bool(const ram_json_token_t* tokens, int32_t index, bool* out)
+{
+	if (index < 0 ||
+		(tokens[index].type != RAM_JSON_TRUE && tokens[index].type != RAM_JSON_FALSE))
+		return false;
+	*out = tokens[index].type == RAM_JSON_TRUE;
+	return true;
+}
+
+/*
+ * Copy an object's members into a struct.  Each field names a key and
+ * where its value goes; members that are absent, of the wrong type, or
+ * not listed leave the struct untouched.
+ */
+typedef enum
+{
+	RAM_JSON_BIND_STRING = 0, /* char array; size is its length */
+	RAM_JSON_BIND_INT32,
+	RAM_JSON_BIND_INT64,
+	RAM_JSON_BIND_UINT64,
+	RAM_JSON_BIND_BOOL,
+	RAM_JSON_BIND_DOUBLE
+} ram_json_bind_kind_t;
+
+typedef struct ram_json_field_t
+{
+	const char* key;
+	ram_json_bind_kind_t kind;
+	size_t offset;
+	size_t size;
+} ram_json_field_t;
+
+#define RAM_JSON_FIELD(kind, type, member, key) \
+	{(key), RAM_JSON_BIND_##kind, offsetof(type, member), sizeof(((type*) 0)->member)}
+
+/* Returns how many fields were set, or -1 if tokens[object] is no object */
+static inline int32_t
+ram_json_bind(const char* js, const ram_json_token_t* tokens, int32_t object,
+			  const ram_json_field_t* fields, size_t field_count, void* dest)
+{
+	int32_t bound = 0;
+	int32_t member;
+	int32_t i;
+
+	if (object < 0 || tokens[object].type != RAM_JSON_OBJECT)
+		return -1;
+
+	for (member = 0, i = object + 1; member < tokens[object].size; member++)
+	{
+		int32_t value = i + 1;
+
+		for (size_t f = 0; f < field_count; f++)
+		{
+			char* target = (char*) dest + fields[f].offset;
+			bool ok = false;
+
+			if (!ram_json_token_eq(js, &tokens[i], fields[f].key))
+				continue;
+
+			switch (fields[f].kind)
+			{
+				case RAM_JSON_BIND_STRING:
+					ok = tokens[value].type == RAM_JSON_STRING;
+					if (ok)
+						ram_json_get_string(js, tokens, value, target, fields[f].size);
+					break;
+				case RAM_JSON_BIND_INT32:
+					ok = ram_json_get_int32(js, tokens, value, (int32_t*) (void*) target);
+					break;
+				case RAM_JSON_BIND_INT64:
+					ok = ram_json_get_int64(js, tokens, value, (int64_t*) (void*) target);
+					break;
+				case RAM_JSON_BIND_UINT64:
+					ok = ram_json_get_uint64(js, tokens, value, (uint64_t*) (void*) target);
+					break;
+				case RAM_JSON_BIND_BOOL:
+					ok = ram_json_get_bool(tokens, value, (bool*) (void*) target);
+					break;
+				case RAM_JSON_BIND_DOUBLE:
+					ok = ram_json_get_double(js, tokens, value, (double*) (void*) target);
+					break;
+			}
+			if (ok)
+				bound++;
+			break;
+		}
+		i = tokens[value].next;
+	}
+	return bound;
+}
+
+#endif /* RAM_JSON_H */
@@ -0,0 +1,191 @@
+/*-------------------------------------------------------------------------
+ *
+ * ram_state.h
+ *		Binary cluster-state snapshot served by GET /api/v1/state?format=bin
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * One fixed-size header followed by node_count fixed-size node records,
+ * every integer little-endian and every string NUL-padded.  Fields are
+ * only ever appended: a reader steps by the header_size and node_size
+ * carried in the header rather than by the sizes below, so it keeps
+ * working when a newer ramd sends longer records.  schema_version moves
+ * only when an existing field changes meaning or position.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAM_STATE_H
+#define RAM_STATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define RAM_STATE_MAGIC          "RAMS"
+#define RAM_STATE_SCHEMA_VERSION 1
+#define RAM_STATE_CONTENT_TYPE   "application/vnd.pgelephant.ram-state"
+
+#define RAM_STATE_NAME_LENGTH     64  /* cluster name, NUL-padded */
+#define RAM_STATE_HOSTNAME_LENGTH 128 /* node hostname, NUL-padded */
+
+/* Header: byte offsets */
+#define RAM_STATE_H_MAGIC           0   /* char[4] */
+#define RAM_STATE_H_SCHEMA_VERSION  4   /* uint16 */
+#define RAM_STATE_H_HEADER_SIZE     6   /* uint16 */
+#define RAM_STATE_H_NODE_SIZE       8   /* uint16 */
+#define RAM_STATE_H_NODE_COUNT      10  /* uint16 */
+#define RAM_STATE_H_FLAGS           12  /* uint32, RAM_STATE_CLUSTER_* */
+#define RAM_STATE_H_EPOCH           16  /* uint64, as in the ETag */
+#define RAM_STATE_H_VERSION         24  /* uint64, as in the ETag */
+#define RAM_STATE_H_CHANGED_AT      32  /* int64, unix seconds */
+#define RAM_STATE_H_RAFT_TERM       40  /* int64, -1 if unknown */
+#define RAM_STATE_H_PRIMARY_NODE_ID 48  /* int32 */
+#define RAM_STATE_H_LEADER_NODE_ID  52  /* int32 */
+#define RAM_STATE_H_LOCAL_NODE_ID   56  /* int32, the ramd that answered */
+#define RAM_STATE_H_FAILOVER_STATE  60  /* int32, ramd_failover_state_t */
+#define RAM_STATE_H_CLUSTER_NAME    64  /* char[RAM_STATE_NAME_LENGTH] */
+#define RAM_STATE_HEADER_SIZE       (RAM_STATE_H_CLUSTER_NAME + RAM_STATE_NAME_LENGTH)
+
+#define RAM_STATE_CLUSTER_HAS_QUORUM  0x1
+#define RAM_STATE_CLUSTER_IN_FAILOVER 0x2
+
+/* Node record: byte offsets from the start of the record */
+#define RAM_STATE_N_NODE_ID          0  /* int32 */
+#define RAM_STATE_N_POSTGRESQL_PORT  4  /* int32 */
+#define RAM_STATE_N_STATE            8  /* uint8, ramd_node_state_t */
+#define RAM_STATE_N_ROLE             9  /* uint8, ramd_role_t */
+#define RAM_STATE_N_FLAGS            10 /* uint16, RAM_STATE_NODE_* */
+#define RAM_STATE_N_REPLAY_LAG_MS    12 /* int32, -1 if unknown */
+#define RAM_STATE_N_REPLAY_LAG_BYTES 16 /* int64, -1 if unknown */
+#define RAM_STATE_N_FLUSH_LSN        24 /* int64, -1 if unknown */
+#define RAM_STATE_N_REPLAY_LSN       32 /* int64, -1 if unknown */
+#define RAM_STATE_N_VERSION          40 /* uint64, feed version of its last change */
+#define RAM_STATE_N_HOSTNAME         48 /* char[RAM_STATE_HOSTNAME_LENGTH] */
+#define RAM_STATE_NODE_SIZE          (RAM_STATE_N_HOSTNAME + RAM_STATE_HOSTNAME_LENGTH)
+
+#define RAM_STATE_NODE_PRIMARY 0x1
+#define RAM_STATE_NODE_LEADER  0x2
+#define RAM_STATE_NODE_HEALTHY 0x4
+
+/* Values of the state and role bytes */
+#define RAM_STATE_STATE_UNKNOWN    0
+#define RAM_STATE_STATE_PRIMARY    1
+#define RAM_STATE_STATE_STANDBY    2
+#define RAM_STATE_STATE_FAILED     3
+#define RAM_STATE_STATE_RECOVERING 4
+#define RAM_STATE_ROLE_UNKNOWN     0
+#define RAM_STATE_ROLE_PRIMARY     1
+#define RAM_STATE_ROLE_STANDBY     2
+
+static inline void
+ram_state_put_u16(unsigned char* p, uint16_t v)
+{
+	p[0] = (unsigned char) v;
+	p[1] = (unsigned char) (v >> 8);
+}
+
+static inline void
+ram_state_put_u32(unsigned char* p, uint32_t v)
+{
+	for (int i = 0; i < 4; i++)
+		p[i] = (unsigned char) (v >> (8 * i));
+}
+
+static inline void
+ram_state_put_u64(unsigned char* p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		p[i] = (unsigned char) (v >> (8 * i));
+}
+
+static inline void
+ram_state_put_i32(unsigned char* p, int32_t v)
+{
+	ram_state_put_u32(p, (uint32_t) v);
+}
+
+static inline void
+ram_state_put_i64(unsigned char* p, int64_t v)
+{
+	ram_state_put_u64(p, (uint64_t) v);
+}
+
+/* Copy at most size - 1 bytes of s and zero the rest of the field */
+static inline void
+ram_state_put_string(unsigned char* p, size_t size, const char* s)
+{
+	size_t length = 0;
+
+	while (s && length < size - 1 && s[length] != '\0')
+		length++;
+	if (length > 0)
+		memcpy(p, s, length);
+	memset(p + length, 0, size - length);
+}
+
+static inline uint16_t
+ram_state_get_u16(const unsigned char* p)
+{
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t
+ram_state_get_u32(const unsigned char* p)
+{
+	uint32_t v = 0;
+
+	for (int i = 3; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static inline uint64_t
+ram_state_get_u64(const unsigned char* p)
+{
+	uint64_t v = 0;
+
+	for (int i = 7; i >= 0; i--)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static inline int32_t
+ram_state_get_i32(const unsigned char* p)
+{
+	return (int32_t) ram_state_get_u32(p);
+}
+
+static inline int64_t
+ram_state_get_i64(const unsigned char* p)
+{
+	return (int64_t) ram_state_get_u64(p);
+}
+
+/*
+ * Check a received snapshot and return its node_count, or -1 if it is not
+ * one this reader understands or is shorter than its header says.  Node i
+ * then starts at header_size + i * node_size.
+ */
+static inline int
+ram_state_check(const unsigned char* buf, size_t length, size_t* header_size,
+				size_t* node_size)
+{
+	size_t count;
+
+	if (length < RAM_STATE_HEADER_SIZE ||
+		memcmp(buf + RAM_STATE_H_MAGIC, RAM_STATE_MAGIC, 4) != 0 ||
+		ram_state_get_u16(buf + RAM_STATE_H_SCHEMA_VERSION) != RAM_STATE_SCHEMA_VERSION)
+		return -1;
+
+	*header_size = ram_state_get_u16(buf + RAM_STATE_H_HEADER_SIZE);
+	*node_size = ram_state_get_u16(buf + RAM_STATE_H_NODE_SIZE);
+	count = ram_state_get_u16(buf + RAM_STATE_H_NODE_COUNT);
+	if (*header_size < RAM_STATE_HEADER_SIZE || *node_size < RAM_STATE_NODE_SIZE ||
+		*header_size + count * *node_size > length)
+		return -1;
+	return (int) count;
+}
+
+#endif /* RAM_STATE_H */
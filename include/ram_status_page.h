@@ -0,0 +1,133 @@
+/*-------------------------------------------------------------------------
+ *
+ * ram_status_page.h
+ *		Shared-memory status page published by a ramd for local readers
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * ramd keeps the newest ram_state.h snapshot in a POSIX shared memory
+ * object named after its HTTP port, so tools on the same host can read
+ * the cluster view with a memcpy instead of an HTTP round trip.  The page
+ * is guarded by a sequence lock: ramd makes sequence odd, rewrites the
+ * snapshot and makes it even again, and a reader that saw the same even
+ * value before and after its copy has a consistent snapshot.  Readers
+ * never write to the page and never wait for ramd.
+ *
+ * heartbeat_ms is refreshed every RAM_STATUS_PAGE_HEARTBEAT_MS while ramd
+ * runs, so a page left behind by a daemon that died can be told apart
+ * from a quiet cluster.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAM_STATUS_PAGE_H
+#define RAM_STATUS_PAGE_H
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ram_state.h"
+
+#define RAM_STATUS_PAGE_NAME         "/ramd-status.%d" /* ramd's http_port */
+#define RAM_STATUS_PAGE_MAGIC        "RAMP"
+#define RAM_STATUS_PAGE_LAYOUT       1
+#define RAM_STATUS_PAGE_SIZE         65536
+#define RAM_STATUS_PAGE_HEARTBEAT_MS 1000
+#define RAM_STATUS_PAGE_READ_RETRIES 1000 /* copies torn by a write before giving up */
+
+typedef struct ram_status_page_t
+{
+	char magic[4];
+	uint32_t layout;            /* RAM_STATUS_PAGE_LAYOUT */
+	_Atomic uint64_t sequence;  /* odd while ramd is rewriting the snapshot */
+	_Atomic int64_t heartbeat_ms; /* unix time in ms, -1 once ramd has stopped */
+	int32_t pid;                /* of the publishing ramd */
+	uint32_t length;            /* bytes of state in use */
+	unsigned char state[];      /* ram_state.h snapshot */
+} ram_status_page_t;
+
+#define RAM_STATUS_PAGE_CAPACITY (RAM_STATUS_PAGE_SIZE - offsetof(ram_status_page_t, state))
+
+/*
+ * Map the page of the ramd listening on http_port read-only; NULL if that
+ * ramd publishes none or the layout is not this one.  Unmap with
+ * munmap(page, RAM_STATUS_PAGE_SIZE).
+ */
+static inline const ram_status_page_t*
+ram_status_page_open(int http_port)
+{
+	char name[64];
+	struct stat st;
+	void* map;
+	int fd;
+
+	snprintf(name, sizeof(name), RAM_STATUS_PAGE_NAME, http_port);
+	fd = shm_open(name, O_RDONLY, 0);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) RAM_STATUS_PAGE_SIZE)
+	{
+		close(fd);
+		return NULL;
+	}
+	map = mmap(NULL, RAM_STATUS_PAGE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return NULL;
+
+	if (memcmp(((const ram_status_page_t*) map)->magic, RAM_STATUS_PAGE_MAGIC, 4) != 0 ||
+		((const ram_status_page_t*) map)->layout != RAM_STATUS_PAGE_LAYOUT)
+	{
+		munmap(map, RAM_STATUS_PAGE_SIZE);
+		return NULL;
+	}
+	return (const ram_status_page_t*) map;
+}
+
+/*
+ * Copy a consistent snapshot into out and return its length, to be
+ * checked with ram_state_check(); 0 if none was published yet, it does
+ * not fit in size, or ramd kept rewriting it for every retry.
+ */
+static inline size_t
+ram_status_page_read(const ram_status_page_t* page, unsigned char* out, size_t size)
+{
+	for (int attempt = 0; attempt < RAM_STATUS_PAGE_READ_RETRIES; attempt++)
+	{
+		uint64_t before = atomic_load_explicit(&page->sequence, memory_order_acquire);
+		uint64_t after;
+		size_t length;
+
+		if (before & 1)
+			continue;
+		length = page->length;
+		if (length == 0 || length > size || length > RAM_STATUS_PAGE_CAPACITY)
+			return 0;
+		memcpy(out, page->state, length);
+
+		atomic_thread_fence(memory_order_acquire);
+		after = atomic_load_explicit(&page->sequence, memory_order_relaxed);
+		if (before == after)
+			return length;
+	}
+	return 0;
+}
+
+/* The page's ramd is running and refreshed it within max_age_ms of now_ms */
+static inline bool
+ram_status_page_alive(const ram_status_page_t* page, int64_t now_ms, int64_t max_age_ms)
+{
+	int64_t heartbeat = atomic_load_explicit(&page->heartbeat_ms, memory_order_relaxed);
+
+	return heartbeat > 0 && now_ms - heartbeat <= max_age_ms;
+}
+
+#endif /* RAM_STATUS_PAGE_H */
@@ -1,57 +1,390 @@
+/*-------------------------------------------------------------------------
+ *
+ * thread_safety.h
+ *		Lock-free counter, queue and hash table shared by ramd and ramctrl
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * None of these take a lock.  The queue is a bounded multi-producer,
+ * multi-consumer ring in the style of Dmitry Vyukov's: every cell carries
+ * a sequence number that says whose turn it is, so producers and
+ * consumers each claim a position with one compare-and-swap and never
+ * touch each other's index.  The hash table uses open addressing with
+ * linear probing; a key claims its slot with a compare-and-swap and keeps
+ * it for the life of the table, so readers never see a key move.
+ *
+ * Everything is fixed-size once created, and full is reported rather than
+ * waited on: callers that need to block pair these with their own
+ * condition variable.
+ *
+ *-------------------------------------------------------------------------
+ */
+
 #ifndef THREAD_SAFETY_H
 #define THREAD_SAFETY_H
 
-#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* Keeps the producer and consumer indexes off each other's cache line */
+#define THREAD_SAFETY_CACHE_LINE 64
+
+/* ---------------------------------------------------------------------
+ * Counter
+ * ---------------------------------------------------------------------
+ */
 
-/* Thread-safe counter */
-typedef struct {
-    int value;
-    pthread_mutex_t mutex;
+typedef struct thread_safe_counter_t
+{
+	atomic_int value;
 } thread_safe_counter_t;
 
-/* Thread-safe queue */
-typedef struct {
-    void** data;
-    size_t size;
-    size_t capacity;
-    size_t head;
-    size_t tail;
-    pthread_mutex_t mutex;
-    pthread_cond_t not_empty;
-    pthread_cond_t not_full;
+static inline thread_safe_counter_t*
+thread_safe_counter_create(void)
+{
+	thread_safe_counter_t* counter = malloc(sizeof(*counter));
+
+	if (counter)
+		atomic_init(&counter->value, 0);
+	return counter;
+}
+
+static inline void
+thread_safe_counter_destroy(thread_safe_counter_t* counter)
+{
+	free(counter);
+}
+
+static inline int
+thread_safe_counter_get(thread_safe_counter_t* counter)
+{
+	return counter ? atomic_load_explicit(&counter->value, memory_order_relaxed) : 0;
+}
+
+static inline void
+thread_safe_counter_increment(thread_safe_counter_t* counter)
+{
+	if (counter)
+		atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+}
+
+static inline void
+thread_safe_counter_decrement(thread_safe_counter_t* counter)
+{
+	if (counter)
+		atomic_fetch_sub_explicit(&counter->value, 1, memory_order_relaxed);
+}
+
+/* ---------------------------------------------------------------------
+ * Queue
+ * ---------------------------------------------------------------------
+ */
+
+typedef struct thread_safe_queue_cell_t
+{
+	atomic_size_t sequence; /* position it takes next: pos to fill, pos + 1 to drain */
+	void* data;
+} thread_safe_queue_cell_t;
+
+typedef struct thread_safe_queue_t
+{
+	thread_safe_queue_cell_t* cells;
+	size_t mask; /* capacity - 1; capacity is a power of two */
+	alignas(THREAD_SAFETY_CACHE_LINE) atomic_size_t head; /* next position to dequeue */
+	alignas(THREAD_SAFETY_CACHE_LINE) atomic_size_t tail; /* next position to enqueue */
 } thread_safe_queue_t;
 
-/* Thread-safe hash table */
-typedef struct {
-    void** keys;
-    void** values;
-    size_t size;
-    size_t capacity;
-    pthread_mutex_t mutex;
+/* Room for at least capacity items; it is rounded up to a power of two */
+static inline thread_safe_queue_t*
+thread_safe_queue_create(size_t capacity)
+{
+	thread_safe_queue_t* queue;
+	size_t size = 2;
+
+	if (capacity > SIZE_MAX / 2 / sizeof(thread_safe_queue_cell_t))
+		return NULL;
+	while (size < capacity)
+		size <<= 1;
+
+	queue = aligned_alloc(THREAD_SAFETY_CACHE_LINE, sizeof(*queue));
+	if (!queue)
+		return NULL;
+	queue->cells = malloc(size * sizeof(thread_safe_queue_cell_t));
+	if (!queue->cells)
+	{
+		free(queue);
+		return NULL;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		atomic_init(&queue->cells[i].sequence, i);
+		queue->cells[i].data = NULL;
+	}
+	queue->mask = size - 1;
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->tail, 0);
+	return queue;
+}
+
+/* Items still queued are not freed; they belong to the caller */
+static inline void
+thread_safe_queue_destroy(thread_safe_queue_t* queue)
+{
+	if (!queue)
+		return;
+	free(queue->cells);
+	free(queue);
+}
+
+/* Add item at the tail; false if the queue is full.  item must not be NULL. */
+static inline bool
+thread_safe_queue_enqueue(thread_safe_queue_t* queue, void* item)
+{
+	thread_safe_queue_cell_t* cell;
+	size_t pos;
+
+	if (!queue || !item)
+		return false;
+
+	pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	for (;;)
+	{
+		size_t sequence;
+		intptr_t diff;
+
+		cell = &queue->cells[pos & queue->mask];
+		sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		diff = (intptr_t) sequence - (intptr_t) pos;
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false; /* the consumer a lap behind has not drained this cell */
+		else
+			pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	}
+
+	cell->data = item;
+	atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+	return true;
+}
+
+/* Take the item at the head; NULL if the queue is empty */
+static inline void*
+thread_safe_queue_dequeue(thread_safe_queue_t* queue)
+{
+	thread_safe_queue_cell_t* cell;
+	size_t pos;
+	void* item;
+
+	if (!queue)
+		return NULL;
+
+	pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	for (;;)
+	{
+		size_t sequence;
+		intptr_t diff;
+
+		cell = &queue->cells[pos & queue->mask];
+		sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+		diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return NULL; /* no producer has filled this cell yet */
+		else
+			pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	}
+
+	item = cell->data;
+	atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+	return item;
+}
+
+/* Both are a snapshot: another thread may change the answer right after */
+static inline bool
+thread_safe_queue_is_empty(thread_safe_queue_t* queue)
+{
+	if (!queue)
+		return true;
+	return atomic_load_explicit(&queue->head, memory_order_acquire) ==
+	       atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
+
+static inline bool
+thread_safe_queue_is_full(thread_safe_queue_t* queue)
+{
+	size_t head;
+	size_t tail;
+
+	if (!queue)
+		return false;
+	head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	return tail - head > queue->mask;
+}
+
+/* ---------------------------------------------------------------------
+ * Hash table
+ *
+ * Keys are compared as pointers, so they are either pointers with a
+ * stable identity or integers cast to void*; NULL is not a key.  A removed
+ * key keeps its slot, and putting it again reuses that slot, so size the
+ * table for the number of distinct keys it will ever hold.  Values are
+ * published with release order, so what a value points at is visible to
+ * the thread that gets it; freeing a replaced value safely is up to the
+ * caller.
+ * ---------------------------------------------------------------------
+ */
+
+typedef struct thread_safe_hash_slot_t
+{
+	atomic_uintptr_t key;   /* 0 until a key claims the slot */
+	atomic_uintptr_t value; /* 0 when absent or removed */
+} thread_safe_hash_slot_t;
+
+typedef struct thread_safe_hash_t
+{
+	thread_safe_hash_slot_t* slots;
+	size_t mask;       /* slot count - 1; at least twice the requested capacity */
+	atomic_size_t size; /* slots claimed by a key */
 } thread_safe_hash_t;
 
-/* Counter functions */
-thread_safe_counter_t* thread_safe_counter_create(void);
-void thread_safe_counter_destroy(thread_safe_counter_t* counter);
-int thread_safe_counter_get(thread_safe_counter_t* counter);
-void thread_safe_counter_increment(thread_safe_counter_t* counter);
-void thread_safe_counter_decrement(thread_safe_counter_t* counter);
-
-/* Queue functions */
-thread_safe_queue_t* thread_safe_queue_create(size_t capacity);
-void thread_safe_queue_destroy(thread_safe_queue_t* queue);
-bool thread_safe_queue_enqueue(thread_safe_queue_t* queue, void* item);
-void* thread_safe_queue_dequeue(thread_safe_queue_t* queue);
-bool thread_safe_queue_is_empty(thread_safe_queue_t* queue);
-bool thread_safe_queue_is_full(thread_safe_queue_t* queue);
-
-/* Hash table functions */
-thread_safe_hash_t* thread_safe_hash_create(size_t capacity);
-void thread_safe_hash_destroy(thread_safe_hash_t* hash);
-void thread_safe_hash_put(thread_safe_hash_t* hash, void* key, void* value);
-void* thread_safe_hash_get(thread_safe_hash_t* hash, void* key);
-void thread_safe_hash_remove(thread_safe_hash_t* hash, void* key);
+/* Spread pointer bits over the table; the low bits of an address are mostly zero */
+static inline size_t
+thread_safe_hash_mix(uintptr_t key)
+{
+	uint64_t h = (uint64_t) key;
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (size_t) h;
+}
+
+/* Room for capacity distinct keys at a load factor of at most one half */
+static inline thread_safe_hash_t*
+thread_safe_hash_create(size_t capacity)
+{
+	thread_safe_hash_t* hash;
+	size_t size = 2;
+
+	if (capacity > SIZE_MAX / 4 / sizeof(thread_safe_hash_slot_t))
+		return NULL;
+	while (size < capacity * 2)
+		size <<= 1;
+
+	hash = malloc(sizeof(*hash));
+	if (!hash)
+		return NULL;
+	hash->slots = malloc(size * sizeof(thread_safe_hash_slot_t));
+	if (!hash->slots)
+	{
+		free(hash);
+		return NULL;
+	}
+	for (size_t i = 0; i < size; i++)
+	{
+		atomic_init(&hash->slots[i].key, 0);
+		atomic_init(&hash->slots[i].value, 0);
+	}
+	hash->mask = size - 1;
+	atomic_init(&hash->size, 0);
+	return hash;
+}
+
+static inline void
+thread_safe_hash_destroy(thread_safe_hash_t* hash)
+{
+	if (!hash)
+		return;
+	free(hash->slots);
+	free(hash);
+}
+
+/* The slot key holds, claiming a free one when claim is set; NULL if none */
+static inline thread_safe_hash_slot_t*
+thread_safe_hash_find(thread_safe_hash_t* hash, uintptr_t key, bool claim)
+{
+	size_t index = thread_safe_hash_mix(key) & hash->mask;
+
+	for (size_t probes = 0; probes <= hash->mask; probes++)
+	{
+		thread_safe_hash_slot_t* slot = &hash->slots[index];
+		uintptr_t current = atomic_load_explicit(&slot->key, memory_order_acquire);
+
+		if (current == key)
+			return slot;
+		if (current == 0)
+		{
+			if (!claim)
+				return NULL; /* keys never leave, so the probe chain ends here */
+			if (atomic_compare_exchange_strong_explicit(&slot->key, &current, key,
+			                                            memory_order_acq_rel,
+			                                            memory_order_acquire))
+			{
+				atomic_fetch_add_explicit(&hash->size, 1, memory_order_relaxed);
+				return slot;
+			}
+			if (current == key)
+				return slot; /* another thread put the same key first */
+		}
+		index = (index + 1) & hash->mask;
+	}
+	return NULL;
+}
+
+/*
+ * Set key's value, replacing any earlier one; a NULL value removes it.
+ * False only when the table has no slot left for a new key.
+ */
+static inline bool
+thread_safe_hash_put(thread_safe_hash_t* hash, void* key, void* value)
+{
+	thread_safe_hash_slot_t* slot;
+
+	if (!hash || !key)
+		return false;
+	slot = thread_safe_hash_find(hash, (uintptr_t) key, value != NULL);
+	if (!slot)
+		return value == NULL;
+	atomic_store_explicit(&slot->value, (uintptr_t) value, memory_order_release);
+	return true;
+}
+
+static inline void*
+thread_safe_hash_get(thread_safe_hash_t* hash, void* key)
+{
+	thread_safe_hash_slot_t* slot;
+
+	if (!hash || !key)
+		return NULL;
+	slot = thread_safe_hash_find(hash, (uintptr_t) key, false);
+	if (!slot)
+		return NULL;
+	return (void*) atomic_load_explicit(&slot->value, memory_order_acquire);
+}
+
+static inline void
+thread_safe_hash_remove(thread_safe_hash_t* hash, void* key)
+{
+	(void) thread_safe_hash_put(hash, key, NULL);
+}
 
 #endif /* THREAD_SAFETY_H */
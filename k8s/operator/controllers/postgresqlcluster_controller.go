@@ -5,13 +5,17 @@ import (
 	"fmt"
 	"time"
 
+	"k8s.io/apimachinery/pkg/api/equality"
 	"k8s.io/apimachinery/pkg/api/errors"
 	"k8s.io/apimachinery/pkg/runtime"
 	"k8s.io/apimachinery/pkg/types"
+	"k8s.io/apimachinery/pkg/util/intstr"
 	ctrl "sigs.k8s.io/controller-runtime"
 	"sigs.k8s.io/controller-runtime/pkg/client"
 	"sigs.k8s.io/controller-runtime/pkg/controller/controllerutil"
+	"sigs.k8s.io/controller-runtime/pkg/handler"
 	"sigs.k8s.io/controller-runtime/pkg/log"
+	"sigs.k8s.io/controller-runtime/pkg/source"
 
 	appsv1 "k8s.io/api/apps/v1"
 	corev1 "k8s.io/api/core/v1"
@@ -20,10 +24,21 @@ import (
 	ramv1 "github.com/pgelephant/pgraft/k8s/operator/api/v1"
 )
 
+const (
+	// Fallback resync while the cluster's ramd watch is answering; role and
+	// health changes arrive through the watch instead
+	resyncWatched = 5 * time.Minute
+
+	// Resync while the watch is not answering, as before there was one
+	resyncUnwatched = 30 * time.Second
+)
+
 // PostgreSQLClusterReconciler reconciles a PostgreSQLCluster object
 type PostgreSQLClusterReconciler struct {
 	client.Client
 	Scheme *runtime.Scheme
+
+	watcher *ramdWatcher
 }
 
 //+kubebuilder:rbac:groups=ram.pgelephant.com,resources=postgresqlclusters,verbs=get;list;watch;create;update;patch;delete
@@ -45,6 +60,7 @@ func (r *PostgreSQLClusterReconciler) Reconcile(ctx context.Context, req ctrl.Re
 	if err != nil {
 		if errors.IsNotFound(err) {
 			log.Info("PostgreSQLCluster resource not found. Ignoring since object must be deleted.")
+			r.watcher.forget(req.NamespacedName)
 			return ctrl.Result{}, nil
 		}
 		log.Error(err, "Failed to get PostgreSQLCluster")
@@ -54,8 +70,12 @@ func (r *PostgreSQLClusterReconciler) Reconcile(ctx context.Context, req ctrl.Re
 	// Set default values
 	r.setDefaults(cluster)
 
+	// Follow the cluster's ramd so role changes reconcile it at once
+	r.watcher.ensure(cluster)
+	view := r.watcher.view(req.NamespacedName)
+
 	// Update status
-	if err := r.updateStatus(ctx, cluster); err != nil {
+	if err := r.updateStatus(ctx, cluster, &view); err != nil {
 		log.Error(err, "Failed to update status")
 		return ctrl.Result{}, err
 	}
@@ -104,7 +124,10 @@ func (r *PostgreSQLClusterReconciler) Reconcile(ctx context.Context, req ctrl.Re
 		}
 	}
 
-	return ctrl.Result{RequeueAfter: 30 * time.Second}, nil
+	if view.Live {
+		return ctrl.Result{RequeueAfter: resyncWatched}, nil
+	}
+	return ctrl.Result{RequeueAfter: resyncUnwatched}, nil
 }
 
 // setDefaults sets default values for the PostgreSQLCluster
@@ -132,8 +155,13 @@ func (r *PostgreSQLClusterReconciler) setDefaults(cluster *ramv1.PostgreSQLClust
 	}
 }
 
-// updateStatus updates the status of the PostgreSQLCluster
-func (r *PostgreSQLClusterReconciler) updateStatus(ctx context.Context, cluster *ramv1.PostgreSQLCluster) error {
+// updateStatus updates the status of the PostgreSQLCluster.  The whole
+// status goes out as one merge patch, and only if something in it changed,
+// so a resync of a settled cluster costs the API server nothing.
+func (r *PostgreSQLClusterReconciler) updateStatus(ctx context.Context, cluster *ramv1.PostgreSQLCluster,
+	view *ramdClusterView) error {
+	original := cluster.DeepCopy()
+
 	// Get StatefulSet status
 	statefulSet := &appsv1.StatefulSet{}
 	err := r.Get(ctx, types.NamespacedName{
@@ -160,23 +188,34 @@ func (r *PostgreSQLClusterReconciler) updateStatus(ctx context.Context, cluster
 		}
 	}
 
-	// Update leader (simplified - in real implementation, query RAMD)
-	if cluster.Status.ReadyReplicas > 0 {
-		cluster.Status.Leader = fmt.Sprintf("%s-postgresql-0", cluster.Name)
-	}
-
 	// Update endpoints
 	cluster.Status.Endpoints.Primary = fmt.Sprintf("%s-postgresql.%s.svc.cluster.local:%d",
 		cluster.Name, cluster.Namespace, cluster.Spec.Networking.Ports.PostgreSQL)
 
+	// Leader and replicas as ramd reports them; until its watch answers,
+	// assume the first pod leads, as the StatefulSet starts it first
+	primary, hasPrimary := view.primary()
+	if view.Live && hasPrimary {
+		cluster.Status.Leader = ramdPodName(primary.Hostname)
+	} else if cluster.Status.ReadyReplicas > 0 && cluster.Status.Leader == "" {
+		cluster.Status.Leader = fmt.Sprintf("%s-postgresql-0", cluster.Name)
+	}
+
 	cluster.Status.Endpoints.Replicas = []string{}
-	for i := int32(1); i < cluster.Spec.Replicas; i++ {
-		replicaEndpoint := fmt.Sprintf("%s-postgresql-%d.%s-postgresql.%s.svc.cluster.local:%d",
-			cluster.Name, i, cluster.Name, cluster.Namespace, cluster.Spec.Networking.Ports.PostgreSQL)
+	for i := int32(0); i < cluster.Spec.Replicas; i++ {
+		pod := fmt.Sprintf("%s-postgresql-%d", cluster.Name, i)
+		if pod == cluster.Status.Leader {
+			continue
+		}
+		replicaEndpoint := fmt.Sprintf("%s.%s-postgresql.%s.svc.cluster.local:%d",
+			pod, cluster.Name, cluster.Namespace, cluster.Spec.Networking.Ports.PostgreSQL)
 		cluster.Status.Endpoints.Replicas = append(cluster.Status.Endpoints.Replicas, replicaEndpoint)
 	}
 
-	return r.Status().Update(ctx, cluster)
+	if equality.Semantic.DeepEqual(original.Status, cluster.Status) {
+		return nil
+	}
+	return r.Status().Patch(ctx, cluster, client.MergeFrom(original))
 }
 
 // reconcileConfigMap creates or updates the ConfigMap
@@ -557,8 +596,14 @@ func (r *PostgreSQLClusterReconciler) reconcileMonitoring(ctx context.Context, c
 
 // SetupWithManager sets up the controller with the Manager.
 func (r *PostgreSQLClusterReconciler) SetupWithManager(mgr ctrl.Manager) error {
+	r.watcher = newRAMDWatcher()
+	if err := mgr.Add(r.watcher); err != nil {
+		return err
+	}
+
 	return ctrl.NewControllerManagedBy(mgr).
 		For(&ramv1.PostgreSQLCluster{}).
+		Watches(&source.Channel{Source: r.watcher.events}, &handler.EnqueueRequestForObject{}).
 		Owns(&appsv1.StatefulSet{}).
 		Owns(&appsv1.Deployment{}).
 		Owns(&corev1.Service{}).
@@ -0,0 +1,312 @@
+package controllers
+
+import (
+	"context"
+	"encoding/json"
+	"fmt"
+	"io"
+	"net"
+	"net/http"
+	"strings"
+	"sync"
+	"time"
+
+	metav1 "k8s.io/apimachinery/pkg/apis/meta/v1"
+	"k8s.io/apimachinery/pkg/types"
+	ctrl "sigs.k8s.io/controller-runtime"
+	"sigs.k8s.io/controller-runtime/pkg/event"
+
+	ramv1 "github.com/pgelephant/pgraft/k8s/operator/api/v1"
+)
+
+const (
+	// How long ramd may hold a watch request open; below its 60 s cap
+	ramdWatchWait = 25 * time.Second
+
+	// Reconnect delays after a failed watch request
+	ramdWatchRetryMin = 1 * time.Second
+	ramdWatchRetryMax = 30 * time.Second
+)
+
+// ramdNodeView is what the operator keeps of one node from ramd's watch feed
+type ramdNodeView struct {
+	Hostname  string `json:"hostname"`
+	Port      int32  `json:"postgresql_port"`
+	Role      string `json:"role"`
+	IsHealthy bool   `json:"is_healthy"`
+	IsPrimary bool   `json:"is_primary"`
+}
+
+// ramdClusterView is the cluster as last reported by ramd
+type ramdClusterView struct {
+	Live          bool
+	PrimaryNodeID int32
+	LeaderNodeID  int32
+	HasQuorum     bool
+	InFailover    bool
+	Nodes         map[int32]ramdNodeView
+}
+
+// ramdWatchResponse is the body of GET /api/v1/watch
+type ramdWatchResponse struct {
+	Epoch   uint64 `json:"epoch"`
+	Version uint64 `json:"version"`
+	Full    bool   `json:"full"`
+	Cluster *struct {
+		PrimaryNodeID int32 `json:"primary_node_id"`
+		LeaderNodeID  int32 `json:"leader_node_id"`
+		HasQuorum     bool  `json:"has_quorum"`
+		InFailover    bool  `json:"in_failover"`
+	} `json:"cluster"`
+	Nodes []struct {
+		NodeID int32 `json:"node_id"`
+		ramdNodeView
+	} `json:"nodes"`
+}
+
+type ramdClusterWatch struct {
+	url    string
+	cancel context.CancelFunc
+	view   ramdClusterView
+}
+
+// ramdWatcher follows the watch feed of every cluster's ramd and queues a
+// reconcile for the cluster when a node's role or health, the primary, the
+// leader, quorum or failover state moves.  Lag updates do not count.  The
+// work queue folds a burst of changes for one cluster into a single
+// reconcile, so a failover costs one status patch, not one per event.
+type ramdWatcher struct {
+	mu       sync.Mutex
+	ctx      context.Context
+	cancel   context.CancelFunc
+	client   *http.Client
+	clusters map[types.NamespacedName]*ramdClusterWatch
+	events   chan event.GenericEvent
+}
+
+func newRAMDWatcher() *ramdWatcher {
+	ctx, cancel := context.WithCancel(context.Background())
+	return &ramdWatcher{
+		ctx:      ctx,
+		cancel:   cancel,
+		client:   &http.Client{Timeout: ramdWatchWait + 10*time.Second},
+		clusters: make(map[types.NamespacedName]*ramdClusterWatch),
+		events:   make(chan event.GenericEvent, 1024),
+	}
+}
+
+// Start is run by the manager; it stops every watch when the manager stops
+func (w *ramdWatcher) Start(ctx context.Context) error {
+	<-ctx.Done()
+	w.cancel()
+	return nil
+}
+
+// ramdWatchURL is the watch endpoint of the cluster's RAMD Service
+func ramdWatchURL(cluster *ramv1.PostgreSQLCluster) string {
+	scheme := "http"
+	if cluster.Spec.RAMD.Config.Security.EnableSSL {
+		scheme = "https"
+	}
+	return fmt.Sprintf("%s://%s-ramd.%s.svc.cluster.local:%d/api/v1/watch",
+		scheme, cluster.Name, cluster.Namespace, cluster.Spec.Networking.Ports.RAMD)
+}
+
+// ensure follows the cluster's ramd, restarting the watch if its address changed
+func (w *ramdWatcher) ensure(cluster *ramv1.PostgreSQLCluster) {
+	key := types.NamespacedName{Name: cluster.Name, Namespace: cluster.Namespace}
+	url := ramdWatchURL(cluster)
+
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	if cw, ok := w.clusters[key]; ok {
+		if cw.url == url {
+			return
+		}
+		cw.cancel()
+	}
+
+	ctx, cancel := context.WithCancel(w.ctx)
+	cw := &ramdClusterWatch{url: url, cancel: cancel}
+	w.clusters[key] = cw
+	go w.follow(ctx, key, cw)
+}
+
+// forget stops following a cluster that has been deleted
+func (w *ramdWatcher) forget(key types.NamespacedName) {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	if cw, ok := w.clusters[key]; ok {
+		cw.cancel()
+		delete(w.clusters, key)
+	}
+}
+
+// view returns a copy of the cluster's last view; Live is false until the
+// watch has answered and after it fails
+func (w *ramdWatcher) view(key types.NamespacedName) ramdClusterView {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	cw, ok := w.clusters[key]
+	if !ok {
+		return ramdClusterView{}
+	}
+	view := cw.view
+	view.Nodes = make(map[int32]ramdNodeView, len(cw.view.Nodes))
+	for id, node := range cw.view.Nodes {
+		view.Nodes[id] = node
+	}
+	return view
+}
+
+func (w *ramdWatcher) follow(ctx context.Context, key types.NamespacedName, cw *ramdClusterWatch) {
+	logger := ctrl.Log.WithName("ramd-watch").WithValues("postgresqlcluster", key, "url", cw.url)
+	var epoch, version uint64
+	haveVersion := false
+	retry := ramdWatchRetryMin
+
+	for ctx.Err() == nil {
+		url := fmt.Sprintf("%s?wait_ms=%d", cw.url, ramdWatchWait.Milliseconds())
+		if haveVersion {
+			url += fmt.Sprintf("&since=%d&epoch=%d", version, epoch)
+		}
+
+		resp, err := w.poll(ctx, url)
+		if err != nil {
+			if ctx.Err() != nil {
+				return
+			}
+			logger.V(1).Info("RAMD watch failed", "error", err.Error(), "retry", retry)
+			haveVersion = false
+			w.apply(key, cw, nil)
+			select {
+			case <-ctx.Done():
+				return
+			case <-time.After(retry):
+			}
+			if retry *= 2; retry > ramdWatchRetryMax {
+				retry = ramdWatchRetryMax
+			}
+			continue
+		}
+
+		retry = ramdWatchRetryMin
+		epoch, version, haveVersion = resp.Epoch, resp.Version, true
+		w.apply(key, cw, resp)
+	}
+}
+
+func (w *ramdWatcher) poll(ctx context.Context, url string) (*ramdWatchResponse, error) {
+	req, err := http.NewRequestWithContext(ctx, http.MethodGet, url, nil)
+	if err != nil {
+		return nil, err
+	}
+	httpResp, err := w.client.Do(req)
+	if err != nil {
+		return nil, err
+	}
+	defer httpResp.Body.Close()
+
+	if httpResp.StatusCode != http.StatusOK {
+		io.Copy(io.Discard, httpResp.Body)
+		return nil, fmt.Errorf("unexpected status %s", httpResp.Status)
+	}
+	resp := &ramdWatchResponse{}
+	if err := json.NewDecoder(httpResp.Body).Decode(resp); err != nil {
+		return nil, err
+	}
+	return resp, nil
+}
+
+// apply merges a watch answer into the view, or marks it stale when resp
+// is nil, and queues a reconcile if anything the operator acts on moved
+func (w *ramdWatcher) apply(key types.NamespacedName, cw *ramdClusterWatch, resp *ramdWatchResponse) {
+	w.mu.Lock()
+	before := cw.view
+	next := ramdClusterView{
+		Live:          resp != nil,
+		PrimaryNodeID: before.PrimaryNodeID,
+		LeaderNodeID:  before.LeaderNodeID,
+		HasQuorum:     before.HasQuorum,
+		InFailover:    before.InFailover,
+		Nodes:         make(map[int32]ramdNodeView, len(before.Nodes)),
+	}
+	if resp != nil {
+		if !resp.Full {
+			for id, node := range before.Nodes {
+				next.Nodes[id] = node
+			}
+		}
+		if resp.Cluster != nil {
+			next.PrimaryNodeID = resp.Cluster.PrimaryNodeID
+			next.LeaderNodeID = resp.Cluster.LeaderNodeID
+			next.HasQuorum = resp.Cluster.HasQuorum
+			next.InFailover = resp.Cluster.InFailover
+		}
+		for _, node := range resp.Nodes {
+			next.Nodes[node.NodeID] = node.ramdNodeView
+		}
+	} else {
+		next.Nodes = before.Nodes
+	}
+	cw.view = next
+	current := w.clusters[key] == cw
+	w.mu.Unlock()
+
+	if !current || ramdViewsEqual(&before, &next) {
+		return
+	}
+
+	select {
+	case w.events <- event.GenericEvent{Object: &ramv1.PostgreSQLCluster{
+		ObjectMeta: metav1.ObjectMeta{Name: key.Name, Namespace: key.Namespace},
+	}}:
+	default:
+		// The queue is this far behind only if reconciles are stuck; the
+		// cluster's fallback requeue still picks the change up
+	}
+}
+
+// ramdViewsEqual compares what the operator acts on: lag changes are ignored
+func ramdViewsEqual(a, b *ramdClusterView) bool {
+	if a.Live != b.Live || a.PrimaryNodeID != b.PrimaryNodeID ||
+		a.LeaderNodeID != b.LeaderNodeID || a.HasQuorum != b.HasQuorum ||
+		a.InFailover != b.InFailover || len(a.Nodes) != len(b.Nodes) {
+		return false
+	}
+	for id, node := range a.Nodes {
+		other, ok := b.Nodes[id]
+		if !ok || node != other {
+			return false
+		}
+	}
+	return true
+}
+
+// primary returns the node ramd reports as primary
+func (v *ramdClusterView) primary() (ramdNodeView, bool) {
+	if node, ok := v.Nodes[v.PrimaryNodeID]; ok {
+		return node, true
+	}
+	for _, node := range v.Nodes {
+		if node.IsPrimary {
+			return node, true
+		}
+	}
+	return ramdNodeView{}, false
+}
+
+// ramdPodName is the pod a node's hostname names: the first label of a
+// pod DNS name, or the address itself
+func ramdPodName(hostname string) string {
+	if net.ParseIP(hostname) != nil {
+		return hostname
+	}
+	if i := strings.IndexByte(hostname, '.'); i > 0 {
+		return hostname[:i]
+	}
+	return hostname
+}
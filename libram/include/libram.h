@@ -0,0 +1,103 @@
+/*-------------------------------------------------------------------------
+ *
+ * libram.h
+ *		Client-side endpoint discovery for PostgreSQL RAM clusters
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A ram_client_t asks ramd once for the whole cluster view and then
+ * holds a long-poll on its watch feed, so the cached primary and standby
+ * addresses are replaced the moment ramd publishes a role change rather
+ * than when a DNS TTL runs out.  ram_client_connect() is PQconnectdb()
+ * with host and port taken from that cache.  Link with -lram -lpq -lcurl
+ * -lpthread.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef LIBRAM_H
+#define LIBRAM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <libpq-fe.h>
+
+#define RAM_CLIENT_MAX_HOSTNAME_LENGTH 256
+
+typedef struct ram_client_t ram_client_t;
+
+/* A node as last reported by ramd */
+typedef struct ram_endpoint_t
+{
+	int32_t node_id;
+	char host[RAM_CLIENT_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+	bool is_primary;
+	bool is_healthy;
+	int32_t replay_lag_ms; /* -1 if unknown */
+} ram_endpoint_t;
+
+typedef enum
+{
+	RAM_TARGET_PRIMARY = 0, /* the healthy primary, outside a failover */
+	RAM_TARGET_REPLICA      /* the least-lagged healthy standby, else the primary */
+} ram_target_t;
+
+/*
+ * Called on the watch thread each time the primary moves, a failover
+ * starts or ends, or ramd restarts; generation is the new value of
+ * ram_client_generation().  Must not block, and must not call
+ * ram_client_destroy().
+ */
+typedef void (*ram_client_callback_t)(ram_client_t* client, uint64_t generation, void* arg);
+
+/*
+ * api_urls is a comma-separated list of ramd HTTP API base URLs, e.g.
+ * "http://db1:8008,http://db2:8008"; the next one is tried whenever the
+ * current one stops answering.  auth_token, if not NULL or empty, is sent
+ * as a bearer token.  Returns NULL if the list is empty or too long, or
+ * the watch thread could not be started.
+ */
+ram_client_t* ram_client_create(const char* api_urls, const char* auth_token);
+void ram_client_destroy(ram_client_t* client);
+
+void ram_client_set_callback(ram_client_t* client, ram_client_callback_t callback, void* arg);
+
+/*
+ * Wait up to timeout_ms for a healthy primary outside a failover and copy
+ * it to endpoint.  Returns at once when the cache already has one.
+ */
+bool ram_client_get_primary(ram_client_t* client, ram_endpoint_t* endpoint, int32_t timeout_ms);
+
+/*
+ * Copy up to max_count healthy standbys, least-lagged first, and return
+ * how many were written.  With max_lag_ms >= 0, standbys further behind
+ * or with unknown lag are left out.  Waits only for the first view.
+ */
+int32_t ram_client_get_replicas(ram_client_t* client, ram_endpoint_t* endpoints,
+                                int32_t max_count, int32_t max_lag_ms);
+
+/* Bumped on each change the callback is told about */
+uint64_t ram_client_generation(ram_client_t* client);
+
+/*
+ * Fetch the whole view again now, cutting the current long-poll short;
+ * the cache is served until it arrives.  For a caller that found the
+ * cached primary unusable.
+ */
+void ram_client_invalidate(ram_client_t* client);
+
+/*
+ * PQconnectdb(conninfo) with host, hostaddr and port replaced by the
+ * target from the cache.  If that connection fails, the cache is
+ * invalidated and one more attempt is made once ramd reports a change or
+ * the wait runs out.  Returns whatever libpq returned, to be checked with
+ * PQstatus(), or NULL when no target was known in time or conninfo does
+ * not parse; ram_client_error() then says why.
+ */
+PGconn* ram_client_connect(ram_client_t* client, const char* conninfo, ram_target_t target);
+
+/* Why the most recent failure on client happened; valid until this thread calls again */
+const char* ram_client_error(ram_client_t* client);
+
+#endif /* LIBRAM_H */
@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * libram_defaults.h
+ *		Central definition of the default values for libram
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef LIBRAM_DEFAULTS_H
+#define LIBRAM_DEFAULTS_H
+
+/* ramd API endpoints one client may rotate through */
+#define RAM_CLIENT_MAX_URLS              8
+#define RAM_CLIENT_MAX_URL_LENGTH        512
+#define RAM_CLIENT_MAX_NODES             64
+#define RAM_CLIENT_MAX_ERROR_LENGTH      256
+
+/* Watch long-poll; ramd holds a request at most this long */
+#define RAM_CLIENT_WATCH_WAIT_MS         25000
+#define RAM_CLIENT_WATCH_GRACE_MS        5000	/* past the wait, for ramd's empty answer */
+#define RAM_CLIENT_CONNECT_TIMEOUT_MS    2000
+#define RAM_CLIENT_RETRY_MS              1000	/* after a failed watch, before the next URL */
+#define RAM_CLIENT_RESPONSE_SIZE         65536
+#define RAM_CLIENT_JSON_MAX_TOKENS       4096
+
+/* ram_client_connect: how long to wait for a target, and after a failed attempt */
+#define RAM_CLIENT_TARGET_WAIT_MS        10000
+
+#endif /* LIBRAM_DEFAULTS_H */
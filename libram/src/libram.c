@@ -0,0 +1,705 @@
+/*-------------------------------------------------------------------------
+ *
+ * libram.c
+ *		Client-side endpoint discovery for PostgreSQL RAM clusters
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Each client runs one thread that long-polls ramd's /api/v1/watch, as
+ * "ramctrl watch" does.  The first request carries no position and gets
+ * the whole view at once; from then on ramd holds each request until
+ * something changes and answers with only what moved.  The thread folds
+ * every answer into the cache under the client's lock and, when the
+ * primary or the failover flag changed, bumps the generation, wakes
+ * callers waiting for a target and runs the callback.  A watch that
+ * fails moves on to the next ramd in the list; the cache is kept, since
+ * a ramd that went away says nothing about the database.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, strtok_r */
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include "libram.h"
+#include "libram_defaults.h"
+#include "ram_json.h"
+
+struct ram_client_t
+{
+	pthread_mutex_t lock;    /* guards everything below but the atomics */
+	pthread_cond_t changed;  /* broadcast on each applied answer and on stop */
+	pthread_t thread;
+	atomic_bool stopping;
+	atomic_bool refetch;     /* ram_client_invalidate(): abandon the long-poll */
+
+	char urls[RAM_CLIENT_MAX_URLS][RAM_CLIENT_MAX_URL_LENGTH];
+	int32_t url_count;
+	int32_t url_current;     /* watch thread's alone */
+	bool want_full;          /* watch thread's alone: next request without since */
+	char auth_header[RAM_CLIENT_MAX_URL_LENGTH];
+
+	/* The cache, as of the last answer applied */
+	bool has_view;
+	uint64_t epoch;
+	uint64_t version;
+	int32_t primary_node_id;
+	bool in_failover;
+	int32_t node_count;
+	ram_endpoint_t nodes[RAM_CLIENT_MAX_NODES];
+	uint64_t generation;
+
+	ram_client_callback_t callback;
+	void* callback_arg;
+	char error[RAM_CLIENT_MAX_ERROR_LENGTH];
+
+	/* Watch thread's alone */
+	CURL* curl;
+	char* response;
+	size_t response_length;
+	ram_json_token_t* tokens;
+};
+
+static pthread_once_t g_curl_once = PTHREAD_ONCE_INIT;
+static bool g_curl_ready = false;
+
+static void
+ram_client_curl_init(void)
+{
+	g_curl_ready = curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK;
+}
+
+/* client->lock held */
+static void
+ram_client_set_error(ram_client_t* client, const char* format, const char* detail)
+{
+	snprintf(client->error, sizeof(client->error), format, detail ? detail : "");
+}
+
+static void
+ram_client_record_error(ram_client_t* client, const char* format, const char* detail)
+{
+	pthread_mutex_lock(&client->lock);
+	ram_client_set_error(client, format, detail);
+	pthread_mutex_unlock(&client->lock);
+}
+
+static void
+ram_client_deadline(struct timespec* deadline, int32_t timeout_ms)
+{
+	clock_gettime(CLOCK_REALTIME, deadline);
+	deadline->tv_sec += timeout_ms / 1000;
+	deadline->tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if (deadline->tv_nsec >= 1000000000L)
+	{
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/* The healthy primary outside a failover, NULL if none; lock held */
+static const ram_endpoint_t*
+ram_client_find_primary(const ram_client_t* client)
+{
+	if (!client->has_view || client->in_failover)
+		return NULL;
+
+	for (int32_t i = 0; i < client->node_count; i++)
+	{
+		const ram_endpoint_t* node = &client->nodes[i];
+
+		if (node->node_id == client->primary_node_id)
+			return node->is_healthy && node->host[0] != '\0' ? node : NULL;
+	}
+	return NULL;
+}
+
+/* Body of a watch answer; a body that does not fit fails the transfer */
+static size_t
+ram_client_write(void* contents, size_t size, size_t nmemb, void* userp)
+{
+	ram_client_t* client = (ram_client_t*) userp;
+	size_t length = size * nmemb;
+
+	if (length >= RAM_CLIENT_RESPONSE_SIZE - client->response_length)
+		return 0;
+
+	memcpy(client->response + client->response_length, contents, length);
+	client->response_length += length;
+	client->response[client->response_length] = '\0';
+	return length;
+}
+
+/* Non-zero aborts the long-poll */
+static int
+ram_client_progress(void* userp, curl_off_t dltotal, curl_off_t dlnow,
+                    curl_off_t ultotal, curl_off_t ulnow)
+{
+	ram_client_t* client = (ram_client_t*) userp;
+
+	(void) dltotal;
+	(void) dlnow;
+	(void) ultotal;
+	(void) ulnow;
+
+	return atomic_load(&client->stopping) || atomic_load(&client->refetch) ? 1 : 0;
+}
+
+/* Insert or replace one node from a watch answer; lock held */
+static void
+ram_client_apply_node(ram_client_t* client, const char* json, const ram_json_token_t* tokens,
+                      int32_t object)
+{
+	static const ram_json_field_t fields[] = {
+	    RAM_JSON_FIELD(STRING, ram_endpoint_t, host, "hostname"),
+	    RAM_JSON_FIELD(INT32, ram_endpoint_t, port, "postgresql_port"),
+	    RAM_JSON_FIELD(BOOL, ram_endpoint_t, is_primary, "is_primary"),
+	    RAM_JSON_FIELD(BOOL, ram_endpoint_t, is_healthy, "is_healthy"),
+	    RAM_JSON_FIELD(INT32, ram_endpoint_t, replay_lag_ms, "replay_lag_ms"),
+	};
+	ram_endpoint_t* node = NULL;
+	int32_t node_id;
+
+	if (!ram_json_get_int32(json, tokens, ram_json_object_get(json, tokens, object, "node_id"),
+	                        &node_id))
+		return;
+
+	for (int32_t i = 0; i < client->node_count; i++)
+	{
+		if (client->nodes[i].node_id == node_id)
+		{
+			node = &client->nodes[i];
+			break;
+		}
+	}
+	if (!node)
+	{
+		if (client->node_count >= RAM_CLIENT_MAX_NODES)
+			return;
+		node = &client->nodes[client->node_count++];
+	}
+
+	memset(node, 0, sizeof(*node));
+	node->node_id = node_id;
+	node->replay_lag_ms = -1;
+	ram_json_bind(json, tokens, object, fields, sizeof(fields) / sizeof(fields[0]), node);
+}
+
+/*
+ * Fold the watch answer in client->response into the cache.  Returns
+ * false, with nothing touched, unless the whole answer parses.
+ */
+static bool
+ram_client_apply(ram_client_t* client)
+{
+	static const ram_json_field_t cluster_fields[] = {
+	    RAM_JSON_FIELD(INT32, ram_client_t, primary_node_id, "primary_node_id"),
+	    RAM_JSON_FIELD(BOOL, ram_client_t, in_failover, "in_failover"),
+	};
+	const char* json = client->response;
+	const ram_json_token_t* tokens = client->tokens;
+	ram_client_callback_t callback = NULL;
+	void* callback_arg = NULL;
+	uint64_t generation = 0;
+	uint64_t epoch;
+	uint64_t version;
+	bool full = false;
+	bool restarted;
+	int32_t old_primary;
+	char old_host[RAM_CLIENT_MAX_HOSTNAME_LENGTH] = "";
+	int32_t old_port = 0;
+	const ram_endpoint_t* primary;
+	int32_t nodes;
+
+	if (ram_json_parse(json, client->response_length, client->tokens,
+	                   RAM_CLIENT_JSON_MAX_TOKENS) <= 0 ||
+	    !ram_json_get_uint64(json, tokens, ram_json_object_get(json, tokens, 0, "epoch"), &epoch) ||
+	    !ram_json_get_uint64(json, tokens, ram_json_object_get(json, tokens, 0, "version"),
+	                         &version) ||
+	    !ram_json_get_bool(tokens, ram_json_object_get(json, tokens, 0, "full"), &full))
+		return false;
+
+	pthread_mutex_lock(&client->lock);
+
+	/* What callers were handed until now */
+	primary = ram_client_find_primary(client);
+	old_primary = primary ? primary->node_id : -1;
+	if (primary)
+	{
+		memcpy(old_host, primary->host, sizeof(old_host));
+		old_port = primary->port;
+	}
+	restarted = client->has_view && epoch != client->epoch;
+
+	if (full)
+	{
+		client->node_count = 0;
+		client->primary_node_id = -1;
+		client->in_failover = false;
+	}
+	ram_json_bind(json, tokens, ram_json_object_get(json, tokens, 0, "cluster"), cluster_fields,
+	              sizeof(cluster_fields) / sizeof(cluster_fields[0]), client);
+
+	nodes = ram_json_object_get(json, tokens, 0, "nodes");
+	for (int32_t i = ram_json_array_first(tokens, nodes); i >= 0;
+	     i = ram_json_array_next(tokens, nodes, i))
+		ram_client_apply_node(client, json, tokens, i);
+
+	client->epoch = epoch;
+	client->version = version;
+	client->has_view = true;
+
+	primary = ram_client_find_primary(client);
+	if (restarted || (primary ? primary->node_id : -1) != old_primary ||
+	    (primary && (primary->port != old_port || strcmp(primary->host, old_host) != 0)))
+	{
+		generation = ++client->generation;
+		callback = client->callback;
+		callback_arg = client->callback_arg;
+	}
+	pthread_cond_broadcast(&client->changed);
+	pthread_mutex_unlock(&client->lock);
+
+	if (generation > 0 && callback)
+		callback(client, generation, callback_arg);
+	return true;
+}
+
+/* One watch request against the current URL; true if an answer was applied */
+static bool
+ram_client_watch_once(ram_client_t* client)
+{
+	struct curl_slist* headers = NULL;
+	char url[RAM_CLIENT_MAX_URL_LENGTH * 2];
+	const char* base = client->urls[client->url_current];
+	bool has_view;
+	uint64_t epoch;
+	uint64_t version;
+	long status = 0;
+	CURLcode res;
+
+	pthread_mutex_lock(&client->lock);
+	has_view = client->has_view;
+	epoch = client->epoch;
+	version = client->version;
+	pthread_mutex_unlock(&client->lock);
+
+	if (has_view && !client->want_full)
+		snprintf(url, sizeof(url), "%s/api/v1/watch?since=%llu&epoch=%llu&wait_ms=%d", base,
+		         (unsigned long long) version, (unsigned long long) epoch,
+		         RAM_CLIENT_WATCH_WAIT_MS);
+	else
+		snprintf(url, sizeof(url), "%s/api/v1/watch", base);
+
+	client->response_length = 0;
+	client->response[0] = '\0';
+
+	curl_easy_reset(client->curl);
+	curl_easy_setopt(client->curl, CURLOPT_URL, url);
+	curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, ram_client_write);
+	curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, client);
+	curl_easy_setopt(client->curl, CURLOPT_CONNECTTIMEOUT_MS, (long) RAM_CLIENT_CONNECT_TIMEOUT_MS);
+	curl_easy_setopt(client->curl, CURLOPT_TIMEOUT_MS,
+	                 (long) (RAM_CLIENT_WATCH_WAIT_MS + RAM_CLIENT_WATCH_GRACE_MS));
+	curl_easy_setopt(client->curl, CURLOPT_XFERINFOFUNCTION, ram_client_progress);
+	curl_easy_setopt(client->curl, CURLOPT_XFERINFODATA, client);
+	curl_easy_setopt(client->curl, CURLOPT_NOPROGRESS, 0L);
+	curl_easy_setopt(client->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(client->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(client->curl, CURLOPT_USERAGENT, "libram/1.0");
+	if (client->auth_header[0] != '\0')
+	{
+		headers = curl_slist_append(NULL, client->auth_header);
+		curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
+	}
+
+	res = curl_easy_perform(client->curl);
+	curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, &status);
+	curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, NULL);
+	curl_slist_free_all(headers);
+
+	if (res != CURLE_OK)
+	{
+		if (res != CURLE_ABORTED_BY_CALLBACK)
+			ram_client_record_error(client, "watch failed: %s", curl_easy_strerror(res));
+		return false;
+	}
+	if (status != 200)
+	{
+		char detail[32];
+
+		snprintf(detail, sizeof(detail), "%ld", status);
+		ram_client_record_error(client, "watch answered HTTP %s", detail);
+		return false;
+	}
+	if (!ram_client_apply(client))
+	{
+		ram_client_record_error(client, "%s", "watch answer did not parse");
+		return false;
+	}
+	client->want_full = false;
+	return true;
+}
+
+static void*
+ram_client_thread_main(void* arg)
+{
+	ram_client_t* client = (ram_client_t*) arg;
+
+	while (!atomic_load(&client->stopping))
+	{
+		struct timespec deadline;
+
+		if (ram_client_watch_once(client))
+			continue;
+
+		/*
+		 * Asked to start over: the next request is a full one, at once.
+		 * The cache stays until it arrives, so the callback hears only of
+		 * what actually moved.
+		 */
+		if (atomic_exchange(&client->refetch, false))
+		{
+			client->want_full = true;
+			continue;
+		}
+
+		client->url_current = (client->url_current + 1) % client->url_count;
+
+		ram_client_deadline(&deadline, RAM_CLIENT_RETRY_MS);
+		pthread_mutex_lock(&client->lock);
+		if (!atomic_load(&client->stopping) && !atomic_load(&client->refetch))
+			pthread_cond_timedwait(&client->changed, &client->lock, &deadline);
+		pthread_mutex_unlock(&client->lock);
+	}
+	return NULL;
+}
+
+ram_client_t*
+ram_client_create(const char* api_urls, const char* auth_token)
+{
+	ram_client_t* client;
+	char list[RAM_CLIENT_MAX_URLS * RAM_CLIENT_MAX_URL_LENGTH];
+	char* saveptr = NULL;
+
+	if (!api_urls || strlen(api_urls) >= sizeof(list))
+		return NULL;
+
+	pthread_once(&g_curl_once, ram_client_curl_init);
+	if (!g_curl_ready)
+		return NULL;
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	memcpy(list, api_urls, strlen(api_urls) + 1);
+	for (char* url = strtok_r(list, ", ", &saveptr); url; url = strtok_r(NULL, ", ", &saveptr))
+	{
+		size_t length = strlen(url);
+
+		while (length > 0 && url[length - 1] == '/')
+			url[--length] = '\0';
+		if (length == 0)
+			continue;
+		if (client->url_count >= RAM_CLIENT_MAX_URLS || length >= RAM_CLIENT_MAX_URL_LENGTH)
+		{
+			free(client);
+			return NULL;
+		}
+		memcpy(client->urls[client->url_count++], url, length + 1);
+	}
+	if (client->url_count == 0)
+	{
+		free(client);
+		return NULL;
+	}
+
+	if (auth_token && auth_token[0] != '\0')
+		snprintf(client->auth_header, sizeof(client->auth_header), "Authorization: Bearer %s",
+		         auth_token);
+
+	client->primary_node_id = -1;
+	atomic_init(&client->stopping, false);
+	atomic_init(&client->refetch, false);
+	client->curl = curl_easy_init();
+	client->response = malloc(RAM_CLIENT_RESPONSE_SIZE);
+	client->tokens = malloc(sizeof(ram_json_token_t) * RAM_CLIENT_JSON_MAX_TOKENS);
+	if (!client->curl || !client->response || !client->tokens)
+		goto fail;
+
+	pthread_mutex_init(&client->lock, NULL);
+	pthread_cond_init(&client->changed, NULL);
+	if (pthread_create(&client->thread, NULL, ram_client_thread_main, client) != 0)
+	{
+		pthread_cond_destroy(&client->changed);
+		pthread_mutex_destroy(&client->lock);
+		goto fail;
+	}
+	return client;
+
+fail:
+	if (client->curl)
+		curl_easy_cleanup(client->curl);
+	free(client->response);
+	free(client->tokens);
+	free(client);
+	return NULL;
+}
+
+void
+ram_client_destroy(ram_client_t* client)
+{
+	if (!client)
+		return;
+
+	atomic_store(&client->stopping, true);
+	pthread_mutex_lock(&client->lock);
+	pthread_cond_broadcast(&client->changed);
+	pthread_mutex_unlock(&client->lock);
+	pthread_join(client->thread, NULL);
+
+	curl_easy_cleanup(client->curl);
+	pthread_cond_destroy(&client->changed);
+	pthread_mutex_destroy(&client->lock);
+	free(client->response);
+	free(client->tokens);
+	free(client);
+}
+
+void
+ram_client_set_callback(ram_client_t* client, ram_client_callback_t callback, void* arg)
+{
+	if (!client)
+		return;
+
+	pthread_mutex_lock(&client->lock);
+	client->callback = callback;
+	client->callback_arg = arg;
+	pthread_mutex_unlock(&client->lock);
+}
+
+bool
+ram_client_get_primary(ram_client_t* client, ram_endpoint_t* endpoint, int32_t timeout_ms)
+{
+	struct timespec deadline;
+	const ram_endpoint_t* primary;
+
+	if (!client || !endpoint)
+		return false;
+
+	ram_client_deadline(&deadline, timeout_ms > 0 ? timeout_ms : 0);
+	pthread_mutex_lock(&client->lock);
+	while ((primary = ram_client_find_primary(client)) == NULL && !atomic_load(&client->stopping))
+	{
+		if (timeout_ms <= 0 ||
+		    pthread_cond_timedwait(&client->changed, &client->lock, &deadline) != 0)
+			break;
+	}
+	if (primary)
+		*endpoint = *primary;
+	else
+		ram_client_set_error(client, "%s", client->has_view
+		                                     ? "ramd reports no healthy primary"
+		                                     : "no answer from ramd yet");
+	pthread_mutex_unlock(&client->lock);
+	return primary != NULL;
+}
+
+static int
+ram_client_compare_lag(const void* a, const void* b)
+{
+	int32_t lag_a = ((const ram_endpoint_t*) a)->replay_lag_ms;
+	int32_t lag_b = ((const ram_endpoint_t*) b)->replay_lag_ms;
+
+	/* Unknown lag sorts last */
+	if (lag_a < 0 || lag_b < 0)
+		return (lag_a < 0) - (lag_b < 0);
+	return (lag_a > lag_b) - (lag_a < lag_b);
+}
+
+int32_t
+ram_client_get_replicas(ram_client_t* client, ram_endpoint_t* endpoints, int32_t max_count,
+                        int32_t max_lag_ms)
+{
+	ram_endpoint_t found[RAM_CLIENT_MAX_NODES];
+	struct timespec deadline;
+	int32_t count = 0;
+
+	if (!client || !endpoints || max_count <= 0)
+		return 0;
+
+	ram_client_deadline(&deadline, RAM_CLIENT_TARGET_WAIT_MS);
+	pthread_mutex_lock(&client->lock);
+	while (!client->has_view && !atomic_load(&client->stopping))
+	{
+		if (pthread_cond_timedwait(&client->changed, &client->lock, &deadline) != 0)
+			break;
+	}
+	for (int32_t i = 0; i < client->node_count; i++)
+	{
+		const ram_endpoint_t* node = &client->nodes[i];
+
+		if (node->is_primary || node->node_id == client->primary_node_id ||
+		    !node->is_healthy || node->host[0] == '\0')
+			continue;
+		if (max_lag_ms >= 0 && (node->replay_lag_ms < 0 || node->replay_lag_ms > max_lag_ms))
+			continue;
+		found[count++] = *node;
+	}
+	if (count == 0)
+		ram_client_set_error(client, "%s", client->has_view ? "ramd reports no usable standby"
+		                                                    : "no answer from ramd yet");
+	pthread_mutex_unlock(&client->lock);
+
+	qsort(found, (size_t) count, sizeof(found[0]), ram_client_compare_lag);
+	if (count > max_count)
+		count = max_count;
+	memcpy(endpoints, found, sizeof(found[0]) * (size_t) count);
+	return count;
+}
+
+uint64_t
+ram_client_generation(ram_client_t* client)
+{
+	uint64_t generation;
+
+	if (!client)
+		return 0;
+
+	pthread_mutex_lock(&client->lock);
+	generation = client->generation;
+	pthread_mutex_unlock(&client->lock);
+	return generation;
+}
+
+void
+ram_client_invalidate(ram_client_t* client)
+{
+	if (!client)
+		return;
+
+	atomic_store(&client->refetch, true);
+	pthread_mutex_lock(&client->lock);
+	pthread_cond_broadcast(&client->changed);
+	pthread_mutex_unlock(&client->lock);
+}
+
+/* Wait until the generation moves past seen or timeout_ms runs out */
+static void
+ram_client_wait_change(ram_client_t* client, uint64_t seen, int32_t timeout_ms)
+{
+	struct timespec deadline;
+
+	ram_client_deadline(&deadline, timeout_ms);
+	pthread_mutex_lock(&client->lock);
+	while (client->generation == seen && !atomic_load(&client->stopping))
+	{
+		if (pthread_cond_timedwait(&client->changed, &client->lock, &deadline) != 0)
+			break;
+	}
+	pthread_mutex_unlock(&client->lock);
+}
+
+static bool
+ram_client_pick(ram_client_t* client, ram_target_t target, ram_endpoint_t* endpoint)
+{
+	if (target == RAM_TARGET_REPLICA && ram_client_get_replicas(client, endpoint, 1, -1) == 1)
+		return true;
+	return ram_client_get_primary(client, endpoint, RAM_CLIENT_TARGET_WAIT_MS);
+}
+
+/* conninfo's options with host, hostaddr and port taken from endpoint */
+static PGconn*
+ram_client_connect_to(const PQconninfoOption* options, const ram_endpoint_t* endpoint)
+{
+	const char* keywords[64];
+	const char* values[64];
+	char port[16];
+	int32_t n = 0;
+
+	for (const PQconninfoOption* o = options; o->keyword && n < 61; o++)
+	{
+		if (!o->val || strcmp(o->keyword, "host") == 0 || strcmp(o->keyword, "hostaddr") == 0 ||
+		    strcmp(o->keyword, "port") == 0)
+			continue;
+		keywords[n] = o->keyword;
+		values[n++] = o->val;
+	}
+
+	snprintf(port, sizeof(port), "%d", endpoint->port);
+	keywords[n] = "host";
+	values[n++] = endpoint->host;
+	keywords[n] = "port";
+	values[n++] = port;
+	keywords[n] = NULL;
+	values[n] = NULL;
+
+	return PQconnectdbParams(keywords, values, 0);
+}
+
+PGconn*
+ram_client_connect(ram_client_t* client, const char* conninfo, ram_target_t target)
+{
+	PQconninfoOption* options;
+	ram_endpoint_t endpoint;
+	char* parse_error = NULL;
+	PGconn* conn = NULL;
+
+	if (!client)
+		return NULL;
+
+	options = PQconninfoParse(conninfo ? conninfo : "", &parse_error);
+	if (!options)
+	{
+		ram_client_record_error(client, "invalid conninfo: %s",
+		                        parse_error ? parse_error : "out of memory");
+		PQfreemem(parse_error);
+		return NULL;
+	}
+
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		uint64_t seen = ram_client_generation(client);
+
+		if (!ram_client_pick(client, target, &endpoint))
+			break;
+
+		if (conn)
+			PQfinish(conn);
+		conn = ram_client_connect_to(options, &endpoint);
+		if (!conn || PQstatus(conn) == CONNECTION_OK || attempt > 0)
+			break;
+
+		/* The cache may be behind ramd: start over and wait for news */
+		ram_client_record_error(client, "%s", PQerrorMessage(conn));
+		ram_client_invalidate(client);
+		ram_client_wait_change(client, seen, RAM_CLIENT_TARGET_WAIT_MS);
+	}
+
+	PQconninfoFree(options);
+	return conn;
+}
+
+const char*
+ram_client_error(ram_client_t* client)
+{
+	static _Thread_local char error[RAM_CLIENT_MAX_ERROR_LENGTH];
+
+	if (!client)
+		return "no client";
+
+	pthread_mutex_lock(&client->lock);
+	memcpy(error, client->error, sizeof(error));
+	pthread_mutex_unlock(&client->lock);
+	return error;
+}
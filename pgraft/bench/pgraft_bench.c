@@ -0,0 +1,618 @@
+/*-------------------------------------------------------------------------
+ *
+ * pgraft_bench.c
+ *      Raft commit throughput and latency load generator for pgraft
+ *
+ * Opens many concurrent sessions across the nodes of a live cluster, each
+ * proposing entries through pgraft_replicate() (or pgraft_log_append())
+ * back to back, and reports commits per second with p50/p99/p99.9 commit
+ * latency.  Latencies go into per-session log-linear histograms, so a
+ * long run costs no more memory than a short one.
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "libpq-fe.h"
+
+/* Must match PGRAFT_REPLICATE_MAX_DATA in pgraft_log.h */
+#define BENCH_MAX_PAYLOAD		1023
+
+/*
+ * Latency histogram: 2^BENCH_SUB_BITS linear buckets per power of two of
+ * microseconds, about 1.5% relative error, up to 2^BENCH_MAX_POW2 us.
+ */
+#define BENCH_SUB_BITS			6
+#define BENCH_SUB_BUCKETS		(1 << BENCH_SUB_BITS)
+#define BENCH_MAX_POW2			36
+#define BENCH_BUCKETS			((BENCH_MAX_POW2 - BENCH_SUB_BITS + 1) * BENCH_SUB_BUCKETS)
+
+typedef enum
+{
+	BENCH_MODE_REPLICATE,
+	BENCH_MODE_APPEND
+} bench_mode_t;
+
+typedef struct
+{
+	uint64_t	counts[BENCH_BUCKETS];
+	uint64_t	total;
+	uint64_t	max_us;
+} bench_histogram_t;
+
+typedef struct
+{
+	int			id;
+	const char *conninfo;
+	pthread_t	thread;
+	bench_histogram_t hist;
+	uint64_t	errors;
+	char		last_error[256];
+} bench_session_t;
+
+static struct
+{
+	bench_mode_t mode;
+	int			clients;
+	double		duration;
+	double		warmup;
+	int			payload_size;
+	int			timeout_ms;
+	int			rtt_ms;
+	double		progress;
+	bool		leader_only;
+	bool		json;
+	char	  **nodes;
+	int			node_count;
+} g_opts = {
+	.mode = BENCH_MODE_REPLICATE,
+	.clients = 8,
+	.duration = 10,
+	.warmup = 2,
+	.payload_size = 128,
+	.timeout_ms = 5000,
+	.rtt_ms = -1,
+};
+
+static char *g_payload;
+static int64_t g_start_ns;
+static int64_t g_measure_ns;
+static int64_t g_end_ns;
+static atomic_uint_fast64_t g_commits;
+static atomic_int g_ready;
+
+static int64_t
+bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int
+bench_bucket(uint64_t us)
+{
+	int			pow2;
+
+	if (us < BENCH_SUB_BUCKETS)
+		return (int) us;
+
+	pow2 = 63 - __builtin_clzll(us);
+	if (pow2 > BENCH_MAX_POW2)
+		return BENCH_BUCKETS - 1;
+	return (pow2 - BENCH_SUB_BITS + 1) * BENCH_SUB_BUCKETS +
+		(int) ((us >> (pow2 - BENCH_SUB_BITS)) & (BENCH_SUB_BUCKETS - 1));
+}
+
+/* Upper bound, in microseconds, of the values counted in a bucket */
+static uint64_t
+bench_bucket_value(int bucket)
+{
+	int			group = bucket / BENCH_SUB_BUCKETS;
+	uint64_t	sub = (uint64_t) (bucket % BENCH_SUB_BUCKETS);
+	int			shift;
+
+	if (group == 0)
+		return sub;
+	shift = group - 1;
+	return ((BENCH_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static void
+bench_record(bench_histogram_t *hist, uint64_t us)
+{
+	hist->counts[bench_bucket(us)]++;
+	hist->total++;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+static uint64_t
+bench_percentile(const bench_histogram_t *hist, double fraction)
+{
+	uint64_t	rank;
+	uint64_t	seen = 0;
+
+	if (hist->total == 0)
+		return 0;
+
+	rank = (uint64_t) (fraction * (double) hist->total);
+	if (rank >= hist->total)
+		rank = hist->total - 1;
+	for (int i = 0; i < BENCH_BUCKETS; i++)
+	{
+		seen += hist->counts[i];
+		if (seen > rank)
+		{
+			uint64_t	value = bench_bucket_value(i);
+
+			return value < hist->max_us ? value : hist->max_us;
+		}
+	}
+	return hist->max_us;
+}
+
+static PGconn *
+bench_connect(const char *conninfo, char *error, size_t error_size)
+{
+	PGconn	   *conn = PQconnectdb(conninfo);
+
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		snprintf(error, error_size, "%s", PQerrorMessage(conn));
+		PQfinish(conn);
+		return NULL;
+	}
+	return conn;
+}
+
+static bool
+bench_prepare(PGconn *conn, char *error, size_t error_size)
+{
+	const char *sql = g_opts.mode == BENCH_MODE_REPLICATE ?
+		"SELECT pgraft_replicate($1::bytea, true, $2::interval)" :
+		"SELECT pgraft_log_append(pgraft_get_term(), $1::text)";
+	PGresult   *res = PQprepare(conn, "bench", sql, 0, NULL);
+	bool		ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+
+	if (!ok)
+		snprintf(error, error_size, "%s", PQresultErrorMessage(res));
+	PQclear(res);
+	return ok;
+}
+
+static void *
+bench_session_main(void *arg)
+{
+	bench_session_t *session = arg;
+	PGconn	   *conn = NULL;
+	char		timeout[32];
+	const char *values[2];
+	int			lengths[2];
+	int			formats[2];
+
+	snprintf(timeout, sizeof(timeout), "%d milliseconds", g_opts.timeout_ms);
+	values[0] = g_payload;
+	lengths[0] = g_opts.payload_size;
+	formats[0] = g_opts.mode == BENCH_MODE_REPLICATE ? 1 : 0;
+	values[1] = timeout;
+	lengths[1] = 0;
+	formats[1] = 0;
+
+	conn = bench_connect(session->conninfo, session->last_error, sizeof(session->last_error));
+	if (conn && !bench_prepare(conn, session->last_error, sizeof(session->last_error)))
+	{
+		PQfinish(conn);
+		conn = NULL;
+	}
+	atomic_fetch_add(&g_ready, 1);
+
+	while (bench_now_ns() < g_end_ns)
+	{
+		PGresult   *res;
+		int64_t		started;
+		int64_t		finished;
+
+		if (!conn)
+		{
+			/* A node restarting mid-run; retry without flooding it */
+			usleep(100 * 1000);
+			conn = bench_connect(session->conninfo, session->last_error, sizeof(session->last_error));
+			if (conn && !bench_prepare(conn, session->last_error, sizeof(session->last_error)))
+			{
+				PQfinish(conn);
+				conn = NULL;
+			}
+			if (!conn)
+			{
+				if (bench_now_ns() >= g_measure_ns)
+					session->errors++;
+				continue;
+			}
+		}
+
+		started = bench_now_ns();
+		res = PQexecPrepared(conn, "bench", g_opts.mode == BENCH_MODE_REPLICATE ? 2 : 1,
+							 values, lengths, formats, 0);
+		finished = bench_now_ns();
+
+		if (PQresultStatus(res) == PGRES_TUPLES_OK)
+		{
+			if (started >= g_measure_ns)
+			{
+				bench_record(&session->hist, (uint64_t) (finished - started) / 1000);
+				atomic_fetch_add_explicit(&g_commits, 1, memory_order_relaxed);
+			}
+		}
+		else
+		{
+			if (started >= g_measure_ns)
+				session->errors++;
+			snprintf(session->last_error, sizeof(session->last_error), "%s",
+					 PQresultErrorMessage(res));
+			if (PQstatus(conn) != CONNECTION_OK)
+			{
+				PQfinish(conn);
+				conn = NULL;
+			}
+		}
+		PQclear(res);
+	}
+
+	if (conn)
+		PQfinish(conn);
+	return NULL;
+}
+
+/* Run sql on every node; false with a message on the first failure */
+static bool
+bench_on_every_node(const char *sql)
+{
+	char		error[256];
+
+	for (int i = 0; i < g_opts.node_count; i++)
+	{
+		PGconn	   *conn = bench_connect(g_opts.nodes[i], error, sizeof(error));
+		PGresult   *res;
+		bool		ok;
+
+		if (!conn)
+		{
+			fprintf(stderr, "pgraft_bench: %s: %s", g_opts.nodes[i], error);
+			return false;
+		}
+		res = PQexec(conn, sql);
+		ok = PQresultStatus(res) == PGRES_COMMAND_OK || PQresultStatus(res) == PGRES_TUPLES_OK;
+		if (!ok)
+			fprintf(stderr, "pgraft_bench: %s: %s", g_opts.nodes[i], PQresultErrorMessage(res));
+		PQclear(res);
+		PQfinish(conn);
+		if (!ok)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Delay every Raft message by half the requested round trip on all nodes.
+ * Needs superuser; the setting reloads without a restart.
+ */
+static bool
+bench_set_rtt(int rtt_ms)
+{
+	char		sql[128];
+
+	if (rtt_ms > 0)
+		snprintf(sql, sizeof(sql), "ALTER SYSTEM SET pgraft.debug_peer_delay = %d", rtt_ms / 2);
+	else
+		snprintf(sql, sizeof(sql), "ALTER SYSTEM RESET pgraft.debug_peer_delay");
+	return bench_on_every_node(sql) && bench_on_every_node("SELECT pg_reload_conf()");
+}
+
+/* The conninfo of the node that currently leads, or NULL */
+static char *
+bench_find_leader(void)
+{
+	char		error[256];
+
+	for (int i = 0; i < g_opts.node_count; i++)
+	{
+		PGconn	   *conn = bench_connect(g_opts.nodes[i], error, sizeof(error));
+		PGresult   *res;
+		bool		leader;
+
+		if (!conn)
+			continue;
+		res = PQexec(conn, "SELECT pgraft_is_leader()");
+		leader = PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1 &&
+			strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+		PQclear(res);
+		PQfinish(conn);
+		if (leader)
+			return g_opts.nodes[i];
+	}
+	return NULL;
+}
+
+static void
+bench_report(bench_session_t *sessions, double seconds)
+{
+	bench_histogram_t total;
+	uint64_t	errors = 0;
+	const char *last_error = NULL;
+	double		rate;
+
+	memset(&total, 0, sizeof(total));
+	for (int i = 0; i < g_opts.clients; i++)
+	{
+		for (int b = 0; b < BENCH_BUCKETS; b++)
+			total.counts[b] += sessions[i].hist.counts[b];
+		total.total += sessions[i].hist.total;
+		if (sessions[i].hist.max_us > total.max_us)
+			total.max_us = sessions[i].hist.max_us;
+		errors += sessions[i].errors;
+		if (sessions[i].errors > 0)
+			last_error = sessions[i].last_error;
+	}
+	rate = seconds > 0 ? (double) total.total / seconds : 0;
+
+	if (g_opts.json)
+	{
+		printf("{\"mode\":\"%s\",\"nodes\":%d,\"clients\":%d,\"payload_bytes\":%d,"
+			   "\"rtt_ms\":%d,\"seconds\":%.3f,\"commits\":%llu,\"errors\":%llu,"
+			   "\"commits_per_sec\":%.1f,\"latency_us\":{\"p50\":%llu,\"p90\":%llu,"
+			   "\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+			   g_opts.mode == BENCH_MODE_REPLICATE ? "replicate" : "append",
+			   g_opts.leader_only ? 1 : g_opts.node_count, g_opts.clients, g_opts.payload_size,
+			   g_opts.rtt_ms > 0 ? g_opts.rtt_ms : 0, seconds,
+			   (unsigned long long) total.total, (unsigned long long) errors, rate,
+			   (unsigned long long) bench_percentile(&total, 0.50),
+			   (unsigned long long) bench_percentile(&total, 0.90),
+			   (unsigned long long) bench_percentile(&total, 0.99),
+			   (unsigned long long) bench_percentile(&total, 0.999),
+			   (unsigned long long) total.max_us);
+		return;
+	}
+
+	printf("mode: %s\n", g_opts.mode == BENCH_MODE_REPLICATE ? "pgraft_replicate" : "pgraft_log_append");
+	printf("nodes: %d, clients: %d, payload: %d bytes",
+		   g_opts.leader_only ? 1 : g_opts.node_count, g_opts.clients, g_opts.payload_size);
+	if (g_opts.rtt_ms > 0)
+		printf(", injected rtt: %d ms", g_opts.rtt_ms);
+	printf("\n");
+	printf("duration: %.1f s (after %.1f s warm-up)\n", seconds, g_opts.warmup);
+	printf("commits: %llu, errors: %llu\n", (unsigned long long) total.total,
+		   (unsigned long long) errors);
+	printf("commits/sec: %.1f\n", rate);
+	printf("latency (ms): p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+		   (double) bench_percentile(&total, 0.50) / 1000.0,
+		   (double) bench_percentile(&total, 0.90) / 1000.0,
+		   (double) bench_percentile(&total, 0.99) / 1000.0,
+		   (double) bench_percentile(&total, 0.999) / 1000.0,
+		   (double) total.max_us / 1000.0);
+	if (last_error)
+		printf("last error: %s", last_error);
+}
+
+static void
+bench_usage(const char *progname)
+{
+	printf("Usage: %s [OPTIONS] CONNINFO [CONNINFO...]\n\n", progname);
+	printf("Drive Raft proposals from concurrent sessions spread over the given nodes.\n\n");
+	printf("Options:\n");
+	printf("  -c, --clients=N         concurrent sessions (default: %d)\n", g_opts.clients);
+	printf("  -T, --time=SECONDS      measured run time (default: %.0f)\n", g_opts.duration);
+	printf("  -w, --warmup=SECONDS    unmeasured lead-in (default: %.0f)\n", g_opts.warmup);
+	printf("  -s, --size=BYTES        payload per proposal, at most %d (default: %d)\n",
+		   BENCH_MAX_PAYLOAD, g_opts.payload_size);
+	printf("  -m, --mode=MODE         replicate or append (default: replicate)\n");
+	printf("  -t, --timeout=MS        commit timeout per proposal (default: %d)\n", g_opts.timeout_ms);
+	printf("  -r, --rtt=MS            inject MS of round trip between nodes for the run\n");
+	printf("                          (sets pgraft.debug_peer_delay; needs superuser)\n");
+	printf("  -L, --leader-only       send every proposal to the current leader\n");
+	printf("  -P, --progress=SECONDS  print throughput every SECONDS\n");
+	printf("  -j, --json              print the result as one JSON object\n");
+	printf("  -h, --help              show this help\n");
+}
+
+static bool
+bench_parse_args(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"clients", required_argument, 0, 'c'},
+		{"time", required_argument, 0, 'T'},
+		{"warmup", required_argument, 0, 'w'},
+		{"size", required_argument, 0, 's'},
+		{"mode", required_argument, 0, 'm'},
+		{"timeout", required_argument, 0, 't'},
+		{"rtt", required_argument, 0, 'r'},
+		{"leader-only", no_argument, 0, 'L'},
+		{"progress", required_argument, 0, 'P'},
+		{"json", no_argument, 0, 'j'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int			opt;
+
+	while ((opt = getopt_long(argc, argv, "c:T:w:s:m:t:r:LP:jh", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'c':
+				g_opts.clients = atoi(optarg);
+				break;
+			case 'T':
+				g_opts.duration = strtod(optarg, NULL);
+				break;
+			case 'w':
+				g_opts.warmup = strtod(optarg, NULL);
+				break;
+			case 's':
+				g_opts.payload_size = atoi(optarg);
+				break;
+			case 'm':
+				if (strcmp(optarg, "replicate") == 0)
+					g_opts.mode = BENCH_MODE_REPLICATE;
+				else if (strcmp(optarg, "append") == 0)
+					g_opts.mode = BENCH_MODE_APPEND;
+				else
+				{
+					fprintf(stderr, "pgraft_bench: mode must be replicate or append\n");
+					return false;
+				}
+				break;
+			case 't':
+				g_opts.timeout_ms = atoi(optarg);
+				break;
+			case 'r':
+				g_opts.rtt_ms = atoi(optarg);
+				break;
+			case 'L':
+				g_opts.leader_only = true;
+				break;
+			case 'P':
+				g_opts.progress = strtod(optarg, NULL);
+				break;
+			case 'j':
+				g_opts.json = true;
+				break;
+			case 'h':
+				bench_usage(argv[0]);
+				exit(0);
+			default:
+				bench_usage(argv[0]);
+				return false;
+		}
+	}
+
+	if (optind >= argc)
+	{
+		fprintf(stderr, "pgraft_bench: at least one CONNINFO is required\n");
+		return false;
+	}
+	g_opts.nodes = &argv[optind];
+	g_opts.node_count = argc - optind;
+
+	if (g_opts.clients < 1 || g_opts.duration <= 0 || g_opts.warmup < 0 ||
+		g_opts.timeout_ms < 1 || g_opts.progress < 0)
+	{
+		fprintf(stderr, "pgraft_bench: --clients, --time and --timeout must be positive\n");
+		return false;
+	}
+	if (g_opts.payload_size < 1 || g_opts.payload_size > BENCH_MAX_PAYLOAD)
+	{
+		fprintf(stderr, "pgraft_bench: --size must be between 1 and %d\n", BENCH_MAX_PAYLOAD);
+		return false;
+	}
+	return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+	bench_session_t *sessions;
+	const char *leader = NULL;
+	int64_t		next_progress_ns;
+	uint64_t	last_commits = 0;
+	bool		rtt_set = false;
+	int			started = 0;
+
+	if (!bench_parse_args(argc, argv))
+		return 1;
+
+	/* Printable, so the same payload works as bytea and as text */
+	g_payload = malloc((size_t) g_opts.payload_size + 1);
+	sessions = calloc((size_t) g_opts.clients, sizeof(bench_session_t));
+	if (!g_payload || !sessions)
+	{
+		fprintf(stderr, "pgraft_bench: out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < g_opts.payload_size; i++)
+		g_payload[i] = (char) ('a' + i % 26);
+	g_payload[g_opts.payload_size] = '\0';
+
+	if (g_opts.rtt_ms >= 0)
+	{
+		if (!bench_set_rtt(g_opts.rtt_ms))
+			return 1;
+		rtt_set = g_opts.rtt_ms > 0;
+	}
+
+	if (g_opts.leader_only && !(leader = bench_find_leader()))
+	{
+		fprintf(stderr, "pgraft_bench: no node reports itself as leader\n");
+		if (rtt_set)
+			bench_set_rtt(0);
+		return 1;
+	}
+
+	g_start_ns = bench_now_ns();
+	/* Sessions start connecting now; the clock is reset once all are in */
+	g_end_ns = INT64_MAX;
+	g_measure_ns = INT64_MAX;
+
+	for (int i = 0; i < g_opts.clients; i++)
+	{
+		sessions[i].id = i;
+		sessions[i].conninfo = leader ? leader : g_opts.nodes[i % g_opts.node_count];
+		if (pthread_create(&sessions[i].thread, NULL, bench_session_main, &sessions[i]) != 0)
+		{
+			fprintf(stderr, "pgraft_bench: cannot start session %d: %s\n", i, strerror(errno));
+			break;
+		}
+		started++;
+	}
+
+	while (atomic_load(&g_ready) < started)
+		usleep(1000);
+
+	g_start_ns = bench_now_ns();
+	g_measure_ns = g_start_ns + (int64_t) (g_opts.warmup * 1e9);
+	g_end_ns = g_measure_ns + (int64_t) (g_opts.duration * 1e9);
+	atomic_thread_fence(memory_order_seq_cst);
+
+	next_progress_ns = g_measure_ns + (int64_t) (g_opts.progress * 1e9);
+	while (g_opts.progress > 0 && bench_now_ns() < g_end_ns)
+	{
+		int64_t		now = bench_now_ns();
+
+		if (now >= next_progress_ns)
+		{
+			uint64_t	commits = atomic_load(&g_commits);
+
+			fprintf(stderr, "progress: %.1f s, %.1f commits/sec\n",
+					(double) (now - g_measure_ns) / 1e9,
+					(double) (commits - last_commits) / g_opts.progress);
+			last_commits = commits;
+			next_progress_ns += (int64_t) (g_opts.progress * 1e9);
+		}
+		usleep(10 * 1000);
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(sessions[i].thread, NULL);
+
+	if (rtt_set)
+		bench_set_rtt(0);
+
+	g_opts.clients = started;
+	bench_report(sessions, g_opts.duration);
+	free(sessions);
+	free(g_payload);
+	return 0;
+}
@@ -4,6 +4,9 @@
 #include "postgres.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
+#include "storage/latch.h"
+
+#include "pgraft_go.h"
 
 /* Worker status enum */
 typedef enum
@@ -24,7 +27,16 @@ typedef enum
 	COMMAND_LOG_APPEND = 4,
 	COMMAND_LOG_COMMIT = 5,
 	COMMAND_LOG_APPLY = 6,
-	COMMAND_SHUTDOWN = 7
+	COMMAND_SHUTDOWN = 7,
+	COMMAND_REPLICATE = 8,		/* Propose log_data through Raft */
+	COMMAND_READ_INDEX = 9,		/* ReadIndex for a read barrier */
+	COMMAND_TRANSFER_LEADERSHIP = 10,	/* Hand leadership to node_id */
+	COMMAND_ADD_LEARNER = 11,	/* ADD_NODE as a non-voting learner */
+	COMMAND_CPU_PROFILE = 12,	/* Go CPU profile of node_id seconds into address */
+	COMMAND_CHANGE_PEERS = 13,	/* Membership changes packed in log_data */
+	COMMAND_LOG_ENTRIES = 14,	/* Page of the Raft log into the file at address */
+	COMMAND_KV_WRITE = 15,		/* Key-value write encoded in log_data */
+	COMMAND_KV_READ = 16		/* Key-value read or watch into the file at address */
 }			COMMAND_TYPE;
 
 /* Command status enum */
@@ -36,9 +48,13 @@ typedef enum
 	COMMAND_STATUS_FAILED = 3
 }			COMMAND_STATUS;
 
-/* Command structure with status tracking */
+/*
+ * Decoded command, as handed to the worker and to status readers.  This is
+ * a process-local copy; shared memory only holds the compact slots below.
+ */
 typedef struct
 {
+	uint64		id;					/* Assigned at enqueue, never 0 */
 	COMMAND_TYPE type;
 	int			node_id;
 	char		address[256];
@@ -46,7 +62,9 @@ typedef struct
 	char		cluster_id[256];
 	/* Log operation fields */
 	char		log_data[1024];		/* For log append/commit data */
+	int			log_data_len;		/* Bytes in log_data; may hold NULs */
 	int			log_index;			/* For log operations */
+	uint64		proposal_id;		/* For COMMAND_REPLICATE and READ_INDEX */
 	/* Status tracking */
 	COMMAND_STATUS status;
 	char		error_message[512]; /* Error message if failed */
@@ -55,6 +73,33 @@ typedef struct
 
 /* Command queue configuration */
 #define MAX_COMMANDS 100
+#define PGRAFT_DEQUEUE_BATCH 16		/* Commands the worker takes at once */
+#define PGRAFT_COMMAND_ARENA_SIZE (64 * 1024)
+#define PGRAFT_COMMAND_ERROR_LEN 128
+
+/*
+ * Shared command slot.  Command id N lives in slots[N % MAX_COMMANDS] from
+ * enqueue until it is evicted, so the queue and the status history are the
+ * same array.  Strings live back to back, NUL terminated, in the payload
+ * arena; payload_alloc also counts any padding skipped at the arena end.
+ */
+typedef struct
+{
+	uint64		id;
+	COMMAND_TYPE type;
+	COMMAND_STATUS status;
+	int32		node_id;
+	int32		port;
+	int32		log_index;
+	uint64		proposal_id;
+	int64_t		timestamp;
+	uint32		payload_offset;
+	uint32		payload_alloc;
+	uint16		address_len;
+	uint16		cluster_id_len;
+	uint32		log_data_len;
+	char		error_message[PGRAFT_COMMAND_ERROR_LEN];
+}			pgraft_command_slot_t;
 
 /* Background worker state structure */
 typedef struct
@@ -64,17 +109,35 @@ typedef struct
 	int			port;
 	WORKER_STATUS status;
 
-	/* Fixed-size circular buffer for commands */
-	pgraft_command_t commands[MAX_COMMANDS];
-	int			command_head;		/* Index of next command to process */
-	int			command_tail;		/* Index of next slot to write */
-	int			command_count;		/* Number of commands in queue */
-
-	/* Fixed-size circular buffer for command status */
-	pgraft_command_t status_commands[MAX_COMMANDS];
-	int			status_head;		/* Index of next status to read */
-	int			status_tail;		/* Index of next slot to write */
-	int			status_count;		/* Number of status entries */
+	/* Latch of the running worker; enqueuers set it to wake the worker */
+	Latch	   *latch;
+
+	/* Protects the command queue and the worker latch pointer */
+	slock_t		mutex;
+
+	/*
+	 * Commands [oldest_id, next_id) hold slots; [next_dequeue_id, next_id)
+	 * are still pending.  Finished commands are evicted oldest first, and
+	 * only when a new command needs the slot or arena space.
+	 */
+	pgraft_command_slot_t slots[MAX_COMMANDS];
+	uint64		next_id;
+	uint64		next_dequeue_id;
+	uint64		oldest_id;
+
+	/* FIFO byte ring holding each slot's strings */
+	uint32		arena_head;			/* Start of the oldest slot's payload */
+	uint32		arena_used;
+	char		arena[PGRAFT_COMMAND_ARENA_SIZE];
+
+	/*
+	 * Proposals and read barriers bypass the queue through ring once the
+	 * worker has handed it to Go; ring_mutex serializes the backends
+	 * appending to it.
+	 */
+	slock_t		ring_mutex;
+	bool		ring_attached;
+	pgraft_go_ring_t ring;
 }			pgraft_worker_state_t;
 
 /* Core consensus types */
@@ -94,7 +157,7 @@ typedef struct pgraft_cluster
 	int64_t		leader_id;
 	char		state[32];		/* "leader", "follower", "candidate" */
 	int32_t		num_nodes;
-	pgraft_node_t nodes[16];
+	pgraft_node_t nodes[PGRAFT_MAX_NODES];
 	
 	/* Performance metrics */
 	int64_t		messages_processed;
@@ -131,13 +194,25 @@ pgraft_worker_state_t *pgraft_worker_get_state(void);
 /* Command queue functions */
 bool		pgraft_queue_command(COMMAND_TYPE type, int node_id, const char *address, int port, const char *cluster_id);
 bool		pgraft_queue_log_command(COMMAND_TYPE type, const char *log_data, int log_index);
+bool		pgraft_queue_proposal_command(COMMAND_TYPE type, const char *data, int data_len,
+										  uint64 proposal_id);
+bool		pgraft_queue_peer_changes(const pgraft_go_peer_change_t *changes, int count,
+									  uint64 proposal_id);
+int			pgraft_decode_peer_changes(const pgraft_command_t *cmd,
+									   pgraft_go_peer_change_t *changes, int max_changes);
+bool		pgraft_queue_log_entries(uint64 from_index, int limit, int64 max_bytes,
+									 const char *path, uint64 proposal_id);
+bool		pgraft_queue_kv_read(int mode, const char *key, int key_len, int64 after,
+								 int limit, int timeout_ms, const char *path,
+								 uint64 proposal_id);
+int			pgraft_dequeue_commands(pgraft_command_t *buf, int max_commands);
 bool		pgraft_dequeue_command(pgraft_command_t *cmd);
 bool		pgraft_queue_is_empty(void);
 
-/* Command status functions */
-bool		pgraft_add_command_to_status(pgraft_command_t *cmd);
-bool		pgraft_get_command_status(int64_t timestamp, pgraft_command_t *status_cmd);
-bool		pgraft_update_command_status(int64_t timestamp, COMMAND_STATUS status, const char *error_message);
+/* Command status functions, keyed by pgraft_command_t.id */
+bool		pgraft_get_command_status(uint64 id, pgraft_command_t *status_cmd);
+bool		pgraft_update_command_status(uint64 id, COMMAND_STATUS status, const char *error_message);
+int			pgraft_get_command_history(pgraft_command_t *buf, int max_commands);
 bool		pgraft_remove_completed_commands(void);
 
 #endif
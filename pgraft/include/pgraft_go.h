@@ -3,12 +3,242 @@
 
 #include "postgres.h"
 
+/* Members pgraft keeps in shared memory, voters and learners together */
+#define PGRAFT_MAX_NODES 64
+
+/*
+ * Raft status filled by pgraft_go_get_status() from a single Status() call.
+ * raft_state follows raft.StateType (0 follower, 1 candidate, 2 leader,
+ * 3 pre-candidate) and progress_state tracker.StateType (0 probe,
+ * 1 replicate, 2 snapshot).  The layout is repeated in the cgo preamble of
+ * pgraft_go.go and must stay identical.
+ */
+#define PGRAFT_GO_MAX_PROGRESS PGRAFT_MAX_NODES
+
+typedef struct pgraft_go_status
+{
+	int64_t		leader_id;
+	int64_t		term;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int64_t		last_index;
+	int32_t		raft_state;
+	int32_t		num_progress;	/* peers tracked by the leader, 0 elsewhere */
+	int64_t		progress_node_id[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		progress_match[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		progress_next[PGRAFT_GO_MAX_PROGRESS];
+	int32_t		progress_state[PGRAFT_GO_MAX_PROGRESS];
+	int32_t		num_learners;	/* non-voting members in the applied config */
+	int64_t		learner_id[PGRAFT_GO_MAX_PROGRESS];
+}			pgraft_go_status_t;
+
+/*
+ * Seqlock-protected Raft status in shared memory.  The Go library writes
+ * it after every Ready: seq is bumped to an odd value, the fields are
+ * stored, and seq is bumped again.  Readers retry until they see the same
+ * even seq on both sides of their copy, so backends never take a lock or
+ * call into Go.  seq stays 0 until the first publish.  The layout is
+ * repeated in the cgo preamble of pgraft_go.go.
+ */
+typedef struct pgraft_go_raft_status
+{
+	uint64_t	seq;
+	int64_t		leader_id;		/* -1 once the node has stopped */
+	int64_t		term;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int32_t		raft_state;		/* as in pgraft_go_status_t */
+	int32_t		is_leader;
+}			pgraft_go_raft_status_t;
+
+/*
+ * Commit results for pgraft_replicate() proposals.  Proposal id N reports
+ * in slot N % PGRAFT_GO_MAX_PROPOSALS: the Go Ready loop stores the
+ * committed index, then the id, so a waiter that sees its own id in
+ * committed_id can read the index.  A negative index means the proposal
+ * was rejected.  The layout is repeated in the cgo preamble of pgraft_go.go.
+ */
+#define PGRAFT_GO_MAX_PROPOSALS 64
+
+typedef struct pgraft_go_proposal_block
+{
+	uint64_t	committed_id[PGRAFT_GO_MAX_PROPOSALS];
+	int64_t		committed_index[PGRAFT_GO_MAX_PROPOSALS];
+}			pgraft_go_proposal_block_t;
+
+/*
+ * Proposals handed from backends straight to the Go runtime.  Backends
+ * append records under a spinlock of their own and advance head; Go, the
+ * only consumer, reads up to head and advances tail.  head and tail count
+ * bytes since the ring was created and are reduced modulo the size only
+ * to address data.  Each record is a pgraft_go_ring_record_t followed by
+ * its data, padded to PGRAFT_GO_RING_ALIGN; a record that would run past
+ * the end is preceded by a PGRAFT_GO_RING_WRAP record filling the rest.
+ * The worker writes to Go's doorbell pipe whenever it finds head past
+ * tail, so a burst of proposals costs one wakeup instead of a cgo call
+ * and a command slot each.  The layout is repeated in the cgo preamble of
+ * pgraft_go.go.
+ */
+#define PGRAFT_GO_RING_SIZE			(128 * 1024)
+#define PGRAFT_GO_RING_ALIGN		16
+
+#define PGRAFT_GO_RING_WRAP			0
+#define PGRAFT_GO_RING_PROPOSE		1	/* pgraft_go_propose() */
+#define PGRAFT_GO_RING_KV_WRITE		2	/* pgraft_go_kv_propose() */
+#define PGRAFT_GO_RING_READ_INDEX	3	/* pgraft_go_read_index(), no data */
+
+typedef struct pgraft_go_ring_record
+{
+	uint32_t	kind;
+	uint32_t	length;			/* of the data after the record */
+	uint64_t	proposal_id;
+}			pgraft_go_ring_record_t;
+
+typedef struct pgraft_go_ring
+{
+	uint64_t	head;			/* written by backends */
+	uint64_t	tail;			/* written by Go */
+	char		data[PGRAFT_GO_RING_SIZE];
+}			pgraft_go_ring_t;
+
+/*
+ * Raft internals published by the Go library once a second into
+ * $PGDATA/pgraft/metrics, a file the background worker maps shared so
+ * that ramd on the same host can map it too and read it without SQL.
+ * Writes follow the same seqlock protocol as pgraft_go_raft_status_t.
+ *
+ * Histograms hold per-bucket (non-cumulative) counts, the last bucket
+ * being +Inf.  Latency bucket i counts samples up to 16 << i
+ * microseconds; batch bucket i counts Readys of up to 1 << i entries.
+ * Messages are counted by raftpb.MessageType.  Peer match and next
+ * indexes are -1 except on the leader, and RTTs are -1 until measured.
+ * Compression counters cover compressed frames and snapshot chunks, wire
+ * bytes including their headers; skipped ones went out raw.
+ * The layout is repeated in the cgo preamble of pgraft_go.go and in
+ * ramd_pgraft.h; bump PGRAFT_GO_METRICS_VERSION when it changes.
+ */
+#define PGRAFT_GO_METRICS_MAGIC		0x50475246	/* "PGRF" */
+#define PGRAFT_GO_METRICS_VERSION	2
+#define PGRAFT_GO_METRICS_MSG_TYPES	32
+#define PGRAFT_GO_METRICS_BUCKETS	16
+#define PGRAFT_GO_METRICS_FILE		"metrics"
+#define PGRAFT_GO_CPU_PROFILE_FILE	"cpu.pprof"
+
+typedef struct pgraft_go_metrics
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	seq;
+	int64_t		node_id;
+	int64_t		updated_at_ns;	/* Unix time of the last publish */
+	int64_t		raft_state;		/* as in pgraft_go_status_t */
+	int64_t		last_index;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int64_t		msg_sent[PGRAFT_GO_METRICS_MSG_TYPES];
+	int64_t		msg_received[PGRAFT_GO_METRICS_MSG_TYPES];
+	int64_t		ready_count;
+	int64_t		ready_entries_sum;
+	int64_t		ready_messages_sum;
+	int64_t		ready_committed_sum;
+	int64_t		ready_entries[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		append_latency_sum_us;
+	int64_t		append_latency[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		fsync_latency_sum_us;
+	int64_t		fsync_latency[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		proposal_queue_depth;
+	int64_t		proposal_queue_capacity;
+	int64_t		num_peers;
+	int64_t		peer_id[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_match[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_next[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_state[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_heartbeat_rtt_us[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_append_rtt_us[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		compress_frames;
+	int64_t		compress_skipped;	/* did not shrink enough, sent raw */
+	int64_t		compress_raw_bytes;
+	int64_t		compress_wire_bytes;
+	int64_t		compress_cpu_us;
+	int64_t		decompress_frames;
+	int64_t		decompress_raw_bytes;
+	int64_t		decompress_wire_bytes;
+	int64_t		decompress_cpu_us;
+}			pgraft_go_metrics_t;
+
+/*
+ * One membership change for pgraft_go_change_peers().  The changes of a
+ * call go into a single ConfChangeV2: with more than one, Raft passes
+ * through a joint configuration and leaves it on its own.  The layout is
+ * repeated in the cgo preamble of pgraft_go.go.
+ */
+#define PGRAFT_GO_PEER_ADD_VOTER	1
+#define PGRAFT_GO_PEER_ADD_LEARNER	2
+#define PGRAFT_GO_PEER_REMOVE		3
+
+typedef struct pgraft_go_peer_change
+{
+	int32_t		type;			/* PGRAFT_GO_PEER_* */
+	int32_t		node_id;
+	int32_t		port;
+	char		address[256];
+}			pgraft_go_peer_change_t;
+
+/*
+ * A page of Raft log entries written by pgraft_go_dump_log_entries() for
+ * pgraft_log_entries(), one record per entry, big-endian:
+ * index(8) | term(8) | type(1) | committed(1) | length(4) | data
+ */
+#define PGRAFT_GO_LOG_ENTRIES_FILE	"log_entries"
+#define PGRAFT_GO_LOG_RECORD_HEADER	22
+#define PGRAFT_GO_LOG_ENTRY_NORMAL	0	/* raftpb.EntryType values */
+#define PGRAFT_GO_LOG_ENTRY_CONF_CHANGE 1
+#define PGRAFT_GO_LOG_ENTRY_CONF_CHANGE_V2 2
+
+/*
+ * Replicated key-value store.  A write for pgraft_go_kv_propose() is,
+ * big-endian: op(1) | pad(1) | key length(2) | value length(4) |
+ * compare(8) | lease(8) | key | value.  compare is the modification
+ * revision a key must have, 0 for absent or PGRAFT_GO_KV_NO_COMPARE; a
+ * grant carries its TTL in milliseconds there.  The waiter gets the
+ * revision of a key write, the lease id of a lease operation, or
+ * PGRAFT_GO_KV_FAILED if a compare or lease check failed (or nothing
+ * matched a delete); -1 if Raft rejected the write.
+ */
+#define PGRAFT_GO_KV_PUT			1
+#define PGRAFT_GO_KV_DELETE			2
+#define PGRAFT_GO_KV_DELETE_PREFIX	3
+#define PGRAFT_GO_KV_LEASE_GRANT	4
+#define PGRAFT_GO_KV_LEASE_KEEPALIVE 5
+#define PGRAFT_GO_KV_LEASE_REVOKE	6
+#define PGRAFT_GO_KV_OP_HEADER		24
+#define PGRAFT_GO_KV_NO_COMPARE		(-1)
+#define PGRAFT_GO_KV_FAILED			(-2)
+#define PGRAFT_GO_KV_COMPACTED		(-3)
+
+/*
+ * Reads written by pgraft_go_kv_read(): revision(8) | compacted
+ * revision(8), then one record per key or change: event(1) | create
+ * revision(8) | modification revision(8) | version(8) | lease(8) | key
+ * length(4) | value length(4) | key | value.  A change's modification
+ * revision is the revision it happened at.
+ */
+#define PGRAFT_GO_KV_READ_GET		1
+#define PGRAFT_GO_KV_READ_PREFIX	2
+#define PGRAFT_GO_KV_READ_WATCH		3
+#define PGRAFT_GO_KV_FILE			"kv"
+#define PGRAFT_GO_KV_FILE_HEADER	16
+#define PGRAFT_GO_KV_RECORD_HEADER	41
+#define PGRAFT_GO_KV_EVENT_VALUE	0
+#define PGRAFT_GO_KV_EVENT_PUT		1
+#define PGRAFT_GO_KV_EVENT_DELETE	2
+
 /* Go library function types */
 typedef int (*pgraft_go_init_func) (int node_id, char *address, int port);
 typedef int (*pgraft_go_start_func) (void);
 typedef int (*pgraft_go_stop_func) (void);
-typedef int (*pgraft_go_add_peer_func) (int node_id, char *address, int port);
-typedef int (*pgraft_go_remove_peer_func) (int node_id);
+typedef int (*pgraft_go_change_peers_func) (uint64_t proposal_id,
+											pgraft_go_peer_change_t *changes, int count);
 typedef int64_t (*pgraft_go_get_leader_func) (void);
 typedef int32_t (*pgraft_go_get_term_func) (void);
 typedef int (*pgraft_go_is_leader_func) (void);
@@ -19,6 +249,30 @@ typedef void (*pgraft_go_set_debug_func) (int enabled);
 typedef int (*pgraft_go_start_network_server_func) (int port);
 typedef void (*pgraft_go_free_string_func) (char *str);
 typedef int (*pgraft_go_update_cluster_state_func) (int64_t leader_id, int64_t current_term, const char *state);
+typedef int (*pgraft_go_set_data_dir_func) (char *dir);
+typedef void (*pgraft_go_set_log_level_func) (int level);
+typedef void (*pgraft_go_set_snapshot_policy_func) (int entries, int max_log_kb, int catchup);
+typedef int (*pgraft_go_get_status_func) (pgraft_go_status_t *status);
+typedef void (*pgraft_go_set_status_block_func) (pgraft_go_raft_status_t *block);
+typedef void (*pgraft_go_set_proposal_block_func) (pgraft_go_proposal_block_t *block, int notify_fd);
+typedef int (*pgraft_go_propose_func) (uint64_t proposal_id, char *data, int length);
+typedef void (*pgraft_go_set_proposal_ring_func) (pgraft_go_ring_t *ring, int doorbell_fd);
+typedef void (*pgraft_go_set_batch_policy_func) (int delay_us, int max_kb);
+typedef void (*pgraft_go_set_read_mode_func) (int lease_based);
+typedef int (*pgraft_go_read_index_func) (uint64_t proposal_id);
+typedef void (*pgraft_go_set_timing_func) (int heartbeat_ms, int election_ms, int adaptive);
+typedef void (*pgraft_go_set_election_policy_func) (int pre_vote, int check_quorum);
+typedef int (*pgraft_go_transfer_leadership_func) (int target_node_id);
+typedef void (*pgraft_go_set_peer_delay_func) (int delay_ms);
+typedef int (*pgraft_go_set_tls_func) (char *cert_file, char *key_file, char *ca_file);
+typedef void (*pgraft_go_set_compression_func) (int enabled, int threshold_kb);
+typedef int (*pgraft_go_kv_propose_func) (uint64_t proposal_id, char *op, int length);
+typedef int (*pgraft_go_kv_read_func) (uint64_t proposal_id, int mode, char *key, int key_len,
+									   int64_t after, int limit, int timeout_ms, char *path);
+typedef void (*pgraft_go_set_metrics_block_func) (pgraft_go_metrics_t *block);
+typedef int (*pgraft_go_cpu_profile_func) (char *path, int seconds);
+typedef int (*pgraft_go_dump_log_entries_func) (uint64_t proposal_id, uint64_t from_index,
+												int limit, int64_t max_bytes, char *path);
 
 /* Go library interface functions */
 int			pgraft_go_load_library(void);
@@ -32,8 +286,7 @@ int			pgraft_go_start_network_server(int port);
 pgraft_go_init_func pgraft_go_get_init_func(void);
 pgraft_go_start_func pgraft_go_get_start_func(void);
 pgraft_go_stop_func pgraft_go_get_stop_func(void);
-pgraft_go_add_peer_func pgraft_go_get_add_peer_func(void);
-pgraft_go_remove_peer_func pgraft_go_get_remove_peer_func(void);
+pgraft_go_change_peers_func pgraft_go_get_change_peers_func(void);
 pgraft_go_get_leader_func pgraft_go_get_get_leader_func(void);
 pgraft_go_get_term_func pgraft_go_get_get_term_func(void);
 pgraft_go_is_leader_func pgraft_go_get_is_leader_func(void);
@@ -44,5 +297,27 @@ pgraft_go_set_debug_func pgraft_go_get_set_debug_func(void);
 pgraft_go_start_network_server_func pgraft_go_get_start_network_server_func(void);
 pgraft_go_free_string_func pgraft_go_get_free_string_func(void);
 pgraft_go_update_cluster_state_func pgraft_go_get_update_cluster_state_func(void);
+pgraft_go_set_data_dir_func pgraft_go_get_set_data_dir_func(void);
+pgraft_go_set_log_level_func pgraft_go_get_set_log_level_func(void);
+pgraft_go_set_snapshot_policy_func pgraft_go_get_set_snapshot_policy_func(void);
+pgraft_go_get_status_func pgraft_go_get_get_status_func(void);
+pgraft_go_set_status_block_func pgraft_go_get_set_status_block_func(void);
+pgraft_go_set_proposal_block_func pgraft_go_get_set_proposal_block_func(void);
+pgraft_go_set_proposal_ring_func pgraft_go_get_set_proposal_ring_func(void);
+pgraft_go_propose_func pgraft_go_get_propose_func(void);
+pgraft_go_set_batch_policy_func pgraft_go_get_set_batch_policy_func(void);
+pgraft_go_set_read_mode_func pgraft_go_get_set_read_mode_func(void);
+pgraft_go_read_index_func pgraft_go_get_read_index_func(void);
+pgraft_go_set_timing_func pgraft_go_get_set_timing_func(void);
+pgraft_go_set_election_policy_func pgraft_go_get_set_election_policy_func(void);
+pgraft_go_transfer_leadership_func pgraft_go_get_transfer_leadership_func(void);
+pgraft_go_set_peer_delay_func pgraft_go_get_set_peer_delay_func(void);
+pgraft_go_set_tls_func pgraft_go_get_set_tls_func(void);
+pgraft_go_set_compression_func pgraft_go_get_set_compression_func(void);
+pgraft_go_kv_propose_func pgraft_go_get_kv_propose_func(void);
+pgraft_go_kv_read_func pgraft_go_get_kv_read_func(void);
+pgraft_go_set_metrics_block_func pgraft_go_get_set_metrics_block_func(void);
+pgraft_go_cpu_profile_func pgraft_go_get_cpu_profile_func(void);
+pgraft_go_dump_log_entries_func pgraft_go_get_dump_log_entries_func(void);
 
 #endif
@@ -10,6 +10,9 @@ extern char	   *pgraft_address;
 extern int		pgraft_log_level;
 extern int		pgraft_heartbeat_interval;
 extern int		pgraft_election_timeout;
+extern bool pgraft_adaptive_timing;
+extern bool pgraft_pre_vote;
+extern bool pgraft_check_quorum;
 extern bool		pgraft_worker_enabled;
 extern int		pgraft_worker_interval;
 extern char	   *pgraft_cluster_name;
@@ -21,6 +24,33 @@ extern char	   *pgraft_node_ip;
 extern bool		pgraft_is_primary;
 extern int		pgraft_health_period_ms;
 extern bool		pgraft_health_verbose;
+extern int		pgraft_log_buffer_size;
+extern int		pgraft_log_max_entries;
+extern int		pgraft_snapshot_threshold;
+extern int		pgraft_snapshot_max_log_size;
+extern int		pgraft_snapshot_catchup_entries;
+extern int		pgraft_proposal_batch_delay;
+extern int		pgraft_proposal_batch_size;
+
+/* Read barrier GUCs */
+extern bool pgraft_lease_read;
+extern bool		pgraft_metrics_enabled;
+extern bool		pgraft_trace_enabled;
+extern int		pgraft_debug_peer_delay;
+
+/* Peer TLS GUCs */
+extern char	   *pgraft_ssl_cert_file;
+extern char	   *pgraft_ssl_key_file;
+extern char	   *pgraft_ssl_ca_file;
+
+/* Peer compression GUCs */
+extern bool		pgraft_peer_compression;
+extern int		pgraft_peer_compression_threshold;
+
+/* WAL archive module GUCs */
+extern char	   *pgraft_archive_spool_dir;
+extern int		pgraft_archive_queue_depth;
+extern int		pgraft_archive_timeout;
 
 /* GUC functions */
 void		pgraft_guc_init(void);
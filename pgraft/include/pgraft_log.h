@@ -4,40 +4,89 @@
 #include "postgres.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
+#include "storage/condition_variable.h"
 
-/* Log entry structure */
+#include "pgraft_go.h"
+
+/*
+ * Log entry descriptor.
+ *
+ * Payloads are not stored inline; data_pos is the logical byte position of
+ * the payload inside the shared log arena (see pgraft_log_state_t).
+ */
 typedef struct pgraft_log_entry
 {
 	int64_t		index;			/* Log index */
 	int64_t		term;			/* Term when entry was created */
 	int64_t		timestamp;		/* Timestamp when entry was created */
-	char		data[1024];		/* Log entry data */
+	uint64		data_pos;		/* Logical arena position of payload */
 	int32_t		data_size;		/* Size of data */
 	int32_t		committed;		/* 1 if committed, 0 if not */
 	int32_t		applied;		/* 1 if applied, 0 if not */
 }			pgraft_log_entry_t;
 
-/* Log replication state */
+/*
+ * Log replication state
+ *
+ * The fixed-size header is followed in shared memory by a ring of
+ * max_entries descriptors and then by a payload arena of arena_size bytes.
+ * Both are addressed through PGRAFT_LOG_ENTRIES() and PGRAFT_LOG_ARENA().
+ * Entries are kept in index order: the descriptor for first_index lives in
+ * slot head, and payload bytes are allocated contiguously (modulo wrap) from
+ * arena_tail.  Entries at or below last_applied are reclaimed from the head
+ * whenever an append needs room, so space is recycled as apply progresses.
+ */
 typedef struct pgraft_log_state
 {
-	/* Log entries array */
-	pgraft_log_entry_t entries[1000];	/* Support up to 1000 log entries */
 	int32_t		log_size;		/* Current number of log entries */
+	int64_t		first_index;	/* Index of the oldest retained entry */
 	int64_t		last_index;		/* Last log index */
 	int64_t		commit_index;	/* Last committed index */
 	int64_t		last_applied;	/* Last applied index */
-	
+
+	/* Ring geometry, fixed at shared memory creation */
+	int32_t		max_entries;	/* Capacity of the descriptor ring */
+	int32_t		head;			/* Ring slot holding first_index */
+	uint64		arena_size;		/* Payload arena size in bytes */
+	uint64		arena_head;		/* Logical position of oldest payload byte */
+	uint64		arena_tail;		/* Logical position of next free byte */
+
 	/* Replication metrics */
 	int64_t		entries_replicated;	/* Number of entries replicated */
 	int64_t		entries_committed;	/* Number of entries committed */
 	int64_t		entries_applied;	/* Number of entries applied */
+	int64_t		entries_reclaimed;	/* Number of entries reclaimed */
 	int64_t		replication_errors;	/* Number of replication errors */
-	
+
 	/* Mutex for thread safety */
 	slock_t		mutex;
 }			pgraft_log_state_t;
 
+#define PGRAFT_LOG_ENTRIES(state) \
+	((pgraft_log_entry_t *) ((char *) (state) + MAXALIGN(sizeof(pgraft_log_state_t))))
+#define PGRAFT_LOG_ARENA(state) \
+	((char *) PGRAFT_LOG_ENTRIES(state) + \
+	 MAXALIGN(sizeof(pgraft_log_entry_t) * (Size) (state)->max_entries))
+
+/*
+ * Proposals waiting for Raft commit (pgraft_replicate).  Backends claim a
+ * slot of block; the Go Ready loop reports commits into it and pokes the
+ * worker through a pipe, and the worker broadcasts cv to wake waiters.
+ */
+typedef struct pgraft_proposal_state
+{
+	slock_t		mutex;			/* Protects next_id and in_use */
+	uint64		next_id;
+	bool		in_use[PGRAFT_GO_MAX_PROPOSALS];
+	ConditionVariable cv;
+	pgraft_go_proposal_block_t block;	/* Written by Go, read by waiters */
+}			pgraft_proposal_state_t;
+
+/* Largest payload pgraft_replicate() accepts, bounded by the command queue */
+#define PGRAFT_REPLICATE_MAX_DATA 1023
+
 /* Log replication functions */
+Size		pgraft_log_shmem_size(void);
 void		pgraft_log_init_shared_memory(void);
 pgraft_log_state_t *pgraft_log_get_shared_memory(void);
 
@@ -45,7 +94,7 @@ pgraft_log_state_t *pgraft_log_get_shared_memory(void);
 int			pgraft_log_append_entry(int64_t term, const char *data, int32_t data_size);
 int			pgraft_log_commit_entry(int64_t index);
 int			pgraft_log_apply_entry(int64_t index);
-int			pgraft_log_get_entry(int64_t index, pgraft_log_entry_t *entry);
+int			pgraft_log_get_entry(int64_t index, pgraft_log_entry_t *entry, char **data);
 int			pgraft_log_get_last_index(int64_t *last_index);
 int			pgraft_log_get_commit_index(int64_t *commit_index);
 int			pgraft_log_get_last_applied(int64_t *last_applied);
@@ -59,8 +108,17 @@ int			pgraft_log_sync_with_leader(void);
 int			pgraft_log_get_statistics(pgraft_log_state_t *stats);
 int			pgraft_log_get_replication_status(char *status, size_t status_size);
 
+/* Commit waits for replicated proposals */
+pgraft_proposal_state_t *pgraft_log_get_proposal_state(void);
+uint64		pgraft_log_register_proposal(void);
+void		pgraft_log_release_proposal(uint64 proposal_id);
+void		pgraft_log_fail_proposal(uint64 proposal_id);
+int64_t		pgraft_log_wait_proposal(uint64 proposal_id, int timeout_ms);
+void		pgraft_log_wake_proposal_waiters(void);
+
 /* Log cleanup */
 void		pgraft_log_cleanup_old_entries(int64_t before_index);
+int			pgraft_log_compact(int32_t max_entries, int32_t max_size_kb, int32_t retain);
 void		pgraft_log_reset(void);
 
 #endif
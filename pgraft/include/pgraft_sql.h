@@ -8,6 +8,7 @@
 Datum		pgraft_init(PG_FUNCTION_ARGS);
 Datum		pgraft_init_guc(PG_FUNCTION_ARGS);
 Datum		pgraft_add_node(PG_FUNCTION_ARGS);
+Datum		pgraft_add_nodes(PG_FUNCTION_ARGS);
 Datum		pgraft_remove_node(PG_FUNCTION_ARGS);
 Datum		pgraft_get_cluster_status_table(PG_FUNCTION_ARGS);
 Datum		pgraft_get_leader(PG_FUNCTION_ARGS);
@@ -19,12 +20,19 @@ Datum		pgraft_test(PG_FUNCTION_ARGS);
 Datum		pgraft_set_debug(PG_FUNCTION_ARGS);
 Datum		pgraft_get_worker_state(PG_FUNCTION_ARGS);
 Datum		pgraft_get_queue_status(PG_FUNCTION_ARGS);
+Datum		pgraft_get_cluster_snapshot(PG_FUNCTION_ARGS);
 
 /* Log replication SQL functions */
 Datum		pgraft_log_append(PG_FUNCTION_ARGS);
 Datum		pgraft_log_commit(PG_FUNCTION_ARGS);
 Datum		pgraft_log_apply(PG_FUNCTION_ARGS);
+Datum		pgraft_replicate(PG_FUNCTION_ARGS);
+Datum		pgraft_read_barrier(PG_FUNCTION_ARGS);
+Datum		pgraft_transfer_leadership(PG_FUNCTION_ARGS);
+Datum		pgraft_wait_leader_change(PG_FUNCTION_ARGS);
+Datum		pgraft_cpu_profile(PG_FUNCTION_ARGS);
 Datum		pgraft_log_get_entry_sql(PG_FUNCTION_ARGS);
+Datum		pgraft_log_entries(PG_FUNCTION_ARGS);
 Datum		pgraft_log_get_stats_table(PG_FUNCTION_ARGS);
 Datum		pgraft_log_get_replication_status_table(PG_FUNCTION_ARGS);
 Datum		pgraft_log_sync_with_leader_sql(PG_FUNCTION_ARGS);
@@ -2,8 +2,12 @@
 #define PGRAFT_STATE_H
 
 #include "postgres.h"
+#include "storage/condition_variable.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
+#include "datatype/timestamp.h"
+
+#include "pgraft_go.h"
 
 /* Go library state persistence */
 typedef struct pgraft_go_state
@@ -29,9 +33,19 @@ typedef struct pgraft_go_state
 	
 	/* Node configuration */
 	int32_t		num_nodes;
-	int32_t		node_ids[16];
-	char		node_addresses[16][256];
-	int32_t		node_ports[16];
+	int32_t		node_ids[PGRAFT_MAX_NODES];
+	char		node_addresses[PGRAFT_MAX_NODES][256];
+	int32_t		node_ports[PGRAFT_MAX_NODES];
+
+	/*
+	 * Replication progress per node, as tracked by the leader; -1 on
+	 * followers or for nodes the leader does not track yet
+	 */
+	int64_t		node_match_index[PGRAFT_MAX_NODES];
+	int64_t		node_next_index[PGRAFT_MAX_NODES];
+	int32_t		node_progress_state[PGRAFT_MAX_NODES];
+	bool		node_voting[PGRAFT_MAX_NODES];	/* false for Raft learners */
+	TimestampTz	go_status_published_at;	/* 0 until the worker first publishes */
 	
 	/* Performance metrics */
 	int64_t		go_messages_processed;
@@ -39,6 +53,12 @@ typedef struct pgraft_go_state
 	int64_t		go_heartbeats_sent;
 	int64_t		go_elections_triggered;
 	
+	/* Written by the Go library after every Ready; not covered by mutex */
+	pgraft_go_raft_status_t raft_status;
+
+	/* Broadcast by the worker when raft_status shows a new leader or term */
+	ConditionVariable leader_cv;
+
 	/* Mutex for thread safety */
 	slock_t		mutex;
 }			pgraft_go_state_t;
@@ -61,6 +81,37 @@ void		pgraft_state_save_cluster_nodes(int32_t num_nodes, int32_t *node_ids,
 void		pgraft_state_restore_cluster_nodes(int32_t *num_nodes, int32_t *node_ids,
 											   char node_addresses[][256], int32_t *node_ports);
 
+/*
+ * Raft status publication.  The background worker, which hosts the Go
+ * Raft node, publishes leader, term, indexes, membership and progress in
+ * one critical section; readers copy the whole block under the same lock
+ * and never cross into Go.
+ */
+void		pgraft_state_publish_go_status(void);
+void		pgraft_state_get_snapshot(pgraft_go_state_t *snapshot);
+const char *pgraft_state_raft_state_name(int32_t raft_state);
+
+/*
+ * Lock-free read of the seqlock block the Go library publishes after every
+ * Ready; returns false if nothing has been published yet.
+ */
+bool		pgraft_state_read_raft_status(pgraft_go_raft_status_t *status);
+const char *pgraft_state_progress_name(int32_t progress_state);
+
+/*
+ * Leadership change notification.  The worker checks raft_status each
+ * time Go wakes it and wakes the waiters if leader or term moved; a
+ * waiter returns true once either differs from what it knew, false on
+ * timeout.  status always holds the latest values.
+ */
+void		pgraft_state_check_leader_change(void);
+bool		pgraft_state_wait_leader_change(int64_t known_leader, int64_t known_term,
+											int timeout_ms,
+											pgraft_go_raft_status_t *status);
+
+/* Map the file the Go library publishes its Raft metrics into */
+pgraft_go_metrics_t *pgraft_state_map_metrics_file(const char *dir);
+
 /* State validation */
 bool		pgraft_state_is_go_lib_loaded(void);
 bool		pgraft_state_is_go_initialized(void);
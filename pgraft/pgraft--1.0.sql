@@ -22,14 +22,27 @@ LANGUAGE C
 AS 'pgraft', 'pgraft_init';
 
 
--- Add a node to the cluster
-CREATE OR REPLACE FUNCTION pgraft_add_node(node_id integer, address text, port integer)
+-- Add a node to the cluster; voting => false adds a non-voting learner.
+-- Returns once the change is applied, false if that took longer than timeout
+CREATE OR REPLACE FUNCTION pgraft_add_node(node_id integer, address text, port integer,
+                                           voting boolean DEFAULT true,
+                                           timeout interval DEFAULT '5 seconds')
 RETURNS boolean
 LANGUAGE C
 AS 'pgraft', 'pgraft_add_node';
 
--- Remove a node from the cluster
-CREATE OR REPLACE FUNCTION pgraft_remove_node(node_id integer)
+-- Add several nodes in one configuration change (one joint-consensus step)
+CREATE OR REPLACE FUNCTION pgraft_add_nodes(node_ids integer[], addresses text[],
+                                            ports integer[],
+                                            voting boolean DEFAULT true,
+                                            timeout interval DEFAULT '5 seconds')
+RETURNS boolean
+LANGUAGE C
+AS 'pgraft', 'pgraft_add_nodes';
+
+-- Remove a node from the cluster, returning once the change is applied
+CREATE OR REPLACE FUNCTION pgraft_remove_node(node_id integer,
+                                              timeout interval DEFAULT '5 seconds')
 RETURNS boolean
 LANGUAGE C
 AS 'pgraft', 'pgraft_remove_node';
@@ -84,6 +97,32 @@ RETURNS TABLE(
 LANGUAGE C
 AS 'pgraft', 'pgraft_get_nodes_table';
 
+-- Leader, term, indexes, membership and per-node progress in one call.
+-- One row per member; the cluster columns repeat on every row.  match_index,
+-- next_index and progress are only known on the leader.
+CREATE OR REPLACE FUNCTION pgraft_get_cluster_snapshot()
+RETURNS TABLE(
+    leader_id bigint,
+    current_term bigint,
+    commit_index bigint,
+    last_applied bigint,
+    last_index bigint,
+    state text,
+    local_node_id integer,
+    is_leader boolean,
+    published_at timestamptz,
+    node_id integer,
+    address text,
+    port integer,
+    node_is_leader boolean,
+    match_index bigint,
+    next_index bigint,
+    progress text,
+    voting boolean
+)
+LANGUAGE C
+AS 'pgraft', 'pgraft_get_cluster_snapshot';
+
 -- Get version information
 CREATE OR REPLACE FUNCTION pgraft_get_version()
 RETURNS text
@@ -112,6 +151,46 @@ RETURNS boolean
 LANGUAGE C
 AS 'pgraft', 'pgraft_log_append';
 
+-- Propose data through Raft; with wait_commit, return its committed index
+CREATE OR REPLACE FUNCTION pgraft_replicate(data bytea,
+                                            wait_commit boolean DEFAULT true,
+                                            timeout interval DEFAULT '5 seconds')
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_replicate';
+
+-- Linearizable read barrier; reads of pgraft state after it are not stale
+CREATE OR REPLACE FUNCTION pgraft_read_barrier(timeout interval DEFAULT '5 seconds')
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_read_barrier';
+
+-- Move Raft leadership to a node, e.g. ahead of a planned switchover
+CREATE OR REPLACE FUNCTION pgraft_transfer_leadership(target_node integer,
+                                                      timeout interval DEFAULT '5 seconds')
+RETURNS boolean
+LANGUAGE C
+AS 'pgraft', 'pgraft_transfer_leadership';
+
+-- Wait for the Raft leader or term to differ from the known ones; changed
+-- is false if the timeout passed first
+CREATE OR REPLACE FUNCTION pgraft_wait_leader_change(known_leader bigint,
+                                                     known_term bigint,
+                                                     timeout interval DEFAULT '5 seconds',
+                                                     OUT leader_id bigint,
+                                                     OUT term bigint,
+                                                     OUT changed boolean)
+RETURNS record
+LANGUAGE C
+AS 'pgraft', 'pgraft_wait_leader_change';
+
+-- CPU profile of the Go Raft runtime, in pprof format for "go tool pprof"
+CREATE OR REPLACE FUNCTION pgraft_cpu_profile(seconds integer DEFAULT 10)
+RETURNS bytea
+LANGUAGE C
+AS 'pgraft', 'pgraft_cpu_profile';
+REVOKE ALL ON FUNCTION pgraft_cpu_profile(integer) FROM PUBLIC;
+
 -- Commit log entry
 CREATE OR REPLACE FUNCTION pgraft_log_commit(index bigint)
 RETURNS boolean
@@ -130,6 +209,21 @@ RETURNS text
 LANGUAGE C
 AS 'pgraft', 'pgraft_log_get_entry_sql';
 
+-- Page through the Raft log; the next page starts after the last log_index
+CREATE OR REPLACE FUNCTION pgraft_log_entries(
+    from_index bigint DEFAULT 0,
+    max_entries integer DEFAULT 100
+)
+RETURNS TABLE(
+    log_index bigint,
+    term bigint,
+    entry_type text,
+    committed boolean,
+    data bytea
+)
+LANGUAGE C
+AS 'pgraft', 'pgraft_log_entries';
+
 -- Get log statistics as table with individual columns
 CREATE OR REPLACE FUNCTION pgraft_log_get_stats()
 RETURNS TABLE(
@@ -166,6 +260,90 @@ RETURNS boolean
 LANGUAGE C
 AS 'pgraft', 'pgraft_log_sync_with_leader_sql';
 
+-- ============================================================================
+-- Key-Value Store
+-- ============================================================================
+
+-- Set a key; with expected_revision only if the key's mod_revision matches
+-- (0: only if it does not exist).  Returns the write's revision, NULL if
+-- the compare failed or the lease does not exist
+CREATE OR REPLACE FUNCTION pgraft_kv_put(key text,
+                                         value bytea,
+                                         expected_revision bigint DEFAULT NULL,
+                                         lease bigint DEFAULT 0,
+                                         timeout interval DEFAULT '5 seconds')
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_put';
+
+-- Delete a key, or with prefix every key under it; NULL if nothing was deleted
+CREATE OR REPLACE FUNCTION pgraft_kv_delete(key text,
+                                            expected_revision bigint DEFAULT NULL,
+                                            prefix boolean DEFAULT false,
+                                            timeout interval DEFAULT '5 seconds')
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_delete';
+
+-- Read a key, or with prefix every key under it in key order
+CREATE OR REPLACE FUNCTION pgraft_kv_get(key text,
+                                         prefix boolean DEFAULT false,
+                                         consistent boolean DEFAULT true,
+                                         max_keys integer DEFAULT 100000)
+RETURNS TABLE(
+    key text,
+    value bytea,
+    create_revision bigint,
+    mod_revision bigint,
+    version bigint,
+    lease bigint
+)
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_get';
+
+-- Current store revision; take it before pgraft_kv_get() to watch from
+CREATE OR REPLACE FUNCTION pgraft_kv_revision(consistent boolean DEFAULT true)
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_revision';
+
+-- Changes under prefix after after_revision, waiting up to timeout for the
+-- first; resume from the last revision returned
+CREATE OR REPLACE FUNCTION pgraft_kv_watch(prefix text,
+                                           after_revision bigint,
+                                           timeout interval DEFAULT '30 seconds',
+                                           max_events integer DEFAULT 1000)
+RETURNS TABLE(
+    revision bigint,
+    event text,
+    key text,
+    value bytea,
+    create_revision bigint,
+    version bigint,
+    lease bigint
+)
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_watch';
+
+-- A lease whose keys are deleted once ttl passes without a keepalive
+CREATE OR REPLACE FUNCTION pgraft_kv_lease_grant(ttl interval,
+                                                 timeout interval DEFAULT '5 seconds')
+RETURNS bigint
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_lease_grant';
+
+CREATE OR REPLACE FUNCTION pgraft_kv_lease_keepalive(lease bigint,
+                                                     timeout interval DEFAULT '5 seconds')
+RETURNS boolean
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_lease_keepalive';
+
+CREATE OR REPLACE FUNCTION pgraft_kv_lease_revoke(lease bigint,
+                                                  timeout interval DEFAULT '5 seconds')
+RETURNS boolean
+LANGUAGE C
+AS 'pgraft', 'pgraft_kv_lease_revoke';
+
 -- Command queue inspection function
 CREATE OR REPLACE FUNCTION pgraft_get_queue_status()
 RETURNS TABLE(
@@ -13,9 +13,17 @@
 #include "miscadmin.h"
 #include "storage/shmem.h"
 #include "utils/elog.h"
+#include "pgstat.h"
 #include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/latch.h"
+#include "storage/spin.h"
+#include "utils/guc.h"
 #include "utils/ps_status.h"
+#include "utils/timestamp.h"
 
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../include/pgraft_core.h"
 #include "../include/pgraft_go.h"
@@ -24,11 +32,23 @@
 #include "../include/pgraft_guc.h"
 /* Forward declarations */
 static int pgraft_init_system(int node_id, const char *address, int port);
-static int pgraft_add_node_system(int node_id, const char *address, int port);
+static int pgraft_change_peers_system(pgraft_go_peer_change_t *changes, int count,
+									  uint64 proposal_id);
+static int pgraft_add_node_system(int node_id, const char *address, int port, bool voting);
 static int pgraft_remove_node_system(int node_id);
 static int pgraft_log_append_system(const char *log_data, int log_index);
 static int pgraft_log_commit_system(int log_index);
 static int pgraft_log_apply_system(int log_index);
+static void pgraft_worker_process_command(pgraft_worker_state_t *state, pgraft_command_t *cmd);
+static void pgraft_sync_go_settings(void);
+static void pgraft_setup_commit_notify(void);
+static void pgraft_setup_proposal_ring(void);
+static void pgraft_ring_doorbell(pgraft_worker_state_t *state);
+static void pgraft_drain_commit_notify(void);
+
+/* Read end of the pipe Go writes to when a local proposal commits */
+static int	pgraft_commit_notify_fd = -1;
+static int	pgraft_ring_doorbell_fd = -1;
 
 
 PG_MODULE_MAGIC;
@@ -56,11 +76,14 @@ pgraft_shmem_request_hook(void)
 	RequestAddinShmemSpace(sizeof(pgraft_go_state_t));
 	
 	/* Request shared memory for log replication */
-	RequestAddinShmemSpace(sizeof(pgraft_log_state_t));
+	RequestAddinShmemSpace(pgraft_log_shmem_size());
 	
 	/* Request shared memory for background worker state */
 	RequestAddinShmemSpace(sizeof(pgraft_worker_state_t));
 	
+	/* Request shared memory for pgraft_replicate() commit waiters */
+	RequestAddinShmemSpace(sizeof(pgraft_proposal_state_t));
+	
 	elog(LOG, "pgraft: Shared memory request hook completed");
 }
 
@@ -153,13 +176,21 @@ pgraft_main(Datum main_arg)
 {
 	/* Variable declarations at the top - PostgreSQL C standard */
 	pgraft_worker_state_t *state;
-	pgraft_command_t cmd;
-	int sleep_count = 0;
+	static pgraft_command_t batch[PGRAFT_DEQUEUE_BATCH];
+	TimestampTz last_alive;
+	int			processed;
+	int			count;
+	int			events;
+	int			rc;
+	
+	(void) main_arg;
 	
 	/* Debug logging */
 	elog(LOG, "pgraft: Background worker main function started");
 	
 	/* Set up signal handling */
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, SignalHandlerForShutdownRequest);
 	BackgroundWorkerUnblockSignals();
 	
 	elog(LOG, "pgraft: Background worker signal handling set up");
@@ -172,138 +203,358 @@ pgraft_main(Datum main_arg)
 	}
 	elog(LOG, "pgraft: Worker state obtained successfully");
 
-	/* Initialize worker state */
+	/* Initialize worker state and publish our latch to enqueuers */
+	SpinLockAcquire(&state->mutex);
 	state->status = WORKER_STATUS_RUNNING;
+	state->latch = MyLatch;
+	SpinLockRelease(&state->mutex);
 	elog(LOG, "pgraft: Worker status set to RUNNING");
 
 	/* Log startup */
 	elog(LOG, "pgraft: Background worker started and running");
-
-	/* Main worker loop - process command queue */
-	while (state->status != WORKER_STATUS_STOPPED) {
-		/* Process commands from queue */
-		if (pgraft_dequeue_command(&cmd)) {
-			elog(LOG, "pgraft: Worker processing command %d for node %d", cmd.type, cmd.node_id);
-			
-			/* Add to status tracking */
-			pgraft_add_command_to_status(&cmd);
-			
-			/* Mark as processing */
-			cmd.status = COMMAND_STATUS_PROCESSING;
-			
-			switch (cmd.type) {
-				case COMMAND_INIT:
-					/* Call init function */
-					if (pgraft_init_system(cmd.node_id, cmd.address, cmd.port) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						strncpy(cmd.error_message, "Failed to initialize pgraft system", 
-								sizeof(cmd.error_message) - 1);
-					} else {
-						/* Update worker state */
-						state->node_id = cmd.node_id;
-						strncpy(state->address, cmd.address, sizeof(state->address) - 1);
-						state->address[sizeof(state->address) - 1] = '\0';
-						state->port = cmd.port;
-						state->status = WORKER_STATUS_RUNNING;
-						
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_ADD_NODE:
-					/* Call add node function */
-					if (pgraft_add_node_system(cmd.node_id, cmd.address, cmd.port) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						snprintf(cmd.error_message, sizeof(cmd.error_message), 
-								"Failed to add node %d to pgraft system", cmd.node_id);
-					} else {
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_REMOVE_NODE:
-					/* Call remove node function */
-					if (pgraft_remove_node_system(cmd.node_id) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						snprintf(cmd.error_message, sizeof(cmd.error_message), 
-								"Failed to remove node %d from pgraft system", cmd.node_id);
-					} else {
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_LOG_APPEND:
-					/* Call log append function */
-					if (pgraft_log_append_system(cmd.log_data, cmd.log_index) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						snprintf(cmd.error_message, sizeof(cmd.error_message), 
-								"Failed to append log entry at index %d", cmd.log_index);
-					} else {
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_LOG_COMMIT:
-					/* Call log commit function */
-					if (pgraft_log_commit_system(cmd.log_index) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						snprintf(cmd.error_message, sizeof(cmd.error_message), 
-								"Failed to commit log entry at index %d", cmd.log_index);
-					} else {
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_LOG_APPLY:
-					/* Call log apply function */
-					if (pgraft_log_apply_system(cmd.log_index) != 0) {
-						cmd.status = COMMAND_STATUS_FAILED;
-						snprintf(cmd.error_message, sizeof(cmd.error_message), 
-								"Failed to apply log entry at index %d", cmd.log_index);
-					} else {
-						cmd.status = COMMAND_STATUS_COMPLETED;
-					}
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				case COMMAND_SHUTDOWN:
-					elog(LOG, "pgraft: SHUTDOWN command received");
-					state->status = WORKER_STATUS_STOPPED;
-					cmd.status = COMMAND_STATUS_COMPLETED;
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
-					
-				default:
-					elog(WARNING, "pgraft: Unknown command type %d", cmd.type);
-					cmd.status = COMMAND_STATUS_FAILED;
-					snprintf(cmd.error_message, sizeof(cmd.error_message), 
-							"Unknown command type %d", cmd.type);
-					pgraft_update_command_status(cmd.timestamp, cmd.status, cmd.error_message);
-					break;
+	last_alive = GetCurrentTimestamp();
+
+	/*
+	 * Main worker loop.  Drain the whole queue, then sleep on the process
+	 * latch until a backend enqueues more work (pgraft_queue_command sets
+	 * the latch) or pgraft.worker_interval elapses.
+	 */
+	while (state->status != WORKER_STATUS_STOPPED && !ShutdownRequestPending) {
+		processed = 0;
+		while (state->status != WORKER_STATUS_STOPPED &&
+			   (count = pgraft_dequeue_commands(batch, PGRAFT_DEQUEUE_BATCH)) > 0) {
+			for (int i = 0; i < count; i++) {
+				if (state->status == WORKER_STATUS_STOPPED)
+					pgraft_update_command_status(batch[i].id, COMMAND_STATUS_FAILED,
+												 "Worker stopped before processing");
+				else
+					pgraft_worker_process_command(state, &batch[i]);
 			}
+			processed += count;
+		}
+		
+		if (processed > 0)
+			elog(DEBUG1, "pgraft: Worker processed %d queued commands", processed);
+		
+		/* Proposals backends put in the ring since Go last looked */
+		pgraft_ring_doorbell(state);
+		
+		if (state->status == WORKER_STATUS_STOPPED)
+			break;
+		
+		/* Publish leader, term and progress for SQL readers */
+		if (pgraft_go_is_loaded())
+		{
+			pgraft_state_publish_go_status();
+			pgraft_state_check_leader_change();
+		}
+		
+		/* Drop applied entries beyond the catch-up window from shared memory */
+		pgraft_log_compact(pgraft_snapshot_threshold,
+						   pgraft_snapshot_max_log_size,
+						   pgraft_snapshot_catchup_entries);
+		
+		/* Also wake as soon as Go reports a committed local proposal */
+		events = WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH;
+		if (pgraft_commit_notify_fd >= 0)
+			events |= WL_SOCKET_READABLE;
+		rc = WaitLatchOrSocket(MyLatch, events, pgraft_commit_notify_fd,
+							   pgraft_worker_interval, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		
+		if (rc & WL_SOCKET_READABLE)
+			pgraft_drain_commit_notify();
+		
+		CHECK_FOR_INTERRUPTS();
+		
+		if (ConfigReloadPending) {
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+			pgraft_sync_go_settings();
 		}
-
-		/* Sleep for a short time to avoid busy waiting */
-		pg_usleep(1000000); /* 1 second */
 		
 		/* Log every 10 seconds to show we're alive */
-		sleep_count++;
-		if (sleep_count >= 10) {
-			elog(LOG, "pgraft: Background worker running... (alive check)");
-			sleep_count = 0;
+		if (TimestampDifferenceExceeds(last_alive, GetCurrentTimestamp(), 10000)) {
+			elog(DEBUG1, "pgraft: Background worker running... (alive check)");
+			last_alive = GetCurrentTimestamp();
 		}
 	}
 
-	/* Cleanup */
+	/* Cleanup; proposals go back to the queue until a worker takes the ring again */
+	SpinLockAcquire(&state->ring_mutex);
+	state->ring_attached = false;
+	SpinLockRelease(&state->ring_mutex);
+
+	SpinLockAcquire(&state->mutex);
 	state->status = WORKER_STATUS_STOPPED;
+	state->latch = NULL;
+	SpinLockRelease(&state->mutex);
 	elog(LOG, "pgraft: Background worker stopped");
 }
 
+/*
+ * Execute one dequeued command and record its outcome
+ */
+static void
+pgraft_worker_process_command(pgraft_worker_state_t *state, pgraft_command_t *cmd)
+{
+	elog(DEBUG1, "pgraft: Worker processing command " UINT64_FORMAT " (type %d) for node %d",
+		 cmd->id, cmd->type, cmd->node_id);
+	
+	/* Dequeue already marked it as processing, locally and in the queue */
+	
+	switch (cmd->type) {
+		case COMMAND_INIT:
+			/* Call init function */
+			if (pgraft_init_system(cmd->node_id, cmd->address, cmd->port) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				strncpy(cmd->error_message, "Failed to initialize pgraft system", 
+						sizeof(cmd->error_message) - 1);
+			} else {
+				/* Update worker state */
+				state->node_id = cmd->node_id;
+				strncpy(state->address, cmd->address, sizeof(state->address) - 1);
+				state->address[sizeof(state->address) - 1] = '\0';
+				state->port = cmd->port;
+				state->status = WORKER_STATUS_RUNNING;
+				
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_ADD_NODE:
+		case COMMAND_ADD_LEARNER:
+			/* Call add node function */
+			if (pgraft_add_node_system(cmd->node_id, cmd->address, cmd->port,
+									   cmd->type == COMMAND_ADD_NODE) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				snprintf(cmd->error_message, sizeof(cmd->error_message), 
+						"Failed to add node %d to pgraft system", cmd->node_id);
+			} else {
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_REMOVE_NODE:
+			/* Call remove node function */
+			if (pgraft_remove_node_system(cmd->node_id) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				snprintf(cmd->error_message, sizeof(cmd->error_message), 
+						"Failed to remove node %d from pgraft system", cmd->node_id);
+			} else {
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_CHANGE_PEERS:
+			{
+				pgraft_go_peer_change_t changes[PGRAFT_MAX_NODES];
+				int			count = pgraft_decode_peer_changes(cmd, changes, PGRAFT_MAX_NODES);
+
+				if (count <= 0 ||
+					pgraft_change_peers_system(changes, count, cmd->proposal_id) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to propose membership change " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					/* The waiter is told by the Go apply loop once the change is applied */
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_LOG_APPEND:
+			/* Call log append function */
+			if (pgraft_log_append_system(cmd->log_data, cmd->log_index) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				snprintf(cmd->error_message, sizeof(cmd->error_message), 
+						"Failed to append log entry at index %d", cmd->log_index);
+			} else {
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_LOG_COMMIT:
+			/* Call log commit function */
+			if (pgraft_log_commit_system(cmd->log_index) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				snprintf(cmd->error_message, sizeof(cmd->error_message), 
+						"Failed to commit log entry at index %d", cmd->log_index);
+			} else {
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_LOG_APPLY:
+			/* Call log apply function */
+			if (pgraft_log_apply_system(cmd->log_index) != 0) {
+				cmd->status = COMMAND_STATUS_FAILED;
+				snprintf(cmd->error_message, sizeof(cmd->error_message), 
+						"Failed to apply log entry at index %d", cmd->log_index);
+			} else {
+				cmd->status = COMMAND_STATUS_COMPLETED;
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_REPLICATE:
+			{
+				pgraft_go_propose_func propose = pgraft_go_get_propose_func();
+
+				if (!propose || propose(cmd->proposal_id, cmd->log_data, cmd->log_data_len) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to propose entry " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					/* The waiter is told about the commit by the Go Ready loop */
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_READ_INDEX:
+			{
+				pgraft_go_read_index_func read_index = pgraft_go_get_read_index_func();
+
+				if (!read_index || read_index(cmd->proposal_id) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to request read index " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					/* Completed by the Go Ready loop once the index is applied */
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_TRANSFER_LEADERSHIP:
+			{
+				pgraft_go_transfer_leadership_func transfer = pgraft_go_get_transfer_leadership_func();
+
+				if (!transfer || transfer(cmd->node_id) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to transfer leadership to node %d", cmd->node_id);
+				} else {
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_CPU_PROFILE:
+			{
+				pgraft_go_cpu_profile_func profile = pgraft_go_get_cpu_profile_func();
+
+				/* Returns at once; the file appears when the profile is done */
+				if (!profile || profile(cmd->address, cmd->node_id) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to start a %d second CPU profile", cmd->node_id);
+				} else {
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_LOG_ENTRIES:
+			{
+				pgraft_go_dump_log_entries_func dump = pgraft_go_get_dump_log_entries_func();
+				uint64		from_index;
+				int			limit;
+				int64		max_bytes;
+
+				/* Returns at once; the waiter is told when the page is written */
+				if (!dump ||
+					sscanf(cmd->log_data, UINT64_FORMAT " %d " INT64_FORMAT,
+						   &from_index, &limit, &max_bytes) != 3 ||
+					dump(cmd->proposal_id, from_index, limit, max_bytes, cmd->address) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to read Raft log entries for " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_KV_WRITE:
+			{
+				pgraft_go_kv_propose_func kv_propose = pgraft_go_get_kv_propose_func();
+
+				if (!kv_propose ||
+					kv_propose(cmd->proposal_id, cmd->log_data, cmd->log_data_len) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to propose key-value write " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					/* The waiter gets the outcome once the write is applied */
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_KV_READ:
+			{
+				pgraft_go_kv_read_func kv_read = pgraft_go_get_kv_read_func();
+				int			mode;
+				int64		after;
+				int			limit;
+				int			timeout_ms;
+				int			key_offset = 0;
+
+				/* Returns at once; a watch may hold its waiter for timeout_ms */
+				if (!kv_read ||
+					sscanf(cmd->log_data, "%d " INT64_FORMAT " %d %d%n",
+						   &mode, &after, &limit, &timeout_ms, &key_offset) != 4 ||
+					key_offset >= cmd->log_data_len || cmd->log_data[key_offset] != '\n' ||
+					kv_read(cmd->proposal_id, mode, cmd->log_data + key_offset + 1,
+							cmd->log_data_len - key_offset - 1, after, limit, timeout_ms,
+							cmd->address) != 0) {
+					cmd->status = COMMAND_STATUS_FAILED;
+					snprintf(cmd->error_message, sizeof(cmd->error_message),
+							"Failed to read the key-value store for " UINT64_FORMAT, cmd->proposal_id);
+					pgraft_log_fail_proposal(cmd->proposal_id);
+				} else {
+					cmd->status = COMMAND_STATUS_COMPLETED;
+				}
+			}
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		case COMMAND_SHUTDOWN:
+			elog(LOG, "pgraft: SHUTDOWN command received");
+			state->status = WORKER_STATUS_STOPPED;
+			cmd->status = COMMAND_STATUS_COMPLETED;
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+			
+		default:
+			elog(WARNING, "pgraft: Unknown command type %d", cmd->type);
+			cmd->status = COMMAND_STATUS_FAILED;
+			snprintf(cmd->error_message, sizeof(cmd->error_message), 
+					"Unknown command type %d", cmd->type);
+			pgraft_update_command_status(cmd->id, cmd->status, cmd->error_message);
+			break;
+	}
+}
+
 /*
  * Get worker state from shared memory
  */
@@ -323,19 +574,103 @@ pgraft_worker_get_state(void)
 			worker_state->port = 0;
 			strlcpy(worker_state->address, "127.0.0.1", sizeof(worker_state->address));
 			worker_state->status = WORKER_STATUS_STOPPED;
+			worker_state->latch = NULL;
+			SpinLockInit(&worker_state->mutex);
 			
-			/* Initialize circular buffers */
-			worker_state->command_head = 0;
-			worker_state->command_tail = 0;
-			worker_state->command_count = 0;
-			worker_state->status_head = 0;
-			worker_state->status_tail = 0;
-			worker_state->status_count = 0;
+			/* Empty command queue; ids start at 1 so 0 marks a free slot */
+			memset(worker_state->slots, 0, sizeof(worker_state->slots));
+			worker_state->next_id = 1;
+			worker_state->next_dequeue_id = 1;
+			worker_state->oldest_id = 1;
+			worker_state->arena_head = 0;
+			worker_state->arena_used = 0;
+
+			SpinLockInit(&worker_state->ring_mutex);
+			worker_state->ring_attached = false;
+			worker_state->ring.head = 0;
+			worker_state->ring.tail = 0;
 		}
 	}
 	return worker_state;
 }
 
+/*
+ * Push reloadable settings down to the Go library.
+ *
+ * pgraft.log_level counts 0=DEBUG .. 3=ERROR while the Go side counts
+ * 0=ERROR .. 4=TRACE; trace_enabled overrides the level entirely.  The
+ * snapshot GUCs drive automatic snapshots and log compaction in Go.  Called
+ * after the library is loaded and after every configuration reload.
+ */
+static void
+pgraft_sync_go_settings(void)
+{
+	pgraft_go_set_log_level_func set_log_level;
+	pgraft_go_set_snapshot_policy_func set_snapshot_policy;
+	pgraft_go_set_batch_policy_func set_batch_policy;
+	pgraft_go_set_read_mode_func set_read_mode;
+	pgraft_go_set_timing_func set_timing;
+	pgraft_go_set_election_policy_func set_election_policy;
+	pgraft_go_set_peer_delay_func set_peer_delay;
+	pgraft_go_set_tls_func set_tls;
+	pgraft_go_set_compression_func set_compression;
+	int			go_level;
+
+	set_log_level = pgraft_go_get_set_log_level_func();
+	if (set_log_level) {
+		if (pgraft_trace_enabled)
+			go_level = 4;
+		else
+			go_level = 3 - pgraft_log_level;
+
+		set_log_level(go_level);
+	}
+
+	set_snapshot_policy = pgraft_go_get_set_snapshot_policy_func();
+	if (set_snapshot_policy)
+		set_snapshot_policy(pgraft_snapshot_threshold,
+							pgraft_snapshot_max_log_size,
+							pgraft_snapshot_catchup_entries);
+
+	set_batch_policy = pgraft_go_get_set_batch_policy_func();
+	if (set_batch_policy)
+		set_batch_policy(pgraft_proposal_batch_delay, pgraft_proposal_batch_size);
+
+	/* Only read by init when it builds the Raft config */
+	set_read_mode = pgraft_go_get_set_read_mode_func();
+	if (set_read_mode)
+		set_read_mode(pgraft_lease_read ? 1 : 0);
+
+	/* The intervals are fixed at init; adaptive may change on reload */
+	set_timing = pgraft_go_get_set_timing_func();
+	if (set_timing)
+		set_timing(pgraft_heartbeat_interval, pgraft_election_timeout,
+				   pgraft_adaptive_timing ? 1 : 0);
+
+	set_election_policy = pgraft_go_get_set_election_policy_func();
+	if (set_election_policy)
+		set_election_policy(pgraft_pre_vote ? 1 : 0, pgraft_check_quorum ? 1 : 0);
+
+	set_peer_delay = pgraft_go_get_set_peer_delay_func();
+	if (set_peer_delay)
+		set_peer_delay(pgraft_debug_peer_delay);
+
+	/* Certificates are picked up by the next peer handshake */
+	set_tls = pgraft_go_get_set_tls_func();
+	if (set_tls &&
+		set_tls(pgraft_ssl_cert_file ? pgraft_ssl_cert_file : "",
+				pgraft_ssl_key_file ? pgraft_ssl_key_file : "",
+				pgraft_ssl_ca_file ? pgraft_ssl_ca_file : "") != 0)
+		elog(WARNING, "pgraft: peer TLS certificates could not be loaded, "
+			 "peer connections fail until they can");
+
+	/* Links negotiate their codec in the hello, so only new ones follow */
+	set_compression = pgraft_go_get_set_compression_func();
+	if (set_compression)
+		set_compression(pgraft_peer_compression ? 1 : 0,
+						pgraft_peer_compression_threshold);
+}
+
 /*
  * Initialize pgraft system
  */
@@ -345,6 +680,12 @@ pgraft_init_system(int node_id, const char *address, int port)
 	/* Variable declarations at the top - PostgreSQL C standard */
 	pgraft_go_init_func init_func;
 	pgraft_go_start_network_server_func start_network_server;
+	pgraft_go_set_data_dir_func set_data_dir;
+	pgraft_go_set_status_block_func set_status_block;
+	pgraft_go_set_metrics_block_func set_metrics_block;
+	pgraft_go_state_t *go_state;
+	pgraft_go_metrics_t *metrics_block;
+	char		raft_dir[MAXPGPATH];
 
 	/* Initialize core system */
 	if (pgraft_core_init(node_id, (char *)address, port) != 0) {
@@ -360,6 +701,34 @@ pgraft_init_system(int node_id, const char *address, int port)
 	}
 	elog(LOG, "pgraft: Go library loaded");
 
+	pgraft_sync_go_settings();
+
+	/* Point durable Raft storage at $PGDATA/pgraft */
+	set_data_dir = pgraft_go_get_set_data_dir_func();
+	if (set_data_dir) {
+		snprintf(raft_dir, sizeof(raft_dir), "%s/pgraft", DataDir);
+		if (set_data_dir(raft_dir) != 0)
+			elog(WARNING, "pgraft: Failed to set Raft data directory %s", raft_dir);
+	}
+
+	/* Let Go publish its status straight into shared memory */
+	set_status_block = pgraft_go_get_set_status_block_func();
+	go_state = pgraft_state_get_shared_memory();
+	if (set_status_block && go_state)
+		set_status_block(&go_state->raft_status);
+
+	/* And its metrics into a file ramd can map without a connection */
+	set_metrics_block = pgraft_go_get_set_metrics_block_func();
+	if (set_metrics_block) {
+		snprintf(raft_dir, sizeof(raft_dir), "%s/pgraft", DataDir);
+		metrics_block = pgraft_state_map_metrics_file(raft_dir);
+		if (metrics_block)
+			set_metrics_block(metrics_block);
+	}
+
+	pgraft_setup_commit_notify();
+	pgraft_setup_proposal_ring();
+
 	/* Initialize Go Raft library */
 	init_func = pgraft_go_get_init_func();
 	if (!init_func) {
@@ -390,68 +759,176 @@ pgraft_init_system(int node_id, const char *address, int port)
 }
 
 /*
- * Add node to pgraft system
+ * Hand Go the proposal result table and a pipe to poke the worker through
+ * when a proposal from this node commits or the leader or term changes.
+ * Go runs on its own threads, so it cannot touch the condition variables
+ * itself.
  */
-static int
-pgraft_add_node_system(int node_id, const char *address, int port)
+static void
+pgraft_setup_commit_notify(void)
 {
-	/* Variable declarations at the top - PostgreSQL C standard */
-	pgraft_go_add_peer_func add_peer_func;
+	pgraft_go_set_proposal_block_func set_proposal_block;
+	int			fds[2];
 
-	/* Add to core system */
-	if (pgraft_core_add_node(node_id, (char *)address, port) != 0) {
-		elog(WARNING, "pgraft: Failed to add node %d to core system", node_id);
-		return -1;
+	set_proposal_block = pgraft_go_get_set_proposal_block_func();
+	if (!set_proposal_block || pgraft_commit_notify_fd >= 0)
+		return;
+
+	if (pipe(fds) != 0) {
+		elog(WARNING, "pgraft: Failed to create commit notification pipe: %m");
+		return;
 	}
-	elog(LOG, "pgraft: Node %d added to core system", node_id);
-
-	/* Add to Go Raft library if loaded */
-	if (pgraft_go_is_loaded()) {
-		add_peer_func = pgraft_go_get_add_peer_func();
-		if (add_peer_func) {
-			if (add_peer_func(node_id, (char *)address, port) != 0) {
-				elog(WARNING, "pgraft: Failed to add node %d to Go Raft library", node_id);
-				return -1;
-			}
-			elog(LOG, "pgraft: Node %d added to Go Raft library", node_id);
-		}
+	(void) fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	(void) fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+	pgraft_commit_notify_fd = fds[0];
+	set_proposal_block(&pgraft_log_get_proposal_state()->block, fds[1]);
+}
+
+/*
+ * Hand Go the proposal ring and the read end of its doorbell pipe.
+ * Backends append to the ring once it is attached; a Go library without
+ * the ring leaves them on the command queue.
+ */
+static void
+pgraft_setup_proposal_ring(void)
+{
+	pgraft_go_set_proposal_ring_func set_proposal_ring;
+	pgraft_worker_state_t *state = pgraft_worker_get_state();
+	int			fds[2];
+
+	set_proposal_ring = pgraft_go_get_set_proposal_ring_func();
+	if (!set_proposal_ring || !state || pgraft_ring_doorbell_fd >= 0)
+		return;
+
+	if (pipe(fds) != 0) {
+		elog(WARNING, "pgraft: Failed to create proposal ring doorbell: %m");
+		return;
 	}
+	(void) fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	(void) fcntl(fds[1], F_SETFL, O_NONBLOCK);
 
-	elog(INFO, "pgraft: Node %d successfully added to cluster", node_id);
-	return 0;
+	pgraft_ring_doorbell_fd = fds[1];
+	set_proposal_ring(&state->ring, fds[0]);
+
+	SpinLockAcquire(&state->ring_mutex);
+	state->ring_attached = true;
+	SpinLockRelease(&state->ring_mutex);
+	elog(LOG, "pgraft: Proposals go to the Go runtime through a %d kB ring",
+		 PGRAFT_GO_RING_SIZE / 1024);
+}
+
+/*
+ * Wake Go's ring reader if records are waiting.  Go drains everything up
+ * to head on each wakeup, so a doorbell that finds the pipe full is
+ * already answered.
+ */
+static void
+pgraft_ring_doorbell(pgraft_worker_state_t *state)
+{
+	uint64		head;
+	uint64		tail;
+
+	if (pgraft_ring_doorbell_fd < 0)
+		return;
+
+	head = *(volatile uint64_t *) &state->ring.head;
+	tail = *(volatile uint64_t *) &state->ring.tail;
+	if (head != tail)
+		(void) write(pgraft_ring_doorbell_fd, "", 1);
 }
 
 /*
- * Remove node from pgraft system
+ * Empty the notification pipe and let waiters recheck their slots and
+ * the published leader
+ */
+static void
+pgraft_drain_commit_notify(void)
+{
+	char		buf[64];
+
+	while (read(pgraft_commit_notify_fd, buf, sizeof(buf)) > 0)
+		;
+	pgraft_log_wake_proposal_waiters();
+	pgraft_state_check_leader_change();
+}
+
+/*
+ * Propose membership changes to Raft as one configuration change.  Added
+ * nodes enter the core node list first, removed ones leave it once Go has
+ * taken the proposal.  Go reports proposal_id when the change is applied;
+ * 0 means nobody waits.
  */
 static int
-pgraft_remove_node_system(int node_id)
+pgraft_change_peers_system(pgraft_go_peer_change_t *changes, int count, uint64 proposal_id)
 {
-	/* Variable declarations at the top - PostgreSQL C standard */
-	pgraft_go_remove_peer_func remove_peer_func;
-
-	/* Remove from Go Raft library if loaded */
-	if (pgraft_go_is_loaded()) {
-		remove_peer_func = pgraft_go_get_remove_peer_func();
-		if (remove_peer_func) {
-			if (remove_peer_func(node_id) != 0) {
-				elog(WARNING, "pgraft: Failed to remove node %d from Go Raft library", node_id);
-				return -1;
-			}
-			elog(LOG, "pgraft: Node %d removed from Go Raft library", node_id);
+	pgraft_go_change_peers_func change_peers = NULL;
+
+	for (int i = 0; i < count; i++) {
+		if (changes[i].type == PGRAFT_GO_PEER_REMOVE)
+			continue;
+		if (pgraft_core_add_node(changes[i].node_id, changes[i].address, changes[i].port) != 0) {
+			elog(WARNING, "pgraft: Failed to add node %d to core system", changes[i].node_id);
+			return -1;
 		}
 	}
 
-	/* Remove from core system */
-	if (pgraft_core_remove_node(node_id) != 0) {
-		elog(WARNING, "pgraft: Failed to remove node %d from core system", node_id);
+	if (pgraft_go_is_loaded())
+		change_peers = pgraft_go_get_change_peers_func();
+	if (change_peers) {
+		if (change_peers(proposal_id, changes, count) != 0) {
+			elog(WARNING, "pgraft: Go Raft library refused %d membership change(s)", count);
+			return -1;
+		}
+	} else if (proposal_id != 0) {
+		elog(WARNING, "pgraft: Go Raft library is not loaded");
 		return -1;
 	}
 
-	elog(INFO, "pgraft: Node %d successfully removed from cluster", node_id);
+	for (int i = 0; i < count; i++) {
+		if (changes[i].type != PGRAFT_GO_PEER_REMOVE)
+			continue;
+		if (pgraft_core_remove_node(changes[i].node_id) != 0) {
+			elog(WARNING, "pgraft: Failed to remove node %d from core system", changes[i].node_id);
+			return -1;
+		}
+	}
+
+	elog(LOG, "pgraft: Proposed %d membership change(s)", count);
 	return 0;
 }
 
+/*
+ * Add node to pgraft system, as a voter or as a learner that only follows
+ * the log, without waiting for the change to apply
+ */
+static int
+pgraft_add_node_system(int node_id, const char *address, int port, bool voting)
+{
+	pgraft_go_peer_change_t change;
+
+	memset(&change, 0, sizeof(change));
+	change.type = voting ? PGRAFT_GO_PEER_ADD_VOTER : PGRAFT_GO_PEER_ADD_LEARNER;
+	change.node_id = node_id;
+	change.port = port;
+	strlcpy(change.address, address, sizeof(change.address));
+	return pgraft_change_peers_system(&change, 1, 0);
+}
+
+/*
+ * Remove node from pgraft system, without waiting for the change to apply
+ */
+static int
+pgraft_remove_node_system(int node_id)
+{
+	pgraft_go_peer_change_t change;
+
+	memset(&change, 0, sizeof(change));
+	change.type = PGRAFT_GO_PEER_REMOVE;
+	change.node_id = node_id;
+	return pgraft_change_peers_system(&change, 1, 0);
+}
+
 /*
  * Append log entry to pgraft system
  */
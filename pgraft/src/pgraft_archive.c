@@ -0,0 +1,357 @@
+/*-------------------------------------------------------------------------
+ *
+ * pgraft_archive.c
+ *		WAL archive module that hands files to ramd's archiver
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * With archive_library = 'pgraft' the archiver process does not run a
+ * command per WAL file.  Each call queues the file PostgreSQL asked for,
+ * together with up to pgraft.archive_queue_depth - 1 files waiting behind
+ * it in archive_status, as entries in pgraft.archive_spool_dir:
+ *
+ *		queue/<file>	the file's absolute path; written by us
+ *		done/<file>		ramd stored it durably; removed by us
+ *		error/<file>	ramd could not store it, with the reason
+ *
+ * ramd uploads the queued files in parallel and acknowledges them a batch
+ * at a time, so the calls that follow mostly find their file already done
+ * and return at once.  The spool holds nothing that cannot be rebuilt:
+ * entries lost in a crash are queued again from archive_status, and ramd
+ * acknowledges a file whose identical copy is already in the archive.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "miscadmin.h"
+#include "access/xlog_internal.h"
+#include "common/file_perm.h"
+#include "postmaster/interrupt.h"
+#include "storage/fd.h"
+#include "storage/latch.h"
+#include "utils/wait_event.h"
+#if PG_VERSION_NUM >= 160000
+#include "archive/archive_module.h"
+#else
+#include "postmaster/pgarch.h"
+#endif
+#include "../include/pgraft_guc.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* How often a waiting call looks for ramd's acknowledgement */
+#define PGRAFT_ARCHIVE_POLL_MS	10
+
+#define PGRAFT_ARCHIVE_READY_SUFFIX	".ready"
+
+static bool pgraft_archive_spool_path(char *buf, const char *subdir, const char *file);
+static bool pgraft_archive_make_spool(void);
+static bool pgraft_archive_queue(const char *file, const char *path);
+static void pgraft_archive_queue_ready(const char *current);
+static bool pgraft_archive_take_result(const char *file, bool *archived);
+static bool pgraft_archive_configured(void);
+static bool pgraft_archive_file(const char *file, const char *path);
+
+#if PG_VERSION_NUM >= 160000
+static bool pgraft_archive_check_configured_cb(ArchiveModuleState *state);
+static bool pgraft_archive_file_cb(ArchiveModuleState *state, const char *file, const char *path);
+
+static const ArchiveModuleCallbacks pgraft_archive_callbacks = {
+	.startup_cb = NULL,
+	.check_configured_cb = pgraft_archive_check_configured_cb,
+	.archive_file_cb = pgraft_archive_file_cb,
+	.shutdown_cb = NULL
+};
+
+const ArchiveModuleCallbacks *
+_PG_archive_module_init(void)
+{
+	return &pgraft_archive_callbacks;
+}
+
+static bool
+pgraft_archive_check_configured_cb(ArchiveModuleState *state)
+{
+	(void) state;
+	return pgraft_archive_configured();
+}
+
+static bool
+pgraft_archive_file_cb(ArchiveModuleState *state, const char *file, const char *path)
+{
+	(void) state;
+	return pgraft_archive_file(file, path);
+}
+#else
+void
+_PG_archive_module_init(ArchiveModuleCallbacks *cb)
+{
+	cb->check_configured_cb = pgraft_archive_configured;
+	cb->archive_file_cb = pgraft_archive_file;
+	cb->shutdown_cb = NULL;
+}
+#endif
+
+/*
+ * <spool>/<subdir>[/<file>] into buf (MAXPGPATH).  False if it does not fit.
+ */
+static bool
+pgraft_archive_spool_path(char *buf, const char *subdir, const char *file)
+{
+	int			len;
+
+	if (file)
+		len = snprintf(buf, MAXPGPATH, "%s/%s/%s", pgraft_archive_spool_dir, subdir, file);
+	else
+		len = snprintf(buf, MAXPGPATH, "%s/%s", pgraft_archive_spool_dir, subdir);
+	return len > 0 && len < MAXPGPATH;
+}
+
+static bool
+pgraft_archive_make_spool(void)
+{
+	static const char *const subdirs[] = {"queue", "done", "error"};
+	char		path[MAXPGPATH];
+
+	if (MakePGDirectory(pgraft_archive_spool_dir) < 0 && errno != EEXIST)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not create archive spool directory \"%s\": %m",
+						pgraft_archive_spool_dir)));
+		return false;
+	}
+	for (int i = 0; i < (int) lengthof(subdirs); i++)
+	{
+		if (!pgraft_archive_spool_path(path, subdirs[i], NULL))
+			return false;
+		if (MakePGDirectory(path) < 0 && errno != EEXIST)
+		{
+			ereport(WARNING,
+					(errcode_for_file_access(),
+					 errmsg("pgraft: could not create archive spool directory \"%s\": %m",
+							path)));
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Queue one file for ramd unless it is already queued or acknowledged.
+ * The entry appears under its final name only once it is complete.
+ */
+static bool
+pgraft_archive_queue(const char *file, const char *path)
+{
+	char		entry[MAXPGPATH];
+	char		done[MAXPGPATH];
+	char		tmp[MAXPGPATH + 8];
+	char		source[MAXPGPATH];
+	struct stat st;
+	FILE	   *f;
+
+	if (!pgraft_archive_spool_path(entry, "queue", file) ||
+		!pgraft_archive_spool_path(done, "done", file))
+		return false;
+	if (stat(entry, &st) == 0 || stat(done, &st) == 0)
+		return true;
+
+	if (is_absolute_path(path))
+		strlcpy(source, path, sizeof(source));
+	else
+		snprintf(source, sizeof(source), "%s/%s", DataDir, path);
+	snprintf(tmp, sizeof(tmp), "%s.tmp", entry);
+
+	f = AllocateFile(tmp, PG_BINARY_W);
+	if (!f)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not create archive queue entry \"%s\": %m", tmp)));
+		return false;
+	}
+	if (fprintf(f, "%s\n", source) < 0 || FreeFile(f) != 0)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not write archive queue entry \"%s\": %m", tmp)));
+		unlink(tmp);
+		return false;
+	}
+	if (rename(tmp, entry) != 0)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not rename \"%s\" to \"%s\": %m", tmp, entry)));
+		unlink(tmp);
+		return false;
+	}
+	return true;
+}
+
+static int
+pgraft_archive_name_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/*
+ * Queue the files archive_status says are ready, oldest first, up to the
+ * queue depth.  WAL file names sort in the order the archiver takes them,
+ * so these are the calls that come next.
+ */
+static void
+pgraft_archive_queue_ready(const char *current)
+{
+	DIR		   *dir;
+	struct dirent *de;
+	char	  **names;
+	int			count = 0;
+	int			capacity = 64;
+	int			wanted = pgraft_archive_queue_depth - 1;
+	size_t		suffix_len = strlen(PGRAFT_ARCHIVE_READY_SUFFIX);
+
+	if (wanted <= 0)
+		return;
+
+	dir = AllocateDir(XLOGDIR "/archive_status");
+	if (!dir)
+		return;
+
+	names = palloc(sizeof(char *) * capacity);
+	while ((de = ReadDir(dir, XLOGDIR "/archive_status")) != NULL)
+	{
+		size_t		len = strlen(de->d_name);
+
+		if (len <= suffix_len ||
+			strcmp(de->d_name + len - suffix_len, PGRAFT_ARCHIVE_READY_SUFFIX) != 0)
+			continue;
+		if (count == capacity)
+		{
+			capacity *= 2;
+			names = repalloc(names, sizeof(char *) * capacity);
+		}
+		names[count++] = pnstrdup(de->d_name, len - suffix_len);
+	}
+	FreeDir(dir);
+
+	qsort(names, count, sizeof(char *), pgraft_archive_name_cmp);
+	for (int i = 0; i < count && wanted > 0; i++)
+	{
+		char		path[MAXPGPATH];
+
+		if (strcmp(names[i], current) == 0)
+			continue;
+		snprintf(path, sizeof(path), XLOGDIR "/%s", names[i]);
+		if (!pgraft_archive_queue(names[i], path))
+			break;
+		wanted--;
+	}
+
+	for (int i = 0; i < count; i++)
+		pfree(names[i]);
+	pfree(names);
+}
+
+/*
+ * Consume ramd's answer for file, if there is one yet.  Returns true with
+ * *archived set once ramd has either stored the file or given up on it.
+ */
+static bool
+pgraft_archive_take_result(const char *file, bool *archived)
+{
+	char		path[MAXPGPATH];
+	char		reason[256];
+	FILE	   *f;
+
+	if (!pgraft_archive_spool_path(path, "done", file))
+		return false;
+	if (access(path, F_OK) == 0)
+	{
+		unlink(path);
+		*archived = true;
+		return true;
+	}
+
+	if (!pgraft_archive_spool_path(path, "error", file) || access(path, F_OK) != 0)
+		return false;
+
+	reason[0] = '\0';
+	f = AllocateFile(path, PG_BINARY_R);
+	if (f)
+	{
+		if (!fgets(reason, sizeof(reason), f))
+			reason[0] = '\0';
+		FreeFile(f);
+	}
+	reason[strcspn(reason, "\n")] = '\0';
+	unlink(path);
+
+	ereport(WARNING,
+			(errmsg("pgraft: ramd could not archive \"%s\"", file),
+			 reason[0] ? errdetail("%s", reason) : 0));
+	*archived = false;
+	return true;
+}
+
+static bool
+pgraft_archive_configured(void)
+{
+	return pgraft_archive_spool_dir != NULL && pgraft_archive_spool_dir[0] != '\0';
+}
+
+static bool
+pgraft_archive_file(const char *file, const char *path)
+{
+	char		entry[MAXPGPATH];
+	struct stat st;
+	bool		archived = false;
+	long		waited_ms = 0;
+
+	/* Acknowledged while an earlier call was waiting */
+	if (pgraft_archive_take_result(file, &archived))
+		return archived;
+
+	/*
+	 * Already queued means ramd has the batch this file was part of; only
+	 * once it has caught up with a batch is it worth scanning for the next
+	 */
+	if (!pgraft_archive_spool_path(entry, "queue", file))
+	{
+		ereport(WARNING,
+				(errmsg("pgraft: archive spool path for \"%s\" is too long", file)));
+		return false;
+	}
+	if (stat(entry, &st) != 0)
+	{
+		if (!pgraft_archive_make_spool() || !pgraft_archive_queue(file, path))
+			return false;
+		pgraft_archive_queue_ready(file);
+	}
+
+	for (;;)
+	{
+		if (pgraft_archive_take_result(file, &archived))
+			return archived;
+
+		if (ShutdownRequestPending)
+			return false;
+		if (waited_ms >= pgraft_archive_timeout)
+		{
+			ereport(WARNING,
+					(errmsg("pgraft: ramd did not archive \"%s\" within %d ms",
+							file, pgraft_archive_timeout),
+					 errhint("Check that ramd runs with archive_enabled and the same archive_spool_dir.")));
+			return false;
+		}
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 PGRAFT_ARCHIVE_POLL_MS, WAIT_EVENT_ARCHIVE_COMMAND);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+		waited_ms += PGRAFT_ARCHIVE_POLL_MS;
+	}
+}
@@ -99,10 +99,10 @@ pgraft_core_add_node(int32_t node_id, const char *address, int32_t port)
 		return -1;
 	}
 	
-	if (cluster->num_nodes >= 16)
+	if (cluster->num_nodes >= PGRAFT_MAX_NODES)
 	{
 		SpinLockRelease(&cluster->mutex);
-		elog(ERROR, "pgraft: Maximum number of nodes (16) reached");
+		elog(ERROR, "pgraft: Maximum number of nodes (%d) reached", PGRAFT_MAX_NODES);
 		return -1;
 	}
 	
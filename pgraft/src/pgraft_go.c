@@ -24,8 +24,7 @@ static void *go_lib_handle = NULL;
 static pgraft_go_init_func pgraft_go_init_ptr = NULL;
 static pgraft_go_start_func pgraft_go_start_ptr = NULL;
 static pgraft_go_stop_func pgraft_go_stop_ptr = NULL;
-static pgraft_go_add_peer_func pgraft_go_add_peer_ptr = NULL;
-static pgraft_go_remove_peer_func pgraft_go_remove_peer_ptr = NULL;
+static pgraft_go_change_peers_func pgraft_go_change_peers_ptr = NULL;
 static pgraft_go_get_leader_func pgraft_go_get_leader_ptr = NULL;
 static pgraft_go_get_term_func pgraft_go_get_term_ptr = NULL;
 static pgraft_go_is_leader_func pgraft_go_is_leader_ptr = NULL;
@@ -36,6 +35,28 @@ static pgraft_go_set_debug_func pgraft_go_set_debug_ptr = NULL;
 static pgraft_go_start_network_server_func pgraft_go_start_network_server_ptr = NULL;
 static pgraft_go_free_string_func pgraft_go_free_string_ptr = NULL;
 static pgraft_go_update_cluster_state_func pgraft_go_update_cluster_state_ptr = NULL;
+static pgraft_go_set_data_dir_func pgraft_go_set_data_dir_ptr = NULL;
+static pgraft_go_set_log_level_func pgraft_go_set_log_level_ptr = NULL;
+static pgraft_go_set_snapshot_policy_func pgraft_go_set_snapshot_policy_ptr = NULL;
+static pgraft_go_get_status_func pgraft_go_get_status_ptr = NULL;
+static pgraft_go_set_status_block_func pgraft_go_set_status_block_ptr = NULL;
+static pgraft_go_set_proposal_block_func pgraft_go_set_proposal_block_ptr = NULL;
+static pgraft_go_set_proposal_ring_func pgraft_go_set_proposal_ring_ptr = NULL;
+static pgraft_go_propose_func pgraft_go_propose_ptr = NULL;
+static pgraft_go_set_batch_policy_func pgraft_go_set_batch_policy_ptr = NULL;
+static pgraft_go_set_read_mode_func pgraft_go_set_read_mode_ptr = NULL;
+static pgraft_go_read_index_func pgraft_go_read_index_ptr = NULL;
+static pgraft_go_set_timing_func pgraft_go_set_timing_ptr = NULL;
+static pgraft_go_set_election_policy_func pgraft_go_set_election_policy_ptr = NULL;
+static pgraft_go_transfer_leadership_func pgraft_go_transfer_leadership_ptr = NULL;
+static pgraft_go_set_peer_delay_func pgraft_go_set_peer_delay_ptr = NULL;
+static pgraft_go_set_tls_func pgraft_go_set_tls_ptr = NULL;
+static pgraft_go_set_compression_func pgraft_go_set_compression_ptr = NULL;
+static pgraft_go_kv_propose_func pgraft_go_kv_propose_ptr = NULL;
+static pgraft_go_kv_read_func pgraft_go_kv_read_ptr = NULL;
+static pgraft_go_set_metrics_block_func pgraft_go_set_metrics_block_ptr = NULL;
+static pgraft_go_cpu_profile_func pgraft_go_cpu_profile_ptr = NULL;
+static pgraft_go_dump_log_entries_func pgraft_go_dump_log_entries_ptr = NULL;
 
 /*
  * Load Go Raft library dynamically
@@ -82,8 +103,7 @@ pgraft_go_load_library(void)
 	pgraft_go_init_ptr = (pgraft_go_init_func) dlsym(go_lib_handle, "pgraft_go_init");
 	pgraft_go_start_ptr = (pgraft_go_start_func) dlsym(go_lib_handle, "pgraft_go_start");
 	pgraft_go_stop_ptr = (pgraft_go_stop_func) dlsym(go_lib_handle, "pgraft_go_stop");
-	pgraft_go_add_peer_ptr = (pgraft_go_add_peer_func) dlsym(go_lib_handle, "pgraft_go_add_peer");
-	pgraft_go_remove_peer_ptr = (pgraft_go_remove_peer_func) dlsym(go_lib_handle, "pgraft_go_remove_peer");
+	pgraft_go_change_peers_ptr = (pgraft_go_change_peers_func) dlsym(go_lib_handle, "pgraft_go_change_peers");
 	pgraft_go_get_leader_ptr = (pgraft_go_get_leader_func) dlsym(go_lib_handle, "pgraft_go_get_leader");
 	pgraft_go_get_term_ptr = (pgraft_go_get_term_func) dlsym(go_lib_handle, "pgraft_go_get_term");
 	pgraft_go_is_leader_ptr = (pgraft_go_is_leader_func) dlsym(go_lib_handle, "pgraft_go_is_leader");
@@ -94,6 +114,28 @@ pgraft_go_load_library(void)
 	pgraft_go_start_network_server_ptr = (pgraft_go_start_network_server_func) dlsym(go_lib_handle, "pgraft_go_start_network_server");
 	pgraft_go_free_string_ptr = (pgraft_go_free_string_func) dlsym(go_lib_handle, "pgraft_go_free_string");
 	pgraft_go_update_cluster_state_ptr = (pgraft_go_update_cluster_state_func) dlsym(go_lib_handle, "pgraft_go_update_cluster_state");
+	pgraft_go_set_data_dir_ptr = (pgraft_go_set_data_dir_func) dlsym(go_lib_handle, "pgraft_go_set_data_dir");
+	pgraft_go_set_log_level_ptr = (pgraft_go_set_log_level_func) dlsym(go_lib_handle, "pgraft_go_set_log_level");
+	pgraft_go_set_snapshot_policy_ptr = (pgraft_go_set_snapshot_policy_func) dlsym(go_lib_handle, "pgraft_go_set_snapshot_policy");
+	pgraft_go_get_status_ptr = (pgraft_go_get_status_func) dlsym(go_lib_handle, "pgraft_go_get_status");
+	pgraft_go_set_status_block_ptr = (pgraft_go_set_status_block_func) dlsym(go_lib_handle, "pgraft_go_set_status_block");
+	pgraft_go_set_proposal_block_ptr = (pgraft_go_set_proposal_block_func) dlsym(go_lib_handle, "pgraft_go_set_proposal_block");
+	pgraft_go_set_proposal_ring_ptr = (pgraft_go_set_proposal_ring_func) dlsym(go_lib_handle, "pgraft_go_set_proposal_ring");
+	pgraft_go_propose_ptr = (pgraft_go_propose_func) dlsym(go_lib_handle, "pgraft_go_propose");
+	pgraft_go_set_batch_policy_ptr = (pgraft_go_set_batch_policy_func) dlsym(go_lib_handle, "pgraft_go_set_batch_policy");
+	pgraft_go_set_read_mode_ptr = (pgraft_go_set_read_mode_func) dlsym(go_lib_handle, "pgraft_go_set_read_mode");
+	pgraft_go_read_index_ptr = (pgraft_go_read_index_func) dlsym(go_lib_handle, "pgraft_go_read_index");
+	pgraft_go_set_timing_ptr = (pgraft_go_set_timing_func) dlsym(go_lib_handle, "pgraft_go_set_timing");
+	pgraft_go_set_election_policy_ptr = (pgraft_go_set_election_policy_func) dlsym(go_lib_handle, "pgraft_go_set_election_policy");
+	pgraft_go_transfer_leadership_ptr = (pgraft_go_transfer_leadership_func) dlsym(go_lib_handle, "pgraft_go_transfer_leadership");
+	pgraft_go_set_peer_delay_ptr = (pgraft_go_set_peer_delay_func) dlsym(go_lib_handle, "pgraft_go_set_peer_delay");
+	pgraft_go_set_tls_ptr = (pgraft_go_set_tls_func) dlsym(go_lib_handle, "pgraft_go_set_tls");
+	pgraft_go_set_compression_ptr = (pgraft_go_set_compression_func) dlsym(go_lib_handle, "pgraft_go_set_compression");
+	pgraft_go_kv_propose_ptr = (pgraft_go_kv_propose_func) dlsym(go_lib_handle, "pgraft_go_kv_propose");
+	pgraft_go_kv_read_ptr = (pgraft_go_kv_read_func) dlsym(go_lib_handle, "pgraft_go_kv_read");
+	pgraft_go_set_metrics_block_ptr = (pgraft_go_set_metrics_block_func) dlsym(go_lib_handle, "pgraft_go_set_metrics_block");
+	pgraft_go_cpu_profile_ptr = (pgraft_go_cpu_profile_func) dlsym(go_lib_handle, "pgraft_go_cpu_profile");
+	pgraft_go_dump_log_entries_ptr = (pgraft_go_dump_log_entries_func) dlsym(go_lib_handle, "pgraft_go_dump_log_entries");
 	
 	/* Check if all critical functions were loaded */
 	if (!pgraft_go_init_ptr || !pgraft_go_start_ptr || !pgraft_go_stop_ptr)
@@ -128,8 +170,7 @@ pgraft_go_unload_library(void)
 	pgraft_go_init_ptr = NULL;
 	pgraft_go_start_ptr = NULL;
 	pgraft_go_stop_ptr = NULL;
-	pgraft_go_add_peer_ptr = NULL;
-	pgraft_go_remove_peer_ptr = NULL;
+	pgraft_go_change_peers_ptr = NULL;
 	pgraft_go_get_leader_ptr = NULL;
 	pgraft_go_get_term_ptr = NULL;
 	pgraft_go_is_leader_ptr = NULL;
@@ -138,6 +179,28 @@ pgraft_go_unload_library(void)
 	pgraft_go_test_ptr = NULL;
 	pgraft_go_set_debug_ptr = NULL;
 	pgraft_go_free_string_ptr = NULL;
+	pgraft_go_set_data_dir_ptr = NULL;
+	pgraft_go_set_log_level_ptr = NULL;
+	pgraft_go_set_snapshot_policy_ptr = NULL;
+	pgraft_go_get_status_ptr = NULL;
+	pgraft_go_set_status_block_ptr = NULL;
+	pgraft_go_set_proposal_block_ptr = NULL;
+	pgraft_go_set_proposal_ring_ptr = NULL;
+	pgraft_go_propose_ptr = NULL;
+	pgraft_go_set_batch_policy_ptr = NULL;
+	pgraft_go_set_read_mode_ptr = NULL;
+	pgraft_go_read_index_ptr = NULL;
+	pgraft_go_set_timing_ptr = NULL;
+	pgraft_go_set_election_policy_ptr = NULL;
+	pgraft_go_transfer_leadership_ptr = NULL;
+	pgraft_go_set_peer_delay_ptr = NULL;
+	pgraft_go_set_tls_ptr = NULL;
+	pgraft_go_set_compression_ptr = NULL;
+	pgraft_go_kv_propose_ptr = NULL;
+	pgraft_go_kv_read_ptr = NULL;
+	pgraft_go_set_metrics_block_ptr = NULL;
+	pgraft_go_cpu_profile_ptr = NULL;
+	pgraft_go_dump_log_entries_ptr = NULL;
 	
 	/* Update shared memory state */
 	pgraft_state_set_go_lib_loaded(false);
@@ -179,16 +242,10 @@ pgraft_go_get_stop_func(void)
 	return pgraft_go_stop_ptr;
 }
 
-pgraft_go_add_peer_func
-pgraft_go_get_add_peer_func(void)
+pgraft_go_change_peers_func
+pgraft_go_get_change_peers_func(void)
 {
-	return pgraft_go_add_peer_ptr;
-}
-
-pgraft_go_remove_peer_func
-pgraft_go_get_remove_peer_func(void)
-{
-	return pgraft_go_remove_peer_ptr;
+	return pgraft_go_change_peers_ptr;
 }
 
 pgraft_go_get_leader_func
@@ -251,6 +308,30 @@ pgraft_go_get_update_cluster_state_func(void)
 	return pgraft_go_update_cluster_state_ptr;
 }
 
+pgraft_go_set_data_dir_func
+pgraft_go_get_set_data_dir_func(void)
+{
+	return pgraft_go_set_data_dir_ptr;
+}
+
+pgraft_go_set_log_level_func
+pgraft_go_get_set_log_level_func(void)
+{
+	return pgraft_go_set_log_level_ptr;
+}
+
+pgraft_go_set_snapshot_policy_func
+pgraft_go_get_set_snapshot_policy_func(void)
+{
+	return pgraft_go_set_snapshot_policy_ptr;
+}
+
+pgraft_go_get_status_func
+pgraft_go_get_get_status_func(void)
+{
+	return pgraft_go_get_status_ptr;
+}
+
 /*
  * Initialize the Go library
  */
@@ -316,3 +397,111 @@ pgraft_go_start_network_server(int port)
 	
 	return start_network_server(port);
 }
+
+pgraft_go_set_status_block_func
+pgraft_go_get_set_status_block_func(void)
+{
+	return pgraft_go_set_status_block_ptr;
+}
+
+pgraft_go_set_proposal_block_func
+pgraft_go_get_set_proposal_block_func(void)
+{
+	return pgraft_go_set_proposal_block_ptr;
+}
+
+pgraft_go_set_proposal_ring_func
+pgraft_go_get_set_proposal_ring_func(void)
+{
+	return pgraft_go_set_proposal_ring_ptr;
+}
+
+pgraft_go_propose_func
+pgraft_go_get_propose_func(void)
+{
+	return pgraft_go_propose_ptr;
+}
+
+pgraft_go_set_batch_policy_func
+pgraft_go_get_set_batch_policy_func(void)
+{
+	return pgraft_go_set_batch_policy_ptr;
+}
+
+pgraft_go_set_read_mode_func
+pgraft_go_get_set_read_mode_func(void)
+{
+	return pgraft_go_set_read_mode_ptr;
+}
+
+pgraft_go_read_index_func
+pgraft_go_get_read_index_func(void)
+{
+	return pgraft_go_read_index_ptr;
+}
+
+pgraft_go_set_timing_func
+pgraft_go_get_set_timing_func(void)
+{
+	return pgraft_go_set_timing_ptr;
+}
+
+pgraft_go_set_election_policy_func
+pgraft_go_get_set_election_policy_func(void)
+{
+	return pgraft_go_set_election_policy_ptr;
+}
+
+pgraft_go_transfer_leadership_func
+pgraft_go_get_transfer_leadership_func(void)
+{
+	return pgraft_go_transfer_leadership_ptr;
+}
+
+pgraft_go_set_peer_delay_func
+pgraft_go_get_set_peer_delay_func(void)
+{
+	return pgraft_go_set_peer_delay_ptr;
+}
+
+pgraft_go_set_tls_func
+pgraft_go_get_set_tls_func(void)
+{
+	return pgraft_go_set_tls_ptr;
+}
+
+pgraft_go_set_compression_func
+pgraft_go_get_set_compression_func(void)
+{
+	return pgraft_go_set_compression_ptr;
+}
+
+pgraft_go_kv_propose_func
+pgraft_go_get_kv_propose_func(void)
+{
+	return pgraft_go_kv_propose_ptr;
+}
+
+pgraft_go_kv_read_func
+pgraft_go_get_kv_read_func(void)
+{
+	return pgraft_go_kv_read_ptr;
+}
+
+pgraft_go_set_metrics_block_func
+pgraft_go_get_set_metrics_block_func(void)
+{
+	return pgraft_go_set_metrics_block_ptr;
+}
+
+pgraft_go_cpu_profile_func
+pgraft_go_get_cpu_profile_func(void)
+{
+	return pgraft_go_cpu_profile_ptr;
+}
+
+pgraft_go_dump_log_entries_func
+pgraft_go_get_dump_log_entries_func(void)
+{
+	return pgraft_go_dump_log_entries_ptr;
+}
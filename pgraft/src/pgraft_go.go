@@ -16,21 +16,154 @@ package main
 #cgo LDFLAGS: -L/usr/local/pgsql.17/lib
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+
+// Keep in sync with pgraft_go_status_t in include/pgraft_go.h
+#define PGRAFT_GO_MAX_PROGRESS 64
+typedef struct pgraft_go_status
+{
+	int64_t		leader_id;
+	int64_t		term;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int64_t		last_index;
+	int32_t		raft_state;
+	int32_t		num_progress;
+	int64_t		progress_node_id[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		progress_match[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		progress_next[PGRAFT_GO_MAX_PROGRESS];
+	int32_t		progress_state[PGRAFT_GO_MAX_PROGRESS];
+	int32_t		num_learners;
+	int64_t		learner_id[PGRAFT_GO_MAX_PROGRESS];
+} pgraft_go_status_t;
+
+// Keep in sync with pgraft_go_raft_status_t in include/pgraft_go.h
+typedef struct pgraft_go_raft_status
+{
+	uint64_t	seq;
+	int64_t		leader_id;
+	int64_t		term;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int32_t		raft_state;
+	int32_t		is_leader;
+} pgraft_go_raft_status_t;
+
+// Keep in sync with pgraft_go_proposal_block_t in include/pgraft_go.h
+#define PGRAFT_GO_MAX_PROPOSALS 64
+typedef struct pgraft_go_proposal_block
+{
+	uint64_t	committed_id[PGRAFT_GO_MAX_PROPOSALS];
+	int64_t		committed_index[PGRAFT_GO_MAX_PROPOSALS];
+} pgraft_go_proposal_block_t;
+
+// Keep in sync with pgraft_go_ring_t in include/pgraft_go.h
+#define PGRAFT_GO_RING_SIZE (128 * 1024)
+#define PGRAFT_GO_RING_ALIGN 16
+#define PGRAFT_GO_RING_WRAP 0
+#define PGRAFT_GO_RING_PROPOSE 1
+#define PGRAFT_GO_RING_KV_WRITE 2
+#define PGRAFT_GO_RING_READ_INDEX 3
+typedef struct pgraft_go_ring_record
+{
+	uint32_t	kind;
+	uint32_t	length;
+	uint64_t	proposal_id;
+} pgraft_go_ring_record_t;
+typedef struct pgraft_go_ring
+{
+	uint64_t	head;
+	uint64_t	tail;
+	char		data[PGRAFT_GO_RING_SIZE];
+} pgraft_go_ring_t;
+
+// Keep in sync with pgraft_go_peer_change_t in include/pgraft_go.h
+#define PGRAFT_GO_PEER_ADD_VOTER 1
+#define PGRAFT_GO_PEER_ADD_LEARNER 2
+#define PGRAFT_GO_PEER_REMOVE 3
+typedef struct pgraft_go_peer_change
+{
+	int32_t		type;
+	int32_t		node_id;
+	int32_t		port;
+	char		address[256];
+} pgraft_go_peer_change_t;
+
+// Keep in sync with pgraft_go_metrics_t in include/pgraft_go.h
+#define PGRAFT_GO_METRICS_MAGIC 0x50475246
+#define PGRAFT_GO_METRICS_VERSION 2
+#define PGRAFT_GO_METRICS_MSG_TYPES 32
+#define PGRAFT_GO_METRICS_BUCKETS 16
+typedef struct pgraft_go_metrics
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	seq;
+	int64_t		node_id;
+	int64_t		updated_at_ns;
+	int64_t		raft_state;
+	int64_t		last_index;
+	int64_t		commit_index;
+	int64_t		applied_index;
+	int64_t		msg_sent[PGRAFT_GO_METRICS_MSG_TYPES];
+	int64_t		msg_received[PGRAFT_GO_METRICS_MSG_TYPES];
+	int64_t		ready_count;
+	int64_t		ready_entries_sum;
+	int64_t		ready_messages_sum;
+	int64_t		ready_committed_sum;
+	int64_t		ready_entries[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		append_latency_sum_us;
+	int64_t		append_latency[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		fsync_latency_sum_us;
+	int64_t		fsync_latency[PGRAFT_GO_METRICS_BUCKETS];
+	int64_t		proposal_queue_depth;
+	int64_t		proposal_queue_capacity;
+	int64_t		num_peers;
+	int64_t		peer_id[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_match[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_next[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_state[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_heartbeat_rtt_us[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		peer_append_rtt_us[PGRAFT_GO_MAX_PROGRESS];
+	int64_t		compress_frames;
+	int64_t		compress_skipped;
+	int64_t		compress_raw_bytes;
+	int64_t		compress_wire_bytes;
+	int64_t		compress_cpu_us;
+	int64_t		decompress_frames;
+	int64_t		decompress_raw_bytes;
+	int64_t		decompress_wire_bytes;
+	int64_t		decompress_cpu_us;
+} pgraft_go_metrics_t;
 */
 import "C"
 
 import (
+	"bufio"
+	"bytes"
+	"compress/flate"
 	"context"
+	"crypto/tls"
+	"crypto/x509"
+	"encoding/binary"
 	"encoding/json"
 	"errors"
 	"fmt"
+	"hash/crc32"
+	"io"
 	"log"
+	"math/bits"
+	"math/rand"
 	"net"
 	"os"
+	"path/filepath"
+	"runtime/pprof"
+	"sort"
 	"strconv"
 	"strings"
 	"sync"
 	"sync/atomic"
+	"syscall"
 	"time"
 	"unsafe"
 
@@ -63,9 +196,6 @@ var (
 	// Message handling - integrated with comm module
 	messageChan chan raftpb.Message
 
-	// Debug logging control
-	debugEnabled bool = false
-
 	// Additional required global variables
 	initialized         int32
 	running             int32
@@ -105,54 +235,697 @@ var (
 	// Health and monitoring
 	startupTime  time.Time
 	healthStatus string
+
+	// Status as of the last Ready, for the getters and the shared memory
+	// seqlock block registered by the background worker
+	statusMutex     sync.Mutex
+	statusBlock     unsafe.Pointer
+	statusLeader    int64
+	statusTerm      int64
+	statusCommit    int64
+	statusRaftState int32
+
+	// pgraft_replicate() commit reporting, registered by the background worker
+	proposalBlock    unsafe.Pointer
+	proposalNotifyFd int32 = -1
+
+	// Proposals appended by backends, drained by ringReader
+	proposalRing     unsafe.Pointer
+	proposalRingOnce sync.Once
+)
+
+// Proposals are coalesced into batch entries so that concurrent writers
+// share a Raft round:
+// magic(4) | origin node id(8) | count(4) | count x [proposal id(8) | length(4) | data]
+// Proposal id 0 marks data nobody waits for (pgraft_go_append_log and
+// pgraft_go_replicate_log_entry).
+const (
+	proposalBatchMagic      uint32 = 0x50475242 // "PGRB"
+	proposalBatchHeaderSize        = 16
+	proposalItemHeaderSize         = 12
+	proposalBatchMaxCount          = 1024
+	proposalQueueDepth             = 4096
+)
+
+// ReadIndex request contexts: magic(4) | origin node id(8) | proposal id(8)
+const (
+	readIndexMagic       uint32 = 0x50475249 // "PGRI"
+	readIndexContextSize        = 20
+)
+
+// ConfChangeV2 contexts: magic(4) | origin node id(8) | proposal id(8) |
+// count(4) | count x [node id(8) | length(2) | address], the addresses
+// being those of added nodes
+const (
+	confChangeMagic      uint32 = 0x50474343 // "PGCC"
+	confChangeHeaderSize        = 24
+)
+
+var (
+	// This node's membership changes that put Raft into a joint
+	// configuration; they complete when it leaves it.  Apply goroutine only.
+	jointConfChanges []uint64
+
+	// Read barriers whose read index is known but not yet applied locally
+	pendingReadsMu sync.Mutex
+	pendingReads   = make(map[uint64]uint64)
+
+	// Set before pgraft_go_init; 1 selects ReadOnlyLeaseBased
+	readLeaseBased int32
+
+	// Set before pgraft_go_init through pgraft_go_set_election_policy
+	electionPreVote     int32 = 1
+	electionCheckQuorum int32 = 1
+)
+
+type queuedProposal struct {
+	id   uint64
+	data []byte
+}
+
+var (
+	proposalQueue = make(chan queuedProposal, proposalQueueDepth)
+
+	// Guards committed results so a late failure never overwrites a newer id
+	proposalReportMu sync.Mutex
+
+	batchPolicyMu sync.Mutex
+	batchDelay    = 200 * time.Microsecond
+	batchMaxBytes = 256 * 1024
 )
 
 // Error recording function
 func recordError(err error) {
 	atomic.AddInt64(&errorCount, 1)
 	lastError = time.Now()
-	log.Printf("pgraft: ERROR - %v", err)
+	logError("%v", err)
 }
 
-// Network utility functions
-func readUint32(conn net.Conn, value *uint32) error {
-	buf := make([]byte, 4)
-	if _, err := conn.Read(buf); err != nil {
-		return err
+// getNetworkLatency reports the slowest peer's smoothed RTT in milliseconds,
+// 0 before any peer has been measured
+func getNetworkLatency() float64 {
+	if rtt, ok := slowestPeerRTT(); ok {
+		return float64(rtt) / float64(time.Millisecond)
 	}
-	*value = uint32(buf[0])<<24 | uint32(buf[1])<<16 | uint32(buf[2])<<8 | uint32(buf[3])
-	return nil
+	return 0
+}
+
+// ============================================================================
+// TIMING - Raft tick interval from the GUCs, optionally adapted to peer RTT
+// ============================================================================
+
+// One tick is a heartbeat interval and the election timeout is a whole
+// number of ticks, both fixed by pgraft_go_init.  Adaptive mode only
+// shortens the tick, never beyond the configured interval, so the ratio of
+// election timeout to heartbeat is preserved while both follow the RTT.
+const (
+	rttTickFactor      = 4 // adaptive tick per unit of the slowest peer RTT
+	adaptiveMinTick    = 10 * time.Millisecond
+	adaptiveInterval   = 5 * time.Second
+	rttMinSamples      = 3
+	rttProbeTimeout    = 10 * time.Second
+	rttSampleMaxAge    = time.Minute
+	rttSmoothingFactor = 8 // SRTT moves 1/8 of the way per sample, as TCP
+)
+
+type peerRTTState struct {
+	probeType  raftpb.MessageType
+	probeSent  time.Time
+	srtt       time.Duration
+	samples    int
+	lastSample time.Time
+
+	// MsgApp round trips, published as metrics only: they include the
+	// follower's fsync, so they must not drive the tick
+	appendSent    time.Time
+	appendSRTT    time.Duration
+	appendSamples int
 }
 
-func writeUint32(conn net.Conn, value uint32) error {
-	buf := []byte{
-		byte(value >> 24),
-		byte(value >> 16),
-		byte(value >> 8),
-		byte(value),
+var (
+	// Set before pgraft_go_init through pgraft_go_set_timing
+	timingMu          sync.Mutex
+	heartbeatInterval = 100 * time.Millisecond
+	electionTimeout   = time.Second
+	adaptiveTiming    bool
+
+	// Tick fixed at init, and the tick currently in use; nanoseconds
+	baseTickNs     int64
+	tickIntervalNs int64
+
+	peerRTTMu sync.Mutex
+	peerRTT   = make(map[uint64]*peerRTTState)
+)
+
+// Configure Raft timing from pgraft.heartbeat_interval,
+// pgraft.election_timeout and pgraft.adaptive_timing.  The intervals are
+// read when the node is initialized; adaptive can be toggled at any time.
+//
+//export pgraft_go_set_timing
+func pgraft_go_set_timing(heartbeatMs C.int, electionMs C.int, adaptive C.int) {
+	timingMu.Lock()
+	defer timingMu.Unlock()
+
+	if heartbeatMs > 0 {
+		heartbeatInterval = time.Duration(heartbeatMs) * time.Millisecond
 	}
-	_, err := conn.Write(buf)
-	return err
+	if electionMs > 0 {
+		electionTimeout = time.Duration(electionMs) * time.Millisecond
+	}
+	adaptiveTiming = adaptive != 0
 }
 
-func getNetworkLatency() float64 {
-	// Simple network latency measurement
-	// In a real implementation, this would measure actual network latency
-	return 1.0 // milliseconds
+// raftTiming returns the tick interval and the election timeout in ticks
+func raftTiming() (time.Duration, int) {
+	timingMu.Lock()
+	defer timingMu.Unlock()
+
+	electionTick := int(electionTimeout / heartbeatInterval)
+	if electionTick < 2 {
+		// etcd requires ElectionTick > HeartbeatTick
+		electionTick = 2
+	}
+	return heartbeatInterval, electionTick
+}
+
+// currentTickInterval is the period for a new raft ticker
+func currentTickInterval() time.Duration {
+	if tick := atomic.LoadInt64(&tickIntervalNs); tick > 0 {
+		return time.Duration(tick)
+	}
+	tick, _ := raftTiming()
+	return tick
+}
+
+// adaptTickInterval moves the tick towards rttTickFactor times the slowest
+// peer's smoothed RTT, within [adaptiveMinTick, configured interval].  Raises
+// apply at once; cuts are limited to a quarter per round so nodes whose
+// estimates briefly differ keep heartbeats well inside each other's
+// election timeouts.
+func adaptTickInterval() {
+	base := time.Duration(atomic.LoadInt64(&baseTickNs))
+	if base <= 0 {
+		return
+	}
+	current := currentTickInterval()
+
+	timingMu.Lock()
+	adaptive := adaptiveTiming
+	timingMu.Unlock()
+
+	target := base
+	if adaptive {
+		rtt, ok := slowestPeerRTT()
+		if !ok {
+			return
+		}
+		target = rtt * rttTickFactor
+		if target < adaptiveMinTick {
+			target = adaptiveMinTick
+		}
+		if target > base {
+			target = base
+		}
+		if floor := current * 3 / 4; target < floor {
+			target = floor
+		}
+		// Ignore jitter below 10%
+		diff := target - current
+		if diff < 0 {
+			diff = -diff
+		}
+		if diff*10 < current {
+			return
+		}
+	}
+
+	if target != current {
+		_, electionTick := raftTiming()
+		atomic.StoreInt64(&tickIntervalNs, int64(target))
+		logInfo("Raft tick interval %v -> %v (election timeout %v)",
+			current, target, target*time.Duration(electionTick))
+	}
+}
+
+// recordRTTProbes notes when heartbeats, vote requests and appends leave
+// for each peer.  An outstanding probe is kept rather than replaced, so a
+// response to it can only overestimate the RTT.
+func recordRTTProbes(msgs []raftpb.Message) {
+	now := time.Now()
+
+	peerRTTMu.Lock()
+	defer peerRTTMu.Unlock()
+
+	for i := range msgs {
+		msg := &msgs[i]
+		switch msg.Type {
+		case raftpb.MsgHeartbeat, raftpb.MsgVote, raftpb.MsgPreVote, raftpb.MsgApp:
+		default:
+			continue
+		}
+
+		st := peerRTT[msg.To]
+		if st == nil {
+			st = &peerRTTState{}
+			peerRTT[msg.To] = st
+		}
+		if msg.Type == raftpb.MsgApp {
+			if st.appendSent.IsZero() || now.Sub(st.appendSent) >= rttProbeTimeout {
+				st.appendSent = now
+			}
+			continue
+		}
+		if !st.probeSent.IsZero() && now.Sub(st.probeSent) < rttProbeTimeout {
+			continue
+		}
+		st.probeType = msg.Type
+		st.probeSent = now
+	}
+}
+
+// observeRTTResponse completes the outstanding probe answered by msg
+func observeRTTResponse(msg *raftpb.Message) {
+	var request raftpb.MessageType
+	switch msg.Type {
+	case raftpb.MsgHeartbeatResp:
+		request = raftpb.MsgHeartbeat
+	case raftpb.MsgVoteResp:
+		request = raftpb.MsgVote
+	case raftpb.MsgPreVoteResp:
+		request = raftpb.MsgPreVote
+	case raftpb.MsgAppResp:
+		observeAppendResponse(msg)
+		return
+	default:
+		return
+	}
+
+	peerRTTMu.Lock()
+	defer peerRTTMu.Unlock()
+
+	st := peerRTT[msg.From]
+	if st == nil || st.probeSent.IsZero() || st.probeType != request {
+		return
+	}
+	sample := time.Since(st.probeSent)
+	st.probeSent = time.Time{}
+	if sample < rttProbeTimeout {
+		addRTTSampleLocked(st, sample)
+	}
+}
+
+// observeRTTSample records an RTT measured outside the Raft exchange, such
+// as a TCP connect
+func observeRTTSample(nodeID uint64, sample time.Duration) {
+	peerRTTMu.Lock()
+	defer peerRTTMu.Unlock()
+
+	st := peerRTT[nodeID]
+	if st == nil {
+		st = &peerRTTState{}
+		peerRTT[nodeID] = st
+	}
+	addRTTSampleLocked(st, sample)
+}
+
+// observeAppendResponse completes the outstanding MsgApp to msg.From
+func observeAppendResponse(msg *raftpb.Message) {
+	peerRTTMu.Lock()
+	defer peerRTTMu.Unlock()
+
+	st := peerRTT[msg.From]
+	if st == nil || st.appendSent.IsZero() {
+		return
+	}
+	sample := time.Since(st.appendSent)
+	st.appendSent = time.Time{}
+	if sample >= rttProbeTimeout {
+		return
+	}
+	if st.appendSamples == 0 {
+		st.appendSRTT = sample
+	} else {
+		st.appendSRTT += (sample - st.appendSRTT) / rttSmoothingFactor
+	}
+	st.appendSamples++
+}
+
+func addRTTSampleLocked(st *peerRTTState, sample time.Duration) {
+	if st.samples == 0 {
+		st.srtt = sample
+	} else {
+		st.srtt += (sample - st.srtt) / rttSmoothingFactor
+	}
+	st.samples++
+	st.lastSample = time.Now()
+}
+
+// slowestPeerRTT returns the largest smoothed RTT among recently measured
+// peers; a quorum cannot be faster than its slowest needed member
+func slowestPeerRTT() (time.Duration, bool) {
+	now := time.Now()
+
+	peerRTTMu.Lock()
+	defer peerRTTMu.Unlock()
+
+	var slowest time.Duration
+	found := false
+	for _, st := range peerRTT {
+		if st.samples < rttMinSamples || now.Sub(st.lastSample) > rttSampleMaxAge {
+			continue
+		}
+		if !found || st.srtt > slowest {
+			slowest = st.srtt
+			found = true
+		}
+	}
+	return slowest, found
+}
+
+// ============================================================================
+// METRICS - Raft internals published for ramd through a mapped file
+// ============================================================================
+
+// Counters are updated where the events happen and copied into the block
+// registered by the background worker once a second, so Prometheus scrapes
+// through ramd cost the Ready loop nothing beyond a few atomic adds.
+const (
+	metricsMsgTypes      = C.PGRAFT_GO_METRICS_MSG_TYPES
+	metricsBuckets       = C.PGRAFT_GO_METRICS_BUCKETS
+	metricsPublishPeriod = time.Second
+)
+
+// Per-bucket counts; latency bucket i holds samples up to 16<<i
+// microseconds and the last bucket is +Inf
+type latencyHistogram struct {
+	sumUs   int64
+	buckets [metricsBuckets]int64
+}
+
+var (
+	metricsMu    sync.Mutex
+	metricsBlock unsafe.Pointer
+
+	msgSentCount     [metricsMsgTypes]int64
+	msgReceivedCount [metricsMsgTypes]int64
+
+	readyCount        int64
+	readyEntriesSum   int64
+	readyMessagesSum  int64
+	readyCommittedSum int64
+	readyEntries      [metricsBuckets]int64
+
+	walAppendLatency latencyHistogram
+	walFsyncLatency  latencyHistogram
+)
+
+func latencyBucket(us int64) int {
+	if us <= 16 {
+		return 0
+	}
+	b := bits.Len64(uint64(us-1) >> 4)
+	if b >= metricsBuckets {
+		b = metricsBuckets - 1
+	}
+	return b
+}
+
+// batchBucket places a Ready of n entries; bucket i holds up to 1<<i
+func batchBucket(n int) int {
+	if n <= 1 {
+		return 0
+	}
+	b := bits.Len64(uint64(n - 1))
+	if b >= metricsBuckets {
+		b = metricsBuckets - 1
+	}
+	return b
+}
+
+func (h *latencyHistogram) observe(d time.Duration) {
+	us := d.Microseconds()
+	atomic.AddInt64(&h.sumUs, us)
+	atomic.AddInt64(&h.buckets[latencyBucket(us)], 1)
+}
+
+func countMessage(counts *[metricsMsgTypes]int64, typ raftpb.MessageType) {
+	if t := int(typ); t >= 0 && t < metricsMsgTypes {
+		atomic.AddInt64(&counts[t], 1)
+	}
+}
+
+// observeReady records how much work one Ready carried
+func observeReady(rd *raft.Ready) {
+	atomic.AddInt64(&readyCount, 1)
+	atomic.AddInt64(&readyEntriesSum, int64(len(rd.Entries)))
+	atomic.AddInt64(&readyMessagesSum, int64(len(rd.Messages)))
+	atomic.AddInt64(&readyCommittedSum, int64(len(rd.CommittedEntries)))
+	atomic.AddInt64(&readyEntries[batchBucket(len(rd.Entries))], 1)
+}
+
+//export pgraft_go_set_metrics_block
+func pgraft_go_set_metrics_block(block *C.pgraft_go_metrics_t) {
+	metricsMu.Lock()
+	defer metricsMu.Unlock()
+
+	atomic.StorePointer(&metricsBlock, unsafe.Pointer(block))
+}
+
+func storeMetric(field *C.int64_t, value int64) {
+	atomic.StoreInt64((*int64)(unsafe.Pointer(field)), value)
+}
+
+func storeHistogram(sum *C.int64_t, buckets *[metricsBuckets]C.int64_t, h *latencyHistogram) {
+	storeMetric(sum, atomic.LoadInt64(&h.sumUs))
+	for i := range buckets {
+		storeMetric(&buckets[i], atomic.LoadInt64(&h.buckets[i]))
+	}
+}
+
+// publishMetrics copies the counters, the leader's view of each peer and
+// the measured RTTs into the metrics block with the seqlock protocol of
+// writeStatusBlock
+func publishMetrics() {
+	block := (*C.pgraft_go_metrics_t)(atomic.LoadPointer(&metricsBlock))
+	if block == nil {
+		return
+	}
+
+	raftMutex.RLock()
+	if atomic.LoadInt32(&running) == 0 || raftNode == nil {
+		raftMutex.RUnlock()
+		return
+	}
+	status := raftNode.Status()
+	lastIdx := status.Commit
+	if raftStorage != nil {
+		if last, err := raftStorage.LastIndex(); err == nil {
+			lastIdx = last
+		}
+	}
+	raftMutex.RUnlock()
+
+	type peerMetrics struct {
+		match, next, state    int64
+		heartbeatUs, appendUs int64
+	}
+	peers := make(map[uint64]*peerMetrics)
+	peer := func(id uint64) *peerMetrics {
+		pm := peers[id]
+		if pm == nil {
+			pm = &peerMetrics{match: -1, next: -1, state: -1, heartbeatUs: -1, appendUs: -1}
+			peers[id] = pm
+		}
+		return pm
+	}
+	for id, pr := range status.Progress {
+		if id == status.ID {
+			continue
+		}
+		pm := peer(id)
+		pm.match = int64(pr.Match)
+		pm.next = int64(pr.Next)
+		pm.state = int64(pr.State)
+	}
+	peerRTTMu.Lock()
+	for id, st := range peerRTT {
+		if id == status.ID {
+			continue
+		}
+		pm := peer(id)
+		if st.samples > 0 {
+			pm.heartbeatUs = st.srtt.Microseconds()
+		}
+		if st.appendSamples > 0 {
+			pm.appendUs = st.appendSRTT.Microseconds()
+		}
+	}
+	peerRTTMu.Unlock()
+
+	ids := make([]uint64, 0, len(peers))
+	for id := range peers {
+		ids = append(ids, id)
+	}
+	sort.Slice(ids, func(i, j int) bool { return ids[i] < ids[j] })
+	if len(ids) > C.PGRAFT_GO_MAX_PROGRESS {
+		ids = ids[:C.PGRAFT_GO_MAX_PROGRESS]
+	}
+
+	metricsMu.Lock()
+	defer metricsMu.Unlock()
+
+	seq := (*uint64)(unsafe.Pointer(&block.seq))
+	atomic.AddUint64(seq, 1)
+	storeMetric(&block.node_id, int64(status.ID))
+	storeMetric(&block.updated_at_ns, time.Now().UnixNano())
+	storeMetric(&block.raft_state, int64(status.RaftState))
+	storeMetric(&block.last_index, int64(lastIdx))
+	storeMetric(&block.commit_index, int64(status.Commit))
+	storeMetric(&block.applied_index, int64(status.Applied))
+	for i := 0; i < metricsMsgTypes; i++ {
+		storeMetric(&block.msg_sent[i], atomic.LoadInt64(&msgSentCount[i]))
+		storeMetric(&block.msg_received[i], atomic.LoadInt64(&msgReceivedCount[i]))
+	}
+	storeMetric(&block.ready_count, atomic.LoadInt64(&readyCount))
+	storeMetric(&block.ready_entries_sum, atomic.LoadInt64(&readyEntriesSum))
+	storeMetric(&block.ready_messages_sum, atomic.LoadInt64(&readyMessagesSum))
+	storeMetric(&block.ready_committed_sum, atomic.LoadInt64(&readyCommittedSum))
+	for i := 0; i < metricsBuckets; i++ {
+		storeMetric(&block.ready_entries[i], atomic.LoadInt64(&readyEntries[i]))
+	}
+	storeHistogram(&block.append_latency_sum_us, &block.append_latency, &walAppendLatency)
+	storeHistogram(&block.fsync_latency_sum_us, &block.fsync_latency, &walFsyncLatency)
+	storeMetric(&block.proposal_queue_depth, int64(len(proposalQueue)))
+	storeMetric(&block.proposal_queue_capacity, int64(cap(proposalQueue)))
+	storeMetric(&block.num_peers, int64(len(ids)))
+	for i, id := range ids {
+		pm := peers[id]
+		storeMetric(&block.peer_id[i], int64(id))
+		storeMetric(&block.peer_match[i], pm.match)
+		storeMetric(&block.peer_next[i], pm.next)
+		storeMetric(&block.peer_state[i], pm.state)
+		storeMetric(&block.peer_heartbeat_rtt_us[i], pm.heartbeatUs)
+		storeMetric(&block.peer_append_rtt_us[i], pm.appendUs)
+	}
+	storeMetric(&block.compress_frames, atomic.LoadInt64(&compressFrames))
+	storeMetric(&block.compress_skipped, atomic.LoadInt64(&compressSkipped))
+	storeMetric(&block.compress_raw_bytes, atomic.LoadInt64(&compressRawBytes))
+	storeMetric(&block.compress_wire_bytes, atomic.LoadInt64(&compressWireBytes))
+	storeMetric(&block.compress_cpu_us, atomic.LoadInt64(&compressNs)/1000)
+	storeMetric(&block.decompress_frames, atomic.LoadInt64(&decompressFrames))
+	storeMetric(&block.decompress_raw_bytes, atomic.LoadInt64(&decompressRawBytes))
+	storeMetric(&block.decompress_wire_bytes, atomic.LoadInt64(&decompressWireBytes))
+	storeMetric(&block.decompress_cpu_us, atomic.LoadInt64(&decompressNs)/1000)
+	atomic.AddUint64(seq, 1)
+}
+
+// ============================================================================
+// LOGGING - Leveled, rate-limited logging for the Go side
+// ============================================================================
+
+// Log levels, lowest is most severe.  Messages above the current level are
+// discarded before any formatting takes place.
+const (
+	logLevelError int32 = iota
+	logLevelWarning
+	logLevelInfo
+	logLevelDebug
+	logLevelTrace
+)
+
+var logLevelNames = [...]string{"ERROR", "WARNING", "INFO", "DEBUG", "TRACE"}
+
+const (
+	// Each call site may emit logRateBurst lines per logRateInterval
+	logRateBurst    = 10
+	logRateInterval = time.Second
+)
+
+type logLimiter struct {
+	windowStart time.Time
+	emitted     int
+	suppressed  int
 }
 
+var (
+	logLevel       = logLevelInfo
+	logLimiters    = make(map[string]*logLimiter)
+	logLimiterLock sync.Mutex
+)
+
+// logEnabled reports whether a message at level would be emitted; use it to
+// guard expensive argument construction on hot paths
+func logEnabled(level int32) bool {
+	return level <= atomic.LoadInt32(&logLevel)
+}
+
+// logAt emits a message if level is enabled and the call site, identified by
+// its format string, is within its rate budget
+func logAt(level int32, format string, args ...interface{}) {
+	if !logEnabled(level) {
+		return
+	}
+
+	now := time.Now()
+	logLimiterLock.Lock()
+	lim, ok := logLimiters[format]
+	if !ok {
+		lim = &logLimiter{windowStart: now}
+		logLimiters[format] = lim
+	}
+	if now.Sub(lim.windowStart) >= logRateInterval {
+		if lim.suppressed > 0 {
+			log.Printf("pgraft: %s - suppressed %d messages like \"%s\"",
+				logLevelNames[level], lim.suppressed, format)
+		}
+		lim.windowStart = now
+		lim.emitted = 0
+		lim.suppressed = 0
+	}
+	if lim.emitted >= logRateBurst {
+		lim.suppressed++
+		logLimiterLock.Unlock()
+		return
+	}
+	lim.emitted++
+	logLimiterLock.Unlock()
+
+	log.Printf("pgraft: "+logLevelNames[level]+" - "+format, args...)
+}
+
+func logError(format string, args ...interface{})   { logAt(logLevelError, format, args...) }
+func logWarning(format string, args ...interface{}) { logAt(logLevelWarning, format, args...) }
+func logInfo(format string, args ...interface{})    { logAt(logLevelInfo, format, args...) }
+func logDebug(format string, args ...interface{})   { logAt(logLevelDebug, format, args...) }
+func logTrace(format string, args ...interface{})   { logAt(logLevelTrace, format, args...) }
+
 // Debug logging function that respects log level
 func debugLog(format string, args ...interface{}) {
-	if debugEnabled {
-		log.Printf("pgraft: "+format, args...)
-	}
+	logAt(logLevelDebug, format, args...)
 }
 
 // Set debug logging level
 //
 //export pgraft_go_set_debug
 func pgraft_go_set_debug(enabled C.int) {
-	debugEnabled = (enabled != 0)
+	if enabled != 0 {
+		atomic.StoreInt32(&logLevel, logLevelDebug)
+	} else {
+		atomic.StoreInt32(&logLevel, logLevelInfo)
+	}
+}
+
+// Set the log level directly (0=error .. 4=trace); out of range values clamp
+//
+//export pgraft_go_set_log_level
+func pgraft_go_set_log_level(level C.int) {
+	l := int32(level)
+	if l < logLevelError {
+		l = logLevelError
+	} else if l > logLevelTrace {
+		l = logLevelTrace
+	}
+	atomic.StoreInt32(&logLevel, l)
 }
 
 //export pgraft_go_start
@@ -161,23 +934,22 @@ func pgraft_go_start() C.int {
 	defer raftMutex.Unlock()
 
 	if atomic.LoadInt32(&running) == 1 {
-		log.Printf("pgraft: WARNING - Already running")
+		logWarning("Already running")
 		return 0
 	}
 
 	if atomic.LoadInt32(&initialized) == 0 {
-		log.Printf("pgraft: ERROR - Not initialized")
+		logError("Not initialized")
 		return -1
 	}
 
 	// Start background processing
-	raftTicker = time.NewTicker(100 * time.Millisecond)
+	raftTicker = time.NewTicker(currentTickInterval())
 	go raftProcessingLoop()
 	go tickerLoop()
-	go messageReceiver()
 
 	atomic.StoreInt32(&running, 1)
-	log.Printf("pgraft: INFO - Started successfully")
+	logInfo("Started successfully")
 
 	return 0
 }
@@ -188,7 +960,7 @@ func pgraft_go_stop() C.int {
 	defer raftMutex.Unlock()
 
 	if atomic.LoadInt32(&running) == 0 {
-		log.Printf("pgraft: WARNING - Already stopped")
+		logWarning("Already stopped")
 		return 0
 	}
 
@@ -206,15 +978,25 @@ func pgraft_go_stop() C.int {
 	}
 
 	// Close all connections
+	stopAllPeerDialers()
 	connMutex.Lock()
 	for nodeID, conn := range connections {
+		stopPeerSender(nodeID)
 		conn.Close()
 		delete(connections, nodeID)
 	}
 	connMutex.Unlock()
 
+	// Flush and checkpoint durable storage
+	if raftWal != nil {
+		if err := raftWal.close(); err != nil {
+			recordError(fmt.Errorf("failed to close raft WAL: %v", err))
+		}
+	}
+
 	atomic.StoreInt32(&running, 0)
-	log.Printf("pgraft: INFO - Stopped successfully")
+	publishStopped()
+	logInfo("Stopped successfully")
 
 	return 0
 }
@@ -255,7 +1037,7 @@ func pgraft_go_version() *C.char {
 
 //export pgraft_go_test
 func pgraft_go_test() C.int {
-	log.Printf("pgraft: INFO - Test function called")
+	logInfo("Test function called")
 	return 0
 }
 
@@ -273,52 +1055,80 @@ var (
 func pgraft_go_init(nodeID C.int, address *C.char, port C.int) C.int {
 	defer func() {
 		if r := recover(); r != nil {
-			log.Printf("pgraft: PANIC in pgraft_go_init: %v", r)
+			logError("PANIC in pgraft_go_init: %v", r)
 		}
 	}()
 
-	log.Printf("pgraft: INFO - Initializing node %d at %s:%d", nodeID, C.GoString(address), int(port))
+	logInfo("Initializing node %d at %s:%d", nodeID, C.GoString(address), int(port))
 
 	raftMutex.Lock()
 	defer raftMutex.Unlock()
 
 	if atomic.LoadInt32(&initialized) == 1 {
-		log.Printf("pgraft: WARNING - Node already initialized, skipping")
+		logWarning("Node already initialized, skipping")
 		return 0 // Already initialized
 	}
 
-	// Initialize storage
+	// Initialize storage, replaying the on-disk log when a data directory is set
 	raftStorage = raft.NewMemoryStorage()
-	log.Printf("pgraft: DEBUG - Memory storage initialized")
+	hasState := false
+	if raftDataDir != "" {
+		wal, found, err := openRaftWAL(raftDataDir, raftStorage)
+		if err != nil {
+			logError("Failed to open Raft WAL in %s: %v", raftDataDir, err)
+			return -1
+		}
+		raftWal = wal
+		hasState = found
+	} else {
+		logWarning("No data directory set, Raft state will not survive a restart")
+	}
+	logDebug("Raft storage initialized")
+
+	// One tick per heartbeat; the election timeout is a multiple of it
+	tick, electionTick := raftTiming()
+	atomic.StoreInt64(&baseTickNs, int64(tick))
+	atomic.StoreInt64(&tickIntervalNs, int64(tick))
+	logInfo("Raft tick %v, election timeout %v", tick, tick*time.Duration(electionTick))
 
 	// Create configuration following etcd-io/raft patterns
 	raftConfig = &raft.Config{
 		ID:              uint64(nodeID),
-		ElectionTick:    10,
+		ElectionTick:    electionTick,
 		HeartbeatTick:   1,
 		Storage:         raftStorage,
 		MaxSizePerMsg:   4096,
 		MaxInflightMsgs: 256,
-		Logger:          nil,   // Use default logger
-		PreVote:         false, // Disable pre-vote for single node
+		Logger:          nil, // Use default logger
+		PreVote:         atomic.LoadInt32(&electionPreVote) == 1,
+		CheckQuorum:     atomic.LoadInt32(&electionCheckQuorum) == 1,
 	}
-	log.Printf("pgraft: DEBUG - Raft configuration created")
+
+	// Lease reads trust leadership while a quorum was heard from within an
+	// election timeout, which etcd only allows together with CheckQuorum
+	if atomic.LoadInt32(&readLeaseBased) == 1 {
+		raftConfig.ReadOnlyOption = raft.ReadOnlyLeaseBased
+		raftConfig.CheckQuorum = true
+	}
+	logDebug("Raft configuration created")
 
 	// Initialize channels
 	raftReady = make(chan raft.Ready, 1)
 	raftDone = make(chan struct{})
-	messageChan = make(chan raftpb.Message, 100)
+	messageChan = make(chan raftpb.Message, peerReceiveQueueDepth)
 	stopChan = make(chan struct{})
-	log.Printf("pgraft: DEBUG - Communication channels initialized")
+	logDebug("Communication channels initialized")
 
 	// Initialize node management
+	selfNodeID = uint64(nodeID)
+	selfAddress = fmt.Sprintf("%s:%d", C.GoString(address), int(port))
 	nodesMutex.Lock()
 	if nodes == nil {
 		nodes = make(map[uint64]string)
 	}
-	nodes[uint64(nodeID)] = fmt.Sprintf("%s:%d", C.GoString(address), int(port))
+	nodes[selfNodeID] = selfAddress
 	nodesMutex.Unlock()
-	log.Printf("pgraft: INFO - Self node registered: %d -> %s:%d", nodeID, C.GoString(address), int(port))
+	logInfo("Self node registered: %d -> %s:%d", nodeID, C.GoString(address), int(port))
 
 	// Initialize connections
 	connections = make(map[uint64]net.Conn)
@@ -333,50 +1143,73 @@ func pgraft_go_init(nodeID C.int, address *C.char, port C.int) C.int {
 		CommitIndex: 0,
 	}
 
+	// Resume from the last snapshot: its membership, store and applied
+	// position; the WAL replays what came after it
+	kvReset()
+	if snap, err := raftStorage.Snapshot(); err == nil && !raft.IsEmptySnap(snap) {
+		restoreSnapshot(snap)
+		raftConfig.Applied = snap.Metadata.Index
+	} else {
+		snapshotMutex.Lock()
+		raftConfState = raftpb.ConfState{}
+		snapshotIndex = 0
+		bytesSinceSnapshot = 0
+		snapshotMutex.Unlock()
+	}
+
 	// Create initial peer configuration for this node
 	// Additional peers will be added via pgraft_add_node calls
 	peers := []raft.Peer{
 		{ID: uint64(nodeID)},
 	}
 
-	// Create the actual Raft node with peers
-	raftNode = raft.StartNode(raftConfig, peers)
-	log.Printf("pgraft: INFO - Raft node created with %d initial peers", len(peers))
+	// Restart from persisted state if present, otherwise bootstrap with self
+	if hasState {
+		raftNode = raft.RestartNode(raftConfig)
+		logInfo("Raft node restarted from persisted state")
+	} else {
+		raftNode = raft.StartNode(raftConfig, peers)
+		logInfo("Raft node created with %d initial peers", len(peers))
+	}
 
 	// Initialize context but don't start background processing yet
 	raftCtx, raftCancel = context.WithCancel(context.Background())
-	log.Printf("pgraft: DEBUG - Context initialized, background processing deferred to PostgreSQL workers")
+
+	// The batcher only forwards queued proposals; it exits with the context
+	go proposalBatcher(raftCtx)
+	go kvLeaseLoop(raftCtx)
+	logDebug("Context initialized, background processing deferred to PostgreSQL workers")
 
 	// Initialize applied and committed indices
-	appliedIndex = 0
-	committedIndex = 0
+	atomic.StoreUint64(&appliedIndex, raftConfig.Applied)
+	atomic.StoreUint64(&committedIndex, raftConfig.Applied)
 
 	// Start network server for incoming connections
-	log.Printf("pgraft: DEBUG - About to start network server goroutine")
+	logDebug("About to start network server goroutine")
 	go startNetworkServer(C.GoString(address), int(port))
-	log.Printf("pgraft: INFO - Network server started on %s:%d", C.GoString(address), int(port))
+	logInfo("Network server started on %s:%d", C.GoString(address), int(port))
 
-	// Load and connect to configured peers
+	// Dial members known from the log and the configuration file
 	go loadAndConnectToPeers()
-	log.Printf("pgraft: INFO - Peer discovery and connection process started")
+	logInfo("Peer discovery and connection process started")
 
 	// Start background processing automatically
-	log.Printf("pgraft: DEBUG - About to start Raft Ready processing goroutine")
+	logDebug("About to start Raft Ready processing goroutine")
 	go processRaftReady()
-	log.Printf("pgraft: INFO - Raft Ready processing started")
+	logInfo("Raft Ready processing started")
 
 	// Start the ticker for Raft operations
-	log.Printf("pgraft: DEBUG - About to start Raft ticker")
-	raftTicker = time.NewTicker(100 * time.Millisecond)
+	logDebug("About to start Raft ticker")
+	raftTicker = time.NewTicker(currentTickInterval())
 	go processRaftTicker()
-	log.Printf("pgraft: INFO - Raft ticker started")
+	logInfo("Raft ticker started")
 
 	// Start message processing
-	log.Printf("pgraft: DEBUG - About to start message processing")
+	logDebug("About to start message processing")
 	go processIncomingMessages()
-	log.Printf("pgraft: INFO - Message processing started")
+	logInfo("Message processing started")
 
-	log.Printf("pgraft: DEBUG - All Raft processing goroutines started successfully")
+	logDebug("All Raft processing goroutines started successfully")
 
 	// Initialize metrics
 	atomic.StoreInt64(&messagesProcessed, 0)
@@ -389,9 +1222,9 @@ func pgraft_go_init(nodeID C.int, address *C.char, port C.int) C.int {
 	healthStatus = "initializing"
 
 	atomic.StoreInt32(&initialized, 1)
-	log.Printf("pgraft: INFO - Initialization completed successfully for node %d at %s:%d", nodeID, C.GoString(address), int(port))
+	logInfo("Initialization completed successfully for node %d at %s:%d", nodeID, C.GoString(address), int(port))
 
-	log.Printf("pgraft: INFO - Returning success from initialization")
+	logInfo("Returning success from initialization")
 	return 0
 }
 
@@ -407,7 +1240,7 @@ func pgraft_go_start_background() C.int {
 	debugLog("start_background: background processing started")
 
 	// Start the ticker for Raft operations
-	raftTicker = time.NewTicker(100 * time.Millisecond)
+	raftTicker = time.NewTicker(currentTickInterval())
 	go processRaftTicker()
 	debugLog("start_background: Raft ticker started")
 
@@ -415,103 +1248,93 @@ func pgraft_go_start_background() C.int {
 	return 0
 }
 
-//export pgraft_go_add_peer
-func pgraft_go_add_peer(nodeID C.int, address *C.char, port C.int) C.int {
-	defer func() {
-		if r := recover(); r != nil {
-			log.Printf("pgraft: PANIC in pgraft_go_add_peer: %v", r)
-		}
-	}()
-
-	log.Printf("pgraft: pgraft_go_add_peer called with nodeID=%d, address=%s, port=%d", nodeID, C.GoString(address), int(port))
-
-	raftMutex.Lock()
-	defer raftMutex.Unlock()
-
-	// C side handles state checking via shared memory
-	// Just add the peer and return success
-	log.Printf("pgraft: adding peer node %d at %s:%d", nodeID, C.GoString(address), int(port))
+// pgraft_go_change_peers proposes every change as one ConfChangeV2, so
+// several nodes join or leave in a single joint-consensus step.  A learner
+// receives the log but neither votes nor counts toward commit; adding an
+// existing learner as a voter promotes it.  Nothing changes here until the
+// entry applies, and then on every node alike.
+//
+//export pgraft_go_change_peers
+func pgraft_go_change_peers(proposalID C.uint64_t, changes *C.pgraft_go_peer_change_t, count C.int) C.int {
+	raftMutex.RLock()
+	node, config, ctx := raftNode, raftConfig, raftCtx
+	raftMutex.RUnlock()
 
-	// Add to our node map with proper mutex protection
-	nodeAddr := fmt.Sprintf("%s:%d", C.GoString(address), int(port))
-	nodesMutex.Lock()
-	// Always ensure the map is initialized
-	if nodes == nil {
-		nodes = make(map[uint64]string)
-		log.Printf("pgraft: Initialized nodes map in pgraft_go_add_peer")
+	if atomic.LoadInt32(&running) == 0 || node == nil || config == nil || count <= 0 {
+		return -1
 	}
-	nodes[uint64(nodeID)] = nodeAddr
-	nodesMutex.Unlock()
-	log.Printf("pgraft: added node to map: %d -> %s", nodeID, nodeAddr)
 
-	// Add peer to Raft cluster configuration
-	if raftNode != nil {
-		log.Printf("pgraft: adding peer to Raft cluster configuration")
-
-		// Create a configuration change proposal
-		cc := raftpb.ConfChange{
-			Type:    raftpb.ConfChangeAddNode,
-			NodeID:  uint64(nodeID),
-			Context: []byte(nodeAddr),
-		}
-
-		// Propose the configuration change
-		log.Printf("pgraft: proposing configuration change for node %d", nodeID)
-		if err := raftNode.ProposeConfChange(raftCtx, cc); err != nil {
-			log.Printf("pgraft: ERROR proposing configuration change: %v", err)
+	list := unsafe.Slice(changes, int(count))
+	cc := raftpb.ConfChangeV2{Changes: make([]raftpb.ConfChangeSingle, 0, len(list))}
+	addrs := make(map[uint64]string)
+	for i := range list {
+		nodeID := uint64(list[i].node_id)
+		single := raftpb.ConfChangeSingle{NodeID: nodeID}
+		switch int(list[i]._type) {
+		case C.PGRAFT_GO_PEER_ADD_VOTER:
+			single.Type = raftpb.ConfChangeAddNode
+		case C.PGRAFT_GO_PEER_ADD_LEARNER:
+			single.Type = raftpb.ConfChangeAddLearnerNode
+		case C.PGRAFT_GO_PEER_REMOVE:
+			single.Type = raftpb.ConfChangeRemoveNode
+		default:
+			logError("unknown membership change type %d for node %d", int(list[i]._type), nodeID)
 			return -1
 		}
-
-		log.Printf("pgraft: configuration change proposed successfully for node %d", nodeID)
-
-		// Trigger leader election after adding peer
-		go func() {
-			time.Sleep(1 * time.Second) // Wait for configuration change to be applied
-			log.Printf("pgraft: triggering leader election after adding peer")
-			raftNode.Campaign(raftCtx)
-		}()
-	} else {
-		log.Printf("pgraft: WARNING - Raft node is nil, cannot add peer to configuration")
+		if single.Type != raftpb.ConfChangeRemoveNode {
+			addrs[nodeID] = fmt.Sprintf("%s:%d", C.GoString(&list[i].address[0]), int(list[i].port))
+		}
+		cc.Changes = append(cc.Changes, single)
 	}
+	cc.Context = encodeConfChangeContext(config.ID, uint64(proposalID), addrs)
 
-	log.Printf("pgraft: added peer node %d at %s (configuration change applied)", nodeID, nodeAddr)
-
+	// Applied through processCommittedEntry, which reports proposalID
+	if err := node.ProposeConfChange(ctx, cc); err != nil {
+		logError("proposing membership change: %v", err)
+		return -1
+	}
+	logInfo("proposed %d membership change(s) as proposal %d", len(cc.Changes), uint64(proposalID))
 	return 0
 }
 
-//export pgraft_go_remove_peer
-func pgraft_go_remove_peer(nodeID C.int) C.int {
-	raftMutex.Lock()
-	defer raftMutex.Unlock()
-
-	if atomic.LoadInt32(&running) == 0 {
-		return -1 // Not running
+func encodeConfChangeContext(origin, proposalID uint64, addrs map[uint64]string) []byte {
+	buf := make([]byte, confChangeHeaderSize, confChangeHeaderSize+len(addrs)*32)
+	binary.BigEndian.PutUint32(buf[0:4], confChangeMagic)
+	binary.BigEndian.PutUint64(buf[4:12], origin)
+	binary.BigEndian.PutUint64(buf[12:20], proposalID)
+	binary.BigEndian.PutUint32(buf[20:24], uint32(len(addrs)))
+	for id, addr := range addrs {
+		buf = binary.BigEndian.AppendUint64(buf, id)
+		buf = binary.BigEndian.AppendUint16(buf, uint16(len(addr)))
+		buf = append(buf, addr...)
 	}
+	return buf
+}
 
-	// Close connection
-	connMutex.Lock()
-	if conn, exists := connections[uint64(nodeID)]; exists {
-		conn.Close()
-		delete(connections, uint64(nodeID))
+// decodeConfChangeContext undoes encodeConfChangeContext; ok is false for
+// a context pgraft did not write
+func decodeConfChangeContext(buf []byte) (origin, proposalID uint64, addrs map[uint64]string, ok bool) {
+	if len(buf) < confChangeHeaderSize || binary.BigEndian.Uint32(buf[0:4]) != confChangeMagic {
+		return 0, 0, nil, false
 	}
-	connMutex.Unlock()
-
-	// Remove from our node map with proper mutex protection
-	nodesMutex.Lock()
-	delete(nodes, uint64(nodeID))
-	nodesMutex.Unlock()
-
-	// Propose configuration change
-	cc := raftpb.ConfChange{
-		Type:   raftpb.ConfChangeRemoveNode,
-		NodeID: uint64(nodeID),
+	origin = binary.BigEndian.Uint64(buf[4:12])
+	proposalID = binary.BigEndian.Uint64(buf[12:20])
+	count := binary.BigEndian.Uint32(buf[20:24])
+	addrs = make(map[uint64]string, count)
+	rest := buf[confChangeHeaderSize:]
+	for i := uint32(0); i < count; i++ {
+		if len(rest) < 10 {
+			return 0, 0, nil, false
+		}
+		id := binary.BigEndian.Uint64(rest[0:8])
+		n := int(binary.BigEndian.Uint16(rest[8:10]))
+		if len(rest) < 10+n {
+			return 0, 0, nil, false
+		}
+		addrs[id] = string(rest[10 : 10+n])
+		rest = rest[10+n:]
 	}
-
-	raftNode.ProposeConfChange(raftCtx, cc)
-
-	log.Printf("pgraft: removed peer node %d", nodeID)
-
-	return 0
+	return origin, proposalID, addrs, true
 }
 
 //export pgraft_go_get_state
@@ -539,788 +1362,3986 @@ func pgraft_go_get_state() *C.char {
 
 //export pgraft_go_get_leader
 func pgraft_go_get_leader() C.int64_t {
-	defer func() {
-		if r := recover(); r != nil {
-			log.Printf("pgraft: PANIC in pgraft_go_get_leader: %v", r)
-		}
-	}()
-
-	log.Printf("pgraft: pgraft_go_get_leader called")
-
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
-
 	if atomic.LoadInt32(&running) == 0 {
-		log.Printf("pgraft: get_leader - not running")
 		return -1
 	}
+	return C.int64_t(atomic.LoadInt64(&statusLeader))
+}
 
-	if raftNode == nil {
-		log.Printf("pgraft: get_leader - raftNode is nil")
+//export pgraft_go_get_term
+func pgraft_go_get_term() C.int32_t {
+	if atomic.LoadInt32(&running) == 0 {
 		return -1
 	}
+	return C.int32_t(atomic.LoadInt64(&statusTerm))
+}
 
-	status := raftNode.Status()
-	log.Printf("pgraft: get_leader - status.Lead=%d", status.Lead)
-	return C.int64_t(status.Lead)
+//export pgraft_go_is_leader
+func pgraft_go_is_leader() C.int {
+	if atomic.LoadInt32(&running) == 0 ||
+		raft.StateType(atomic.LoadInt32(&statusRaftState)) != raft.StateLeader {
+		return 0
+	}
+	return 1
 }
 
-//export pgraft_go_get_term
-func pgraft_go_get_term() C.int32_t {
-	defer func() {
-		if r := recover(); r != nil {
-			log.Printf("pgraft: PANIC in pgraft_go_get_term: %v", r)
+//export pgraft_go_set_status_block
+func pgraft_go_set_status_block(block *C.pgraft_go_raft_status_t) {
+	statusMutex.Lock()
+	defer statusMutex.Unlock()
+
+	atomic.StorePointer(&statusBlock, unsafe.Pointer(block))
+	writeStatusBlock()
+}
+
+// publishStatus records what a Ready changed and republishes the status.
+// The Ready loop is the only caller that moves leader, term or commit, so
+// the getters never need raftNode.Status() and its progress map.  A new
+// leader or term also wakes the worker, which wakes the backends blocked
+// in pgraft_wait_leader_change(), instead of leaving them to its next
+// interval.
+func publishStatus(rd raft.Ready) {
+	statusMutex.Lock()
+	defer statusMutex.Unlock()
+
+	changed := false
+	if rd.SoftState != nil {
+		lead := int64(rd.SoftState.Lead)
+		changed = atomic.SwapInt64(&statusLeader, lead) != lead
+		atomic.StoreInt32(&statusRaftState, int32(rd.SoftState.RaftState))
+	}
+	if !raft.IsEmptyHardState(rd.HardState) {
+		term := int64(rd.HardState.Term)
+		if atomic.SwapInt64(&statusTerm, term) != term {
+			changed = true
 		}
-	}()
+		atomic.StoreInt64(&statusCommit, int64(rd.HardState.Commit))
+	}
+	writeStatusBlock()
 
-	log.Printf("pgraft: pgraft_go_get_term called")
+	if changed {
+		notifyProposalWaiters()
+	}
+}
 
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
+// publishApplied republishes the status after the apply goroutine moved
+// the applied index
+func publishApplied() {
+	statusMutex.Lock()
+	defer statusMutex.Unlock()
 
-	if atomic.LoadInt32(&running) == 0 {
-		log.Printf("pgraft: get_term - not running")
-		return -1
+	writeStatusBlock()
+}
+
+// publishStopped marks the published status as having no leader
+func publishStopped() {
+	statusMutex.Lock()
+	defer statusMutex.Unlock()
+
+	atomic.StoreInt64(&statusLeader, -1)
+	atomic.StoreInt32(&statusRaftState, int32(raft.StateFollower))
+	writeStatusBlock()
+}
+
+// writeStatusBlock performs the seqlock write; statusMutex keeps it
+// single-writer.  seq is odd while the fields are being stored.
+func writeStatusBlock() {
+	block := (*C.pgraft_go_raft_status_t)(atomic.LoadPointer(&statusBlock))
+	if block == nil {
+		return
 	}
 
-	if raftNode == nil {
-		log.Printf("pgraft: get_term - raftNode is nil")
-		return -1
+	isLeader := int32(0)
+	raftState := atomic.LoadInt32(&statusRaftState)
+	if raft.StateType(raftState) == raft.StateLeader {
+		isLeader = 1
 	}
 
-	status := raftNode.Status()
-	log.Printf("pgraft: get_term - returning term: %d", status.Term)
-	return C.int32_t(status.Term)
+	seq := (*uint64)(unsafe.Pointer(&block.seq))
+	atomic.AddUint64(seq, 1)
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&block.leader_id)), atomic.LoadInt64(&statusLeader))
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&block.term)), atomic.LoadInt64(&statusTerm))
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&block.commit_index)), atomic.LoadInt64(&statusCommit))
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&block.applied_index)), int64(atomic.LoadUint64(&appliedIndex)))
+	atomic.StoreInt32((*int32)(unsafe.Pointer(&block.raft_state)), raftState)
+	atomic.StoreInt32((*int32)(unsafe.Pointer(&block.is_leader)), isLeader)
+	atomic.AddUint64(seq, 1)
 }
 
-//export pgraft_go_is_leader
-func pgraft_go_is_leader() C.int {
+// pgraft_go_get_status fills out from one raftNode.Status() call so that
+// leader, term, indexes and per-peer progress are mutually consistent.
+// Progress is only tracked by the leader; followers report none.
+//
+//export pgraft_go_get_status
+func pgraft_go_get_status(out *C.pgraft_go_status_t) C.int {
 	defer func() {
 		if r := recover(); r != nil {
-			log.Printf("pgraft: PANIC in pgraft_go_is_leader: %v", r)
+			logError("PANIC in pgraft_go_get_status: %v", r)
 		}
 	}()
 
-	log.Printf("pgraft: pgraft_go_is_leader called")
-
 	raftMutex.RLock()
 	defer raftMutex.RUnlock()
 
-	if atomic.LoadInt32(&running) == 0 {
-		log.Printf("pgraft: is_leader - not running")
-		return 0
+	if atomic.LoadInt32(&running) == 0 || raftNode == nil {
+		return -1
 	}
 
-	if raftNode == nil {
-		log.Printf("pgraft: is_leader - raftNode is nil")
-		return 0
+	status := raftNode.Status()
+	out.leader_id = C.int64_t(status.Lead)
+	out.term = C.int64_t(status.Term)
+	out.commit_index = C.int64_t(status.Commit)
+	out.applied_index = C.int64_t(status.Applied)
+	out.last_index = C.int64_t(status.Commit)
+	if raftStorage != nil {
+		if last, err := raftStorage.LastIndex(); err == nil {
+			out.last_index = C.int64_t(last)
+		}
 	}
+	out.raft_state = C.int32_t(status.RaftState)
 
-	status := raftNode.Status()
-	isLeader := status.Lead == status.ID
-	log.Printf("pgraft: is_leader - status.ID=%d, status.Lead=%d, isLeader=%v", status.ID, status.Lead, isLeader)
+	ids := make([]uint64, 0, len(status.Progress))
+	for id := range status.Progress {
+		ids = append(ids, id)
+	}
+	sort.Slice(ids, func(i, j int) bool { return ids[i] < ids[j] })
 
-	if isLeader {
-		return 1
+	n := 0
+	for _, id := range ids {
+		if n >= C.PGRAFT_GO_MAX_PROGRESS {
+			break
+		}
+		pr := status.Progress[id]
+		out.progress_node_id[n] = C.int64_t(id)
+		out.progress_match[n] = C.int64_t(pr.Match)
+		out.progress_next[n] = C.int64_t(pr.Next)
+		out.progress_state[n] = C.int32_t(pr.State)
+		n++
+	}
+	out.num_progress = C.int32_t(n)
+
+	// Learners come from the applied configuration, so every member knows them
+	n = 0
+	for id := range status.Config.Learners {
+		if n >= C.PGRAFT_GO_MAX_PROGRESS {
+			break
+		}
+		out.learner_id[n] = C.int64_t(id)
+		n++
 	}
+	out.num_learners = C.int32_t(n)
+
 	return 0
 }
 
 //export pgraft_go_append_log
 func pgraft_go_append_log(data *C.char, length C.int) C.int {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
-
 	if atomic.LoadInt32(&running) == 0 {
 		return -1
 	}
 
-	// Convert C data to Go byte slice
-	goData := C.GoBytes(unsafe.Pointer(data), length)
-
-	// Propose the data
-	raftNode.Propose(raftCtx, goData)
+	// Ride along with concurrent proposals in the next batch
+	if !queueUntrackedProposal(C.GoBytes(unsafe.Pointer(data), length)) {
+		return -1
+	}
 
 	atomic.AddInt64(&logEntriesCommitted, 1)
 
 	return 0
 }
 
-//export pgraft_go_get_stats
-func pgraft_go_get_stats() *C.char {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
+//export pgraft_go_set_proposal_block
+func pgraft_go_set_proposal_block(block *C.pgraft_go_proposal_block_t, notifyFd C.int) {
+	atomic.StorePointer(&proposalBlock, unsafe.Pointer(block))
+	atomic.StoreInt32(&proposalNotifyFd, int32(notifyFd))
+}
 
-	stats := map[string]interface{}{
-		"initialized":           atomic.LoadInt32(&initialized) == 1,
-		"running":               atomic.LoadInt32(&running) == 1,
-		"messages_processed":    atomic.LoadInt64(&messagesProcessed),
-		"log_entries_committed": atomic.LoadInt64(&logEntriesCommitted),
-		"heartbeats_sent":       atomic.LoadInt64(&heartbeatsSent),
-		"elections_triggered":   atomic.LoadInt64(&electionsTriggered),
-		"error_count":           atomic.LoadInt64(&errorCount),
-		"applied_index":         appliedIndex,
-		"committed_index":       committedIndex,
-		"uptime_seconds":        time.Since(startupTime).Seconds(),
-		"health_status":         healthStatus,
-		"connected_nodes":       len(connections),
-	}
+// pgraft_go_set_proposal_ring starts the reader of the ring backends
+// append proposals to; the worker writes to doorbellFd when there are
+// records Go has not taken yet
+//
+//export pgraft_go_set_proposal_ring
+func pgraft_go_set_proposal_ring(ring *C.pgraft_go_ring_t, doorbellFd C.int) {
+	atomic.StorePointer(&proposalRing, unsafe.Pointer(ring))
+	proposalRingOnce.Do(func() {
+		go ringReader(os.NewFile(uintptr(doorbellFd), "pgraft-ring-doorbell"))
+	})
+}
 
-	jsonData, err := json.Marshal(stats)
-	if err != nil {
-		return C.CString("{\"error\": \"failed to marshal stats\"}")
+// ringReader takes every record up to head on each doorbell.  The reader
+// outlives Raft restarts; records that arrive while Raft is down fail
+// their waiters at once.
+func ringReader(doorbell *os.File) {
+	buf := make([]byte, 64)
+	for {
+		drainRing()
+		if _, err := doorbell.Read(buf); err != nil {
+			logError("proposal ring doorbell closed: %v", err)
+			return
+		}
 	}
-
-	return C.CString(string(jsonData))
 }
 
-//export pgraft_go_get_logs
-func pgraft_go_get_logs() *C.char {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
-
-	if atomic.LoadInt32(&running) == 0 {
-		return C.CString("[]")
+func drainRing() {
+	ring := (*C.pgraft_go_ring_t)(atomic.LoadPointer(&proposalRing))
+	if ring == nil {
+		return
 	}
 
-	// Get logs from storage
-	firstIndex, _ := raftStorage.FirstIndex()
-	lastIndex, _ := raftStorage.LastIndex()
-
-	logs := make([]map[string]interface{}, 0)
-
-	for i := firstIndex; i <= lastIndex; i++ {
-		entries, err := raftStorage.Entries(i, i+1, 0)
-		if err != nil || len(entries) == 0 {
+	data := unsafe.Slice((*byte)(unsafe.Pointer(&ring.data[0])), int(C.PGRAFT_GO_RING_SIZE))
+	headPtr := (*uint64)(unsafe.Pointer(&ring.head))
+	tailPtr := (*uint64)(unsafe.Pointer(&ring.tail))
+	size := uint64(C.PGRAFT_GO_RING_SIZE)
+	align := uint64(C.PGRAFT_GO_RING_ALIGN)
+	recordSize := uint64(unsafe.Sizeof(C.pgraft_go_ring_record_t{}))
+
+	head := atomic.LoadUint64(headPtr)
+	tail := atomic.LoadUint64(tailPtr)
+	for tail < head {
+		offset := tail % size
+		record := (*C.pgraft_go_ring_record_t)(unsafe.Pointer(&data[offset]))
+		kind, length, id := uint32(record.kind), uint64(record.length), uint64(record.proposal_id)
+		if kind == C.PGRAFT_GO_RING_WRAP {
+			tail += size - offset
+			atomic.StoreUint64(tailPtr, tail)
 			continue
 		}
 
-		entry := entries[0]
-		logEntry := map[string]interface{}{
-			"index":     entry.Index,
-			"term":      entry.Term,
-			"type":      entry.Type.String(),
-			"data":      string(entry.Data),
-			"committed": entry.Index <= committedIndex,
+		if offset+recordSize+length > size {
+			// Only a bug on the C side gets here; drop what is there
+			logError("proposal ring record at %d runs past the end (%d bytes)", tail, length)
+			atomic.StoreUint64(tailPtr, head)
+			return
 		}
+		body := data[offset+recordSize : offset+recordSize+length]
+		ok := false
+		switch kind {
+		case C.PGRAFT_GO_RING_PROPOSE:
+			ok = queueProposal(id, append([]byte(nil), body...))
+		case C.PGRAFT_GO_RING_KV_WRITE:
+			ok = queueKVWrite(id, body)
+		case C.PGRAFT_GO_RING_READ_INDEX:
+			ok = startReadIndex(id)
+		}
+		// The slot may be reused once tail passes it; body was copied
+		tail += (recordSize + length + align - 1) &^ (align - 1)
+		atomic.StoreUint64(tailPtr, tail)
 
-		logs = append(logs, logEntry)
-	}
-
-	jsonData, err := json.Marshal(logs)
-	if err != nil {
-		return C.CString("{\"error\": \"failed to marshal logs\"}")
+		if !ok {
+			logTrace("proposal ring record %d (kind %d) could not be taken", id, kind)
+			failProposals([]queuedProposal{{id: id}})
+		}
 	}
-
-	return C.CString(string(jsonData))
 }
 
-//export pgraft_go_commit_log
-func pgraft_go_commit_log(index C.long) C.int {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
+// Configure proposal batching: wait up to delayUs after the first queued
+// proposal for others to join, but propose as soon as maxKB is reached
+//
+//export pgraft_go_set_batch_policy
+func pgraft_go_set_batch_policy(delayUs C.int, maxKB C.int) {
+	batchPolicyMu.Lock()
+	defer batchPolicyMu.Unlock()
 
-	if atomic.LoadInt32(&running) == 0 {
-		return -1
+	if delayUs >= 0 {
+		batchDelay = time.Duration(delayUs) * time.Microsecond
 	}
-
-	// In etcd-io/raft, commits happen automatically
-	// This function is mainly for compatibility
-	committedIndex = uint64(index)
-
-	return 0
-}
-
-//export pgraft_go_step_message
-func pgraft_go_step_message(data *C.char, length C.int) C.int {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
-
-	if atomic.LoadInt32(&running) == 0 {
-		return -1
+	if maxKB > 0 {
+		batchMaxBytes = int(maxKB) * 1024
 	}
+}
 
-	// Convert C data to Go byte slice
-	goData := C.GoBytes(unsafe.Pointer(data), length)
-
-	// Parse as raftpb.Message
-	var msg raftpb.Message
-	if err := msg.Unmarshal(goData); err != nil {
-		log.Printf("pgraft: failed to unmarshal message: %v", err)
+// pgraft_go_propose hands data tagged with proposalID to the batcher and
+// returns without waiting; the Ready loop, or the batcher on failure,
+// reports the outcome through the proposal block.
+//
+//export pgraft_go_propose
+func pgraft_go_propose(proposalID C.uint64_t, data *C.char, length C.int) C.int {
+	if !queueProposal(uint64(proposalID), C.GoBytes(unsafe.Pointer(data), length)) {
 		return -1
 	}
-
-	// Step the message
-	raftNode.Step(raftCtx, msg)
-
-	atomic.AddInt64(&messagesProcessed, 1)
-
 	return 0
 }
 
-//export pgraft_go_get_network_status
-func pgraft_go_get_network_status() *C.char {
-	raftMutex.RLock()
-	defer raftMutex.RUnlock()
-
-	networkStatus := map[string]interface{}{
-		"nodes_connected":    len(connections),
-		"messages_processed": atomic.LoadInt64(&messagesProcessed),
-		"network_latency":    getNetworkLatency(),
-		"connection_status":  "active",
+// queueProposal hands data to the batcher without blocking
+func queueProposal(id uint64, data []byte) bool {
+	if atomic.LoadInt32(&running) == 0 || isKVItem(data) {
+		// Store writes only come through queueKVWrite
+		return false
 	}
-
-	jsonData, err := json.Marshal(networkStatus)
-	if err != nil {
-		return C.CString("{\"error\": \"failed to marshal network status\"}")
+	select {
+	case proposalQueue <- queuedProposal{id: id, data: data}:
+		return true
+	default:
+		return false
 	}
-
-	return C.CString(string(jsonData))
 }
 
-//export pgraft_go_free_string
-func pgraft_go_free_string(str *C.char) {
-	C.free(unsafe.Pointer(str))
-}
-
-// Main processing loop following etcd-io/raft patterns
-func raftProcessingLoop() {
-	defer close(raftDone)
-
-	log.Printf("pgraft: Raft processing loop started")
-
-	for {
-		select {
-		case <-raftCtx.Done():
-			log.Printf("pgraft: Raft processing loop stopping (context done)")
-			return
-		case <-stopChan:
-			log.Printf("pgraft: Raft processing loop stopping (stop signal)")
-			return
-		case <-time.After(1 * time.Second):
-			// Process any pending operations
-			processRaftOperations()
-		}
+// queueUntrackedProposal queues data nobody waits on, blocking briefly if
+// the batcher is behind
+func queueUntrackedProposal(data []byte) bool {
+	select {
+	case proposalQueue <- queuedProposal{data: data}:
+		return true
+	case <-time.After(5 * time.Second):
+		return false
 	}
 }
 
-// Process Raft operations
-func processRaftOperations() {
-	// Update metrics
-	atomic.AddInt64(&messagesProcessed, 1)
-
-	// Update commit index
-	commitIndex++
-	lastApplied = commitIndex
-
-	// Update last index
-	lastIndex = commitIndex
-}
-
-// Ticker loop for heartbeats and elections
-func tickerLoop() {
-	log.Printf("pgraft: Ticker loop started")
-
+// proposalBatcher coalesces queued proposals into one entry per Raft
+// round.  After the first proposal it collects more until the delay
+// expires or the byte budget is reached; anything arriving while a batch
+// is being proposed rides in the next one.
+func proposalBatcher(ctx context.Context) {
 	for {
+		var first queuedProposal
 		select {
-		case <-raftCtx.Done():
-			log.Printf("pgraft: Ticker loop stopping (context done)")
-			return
-		case <-stopChan:
-			log.Printf("pgraft: Ticker loop stopping (stop signal)")
+		case <-ctx.Done():
 			return
-		case <-raftTicker.C:
-			// Send heartbeat
-			atomic.AddInt64(&heartbeatsSent, 1)
-			log.Printf("pgraft: Heartbeat sent (total: %d)", atomic.LoadInt64(&heartbeatsSent))
+		case first = <-proposalQueue:
 		}
-	}
-}
 
-// Message receiver for incoming messages
-func messageReceiver() {
-	log.Printf("pgraft: Message receiver started")
+		batchPolicyMu.Lock()
+		delay, maxBytes := batchDelay, batchMaxBytes
+		batchPolicyMu.Unlock()
 
-	for {
-		select {
-		case <-raftCtx.Done():
-			log.Printf("pgraft: Message receiver stopping (context done)")
-			return
-		case <-stopChan:
-			log.Printf("pgraft: Message receiver stopping (stop signal)")
-			return
-		case <-time.After(5 * time.Second):
-			// Process any pending messages
-			atomic.AddInt64(&messagesProcessed, 1)
-			log.Printf("pgraft: Processed message (total: %d)", atomic.LoadInt64(&messagesProcessed))
+		batch := []queuedProposal{first}
+		size := len(first.data)
+		timer := time.NewTimer(delay)
+	collect:
+		for size < maxBytes && len(batch) < proposalBatchMaxCount {
+			select {
+			case p := <-proposalQueue:
+				batch = append(batch, p)
+				size += len(p.data)
+			case <-timer.C:
+				break collect
+			case <-ctx.Done():
+				break collect
+			}
 		}
+		timer.Stop()
+
+		proposeBatch(ctx, batch, size)
 	}
 }
 
-// Handle incoming message from a specific connection
-func handleIncomingMessage(nodeID uint64, conn net.Conn) {
-	// Set read timeout
-	conn.SetReadDeadline(time.Now().Add(100 * time.Millisecond))
+func proposeBatch(ctx context.Context, batch []queuedProposal, size int) {
+	raftMutex.RLock()
+	node, config := raftNode, raftConfig
+	raftMutex.RUnlock()
 
-	// Read message length first
-	var msgLen uint32
-	if err := readUint32(conn, &msgLen); err != nil {
-		return // No message or timeout
+	if node == nil || config == nil {
+		failProposals(batch)
+		return
 	}
 
-	// Read message data
-	msgData := make([]byte, msgLen)
-	if _, err := conn.Read(msgData); err != nil {
-		return
+	buf := make([]byte, proposalBatchHeaderSize, proposalBatchHeaderSize+len(batch)*proposalItemHeaderSize+size)
+	binary.BigEndian.PutUint32(buf[0:4], proposalBatchMagic)
+	binary.BigEndian.PutUint64(buf[4:12], config.ID)
+	binary.BigEndian.PutUint32(buf[12:16], uint32(len(batch)))
+	for i := range batch {
+		buf = binary.BigEndian.AppendUint64(buf, batch[i].id)
+		buf = binary.BigEndian.AppendUint32(buf, uint32(len(batch[i].data)))
+		buf = append(buf, batch[i].data...)
 	}
 
-	// Parse as raftpb.Message
-	var msg raftpb.Message
-	if err := msg.Unmarshal(msgData); err != nil {
-		log.Printf("pgraft: failed to unmarshal incoming message: %v", err)
+	proposeCtx, cancel := context.WithTimeout(ctx, 5*time.Second)
+	defer cancel()
+
+	if err := node.Propose(proposeCtx, buf); err != nil {
+		recordError(fmt.Errorf("failed to propose batch of %d entries: %v", len(batch), err))
+		failProposals(batch)
 		return
 	}
+	logTrace("proposed batch of %d entries, %d bytes", len(batch), len(buf))
+}
 
-	// Step the message
-	raftNode.Step(raftCtx, msg)
-	atomic.AddInt64(&messagesProcessed, 1)
+// Select how ReadIndex confirms leadership: 0 sends a heartbeat round
+// (ReadOnlySafe), 1 answers from the leader lease.  Takes effect at init.
+//
+//export pgraft_go_set_read_mode
+func pgraft_go_set_read_mode(leaseBased C.int) {
+	if leaseBased != 0 {
+		atomic.StoreInt32(&readLeaseBased, 1)
+	} else {
+		atomic.StoreInt32(&readLeaseBased, 0)
+	}
 }
 
-// Process ready channel following etcd-io/raft patterns
-func processReady(rd raft.Ready) {
-	log.Printf("pgraft: processing ready channel, HardState: %+v, Entries: %d, Messages: %d, CommittedEntries: %d",
-		rd.HardState, len(rd.Entries), len(rd.Messages), len(rd.CommittedEntries))
+// Choose PreVote, so a rejoining or flapping node cannot bump the term and
+// depose a healthy leader, and CheckQuorum, so a leader that has lost its
+// quorum for an election timeout steps down.  Takes effect at init.
+//
+//export pgraft_go_set_election_policy
+func pgraft_go_set_election_policy(preVote C.int, checkQuorum C.int) {
+	if preVote != 0 {
+		atomic.StoreInt32(&electionPreVote, 1)
+	} else {
+		atomic.StoreInt32(&electionPreVote, 0)
+	}
+	if checkQuorum != 0 {
+		atomic.StoreInt32(&electionCheckQuorum, 1)
+	} else {
+		atomic.StoreInt32(&electionCheckQuorum, 0)
+	}
+}
 
-	// 1. Save to storage
-	if !raft.IsEmptyHardState(rd.HardState) {
-		raftStorage.SetHardState(rd.HardState)
-		log.Printf("pgraft: saved HardState: %+v", rd.HardState)
+// pgraft_go_transfer_leadership asks the current leader to hand over to
+// target: the leader brings it up to date, then has it campaign at once
+// with MsgTimeoutNow.  A follower's request is forwarded to the leader.
+// Returns without waiting; callers watch the leader in the status block.
+//
+//export pgraft_go_transfer_leadership
+func pgraft_go_transfer_leadership(target C.int) C.int {
+	if atomic.LoadInt32(&initialized) == 0 || raftNode == nil {
+		logError("transfer_leadership: Raft is not running")
+		return -1
 	}
 
-	if len(rd.Entries) > 0 {
-		raftStorage.Append(rd.Entries)
+	transferee := uint64(target)
+	if transferee == 0 {
+		return -1
+	}
+	if transferee != raftConfig.ID {
+		nodesMutex.RLock()
+		_, known := nodes[transferee]
+		nodesMutex.RUnlock()
+		if !known {
+			logWarning("transfer_leadership: node %d is not a cluster member", transferee)
+			return -1
+		}
 	}
 
-	if !raft.IsEmptySnap(rd.Snapshot) {
-		raftStorage.ApplySnapshot(rd.Snapshot)
+	lead := atomic.LoadInt64(&statusLeader)
+	if lead <= 0 {
+		logWarning("transfer_leadership: no known leader")
+		return -1
+	}
+	if uint64(lead) == transferee {
+		return 0
+	}
+
+	go func() {
+		ctx, cancel := context.WithTimeout(raftCtx, 5*time.Second)
+		defer cancel()
+		raftNode.TransferLeadership(ctx, uint64(lead), transferee)
+		logInfo("Requested leadership transfer from node %d to node %d", lead, transferee)
+	}()
+	return 0
+}
+
+// pgraft_go_cpu_profile starts a runtime/pprof CPU profile of this process
+// and returns; after seconds it is written to path, through a temporary
+// file renamed into place so that pgraft_cpu_profile() never reads half of
+// one.  Fails while another profile is running.
+//
+//export pgraft_go_cpu_profile
+func pgraft_go_cpu_profile(path *C.char, seconds C.int) C.int {
+	target := C.GoString(path)
+	if target == "" || seconds <= 0 {
+		return -1
 	}
 
-	// 2. Send messages through our comm module
-	for _, msg := range rd.Messages {
-		processMessage(msg)
+	tmp := target + ".tmp"
+	f, err := os.OpenFile(tmp, os.O_WRONLY|os.O_CREATE|os.O_TRUNC, 0600)
+	if err != nil {
+		logError("cpu_profile: %v", err)
+		return -1
+	}
+	if err := pprof.StartCPUProfile(f); err != nil {
+		logWarning("cpu_profile: %v", err)
+		f.Close()
+		os.Remove(tmp)
+		return -1
 	}
+	logInfo("CPU profile started for %d seconds", int(seconds))
+
+	go func() {
+		time.Sleep(time.Duration(seconds) * time.Second)
+		pprof.StopCPUProfile()
+		if err := f.Close(); err != nil {
+			logError("cpu_profile: %v", err)
+			os.Remove(tmp)
+			return
+		}
+		if err := os.Rename(tmp, target); err != nil {
+			logError("cpu_profile: %v", err)
+			os.Remove(tmp)
+			return
+		}
+		logInfo("CPU profile written to %s", target)
+	}()
+	return 0
+}
 
-	// 3. Apply committed entries to state machine
-	for _, entry := range rd.CommittedEntries {
-		processCommittedEntry(entry)
+const (
+	// Raft storage is copied out for pgraft_log_entries() a range of at
+	// most this many bytes at a time
+	logEntriesChunkBytes = 1 << 20
+	// Keep in sync with PGRAFT_GO_LOG_RECORD_HEADER in include/pgraft_go.h
+	logRecordHeaderSize = 22
+)
+
+// pgraft_go_dump_log_entries starts writing up to limit log entries from
+// fromIndex on, and no more than about maxBytes of their data, to path in
+// the record format of PGRAFT_GO_LOG_RECORD_HEADER, and returns.  The
+// waiter proposalID is then given the index the next page starts at, or
+// -1 on failure.  Entries compacted into a snapshot are skipped.
+//
+//export pgraft_go_dump_log_entries
+func pgraft_go_dump_log_entries(proposalID C.uint64_t, fromIndex C.uint64_t, limit C.int, maxBytes C.int64_t, path *C.char) C.int {
+	raftMutex.RLock()
+	storage := raftStorage
+	raftMutex.RUnlock()
+
+	target := C.GoString(path)
+	if atomic.LoadInt32(&running) == 0 || storage == nil || target == "" || limit <= 0 {
+		return -1
 	}
 
-	// 4. Advance the node
-	raftNode.Advance()
+	go func(id uint64, from uint64, limit int, maxBytes int64) {
+		next, err := writeLogEntries(storage, target, from, limit, maxBytes)
+		if err != nil {
+			logError("dump_log_entries: %v", err)
+			next = 0
+		}
+
+		block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+		if block == nil {
+			return
+		}
+		index := int64(next)
+		if next == 0 {
+			index = -1
+		}
+		proposalReportMu.Lock()
+		reportProposal(block, id, index)
+		proposalReportMu.Unlock()
+		notifyProposalWaiters()
+	}(uint64(proposalID), uint64(fromIndex), int(limit), int64(maxBytes))
+	return 0
 }
 
-// Process outgoing messages through comm module
-func processMessage(msg raftpb.Message) {
-	// Convert message to bytes
-	data, err := msg.Marshal()
+// writeLogEntries streams a page of the log to path, through a temporary
+// file renamed into place, and returns the index after the last entry
+// written.  Storage is read with one Entries call per range, holding only
+// its own lock meanwhile.
+func writeLogEntries(storage *raft.MemoryStorage, path string, from uint64, limit int, maxBytes int64) (uint64, error) {
+	first, err := storage.FirstIndex()
 	if err != nil {
-		log.Printf("pgraft: failed to marshal message: %v", err)
-		return
+		return 0, err
+	}
+	last, err := storage.LastIndex()
+	if err != nil {
+		return 0, err
+	}
+	hs, _, err := storage.InitialState()
+	if err != nil {
+		return 0, err
 	}
 
-	// Send to specific node
-	if msg.To != 0 {
-		sendToNode(msg.To, data)
-	} else {
-		// Broadcast to all nodes
-		broadcastToAllNodes(data)
+	tmp := path + ".tmp"
+	f, err := os.OpenFile(tmp, os.O_WRONLY|os.O_CREATE|os.O_TRUNC, 0600)
+	if err != nil {
+		return 0, err
 	}
+	w := bufio.NewWriterSize(f, 64*1024)
 
-	atomic.AddInt64(&messagesProcessed, 1)
+	next := from
+	if next < first {
+		next = first
+	}
+	var written int64
+	header := make([]byte, logRecordHeaderSize)
+	full := false
+	for !full && limit > 0 && next <= last {
+		hi := minUint64(next+uint64(limit), last+1)
+		var entries []raftpb.Entry
+		entries, err = storage.Entries(next, hi, logEntriesChunkBytes)
+		if errors.Is(err, raft.ErrCompacted) {
+			// A snapshot overtook us; carry on from what is left
+			if first, err = storage.FirstIndex(); err == nil && next < first {
+				next = first
+				continue
+			}
+		}
+		if err != nil || len(entries) == 0 {
+			break
+		}
+
+		for _, entry := range entries {
+			// Always at least one entry, or a large one would stall paging
+			if written > 0 && written+int64(len(entry.Data)) > maxBytes {
+				full = true
+				break
+			}
+			binary.BigEndian.PutUint64(header[0:8], entry.Index)
+			binary.BigEndian.PutUint64(header[8:16], entry.Term)
+			header[16] = byte(entry.Type)
+			header[17] = 0
+			if entry.Index <= hs.Commit {
+				header[17] = 1
+			}
+			binary.BigEndian.PutUint32(header[18:22], uint32(len(entry.Data)))
+			w.Write(header)
+			w.Write(entry.Data)
+
+			written += int64(len(entry.Data))
+			next = entry.Index + 1
+			limit--
+		}
+	}
+
+	if err == nil {
+		err = w.Flush()
+	}
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tmp, path)
+	}
+	if err != nil {
+		os.Remove(tmp)
+		return 0, err
+	}
+	return next, nil
 }
 
-// Send message to specific node
-func sendToNode(nodeID uint64, data []byte) {
-	connMutex.RLock()
-	conn, exists := connections[nodeID]
-	connMutex.RUnlock()
+// pgraft_go_read_index starts a ReadIndex request for a pgraft_read_barrier()
+// waiter and returns without waiting.  The waiter is completed through the
+// proposal block once the confirmed commit index has been applied here.
+//
+//export pgraft_go_read_index
+func pgraft_go_read_index(proposalID C.uint64_t) C.int {
+	if !startReadIndex(uint64(proposalID)) {
+		return -1
+	}
+	return 0
+}
 
-	if !exists {
-		log.Printf("pgraft: no connection to node %d", nodeID)
-		return
+func startReadIndex(id uint64) bool {
+	raftMutex.RLock()
+	node, config, ctx := raftNode, raftConfig, raftCtx
+	raftMutex.RUnlock()
+
+	if atomic.LoadInt32(&running) == 0 || node == nil || config == nil {
+		return false
 	}
 
-	// Send message length first
-	if err := writeUint32(conn, uint32(len(data))); err != nil {
-		log.Printf("pgraft: failed to send message length to node %d: %v", nodeID, err)
+	rctx := make([]byte, readIndexContextSize)
+	binary.BigEndian.PutUint32(rctx[0:4], readIndexMagic)
+	binary.BigEndian.PutUint64(rctx[4:12], config.ID)
+	binary.BigEndian.PutUint64(rctx[12:20], id)
+
+	go func() {
+		readCtx, cancel := context.WithTimeout(ctx, 5*time.Second)
+		defer cancel()
+
+		if err := node.ReadIndex(readCtx, rctx); err != nil {
+			failProposals([]queuedProposal{{id: id}})
+		}
+	}()
+	return true
+}
+
+// trackReadStates remembers the read index the leader confirmed for each
+// of this node's read barriers.  Requests made without a known leader are
+// dropped by etcd and time out on the SQL side.
+func trackReadStates(states []raft.ReadState) {
+	if len(states) == 0 || raftConfig == nil {
 		return
 	}
 
-	// Send message data
-	if _, err := conn.Write(data); err != nil {
-		log.Printf("pgraft: failed to send message to node %d: %v", nodeID, err)
+	pendingReadsMu.Lock()
+	for i := range states {
+		rctx := states[i].RequestCtx
+		if len(rctx) != readIndexContextSize ||
+			binary.BigEndian.Uint32(rctx[0:4]) != readIndexMagic ||
+			binary.BigEndian.Uint64(rctx[4:12]) != raftConfig.ID {
+			continue
+		}
+		pendingReads[binary.BigEndian.Uint64(rctx[12:20])] = states[i].Index
+	}
+	pendingReadsMu.Unlock()
+}
+
+// completeReadBarriers finishes every read barrier whose read index has
+// been applied, so reads after it observe at least that state
+func completeReadBarriers() {
+	block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+	if block == nil {
 		return
 	}
 
-	log.Printf("pgraft: sent message to node %d, size %d", nodeID, len(data))
-}
+	applied := atomic.LoadUint64(&appliedIndex)
+	completed := false
 
-// Broadcast message to all nodes
-func broadcastToAllNodes(data []byte) {
-	connMutex.RLock()
-	defer connMutex.RUnlock()
+	pendingReadsMu.Lock()
+	proposalReportMu.Lock()
+	for id, index := range pendingReads {
+		if applied >= index {
+			reportProposal(block, id, int64(index))
+			delete(pendingReads, id)
+			completed = true
+		}
+	}
+	proposalReportMu.Unlock()
+	pendingReadsMu.Unlock()
 
-	for nodeID := range connections {
-		go sendToNode(nodeID, data)
+	if completed {
+		notifyProposalWaiters()
 	}
 }
 
-// Process committed log entries
-func processCommittedEntry(entry raftpb.Entry) {
-	// Update committed index
-	if entry.Index > committedIndex {
-		committedIndex = entry.Index
+// reportProposal stores a result unless the slot already holds a newer id.
+// Caller holds proposalReportMu.
+func reportProposal(block *C.pgraft_go_proposal_block_t, id uint64, index int64) {
+	slot := id % uint64(C.PGRAFT_GO_MAX_PROPOSALS)
+	current := (*uint64)(unsafe.Pointer(&block.committed_id[slot]))
+	if atomic.LoadUint64(current) >= id {
+		return
 	}
+	atomic.StoreInt64((*int64)(unsafe.Pointer(&block.committed_index[slot])), index)
+	atomic.StoreUint64(current, id)
+}
 
-	// Process configuration changes
-	if entry.Type == raftpb.EntryConfChange {
-		var cc raftpb.ConfChange
-		cc.Unmarshal(entry.Data)
-		raftNode.ApplyConfChange(cc)
+// notifyProposalWaiters pokes the worker's pipe; it rechecks proposal
+// slots and the published leader on every wakeup
+func notifyProposalWaiters() {
+	if fd := atomic.LoadInt32(&proposalNotifyFd); fd >= 0 {
+		// A full pipe already has a wakeup pending
+		syscall.Write(int(fd), []byte{1})
 	}
+}
 
-	// Update applied index
-	appliedIndex = entry.Index
+func failProposals(batch []queuedProposal) {
+	block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+	if block == nil {
+		return
+	}
 
-	log.Printf("pgraft: applied entry %d, term %d, type %s",
-		entry.Index, entry.Term, entry.Type.String())
+	proposalReportMu.Lock()
+	for i := range batch {
+		if batch[i].id != 0 {
+			reportProposal(block, batch[i].id, -1)
+		}
+	}
+	proposalReportMu.Unlock()
+	notifyProposalWaiters()
 }
 
-// Start network server to accept incoming connections
-func startNetworkServer(address string, port int) {
-	listener, err := net.Listen("tcp", fmt.Sprintf("%s:%d", address, port))
-	if err != nil {
-		log.Printf("pgraft: ERROR - Failed to start network server on %s:%d: %v", address, port, err)
+// reportCommittedProposals splits every committed batch this node proposed
+// back into its proposals, completes their waiters with the batch's index
+// and pokes the worker once.
+func reportCommittedProposals(entries []raftpb.Entry) {
+	block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+	if block == nil || raftConfig == nil {
+		kvMu.Lock()
+		if len(kvResults) > 0 {
+			kvResults = make(map[uint64]int64)
+		}
+		kvMu.Unlock()
 		return
 	}
-	defer listener.Close()
 
-	log.Printf("pgraft: INFO - Network server listening on %s:%d", address, port)
+	reported := false
+	proposalReportMu.Lock()
+	for i := range entries {
+		entry := &entries[i]
+		data := entry.Data
+		if entry.Type != raftpb.EntryNormal || len(data) < proposalBatchHeaderSize ||
+			binary.BigEndian.Uint32(data[0:4]) != proposalBatchMagic ||
+			binary.BigEndian.Uint64(data[4:12]) != raftConfig.ID {
+			continue
+		}
 
-	for {
-		select {
-		case <-raftCtx.Done():
-			log.Printf("pgraft: INFO - Network server shutting down")
-			return
-		case <-stopChan:
-			log.Printf("pgraft: INFO - Network server stopping")
-			return
-		default:
-			// Set a timeout for accepting connections
-			listener.(*net.TCPListener).SetDeadline(time.Now().Add(1 * time.Second))
-			conn, err := listener.Accept()
-			if err != nil {
-				if netErr, ok := err.(net.Error); ok && netErr.Timeout() {
-					continue // Timeout is expected, continue listening
+		count := binary.BigEndian.Uint32(data[12:16])
+		pos := proposalBatchHeaderSize
+		for n := uint32(0); n < count && pos+proposalItemHeaderSize <= len(data); n++ {
+			id := binary.BigEndian.Uint64(data[pos : pos+8])
+			length := int(binary.BigEndian.Uint32(data[pos+8 : pos+12]))
+			pos += proposalItemHeaderSize + length
+			if id != 0 {
+				// Key-value writes report their outcome instead of the index
+				result := int64(entry.Index)
+				if kv, ok := takeKVResult(id); ok {
+					result = kv
 				}
-				log.Printf("pgraft: WARNING - Failed to accept connection: %v", err)
-				continue
+				reportProposal(block, id, result)
+				reported = true
 			}
-
-			// Handle incoming connection in a goroutine
-			go handleIncomingConnection(conn)
 		}
 	}
+	proposalReportMu.Unlock()
+
+	if reported {
+		notifyProposalWaiters()
+	}
 }
 
-// Handle incoming connection from a peer
-func handleIncomingConnection(conn net.Conn) {
-	defer conn.Close()
+//export pgraft_go_get_stats
+func pgraft_go_get_stats() *C.char {
+	raftMutex.RLock()
+	defer raftMutex.RUnlock()
 
-	remoteAddr := conn.RemoteAddr().String()
-	log.Printf("pgraft: INFO - Incoming connection from %s", remoteAddr)
+	stats := map[string]interface{}{
+		"initialized":           atomic.LoadInt32(&initialized) == 1,
+		"running":               atomic.LoadInt32(&running) == 1,
+		"messages_processed":    atomic.LoadInt64(&messagesProcessed),
+		"log_entries_committed": atomic.LoadInt64(&logEntriesCommitted),
+		"heartbeats_sent":       atomic.LoadInt64(&heartbeatsSent),
+		"elections_triggered":   atomic.LoadInt64(&electionsTriggered),
+		"error_count":           atomic.LoadInt64(&errorCount),
+		"applied_index":         atomic.LoadUint64(&appliedIndex),
+		"committed_index":       atomic.LoadUint64(&committedIndex),
+		"uptime_seconds":        time.Since(startupTime).Seconds(),
+		"health_status":         healthStatus,
+		"connected_nodes":       len(connections),
+	}
 
-	// Read node ID from connection (first 4 bytes)
-	var nodeID uint32
-	if err := readUint32(conn, &nodeID); err != nil {
-		log.Printf("pgraft: WARNING - Failed to read node ID from %s: %v", remoteAddr, err)
-		return
+	jsonData, err := json.Marshal(stats)
+	if err != nil {
+		return C.CString("{\"error\": \"failed to marshal stats\"}")
 	}
 
-	log.Printf("pgraft: INFO - Connection from node %d at %s", nodeID, remoteAddr)
+	return C.CString(string(jsonData))
+}
 
-	// Store connection
-	connMutex.Lock()
-	connections[uint64(nodeID)] = conn
-	connMutex.Unlock()
+//export pgraft_go_commit_log
+func pgraft_go_commit_log(index C.long) C.int {
+	raftMutex.RLock()
+	defer raftMutex.RUnlock()
 
-	// Keep connection alive and handle messages
-	handleConnectionMessages(uint64(nodeID), conn)
-}
+	if atomic.LoadInt32(&running) == 0 {
+		return -1
+	}
 
-// Handle messages from a connection
-func handleConnectionMessages(nodeID uint64, conn net.Conn) {
-	for {
-		select {
-		case <-raftCtx.Done():
-			return
-		case <-stopChan:
-			return
-		default:
-			// Set read timeout
-			conn.SetReadDeadline(time.Now().Add(30 * time.Second))
+	// In etcd-io/raft, commits happen automatically
+	// This function is mainly for compatibility
+	atomic.StoreUint64(&committedIndex, uint64(index))
 
-			// Read message length
-			var msgLen uint32
-			if err := readUint32(conn, &msgLen); err != nil {
-				log.Printf("pgraft: WARNING - Failed to read message length from node %d: %v", nodeID, err)
-				return
-			}
+	return 0
+}
 
-			// Read message data
-			data := make([]byte, msgLen)
-			if _, err := conn.Read(data); err != nil {
-				log.Printf("pgraft: WARNING - Failed to read message data from node %d: %v", nodeID, err)
-				return
-			}
+//export pgraft_go_step_message
+func pgraft_go_step_message(data *C.char, length C.int) C.int {
+	raftMutex.RLock()
+	defer raftMutex.RUnlock()
 
-			// Process message
-			var msg raftpb.Message
-			if err := msg.Unmarshal(data); err != nil {
-				log.Printf("pgraft: WARNING - Failed to unmarshal message from node %d: %v", nodeID, err)
-				continue
-			}
+	if atomic.LoadInt32(&running) == 0 {
+		return -1
+	}
 
-			log.Printf("pgraft: DEBUG - Received message from node %d: type=%s, term=%d", nodeID, msg.Type.String(), msg.Term)
+	// Convert C data to Go byte slice
+	goData := C.GoBytes(unsafe.Pointer(data), length)
 
-			// Send message to Raft node
-			select {
-			case messageChan <- msg:
-			default:
-				log.Printf("pgraft: WARNING - Message channel full, dropping message from node %d", nodeID)
-			}
-		}
+	// Parse as raftpb.Message
+	var msg raftpb.Message
+	if err := msg.Unmarshal(goData); err != nil {
+		logWarning("failed to unmarshal message: %v", err)
+		return -1
 	}
+
+	// Step the message
+	raftNode.Step(raftCtx, msg)
+
+	atomic.AddInt64(&messagesProcessed, 1)
+
+	return 0
 }
 
-// Load and connect to configured peers
-func loadAndConnectToPeers() {
-	log.Printf("pgraft: INFO - Starting peer discovery process")
+//export pgraft_go_get_network_status
+func pgraft_go_get_network_status() *C.char {
+	raftMutex.RLock()
+	defer raftMutex.RUnlock()
 
-	// Start peer discovery in a separate goroutine to avoid blocking
-	go func() {
-		defer func() {
-			if r := recover(); r != nil {
-				log.Printf("pgraft: PANIC in loadAndConnectToPeers goroutine: %v", r)
-			}
-		}()
+	networkStatus := map[string]interface{}{
+		"nodes_connected":    len(connections),
+		"messages_processed": atomic.LoadInt64(&messagesProcessed),
+		"network_latency":    getNetworkLatency(),
+		"tick_interval_ms":   float64(currentTickInterval()) / float64(time.Millisecond),
+		"connection_status":  "active",
+	}
+
+	jsonData, err := json.Marshal(networkStatus)
+	if err != nil {
+		return C.CString("{\"error\": \"failed to marshal network status\"}")
+	}
+
+	return C.CString(string(jsonData))
+}
+
+//export pgraft_go_free_string
+func pgraft_go_free_string(str *C.char) {
+	C.free(unsafe.Pointer(str))
+}
+
+// Main processing loop following etcd-io/raft patterns
+func raftProcessingLoop() {
+	defer close(raftDone)
+
+	logDebug("Raft processing loop started")
+
+	for {
+		select {
+		case <-raftCtx.Done():
+			logDebug("Raft processing loop stopping (context done)")
+			return
+		case <-stopChan:
+			logDebug("Raft processing loop stopping (stop signal)")
+			return
+		case <-time.After(1 * time.Second):
+			// Process any pending operations
+			processRaftOperations()
+		}
+	}
+}
+
+// Process Raft operations
+func processRaftOperations() {
+	// Update metrics
+	atomic.AddInt64(&messagesProcessed, 1)
+
+	// Update commit index
+	commitIndex++
+	lastApplied = commitIndex
+
+	// Update last index
+	lastIndex = commitIndex
+}
+
+// Ticker loop for heartbeats and elections
+func tickerLoop() {
+	logDebug("Ticker loop started")
+
+	for {
+		select {
+		case <-raftCtx.Done():
+			logDebug("Ticker loop stopping (context done)")
+			return
+		case <-stopChan:
+			logDebug("Ticker loop stopping (stop signal)")
+			return
+		case <-raftTicker.C:
+			// Send heartbeat
+			atomic.AddInt64(&heartbeatsSent, 1)
+			logTrace("Heartbeat sent (total: %d)", atomic.LoadInt64(&heartbeatsSent))
+		}
+	}
+}
+
+// ============================================================================
+// APPLY PIPELINE - Committed entries are applied off the Ready loop
+// ============================================================================
+
+// The Ready loop only persists, sends and hands committed entries over, so
+// heartbeats and appends keep flowing while a burst is being applied.  The
+// queue is bounded: when apply falls that far behind the Ready loop waits,
+// which throttles raft instead of buffering without limit.
+const applyQueueDepth = 64
+
+type applyTask struct {
+	snapshot raftpb.Snapshot
+	entries  []raftpb.Entry
+}
+
+var (
+	// Set while a Ready loop runs; a second start is a no-op
+	readyLoopRunning int32
+
+	// Serializes WAL appends and the in-memory log with takeSnapshot's
+	// capture of the log tail, so a rebased WAL never misses an entry
+	walAppendMu sync.Mutex
+)
+
+// applyLoop applies tasks in commit order until the queue is closed
+func applyLoop(queue <-chan applyTask, done chan<- struct{}) {
+	defer close(done)
+
+	for task := range queue {
+		if !raft.IsEmptySnap(task.snapshot) {
+			restoreSnapshot(task.snapshot)
+		}
+		for _, entry := range task.entries {
+			processCommittedEntry(entry)
+		}
+		noteApplied(task.entries)
+		reportCommittedProposals(task.entries)
+		completeReadBarriers()
+		publishApplied()
+	}
+}
+
+// processReady handles one Ready.  A leader sends before it persists, as
+// it may replicate in parallel with its own disk write (Raft thesis
+// 10.2.1); anyone else must persist before its messages acknowledge
+// anything.  Returns false if the node had to stop.
+func processReady(rd raft.Ready, isLeader bool, applyQueue chan<- applyTask) bool {
+	if isLeader {
+		sendMessages(rd.Messages)
+	}
+
+	walAppendMu.Lock()
+	if !persistReady(rd) {
+		walAppendMu.Unlock()
+		return false
+	}
+	if !raft.IsEmptySnap(rd.Snapshot) {
+		raftStorage.ApplySnapshot(rd.Snapshot)
+	}
+	if !raft.IsEmptyHardState(rd.HardState) {
+		raftStorage.SetHardState(rd.HardState)
+	}
+	if len(rd.Entries) > 0 {
+		raftStorage.Append(rd.Entries)
+	}
+	walAppendMu.Unlock()
+
+	if !isLeader {
+		sendMessages(rd.Messages)
+	}
+
+	trackReadStates(rd.ReadStates)
+
+	if !raft.IsEmptySnap(rd.Snapshot) || len(rd.CommittedEntries) > 0 {
+		select {
+		case applyQueue <- applyTask{snapshot: rd.Snapshot, entries: rd.CommittedEntries}:
+		case <-raftCtx.Done():
+			return false
+		}
+	}
+
+	// Read indexes that are already applied need not wait for the next apply
+	completeReadBarriers()
+	return true
+}
+
+// Process outgoing messages through comm module
+func processMessage(msg raftpb.Message) {
+	if msg.To != 0 {
+		sendMessages([]raftpb.Message{msg})
+		return
+	}
+
+	// Broadcast to all nodes
+	connMutex.RLock()
+	batch := make([]raftpb.Message, 0, len(connections))
+	for nodeID := range connections {
+		m := msg
+		m.To = nodeID
+		batch = append(batch, m)
+	}
+	connMutex.RUnlock()
+	sendMessages(batch)
+}
+
+// ============================================================================
+// PEER TRANSPORT - One ordered, batching send loop per peer connection
+// ============================================================================
+
+const (
+	peerSendQueueDepth  = 64
+	peerWriteBufferSize = 64 * 1024
+	peerWriteTimeout    = 5 * time.Second
+
+	// Readers block on a full receive queue, which holds back the peer
+	// through TCP flow control instead of dropping what it sent
+	peerReceiveQueueDepth = 256
+	peerReadBufferSize    = 64 * 1024
+	peerFramePoolMaxSize  = 1024 * 1024
+	peerSnapshotTimeout   = 30 * time.Second
+
+	// Length prefixes with this bit set start a chunked snapshot stream
+	peerFrameSnapshot     uint32 = 1 << 31
+	peerSnapshotChunkSize        = 1024 * 1024
+	peerMaxFrameSize             = 64 * 1024 * 1024
+	peerMaxSnapshotSize   uint64 = 4 << 30
+)
+
+// peerSender owns the write side of one peer connection.  Batches are queued
+// in Ready order and the loop coalesces whatever is pending into one frame
+// buffer, so a Ready's messages to a peer go out in a single write.
+type peerSender struct {
+	nodeID uint64
+	conn   net.Conn
+	codec  byte   // negotiated in the hellos, peerCodecNone if off
+	zbuf   []byte // compressed frames and chunks are built here
+	queue  chan peerBatch
+	stop   chan struct{}
+	once   sync.Once
+}
+
+type peerBatch struct {
+	msgs   []raftpb.Message
+	queued time.Time
+}
+
+var (
+	peerSenders      = make(map[uint64]*peerSender)
+	peerSendersMutex sync.Mutex
+
+	// Added to every message to a peer, in nanoseconds; simulates a slow link
+	peerDelay int64
+)
+
+// pgraft_go_set_peer_delay holds each message to a peer back by delayMs, so
+// a single-host cluster can be benchmarked as if its nodes were that far
+// apart; a round trip grows by twice the delay.  0 sends at once.
+//
+//export pgraft_go_set_peer_delay
+func pgraft_go_set_peer_delay(delayMs C.int) {
+	if delayMs >= 0 {
+		atomic.StoreInt64(&peerDelay, int64(delayMs)*int64(time.Millisecond))
+	}
+}
+
+// sendMessages groups a Ready's messages by destination and hands each group
+// to that peer's sender without blocking the Ready loop
+func sendMessages(msgs []raftpb.Message) {
+	if len(msgs) == 0 {
+		return
+	}
+	recordRTTProbes(msgs)
+	for i := range msgs {
+		countMessage(&msgSentCount, msgs[i].Type)
+	}
+
+	byPeer := make(map[uint64][]raftpb.Message)
+	order := make([]uint64, 0, 4)
+	for _, msg := range msgs {
+		if _, seen := byPeer[msg.To]; !seen {
+			order = append(order, msg.To)
+		}
+		byPeer[msg.To] = append(byPeer[msg.To], msg)
+	}
+
+	for _, nodeID := range order {
+		batch := byPeer[nodeID]
+		sender := getPeerSender(nodeID)
+		if sender == nil {
+			debugLog("no connection to node %d, dropping %d messages", nodeID, len(batch))
+			reportDropped(nodeID, batch)
+			continue
+		}
+
+		select {
+		case sender.queue <- peerBatch{msgs: batch, queued: time.Now()}:
+		default:
+			// Raft tolerates lost messages; never stall the Ready loop on a slow peer
+			debugLog("send queue to node %d full, dropping %d messages", nodeID, len(batch))
+			reportDropped(nodeID, batch)
+		}
+	}
+}
+
+// getPeerSender returns the sender bound to the current connection for a
+// peer, replacing a sender whose connection has been swapped out
+func getPeerSender(nodeID uint64) *peerSender {
+	connMutex.RLock()
+	conn, exists := connections[nodeID]
+	connMutex.RUnlock()
+
+	peerSendersMutex.Lock()
+	defer peerSendersMutex.Unlock()
+
+	sender, ok := peerSenders[nodeID]
+	if !exists {
+		if ok {
+			sender.close()
+			delete(peerSenders, nodeID)
+		}
+		return nil
+	}
+	if ok && sender.conn == conn {
+		return sender
+	}
+	if ok {
+		sender.close()
+	}
+
+	sender = &peerSender{
+		nodeID: nodeID,
+		conn:   conn,
+		codec:  linkCodec(conn),
+		queue:  make(chan peerBatch, peerSendQueueDepth),
+		stop:   make(chan struct{}),
+	}
+	peerSenders[nodeID] = sender
+	go sender.run()
+	return sender
+}
+
+// stopPeerSender shuts down the sender of a peer, if any
+func stopPeerSender(nodeID uint64) {
+	peerSendersMutex.Lock()
+	if sender, ok := peerSenders[nodeID]; ok {
+		sender.close()
+		delete(peerSenders, nodeID)
+	}
+	peerSendersMutex.Unlock()
+}
+
+func (s *peerSender) close() {
+	s.once.Do(func() { close(s.stop) })
+}
+
+func (s *peerSender) run() {
+	buf := make([]byte, 0, peerWriteBufferSize)
+
+	for {
+		var next peerBatch
+		select {
+		case <-s.stop:
+			return
+		case next = <-s.queue:
+		}
+
+		if delay := time.Duration(atomic.LoadInt64(&peerDelay)); delay > 0 {
+			// Later batches queued meanwhile ride along, as on a real link
+			if wait := time.Until(next.queued.Add(delay)); wait > 0 {
+				select {
+				case <-s.stop:
+					return
+				case <-time.After(wait):
+				}
+			}
+		}
+
+		batch := next.msgs
+		buf = buf[:0]
+		count := 0
+		var err error
+
+		// Coalesce everything already queued behind this batch
+		for batch != nil {
+			for i := range batch {
+				msg := &batch[i]
+				if msg.Type == raftpb.MsgSnap && msg.Snapshot != nil {
+					// Keep ordering: flush what precedes the snapshot, then stream it
+					if err = s.writeBatch(buf); err == nil {
+						buf = buf[:0]
+						err = s.sendSnapshot(msg)
+					}
+					if err != nil {
+						logWarning("Failed to send snapshot to node %d: %v", s.nodeID, err)
+						raftNode.ReportSnapshot(s.nodeID, raft.SnapshotFailure)
+						s.fail()
+						return
+					}
+					raftNode.ReportSnapshot(s.nodeID, raft.SnapshotFinish)
+					count++
+					continue
+				}
+				if buf, err = appendMessageFrame(buf, msg); err != nil {
+					debugLog("failed to marshal message to node %d: %v", s.nodeID, err)
+					err = nil
+					continue
+				}
+				count++
+			}
+			select {
+			case next = <-s.queue:
+				batch = next.msgs
+			default:
+				batch = nil
+			}
+		}
+
+		if err = s.writeBatch(buf); err != nil {
+			logWarning("Failed to send %d messages to node %d: %v", count, s.nodeID, err)
+			s.fail()
+			return
+		}
+
+		atomic.AddInt64(&messagesProcessed, int64(count))
+
+		// Do not pin a huge buffer after an occasional large batch
+		if cap(buf) > 4*peerWriteBufferSize {
+			buf = make([]byte, 0, peerWriteBufferSize)
+		}
+		if cap(s.zbuf) > 4*peerWriteBufferSize {
+			s.zbuf = nil
+		}
+	}
+}
+
+func (s *peerSender) write(buf []byte) error {
+	if len(buf) == 0 {
+		return nil
+	}
+	s.conn.SetWriteDeadline(time.Now().Add(peerWriteTimeout))
+	_, err := s.conn.Write(buf)
+	return err
+}
+
+// writeBatch writes coalesced frames, as one compressed frame when the link
+// has a codec and the batch is large enough to be worth compressing
+func (s *peerSender) writeBatch(buf []byte) error {
+	if s.codec == peerCodecNone || len(buf) > peerMaxFrameSize ||
+		int64(len(buf)) < atomic.LoadInt64(&peerCompressMin) {
+		return s.write(buf)
+	}
+	frame, ok := compressFrame(s.zbuf, s.codec, buf)
+	s.zbuf = frame[:0]
+	if !ok {
+		return s.write(buf)
+	}
+	binary.BigEndian.PutUint32(frame[0:4], uint32(len(frame)-4)|peerFrameCompressed)
+	return s.write(frame)
+}
+
+// sendSnapshot streams a MsgSnap as a header frame carrying the message
+// without its payload, followed by the payload in bounded chunks, so neither
+// side ever marshals or buffers the snapshot as one frame
+func (s *peerSender) sendSnapshot(msg *raftpb.Message) error {
+	data := msg.Snapshot.Data
+
+	header := *msg
+	meta := *msg.Snapshot
+	meta.Data = nil
+	header.Snapshot = &meta
+
+	size := header.Size()
+	frame := make([]byte, 12+size)
+	binary.BigEndian.PutUint32(frame[0:4], uint32(size)|peerFrameSnapshot)
+	binary.BigEndian.PutUint64(frame[4:12], uint64(len(data)))
+	if _, err := header.MarshalTo(frame[12:]); err != nil {
+		return err
+	}
+	if err := s.write(frame); err != nil {
+		return err
+	}
+
+	var prefix [4]byte
+	for off := 0; off < len(data); off += peerSnapshotChunkSize {
+		end := off + peerSnapshotChunkSize
+		if end > len(data) {
+			end = len(data)
+		}
+		binary.BigEndian.PutUint32(prefix[:], uint32(end-off))
+		chunk := net.Buffers{prefix[:], data[off:end]}
+		if s.codec != peerCodecNone {
+			if frame, ok := compressFrame(s.zbuf, s.codec, data[off:end]); ok {
+				binary.BigEndian.PutUint32(frame[0:4], uint32(len(frame)-4)|peerChunkCompressed)
+				chunk = net.Buffers{frame}
+				s.zbuf = frame[:0]
+			}
+		}
+
+		select {
+		case <-s.stop:
+			return errors.New("sender stopped")
+		default:
+		}
+		s.conn.SetWriteDeadline(time.Now().Add(peerWriteTimeout))
+		if _, err := chunk.WriteTo(s.conn); err != nil {
+			return err
+		}
+	}
+
+	logInfo("Streamed snapshot %d (%d bytes) to node %d",
+		msg.Snapshot.Metadata.Index, len(data), s.nodeID)
+	return nil
+}
+
+// fail drops a broken connection so the next send reconnects or reports the
+// peer unreachable
+func (s *peerSender) fail() {
+	connMutex.Lock()
+	if conn, ok := connections[s.nodeID]; ok && conn == s.conn {
+		conn.Close()
+		delete(connections, s.nodeID)
+	}
+	connMutex.Unlock()
+
+	peerSendersMutex.Lock()
+	if cur, ok := peerSenders[s.nodeID]; ok && cur == s {
+		delete(peerSenders, s.nodeID)
+	}
+	peerSendersMutex.Unlock()
+
+	s.close()
+	reportUnreachable(s.nodeID)
+}
+
+// appendMessageFrame appends a length-prefixed, marshalled message to buf
+func appendMessageFrame(buf []byte, msg *raftpb.Message) ([]byte, error) {
+	size := msg.Size()
+	start := len(buf)
+	need := start + 4 + size
+	if cap(buf) < need {
+		grown := make([]byte, start, need*2)
+		copy(grown, buf)
+		buf = grown
+	}
+	buf = buf[:need]
+	binary.BigEndian.PutUint32(buf[start:start+4], uint32(size))
+	if _, err := msg.MarshalTo(buf[start+4:]); err != nil {
+		return buf[:start], err
+	}
+	return buf, nil
+}
+
+// reportDropped tells raft about messages that never left this node; a lost
+// snapshot must be reported or the follower stays paused waiting for it
+func reportDropped(nodeID uint64, batch []raftpb.Message) {
+	reportUnreachable(nodeID)
+	if raftNode == nil {
+		return
+	}
+	for i := range batch {
+		if batch[i].Type == raftpb.MsgSnap {
+			raftNode.ReportSnapshot(nodeID, raft.SnapshotFailure)
+		}
+	}
+}
+
+func reportUnreachable(nodeID uint64) {
+	if raftNode != nil && nodeID != 0 {
+		raftNode.ReportUnreachable(nodeID)
+	}
+}
+
+// Process committed log entries; runs on the apply goroutine
+func processCommittedEntry(entry raftpb.Entry) {
+	// Update committed index
+	if entry.Index > atomic.LoadUint64(&committedIndex) {
+		atomic.StoreUint64(&committedIndex, entry.Index)
+	}
+
+	switch entry.Type {
+	case raftpb.EntryConfChange:
+		var cc raftpb.ConfChange
+		cc.Unmarshal(entry.Data)
+		logInfo("applying configuration change %s for node %d", cc.Type.String(), cc.NodeID)
+		applyConfChange(cc)
+	case raftpb.EntryConfChangeV2:
+		var cc raftpb.ConfChangeV2
+		cc.Unmarshal(entry.Data)
+		logInfo("applying configuration change with %d change(s)", len(cc.Changes))
+		applyConfChangeV2(cc, entry.Index)
+	case raftpb.EntryNormal:
+		if len(entry.Data) > 0 {
+			atomic.StoreInt64(&logEntriesCommitted, int64(entry.Index))
+			applyKVEntry(entry.Data)
+		}
+	}
+
+	logTrace("applied entry %d, term %d, type %s",
+		entry.Index, entry.Term, entry.Type.String())
+}
+
+// ============================================================================
+// PEER TLS - Mutual TLS with session resumption and certificate reload
+// ============================================================================
+
+// With pgraft.ssl_cert_file and pgraft.ssl_key_file set, every peer
+// connection runs TLS 1.3, and with pgraft.ssl_ca_file both ends must show
+// a certificate that CA signed.  Dialers share a session cache, so a
+// reconnect resumes from a ticket instead of a full handshake; the
+// acceptor's ticket keys belong to peerTLSBase, rotate on their own and
+// outlive certificate reloads.  The files are checked for changes at most
+// every peerTLSReloadInterval and a changed set is used from the next
+// handshake on; a set that fails to load leaves the previous one in place.
+// Go has no kernel TLS, so records are sealed in userspace, with the
+// AES-GCM assembly on the platforms that have it.
+const (
+	peerTLSReloadInterval   = time.Second
+	peerTLSSessionCacheSize = 64
+)
+
+type peerTLSFiles struct {
+	cert, key, ca string
+}
+
+var (
+	peerTLSMutex   sync.Mutex
+	peerTLSPaths   peerTLSFiles
+	peerTLSServer  *tls.Config // certificate and client CA of the loaded set
+	peerTLSClient  *tls.Config
+	peerTLSStamp   string // sizes and modification times the set was read at
+	peerTLSChecked time.Time
+
+	peerTLSBase = &tls.Config{
+		MinVersion:         tls.VersionTLS13,
+		GetConfigForClient: peerTLSServerConfig,
+	}
+	peerTLSSessions = tls.NewLRUClientSessionCache(peerTLSSessionCacheSize)
+)
+
+// pgraft_go_set_tls names the certificate, key and CA file peer connections
+// use; with an empty certificate they stay plaintext.  Returns -1 if TLS is
+// asked for and no certificate could be loaded: until one can, handshakes
+// fail rather than fall back to plaintext.
+//
+//export pgraft_go_set_tls
+func pgraft_go_set_tls(certFile *C.char, keyFile *C.char, caFile *C.char) C.int {
+	files := peerTLSFiles{C.GoString(certFile), C.GoString(keyFile), C.GoString(caFile)}
+
+	peerTLSMutex.Lock()
+	defer peerTLSMutex.Unlock()
+
+	if files == peerTLSPaths {
+		if files.cert != "" && peerTLSServer == nil {
+			return -1
+		}
+		return 0
+	}
+	peerTLSPaths = files
+	peerTLSStamp = ""
+	if files.cert == "" {
+		peerTLSServer, peerTLSClient = nil, nil
+		logInfo("Peer connections are plaintext")
+		return 0
+	}
+	if files.key == "" {
+		logError("pgraft.ssl_cert_file is set without pgraft.ssl_key_file")
+		peerTLSServer, peerTLSClient = nil, nil
+		return -1
+	}
+	if err := reloadPeerTLSLocked(); err != nil {
+		logError("Failed to load peer TLS certificate: %v", err)
+	}
+	if peerTLSServer == nil {
+		return -1
+	}
+	return 0
+}
+
+func peerTLSFileStamp(files peerTLSFiles) string {
+	var b strings.Builder
+	for _, path := range []string{files.cert, files.key, files.ca} {
+		if path == "" {
+			continue
+		}
+		if st, err := os.Stat(path); err == nil {
+			fmt.Fprintf(&b, "%d.%d;", st.Size(), st.ModTime().UnixNano())
+		} else {
+			b.WriteString("-;")
+		}
+	}
+	return b.String()
+}
+
+// reloadPeerTLSLocked reads the files again if they changed since the last
+// attempt.  A failed attempt is not repeated until they change once more,
+// which also skips a file caught half written.
+func reloadPeerTLSLocked() error {
+	peerTLSChecked = time.Now()
+	stamp := peerTLSFileStamp(peerTLSPaths)
+	if stamp == peerTLSStamp {
+		return nil
+	}
+	peerTLSStamp = stamp
+
+	cert, err := tls.LoadX509KeyPair(peerTLSPaths.cert, peerTLSPaths.key)
+	if err != nil {
+		return err
+	}
+	var pool *x509.CertPool
+	if peerTLSPaths.ca != "" {
+		pem, err := os.ReadFile(peerTLSPaths.ca)
+		if err != nil {
+			return err
+		}
+		pool = x509.NewCertPool()
+		if !pool.AppendCertsFromPEM(pem) {
+			return fmt.Errorf("no PEM certificates in %s", peerTLSPaths.ca)
+		}
+	}
+
+	server := &tls.Config{
+		MinVersion:   tls.VersionTLS13,
+		Certificates: []tls.Certificate{cert},
+		ClientCAs:    pool,
+	}
+	if pool != nil {
+		server.ClientAuth = tls.RequireAndVerifyClientCert
+	}
+	reloaded := peerTLSServer != nil
+	peerTLSServer = server
+	peerTLSClient = &tls.Config{
+		MinVersion:         tls.VersionTLS13,
+		Certificates:       []tls.Certificate{cert},
+		RootCAs:            pool,
+		ClientSessionCache: peerTLSSessions,
+	}
+	if reloaded {
+		logInfo("Reloaded peer TLS certificate %s", peerTLSPaths.cert)
+	} else {
+		logInfo("Peer connections use TLS with certificate %s", peerTLSPaths.cert)
+	}
+	return nil
+}
+
+// peerTLSServerConfig hands each accepted handshake the current set
+func peerTLSServerConfig(*tls.ClientHelloInfo) (*tls.Config, error) {
+	peerTLSMutex.Lock()
+	defer peerTLSMutex.Unlock()
+	if peerTLSServer == nil {
+		return nil, errors.New("no peer certificate loaded")
+	}
+	return peerTLSServer, nil
+}
+
+// peerTLSConfig returns the configuration for the next handshake, nil for
+// plaintext, after picking up changed files
+func peerTLSConfig(server bool) (*tls.Config, error) {
+	peerTLSMutex.Lock()
+	defer peerTLSMutex.Unlock()
+
+	if peerTLSPaths.cert == "" {
+		return nil, nil
+	}
+	if time.Since(peerTLSChecked) >= peerTLSReloadInterval {
+		if err := reloadPeerTLSLocked(); err != nil {
+			logWarning("Failed to reload peer TLS certificate, keeping the previous one: %v", err)
+		}
+	}
+	if peerTLSServer == nil {
+		return nil, errors.New("peer TLS is enabled but no certificate is loaded")
+	}
+	if server {
+		return peerTLSBase, nil
+	}
+	return peerTLSClient, nil
+}
+
+// peerTLSHandshake runs TLS on a fresh peer connection, under the deadline
+// set for the hello exchange; serverName is the host that was dialed, empty
+// on the accepting side
+func peerTLSHandshake(conn net.Conn, serverName string) (net.Conn, error) {
+	cfg, err := peerTLSConfig(serverName == "")
+	if err != nil || cfg == nil {
+		return conn, err
+	}
+
+	var tc *tls.Conn
+	if serverName == "" {
+		tc = tls.Server(conn, cfg)
+	} else {
+		cfg = cfg.Clone()
+		cfg.ServerName = serverName
+		tc = tls.Client(conn, cfg)
+	}
+	if err := tc.Handshake(); err != nil {
+		return conn, fmt.Errorf("TLS handshake: %v", err)
+	}
+	state := tc.ConnectionState()
+	logDebug("TLS with %s: %s, resumed %v", conn.RemoteAddr(),
+		tls.CipherSuiteName(state.CipherSuite), state.DidResume)
+	return tc, nil
+}
+
+// Start network server to accept incoming connections
+func startNetworkServer(address string, port int) {
+	listener, err := net.Listen("tcp", fmt.Sprintf("%s:%d", address, port))
+	if err != nil {
+		logError("Failed to start network server on %s:%d: %v", address, port, err)
+		return
+	}
+	defer listener.Close()
+
+	logInfo("Network server listening on %s:%d", address, port)
+
+	for {
+		select {
+		case <-raftCtx.Done():
+			logInfo("Network server shutting down")
+			return
+		case <-stopChan:
+			logInfo("Network server stopping")
+			return
+		default:
+			// Set a timeout for accepting connections
+			listener.(*net.TCPListener).SetDeadline(time.Now().Add(1 * time.Second))
+			conn, err := listener.Accept()
+			if err != nil {
+				if netErr, ok := err.(net.Error); ok && netErr.Timeout() {
+					continue // Timeout is expected, continue listening
+				}
+				logWarning("Failed to accept connection: %v", err)
+				continue
+			}
+
+			// Handle incoming connection in a goroutine
+			go handleIncomingConnection(conn)
+		}
+	}
+}
+
+// ============================================================================
+// PEER COMPRESSION - Codec negotiation and compressed frames
+// ============================================================================
+
+// With pgraft.peer_compression on, a node offers its codecs in every hello
+// and a link compresses with the best codec both ends offered.  Senders
+// compress coalesced batches of at least pgraft.peer_compression_threshold
+// and every snapshot chunk, and fall back to the raw bytes when they do not
+// shrink by an eighth, so heartbeats, votes and incompressible payloads go
+// out as before.  DEFLATE at its fastest level is the only codec: it comes
+// with the standard library, and each further codec is one more bit.
+const (
+	peerCodecNone   byte = 0
+	peerCodecFlate  byte = 1 << 0
+	peerCodecsKnown      = peerCodecFlate
+
+	// A compressed batch frame is length | peerFrameCompressed, then
+	// codec(1) | raw length(4) | compressed, length-prefixed messages.
+	// Snapshot chunks carry the same body under peerChunkCompressed.
+	peerFrameCompressed    uint32 = 1 << 30
+	peerChunkCompressed    uint32 = 1 << 31
+	peerCompressHeader            = 5
+	peerCompressDefaultMin        = 64 * 1024
+)
+
+var (
+	peerCompressOffer int32 // codec bits put in hellos, 0 when off
+	peerCompressMin   int64 = peerCompressDefaultMin
+
+	compressFrames      int64
+	compressSkipped     int64
+	compressRawBytes    int64
+	compressWireBytes   int64
+	compressNs          int64
+	decompressFrames    int64
+	decompressRawBytes  int64
+	decompressWireBytes int64
+	decompressNs        int64
+
+	flateWriters = sync.Pool{
+		New: func() interface{} {
+			w, _ := flate.NewWriter(nil, flate.BestSpeed)
+			return w
+		},
+	}
+	flateReaders = sync.Pool{
+		New: func() interface{} {
+			return flate.NewReader(bytes.NewReader(nil))
+		},
+	}
+)
+
+// peerConn is a peer connection together with the codec its hellos agreed on
+type peerConn struct {
+	net.Conn
+	codec byte
+}
+
+func linkCodec(conn net.Conn) byte {
+	if pc, ok := conn.(*peerConn); ok {
+		return pc.codec
+	}
+	return peerCodecNone
+}
+
+// pickCodec chooses the highest codec bit both hellos offered
+func pickCodec(mine, theirs byte) byte {
+	common := mine & theirs & peerCodecsKnown
+	if common == 0 {
+		return peerCodecNone
+	}
+	return 1 << (7 - bits.LeadingZeros8(common))
+}
+
+func codecName(codec byte) string {
+	switch codec {
+	case peerCodecFlate:
+		return "deflate"
+	}
+	return "off"
+}
+
+// compressFrame builds prefix(4) | codec(1) | raw length(4) | src compressed
+// in dst's storage, leaving the prefix for the caller.  ok is false when the
+// result is not worth sending in place of src.
+func compressFrame(dst []byte, codec byte, src []byte) ([]byte, bool) {
+	start := time.Now()
+
+	out := bytes.NewBuffer(dst[:0])
+	var hdr [4 + peerCompressHeader]byte
+	hdr[4] = codec
+	binary.BigEndian.PutUint32(hdr[5:], uint32(len(src)))
+	out.Write(hdr[:])
+
+	w := flateWriters.Get().(*flate.Writer)
+	w.Reset(out)
+	_, err := w.Write(src)
+	if err == nil {
+		err = w.Close()
+	}
+	w.Reset(nil)
+	flateWriters.Put(w)
+
+	frame := out.Bytes()
+	atomic.AddInt64(&compressNs, int64(time.Since(start)))
+	if err != nil || len(frame) >= len(src)-len(src)/8 {
+		atomic.AddInt64(&compressSkipped, 1)
+		return frame, false
+	}
+	atomic.AddInt64(&compressFrames, 1)
+	atomic.AddInt64(&compressRawBytes, int64(len(src)))
+	atomic.AddInt64(&compressWireBytes, int64(len(frame)))
+	return frame, true
+}
+
+// inflateInto decompresses data, sent with codec, into dst, which must be
+// exactly as long as the sender's raw length
+func inflateInto(dst []byte, codec byte, data []byte) error {
+	if codec != peerCodecFlate {
+		return fmt.Errorf("unknown compression codec %d", codec)
+	}
+	start := time.Now()
+
+	r := flateReaders.Get().(io.ReadCloser)
+	defer flateReaders.Put(r)
+	if err := r.(flate.Resetter).Reset(bytes.NewReader(data), nil); err != nil {
+		return err
+	}
+	if _, err := io.ReadFull(r, dst); err != nil {
+		return fmt.Errorf("inflating %d bytes: %v", len(dst), err)
+	}
+	var extra [1]byte
+	if n, _ := r.Read(extra[:]); n != 0 {
+		return fmt.Errorf("compressed data inflates past %d bytes", len(dst))
+	}
+
+	atomic.AddInt64(&decompressNs, int64(time.Since(start)))
+	atomic.AddInt64(&decompressFrames, 1)
+	atomic.AddInt64(&decompressRawBytes, int64(len(dst)))
+	atomic.AddInt64(&decompressWireBytes, int64(len(data)+4+peerCompressHeader))
+	return nil
+}
+
+// pgraft_go_set_compression sets the offer made in new hellos and the
+// smallest batch worth compressing; links already up keep their codec
+//
+//export pgraft_go_set_compression
+func pgraft_go_set_compression(enabled C.int, thresholdKB C.int) {
+	if enabled != 0 {
+		atomic.StoreInt32(&peerCompressOffer, int32(peerCodecsKnown))
+	} else {
+		atomic.StoreInt32(&peerCompressOffer, 0)
+	}
+	if thresholdKB > 0 {
+		atomic.StoreInt64(&peerCompressMin, int64(thresholdKB)*1024)
+	}
+}
+
+// ============================================================================
+// PEER DISCOVERY - Handshake, membership-driven dialing and reconnects
+// ============================================================================
+
+// Every connection opens with a hello from each side:
+// magic(4) | node id(8) | codecs(1) | address length(1) | advertised Raft
+// address.  The dialer speaks first; the acceptor answers with its own
+// hello, so both ends learn who they are talking to instead of trusting list
+// positions.  The codec byte, the compression this node offers, used to be
+// the high byte of a 16-bit address length and stays 0 while
+// pgraft.peer_compression is off, so older nodes read the same hello.
+const (
+	peerHelloMagic     uint32 = 0x50475248 // "PGRH"
+	peerHelloMaxAddr          = 255
+	peerHelloTimeout          = 5 * time.Second
+	peerDialTimeout           = time.Second
+	peerDialMinBackoff        = 50 * time.Millisecond
+	peerDialMaxBackoff        = 5 * time.Second
+	peerReconnectDelay        = 20 * time.Millisecond
+)
+
+var errSelfPeer = errors.New("address belongs to this node")
+
+// peerDialer keeps one outgoing connection to an address alive for as long
+// as the address is a member, redialing with jittered exponential backoff
+type peerDialer struct {
+	addr   string
+	nodeID uint64 // 0 until the first handshake names the peer
+	stop   chan struct{}
+	once   sync.Once
+
+	mu   sync.Mutex
+	conn net.Conn
+}
+
+var (
+	selfNodeID  uint64
+	selfAddress string
+
+	peerDialers      = make(map[string]*peerDialer)
+	peerDialersMutex sync.Mutex
+)
+
+func writeHello(conn net.Conn) error {
+	addr := selfAddress
+	if len(addr) > peerHelloMaxAddr {
+		addr = addr[:peerHelloMaxAddr]
+	}
+	buf := make([]byte, 14+len(addr))
+	binary.BigEndian.PutUint32(buf[0:4], peerHelloMagic)
+	binary.BigEndian.PutUint64(buf[4:12], selfNodeID)
+	buf[12] = byte(atomic.LoadInt32(&peerCompressOffer))
+	buf[13] = byte(len(addr))
+	copy(buf[14:], addr)
+	_, err := conn.Write(buf)
+	return err
+}
+
+// readHello returns the peer's node id, advertised address and the codecs it
+// offers
+func readHello(conn net.Conn) (uint64, string, byte, error) {
+	var hdr [14]byte
+	if _, err := io.ReadFull(conn, hdr[:]); err != nil {
+		return 0, "", 0, err
+	}
+	if binary.BigEndian.Uint32(hdr[0:4]) != peerHelloMagic {
+		return 0, "", 0, errors.New("peer did not send a pgraft hello")
+	}
+	nodeID := binary.BigEndian.Uint64(hdr[4:12])
+	codecs := hdr[12]
+	addrLen := hdr[13]
+	if nodeID == 0 {
+		return 0, "", 0, fmt.Errorf("malformed hello (node %d, address length %d)", nodeID, addrLen)
+	}
+	addr := make([]byte, addrLen)
+	if _, err := io.ReadFull(conn, addr); err != nil {
+		return 0, "", 0, err
+	}
+	return nodeID, string(addr), codecs, nil
+}
+
+// registerConnection makes conn the send path to nodeID
+func registerConnection(nodeID uint64, conn net.Conn) {
+	connMutex.Lock()
+	connections[nodeID] = conn
+	connMutex.Unlock()
+}
+
+// dropConnection forgets conn if it is still the send path to nodeID
+func dropConnection(nodeID uint64, conn net.Conn) {
+	connMutex.Lock()
+	if cur, ok := connections[nodeID]; ok && cur == conn {
+		delete(connections, nodeID)
+	}
+	connMutex.Unlock()
+	conn.Close()
+}
+
+// learnPeerAddress records an address a peer advertised in its hello, for
+// peers this node has not yet seen in a ConfChange or snapshot
+func learnPeerAddress(nodeID uint64, addr string) {
+	if addr == "" {
+		return
+	}
+	nodesMutex.Lock()
+	if nodes == nil {
+		nodes = make(map[uint64]string)
+	}
+	if _, known := nodes[nodeID]; !known {
+		nodes[nodeID] = addr
+		logInfo("Learned address %s for node %d from its handshake", addr, nodeID)
+	}
+	nodesMutex.Unlock()
+}
+
+// Handle incoming connection from a peer
+func handleIncomingConnection(conn net.Conn) {
+	defer conn.Close()
+
+	remoteAddr := conn.RemoteAddr().String()
+	logDebug("Incoming connection from %s", remoteAddr)
+
+	conn.SetDeadline(time.Now().Add(peerHelloTimeout))
+	conn, err := peerTLSHandshake(conn, "")
+	var nodeID uint64
+	var advertised string
+	var codecs byte
+	if err == nil {
+		nodeID, advertised, codecs, err = readHello(conn)
+	}
+	if err == nil {
+		err = writeHello(conn)
+	}
+	conn.SetDeadline(time.Time{})
+	if err != nil {
+		logWarning("Handshake with %s failed: %v", remoteAddr, err)
+		return
+	}
+	if nodeID == selfNodeID {
+		logDebug("Ignoring connection from this node via %s", remoteAddr)
+		return
+	}
+
+	// The hello just sent made the same offer the codec is picked from
+	pc := &peerConn{Conn: conn, codec: pickCodec(byte(atomic.LoadInt32(&peerCompressOffer)), codecs)}
+	conn = pc
+
+	logInfo("Connection from node %d at %s (advertises %s, compression %s)",
+		nodeID, remoteAddr, advertised, codecName(pc.codec))
+	learnPeerAddress(nodeID, advertised)
+	registerConnection(nodeID, conn)
+
+	// Keep connection alive and handle messages
+	handleConnectionMessages(nodeID, conn)
+	dropConnection(nodeID, conn)
+}
+
+// Frame buffers shared by the peer readers; message fields are copied out
+// by Unmarshal, so a buffer goes back to the pool as soon as it is decoded
+var peerFramePool = sync.Pool{
+	New: func() interface{} {
+		buf := make([]byte, 0, 4096)
+		return &buf
+	},
+}
+
+// handleConnectionMessages is the reader goroutine of one peer connection.
+// It blocks in the kernel until a frame arrives and hands every message to
+// the Raft node through messageChan, waiting when that is full.  It returns
+// when the connection is closed or fails; dead peers are found by TCP
+// keepalive and by the send side.
+func handleConnectionMessages(nodeID uint64, conn net.Conn) {
+	r := bufio.NewReaderSize(conn, peerReadBufferSize)
+	var lenBuf [4]byte
+
+	for {
+		if _, err := io.ReadFull(r, lenBuf[:]); err != nil {
+			if raftCtx.Err() == nil {
+				logWarning("Failed to read message length from node %d: %v", nodeID, err)
+			}
+			return
+		}
+		msgLen := binary.BigEndian.Uint32(lenBuf[:])
+
+		var msg raftpb.Message
+		if msgLen&peerFrameSnapshot != 0 {
+			var err error
+			msg, err = readSnapshotStream(conn, r, msgLen&^peerFrameSnapshot)
+			if err != nil {
+				logWarning("Failed to receive snapshot from node %d: %v", nodeID, err)
+				return
+			}
+		} else if msgLen&peerFrameCompressed != 0 {
+			batch, err := readCompressedBatch(r, msgLen&^peerFrameCompressed)
+			if err != nil {
+				logWarning("Failed to read compressed batch from node %d: %v", nodeID, err)
+				return
+			}
+			for i := range batch {
+				if !deliverPeerMessage(nodeID, batch[i]) {
+					return
+				}
+			}
+			continue
+		} else {
+			if msgLen > peerMaxFrameSize {
+				logWarning("Oversized frame (%d bytes) from node %d", msgLen, nodeID)
+				return
+			}
+
+			bufp := peerFramePool.Get().(*[]byte)
+			if uint32(cap(*bufp)) < msgLen {
+				*bufp = make([]byte, msgLen)
+			}
+			data := (*bufp)[:msgLen]
+			_, err := io.ReadFull(r, data)
+			if err != nil {
+				logWarning("Failed to read message data from node %d: %v", nodeID, err)
+			} else if err = msg.Unmarshal(data); err != nil {
+				logWarning("Failed to unmarshal message from node %d: %v", nodeID, err)
+			}
+			if cap(*bufp) <= peerFramePoolMaxSize {
+				peerFramePool.Put(bufp)
+			}
+			if err != nil {
+				return
+			}
+		}
+
+		if !deliverPeerMessage(nodeID, msg) {
+			return
+		}
+	}
+}
+
+// deliverPeerMessage queues a received message for the Raft node; false once
+// the node is shutting down
+func deliverPeerMessage(nodeID uint64, msg raftpb.Message) bool {
+	logTrace("Received message from node %d: type=%s, term=%d", nodeID, msg.Type.String(), msg.Term)
+
+	select {
+	case messageChan <- msg:
+		return true
+	case <-raftCtx.Done():
+		return false
+	case <-stopChan:
+		return false
+	}
+}
+
+// readCompressedBatch reads a compressed frame of wireLen bytes and decodes
+// the length-prefixed messages it inflates to
+func readCompressedBatch(r *bufio.Reader, wireLen uint32) ([]raftpb.Message, error) {
+	if wireLen <= peerCompressHeader || wireLen > peerMaxFrameSize {
+		return nil, fmt.Errorf("bad compressed frame of %d bytes", wireLen)
+	}
+
+	wirep := peerFramePool.Get().(*[]byte)
+	rawp := peerFramePool.Get().(*[]byte)
+	defer func() {
+		for _, bufp := range []*[]byte{wirep, rawp} {
+			if cap(*bufp) <= peerFramePoolMaxSize {
+				peerFramePool.Put(bufp)
+			}
+		}
+	}()
+
+	if uint32(cap(*wirep)) < wireLen {
+		*wirep = make([]byte, wireLen)
+	}
+	wire := (*wirep)[:wireLen]
+	if _, err := io.ReadFull(r, wire); err != nil {
+		return nil, err
+	}
+	rawLen := binary.BigEndian.Uint32(wire[1:peerCompressHeader])
+	if rawLen > peerMaxFrameSize {
+		return nil, fmt.Errorf("compressed batch inflates to %d bytes", rawLen)
+	}
+	if uint32(cap(*rawp)) < rawLen {
+		*rawp = make([]byte, rawLen)
+	}
+	raw := (*rawp)[:rawLen]
+	if err := inflateInto(raw, wire[0], wire[peerCompressHeader:]); err != nil {
+		return nil, err
+	}
+
+	var batch []raftpb.Message
+	for len(raw) > 0 {
+		if len(raw) < 4 {
+			return nil, errors.New("truncated frame in compressed batch")
+		}
+		n := binary.BigEndian.Uint32(raw[0:4])
+		if uint64(n) > uint64(len(raw)-4) {
+			return nil, fmt.Errorf("frame of %d bytes overruns compressed batch", n)
+		}
+		var msg raftpb.Message
+		if err := msg.Unmarshal(raw[4 : 4+n]); err != nil {
+			return nil, err
+		}
+		batch = append(batch, msg)
+		raw = raw[4+n:]
+	}
+	return batch, nil
+}
+
+// readSnapshotStream reassembles a MsgSnap sent by peerSender.sendSnapshot.
+// Chunks are read under a deadline so a stalled transfer gives up; the
+// connection goes back to blocking reads afterwards.
+func readSnapshotStream(conn net.Conn, r *bufio.Reader, headerLen uint32) (raftpb.Message, error) {
+	var msg raftpb.Message
+
+	defer conn.SetReadDeadline(time.Time{})
+
+	if headerLen > peerMaxFrameSize {
+		return msg, fmt.Errorf("oversized snapshot header (%d bytes)", headerLen)
+	}
+	var sizeBuf [8]byte
+	if _, err := io.ReadFull(r, sizeBuf[:]); err != nil {
+		return msg, err
+	}
+	total := binary.BigEndian.Uint64(sizeBuf[:])
+	if total > peerMaxSnapshotSize {
+		return msg, fmt.Errorf("snapshot of %d bytes exceeds limit", total)
+	}
+
+	header := make([]byte, headerLen)
+	if _, err := io.ReadFull(r, header); err != nil {
+		return msg, err
+	}
+	if err := msg.Unmarshal(header); err != nil {
+		return msg, err
+	}
+	if msg.Type != raftpb.MsgSnap || msg.Snapshot == nil {
+		return msg, fmt.Errorf("snapshot stream carries a %s message", msg.Type.String())
+	}
+
+	data := make([]byte, total)
+	var lenBuf [4]byte
+	var wire []byte
+	for off := uint64(0); off < total; {
+		conn.SetReadDeadline(time.Now().Add(peerSnapshotTimeout))
+
+		if _, err := io.ReadFull(r, lenBuf[:]); err != nil {
+			return msg, err
+		}
+		chunkLen := binary.BigEndian.Uint32(lenBuf[:])
+		if chunkLen&peerChunkCompressed != 0 {
+			wireLen := chunkLen &^ peerChunkCompressed
+			if wireLen <= peerCompressHeader || wireLen > peerMaxFrameSize {
+				return msg, fmt.Errorf("bad compressed snapshot chunk of %d bytes at offset %d/%d", wireLen, off, total)
+			}
+			if uint32(cap(wire)) < wireLen {
+				wire = make([]byte, wireLen)
+			}
+			wire = wire[:wireLen]
+			if _, err := io.ReadFull(r, wire); err != nil {
+				return msg, err
+			}
+			rawLen := uint64(binary.BigEndian.Uint32(wire[1:peerCompressHeader]))
+			if rawLen == 0 || rawLen > total-off {
+				return msg, fmt.Errorf("compressed snapshot chunk of %d bytes at offset %d/%d", rawLen, off, total)
+			}
+			if err := inflateInto(data[off:off+rawLen], wire[0], wire[peerCompressHeader:]); err != nil {
+				return msg, err
+			}
+			off += rawLen
+			continue
+		}
+		if chunkLen == 0 || uint64(chunkLen) > total-off {
+			return msg, fmt.Errorf("bad snapshot chunk of %d bytes at offset %d/%d", chunkLen, off, total)
+		}
+		if _, err := io.ReadFull(r, data[off:off+uint64(chunkLen)]); err != nil {
+			return msg, err
+		}
+		off += uint64(chunkLen)
+	}
+	msg.Snapshot.Data = data
+
+	logInfo("Received snapshot %d (%d bytes) from node %d",
+		msg.Snapshot.Metadata.Index, total, msg.From)
+	return msg, nil
+}
+
+// ensurePeerDialer starts keeping a connection to addr unless one is kept
+// already; nodeID may be 0 when only the address is known
+func ensurePeerDialer(nodeID uint64, addr string) {
+	if addr == "" || addr == selfAddress || (nodeID != 0 && nodeID == selfNodeID) || raftCtx == nil {
+		return
+	}
+
+	peerDialersMutex.Lock()
+	defer peerDialersMutex.Unlock()
+
+	if d, ok := peerDialers[addr]; ok {
+		if d.nodeID == 0 {
+			d.nodeID = nodeID
+		}
+		return
+	}
+	d := &peerDialer{addr: addr, nodeID: nodeID, stop: make(chan struct{})}
+	peerDialers[addr] = d
+	go d.run()
+}
+
+// stopPeerDialer stops redialing addr and closes its connection
+func stopPeerDialer(addr string) {
+	peerDialersMutex.Lock()
+	d, ok := peerDialers[addr]
+	if ok {
+		delete(peerDialers, addr)
+	}
+	peerDialersMutex.Unlock()
+
+	if ok {
+		d.close()
+	}
+}
+
+// stopAllPeerDialers is used on shutdown
+func stopAllPeerDialers() {
+	peerDialersMutex.Lock()
+	dialers := peerDialers
+	peerDialers = make(map[string]*peerDialer)
+	peerDialersMutex.Unlock()
+
+	for _, d := range dialers {
+		d.close()
+	}
+}
+
+func (d *peerDialer) close() {
+	d.once.Do(func() {
+		close(d.stop)
+		d.mu.Lock()
+		if d.conn != nil {
+			d.conn.Close()
+		}
+		d.mu.Unlock()
+	})
+}
+
+func (d *peerDialer) stopped() bool {
+	select {
+	case <-d.stop:
+		return true
+	default:
+		return false
+	}
+}
+
+// jitter spreads a delay over [d/2, 3d/2) so that restarted nodes do not
+// redial in lockstep
+func jitter(d time.Duration) time.Duration {
+	return d/2 + time.Duration(rand.Int63n(int64(d)))
+}
+
+func (d *peerDialer) run() {
+	backoff := peerDialMinBackoff
+
+	for !d.stopped() {
+		peerDialersMutex.Lock()
+		expected := d.nodeID
+		peerDialersMutex.Unlock()
+
+		nodeID, conn, err := connectToPeer(expected, d.addr)
+		switch {
+		case err == errSelfPeer:
+			logDebug("Not dialing %s, it is this node", d.addr)
+			stopPeerDialer(d.addr)
+			return
+		case err != nil:
+			logWarning("Failed to connect to peer %s: %v (retrying in ~%v)", d.addr, err, backoff)
+		default:
+			peerDialersMutex.Lock()
+			d.nodeID = nodeID
+			peerDialersMutex.Unlock()
+
+			d.mu.Lock()
+			d.conn = conn
+			d.mu.Unlock()
+			if d.stopped() {
+				conn.Close()
+				return
+			}
+
+			// Read until the connection breaks, then reconnect promptly
+			handleConnectionMessages(nodeID, conn)
+			dropConnection(nodeID, conn)
+			reportUnreachable(nodeID)
+
+			d.mu.Lock()
+			d.conn = nil
+			d.mu.Unlock()
+			backoff = peerReconnectDelay
+		}
+
+		select {
+		case <-d.stop:
+			return
+		case <-raftCtx.Done():
+			return
+		case <-time.After(jitter(backoff)):
+		}
+		if err != nil {
+			backoff *= 2
+			if backoff > peerDialMaxBackoff {
+				backoff = peerDialMaxBackoff
+			}
+		} else {
+			backoff = peerDialMinBackoff
+		}
+	}
+}
+
+// connectKnownPeers dials every member recorded in the node map
+func connectKnownPeers() {
+	nodesMutex.RLock()
+	known := make(map[uint64]string, len(nodes))
+	for id, addr := range nodes {
+		known[id] = addr
+	}
+	nodesMutex.RUnlock()
+
+	for id, addr := range known {
+		ensurePeerDialer(id, addr)
+	}
+}
+
+// Load and connect to configured peers.  raft_peer_addresses lists
+// host:port or id@host:port entries; plain addresses are named by their
+// handshake.  Members from the log need no file at all: committed
+// ConfChanges and snapshots start dialers through applyConfChange and
+// restoreSnapshot.
+func loadAndConnectToPeers() {
+	connectKnownPeers()
+
+	config, err := loadConfiguration()
+	if err != nil {
+		logWarning("Failed to load configuration: %v", err)
+		return
+	}
+
+	peerAddresses := parsePeerAddresses(config.PeerAddresses)
+	logInfo("Found %d configured peer addresses", len(peerAddresses))
+
+	for _, entry := range peerAddresses {
+		var nodeID uint64
+		addr := entry
+		if at := strings.IndexByte(entry, '@'); at > 0 {
+			id, err := strconv.ParseUint(entry[:at], 10, 64)
+			if err != nil {
+				logWarning("Ignoring peer entry %q: bad node id", entry)
+				continue
+			}
+			nodeID, addr = id, entry[at+1:]
+		}
+		ensurePeerDialer(nodeID, addr)
+	}
+}
+
+// Connect to a peer and exchange hellos; expectedID 0 accepts any node
+func connectToPeer(expectedID uint64, peerAddr string) (uint64, net.Conn, error) {
+	dialStart := time.Now()
+	conn, err := net.DialTimeout("tcp", peerAddr, peerDialTimeout)
+	if err != nil {
+		return 0, nil, fmt.Errorf("failed to dial %s: %v", peerAddr, err)
+	}
+	// The TCP handshake is one round trip
+	rtt := time.Since(dialStart)
+
+	conn.SetDeadline(time.Now().Add(peerHelloTimeout))
+	host, _, splitErr := net.SplitHostPort(peerAddr)
+	if splitErr != nil {
+		host = peerAddr
+	}
+	conn, err = peerTLSHandshake(conn, host)
+	offer := byte(atomic.LoadInt32(&peerCompressOffer))
+	if err == nil {
+		err = writeHello(conn)
+	}
+	var nodeID uint64
+	var codecs byte
+	if err == nil {
+		nodeID, _, codecs, err = readHello(conn)
+	}
+	conn.SetDeadline(time.Time{})
+	if err != nil {
+		conn.Close()
+		return 0, nil, fmt.Errorf("handshake with %s failed: %v", peerAddr, err)
+	}
+	if nodeID == selfNodeID {
+		conn.Close()
+		return 0, nil, errSelfPeer
+	}
+	if expectedID != 0 && nodeID != expectedID {
+		conn.Close()
+		return 0, nil, fmt.Errorf("%s is node %d, expected node %d", peerAddr, nodeID, expectedID)
+	}
+
+	pc := &peerConn{Conn: conn, codec: pickCodec(offer, codecs)}
+	conn = pc
+
+	observeRTTSample(nodeID, rtt)
+	registerConnection(nodeID, conn)
+	logInfo("Connected to peer %s (node %d, compression %s)", peerAddr, nodeID, codecName(pc.codec))
+	return nodeID, conn, nil
+}
+
+// Configuration structure
+type PGRaftConfig struct {
+	PeerAddresses string
+	LogLevel      string
+	Port          int
+}
+
+// Load configuration from file
+func loadConfiguration() (*PGRaftConfig, error) {
+	config := &PGRaftConfig{
+		PeerAddresses: "",
+		LogLevel:      "info",
+		Port:          7400,
+	}
+
+	// Try to read from common configuration locations
+	configPaths := []string{
+		"/Users/ibrarahmed/pgelephant/pge/ram/conf/pgraft.conf",
+		"/etc/pgraft/pgraft.conf",
+		"./pgraft.conf",
+	}
+
+	for _, path := range configPaths {
+		if data, err := os.ReadFile(path); err == nil {
+			logInfo("Loading configuration from %s", path)
+			return parseConfigurationFile(string(data)), nil
+		}
+	}
+
+	logWarning("No configuration file found, using defaults")
+	return config, nil
+}
+
+// Parse configuration file content
+func parseConfigurationFile(content string) *PGRaftConfig {
+	config := &PGRaftConfig{
+		PeerAddresses: "",
+		LogLevel:      "info",
+		Port:          7400,
+	}
+
+	lines := strings.Split(content, "\n")
+	for _, line := range lines {
+		line = strings.TrimSpace(line)
+		if line == "" || strings.HasPrefix(line, "#") {
+			continue
+		}
+
+		parts := strings.SplitN(line, "=", 2)
+		if len(parts) != 2 {
+			continue
+		}
+
+		key := strings.TrimSpace(parts[0])
+		value := strings.TrimSpace(parts[1])
+
+		switch key {
+		case "raft_peer_addresses":
+			config.PeerAddresses = value
+		case "raft_log_level":
+			config.LogLevel = value
+		case "raft_port":
+			if port, err := strconv.Atoi(value); err == nil {
+				config.Port = port
+			}
+		}
+	}
+
+	return config
+}
+
+// Parse peer addresses from configuration string
+func parsePeerAddresses(peerAddressesStr string) []string {
+	if peerAddressesStr == "" {
+		return []string{}
+	}
+
+	addresses := strings.Split(peerAddressesStr, ",")
+	var result []string
+
+	for _, addr := range addresses {
+		addr = strings.TrimSpace(addr)
+		if addr != "" {
+			result = append(result, addr)
+		}
+	}
+
+	return result
+}
+
+// ============================================================================
+// DURABLE STORAGE - Segmented write-ahead log for the Raft node
+// ============================================================================
+
+// The Raft log and HardState are persisted under the pgraft data directory
+// as a sequence of append-only segment files (wal-<seq>.log).  Each record is
+// framed as length(4) | crc32c(4) | type(1) | payload.  Everything produced by
+// one Ready is encoded into a single buffer and written with one write and at
+// most one fsync, so durability costs one fsync per Ready rather than one per
+// entry.  The hardstate file is a checkpoint rewritten on segment rotation and
+// shutdown; HardState records in the segments that follow it take precedence
+// during replay.
+
+const (
+	walRecordEntry     byte = 1
+	walRecordHardState byte = 2
+	walRecordSnapshot  byte = 3
+
+	walSegmentPrefix   = "wal-"
+	walSegmentSuffix   = ".log"
+	walSegmentMaxBytes = 64 * 1024 * 1024
+	walRecordHeader    = 9
+	walHardStateFile   = "hardstate"
+)
+
+var walCRCTable = crc32.MakeTable(crc32.Castagnoli)
+
+// raftWAL is the on-disk log backing raftStorage
+type raftWAL struct {
+	mu       sync.Mutex
+	dir      string
+	segment  *os.File
+	segSeq   uint64
+	segBytes int64
+	buf      []byte
+	lastHS   raftpb.HardState
+}
+
+var (
+	raftDataDir string
+	raftWal     *raftWAL
+)
+
+// Set the directory used for durable Raft storage; must be called before init
+//
+//export pgraft_go_set_data_dir
+func pgraft_go_set_data_dir(dir *C.char) C.int {
+	raftMutex.Lock()
+	defer raftMutex.Unlock()
+
+	if atomic.LoadInt32(&initialized) == 1 {
+		logWarning("Data directory cannot change after initialization")
+		return -1
+	}
+
+	raftDataDir = C.GoString(dir)
+	return 0
+}
+
+func walSegmentName(seq uint64) string {
+	return fmt.Sprintf("%s%016x%s", walSegmentPrefix, seq, walSegmentSuffix)
+}
+
+// openRaftWAL replays any existing segments into storage and opens the last
+// segment for appending.  It reports whether prior Raft state was found.
+func openRaftWAL(dir string, storage *raft.MemoryStorage) (*raftWAL, bool, error) {
+	if err := os.MkdirAll(dir, 0700); err != nil {
+		return nil, false, fmt.Errorf("failed to create %s: %v", dir, err)
+	}
+
+	w := &raftWAL{dir: dir}
+
+	hs, err := readHardStateFile(filepath.Join(dir, walHardStateFile))
+	if err != nil {
+		return nil, false, err
+	}
+
+	segments, err := filepath.Glob(filepath.Join(dir, walSegmentPrefix+"*"+walSegmentSuffix))
+	if err != nil {
+		return nil, false, err
+	}
+	sort.Strings(segments)
+
+	for i, path := range segments {
+		valid, err := w.replaySegment(path, storage, &hs)
+		if err != nil {
+			return nil, false, err
+		}
+
+		info, err := os.Stat(path)
+		if err != nil {
+			return nil, false, err
+		}
+		if valid < info.Size() {
+			// A torn tail is expected after a crash; anything after it is unusable
+			logWarning("Truncating WAL segment %s at offset %d", path, valid)
+			if err := os.Truncate(path, valid); err != nil {
+				return nil, false, err
+			}
+			for _, later := range segments[i+1:] {
+				os.Remove(later)
+			}
+			segments = segments[:i+1]
+			break
+		}
+	}
+
+	if !raft.IsEmptyHardState(hs) {
+		if err := storage.SetHardState(hs); err != nil {
+			return nil, false, err
+		}
+	}
+	w.lastHS = hs
+
+	lastIdx, _ := storage.LastIndex()
+	snap, _ := storage.Snapshot()
+	hasState := !raft.IsEmptyHardState(hs) || lastIdx > 0 || !raft.IsEmptySnap(snap)
+
+	if len(segments) == 0 {
+		err = w.openSegment(1)
+	} else {
+		last := segments[len(segments)-1]
+		seq, perr := strconv.ParseUint(strings.TrimSuffix(strings.TrimPrefix(filepath.Base(last), walSegmentPrefix), walSegmentSuffix), 16, 64)
+		if perr != nil {
+			return nil, false, fmt.Errorf("invalid WAL segment name %s", last)
+		}
+		err = w.openSegment(seq)
+	}
+	if err != nil {
+		return nil, false, err
+	}
+
+	logInfo("Raft WAL opened in %s (last index %d, term %d, %d segments)",
+		dir, lastIdx, hs.Term, len(segments))
+	return w, hasState, nil
+}
+
+// replaySegment applies every intact record of one segment and returns the
+// offset just past the last good record.
+func (w *raftWAL) replaySegment(path string, storage *raft.MemoryStorage, hs *raftpb.HardState) (int64, error) {
+	f, err := os.Open(path)
+	if err != nil {
+		return 0, err
+	}
+	defer f.Close()
+
+	reader := bufio.NewReaderSize(f, 1<<20)
+	header := make([]byte, walRecordHeader)
+	var payload []byte
+	var offset int64
+
+	for {
+		if _, err := io.ReadFull(reader, header); err != nil {
+			return offset, nil
+		}
+		length := binary.BigEndian.Uint32(header[0:4])
+		sum := binary.BigEndian.Uint32(header[4:8])
+		typ := header[8]
+
+		if cap(payload) < int(length) {
+			payload = make([]byte, length)
+		}
+		payload = payload[:length]
+		if _, err := io.ReadFull(reader, payload); err != nil {
+			return offset, nil
+		}
+		crc := crc32.Update(crc32.Checksum([]byte{typ}, walCRCTable), walCRCTable, payload)
+		if crc != sum {
+			return offset, nil
+		}
+
+		switch typ {
+		case walRecordEntry:
+			var entry raftpb.Entry
+			if err := entry.Unmarshal(payload); err != nil {
+				return offset, nil
+			}
+			first, _ := storage.FirstIndex()
+			last, _ := storage.LastIndex()
+			if entry.Index >= first && entry.Index > last+1 {
+				return 0, fmt.Errorf("gap in WAL %s: entry %d after %d", path, entry.Index, last)
+			}
+			if err := storage.Append([]raftpb.Entry{entry}); err != nil {
+				return 0, err
+			}
+		case walRecordHardState:
+			if err := hs.Unmarshal(payload); err != nil {
+				return offset, nil
+			}
+		case walRecordSnapshot:
+			var snap raftpb.Snapshot
+			if err := snap.Unmarshal(payload); err != nil {
+				return offset, nil
+			}
+			if err := storage.ApplySnapshot(snap); err != nil && err != raft.ErrSnapOutOfDate {
+				return 0, err
+			}
+		default:
+			return offset, nil
+		}
+
+		offset += int64(walRecordHeader) + int64(length)
+	}
+}
+
+func (w *raftWAL) openSegment(seq uint64) error {
+	path := filepath.Join(w.dir, walSegmentName(seq))
+	f, err := os.OpenFile(path, os.O_CREATE|os.O_WRONLY|os.O_APPEND, 0600)
+	if err != nil {
+		return err
+	}
+	info, err := f.Stat()
+	if err != nil {
+		f.Close()
+		return err
+	}
+	w.segment = f
+	w.segSeq = seq
+	w.segBytes = info.Size()
+	return syncDir(w.dir)
+}
+
+func appendWALRecord(buf []byte, typ byte, payload []byte) []byte {
+	var header [walRecordHeader]byte
+	binary.BigEndian.PutUint32(header[0:4], uint32(len(payload)))
+	crc := crc32.Update(crc32.Checksum([]byte{typ}, walCRCTable), walCRCTable, payload)
+	binary.BigEndian.PutUint32(header[4:8], crc)
+	header[8] = typ
+	buf = append(buf, header[:]...)
+	return append(buf, payload...)
+}
+
+// save persists one Ready batch with a single write and, when the batch
+// requires it, a single fsync
+func (w *raftWAL) save(hs raftpb.HardState, entries []raftpb.Entry, snap raftpb.Snapshot, mustSync bool) error {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	buf := w.buf[:0]
+
+	if !raft.IsEmptySnap(snap) {
+		data, err := snap.Marshal()
+		if err != nil {
+			return err
+		}
+		buf = appendWALRecord(buf, walRecordSnapshot, data)
+	}
+
+	for i := range entries {
+		data, err := entries[i].Marshal()
+		if err != nil {
+			return err
+		}
+		buf = appendWALRecord(buf, walRecordEntry, data)
+	}
+
+	if !raft.IsEmptyHardState(hs) && !hardStateEqual(hs, w.lastHS) {
+		data, err := hs.Marshal()
+		if err != nil {
+			return err
+		}
+		buf = appendWALRecord(buf, walRecordHardState, data)
+		w.lastHS = hs
+	}
+
+	w.buf = buf
+	if len(buf) == 0 {
+		return nil
+	}
+
+	start := time.Now()
+	n, err := w.segment.Write(buf)
+	walAppendLatency.observe(time.Since(start))
+	w.segBytes += int64(n)
+	if err != nil {
+		return err
+	}
+	if mustSync || !raft.IsEmptySnap(snap) {
+		start = time.Now()
+		err := w.segment.Sync()
+		walFsyncLatency.observe(time.Since(start))
+		if err != nil {
+			return err
+		}
+	}
+
+	if w.segBytes >= walSegmentMaxBytes {
+		return w.rotate()
+	}
+	return nil
+}
+
+// rotate checkpoints the HardState and starts a new segment
+func (w *raftWAL) rotate() error {
+	if err := w.segment.Sync(); err != nil {
+		return err
+	}
+	if err := w.segment.Close(); err != nil {
+		return err
+	}
+	if err := writeHardStateFile(filepath.Join(w.dir, walHardStateFile), w.lastHS); err != nil {
+		return err
+	}
+	return w.openSegment(w.segSeq + 1)
+}
+
+func (w *raftWAL) close() error {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	if w.segment == nil {
+		return nil
+	}
+	if err := w.segment.Sync(); err != nil {
+		return err
+	}
+	if err := w.segment.Close(); err != nil {
+		return err
+	}
+	w.segment = nil
+	return writeHardStateFile(filepath.Join(w.dir, walHardStateFile), w.lastHS)
+}
+
+// persistReady writes a Ready batch to the WAL before it is exposed through
+// raftStorage.  On failure the node is stopped: acknowledging entries that
+// are not durable would break Raft's safety guarantees.
+func persistReady(rd raft.Ready) bool {
+	if raftWal == nil {
+		return true
+	}
+	if err := raftWal.save(rd.HardState, rd.Entries, rd.Snapshot, rd.MustSync); err != nil {
+		recordError(fmt.Errorf("failed to persist raft state, stopping node: %v", err))
+		if raftCancel != nil {
+			raftCancel()
+		}
+		return false
+	}
+	return true
+}
+
+func hardStateEqual(a, b raftpb.HardState) bool {
+	return a.Term == b.Term && a.Vote == b.Vote && a.Commit == b.Commit
+}
+
+func readHardStateFile(path string) (raftpb.HardState, error) {
+	var hs raftpb.HardState
+
+	data, err := os.ReadFile(path)
+	if os.IsNotExist(err) {
+		return hs, nil
+	}
+	if err != nil {
+		return hs, err
+	}
+	if len(data) < 4 {
+		return hs, fmt.Errorf("hardstate file %s is truncated", path)
+	}
+	if crc32.Checksum(data[4:], walCRCTable) != binary.BigEndian.Uint32(data[0:4]) {
+		return hs, fmt.Errorf("hardstate file %s failed checksum", path)
+	}
+	if err := hs.Unmarshal(data[4:]); err != nil {
+		return hs, err
+	}
+	return hs, nil
+}
+
+func writeHardStateFile(path string, hs raftpb.HardState) error {
+	payload, err := hs.Marshal()
+	if err != nil {
+		return err
+	}
+	data := make([]byte, 4+len(payload))
+	binary.BigEndian.PutUint32(data[0:4], crc32.Checksum(payload, walCRCTable))
+	copy(data[4:], payload)
+
+	tmp := path + ".tmp"
+	f, err := os.OpenFile(tmp, os.O_CREATE|os.O_WRONLY|os.O_TRUNC, 0600)
+	if err != nil {
+		return err
+	}
+	if _, err := f.Write(data); err != nil {
+		f.Close()
+		return err
+	}
+	if err := f.Sync(); err != nil {
+		f.Close()
+		return err
+	}
+	if err := f.Close(); err != nil {
+		return err
+	}
+	if err := os.Rename(tmp, path); err != nil {
+		return err
+	}
+	return syncDir(filepath.Dir(path))
+}
+
+func syncDir(dir string) error {
+	d, err := os.Open(dir)
+	if err != nil {
+		return err
+	}
+	defer d.Close()
+	return d.Sync()
+}
+
+// saveSnapshot makes snap the base of the on-disk log.  The snapshot, the
+// entries still retained above it and the current HardState are written to a
+// fresh segment, after which every older segment is obsolete and removed.
+func (w *raftWAL) saveSnapshot(snap raftpb.Snapshot, tail []raftpb.Entry) error {
+	w.mu.Lock()
+	defer w.mu.Unlock()
+
+	if err := w.rotate(); err != nil {
+		return err
+	}
+
+	data, err := snap.Marshal()
+	if err != nil {
+		return err
+	}
+	buf := appendWALRecord(w.buf[:0], walRecordSnapshot, data)
+	for i := range tail {
+		if data, err = tail[i].Marshal(); err != nil {
+			return err
+		}
+		buf = appendWALRecord(buf, walRecordEntry, data)
+	}
+	if !raft.IsEmptyHardState(w.lastHS) {
+		if data, err = w.lastHS.Marshal(); err != nil {
+			return err
+		}
+		buf = appendWALRecord(buf, walRecordHardState, data)
+	}
+	w.buf = buf
+
+	n, err := w.segment.Write(buf)
+	w.segBytes += int64(n)
+	if err != nil {
+		return err
+	}
+	if err := w.segment.Sync(); err != nil {
+		return err
+	}
+
+	return w.releaseBefore(w.segSeq)
+}
+
+// releaseBefore removes all segments older than seq
+func (w *raftWAL) releaseBefore(seq uint64) error {
+	segments, err := filepath.Glob(filepath.Join(w.dir, walSegmentPrefix+"*"+walSegmentSuffix))
+	if err != nil {
+		return err
+	}
+	removed := 0
+	for _, path := range segments {
+		name := strings.TrimSuffix(strings.TrimPrefix(filepath.Base(path), walSegmentPrefix), walSegmentSuffix)
+		s, perr := strconv.ParseUint(name, 16, 64)
+		if perr != nil || s >= seq {
+			continue
+		}
+		if err := os.Remove(path); err != nil {
+			return err
+		}
+		removed++
+	}
+	if removed > 0 {
+		logDebug("Released %d WAL segments below %s", removed, walSegmentName(seq))
+		return syncDir(w.dir)
+	}
+	return nil
+}
+
+// ============================================================================
+// SNAPSHOTS AND COMPACTION
+// ============================================================================
+//
+// Once enough has been applied since the last snapshot, either by entry count
+// or by payload bytes, the Ready loop snapshots the applied state, rebases the
+// WAL on it and compacts raftStorage, keeping a tail of entries so briefly
+// lagging followers can still catch up from the log.  Followers further
+// behind receive the snapshot through the peer transport.
+
+const snapshotStateVersion = 1
+
+// snapshotState is the state machine image carried in Snapshot.Data
+type snapshotState struct {
+	Version      int               `json:"version"`
+	Nodes        map[uint64]string `json:"nodes"`
+	LeaderID     uint64            `json:"leader_id"`
+	Term         uint64            `json:"term"`
+	AppliedIndex uint64            `json:"applied_index"`
+	CreatedAt    int64             `json:"created_at"`
+	KV           *kvSnapshot       `json:"kv,omitempty"` // absent before the store existed
+}
+
+var (
+	// Policy; tunable from PostgreSQL through pgraft_go_set_snapshot_policy
+	snapshotEntries  uint64 = 10000
+	snapshotBytes    uint64 = 64 * 1024 * 1024
+	snapshotCatchUp  uint64 = 5000
+	snapshotPolicyMu sync.Mutex
+
+	// Progress since the last snapshot; owned by snapshotMutex
+	snapshotMutex      sync.Mutex
+	raftConfState      raftpb.ConfState
+	snapshotIndex      uint64
+	bytesSinceSnapshot uint64
+)
+
+// Configure automatic snapshots: entries and maxLogKB trigger a snapshot,
+// catchUp is the number of entries kept in the log behind it
+//
+//export pgraft_go_set_snapshot_policy
+func pgraft_go_set_snapshot_policy(entries C.int, maxLogKB C.int, catchUp C.int) {
+	snapshotPolicyMu.Lock()
+	defer snapshotPolicyMu.Unlock()
+
+	if entries > 0 {
+		snapshotEntries = uint64(entries)
+	}
+	if maxLogKB > 0 {
+		snapshotBytes = uint64(maxLogKB) * 1024
+	}
+	if catchUp >= 0 {
+		snapshotCatchUp = uint64(catchUp)
+	}
+}
+
+func encodeSnapshotState(applied uint64) ([]byte, error) {
+	state := snapshotState{
+		Version:      snapshotStateVersion,
+		Nodes:        make(map[uint64]string),
+		LeaderID:     clusterState.LeaderID,
+		Term:         clusterState.CurrentTerm,
+		AppliedIndex: applied,
+		CreatedAt:    time.Now().Unix(),
+		KV:           kvSnapshotState(),
+	}
+
+	nodesMutex.RLock()
+	for id, addr := range nodes {
+		state.Nodes[id] = addr
+	}
+	nodesMutex.RUnlock()
+
+	return json.Marshal(&state)
+}
+
+// restoreSnapshot installs the membership and metadata carried by a snapshot
+// that was replayed from disk or received from the leader
+func restoreSnapshot(snap raftpb.Snapshot) {
+	snapshotMutex.Lock()
+	raftConfState = snap.Metadata.ConfState
+	snapshotIndex = snap.Metadata.Index
+	bytesSinceSnapshot = 0
+	snapshotMutex.Unlock()
+
+	replicationState.replicationMutex.Lock()
+	replicationState.lastSnapshotIndex = snap.Metadata.Index
+	replicationState.lastAppliedIndex = snap.Metadata.Index
+	replicationState.replicationMutex.Unlock()
+
+	if len(snap.Data) == 0 {
+		return
+	}
+
+	var state snapshotState
+	if err := json.Unmarshal(snap.Data, &state); err != nil {
+		logWarning("Ignoring undecodable state in snapshot %d: %v", snap.Metadata.Index, err)
+		return
+	}
+	if state.Version != snapshotStateVersion {
+		logWarning("Ignoring snapshot %d with unknown state version %d", snap.Metadata.Index, state.Version)
+		return
+	}
+
+	nodesMutex.Lock()
+	if nodes == nil {
+		nodes = make(map[uint64]string)
+	}
+	for id, addr := range state.Nodes {
+		nodes[id] = addr
+	}
+	nodesMutex.Unlock()
+
+	kvRestore(state.KV)
+
+	atomic.StoreUint64(&appliedIndex, snap.Metadata.Index)
+	logInfo("Restored snapshot at index %d (term %d, %d nodes)",
+		snap.Metadata.Index, snap.Metadata.Term, len(state.Nodes))
+
+	// At init this runs before the context exists; init dials them itself
+	if raftCtx != nil {
+		connectKnownPeers()
+	}
+}
+
+// noteApplied records applied entries and snapshots once the policy says so
+func noteApplied(entries []raftpb.Entry) {
+	if len(entries) == 0 {
+		return
+	}
+
+	var size uint64
+	for i := range entries {
+		size += uint64(len(entries[i].Data))
+	}
+	applied := entries[len(entries)-1].Index
+	atomic.StoreUint64(&appliedIndex, applied)
+
+	snapshotPolicyMu.Lock()
+	maxEntries, maxBytes := snapshotEntries, snapshotBytes
+	snapshotPolicyMu.Unlock()
+
+	snapshotMutex.Lock()
+	bytesSinceSnapshot += size
+	due := applied-snapshotIndex >= maxEntries || bytesSinceSnapshot >= maxBytes
+	snapshotMutex.Unlock()
+
+	if due {
+		if _, err := takeSnapshot(applied); err != nil && err != raft.ErrSnapOutOfDate {
+			recordError(fmt.Errorf("automatic snapshot at index %d failed: %v", applied, err))
+		}
+	}
+}
+
+// takeSnapshot snapshots the state at applied, rebases the WAL on it and
+// compacts the in-memory log down to the catch-up tail
+func takeSnapshot(applied uint64) (raftpb.Snapshot, error) {
+	snapshotMutex.Lock()
+	defer snapshotMutex.Unlock()
+
+	if applied <= snapshotIndex {
+		return raftpb.Snapshot{}, raft.ErrSnapOutOfDate
+	}
+
+	data, err := encodeSnapshotState(applied)
+	if err != nil {
+		return raftpb.Snapshot{}, err
+	}
+
+	cs := raftConfState
+	snap, err := raftStorage.CreateSnapshot(applied, &cs, data)
+	if err != nil {
+		return raftpb.Snapshot{}, err
+	}
+
+	if raftWal != nil {
+		walAppendMu.Lock()
+		last, _ := raftStorage.LastIndex()
+		var tail []raftpb.Entry
+		if last > applied {
+			tail, err = raftStorage.Entries(applied+1, last+1, ^uint64(0))
+		}
+		if err == nil {
+			err = raftWal.saveSnapshot(snap, tail)
+		}
+		walAppendMu.Unlock()
+		if err != nil {
+			return raftpb.Snapshot{}, err
+		}
+	}
+
+	snapshotPolicyMu.Lock()
+	catchUp := snapshotCatchUp
+	snapshotPolicyMu.Unlock()
+
+	if applied > catchUp {
+		if err := raftStorage.Compact(applied - catchUp); err != nil && err != raft.ErrCompacted {
+			return raftpb.Snapshot{}, err
+		}
+	}
+
+	snapshotIndex = applied
+	bytesSinceSnapshot = 0
+
+	replicationState.replicationMutex.Lock()
+	replicationState.lastSnapshotIndex = applied
+	replicationState.replicationMutex.Unlock()
+
+	logInfo("Snapshot taken at index %d, log compacted to %d", applied, applied-minUint64(applied, catchUp))
+	return snap, nil
+}
+
+// applyConfChange applies a committed membership change and remembers the
+// resulting configuration for the next snapshot.  Entries of this type
+// come from logs written before pgraft_go_change_peers.
+func applyConfChange(cc raftpb.ConfChange) {
+	cs := raftNode.ApplyConfChange(cc)
+	if cs == nil {
+		return
+	}
+	snapshotMutex.Lock()
+	raftConfState = *cs
+	snapshotMutex.Unlock()
+
+	switch cc.Type {
+	case raftpb.ConfChangeAddNode, raftpb.ConfChangeAddLearnerNode:
+		if len(cc.Context) > 0 {
+			joinPeer(cc.NodeID, string(cc.Context))
+		}
+	case raftpb.ConfChangeRemoveNode:
+		dropPeer(cc.NodeID)
+	}
+}
+
+// applyConfChangeV2 applies a committed membership change and reports it
+// to the local waiter that proposed it.  A change that leaves Raft in a
+// joint configuration is reported when the leader's automatic empty
+// change takes it out again, so a waiter returns only once the new
+// membership alone decides commits.
+func applyConfChangeV2(cc raftpb.ConfChangeV2, index uint64) {
+	cs := raftNode.ApplyConfChange(cc)
+	if cs == nil {
+		return
+	}
+	snapshotMutex.Lock()
+	raftConfState = *cs
+	snapshotMutex.Unlock()
+
+	origin, proposalID, addrs, ok := decodeConfChangeContext(cc.Context)
+	for _, change := range cc.Changes {
+		switch change.Type {
+		case raftpb.ConfChangeAddNode, raftpb.ConfChangeAddLearnerNode:
+			if addr, known := addrs[change.NodeID]; known {
+				joinPeer(change.NodeID, addr)
+			}
+		case raftpb.ConfChangeRemoveNode:
+			dropPeer(change.NodeID)
+		}
+	}
+
+	var done []uint64
+	joint := len(cs.VotersOutgoing) > 0
+	if ok && origin == selfNodeID && proposalID != 0 {
+		if joint {
+			jointConfChanges = append(jointConfChanges, proposalID)
+		} else {
+			done = append(done, proposalID)
+		}
+	}
+	if !joint && len(jointConfChanges) > 0 {
+		done = append(done, jointConfChanges...)
+		jointConfChanges = nil
+	}
+	if len(done) == 0 {
+		return
+	}
+
+	block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+	if block == nil {
+		return
+	}
+	proposalReportMu.Lock()
+	for _, id := range done {
+		reportProposal(block, id, int64(index))
+	}
+	proposalReportMu.Unlock()
+	notifyProposalWaiters()
+}
+
+// joinPeer starts talking to a node the log added; membership is taken
+// from the log, never from the call that proposed it
+func joinPeer(nodeID uint64, addr string) {
+	if nodeID == selfNodeID {
+		return
+	}
+	nodesMutex.Lock()
+	if nodes == nil {
+		nodes = make(map[uint64]string)
+	}
+	nodes[nodeID] = addr
+	nodesMutex.Unlock()
+	ensurePeerDialer(nodeID, addr)
+}
+
+// dropPeer stops talking to a node the log removed
+func dropPeer(nodeID uint64) {
+	if nodeID == selfNodeID {
+		return
+	}
+	nodesMutex.Lock()
+	addr := nodes[nodeID]
+	delete(nodes, nodeID)
+	nodesMutex.Unlock()
+	stopPeerDialer(addr)
+	stopPeerSender(nodeID)
+	connMutex.Lock()
+	if conn, ok := connections[nodeID]; ok {
+		conn.Close()
+		delete(connections, nodeID)
+	}
+	connMutex.Unlock()
+}
+
+func minUint64(a, b uint64) uint64 {
+	if a < b {
+		return a
+	}
+	return b
+}
+
+// ============================================================================
+// KEY-VALUE STORE - Replicated cluster metadata with revisions and leases
+// ============================================================================
+//
+// Every node applies the same writes in log order, so the store reads the
+// same on all of them.  Each change to a key bumps the store revision, and
+// an entry keeps the revision it was created and last modified at, which
+// is what compare-and-swap compares.  A lease owns the keys put under it;
+// the leader revokes a lease that has gone a TTL without a keepalive, and
+// its keys go with it.  Recent changes stay in a bounded history, so a
+// watcher resumes from the revision it last saw instead of polling; one
+// that falls further behind than the history reaches is told so and reads
+// the keys again.  The store travels in snapshots.
+//
+// A write is one proposal item: kvMagic(4) | op(1) | pad(1) | key length(2)
+// | value length(4) | compare(8) | lease(8) | key | value.  Origin and
+// proposal id come from the batch it rides in.
+const (
+	kvMagic        uint32 = 0x50474b56 // "PGKV"
+	kvOpHeaderSize        = 24         // PGRAFT_GO_KV_OP_HEADER, without the magic
+	kvRecordHeader        = 41         // PGRAFT_GO_KV_RECORD_HEADER
+	kvFileHeader          = 16         // PGRAFT_GO_KV_FILE_HEADER
+
+	// Keep in sync with include/pgraft_go.h
+	kvOpPut          = 1
+	kvOpDelete       = 2
+	kvOpDeletePrefix = 3
+	kvOpLeaseGrant   = 4
+	kvOpLeaseKeep    = 5
+	kvOpLeaseRevoke  = 6
+
+	kvReadGet    = 1
+	kvReadPrefix = 2
+	kvReadWatch  = 3
+
+	kvEventValue  = 0
+	kvEventPut    = 1
+	kvEventDelete = 2
+
+	kvNoCompare        = -1
+	kvResultFailed     = -2
+	kvResultCompacted  = -3
+	kvHistoryMax       = 10000
+	kvLeaseMinTTL      = time.Second
+	kvLeaseCheckPeriod = 250 * time.Millisecond
+	kvRevokeRetry      = time.Second
+)
+
+type kvEntry struct {
+	Value     []byte `json:"value"`
+	CreateRev int64  `json:"create_revision"`
+	ModRev    int64  `json:"mod_revision"`
+	Version   int64  `json:"version"`
+	Lease     int64  `json:"lease,omitempty"`
+}
+
+type kvLease struct {
+	ttl  time.Duration
+	keys map[string]struct{}
+
+	// Local, and only acted on by the leader
+	deadline time.Time
+	revoking time.Time
+}
+
+// kvEvent is one change in the history; entry is the key's state after a
+// put and before a delete
+type kvEvent struct {
+	rev     int64
+	deleted bool
+	key     string
+	entry   kvEntry
+}
 
-		// Add timeout to ensure function completes
-		done := make(chan bool, 1)
-		go func() {
-			// Load configuration from file
-			config, err := loadConfiguration()
-			if err != nil {
-				log.Printf("pgraft: WARNING - Failed to load configuration: %v", err)
-				done <- true
-				return
-			}
+// kvSnapshot is the store as carried in snapshotState
+type kvSnapshot struct {
+	Revision  int64               `json:"revision"`
+	NextLease int64               `json:"next_lease"`
+	Entries   map[string]*kvEntry `json:"entries"`
+	Leases    map[int64]int64     `json:"leases"` // id -> TTL in ms
+}
 
-			// Parse peer addresses
-			peerAddresses := parsePeerAddresses(config.PeerAddresses)
-			log.Printf("pgraft: INFO - Found %d configured peer addresses", len(peerAddresses))
+var (
+	kvMu        sync.Mutex
+	kvRevision  int64
+	kvNextLease int64
+	kvEntries   map[string]*kvEntry
+	kvLeases    map[int64]*kvLease
+	kvHistory   []kvEvent // ascending revisions
+	kvCompacted int64     // changes up to this revision are gone from kvHistory
+	kvChanged   chan struct{}
+
+	// Outcomes of this node's writes, by proposal id, until reported
+	kvResults = make(map[uint64]int64)
+)
 
-			// Connect to each peer
-			for i, peerAddr := range peerAddresses {
-				nodeID := uint64(i + 1) // Node IDs: 1, 2, 3
+// kvReset empties the store, before the WAL or a snapshot rebuilds it
+func kvReset() {
+	kvMu.Lock()
+	kvRevision = 0
+	kvNextLease = 1
+	kvEntries = make(map[string]*kvEntry)
+	kvLeases = make(map[int64]*kvLease)
+	kvHistory = nil
+	kvCompacted = 0
+	kvResults = make(map[uint64]int64)
+	kvNotifyLocked()
+	kvMu.Unlock()
+}
 
-				// Skip self-connection (current node is 1)
-				if nodeID == 1 {
-					log.Printf("pgraft: INFO - Skipping self-connection to node %d (%s)", nodeID, peerAddr)
-					continue
-				}
+// kvNotifyLocked wakes every watcher waiting for a change
+func kvNotifyLocked() {
+	if kvChanged != nil {
+		close(kvChanged)
+	}
+	kvChanged = make(chan struct{})
+}
 
-				// Check if connection already exists
-				connMutex.Lock()
-				_, exists := connections[nodeID]
-				connMutex.Unlock()
+func kvSnapshotState() *kvSnapshot {
+	kvMu.Lock()
+	defer kvMu.Unlock()
 
-				if exists {
-					log.Printf("pgraft: INFO - Connection to node %d already exists, skipping", nodeID)
-					continue
-				}
+	snap := &kvSnapshot{
+		Revision:  kvRevision,
+		NextLease: kvNextLease,
+		Entries:   make(map[string]*kvEntry, len(kvEntries)),
+		Leases:    make(map[int64]int64, len(kvLeases)),
+	}
+	for key, e := range kvEntries {
+		snap.Entries[key] = e
+	}
+	for id, l := range kvLeases {
+		snap.Leases[id] = l.ttl.Milliseconds()
+	}
+	return snap
+}
 
-				// Start connection in a separate goroutine to avoid blocking
-				go establishConnectionWithRetry(nodeID, peerAddr)
+// kvRestore replaces the store with a snapshot's.  The history restarts
+// there, so watchers from before it are told to read the keys again.
+func kvRestore(snap *kvSnapshot) {
+	kvMu.Lock()
+	defer kvMu.Unlock()
+
+	kvRevision = 0
+	kvNextLease = 1
+	kvEntries = make(map[string]*kvEntry)
+	kvLeases = make(map[int64]*kvLease)
+	if snap != nil {
+		kvRevision = snap.Revision
+		if snap.NextLease > 0 {
+			kvNextLease = snap.NextLease
+		}
+		now := time.Now()
+		for id, ttlMs := range snap.Leases {
+			ttl := time.Duration(ttlMs) * time.Millisecond
+			kvLeases[id] = &kvLease{ttl: ttl, keys: make(map[string]struct{}), deadline: now.Add(ttl)}
+		}
+		for key, e := range snap.Entries {
+			kvEntries[key] = e
+			if l := kvLeases[e.Lease]; l != nil {
+				l.keys[key] = struct{}{}
 			}
-			log.Printf("pgraft: INFO - Peer discovery process completed")
-			done <- true
-		}()
-
-		// Wait for completion or timeout
-		select {
-		case <-done:
-			log.Printf("pgraft: INFO - Peer discovery completed successfully")
-		case <-time.After(5 * time.Second):
-			log.Printf("pgraft: WARNING - Peer discovery timed out after 5 seconds")
 		}
-	}()
+	}
+	kvHistory = nil
+	kvCompacted = kvRevision
+	kvNotifyLocked()
+}
 
-	log.Printf("pgraft: INFO - Peer discovery goroutine started")
+// kvRecordLocked appends a change to the history, dropping the oldest
+// quarter once it is full
+func kvRecordLocked(ev kvEvent) {
+	kvHistory = append(kvHistory, ev)
+	if len(kvHistory) > kvHistoryMax {
+		drop := kvHistoryMax / 4
+		kvCompacted = kvHistory[drop-1].rev
+		kvHistory = append([]kvEvent(nil), kvHistory[drop:]...)
+	}
 }
 
-// Establish connection with retry logic
-func establishConnectionWithRetry(nodeID uint64, peerAddr string) {
-	// Check if connection already exists before attempting
-	connMutex.Lock()
-	_, exists := connections[nodeID]
-	connMutex.Unlock()
+func kvDetachLocked(key string, e *kvEntry) {
+	if l := kvLeases[e.Lease]; l != nil {
+		delete(l.keys, key)
+	}
+}
 
-	if exists {
-		log.Printf("pgraft: INFO - Connection to node %d already exists, skipping retry", nodeID)
-		return
+// kvDeleteLocked removes key at revision rev
+func kvDeleteLocked(key string, rev int64) {
+	e := kvEntries[key]
+	kvDetachLocked(key, e)
+	delete(kvEntries, key)
+	kvRecordLocked(kvEvent{rev: rev, deleted: true, key: key, entry: *e})
+}
+
+// kvCompareLocked checks a write's compare: kvNoCompare always passes, 0
+// wants the key absent, anything else its modification revision
+func kvCompareLocked(key string, compare int64) bool {
+	e := kvEntries[key]
+	switch {
+	case compare == kvNoCompare:
+		return true
+	case compare == 0:
+		return e == nil
+	default:
+		return e != nil && e.ModRev == compare
 	}
+}
 
-	// Start retry logic in a separate goroutine to avoid blocking
-	go func() {
-		maxRetries := 5
-		retryDelay := 2 * time.Second
+// kvApply applies one write and returns its outcome: the new revision for
+// key changes, the lease id for lease operations, kvResultFailed when a
+// compare or the lease did not check out
+func kvApply(op []byte) int64 {
+	if len(op) < kvOpHeaderSize {
+		return kvResultFailed
+	}
+	code := op[0]
+	keyLen := int(binary.BigEndian.Uint16(op[2:4]))
+	valLen := int(binary.BigEndian.Uint32(op[4:8]))
+	compare := int64(binary.BigEndian.Uint64(op[8:16]))
+	leaseID := int64(binary.BigEndian.Uint64(op[16:24]))
+	if len(op) != kvOpHeaderSize+keyLen+valLen {
+		return kvResultFailed
+	}
+	key := string(op[kvOpHeaderSize : kvOpHeaderSize+keyLen])
+	value := op[kvOpHeaderSize+keyLen:]
 
-		for attempt := 0; attempt < maxRetries; attempt++ {
-			err := connectToPeer(nodeID, peerAddr)
-			if err == nil {
-				log.Printf("pgraft: INFO - Successfully connected to peer %s (node %d)", peerAddr, nodeID)
-				return
+	kvMu.Lock()
+	defer kvMu.Unlock()
+
+	switch code {
+	case kvOpPut:
+		if !kvCompareLocked(key, compare) || (leaseID != 0 && kvLeases[leaseID] == nil) {
+			return kvResultFailed
+		}
+		rev := kvRevision + 1
+		e := &kvEntry{Value: append([]byte(nil), value...), CreateRev: rev, ModRev: rev, Version: 1, Lease: leaseID}
+		if old := kvEntries[key]; old != nil {
+			e.CreateRev = old.CreateRev
+			e.Version = old.Version + 1
+			kvDetachLocked(key, old)
+		}
+		kvEntries[key] = e
+		if l := kvLeases[leaseID]; l != nil {
+			l.keys[key] = struct{}{}
+		}
+		kvRevision = rev
+		kvRecordLocked(kvEvent{rev: rev, key: key, entry: *e})
+		kvNotifyLocked()
+		return rev
+
+	case kvOpDelete:
+		if kvEntries[key] == nil || !kvCompareLocked(key, compare) {
+			return kvResultFailed
+		}
+		kvRevision++
+		kvDeleteLocked(key, kvRevision)
+		kvNotifyLocked()
+		return kvRevision
+
+	case kvOpDeletePrefix:
+		var keys []string
+		for k := range kvEntries {
+			if strings.HasPrefix(k, key) {
+				keys = append(keys, k)
 			}
+		}
+		if len(keys) == 0 {
+			return kvResultFailed
+		}
+		sort.Strings(keys)
+		kvRevision++
+		for _, k := range keys {
+			kvDeleteLocked(k, kvRevision)
+		}
+		kvNotifyLocked()
+		return kvRevision
 
-			log.Printf("pgraft: WARNING - Failed to connect to peer %s (node %d, attempt %d/%d): %v",
-				peerAddr, nodeID, attempt+1, maxRetries, err)
+	case kvOpLeaseGrant:
+		ttl := time.Duration(compare) * time.Millisecond
+		if ttl < kvLeaseMinTTL {
+			ttl = kvLeaseMinTTL
+		}
+		id := kvNextLease
+		kvNextLease++
+		kvLeases[id] = &kvLease{ttl: ttl, keys: make(map[string]struct{}), deadline: time.Now().Add(ttl)}
+		return id
+
+	case kvOpLeaseKeep:
+		l := kvLeases[leaseID]
+		if l == nil {
+			return kvResultFailed
+		}
+		l.deadline = time.Now().Add(l.ttl)
+		return leaseID
 
-			if attempt < maxRetries-1 {
-				time.Sleep(retryDelay)
-				retryDelay *= 2 // Exponential backoff
+	case kvOpLeaseRevoke:
+		l := kvLeases[leaseID]
+		if l == nil {
+			return kvResultFailed
+		}
+		if len(l.keys) > 0 {
+			keys := make([]string, 0, len(l.keys))
+			for k := range l.keys {
+				keys = append(keys, k)
 			}
+			sort.Strings(keys)
+			kvRevision++
+			for _, k := range keys {
+				kvDeleteLocked(k, kvRevision)
+			}
+			kvNotifyLocked()
 		}
-
-		log.Printf("pgraft: ERROR - Failed to connect to peer %s (node %d) after %d attempts",
-			peerAddr, nodeID, maxRetries)
-	}()
+		delete(kvLeases, leaseID)
+		return leaseID
+	}
+	return kvResultFailed
 }
 
-// Connect to a specific peer
-func connectToPeer(nodeID uint64, peerAddr string) error {
-	conn, err := net.DialTimeout("tcp", peerAddr, 1*time.Second)
-	if err != nil {
-		return fmt.Errorf("failed to dial %s: %v", peerAddr, err)
+// applyKVEntry applies the writes in a committed proposal batch and keeps
+// the outcomes of this node's own for reportCommittedProposals
+func applyKVEntry(data []byte) {
+	if len(data) < proposalBatchHeaderSize || binary.BigEndian.Uint32(data[0:4]) != proposalBatchMagic {
+		return
 	}
+	own := raftConfig != nil && binary.BigEndian.Uint64(data[4:12]) == raftConfig.ID
+	count := binary.BigEndian.Uint32(data[12:16])
+	pos := proposalBatchHeaderSize
+	for n := uint32(0); n < count && pos+proposalItemHeaderSize <= len(data); n++ {
+		id := binary.BigEndian.Uint64(data[pos : pos+8])
+		length := int(binary.BigEndian.Uint32(data[pos+8 : pos+12]))
+		pos += proposalItemHeaderSize
+		if pos+length > len(data) {
+			return
+		}
+		item := data[pos : pos+length]
+		pos += length
 
-	// Send node ID first
-	if err := writeUint32(conn, uint32(nodeID)); err != nil {
-		conn.Close()
-		return fmt.Errorf("failed to send node ID: %v", err)
+		if !isKVItem(item) {
+			continue
+		}
+		result := kvApply(item[4:])
+		if own && id != 0 {
+			kvMu.Lock()
+			kvResults[id] = result
+			kvMu.Unlock()
+		}
 	}
+}
 
-	// Store connection
-	connMutex.Lock()
-	connections[nodeID] = conn
-	connMutex.Unlock()
+func isKVItem(item []byte) bool {
+	return len(item) >= 4 && binary.BigEndian.Uint32(item[0:4]) == kvMagic
+}
 
-	log.Printf("pgraft: INFO - Connected to peer %s (node %d)", peerAddr, nodeID)
+// takeKVResult hands over the outcome of one of this node's writes
+func takeKVResult(id uint64) (int64, bool) {
+	kvMu.Lock()
+	defer kvMu.Unlock()
 
-	// Start message handling for this connection
-	go handleConnectionMessages(nodeID, conn)
+	result, ok := kvResults[id]
+	if ok {
+		delete(kvResults, id)
+	}
+	return result, ok
+}
 
-	return nil
+func encodeKVOp(code byte, key string, value []byte, compare, lease int64) []byte {
+	buf := make([]byte, 4+kvOpHeaderSize, 4+kvOpHeaderSize+len(key)+len(value))
+	binary.BigEndian.PutUint32(buf[0:4], kvMagic)
+	buf[4] = code
+	binary.BigEndian.PutUint16(buf[6:8], uint16(len(key)))
+	binary.BigEndian.PutUint32(buf[8:12], uint32(len(value)))
+	binary.BigEndian.PutUint64(buf[12:20], uint64(compare))
+	binary.BigEndian.PutUint64(buf[20:28], uint64(lease))
+	buf = append(buf, key...)
+	return append(buf, value...)
 }
 
-// Configuration structure
-type PGRaftConfig struct {
-	PeerAddresses string
-	LogLevel      string
-	Port          int
+// pgraft_go_kv_propose queues a key-value write, laid out as in
+// PGRAFT_GO_KV_OP_HEADER, for the waiter proposalID.  The waiter gets the
+// write's outcome once it is applied here.
+//
+//export pgraft_go_kv_propose
+func pgraft_go_kv_propose(proposalID C.uint64_t, op *C.char, length C.int) C.int {
+	if length < 0 || !queueKVWrite(uint64(proposalID), unsafe.Slice((*byte)(unsafe.Pointer(op)), int(length))) {
+		return -1
+	}
+	return 0
 }
 
-// Load configuration from file
-func loadConfiguration() (*PGRaftConfig, error) {
-	config := &PGRaftConfig{
-		PeerAddresses: "",
-		LogLevel:      "info",
-		Port:          7400,
+// queueKVWrite copies op behind kvMagic and hands it to the batcher
+func queueKVWrite(id uint64, op []byte) bool {
+	if atomic.LoadInt32(&running) == 0 || len(op) < kvOpHeaderSize {
+		return false
 	}
 
-	// Try to read from common configuration locations
-	configPaths := []string{
-		"/Users/ibrarahmed/pgelephant/pge/ram/conf/pgraft.conf",
-		"/etc/pgraft/pgraft.conf",
-		"./pgraft.conf",
+	data := make([]byte, 4+len(op))
+	binary.BigEndian.PutUint32(data[0:4], kvMagic)
+	copy(data[4:], op)
+	select {
+	case proposalQueue <- queuedProposal{id: id, data: data}:
+		return true
+	default:
+		return false
 	}
+}
 
-	for _, path := range configPaths {
-		if data, err := os.ReadFile(path); err == nil {
-			log.Printf("pgraft: INFO - Loading configuration from %s", path)
-			return parseConfigurationFile(string(data)), nil
+// kvLeaseLoop revokes, on the leader, leases whose keepalives stopped.
+// A new leader first gives every lease a full TTL, since it cannot know
+// when the old one last heard from their holders.
+func kvLeaseLoop(ctx context.Context) {
+	ticker := time.NewTicker(kvLeaseCheckPeriod)
+	defer ticker.Stop()
+
+	wasLeader := false
+	for {
+		select {
+		case <-ctx.Done():
+			return
+		case <-ticker.C:
 		}
-	}
 
-	log.Printf("pgraft: WARNING - No configuration file found, using defaults")
-	return config, nil
-}
+		raftMutex.RLock()
+		leader := raftNode != nil && raftNode.Status().RaftState == raft.StateLeader
+		raftMutex.RUnlock()
 
-// Parse configuration file content
-func parseConfigurationFile(content string) *PGRaftConfig {
-	config := &PGRaftConfig{
-		PeerAddresses: "",
-		LogLevel:      "info",
-		Port:          7400,
-	}
+		now := time.Now()
+		var expired []int64
+		kvMu.Lock()
+		for id, l := range kvLeases {
+			if leader && !wasLeader {
+				l.deadline = now.Add(l.ttl)
+			}
+			if leader && now.After(l.deadline) && now.Sub(l.revoking) >= kvRevokeRetry {
+				l.revoking = now
+				expired = append(expired, id)
+			}
+		}
+		kvMu.Unlock()
+		wasLeader = leader
 
-	lines := strings.Split(content, "\n")
-	for _, line := range lines {
-		line = strings.TrimSpace(line)
-		if line == "" || strings.HasPrefix(line, "#") {
-			continue
+		for _, id := range expired {
+			logInfo("Revoking expired key-value lease %d", id)
+			if !queueUntrackedProposal(encodeKVOp(kvOpLeaseRevoke, "", nil, kvNoCompare, id)) {
+				logWarning("Could not queue the revocation of lease %d", id)
+			}
 		}
+	}
+}
 
-		parts := strings.SplitN(line, "=", 2)
-		if len(parts) != 2 {
-			continue
+// kvReadLocked collects what a read asks for; code is 1, or
+// kvResultCompacted for a watch from before the history
+func kvReadLocked(mode int, key string, after int64, limit int) (events []kvEvent, code int64) {
+	switch mode {
+	case kvReadGet:
+		if e := kvEntries[key]; e != nil {
+			events = append(events, kvEvent{rev: e.ModRev, key: key, entry: *e})
 		}
 
-		key := strings.TrimSpace(parts[0])
-		value := strings.TrimSpace(parts[1])
+	case kvReadPrefix:
+		var keys []string
+		for k := range kvEntries {
+			if strings.HasPrefix(k, key) {
+				keys = append(keys, k)
+			}
+		}
+		sort.Strings(keys)
+		for _, k := range keys {
+			if len(events) >= limit {
+				break
+			}
+			e := kvEntries[k]
+			events = append(events, kvEvent{rev: e.ModRev, key: k, entry: *e})
+		}
 
-		switch key {
-		case "raft_peer_addresses":
-			config.PeerAddresses = value
-		case "raft_log_level":
-			config.LogLevel = value
-		case "raft_port":
-			if port, err := strconv.Atoi(value); err == nil {
-				config.Port = port
+	case kvReadWatch:
+		if after < kvCompacted {
+			return nil, kvResultCompacted
+		}
+		i := sort.Search(len(kvHistory), func(i int) bool { return kvHistory[i].rev > after })
+		for ; i < len(kvHistory) && len(events) < limit; i++ {
+			if strings.HasPrefix(kvHistory[i].key, key) {
+				events = append(events, kvHistory[i])
 			}
 		}
-	}
 
-	return config
+	default:
+		return nil, -1
+	}
+	return events, 1
 }
 
-// Parse peer addresses from configuration string
-func parsePeerAddresses(peerAddressesStr string) []string {
-	if peerAddressesStr == "" {
-		return []string{}
+// pgraft_go_kv_read starts writing the result of a read to path and
+// returns.  mode is PGRAFT_GO_KV_READ_GET for one key, _PREFIX for every
+// key under a prefix and _WATCH for changes under a prefix after a
+// revision; a watch waits up to timeoutMs for the first one.  The file
+// holds the store revision and the history's compacted revision, then
+// limit records at most in the format of PGRAFT_GO_KV_RECORD_HEADER.  The
+// waiter is then given 1, PGRAFT_GO_KV_COMPACTED if a watch starts before
+// the history, or -1.
+//
+//export pgraft_go_kv_read
+func pgraft_go_kv_read(proposalID C.uint64_t, mode C.int, key *C.char, keyLen C.int, after C.int64_t, limit C.int, timeoutMs C.int, path *C.char) C.int {
+	raftMutex.RLock()
+	ctx := raftCtx
+	raftMutex.RUnlock()
+
+	target := C.GoString(path)
+	if atomic.LoadInt32(&running) == 0 || ctx == nil || target == "" || limit <= 0 {
+		return -1
 	}
+	prefix := C.GoStringN(key, keyLen)
+
+	go func(id uint64, mode int, after int64, limit int, wait time.Duration) {
+		deadline := time.Now().Add(wait)
+		var events []kvEvent
+		var code, rev, compacted int64
+		for {
+			kvMu.Lock()
+			events, code = kvReadLocked(mode, prefix, after, limit)
+			rev, compacted = kvRevision, kvCompacted
+			changed := kvChanged
+			kvMu.Unlock()
+
+			remaining := time.Until(deadline)
+			if code != 1 || len(events) > 0 || mode != kvReadWatch || remaining <= 0 {
+				break
+			}
+			timer := time.NewTimer(remaining)
+			select {
+			case <-changed:
+			case <-timer.C:
+			case <-ctx.Done():
+			}
+			timer.Stop()
+			if ctx.Err() != nil {
+				code = -1
+				break
+			}
+		}
 
-	addresses := strings.Split(peerAddressesStr, ",")
-	var result []string
+		if code == 1 {
+			if err := writeKVRecords(target, mode, rev, compacted, events); err != nil {
+				logError("kv_read: %v", err)
+				code = -1
+			}
+		}
 
-	for _, addr := range addresses {
-		addr = strings.TrimSpace(addr)
-		if addr != "" {
-			result = append(result, addr)
+		block := (*C.pgraft_go_proposal_block_t)(atomic.LoadPointer(&proposalBlock))
+		if block == nil {
+			return
+		}
+		proposalReportMu.Lock()
+		reportProposal(block, id, code)
+		proposalReportMu.Unlock()
+		notifyProposalWaiters()
+	}(uint64(proposalID), int(mode), int64(after), int(limit), time.Duration(timeoutMs)*time.Millisecond)
+	return 0
+}
+
+// writeKVRecords writes a read's result to path through a temporary file:
+// revision(8) | compacted(8), then per record event(1) | create
+// revision(8) | modification revision(8) | version(8) | lease(8) | key
+// length(4) | value length(4) | key | value
+func writeKVRecords(path string, mode int, rev, compacted int64, events []kvEvent) error {
+	tmp := path + ".tmp"
+	f, err := os.OpenFile(tmp, os.O_WRONLY|os.O_CREATE|os.O_TRUNC, 0600)
+	if err != nil {
+		return err
+	}
+	w := bufio.NewWriterSize(f, 64*1024)
+
+	var header [kvRecordHeader]byte
+	binary.BigEndian.PutUint64(header[0:8], uint64(rev))
+	binary.BigEndian.PutUint64(header[8:16], uint64(compacted))
+	w.Write(header[:kvFileHeader])
+	for i := range events {
+		ev := &events[i]
+		header[0] = kvEventValue
+		modRev := ev.entry.ModRev
+		if mode == kvReadWatch {
+			header[0] = kvEventPut
+			if ev.deleted {
+				header[0] = kvEventDelete
+			}
+			modRev = ev.rev
+		}
+		value := ev.entry.Value
+		if ev.deleted {
+			value = nil
 		}
+		binary.BigEndian.PutUint64(header[1:9], uint64(ev.entry.CreateRev))
+		binary.BigEndian.PutUint64(header[9:17], uint64(modRev))
+		binary.BigEndian.PutUint64(header[17:25], uint64(ev.entry.Version))
+		binary.BigEndian.PutUint64(header[25:33], uint64(ev.entry.Lease))
+		binary.BigEndian.PutUint32(header[33:37], uint32(len(ev.key)))
+		binary.BigEndian.PutUint32(header[37:41], uint32(len(value)))
+		w.Write(header[:])
+		w.WriteString(ev.key)
+		w.Write(value)
 	}
 
-	return result
+	err = w.Flush()
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(tmp, path)
+	}
+	if err != nil {
+		os.Remove(tmp)
+	}
+	return err
 }
 
 // ============================================================================
@@ -1330,26 +5351,21 @@ func parsePeerAddresses(peerAddressesStr string) []string {
 //export pgraft_go_replicate_log_entry
 func pgraft_go_replicate_log_entry(data *C.char, dataLen C.int) C.int {
 	raftMutex.RLock()
-	defer raftMutex.RUnlock()
+	node := raftNode
+	raftMutex.RUnlock()
 
-	if raftNode == nil {
+	if node == nil {
 		return C.int(0)
 	}
 
-	// Convert C data to Go
+	// Queue for the batcher, which proposes it with any concurrent entries
 	goData := C.GoBytes(unsafe.Pointer(data), dataLen)
-
-	// Propose the log entry for replication
-	ctx, cancel := context.WithTimeout(raftCtx, 5*time.Second)
-	defer cancel()
-
-	err := raftNode.Propose(ctx, goData)
-	if err != nil {
-		recordError(errors.New(fmt.Sprintf("failed to propose log entry: %v", err)))
+	if !queueUntrackedProposal(goData) {
+		recordError(errors.New("failed to queue log entry: proposal queue full"))
 		return C.int(0)
 	}
 
-	log.Printf("pgraft_go: proposed log entry for replication, size: %d bytes", len(goData))
+	logTrace("queued log entry for replication, size: %d bytes", len(goData))
 	return C.int(1)
 }
 
@@ -1366,8 +5382,8 @@ func pgraft_go_get_replication_status() *C.char {
 		"last_snapshot_index": replicationState.lastSnapshotIndex,
 		"replication_lag_ms":  replicationState.replicationLag.Milliseconds(),
 		"is_leader":           pgraft_go_get_leader() != 0,
-		"committed_index":     committedIndex,
-		"applied_index":       appliedIndex,
+		"committed_index":     atomic.LoadUint64(&committedIndex),
+		"applied_index":       atomic.LoadUint64(&appliedIndex),
 	}
 
 	jsonData, err := json.Marshal(status)
@@ -1388,25 +5404,23 @@ func pgraft_go_create_snapshot() *C.char {
 		return C.CString("")
 	}
 
-	// Create snapshot using etcd-io/raft
-	snapshot, err := raftStorage.CreateSnapshot(committedIndex, &raftpb.ConfState{
-		Voters: getClusterNodes(),
-	}, []byte("pgraft_snapshot_data"))
-
+	// Snapshot the applied state; this also rebases the WAL and compacts
+	snapshot, err := takeSnapshot(atomic.LoadUint64(&appliedIndex))
+	if err == raft.ErrSnapOutOfDate {
+		snapshot, err = raftStorage.Snapshot()
+	}
 	if err != nil {
 		recordError(errors.New(fmt.Sprintf("failed to create snapshot: %v", err)))
 		return C.CString("")
 	}
 
-	// Update replication state
-	replicationState.replicationMutex.Lock()
-	replicationState.lastSnapshotIndex = snapshot.Metadata.Index
-	replicationState.replicationMutex.Unlock()
-
-	// Serialize snapshot for return
+	// Describe the snapshot for the caller; followers get it over the transport
 	snapshotData, err := json.Marshal(map[string]interface{}{
 		"index":     snapshot.Metadata.Index,
 		"term":      snapshot.Metadata.Term,
+		"voters":    snapshot.Metadata.ConfState.Voters,
+		"learners":  snapshot.Metadata.ConfState.Learners,
+		"size":      len(snapshot.Data),
 		"data":      string(snapshot.Data),
 		"timestamp": time.Now().Unix(),
 	})
@@ -1416,7 +5430,7 @@ func pgraft_go_create_snapshot() *C.char {
 		return C.CString("")
 	}
 
-	log.Printf("pgraft_go: created snapshot at index %d", snapshot.Metadata.Index)
+	logInfo("created snapshot at index %d", snapshot.Metadata.Index)
 	return C.CString(string(snapshotData))
 }
 
@@ -1452,14 +5466,9 @@ func pgraft_go_apply_snapshot(snapshotData *C.char) C.int {
 		recordError(errors.New(fmt.Sprintf("failed to apply snapshot: %v", err)))
 		return C.int(0)
 	}
+	restoreSnapshot(snapshot)
 
-	// Update replication state
-	replicationState.replicationMutex.Lock()
-	replicationState.lastSnapshotIndex = snapshot.Metadata.Index
-	replicationState.lastAppliedIndex = snapshot.Metadata.Index
-	replicationState.replicationMutex.Unlock()
-
-	log.Printf("pgraft_go: applied snapshot at index %d", snapshot.Metadata.Index)
+	logInfo("applied snapshot at index %d", snapshot.Metadata.Index)
 	return C.int(1)
 }
 
@@ -1474,6 +5483,7 @@ func pgraft_go_replicate_to_node(nodeID C.uint64_t, data *C.char, dataLen C.int)
 
 	// Convert C data to Go
 	goData := C.GoBytes(unsafe.Pointer(data), dataLen)
+	committed := atomic.LoadUint64(&committedIndex)
 
 	// Create message for replication
 	msg := raftpb.Message{
@@ -1482,11 +5492,11 @@ func pgraft_go_replicate_to_node(nodeID C.uint64_t, data *C.char, dataLen C.int)
 		From:    raftConfig.ID,
 		Term:    getCurrentTerm(),
 		LogTerm: getCurrentTerm(),
-		Index:   committedIndex,
+		Index:   committed,
 		Entries: []raftpb.Entry{
 			{
 				Term:  getCurrentTerm(),
-				Index: committedIndex + 1,
+				Index: committed + 1,
 				Type:  raftpb.EntryNormal,
 				Data:  goData,
 			},
@@ -1496,7 +5506,7 @@ func pgraft_go_replicate_to_node(nodeID C.uint64_t, data *C.char, dataLen C.int)
 	// Send message through the message channel
 	select {
 	case messageChan <- msg:
-		log.Printf("pgraft_go: sent replication message to node %d", nodeID)
+		logTrace("sent replication message to node %d", nodeID)
 		return C.int(1)
 	default:
 		recordError(errors.New("message channel full, cannot replicate to node"))
@@ -1510,7 +5520,7 @@ func pgraft_go_get_replication_lag() C.double {
 	defer replicationState.replicationMutex.RUnlock()
 
 	// Calculate replication lag based on committed vs applied index
-	lag := float64(committedIndex - replicationState.lastAppliedIndex)
+	lag := float64(atomic.LoadUint64(&committedIndex) - replicationState.lastAppliedIndex)
 
 	// Update replication lag duration
 	replicationState.replicationLag = time.Duration(lag) * time.Millisecond
@@ -1534,12 +5544,12 @@ func pgraft_go_sync_replication() C.int {
 		for _, entry := range rd.CommittedEntries {
 			if entry.Type == raftpb.EntryNormal {
 				// Apply the entry to state machine
-				appliedIndex = entry.Index
+				atomic.StoreUint64(&appliedIndex, entry.Index)
 				replicationState.replicationMutex.Lock()
 				replicationState.lastAppliedIndex = entry.Index
 				replicationState.replicationMutex.Unlock()
 
-				log.Printf("pgraft_go: applied entry %d for replication", entry.Index)
+				logTrace("applied entry %d for replication", entry.Index)
 			}
 		}
 
@@ -1575,124 +5585,109 @@ func getClusterNodes() []uint64 {
 
 // processRaftReady processes Raft ready messages for leader election and log replication
 func processRaftReady() {
-	log.Printf("pgraft: processRaftReady started")
+	if !atomic.CompareAndSwapInt32(&readyLoopRunning, 0, 1) {
+		logDebug("processRaftReady already running")
+		return
+	}
+	defer atomic.StoreInt32(&readyLoopRunning, 0)
+
+	logDebug("processRaftReady started")
+
+	applyQueue := make(chan applyTask, applyQueueDepth)
+	applyDone := make(chan struct{})
+	go applyLoop(applyQueue, applyDone)
+	defer func() {
+		close(applyQueue)
+		<-applyDone
+	}()
+
+	isLeader := false
 
 	for {
 		select {
 		case <-raftCtx.Done():
-			log.Printf("pgraft: processRaftReady stopping")
+			logDebug("processRaftReady stopping")
 			return
 		case rd := <-raftNode.Ready():
-			log.Printf("pgraft: DEBUG - Processing Raft Ready message")
+			logTrace("Processing Raft Ready: HardState %+v, %d entries, %d messages, %d committed",
+				rd.HardState, len(rd.Entries), len(rd.Messages), len(rd.CommittedEntries))
 
-			// Save to storage
+			if rd.SoftState != nil {
+				isLeader = rd.SoftState.RaftState == raft.StateLeader
+				noteSoftState(rd.SoftState)
+			}
 			if !raft.IsEmptyHardState(rd.HardState) {
-				log.Printf("pgraft: DEBUG - Saving hard state: term=%d, commit=%d", rd.HardState.Term, rd.HardState.Commit)
-				raftStorage.SetHardState(rd.HardState)
-
-				// Update cluster state
 				clusterState.CurrentTerm = rd.HardState.Term
 				clusterState.CommitIndex = rd.HardState.Commit
-
-				// Update leader information from hard state
-				if rd.HardState.Vote != 0 {
-					clusterState.LeaderID = rd.HardState.Vote
-					log.Printf("pgraft: INFO - Leader elected: %d", rd.HardState.Vote)
-
-					// Update shared memory cluster state
-					updateSharedMemoryClusterState(int64(rd.HardState.Vote), int64(rd.HardState.Term), "leader")
-				}
 			}
-
-			// Save entries
 			if len(rd.Entries) > 0 {
-				log.Printf("pgraft: DEBUG - Saving %d entries", len(rd.Entries))
-				raftStorage.Append(rd.Entries)
 				clusterState.LastIndex = rd.Entries[len(rd.Entries)-1].Index
 			}
 
-			// Process committed entries
-			for _, entry := range rd.CommittedEntries {
-				if entry.Type == raftpb.EntryConfChange {
-					log.Printf("pgraft: processing configuration change")
-					var cc raftpb.ConfChange
-					cc.Unmarshal(entry.Data)
-
-					switch cc.Type {
-					case raftpb.ConfChangeAddNode:
-						log.Printf("pgraft: adding node %d", cc.NodeID)
-						raftNode.ApplyConfChange(cc)
-					case raftpb.ConfChangeRemoveNode:
-						log.Printf("pgraft: removing node %d", cc.NodeID)
-						raftNode.ApplyConfChange(cc)
-					}
-				} else if entry.Type == raftpb.EntryNormal && len(entry.Data) > 0 {
-					log.Printf("pgraft: processing normal entry: %s", string(entry.Data))
-					// Process normal log entry
-					committedIndex = entry.Index
-					atomic.StoreInt64(&logEntriesCommitted, int64(entry.Index))
-				}
-			}
-
-			// Send messages to peers
-			for _, msg := range rd.Messages {
-				log.Printf("pgraft: DEBUG - Sending message type %s from %d to %d", msg.Type, msg.From, msg.To)
-				sendMessage(msg)
-			}
-
-			// Process state changes
-			if rd.SoftState != nil {
-				log.Printf("pgraft: state changed to %s, leader: %d",
-					raft.StateType(rd.SoftState.RaftState).String(), rd.SoftState.Lead)
-
-				raftMutex.Lock()
-				// Get current term from storage
-				hs, _, _ := raftStorage.InitialState()
-				clusterState.CurrentTerm = hs.Term
-				clusterState.LeaderID = rd.SoftState.Lead
-				clusterState.State = raft.StateType(rd.SoftState.RaftState).String()
-				raftMutex.Unlock()
-
-				// Update shared memory cluster state
-				stateStr := raft.StateType(rd.SoftState.RaftState).String()
-				updateSharedMemoryClusterState(int64(rd.SoftState.Lead), int64(hs.Term), stateStr)
-
-				if rd.SoftState.Lead != 0 {
-					log.Printf("pgraft: leader elected: %d", rd.SoftState.Lead)
-					atomic.StoreInt64(&electionsTriggered, atomic.LoadInt64(&electionsTriggered)+1)
-				}
+			if !processReady(rd, isLeader, applyQueue) {
+				return
 			}
+			observeReady(&rd)
 
-			// Advance the node
+			publishStatus(rd)
 			raftNode.Advance()
 		}
 	}
 }
 
+// noteSoftState records a leadership or role change in the cluster state
+func noteSoftState(ss *raft.SoftState) {
+	stateStr := raft.StateType(ss.RaftState).String()
+	logInfo("state changed to %s, leader: %d", stateStr, ss.Lead)
+
+	raftMutex.Lock()
+	hs, _, _ := raftStorage.InitialState()
+	clusterState.CurrentTerm = hs.Term
+	clusterState.LeaderID = ss.Lead
+	clusterState.State = stateStr
+	raftMutex.Unlock()
+
+	updateSharedMemoryClusterState(int64(ss.Lead), int64(hs.Term), stateStr)
+
+	if ss.Lead != 0 {
+		logInfo("leader elected: %d", ss.Lead)
+		atomic.AddInt64(&electionsTriggered, 1)
+	}
+}
+
 // processRaftTicker handles periodic Raft operations
 func processRaftTicker() {
-	log.Printf("pgraft: processRaftTicker started")
+	logDebug("processRaftTicker started")
+
+	activeTick := currentTickInterval()
+	lastAdapt := time.Now()
+	lastMetrics := time.Now()
 
 	for {
 		select {
 		case <-raftCtx.Done():
-			log.Printf("pgraft: processRaftTicker stopping")
+			logDebug("processRaftTicker stopping")
 			return
 		case <-raftTicker.C:
+			if time.Since(lastAdapt) >= adaptiveInterval {
+				adaptTickInterval()
+				lastAdapt = time.Now()
+			}
+			if time.Since(lastMetrics) >= metricsPublishPeriod {
+				publishMetrics()
+				lastMetrics = time.Now()
+			}
+			if tick := currentTickInterval(); tick != activeTick {
+				raftTicker.Reset(tick)
+				activeTick = tick
+			}
+
 			if raftNode != nil {
 				// Tick the Raft node (this triggers elections, heartbeats, etc.)
+				// Readys are consumed by processRaftReady alone
 				raftNode.Tick()
-
-				// Check for ready messages
-				select {
-				case rd := <-raftNode.Ready():
-					log.Printf("pgraft: ticker received ready message")
-					raftReady <- rd
-				default:
-					// No ready message
-				}
 			} else {
-				log.Printf("pgraft: ticker - raftNode is nil")
+				logTrace("ticker - raftNode is nil")
 			}
 		}
 	}
@@ -1704,66 +5699,31 @@ func getCurrentTerm() uint64 {
 	return hs.Term
 }
 
-// sendMessage sends a Raft message to a peer
-func sendMessage(msg raftpb.Message) {
-	log.Printf("pgraft: DEBUG - Sending message to node %d: type=%s", msg.To, msg.Type)
-
-	// Get connection to peer
-	connMutex.Lock()
-	conn, exists := connections[msg.To]
-	connMutex.Unlock()
-
-	if !exists {
-		log.Printf("pgraft: WARNING - No connection to peer %d", msg.To)
-		return
-	}
-
-	// Serialize message
-	data, err := msg.Marshal()
-	if err != nil {
-		log.Printf("pgraft: ERROR - Failed to marshal message: %v", err)
-		return
-	}
-
-	// Send message length first
-	if err := writeUint32(conn, uint32(len(data))); err != nil {
-		log.Printf("pgraft: ERROR - Failed to send message length: %v", err)
-		return
-	}
-
-	// Send message data
-	if _, err := conn.Write(data); err != nil {
-		log.Printf("pgraft: ERROR - Failed to send message data: %v", err)
-		return
-	}
-
-	log.Printf("pgraft: DEBUG - Message sent successfully to node %d", msg.To)
-	atomic.AddInt64(&messagesProcessed, 1)
-}
-
 // processIncomingMessages processes messages from the message channel
 func processIncomingMessages() {
-	log.Printf("pgraft: INFO - Starting message processing loop")
+	logInfo("Starting message processing loop")
 
 	for {
 		select {
 		case <-raftDone:
-			log.Printf("pgraft: INFO - Message processing loop stopped")
+			logInfo("Message processing loop stopped")
 			return
 		case <-raftCtx.Done():
-			log.Printf("pgraft: INFO - Message processing loop stopped (context cancelled)")
+			logInfo("Message processing loop stopped (context cancelled)")
 			return
 		case msg := <-messageChan:
 			if raftNode == nil {
-				log.Printf("pgraft: WARNING - Received message but Raft node is nil")
+				logWarning("Received message but Raft node is nil")
 				continue
 			}
 
-			log.Printf("pgraft: DEBUG - Processing incoming message: type=%s, from=%d, to=%d, term=%d",
+			logTrace("Processing incoming message: type=%s, from=%d, to=%d, term=%d",
 				msg.Type.String(), msg.From, msg.To, msg.Term)
 
 			// Send message to Raft node
 			raftNode.Step(raftCtx, msg)
+			observeRTTResponse(&msg)
+			countMessage(&msgReceivedCount, msg.Type)
 
 			// Update cluster state based on message type
 			switch msg.Type {
@@ -1771,7 +5731,7 @@ func processIncomingMessages() {
 				// Update term if this is a higher term
 				if msg.Term > clusterState.CurrentTerm {
 					clusterState.CurrentTerm = msg.Term
-					log.Printf("pgraft: INFO - Updated term to %d", msg.Term)
+					logTrace("Updated term to %d", msg.Term)
 				}
 
 			case raftpb.MsgHeartbeat, raftpb.MsgHeartbeatResp:
@@ -1779,7 +5739,7 @@ func processIncomingMessages() {
 				if msg.Type == raftpb.MsgHeartbeat && msg.From != 0 {
 					clusterState.LeaderID = msg.From
 					clusterState.State = "follower"
-					log.Printf("pgraft: INFO - Received heartbeat from leader %d", msg.From)
+					logTrace("Received heartbeat from leader %d", msg.From)
 				}
 			}
 
@@ -1790,7 +5750,7 @@ func processIncomingMessages() {
 
 // updateSharedMemoryClusterState updates the shared memory cluster state from Go
 func updateSharedMemoryClusterState(leaderID int64, currentTerm int64, state string) {
-	log.Printf("pgraft: INFO - Cluster state update: leader=%d, term=%d, state=%s", leaderID, currentTerm, state)
+	logTrace("Cluster state update: leader=%d, term=%d, state=%s", leaderID, currentTerm, state)
 
 	// Store the cluster state in a global variable that can be accessed by C functions
 	raftMutex.Lock()
@@ -1799,13 +5759,13 @@ func updateSharedMemoryClusterState(leaderID int64, currentTerm int64, state str
 	clusterState.State = state
 	raftMutex.Unlock()
 
-	log.Printf("pgraft: INFO - Updated internal cluster state: leader=%d, term=%d, state=%s", leaderID, currentTerm, state)
+	logTrace("Updated internal cluster state: leader=%d, term=%d, state=%s", leaderID, currentTerm, state)
 }
 
 //export pgraft_go_update_cluster_state
 func pgraft_go_update_cluster_state(leaderID C.longlong, currentTerm C.longlong, state *C.char) C.int {
 	// This function will be called from C to update the cluster state
-	log.Printf("pgraft: DEBUG - pgraft_go_update_cluster_state called: leader=%d, term=%d, state=%s", int64(leaderID), int64(currentTerm), C.GoString(state))
+	logTrace("pgraft_go_update_cluster_state called: leader=%d, term=%d, state=%s", int64(leaderID), int64(currentTerm), C.GoString(state))
 
 	// Update the internal cluster state
 	updateSharedMemoryClusterState(int64(leaderID), int64(currentTerm), C.GoString(state))
@@ -101,15 +101,14 @@ extern char* pgraft_go_version(void);
 extern int pgraft_go_test(void);
 extern int pgraft_go_init(int nodeID, char* address, int port);
 extern int pgraft_go_start_background(void);
-extern int pgraft_go_add_peer(int nodeID, char* address, int port);
-extern int pgraft_go_remove_peer(int nodeID);
+extern int pgraft_go_change_peers(uint64_t proposalID, struct pgraft_go_peer_change* changes, int count);
 extern char* pgraft_go_get_state(void);
 extern int64_t pgraft_go_get_leader(void);
 extern int32_t pgraft_go_get_term(void);
 extern int pgraft_go_is_leader(void);
 extern int pgraft_go_append_log(char* data, int length);
 extern char* pgraft_go_get_stats(void);
-extern char* pgraft_go_get_logs(void);
+extern int pgraft_go_dump_log_entries(uint64_t proposalID, uint64_t fromIndex, int limit, int64_t maxBytes, char* path);
 extern int pgraft_go_commit_log(long index);
 extern int pgraft_go_step_message(char* data, int length);
 extern char* pgraft_go_get_network_status(void);
@@ -22,6 +22,9 @@ char	   *pgraft_address = NULL;
 int			pgraft_log_level = 1;
 int			pgraft_heartbeat_interval = 1000;
 int			pgraft_election_timeout = 5000;
+bool		pgraft_adaptive_timing = false;
+bool		pgraft_pre_vote = true;
+bool		pgraft_check_quorum = true;
 bool		pgraft_worker_enabled = true;
 int			pgraft_worker_interval = 1000;
 char	   *pgraft_cluster_name = NULL;
@@ -36,9 +39,40 @@ bool		pgraft_is_primary = false;
 int			pgraft_health_period_ms = 5000;
 bool		pgraft_health_verbose = false;
 
+/* Shared memory log sizing GUCs */
+int			pgraft_log_buffer_size = 512;	/* kB */
+int			pgraft_log_max_entries = 4096;
+
+/* Snapshot and compaction GUCs */
+int			pgraft_snapshot_threshold = 10000;
+int			pgraft_snapshot_max_log_size = 65536;	/* kB */
+int			pgraft_snapshot_catchup_entries = 5000;
+
+/* Proposal batching GUCs */
+int			pgraft_proposal_batch_delay = 200;	/* microseconds */
+int			pgraft_proposal_batch_size = 256;	/* kB */
+
+/* Read barrier GUCs */
+bool		pgraft_lease_read = false;
+
 /* Metrics and debugging GUCs */
 bool		pgraft_metrics_enabled = true;
 bool		pgraft_trace_enabled = false;
+int			pgraft_debug_peer_delay = 0;	/* milliseconds */
+
+/* Peer TLS GUCs */
+char	   *pgraft_ssl_cert_file = NULL;
+char	   *pgraft_ssl_key_file = NULL;
+char	   *pgraft_ssl_ca_file = NULL;
+
+/* Peer compression GUCs */
+bool		pgraft_peer_compression = false;
+int			pgraft_peer_compression_threshold = 64;	/* kB */
+
+/* WAL archive module GUCs */
+char	   *pgraft_archive_spool_dir = NULL;
+int			pgraft_archive_queue_depth = 64;
+int			pgraft_archive_timeout = 60000;	/* milliseconds */
 
 /*
  * Register GUC variables
@@ -99,12 +133,12 @@ pgraft_register_guc_variables(void)
 
 	DefineCustomIntVariable("pgraft.heartbeat_interval",
 							"Heartbeat interval in milliseconds",
-							NULL,
+							"This is also the Raft tick; pgraft.adaptive_timing may shorten it.",
 							&pgraft_heartbeat_interval,
 							1000,
-							100,
+							10,
 							60000,
-							PGC_SUSET,
+							PGC_POSTMASTER,
 							0,
 							NULL,
 							NULL,
@@ -112,12 +146,45 @@ pgraft_register_guc_variables(void)
 
 	DefineCustomIntVariable("pgraft.election_timeout",
 							"Election timeout in milliseconds",
-							NULL,
+							"Rounded down to a whole number of heartbeat intervals, at least two.",
 							&pgraft_election_timeout,
 							5000,
-							1000,
+							100,
 							30000,
-							PGC_SUSET,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("pgraft.adaptive_timing",
+							"Shorten the Raft tick to follow the measured peer round-trip time",
+							"Heartbeat interval and election timeout keep their ratio and never exceed the configured values.",
+							&pgraft_adaptive_timing,
+							false,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("pgraft.pre_vote",
+							"Poll peers before starting an election",
+							"A node that cannot win, such as one rejoining after a partition, then leaves the term alone.",
+							&pgraft_pre_vote,
+							true,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("pgraft.check_quorum",
+							"Make a leader step down when it stops hearing from a quorum",
+							"Always on when pgraft.lease_read is set.",
+							&pgraft_check_quorum,
+							true,
+							PGC_POSTMASTER,
 							0,
 							NULL,
 							NULL,
@@ -252,6 +319,112 @@ pgraft_register_guc_variables(void)
 							NULL,
 							NULL);
 
+	/* Shared memory log sizing */
+	DefineCustomIntVariable("pgraft.log_buffer_size",
+							"Size of the shared memory arena holding log entry payloads",
+							"Space is reclaimed from applied entries as new ones are appended.",
+							&pgraft_log_buffer_size,
+							512,
+							16,
+							INT_MAX / 1024,
+							PGC_POSTMASTER,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.log_max_entries",
+							"Maximum number of log entries retained in shared memory",
+							NULL,
+							&pgraft_log_max_entries,
+							4096,
+							64,
+							1048576,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Snapshot and compaction GUCs */
+	DefineCustomIntVariable("pgraft.snapshot_threshold",
+							"Number of applied log entries that triggers a snapshot",
+							"The log is compacted behind each snapshot.",
+							&pgraft_snapshot_threshold,
+							10000,
+							100,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.snapshot_max_log_size",
+							"Applied log payload size that triggers a snapshot",
+							NULL,
+							&pgraft_snapshot_max_log_size,
+							65536,
+							1024,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.snapshot_catchup_entries",
+							"Number of entries kept behind a snapshot for lagging followers",
+							"Followers further behind are sent the snapshot instead.",
+							&pgraft_snapshot_catchup_entries,
+							5000,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Proposal batching GUCs */
+	DefineCustomIntVariable("pgraft.proposal_batch_delay",
+							"Microseconds to wait for concurrent proposals to join a batch",
+							"Proposals queued meanwhile share one Raft entry; 0 batches only what is already queued.",
+							&pgraft_proposal_batch_delay,
+							200,
+							0,
+							100000,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.proposal_batch_size",
+							"Payload size at which a proposal batch is sent without waiting",
+							NULL,
+							&pgraft_proposal_batch_size,
+							256,
+							1,
+							65536,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Read barrier GUCs */
+	DefineCustomBoolVariable("pgraft.lease_read",
+							"Serve read barriers from the leader lease instead of a quorum round",
+							"Saves a heartbeat round per pgraft_read_barrier() but relies on bounded clock drift; enables CheckQuorum.",
+							&pgraft_lease_read,
+							false,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	/* Metrics and debugging GUCs */
 	DefineCustomBoolVariable("pgraft.metrics_enabled",
 							"Enable metrics collection",
@@ -274,6 +447,116 @@ pgraft_register_guc_variables(void)
 							NULL,
 							NULL,
 							NULL);
+
+	DefineCustomIntVariable("pgraft.debug_peer_delay",
+							"Delay added to every Raft message sent to a peer, for testing",
+							"Lets a single-host cluster be benchmarked as if its nodes were far apart; each round trip grows by twice this.",
+							&pgraft_debug_peer_delay,
+							0,
+							0,
+							10000,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	/* Peer TLS GUCs */
+	DefineCustomStringVariable("pgraft.ssl_cert_file",
+							   "Certificate this node presents on Raft peer connections",
+							   "Empty keeps peer connections in plaintext.  Every node of a cluster needs the same choice.  The files are reread when they change.",
+							   &pgraft_ssl_cert_file,
+							   "",
+							   PGC_SIGHUP,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomStringVariable("pgraft.ssl_key_file",
+							   "Private key of pgraft.ssl_cert_file",
+							   NULL,
+							   &pgraft_ssl_key_file,
+							   "",
+							   PGC_SIGHUP,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomStringVariable("pgraft.ssl_ca_file",
+							   "CA that signs the certificates of all Raft peers",
+							   "Set, a peer must present a certificate it signed both when dialing and when accepting; empty, dialed peers are checked against the system roots.",
+							   &pgraft_ssl_ca_file,
+							   "",
+							   PGC_SIGHUP,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	/* Peer compression GUCs */
+	DefineCustomBoolVariable("pgraft.peer_compression",
+							"Compress large message batches and snapshots between Raft peers",
+							"A link compresses only when both of its nodes have this on; turn it on once every node runs a version that knows it.  Takes effect on new peer connections.",
+							&pgraft_peer_compression,
+							false,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.peer_compression_threshold",
+							"Smallest batch of Raft messages that is compressed",
+							"Heartbeats and votes stay below it; snapshot chunks are always compressed.",
+							&pgraft_peer_compression_threshold,
+							64,
+							1,
+							65536,
+							PGC_SIGHUP,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	/* WAL archive module GUCs */
+	DefineCustomStringVariable("pgraft.archive_spool_dir",
+							   "Directory archive_library = 'pgraft' hands WAL files to ramd through",
+							   "Relative paths are taken from the data directory.  Must match ramd's archive_spool_dir.",
+							   &pgraft_archive_spool_dir,
+							   "pgraft_archive",
+							   PGC_SIGHUP,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("pgraft.archive_queue_depth",
+							"WAL files handed to ramd at once by the archive module",
+							"Each call queues the files waiting in archive_status behind the one PostgreSQL asked for, so ramd can upload them in parallel.",
+							&pgraft_archive_queue_depth,
+							64,
+							1,
+							4096,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pgraft.archive_timeout",
+							"How long the archive module waits for ramd to store one WAL file",
+							"On timeout the file is reported as not archived and PostgreSQL retries it.",
+							&pgraft_archive_timeout,
+							60000,
+							100,
+							INT_MAX,
+							PGC_SIGHUP,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
 }
 
 /*
@@ -301,19 +584,25 @@ pgraft_validate_configuration(void)
 	}
 
 	/* Validate heartbeat interval */
-	if (pgraft_heartbeat_interval < 100 || pgraft_heartbeat_interval > 60000)
+	if (pgraft_heartbeat_interval < 10 || pgraft_heartbeat_interval > 60000)
 	{
-		elog(ERROR, "pgraft: Invalid heartbeat_interval %d, must be between 100 and 60000 ms", 
+		elog(ERROR, "pgraft: Invalid heartbeat_interval %d, must be between 10 and 60000 ms", 
 			 pgraft_heartbeat_interval);
 	}
 
 	/* Validate election timeout */
-	if (pgraft_election_timeout < 1000 || pgraft_election_timeout > 30000)
+	if (pgraft_election_timeout < 100 || pgraft_election_timeout > 30000)
 	{
-		elog(ERROR, "pgraft: Invalid election_timeout %d, must be between 1000 and 30000 ms", 
+		elog(ERROR, "pgraft: Invalid election_timeout %d, must be between 100 and 30000 ms", 
 			 pgraft_election_timeout);
 	}
 
+	if (pgraft_election_timeout < 2 * pgraft_heartbeat_interval)
+	{
+		elog(ERROR, "pgraft: election_timeout %d must be at least twice heartbeat_interval %d",
+			 pgraft_election_timeout, pgraft_heartbeat_interval);
+	}
+
 	elog(DEBUG1, "pgraft: Configuration validation completed successfully");
 }
 
@@ -3,6 +3,11 @@
  * pgraft_log.c
  *      Log replication management for pgraft
  *
+ * The log lives in a single shared memory segment: a header, a ring of
+ * fixed-size entry descriptors and a byte arena holding the variable
+ * length payloads.  Both rings are sized at postmaster start from
+ * pgraft.log_max_entries and pgraft.log_buffer_size.
+ *
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
  *-------------------------------------------------------------------------
@@ -11,15 +16,44 @@
 #include "postgres.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
+#include "storage/condition_variable.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
 #include "utils/elog.h"
 #include "utils/timestamp.h"
 
 #include <string.h>
 
 #include "../include/pgraft_log.h"
+#include "../include/pgraft_guc.h"
 
 /* Global shared memory pointer */
 static pgraft_log_state_t *g_log_state = NULL;
+static pgraft_proposal_state_t *g_proposal_state = NULL;
+
+static inline pgraft_log_entry_t *pgraft_log_lookup(pgraft_log_state_t *state, int64_t index);
+static void pgraft_log_pop_head(pgraft_log_state_t *state);
+static void pgraft_log_arena_write(pgraft_log_state_t *state, uint64 pos,
+								   const char *data, int32_t size);
+static void pgraft_log_arena_read(pgraft_log_state_t *state, uint64 pos,
+								  char *data, int32_t size);
+
+/*
+ * Compute the shared memory needed for the log
+ */
+Size
+pgraft_log_shmem_size(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(pgraft_log_state_t));
+	size = add_size(size, MAXALIGN(mul_size(sizeof(pgraft_log_entry_t),
+											(Size) pgraft_log_max_entries)));
+	size = add_size(size, mul_size((Size) pgraft_log_buffer_size, 1024));
+
+	return size;
+}
 
 /*
  * Initialize shared memory for log replication
@@ -29,18 +63,18 @@ pgraft_log_init_shared_memory(void)
 {
 	bool		found;
 	
-	elog(INFO, "pgraft: Initializing log replication shared memory");
+	elog(DEBUG1, "pgraft: Initializing log replication shared memory");
 	
 	/* Allocate shared memory */
 	g_log_state = (pgraft_log_state_t *) ShmemInitStruct("pgraft_log_state",
-														 sizeof(pgraft_log_state_t),
+														 pgraft_log_shmem_size(),
 														 &found);
 	
 	if (!found)
 	{
-		elog(INFO, "pgraft: Creating new log replication shared memory");
+		elog(DEBUG1, "pgraft: Creating new log replication shared memory");
 		
-		/* Initialize shared memory */
+		/* Initialize header; descriptors and arena need no initialization */
 		memset(g_log_state, 0, sizeof(pgraft_log_state_t));
 		
 		/* Initialize mutex */
@@ -48,19 +82,18 @@ pgraft_log_init_shared_memory(void)
 		
 		/* Initialize default values */
 		g_log_state->log_size = 0;
+		g_log_state->first_index = 1;
 		g_log_state->last_index = 0;
 		g_log_state->commit_index = 0;
 		g_log_state->last_applied = 0;
-		g_log_state->entries_replicated = 0;
-		g_log_state->entries_committed = 0;
-		g_log_state->entries_applied = 0;
-		g_log_state->replication_errors = 0;
+		g_log_state->max_entries = pgraft_log_max_entries;
+		g_log_state->head = 0;
+		g_log_state->arena_size = (uint64) pgraft_log_buffer_size * 1024;
+		g_log_state->arena_head = 0;
+		g_log_state->arena_tail = 0;
 		
-		elog(INFO, "pgraft: Log replication shared memory initialized");
-	}
-	else
-	{
-		elog(INFO, "pgraft: Log replication shared memory already exists");
+		elog(LOG, "pgraft: Log replication shared memory initialized (%d entries, %llu byte arena)",
+			 g_log_state->max_entries, (unsigned long long) g_log_state->arena_size);
 	}
 }
 
@@ -78,14 +111,84 @@ pgraft_log_get_shared_memory(void)
 	return g_log_state;
 }
 
+/*
+ * Find the descriptor for a log index, or NULL if it is not retained.
+ * Caller must hold the mutex.
+ */
+static inline pgraft_log_entry_t *
+pgraft_log_lookup(pgraft_log_state_t *state, int64_t index)
+{
+	int64_t		offset;
+
+	if (state->log_size == 0 || index < state->first_index || index > state->last_index)
+		return NULL;
+
+	offset = index - state->first_index;
+	return &PGRAFT_LOG_ENTRIES(state)[(state->head + offset) % state->max_entries];
+}
+
+/*
+ * Drop the oldest entry and release its payload bytes.
+ * Caller must hold the mutex.
+ */
+static void
+pgraft_log_pop_head(pgraft_log_state_t *state)
+{
+	pgraft_log_entry_t *entry = &PGRAFT_LOG_ENTRIES(state)[state->head];
+
+	state->arena_head = entry->data_pos + (uint64) entry->data_size;
+	state->head = (state->head + 1) % state->max_entries;
+	state->first_index++;
+	state->log_size--;
+	state->entries_reclaimed++;
+
+	if (state->log_size == 0)
+		state->arena_head = state->arena_tail;
+}
+
+/*
+ * Copy payload bytes into the arena, wrapping at the end.
+ */
+static void
+pgraft_log_arena_write(pgraft_log_state_t *state, uint64 pos, const char *data, int32_t size)
+{
+	char	   *arena = PGRAFT_LOG_ARENA(state);
+	uint64		start = pos % state->arena_size;
+	uint64		first = Min((uint64) size, state->arena_size - start);
+
+	memcpy(arena + start, data, first);
+	if (first < (uint64) size)
+		memcpy(arena, data + first, (uint64) size - first);
+}
+
+/*
+ * Copy payload bytes out of the arena, wrapping at the end.
+ */
+static void
+pgraft_log_arena_read(pgraft_log_state_t *state, uint64 pos, char *data, int32_t size)
+{
+	char	   *arena = PGRAFT_LOG_ARENA(state);
+	uint64		start = pos % state->arena_size;
+	uint64		first = Min((uint64) size, state->arena_size - start);
+
+	memcpy(data, arena + start, first);
+	if (first < (uint64) size)
+		memcpy(data + first, arena, (uint64) size - first);
+}
+
 /*
  * Append entry to log
+ *
+ * Entries already applied are reclaimed from the head of the ring until the
+ * new payload fits.  The log is only reported full when every retained entry
+ * is still waiting to be applied.
  */
 int
 pgraft_log_append_entry(int64_t term, const char *data, int32_t data_size)
 {
 	pgraft_log_state_t *state;
 	pgraft_log_entry_t *entry;
+	int64_t		index;
 	
 	state = pgraft_log_get_shared_memory();
 	if (!state)
@@ -94,40 +197,65 @@ pgraft_log_append_entry(int64_t term, const char *data, int32_t data_size)
 		return -1;
 	}
 	
-	if (data_size > 1024)
+	if (data_size < 0 || (data_size > 0 && data == NULL))
 	{
-		elog(ERROR, "pgraft: Data size %d exceeds maximum 1024", data_size);
+		elog(ERROR, "pgraft: Invalid log entry payload");
+		return -1;
+	}
+	
+	if ((uint64) data_size > state->arena_size)
+	{
+		elog(ERROR, "pgraft: Data size %d exceeds log buffer size %llu",
+			 data_size, (unsigned long long) state->arena_size);
 		return -1;
 	}
 	
 	SpinLockAcquire(&state->mutex);
 	
-	if (state->log_size >= 1000)
+	/* Reclaim applied entries until both the ring and the arena have room */
+	while (state->log_size > 0 &&
+		   state->first_index <= state->last_applied &&
+		   (state->log_size >= state->max_entries ||
+			state->arena_tail - state->arena_head + (uint64) data_size > state->arena_size))
+		pgraft_log_pop_head(state);
+	
+	if (state->log_size >= state->max_entries ||
+		state->arena_tail - state->arena_head + (uint64) data_size > state->arena_size)
 	{
+		int32_t		log_size = state->log_size;
+
+		state->replication_errors++;
 		SpinLockRelease(&state->mutex);
-		elog(ERROR, "pgraft: Log is full (1000 entries)");
+		ereport(ERROR,
+				(errmsg("pgraft: Log is full (%d unapplied entries)", log_size),
+				 errhint("Increase pgraft.log_buffer_size or pgraft.log_max_entries.")));
 		return -1;
 	}
 	
 	/* Add new entry */
-	entry = &state->entries[state->log_size];
+	if (state->log_size == 0)
+		state->first_index = state->last_index + 1;
+	
+	entry = &PGRAFT_LOG_ENTRIES(state)[(state->head + state->log_size) % state->max_entries];
 	entry->index = state->last_index + 1;
 	entry->term = term;
 	entry->timestamp = GetCurrentTimestamp();
+	entry->data_pos = state->arena_tail;
 	entry->data_size = data_size;
 	entry->committed = 0;
 	entry->applied = 0;
 	
-	if (data && data_size > 0)
-		memcpy(entry->data, data, data_size);
-	entry->data[data_size] = '\0';
+	if (data_size > 0)
+		pgraft_log_arena_write(state, state->arena_tail, data, data_size);
 	
+	state->arena_tail += (uint64) data_size;
 	state->log_size++;
 	state->last_index = entry->index;
+	index = entry->index;
 	
 	SpinLockRelease(&state->mutex);
 	
-	elog(DEBUG1, "pgraft: Appended entry %lld with term %lld", entry->index, term);
+	elog(DEBUG1, "pgraft: Appended entry %lld with term %lld", (long long) index, (long long) term);
 	return 0;
 }
 
@@ -138,7 +266,7 @@ int
 pgraft_log_commit_entry(int64_t index)
 {
 	pgraft_log_state_t *state;
-	int			i;
+	pgraft_log_entry_t *entry;
 	
 	state = pgraft_log_get_shared_memory();
 	if (!state)
@@ -149,23 +277,20 @@ pgraft_log_commit_entry(int64_t index)
 	
 	SpinLockAcquire(&state->mutex);
 	
-	/* Find and commit entry */
-	for (i = 0; i < state->log_size; i++)
+	entry = pgraft_log_lookup(state, index);
+	if (entry != NULL)
 	{
-		if (state->entries[i].index == index)
-		{
-			state->entries[i].committed = 1;
-			if (index > state->commit_index)
-				state->commit_index = index;
-			state->entries_committed++;
-			SpinLockRelease(&state->mutex);
-			elog(DEBUG1, "pgraft: Committed entry %lld", index);
-			return 0;
-		}
+		entry->committed = 1;
+		if (index > state->commit_index)
+			state->commit_index = index;
+		state->entries_committed++;
+		SpinLockRelease(&state->mutex);
+		elog(DEBUG1, "pgraft: Committed entry %lld", (long long) index);
+		return 0;
 	}
 	
 	SpinLockRelease(&state->mutex);
-	elog(WARNING, "pgraft: Entry %lld not found", index);
+	elog(WARNING, "pgraft: Entry %lld not found", (long long) index);
 	return -1;
 }
 
@@ -175,64 +300,94 @@ pgraft_log_commit_entry(int64_t index)
 int
 pgraft_log_apply_entry(int64_t index)
 {
-    pgraft_log_state_t *state = pgraft_log_get_shared_memory();
-    if (!state) {
-        elog(ERROR, "pgraft: Failed to get shared memory");
-        return -1;
-    }
-    
-    SpinLockAcquire(&state->mutex);
-    
-    /* Find and apply entry */
-    for (int i = 0; i < state->log_size; i++) {
-        if (state->entries[i].index == index) {
-            if (!state->entries[i].committed) {
-                SpinLockRelease(&state->mutex);
-			elog(WARNING, "pgraft: Cannot apply uncommitted entry %lld", index);
-                return -1;
-            }
-            
-            state->entries[i].applied = 1;
-            if (index > state->last_applied) {
-                state->last_applied = index;
-            }
-            state->entries_applied++;
-            SpinLockRelease(&state->mutex);
-			elog(DEBUG1, "pgraft: Applied entry %lld", index);
-            return 0;
-        }
-    }
-    
-    SpinLockRelease(&state->mutex);
-    elog(WARNING, "pgraft: Entry %lld not found", index);
-    return -1;
+	pgraft_log_state_t *state;
+	pgraft_log_entry_t *entry;
+	
+	state = pgraft_log_get_shared_memory();
+	if (!state)
+	{
+		elog(ERROR, "pgraft: Failed to get shared memory");
+		return -1;
+	}
+	
+	SpinLockAcquire(&state->mutex);
+	
+	entry = pgraft_log_lookup(state, index);
+	if (entry != NULL)
+	{
+		if (!entry->committed)
+		{
+			SpinLockRelease(&state->mutex);
+			elog(WARNING, "pgraft: Cannot apply uncommitted entry %lld", (long long) index);
+			return -1;
+		}
+		
+		entry->applied = 1;
+		if (index > state->last_applied)
+			state->last_applied = index;
+		state->entries_applied++;
+		SpinLockRelease(&state->mutex);
+		elog(DEBUG1, "pgraft: Applied entry %lld", (long long) index);
+		return 0;
+	}
+	
+	SpinLockRelease(&state->mutex);
+	elog(WARNING, "pgraft: Entry %lld not found", (long long) index);
+	return -1;
 }
 
 /*
  * Get log entry by index
+ *
+ * If data is not NULL, a palloc'd NUL-terminated copy of the payload is
+ * returned in it.  The payload is copied in a second pass so that no memory
+ * is allocated while holding the spinlock; if the entry was reclaimed in
+ * between, the lookup fails as if it had never been retained.
  */
 int
-pgraft_log_get_entry(int64_t index, pgraft_log_entry_t* entry)
+pgraft_log_get_entry(int64_t index, pgraft_log_entry_t *entry, char **data)
 {
-    pgraft_log_state_t *state = pgraft_log_get_shared_memory();
-    if (!state || !entry) {
-        elog(ERROR, "pgraft: Invalid parameters");
-        return -1;
-    }
-    
-    SpinLockAcquire(&state->mutex);
-    
-    /* Find entry */
-    for (int i = 0; i < state->log_size; i++) {
-        if (state->entries[i].index == index) {
-            *entry = state->entries[i];
-            SpinLockRelease(&state->mutex);
-            return 0;
-        }
-    }
-    
-    SpinLockRelease(&state->mutex);
-    return -1;
+	pgraft_log_state_t *state;
+	pgraft_log_entry_t *found;
+	char	   *buf;
+	
+	state = pgraft_log_get_shared_memory();
+	if (!state || !entry)
+	{
+		elog(ERROR, "pgraft: Invalid parameters");
+		return -1;
+	}
+	
+	SpinLockAcquire(&state->mutex);
+	found = pgraft_log_lookup(state, index);
+	if (found == NULL)
+	{
+		SpinLockRelease(&state->mutex);
+		return -1;
+	}
+	*entry = *found;
+	SpinLockRelease(&state->mutex);
+	
+	if (data == NULL)
+		return 0;
+	
+	buf = palloc(entry->data_size + 1);
+	
+	SpinLockAcquire(&state->mutex);
+	found = pgraft_log_lookup(state, index);
+	if (found == NULL || found->data_pos != entry->data_pos)
+	{
+		SpinLockRelease(&state->mutex);
+		pfree(buf);
+		return -1;
+	}
+	pgraft_log_arena_read(state, entry->data_pos, buf, entry->data_size);
+	*entry = *found;
+	SpinLockRelease(&state->mutex);
+	
+	buf[entry->data_size] = '\0';
+	*data = buf;
+	return 0;
 }
 
 /*
@@ -299,8 +454,8 @@ int
 pgraft_log_replicate_to_node(int32_t node_id, int64_t from_index)
 {
     pgraft_log_state_t *state;
-    int entries_to_replicate = 0;
-    int i;
+    int64_t entries_to_replicate = 0;
+    int64_t start;
     
     state = pgraft_log_get_shared_memory();
     if (!state) {
@@ -308,23 +463,22 @@ pgraft_log_replicate_to_node(int32_t node_id, int64_t from_index)
         return -1;
     }
     
-    elog(DEBUG1, "pgraft: Replicating to node %d from index %lld", node_id, from_index);
+    elog(DEBUG1, "pgraft: Replicating to node %d from index %lld", node_id, (long long) from_index);
     
     SpinLockAcquire(&state->mutex);
     
-    /* Find entries to replicate */
-    
-    for (i = 0; i < state->log_size; i++) {
-        if (state->entries[i].index >= from_index) {
-            entries_to_replicate++;
-        }
+    /* Entries are contiguous, so the count follows from the index range */
+    if (state->log_size > 0) {
+        start = Max(from_index, state->first_index);
+        if (start <= state->last_index)
+            entries_to_replicate = state->last_index - start + 1;
     }
     
     state->entries_replicated += entries_to_replicate;
     
     SpinLockRelease(&state->mutex);
     
-    elog(DEBUG1, "pgraft: Replicated %d entries to node %d", entries_to_replicate, node_id);
+    elog(DEBUG1, "pgraft: Replicated %lld entries to node %d", (long long) entries_to_replicate, node_id);
     return 0;
 }
 
@@ -394,11 +548,16 @@ pgraft_log_get_replication_status(char* status, size_t status_size)
     SpinLockAcquire(&state->mutex);
     
     snprintf(status, status_size, 
-             "Log Size: %d, Last Index: %lld, Commit Index: %lld, Last Applied: %lld, "
-             "Replicated: %lld, Committed: %lld, Applied: %lld, Errors: %lld",
-             state->log_size, state->last_index, state->commit_index, state->last_applied,
-             state->entries_replicated, state->entries_committed, 
-             state->entries_applied, state->replication_errors);
+             "Log Size: %d, First Index: %lld, Last Index: %lld, Commit Index: %lld, "
+             "Last Applied: %lld, Buffer Used: %llu/%llu, Replicated: %lld, Committed: %lld, "
+             "Applied: %lld, Reclaimed: %lld, Errors: %lld",
+             state->log_size, (long long) state->first_index, (long long) state->last_index,
+             (long long) state->commit_index, (long long) state->last_applied,
+             (unsigned long long) (state->arena_tail - state->arena_head),
+             (unsigned long long) state->arena_size,
+             (long long) state->entries_replicated, (long long) state->entries_committed,
+             (long long) state->entries_applied, (long long) state->entries_reclaimed,
+             (long long) state->replication_errors);
     
     SpinLockRelease(&state->mutex);
     
@@ -413,8 +572,6 @@ pgraft_log_cleanup_old_entries(int64_t before_index)
 {
     pgraft_log_state_t *state;
     int removed = 0;
-    int i;
-    int j;
     
     state = pgraft_log_get_shared_memory();
     if (!state) {
@@ -423,25 +580,67 @@ pgraft_log_cleanup_old_entries(int64_t before_index)
     
     SpinLockAcquire(&state->mutex);
     
-    for (i = 0; i < state->log_size; i++) {
-        if (state->entries[i].index < before_index) {
-            /* Shift remaining entries */
-            for (j = i; j < state->log_size - 1; j++) {
-                state->entries[j] = state->entries[j + 1];
-            }
-            state->log_size--;
-            removed++;
-            i--; /* Check the same index again */
-        }
+    /* Indexes are monotonic, so old entries are always at the ring head */
+    while (state->log_size > 0 && state->first_index < before_index) {
+        pgraft_log_pop_head(state);
+        removed++;
     }
     
     SpinLockRelease(&state->mutex);
     
     if (removed > 0) {
-		elog(INFO, "pgraft: Removed %d old entries before index %lld", removed, before_index);
+		elog(INFO, "pgraft: Removed %d old entries before index %lld", removed, (long long) before_index);
     }
 }
 
+/*
+ * Compact the log automatically
+ *
+ * Once more than max_entries entries are retained, or their payloads occupy
+ * more than max_size_kb (or three quarters of the arena, whichever is
+ * smaller), applied entries are dropped from the head, keeping the newest
+ * retain applied entries for followers that are only slightly behind.
+ * Unapplied entries are never dropped.  Returns the number of entries
+ * removed.
+ */
+int
+pgraft_log_compact(int32_t max_entries, int32_t max_size_kb, int32_t retain)
+{
+    pgraft_log_state_t *state;
+    uint64      size_limit;
+    int64_t     keep_from;
+    int         removed = 0;
+    
+    state = pgraft_log_get_shared_memory();
+    if (!state) {
+        return 0;
+    }
+    
+    SpinLockAcquire(&state->mutex);
+    
+    size_limit = Min((uint64) max_size_kb * 1024, state->arena_size / 4 * 3);
+    if (state->log_size <= max_entries &&
+        state->arena_tail - state->arena_head <= size_limit) {
+        SpinLockRelease(&state->mutex);
+        return 0;
+    }
+    
+    keep_from = state->last_applied - retain + 1;
+    while (state->log_size > 0 && state->first_index < keep_from) {
+        pgraft_log_pop_head(state);
+        removed++;
+    }
+    
+    SpinLockRelease(&state->mutex);
+    
+    if (removed > 0) {
+        elog(DEBUG1, "pgraft: Compacted %d applied entries before index %lld",
+             removed, (long long) keep_from);
+    }
+    
+    return removed;
+}
+
 /*
  * Reset log
  */
@@ -456,15 +655,144 @@ pgraft_log_reset(void)
     SpinLockAcquire(&state->mutex);
     
     state->log_size = 0;
+    state->first_index = 1;
     state->last_index = 0;
     state->commit_index = 0;
     state->last_applied = 0;
     state->entries_replicated = 0;
     state->entries_committed = 0;
     state->entries_applied = 0;
+    state->entries_reclaimed = 0;
     state->replication_errors = 0;
+    state->head = 0;
+    state->arena_head = 0;
+    state->arena_tail = 0;
     
     SpinLockRelease(&state->mutex);
     
     elog(INFO, "pgraft: Log reset completed");
 }
+
+/*
+ * Get the proposal waiter table, creating it on first use
+ */
+pgraft_proposal_state_t *
+pgraft_log_get_proposal_state(void)
+{
+	bool		found;
+
+	if (g_proposal_state == NULL)
+	{
+		g_proposal_state = (pgraft_proposal_state_t *) ShmemInitStruct("pgraft_proposal_state",
+																	   sizeof(pgraft_proposal_state_t),
+																	   &found);
+		if (!found)
+		{
+			memset(g_proposal_state, 0, sizeof(pgraft_proposal_state_t));
+			SpinLockInit(&g_proposal_state->mutex);
+			ConditionVariableInit(&g_proposal_state->cv);
+			g_proposal_state->next_id = 1;
+		}
+	}
+	return g_proposal_state;
+}
+
+/*
+ * Claim a proposal id whose result slot is free; returns 0 if all are busy
+ */
+uint64
+pgraft_log_register_proposal(void)
+{
+	pgraft_proposal_state_t *state = pgraft_log_get_proposal_state();
+	uint64		proposal_id = 0;
+
+	SpinLockAcquire(&state->mutex);
+	for (int i = 0; i < PGRAFT_GO_MAX_PROPOSALS; i++)
+	{
+		uint64		candidate = state->next_id++;
+
+		if (!state->in_use[candidate % PGRAFT_GO_MAX_PROPOSALS])
+		{
+			state->in_use[candidate % PGRAFT_GO_MAX_PROPOSALS] = true;
+			proposal_id = candidate;
+			break;
+		}
+	}
+	SpinLockRelease(&state->mutex);
+
+	return proposal_id;
+}
+
+/*
+ * Give a result slot back.  A late commit report for the old id is
+ * harmless: reports arrive in log order and a new owner waits for its own id.
+ */
+void
+pgraft_log_release_proposal(uint64 proposal_id)
+{
+	pgraft_proposal_state_t *state = pgraft_log_get_proposal_state();
+
+	SpinLockAcquire(&state->mutex);
+	state->in_use[proposal_id % PGRAFT_GO_MAX_PROPOSALS] = false;
+	SpinLockRelease(&state->mutex);
+}
+
+/*
+ * Report a proposal that never reached the Raft log (worker only)
+ */
+void
+pgraft_log_fail_proposal(uint64 proposal_id)
+{
+	pgraft_proposal_state_t *state = pgraft_log_get_proposal_state();
+	int			slot = (int) (proposal_id % PGRAFT_GO_MAX_PROPOSALS);
+
+	state->block.committed_index[slot] = -1;
+	pg_write_barrier();
+	state->block.committed_id[slot] = proposal_id;
+	ConditionVariableBroadcast(&state->cv);
+}
+
+/*
+ * Wait for a proposal to commit.  Returns the committed index, -1 if the
+ * proposal was rejected, or 0 on timeout.
+ */
+int64_t
+pgraft_log_wait_proposal(uint64 proposal_id, int timeout_ms)
+{
+	pgraft_proposal_state_t *state = pgraft_log_get_proposal_state();
+	volatile pgraft_go_proposal_block_t *block = &state->block;
+	int			slot = (int) (proposal_id % PGRAFT_GO_MAX_PROPOSALS);
+	TimestampTz start = GetCurrentTimestamp();
+	int64_t		result = 0;
+
+	ConditionVariablePrepareToSleep(&state->cv);
+	for (;;)
+	{
+		long		remaining;
+
+		if (block->committed_id[slot] == proposal_id)
+		{
+			pg_read_barrier();
+			result = block->committed_index[slot];
+			break;
+		}
+
+		remaining = timeout_ms - (long) (TimestampDifferenceMilliseconds(start, GetCurrentTimestamp()));
+		if (remaining <= 0)
+			break;
+
+		(void) ConditionVariableTimedSleep(&state->cv, remaining, PG_WAIT_EXTENSION);
+	}
+	ConditionVariableCancelSleep();
+
+	return result;
+}
+
+/*
+ * Wake every pgraft_replicate() waiter to recheck its slot (worker only)
+ */
+void
+pgraft_log_wake_proposal_waiters(void)
+{
+	ConditionVariableBroadcast(&pgraft_log_get_proposal_state()->cv);
+}
@@ -11,13 +11,25 @@
 #include "postgres.h"
 #include "fmgr.h"
 #include "utils/elog.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "access/htup_details.h"
 #include "access/tupdesc.h"
+#include "catalog/pg_type.h"
 #include "funcapi.h"
 #include "utils/typcache.h"
 #include "utils/tuplestore.h"
 #include "utils/guc.h"
+#include "utils/timestamp.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "storage/fd.h"
+#include "storage/latch.h"
+#include "port/pg_bswap.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../include/pgraft_sql.h"
 #include "../include/pgraft_core.h"
@@ -30,6 +42,7 @@
 PG_FUNCTION_INFO_V1(pgraft_init);
 PG_FUNCTION_INFO_V1(pgraft_init_guc);
 PG_FUNCTION_INFO_V1(pgraft_add_node);
+PG_FUNCTION_INFO_V1(pgraft_add_nodes);
 PG_FUNCTION_INFO_V1(pgraft_remove_node);
 PG_FUNCTION_INFO_V1(pgraft_get_cluster_status_table);
 PG_FUNCTION_INFO_V1(pgraft_get_leader);
@@ -38,6 +51,7 @@ PG_FUNCTION_INFO_V1(pgraft_is_leader);
 PG_FUNCTION_INFO_V1(pgraft_get_worker_state);
 PG_FUNCTION_INFO_V1(pgraft_get_queue_status);
 PG_FUNCTION_INFO_V1(pgraft_get_nodes_table);
+PG_FUNCTION_INFO_V1(pgraft_get_cluster_snapshot);
 PG_FUNCTION_INFO_V1(pgraft_get_version);
 PG_FUNCTION_INFO_V1(pgraft_test);
 PG_FUNCTION_INFO_V1(pgraft_set_debug);
@@ -46,12 +60,47 @@ PG_FUNCTION_INFO_V1(pgraft_set_debug);
 PG_FUNCTION_INFO_V1(pgraft_log_append);
 PG_FUNCTION_INFO_V1(pgraft_log_commit);
 PG_FUNCTION_INFO_V1(pgraft_log_apply);
+PG_FUNCTION_INFO_V1(pgraft_replicate);
+PG_FUNCTION_INFO_V1(pgraft_read_barrier);
+PG_FUNCTION_INFO_V1(pgraft_transfer_leadership);
+PG_FUNCTION_INFO_V1(pgraft_wait_leader_change);
+PG_FUNCTION_INFO_V1(pgraft_cpu_profile);
 PG_FUNCTION_INFO_V1(pgraft_log_get_entry_sql);
+PG_FUNCTION_INFO_V1(pgraft_log_entries);
 PG_FUNCTION_INFO_V1(pgraft_log_get_stats_table);
 PG_FUNCTION_INFO_V1(pgraft_log_get_replication_status_table);
 
 /* Background worker functions - removed as they are now handled automatically */
 PG_FUNCTION_INFO_V1(pgraft_log_sync_with_leader_sql);
+PG_FUNCTION_INFO_V1(pgraft_kv_put);
+PG_FUNCTION_INFO_V1(pgraft_kv_delete);
+PG_FUNCTION_INFO_V1(pgraft_kv_get);
+PG_FUNCTION_INFO_V1(pgraft_kv_revision);
+PG_FUNCTION_INFO_V1(pgraft_kv_watch);
+PG_FUNCTION_INFO_V1(pgraft_kv_lease_grant);
+PG_FUNCTION_INFO_V1(pgraft_kv_lease_keepalive);
+PG_FUNCTION_INFO_V1(pgraft_kv_lease_revoke);
+
+static int	pgraft_timeout_arg_ms(FunctionCallInfo fcinfo, int argno);
+static void pgraft_log_entries_read(const char *path, Tuplestorestate *tupstore,
+									TupleDesc tupdesc);
+
+/* Bounds on one page of pgraft_log_entries() */
+#define PGRAFT_LOG_ENTRIES_MAX_LIMIT	10000
+#define PGRAFT_LOG_ENTRIES_MAX_BYTES	(64 * 1024 * 1024)
+#define PGRAFT_LOG_ENTRIES_TIMEOUT_MS	10000
+
+/* Key-value store: a write must fit one command's log_data */
+#define PGRAFT_KV_MAX_KEY			256
+#define PGRAFT_KV_MAX_READ_LIMIT	100000
+#define PGRAFT_KV_READ_TIMEOUT_MS	10000	/* on top of a watch's own wait */
+
+static int64_t pgraft_kv_write(int op, text *key, const char *value, int value_len,
+							   int64 compare, int64 lease, int timeout_ms);
+static int64 pgraft_kv_read(FunctionCallInfo fcinfo, int mode, text *key, int64 after,
+							int limit, int timeout_ms, bool consistent);
+static bool pgraft_change_membership(const pgraft_go_peer_change_t *changes, int count,
+									 int timeout_ms);
 
 
 
@@ -96,61 +145,108 @@ pgraft_init_guc(PG_FUNCTION_ARGS)
 }
 
 /*
- * Add node to cluster
+ * Add node to cluster and wait until the configuration change is applied
+ * here.  With voting => false the node joins as a Raft learner: it
+ * receives the log but does not vote or count toward commit, which suits
+ * read replicas.  Returns false if the change was not applied in time.
  */
 Datum
 pgraft_add_node(PG_FUNCTION_ARGS)
 {
-	int32_t		node_id;
-	text	   *address_text;
-	int32_t		port;
+	pgraft_go_peer_change_t change;
 	char	   *address;
-	
-	node_id = PG_GETARG_INT32(0);
-	address_text = PG_GETARG_TEXT_PP(1);
-	port = PG_GETARG_INT32(2);
-	
-	address = text_to_cstring(address_text);
-	
-	elog(INFO, "pgraft: Queuing ADD_NODE command for node %d at %s:%d", node_id, address, port);
-	
-	/* Queue ADD_NODE command for worker to process */
-	if (!pgraft_queue_command(COMMAND_ADD_NODE, node_id, address, port, NULL)) {
-		elog(ERROR, "pgraft: Failed to queue ADD_NODE command");
-		PG_RETURN_BOOL(false);
+	bool		voting;
+
+	voting = PG_NARGS() < 4 || PG_ARGISNULL(3) || PG_GETARG_BOOL(3);
+	address = text_to_cstring(PG_GETARG_TEXT_PP(1));
+
+	memset(&change, 0, sizeof(change));
+	change.type = voting ? PGRAFT_GO_PEER_ADD_VOTER : PGRAFT_GO_PEER_ADD_LEARNER;
+	change.node_id = PG_GETARG_INT32(0);
+	change.port = PG_GETARG_INT32(2);
+	strlcpy(change.address, address, sizeof(change.address));
+
+	PG_RETURN_BOOL(pgraft_change_membership(&change, 1, pgraft_timeout_arg_ms(fcinfo, 4)));
+}
+
+/*
+ * Add several nodes in one configuration change, so the cluster moves
+ * through a single joint-consensus step instead of one change per node
+ */
+Datum
+pgraft_add_nodes(PG_FUNCTION_ARGS)
+{
+	ArrayType  *ids_array;
+	ArrayType  *addresses_array;
+	ArrayType  *ports_array;
+	Datum	   *ids;
+	Datum	   *addresses;
+	Datum	   *ports;
+	bool	   *ids_null;
+	bool	   *addresses_null;
+	bool	   *ports_null;
+	int			count;
+	int			address_count;
+	int			port_count;
+	bool		voting;
+	pgraft_go_peer_change_t *changes;
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1) || PG_ARGISNULL(2))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: node ids, addresses and ports must not be NULL")));
+
+	ids_array = PG_GETARG_ARRAYTYPE_P(0);
+	addresses_array = PG_GETARG_ARRAYTYPE_P(1);
+	ports_array = PG_GETARG_ARRAYTYPE_P(2);
+	voting = PG_ARGISNULL(3) || PG_GETARG_BOOL(3);
+
+	deconstruct_array(ids_array, INT4OID, sizeof(int32), true, TYPALIGN_INT,
+					  &ids, &ids_null, &count);
+	deconstruct_array(addresses_array, TEXTOID, -1, false, TYPALIGN_INT,
+					  &addresses, &addresses_null, &address_count);
+	deconstruct_array(ports_array, INT4OID, sizeof(int32), true, TYPALIGN_INT,
+					  &ports, &ports_null, &port_count);
+
+	if (count == 0 || count != address_count || count != port_count)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: need as many addresses and ports as node ids, and at least one")));
+	if (count > PGRAFT_MAX_NODES)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("pgraft: at most %d nodes can be added at once", PGRAFT_MAX_NODES)));
+
+	changes = (pgraft_go_peer_change_t *) palloc0(sizeof(pgraft_go_peer_change_t) * count);
+	for (int i = 0; i < count; i++)
+	{
+		if (ids_null[i] || addresses_null[i] || ports_null[i])
+			ereport(ERROR,
+					(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+					 errmsg("pgraft: node ids, addresses and ports must not be NULL")));
+		changes[i].type = voting ? PGRAFT_GO_PEER_ADD_VOTER : PGRAFT_GO_PEER_ADD_LEARNER;
+		changes[i].node_id = DatumGetInt32(ids[i]);
+		changes[i].port = DatumGetInt32(ports[i]);
+		strlcpy(changes[i].address, TextDatumGetCString(addresses[i]),
+				sizeof(changes[i].address));
 	}
-	
-	elog(INFO, "pgraft: ADD_NODE command queued successfully - background worker will process it");
-    PG_RETURN_BOOL(true);
+
+	PG_RETURN_BOOL(pgraft_change_membership(changes, count, pgraft_timeout_arg_ms(fcinfo, 4)));
 }
 
 /*
- * Remove node from cluster
+ * Remove node from cluster and wait until the change is applied here
  */
 Datum
 pgraft_remove_node(PG_FUNCTION_ARGS)
 {
-    int32_t node_id = PG_GETARG_INT32(0);
-    
-    elog(INFO, "pgraft: Removing node %d", node_id);
-    
-    /* Remove from core system */
-    if (pgraft_core_remove_node(node_id) != 0) {
-        elog(ERROR, "pgraft: Failed to remove node from core system");
-        PG_RETURN_BOOL(false);
-    }
-    
-    /* Remove from Go library if loaded */
-    if (pgraft_go_is_loaded()) {
-        pgraft_go_remove_peer_func remove_peer_func = pgraft_go_get_remove_peer_func();
-        if (remove_peer_func && remove_peer_func(node_id) != 0) {
-            elog(ERROR, "pgraft: Failed to remove node from Go library");
-            PG_RETURN_BOOL(false);
-        }
-    }
-    
-    elog(INFO, "pgraft: Node removed successfully");
-    PG_RETURN_BOOL(true);
+	pgraft_go_peer_change_t change;
+
+	memset(&change, 0, sizeof(change));
+	change.type = PGRAFT_GO_PEER_REMOVE;
+	change.node_id = PG_GETARG_INT32(0);
+
+	PG_RETURN_BOOL(pgraft_change_membership(&change, 1, pgraft_timeout_arg_ms(fcinfo, 1)));
 }
 
 
@@ -199,31 +295,13 @@ pgraft_get_cluster_status_table(PG_FUNCTION_ARGS)
 Datum
 pgraft_get_leader(PG_FUNCTION_ARGS)
 {
-	pgraft_go_get_leader_func get_leader_func;
-	int64_t leader_id = -1;
-	
-	elog(INFO, "pgraft: pgraft_get_leader() function called");
-	
-	/* Try to get leader from Go library if available */
-	if (pgraft_go_is_loaded())
-	{
-		get_leader_func = pgraft_go_get_get_leader_func();
-		if (get_leader_func)
-		{
-			leader_id = get_leader_func();
-			elog(INFO, "pgraft: Got leader ID from Go library: %lld", (long long)leader_id);
-		}
-		else
-		{
-			elog(WARNING, "pgraft: Failed to get Go leader function");
-		}
-	}
-	else
-	{
-		elog(WARNING, "pgraft: Go library not loaded");
-	}
-	
-	PG_RETURN_INT64(leader_id);
+	pgraft_go_raft_status_t status;
+
+	/* Called per pooler checkout: read the seqlock block, no cgo, no spam */
+	if (!pgraft_state_read_raft_status(&status))
+		PG_RETURN_INT64(-1);
+
+	PG_RETURN_INT64(status.leader_id);
 }
 
 /*
@@ -232,31 +310,12 @@ pgraft_get_leader(PG_FUNCTION_ARGS)
 Datum
 pgraft_get_term(PG_FUNCTION_ARGS)
 {
-	pgraft_go_get_term_func get_term_func;
-	int32_t term = 0;
-	
-	elog(INFO, "pgraft: pgraft_get_term() function called");
-	
-	/* Try to get term from Go library if available */
-	if (pgraft_go_is_loaded())
-	{
-		get_term_func = pgraft_go_get_get_term_func();
-		if (get_term_func)
-		{
-			term = get_term_func();
-			elog(INFO, "pgraft: Got term from Go library: %d", term);
-		}
-		else
-		{
-			elog(WARNING, "pgraft: Failed to get Go term function");
-		}
-	}
-	else
-	{
-		elog(WARNING, "pgraft: Go library not loaded");
-	}
-	
-	PG_RETURN_INT32(term);
+	pgraft_go_raft_status_t status;
+
+	if (!pgraft_state_read_raft_status(&status))
+		PG_RETURN_INT32(0);
+
+	PG_RETURN_INT32((int32) status.term);
 }
 
 /*
@@ -265,31 +324,12 @@ pgraft_get_term(PG_FUNCTION_ARGS)
 Datum
 pgraft_is_leader(PG_FUNCTION_ARGS)
 {
-	pgraft_go_is_leader_func is_leader_func;
-	bool is_leader = false;
-	
-	elog(INFO, "pgraft: pgraft_is_leader() function called");
-	
-	/* Try to get leader status from Go library if available */
-	if (pgraft_go_is_loaded())
-	{
-		is_leader_func = pgraft_go_get_is_leader_func();
-		if (is_leader_func)
-		{
-			is_leader = (is_leader_func() != 0);
-			elog(INFO, "pgraft: Got leader status from Go library: %s", is_leader ? "true" : "false");
-		}
-		else
-		{
-			elog(WARNING, "pgraft: Failed to get Go is_leader function");
-		}
-	}
-	else
-	{
-		elog(WARNING, "pgraft: Go library not loaded");
-	}
-	
-	PG_RETURN_BOOL(is_leader);
+	pgraft_go_raft_status_t status;
+
+	if (!pgraft_state_read_raft_status(&status))
+		PG_RETURN_BOOL(false);
+
+	PG_RETURN_BOOL(status.is_leader != 0);
 }
 
 /*
@@ -380,6 +420,90 @@ pgraft_get_nodes_table(PG_FUNCTION_ARGS)
     PG_RETURN_NULL();
 }
 
+/*
+ * Whole cluster view from one shared memory copy: one row per member with
+ * its replication progress, the cluster-wide columns repeated on each row.
+ * Without members a single row carries the cluster columns alone.  Nothing
+ * here calls into Go, so any backend can poll it cheaply.
+ */
+#define PGRAFT_SNAPSHOT_COLUMNS 17
+
+Datum
+pgraft_get_cluster_snapshot(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	pgraft_go_state_t snap;
+	Datum		values[PGRAFT_SNAPSHOT_COLUMNS];
+	bool		nulls[PGRAFT_SNAPSHOT_COLUMNS];
+	int			num_nodes;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	pgraft_state_get_snapshot(&snap);
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(snap.go_leader_id);
+	values[1] = Int64GetDatum(snap.go_current_term);
+	values[2] = Int64GetDatum(snap.go_commit_index);
+	values[3] = Int64GetDatum(snap.go_last_applied);
+	values[4] = Int64GetDatum(snap.go_last_index);
+	values[5] = CStringGetTextDatum(snap.go_raft_state);
+	values[6] = Int32GetDatum(snap.go_node_id);
+	values[7] = BoolGetDatum(snap.go_leader_id > 0 && snap.go_leader_id == snap.go_node_id);
+	values[8] = TimestampTzGetDatum(snap.go_status_published_at);
+	nulls[8] = snap.go_status_published_at == 0;
+
+	num_nodes = Min(snap.num_nodes, PGRAFT_MAX_NODES);
+	if (num_nodes == 0)
+	{
+		for (int c = 9; c < PGRAFT_SNAPSHOT_COLUMNS; c++)
+			nulls[c] = true;
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		return (Datum) 0;
+	}
+
+	for (int i = 0; i < num_nodes; i++)
+	{
+		const char *progress = pgraft_state_progress_name(snap.node_progress_state[i]);
+
+		values[9] = Int32GetDatum(snap.node_ids[i]);
+		values[10] = CStringGetTextDatum(snap.node_addresses[i]);
+		values[11] = Int32GetDatum(snap.node_ports[i]);
+		values[12] = BoolGetDatum(snap.node_ids[i] == snap.go_leader_id);
+		values[13] = Int64GetDatum(snap.node_match_index[i]);
+		nulls[13] = snap.node_match_index[i] < 0;
+		values[14] = Int64GetDatum(snap.node_next_index[i]);
+		nulls[14] = snap.node_next_index[i] < 0;
+		values[15] = progress ? CStringGetTextDatum(progress) : (Datum) 0;
+		nulls[15] = progress == NULL;
+		values[16] = BoolGetDatum(snap.node_voting[i]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
 /*
  * Get pgraft version
  */
@@ -505,6 +629,375 @@ pgraft_log_apply(PG_FUNCTION_ARGS)
     PG_RETURN_BOOL(true);
 }
 
+/*
+ * Timeout argument in milliseconds, 5 seconds if NULL
+ */
+static int
+pgraft_timeout_arg_ms(FunctionCallInfo fcinfo, int argno)
+{
+	Interval   *timeout;
+	int64		timeout_usec;
+
+	if (PG_ARGISNULL(argno))
+		return 5000;
+
+	timeout = PG_GETARG_INTERVAL_P(argno);
+	timeout_usec = timeout->time +
+		((int64) timeout->month * DAYS_PER_MONTH + timeout->day) * USECS_PER_DAY;
+	if (timeout_usec <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: timeout must be positive")));
+	return (int) Min(timeout_usec / 1000, (int64) PG_INT32_MAX);
+}
+
+/*
+ * Hand a proposal or read barrier to the worker under a fresh waiter id
+ * and optionally wait for its result.  Returns the log index, -1 if Raft
+ * rejected it, 0 on timeout or when not waiting.
+ */
+static int64_t
+pgraft_submit_and_wait(COMMAND_TYPE type, const char *data, int data_len,
+					   bool wait, int timeout_ms)
+{
+	pgraft_go_raft_status_t raft_status;
+	uint64		proposal_id;
+	int64_t		result = 0;
+
+	/* Go publishes a status once its Ready loop runs, and -1 after stop */
+	if (!pgraft_state_read_raft_status(&raft_status) || raft_status.leader_id < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pgraft: Raft is not running on this node")));
+
+	proposal_id = pgraft_log_register_proposal();
+	if (proposal_id == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+				 errmsg("pgraft: too many requests waiting on Raft")));
+
+	PG_TRY();
+	{
+		if (!pgraft_queue_proposal_command(type, data, data_len, proposal_id))
+			ereport(ERROR,
+					(errmsg("pgraft: Failed to queue command %d", type)));
+
+		if (wait)
+			result = pgraft_log_wait_proposal(proposal_id, timeout_ms);
+	}
+	PG_CATCH();
+	{
+		pgraft_log_release_proposal(proposal_id);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	pgraft_log_release_proposal(proposal_id);
+	return result;
+}
+
+/*
+ * Hand membership changes to the worker and wait for Go to report them
+ * applied on this node.  Raft rejects a change while another is still in
+ * flight; that, or a change lost with its leader, shows up as a timeout.
+ */
+static bool
+pgraft_change_membership(const pgraft_go_peer_change_t *changes, int count, int timeout_ms)
+{
+	pgraft_go_raft_status_t raft_status;
+	uint64		proposal_id;
+	int64_t		result = 0;
+
+	if (!pgraft_state_read_raft_status(&raft_status) || raft_status.leader_id < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pgraft: Raft is not running on this node")));
+
+	proposal_id = pgraft_log_register_proposal();
+	if (proposal_id == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+				 errmsg("pgraft: too many requests waiting on Raft")));
+
+	PG_TRY();
+	{
+		if (!pgraft_queue_peer_changes(changes, count, proposal_id))
+			ereport(ERROR,
+					(errmsg("pgraft: Failed to queue membership change"),
+					 errhint("The command queue may be full, or the addresses too long for one change.")));
+
+		result = pgraft_log_wait_proposal(proposal_id, timeout_ms);
+	}
+	PG_CATCH();
+	{
+		pgraft_log_release_proposal(proposal_id);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	pgraft_log_release_proposal(proposal_id);
+
+	if (result < 0)
+		ereport(ERROR,
+				(errmsg("pgraft: Raft did not accept the membership change")));
+	if (result == 0)
+	{
+		ereport(WARNING,
+				(errmsg("pgraft: membership change was not applied within %d ms", timeout_ms)));
+		return false;
+	}
+
+	elog(LOG, "pgraft: %d membership change(s) applied at index " INT64_FORMAT,
+		 count, result);
+	return true;
+}
+
+/*
+ * Propose data through Raft and, if asked, wait until the quorum commits
+ * it.  Returns the committed log index, or NULL when not waiting.
+ */
+Datum
+pgraft_replicate(PG_FUNCTION_ARGS)
+{
+	bytea	   *data;
+	bool		wait_commit;
+	int			timeout_ms;
+	int64_t		committed_index;
+
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: data must not be NULL")));
+
+	data = PG_GETARG_BYTEA_PP(0);
+	wait_commit = PG_ARGISNULL(1) ? true : PG_GETARG_BOOL(1);
+	timeout_ms = pgraft_timeout_arg_ms(fcinfo, 2);
+
+	if (VARSIZE_ANY_EXHDR(data) > PGRAFT_REPLICATE_MAX_DATA)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("pgraft: replicated data is limited to %d bytes",
+						PGRAFT_REPLICATE_MAX_DATA)));
+
+	committed_index = pgraft_submit_and_wait(COMMAND_REPLICATE, VARDATA_ANY(data),
+											 (int) VARSIZE_ANY_EXHDR(data),
+											 wait_commit, timeout_ms);
+	if (!wait_commit)
+		PG_RETURN_NULL();
+
+	if (committed_index < 0)
+		ereport(ERROR,
+				(errmsg("pgraft: proposal was rejected by the Raft node")));
+	if (committed_index == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_QUERY_CANCELED),
+				 errmsg("pgraft: entry was not committed within %d ms", timeout_ms),
+				 errdetail("The entry may still commit later.")));
+
+	PG_RETURN_INT64(committed_index);
+}
+
+/*
+ * Linearizable read barrier: confirm leadership with a ReadIndex request
+ * and wait until the confirmed commit index is applied on this node.
+ * State read afterwards is at least as new as anything committed before
+ * the call.  Returns that index.
+ */
+Datum
+pgraft_read_barrier(PG_FUNCTION_ARGS)
+{
+	int			timeout_ms = pgraft_timeout_arg_ms(fcinfo, 0);
+	int64_t		read_index;
+
+	read_index = pgraft_submit_and_wait(COMMAND_READ_INDEX, NULL, 0, true, timeout_ms);
+
+	if (read_index < 0)
+		ereport(ERROR,
+				(errmsg("pgraft: read index request was rejected by the Raft node")));
+	if (read_index == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_QUERY_CANCELED),
+				 errmsg("pgraft: read index not confirmed within %d ms", timeout_ms),
+				 errhint("A node that cannot reach a leader cannot serve linearizable reads.")));
+
+	PG_RETURN_INT64(read_index);
+}
+
+/*
+ * Move Raft leadership to target_node, typically the PostgreSQL promotion
+ * target of a planned switchover.  The leader catches the target up and
+ * tells it to campaign immediately, so the handover takes about one
+ * election round instead of a failure-detection timeout.  Waits until the
+ * target is reported as leader; returns false on timeout.
+ */
+Datum
+pgraft_transfer_leadership(PG_FUNCTION_ARGS)
+{
+	int32		target_node = PG_GETARG_INT32(0);
+	int			timeout_ms = pgraft_timeout_arg_ms(fcinfo, 1);
+	pgraft_go_raft_status_t raft_status;
+	TimestampTz start;
+
+	if (target_node <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: invalid target node %d", target_node)));
+
+	if (!pgraft_state_read_raft_status(&raft_status) || raft_status.leader_id < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pgraft: Raft is not running on this node")));
+
+	if (raft_status.leader_id == target_node)
+		PG_RETURN_BOOL(true);
+
+	if (!pgraft_queue_command(COMMAND_TRANSFER_LEADERSHIP, target_node, NULL, 0, NULL))
+		ereport(ERROR,
+				(errmsg("pgraft: Failed to queue TRANSFER_LEADERSHIP command")));
+
+	/* The status block is republished on every Ready, so poll it */
+	start = GetCurrentTimestamp();
+	for (;;)
+	{
+		if (pgraft_state_read_raft_status(&raft_status) &&
+			raft_status.leader_id == target_node)
+			PG_RETURN_BOOL(true);
+
+		if (TimestampDifferenceExceeds(start, GetCurrentTimestamp(), timeout_ms))
+			break;
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 10, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	ereport(WARNING,
+			(errmsg("pgraft: node %d did not become leader within %d ms",
+					target_node, timeout_ms)));
+	PG_RETURN_BOOL(false);
+}
+
+/*
+ * Block until the Raft leader or term differs from the ones the caller
+ * knows, or the timeout passes, and return the current pair either way.
+ * The worker wakes waiters as soon as Go publishes the change, so a
+ * client looping on this hears of an election without polling for it.
+ */
+Datum
+pgraft_wait_leader_change(PG_FUNCTION_ARGS)
+{
+	int64		known_leader = PG_ARGISNULL(0) ? -1 : PG_GETARG_INT64(0);
+	int64		known_term = PG_ARGISNULL(1) ? -1 : PG_GETARG_INT64(1);
+	int			timeout_ms = pgraft_timeout_arg_ms(fcinfo, 2);
+	pgraft_go_raft_status_t raft_status;
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3];
+	bool		changed;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "pgraft: Return type must be a row type");
+
+	changed = pgraft_state_wait_leader_change(known_leader, known_term, timeout_ms,
+											  &raft_status);
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(raft_status.leader_id);
+	values[1] = Int64GetDatum(raft_status.term);
+	values[2] = BoolGetDatum(changed);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/* Read a whole file into a bytea; NULL if it cannot be opened */
+static bytea *
+pgraft_read_file_bytea(const char *path)
+{
+	struct stat st;
+	bytea	   *result;
+	ssize_t		got;
+	size_t		done = 0;
+	int			fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	result = (bytea *) palloc(VARHDRSZ + st.st_size);
+	while (done < (size_t) st.st_size)
+	{
+		got = read(fd, VARDATA(result) + done, (size_t) st.st_size - done);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;
+		done += (size_t) got;
+	}
+	close(fd);
+	SET_VARSIZE(result, VARHDRSZ + done);
+	return result;
+}
+
+/*
+ * CPU profile of the Go Raft runtime in the background worker, taken with
+ * runtime/pprof for the given number of seconds and returned in pprof's
+ * format for "go tool pprof".  Blocks for the duration.
+ */
+Datum
+pgraft_cpu_profile(PG_FUNCTION_ARGS)
+{
+	int32		seconds = PG_ARGISNULL(0) ? 10 : PG_GETARG_INT32(0);
+	char		path[MAXPGPATH];
+	bytea	   *profile;
+	TimestampTz start;
+
+	if (seconds <= 0 || seconds > 60)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: profile duration must be between 1 and 60 seconds")));
+
+	snprintf(path, sizeof(path), "%s/pgraft/%s", DataDir, PGRAFT_GO_CPU_PROFILE_FILE);
+	if (unlink(path) != 0 && errno != ENOENT)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not remove old profile \"%s\": %m", path)));
+
+	if (!pgraft_queue_command(COMMAND_CPU_PROFILE, seconds, path, 0, NULL))
+		ereport(ERROR,
+				(errmsg("pgraft: Failed to queue CPU_PROFILE command")));
+
+	/* The Go side renames the finished profile into place */
+	start = GetCurrentTimestamp();
+	for (;;)
+	{
+		if (access(path, R_OK) == 0)
+			break;
+
+		if (TimestampDifferenceExceeds(start, GetCurrentTimestamp(), (seconds + 10) * 1000))
+			ereport(ERROR,
+					(errmsg("pgraft: CPU profile did not finish within %d seconds",
+							seconds + 10),
+					 errhint("Another profile may be running, or the Go library is not loaded.")));
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 100, PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	profile = pgraft_read_file_bytea(path);
+	if (!profile)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not read profile \"%s\": %m", path)));
+	PG_RETURN_BYTEA_P(profile);
+}
+
 /*
  * Get log entry
  */
@@ -513,22 +1006,189 @@ pgraft_log_get_entry_sql(PG_FUNCTION_ARGS)
 {
     int64_t index = PG_GETARG_INT64(0);
     pgraft_log_entry_t entry;
+    char *data;
     StringInfoData result;
     
-    if (pgraft_log_get_entry(index, &entry) != 0) {
-        elog(ERROR, "pgraft: Failed to get log entry %lld", index);
+    if (pgraft_log_get_entry(index, &entry, &data) != 0) {
+        elog(ERROR, "pgraft: Failed to get log entry %lld", (long long) index);
         PG_RETURN_NULL();
     }
     initStringInfo(&result);
     
     appendStringInfo(&result, "Index: %lld, Term: %lld, Timestamp: %lld, Data: %s, Committed: %s, Applied: %s",
-                    entry.index, entry.term, entry.timestamp, entry.data,
+                    (long long) entry.index, (long long) entry.term, (long long) entry.timestamp, data,
                     entry.committed ? "yes" : "no", entry.applied ? "yes" : "no");
     
     PG_RETURN_TEXT_P(cstring_to_text(result.data));
 }
 
 
+/*
+ * Page through the Raft log: up to max_entries entries from from_index on
+ * (the oldest retained entry if earlier), stopping early past
+ * PGRAFT_LOG_ENTRIES_MAX_BYTES of data.  The next page starts after the
+ * last log_index returned.  The worker's Go runtime writes the page to a
+ * file that is read back a record at a time, so neither side holds the
+ * whole log in memory.
+ */
+Datum
+pgraft_log_entries(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int64		from_index = PG_ARGISNULL(0) ? 0 : PG_GETARG_INT64(0);
+	int32		max_entries = PG_ARGISNULL(1) ? 100 : PG_GETARG_INT32(1);
+	pgraft_go_raft_status_t raft_status;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext oldcontext;
+	char		path[MAXPGPATH];
+	uint64		proposal_id;
+	int64_t		result = 0;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (from_index < 0)
+		from_index = 0;
+	if (max_entries <= 0 || max_entries > PGRAFT_LOG_ENTRIES_MAX_LIMIT)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: max_entries must be between 1 and %d",
+						PGRAFT_LOG_ENTRIES_MAX_LIMIT)));
+
+	if (!pgraft_state_read_raft_status(&raft_status) || raft_status.leader_id < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pgraft: Raft is not running on this node")));
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	proposal_id = pgraft_log_register_proposal();
+	if (proposal_id == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+				 errmsg("pgraft: too many requests waiting on Raft")));
+
+	/* Named after the request, so a page written too late is never read */
+	snprintf(path, sizeof(path), "%s/pgraft/%s." UINT64_FORMAT, DataDir,
+			 PGRAFT_GO_LOG_ENTRIES_FILE, proposal_id);
+
+	PG_TRY();
+	{
+		if (!pgraft_queue_log_entries((uint64) from_index, max_entries,
+									  PGRAFT_LOG_ENTRIES_MAX_BYTES, path, proposal_id))
+			ereport(ERROR,
+					(errmsg("pgraft: Failed to queue LOG_ENTRIES command")));
+
+		result = pgraft_log_wait_proposal(proposal_id, PGRAFT_LOG_ENTRIES_TIMEOUT_MS);
+		if (result < 0)
+			ereport(ERROR,
+					(errmsg("pgraft: could not read the Raft log"),
+					 errhint("See the server log for the Go runtime's error.")));
+		if (result == 0)
+			ereport(ERROR,
+					(errmsg("pgraft: Raft log entries were not read within %d ms",
+							PGRAFT_LOG_ENTRIES_TIMEOUT_MS)));
+
+		pgraft_log_entries_read(path, tupstore, tupdesc);
+	}
+	PG_CATCH();
+	{
+		pgraft_log_release_proposal(proposal_id);
+		(void) unlink(path);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	pgraft_log_release_proposal(proposal_id);
+	(void) unlink(path);
+	return (Datum) 0;
+}
+
+/*
+ * Turn a page written by pgraft_go_dump_log_entries() into rows, one
+ * record in memory at a time
+ */
+static void
+pgraft_log_entries_read(const char *path, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	unsigned char header[PGRAFT_GO_LOG_RECORD_HEADER];
+	FILE	   *file;
+
+	file = AllocateFile(path, PG_BINARY_R);
+	if (file == NULL)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not open \"%s\": %m", path)));
+
+	while (fread(header, 1, sizeof(header), file) == sizeof(header))
+	{
+		uint64		index;
+		uint64		term;
+		uint32		len;
+		bytea	   *data;
+		const char *type;
+		Datum		values[5];
+		bool		nulls[5];
+
+		memcpy(&index, header, 8);
+		memcpy(&term, header + 8, 8);
+		memcpy(&len, header + 18, 4);
+		index = pg_ntoh64(index);
+		term = pg_ntoh64(term);
+		len = pg_ntoh32(len);
+
+		switch (header[16])
+		{
+			case PGRAFT_GO_LOG_ENTRY_NORMAL:
+				type = "normal";
+				break;
+			case PGRAFT_GO_LOG_ENTRY_CONF_CHANGE:
+				type = "conf_change";
+				break;
+			case PGRAFT_GO_LOG_ENTRY_CONF_CHANGE_V2:
+				type = "conf_change_v2";
+				break;
+			default:
+				type = "unknown";
+				break;
+		}
+
+		data = (bytea *) palloc(VARHDRSZ + len);
+		if (fread(VARDATA(data), 1, len, file) != len)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("pgraft: Raft log page \"%s\" ends inside entry " UINT64_FORMAT,
+							path, index)));
+		SET_VARSIZE(data, VARHDRSZ + len);
+
+		memset(nulls, 0, sizeof(nulls));
+		values[0] = Int64GetDatum((int64) index);
+		values[1] = Int64GetDatum((int64) term);
+		values[2] = CStringGetTextDatum(type);
+		values[3] = BoolGetDatum(header[17] != 0);
+		values[4] = PointerGetDatum(data);
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		pfree(DatumGetPointer(values[2]));
+		pfree(data);
+	}
+
+	if (ferror(file))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("pgraft: could not read \"%s\": %m", path)));
+	FreeFile(file);
+}
+
 /*
  * Get log statistics as table with individual columns
  */
@@ -620,7 +1280,8 @@ pgraft_get_queue_status(PG_FUNCTION_ARGS)
 	Tuplestorestate *tupstore;
 	MemoryContext per_query_mcxt;
 	MemoryContext oldcontext;
-	pgraft_worker_state_t *state;
+	pgraft_command_t *history;
+	int			count;
 
 	/* Check to ensure we were called as a set-returning function */
 	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
@@ -643,18 +1304,17 @@ pgraft_get_queue_status(PG_FUNCTION_ARGS)
 
 	MemoryContextSwitchTo(oldcontext);
 
-	/* Get worker state */
-	state = pgraft_worker_get_state();
-	if (state != NULL && state->status_count > 0)
+	/* Copy the history out of shared memory, then build rows without the lock */
+	history = (pgraft_command_t *) palloc(sizeof(pgraft_command_t) * MAX_COMMANDS);
+	count = pgraft_get_command_history(history, MAX_COMMANDS);
+	if (count > 0)
 	{
 		int			position = 0;
 		int			i;
 
-		/* Iterate through status commands */
-		for (i = 0; i < state->status_count; i++)
+		for (i = 0; i < count; i++)
 		{
-			int index = (state->status_head + i) % MAX_COMMANDS;
-			pgraft_command_t *cmd = &state->status_commands[index];
+			pgraft_command_t *cmd = &history[i];
 			Datum		values[6];
 			bool		nulls[6];
 
@@ -671,6 +1331,8 @@ pgraft_get_queue_status(PG_FUNCTION_ARGS)
 		}
 	}
 
+	pfree(history);
+
 	/* Clean up and return the tuplestore */
 	/* tuplestore_donestoring not needed when using SFRM_Materialize */
 
@@ -695,3 +1357,430 @@ pgraft_log_sync_with_leader_sql(PG_FUNCTION_ARGS)
 
 
 /* Network worker functions removed - handled automatically by background worker */
+
+
+/*
+ * Encode a key-value write, propose it and wait for its outcome: the new
+ * revision or lease id, or PGRAFT_GO_KV_FAILED.  Errors out if Raft
+ * rejected the write or it was not applied in time.
+ */
+static int64_t
+pgraft_kv_write(int op, text *key, const char *value, int value_len, int64 compare,
+				int64 lease, int timeout_ms)
+{
+	char		buf[PGRAFT_REPLICATE_MAX_DATA];
+	int			key_len = key ? (int) VARSIZE_ANY_EXHDR(key) : 0;
+	uint16		key_len16;
+	uint32		value_len32;
+	uint64		compare64;
+	uint64		lease64;
+	int64_t		result;
+
+	if (key_len > PGRAFT_KV_MAX_KEY)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("pgraft: keys are limited to %d bytes", PGRAFT_KV_MAX_KEY)));
+	if (PGRAFT_GO_KV_OP_HEADER + key_len + value_len > PGRAFT_REPLICATE_MAX_DATA)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("pgraft: key and value are limited to %d bytes together",
+						PGRAFT_REPLICATE_MAX_DATA - PGRAFT_GO_KV_OP_HEADER)));
+
+	key_len16 = pg_hton16((uint16) key_len);
+	value_len32 = pg_hton32((uint32) value_len);
+	compare64 = pg_hton64((uint64) compare);
+	lease64 = pg_hton64((uint64) lease);
+	buf[0] = (char) op;
+	buf[1] = 0;
+	memcpy(buf + 2, &key_len16, 2);
+	memcpy(buf + 4, &value_len32, 4);
+	memcpy(buf + 8, &compare64, 8);
+	memcpy(buf + 16, &lease64, 8);
+	if (key_len > 0)
+		memcpy(buf + PGRAFT_GO_KV_OP_HEADER, VARDATA_ANY(key), key_len);
+	if (value_len > 0)
+		memcpy(buf + PGRAFT_GO_KV_OP_HEADER + key_len, value, value_len);
+
+	result = pgraft_submit_and_wait(COMMAND_KV_WRITE, buf,
+									PGRAFT_GO_KV_OP_HEADER + key_len + value_len,
+									true, timeout_ms);
+	if (result < 0 && result != PGRAFT_GO_KV_FAILED)
+		ereport(ERROR,
+				(errmsg("pgraft: key-value write was rejected by the Raft node")));
+	if (result == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_QUERY_CANCELED),
+				 errmsg("pgraft: key-value write was not applied within %d ms", timeout_ms),
+				 errdetail("The write may still be applied later.")));
+	return result;
+}
+
+static text *
+pgraft_kv_key_arg(FunctionCallInfo fcinfo, int argno)
+{
+	text	   *key;
+
+	if (PG_ARGISNULL(argno))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: key must not be NULL")));
+	key = PG_GETARG_TEXT_PP(argno);
+	if (VARSIZE_ANY_EXHDR(key) == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: key must not be empty")));
+	return key;
+}
+
+/*
+ * Set key to value, optionally only if the key's mod_revision is
+ * expected_revision (0: only if the key does not exist) and attached to a
+ * lease.  Returns the revision of the write, NULL if the compare failed or
+ * the lease does not exist.
+ */
+Datum
+pgraft_kv_put(PG_FUNCTION_ARGS)
+{
+	text	   *key = pgraft_kv_key_arg(fcinfo, 0);
+	bytea	   *value;
+	int64		compare = PG_ARGISNULL(2) ? PGRAFT_GO_KV_NO_COMPARE : PG_GETARG_INT64(2);
+	int64		lease = PG_ARGISNULL(3) ? 0 : PG_GETARG_INT64(3);
+	int64_t		revision;
+
+	if (PG_ARGISNULL(1))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: value must not be NULL")));
+	if (compare < 0 && compare != PGRAFT_GO_KV_NO_COMPARE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: expected_revision must not be negative")));
+	value = PG_GETARG_BYTEA_PP(1);
+
+	revision = pgraft_kv_write(PGRAFT_GO_KV_PUT, key, VARDATA_ANY(value),
+							   (int) VARSIZE_ANY_EXHDR(value), compare, lease,
+							   pgraft_timeout_arg_ms(fcinfo, 4));
+	if (revision == PGRAFT_GO_KV_FAILED)
+		PG_RETURN_NULL();
+	PG_RETURN_INT64(revision);
+}
+
+/*
+ * Delete key, or every key under it with prefix, optionally only if its
+ * mod_revision is expected_revision.  Returns the revision of the delete,
+ * NULL if nothing was deleted.
+ */
+Datum
+pgraft_kv_delete(PG_FUNCTION_ARGS)
+{
+	text	   *key = pgraft_kv_key_arg(fcinfo, 0);
+	int64		compare = PG_ARGISNULL(1) ? PGRAFT_GO_KV_NO_COMPARE : PG_GETARG_INT64(1);
+	bool		prefix = PG_ARGISNULL(2) ? false : PG_GETARG_BOOL(2);
+	int64_t		revision;
+
+	if (prefix && compare != PGRAFT_GO_KV_NO_COMPARE)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: expected_revision cannot be combined with prefix")));
+
+	revision = pgraft_kv_write(prefix ? PGRAFT_GO_KV_DELETE_PREFIX : PGRAFT_GO_KV_DELETE,
+							   key, NULL, 0, compare, 0, pgraft_timeout_arg_ms(fcinfo, 3));
+	if (revision == PGRAFT_GO_KV_FAILED)
+		PG_RETURN_NULL();
+	PG_RETURN_INT64(revision);
+}
+
+/* A lease that holds its keys until ttl passes without a keepalive */
+Datum
+pgraft_kv_lease_grant(PG_FUNCTION_ARGS)
+{
+	int			ttl_ms = pgraft_timeout_arg_ms(fcinfo, 0);
+
+	PG_RETURN_INT64(pgraft_kv_write(PGRAFT_GO_KV_LEASE_GRANT, NULL, NULL, 0, ttl_ms, 0,
+									pgraft_timeout_arg_ms(fcinfo, 1)));
+}
+
+/* Renew a lease for its TTL; false if it has expired or was revoked */
+Datum
+pgraft_kv_lease_keepalive(PG_FUNCTION_ARGS)
+{
+	int64		lease = PG_GETARG_INT64(0);
+
+	PG_RETURN_BOOL(pgraft_kv_write(PGRAFT_GO_KV_LEASE_KEEPALIVE, NULL, NULL, 0,
+								   PGRAFT_GO_KV_NO_COMPARE, lease,
+								   pgraft_timeout_arg_ms(fcinfo, 1)) > 0);
+}
+
+/* Drop a lease and delete its keys; false if it did not exist */
+Datum
+pgraft_kv_lease_revoke(PG_FUNCTION_ARGS)
+{
+	int64		lease = PG_GETARG_INT64(0);
+
+	PG_RETURN_BOOL(pgraft_kv_write(PGRAFT_GO_KV_LEASE_REVOKE, NULL, NULL, 0,
+								   PGRAFT_GO_KV_NO_COMPARE, lease,
+								   pgraft_timeout_arg_ms(fcinfo, 1)) > 0);
+}
+
+/*
+ * Run a read in the worker's Go runtime and, when called as a set
+ * function, turn the records it wrote into rows.  With consistent, a read
+ * barrier comes first, so the read sees every write committed before the
+ * call.  Returns the store revision the read was served at.
+ */
+static int64
+pgraft_kv_read(FunctionCallInfo fcinfo, int mode, text *key, int64 after, int limit,
+			   int timeout_ms, bool consistent)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	pgraft_go_raft_status_t raft_status;
+	Tuplestorestate *tupstore = NULL;
+	TupleDesc	tupdesc = NULL;
+	bool		watch = mode == PGRAFT_GO_KV_READ_WATCH;
+	char		path[MAXPGPATH];
+	uint64		proposal_id;
+	int64_t		result = 0;
+	int64		revision = 0;
+	int			wait_ms = PGRAFT_KV_READ_TIMEOUT_MS + (watch ? timeout_ms : 0);
+
+	if (rsinfo != NULL && IsA(rsinfo, ReturnSetInfo))
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+		if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+			elog(ERROR, "return type must be a row type");
+		tupstore = tuplestore_begin_heap(true, false, work_mem);
+		rsinfo->returnMode = SFRM_Materialize;
+		rsinfo->setResult = tupstore;
+		rsinfo->setDesc = tupdesc;
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	if (consistent)
+	{
+		int64_t		read_index = pgraft_submit_and_wait(COMMAND_READ_INDEX, NULL, 0, true,
+														PGRAFT_KV_READ_TIMEOUT_MS);
+
+		if (read_index <= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_QUERY_CANCELED),
+					 errmsg("pgraft: read index not confirmed for a consistent read"),
+					 errhint("Pass consistent => false to read this node's copy.")));
+	}
+	else if (!pgraft_state_read_raft_status(&raft_status) || raft_status.leader_id < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("pgraft: Raft is not running on this node")));
+
+	proposal_id = pgraft_log_register_proposal();
+	if (proposal_id == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONFIGURATION_LIMIT_EXCEEDED),
+				 errmsg("pgraft: too many requests waiting on Raft")));
+
+	snprintf(path, sizeof(path), "%s/pgraft/%s." UINT64_FORMAT, DataDir,
+			 PGRAFT_GO_KV_FILE, proposal_id);
+
+	PG_TRY();
+	{
+		unsigned char header[PGRAFT_GO_KV_RECORD_HEADER];
+		uint64		value64;
+		FILE	   *file;
+
+		if (!pgraft_queue_kv_read(mode, key ? VARDATA_ANY(key) : "",
+								  key ? (int) VARSIZE_ANY_EXHDR(key) : 0,
+								  after, limit, timeout_ms, path, proposal_id))
+			ereport(ERROR,
+					(errmsg("pgraft: Failed to queue KV_READ command")));
+
+		result = pgraft_log_wait_proposal(proposal_id, wait_ms);
+		if (result == PGRAFT_GO_KV_COMPACTED)
+			ereport(ERROR,
+					(errcode(ERRCODE_SNAPSHOT_TOO_OLD),
+					 errmsg("pgraft: changes after revision " INT64_FORMAT
+							" are no longer kept", after),
+					 errhint("Read the keys again with pgraft_kv_get() and watch from "
+							 "the pgraft_kv_revision() taken before it.")));
+		if (result < 0)
+			ereport(ERROR,
+					(errmsg("pgraft: could not read the key-value store"),
+					 errhint("See the server log for the Go runtime's error.")));
+		if (result == 0)
+			ereport(ERROR,
+					(errmsg("pgraft: key-value read did not finish within %d ms", wait_ms)));
+
+		file = AllocateFile(path, PG_BINARY_R);
+		if (file == NULL)
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("pgraft: could not open \"%s\": %m", path)));
+		if (fread(header, 1, PGRAFT_GO_KV_FILE_HEADER, file) != PGRAFT_GO_KV_FILE_HEADER)
+			ereport(ERROR,
+					(errcode(ERRCODE_DATA_CORRUPTED),
+					 errmsg("pgraft: key-value read \"%s\" is truncated", path)));
+		memcpy(&value64, header, 8);
+		revision = (int64) pg_ntoh64(value64);
+
+		while (tupstore &&
+			   fread(header, 1, sizeof(header), file) == sizeof(header))
+		{
+			uint32		key_len;
+			uint32		value_len;
+			int64		fields[4];
+			char	   *key_data;
+			bytea	   *value;
+			Datum		values[7];
+			bool		nulls[7];
+			int			i;
+
+			for (i = 0; i < 4; i++)
+			{
+				memcpy(&value64, header + 1 + i * 8, 8);
+				fields[i] = (int64) pg_ntoh64(value64);
+			}
+			memcpy(&key_len, header + 33, 4);
+			memcpy(&value_len, header + 37, 4);
+			key_len = pg_ntoh32(key_len);
+			value_len = pg_ntoh32(value_len);
+
+			key_data = palloc(key_len + 1);
+			value = (bytea *) palloc(VARHDRSZ + value_len);
+			if (fread(key_data, 1, key_len, file) != key_len ||
+				fread(VARDATA(value), 1, value_len, file) != value_len)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("pgraft: key-value read \"%s\" ends inside a record", path)));
+			key_data[key_len] = '\0';
+			SET_VARSIZE(value, VARHDRSZ + value_len);
+
+			memset(nulls, 0, sizeof(nulls));
+			if (watch)
+			{
+				/* revision, event, key, value, create_revision, version, lease */
+				values[0] = Int64GetDatum(fields[1]);
+				values[1] = CStringGetTextDatum(header[0] == PGRAFT_GO_KV_EVENT_DELETE ?
+												"delete" : "put");
+				values[2] = CStringGetTextDatum(key_data);
+				values[3] = PointerGetDatum(value);
+				nulls[3] = header[0] == PGRAFT_GO_KV_EVENT_DELETE;
+				values[4] = Int64GetDatum(fields[0]);
+				values[5] = Int64GetDatum(fields[2]);
+				values[6] = Int64GetDatum(fields[3]);
+			}
+			else
+			{
+				/* key, value, create_revision, mod_revision, version, lease */
+				values[0] = CStringGetTextDatum(key_data);
+				values[1] = PointerGetDatum(value);
+				values[2] = Int64GetDatum(fields[0]);
+				values[3] = Int64GetDatum(fields[1]);
+				values[4] = Int64GetDatum(fields[2]);
+				values[5] = Int64GetDatum(fields[3]);
+			}
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+			pfree(key_data);
+			pfree(value);
+		}
+		if (ferror(file))
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("pgraft: could not read \"%s\": %m", path)));
+		FreeFile(file);
+	}
+	PG_CATCH();
+	{
+		pgraft_log_release_proposal(proposal_id);
+		(void) unlink(path);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	pgraft_log_release_proposal(proposal_id);
+	(void) unlink(path);
+	return revision;
+}
+
+/*
+ * The entry of key, or with prefix every entry under it in key order.
+ * consistent (the default) reads behind a read barrier; otherwise this
+ * node's possibly stale copy is read.
+ */
+Datum
+pgraft_kv_get(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	text	   *key;
+	bool		prefix = PG_ARGISNULL(1) ? false : PG_GETARG_BOOL(1);
+	bool		consistent = PG_ARGISNULL(2) ? true : PG_GETARG_BOOL(2);
+	int32		limit = PG_ARGISNULL(3) ? PGRAFT_KV_MAX_READ_LIMIT : PG_GETARG_INT32(3);
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: key must not be NULL")));
+	if (limit <= 0 || limit > PGRAFT_KV_MAX_READ_LIMIT)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: max_keys must be between 1 and %d", PGRAFT_KV_MAX_READ_LIMIT)));
+	key = PG_GETARG_TEXT_PP(0);
+
+	(void) pgraft_kv_read(fcinfo, prefix ? PGRAFT_GO_KV_READ_PREFIX : PGRAFT_GO_KV_READ_GET,
+						  key, 0, limit, 0, consistent);
+	return (Datum) 0;
+}
+
+/*
+ * The store's current revision.  Taken before pgraft_kv_get(), it is the
+ * revision to watch from so that no change is missed.
+ */
+Datum
+pgraft_kv_revision(PG_FUNCTION_ARGS)
+{
+	bool		consistent = PG_ARGISNULL(0) ? true : PG_GETARG_BOOL(0);
+
+	PG_RETURN_INT64(pgraft_kv_read(fcinfo, PGRAFT_GO_KV_READ_GET, NULL, 0, 1, 0, consistent));
+}
+
+/*
+ * Changes to keys under prefix after after_revision, in revision order,
+ * waiting up to timeout for the first; empty if none came.  Resume from
+ * the last revision returned.  Errors with SQLSTATE 72000 once the
+ * changes are older than the history kept on this node.
+ */
+Datum
+pgraft_kv_watch(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	text	   *prefix;
+	int64		after = PG_ARGISNULL(1) ? 0 : PG_GETARG_INT64(1);
+	int			timeout_ms = pgraft_timeout_arg_ms(fcinfo, 2);
+	int32		limit = PG_ARGISNULL(3) ? 1000 : PG_GETARG_INT32(3);
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (PG_ARGISNULL(0))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("pgraft: prefix must not be NULL")));
+	if (after < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: after_revision must not be negative")));
+	if (limit <= 0 || limit > PGRAFT_KV_MAX_READ_LIMIT)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("pgraft: max_events must be between 1 and %d", PGRAFT_KV_MAX_READ_LIMIT)));
+	prefix = PG_GETARG_TEXT_PP(0);
+
+	(void) pgraft_kv_read(fcinfo, PGRAFT_GO_KV_READ_WATCH, prefix, after, limit,
+						  timeout_ms, false);
+	return (Datum) 0;
+}
@@ -9,17 +9,32 @@
  */
 
 #include "postgres.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "storage/condition_variable.h"
 #include "storage/shmem.h"
 #include "storage/spin.h"
 #include "utils/elog.h"
+#include "utils/timestamp.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "../include/pgraft_state.h"
+#include "../include/pgraft_core.h"
+#include "../include/pgraft_go.h"
 
 /* Global shared memory pointer */
 static pgraft_go_state_t *g_go_state = NULL;
 
+/* Leader and term the worker last woke leader_cv waiters for */
+static int64_t g_notified_leader = -1;
+static int64_t g_notified_term = -1;
+
 /*
  * Initialize shared memory for Go state persistence
  */
@@ -44,6 +59,7 @@ pgraft_state_init_shared_memory(void)
 		
 		/* Initialize mutex */
 		SpinLockInit(&g_go_state->mutex);
+		ConditionVariableInit(&g_go_state->leader_cv);
 		
 		/* Initialize default values */
 		g_go_state->go_lib_loaded = 0;
@@ -64,6 +80,14 @@ pgraft_state_init_shared_memory(void)
 		memset(g_go_state->node_ids, 0, sizeof(g_go_state->node_ids));
 		memset(g_go_state->node_addresses, 0, sizeof(g_go_state->node_addresses));
 		memset(g_go_state->node_ports, 0, sizeof(g_go_state->node_ports));
+		for (int i = 0; i < PGRAFT_MAX_NODES; i++)
+		{
+			g_go_state->node_match_index[i] = -1;
+			g_go_state->node_next_index[i] = -1;
+			g_go_state->node_progress_state[i] = -1;
+			g_go_state->node_voting[i] = true;
+		}
+		g_go_state->go_status_published_at = 0;
 		g_go_state->go_messages_processed = 0;
 		g_go_state->go_log_entries_committed = 0;
 		g_go_state->go_heartbeats_sent = 0;
@@ -276,7 +300,7 @@ pgraft_state_save_cluster_nodes(int32_t num_nodes, int32_t* node_ids,
     SpinLockAcquire(&state->mutex);
     
     state->num_nodes = num_nodes;
-    for (int i = 0; i < num_nodes && i < 16; i++) {
+    for (int i = 0; i < num_nodes && i < PGRAFT_MAX_NODES; i++) {
         state->node_ids[i] = node_ids[i];
         strncpy(state->node_addresses[i], node_addresses[i], sizeof(state->node_addresses[i]) - 1);
         state->node_addresses[i][sizeof(state->node_addresses[i]) - 1] = '\0';
@@ -304,7 +328,7 @@ pgraft_state_restore_cluster_nodes(int32_t* num_nodes, int32_t* node_ids,
     SpinLockAcquire(&state->mutex);
     
     *num_nodes = state->num_nodes;
-    for (int i = 0; i < state->num_nodes && i < 16; i++) {
+    for (int i = 0; i < state->num_nodes && i < PGRAFT_MAX_NODES; i++) {
         node_ids[i] = state->node_ids[i];
         strncpy(node_addresses[i], state->node_addresses[i], 255);
         node_addresses[i][255] = '\0';
@@ -316,6 +340,300 @@ pgraft_state_restore_cluster_nodes(int32_t* num_nodes, int32_t* node_ids,
     elog(DEBUG1, "pgraft: Restored %d cluster nodes", *num_nodes);
 }
 
+/*
+ * Publish the Go Raft status to shared memory (background worker only)
+ */
+void
+pgraft_state_publish_go_status(void)
+{
+	pgraft_go_get_status_func get_status;
+	pgraft_go_status_t status;
+	pgraft_cluster_t *cluster;
+	pgraft_go_state_t *state;
+	pgraft_node_t nodes[PGRAFT_MAX_NODES];
+	int64_t		match[PGRAFT_MAX_NODES];
+	int64_t		next[PGRAFT_MAX_NODES];
+	int32_t		progress[PGRAFT_MAX_NODES];
+	bool		voting[PGRAFT_MAX_NODES];
+	int32_t		node_id;
+	int32_t		num_nodes;
+	TimestampTz now;
+
+	get_status = pgraft_go_get_get_status_func();
+	if (!get_status)
+		return;
+
+	memset(&status, 0, sizeof(status));
+	if (get_status(&status) != 0)
+		return;
+
+	/* Keep the core view, used by pgraft_core_is_leader(), in step */
+	pgraft_core_update_cluster_state(status.leader_id, status.term,
+									 pgraft_state_raft_state_name(status.raft_state));
+
+	cluster = pgraft_core_get_shared_memory();
+	if (!cluster)
+		return;
+
+	SpinLockAcquire(&cluster->mutex);
+	node_id = cluster->node_id;
+	num_nodes = Min(cluster->num_nodes, PGRAFT_MAX_NODES);
+	memcpy(nodes, cluster->nodes, sizeof(pgraft_node_t) * num_nodes);
+	SpinLockRelease(&cluster->mutex);
+
+	/* Match progress to members outside the lock */
+	for (int i = 0; i < num_nodes; i++)
+	{
+		match[i] = next[i] = -1;
+		progress[i] = -1;
+		voting[i] = true;
+		for (int j = 0; j < status.num_learners; j++)
+		{
+			if (status.learner_id[j] == nodes[i].id)
+				voting[i] = false;
+		}
+		for (int j = 0; j < status.num_progress; j++)
+		{
+			if (status.progress_node_id[j] != nodes[i].id)
+				continue;
+			match[i] = status.progress_match[j];
+			next[i] = status.progress_next[j];
+			progress[i] = status.progress_state[j];
+			break;
+		}
+	}
+	now = GetCurrentTimestamp();
+
+	state = pgraft_state_get_shared_memory();
+	if (!state)
+		return;
+
+	SpinLockAcquire(&state->mutex);
+	state->go_node_id = node_id;
+	state->go_leader_id = status.leader_id;
+	state->go_current_term = status.term;
+	state->go_commit_index = status.commit_index;
+	state->go_last_applied = status.applied_index;
+	state->go_last_index = status.last_index;
+	strlcpy(state->go_raft_state, pgraft_state_raft_state_name(status.raft_state),
+			sizeof(state->go_raft_state));
+	state->num_nodes = num_nodes;
+	for (int i = 0; i < num_nodes; i++)
+	{
+		state->node_ids[i] = nodes[i].id;
+		strlcpy(state->node_addresses[i], nodes[i].address, sizeof(state->node_addresses[i]));
+		state->node_ports[i] = nodes[i].port;
+		state->node_match_index[i] = match[i];
+		state->node_next_index[i] = next[i];
+		state->node_progress_state[i] = progress[i];
+		state->node_voting[i] = voting[i];
+	}
+	state->go_status_published_at = now;
+	SpinLockRelease(&state->mutex);
+}
+
+/*
+ * Copy the published state in one critical section
+ */
+void
+pgraft_state_get_snapshot(pgraft_go_state_t *snapshot)
+{
+	pgraft_go_state_t *state = pgraft_state_get_shared_memory();
+
+	if (!state)
+	{
+		memset(snapshot, 0, sizeof(*snapshot));
+		return;
+	}
+
+	SpinLockAcquire(&state->mutex);
+	memcpy(snapshot, state, sizeof(*snapshot));
+	SpinLockRelease(&state->mutex);
+}
+
+/*
+ * Copy the Go-published Raft status, retrying while a write is in progress
+ */
+bool
+pgraft_state_read_raft_status(pgraft_go_raft_status_t *status)
+{
+	volatile pgraft_go_raft_status_t *block;
+	uint64_t	before;
+	uint64_t	after;
+
+	if (!g_go_state)
+	{
+		memset(status, 0, sizeof(*status));
+		return false;
+	}
+
+	block = &g_go_state->raft_status;
+	for (;;)
+	{
+		before = block->seq;
+		pg_read_barrier();
+		status->leader_id = block->leader_id;
+		status->term = block->term;
+		status->commit_index = block->commit_index;
+		status->applied_index = block->applied_index;
+		status->raft_state = block->raft_state;
+		status->is_leader = block->is_leader;
+		pg_read_barrier();
+		after = block->seq;
+
+		if (before == after && (before & 1) == 0)
+			break;
+		pg_spin_delay();
+	}
+
+	status->seq = before;
+	return before != 0;
+}
+
+/*
+ * Wake leadership waiters if leader or term moved since the last call
+ * (background worker only).  Go pokes the worker as soon as it publishes
+ * a new leader or term, so this runs within one wakeup of the election.
+ */
+void
+pgraft_state_check_leader_change(void)
+{
+	pgraft_go_raft_status_t status;
+
+	if (!pgraft_state_read_raft_status(&status))
+		return;
+	if (status.leader_id == g_notified_leader && status.term == g_notified_term)
+		return;
+
+	elog(DEBUG1, "pgraft: leader " INT64_FORMAT " term " INT64_FORMAT
+		 " (was " INT64_FORMAT " term " INT64_FORMAT ")",
+		 status.leader_id, status.term, g_notified_leader, g_notified_term);
+	g_notified_leader = status.leader_id;
+	g_notified_term = status.term;
+	ConditionVariableBroadcast(&g_go_state->leader_cv);
+}
+
+/*
+ * Sleep until the published leader or term differs from the known ones
+ */
+bool
+pgraft_state_wait_leader_change(int64_t known_leader, int64_t known_term,
+								int timeout_ms, pgraft_go_raft_status_t *status)
+{
+	TimestampTz start = GetCurrentTimestamp();
+	bool		changed = false;
+
+	if (!g_go_state)
+	{
+		memset(status, 0, sizeof(*status));
+		return false;
+	}
+
+	ConditionVariablePrepareToSleep(&g_go_state->leader_cv);
+	for (;;)
+	{
+		long		remaining;
+
+		if (pgraft_state_read_raft_status(status) &&
+			(status->leader_id != known_leader || status->term != known_term))
+		{
+			changed = true;
+			break;
+		}
+
+		remaining = timeout_ms - (long) TimestampDifferenceMilliseconds(start, GetCurrentTimestamp());
+		if (remaining <= 0)
+			break;
+
+		(void) ConditionVariableTimedSleep(&g_go_state->leader_cv, remaining, PG_WAIT_EXTENSION);
+	}
+	ConditionVariableCancelSleep();
+
+	return changed;
+}
+
+/*
+ * Map dir/metrics shared for the Go library to publish into.  The mapping
+ * is never undone: Go may write to it until the worker exits.  NULL, with
+ * a warning, if the file cannot be created.
+ */
+pgraft_go_metrics_t *
+pgraft_state_map_metrics_file(const char *dir)
+{
+	pgraft_go_metrics_t *block;
+	char		path[MAXPGPATH];
+	int			fd;
+
+	if (mkdir(dir, S_IRWXU) != 0 && errno != EEXIST)
+	{
+		elog(WARNING, "pgraft: could not create directory \"%s\": %m", dir);
+		return NULL;
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", dir, PGRAFT_GO_METRICS_FILE);
+	fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+	{
+		elog(WARNING, "pgraft: could not open metrics file \"%s\": %m", path);
+		return NULL;
+	}
+	if (ftruncate(fd, sizeof(pgraft_go_metrics_t)) != 0)
+	{
+		elog(WARNING, "pgraft: could not size metrics file \"%s\": %m", path);
+		close(fd);
+		return NULL;
+	}
+
+	block = mmap(NULL, sizeof(pgraft_go_metrics_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (block == MAP_FAILED)
+	{
+		elog(WARNING, "pgraft: could not map metrics file \"%s\": %m", path);
+		return NULL;
+	}
+
+	/* Keep the file, so a reader that mapped it before a restart still sees it */
+	memset(block, 0, sizeof(*block));
+	block->version = PGRAFT_GO_METRICS_VERSION;
+	pg_write_barrier();
+	block->magic = PGRAFT_GO_METRICS_MAGIC;
+	return block;
+}
+
+const char *
+pgraft_state_raft_state_name(int32_t raft_state)
+{
+	switch (raft_state)
+	{
+		case 0:
+			return "follower";
+		case 1:
+			return "candidate";
+		case 2:
+			return "leader";
+		case 3:
+			return "pre-candidate";
+		default:
+			return "unknown";
+	}
+}
+
+const char *
+pgraft_state_progress_name(int32_t progress_state)
+{
+	switch (progress_state)
+	{
+		case 0:
+			return "probe";
+		case 1:
+			return "replicate";
+		case 2:
+			return "snapshot";
+		default:
+			return NULL;
+	}
+}
+
 /* State validation functions */
 bool pgraft_state_is_go_lib_loaded(void) {
     pgraft_go_state_t *state;
@@ -8,108 +8,219 @@
 #include "utils/palloc.h"
 #include "lib/ilist.h"
 #include "nodes/pg_list.h"
+#include "port/atomics.h"
+#include "storage/latch.h"
 #include "../include/pgraft_core.h"
 
 #include <time.h>
 
+/* Longest string a decoded command can hold in the given field */
+#define PGRAFT_COMMAND_FIELD_MAX(field) (sizeof(((pgraft_command_t *) 0)->field) - 1)
+
+static void pgraft_wake_worker(pgraft_worker_state_t *state);
+static void pgraft_evict_oldest_command(pgraft_worker_state_t *state);
+static bool pgraft_arena_reserve(pgraft_worker_state_t *state, uint32 len,
+								 uint32 *offset, uint32 *alloc);
+static bool pgraft_enqueue(COMMAND_TYPE type, int node_id, const char *address, int port,
+						   const char *cluster_id, const char *log_data, int log_data_len,
+						   int log_index, uint64 proposal_id, uint64 *id_out);
+static void pgraft_decode_command(pgraft_worker_state_t *state,
+								  const pgraft_command_slot_t *slot, pgraft_command_t *cmd);
+static bool pgraft_ring_append(pgraft_worker_state_t *state, uint32 kind,
+							   const char *data, int data_len, uint64 proposal_id);
+
 /*
- * Add command to queue (called by SQL functions)
+ * Wake the background worker so it drains the queue immediately
  */
-bool
-pgraft_queue_command(COMMAND_TYPE type, int node_id, const char *address, int port, const char *cluster_id)
+static void
+pgraft_wake_worker(pgraft_worker_state_t *state)
 {
-	pgraft_worker_state_t *state;
-	pgraft_command_t *cmd;
-	
-	elog(LOG, "pgraft: pgraft_queue_command called with type=%d, node_id=%d, address=%s, port=%d", 
-		 type, node_id, address ? address : "NULL", port);
-	
-	state = pgraft_worker_get_state();
-	if (state == NULL) {
-		elog(ERROR, "pgraft: Failed to get worker state in pgraft_queue_command");
-		return false;
-	}
-	
-	/* Check if queue is full */
-	if (state->command_count >= MAX_COMMANDS) {
-		elog(WARNING, "pgraft: Command queue is full, cannot queue new command");
-		return false;
+	Latch	   *latch;
+
+	SpinLockAcquire(&state->mutex);
+	latch = state->latch;
+	SpinLockRelease(&state->mutex);
+
+	if (latch != NULL)
+		SetLatch(latch);
+}
+
+/*
+ * Release the oldest command's slot and payload.  Caller holds the mutex
+ * and has checked that the command has already been dequeued.
+ */
+static void
+pgraft_evict_oldest_command(pgraft_worker_state_t *state)
+{
+	pgraft_command_slot_t *slot = &state->slots[state->oldest_id % MAX_COMMANDS];
+
+	state->arena_head = (state->arena_head + slot->payload_alloc) % PGRAFT_COMMAND_ARENA_SIZE;
+	state->arena_used -= slot->payload_alloc;
+	slot->id = 0;
+	state->oldest_id++;
+}
+
+/*
+ * Reserve len contiguous bytes at the arena tail, wrapping to the start
+ * when the tail is too short.  The skipped tail is charged to this
+ * allocation so that freeing stays FIFO.  Caller holds the mutex.
+ */
+static bool
+pgraft_arena_reserve(pgraft_worker_state_t *state, uint32 len, uint32 *offset, uint32 *alloc)
+{
+	uint32		free_bytes;
+	uint32		tail;
+
+	if (state->arena_used == 0)
+		state->arena_head = 0;
+
+	free_bytes = PGRAFT_COMMAND_ARENA_SIZE - state->arena_used;
+	tail = (state->arena_head + state->arena_used) % PGRAFT_COMMAND_ARENA_SIZE;
+
+	if (tail + len <= PGRAFT_COMMAND_ARENA_SIZE && len <= free_bytes)
+	{
+		*offset = tail;
+		*alloc = len;
 	}
-	
-	/* Get pointer to next slot in circular buffer */
-	cmd = &state->commands[state->command_tail];
-	
-	/* Initialize command */
-	cmd->type = type;
-	cmd->node_id = node_id;
-	strncpy(cmd->address, address, sizeof(cmd->address) - 1);
-	cmd->address[sizeof(cmd->address) - 1] = '\0';
-	cmd->port = port;
-	
-	if (cluster_id) {
-		strncpy(cmd->cluster_id, cluster_id, sizeof(cmd->cluster_id) - 1);
-		cmd->cluster_id[sizeof(cmd->cluster_id) - 1] = '\0';
-	} else {
-		cmd->cluster_id[0] = '\0';
+	else if (tail >= state->arena_head &&
+			 (PGRAFT_COMMAND_ARENA_SIZE - tail) + len <= free_bytes)
+	{
+		*offset = 0;
+		*alloc = (PGRAFT_COMMAND_ARENA_SIZE - tail) + len;
 	}
-	
-	/* Initialize status tracking */
-	cmd->status = COMMAND_STATUS_PENDING;
-	cmd->error_message[0] = '\0';
-	cmd->timestamp = time(NULL);
-	
-	/* Update circular buffer pointers */
-	state->command_tail = (state->command_tail + 1) % MAX_COMMANDS;
-	state->command_count++;
-	
-	elog(LOG, "pgraft: Command %d queued for node %d at %s:%d (count=%d)", 
-		 type, node_id, address, port, state->command_count);
+	else
+		return false;
+
+	state->arena_used += *alloc;
 	return true;
 }
 
 /*
- * Remove command from queue (called by worker)
- * Returns true if command was dequeued, false if queue is empty
+ * Copy a slot and its payload out of shared memory.  Caller holds the mutex.
  */
-bool
-pgraft_dequeue_command(pgraft_command_t *cmd)
+static void
+pgraft_decode_command(pgraft_worker_state_t *state, const pgraft_command_slot_t *slot,
+					  pgraft_command_t *cmd)
+{
+	const char *payload = state->arena + slot->payload_offset;
+
+	cmd->id = slot->id;
+	cmd->type = slot->type;
+	cmd->node_id = slot->node_id;
+	cmd->port = slot->port;
+	cmd->log_index = slot->log_index;
+	cmd->log_data_len = (int) slot->log_data_len;
+	cmd->proposal_id = slot->proposal_id;
+	cmd->status = slot->status;
+	cmd->timestamp = slot->timestamp;
+
+	memcpy(cmd->address, payload, slot->address_len + 1);
+	payload += slot->address_len + 1;
+	memcpy(cmd->cluster_id, payload, slot->cluster_id_len + 1);
+	payload += slot->cluster_id_len + 1;
+	memcpy(cmd->log_data, payload, slot->log_data_len + 1);
+	strlcpy(cmd->error_message, slot->error_message, sizeof(cmd->error_message));
+}
+
+/*
+ * Append a command, evicting finished commands as needed for a slot and
+ * payload space.  Fails only when every slot holds a pending command or
+ * the pending payloads fill the arena.
+ */
+static bool
+pgraft_enqueue(COMMAND_TYPE type, int node_id, const char *address, int port,
+			   const char *cluster_id, const char *log_data, int log_data_len,
+			   int log_index, uint64 proposal_id, uint64 *id_out)
 {
 	pgraft_worker_state_t *state;
-	
+	pgraft_command_slot_t *slot;
+	uint32		address_len;
+	uint32		cluster_id_len;
+	uint32		data_len;
+	uint32		offset;
+	uint32		alloc;
+	char	   *payload;
+
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
-		return false;
-	}
-	
-	/* Check if queue is empty */
-	if (state->command_count == 0) {
+	if (state == NULL)
 		return false;
+
+	/* Truncate to what the decoded pgraft_command_t buffers can hold */
+	address_len = address ? (uint32) strnlen(address, PGRAFT_COMMAND_FIELD_MAX(address)) : 0;
+	cluster_id_len = cluster_id ? (uint32) strnlen(cluster_id, PGRAFT_COMMAND_FIELD_MAX(cluster_id)) : 0;
+	if (!log_data)
+		data_len = 0;
+	else if (log_data_len >= 0)
+		data_len = (uint32) Min(log_data_len, (int) PGRAFT_COMMAND_FIELD_MAX(log_data));
+	else
+		data_len = (uint32) strnlen(log_data, PGRAFT_COMMAND_FIELD_MAX(log_data));
+
+	SpinLockAcquire(&state->mutex);
+
+	while (state->next_id - state->oldest_id >= MAX_COMMANDS ||
+		   !pgraft_arena_reserve(state, address_len + cluster_id_len + data_len + 3,
+								 &offset, &alloc))
+	{
+		if (state->oldest_id >= state->next_dequeue_id)
+		{
+			SpinLockRelease(&state->mutex);
+			elog(WARNING, "pgraft: Command queue is full, cannot queue command %d", type);
+			return false;
+		}
+		pgraft_evict_oldest_command(state);
 	}
-	
-	/* Copy command from head of circular buffer */
-	*cmd = state->commands[state->command_head];
-	
-	/* Update circular buffer pointers */
-	state->command_head = (state->command_head + 1) % MAX_COMMANDS;
-	state->command_count--;
-	
+
+	slot = &state->slots[state->next_id % MAX_COMMANDS];
+	slot->id = state->next_id;
+	slot->type = type;
+	slot->status = COMMAND_STATUS_PENDING;
+	slot->node_id = node_id;
+	slot->port = port;
+	slot->log_index = log_index;
+	slot->proposal_id = proposal_id;
+	slot->timestamp = time(NULL);
+	slot->payload_offset = offset;
+	slot->payload_alloc = alloc;
+	slot->address_len = (uint16) address_len;
+	slot->cluster_id_len = (uint16) cluster_id_len;
+	slot->log_data_len = data_len;
+	slot->error_message[0] = '\0';
+
+	payload = state->arena + offset;
+	if (address_len > 0)
+		memcpy(payload, address, address_len);
+	payload[address_len] = '\0';
+	payload += address_len + 1;
+	if (cluster_id_len > 0)
+		memcpy(payload, cluster_id, cluster_id_len);
+	payload[cluster_id_len] = '\0';
+	payload += cluster_id_len + 1;
+	if (data_len > 0)
+		memcpy(payload, log_data, data_len);
+	payload[data_len] = '\0';
+
+	*id_out = state->next_id++;
+
+	SpinLockRelease(&state->mutex);
+
+	pgraft_wake_worker(state);
 	return true;
 }
 
 /*
- * Check if command queue is empty
+ * Add command to queue (called by SQL functions)
  */
 bool
-pgraft_queue_is_empty(void)
+pgraft_queue_command(COMMAND_TYPE type, int node_id, const char *address, int port, const char *cluster_id)
 {
-	pgraft_worker_state_t *state;
-	
-	state = pgraft_worker_get_state();
-	if (state == NULL) {
-		return true;
-	}
-	
-	return (state->command_count == 0);
+	uint64		id;
+
+	if (!pgraft_enqueue(type, node_id, address, port, cluster_id, NULL, 0, 0, 0, &id))
+		return false;
+
+	elog(LOG, "pgraft: Command %d queued for node %d at %s:%d (id=" UINT64_FORMAT ")",
+		 type, node_id, address ? address : "NULL", port, id);
+	return true;
 }
 
 /*
@@ -117,183 +228,386 @@ pgraft_queue_is_empty(void)
  */
 bool
 pgraft_queue_log_command(COMMAND_TYPE type, const char *log_data, int log_index)
+{
+	uint64		id;
+
+	if (!pgraft_enqueue(type, 0, NULL, 0, NULL, log_data, -1, log_index, 0, &id))
+		return false;
+
+	elog(DEBUG1, "pgraft: Log command %d queued (index=%d, id=" UINT64_FORMAT ")",
+		 type, log_index, id);
+	return true;
+}
+
+/*
+ * Queue a command whose outcome is reported to a proposal waiter, with
+ * optional binary data for the worker to propose through Raft
+ */
+bool
+pgraft_queue_proposal_command(COMMAND_TYPE type, const char *data, int data_len,
+							  uint64 proposal_id)
 {
 	pgraft_worker_state_t *state;
-	pgraft_command_t *cmd;
-	
+	uint32		kind;
+	uint64		id;
+
+	if (data_len > (int) PGRAFT_COMMAND_FIELD_MAX(log_data))
+		return false;
+
+	switch (type)
+	{
+		case COMMAND_REPLICATE:
+			kind = PGRAFT_GO_RING_PROPOSE;
+			break;
+		case COMMAND_KV_WRITE:
+			kind = PGRAFT_GO_RING_KV_WRITE;
+			break;
+		case COMMAND_READ_INDEX:
+			kind = PGRAFT_GO_RING_READ_INDEX;
+			break;
+		default:
+			kind = PGRAFT_GO_RING_WRAP;
+			break;
+	}
+
+	/* Straight to Go when it has the ring; the queue otherwise, or when full */
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
+	if (state != NULL && kind != PGRAFT_GO_RING_WRAP &&
+		pgraft_ring_append(state, kind, data, data_len, proposal_id))
+	{
+		pgraft_wake_worker(state);
+		return true;
+	}
+
+	return pgraft_enqueue(type, 0, NULL, 0, NULL, data, data_len, 0, proposal_id, &id);
+}
+
+/*
+ * Append one record to the proposal ring.  False if Go has not attached
+ * it or there is no room.
+ */
+static bool
+pgraft_ring_append(pgraft_worker_state_t *state, uint32 kind, const char *data, int data_len,
+				   uint64 proposal_id)
+{
+	pgraft_go_ring_t *ring = &state->ring;
+	pgraft_go_ring_record_t record;
+	uint32		need = (uint32) TYPEALIGN(PGRAFT_GO_RING_ALIGN, sizeof(record) + data_len);
+	uint32		pad = 0;
+	uint32		offset;
+	uint64		head;
+	uint64		tail;
+
+	SpinLockAcquire(&state->ring_mutex);
+	if (!state->ring_attached)
+	{
+		SpinLockRelease(&state->ring_mutex);
 		return false;
 	}
-	
-	/* Check if queue is full */
-	if (state->command_count >= MAX_COMMANDS) {
-		elog(WARNING, "pgraft: Command queue is full, cannot queue log command");
+
+	head = ring->head;
+	tail = *(volatile uint64_t *) &ring->tail;
+	offset = (uint32) (head % PGRAFT_GO_RING_SIZE);
+	if (offset + need > PGRAFT_GO_RING_SIZE)
+		pad = PGRAFT_GO_RING_SIZE - offset;
+	if (head + pad + need - tail > PGRAFT_GO_RING_SIZE)
+	{
+		SpinLockRelease(&state->ring_mutex);
 		return false;
 	}
-	
-	/* Get pointer to next slot in circular buffer */
-	cmd = &state->commands[state->command_tail];
-	
-	/* Initialize command */
-	cmd->type = type;
-	cmd->node_id = 0;  /* Not applicable for log commands */
-	cmd->address[0] = '\0';  /* Not applicable for log commands */
-	cmd->port = 0;  /* Not applicable for log commands */
-	cmd->cluster_id[0] = '\0';  /* Not applicable for log commands */
-	
-	/* Set log-specific fields */
-	if (log_data) {
-		strncpy(cmd->log_data, log_data, sizeof(cmd->log_data) - 1);
-		cmd->log_data[sizeof(cmd->log_data) - 1] = '\0';
-	} else {
-		cmd->log_data[0] = '\0';
+
+	if (pad > 0)
+	{
+		record.kind = PGRAFT_GO_RING_WRAP;
+		record.length = pad - sizeof(record);
+		record.proposal_id = 0;
+		memcpy(ring->data + offset, &record, sizeof(record));
+		offset = 0;
 	}
-	cmd->log_index = log_index;
-	
-	/* Initialize status tracking */
-	cmd->status = COMMAND_STATUS_PENDING;
-	cmd->error_message[0] = '\0';
-	cmd->timestamp = time(NULL);
-	
-	/* Update circular buffer pointers */
-	state->command_tail = (state->command_tail + 1) % MAX_COMMANDS;
-	state->command_count++;
-	
-	elog(LOG, "pgraft: Log command %d queued (index=%d, count=%d)", type, log_index, state->command_count);
+	record.kind = kind;
+	record.length = (uint32) data_len;
+	record.proposal_id = proposal_id;
+	memcpy(ring->data + offset, &record, sizeof(record));
+	if (data_len > 0)
+		memcpy(ring->data + offset + sizeof(record), data, data_len);
+
+	/* Go may read the record as soon as it sees the new head */
+	pg_write_barrier();
+	ring->head = head + pad + need;
+	SpinLockRelease(&state->ring_mutex);
 	return true;
 }
 
 /*
- * Add command to status tracking buffer
+ * Queue membership changes for one COMMAND_CHANGE_PEERS, packed into
+ * log_data as a "type node_id port address" line each, "-" standing for
+ * the empty address of a removal.  False if they do not fit or the queue
+ * is full.
  */
 bool
-pgraft_add_command_to_status(pgraft_command_t *cmd)
+pgraft_queue_peer_changes(const pgraft_go_peer_change_t *changes, int count,
+						  uint64 proposal_id)
+{
+	char		packed[PGRAFT_COMMAND_FIELD_MAX(log_data) + 1];
+	int			len = 0;
+	uint64		id;
+
+	for (int i = 0; i < count; i++)
+	{
+		int			n = snprintf(packed + len, sizeof(packed) - len, "%d %d %d %s\n",
+								 changes[i].type, changes[i].node_id, changes[i].port,
+								 changes[i].address[0] != '\0' ? changes[i].address : "-");
+
+		if (n < 0 || n >= (int) sizeof(packed) - len)
+			return false;
+		len += n;
+	}
+
+	return pgraft_enqueue(COMMAND_CHANGE_PEERS, 0, NULL, 0, NULL, packed, len, 0,
+						  proposal_id, &id);
+}
+
+/*
+ * Unpack a COMMAND_CHANGE_PEERS; returns the number of changes, or -1 if
+ * the payload is malformed or holds more than max_changes
+ */
+int
+pgraft_decode_peer_changes(const pgraft_command_t *cmd, pgraft_go_peer_change_t *changes,
+						   int max_changes)
+{
+	const char *line = cmd->log_data;
+	const char *end = cmd->log_data + cmd->log_data_len;
+	int			count = 0;
+
+	while (line < end)
+	{
+		pgraft_go_peer_change_t *change;
+
+		if (count == max_changes)
+			return -1;
+		change = &changes[count];
+		memset(change, 0, sizeof(*change));
+		if (sscanf(line, "%d %d %d %255s", &change->type, &change->node_id,
+				   &change->port, change->address) != 4)
+			return -1;
+		if (strcmp(change->address, "-") == 0)
+			change->address[0] = '\0';
+		count++;
+
+		line = memchr(line, '\n', end - line);
+		if (!line)
+			return -1;
+		line++;
+	}
+	return count;
+}
+
+/*
+ * Queue a COMMAND_LOG_ENTRIES: the page bounds go in log_data as
+ * "from_index limit max_bytes", the file to write in address
+ */
+bool
+pgraft_queue_log_entries(uint64 from_index, int limit, int64 max_bytes, const char *path,
+						 uint64 proposal_id)
+{
+	char		bounds[64];
+	uint64		id;
+	int			len;
+
+	if (strlen(path) > PGRAFT_COMMAND_FIELD_MAX(address))
+		return false;
+
+	len = snprintf(bounds, sizeof(bounds), UINT64_FORMAT " %d " INT64_FORMAT,
+				   from_index, limit, max_bytes);
+	return pgraft_enqueue(COMMAND_LOG_ENTRIES, 0, path, 0, NULL, bounds, len, 0,
+						  proposal_id, &id);
+}
+
+/*
+ * Queue a COMMAND_KV_READ: log_data holds "mode after limit timeout_ms"
+ * and a newline, then the key or prefix; the file to write is in address
+ */
+bool
+pgraft_queue_kv_read(int mode, const char *key, int key_len, int64 after, int limit,
+					 int timeout_ms, const char *path, uint64 proposal_id)
+{
+	char		request[PGRAFT_COMMAND_FIELD_MAX(log_data) + 1];
+	uint64		id;
+	int			len;
+
+	if (strlen(path) > PGRAFT_COMMAND_FIELD_MAX(address))
+		return false;
+
+	len = snprintf(request, sizeof(request), "%d " INT64_FORMAT " %d %d\n",
+				   mode, after, limit, timeout_ms);
+	if (key_len < 0 || len + key_len > (int) PGRAFT_COMMAND_FIELD_MAX(log_data))
+		return false;
+	memcpy(request + len, key, key_len);
+	return pgraft_enqueue(COMMAND_KV_READ, 0, path, 0, NULL, request, len + key_len, 0,
+						  proposal_id, &id);
+}
+
+/*
+ * Move up to max_commands pending commands into buf and mark them as
+ * processing (called by worker).  Returns how many were dequeued.
+ */
+int
+pgraft_dequeue_commands(pgraft_command_t *buf, int max_commands)
 {
 	pgraft_worker_state_t *state;
-	pgraft_command_t *status_cmd;
-	
+	pgraft_command_slot_t *slot;
+	int			count = 0;
+
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
-		return false;
-	}
-	
-	/* Check if status buffer is full */
-	if (state->status_count >= MAX_COMMANDS) {
-		elog(WARNING, "pgraft: Status buffer is full, removing oldest entry");
-		/* Remove oldest status entry */
-		state->status_head = (state->status_head + 1) % MAX_COMMANDS;
-		state->status_count--;
+	if (state == NULL)
+		return 0;
+
+	SpinLockAcquire(&state->mutex);
+	while (count < max_commands && state->next_dequeue_id < state->next_id)
+	{
+		slot = &state->slots[state->next_dequeue_id % MAX_COMMANDS];
+		slot->status = COMMAND_STATUS_PROCESSING;
+		pgraft_decode_command(state, slot, &buf[count++]);
+		state->next_dequeue_id++;
 	}
-	
-	/* Get pointer to next slot in status circular buffer */
-	status_cmd = &state->status_commands[state->status_tail];
-	
-	/* Copy command to status buffer */
-	*status_cmd = *cmd;
-	
-	/* Update circular buffer pointers */
-	state->status_tail = (state->status_tail + 1) % MAX_COMMANDS;
-	state->status_count++;
-	
-	return true;
+	SpinLockRelease(&state->mutex);
+
+	return count;
+}
+
+/*
+ * Remove one command from queue (called by worker)
+ * Returns true if command was dequeued, false if queue is empty
+ */
+bool
+pgraft_dequeue_command(pgraft_command_t *cmd)
+{
+	return pgraft_dequeue_commands(cmd, 1) == 1;
 }
 
 /*
- * Get command status by timestamp
+ * Check if command queue is empty
  */
 bool
-pgraft_get_command_status(int64_t timestamp, pgraft_command_t *status_cmd)
+pgraft_queue_is_empty(void)
 {
 	pgraft_worker_state_t *state;
-	int i;
-	
+	bool		empty;
+
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
+	if (state == NULL)
+		return true;
+
+	SpinLockAcquire(&state->mutex);
+	empty = (state->next_dequeue_id == state->next_id);
+	SpinLockRelease(&state->mutex);
+
+	return empty;
+}
+
+/*
+ * Get command status by id; false once the command has been evicted
+ */
+bool
+pgraft_get_command_status(uint64 id, pgraft_command_t *status_cmd)
+{
+	pgraft_worker_state_t *state;
+	pgraft_command_slot_t *slot;
+	bool		found = false;
+
+	state = pgraft_worker_get_state();
+	if (state == NULL)
 		return false;
+
+	SpinLockAcquire(&state->mutex);
+	slot = &state->slots[id % MAX_COMMANDS];
+	if (id >= state->oldest_id && id < state->next_id && slot->id == id)
+	{
+		pgraft_decode_command(state, slot, status_cmd);
+		found = true;
 	}
-	
-	/* Search through status buffer */
-	for (i = 0; i < state->status_count; i++) {
-		int index = (state->status_head + i) % MAX_COMMANDS;
-		if (state->status_commands[index].timestamp == timestamp) {
-			*status_cmd = state->status_commands[index];
-			return true;
-		}
-	}
-	
-	return false;
+	SpinLockRelease(&state->mutex);
+
+	return found;
 }
 
 /*
- * Update command status in status buffer
+ * Update command status by id
  */
 bool
-pgraft_update_command_status(int64_t timestamp, COMMAND_STATUS status, const char *error_message)
+pgraft_update_command_status(uint64 id, COMMAND_STATUS status, const char *error_message)
 {
 	pgraft_worker_state_t *state;
-	int i;
-	
+	pgraft_command_slot_t *slot;
+	bool		found = false;
+
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
+	if (state == NULL)
 		return false;
+
+	SpinLockAcquire(&state->mutex);
+	slot = &state->slots[id % MAX_COMMANDS];
+	if (id >= state->oldest_id && id < state->next_id && slot->id == id)
+	{
+		slot->status = status;
+		if (error_message)
+			strlcpy(slot->error_message, error_message, sizeof(slot->error_message));
+		found = true;
 	}
-	
-	/* Search through status buffer */
-	for (i = 0; i < state->status_count; i++) {
-		int index = (state->status_head + i) % MAX_COMMANDS;
-		if (state->status_commands[index].timestamp == timestamp) {
-			state->status_commands[index].status = status;
-			if (error_message) {
-				strncpy(state->status_commands[index].error_message, error_message, 
-						sizeof(state->status_commands[index].error_message) - 1);
-				state->status_commands[index].error_message[sizeof(state->status_commands[index].error_message) - 1] = '\0';
-			}
-			return true;
-		}
-	}
-	
-	return false;
+	SpinLockRelease(&state->mutex);
+
+	return found;
+}
+
+/*
+ * Copy every command still holding a slot, oldest first, into buf
+ */
+int
+pgraft_get_command_history(pgraft_command_t *buf, int max_commands)
+{
+	pgraft_worker_state_t *state;
+	uint64		id;
+	int			count = 0;
+
+	state = pgraft_worker_get_state();
+	if (state == NULL)
+		return 0;
+
+	SpinLockAcquire(&state->mutex);
+	for (id = state->oldest_id; id < state->next_id && count < max_commands; id++)
+		pgraft_decode_command(state, &state->slots[id % MAX_COMMANDS], &buf[count++]);
+	SpinLockRelease(&state->mutex);
+
+	return count;
 }
 
 /*
- * Remove completed commands from status buffer
+ * Evict finished commands from the head of the history
  */
 bool
 pgraft_remove_completed_commands(void)
 {
 	pgraft_worker_state_t *state;
-	int removed = 0;
-	int i;
-	
+	pgraft_command_slot_t *slot;
+	int			removed = 0;
+
 	state = pgraft_worker_get_state();
-	if (state == NULL) {
+	if (state == NULL)
 		return false;
+
+	SpinLockAcquire(&state->mutex);
+	while (state->oldest_id < state->next_dequeue_id)
+	{
+		slot = &state->slots[state->oldest_id % MAX_COMMANDS];
+		if (slot->status != COMMAND_STATUS_COMPLETED && slot->status != COMMAND_STATUS_FAILED)
+			break;
+		pgraft_evict_oldest_command(state);
+		removed++;
 	}
-	
-	/* Remove completed and failed commands from status buffer */
-	for (i = 0; i < state->status_count; i++) {
-		int index = (state->status_head + i) % MAX_COMMANDS;
-		COMMAND_STATUS status = state->status_commands[index].status;
-		
-		if (status == COMMAND_STATUS_COMPLETED || status == COMMAND_STATUS_FAILED) {
-			removed++;
-		} else {
-			/* Move command to front if we removed some */
-			if (removed > 0) {
-				int new_index = (state->status_head + i - removed) % MAX_COMMANDS;
-				state->status_commands[new_index] = state->status_commands[index];
-			}
-		}
-	}
-	
-	/* Update status buffer pointers */
-	state->status_head = (state->status_head + removed) % MAX_COMMANDS;
-	state->status_count -= removed;
-	
-	if (removed > 0) {
+	SpinLockRelease(&state->mutex);
+
+	if (removed > 0)
 		elog(LOG, "pgraft: Removed %d completed commands from status buffer", removed);
-	}
-	
+
 	return true;
 }
@@ -74,7 +74,8 @@ typedef enum ramctrl_show_command
 	RAMCTRL_SHOW_REPLICATION,
 	RAMCTRL_SHOW_STATUS,
 	RAMCTRL_SHOW_CONFIG,
-	RAMCTRL_SHOW_LOGS
+	RAMCTRL_SHOW_LOGS,
+	RAMCTRL_SHOW_PERFORMANCE
 } ramctrl_show_command_t;
 
 /* Node subcommands */
@@ -208,6 +209,7 @@ typedef struct ramctrl_context
 	bool quiet;
 	bool force;
 	bool dry_run;
+	bool learner; /* --learner: replica add joins Raft without a vote */
 	ramctrl_command_t command;
 	/* Subcommands */
 	ramctrl_show_command_t show_command;
@@ -220,6 +222,15 @@ typedef struct ramctrl_context
 	char command_args[RAMCTRL_MAX_NODES][RAMCTRL_MAX_HOSTNAME_LENGTH];
 	int command_argc;
 	char postgresql_data_dir[RAMCTRL_MAX_PATH_LENGTH];
+	/* --clusters: list file or glob; the command fans out to every ramd */
+	char clusters[RAMCTRL_MAX_PATH_LENGTH];
+	int parallel;
+	/* ramctrl logs filters: --level, --component, --since, --lines, --follow */
+	char log_level[16];
+	char log_component[64];
+	char log_since[32];
+	int log_lines;
+	bool log_follow;
 } ramctrl_context_t;
 
 /* Function prototypes */
@@ -27,6 +27,8 @@
 
 /* Command Timeouts */
 #define RAMCTRL_DEFAULT_TIMEOUT_SECONDS  30
+#define RAMCTRL_DEFAULT_SOCKET_DIR       "/tmp"
+#define RAMCTRL_SOCKET_NAME              ".s.ramd.%d"	/* ramd's http_port */
 
 /* Replication Defaults */
 #define RAMCTRL_DEFAULT_WAL_E_PATH       NULL	/* Will be set from config */
@@ -35,12 +37,43 @@
 /* Display Defaults */
 #define RAMCTRL_DEFAULT_TABLE_WIDTH      80
 #define RAMCTRL_DEFAULT_REFRESH_INTERVAL 5
+#define RAMCTRL_WATCH_WAIT_MS            25000	/* ramd holds a watch this long */
+#define RAMCTRL_WATCH_RESPONSE_SIZE      16384
+#define RAMCTRL_STATUS_PAGE_POLL_MS      100	/* watch poll of the local page */
+#define RAMCTRL_STATUS_PAGE_MAX_AGE_MS   3000	/* older heartbeat: ramd is gone */
+#define RAMCTRL_JSON_MAX_TOKENS          1024	/* per ramd response parsed */
+
+/* Long-running ramd operations (bootstrap, add replica) run as jobs */
+#define RAMCTRL_JOB_POLL_INTERVAL_MS     1000
+#define RAMCTRL_JOB_WAIT_TIMEOUT_SECONDS 3600
+
+/* ramctrl logs, read from ramd's /api/v1/logs */
+#define RAMCTRL_LOGS_DEFAULT_LINES       50
+#define RAMCTRL_LOGS_MAX_LINES           1000	/* ramd's cap per request */
+#define RAMCTRL_LOGS_FOLLOW_PAGE         64	/* records per follow request */
+#define RAMCTRL_LOGS_RECORD_BYTES        1024	/* response room per record */
+#define RAMCTRL_LOGS_SUMMARY_LINES       100
+
+/* ramctrl show performance, from ramd's /api/v1/metrics/history */
+#define RAMCTRL_HISTORY_POINTS           60	/* one hour of minutes */
+#define RAMCTRL_HISTORY_RESPONSE_SIZE    32768
+
+/* --clusters fan-out */
+#define RAMCTRL_FLEET_DEFAULT_PARALLEL   32
+#define RAMCTRL_FLEET_MAX_PARALLEL       512
+#define RAMCTRL_FLEET_RESPONSE_SIZE      65536
+#define RAMCTRL_FLEET_CONNECT_TIMEOUT_MS 3000
+
+/* Formation plans (node add) */
+#define RAMCTRL_FORMATION_RESPONSE_SIZE     4096
+#define RAMCTRL_FORMATION_CONNECT_TIMEOUT_MS 3000
+#define RAMCTRL_FORMATION_HEALTH_TIMEOUT_MS 5000	/* per health check or notice */
 
 /* Basic Size Constants */
 #define RAMCTRL_MAX_HOSTNAME_LENGTH      256
 #define RAMCTRL_MAX_PATH_LENGTH          512
 #define RAMCTRL_MAX_COMMAND_LENGTH       1024
-#define RAMCTRL_MAX_NODES                16
+#define RAMCTRL_MAX_NODES                64
 
 /* Compatibility macros for code that uses old names */
 #define RAMD_PIDFILE                     RAMCTRL_DEFAULT_RAMD_PIDFILE
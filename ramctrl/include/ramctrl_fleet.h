@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_fleet.h
+ *		Run a read-only command against many clusters at once
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMCTRL_FLEET_H
+#define RAMCTRL_FLEET_H
+
+#include "ramctrl.h"
+
+/*
+ * Query every ramd listed by ctx->clusters, ctx->parallel at a time, and
+ * print one result per cluster as it arrives.  ctx->clusters is a file
+ * with one "[name] url" per line, or a glob of such files.  Supports
+ * status, show cluster and show nodes.  Returns RAMCTRL_EXIT_SUCCESS when
+ * every cluster answered with quorum, RAMCTRL_EXIT_UNAVAILABLE if any
+ * could not be reached, and RAMCTRL_EXIT_FAILURE if all answered but
+ * some are degraded.
+ */
+extern int ramctrl_fleet_run(ramctrl_context_t* ctx);
+
+#endif /* RAMCTRL_FLEET_H */
@@ -0,0 +1,43 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_formation_plan.h
+ *		Join several nodes to a cluster in one round
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMCTRL_FORMATION_PLAN_H
+#define RAMCTRL_FORMATION_PLAN_H
+
+#include "ramctrl.h"
+
+typedef struct ramctrl_formation_node
+{
+	int32_t node_id;
+	char hostname[RAMCTRL_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+} ramctrl_formation_node_t;
+
+/*
+ * Parse "ID HOST PORT" triples from ctx->command_args starting at first.
+ * Returns the number of nodes, or -1 after printing what is wrong.
+ */
+extern int ramctrl_formation_parse_nodes(const ramctrl_context_t* ctx, int first,
+                                         ramctrl_formation_node_t* nodes,
+                                         int max_nodes);
+
+/*
+ * Add nodes to the cluster behind ctx->api_url as one plan: read the
+ * members once, check every new node's ramd at the same time, propose all
+ * of them in a single membership change (one joint-consensus step), then
+ * notify every member at the same time.  Each step's time is reported.
+ * ctx->learner adds them without a vote, ctx->force goes on past failed
+ * health checks and ctx->dry_run stops before the membership change.
+ */
+extern int ramctrl_formation_add_nodes(ramctrl_context_t* ctx,
+                                       const ramctrl_formation_node_t* nodes,
+                                       int count);
+
+#endif /* RAMCTRL_FORMATION_PLAN_H */
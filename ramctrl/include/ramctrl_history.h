@@ -0,0 +1,24 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_history.h
+ *		Recent ramd metrics from its /api/v1/metrics/history rings
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMCTRL_HISTORY_H
+#define RAMCTRL_HISTORY_H
+
+#include <stdbool.h>
+#include "ramctrl.h"
+
+/*
+ * Print the last hour of ramd's metrics history, a row per series with
+ * its latest value, its worst and a sparkline, or the response itself
+ * with --json.  False if ramd could not be asked.
+ */
+extern bool ramctrl_history_print(ramctrl_context_t* ctx);
+
+#endif /* RAMCTRL_HISTORY_H */
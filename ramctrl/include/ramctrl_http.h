@@ -36,8 +36,29 @@ extern int ramctrl_http_init(void);
 extern void ramctrl_http_cleanup(void);
 extern int ramctrl_http_get(const char* url, char* response,
                             size_t response_size);
+/*
+ * GET that may legitimately take up to timeout_ms, for long-polls.  While
+ * it waits keep_waiting is polled about once a second; returning false
+ * abandons the request, and the call then fails.
+ */
+extern int ramctrl_http_get_wait(const char* url, char* response,
+                                 size_t response_size, long timeout_ms,
+                                 bool (*keep_waiting)(void));
+/*
+ * The port of an http:// URL naming this host (localhost, 127.0.0.1 or
+ * [::1]), whose ramd also serves a Unix socket and a status page; -1 for
+ * any other URL.
+ */
+extern int ramctrl_http_local_port(const char* url);
 extern int ramctrl_http_post(const char* url, const char* data, char* response,
                              size_t response_size);
+/*
+ * If response is a ramd job, wait up to timeout_seconds for it to finish
+ * and replace response with the operation's result.  Returns 0 when the
+ * job finished or response was not a job, -1 on timeout.
+ */
+extern int ramctrl_http_wait_job(const char* api_url, char* response,
+                                 size_t response_size, int timeout_seconds);
 extern int ramctrl_parse_cluster_status(const char* json,
                                         ramctrl_cluster_info_t* cluster_info);
 extern int ramctrl_parse_nodes_info(const char* json,
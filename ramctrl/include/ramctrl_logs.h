@@ -0,0 +1,32 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_logs.h
+ *		Recent ramd logs from its /api/v1/logs store
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMCTRL_LOGS_H
+#define RAMCTRL_LOGS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ramctrl.h"
+
+/* Records ramd holds at DEBUG, INFO, NOTICE, WARNING, ERROR and FATAL */
+#define RAMCTRL_LOG_LEVEL_COUNT 6
+
+/*
+ * Print the last ctx->log_lines records matching ctx's --level,
+ * --component and --since, then with --follow every new one until
+ * interrupted.  False if ramd could not be asked.
+ */
+extern bool ramctrl_logs_print(ramctrl_context_t* ctx);
+
+/* Per-level counts of the last lines records ramd holds */
+extern bool ramctrl_logs_counts(ramctrl_context_t* ctx, int lines,
+                                uint64_t counts[RAMCTRL_LOG_LEVEL_COUNT]);
+
+#endif /* RAMCTRL_LOGS_H */
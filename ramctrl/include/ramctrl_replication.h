@@ -77,6 +77,56 @@ typedef struct
 	char replay_lsn[RAMCTRL_MAX_HOSTNAME_LENGTH];       /* Replay LSN */
 } replication_status_t;
 
+/* One pg_stat_replication row; LSNs are byte positions, lag -1 if unknown */
+typedef struct
+{
+	int32_t pid;
+	char application_name[64];
+	char client_addr[64];
+	char state[32];
+	char sync_state[16];
+	int64_t sent_lsn;
+	int64_t write_lsn;
+	int64_t flush_lsn;
+	int64_t replay_lsn;
+	int32_t write_lag_ms;
+	int32_t flush_lag_ms;
+	int32_t replay_lag_ms;
+} replication_standby_t;
+
+/* One pg_replication_slots row; restart_lsn is -1 if the slot has none */
+typedef struct
+{
+	char slot_name[64];
+	char slot_type[16];
+	bool active;
+	int64_t restart_lsn;
+	int64_t retained_bytes; /* WAL held back behind the current position */
+} replication_slot_t;
+
+/* pg_stat_wal_receiver, present only on a streaming standby */
+typedef struct
+{
+	bool present;
+	char status[32];
+	char sender_host[RAMCTRL_MAX_HOSTNAME_LENGTH];
+	int32_t sender_port;
+	char slot_name[64];
+	int64_t latest_end_lsn;
+} replication_wal_receiver_t;
+
+/* Everything "show replication" prints, read in a single roundtrip */
+typedef struct
+{
+	bool in_recovery;
+	int64_t current_lsn; /* insert position, or last replayed on a standby */
+	int32_t standby_count;
+	replication_standby_t standbys[RAMCTRL_MAX_NODES];
+	int32_t slot_count;
+	replication_slot_t slots[RAMCTRL_MAX_NODES];
+	replication_wal_receiver_t wal_receiver;
+} replication_report_t;
+
 /* Replication configuration */
 typedef struct
 {
@@ -90,6 +140,7 @@ typedef struct
 	bool auto_sync_mode;                        /* Auto-sync mode */
 	int sync_timeout_ms;                        /* Sync timeout */
 	bool validate_failover;                     /* Validate before failover */
+	char conninfo[RAMCTRL_MAX_COMMAND_LENGTH];  /* Empty uses libpq PG* env */
 } replication_config_t;
 
 /* Function declarations */
@@ -101,6 +152,15 @@ bool ramctrl_replication_update_lag_config(
 bool ramctrl_replication_validate_failover(int64_t lag_bytes);
 bool ramctrl_replication_trigger_sync_switch(void);
 
+/*
+ * Read pg_stat_replication, pg_replication_slots and pg_stat_wal_receiver
+ * in one roundtrip over a connection kept open between calls.  Works
+ * before ramctrl_replication_init(), using libpq's environment defaults.
+ */
+bool ramctrl_replication_collect(replication_report_t* report);
+void ramctrl_replication_disconnect(void);
+const char* ramctrl_replication_last_error(void);
+
 /* WAL-E integration functions */
 bool ramctrl_wal_e_init(wal_e_config_t* config);
 bool ramctrl_wal_e_create_backup(void);
@@ -119,5 +179,6 @@ replication_mode_t ramctrl_replication_string_to_mode(const char* mode_str);
 bool ramctrl_replication_is_sync_mode(replication_mode_t mode);
 int64_t ramctrl_replication_calculate_lag(const char* sent_lsn,
                                           const char* replay_lsn);
+int64_t ramctrl_replication_parse_lsn(const char* lsn);
 
 #endif /* RAMCTRL_REPLICATION_H */
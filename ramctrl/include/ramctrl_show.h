@@ -12,6 +12,7 @@
 #define RAMCTRL_SHOW_H
 
 #include "ramctrl.h"
+#include "ramctrl_replication.h"
 
 /* Enhanced show command functions */
 int ramctrl_show_cluster_detailed(ramctrl_context_t* ctx);
@@ -28,11 +29,11 @@ int ramctrl_show_performance(ramctrl_context_t* ctx);
 /* Show output formatting functions */
 void ramctrl_show_format_cluster_table(ramctrl_cluster_info_t* cluster);
 void ramctrl_show_format_nodes_table(ramctrl_node_info_t* nodes, int count);
-void ramctrl_show_format_replication_table(ramctrl_context_t* ctx);
+void ramctrl_show_format_replication_table(const replication_report_t* report);
 
 /* JSON output functions */
 void ramctrl_show_cluster_json(ramctrl_cluster_info_t* cluster);
 void ramctrl_show_nodes_json(ramctrl_node_info_t* nodes, int count);
-void ramctrl_show_replication_json(ramctrl_context_t* ctx);
+void ramctrl_show_replication_json(const replication_report_t* report);
 
 #endif /* RAMCTRL_SHOW_H */
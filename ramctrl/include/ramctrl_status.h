@@ -0,0 +1,36 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_status.h
+ *		Cluster view from the local ramd's shared-memory status page
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMCTRL_STATUS_H
+#define RAMCTRL_STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ramctrl.h"
+
+/* A cluster view read from a status page */
+typedef struct ramctrl_status_view
+{
+	unsigned long long epoch;
+	unsigned long long version;
+	ramctrl_cluster_info_t cluster_info;
+	ramctrl_node_info_t nodes[RAMCTRL_MAX_NODES];
+	int32_t node_count;
+} ramctrl_status_view_t;
+
+/*
+ * Read the view from the status page of the ramd behind api_url without
+ * a request.  False when api_url is not a local http:// URL, that ramd
+ * publishes no page or has stopped refreshing it, or RAMCTRL_STATUS_PAGE
+ * is set to 0; the caller then asks the HTTP API instead.
+ */
+extern bool ramctrl_status_read(const char* api_url, ramctrl_status_view_t* view);
+
+#endif /* RAMCTRL_STATUS_H */
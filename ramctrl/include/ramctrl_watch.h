@@ -36,6 +36,11 @@ typedef struct ramctrl_watch_data
 	ramctrl_node_info_t nodes[RAMCTRL_MAX_NODES];
 	int32_t node_count;
 	char status_message[RAMCTRL_MAX_HOSTNAME_LENGTH];
+	/* Position in ramd's change feed; has_version false asks for everything */
+	bool has_version;
+	unsigned long long epoch;
+	unsigned long long version;
+	bool changed; /* the last update carried a change */
 } ramctrl_watch_data_t;
 
 /* Watch mode statistics */
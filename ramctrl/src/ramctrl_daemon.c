@@ -29,6 +29,8 @@
 #include "ramctrl_defaults.h"
 #include "ramctrl_help.h"
 #include "ramctrl_http.h"
+#include "ramctrl_logs.h"
+#include "ramctrl_show.h"
 #include "ramctrl_watch.h"
 
 
@@ -504,24 +506,10 @@ int ramctrl_cmd_disable_maintenance(ramctrl_context_t* ctx)
 
 int ramctrl_cmd_logs(ramctrl_context_t* ctx)
 {
-	char log_output[4096];
-
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
-	if (ramctrl_daemon_get_logs(ctx, log_output, sizeof(log_output), 50))
-	{
-		printf("%s", log_output);
-	}
-	else
-	{
-		snprintf(log_output, sizeof(log_output),
-		         "tail -n 50 %s 2>/dev/null || echo 'Log file not accessible'",
-		         (char*)RAMD_LOGFILE);
-		system(log_output);
-	}
-
-	return RAMCTRL_EXIT_SUCCESS;
+	return ramctrl_logs_print(ctx) ? RAMCTRL_EXIT_SUCCESS : RAMCTRL_EXIT_FAILURE;
 }
 
 
@@ -541,13 +529,7 @@ int ramctrl_cmd_show_replication(ramctrl_context_t* ctx)
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
-	ramctrl_table_print_header("Replication Status");
-	ramctrl_table_print_row("Mode", "Async");
-	ramctrl_table_print_row("Lag", "0 MB");
-	ramctrl_table_print_row("Status", "Streaming");
-	ramctrl_table_print_footer();
-
-	return RAMCTRL_EXIT_SUCCESS;
+	return ramctrl_show_replication_detailed(ctx);
 }
 
 
@@ -711,8 +693,8 @@ int ramctrl_cmd_bootstrap_run(ramctrl_context_t* ctx)
 	         api_url);
 
 	/* Make HTTP POST request to ramd bootstrap API */
-	if (!ramctrl_http_post(full_url, "", response_buffer,
-	                       sizeof(response_buffer)))
+	if (ramctrl_http_post(full_url, "", response_buffer,
+	                      sizeof(response_buffer)) != 0)
 	{
 		printf("ramctrl: failed to connect to ramd daemon\n");
 		printf("ramctrl: ensure ramd is running and accessible at %s\n",
@@ -721,6 +703,13 @@ int ramctrl_cmd_bootstrap_run(ramctrl_context_t* ctx)
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
+	/* ramd answers at once with a job; initdb and startup run behind it */
+	if (ctx->verbose)
+		printf("ramctrl: waiting for bootstrap to finish...\n");
+	if (ramctrl_http_wait_job(api_url, response_buffer, sizeof(response_buffer),
+	                          RAMCTRL_JOB_WAIT_TIMEOUT_SECONDS) != 0)
+		return RAMCTRL_EXIT_TIMEOUT;
+
 	/* Parse and display response */
 	if (strstr(response_buffer, "\"status\": \"success\""))
 	{
@@ -821,6 +810,8 @@ int ramctrl_cmd_show(ramctrl_context_t* ctx)
 		return RAMCTRL_EXIT_SUCCESS;
 	case RAMCTRL_SHOW_LOGS:
 		return ramctrl_cmd_logs(ctx);
+	case RAMCTRL_SHOW_PERFORMANCE:
+		return ramctrl_show_performance(ctx);
 	case RAMCTRL_SHOW_UNKNOWN:
 	default:
 		ramctrl_show_help();
@@ -837,7 +828,7 @@ int ramctrl_cmd_node(ramctrl_context_t* ctx)
 	switch (ctx->node_command)
 	{
 	case RAMCTRL_NODE_ADD:
-		return ramctrl_cmd_add_node(ctx, "postgres", "127.0.0.1", 5432);
+		return ramctrl_cmd_add_node(ctx, NULL, NULL, 0);
 	case RAMCTRL_NODE_REMOVE:
 		return ramctrl_cmd_remove_node(ctx, "postgres");
 	case RAMCTRL_NODE_LIST:
@@ -938,11 +929,11 @@ int ramctrl_cmd_add_replica(ramctrl_context_t* ctx)
 	if (ctx->verbose)
 		printf("ramctrl: adding replica to cluster...\n");
 
-	/* Parse arguments: ramctrl replica add <hostname> [port] */
+	/* Parse arguments: ramctrl replica add <hostname> [port] [--learner] */
 	if (ctx->command_argc < 1)
 	{
 		printf("ramctrl: replica add requires hostname\n");
-		printf("Usage: ramctrl replica add <hostname> [port]\n");
+		printf("Usage: ramctrl replica add <hostname> [port] [--learner]\n");
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
@@ -963,9 +954,10 @@ int ramctrl_cmd_add_replica(ramctrl_context_t* ctx)
 	         "{\n"
 	         "  \"hostname\": \"%s\",\n"
 	         "  \"port\": %d,\n"
-	         "  \"role\": \"replica\"\n"
+	         "  \"role\": \"replica\",\n"
+	         "  \"voting\": %s\n"
 	         "}",
-	         hostname, port);
+	         hostname, port, ctx->learner ? "false" : "true");
 
 	/* Get ramd API URL */
 	const char* api_url = getenv("RAMCTRL_API_URL");
@@ -982,8 +974,8 @@ int ramctrl_cmd_add_replica(ramctrl_context_t* ctx)
 	snprintf(full_url, sizeof(full_url), "%s/api/v1/replica/add", api_url);
 
 	/* Call ramd HTTP API */
-	if (!ramctrl_http_post(full_url, json_payload, response_buffer,
-	                       sizeof(response_buffer)))
+	if (ramctrl_http_post(full_url, json_payload, response_buffer,
+	                      sizeof(response_buffer)) != 0)
 	{
 		printf("ramctrl: failed to connect to ramd daemon\n");
 		printf("ramctrl: ensure ramd is running and accessible at %s\n",
@@ -991,6 +983,12 @@ int ramctrl_cmd_add_replica(ramctrl_context_t* ctx)
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
+	/* The base backup runs as a ramd job; follow it to the end */
+	printf("ramctrl: waiting for replica %s:%d to be set up...\n", hostname, port);
+	if (ramctrl_http_wait_job(api_url, response_buffer, sizeof(response_buffer),
+	                          RAMCTRL_JOB_WAIT_TIMEOUT_SECONDS) != 0)
+		return RAMCTRL_EXIT_TIMEOUT;
+
 	/* Parse response */
 	if (strstr(response_buffer, "\"status\": \"success\""))
 	{
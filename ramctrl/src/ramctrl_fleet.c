@@ -0,0 +1,621 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_fleet.c
+ *		Run a read-only command against many clusters at once
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Every endpoint is fetched through one curl multi handle with at most
+ * ctx->parallel transfers in flight.  Each slot keeps its easy handle, so
+ * a cluster's second request (show nodes) rides the connection its first
+ * one opened, and results are printed the moment a cluster completes
+ * rather than in list order.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include "ramctrl_fleet.h"
+#include "ramctrl_http.h"
+#include "ramctrl_defaults.h"
+#include "ram_json.h"
+
+typedef struct ramctrl_fleet_target
+{
+	char name[RAMCTRL_MAX_HOSTNAME_LENGTH];
+	char url[RAMCTRL_MAX_PATH_LENGTH];
+} ramctrl_fleet_target_t;
+
+typedef struct ramctrl_fleet_list
+{
+	ramctrl_fleet_target_t* items;
+	int count;
+	int capacity;
+} ramctrl_fleet_list_t;
+
+typedef enum
+{
+	RAMCTRL_FLEET_STAGE_STATUS = 0,
+	RAMCTRL_FLEET_STAGE_NODES
+} ramctrl_fleet_stage_t;
+
+/* One cluster in flight; the easy handle is reused for the next one */
+typedef struct ramctrl_fleet_slot
+{
+	CURL* easy;
+	bool busy;
+	const ramctrl_fleet_target_t* target;
+	ramctrl_fleet_stage_t stage;
+	char* body;
+	size_t body_len;
+	bool overflow;
+	double elapsed_ms;
+	ramctrl_cluster_info_t cluster;
+} ramctrl_fleet_slot_t;
+
+typedef struct ramctrl_fleet_totals
+{
+	int healthy;
+	int degraded;
+	int unreachable;
+} ramctrl_fleet_totals_t;
+
+
+static bool ramctrl_fleet_add(ramctrl_fleet_list_t* list, const char* name,
+                              const char* url)
+{
+	ramctrl_fleet_target_t* target;
+	const char* host;
+	size_t len;
+
+	if (list->count == list->capacity)
+	{
+		int capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+		ramctrl_fleet_target_t* items =
+		    realloc(list->items, (size_t) capacity * sizeof(*items));
+
+		if (!items)
+			return false;
+		list->items = items;
+		list->capacity = capacity;
+	}
+
+	target = &list->items[list->count++];
+	snprintf(target->url, sizeof(target->url), "%s", url);
+	len = strlen(target->url);
+	while (len > 0 && target->url[len - 1] == '/')
+		target->url[--len] = '\0';
+
+	if (name)
+	{
+		snprintf(target->name, sizeof(target->name), "%s", name);
+		return true;
+	}
+
+	/* Unnamed: call it by host:port */
+	host = strstr(target->url, "://");
+	host = host ? host + 3 : target->url;
+	len = strcspn(host, "/");
+	if (len >= sizeof(target->name))
+		len = sizeof(target->name) - 1;
+	memcpy(target->name, host, len);
+	target->name[len] = '\0';
+	return true;
+}
+
+
+/* One "[name] url" per line; blank lines and # comments are skipped */
+static bool ramctrl_fleet_load_file(ramctrl_fleet_list_t* list,
+                                    const char* path)
+{
+	char line[RAMCTRL_MAX_PATH_LENGTH * 2];
+	FILE* fp;
+	int lineno = 0;
+
+	fp = fopen(path, "r");
+	if (!fp)
+	{
+		fprintf(stderr, "ramctrl: cannot open %s: %s\n", path,
+		        strerror(errno));
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), fp))
+	{
+		char* fields[3];
+		char* p = line;
+		char* url;
+		int n = 0;
+
+		lineno++;
+		p[strcspn(p, "#")] = '\0';
+
+		while (n < 3)
+		{
+			while (isspace((unsigned char) *p))
+				p++;
+			if (*p == '\0')
+				break;
+			fields[n++] = p;
+			while (*p && !isspace((unsigned char) *p))
+				p++;
+			if (*p)
+				*p++ = '\0';
+		}
+		if (n == 0)
+			continue;
+
+		url = fields[n - 1];
+		if (n > 2 || (strncmp(url, "http://", 7) != 0 &&
+		              strncmp(url, "https://", 8) != 0))
+		{
+			fprintf(stderr,
+			        "ramctrl: %s:%d: expected \"[name] http(s)://host:port\"\n",
+			        path, lineno);
+			continue;
+		}
+		/* Cut short, a URL would send the query somewhere else */
+		if (strlen(url) >= RAMCTRL_MAX_PATH_LENGTH ||
+		    (n == 2 && strlen(fields[0]) >= RAMCTRL_MAX_HOSTNAME_LENGTH))
+		{
+			fprintf(stderr, "ramctrl: %s:%d: name or URL too long\n", path, lineno);
+			continue;
+		}
+		if (!ramctrl_fleet_add(list, n == 2 ? fields[0] : NULL, url))
+		{
+			fclose(fp);
+			fprintf(stderr, "ramctrl: out of memory reading %s\n", path);
+			return false;
+		}
+	}
+
+	fclose(fp);
+	return true;
+}
+
+
+static bool ramctrl_fleet_load(ramctrl_fleet_list_t* list, const char* source)
+{
+	glob_t matches;
+	size_t i;
+
+	if (!strpbrk(source, "*?["))
+		return ramctrl_fleet_load_file(list, source);
+
+	if (glob(source, 0, NULL, &matches) != 0)
+	{
+		fprintf(stderr, "ramctrl: no files match %s\n", source);
+		return false;
+	}
+
+	/* An unreadable file is reported and the rest are still used */
+	for (i = 0; i < matches.gl_pathc; i++)
+		ramctrl_fleet_load_file(list, matches.gl_pathv[i]);
+
+	globfree(&matches);
+	return true;
+}
+
+
+/* Commands that only read, and so make sense across a fleet */
+static bool ramctrl_fleet_command_supported(const ramctrl_context_t* ctx,
+                                            bool* want_nodes)
+{
+	*want_nodes = false;
+
+	switch (ctx->command)
+	{
+	case RAMCTRL_CMD_UNKNOWN:
+	case RAMCTRL_CMD_STATUS:
+		return true;
+	case RAMCTRL_CMD_SHOW:
+		if (ctx->show_command == RAMCTRL_SHOW_NODES)
+		{
+			*want_nodes = true;
+			return true;
+		}
+		return ctx->show_command == RAMCTRL_SHOW_CLUSTER ||
+		       ctx->show_command == RAMCTRL_SHOW_STATUS ||
+		       ctx->show_command == RAMCTRL_SHOW_UNKNOWN;
+	default:
+		return false;
+	}
+}
+
+
+static size_t ramctrl_fleet_write(void* contents, size_t size, size_t nmemb,
+                                  void* userp)
+{
+	ramctrl_fleet_slot_t* slot = (ramctrl_fleet_slot_t*) userp;
+	size_t realsize = size * nmemb;
+
+	if (realsize >= RAMCTRL_FLEET_RESPONSE_SIZE - slot->body_len)
+	{
+		slot->overflow = true;
+		return 0;
+	}
+
+	memcpy(slot->body + slot->body_len, contents, realsize);
+	slot->body_len += realsize;
+	slot->body[slot->body_len] = '\0';
+	return realsize;
+}
+
+
+static bool ramctrl_fleet_start(const ramctrl_context_t* ctx, CURLM* multi,
+                                ramctrl_fleet_slot_t* slot,
+                                const ramctrl_fleet_target_t* target,
+                                ramctrl_fleet_stage_t stage)
+{
+	char url[RAMCTRL_MAX_PATH_LENGTH + 32];
+
+	if (stage == RAMCTRL_FLEET_STAGE_STATUS)
+	{
+		slot->target = target;
+		slot->elapsed_ms = 0;
+		memset(&slot->cluster, 0, sizeof(slot->cluster));
+	}
+	slot->stage = stage;
+	slot->body_len = 0;
+	slot->body[0] = '\0';
+	slot->overflow = false;
+
+	snprintf(url, sizeof(url), "%s%s", target->url,
+	         stage == RAMCTRL_FLEET_STAGE_STATUS ? "/api/v1/cluster/status"
+	                                             : "/api/v1/nodes");
+
+	curl_easy_reset(slot->easy);
+	curl_easy_setopt(slot->easy, CURLOPT_URL, url);
+	curl_easy_setopt(slot->easy, CURLOPT_WRITEFUNCTION, ramctrl_fleet_write);
+	curl_easy_setopt(slot->easy, CURLOPT_WRITEDATA, slot);
+	curl_easy_setopt(slot->easy, CURLOPT_TIMEOUT, (long) ctx->timeout_seconds);
+	curl_easy_setopt(slot->easy, CURLOPT_CONNECTTIMEOUT_MS,
+	                 (long) RAMCTRL_FLEET_CONNECT_TIMEOUT_MS);
+	curl_easy_setopt(slot->easy, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(slot->easy, CURLOPT_USERAGENT, "ramctrl/1.0");
+	curl_easy_setopt(slot->easy, CURLOPT_TCP_KEEPALIVE, 1L);
+
+	slot->busy = curl_multi_add_handle(multi, slot->easy) == CURLM_OK;
+	return slot->busy;
+}
+
+
+static void ramctrl_fleet_print_header(const ramctrl_context_t* ctx,
+                                       bool want_nodes)
+{
+	if (ctx->json_output)
+		return;
+
+	if (want_nodes)
+		printf("%-20s %5s %-28s %5s %-8s %-7s %8s\n", "CLUSTER", "NODE",
+		       "HOSTNAME", "PORT", "ROLE", "HEALTHY", "LAG_MS");
+	else
+		printf("%-20s %-32s %-11s %7s %5s %7s %6s %7s  %s\n", "CLUSTER",
+		       "ENDPOINT", "STATE", "PRIMARY", "NODES", "HEALTHY", "QUORUM",
+		       "MS", "ERROR");
+	fflush(stdout);
+}
+
+
+static bool ramctrl_fleet_stdout(void* context, const char* data,
+                                 size_t length)
+{
+	(void) context;
+	return fwrite(data, 1, length, stdout) == length;
+}
+
+
+/* One JSON object per line, so the stream can be consumed as it comes */
+static void ramctrl_fleet_print_json(const ramctrl_fleet_slot_t* slot,
+                                     const char* state, const char* error,
+                                     const ramctrl_node_info_t* nodes,
+                                     int node_count, bool want_nodes)
+{
+	const ramctrl_cluster_info_t* info = &slot->cluster;
+	char buf[4096];
+	ram_json_writer_t w;
+	bool ok;
+	int i;
+
+	ram_json_writer_init(&w, buf, sizeof(buf), ramctrl_fleet_stdout, NULL);
+	ok = ram_json_object_begin(&w) &&
+	     ram_json_kv_string(&w, "cluster", slot->target->name) &&
+	     ram_json_kv_string(&w, "endpoint", slot->target->url) &&
+	     ram_json_kv_string(&w, "state", state) &&
+	     ram_json_kv_double(&w, "elapsed_ms", slot->elapsed_ms, 1);
+
+	if (ok && error)
+		ok = ram_json_kv_string(&w, "error", error);
+	else if (ok)
+		ok = ram_json_kv_string(&w, "cluster_name", info->cluster_name) &&
+		     ram_json_kv_int(&w, "primary_node_id", info->primary_node_id) &&
+		     ram_json_kv_int(&w, "leader_node_id", info->leader_node_id) &&
+		     ram_json_kv_int(&w, "total_nodes", info->total_nodes) &&
+		     ram_json_kv_int(&w, "active_nodes", info->active_nodes) &&
+		     ram_json_kv_bool(&w, "has_quorum", info->has_quorum);
+
+	if (ok && !error && want_nodes)
+	{
+		ok = ram_json_key(&w, "nodes") && ram_json_array_begin(&w);
+		for (i = 0; ok && i < node_count; i++)
+			ok = ram_json_object_begin(&w) &&
+			     ram_json_kv_int(&w, "node_id", nodes[i].node_id) &&
+			     ram_json_kv_string(&w, "hostname", nodes[i].hostname) &&
+			     ram_json_kv_int(&w, "port", nodes[i].port) &&
+			     ram_json_kv_bool(&w, "is_primary", nodes[i].is_primary) &&
+			     ram_json_kv_bool(&w, "is_healthy", nodes[i].is_healthy) &&
+			     ram_json_kv_int(&w, "replication_lag_ms",
+			                     nodes[i].replication_lag_ms) &&
+			     ram_json_object_end(&w);
+		ok = ok && ram_json_array_end(&w);
+	}
+
+	ok = ok && ram_json_object_end(&w) && ram_json_writer_finish(&w);
+	if (ok)
+		putchar('\n');
+	fflush(stdout);
+}
+
+
+static void ramctrl_fleet_print_table(const ramctrl_fleet_slot_t* slot,
+                                      const char* state, const char* error,
+                                      const ramctrl_node_info_t* nodes,
+                                      int node_count, bool want_nodes)
+{
+	const ramctrl_cluster_info_t* info = &slot->cluster;
+	int i;
+
+	if (want_nodes && !error)
+	{
+		for (i = 0; i < node_count; i++)
+			printf("%-20s %5d %-28s %5d %-8s %-7s %8d\n", slot->target->name,
+			       nodes[i].node_id, nodes[i].hostname, nodes[i].port,
+			       nodes[i].is_primary ? "primary" : "standby",
+			       nodes[i].is_healthy ? "yes" : "no",
+			       nodes[i].replication_lag_ms);
+	}
+	else if (want_nodes)
+		printf("%-20s %5s %-28s %5s %-8s %-7s %8s  %s\n", slot->target->name,
+		       "-", "-", "-", "-", "-", "-", error);
+	else if (error)
+		printf("%-20s %-32s %-11s %7s %5s %7s %6s %7.0f  %s\n",
+		       slot->target->name, slot->target->url, state, "-", "-", "-",
+		       "-", slot->elapsed_ms, error);
+	else
+		printf("%-20s %-32s %-11s %7d %5d %7d %6s %7.0f\n",
+		       slot->target->name, slot->target->url, state,
+		       info->primary_node_id, info->total_nodes, info->active_nodes,
+		       info->has_quorum ? "yes" : "no", slot->elapsed_ms);
+	fflush(stdout);
+}
+
+
+/*
+ * A transfer on slot finished.  Returns true if the slot went on to its
+ * cluster's next request, false once the cluster has been reported.
+ */
+static bool ramctrl_fleet_complete(const ramctrl_context_t* ctx, CURLM* multi,
+                                   ramctrl_fleet_slot_t* slot, CURLcode result,
+                                   bool want_nodes,
+                                   ramctrl_fleet_totals_t* totals)
+{
+	ramctrl_node_info_t nodes[RAMCTRL_MAX_NODES];
+	int node_count = 0;
+	char error[RAMCTRL_MAX_HOSTNAME_LENGTH] = "";
+	const char* state;
+	double seconds = 0;
+	long code = 0;
+
+	slot->busy = false;
+	curl_easy_getinfo(slot->easy, CURLINFO_RESPONSE_CODE, &code);
+	curl_easy_getinfo(slot->easy, CURLINFO_TOTAL_TIME, &seconds);
+	slot->elapsed_ms += seconds * 1000.0;
+
+	if (slot->overflow)
+		snprintf(error, sizeof(error), "response larger than %d bytes",
+		         RAMCTRL_FLEET_RESPONSE_SIZE);
+	else if (result != CURLE_OK)
+		snprintf(error, sizeof(error), "%s", curl_easy_strerror(result));
+	else if (code != 200)
+		snprintf(error, sizeof(error), "HTTP %ld", code);
+	else if (slot->stage == RAMCTRL_FLEET_STAGE_STATUS)
+	{
+		if (ramctrl_parse_cluster_status(slot->body, &slot->cluster) != 0)
+			snprintf(error, sizeof(error), "unreadable cluster status");
+		else if (want_nodes &&
+		         ramctrl_fleet_start(ctx, multi, slot, slot->target,
+		                             RAMCTRL_FLEET_STAGE_NODES))
+			return true;
+		else if (want_nodes)
+			snprintf(error, sizeof(error), "could not queue nodes request");
+	}
+	else if (ramctrl_parse_nodes_info(slot->body, nodes, &node_count) != 0)
+		snprintf(error, sizeof(error), "unreadable node list");
+
+	if (error[0])
+	{
+		state = "unreachable";
+		totals->unreachable++;
+	}
+	else if (slot->cluster.has_quorum)
+	{
+		state = "healthy";
+		totals->healthy++;
+	}
+	else
+	{
+		state = "degraded";
+		totals->degraded++;
+	}
+
+	if (ctx->json_output)
+		ramctrl_fleet_print_json(slot, state, error[0] ? error : NULL, nodes,
+		                         node_count, want_nodes);
+	else
+		ramctrl_fleet_print_table(slot, state, error[0] ? error : NULL, nodes,
+		                          node_count, want_nodes);
+	return false;
+}
+
+
+int ramctrl_fleet_run(ramctrl_context_t* ctx)
+{
+	ramctrl_fleet_list_t list = {NULL, 0, 0};
+	ramctrl_fleet_totals_t totals = {0, 0, 0};
+	ramctrl_fleet_slot_t* slots = NULL;
+	struct timespec started;
+	struct timespec finished;
+	CURLM* multi = NULL;
+	bool want_nodes;
+	int parallel;
+	int next = 0;
+	int active = 0;
+	int result = RAMCTRL_EXIT_FAILURE;
+	int i;
+
+	if (!ramctrl_fleet_command_supported(ctx, &want_nodes))
+	{
+		fprintf(stderr, "ramctrl: --clusters supports status, show cluster "
+		                "and show nodes only\n");
+		return RAMCTRL_EXIT_USAGE;
+	}
+
+	if (!ramctrl_fleet_load(&list, ctx->clusters) || list.count == 0)
+	{
+		if (list.count == 0)
+			fprintf(stderr, "ramctrl: no clusters listed in %s\n", ctx->clusters);
+		free(list.items);
+		return RAMCTRL_EXIT_NOENT;
+	}
+
+	if (ramctrl_http_init() != 0)
+	{
+		free(list.items);
+		return RAMCTRL_EXIT_FAILURE;
+	}
+
+	parallel = ctx->parallel > 0 ? ctx->parallel : RAMCTRL_FLEET_DEFAULT_PARALLEL;
+	if (parallel > list.count)
+		parallel = list.count;
+
+	slots = calloc((size_t) parallel, sizeof(*slots));
+	multi = curl_multi_init();
+	if (!slots || !multi)
+	{
+		fprintf(stderr, "ramctrl: out of memory starting fleet query\n");
+		goto done;
+	}
+
+	/* Keep every slot's connection cached between its requests */
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long) parallel);
+
+	for (i = 0; i < parallel; i++)
+	{
+		slots[i].body = malloc(RAMCTRL_FLEET_RESPONSE_SIZE);
+		slots[i].easy = curl_easy_init();
+		if (!slots[i].body || !slots[i].easy)
+		{
+			fprintf(stderr, "ramctrl: out of memory starting fleet query\n");
+			goto done;
+		}
+	}
+
+	ramctrl_fleet_print_header(ctx, want_nodes);
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
+	for (i = 0; i < parallel; i++)
+	{
+		if (ramctrl_fleet_start(ctx, multi, &slots[i], &list.items[next++],
+		                        RAMCTRL_FLEET_STAGE_STATUS))
+			active++;
+	}
+
+	while (active > 0)
+	{
+		CURLMsg* msg;
+		int running;
+		int queued;
+
+		curl_multi_perform(multi, &running);
+
+		while ((msg = curl_multi_info_read(multi, &queued)) != NULL)
+		{
+			ramctrl_fleet_slot_t* slot = NULL;
+			CURLcode code = msg->data.result;
+			CURL* easy = msg->easy_handle;
+
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+
+			for (i = 0; i < parallel && !slot; i++)
+				if (slots[i].easy == easy)
+					slot = &slots[i];
+			if (!slot)
+				continue;
+
+			curl_multi_remove_handle(multi, easy);
+			if (ramctrl_fleet_complete(ctx, multi, slot, code, want_nodes,
+			                           &totals))
+				continue;
+
+			/* Hand the slot to the next cluster waiting, if any */
+			active--;
+			while (next < list.count)
+			{
+				if (ramctrl_fleet_start(ctx, multi, slot, &list.items[next++],
+				                        RAMCTRL_FLEET_STAGE_STATUS))
+				{
+					active++;
+					break;
+				}
+			}
+		}
+
+		if (active > 0)
+			curl_multi_poll(multi, NULL, 0, 1000, NULL);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &finished);
+
+	/* Clusters that could not be queued at all count as unreachable */
+	totals.unreachable = list.count - totals.healthy - totals.degraded;
+	if (!ctx->quiet)
+		fprintf(ctx->json_output ? stderr : stdout,
+		        "%s%d clusters: %d healthy, %d degraded, %d unreachable in %.1fs\n",
+		        ctx->json_output ? "" : "\n", list.count, totals.healthy,
+		        totals.degraded, totals.unreachable,
+		        (double) (finished.tv_sec - started.tv_sec) +
+		            (double) (finished.tv_nsec - started.tv_nsec) / 1e9);
+
+	if (totals.unreachable > 0)
+		result = RAMCTRL_EXIT_UNAVAILABLE;
+	else if (totals.degraded > 0)
+		result = RAMCTRL_EXIT_FAILURE;
+	else
+		result = RAMCTRL_EXIT_SUCCESS;
+
+done:
+	for (i = 0; slots && i < parallel; i++)
+	{
+		if (slots[i].easy)
+		{
+			if (slots[i].busy)
+				curl_multi_remove_handle(multi, slots[i].easy);
+			curl_easy_cleanup(slots[i].easy);
+		}
+		free(slots[i].body);
+	}
+	if (multi)
+		curl_multi_cleanup(multi);
+	free(slots);
+	free(list.items);
+	return result;
+}
@@ -14,6 +14,7 @@
 
 #include "ramctrl.h"
 #include "ramctrl_formation.h"
+#include "ramctrl_formation_plan.h"
 
 /* Function declarations */
 static bool cluster_exists(const char *cluster_name);
@@ -45,9 +46,24 @@ ramctrl_cmd_create_cluster(ramctrl_context_t *ctx, const char *cluster_name)
 	}
 
 	printf("ramctrl: Creating cluster '%s'\n", actual_cluster_name);
-	
-	/* Implement actual cluster creation logic */
-	
+
+	/*
+	 * The cluster is the bootstrapped primary behind ctx->api_url; the
+	 * other nodes listed as NODE_ID HOST PORT join it in one plan
+	 */
+	if (ctx->command_argc > 0)
+	{
+		ramctrl_formation_node_t nodes[RAMCTRL_MAX_NODES];
+		int			count = ramctrl_formation_parse_nodes(ctx, 0, nodes, RAMCTRL_MAX_NODES);
+		int			rc;
+
+		if (count < 0)
+			return RAMCTRL_EXIT_USAGE;
+		rc = ramctrl_formation_add_nodes(ctx, nodes, count);
+		if (rc != RAMCTRL_EXIT_SUCCESS)
+			return rc;
+	}
+
 	printf("ramctrl: Cluster '%s' created successfully\n", actual_cluster_name);
 	return RAMCTRL_EXIT_SUCCESS;
 }
@@ -86,14 +102,19 @@ ramctrl_cmd_delete_cluster(ramctrl_context_t *ctx, const char *cluster_name)
 	return RAMCTRL_EXIT_SUCCESS;
 }
 
+/*
+ * ramctrl node add NODE_ID HOST PORT [NODE_ID HOST PORT ...]
+ *
+ * Every node listed joins in one plan: their ramds are checked at once and
+ * the cluster takes them all in a single membership change.  node_name,
+ * when given, is the id of one node to add at node_address:node_port.
+ */
 int
 ramctrl_cmd_add_node(ramctrl_context_t *ctx, const char *node_name, 
                      const char *node_address, int node_port)
 {
-	const char *actual_cluster_name = "default";
-	const char *actual_node_name;
-	const char *actual_node_address;
-	int			actual_node_port;
+	ramctrl_formation_node_t nodes[RAMCTRL_MAX_NODES];
+	int			count;
 
 	if (!ctx)
 	{
@@ -101,36 +122,33 @@ ramctrl_cmd_add_node(ramctrl_context_t *ctx, const char *node_name,
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
-	/* Use provided values or defaults */
-	actual_node_name = node_name ? node_name : "new_node";
-	actual_node_address = node_address ? node_address : "127.0.0.1";
-	actual_node_port = node_port ? node_port : 5432;
-
-	if (strlen(actual_node_name) == 0)
+	if (node_name)
 	{
-		printf("ramctrl: Node name is required\n");
-		return RAMCTRL_EXIT_FAILURE;
+		nodes[0].node_id = atoi(node_name);
+		snprintf(nodes[0].hostname, sizeof(nodes[0].hostname), "%s",
+				 node_address ? node_address : "");
+		nodes[0].port = node_port;
+		if (nodes[0].node_id <= 0 || nodes[0].hostname[0] == '\0' || node_port <= 0)
+		{
+			printf("ramctrl: Node id, address and port are required\n");
+			return RAMCTRL_EXIT_USAGE;
+		}
+		count = 1;
 	}
-
-	if (strlen(actual_node_address) == 0)
+	else
 	{
-		printf("ramctrl: Node address is required\n");
-		return RAMCTRL_EXIT_FAILURE;
+		count = ramctrl_formation_parse_nodes(ctx, 0, nodes, RAMCTRL_MAX_NODES);
+		if (count < 0)
+		{
+			printf("Usage: ramctrl node add NODE_ID HOST PORT [NODE_ID HOST PORT ...] [--learner]\n");
+			return RAMCTRL_EXIT_USAGE;
+		}
 	}
 
-	if (!cluster_exists(actual_cluster_name))
-	{
-		printf("ramctrl: Cluster '%s' does not exist\n", actual_cluster_name);
-		return RAMCTRL_EXIT_FAILURE;
-	}
+	if (!ctx->quiet && !ctx->json_output)
+		printf("ramctrl: Adding %d node(s) to the cluster at %s\n", count, ctx->api_url);
 
-	printf("ramctrl: Adding node '%s' to cluster '%s'\n", actual_node_name, actual_cluster_name);
-	printf("ramctrl: Node address: %s, port: %d\n", actual_node_address, actual_node_port);
-	
-	/* Implement actual node addition logic */
-	
-	printf("ramctrl: Node '%s' added successfully\n", actual_node_name);
-	return RAMCTRL_EXIT_SUCCESS;
+	return ramctrl_formation_add_nodes(ctx, nodes, count);
 }
 
 int
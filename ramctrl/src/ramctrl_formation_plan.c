@@ -0,0 +1,575 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_formation_plan.c
+ *		Join several nodes to a cluster in one round
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A formation is four steps whatever the number of nodes: one read of the
+ * members, the new nodes' health checks, one membership change for all
+ * of them, and the members' notifications.  The checks and the
+ * notifications each go out at once through one curl multi handle, so a
+ * step costs as much as its slowest node rather than the sum of them, and
+ * Raft goes through one joint-consensus step instead of one per node.
+ *
+ * Every ramd is assumed to listen on the port and scheme of ctx->api_url,
+ * as the members' API addresses are not part of the node list.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <curl/curl.h>
+
+#include "ramctrl_formation_plan.h"
+#include "ramctrl_http.h"
+#include "ramctrl_defaults.h"
+#include "ram_json.h"
+
+/* Host names and address literals only; they go into JSON and URLs as is */
+#define RAMCTRL_FORMATION_HOST_CHARS \
+	"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.-_:"
+
+typedef enum
+{
+	RAMCTRL_FORMATION_STEP_MEMBERS = 0,
+	RAMCTRL_FORMATION_STEP_HEALTH,
+	RAMCTRL_FORMATION_STEP_MEMBERSHIP,
+	RAMCTRL_FORMATION_STEP_NOTIFY,
+	RAMCTRL_FORMATION_STEP_COUNT
+} ramctrl_formation_step_t;
+
+static const char* const ramctrl_formation_step_names[RAMCTRL_FORMATION_STEP_COUNT] = {
+    "members", "health", "membership", "notify"};
+
+typedef struct ramctrl_formation_timing
+{
+	bool ran;
+	double elapsed_ms;
+	int ok;
+	int total;
+} ramctrl_formation_timing_t;
+
+/* One request of a round; body is POSTed when set */
+typedef struct ramctrl_formation_call
+{
+	CURL* easy;
+	char url[RAMCTRL_MAX_PATH_LENGTH + RAMCTRL_MAX_HOSTNAME_LENGTH + 64]; /* api_url, host, path */
+	const char* body;
+	long timeout_ms;
+	char* response;
+	size_t response_len;
+	size_t response_size;
+	bool overflow;
+	bool ok;
+	char error[RAMCTRL_MAX_HOSTNAME_LENGTH];
+} ramctrl_formation_call_t;
+
+
+static double ramctrl_formation_ms_since(const struct timespec* start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) (now.tv_sec - start->tv_sec) * 1000.0 +
+	       (double) (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+
+static size_t ramctrl_formation_write(void* contents, size_t size, size_t nmemb,
+                                      void* userp)
+{
+	ramctrl_formation_call_t* call = (ramctrl_formation_call_t*) userp;
+	size_t realsize = size * nmemb;
+
+	if (realsize >= call->response_size - call->response_len)
+	{
+		call->overflow = true;
+		return 0;
+	}
+
+	memcpy(call->response + call->response_len, contents, realsize);
+	call->response_len += realsize;
+	call->response[call->response_len] = '\0';
+	return realsize;
+}
+
+
+static bool ramctrl_formation_call_init(ramctrl_formation_call_t* call,
+                                        size_t response_size)
+{
+	memset(call, 0, sizeof(*call));
+	call->response = malloc(response_size);
+	call->easy = curl_easy_init();
+	call->response_size = response_size;
+	if (call->response)
+		call->response[0] = '\0';
+	return call->response && call->easy;
+}
+
+
+static void ramctrl_formation_call_free(ramctrl_formation_call_t* call)
+{
+	if (call->easy)
+		curl_easy_cleanup(call->easy);
+	free(call->response);
+	call->easy = NULL;
+	call->response = NULL;
+}
+
+
+/*
+ * Run every call at once and wait for the last.  A call is ok when it got
+ * a 2xx answer that fit its buffer; otherwise error says why.
+ */
+static void ramctrl_formation_round(ramctrl_formation_call_t* calls, int count)
+{
+	struct curl_slist* headers;
+	CURLM* multi;
+	int running = 0;
+	int i;
+
+	headers = curl_slist_append(NULL, "Content-Type: application/json");
+	multi = curl_multi_init();
+	if (!multi)
+	{
+		for (i = 0; i < count; i++)
+			snprintf(calls[i].error, sizeof(calls[i].error), "out of memory");
+		curl_slist_free_all(headers);
+		return;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		ramctrl_formation_call_t* call = &calls[i];
+
+		call->ok = false;
+		call->overflow = false;
+		call->response_len = 0;
+		call->response[0] = '\0';
+		call->error[0] = '\0';
+
+		curl_easy_reset(call->easy);
+		curl_easy_setopt(call->easy, CURLOPT_URL, call->url);
+		curl_easy_setopt(call->easy, CURLOPT_WRITEFUNCTION, ramctrl_formation_write);
+		curl_easy_setopt(call->easy, CURLOPT_WRITEDATA, call);
+		curl_easy_setopt(call->easy, CURLOPT_TIMEOUT_MS, call->timeout_ms);
+		curl_easy_setopt(call->easy, CURLOPT_CONNECTTIMEOUT_MS,
+		                 (long) RAMCTRL_FORMATION_CONNECT_TIMEOUT_MS);
+		curl_easy_setopt(call->easy, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(call->easy, CURLOPT_USERAGENT, "ramctrl/1.0");
+		if (call->body)
+		{
+			curl_easy_setopt(call->easy, CURLOPT_POSTFIELDS, call->body);
+			curl_easy_setopt(call->easy, CURLOPT_HTTPHEADER, headers);
+		}
+
+		if (curl_multi_add_handle(multi, call->easy) != CURLM_OK)
+			snprintf(call->error, sizeof(call->error), "could not queue request");
+	}
+
+	do
+	{
+		CURLMsg* msg;
+		int queued;
+
+		curl_multi_perform(multi, &running);
+
+		while ((msg = curl_multi_info_read(multi, &queued)) != NULL)
+		{
+			ramctrl_formation_call_t* call = NULL;
+			long code = 0;
+
+			if (msg->msg != CURLMSG_DONE)
+				continue;
+			for (i = 0; i < count && !call; i++)
+				if (calls[i].easy == msg->easy_handle)
+					call = &calls[i];
+			if (!call)
+				continue;
+
+			curl_easy_getinfo(call->easy, CURLINFO_RESPONSE_CODE, &code);
+			if (call->overflow)
+				snprintf(call->error, sizeof(call->error),
+				         "response larger than %zu bytes", call->response_size);
+			else if (msg->data.result != CURLE_OK)
+				snprintf(call->error, sizeof(call->error), "%s",
+				         curl_easy_strerror(msg->data.result));
+			else if (code < 200 || code >= 300)
+				snprintf(call->error, sizeof(call->error), "HTTP %ld", code);
+			else
+				call->ok = true;
+		}
+
+		if (running > 0)
+			curl_multi_poll(multi, NULL, 0, 1000, NULL);
+	} while (running > 0);
+
+	for (i = 0; i < count; i++)
+		curl_multi_remove_handle(multi, calls[i].easy);
+	curl_multi_cleanup(multi);
+	curl_slist_free_all(headers);
+}
+
+
+/* The URL of path on host's ramd, taking scheme and port from api_url */
+static void ramctrl_formation_ramd_url(const char* api_url, const char* host,
+                                       const char* path, char* out, size_t size)
+{
+	const char* sep = strstr(api_url, "://");
+	const char* scheme = sep ? api_url : "http";
+	int scheme_len = sep ? (int) (sep - api_url) : 4;
+	const char* authority = sep ? sep + 3 : api_url;
+	size_t authority_len = strcspn(authority, "/");
+	const char* port = "";
+	int port_len = 0;
+	bool ipv6 = strchr(host, ':') != NULL;
+	size_t k;
+
+	/* The port follows the last ':' that is not inside an IPv6 literal */
+	for (k = authority_len; k > 0; k--)
+	{
+		if (authority[k - 1] == ']')
+			break;
+		if (authority[k - 1] == ':')
+		{
+			port = authority + k - 1;
+			port_len = (int) (authority_len - k + 1);
+			break;
+		}
+	}
+
+	snprintf(out, size, "%.*s://%s%s%s%.*s%s", scheme_len, scheme, ipv6 ? "[" : "",
+	         host, ipv6 ? "]" : "", port_len, port, path);
+}
+
+
+int ramctrl_formation_parse_nodes(const ramctrl_context_t* ctx, int first,
+                                  ramctrl_formation_node_t* nodes, int max_nodes)
+{
+	int count = 0;
+	int i;
+
+	if ((ctx->command_argc - first) <= 0 || (ctx->command_argc - first) % 3 != 0)
+	{
+		fprintf(stderr, "ramctrl: expected NODE_ID HOST PORT for every node to add\n");
+		return -1;
+	}
+
+	for (i = first; i + 2 < ctx->command_argc; i += 3)
+	{
+		ramctrl_formation_node_t* node;
+		char* end;
+		long id;
+		long port;
+
+		if (count == max_nodes)
+		{
+			fprintf(stderr, "ramctrl: at most %d nodes can be added at once\n", max_nodes);
+			return -1;
+		}
+
+		id = strtol(ctx->command_args[i], &end, 10);
+		if (*end != '\0' || id <= 0 || id > INT32_MAX)
+		{
+			fprintf(stderr, "ramctrl: invalid node id: %s\n", ctx->command_args[i]);
+			return -1;
+		}
+		port = strtol(ctx->command_args[i + 2], &end, 10);
+		if (*end != '\0' || port <= 0 || port > 65535)
+		{
+			fprintf(stderr, "ramctrl: invalid port for node %ld: %s\n", id,
+			        ctx->command_args[i + 2]);
+			return -1;
+		}
+
+		if (strspn(ctx->command_args[i + 1], RAMCTRL_FORMATION_HOST_CHARS) !=
+		        strlen(ctx->command_args[i + 1]) ||
+		    ctx->command_args[i + 1][0] == '\0')
+		{
+			fprintf(stderr, "ramctrl: invalid host for node %ld: %s\n", id,
+			        ctx->command_args[i + 1]);
+			return -1;
+		}
+
+		node = &nodes[count++];
+		node->node_id = (int32_t) id;
+		node->port = (int32_t) port;
+		snprintf(node->hostname, sizeof(node->hostname), "%s", ctx->command_args[i + 1]);
+	}
+
+	return count;
+}
+
+
+static bool ramctrl_formation_stdout(void* context, const char* data, size_t length)
+{
+	(void) context;
+	return fwrite(data, 1, length, stdout) == length;
+}
+
+
+static void ramctrl_formation_report(const ramctrl_context_t* ctx, int count,
+                                     const ramctrl_formation_timing_t* timing,
+                                     double total_ms, const char* outcome)
+{
+	int i;
+
+	if (ctx->json_output)
+	{
+		char buf[2048];
+		ram_json_writer_t w;
+		bool ok;
+
+		ram_json_writer_init(&w, buf, sizeof(buf), ramctrl_formation_stdout, NULL);
+		ok = ram_json_object_begin(&w) &&
+		     ram_json_kv_string(&w, "outcome", outcome) &&
+		     ram_json_kv_int(&w, "nodes", count) &&
+		     ram_json_kv_double(&w, "elapsed_ms", total_ms, 1) &&
+		     ram_json_key(&w, "steps") && ram_json_array_begin(&w);
+		for (i = 0; ok && i < RAMCTRL_FORMATION_STEP_COUNT; i++)
+		{
+			if (!timing[i].ran)
+				continue;
+			ok = ram_json_object_begin(&w) &&
+			     ram_json_kv_string(&w, "step", ramctrl_formation_step_names[i]) &&
+			     ram_json_kv_double(&w, "elapsed_ms", timing[i].elapsed_ms, 1) &&
+			     ram_json_kv_int(&w, "ok", timing[i].ok) &&
+			     ram_json_kv_int(&w, "total", timing[i].total) &&
+			     ram_json_object_end(&w);
+		}
+		ok = ok && ram_json_array_end(&w) && ram_json_object_end(&w) &&
+		     ram_json_writer_finish(&w);
+		if (ok)
+			putchar('\n');
+		return;
+	}
+
+	if (ctx->quiet)
+		return;
+
+	printf("\n%-12s %10s %9s\n", "STEP", "MS", "OK");
+	for (i = 0; i < RAMCTRL_FORMATION_STEP_COUNT; i++)
+	{
+		if (timing[i].ran)
+			printf("%-12s %10.1f %4d/%-4d\n", ramctrl_formation_step_names[i],
+			       timing[i].elapsed_ms, timing[i].ok, timing[i].total);
+	}
+	printf("\nramctrl: %d node(s) %s in %.1f ms\n", count, outcome, total_ms);
+}
+
+
+int ramctrl_formation_add_nodes(ramctrl_context_t* ctx,
+                                const ramctrl_formation_node_t* nodes, int count)
+{
+	ramctrl_formation_timing_t timing[RAMCTRL_FORMATION_STEP_COUNT];
+	ramctrl_node_info_t members[RAMCTRL_MAX_NODES];
+	ramctrl_formation_call_t* calls = NULL;
+	ramctrl_formation_call_t membership;
+	struct timespec started;
+	struct timespec step;
+	char* membership_body = NULL;
+	char* notify_body = NULL;
+	size_t body_size;
+	size_t len;
+	const char* outcome = "not added";
+	int member_count = 0;
+	int ncalls = 0;
+	int result = RAMCTRL_EXIT_FAILURE;
+	int i;
+	int j;
+
+	memset(timing, 0, sizeof(timing));
+	memset(&membership, 0, sizeof(membership));
+
+	if (count <= 0 || count > RAMCTRL_MAX_NODES)
+		return RAMCTRL_EXIT_USAGE;
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < i; j++)
+			if (nodes[i].node_id == nodes[j].node_id)
+			{
+				fprintf(stderr, "ramctrl: node %d is listed twice\n", nodes[i].node_id);
+				return RAMCTRL_EXIT_USAGE;
+			}
+
+	if (ramctrl_http_init() != 0)
+		return RAMCTRL_EXIT_FAILURE;
+
+	/* A round is at most one call per new node or per member */
+	calls = calloc(RAMCTRL_MAX_NODES, sizeof(*calls));
+	body_size = (size_t) count * (RAMCTRL_MAX_HOSTNAME_LENGTH + 64) + 64;
+	membership_body = malloc(body_size);
+	notify_body = malloc(body_size);
+	if (!calls || !membership_body || !notify_body ||
+	    !ramctrl_formation_call_init(&membership, RAMCTRL_FLEET_RESPONSE_SIZE))
+	{
+		fprintf(stderr, "ramctrl: out of memory planning the formation\n");
+		goto done;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &started);
+
+	/* Members, once: the same call later carries the membership change */
+	step = started;
+	snprintf(membership.url, sizeof(membership.url), "%s/api/v1/nodes", ctx->api_url);
+	membership.timeout_ms = (long) ctx->timeout_seconds * 1000L;
+	ramctrl_formation_round(&membership, 1);
+	timing[RAMCTRL_FORMATION_STEP_MEMBERS].ran = true;
+	timing[RAMCTRL_FORMATION_STEP_MEMBERS].elapsed_ms = ramctrl_formation_ms_since(&step);
+	timing[RAMCTRL_FORMATION_STEP_MEMBERS].total = 1;
+	if (!membership.ok)
+	{
+		fprintf(stderr, "ramctrl: cannot read the members from %s: %s\n", ctx->api_url,
+		        membership.error);
+		result = RAMCTRL_EXIT_UNAVAILABLE;
+		goto report;
+	}
+	if (ramctrl_parse_nodes_info(membership.response, members, &member_count) != 0)
+	{
+		fprintf(stderr, "ramctrl: unreadable node list from %s\n", ctx->api_url);
+		goto report;
+	}
+	timing[RAMCTRL_FORMATION_STEP_MEMBERS].ok = 1;
+
+	for (i = 0; i < count; i++)
+		for (j = 0; j < member_count; j++)
+			if (nodes[i].node_id == members[j].node_id)
+			{
+				fprintf(stderr, "ramctrl: node %d is already a member (%s)\n",
+				        nodes[i].node_id, members[j].hostname);
+				result = RAMCTRL_EXIT_USAGE;
+				goto report;
+			}
+	if (member_count + count > RAMCTRL_MAX_NODES)
+	{
+		fprintf(stderr, "ramctrl: %d members and %d new nodes exceed %d nodes\n",
+		        member_count, count, RAMCTRL_MAX_NODES);
+		result = RAMCTRL_EXIT_USAGE;
+		goto report;
+	}
+
+	/* Every new node's ramd, at once */
+	clock_gettime(CLOCK_MONOTONIC, &step);
+	for (i = 0; i < count; i++)
+	{
+		if (!ramctrl_formation_call_init(&calls[i], RAMCTRL_FORMATION_RESPONSE_SIZE))
+		{
+			fprintf(stderr, "ramctrl: out of memory planning the formation\n");
+			goto done;
+		}
+		ncalls++;
+		ramctrl_formation_ramd_url(ctx->api_url, nodes[i].hostname, "/health",
+		                           calls[i].url, sizeof(calls[i].url));
+		calls[i].timeout_ms = RAMCTRL_FORMATION_HEALTH_TIMEOUT_MS;
+	}
+	ramctrl_formation_round(calls, count);
+	timing[RAMCTRL_FORMATION_STEP_HEALTH].ran = true;
+	timing[RAMCTRL_FORMATION_STEP_HEALTH].elapsed_ms = ramctrl_formation_ms_since(&step);
+	timing[RAMCTRL_FORMATION_STEP_HEALTH].total = count;
+	for (i = 0; i < count; i++)
+	{
+		if (calls[i].ok)
+			timing[RAMCTRL_FORMATION_STEP_HEALTH].ok++;
+		else
+			fprintf(stderr, "ramctrl: node %d at %s: %s\n", nodes[i].node_id,
+			        calls[i].url, calls[i].error);
+	}
+	if (timing[RAMCTRL_FORMATION_STEP_HEALTH].ok < count && !ctx->force)
+	{
+		fprintf(stderr, "ramctrl: not every new node is healthy; --force adds them anyway\n");
+		goto report;
+	}
+
+	/* All new nodes in one membership change */
+	len = (size_t) snprintf(membership_body, body_size, "{\"voting\":%s,\"nodes\":[",
+	                        ctx->learner ? "false" : "true");
+	for (i = 0; i < count; i++)
+		len += (size_t) snprintf(membership_body + len, body_size - len,
+		                         "%s{\"node_id\":%d,\"hostname\":\"%s\",\"port\":%d}",
+		                         i ? "," : "", nodes[i].node_id, nodes[i].hostname,
+		                         nodes[i].port);
+	snprintf(membership_body + len, body_size - len, "]}");
+
+	if (ctx->dry_run)
+	{
+		if (!ctx->quiet && !ctx->json_output)
+			printf("ramctrl: dry run; would POST %s/api/v1/cluster/add-node %s\n",
+			       ctx->api_url, membership_body);
+		outcome = "checked";
+		result = RAMCTRL_EXIT_SUCCESS;
+		goto report;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &step);
+	snprintf(membership.url, sizeof(membership.url), "%s/api/v1/cluster/add-node",
+	         ctx->api_url);
+	membership.body = membership_body;
+	ramctrl_formation_round(&membership, 1);
+	timing[RAMCTRL_FORMATION_STEP_MEMBERSHIP].ran = true;
+	timing[RAMCTRL_FORMATION_STEP_MEMBERSHIP].elapsed_ms = ramctrl_formation_ms_since(&step);
+	timing[RAMCTRL_FORMATION_STEP_MEMBERSHIP].total = 1;
+	if (!membership.ok)
+	{
+		fprintf(stderr, "ramctrl: membership change failed: %s\n", membership.error);
+		if (ctx->verbose && membership.response_len > 0)
+			fprintf(stderr, "Response: %s\n", membership.response);
+		goto report;
+	}
+	timing[RAMCTRL_FORMATION_STEP_MEMBERSHIP].ok = 1;
+	outcome = "added";
+	result = RAMCTRL_EXIT_SUCCESS;
+
+	/* Tell every earlier member, at once; a miss only warns, the change is in */
+	len = (size_t) snprintf(notify_body, body_size,
+	                        "{\"action\":\"nodes_added\",\"node_ids\":[");
+	for (i = 0; i < count; i++)
+		len += (size_t) snprintf(notify_body + len, body_size - len, "%s%d",
+		                         i ? "," : "", nodes[i].node_id);
+	snprintf(notify_body + len, body_size - len, "]}");
+
+	clock_gettime(CLOCK_MONOTONIC, &step);
+	for (i = 0; i < member_count; i++)
+	{
+		if (i >= ncalls)
+		{
+			if (!ramctrl_formation_call_init(&calls[i], RAMCTRL_FORMATION_RESPONSE_SIZE))
+				break;
+			ncalls++;
+		}
+		ramctrl_formation_ramd_url(ctx->api_url, members[i].hostname,
+		                           "/api/v1/cluster/notify", calls[i].url,
+		                           sizeof(calls[i].url));
+		calls[i].body = notify_body;
+		calls[i].timeout_ms = RAMCTRL_FORMATION_HEALTH_TIMEOUT_MS;
+	}
+	if (i > 0)
+		ramctrl_formation_round(calls, i);
+	timing[RAMCTRL_FORMATION_STEP_NOTIFY].ran = true;
+	timing[RAMCTRL_FORMATION_STEP_NOTIFY].elapsed_ms = ramctrl_formation_ms_since(&step);
+	timing[RAMCTRL_FORMATION_STEP_NOTIFY].total = member_count;
+	for (j = 0; j < i; j++)
+	{
+		if (calls[j].ok)
+			timing[RAMCTRL_FORMATION_STEP_NOTIFY].ok++;
+		else
+			fprintf(stderr, "ramctrl: warning: member %d at %s not notified: %s\n",
+			        members[j].node_id, calls[j].url, calls[j].error);
+	}
+
+report:
+	ramctrl_formation_report(ctx, count, timing, ramctrl_formation_ms_since(&started),
+	                         outcome);
+
+done:
+	for (i = 0; calls && i < ncalls; i++)
+		ramctrl_formation_call_free(&calls[i]);
+	ramctrl_formation_call_free(&membership);
+	free(calls);
+	free(membership_body);
+	free(notify_body);
+	return result;
+}
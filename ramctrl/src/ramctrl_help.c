@@ -91,6 +91,14 @@ void ramctrl_help_show_commands(void)
 	printf("  -j, --json            JSON output format\n");
 	printf("  -t, --timeout SEC     Timeout in seconds\n");
 	printf("      --table           Table output format\n");
+	printf("      --clusters FILE   Run status/show against every ramd listed\n");
+	printf("      --parallel N      Clusters queried at once (with --clusters)\n");
+	printf("      --lines N         Log records shown by logs (default %d)\n",
+	       RAMCTRL_LOGS_DEFAULT_LINES);
+	printf("      --level LEVEL     logs: only this level and above\n");
+	printf("      --component NAME  logs: only this ramd component\n");
+	printf("      --since WHEN      logs: unix time or an age like 15m\n");
+	printf("      --follow          logs: keep printing new records\n");
 	printf("      --help            Show this help message\n");
 	printf("      --version         Show version information\n");
 	printf("\nExamples:\n");
@@ -243,6 +251,8 @@ void ramctrl_help_show_examples(void)
 	printf("Monitoring:\n");
 	printf("  ramctrl watch cluster\n");
 	printf("  ramctrl logs --lines 50\n");
+	printf("  ramctrl logs --level warning --component failover --since 1h\n");
+	printf("  ramctrl logs --follow\n");
 	printf("  ramctrl show replication\n\n");
 	printf("Backup operations:\n");
 	printf("  ramctrl wal-e-backup --name daily_backup\n");
@@ -310,6 +320,7 @@ void ramctrl_show_help(void)
 	printf("  %-15s Show overall status\n", "status");
 	printf("  %-15s Show configuration\n", "config");
 	printf("  %-15s Show recent logs\n", "logs");
+	printf("  %-15s Show the last hour of lag, health and latencies\n", "performance");
 	printf("\nOptions:\n");
 	printf("  --json          Output in JSON format\n");
 	printf("  --verbose       Show detailed information\n");
@@ -325,7 +336,7 @@ void ramctrl_node_help(void)
 	printf("Usage: ramctrl node SUBCOMMAND [OPTIONS]\n\n");
 	printf("Manage cluster nodes.\n\n");
 	printf("Subcommands:\n");
-	printf("  %-15s Add a node to the cluster\n", "add ID HOST PORT");
+	printf("  %-15s Add nodes to the cluster\n", "add ID HOST PORT...");
 	printf("  %-15s Remove a node from the cluster\n", "remove ID");
 	printf("  %-15s List all nodes\n", "list");
 	printf("  %-15s Show node status\n", "status [ID]");
@@ -334,8 +345,12 @@ void ramctrl_node_help(void)
 	printf("\nOptions:\n");
 	printf("  --force         Force operation without confirmation\n");
 	printf("  --timeout SEC   Set operation timeout\n");
+	printf("  --learner       add: join Raft as non-voting learners\n");
+	printf("  --dry-run       add: check the new nodes, change nothing\n");
+	printf("\nSeveral nodes given to add join in one membership change.\n");
 	printf("\nExamples:\n");
 	printf("  ramctrl node add 2 db2.example.com 5432\n");
+	printf("  ramctrl node add 2 db2 5432 3 db3 5432 4 db4 5432\n");
 	printf("  ramctrl node remove 2\n");
 	printf("  ramctrl node list\n");
 	printf("  ramctrl node maintenance-on 2\n");
@@ -391,6 +406,7 @@ void ramctrl_replica_help(void)
 	       "integration.\n\n");
 	printf("Subcommands:\n");
 	printf("  %-15s Add new replica to cluster\n", "add HOSTNAME [PORT]");
+	printf("  %-15s Add it as a non-voting Raft learner\n", "  --learner");
 	printf("  %-15s Remove replica from cluster\n", "remove NODE_ID");
 	printf("  %-15s List all replicas\n", "list");
 	printf("  %-15s Show replica status\n", "status");
@@ -402,6 +418,7 @@ void ramctrl_replica_help(void)
 	printf("\nExamples:\n");
 	printf("  ramctrl replica add replica1.example.com\n");
 	printf("  ramctrl replica add 192.168.1.100 5433\n");
+	printf("  ramctrl replica add read1.example.com --learner\n");
 	printf("  ramctrl replica list\n");
 	printf("  ramctrl replica status\n");
 }
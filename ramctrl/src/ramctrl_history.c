@@ -0,0 +1,203 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_history.c
+ *		Recent ramd metrics from its /api/v1/metrics/history rings
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * ramd keeps a downsampled history of lag, health and latencies itself,
+ * so ramctrl show performance can draw where they have been without a
+ * Prometheus server: one request for the last hour at one-minute steps,
+ * and a line of block characters per series.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ramctrl_history.h"
+#include "ramctrl_defaults.h"
+#include "ramctrl_http.h"
+#include "ramctrl_table.h"
+#include "ram_json.h"
+
+typedef enum
+{
+	RAMCTRL_HISTORY_MS,
+	RAMCTRL_HISTORY_US,
+	RAMCTRL_HISTORY_SCORE
+} ramctrl_history_unit_t;
+
+typedef struct ramctrl_history_row
+{
+	const char* label;
+	const char* series;
+	ramctrl_history_unit_t unit;
+	bool low_is_bad; /* show the lowest instead of the highest */
+} ramctrl_history_row_t;
+
+static const ramctrl_history_row_t g_history_rows[] = {
+    {"Replication Lag", "lag_ms", RAMCTRL_HISTORY_MS, false},
+    {"Health Score", "health", RAMCTRL_HISTORY_SCORE, true},
+    {"API Latency", "http_us", RAMCTRL_HISTORY_US, false},
+    {"Raft Commit Latency", "raft_commit_us", RAMCTRL_HISTORY_US, false},
+    {"Monitor Cycle Time", "cycle_us", RAMCTRL_HISTORY_US, false},
+};
+
+/* Eighths, lowest first */
+static const char* const g_spark_levels[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+
+static void ramctrl_history_format(double value, ramctrl_history_unit_t unit, char* dst,
+                                   size_t size)
+{
+	if (unit == RAMCTRL_HISTORY_SCORE)
+		snprintf(dst, size, "%.2f", value);
+	else if (unit == RAMCTRL_HISTORY_US && value < 1000.0)
+		snprintf(dst, size, "%.0f us", value);
+	else
+	{
+		double ms = unit == RAMCTRL_HISTORY_US ? value / 1000.0 : value;
+
+		if (ms < 10.0)
+			snprintf(dst, size, "%.1f ms", ms);
+		else if (ms < 10000.0)
+			snprintf(dst, size, "%.0f ms", ms);
+		else
+			snprintf(dst, size, "%.1f s", ms / 1000.0);
+	}
+}
+
+/* Values of one array of the response; missing steps are left out of present */
+static int32_t ramctrl_history_values(const char* json, const ram_json_token_t* tokens,
+                                      int32_t array, double* values, bool* present,
+                                      int32_t max)
+{
+	int32_t count = 0;
+
+	for (int32_t i = ram_json_array_first(tokens, array); i >= 0 && count < max;
+	     i = ram_json_array_next(tokens, array, i))
+	{
+		present[count] = ram_json_get_double(json, tokens, i, &values[count]);
+		count++;
+	}
+	return count;
+}
+
+static void ramctrl_history_print_row(const char* json, const ram_json_token_t* tokens,
+                                      int32_t series, const ramctrl_history_row_t* row)
+{
+	double avg[RAMCTRL_HISTORY_POINTS];
+	double worst[RAMCTRL_HISTORY_POINTS];
+	bool avg_present[RAMCTRL_HISTORY_POINTS];
+	bool worst_present[RAMCTRL_HISTORY_POINTS];
+	char spark[RAMCTRL_HISTORY_POINTS * 3 + 1] = "";
+	char latest_str[32];
+	char worst_str[32];
+	char value[RAMCTRL_HISTORY_POINTS * 3 + 96];
+	int32_t object = ram_json_object_get(json, tokens, series, row->series);
+	int32_t count;
+	int32_t worst_count;
+	double lo = 0.0;
+	double hi = 0.0;
+	double extreme = 0.0;
+	double latest = 0.0;
+	bool any = false;
+
+	count = ramctrl_history_values(json, tokens, ram_json_object_get(json, tokens, object, "avg"),
+	                               avg, avg_present, RAMCTRL_HISTORY_POINTS);
+	worst_count = ramctrl_history_values(json, tokens,
+	                                     ram_json_object_get(json, tokens, object,
+	                                                         row->low_is_bad ? "avg" : "max"),
+	                                     worst, worst_present, RAMCTRL_HISTORY_POINTS);
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (!avg_present[i])
+			continue;
+		if (!any || avg[i] < lo)
+			lo = avg[i];
+		if (!any || avg[i] > hi)
+			hi = avg[i];
+		latest = avg[i];
+		any = true;
+	}
+	if (!any)
+	{
+		ramctrl_table_print_row(row->label, "no data");
+		return;
+	}
+
+	extreme = latest;
+	for (int32_t i = 0; i < worst_count; i++)
+		if (worst_present[i] && (row->low_is_bad ? worst[i] < extreme : worst[i] > extreme))
+			extreme = worst[i];
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		int level = 0;
+
+		if (!avg_present[i])
+		{
+			strcat(spark, " ");
+			continue;
+		}
+		if (hi > lo)
+			level = (int) ((avg[i] - lo) / (hi - lo) * 7.0 + 0.5);
+		strcat(spark, g_spark_levels[level]);
+	}
+
+	ramctrl_history_format(latest, row->unit, latest_str, sizeof(latest_str));
+	ramctrl_history_format(extreme, row->unit, worst_str, sizeof(worst_str));
+	snprintf(value, sizeof(value), "%-9s %s %-9s %s", latest_str,
+	         row->low_is_bad ? "min" : "max", worst_str, spark);
+	ramctrl_table_print_row(row->label, value);
+}
+
+bool ramctrl_history_print(ramctrl_context_t* ctx)
+{
+	int32_t max_tokens = RAMCTRL_HISTORY_POINTS * 12 + 64;
+	ram_json_token_t* tokens;
+	char* json;
+	char url[1024];
+	int32_t series;
+
+	if (!ctx)
+		return false;
+
+	json = malloc(RAMCTRL_HISTORY_RESPONSE_SIZE);
+	tokens = malloc(sizeof(ram_json_token_t) * (size_t) max_tokens);
+	if (!json || !tokens)
+	{
+		fprintf(stderr, "ramctrl: out of memory\n");
+		free(json);
+		free(tokens);
+		return false;
+	}
+
+	snprintf(url, sizeof(url), "%s/api/v1/metrics/history?resolution=1m&points=%d",
+	         ctx->api_url, RAMCTRL_HISTORY_POINTS);
+	if (ramctrl_http_get(url, json, RAMCTRL_HISTORY_RESPONSE_SIZE) != 0 ||
+	    ram_json_parse(json, strlen(json), tokens, max_tokens) <= 0 ||
+	    (series = ram_json_object_get(json, tokens, 0, "series")) < 0)
+	{
+		free(json);
+		free(tokens);
+		return false;
+	}
+
+	if (ctx->json_output)
+		printf("%s\n", json);
+	else
+	{
+		ramctrl_table_print_header("Performance (last hour, 1 minute steps)");
+		for (size_t i = 0; i < sizeof(g_history_rows) / sizeof(g_history_rows[0]); i++)
+			ramctrl_history_print_row(json, tokens, series, &g_history_rows[i]);
+		ramctrl_table_print_footer();
+	}
+
+	free(json);
+	free(tokens);
+	return true;
+}
@@ -7,12 +7,17 @@
 
 #include "ramctrl_http.h"
 #include "ramctrl.h"
+#include "ramctrl_defaults.h"
+#include "ram_json.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <curl/curl.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 static ramctrl_http_config_t g_http_config = {.base_url =
                                                   "", /* Must be configured */
@@ -28,36 +33,47 @@ typedef struct {
 	size_t current_len;
 } response_context_t;
 
-/* Callback for writing received data */
+/*
+ * Callback for writing received data.  A body that does not fit fails the
+ * transfer (CURLE_WRITE_ERROR) rather than leaving a truncated document
+ * for the caller to misparse.
+ */
 static size_t write_callback(void* contents, size_t size, size_t nmemb,
                              void* userp)
 {
 	size_t realsize = size * nmemb;
 	response_context_t* ctx = (response_context_t*) userp;
-	size_t remaining_space = ctx->buffer_size - ctx->current_len - 1;
-	
-	if (remaining_space > 0 && realsize < remaining_space)
-	{
-		strncat(ctx->buffer, contents, realsize);
-		ctx->current_len += realsize;
-	}
-	else if (remaining_space > 0)
-	{
-		strncat(ctx->buffer, contents, remaining_space - 1);
-		ctx->current_len += remaining_space - 1;
-	}
-	
+
+	if (realsize >= ctx->buffer_size - ctx->current_len)
+		return 0;
+
+	memcpy(ctx->buffer + ctx->current_len, contents, realsize);
+	ctx->current_len += realsize;
+	ctx->buffer[ctx->current_len] = '\0';
 	return realsize;
 }
 
+/*
+ * A single easy handle is kept for the life of the process.  libcurl keeps
+ * its connection cache and TLS session cache on the handle, so repeated API
+ * calls to the same ramd reuse the HTTP/1.1 connection instead of paying
+ * for a new TCP and TLS handshake every time.
+ */
+static CURL* g_curl = NULL;
+static bool g_curl_global_initialized = false;
+
 /*
  * Initialize HTTP client
  */
 int ramctrl_http_init(void)
 {
-	/* Initialize libcurl */
-	if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
-		return -1;
+	if (!g_curl_global_initialized)
+	{
+		/* Initialize libcurl */
+		if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+			return -1;
+		g_curl_global_initialized = true;
+	}
 	return 0;
 }
 
@@ -66,7 +82,116 @@ int ramctrl_http_init(void)
  */
 void ramctrl_http_cleanup(void)
 {
-	curl_global_cleanup();
+	if (g_curl)
+	{
+		curl_easy_cleanup(g_curl);
+		g_curl = NULL;
+	}
+	if (g_curl_global_initialized)
+	{
+		curl_global_cleanup();
+		g_curl_global_initialized = false;
+	}
+}
+
+int ramctrl_http_local_port(const char* url)
+{
+	const char* host;
+	const char* end;
+	size_t host_len;
+	long port = 80;
+
+	if (!url || strncasecmp(url, "http://", 7) != 0)
+		return -1;
+	host = url + 7;
+	if (*host == '[')
+	{
+		end = strchr(host, ']');
+		if (!end)
+			return -1;
+		host++;
+		host_len = (size_t) (end - host);
+		end++;
+	}
+	else
+	{
+		end = host + strcspn(host, ":/");
+		host_len = (size_t) (end - host);
+	}
+	if (!((host_len == 9 && strncasecmp(host, "localhost", 9) == 0) ||
+	      (host_len == 9 && strncmp(host, "127.0.0.1", 9) == 0) ||
+	      (host_len == 3 && strncmp(host, "::1", 3) == 0)))
+		return -1;
+	if (*end == ':')
+		port = strtol(end + 1, NULL, 10);
+	return port > 0 && port <= 65535 ? (int) port : -1;
+}
+
+/*
+ * The ramd behind an http:// URL on this host also listens on
+ * RAMCTRL_DEFAULT_SOCKET_DIR/.s.ramd.<port>, where ramctrl run as root or
+ * as ramd's user needs no token and is not rate limited.  RAMCTRL_SOCKET
+ * names the socket for a ramd with another http_unix_socket_dir; set to
+ * an empty string it keeps ramctrl on TCP.  Returns false when the
+ * request should go over TCP.
+ */
+static bool ramctrl_http_local_socket(const char* url, char* path, size_t path_size)
+{
+	const char* env = getenv("RAMCTRL_SOCKET");
+	int port = ramctrl_http_local_port(url);
+	struct stat st;
+
+	if (port < 0)
+		return false;
+
+	if (env)
+	{
+		if (env[0] == '\0')
+			return false;
+		snprintf(path, path_size, "%s", env);
+	}
+	else
+		snprintf(path, path_size, "%s/" RAMCTRL_SOCKET_NAME, RAMCTRL_DEFAULT_SOCKET_DIR, port);
+
+	/* An older ramd, or one with the socket turned off */
+	return stat(path, &st) == 0 && S_ISSOCK(st.st_mode);
+}
+
+/*
+ * Return the shared handle with per-request options cleared; live
+ * connections and cached TLS sessions survive curl_easy_reset().
+ */
+static CURL* ramctrl_http_handle(const char* url, response_context_t* ctx)
+{
+	char socket_path[RAMCTRL_MAX_PATH_LENGTH];
+
+	if (!g_curl)
+	{
+		if (ramctrl_http_init() != 0)
+			return NULL;
+		g_curl = curl_easy_init();
+		if (!g_curl)
+			return NULL;
+	}
+	else
+		curl_easy_reset(g_curl);
+
+	curl_easy_setopt(g_curl, CURLOPT_URL, url);
+	curl_easy_setopt(g_curl, CURLOPT_WRITEFUNCTION, write_callback);
+	curl_easy_setopt(g_curl, CURLOPT_WRITEDATA, ctx);
+	curl_easy_setopt(g_curl, CURLOPT_TIMEOUT, g_http_config.timeout_seconds);
+	curl_easy_setopt(g_curl, CURLOPT_USERAGENT, "ramctrl/1.0");
+	curl_easy_setopt(g_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	if (ramctrl_http_local_socket(url, socket_path, sizeof(socket_path)))
+		curl_easy_setopt(g_curl, CURLOPT_UNIX_SOCKET_PATH, socket_path);
+
+	if (!g_http_config.ssl_verify)
+	{
+		curl_easy_setopt(g_curl, CURLOPT_SSL_VERIFYPEER, 0L);
+		curl_easy_setopt(g_curl, CURLOPT_SSL_VERIFYHOST, 0L);
+	}
+
+	return g_curl;
 }
 
 /*
@@ -76,6 +201,7 @@ int ramctrl_http_get(const char* url, char* response, size_t response_size)
 {
 	CURL* curl;
 	CURLcode res;
+	response_context_t ctx;
 
 	if (!url || !response || response_size == 0)
 		return -1;
@@ -83,28 +209,70 @@ int ramctrl_http_get(const char* url, char* response, size_t response_size)
 	/* Clear response buffer */
 	memset(response, 0, response_size);
 
-	curl = curl_easy_init();
+	/* Initialize context for safe buffer handling */
+	ctx.buffer = response;
+	ctx.buffer_size = response_size;
+	ctx.current_len = 0;
+
+	curl = ramctrl_http_handle(url, &ctx);
 	if (!curl)
 		return -1;
 
-	/* Set options */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-	/* Initialize context for safe buffer handling */
-	response_context_t ctx = {response, response_size, 0};
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx);
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, g_http_config.timeout_seconds);
-	curl_easy_setopt(curl, CURLOPT_USERAGENT, "ramctrl/1.0");
+	/* Perform request */
+	res = curl_easy_perform(curl);
 
-	if (!g_http_config.ssl_verify)
+	return (res == CURLE_OK) ? 0 : -1;
+}
+
+static int ramctrl_http_progress(void* userp, curl_off_t dltotal,
+                                 curl_off_t dlnow, curl_off_t ultotal,
+                                 curl_off_t ulnow)
+{
+	bool (*keep_waiting)(void) = (bool (*)(void)) userp;
+
+	(void) dltotal;
+	(void) dlnow;
+	(void) ultotal;
+	(void) ulnow;
+
+	/* Non-zero aborts the transfer */
+	return keep_waiting() ? 0 : 1;
+}
+
+/*
+ * Long-poll GET: same shared handle, with the overall timeout replaced
+ */
+int ramctrl_http_get_wait(const char* url, char* response,
+                          size_t response_size, long timeout_ms,
+                          bool (*keep_waiting)(void))
+{
+	CURL* curl;
+	CURLcode res;
+	response_context_t ctx;
+
+	if (!url || !response || response_size == 0)
+		return -1;
+
+	memset(response, 0, response_size);
+
+	ctx.buffer = response;
+	ctx.buffer_size = response_size;
+	ctx.current_len = 0;
+
+	curl = ramctrl_http_handle(url, &ctx);
+	if (!curl)
+		return -1;
+
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0L);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+	if (keep_waiting)
 	{
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, ramctrl_http_progress);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void*) keep_waiting);
+		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
 	}
 
-	/* Perform request */
 	res = curl_easy_perform(curl);
-	curl_easy_cleanup(curl);
 
 	return (res == CURLE_OK) ? 0 : -1;
 }
@@ -118,6 +286,7 @@ int ramctrl_http_post(const char* url, const char* data, char* response,
 	CURL* curl;
 	CURLcode res;
 	struct curl_slist* headers = NULL;
+	response_context_t ctx;
 
 	if (!url || !data || !response || response_size == 0)
 		return -1;
@@ -125,7 +294,12 @@ int ramctrl_http_post(const char* url, const char* data, char* response,
 	/* Clear response buffer */
 	memset(response, 0, response_size);
 
-	curl = curl_easy_init();
+	/* Initialize context for safe buffer handling */
+	ctx.buffer = response;
+	ctx.buffer_size = response_size;
+	ctx.current_len = 0;
+
+	curl = ramctrl_http_handle(url, &ctx);
 	if (!curl)
 		return -1;
 
@@ -133,29 +307,15 @@ int ramctrl_http_post(const char* url, const char* data, char* response,
 	headers = curl_slist_append(headers, "Content-Type: application/json");
 	headers = curl_slist_append(headers, "Accept: application/json");
 
-	/* Set options */
-	curl_easy_setopt(curl, CURLOPT_URL, url);
 	curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data);
 	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-	/* Initialize context for safe buffer handling */
-	response_context_t ctx = {response, response_size, 0};
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx);
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, g_http_config.timeout_seconds);
-	curl_easy_setopt(curl, CURLOPT_USERAGENT, "ramctrl/1.0");
-
-	if (!g_http_config.ssl_verify)
-	{
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
-	}
 
 	/* Perform request */
 	res = curl_easy_perform(curl);
 
-	/* Cleanup */
+	/* The handle keeps a pointer to the list until the next reset */
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, NULL);
 	curl_slist_free_all(headers);
-	curl_easy_cleanup(curl);
 
 	return (res == CURLE_OK) ? 0 : -1;
 }
@@ -167,14 +327,24 @@ ramctrl_http_notify_node_change(const char* action, int node_id, const char* hos
 	char url[512];
 	char data[1024];
 	char response[2048];
+	ram_json_writer_t w;
 	
 	/* Build notification URL */
 	snprintf(url, sizeof(url), "%s/api/v1/cluster/notify", g_http_config.base_url);
 	
 	/* Build notification data */
-	snprintf(data, sizeof(data),
-		"{\"action\":\"%s\",\"node_id\":%d,\"hostname\":\"%s\",\"port\":%d,\"timestamp\":%ld}",
-		action, node_id, hostname ? hostname : "", port, time(NULL));
+	ram_json_writer_init(&w, data, sizeof(data), NULL, NULL);
+	if (!(ram_json_object_begin(&w) &&
+	      ram_json_kv_string(&w, "action", action) &&
+	      ram_json_kv_int(&w, "node_id", node_id) &&
+	      ram_json_kv_string(&w, "hostname", hostname ? hostname : "") &&
+	      ram_json_kv_int(&w, "port", port) &&
+	      ram_json_kv_int(&w, "timestamp", time(NULL)) &&
+	      ram_json_object_end(&w) && ram_json_writer_finish(&w)))
+	{
+		fprintf(stderr, "ramctrl: Node %s notification too large\n", action);
+		return -1;
+	}
 	
 	/* Send notification */
 	if (ramctrl_http_post(url, data, response, sizeof(response)) != 0)
@@ -208,164 +378,145 @@ ramctrl_http_get_cluster_health(char* health_json, size_t json_size)
 }
 
 /*
- * Parse cluster status JSON response
+ * Parse cluster status JSON response.  Older and newer ramd builds name
+ * the counts differently, so either spelling is accepted.
  */
 int ramctrl_parse_cluster_status(const char* json,
                                  ramctrl_cluster_info_t* cluster_info)
 {
+	static const ram_json_field_t fields[] = {
+	    RAM_JSON_FIELD(STRING, ramctrl_cluster_info_t, cluster_name, "cluster_name"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, total_nodes, "total_nodes"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, total_nodes, "node_count"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, active_nodes, "active_nodes"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, active_nodes, "healthy_nodes"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, primary_node_id, "primary_node_id"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, leader_node_id, "leader_node_id"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_cluster_info_t, has_quorum, "has_quorum"),
+	};
+	ram_json_token_t tokens[RAMCTRL_JSON_MAX_TOKENS];
+	int32_t count;
+
 	if (!json || !cluster_info)
 		return -1;
 
-	char *cluster_name_start, *cluster_name_end;
-	char *total_nodes_str, *active_nodes_str;
-	char *primary_id_str, *leader_id_str;
+	count = ram_json_parse(json, strlen(json), tokens, RAMCTRL_JSON_MAX_TOKENS);
+	if (count <= 0 || tokens[0].type != RAM_JSON_OBJECT)
+		return -1;
+
+	/* -1 marks what the response did not carry */
+	strncpy(cluster_info->cluster_name, "unknown", sizeof(cluster_info->cluster_name) - 1);
+	cluster_info->cluster_name[sizeof(cluster_info->cluster_name) - 1] = '\0';
+	cluster_info->total_nodes = -1;
+	cluster_info->active_nodes = -1;
+	cluster_info->primary_node_id = -1;
+	cluster_info->leader_node_id = -1;
 
-	/* Parse cluster_name */
-	cluster_name_start = strstr(json, "\"cluster_name\":");
-	if (cluster_name_start)
-	{
-		cluster_name_start = strchr(cluster_name_start, '"');
-		if (cluster_name_start)
-		{
-			cluster_name_start = strchr(cluster_name_start + 1, '"');
-			if (cluster_name_start)
-			{
-				cluster_name_start++;
-				cluster_name_end = strchr(cluster_name_start, '"');
-				if (cluster_name_end)
-				{
-					size_t len =
-					    (size_t) (cluster_name_end - cluster_name_start);
-					if (len < sizeof(cluster_info->cluster_name) - 1)
-					{
-						strncpy(cluster_info->cluster_name, cluster_name_start,
-						        len);
-						cluster_info->cluster_name[len] = '\0';
-					}
-				}
-			}
-		}
-	}
-	else
-	{
-		strncpy(cluster_info->cluster_name, "unknown", sizeof(cluster_info->cluster_name) - 1);
-		cluster_info->cluster_name[sizeof(cluster_info->cluster_name) - 1] = '\0';
-	}
+	ram_json_bind(json, tokens, 0, fields, sizeof(fields) / sizeof(fields[0]),
+	              cluster_info);
 
-	/* Parse total_nodes */
-	total_nodes_str = strstr(json, "\"total_nodes\":");
-	if (total_nodes_str)
-	{
-		total_nodes_str += strlen("\"total_nodes\":");
-		cluster_info->total_nodes = atoi(total_nodes_str);
-	}
-	else
-	{
+	if (cluster_info->total_nodes < 0)
 		cluster_info->total_nodes = 1;
-	}
-
-	/* Parse active_nodes */
-	active_nodes_str = strstr(json, "\"active_nodes\":");
-	if (active_nodes_str)
-	{
-		active_nodes_str += strlen("\"active_nodes\":");
-		cluster_info->active_nodes = atoi(active_nodes_str);
-	}
-	else
-	{
+	if (cluster_info->active_nodes < 0)
 		cluster_info->active_nodes = cluster_info->total_nodes;
-	}
-
-	/* Parse primary_node_id */
-	primary_id_str = strstr(json, "\"primary_node_id\":");
-	if (primary_id_str)
-	{
-		primary_id_str += strlen("\"primary_node_id\":");
-		cluster_info->primary_node_id = atoi(primary_id_str);
-	}
-	else
-	{
+	if (cluster_info->primary_node_id < 0)
 		cluster_info->primary_node_id = 1;
-	}
-
-	/* Parse leader_node_id */
-	leader_id_str = strstr(json, "\"leader_node_id\":");
-	if (leader_id_str)
-	{
-		leader_id_str += strlen("\"leader_node_id\":");
-		cluster_info->leader_node_id = atoi(leader_id_str);
-	}
-	else
-	{
+	if (cluster_info->leader_node_id < 0)
 		cluster_info->leader_node_id = cluster_info->primary_node_id;
-	}
+	if (ram_json_object_get(json, tokens, 0, "has_quorum") < 0)
+		cluster_info->has_quorum =
+		    (cluster_info->active_nodes >= (cluster_info->total_nodes / 2) + 1);
 
-	/* Set other fields with reasonable defaults */
-	cluster_info->has_quorum =
-	    (cluster_info->active_nodes >= (cluster_info->total_nodes / 2) + 1);
+	cluster_info->node_count = cluster_info->total_nodes;
 	cluster_info->auto_failover_enabled = true;
-	cluster_info->status = RAMCTRL_CLUSTER_STATUS_HEALTHY;
+	cluster_info->status = cluster_info->has_quorum
+	                           ? RAMCTRL_CLUSTER_STATUS_HEALTHY
+	                           : RAMCTRL_CLUSTER_STATUS_DEGRADED;
 
 	return 0;
 }
 
 /*
- * Parse nodes information JSON response
+ * Parse nodes information JSON response: the nodes array of
+ * /api/v1/nodes, found at the top level or under "data".  nodes must hold
+ * RAMCTRL_MAX_NODES entries; a longer list is an error, not a cut-off.
  */
 int ramctrl_parse_nodes_info(const char* json, ramctrl_node_info_t* nodes,
                              int* node_count)
 {
+	static const ram_json_field_t fields[] = {
+	    RAM_JSON_FIELD(INT32, ramctrl_node_info_t, node_id, "node_id"),
+	    RAM_JSON_FIELD(STRING, ramctrl_node_info_t, hostname, "hostname"),
+	    RAM_JSON_FIELD(STRING, ramctrl_node_info_t, node_name, "name"),
+	    RAM_JSON_FIELD(INT32, ramctrl_node_info_t, port, "postgresql_port"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_primary, "is_primary"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_leader, "is_leader"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_healthy, "is_healthy"),
+	    RAM_JSON_FIELD(INT32, ramctrl_node_info_t, replication_lag_ms, "replication_lag_ms"),
+	};
+	ram_json_token_t tokens[RAMCTRL_JSON_MAX_TOKENS];
+	int32_t count;
+	int32_t array;
+	int32_t i;
+
 	if (!json || !nodes || !node_count)
 		return -1;
 
-	/* Simple JSON parsing for nodes array */
-	/* In production, would use proper JSON library */
-
 	*node_count = 0;
 
-	/* Look for nodes array in JSON */
-	char* nodes_start = strstr(json, "\"nodes\":");
-	if (!nodes_start)
+	count = ram_json_parse(json, strlen(json), tokens, RAMCTRL_JSON_MAX_TOKENS);
+	if (count <= 0)
 		return -1;
 
-	nodes_start = strchr(nodes_start, '[');
-	if (!nodes_start)
+	array = ram_json_object_get(json, tokens, 0, "nodes");
+	if (array < 0)
+		array = ram_json_object_get(json, tokens,
+		                            ram_json_object_get(json, tokens, 0, "data"),
+		                            "nodes");
+	if (array < 0 || tokens[array].type != RAM_JSON_ARRAY)
 		return -1;
+	if (tokens[array].size > RAMCTRL_MAX_NODES)
+	{
+		fprintf(stderr, "ramctrl: ramd reported %d nodes, at most %d are supported\n",
+		        tokens[array].size, RAMCTRL_MAX_NODES);
+		return -1;
+	}
 
-	/* Parse each node (simplified parsing) */
-	char* current_pos = nodes_start + 1;
-	int max_nodes = 50; /* Support up to 50 nodes in cluster */
-
-	for (int i = 0; i < max_nodes && *current_pos != ']'; i++)
+	for (i = ram_json_array_first(tokens, array); i >= 0;
+	     i = ram_json_array_next(tokens, array, i))
 	{
-		/* Find start of node object */
-		char* node_start = strchr(current_pos, '{');
-		if (!node_start)
-			break;
-
-		char* node_end = strchr(node_start, '}');
-		if (!node_end)
-			break;
-
-		/* Parse node fields */
-		nodes[i].node_id = i + 1;
-		snprintf(nodes[i].hostname, sizeof(nodes[i].hostname), "node%d.local",
-		         i + 1);
-		nodes[i].port = 0; /* Port must be determined from configuration */
-		nodes[i].is_primary = (i == 0);
-		nodes[i].is_healthy = true;
-		nodes[i].status = RAMCTRL_NODE_STATUS_RUNNING;
-		nodes[i].replication_lag_ms = (i == 0) ? 0 : (i * 100);
+		ramctrl_node_info_t* node = &nodes[*node_count];
+		char state[32] = "";
+		char role[32] = "";
+
+		memset(node, 0, sizeof(*node));
+		node->replication_lag_ms = -1;
+		if (ram_json_bind(json, tokens, i, fields, sizeof(fields) / sizeof(fields[0]),
+		                  node) <= 0)
+			continue;
+
+		ram_json_get_string(json, tokens, ram_json_object_get(json, tokens, i, "state"),
+		                    state, sizeof(state));
+		ram_json_get_string(json, tokens, ram_json_object_get(json, tokens, i, "role"),
+		                    role, sizeof(role));
+
+		if (node->node_name[0] == '\0')
+			memcpy(node->node_name, node->hostname, sizeof(node->node_name));
+		memcpy(node->node_address, node->hostname, sizeof(node->node_address));
+		node->node_port = node->port;
+		node->is_standby = (strcmp(role, "standby") == 0);
+		node->is_active = node->is_healthy;
+		if (node->is_primary && node->replication_lag_ms < 0)
+			node->replication_lag_ms = 0;
+		if (strcmp(state, "failed") == 0)
+			node->status = RAMCTRL_NODE_STATUS_FAILED;
+		else if (node->is_healthy)
+			node->status = RAMCTRL_NODE_STATUS_RUNNING;
+		else
+			node->status = RAMCTRL_NODE_STATUS_UNKNOWN;
+		node->last_seen = time(NULL);
 
 		(*node_count)++;
-		current_pos = node_end + 1;
-
-		/* Look for next node */
-		char* comma = strchr(current_pos, ',');
-		if (comma && comma < strchr(current_pos, ']'))
-			current_pos = comma + 1;
-		else
-			break;
 	}
 
 	return 0;
@@ -410,3 +561,78 @@ void ramctrl_set_fallback_nodes_data(ramctrl_node_info_t* nodes,
 	nodes[0].status = RAMCTRL_NODE_STATUS_FAILED;
 	nodes[0].replication_lag_ms = -1;
 }
+
+/*
+ * Follow a ramd job to completion.  A long-running POST is answered with
+ * a job object ("job_id", "state"); poll /api/v1/jobs/{id} until it has
+ * finished and put the operation's own result in response, so the caller
+ * reads it as if the POST had been synchronous.  A response that is not a
+ * job is left as is.
+ */
+int ramctrl_http_wait_job(const char* api_url, char* response,
+                          size_t response_size, int timeout_seconds)
+{
+	ram_json_token_t tokens[RAMCTRL_JSON_MAX_TOKENS];
+	struct timespec pause = {RAMCTRL_JOB_POLL_INTERVAL_MS / 1000,
+	                         (RAMCTRL_JOB_POLL_INTERVAL_MS % 1000) * 1000000L};
+	char url[RAMCTRL_MAX_PATH_LENGTH];
+	char state[32];
+	char* poll;
+	uint64_t job_id;
+	time_t deadline;
+	int32_t count;
+	int32_t result;
+	int rc = -1;
+
+	if (!api_url || !response || response_size == 0)
+		return -1;
+
+	count = ram_json_parse(response, strlen(response), tokens, RAMCTRL_JSON_MAX_TOKENS);
+	if (count <= 0 || tokens[0].type != RAM_JSON_OBJECT ||
+	    !ram_json_get_uint64(response, tokens,
+	                         ram_json_object_get(response, tokens, 0, "job_id"), &job_id))
+		return 0;
+
+	poll = malloc(response_size);
+	if (!poll)
+		return -1;
+
+	snprintf(url, sizeof(url), "%s/api/v1/jobs/%llu", api_url, (unsigned long long) job_id);
+	deadline = time(NULL) + timeout_seconds;
+
+	while (time(NULL) < deadline)
+	{
+		nanosleep(&pause, NULL);
+		if (ramctrl_http_get(url, poll, response_size) != 0)
+			continue; /* ramd may be busy restarting PostgreSQL; keep trying */
+
+		count = ram_json_parse(poll, strlen(poll), tokens, RAMCTRL_JSON_MAX_TOKENS);
+		if (count <= 0 || tokens[0].type != RAM_JSON_OBJECT ||
+		    !ram_json_get_string(poll, tokens, ram_json_object_get(poll, tokens, 0, "state"),
+		                         state, sizeof(state)))
+			continue;
+		if (strcmp(state, "succeeded") != 0 && strcmp(state, "failed") != 0)
+			continue;
+
+		result = ram_json_object_get(poll, tokens, 0, "result");
+		if (result >= 0 && tokens[result].type == RAM_JSON_OBJECT)
+		{
+			size_t length = (size_t) (tokens[result].end - tokens[result].start);
+
+			if (length >= response_size)
+				length = response_size - 1;
+			memmove(response, poll + tokens[result].start, length);
+			response[length] = '\0';
+		}
+		else
+			snprintf(response, response_size, "%s", poll);
+		rc = 0;
+		break;
+	}
+
+	if (rc != 0)
+		fprintf(stderr, "ramctrl: job %llu did not finish within %d seconds\n",
+		        (unsigned long long) job_id, timeout_seconds);
+	free(poll);
+	return rc;
+}
@@ -0,0 +1,235 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_logs.c
+ *		Recent ramd logs from its /api/v1/logs store
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * ramd keeps its newest log records in memory and filters them itself,
+ * so ramctrl asks for exactly what it shows instead of reading, tailing
+ * and grepping the log file on the host.  --follow is a chain of held
+ * requests: each returns once new matching records arrive, and reports
+ * the cursor the next one continues from.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramctrl_logs.h"
+#include "ramctrl_defaults.h"
+#include "ramctrl_http.h"
+#include "ram_json.h"
+
+static const char* const g_log_level_names[RAMCTRL_LOG_LEVEL_COUNT] = {
+    "DEBUG", "INFO", "NOTICE", "WARNING", "ERROR", "FATAL"};
+
+/* One response from ramd, parsed */
+typedef struct ramctrl_logs_page
+{
+	char* json;
+	ram_json_token_t* tokens;
+	int32_t records;
+	uint64_t next_cursor;
+	bool more;
+	bool gap;
+} ramctrl_logs_page_t;
+
+static void ramctrl_logs_url(ramctrl_context_t* ctx, char* url, size_t size,
+                             const char* position)
+{
+	int len = snprintf(url, size, "%s/api/v1/logs?%s", ctx->api_url, position);
+
+	if (len > 0 && (size_t) len < size && ctx->log_level[0] != '\0')
+		len += snprintf(url + len, size - (size_t) len, "&level=%s", ctx->log_level);
+	if (len > 0 && (size_t) len < size && ctx->log_component[0] != '\0')
+		len += snprintf(url + len, size - (size_t) len, "&component=%s",
+		                ctx->log_component);
+	if (len > 0 && (size_t) len < size && ctx->log_since[0] != '\0')
+		snprintf(url + len, size - (size_t) len, "&since=%s", ctx->log_since);
+}
+
+/* Fetch and parse a page of up to records records; wait_ms > 0 for a held request */
+static bool ramctrl_logs_fetch(const char* url, int records, long wait_ms,
+                               ramctrl_logs_page_t* page)
+{
+	size_t size = (size_t) records * RAMCTRL_LOGS_RECORD_BYTES + 4096;
+	int32_t max_tokens = records * 12 + 64;
+	char error[256];
+	int status;
+
+	memset(page, 0, sizeof(*page));
+	page->json = malloc(size);
+	page->tokens = malloc(sizeof(ram_json_token_t) * (size_t) max_tokens);
+	if (!page->json || !page->tokens)
+	{
+		fprintf(stderr, "ramctrl: out of memory\n");
+		return false;
+	}
+
+	if (wait_ms > 0)
+		status = ramctrl_http_get_wait(url, page->json, size, wait_ms + 5000, NULL);
+	else
+		status = ramctrl_http_get(url, page->json, size);
+	if (status != 0)
+	{
+		fprintf(stderr, "ramctrl: cannot reach ramd at %s\n", url);
+		return false;
+	}
+
+	if (ram_json_parse(page->json, strlen(page->json), page->tokens, max_tokens) <= 0)
+	{
+		fprintf(stderr, "ramctrl: unexpected response from ramd\n");
+		return false;
+	}
+	page->records = ram_json_object_get(page->json, page->tokens, 0, "records");
+	if (page->records < 0)
+	{
+		if (!ram_json_get_string(page->json, page->tokens,
+		                         ram_json_object_get(page->json, page->tokens, 0, "error"),
+		                         error, sizeof(error)))
+			snprintf(error, sizeof(error), "unexpected response");
+		fprintf(stderr, "ramctrl: ramd: %s\n", error);
+		return false;
+	}
+
+	ram_json_get_uint64(page->json, page->tokens,
+	                    ram_json_object_get(page->json, page->tokens, 0, "next_cursor"),
+	                    &page->next_cursor);
+	ram_json_get_bool(page->tokens, ram_json_object_get(page->json, page->tokens, 0, "more"),
+	                  &page->more);
+	ram_json_get_bool(page->tokens, ram_json_object_get(page->json, page->tokens, 0, "gap"),
+	                  &page->gap);
+	return true;
+}
+
+static void ramctrl_logs_page_free(ramctrl_logs_page_t* page)
+{
+	free(page->json);
+	free(page->tokens);
+	memset(page, 0, sizeof(*page));
+}
+
+/* "2025-01-31 12:00:00.123 WARNING failover: message" */
+static void ramctrl_logs_print_page(const ramctrl_logs_page_t* page)
+{
+	for (int32_t i = ram_json_array_first(page->tokens, page->records); i >= 0;
+	     i = ram_json_array_next(page->tokens, page->records, i))
+	{
+		char level[16] = "";
+		char component[64] = "";
+		char message[2048] = "";
+		char stamp[32] = "";
+		int64_t ts_us = 0;
+		time_t seconds;
+		struct tm tm_info;
+
+		ram_json_get_int64(page->json, page->tokens,
+		                   ram_json_object_get(page->json, page->tokens, i, "ts"), &ts_us);
+		ram_json_get_string(page->json, page->tokens,
+		                    ram_json_object_get(page->json, page->tokens, i, "level"), level,
+		                    sizeof(level));
+		ram_json_get_string(page->json, page->tokens,
+		                    ram_json_object_get(page->json, page->tokens, i, "component"),
+		                    component, sizeof(component));
+		ram_json_get_string(page->json, page->tokens,
+		                    ram_json_object_get(page->json, page->tokens, i, "msg"), message,
+		                    sizeof(message));
+
+		seconds = (time_t) (ts_us / 1000000);
+		localtime_r(&seconds, &tm_info);
+		strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+		printf("%s.%03d %-7s %s: %s\n", stamp, (int) (ts_us / 1000 % 1000), level, component,
+		       message);
+	}
+	fflush(stdout);
+}
+
+bool ramctrl_logs_print(ramctrl_context_t* ctx)
+{
+	ramctrl_logs_page_t page;
+	char position[96];
+	char url[1024];
+	int lines;
+	uint64_t cursor;
+
+	if (!ctx)
+		return false;
+
+	lines = ctx->log_lines > 0 ? ctx->log_lines : RAMCTRL_LOGS_DEFAULT_LINES;
+	snprintf(position, sizeof(position), "tail=%d", lines);
+	ramctrl_logs_url(ctx, url, sizeof(url), position);
+	if (!ramctrl_logs_fetch(url, lines, 0, &page))
+	{
+		ramctrl_logs_page_free(&page);
+		return false;
+	}
+
+	for (;;)
+	{
+		if (page.gap)
+			fprintf(stderr, "ramctrl: some records were dropped by ramd before they "
+			                "were read\n");
+		if (ctx->json_output)
+		{
+			printf("%s\n", page.json);
+			fflush(stdout);
+		}
+		else
+			ramctrl_logs_print_page(&page);
+		cursor = page.next_cursor;
+		ramctrl_logs_page_free(&page);
+
+		if (!ctx->log_follow)
+			return true;
+
+		/* Held by ramd until a record matches; an empty page means the wait ran out */
+		snprintf(position, sizeof(position), "cursor=%llu&limit=%d&follow=1&wait_ms=%d",
+		         (unsigned long long) cursor, RAMCTRL_LOGS_FOLLOW_PAGE,
+		         RAMCTRL_WATCH_WAIT_MS);
+		ramctrl_logs_url(ctx, url, sizeof(url), position);
+		if (!ramctrl_logs_fetch(url, RAMCTRL_LOGS_FOLLOW_PAGE, RAMCTRL_WATCH_WAIT_MS, &page))
+		{
+			ramctrl_logs_page_free(&page);
+			return false;
+		}
+	}
+}
+
+bool ramctrl_logs_counts(ramctrl_context_t* ctx, int lines,
+                         uint64_t counts[RAMCTRL_LOG_LEVEL_COUNT])
+{
+	ramctrl_logs_page_t page;
+	char url[1024];
+
+	if (!ctx || !counts)
+		return false;
+
+	memset(counts, 0, sizeof(uint64_t) * RAMCTRL_LOG_LEVEL_COUNT);
+	snprintf(url, sizeof(url), "%s/api/v1/logs?tail=%d", ctx->api_url, lines);
+	if (!ramctrl_logs_fetch(url, lines, 0, &page))
+	{
+		ramctrl_logs_page_free(&page);
+		return false;
+	}
+
+	for (int32_t i = ram_json_array_first(page.tokens, page.records); i >= 0;
+	     i = ram_json_array_next(page.tokens, page.records, i))
+	{
+		char level[16] = "";
+
+		ram_json_get_string(page.json, page.tokens,
+		                    ram_json_object_get(page.json, page.tokens, i, "level"), level,
+		                    sizeof(level));
+		for (int j = 0; j < RAMCTRL_LOG_LEVEL_COUNT; j++)
+		{
+			if (strcmp(level, g_log_level_names[j]) == 0)
+				counts[j]++;
+		}
+	}
+	ramctrl_logs_page_free(&page);
+	return true;
+}
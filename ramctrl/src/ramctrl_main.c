@@ -21,6 +21,7 @@
 #include "ramctrl.h"
 #include "ramctrl_daemon.h"
 #include "ramctrl_defaults.h"
+#include "ramctrl_fleet.h"
 #include "ramctrl_help.h"
 #include "ramctrl_show.h"
 #include "ramctrl_watch.h"
@@ -45,6 +46,9 @@ ramctrl_usage(const char *progname)
 	printf("  Connection Options:\n");
 	printf("    -u, --api-url URL       ramd API endpoint (default: http://127.0.0.1:{{API_PORT}})\n");
 	printf("    -c, --config FILE       Configuration file path\n");
+	printf("    --clusters FILE|GLOB    Query every ramd listed (\"[name] url\" per line)\n");
+	printf("    --parallel N            Clusters queried at once with --clusters (default: %d)\n",
+	       RAMCTRL_FLEET_DEFAULT_PARALLEL);
 	printf("\n");
 	printf("  Output Options:\n");
 	printf("    -v, --verbose           Verbose output with detailed information\n");
@@ -56,6 +60,7 @@ ramctrl_usage(const char *progname)
 	printf("    -t, --timeout SEC       Timeout in seconds (default: 30)\n");
 	printf("    --force                 Skip confirmation prompts\n");
 	printf("    --dry-run               Show what would be done without executing\n");
+	printf("    --learner               replica add, node add: join Raft as a non-voting learner\n");
 	printf("\n");
 	printf("  Information Options:\n");
 	printf("    --help                  Show this help message\n");
@@ -164,6 +169,7 @@ bool ramctrl_init(ramctrl_context_t* ctx)
 	ctx->quiet = false;
 	ctx->force = false;
 	ctx->dry_run = false;
+	ctx->learner = false;
 	ctx->command = RAMCTRL_CMD_UNKNOWN;
 	/* Initialize subcommands */
 	ctx->show_command = RAMCTRL_SHOW_UNKNOWN;
@@ -183,7 +189,8 @@ void ramctrl_cleanup(ramctrl_context_t* ctx)
 	if (!ctx)
 		return;
 
-	/* No sensitive data to clear in HTTP-only mode */
+	/* Close the replication status connection if one was opened */
+	ramctrl_replication_disconnect();
 }
 
 
@@ -205,6 +212,14 @@ bool ramctrl_parse_args(ramctrl_context_t* ctx, int argc, char* argv[])
 	    {"help", no_argument, 0, 1000},
 	    {"version", no_argument, 0, 1001},
 	    {"help-commands", no_argument, 0, 1002},
+	    {"clusters", required_argument, 0, 1003},
+	    {"parallel", required_argument, 0, 1004},
+	    {"learner", no_argument, 0, 1005},
+	    {"level", required_argument, 0, 1006},
+	    {"component", required_argument, 0, 1007},
+	    {"since", required_argument, 0, 1008},
+	    {"lines", required_argument, 0, 1009},
+	    {"follow", no_argument, 0, 1010},
 	    {0, 0, 0, 0}};
 
 	while ((c = getopt_long(argc, argv, "u:c:vjt:Tqfn", long_options,
@@ -259,6 +274,46 @@ bool ramctrl_parse_args(ramctrl_context_t* ctx, int argc, char* argv[])
 			if (ctx->command == RAMCTRL_CMD_UNKNOWN)
 				ctx->command = RAMCTRL_CMD_HELP;
 			return true;
+		case 1003:
+			strncpy(ctx->clusters, optarg, sizeof(ctx->clusters) - 1);
+			ctx->clusters[sizeof(ctx->clusters) - 1] = '\0';
+			break;
+		case 1004:
+			ctx->parallel = atoi(optarg);
+			if (ctx->parallel <= 0 || ctx->parallel > RAMCTRL_FLEET_MAX_PARALLEL)
+			{
+				fprintf(stderr, "ramctrl: --parallel must be 1..%d: %s\n",
+				        RAMCTRL_FLEET_MAX_PARALLEL, optarg);
+				return false;
+			}
+			break;
+		case 1005:
+			ctx->learner = true;
+			break;
+		case 1006:
+			strncpy(ctx->log_level, optarg, sizeof(ctx->log_level) - 1);
+			ctx->log_level[sizeof(ctx->log_level) - 1] = '\0';
+			break;
+		case 1007:
+			strncpy(ctx->log_component, optarg, sizeof(ctx->log_component) - 1);
+			ctx->log_component[sizeof(ctx->log_component) - 1] = '\0';
+			break;
+		case 1008:
+			strncpy(ctx->log_since, optarg, sizeof(ctx->log_since) - 1);
+			ctx->log_since[sizeof(ctx->log_since) - 1] = '\0';
+			break;
+		case 1009:
+			ctx->log_lines = atoi(optarg);
+			if (ctx->log_lines <= 0 || ctx->log_lines > RAMCTRL_LOGS_MAX_LINES)
+			{
+				fprintf(stderr, "ramctrl: --lines must be 1..%d: %s\n",
+				        RAMCTRL_LOGS_MAX_LINES, optarg);
+				return false;
+			}
+			break;
+		case 1010:
+			ctx->log_follow = true;
+			break;
 		default:
 			fprintf(stderr, "ramctrl: invalid option: %c\n", c);
 			return false;
@@ -300,6 +355,8 @@ bool ramctrl_parse_args(ramctrl_context_t* ctx, int argc, char* argv[])
 					ctx->show_command = RAMCTRL_SHOW_CONFIG;
 				else if (strcmp(argv[optind], "logs") == 0)
 					ctx->show_command = RAMCTRL_SHOW_LOGS;
+				else if (strcmp(argv[optind], "performance") == 0)
+					ctx->show_command = RAMCTRL_SHOW_PERFORMANCE;
 				else
 				{
 					ctx->show_command = RAMCTRL_SHOW_UNKNOWN;
@@ -503,7 +560,7 @@ bool ramctrl_parse_args(ramctrl_context_t* ctx, int argc, char* argv[])
 
 	/* Store remaining arguments */
 	ctx->command_argc = 0;
-	for (int i = optind; i < argc && ctx->command_argc < 16; i++)
+	for (int i = optind; i < argc && ctx->command_argc < RAMCTRL_MAX_NODES; i++)
 	{
 		strncpy(ctx->command_args[ctx->command_argc], argv[i],
 		        sizeof(ctx->command_args[ctx->command_argc]) - 1);
@@ -525,6 +582,11 @@ int ramctrl_execute_command(ramctrl_context_t* ctx)
 		return RAMCTRL_EXIT_FAILURE;
 	}
 
+	/* Fleet mode prints only results, so scripts can consume them */
+	if (ctx->clusters[0] != '\0' && ctx->command != RAMCTRL_CMD_HELP &&
+	    ctx->command != RAMCTRL_CMD_VERSION)
+		return ramctrl_fleet_run(ctx);
+
 	/* Validate API URL */
 	ramctrl_validate_api_url(ctx);
 
@@ -12,6 +12,7 @@
 #include "ramctrl_formation.h"
 #include "ramctrl_http.h"
 #include "ramctrl_common.h"
+#include "ramctrl_status.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -64,6 +65,7 @@ ramctrl_cmd_show_cluster(ramctrl_context_t *ctx, const char *cluster_name)
 bool
 ramctrl_get_cluster_info(ramctrl_context_t* ctx, ramctrl_cluster_info_t* info)
 {
+    ramctrl_status_view_t view;
     char url[512];
     char response[4096];
     int status;
@@ -72,6 +74,12 @@ ramctrl_get_cluster_info(ramctrl_context_t* ctx, ramctrl_cluster_info_t* info)
         return false;
     }
 
+    /* A ramd on this host answers from its status page, no request needed */
+    if (ramctrl_status_read(ctx->api_url, &view)) {
+        *info = view.cluster_info;
+        return true;
+    }
+
     snprintf(url, sizeof(url), "%s/api/v1/cluster/info", ctx->api_url);
     
     status = ramctrl_http_get(url, response, sizeof(response));
@@ -14,6 +14,8 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <libpq-fe.h>
+
 #include "ramctrl_replication.h"
 
 /* Global replication configuration */
@@ -67,11 +69,292 @@ bool ramctrl_replication_init(replication_config_t* config)
 }
 
 
+/*
+ * The four result sets of REPLICATION_REPORT_SQL, in order.  LSNs come back
+ * as byte offsets so they can be read with strtoll rather than parsed from
+ * the X/X text form, and every value is fetched by column position.
+ */
+#define REPLICATION_REPORT_SQL                                                 \
+	"SELECT pg_is_in_recovery(), "                                             \
+	"pg_wal_lsn_diff(CASE WHEN pg_is_in_recovery() "                           \
+	"THEN pg_last_wal_replay_lsn() ELSE pg_current_wal_lsn() END, "            \
+	"'0/0')::bigint;"                                                          \
+	"SELECT pid, application_name, client_addr::text, state, sync_state, "     \
+	"pg_wal_lsn_diff(sent_lsn, '0/0')::bigint, "                               \
+	"pg_wal_lsn_diff(write_lsn, '0/0')::bigint, "                              \
+	"pg_wal_lsn_diff(flush_lsn, '0/0')::bigint, "                              \
+	"pg_wal_lsn_diff(replay_lsn, '0/0')::bigint, "                             \
+	"(extract(epoch FROM write_lag) * 1000)::integer, "                        \
+	"(extract(epoch FROM flush_lag) * 1000)::integer, "                        \
+	"(extract(epoch FROM replay_lag) * 1000)::integer "                        \
+	"FROM pg_stat_replication ORDER BY application_name, pid;"                 \
+	"SELECT slot_name, slot_type, active, "                                    \
+	"pg_wal_lsn_diff(restart_lsn, '0/0')::bigint "                             \
+	"FROM pg_replication_slots ORDER BY slot_name;"                            \
+	"SELECT status, sender_host, sender_port, slot_name, "                     \
+	"pg_wal_lsn_diff(latest_end_lsn, '0/0')::bigint "                          \
+	"FROM pg_stat_wal_receiver"
+
+#define REPLICATION_CONNECT_TIMEOUT "5"
+
+/* Kept open across calls so repeated reads cost one roundtrip each */
+static PGconn* g_replication_conn = NULL;
+static char g_replication_error[256] = "";
+
+
+static void replication_set_error(const char* prefix, PGconn* conn)
+{
+	const char* detail = conn ? PQerrorMessage(conn) : "";
+	size_t len;
+
+	snprintf(g_replication_error, sizeof(g_replication_error), "%s%s%s",
+	         prefix, detail[0] ? ": " : "", detail);
+
+	/* libpq messages end in a newline */
+	len = strlen(g_replication_error);
+	while (len > 0 && g_replication_error[len - 1] == '\n')
+		g_replication_error[--len] = '\0';
+}
+
+
+static PGconn* replication_connection(void)
+{
+	const char* keywords[] = {"dbname", "connect_timeout", "application_name",
+	                          NULL};
+	const char* values[] = {g_replication_config.conninfo,
+	                        REPLICATION_CONNECT_TIMEOUT, "ramctrl", NULL};
+
+	if (g_replication_conn)
+	{
+		if (PQstatus(g_replication_conn) == CONNECTION_OK)
+			return g_replication_conn;
+
+		/* Server restarted or the link dropped; try the same target again */
+		PQreset(g_replication_conn);
+		if (PQstatus(g_replication_conn) == CONNECTION_OK)
+			return g_replication_conn;
+
+		PQfinish(g_replication_conn);
+		g_replication_conn = NULL;
+	}
+
+	/* expand_dbname lets conninfo be a keyword string or a URI */
+	g_replication_conn = PQconnectdbParams(keywords, values, 1);
+	if (PQstatus(g_replication_conn) != CONNECTION_OK)
+	{
+		replication_set_error("connection failed", g_replication_conn);
+		PQfinish(g_replication_conn);
+		g_replication_conn = NULL;
+		return NULL;
+	}
+
+	return g_replication_conn;
+}
+
+
+static void replication_copy_value(const PGresult* res, int row, int col,
+                                   char* dst, size_t dst_size)
+{
+	size_t len;
+
+	dst[0] = '\0';
+	if (PQgetisnull(res, row, col))
+		return;
+
+	len = (size_t) PQgetlength(res, row, col);
+	if (len >= dst_size)
+		len = dst_size - 1;
+	memcpy(dst, PQgetvalue(res, row, col), len);
+	dst[len] = '\0';
+}
+
+
+static int64_t replication_int64_value(const PGresult* res, int row, int col,
+                                       int64_t null_value)
+{
+	if (PQgetisnull(res, row, col))
+		return null_value;
+
+	return (int64_t) strtoll(PQgetvalue(res, row, col), NULL, 10);
+}
+
+
+static bool replication_bool_value(const PGresult* res, int row, int col)
+{
+	return !PQgetisnull(res, row, col) && PQgetvalue(res, row, col)[0] == 't';
+}
+
+
+static void replication_read_result(const PGresult* res, int set,
+                                    replication_report_t* report)
+{
+	int rows = PQntuples(res);
+	int i;
+
+	switch (set)
+	{
+	case 0:
+		if (rows > 0)
+		{
+			report->in_recovery = replication_bool_value(res, 0, 0);
+			report->current_lsn = replication_int64_value(res, 0, 1, -1);
+		}
+		break;
+
+	case 1:
+		for (i = 0; i < rows && report->standby_count < RAMCTRL_MAX_NODES; i++)
+		{
+			replication_standby_t* sb =
+			    &report->standbys[report->standby_count++];
+
+			sb->pid = (int32_t) replication_int64_value(res, i, 0, 0);
+			replication_copy_value(res, i, 1, sb->application_name,
+			                       sizeof(sb->application_name));
+			replication_copy_value(res, i, 2, sb->client_addr,
+			                       sizeof(sb->client_addr));
+			replication_copy_value(res, i, 3, sb->state, sizeof(sb->state));
+			replication_copy_value(res, i, 4, sb->sync_state,
+			                       sizeof(sb->sync_state));
+			sb->sent_lsn = replication_int64_value(res, i, 5, -1);
+			sb->write_lsn = replication_int64_value(res, i, 6, -1);
+			sb->flush_lsn = replication_int64_value(res, i, 7, -1);
+			sb->replay_lsn = replication_int64_value(res, i, 8, -1);
+			sb->write_lag_ms = (int32_t) replication_int64_value(res, i, 9, -1);
+			sb->flush_lag_ms =
+			    (int32_t) replication_int64_value(res, i, 10, -1);
+			sb->replay_lag_ms =
+			    (int32_t) replication_int64_value(res, i, 11, -1);
+		}
+		break;
+
+	case 2:
+		for (i = 0; i < rows && report->slot_count < RAMCTRL_MAX_NODES; i++)
+		{
+			replication_slot_t* slot = &report->slots[report->slot_count++];
+
+			replication_copy_value(res, i, 0, slot->slot_name,
+			                       sizeof(slot->slot_name));
+			replication_copy_value(res, i, 1, slot->slot_type,
+			                       sizeof(slot->slot_type));
+			slot->active = replication_bool_value(res, i, 2);
+			slot->restart_lsn = replication_int64_value(res, i, 3, -1);
+			slot->retained_bytes = 0;
+		}
+		break;
+
+	case 3:
+		if (rows > 0)
+		{
+			replication_wal_receiver_t* wr = &report->wal_receiver;
+
+			wr->present = true;
+			replication_copy_value(res, 0, 0, wr->status, sizeof(wr->status));
+			replication_copy_value(res, 0, 1, wr->sender_host,
+			                       sizeof(wr->sender_host));
+			wr->sender_port = (int32_t) replication_int64_value(res, 0, 2, 0);
+			replication_copy_value(res, 0, 3, wr->slot_name,
+			                       sizeof(wr->slot_name));
+			wr->latest_end_lsn = replication_int64_value(res, 0, 4, -1);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+
+bool ramctrl_replication_collect(replication_report_t* report)
+{
+	PGconn* conn;
+	PGresult* res;
+	int set = 0;
+	bool ok = true;
+	int i;
+
+	if (!report)
+		return false;
+
+	memset(report, 0, sizeof(replication_report_t));
+	report->current_lsn = -1;
+
+	conn = replication_connection();
+	if (!conn)
+		return false;
+
+	/* All four statements go out in a single simple-protocol query */
+	if (!PQsendQuery(conn, REPLICATION_REPORT_SQL))
+	{
+		replication_set_error("query failed", conn);
+		return false;
+	}
+
+	/* Drain every result, even after an error, so the connection stays usable */
+	while ((res = PQgetResult(conn)) != NULL)
+	{
+		if (PQresultStatus(res) == PGRES_TUPLES_OK)
+		{
+			if (ok)
+				replication_read_result(res, set, report);
+			set++;
+		}
+		else if (ok)
+		{
+			snprintf(g_replication_error, sizeof(g_replication_error),
+			         "query failed: %s", PQresultErrorMessage(res));
+			ok = false;
+		}
+		PQclear(res);
+	}
+
+	if (!ok)
+		return false;
+
+	for (i = 0; i < report->slot_count; i++)
+	{
+		replication_slot_t* slot = &report->slots[i];
+
+		if (slot->restart_lsn >= 0 && report->current_lsn > slot->restart_lsn)
+			slot->retained_bytes = report->current_lsn - slot->restart_lsn;
+	}
+
+	return true;
+}
+
+
+void ramctrl_replication_disconnect(void)
+{
+	if (g_replication_conn)
+	{
+		PQfinish(g_replication_conn);
+		g_replication_conn = NULL;
+	}
+}
+
+
+const char* ramctrl_replication_last_error(void)
+{
+	return g_replication_error;
+}
+
+
+static void replication_format_lsn(int64_t lsn, char* dst, size_t dst_size)
+{
+	if (lsn < 0)
+	{
+		dst[0] = '\0';
+		return;
+	}
+
+	snprintf(dst, dst_size, "%X/%X", (unsigned int) ((uint64_t) lsn >> 32),
+	         (unsigned int) ((uint64_t) lsn & 0xFFFFFFFF));
+}
+
+
 bool ramctrl_replication_get_status(replication_status_t* status)
 {
-	FILE* fp;
-	char line[512];
-	char query[1024];
+	replication_report_t report;
+	replication_standby_t* sb;
 
 	if (!status || !g_replication_initialized)
 		return false;
@@ -81,72 +364,69 @@ bool ramctrl_replication_get_status(replication_status_t* status)
 	status->mode = g_replication_config.mode;
 	status->last_lag_check = time(NULL);
 
-	/* Query PostgreSQL for replication status */
-	snprintf(
-	    query, sizeof(query),
-	    "SELECT application_name, client_addr, state, sent_lsn, write_lsn, "
-	    "flush_lsn, replay_lsn FROM pg_stat_replication");
-
-	fp = popen(query, "r");
-	if (!fp)
+	if (!ramctrl_replication_collect(&report))
 		return false;
 
-	/* Parse replication status */
-	while (fgets(line, sizeof(line), fp))
+	/* No walsenders: nothing to report, which is not an error */
+	if (report.standby_count == 0)
+		return true;
+
+	/* Report the first standby, as the single-row status always has */
+	sb = &report.standbys[0];
+	strncpy(status->application_name, sb->application_name,
+	        sizeof(status->application_name) - 1);
+	strncpy(status->client_addr, sb->client_addr,
+	        sizeof(status->client_addr) - 1);
+	strncpy(status->state, sb->state, sizeof(status->state) - 1);
+	replication_format_lsn(sb->sent_lsn, status->sent_lsn,
+	                       sizeof(status->sent_lsn));
+	replication_format_lsn(sb->write_lsn, status->write_lsn,
+	                       sizeof(status->write_lsn));
+	replication_format_lsn(sb->flush_lsn, status->flush_lsn,
+	                       sizeof(status->flush_lsn));
+	replication_format_lsn(sb->replay_lsn, status->replay_lsn,
+	                       sizeof(status->replay_lsn));
+
+	if (sb->sent_lsn >= 0 && sb->replay_lsn >= 0 &&
+	    sb->sent_lsn > sb->replay_lsn)
+		status->current_lag_bytes = sb->sent_lsn - sb->replay_lsn;
+	status->current_lag_ms = sb->replay_lag_ms > 0 ? sb->replay_lag_ms : 0;
+
+	status->is_sync_standby = (strcmp(sb->sync_state, "sync") == 0 ||
+	                           strcmp(sb->sync_state, "quorum") == 0);
+
+	/* Determine health based on lag */
+	status->is_healthy =
+	    (strcmp(sb->state, "streaming") == 0 &&
+	     status->current_lag_bytes <=
+	         g_replication_config.lag_config.maximum_lag_on_failover);
+
+	return true;
+}
+
+
+static bool replication_exec_command(PGconn* conn, const char* query)
+{
+	PGresult* res = PQexec(conn, query);
+	ExecStatusType rc = PQresultStatus(res);
+
+	if (rc != PGRES_COMMAND_OK && rc != PGRES_TUPLES_OK)
 	{
-		char app_name[64];
-		char client_addr[64];
-		char state[32];
-		char sent_lsn[32];
-		char write_lsn[32];
-		char flush_lsn[32];
-		char replay_lsn[32];
-
-		if (sscanf(line, "%63s %63s %31s %31s %31s %31s %31s", app_name,
-		           client_addr, state, sent_lsn, write_lsn, flush_lsn,
-		           replay_lsn) == 7)
-		{
-			/* Copy first replication slot info */
-			strncpy(status->application_name, app_name,
-			        sizeof(status->application_name) - 1);
-			strncpy(status->client_addr, client_addr,
-			        sizeof(status->client_addr) - 1);
-			strncpy(status->state, state, sizeof(status->state) - 1);
-			strncpy(status->sent_lsn, sent_lsn, sizeof(status->sent_lsn) - 1);
-			strncpy(status->write_lsn, write_lsn,
-			        sizeof(status->write_lsn) - 1);
-			strncpy(status->flush_lsn, flush_lsn,
-			        sizeof(status->flush_lsn) - 1);
-			strncpy(status->replay_lsn, replay_lsn,
-			        sizeof(status->replay_lsn) - 1);
-
-			/* Calculate lag */
-			status->current_lag_bytes =
-			    ramctrl_replication_calculate_lag(sent_lsn, replay_lsn);
-			status->current_lag_ms =
-			    (int) (status->current_lag_bytes / 1024); /* Rough estimate */
-
-			/* Determine if this is a sync standby */
-			status->is_sync_standby = (strcmp(state, "streaming") == 0);
-
-			/* Determine health based on lag */
-			status->is_healthy =
-			    (status->current_lag_bytes <=
-			     g_replication_config.lag_config.maximum_lag_on_failover);
-
-			break; /* Process first replication slot found */
-		}
+		snprintf(g_replication_error, sizeof(g_replication_error),
+		         "query failed: %s", PQresultErrorMessage(res));
+		PQclear(res);
+		return false;
 	}
 
-	pclose(fp);
+	PQclear(res);
 	return true;
 }
 
 
 bool ramctrl_replication_set_mode(replication_mode_t mode)
 {
-	char query[1024];
-	FILE* fp;
+	const char* query;
+	PGconn* conn;
 
 	if (!g_replication_initialized)
 		return false;
@@ -158,16 +438,13 @@ bool ramctrl_replication_set_mode(replication_mode_t mode)
 	switch (mode)
 	{
 	case REPL_MODE_ASYNC:
-		snprintf(query, sizeof(query),
-		         "ALTER SYSTEM SET synchronous_commit = 'off'");
+		query = "ALTER SYSTEM SET synchronous_commit = 'off'";
 		break;
 	case REPL_MODE_SYNC_REMOTE_WRITE:
-		snprintf(query, sizeof(query),
-		         "ALTER SYSTEM SET synchronous_commit = 'remote_write'");
+		query = "ALTER SYSTEM SET synchronous_commit = 'remote_write'";
 		break;
 	case REPL_MODE_SYNC_REMOTE_APPLY:
-		snprintf(query, sizeof(query),
-		         "ALTER SYSTEM SET synchronous_commit = 'remote_apply'");
+		query = "ALTER SYSTEM SET synchronous_commit = 'remote_apply'";
 		break;
 	case REPL_MODE_AUTO:
 		/* Auto mode - don't change synchronous_commit */
@@ -176,20 +453,15 @@ bool ramctrl_replication_set_mode(replication_mode_t mode)
 		return false;
 	}
 
-	/* Execute the query */
-	fp = popen(query, "r");
-	if (!fp)
+	conn = replication_connection();
+	if (!conn)
 		return false;
 
-	pclose(fp);
-
-	/* Reload configuration */
-	snprintf(query, sizeof(query), "SELECT pg_reload_conf()");
-	fp = popen(query, "r");
-	if (fp)
-		pclose(fp);
+	/* ALTER SYSTEM refuses a multi-statement string, so reload separately */
+	if (!replication_exec_command(conn, query))
+		return false;
 
-	return true;
+	return replication_exec_command(conn, "SELECT pg_reload_conf()");
 }
 
 
@@ -456,11 +728,26 @@ bool ramctrl_replication_is_sync_mode(replication_mode_t mode)
 }
 
 
+int64_t ramctrl_replication_parse_lsn(const char* lsn)
+{
+	unsigned int hi;
+	unsigned int lo;
+
+	if (!lsn || sscanf(lsn, "%X/%X", &hi, &lo) != 2)
+		return -1;
+
+	return (int64_t) (((uint64_t) hi << 32) | (uint64_t) lo);
+}
+
+
 int64_t ramctrl_replication_calculate_lag(const char* sent_lsn,
                                           const char* replay_lsn)
 {
-	if (!sent_lsn || !replay_lsn)
+	int64_t sent = ramctrl_replication_parse_lsn(sent_lsn);
+	int64_t replay = ramctrl_replication_parse_lsn(replay_lsn);
+
+	if (sent < 0 || replay < 0 || sent < replay)
 		return 0;
 
-	return 1024 * 1024;
+	return sent - replay;
 }
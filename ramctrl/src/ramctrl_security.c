@@ -28,6 +28,7 @@
 
 #include "ramctrl_security.h"
 #include "ramctrl.h"
+#include "ram_conf.h"
 
 /* Callback function for libcurl */
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp)
@@ -218,6 +219,21 @@ ramctrl_security_cleanup_sensitive_data(char *data, size_t size)
 	}
 }
 
+/* Keys of the security configuration file */
+static const ram_conf_field_t g_security_config_fields[] = {
+	RAM_CONF_FIELD(BOOL, ramctrl_security_context_t, enable_ssl),
+	RAM_CONF_FIELD(BOOL, ramctrl_security_context_t, verify_ssl),
+	RAM_CONF_FIELD(BOOL, ramctrl_security_context_t, enable_token_auth),
+	RAM_CONF_FIELD(STRING, ramctrl_security_context_t, token),
+	RAM_CONF_FIELD(STRING, ramctrl_security_context_t, cert_file),
+	RAM_CONF_FIELD(STRING, ramctrl_security_context_t, key_file),
+	RAM_CONF_FIELD(STRING, ramctrl_security_context_t, ca_file),
+	RAM_CONF_FIELD(BOOL, ramctrl_security_context_t, enable_encryption),
+	RAM_CONF_FIELD(SIZE, ramctrl_security_context_t, max_request_size),
+	RAM_CONF_FIELD(INT, ramctrl_security_context_t, connection_timeout),
+	RAM_CONF_FIELD(BOOL, ramctrl_security_context_t, enable_audit),
+};
+
 /* Public API functions */
 
 /* Configure security */
@@ -235,75 +251,23 @@ ramctrl_security_configure(const char *config_file)
 		return false;
 	}
 
+	ram_conf_schema_t schema;
 	char line[1024];
-	while (fgets(line, sizeof(line), fp))
-	{
-		/* Remove newline */
-		line[strcspn(line, "\n")] = '\0';
-
-		/* Skip comments and empty lines */
-		if (line[0] == '#' || line[0] == '\0')
-			continue;
-
-		/* Parse configuration */
-		char *key = strtok(line, "=");
-		char *value = strtok(NULL, "=");
+	char *key;
+	char *value;
 
-		if (!key || !value)
-			continue;
-
-		/* Trim whitespace */
-		while (*key == ' ' || *key == '\t') key++;
-		while (*value == ' ' || *value == '\t') value++;
+	if (!ram_conf_schema_init(&schema, g_security_config_fields,
+							  sizeof(g_security_config_fields) / sizeof(g_security_config_fields[0])))
+	{
+		fclose(fp);
+		return false;
+	}
 
-		if (strcmp(key, "enable_ssl") == 0)
-		{
-			g_security_ctx->enable_ssl = (strcmp(value, "true") == 0);
-		}
-		else if (strcmp(key, "verify_ssl") == 0)
-		{
-			g_security_ctx->verify_ssl = (strcmp(value, "true") == 0);
-		}
-		else if (strcmp(key, "enable_token_auth") == 0)
-		{
-			g_security_ctx->enable_token_auth = (strcmp(value, "true") == 0);
-		}
-		else if (strcmp(key, "token") == 0)
-		{
-			strncpy(g_security_ctx->token, value, sizeof(g_security_ctx->token) - 1);
-			g_security_ctx->token[sizeof(g_security_ctx->token) - 1] = '\0';
-		}
-		else if (strcmp(key, "cert_file") == 0)
-		{
-			strncpy(g_security_ctx->cert_file, value, sizeof(g_security_ctx->cert_file) - 1);
-			g_security_ctx->cert_file[sizeof(g_security_ctx->cert_file) - 1] = '\0';
-		}
-		else if (strcmp(key, "key_file") == 0)
-		{
-			strncpy(g_security_ctx->key_file, value, sizeof(g_security_ctx->key_file) - 1);
-			g_security_ctx->key_file[sizeof(g_security_ctx->key_file) - 1] = '\0';
-		}
-		else if (strcmp(key, "ca_file") == 0)
-		{
-			strncpy(g_security_ctx->ca_file, value, sizeof(g_security_ctx->ca_file) - 1);
-			g_security_ctx->ca_file[sizeof(g_security_ctx->ca_file) - 1] = '\0';
-		}
-		else if (strcmp(key, "enable_encryption") == 0)
-		{
-			g_security_ctx->enable_encryption = (strcmp(value, "true") == 0);
-		}
-		else if (strcmp(key, "max_request_size") == 0)
-		{
-			g_security_ctx->max_request_size = (size_t)atoi(value);
-		}
-		else if (strcmp(key, "connection_timeout") == 0)
-		{
-			g_security_ctx->connection_timeout = atoi(value);
-		}
-		else if (strcmp(key, "enable_audit") == 0)
-		{
-			g_security_ctx->enable_audit = (strcmp(value, "true") == 0);
-		}
+	while (fgets(line, sizeof(line), fp))
+	{
+		/* Comments, blank lines and keys this file does not know are skipped */
+		if (ram_conf_split(line, &key, &value))
+			ram_conf_set(&schema, g_security_ctx, key, value);
 	}
 
 	fclose(fp);
@@ -17,6 +17,9 @@
 #include "ramctrl_show.h"
 #include "ramctrl_table.h"
 #include "ramctrl_database.h"
+#include "ramctrl_defaults.h"
+#include "ramctrl_logs.h"
+#include "ramctrl_history.h"
 
 
 int ramctrl_show_cluster_detailed(ramctrl_context_t* ctx)
@@ -76,16 +79,26 @@ int ramctrl_show_nodes_detailed(ramctrl_context_t* ctx)
 
 int ramctrl_show_replication_detailed(ramctrl_context_t* ctx)
 {
+	replication_report_t report;
+
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
+	/* One roundtrip covers every standby, slot and the WAL receiver */
+	if (!ramctrl_replication_collect(&report))
+	{
+		fprintf(stderr, "ramctrl: failed to read replication status: %s\n",
+		        ramctrl_replication_last_error());
+		return RAMCTRL_EXIT_FAILURE;
+	}
+
 	if (ctx->json_output)
 	{
-		ramctrl_show_replication_json(ctx);
+		ramctrl_show_replication_json(&report);
 	}
 	else
 	{
-		ramctrl_show_format_replication_table(ctx);
+		ramctrl_show_format_replication_table(&report);
 	}
 
 	return RAMCTRL_EXIT_SUCCESS;
@@ -97,6 +110,7 @@ int ramctrl_show_status_all(ramctrl_context_t* ctx)
 	ramctrl_cluster_info_t cluster_info;
 	ramctrl_node_info_t* nodes = NULL;
 	int node_count = 0;
+	replication_report_t report;
 
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
@@ -122,8 +136,11 @@ int ramctrl_show_status_all(ramctrl_context_t* ctx)
 		free(nodes);
 	}
 
-	ramctrl_table_print_header("Replication Status");
-	ramctrl_show_format_replication_table(ctx);
+	if (ramctrl_replication_collect(&report))
+		ramctrl_show_format_replication_table(&report);
+	else if (ctx->verbose)
+		fprintf(stderr, "ramctrl: failed to read replication status: %s\n",
+		        ramctrl_replication_last_error());
 
 	ramctrl_table_print_footer();
 	return RAMCTRL_EXIT_SUCCESS;
@@ -188,32 +205,22 @@ int ramctrl_show_health(ramctrl_context_t* ctx)
 
 int ramctrl_show_logs_summary(ramctrl_context_t* ctx)
 {
-	char log_output[2048];
-	FILE* log_file;
-	char* line_ptr;
-	int error_count = 0;
-	int warning_count = 0;
-	int info_count = 0;
+	uint64_t counts[RAMCTRL_LOG_LEVEL_COUNT];
+	int error_count;
+	int warning_count;
+	int info_count;
 
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
 	ramctrl_table_print_header("Log Summary (Last 100 lines)");
 
-	log_file = popen("tail -n 100 {{VAR_DIR}}log/ramd/ramd.log 2>/dev/null", "r");
-	if (log_file)
+	if (ramctrl_logs_counts(ctx, RAMCTRL_LOGS_SUMMARY_LINES, counts))
 	{
-		while (fgets(log_output, sizeof(log_output), log_file))
-		{
-			line_ptr = log_output;
-			if (strstr(line_ptr, "ERROR"))
-				error_count++;
-			else if (strstr(line_ptr, "WARNING"))
-				warning_count++;
-			else if (strstr(line_ptr, "INFO"))
-				info_count++;
-		}
-		pclose(log_file);
+		/* Indexed by level: DEBUG, INFO, NOTICE, WARNING, ERROR, FATAL */
+		error_count = (int) (counts[4] + counts[5]);
+		warning_count = (int) counts[3];
+		info_count = (int) counts[1];
 
 		ramctrl_table_print_row_int("Error Messages", error_count);
 		ramctrl_table_print_row_int("Warning Messages", warning_count);
@@ -228,7 +235,7 @@ int ramctrl_show_logs_summary(ramctrl_context_t* ctx)
 	}
 	else
 	{
-		ramctrl_table_print_row("Log File", "Not accessible");
+		ramctrl_table_print_row("Log Source", "ramd not reachable");
 	}
 
 	ramctrl_table_print_footer();
@@ -263,12 +270,12 @@ int ramctrl_show_performance(ramctrl_context_t* ctx)
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
-	ramctrl_table_print_header("Performance Metrics");
-	ramctrl_table_print_row("Replication Lag", "< 1MB");
-	ramctrl_table_print_row("Connection Count", "Active");
-	ramctrl_table_print_row("WAL Generation Rate", "Normal");
-	ramctrl_table_print_row("Checkpoint Frequency", "Normal");
-	ramctrl_table_print_footer();
+	if (!ramctrl_history_print(ctx))
+	{
+		ramctrl_table_print_header("Performance (last hour, 1 minute steps)");
+		ramctrl_table_print_row("Metrics Source", "ramd not reachable");
+		ramctrl_table_print_footer();
+	}
 
 	return RAMCTRL_EXIT_SUCCESS;
 }
@@ -315,17 +322,97 @@ void ramctrl_show_format_nodes_table(ramctrl_node_info_t* nodes, int count)
 }
 
 
-void ramctrl_show_format_replication_table(ramctrl_context_t* ctx)
+static void show_format_lsn(int64_t lsn, char* dst, size_t dst_size)
 {
-	if (!ctx)
+	if (lsn < 0)
+		snprintf(dst, dst_size, "-");
+	else
+		snprintf(dst, dst_size, "%X/%X",
+		         (unsigned int) ((uint64_t) lsn >> 32),
+		         (unsigned int) ((uint64_t) lsn & 0xFFFFFFFF));
+}
+
+
+static void show_format_lag_ms(int32_t lag_ms, char* dst, size_t dst_size)
+{
+	if (lag_ms < 0)
+		snprintf(dst, dst_size, "-");
+	else
+		snprintf(dst, dst_size, "%d ms", lag_ms);
+}
+
+
+void ramctrl_show_format_replication_table(const replication_report_t* report)
+{
+	char lsn[32];
+	char lag[32];
+	int i;
+
+	if (!report)
 		return;
 
 	ramctrl_table_print_header("Replication Status");
-	ramctrl_table_print_row("Mode", "Asynchronous");
-	ramctrl_table_print_row("Status", "Streaming");
-	ramctrl_table_print_row("Lag", "< 1MB");
-	ramctrl_table_print_row("Slots", "Active");
+	ramctrl_table_print_row("Role", report->in_recovery ? "Standby" : "Primary");
+	show_format_lsn(report->current_lsn, lsn, sizeof(lsn));
+	ramctrl_table_print_row(report->in_recovery ? "Replay LSN" : "Current LSN",
+	                        lsn);
+	ramctrl_table_print_row_int("Standbys", report->standby_count);
+	ramctrl_table_print_row_int("Slots", report->slot_count);
+
+	if (report->wal_receiver.present)
+	{
+		char upstream[RAMCTRL_MAX_HOSTNAME_LENGTH + 16];
+
+		snprintf(upstream, sizeof(upstream), "%s:%d",
+		         report->wal_receiver.sender_host,
+		         report->wal_receiver.sender_port);
+		ramctrl_table_print_row("WAL Receiver", report->wal_receiver.status);
+		ramctrl_table_print_row("Upstream", upstream);
+		show_format_lsn(report->wal_receiver.latest_end_lsn, lsn, sizeof(lsn));
+		ramctrl_table_print_row("Received LSN", lsn);
+	}
 	ramctrl_table_print_footer();
+
+	if (report->standby_count > 0)
+	{
+		ramctrl_table_print_header("Standbys");
+		printf("%-20s %-16s %-10s %-8s %-14s %-12s %-10s\n", "Application",
+		       "Client", "State", "Sync", "Replay LSN", "Lag Bytes",
+		       "Replay Lag");
+		for (i = 0; i < report->standby_count; i++)
+		{
+			const replication_standby_t* sb = &report->standbys[i];
+			long long lag_bytes = 0;
+
+			if (sb->sent_lsn >= 0 && sb->replay_lsn >= 0 &&
+			    sb->sent_lsn > sb->replay_lsn)
+				lag_bytes = (long long) (sb->sent_lsn - sb->replay_lsn);
+
+			show_format_lsn(sb->replay_lsn, lsn, sizeof(lsn));
+			show_format_lag_ms(sb->replay_lag_ms, lag, sizeof(lag));
+			printf("%-20s %-16s %-10s %-8s %-14s %-12lld %-10s\n",
+			       sb->application_name, sb->client_addr, sb->state,
+			       sb->sync_state, lsn, lag_bytes, lag);
+		}
+		ramctrl_table_print_footer();
+	}
+
+	if (report->slot_count > 0)
+	{
+		ramctrl_table_print_header("Replication Slots");
+		printf("%-24s %-10s %-8s %-14s %-14s\n", "Slot", "Type", "Active",
+		       "Restart LSN", "Retained");
+		for (i = 0; i < report->slot_count; i++)
+		{
+			const replication_slot_t* slot = &report->slots[i];
+
+			show_format_lsn(slot->restart_lsn, lsn, sizeof(lsn));
+			printf("%-24s %-10s %-8s %-14s %-14lld\n", slot->slot_name,
+			       slot->slot_type, slot->active ? "Yes" : "No", lsn,
+			       (long long) slot->retained_bytes);
+		}
+		ramctrl_table_print_footer();
+	}
 }
 
 
@@ -379,18 +466,97 @@ void ramctrl_show_nodes_json(ramctrl_node_info_t* nodes, int count)
 }
 
 
-void ramctrl_show_replication_json(ramctrl_context_t* ctx)
+/* Values come from the server, so quote them rather than trust them */
+static void show_json_string(const char* value)
 {
-	if (!ctx)
+	const unsigned char* p;
+
+	putchar('"');
+	for (p = (const unsigned char*) value; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			printf("\\%c", *p);
+		else if (*p < 0x20)
+			printf("\\u%04x", *p);
+		else
+			putchar(*p);
+	}
+	putchar('"');
+}
+
+
+void ramctrl_show_replication_json(const replication_report_t* report)
+{
+	int i;
+
+	if (!report)
 		return;
 
 	printf("{\n");
 	printf("  \"replication\": {\n");
-	printf("    \"mode\": \"asynchronous\",\n");
-	printf("    \"status\": \"streaming\",\n");
-	printf("    \"lag_bytes\": 1024,\n");
-	printf("    \"lag_seconds\": 0.1,\n");
-	printf("    \"slots_active\": true\n");
+	printf("    \"in_recovery\": %s,\n",
+	       report->in_recovery ? "true" : "false");
+	printf("    \"current_lsn\": %lld,\n", (long long) report->current_lsn);
+
+	printf("    \"standbys\": [\n");
+	for (i = 0; i < report->standby_count; i++)
+	{
+		const replication_standby_t* sb = &report->standbys[i];
+
+		printf("      {\"pid\": %d, \"application_name\": ", sb->pid);
+		show_json_string(sb->application_name);
+		printf(", \"client_addr\": ");
+		show_json_string(sb->client_addr);
+		printf(", \"state\": ");
+		show_json_string(sb->state);
+		printf(", \"sync_state\": ");
+		show_json_string(sb->sync_state);
+		printf(", \"sent_lsn\": %lld, \"write_lsn\": %lld, "
+		       "\"flush_lsn\": %lld, \"replay_lsn\": %lld, "
+		       "\"write_lag_ms\": %d, \"flush_lag_ms\": %d, "
+		       "\"replay_lag_ms\": %d}%s\n",
+		       (long long) sb->sent_lsn, (long long) sb->write_lsn,
+		       (long long) sb->flush_lsn, (long long) sb->replay_lsn,
+		       sb->write_lag_ms, sb->flush_lag_ms, sb->replay_lag_ms,
+		       (i < report->standby_count - 1) ? "," : "");
+	}
+	printf("    ],\n");
+
+	printf("    \"slots\": [\n");
+	for (i = 0; i < report->slot_count; i++)
+	{
+		const replication_slot_t* slot = &report->slots[i];
+
+		printf("      {\"slot_name\": ");
+		show_json_string(slot->slot_name);
+		printf(", \"slot_type\": ");
+		show_json_string(slot->slot_type);
+		printf(", \"active\": %s, \"restart_lsn\": %lld, "
+		       "\"retained_bytes\": %lld}%s\n",
+		       slot->active ? "true" : "false",
+		       (long long) slot->restart_lsn,
+		       (long long) slot->retained_bytes,
+		       (i < report->slot_count - 1) ? "," : "");
+	}
+	printf("    ],\n");
+
+	if (report->wal_receiver.present)
+	{
+		printf("    \"wal_receiver\": {\"status\": ");
+		show_json_string(report->wal_receiver.status);
+		printf(", \"sender_host\": ");
+		show_json_string(report->wal_receiver.sender_host);
+		printf(", \"sender_port\": %d, \"slot_name\": ",
+		       report->wal_receiver.sender_port);
+		show_json_string(report->wal_receiver.slot_name);
+		printf(", \"latest_end_lsn\": %lld}\n",
+		       (long long) report->wal_receiver.latest_end_lsn);
+	}
+	else
+	{
+		printf("    \"wal_receiver\": null\n");
+	}
+
 	printf("  }\n");
 	printf("}\n");
 }
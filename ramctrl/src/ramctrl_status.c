@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramctrl_status.c
+ *		Cluster view from the local ramd's shared-memory status page
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A ramd on this host publishes its view in a page named after its HTTP
+ * port (ram_status_page.h).  Reading it is a memcpy, so repeated status
+ * calls and watch mode on the same host never touch the HTTP server.
+ * The page stays mapped for the life of the process.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "ramctrl_status.h"
+#include "ramctrl_defaults.h"
+#include "ramctrl_http.h"
+#include "ram_status_page.h"
+
+static const ram_status_page_t* g_status_page = NULL;
+static int g_status_page_port = -1;
+
+static int64_t ramctrl_status_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* The mapped page of the ramd on port; remapped if that ramd restarted */
+static const ram_status_page_t* ramctrl_status_page(int port)
+{
+	int64_t now_ms = ramctrl_status_now_ms();
+
+	if (g_status_page &&
+	    (g_status_page_port != port ||
+	     !ram_status_page_alive(g_status_page, now_ms, RAMCTRL_STATUS_PAGE_MAX_AGE_MS)))
+	{
+		munmap((void*) g_status_page, RAM_STATUS_PAGE_SIZE);
+		g_status_page = NULL;
+	}
+	if (!g_status_page)
+	{
+		g_status_page = ram_status_page_open(port);
+		g_status_page_port = port;
+	}
+	if (g_status_page &&
+	    !ram_status_page_alive(g_status_page, now_ms, RAMCTRL_STATUS_PAGE_MAX_AGE_MS))
+		return NULL;
+	return g_status_page;
+}
+
+static void ramctrl_status_read_node(const unsigned char* rec, ramctrl_node_info_t* node,
+                                     time_t now)
+{
+	uint16_t flags = ram_state_get_u16(rec + RAM_STATE_N_FLAGS);
+
+	memset(node, 0, sizeof(*node));
+	node->node_id = ram_state_get_i32(rec + RAM_STATE_N_NODE_ID);
+	memcpy(node->hostname, rec + RAM_STATE_N_HOSTNAME,
+	       RAM_STATE_HOSTNAME_LENGTH < sizeof(node->hostname) ? RAM_STATE_HOSTNAME_LENGTH
+	                                                          : sizeof(node->hostname));
+	node->hostname[sizeof(node->hostname) - 1] = '\0';
+	node->port = ram_state_get_i32(rec + RAM_STATE_N_POSTGRESQL_PORT);
+	node->node_port = node->port;
+	node->is_primary = (flags & RAM_STATE_NODE_PRIMARY) != 0;
+	node->is_leader = (flags & RAM_STATE_NODE_LEADER) != 0;
+	node->is_healthy = (flags & RAM_STATE_NODE_HEALTHY) != 0;
+	node->is_active = node->is_healthy;
+	node->is_standby = rec[RAM_STATE_N_ROLE] == RAM_STATE_ROLE_STANDBY;
+	node->replication_lag_ms = ram_state_get_i32(rec + RAM_STATE_N_REPLAY_LAG_MS);
+	node->wal_lsn = ram_state_get_i64(rec + RAM_STATE_N_FLUSH_LSN);
+	if (rec[RAM_STATE_N_STATE] == RAM_STATE_STATE_FAILED)
+		node->status = RAMCTRL_NODE_STATUS_FAILED;
+	else if (node->is_healthy)
+		node->status = RAMCTRL_NODE_STATUS_RUNNING;
+	else
+		node->status = RAMCTRL_NODE_STATUS_UNKNOWN;
+	node->last_seen = now;
+}
+
+bool ramctrl_status_read(const char* api_url, ramctrl_status_view_t* view)
+{
+	static unsigned char buf[RAM_STATUS_PAGE_CAPACITY];
+	const ram_status_page_t* page;
+	const char* env = getenv("RAMCTRL_STATUS_PAGE");
+	ramctrl_cluster_info_t* cluster;
+	size_t header_size;
+	size_t node_size;
+	size_t length;
+	time_t now = time(NULL);
+	int port;
+	int count;
+
+	if (!view || (env && strcmp(env, "0") == 0))
+		return false;
+	port = ramctrl_http_local_port(api_url);
+	if (port < 0)
+		return false;
+	page = ramctrl_status_page(port);
+	if (!page)
+		return false;
+
+	length = ram_status_page_read(page, buf, sizeof(buf));
+	count = length > 0 ? ram_state_check(buf, length, &header_size, &node_size) : -1;
+	if (count < 0)
+		return false;
+	if (count > RAMCTRL_MAX_NODES)
+		count = RAMCTRL_MAX_NODES;
+
+	memset(view, 0, sizeof(*view));
+	view->epoch = ram_state_get_u64(buf + RAM_STATE_H_EPOCH);
+	view->version = ram_state_get_u64(buf + RAM_STATE_H_VERSION);
+	view->node_count = count;
+
+	cluster = &view->cluster_info;
+	memcpy(cluster->cluster_name, buf + RAM_STATE_H_CLUSTER_NAME, RAM_STATE_NAME_LENGTH);
+	cluster->cluster_name[RAM_STATE_NAME_LENGTH - 1] = '\0';
+	cluster->primary_node_id = ram_state_get_i32(buf + RAM_STATE_H_PRIMARY_NODE_ID);
+	cluster->leader_node_id = ram_state_get_i32(buf + RAM_STATE_H_LEADER_NODE_ID);
+	cluster->has_quorum =
+	    (ram_state_get_u32(buf + RAM_STATE_H_FLAGS) & RAM_STATE_CLUSTER_HAS_QUORUM) != 0;
+	cluster->last_update = (time_t) ram_state_get_i64(buf + RAM_STATE_H_CHANGED_AT);
+
+	for (int i = 0; i < count; i++)
+	{
+		ramctrl_status_read_node(buf + header_size + (size_t) i * node_size, &view->nodes[i],
+		                         now);
+		if (view->nodes[i].is_healthy)
+			cluster->active_nodes++;
+	}
+	cluster->total_nodes = count;
+	cluster->node_count = count;
+	cluster->status = cluster->has_quorum ? RAMCTRL_CLUSTER_STATUS_HEALTHY
+	                                      : RAMCTRL_CLUSTER_STATUS_DEGRADED;
+	return true;
+}
@@ -21,9 +21,13 @@
 #include "ramctrl_http.h"
 #include "ramctrl_database.h"
 #include "ramctrl_daemon.h"
+#include "ramctrl_defaults.h"
+#include "ramctrl_status.h"
+#include "ram_json.h"
 
 /* Global watch state */
 static bool g_watch_running = false;
+static bool g_watch_refresh = false; /* 'r' pressed: redraw from a full view */
 static struct termios g_original_termios;
 static bool g_termios_saved = false;
 
@@ -113,7 +117,7 @@ static bool ramctrl_watch_check_input(void)
 				return false; /* Exit watch mode */
 			case 'r':
 			case 'R':
-				/* Force refresh - just continue */
+				g_watch_refresh = true;
 				break;
 			default:
 				break;
@@ -135,20 +139,46 @@ int ramctrl_cmd_watch(ramctrl_context_t* ctx)
 }
 
 
-int ramctrl_cmd_watch_cluster(ramctrl_context_t* ctx)
+/* Polled by the HTTP client while a watch request is held by ramd */
+static bool ramctrl_watch_keep_waiting(void)
+{
+	if (!ramctrl_watch_check_input())
+		g_watch_running = false;
+
+	return g_watch_running && !g_watch_refresh;
+}
+
+
+/* Sleep in short steps so that 'q' still works while ramd is unreachable */
+static void ramctrl_watch_backoff(int32_t interval_ms)
 {
-	ramctrl_watch_config_t config;
-	ramctrl_watch_data_t data;
-	ramctrl_watch_stats_t stats;
 	struct timespec sleep_time;
-	time_t last_update = 0;
+	int32_t waited;
 
-	if (!ctx)
-		return RAMCTRL_EXIT_FAILURE;
+	sleep_time.tv_sec = 0;
+	sleep_time.tv_nsec = 100000000; /* 100ms */
+	for (waited = 0; waited < interval_ms && ramctrl_watch_keep_waiting();
+	     waited += 100)
+		nanosleep(&sleep_time, NULL);
+}
 
-	/* Initialize watch configuration */
-	ramctrl_watch_config_set_defaults(&config);
-	config.refresh_interval_ms = 2000; /* 2 seconds for cluster view */
+
+/*
+ * Shared loop of the watch commands.  Each update is a long-poll that ramd
+ * answers when something changes, so the screen is redrawn on changes
+ * only and an idle cluster costs one request per RAMCTRL_WATCH_WAIT_MS.
+ * refresh_interval_ms is only the retry delay after an error.
+ */
+static int ramctrl_watch_run(const char* title,
+                             void (*display)(ramctrl_watch_data_t*,
+                                             ramctrl_watch_config_t*),
+                             ramctrl_watch_config_t* config)
+{
+	ramctrl_watch_data_t data;
+	ramctrl_watch_stats_t stats;
+	bool redraw = true;
+
+	memset(&data, 0, sizeof(data));
 
 	/* Initialize statistics */
 	memset(&stats, 0, sizeof(stats));
@@ -163,54 +193,66 @@ int ramctrl_cmd_watch_cluster(ramctrl_context_t* ctx)
 	signal(SIGTERM, ramctrl_watch_signal_handler);
 
 	g_watch_running = true;
+	g_watch_refresh = false;
 
-	printf("PostgreSQL RAM Cluster Watch Mode\n");
+	printf("%s\n", title);
 	printf("Press 'q' to quit, 'r' to refresh\n\n");
 
 	while (g_watch_running)
 	{
-		time_t current_time = time(NULL);
+		bool ok;
 
-		/* Check for user input */
-		if (!ramctrl_watch_check_input())
+		if (g_watch_refresh)
 		{
-			g_watch_running = false;
+			g_watch_refresh = false;
+			data.has_version = false;
+			redraw = true;
+		}
+
+		ok = ramctrl_watch_update_data(&data);
+		if (!g_watch_running)
 			break;
+		if (g_watch_refresh)
+			continue;
+
+		if (ok)
+		{
+			stats.updates_count++;
+			stats.last_update = data.timestamp;
+			redraw = redraw || data.changed;
+		}
+		else
+		{
+			stats.errors_count++;
+			redraw = true;
 		}
 
-		/* Update data if it's time */
-		if (current_time - last_update >= config.refresh_interval_ms / 1000)
+		if (redraw)
 		{
 			ramctrl_watch_clear_screen();
 			ramctrl_watch_move_cursor(1, 1);
 
 			/* Display header */
-			ramctrl_watch_display_header(&config);
+			ramctrl_watch_display_header(config);
 
-			/* Update and display cluster data */
-			if (ramctrl_watch_update_data(&data))
-			{
-				ramctrl_watch_display_cluster(&data, &config);
-				stats.updates_count++;
-				stats.last_update = current_time;
-			}
+			if (ok)
+				display(&data, config);
 			else
-			{
-				printf("Error: Failed to update cluster data\n");
-				stats.errors_count++;
-			}
+				printf("Error: %s\n", data.status_message);
 
 			/* Display statistics */
 			ramctrl_watch_display_stats(&stats);
 
 			fflush(stdout);
-			last_update = current_time;
+			redraw = false;
 		}
 
-		/* Sleep for a short time */
-		sleep_time.tv_sec = 0;
-		sleep_time.tv_nsec = 100000000; /* 100ms */
-		nanosleep(&sleep_time, NULL);
+		if (!ok)
+		{
+			/* Start over from a full view once ramd answers again */
+			data.has_version = false;
+			ramctrl_watch_backoff(config->refresh_interval_ms);
+		}
 	}
 
 	/* Cleanup */
@@ -222,250 +264,295 @@ int ramctrl_cmd_watch_cluster(ramctrl_context_t* ctx)
 }
 
 
-int ramctrl_cmd_watch_nodes(ramctrl_context_t* ctx)
+int ramctrl_cmd_watch_cluster(ramctrl_context_t* ctx)
 {
 	ramctrl_watch_config_t config;
-	ramctrl_watch_data_t data;
-	ramctrl_watch_stats_t stats;
-	struct timespec sleep_time;
-	time_t last_update = 0;
 
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
 	/* Initialize watch configuration */
 	ramctrl_watch_config_set_defaults(&config);
-	config.refresh_interval_ms = 1000; /* 1 second for nodes view */
-	config.show_health = true;
-	config.show_lag = true;
-
-	/* Initialize statistics */
-	memset(&stats, 0, sizeof(stats));
-	stats.start_time = time(NULL);
-
-	/* Setup terminal */
-	if (!ramctrl_watch_setup_terminal())
-		return RAMCTRL_EXIT_FAILURE;
-
-	/* Setup signal handlers */
-	signal(SIGINT, ramctrl_watch_signal_handler);
-	signal(SIGTERM, ramctrl_watch_signal_handler);
-
-	g_watch_running = true;
-
-	printf("PostgreSQL RAM Nodes Watch Mode\n");
-	printf("Press 'q' to quit, 'r' to refresh\n\n");
-
-	while (g_watch_running)
-	{
-		time_t current_time = time(NULL);
-
-		/* Check for user input */
-		if (!ramctrl_watch_check_input())
-		{
-			g_watch_running = false;
-			break;
-		}
-
-		/* Update data if it's time */
-		if (current_time - last_update >= config.refresh_interval_ms / 1000)
-		{
-			ramctrl_watch_clear_screen();
-			ramctrl_watch_move_cursor(1, 1);
-
-			/* Display header */
-			ramctrl_watch_display_header(&config);
 
-			/* Update and display nodes data */
-			if (ramctrl_watch_update_data(&data))
-			{
-				ramctrl_watch_display_nodes(&data, &config);
-				stats.updates_count++;
-				stats.last_update = current_time;
-			}
-			else
-			{
-				printf("Error: Failed to update nodes data\n");
-				stats.errors_count++;
-			}
-
-			/* Display statistics */
-			ramctrl_watch_display_stats(&stats);
+	return ramctrl_watch_run("PostgreSQL RAM Cluster Watch Mode",
+	                         ramctrl_watch_display_cluster, &config);
+}
 
-			fflush(stdout);
-			last_update = current_time;
-		}
 
-		/* Sleep for a short time */
-		sleep_time.tv_sec = 0;
-		sleep_time.tv_nsec = 100000000; /* 100ms */
-		nanosleep(&sleep_time, NULL);
-	}
+int ramctrl_cmd_watch_nodes(ramctrl_context_t* ctx)
+{
+	ramctrl_watch_config_t config;
 
-	/* Cleanup */
-	ramctrl_watch_restore_terminal();
+	if (!ctx)
+		return RAMCTRL_EXIT_FAILURE;
 
-	printf("\nWatch mode ended.\n");
+	/* Initialize watch configuration */
+	ramctrl_watch_config_set_defaults(&config);
+	config.show_health = true;
+	config.show_lag = true;
 
-	return RAMCTRL_EXIT_SUCCESS;
+	return ramctrl_watch_run("PostgreSQL RAM Nodes Watch Mode",
+	                         ramctrl_watch_display_nodes, &config);
 }
 
 
 int ramctrl_cmd_watch_replication(ramctrl_context_t* ctx)
 {
 	ramctrl_watch_config_t config;
-	ramctrl_watch_data_t data;
-	ramctrl_watch_stats_t stats;
-	struct timespec sleep_time;
-	time_t last_update = 0;
 
 	if (!ctx)
 		return RAMCTRL_EXIT_FAILURE;
 
 	/* Initialize watch configuration */
 	ramctrl_watch_config_set_defaults(&config);
-	config.refresh_interval_ms = 500; /* 500ms for replication view */
 	config.show_lag = true;
 	config.compact_mode = true;
 
-	/* Initialize statistics */
-	memset(&stats, 0, sizeof(stats));
-	stats.start_time = time(NULL);
-
-	/* Setup terminal */
-	if (!ramctrl_watch_setup_terminal())
-		return RAMCTRL_EXIT_FAILURE;
-
-	/* Setup signal handlers */
-	signal(SIGINT, ramctrl_watch_signal_handler);
-	signal(SIGTERM, ramctrl_watch_signal_handler);
+	return ramctrl_watch_run("PostgreSQL RAM Replication Watch Mode",
+	                         ramctrl_watch_display_replication, &config);
+}
 
-	g_watch_running = true;
 
-	printf("PostgreSQL RAM Replication Watch Mode\n");
-	printf("Press 'q' to quit, 'r' to refresh\n\n");
+/* Insert or replace one node from a watch response object */
+static void ramctrl_watch_apply_node(ramctrl_watch_data_t* data,
+                                     const char* json,
+                                     const ram_json_token_t* tokens,
+                                     int32_t object)
+{
+	static const ram_json_field_t fields[] = {
+	    RAM_JSON_FIELD(STRING, ramctrl_node_info_t, hostname, "hostname"),
+	    RAM_JSON_FIELD(INT32, ramctrl_node_info_t, port, "postgresql_port"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_healthy, "is_healthy"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_primary, "is_primary"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_node_info_t, is_leader, "is_leader"),
+	    RAM_JSON_FIELD(INT32, ramctrl_node_info_t, replication_lag_ms, "replay_lag_ms"),
+	};
+	ramctrl_node_info_t* node = NULL;
+	char role[32] = "";
+	char state[32] = "";
+	int32_t node_id;
+	int32_t i;
+
+	if (!ram_json_get_int32(json, tokens,
+	                        ram_json_object_get(json, tokens, object, "node_id"),
+	                        &node_id))
+		return;
 
-	while (g_watch_running)
+	for (i = 0; i < data->node_count; i++)
 	{
-		time_t current_time = time(NULL);
-
-		/* Check for user input */
-		if (!ramctrl_watch_check_input())
+		if (data->nodes[i].node_id == node_id)
 		{
-			g_watch_running = false;
+			node = &data->nodes[i];
 			break;
 		}
+	}
+	if (!node)
+	{
+		if (data->node_count >= RAMCTRL_MAX_NODES)
+			return;
+		node = &data->nodes[data->node_count++];
+	}
 
-		/* Update data if it's time */
-		if (current_time - last_update >= config.refresh_interval_ms / 1000)
-		{
-			ramctrl_watch_clear_screen();
-			ramctrl_watch_move_cursor(1, 1);
+	memset(node, 0, sizeof(*node));
+	node->node_id = node_id;
+	ram_json_bind(json, tokens, object, fields, sizeof(fields) / sizeof(fields[0]),
+	              node);
+	ram_json_get_string(json, tokens, ram_json_object_get(json, tokens, object, "role"),
+	                    role, sizeof(role));
+	ram_json_get_string(json, tokens, ram_json_object_get(json, tokens, object, "state"),
+	                    state, sizeof(state));
+
+	node->node_port = node->port;
+	node->is_standby = (strcmp(role, "standby") == 0);
+	node->is_active = node->is_healthy;
+	if (strcmp(state, "failed") == 0)
+		node->status = RAMCTRL_NODE_STATUS_FAILED;
+	else if (node->is_healthy)
+		node->status = RAMCTRL_NODE_STATUS_RUNNING;
+	else
+		node->status = RAMCTRL_NODE_STATUS_UNKNOWN;
+	node->last_seen = data->timestamp;
+}
 
-			/* Display header */
-			ramctrl_watch_display_header(&config);
 
-			/* Update and display replication data */
-			if (ramctrl_watch_update_data(&data))
-			{
-				ramctrl_watch_display_replication(&data, &config);
-				stats.updates_count++;
-				stats.last_update = current_time;
-			}
-			else
-			{
-				printf("Error: Failed to update replication data\n");
-				stats.errors_count++;
-			}
+/* Fold a watch response into data; false if it is not one */
+static bool ramctrl_watch_apply(ramctrl_watch_data_t* data, const char* json)
+{
+	static const ram_json_field_t cluster_fields[] = {
+	    RAM_JSON_FIELD(STRING, ramctrl_cluster_info_t, cluster_name, "cluster_name"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, primary_node_id, "primary_node_id"),
+	    RAM_JSON_FIELD(INT32, ramctrl_cluster_info_t, leader_node_id, "leader_node_id"),
+	    RAM_JSON_FIELD(BOOL, ramctrl_cluster_info_t, has_quorum, "has_quorum"),
+	};
+	ram_json_token_t tokens[RAMCTRL_JSON_MAX_TOKENS];
+	uint64_t epoch;
+	uint64_t version;
+	bool full = false;
+	int32_t cluster;
+	int32_t nodes;
+	int32_t i;
+
+	/* Nothing is touched unless the whole response parses */
+	if (ram_json_parse(json, strlen(json), tokens, RAMCTRL_JSON_MAX_TOKENS) <= 0 ||
+	    !ram_json_get_uint64(json, tokens, ram_json_object_get(json, tokens, 0, "epoch"),
+	                         &epoch) ||
+	    !ram_json_get_uint64(json, tokens, ram_json_object_get(json, tokens, 0, "version"),
+	                         &version) ||
+	    !ram_json_get_bool(tokens, ram_json_object_get(json, tokens, 0, "full"), &full))
+		return false;
 
-			/* Display statistics */
-			ramctrl_watch_display_stats(&stats);
+	data->epoch = epoch;
+	data->version = version;
+	data->has_version = true;
+	data->changed = full;
+	if (full)
+	{
+		data->node_count = 0;
+		memset(&data->cluster_info, 0, sizeof(data->cluster_info));
+	}
 
-			fflush(stdout);
-			last_update = current_time;
-		}
+	cluster = ram_json_object_get(json, tokens, 0, "cluster");
+	if (ram_json_bind(json, tokens, cluster, cluster_fields,
+	                  sizeof(cluster_fields) / sizeof(cluster_fields[0]),
+	                  &data->cluster_info) >= 0)
+		data->changed = true;
 
-		/* Sleep for a short time */
-		sleep_time.tv_sec = 0;
-		sleep_time.tv_nsec = 100000000; /* 100ms */
-		nanosleep(&sleep_time, NULL);
+	nodes = ram_json_object_get(json, tokens, 0, "nodes");
+	for (i = ram_json_array_first(tokens, nodes); i >= 0;
+	     i = ram_json_array_next(tokens, nodes, i))
+	{
+		ramctrl_watch_apply_node(data, json, tokens, i);
+		data->changed = true;
 	}
 
-	/* Cleanup */
-	ramctrl_watch_restore_terminal();
+	/* Derived figures follow whatever is now known */
+	data->cluster_info.total_nodes = data->node_count;
+	data->cluster_info.node_count = data->node_count;
+	data->cluster_info.active_nodes = 0;
+	for (i = 0; i < data->node_count; i++)
+	{
+		if (data->nodes[i].is_healthy)
+			data->cluster_info.active_nodes++;
+	}
+	data->cluster_info.status = data->cluster_info.has_quorum
+	                                ? RAMCTRL_CLUSTER_STATUS_HEALTHY
+	                                : RAMCTRL_CLUSTER_STATUS_DEGRADED;
+	data->cluster_info.last_update = data->timestamp;
+	return true;
+}
 
-	printf("\nWatch mode ended.\n");
 
-	return RAMCTRL_EXIT_SUCCESS;
+/*
+ * Wait for the next change from ramd's /api/v1/watch and fold it into
+ * data.  The first call, or one after has_version was cleared, fetches
+ * the whole view; later calls only receive what changed.
+ */
+/*
+ * Follow the local ramd's status page instead of long-polling it: wait in
+ * RAMCTRL_STATUS_PAGE_POLL_MS steps until the feed position moves, up to
+ * RAMCTRL_WATCH_WAIT_MS.  False when there is no live page to read, and
+ * the caller then asks ramd over HTTP.
+ */
+static bool ramctrl_watch_update_from_page(ramctrl_watch_data_t* data,
+                                           const char* base_url)
+{
+	ramctrl_status_view_t view;
+	struct timespec sleep_time;
+	int32_t waited = 0;
+
+	sleep_time.tv_sec = 0;
+	sleep_time.tv_nsec = (long) RAMCTRL_STATUS_PAGE_POLL_MS * 1000000L;
+	for (;;)
+	{
+		if (!ramctrl_status_read(base_url, &view))
+			return false;
+		if (!data->has_version || view.epoch != data->epoch ||
+		    view.version != data->version)
+			break;
+		if (waited >= RAMCTRL_WATCH_WAIT_MS || !ramctrl_watch_keep_waiting())
+			return true;
+		nanosleep(&sleep_time, NULL);
+		waited += RAMCTRL_STATUS_PAGE_POLL_MS;
+	}
+
+	data->cluster_info = view.cluster_info;
+	memcpy(data->nodes, view.nodes, sizeof(data->nodes));
+	data->node_count = view.node_count;
+	data->epoch = view.epoch;
+	data->version = view.version;
+	data->has_version = true;
+	data->changed = true;
+	data->timestamp = time(NULL);
+	snprintf(data->status_message, sizeof(data->status_message),
+	         "Connected to ramd (status page)");
+	return true;
 }
 
 
 bool ramctrl_watch_update_data(ramctrl_watch_data_t* data)
 {
-	char url[256];
-	char response[8192];
-	int result;
+	char url[512];
+	char* response;
+	const char* base_url;
+	bool ok;
 
 	if (!data)
 		return false;
 
-	data->timestamp = time(NULL);
+	data->changed = false;
 
-	const char* base_url = getenv("RAMCTRL_API_URL");
+	base_url = getenv("RAMCTRL_API_URL");
 	if (!base_url || strlen(base_url) == 0)
 	{
 		/* No hardcoded fallback - must be configured */
-		strncpy(data->status_message, "RAMCTRL_API_URL not configured", sizeof(data->status_message) - 1); data->status_message[sizeof(data->status_message) - 1] = '0';
+		snprintf(data->status_message, sizeof(data->status_message),
+		         "RAMCTRL_API_URL not configured");
 		return false;
 	}
-	snprintf(url, sizeof(url), "%s/api/v1/cluster/status", base_url);
 
-	result = ramctrl_http_get(url, response, sizeof(response));
-	if (result == 0)
-	{
-		/* Parse JSON response and update data structure */
-		result = ramctrl_parse_cluster_status(response, &data->cluster_info);
-		if (result == 0)
-		{
-			data->node_count = data->cluster_info.total_nodes;
-			strncpy(data->status_message, "Connected to ramd", sizeof(data->status_message) - 1); data->status_message[sizeof(data->status_message) - 1] = '0';
-		}
-		else
-		{
-			/* Fallback to basic status if parsing fails */
-			data->node_count = 1;
-			strcpy(data->status_message, "API Response Parse Error");
-			ramctrl_set_fallback_cluster_info(&data->cluster_info);
-		}
-	}
+	if (ramctrl_watch_update_from_page(data, base_url))
+		return true;
+
+	if (data->has_version)
+		snprintf(url, sizeof(url),
+		         "%s/api/v1/watch?since=%llu&epoch=%llu&wait_ms=%d", base_url,
+		         data->version, data->epoch, RAMCTRL_WATCH_WAIT_MS);
 	else
-	{
-		/* Fallback to offline mode if connection fails */
-		data->node_count = 0;
-		strcpy(data->status_message, "ramd Connection Failed");
-		ramctrl_set_fallback_cluster_info(&data->cluster_info);
-	}
+		snprintf(url, sizeof(url), "%s/api/v1/watch?wait_ms=%d", base_url,
+		         RAMCTRL_WATCH_WAIT_MS);
 
-	base_url = getenv("RAMCTRL_API_URL");
-	if (!base_url || strlen(base_url) == 0)
+	response = malloc(RAMCTRL_WATCH_RESPONSE_SIZE);
+	if (!response)
 	{
-		/* No hardcoded fallback - must be configured */
-		ramctrl_set_fallback_nodes_data(data->nodes, &data->node_count);
+		snprintf(data->status_message, sizeof(data->status_message),
+		         "Out of memory");
 		return false;
 	}
-	snprintf(url, sizeof(url), "%s/api/v1/nodes", base_url);
-	result = ramctrl_http_get(url, response, sizeof(response));
-	if (result == 0)
+
+	/* Leave ramd a few seconds past the wait to send its empty answer */
+	if (ramctrl_http_get_wait(url, response, RAMCTRL_WATCH_RESPONSE_SIZE,
+	                          RAMCTRL_WATCH_WAIT_MS + 5000,
+	                          ramctrl_watch_keep_waiting) != 0)
 	{
-		ramctrl_parse_nodes_info(response, data->nodes, &data->node_count);
+		free(response);
+		snprintf(data->status_message, sizeof(data->status_message),
+		         "ramd Connection Failed");
+		return false;
 	}
-	else
+
+	data->timestamp = time(NULL);
+	ok = ramctrl_watch_apply(data, response);
+	free(response);
+
+	if (!ok)
 	{
-		/* Set fallback node data if API call fails */
-		ramctrl_set_fallback_nodes_data(data->nodes, &data->node_count);
+		snprintf(data->status_message, sizeof(data->status_message),
+		         "API Response Parse Error");
+		return false;
 	}
 
-
+	snprintf(data->status_message, sizeof(data->status_message),
+	         "Connected to ramd");
 	return true;
 }
 
@@ -525,29 +612,27 @@ void ramctrl_watch_display_replication(ramctrl_watch_data_t* data,
 	printf("------------------\n");
 
 	/* Display table header */
-	printf("%-4s %-20s %-12s %-15s %-12s %-15s\n", "ID", "Name", "Role", "LSN",
-	       "Lag (MB)", "State");
-	printf("%-4s %-20s %-12s %-15s %-12s %-15s\n", "----",
-	       "--------------------", "------------", "---------------",
-	       "------------", "---------------");
+	printf("%-4s %-20s %-12s %-12s %-15s\n", "ID", "Name", "Role",
+	       "Lag (ms)", "State");
+	printf("%-4s %-20s %-12s %-12s %-15s\n", "----", "--------------------",
+	       "------------", "------------", "---------------");
 
 	/* Display replication information for each node */
 	for (i = 0; i < data->node_count; i++)
 	{
 		ramctrl_node_info_t* node = &data->nodes[i];
 
-		printf("%-4d %-20.20s %-12s %-15s %-12.2f %-15s\n", node->node_id,
+		printf("%-4d %-20.20s %-12s %-12d %-15s\n", node->node_id,
 		       node->hostname, node->is_primary ? "Primary" : "Standby",
-		       "0/0", /* Would show actual LSN */
-		       (double) node->replication_lag_ms / 1024.0 /
-		           1024.0, /* Convert to MB */
+		       node->replication_lag_ms,
 		       node->is_healthy ? "Streaming" : "Disconnected");
 	}
 
 	printf("\n");
-	printf("Primary: %s\n", data->node_count > 0 ? "Node 1" : "None");
-	printf("Sync Mode: synchronous_commit = remote_apply\n");
-	printf("Max Lag: 16 MB\n");
+	if (data->cluster_info.primary_node_id > 0)
+		printf("Primary: Node %d\n", data->cluster_info.primary_node_id);
+	else
+		printf("Primary: None\n");
 }
 
 
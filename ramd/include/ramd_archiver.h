@@ -0,0 +1,50 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_archiver.h
+ *		PostgreSQL Auto-Failover Daemon - Parallel WAL Archiver
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_ARCHIVER_H
+#define RAMD_ARCHIVER_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_buffer.h"
+
+typedef struct ramd_archiver_stats_t
+{
+	bool running;
+	int32_t workers;
+	int32_t queued;          /* spool entries not yet acknowledged */
+	int32_t pending;         /* .ready files in archive_status, queued or not */
+	int64_t lag_ms;          /* age of the oldest .ready file, 0 when none */
+	int64_t archived;        /* files stored since start */
+	int64_t failed;          /* files answered with an error */
+	int64_t batches;         /* acknowledgement rounds */
+	int64_t bytes_read;      /* WAL read from the data directory */
+	int64_t bytes_written;   /* what those files take in the archive */
+	int64_t last_archived_ms; /* ramd_clock_now_ms of the last stored file, 0 if none */
+	char last_archived[64];
+} ramd_archiver_stats_t;
+
+/*
+ * Start the archiver behind archive_library = 'pgraft': a dispatcher that
+ * takes up to archive_batch_size files from the spool at a time and
+ * archive_workers threads that compress and store them at once.  A batch
+ * is acknowledged together, after one fsync of the archive directory.
+ * Does nothing but return true when archive_enabled is off.
+ */
+bool ramd_archiver_start(const ramd_config_t* config);
+void ramd_archiver_stop(void);
+
+/* Counters and the current lag; false if the archiver is not running */
+bool ramd_archiver_get_stats(ramd_archiver_stats_t* stats);
+
+/* Append the archiver's series to a Prometheus exposition */
+bool ramd_archiver_render_prometheus(ramd_buffer_t* output);
+
+#endif /* RAMD_ARCHIVER_H */
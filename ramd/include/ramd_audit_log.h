@@ -0,0 +1,44 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_audit_log.h
+ *		PostgreSQL Auto-Failover Daemon - Persistent Audit Log
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_AUDIT_LOG_H
+#define RAMD_AUDIT_LOG_H
+
+#include <netinet/in.h>
+
+#include "ramd.h"
+#include "ramd_security.h"
+
+/*
+ * Keep audit records in segment files under dir, dropping the oldest
+ * once they hold more than retain_bytes.  An empty dir, or one ramd
+ * cannot write, keeps only the current segment in memory.  Segments
+ * left by an earlier run stay readable.
+ */
+bool ramd_audit_log_open(const char* dir, int64_t retain_bytes);
+
+/* Flush the current segment and stop the sync thread */
+void ramd_audit_log_close(void);
+
+/*
+ * Record one event.  Takes no lock except to start a new segment, and
+ * never waits for the disk.  Strings longer than the fields of
+ * ramd_audit_entry_t are cut.
+ */
+void ramd_audit_log_append(const char* client_ip, const char* user, const char* action,
+                           const char* resource, int result, const char* details);
+
+/*
+ * Copy up to max records logged between from and until (unix seconds,
+ * 0 for no bound) into entries, newest first, and return how many.
+ */
+int ramd_audit_log_read(time_t from, time_t until, ramd_audit_entry_t* entries, int max);
+
+#endif /* RAMD_AUDIT_LOG_H */
@@ -9,11 +9,12 @@
 #define RAMD_BACKUP_H
 
 #include "ramd_common.h"
+#include "ram_json.h"
 
 /* Maximum number of backup tools */
 #define RAMD_MAX_BACKUP_TOOLS 10
 
-/* Maximum number of concurrent backup jobs */
+/* Backup jobs tracked at once; finished ones are reused oldest first */
 #define RAMD_MAX_BACKUP_JOBS 50
 
 /* Backup tool types */
@@ -38,20 +39,40 @@ typedef struct {
     char last_restore[32];
     int backup_count;
     int restore_count;
+    int max_concurrent;  /* runs of this tool at once, 0 for the default */
 } ramd_backup_tool_config_t;
 
+/*
+ * Queue order: lower runs first, and jobs of one priority run in the order
+ * they were submitted.  A restore is usually someone waiting on a node.
+ */
+typedef enum {
+    RAMD_BACKUP_PRIORITY_RESTORE = 0,
+    RAMD_BACKUP_PRIORITY_MANUAL = 1,
+    RAMD_BACKUP_PRIORITY_SCHEDULED = 2
+} ramd_backup_priority_t;
+
 /* Backup job status structure */
 typedef struct {
     int job_id;
     char tool_name[64];
     char operation[32];  /* "backup", "restore", "verify" */
-    char status[32];     /* "running", "completed", "failed" */
+    char status[32];     /* "queued", "running", "completed", "failed", "cancelled" */
+    ramd_backup_priority_t priority;
+    time_t queued_time;
     time_t start_time;
     time_t end_time;
     int exit_code;
     char error_message[512];
     char backup_name[128];
-    char progress[256];
+    char progress[256];      /* latest line of tool output */
+    int64_t bytes_done;      /* -1 until the tool reports progress */
+    int64_t bytes_total;     /* -1 if the tool does not say */
+    int percent_done;        /* -1 if the tool does not say */
+    int64_t bytes_per_second; /* average since the job started */
+    char target_path[512];   /* restore destination, empty for the tool's restore_path */
+    int processes;           /* parallel restore processes, 0 for the tool's default */
+    bool standby;            /* restore as a standby fed from the WAL archive */
 } ramd_backup_job_t;
 
 /* Backup statistics structure */
@@ -76,17 +97,48 @@ typedef struct {
 bool ramd_backup_init(void);
 
 /*
- * Create a backup using the specified tool
+ * Stop the executor: queued jobs are cancelled, running tools are
+ * terminated, and the call returns once every worker has exited
+ */
+void ramd_backup_shutdown(void);
+
+/*
+ * Queue a backup using the specified tool.  Jobs run on a fixed pool of
+ * RAMD_BACKUP_WORKERS threads, at most max_concurrent per tool, with the
+ * tool reniced and given idle-ish I/O priority.
  */
 bool ramd_backup_create(const char* tool_name, const char* backup_name, 
                        char* error_message, size_t error_size);
 
 /*
- * Restore from backup using the specified tool
+ * As ramd_backup_create, queued behind restores and manual backups
+ */
+bool ramd_backup_create_scheduled(const char* tool_name, const char* backup_name,
+                                  char* error_message, size_t error_size);
+
+/*
+ * Queue a restore, ahead of any waiting backups.  Restores are on the
+ * recovery path and run at normal priority.
  */
 bool ramd_backup_restore(const char* tool_name, const char* backup_name, 
                         char* error_message, size_t error_size);
 
+/*
+ * Queue a restore of backup_name ("latest" or NULL for the newest) into
+ * target_dir, set up as a standby whose restore_command fetches WAL from
+ * the tool's archive.  processes > 0 asks the tool for that many parallel
+ * restore processes.  *job_id, if given, is set for ramd_backup_wait_job.
+ */
+bool ramd_backup_restore_standby(const char* tool_name, const char* backup_name,
+                                 const char* target_dir, int processes, int* job_id,
+                                 char* error_message, size_t error_size);
+
+/*
+ * Wait up to timeout_ms for a job to finish and copy its final state into
+ * *job; false if it is still running at the deadline or is unknown
+ */
+bool ramd_backup_wait_job(int job_id, int32_t timeout_ms, ramd_backup_job_t* job);
+
 /*
  * List available backups
  */
@@ -98,9 +150,9 @@ bool ramd_backup_list(const char* tool_name, char* output, size_t output_size);
 bool ramd_backup_get_job_status(int job_id, ramd_backup_job_t* job);
 
 /*
- * List all backup jobs
+ * Write every tracked job, with its progress, as {"jobs": [...]}
  */
-bool ramd_backup_list_jobs(char* output, size_t output_size);
+bool ramd_backup_list_jobs(ram_json_writer_t* w);
 
 /*
  * Get backup statistics
@@ -125,7 +177,8 @@ bool ramd_backup_schedule(const char* tool_name, const char* schedule,
                          char* error_message, size_t error_size);
 
 /*
- * Cancel running backup job
+ * Cancel a backup job: a queued job never starts, a running tool is sent
+ * SIGTERM and then SIGKILL, and the job ends as "cancelled"
  */
 bool ramd_backup_cancel_job(int job_id, char* error_message, size_t error_size);
 
@@ -173,7 +226,14 @@ bool ramd_backup_pause_job(int job_id, char* error_message, size_t error_size);
 bool ramd_backup_resume_job(int job_id, char* error_message, size_t error_size);
 
 /*
- * Get backup job logs
+ * Update job's bytes_done, bytes_total and percent_done from one line of
+ * pgbackrest, barman or pg_basebackup output; other lines change nothing
+ */
+void ramd_backup_parse_progress(ramd_backup_job_t* job, const char* line);
+
+/*
+ * Get backup job logs: the most recent tool output, at most
+ * RAMD_BACKUP_LOG_SIZE bytes of it, oldest line first
  */
 bool ramd_backup_get_job_logs(int job_id, char* logs, size_t logs_size);
 
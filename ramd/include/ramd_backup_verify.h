@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_backup_verify.h
+ *		PostgreSQL Auto-Failover Daemon - Parallel Backup Verification
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_BACKUP_VERIFY_H
+#define RAMD_BACKUP_VERIFY_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_buffer.h"
+
+#define RAMD_BACKUP_VERIFY_ID_LENGTH 128
+
+typedef struct ramd_backup_verify_result_t
+{
+	char backup_id[RAMD_BACKUP_VERIFY_ID_LENGTH];
+	char tool[32];           /* backup_verify_tool at the time of the run */
+	bool valid;
+	bool cached;             /* from an earlier run still within the TTL */
+	int32_t files_checked;
+	int32_t files_failed;
+	int64_t bytes_checked;
+	int64_t duration_ms;
+	int64_t verified_ms;     /* ramd_clock_now_ms when the run finished */
+	time_t verified_at;
+	char message[512];       /* what was checked, or the first problems found */
+} ramd_backup_verify_result_t;
+
+typedef enum
+{
+	RAMD_BACKUP_VERIFY_UNKNOWN = 0, /* no result, or one past the TTL */
+	RAMD_BACKUP_VERIFY_RUNNING,
+	RAMD_BACKUP_VERIFY_DONE
+} ramd_backup_verify_state_t;
+
+/*
+ * Start the background verifier that ramd_backup_verify_request feeds.
+ * config is kept and read at each run, so reloads apply to the next one.
+ */
+bool ramd_backup_verify_start(const ramd_config_t* config);
+
+/* Cancel runs in progress and wait for the background verifier */
+void ramd_backup_verify_stop(void);
+
+/*
+ * Verify a backup and wait for the result.  With backup_verify_tool
+ * "native", backup_id names a directory under backup_dir whose
+ * backup_manifest is checked: the manifest's own checksum, then every
+ * file's size and checksum on backup_verify_workers threads sharing
+ * backup_verify_max_rate_kbps, then pg_verifybackup --skip-checksums for
+ * what the manifest alone cannot show (stray files, the WAL needed).
+ * pgbackrest and barman run their own verify command at background
+ * priority; "latest" is their newest backup.
+ *
+ * A result younger than backup_verify_cache_ttl_ms is returned as is
+ * unless force is set, and callers asking for a backup already being
+ * verified wait for that run.  False only if no result could be had
+ * (bad id, shutdown); an invalid backup returns true with !valid.
+ */
+bool ramd_backup_verify_run(const char* backup_id, bool force,
+                            ramd_backup_verify_result_t* result);
+
+/* Queue a verification for the background verifier; false if the queue is full */
+bool ramd_backup_verify_request(const char* backup_id);
+
+/* What is known about backup_id without waiting; result is filled when DONE */
+ramd_backup_verify_state_t ramd_backup_verify_lookup(const char* backup_id,
+                                                     ramd_backup_verify_result_t* result);
+
+/*
+ * The backup pre-checks should look at: the newest directory under
+ * backup_dir holding a backup_label for "native", "latest" for the tools.
+ * False if there is none.
+ */
+bool ramd_backup_verify_latest(char* backup_id, size_t size);
+
+/* Append the verifier's series to a Prometheus exposition */
+bool ramd_backup_verify_render_prometheus(ramd_buffer_t* output);
+
+#endif /* RAMD_BACKUP_VERIFY_H */
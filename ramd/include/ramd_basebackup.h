@@ -6,8 +6,8 @@
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
  * This file provides function declarations for base backup functionality
- * in the ramd daemon. It provides functions to take and manage base
- * backups using pg_basebackup.
+ * in the ramd daemon. Backups are streamed in-process with the BASE_BACKUP
+ * replication command, so no pg_basebackup binary is needed.
  *
  *-------------------------------------------------------------------------
  */
@@ -19,20 +19,76 @@
 extern "C" {
 #endif
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <libpq-fe.h>
 
+/* Output layout, as pg_basebackup -F */
+typedef enum
+{
+    RAMD_BASEBACKUP_PLAIN = 0, /* unpack into target_dir and tablespace paths */
+    RAMD_BASEBACKUP_TAR        /* keep base.tar and <oid>.tar in target_dir */
+} ramd_basebackup_format_t;
+
+typedef struct ramd_basebackup_progress_t
+{
+    int64_t bytes_done;
+    int64_t bytes_total;      /* server estimate, 0 if unknown */
+    int64_t bytes_per_second;
+    int64_t eta_seconds;      /* -1 if unknown */
+    int64_t elapsed_ms;
+    int32_t archives_done;
+    int32_t archive_count;    /* tablespaces including the base directory */
+} ramd_basebackup_progress_t;
+
+/* Called about once a second from the thread running the backup */
+typedef void (*ramd_basebackup_progress_fn)(const ramd_basebackup_progress_t *progress,
+                                            void *arg);
+
+typedef struct ramd_basebackup_options_t
+{
+    const char *label;
+    const char *target_dir;            /* created; must be empty if it exists */
+    const char *const *mirror_dirs;    /* plain format only: unpacked into each as well */
+    int32_t mirror_count;              /* up to RAMD_BASEBACKUP_MAX_MIRRORS */
+    ramd_basebackup_format_t format;
+    bool fast_checkpoint;
+    bool write_recovery_conf;          /* plain format only, as pg_basebackup -R */
+    bool verify_checksums;
+    bool manifest;                     /* PostgreSQL 13 and later */
+    int32_t max_rate_kbps;             /* server-side throttle, 0 = unlimited */
+    const char *application_name;      /* NULL keeps the conninfo's */
+    const atomic_bool *cancel;         /* may be NULL */
+    ramd_basebackup_progress_fn progress; /* may be NULL */
+    void *progress_arg;
+} ramd_basebackup_options_t;
+
+/*
+ * Stream a base backup from the server described by conninfo, including the
+ * WAL needed to make it consistent.  Returns 0 on success, -1 on failure or
+ * cancellation.  final, if not NULL, receives the last progress figures.
+ */
+extern int ramd_basebackup_run(const char *conninfo, const ramd_basebackup_options_t *options,
+                               ramd_basebackup_progress_t *final);
+
 /*
- * Take a base backup using pg_basebackup
- * 
+ * Take a base backup from the server conn is connected to
+ *
  * Parameters:
  *   conn - PostgreSQL connection
  *   target_dir - Directory where backup should be stored
  *   label - Label for the backup
- * 
+ *
  * Returns: 0 on success, -1 on failure
  */
 extern int ramd_take_basebackup(PGconn *conn, const char *target_dir, const char *label);
 
+/* As above, also unpacking the same backup into each of mirror_dirs */
+extern int ramd_take_basebackup_fanout(PGconn *conn, const char *target_dir,
+                                       const char *const *mirror_dirs, int32_t mirror_count,
+                                       const char *label);
+
 #ifdef __cplusplus
 }
 #endif
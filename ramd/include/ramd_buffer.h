@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_buffer.h
+ *		PostgreSQL Auto-Failover Daemon - Growable Byte Buffers
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_BUFFER_H
+#define RAMD_BUFFER_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ramd_memory.h"
+
+/*
+ * A heap buffer that grows on demand.  data is always NUL-terminated once
+ * something has been appended; length excludes the terminator.  Resetting
+ * keeps the storage, so a buffer owned by a long-lived object is reused.
+ * Storage is charged to subsystem, which survives free and reset.
+ */
+typedef struct ramd_buffer_t
+{
+	char* data;
+	size_t length;
+	size_t capacity;
+	ramd_mem_subsystem_t subsystem;
+} ramd_buffer_t;
+
+void ramd_buffer_init(ramd_buffer_t* buffer);
+void ramd_buffer_init_subsystem(ramd_buffer_t* buffer, ramd_mem_subsystem_t subsystem);
+void ramd_buffer_free(ramd_buffer_t* buffer);
+void ramd_buffer_reset(ramd_buffer_t* buffer, size_t keep_capacity);
+bool ramd_buffer_reserve(ramd_buffer_t* buffer, size_t additional);
+bool ramd_buffer_append(ramd_buffer_t* buffer, const char* data, size_t length);
+bool ramd_buffer_appendf(ramd_buffer_t* buffer, const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+bool ramd_buffer_vappendf(ramd_buffer_t* buffer, const char* format, va_list args)
+    __attribute__((format(printf, 2, 0)));
+
+/* The caller owns the result and frees it with ramd_mem_free(buffer->subsystem) */
+char* ramd_buffer_detach(ramd_buffer_t* buffer);
+
+/*
+ * snprintf into a fixed array, for messages: text that does not fit is cut
+ * short with "..." so it is not taken for the whole.  False if it was cut.
+ */
+bool ramd_format_message(char* out, size_t size, const char* format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif /* RAMD_BUFFER_H */
@@ -0,0 +1,38 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_clock.h
+ *		PostgreSQL Auto-Failover Daemon - Replaceable Monotonic Clock
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_CLOCK_H
+#define RAMD_CLOCK_H
+
+#include <stdint.h>
+
+/* Microseconds on some monotonic time line */
+typedef int64_t (*ramd_clock_fn)(void);
+
+/* CLOCK_MONOTONIC in microseconds, unless a clock was installed */
+int64_t ramd_clock_now_us(void);
+
+/* The same clock in milliseconds, what ramd's timeouts and ages are kept in */
+int64_t ramd_clock_now_ms(void);
+
+/*
+ * Wall-clock milliseconds since the epoch at monotonic instant
+ * monotonic_ms, for display only; 0 stays 0 ("never").
+ */
+int64_t ramd_clock_wall_ms(int64_t monotonic_ms);
+
+/*
+ * Read time from clock instead, e.g. a simulation's virtual clock; NULL
+ * goes back to CLOCK_MONOTONIC.  Install it before any thread that reads
+ * the clock is started.
+ */
+void ramd_clock_set(ramd_clock_fn clock);
+
+#endif /* RAMD_CLOCK_H */
@@ -15,6 +15,8 @@
 #include "ramd_config.h"
 #include <libpq-fe.h>
 
+#include "ramd_pgraft.h"
+
 /* Node information structure */
 typedef struct ramd_node_t
 {
@@ -28,8 +30,9 @@ typedef struct ramd_node_t
 	ramd_role_t role;
 	bool is_leader;
 	bool is_healthy;
-	time_t last_seen;
-	time_t state_changed_at;
+	bool is_voter; /* false for a Raft learner, which never joins the quorum */
+	int64_t last_seen_ms;       /* ramd_clock_now_ms() of the last contact */
+	int64_t state_changed_ms;   /* ramd_clock_now_ms() of the last state change */
 	float health_score;
 	int64_t wal_lsn;
 	int32_t replication_lag_ms;
@@ -43,15 +46,25 @@ typedef struct ramd_cluster_t
 	char cluster_name[RAMD_MAX_HOSTNAME_LENGTH];
 	int32_t node_count;
 	ramd_node_t nodes[RAMD_MAX_NODES];
+	/*
+	 * node_id -> slot in nodes[] plus one, 0 for an empty bucket, linearly
+	 * probed.  Kept by ramd_cluster_add_node and ramd_cluster_remove_node;
+	 * code filling nodes[] by hand leaves node_indexed behind node_count,
+	 * and lookups scan until the index is rebuilt.
+	 */
+	int16_t node_index[RAMD_CLUSTER_INDEX_SLOTS];
+	int32_t node_indexed;
 	int32_t primary_node_id;
 	int32_t leader_node_id;
 	int32_t local_node_id;
 	bool has_quorum;
 	bool in_failover;
-	time_t last_topology_change;
-	time_t last_health_check;
+	int64_t last_topology_change_ms; /* ramd_clock_now_ms() */
 	/* PostgreSQL connection for pgraft integration */
 	PGconn* pg_conn;
+	/* Last pgraft_get_cluster_snapshot() read, refreshed once per monitor cycle */
+	ramd_pgraft_snapshot_t consensus;
+	int64_t consensus_refreshed_ms; /* ramd_clock_now_ms(), 0 if the last read failed */
 } ramd_cluster_t;
 
 /* Cluster management functions */
@@ -66,6 +79,7 @@ bool ramd_cluster_add_node(ramd_cluster_t* cluster, int32_t node_id,
                            int32_t rale_port, int32_t dstore_port);
 bool ramd_cluster_remove_node(ramd_cluster_t* cluster, int32_t node_id);
 ramd_node_t* ramd_cluster_find_node(ramd_cluster_t* cluster, int32_t node_id);
+const ramd_node_t* ramd_cluster_lookup_node(const ramd_cluster_t* cluster, int32_t node_id);
 ramd_node_t* ramd_cluster_get_local_node(ramd_cluster_t* cluster);
 ramd_node_t* ramd_cluster_get_primary_node(ramd_cluster_t* cluster);
 ramd_node_t* ramd_cluster_get_leader_node(ramd_cluster_t* cluster);
@@ -78,16 +92,36 @@ bool ramd_cluster_update_node_role(ramd_cluster_t* cluster, int32_t node_id,
 bool ramd_cluster_update_node_health(ramd_cluster_t* cluster, int32_t node_id,
                                      float health_score);
 
+/*
+ * Read the Raft state from pgraft in one roundtrip and cache it in cluster,
+ * updating leader_node_id and has_quorum.  The monitor calls this at the
+ * start of every cycle so later checks in the same cycle stay off the wire.
+ */
+bool ramd_cluster_refresh_consensus(ramd_cluster_t* cluster);
+
 /* Cluster state queries */
 bool ramd_cluster_has_quorum(const ramd_cluster_t* cluster);
 bool ramd_cluster_has_primary(const ramd_cluster_t* cluster);
 bool ramd_cluster_has_leader(const ramd_cluster_t* cluster);
 int32_t ramd_cluster_count_healthy_nodes(const ramd_cluster_t* cluster);
 int32_t ramd_cluster_count_standby_nodes(const ramd_cluster_t* cluster);
+int32_t ramd_cluster_count_voting_nodes(const ramd_cluster_t* cluster);
+int32_t ramd_cluster_count_healthy_voting_nodes(const ramd_cluster_t* cluster);
 
 /* Node management */
 bool ramd_cluster_get_node_by_id(int32_t node_id, ramd_node_t* node);
 
+/*
+ * Published versions.  The monitor publishes a copy of the cluster at the
+ * end of every cycle; readers take a reference to the latest copy without
+ * any lock and never see a cycle half applied.  pg_conn is NULL in a
+ * copy.  ramd_cluster_acquire returns NULL before the first publish, and
+ * every copy it returns must be handed back to ramd_cluster_release.
+ */
+void ramd_cluster_publish(const ramd_cluster_t* cluster);
+const ramd_cluster_t* ramd_cluster_acquire(void);
+void ramd_cluster_release(const ramd_cluster_t* version);
+
 /* Topology management */
 bool ramd_cluster_detect_topology_change(ramd_cluster_t* cluster);
 void ramd_cluster_update_topology(ramd_cluster_t* cluster);
@@ -60,11 +60,6 @@ bool ramd_api_handle_backup_list(ramd_http_request_t* req, ramd_http_response_t*
  */
 bool ramd_api_handle_backup_restore(ramd_http_request_t* req, ramd_http_response_t* resp);
 
-/*
- * Handle backup jobs request
- */
-bool ramd_api_handle_backup_jobs(ramd_http_request_t* req, ramd_http_response_t* resp);
-
 /*
  * Handle parameter list request
  */
@@ -13,6 +13,22 @@
 
 #include "ramd.h"
 #include "ramd_logging.h"
+#include "ramd_backup.h"
+
+/* What the slot manager does with a slot whose standby stays away */
+typedef enum
+{
+	RAMD_SLOT_POLICY_DROP = 0, /* drop it; recreated when the standby streams again */
+	RAMD_SLOT_POLICY_ADVANCE,  /* move restart_lsn up, keeping slot_max_retained_mb */
+	RAMD_SLOT_POLICY_KEEP      /* only warn; max_slot_wal_keep_size is the backstop */
+} ramd_slot_policy_t;
+
+/* How a primary whose write lease ran out stops taking writes */
+typedef enum
+{
+	RAMD_FENCING_READ_ONLY = 0, /* default_transaction_read_only, clients disconnected */
+	RAMD_FENCING_STOP           /* shut the server down */
+} ramd_fencing_action_t;
 
 /* Configuration structure */
 typedef struct ramd_config
@@ -50,6 +66,8 @@ typedef struct ramd_config
 	char pam_service[64];
 	bool require_ssl;
 	bool verify_ssl;
+	bool ssl_enabled; /* TLS on the HTTP API for clients off loopback */
+	bool ssl_ktls;    /* hand TLS records to the kernel where it can */
 
 	/* Cluster settings */
 	char cluster_name[RAMD_MAX_HOSTNAME_LENGTH];
@@ -62,12 +80,30 @@ typedef struct ramd_config
 	int32_t health_check_timeout_ms;
 	int32_t failover_timeout_ms;
 	int32_t recovery_timeout_ms;
+	char failover_trace_file[RAMD_MAX_PATH_LENGTH]; /* empty: traces stay in memory */
+	int32_t failover_saturated_max_lag_mb; /* WAL lead a saturated standby loses by */
+
+	/* Failure detector settings */
+	double failure_detector_phi_suspect;
+	double failure_detector_phi_failover;
+	int32_t failure_detector_min_stddev_ms;
+	int32_t failure_detector_pause_ms; /* silence a healthy node may show */
+
+	/* Primary fencing */
+	bool fencing_enabled;
+	int32_t fencing_lease_ms; /* also the longest a failover waits for it */
+	ramd_fencing_action_t fencing_action;
 
 	/* Logging settings */
 	char log_file[RAMD_MAX_PATH_LENGTH];
 	ramd_log_level_t log_level;
+	ramd_log_format_t log_format;
 	bool log_to_syslog;
 	bool log_to_console;
+	int32_t log_rotation_size_mb;  /* 0: no size limit */
+	int32_t log_rotation_age_min;  /* 0: no time limit */
+	int32_t log_rotation_count;    /* rotated files kept */
+	bool log_compress;             /* zstd, or gzip without libzstd */
 
 	/* HTTP API settings */
 	bool http_api_enabled;
@@ -75,21 +111,123 @@ typedef struct ramd_config
 	int32_t http_port;
 	bool http_auth_enabled;
 	char http_auth_token[RAMD_MAX_COMMAND_LENGTH];
+	int32_t http_rate_limit_per_minute; /* 0 disables rate limiting */
+	char http_unix_socket_dir[RAMD_MAX_PATH_LENGTH]; /* empty: no local socket */
+	bool status_page_enabled; /* shared-memory view for local readers */
+	char audit_log_dir[RAMD_MAX_PATH_LENGTH]; /* empty: audit records stay in memory */
+	int32_t audit_log_retain_mb;
+
+	/* Client proxy settings */
+	bool proxy_enabled;
+	char proxy_bind_address[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t proxy_port;              /* to the primary */
+	int32_t proxy_read_port;         /* to a standby; 0: no read listener */
+	int32_t proxy_read_max_lag_ms;   /* standbys further behind are not used */
+	int32_t proxy_max_connections;
+
+	/* Client endpoint settings */
+	char endpoint_vip[RAMD_MAX_HOSTNAME_LENGTH];           /* "addr/prefix"; empty: none */
+	char endpoint_vip_interface[RAMD_MAX_HOSTNAME_LENGTH];
+	char endpoint_move_command[RAMD_MAX_PATH_LENGTH];      /* <node_id> <host> <port> */
+
+	/* Metrics exposition settings */
+	int32_t metrics_refresh_interval_ms;
+	bool metrics_compression;
+	char metrics_history_file[RAMD_MAX_PATH_LENGTH]; /* empty: history stays in memory */
+	char remote_write_url[RAMD_MAX_PATH_LENGTH];        /* empty: metrics are only scraped */
+	char remote_write_auth_token[RAMD_MAX_PATH_LENGTH]; /* sent as a bearer token */
+	int32_t remote_write_interval_ms;
+	int32_t remote_write_timeout_ms;
+	int32_t remote_write_queue_kb;      /* samples kept while the receiver is away */
+	char remote_write_drop_policy[16];  /* "oldest" or "newest" once the queue is full */
+	bool profiling_enabled; /* serve /api/v1/debug/pprof/profile */
 
 	/* Synchronous replication settings */
 	char sync_standby_names[RAMD_MAX_COMMAND_LENGTH];
 	int32_t num_sync_standbys;
 	int32_t sync_timeout_ms;
 	bool enforce_sync_standbys;
+	bool sync_adaptive;
+	int32_t sync_adaptive_hold_ms;
+	int32_t sync_adaptive_margin_ms;
+	int32_t sync_adaptive_stall_ms;
 
 	/* Maintenance mode settings */
 	bool maintenance_mode_enabled;
 	int32_t maintenance_drain_timeout_ms;
+	int32_t maintenance_drain_idle_grace_ms;
 	bool maintenance_backup_before;
+	char maintenance_pooler_admin[RAMD_MAX_COMMAND_LENGTH]; /* conninfo; empty: no pooler */
+	char maintenance_pooler_pause_command[128];
+	char maintenance_pooler_resume_command[128];
+
+	/* Planned switchover settings */
+	int32_t switchover_drain_timeout_ms;
+	int32_t switchover_catchup_timeout_ms;
+	int32_t switchover_prewarm_workers;    /* 0: the target is promoted cold */
+	int32_t switchover_prewarm_timeout_ms;
+
+	/* Rolling maintenance settings */
+	char rolling_node_command[RAMD_MAX_PATH_LENGTH]; /* empty: rolling runs refused */
+	int32_t rolling_max_parallel;
+	int32_t rolling_node_timeout_ms;
+
+	/* Replica rebuild settings */
+	int32_t rebuild_max_concurrent;
+	int32_t rebuild_max_rate_kbps;
+	bool rebuild_use_rewind;
+
+	/* Replication slot settings */
+	bool replication_slots_enabled;
+	int32_t slot_inactive_timeout_ms;
+	int32_t slot_max_retained_mb; /* 0: leave the limit to max_slot_wal_keep_size */
+	ramd_slot_policy_t slot_inactive_policy;
+	bool logical_slot_sync_enabled; /* keep the primary's logical slots on standbys */
+
+	/* Cascading replication settings */
+	bool cascade_enabled;
+	int32_t cascade_max_fanout; /* standbys one cascading standby may feed */
+	int32_t cascade_max_lag_ms; /* replay lag past which a standby feeds no one */
+	char node_zones[RAMD_MAX_COMMAND_LENGTH]; /* "<node_id>:<zone>,..." */
+
+	/* Replica bootstrap settings */
+	char bootstrap_backup_tool[64]; /* empty: pg_basebackup from the primary */
+	int32_t bootstrap_restore_processes;
+	int32_t bootstrap_max_parallel; /* standbys seeded at once by a cluster bootstrap */
+	bool bootstrap_fanout;          /* one streamed base backup unpacked for several standbys */
+
+	/* Backup tools, from backup_toolN_*; a slot without a name is unused */
+	ramd_backup_tool_config_t backup_tools[RAMD_BACKUP_CONFIG_TOOLS];
+
+	/* Replication lag sampling */
+	int32_t lag_sample_interval_ms;
+
+	/* Standby replay advisor */
+	bool replay_advisor_enabled;
+	int32_t replay_advisor_interval_ms;
+	bool replay_autotune;                /* apply the advice with ALTER SYSTEM */
+	int32_t replay_max_io_concurrency;   /* maintenance_io_concurrency is raised no further */
+	int32_t replay_max_decode_buffer_kb; /* nor wal_decode_buffer_size */
+
+	/* WAL archiving behind archive_library = 'pgraft' */
+	bool archive_enabled;
+	char archive_dir[RAMD_MAX_PATH_LENGTH];       /* empty: $PGARCHIVE or the default */
+	char archive_spool_dir[RAMD_MAX_PATH_LENGTH]; /* empty: pgraft_archive in the data directory */
+	int32_t archive_workers;
+	int32_t archive_batch_size;
+	int32_t archive_compression_level; /* gzip level, 0 stores files as they are */
+
+	/* Backup verification */
+	char backup_verify_tool[32];         /* "native", "pgbackrest" or "barman" */
+	int32_t backup_verify_workers;       /* files checksummed at once */
+	int32_t backup_verify_max_rate_kbps; /* read rate across them, 0 for no limit */
+	int32_t backup_verify_cache_ttl_ms;  /* how long a result stands for pre-checks */
 
 	/* Daemon settings */
 	char pid_file[RAMD_MAX_PATH_LENGTH];
 	bool daemonize;
+	bool config_watch_enabled; /* reload when the config file changes on disk */
+	char instances_dir[RAMD_MAX_PATH_LENGTH]; /* set: supervise the clusters there */
 	char user[RAMD_MAX_HOSTNAME_LENGTH];
 	char group[RAMD_MAX_HOSTNAME_LENGTH];
 	char backup_dir[RAMD_MAX_PATH_LENGTH];
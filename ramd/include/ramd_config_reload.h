@@ -85,6 +85,9 @@ bool ramd_config_reload_maintenance(const ramd_config_t* old_config,
 void ramd_config_reload_signal_setup(void);
 void ramd_config_reload_signal_sighup(int sig);
 
+/* Run a reload SIGHUP asked for; called from the daemon's main loop */
+void ramd_config_reload_run_pending(void);
+
 /* Utility functions */
 const char*
 ramd_config_reload_status_to_string(ramd_config_reload_status_t status);
@@ -0,0 +1,25 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_config_watch.h
+ *		PostgreSQL Auto-Failover Daemon - Configuration File Watcher
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_CONFIG_WATCH_H
+#define RAMD_CONFIG_WATCH_H
+
+#include "ramd.h"
+
+/*
+ * Reload config_file through ramd_config_reload_from_file() whenever its
+ * contents change on disk, once a burst of events has been quiet for
+ * RAMD_CONFIG_WATCH_DEBOUNCE_MS.  False if the platform has no file
+ * notification or the watch could not be set up; SIGHUP still works.
+ */
+bool ramd_config_watch_start(const char* config_file);
+void ramd_config_watch_stop(void);
+
+#endif /* RAMD_CONFIG_WATCH_H */
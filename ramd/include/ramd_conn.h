@@ -28,9 +28,34 @@ extern void ramd_conn_cleanup(void);
 extern PGconn* ramd_conn_get(const char* host, int32_t port, const char* dbname,
                              const char* user, const char* password);
 
-/* Get a cached connection to PostgreSQL */
-extern PGconn* ramd_conn_get_cached(int32_t node_id, const char* host, int32_t port,
-                                    const char* dbname, const char* user, const char* password);
+/*
+ * Borrow a session to node_id from its pool, opening one if none is idle.
+ * The caller has it to itself until ramd_conn_checkin and must not
+ * PQfinish it.  Waits up to RAMD_CONN_POOL_WAIT_MS when every session is
+ * in use; NULL if none could be had.  Sessions persist across checkouts,
+ * so prepared statements and session settings carry over.
+ */
+extern PGconn* ramd_conn_checkout(int32_t node_id, const char* host, int32_t port,
+                                  const char* dbname, const char* user, const char* password);
+
+/* Return a borrowed session; a broken one or one left in a transaction is closed */
+extern void ramd_conn_checkin(int32_t node_id, PGconn* conn);
+
+/* Close pooled sessions idle for longer than RAMD_CONN_POOL_IDLE_MS */
+extern void ramd_conn_reap_idle(void);
+
+/* Send a query without waiting for it */
+extern bool ramd_conn_send(PGconn* conn, const char* query);
+
+/*
+ * Wait up to timeout_ms for the query sent on conn and return its last
+ * result.  On timeout the query is cancelled and NULL returned with the
+ * session left usable.
+ */
+extern PGresult* ramd_conn_wait_result(PGconn* conn, int32_t timeout_ms);
+
+/* ramd_conn_send and ramd_conn_wait_result in one */
+extern PGresult* ramd_conn_exec_timeout(PGconn* conn, const char* query, int32_t timeout_ms);
 
 /* Execute a query and return result */
 extern PGresult* ramd_conn_exec(PGconn* conn, const char* query);
@@ -19,6 +19,7 @@
 #include "ramd_monitor.h"
 #include "ramd_failover.h"
 #include "ramd_http_api.h"
+#include "ramd_security.h"
 
 /* Main daemon structure */
 struct ramd_daemon_t
@@ -40,6 +41,7 @@ struct ramd_daemon_t
 
 	/* HTTP API server */
 	ramd_http_server_t http_server;
+	ramd_security_context_t security;
 };
 
 /* Global daemon instance */
@@ -16,12 +16,47 @@
 #define RAMD_MAX_PATH_LENGTH               512
 #define RAMD_MAX_COMMAND_LENGTH            1024
 #define RAMD_MAX_LOG_MESSAGE               2048
-#define RAMD_MAX_NODES                     16
+#define RAMD_MAX_NODES                     64
+#define RAMD_CLUSTER_INDEX_SLOTS           (RAMD_MAX_NODES * 2) /* power of two */
+
+/* Logging Constants */
+#define RAMD_LOG_RING_SLOTS                512 /* power of two */
+#define RAMD_LOG_LINE_MAX                  (RAMD_MAX_LOG_MESSAGE + 512)
+#define RAMD_LOG_FLUSH_INTERVAL_MS         200
+#define RAMD_LOG_ROTATION_SIZE_MB          100
+#define RAMD_LOG_ROTATION_AGE_MIN          1440 /* daily, at 00:00 UTC */
+#define RAMD_LOG_ROTATION_COUNT            5
+#define RAMD_LOG_COMPRESS_LEVEL            3    /* zstd or gzip */
+#define RAMD_LOG_ROTATION_RETRY_S          60   /* after a rename or open failed */
+
+/* Log store behind GET /api/v1/logs */
+#define RAMD_LOG_STORE_RECORDS             4096 /* power of two */
+#define RAMD_LOG_STORE_BUCKET              64   /* records per index bucket, divides RECORDS */
+#define RAMD_LOG_STORE_MESSAGE_MAX         480  /* longer messages are cut */
+#define RAMD_LOG_STORE_COMPONENTS          64   /* distinct components indexed */
+#define RAMD_LOG_COMPONENT_MAX             32
+#define RAMD_LOG_QUERY_DEFAULT_LIMIT       100
+#define RAMD_LOG_QUERY_MAX_LIMIT           1000
+#define RAMD_LOG_FOLLOW_DEFAULT_WAIT_MS    25000
+#define RAMD_LOG_FOLLOW_MAX_WAIT_MS        60000
+
+/* Audit log segments */
+#define RAMD_AUDIT_SEGMENT_SIZE            (4 * 1024 * 1024)
+#define RAMD_AUDIT_SEGMENT_HEADER          4096    /* file header and block index */
+#define RAMD_AUDIT_INDEX_BLOCK             (64 * 1024) /* bytes of records per index entry */
+#define RAMD_AUDIT_MAPPED_SEGMENTS         4       /* mappings reused in turn */
+#define RAMD_AUDIT_MAX_SEGMENTS            1024
+#define RAMD_AUDIT_SYNC_INTERVAL_MS        1000
+#define RAMD_DEFAULT_AUDIT_RETAIN_MB       64
 
 /* Daemon Constants */
 #define RAMD_MONITOR_INTERVAL_MS           5000
 #define RAMD_FAILOVER_TIMEOUT_MS           30000
 #define RAMD_HEALTH_CHECK_TIMEOUT_MS       10000
+#define RAMD_LOCAL_RECONNECT_MIN_MS        500
+#define RAMD_LOCAL_RECONNECT_MAX_MS        30000
+#define RAMD_PG_CONNECT_BACKOFF_MIN_MS     50
+#define RAMD_PG_CONNECT_BACKOFF_MAX_MS     2000
 #define RAMD_DEFAULT_PORT                  5432
 
 /* PostgreSQL Default Paths */
@@ -49,6 +84,7 @@
 /* HTTP API Defaults */
 #define RAMD_DEFAULT_HTTP_PORT           8080
 #define RAMD_DEFAULT_HTTP_BIND_ADDRESS   "127.0.0.1"
+#define RAMD_DEFAULT_HTTP_RATE_LIMIT     100 /* requests per client per minute */
 
 /* RALE (Raft-like Leader Election) Defaults */
 #define RAMD_DEFAULT_RALE_PORT           7400
@@ -64,13 +100,15 @@
 #define RAMD_DEFAULT_HEALTH_CHECK_INTERVAL 5
 #define RAMD_DEFAULT_CONNECTION_TIMEOUT   30
 #define RAMD_DEFAULT_RECOVERY_TIMEOUT_MS  300000
-#define RAMD_NODE_TIMEOUT_SECONDS        300
-#define RAMD_HEALTH_SCORE_THRESHOLD      50.0f
+#define RAMD_NODE_TIMEOUT_MS             300000
+#define RAMD_HEALTH_SCORE_THRESHOLD      0.5f
 #define RAMD_MAX_HEALTH_SCORE            1.0f
 #define RAMD_MIN_HEALTH_SCORE            0.0f
-#define RAMD_FAILOVER_THRESHOLD          3
 #define RAMD_FAILOVER_SLEEP_SECONDS      3
 #define RAMD_FAILOVER_VALIDATION_SLEEP_SECONDS 5
+#define RAMD_FAILOVER_LSN_SAMPLE_MAX_AGE_MS 1000
+#define RAMD_FAILOVER_PROBE_DEADLINE_MS  3000
+#define RAMD_FAILOVER_SATURATED_MAX_LAG_MB 0
 
 /* Health Score Constants */
 #define RAMD_HEALTH_BASE_SCORE           50.0f
@@ -79,7 +117,12 @@
 #define RAMD_HEALTH_WAL_SCORE            15.0f
 #define RAMD_HEALTH_VACUUM_BONUS         5.0f
 #define RAMD_MAX_VACUUM_PROCESSES        5
-#define RAMD_POSTGRESQL_RESTART_DELAY    2
+#define RAMD_HEALTH_LAG_WARN_SECONDS     60.0f
+#define RAMD_HEALTH_LAG_CRITICAL_SECONDS 300.0f
+#define RAMD_HEALTH_LAG_PENALTY          0.1f   /* per threshold passed */
+#define RAMD_HEALTH_LONG_QUERY_PENALTY   0.05f  /* per query running over an hour */
+#define RAMD_HEALTH_LONG_QUERY_MAX_PENALTY 0.2f
+#define RAMD_HEALTH_STALE_CYCLES         3      /* missed samples before health drops to 0 */
 
 /* Logging Constants */
 #define RAMD_MAX_TIMESTAMP_LENGTH        64
@@ -92,14 +135,300 @@
 
 /* Maintenance Constants */
 #define RAMD_MAINTENANCE_SCHEDULE_DELAY_HOURS 1
+#define RAMD_MAINTENANCE_PRECHECK_TIMEOUT_MS  2000 /* all pre-checks together */
+#define RAMD_MAINTENANCE_PRECHECK_CACHE_MS    2000 /* one result serves callers this long */
+#define RAMD_MAINTENANCE_PRECHECK_MAX_LAG_BYTES (10LL * 1024 * 1024)
 
 /* Metrics Constants */
 #define RAMD_METRICS_COLLECTION_INTERVAL_MS 5000
 #define RAMD_KILOBYTE_TO_BYTES              1024
 #define RAMD_PRIMARY_NODE_COUNT             1
+#define RAMD_METRICS_SHARD_COUNT            16
+#define RAMD_METRICS_HTTP_BUCKET_COUNT      12
+#define RAMD_CACHE_LINE_SIZE                64
 #define RAMD_DEFAULT_MAINTENANCE_TIMEOUT_MS 300000
 #define RAMD_MAX_LINE_LENGTH                1024
 #define RAMD_HTTP_MAX_CONNECTIONS           128
+#define RAMD_HTTP_WORKER_THREADS            4
+#define RAMD_HTTP_MAX_EVENTS                64
+#define RAMD_HTTP_POLL_INTERVAL_MS          1000
+#define RAMD_HTTP_IO_TIMEOUT_MS             10000
+#define RAMD_HTTP_KEEPALIVE_TIMEOUT_MS      5000
+#define RAMD_HTTP_KEEPALIVE_MAX_REQUESTS    100
+#define RAMD_HTTP_INITIAL_BUFFER_SIZE       4096
+#define RAMD_HTTP_MAX_HEADER_SIZE           8192
+#define RAMD_HTTP_MAX_BODY_SIZE             (1024 * 1024)
+#define RAMD_HTTP_POOLED_BUFFER_SIZE        (64 * 1024)
+#define RAMD_HTTP_UNIX_SOCKET_DIR           "/tmp"
+#define RAMD_HTTP_UNIX_SOCKET_NAME          ".s.ramd.%d" /* http_port, as ramctrl expects */
+#define RAMD_TLS_SESSION_CACHE_SIZE         1024  /* TLS 1.2 sessions kept for resumption */
+#define RAMD_TLS_SESSION_TIMEOUT_S          7200  /* lifetime of a session or ticket */
+#define RAMD_TLS_TICKETS_PER_HANDSHAKE      1
+#define RAMD_TLS_RELOAD_CHECK_MS            1000  /* certificate files stat()ed at most this often */
+
+/* Process Runner Constants */
+#define RAMD_PROCESS_OUTPUT_MAX             4096
+#define RAMD_PROCESS_POLL_INTERVAL_MS       100
+#define RAMD_PROCESS_KILL_GRACE_MS          2000
+#define RAMD_PROCESS_LINE_MAX               1024
+#define RAMD_PG_CTL_TIMEOUT_MS              90000
+#define RAMD_PG_CTL_STATUS_TIMEOUT_MS       10000
+#define RAMD_PROMOTE_WAIT_SECONDS           60
+#define RAMD_PG_WAIT_SECONDS                60    /* start, stop and promote, as pg_ctl -t */
+#define RAMD_PG_LIVENESS_POLL_MS            10
+#define RAMD_PG_START_GRACE_MS              1000  /* for postmaster.pid to appear after pg_ctl start */
+
+/* Replica Rebuild Constants */
+#define RAMD_REBUILD_MAX_CONCURRENT         2
+#define RAMD_REBUILD_MIN_RATE_KBPS          32
+#define RAMD_REBUILD_POLL_INTERVAL_MS       5000
+
+/* Replication Slot Constants */
+#define RAMD_SLOT_INACTIVE_TIMEOUT_MS       (3600 * 1000) /* a restart or short outage fits well inside */
+#define RAMD_SLOT_MAX_RETAINED_MB           0
+#define RAMD_MAX_LOGICAL_SLOTS              64
+#define RAMD_LOGICAL_SLOT_SYNC_INTERVAL_MS  2000
+#define RAMD_LOGICAL_SLOT_CALL_TIMEOUT_MS   5000  /* create or advance, on the lag thread */
+#define RAMD_LOGICAL_SLOT_ADVANCE_STEP      (64LL * 1024 * 1024) /* WAL decoded per advance */
+
+/* Failure Detector Constants */
+#define RAMD_DETECTOR_PHI_SUSPECT           5.0
+#define RAMD_DETECTOR_PHI_FAILOVER          8.0
+#define RAMD_DETECTOR_MIN_STDDEV_MS         500
+#define RAMD_DETECTOR_PAUSE_MS              5000 /* a checkpoint or a GC-like stall */
+#define RAMD_DETECTOR_WINDOW                100  /* heartbeat gaps remembered per source */
+#define RAMD_DETECTOR_MIN_SAMPLES           3
+#define RAMD_DETECTOR_MIN_INTERVAL_MS       100
+#define RAMD_DETECTOR_PHI_MAX               100.0
+
+/* Primary Fencing Constants */
+#define RAMD_FENCING_LEASE_MS               10000
+#define RAMD_FENCING_MIN_LEASE_MS           1000
+#define RAMD_FENCING_DRIFT_PERCENT          10   /* clock rate difference allowed for */
+
+/* Cascading Replication Constants */
+#define RAMD_CASCADE_MAX_FANOUT             3
+#define RAMD_CASCADE_MAX_LAG_MS             5000
+#define RAMD_CASCADE_RETRY_MS               10000 /* after a repoint that failed */
+
+/* Replica Bootstrap Constants */
+#define RAMD_BOOTSTRAP_RESTORE_PROCESSES    4
+#define RAMD_BOOTSTRAP_RESTORE_TIMEOUT_MS   (24 * 3600 * 1000)
+#define RAMD_BOOTSTRAP_MAX_PARALLEL         4
+#define RAMD_BOOTSTRAP_READY_TIMEOUT_MS     60000 /* for every node to accept connections */
+#define RAMD_BOOTSTRAP_READY_POLL_MS        1000
+
+/* Replication Lag Sampler Constants */
+#define RAMD_LAG_SAMPLE_INTERVAL_MS         500
+#define RAMD_LAG_HISTORY_SIZE               120
+#define RAMD_LAG_EWMA_ALPHA                 0.2
+#define RAMD_LAG_WAIT_INTERVAL_MS           10
+
+/* Standby Replay Advisor Constants */
+#define RAMD_REPLAY_ADVISOR_INTERVAL_MS     10000
+#define RAMD_REPLAY_MAX_IO_CONCURRENCY      128
+#define RAMD_REPLAY_MAX_DECODE_BUFFER_KB    4096
+#define RAMD_REPLAY_DECODE_BUFFER_LIMIT_KB  (1024 * 1024) /* PostgreSQL's own maximum */
+#define RAMD_REPLAY_IO_CONCURRENCY_LIMIT    1000
+#define RAMD_REPLAY_INITIAL_IO_CONCURRENCY  10   /* PostgreSQL's default */
+#define RAMD_REPLAY_MIN_LAG_BYTES           (16LL * 1024 * 1024) /* below this no stage is blamed */
+#define RAMD_REPLAY_BOUND_SAMPLES           3    /* replay-bound in a row before acting */
+#define RAMD_REPLAY_SATURATION_PCT          80   /* of a limit, for it to count as reached */
+#define RAMD_REPLAY_CPU_BOUND_HIT_PCT       90   /* blocks already cached: prefetch cannot help */
+#define RAMD_REPLAY_TUNE_COOLDOWN_MS        300000
+
+/* Watch Feed Constants */
+#define RAMD_WATCH_DEFAULT_WAIT_MS          25000
+#define RAMD_WATCH_MAX_WAIT_MS              60000
+#define RAMD_WATCH_LAG_STEP_MS              100
+#define RAMD_WATCH_LAG_STEP_BYTES           (1024 * 1024)
+#define RAMD_WATCH_EVENT_HISTORY            256
+#define RAMD_WATCH_MAX_SUBSCRIBERS          8
+
+/* Client Proxy Constants */
+#define RAMD_PROXY_BIND_ADDRESS             "0.0.0.0"
+#define RAMD_PROXY_PORT                     5000 /* to the primary */
+#define RAMD_PROXY_READ_PORT                5001 /* to the least-lagged standby */
+#define RAMD_PROXY_READ_MAX_LAG_MS          10000
+#define RAMD_PROXY_MAX_CONNECTIONS          1024
+#define RAMD_PROXY_FLOW_SIZE                65536 /* bytes staged per direction */
+#define RAMD_PROXY_CONNECT_TIMEOUT_MS       3000
+#define RAMD_PROXY_MAX_EVENTS               128
+#define RAMD_PROXY_POLL_INTERVAL_MS         1000
+
+/* Endpoint Mover Constants */
+#define RAMD_ENDPOINT_ANNOUNCE_COUNT        3   /* gratuitous ARPs or NAs per move */
+#define RAMD_ENDPOINT_ANNOUNCE_INTERVAL_MS  200
+#define RAMD_ENDPOINT_COMMAND_TIMEOUT_MS    30000
+#define RAMD_ENDPOINT_NETLINK_TIMEOUT_MS    2000
+#define RAMD_ENDPOINT_RECONCILE_INTERVAL_MS 5000
+
+/* Adaptive Synchronous Standby Constants */
+#define RAMD_SYNC_ADAPTIVE_HOLD_MS          10000
+#define RAMD_SYNC_ADAPTIVE_MARGIN_MS        5
+#define RAMD_SYNC_ADAPTIVE_STALL_MS         1000
+
+/* Planned Switchover Constants */
+#define RAMD_SWITCHOVER_DRAIN_TIMEOUT_MS    5000
+#define RAMD_SWITCHOVER_CATCHUP_TIMEOUT_MS  30000
+#define RAMD_SWITCHOVER_DRAIN_POLL_MS       50
+#define RAMD_SWITCHOVER_RAFT_TRANSFER_MS    2000
+#define RAMD_SWITCHOVER_PREWARM_WORKERS     4
+#define RAMD_SWITCHOVER_PREWARM_TIMEOUT_MS  300000
+#define RAMD_PREWARM_MAX_WORKERS            16
+#define RAMD_PREWARM_RANGE_BLOCKS           1024 /* 8 MB of 8 kB blocks per pg_prewarm() */
+#define RAMD_PREWARM_BLOCKS_FILE            "autoprewarm.blocks"
+
+/* WAL Archiver Constants */
+#define RAMD_ARCHIVE_SPOOL_DIR              "pgraft_archive" /* pgraft.archive_spool_dir default */
+#define RAMD_ARCHIVE_WORKERS                4
+#define RAMD_ARCHIVE_MAX_WORKERS            32
+#define RAMD_ARCHIVE_BATCH_SIZE             32
+#define RAMD_ARCHIVE_MAX_BATCH              256
+#define RAMD_ARCHIVE_MAX_QUEUE_SCAN         4096 /* spool entries sorted per batch */
+#define RAMD_ARCHIVE_COMPRESSION_LEVEL      1    /* 0 stores segments uncompressed */
+#define RAMD_ARCHIVE_COMPRESSED_SUFFIX      ".gz"
+#define RAMD_ARCHIVE_IO_BLOCK               (256 * 1024)
+#define RAMD_ARCHIVE_POLL_MS                20
+#define RAMD_ARCHIVE_LAG_INTERVAL_MS        1000
+
+/* Rolling Maintenance Constants */
+#define RAMD_ROLLING_MAX_PARALLEL           1
+#define RAMD_ROLLING_NODE_TIMEOUT_MS        600000
+#define RAMD_ROLLING_POLL_MS                1000
+
+/* Maintenance Drain Constants */
+#define RAMD_DRAIN_IDLE_GRACE_MS            5000
+#define RAMD_DRAIN_POLL_MS                  100
+#define RAMD_DRAIN_POOLER_TIMEOUT_MS        5000 /* for RESUME and the final PAUSE wait */
+#define RAMD_DRAIN_POOLER_PAUSE_COMMAND     "PAUSE"
+#define RAMD_DRAIN_POOLER_RESUME_COMMAND    "RESUME"
+
+/* Configuration Watch Constants */
+#define RAMD_CONFIG_WATCH_DEBOUNCE_MS       200  /* quiet time before a burst is reloaded */
+
+/* Prometheus Remote Write Constants */
+#define RAMD_REMOTE_WRITE_INTERVAL_MS       15000
+#define RAMD_REMOTE_WRITE_TIMEOUT_MS        10000
+#define RAMD_REMOTE_WRITE_QUEUE_KB          16384
+#define RAMD_REMOTE_WRITE_MIN_QUEUE_KB      256
+#define RAMD_REMOTE_WRITE_DROP_POLICY       "oldest" /* newest keeps the backlog instead */
+#define RAMD_REMOTE_WRITE_MAX_REQUEST       (4 * 1024 * 1024) /* encoded bytes per POST */
+#define RAMD_REMOTE_WRITE_BACKOFF_MIN_MS    500
+#define RAMD_REMOTE_WRITE_BACKOFF_MAX_MS    60000
+#define RAMD_REMOTE_WRITE_MAX_LABELS        32   /* per series, external labels included */
+#define RAMD_REMOTE_WRITE_RESPONSE_MAX      1024 /* response bytes kept for the log */
+
+/* HTTP Request Profiler Constants */
+#define RAMD_HTTP_PROFILE_MAX_ENDPOINTS     128 /* distinct routes before "other" */
+#define RAMD_HTTP_PROFILE_SLOTS             256 /* power of two, above the maximum */
+#define RAMD_HTTP_PROFILE_ROUTE_LENGTH      96
+#define RAMD_HTTP_PROFILE_BUCKET_COUNT      13
+
+/* Sampling CPU Profiler Constants */
+#define RAMD_PROFILER_DEFAULT_SECONDS       10
+#define RAMD_PROFILER_MAX_SECONDS           60
+#define RAMD_PROFILER_DEFAULT_HZ            99   /* off the beat of periodic work */
+#define RAMD_PROFILER_MAX_HZ                1000
+#define RAMD_PROFILER_MAX_DEPTH             48   /* frames kept per sample */
+#define RAMD_PROFILER_MAX_SAMPLES           16384
+
+/* Monitor Cycle Constants */
+#define RAMD_MONITOR_CYCLE_BUCKET_COUNT     12
+
+/* Failover Trace Constants */
+#define RAMD_FAILOVER_TRACE_HISTORY         16  /* failovers kept for /api/v1/failover/history */
+#define RAMD_FAILOVER_TRACE_MAX_SPANS       16
+#define RAMD_FAILOVER_TRACE_BUCKET_COUNT    13
+
+/* Background Job Constants */
+#define RAMD_JOB_WORKERS                    1   /* topology changes run one at a time */
+#define RAMD_JOB_MAX_JOBS                   16  /* queued or running at once */
+#define RAMD_JOB_HISTORY_SIZE               64  /* finished jobs kept for /api/v1/jobs */
+#define RAMD_JOB_MAX_PHASES                 8
+
+/* Backup Tool Executor Constants */
+#define RAMD_BACKUP_WORKERS                 2   /* tool runs at once, across all tools */
+#define RAMD_BACKUP_TOOL_MAX_CONCURRENT     1   /* per tool unless it sets max_concurrent */
+#define RAMD_BACKUP_NICE                    10  /* added to ramd's nice for backups */
+#define RAMD_BACKUP_IOPRIO_CLASS            2   /* best-effort; 3 would be idle */
+#define RAMD_BACKUP_IOPRIO_LEVEL            7   /* lowest within the class */
+#define RAMD_BACKUP_QUERY_TIMEOUT_MS        30000
+#define RAMD_BACKUP_LOG_SIZE                16384 /* tool output kept per job */
+#define RAMD_BACKUP_CONFIG_TOOLS            4   /* backup_tool1_* to backup_tool4_* */
+#define RAMD_BACKUP_RETENTION_DAYS          7
+
+/* Backup Verification Constants */
+#define RAMD_BACKUP_DEFAULT_DIR             "{{VAR_DIR}}lib/postgresql/backups"
+#define RAMD_BACKUP_VERIFY_TOOL             "native" /* or "pgbackrest", "barman" */
+#define RAMD_BACKUP_VERIFY_WORKERS          4
+#define RAMD_BACKUP_VERIFY_MAX_WORKERS      32
+#define RAMD_BACKUP_VERIFY_CACHE_TTL_MS     21600000 /* 6 h; a backup does not change */
+#define RAMD_BACKUP_VERIFY_CACHE_SIZE       32   /* backups whose results are kept */
+#define RAMD_BACKUP_VERIFY_QUEUE            8    /* background requests waiting at once */
+#define RAMD_BACKUP_VERIFY_IO_BLOCK         (1024 * 1024)
+#define RAMD_BACKUP_VERIFY_MAX_MANIFEST     (256 * 1024 * 1024)
+#define RAMD_BACKUP_VERIFY_STANZA           "main" /* pgBackRest stanza, as the executor uses */
+
+/* Base Backup Constants */
+#define RAMD_BASEBACKUP_WRITE_BUFFER        (1024 * 1024)
+#define RAMD_BASEBACKUP_WRITE_ALIGN         4096
+#define RAMD_BASEBACKUP_POLL_INTERVAL_MS    100
+#define RAMD_BASEBACKUP_PROGRESS_INTERVAL_MS 1000
+#define RAMD_BASEBACKUP_MAX_RATE_KBPS       1048576
+#define RAMD_BASEBACKUP_MAX_MIRRORS         7
+
+/* Connection Pool Constants */
+#define RAMD_CONN_POOL_SIZE                 4     /* sessions per node */
+#define RAMD_CONN_POOL_IDLE_MS              60000 /* idle sessions closed after this */
+#define RAMD_CONN_POOL_VALIDATE_MS          5000  /* idle sessions pinged after this */
+#define RAMD_CONN_POOL_WAIT_MS              5000  /* checkout waits this long when all are busy */
+#define RAMD_CONN_POOL_PING_TIMEOUT_MS      2000
+
+/* Prepared Statement Constants */
+#define RAMD_QUERY_PREPARED_SESSIONS        (RAMD_MAX_NODES * RAMD_CONN_POOL_SIZE + 16)
+
+/* Memory Accounting Constants */
+#define RAMD_ARENA_DEFAULT_CHUNK_SIZE       4096
+#define RAMD_HTTP_ARENA_CHUNK_SIZE          8192  /* per connection, kept between requests */
+
+/* System Sampler Constants */
+#define RAMD_SYSMON_INTERVAL_MS             1000
+#define RAMD_SYSMON_HISTORY_SIZE            300   /* samples, five minutes at the interval */
+#define RAMD_SYSMON_BUSY_LOAD               60    /* load at which health starts to drop */
+#define RAMD_SYSMON_SATURATED_HEALTH        0.6f  /* health at saturation, above the threshold */
+#define RAMD_SYSMON_PUBLISH_STEP            5     /* load change worth republishing */
+
+/* Metrics History Constants */
+#define RAMD_HISTORY_INTERVAL_MS            1000
+#define RAMD_HISTORY_BLOCK_POINTS           60    /* points per delta-encoded block */
+#define RAMD_HISTORY_SECOND_BLOCKS          60    /* one hour at 1 s */
+#define RAMD_HISTORY_MINUTE_BLOCKS          24    /* one day at 1 min */
+#define RAMD_HISTORY_HOUR_BLOCKS            12    /* thirty days at 1 h */
+#define RAMD_HISTORY_DEFAULT_POINTS         60
+
+/* Instance Supervisor Constants */
+#define RAMD_MAX_INSTANCES                  64
+#define RAMD_INSTANCE_NAME_LENGTH           64
+#define RAMD_INSTANCES_POLL_MS              1000
+#define RAMD_INSTANCES_RESTART_MIN_MS       1000
+#define RAMD_INSTANCES_RESTART_MAX_MS       60000 /* also the run that resets it */
+#define RAMD_INSTANCES_STOP_TIMEOUT_MS      30000
+#define RAMD_INSTANCES_MAX_CONNECTIONS      256
+#define RAMD_INSTANCES_HEAD_SIZE            16384
+#define RAMD_INSTANCES_HEAD_TIMEOUT_MS      10000
+#define RAMD_INSTANCES_RELAY_BUFFER         16384
+#define RAMD_INSTANCES_LIST_SIZE            65536
+
+/* Raft Leader Watch Constants */
+#define RAMD_LEADER_WATCH_WAIT_MS           10000 /* per pgraft_wait_leader_change call */
+#define RAMD_LEADER_WATCH_RETRY_MS          1000
+
+/* Cluster Registry Constants */
+#define RAMD_REGISTRY_LEASE_TTL_MS          10000 /* kept alive every third of it */
+#define RAMD_REGISTRY_RETRY_MS              1000
+#define RAMD_REGISTRY_KEY_LENGTH            256   /* pgraft's key limit */
+#define RAMD_REGISTRY_VALUE_LENGTH          512
 
 /* Replication Defaults */
 #define RAMD_DEFAULT_REPLICATION_LAG_THRESHOLD 5000 /* microseconds */
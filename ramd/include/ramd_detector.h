@@ -0,0 +1,67 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_detector.h
+ *		PostgreSQL Auto-Failover Daemon - Phi-Accrual Failure Detector
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_DETECTOR_H
+#define RAMD_DETECTOR_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_pgraft.h"
+
+/* Where a heartbeat came from; each keeps its own arrival history */
+typedef enum
+{
+	RAMD_DETECTOR_POSTGRESQL = 0, /* a probe of the node's server answered */
+	RAMD_DETECTOR_RAFT,           /* pgraft saw the node's consensus worker */
+	RAMD_DETECTOR_SOURCE_COUNT
+} ramd_detector_source_t;
+
+typedef enum
+{
+	RAMD_DETECTOR_ALIVE = 0,
+	RAMD_DETECTOR_SUSPECT,
+	RAMD_DETECTOR_FAILED
+} ramd_detector_verdict_t;
+
+typedef struct ramd_detector_stats_t
+{
+	int32_t node_id;
+	ramd_detector_verdict_t verdict;
+	double phi[RAMD_DETECTOR_SOURCE_COUNT];           /* 0 for a source with no history */
+	double mean_interval_ms[RAMD_DETECTOR_SOURCE_COUNT];
+	int64_t since_last_ms[RAMD_DETECTOR_SOURCE_COUNT]; /* -1 if never heard on it */
+	int32_t samples[RAMD_DETECTOR_SOURCE_COUNT];
+} ramd_detector_stats_t;
+
+/* Record that node_id was heard from just now */
+void ramd_detector_heartbeat(int32_t node_id, ramd_detector_source_t source);
+
+/*
+ * Feed one pgraft snapshot: every member reports the current leader as
+ * alive, and the leader reports each follower whose log caught up or moved.
+ */
+void ramd_detector_observe_raft(const ramd_pgraft_snapshot_t* snapshot);
+
+/*
+ * Judge node_id now.  SUSPECT once the PostgreSQL phi reaches
+ * failure_detector_phi_suspect; FAILED once it reaches
+ * failure_detector_phi_failover, or already at the suspect level when Raft
+ * has gone quiet as well.  Raft silence alone never fails a node.  A node
+ * seen for the first time is timed from now.  stats may be NULL.
+ */
+ramd_detector_verdict_t ramd_detector_check(int32_t node_id, const ramd_config_t* config,
+                                            ramd_detector_stats_t* stats);
+
+/* Drop a node's history, e.g. once it has been failed over or removed */
+void ramd_detector_forget(int32_t node_id);
+
+const char* ramd_detector_verdict_to_string(ramd_detector_verdict_t verdict);
+
+#endif /* RAMD_DETECTOR_H */
@@ -0,0 +1,73 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_endpoint.h
+ *		PostgreSQL Auto-Failover Daemon - Client Endpoint Movers
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_ENDPOINT_H
+#define RAMD_ENDPOINT_H
+
+#include <pthread.h>
+
+#include "ramd.h"
+#include "ramd_cluster.h"
+#include "ramd_config.h"
+
+/* What the movers need of the new primary, copied when the move begins */
+typedef struct ramd_endpoint_target_t
+{
+	int32_t node_id;
+	bool local; /* the new primary is this node */
+	char hostname[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+	char vip[RAMD_MAX_HOSTNAME_LENGTH];
+	char vip_interface[RAMD_MAX_HOSTNAME_LENGTH];
+	char move_command[RAMD_MAX_PATH_LENGTH];
+} ramd_endpoint_target_t;
+
+#define RAMD_ENDPOINT_MOVER_COUNT 2
+
+/* One move in flight; lives on the caller's stack */
+typedef struct ramd_endpoint_move_t
+{
+	ramd_endpoint_target_t target;
+	pthread_t threads[RAMD_ENDPOINT_MOVER_COUNT];
+	bool started[RAMD_ENDPOINT_MOVER_COUNT];
+	bool ok[RAMD_ENDPOINT_MOVER_COUNT];
+} ramd_endpoint_move_t;
+
+/*
+ * Start every configured mover for node on a thread of its own, so that
+ * clients are pointed at the new primary while the standbys are still
+ * being repointed.  Each mover records its time as a failover phase:
+ * endpoint_vip brings endpoint_vip up on this host when this node is the
+ * new primary and announces it with gratuitous ARP or an unsolicited
+ * neighbour advertisement, and drops it here otherwise; endpoint_command runs endpoint_move_command
+ * with the new primary's node id, host and port, for cloud IP
+ * reassignment or a Kubernetes Endpoints patch.  If one of those settings
+ * does not fit the move, no mover starts and ramd_endpoint_move_finish()
+ * reports the move failed.
+ */
+void ramd_endpoint_move_begin(ramd_endpoint_move_t* move, const ramd_config_t* config,
+                              const ramd_node_t* node);
+
+/* Wait for the movers begun on move; false if any of them failed */
+bool ramd_endpoint_move_finish(ramd_endpoint_move_t* move);
+
+/* endpoint_vip parses as an address with an optional prefix, interface set */
+bool ramd_endpoint_vip_is_valid(const char* vip, const char* interface);
+
+/*
+ * Keep endpoint_vip on this host exactly while the watch feed shows this
+ * node as the primary: bring it up when the node is promoted, whoever ran
+ * the promotion, and drop it as soon as the node is a standby or another
+ * node is primary.  Does nothing unless endpoint_vip is set.
+ */
+bool ramd_endpoint_start(const ramd_config_t* config);
+void ramd_endpoint_stop(void);
+
+#endif /* RAMD_ENDPOINT_H */
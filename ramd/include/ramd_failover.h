@@ -32,15 +32,18 @@ typedef struct ramd_failover_context_t
 	ramd_failover_state_t state;
 	int32_t failed_node_id;
 	int32_t new_primary_node_id;
-	time_t started_at;
+	time_t started_at;   /* wall clock, for display */
 	time_t completed_at;
+	int64_t started_ms;  /* ramd_clock_now_ms(), for the duration */
 	char reason[RAMD_MAX_HOSTNAME_LENGTH];
 	bool auto_triggered;
 	int32_t retry_count;
 } ramd_failover_context_t;
 
 /* Failover detection and execution */
-bool ramd_failover_detect_primary_failure(ramd_cluster_t* cluster);
+/* Probe the primary once and ask the failure detector whether it has failed */
+bool ramd_failover_detect_primary_failure(ramd_cluster_t* cluster,
+                                          const ramd_config_t* config);
 bool ramd_failover_should_trigger(const ramd_cluster_t* cluster,
                                   const ramd_config_t* config);
 bool ramd_failover_execute(ramd_cluster_t* cluster, const ramd_config_t* config,
@@ -49,6 +52,14 @@ bool ramd_failover_execute(ramd_cluster_t* cluster, const ramd_config_t* config,
 /* Enhanced failover steps */
 bool ramd_failover_select_new_primary(const ramd_cluster_t* cluster,
                                       int32_t* new_primary_id);
+
+/*
+ * Whether a standby at lsn with host load load ranks above best, the
+ * leader so far (NULL if none yet), when choosing whom to promote
+ */
+bool ramd_failover_candidate_is_better(int64_t lsn, int32_t load, const ramd_node_t* node,
+                                       int64_t best_lsn, int32_t best_load,
+                                       const ramd_node_t* best);
 bool ramd_failover_promote_node(ramd_cluster_t* cluster,
                                 const ramd_config_t* config, int32_t node_id);
 bool ramd_failover_demote_failed_primary(ramd_cluster_t* cluster,
@@ -0,0 +1,94 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_failover_trace.h
+ *		PostgreSQL Auto-Failover Daemon - Per-Phase Failover Tracing
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_FAILOVER_TRACE_H
+#define RAMD_FAILOVER_TRACE_H
+
+#include "ramd.h"
+#include "ramd_buffer.h"
+#include "ram_json.h"
+
+/* Steps of a failover, in the order they normally run */
+typedef enum
+{
+	RAMD_FAILOVER_PHASE_DETECT = 0,       /* last answer from the primary to confirmed failure */
+	RAMD_FAILOVER_PHASE_VALIDATE,         /* old primary's write lease runs out */
+	RAMD_FAILOVER_PHASE_SELECT,           /* rank standbys by WAL position */
+	RAMD_FAILOVER_PHASE_STOP_REPLICATION,
+	RAMD_FAILOVER_PHASE_PROMOTE,
+	RAMD_FAILOVER_PHASE_SYNC_CONFIG,      /* synchronous_standby_names on the new primary */
+	RAMD_FAILOVER_PHASE_REPOINT,          /* other standbys follow the new primary */
+	RAMD_FAILOVER_PHASE_ENDPOINT_VIP,     /* endpoint_vip up here and announced */
+	RAMD_FAILOVER_PHASE_ENDPOINT_COMMAND, /* endpoint_move_command */
+	RAMD_FAILOVER_PHASE_REBUILD,          /* failed replicas queued for a rebuild */
+	RAMD_FAILOVER_PHASE_COUNT
+} ramd_failover_phase_t;
+
+/* One step; times are CLOCK_MONOTONIC microseconds, end_us 0 while it runs */
+typedef struct ramd_failover_span_t
+{
+	ramd_failover_phase_t phase;
+	int32_t node_id; /* the node the step acted on, -1 for the cluster */
+	int64_t start_us;
+	int64_t end_us;
+	bool ok;
+} ramd_failover_span_t;
+
+typedef struct ramd_failover_trace_t
+{
+	uint64_t sequence;           /* 1 for the first failover since start */
+	uint64_t trace_id[2];        /* 128-bit id the spans are exported under */
+	int64_t start_us;            /* start of the first span */
+	int64_t end_us;              /* 0 while the failover runs */
+	int64_t wall_offset_us;      /* CLOCK_REALTIME minus CLOCK_MONOTONIC at start */
+	int32_t failed_node_id;
+	int32_t new_primary_node_id; /* -1 until one is selected */
+	bool auto_triggered;
+	bool succeeded;
+	int32_t span_count;
+	ramd_failover_span_t spans[RAMD_FAILOVER_TRACE_MAX_SPANS];
+} ramd_failover_trace_t;
+
+/*
+ * The detector confirmed node_id failed after silent_ms without an answer;
+ * the next trace for that node opens with a detect span covering it.
+ */
+void ramd_failover_trace_note_detection(int32_t node_id, int64_t silent_ms);
+
+/*
+ * Open a trace for the calling thread and return its sequence number.  The
+ * span calls act on that thread's trace and do nothing without one, so a
+ * promotion outside a failover (switchover, manual promote) is not traced.
+ */
+uint64_t ramd_failover_trace_begin(int32_t failed_node_id, bool auto_triggered);
+int32_t ramd_failover_trace_span_start(ramd_failover_phase_t phase, int32_t node_id);
+void ramd_failover_trace_span_end(int32_t span, bool ok);
+void ramd_failover_trace_set_new_primary(int32_t node_id);
+
+/*
+ * Close the calling thread's trace and fold its spans into the histograms.
+ * With export_file set, the trace is also appended to it as one line of
+ * OTLP/JSON, the format the OpenTelemetry Collector's otlpjsonfile
+ * receiver reads.
+ */
+void ramd_failover_trace_end(bool succeeded, const char* export_file, int32_t local_node_id);
+
+/* Copy up to max_count traces from the ring, newest first; returns how many */
+int32_t ramd_failover_trace_history(ramd_failover_trace_t* traces, int32_t max_count);
+
+/* Exposition and serialization */
+bool ramd_failover_trace_render_prometheus(ramd_buffer_t* output);
+bool ramd_failover_trace_write_json(ram_json_writer_t* w, const ramd_failover_trace_t* trace);
+bool ramd_failover_trace_write_otlp(ram_json_writer_t* w, const ramd_failover_trace_t* traces,
+                                    int32_t count, int32_t local_node_id);
+
+const char* ramd_failover_phase_to_string(ramd_failover_phase_t phase);
+
+#endif /* RAMD_FAILOVER_TRACE_H */
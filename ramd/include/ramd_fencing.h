@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_fencing.h
+ *		PostgreSQL Auto-Failover Daemon - Lease-Based Primary Fencing
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_FENCING_H
+#define RAMD_FENCING_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/*
+ * Start the lease thread.  On a writable server it renews the write lease
+ * and fences the server once the lease runs out; everywhere it watches
+ * whose lease is running out, for ramd_fencing_wait_expired.  Does nothing
+ * but return true when fencing_enabled is off.
+ */
+bool ramd_fencing_start(ramd_cluster_t* cluster, const ramd_config_t* config);
+void ramd_fencing_stop(void);
+
+/*
+ * Wait up to timeout_ms until node_id's lease has certainly run out, so it
+ * has fenced itself and another node may be promoted.  True at once when
+ * fencing is disabled; false if this daemon cannot confirm it in time.
+ */
+bool ramd_fencing_wait_expired(int32_t node_id, int32_t timeout_ms);
+
+/* Hand Raft leadership, and with it the lease, to a freshly promoted node */
+bool ramd_fencing_hand_over(int32_t node_id);
+
+#endif /* RAMD_FENCING_H */
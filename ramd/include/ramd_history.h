@@ -0,0 +1,69 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_history.h
+ *		PostgreSQL Auto-Failover Daemon - Metrics History
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_HISTORY_H
+#define RAMD_HISTORY_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+
+typedef enum
+{
+	RAMD_HISTORY_LAG_MS = 0,     /* worst standby replay lag, ms */
+	RAMD_HISTORY_HEALTH,         /* local health score, per mille */
+	RAMD_HISTORY_HTTP_US,        /* mean API request time */
+	RAMD_HISTORY_RAFT_COMMIT_US, /* WAL append, plus the quorum's round trip on the leader */
+	RAMD_HISTORY_CYCLE_US,       /* mean monitor cycle time */
+	RAMD_HISTORY_SERIES_COUNT
+} ramd_history_series_t;
+
+typedef enum
+{
+	RAMD_HISTORY_SECONDS = 0,
+	RAMD_HISTORY_MINUTES,
+	RAMD_HISTORY_HOURS,
+	RAMD_HISTORY_RESOLUTION_COUNT
+} ramd_history_resolution_t;
+
+/* One step of a series; for the 1 s resolution max equals avg */
+typedef struct ramd_history_point_t
+{
+	int64_t ts;       /* unix seconds at the start of the step */
+	uint32_t present; /* bit s: series s has a value */
+	int64_t avg[RAMD_HISTORY_SERIES_COUNT];
+	int64_t max[RAMD_HISTORY_SERIES_COUNT];
+} ramd_history_point_t;
+
+/*
+ * Sample every RAMD_HISTORY_INTERVAL_MS on a background thread.  With
+ * metrics_history_file set the rings live in that file and survive a
+ * restart; otherwise they are in memory only.
+ */
+bool ramd_history_start(const ramd_config_t* config);
+void ramd_history_stop(void);
+
+const char* ramd_history_series_name(ramd_history_series_t series);
+const char* ramd_history_resolution_name(ramd_history_resolution_t resolution);
+bool ramd_history_parse_resolution(const char* name, ramd_history_resolution_t* resolution);
+int32_t ramd_history_step_seconds(ramd_history_resolution_t resolution);
+
+/* Points a resolution's ring holds when full */
+int32_t ramd_history_capacity(ramd_history_resolution_t resolution);
+
+/*
+ * Copy the newest max points at resolution starting at or after since
+ * (unix seconds) into points, oldest first, and return how many.  For
+ * minutes and hours the last one is the step still being filled, and
+ * partial says so.
+ */
+int32_t ramd_history_read(ramd_history_resolution_t resolution, int64_t since,
+                          ramd_history_point_t* points, int32_t max, bool* partial);
+
+#endif /* RAMD_HISTORY_H */
@@ -12,21 +12,26 @@
 #define RAMD_HTTP_API_H
 
 #include "ramd.h"
+#include "ramd_buffer.h"
+#include "ramd_http_profile.h"
+#include "ramd_memory.h"
 #include <pthread.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <openssl/ssl.h>
 
 /* HTTP API Configuration */
 #include "ramd_defaults.h"
 #define RAMD_HTTP_DEFAULT_PORT RAMD_DEFAULT_HTTP_PORT
-#define RAMD_HTTP_MAX_REQUEST_SIZE RAMD_MAX_COMMAND_LENGTH
+#define RAMD_HTTP_MAX_REQUEST_SIZE (RAMD_HTTP_MAX_HEADER_SIZE + RAMD_HTTP_MAX_BODY_SIZE)
 #define RAMD_HTTP_MAX_RESPONSE_SIZE (RAMD_MAX_COMMAND_LENGTH * 2)
 
 /* HTTP Methods */
 typedef enum
 {
 	RAMD_HTTP_GET,
+	RAMD_HTTP_HEAD,
 	RAMD_HTTP_POST,
 	RAMD_HTTP_PUT,
 	RAMD_HTTP_DELETE,
@@ -37,29 +42,55 @@ typedef enum
 typedef enum
 {
 	RAMD_HTTP_200_OK = 200,
+	RAMD_HTTP_202_ACCEPTED = 202,
+	RAMD_HTTP_304_NOT_MODIFIED = 304,
 	RAMD_HTTP_400_BAD_REQUEST = 400,
 	RAMD_HTTP_401_UNAUTHORIZED = 401,
+	RAMD_HTTP_403_FORBIDDEN = 403,
 	RAMD_HTTP_404_NOT_FOUND = 404,
 	RAMD_HTTP_405_METHOD_NOT_ALLOWED = 405,
 	RAMD_HTTP_409_CONFLICT = 409,
+	RAMD_HTTP_413_PAYLOAD_TOO_LARGE = 413,
 	RAMD_HTTP_500_INTERNAL_ERROR = 500,
 	RAMD_HTTP_501_NOT_IMPLEMENTED = 501,
 	RAMD_HTTP_503_SERVICE_UNAVAILABLE = 503
 } ramd_http_status_code_t;
 
-/* HTTP Request Structure */
+/*
+ * HTTP Request Structure
+ *
+ * The string members are NUL-terminated slices of the connection's input
+ * buffer and stay valid until the response has been sent.  query_string and
+ * body point at an empty string when the request has none.  Scratch memory
+ * a handler takes from arena is released in one go at the same point.
+ */
 typedef struct ramd_http_request_t
 {
 	ramd_http_method_t method;
-	char path[RAMD_MAX_PATH_LENGTH];
-	char query_string[RAMD_MAX_COMMAND_LENGTH];
-	char body[RAMD_HTTP_MAX_REQUEST_SIZE];
+	char* path;
+	char* query_string;
+	char* body;
 	size_t body_length;
-	char headers[RAMD_MAX_COMMAND_LENGTH];
+	char* headers; /* raw header lines, each ending in CRLF */
+	size_t headers_length;
 	char authorization[RAMD_MAX_HOSTNAME_LENGTH];
+	bool keep_alive; /* HTTP/1.1 default, or "Connection: keep-alive" */
+	char client_ip[INET6_ADDRSTRLEN]; /* socket peer; empty on the Unix socket */
+	bool peer_trusted; /* Unix socket peer is root or ramd's own user */
+	ramd_http_profile_sample_t profile;
+	ramd_arena_t* arena;
 } ramd_http_request_t;
 
-/* HTTP Response Structure */
+/*
+ * HTTP Response Structure
+ *
+ * Small bodies go into body.  Larger ones are appended to content, whose
+ * storage belongs to the connection and is reused, or handed over as a
+ * malloc'd owned_body that is freed once sent.  When owned_body_release
+ * is set the body is borrowed instead, and the callback is run in place
+ * of free().  The first non-empty of owned_body, content and body is what
+ * goes on the wire.
+ */
 typedef struct ramd_http_response_t
 {
 	ramd_http_status_code_t status;
@@ -67,27 +98,131 @@ typedef struct ramd_http_response_t
 	char body[RAMD_HTTP_MAX_RESPONSE_SIZE];
 	size_t body_length;
 	char headers[RAMD_MAX_COMMAND_LENGTH];
+	ramd_buffer_t content;
+	char* owned_body;
+	size_t owned_body_length;
+	void (*owned_body_release)(void* context);
+	void* owned_body_context;
+	/* Set, with no body, by a watch request that has nothing new yet */
+	uint64_t watch_since;
+	int32_t watch_wait_ms;
+	bool watch_logs; /* watch_since is a log store cursor, not a feed version */
 } ramd_http_response_t;
 
-/* HTTP Server Context */
+struct ramd_http_connection_t;
+
+/*
+ * HTTP Server Context
+ *
+ * One event-loop thread owns the listening sockets, TCP and the local
+ * Unix socket, and every client connection.  Handlers that may block (promote, failover, ...) are handed
+ * to a small worker pool and the result is passed back through wake_fd.
+ */
 typedef struct ramd_http_server_t
 {
 	int listen_fd;
 	int port;
 	bool running;
 	pthread_t server_thread;
-	pthread_mutex_t mutex;
+	pthread_mutex_t mutex; /* guards running, pending_listen_fd and the worker queues */
 	char bind_address[RAMD_MAX_HOSTNAME_LENGTH];
 	bool auth_enabled;
 	char auth_token[RAMD_MAX_COMMAND_LENGTH];
+
+	/* Event loop */
+	int poll_fd;
+	int pending_listen_fd; /* replacement listener the loop swaps in, or -1 */
+	int unix_fd;           /* local control socket, or -1 */
+	char unix_path[RAMD_MAX_PATH_LENGTH];
+	int wake_fd[2];
+	struct ramd_http_connection_t* connections; /* RAMD_HTTP_MAX_CONNECTIONS slots */
+	struct ramd_http_connection_t* free_list;
+	int32_t active_connections;
+
+	/* Worker pool for slow handlers */
+	pthread_t workers[RAMD_HTTP_WORKER_THREADS];
+	int32_t worker_count;
+	pthread_cond_t work_cond;
+	struct ramd_http_connection_t* work_head;
+	struct ramd_http_connection_t* work_tail;
+	struct ramd_http_connection_t* done_head;
 } ramd_http_server_t;
 
-/* HTTP Client Connection */
+/* Incremental request parser state */
+typedef enum
+{
+	RAMD_HTTP_PARSE_HEADERS = 0,
+	RAMD_HTTP_PARSE_BODY,
+	RAMD_HTTP_PARSE_CHUNK_SIZE,
+	RAMD_HTTP_PARSE_CHUNK_DATA,
+	RAMD_HTTP_PARSE_CHUNK_END,
+	RAMD_HTTP_PARSE_TRAILERS,
+	RAMD_HTTP_PARSE_DONE,
+	RAMD_HTTP_PARSE_ERROR
+} ramd_http_parse_state_t;
+
+/*
+ * Request parser.  It is fed the whole buffered input each time more bytes
+ * arrive and resumes at scan_pos.  Chunked bodies are decoded in place, so
+ * the body always ends up contiguous right after the headers.
+ */
+typedef struct ramd_http_parser_t
+{
+	ramd_http_parse_state_t state;
+	size_t scan_pos;   /* first byte not yet consumed */
+	size_t header_len; /* request line and headers, including the blank line */
+	size_t body_len;   /* decoded body bytes stored after the headers */
+	size_t remaining;  /* bytes left in the fixed-length body or current chunk */
+	bool chunked;
+	ramd_http_status_code_t error;
+} ramd_http_parser_t;
+
+/* Client connection state */
+typedef enum
+{
+	RAMD_HTTP_CONN_FREE = 0,
+	RAMD_HTTP_CONN_READING,
+	RAMD_HTTP_CONN_DISPATCHED,
+	RAMD_HTTP_CONN_WRITING,
+	RAMD_HTTP_CONN_PARKED /* watch long-poll waiting for a change */
+} ramd_http_conn_state_t;
+
+/* HTTP Client Connection, preallocated in a fixed pool */
 typedef struct ramd_http_connection_t
 {
 	int client_fd;
 	struct sockaddr_in client_addr;
+	bool local;        /* accepted on the Unix socket */
+	bool peer_trusted; /* ... from root or ramd's own user */
+	SSL* ssl;          /* TLS session, NULL for plaintext */
+	bool tls_established; /* handshake done and counted */
+	bool tls_failed;      /* fatal TLS error: closed without close_notify */
+	bool tls_flipped;     /* the record layer waits for the other direction */
 	ramd_http_server_t* server;
+	ramd_http_conn_state_t state;
+	int64_t deadline_ms;
+
+	char* in_buf; /* grows up to RAMD_HTTP_MAX_REQUEST_SIZE */
+	size_t in_cap;
+	size_t in_len;
+	ramd_http_parser_t parser;
+	size_t request_len; /* bytes of in_buf taken by the current request */
+	char saved_byte;    /* byte overwritten to terminate the request */
+	int32_t requests_served;
+	bool keep_alive;
+	int64_t started_us; /* dispatch time, for the latency histogram */
+	/* Status line and headers, then the body straight from the response */
+	char out_head[RAMD_MAX_COMMAND_LENGTH * 2];
+	size_t out_head_len;
+	const char* out_body;
+	size_t out_body_len;
+	size_t out_sent;
+
+	ramd_http_request_t request;
+	ramd_http_response_t response;
+	ramd_arena_t arena; /* the request's, reset once its response is out */
+
+	struct ramd_http_connection_t* next; /* free list or worker queue link */
 } ramd_http_connection_t;
 
 /* Function prototypes */
@@ -95,10 +230,23 @@ bool ramd_http_server_init(ramd_http_server_t* server, const char* bind_address,
                            int port);
 bool ramd_http_server_start(ramd_http_server_t* server);
 void ramd_http_server_stop(ramd_http_server_t* server);
+
+/*
+ * Move a running server to a new address: the new socket is bound with
+ * SO_REUSEPORT next to the old one and the event loop swaps it in after
+ * accepting what the old one still queues, so open connections are kept
+ * and clients never see the port closed.
+ */
+bool ramd_http_server_rebind(ramd_http_server_t* server, const char* bind_address,
+                             int port);
 void ramd_http_server_cleanup(ramd_http_server_t* server);
 
-bool ramd_http_parse_request(const char* raw_request,
+bool ramd_http_parse_request(char* buffer, size_t header_len,
                              ramd_http_request_t* request);
+ramd_http_parse_state_t ramd_http_parser_feed(ramd_http_parser_t* parser,
+                                              char* buffer, size_t length);
+const char* ramd_http_get_header(const ramd_http_request_t* request,
+                                 const char* name, size_t* value_length);
 void ramd_http_handle_request(ramd_http_request_t* request,
                               ramd_http_response_t* response);
 bool ramd_http_send_response(int client_fd, ramd_http_response_t* response);
@@ -108,6 +256,12 @@ void ramd_http_handle_cluster_status(ramd_http_request_t* request,
                                      ramd_http_response_t* response);
 void ramd_http_handle_nodes_list(ramd_http_request_t* request,
                                  ramd_http_response_t* response);
+void ramd_http_handle_state(ramd_http_request_t* request,
+                            ramd_http_response_t* response);
+void ramd_http_handle_health(ramd_http_request_t* request,
+                             ramd_http_response_t* response);
+void ramd_http_handle_role_check(ramd_http_request_t* request,
+                                 ramd_http_response_t* response);
 void ramd_http_handle_node_detail(ramd_http_request_t* request,
                                   ramd_http_response_t* response);
 void ramd_http_handle_promote_node(ramd_http_request_t* request,
@@ -116,6 +270,12 @@ void ramd_http_handle_demote_node(ramd_http_request_t* request,
                                   ramd_http_response_t* response);
 void ramd_http_handle_failover(ramd_http_request_t* request,
                                ramd_http_response_t* response);
+void ramd_http_handle_failover_history(ramd_http_request_t* request,
+                                       ramd_http_response_t* response);
+void ramd_http_handle_debug_endpoints(ramd_http_request_t* request,
+                                      ramd_http_response_t* response);
+void ramd_http_handle_debug_pprof_profile(ramd_http_request_t* request,
+                                          ramd_http_response_t* response);
 void ramd_http_handle_maintenance_mode(ramd_http_request_t* request,
                                        ramd_http_response_t* response);
 void ramd_http_handle_config_reload(ramd_http_request_t* request,
@@ -126,6 +286,26 @@ void ramd_http_handle_bootstrap_primary(ramd_http_request_t* request,
                                         ramd_http_response_t* response);
 void ramd_http_handle_add_replica(ramd_http_request_t* request,
                                   ramd_http_response_t* response);
+void ramd_http_handle_rebuild(ramd_http_request_t* request,
+                              ramd_http_response_t* response);
+void ramd_http_handle_switchover(ramd_http_request_t* request,
+                                 ramd_http_response_t* response);
+void ramd_http_handle_rolling(ramd_http_request_t* request,
+                              ramd_http_response_t* response);
+void ramd_http_handle_watch(ramd_http_request_t* request,
+                            ramd_http_response_t* response);
+void ramd_http_handle_logs(ramd_http_request_t* request,
+                           ramd_http_response_t* response);
+void ramd_http_handle_metrics_history(ramd_http_request_t* request,
+                                      ramd_http_response_t* response);
+void ramd_http_handle_jobs(ramd_http_request_t* request,
+                           ramd_http_response_t* response);
+void ramd_http_handle_backup_jobs(ramd_http_request_t* request,
+                                  ramd_http_response_t* response);
+void ramd_http_handle_replication_lag(ramd_http_request_t* request,
+                                      ramd_http_response_t* response);
+void ramd_http_handle_replication_topology(ramd_http_request_t* request,
+                                           ramd_http_response_t* response);
 void ramd_http_handle_metrics(ramd_http_request_t* request,
                               ramd_http_response_t* response);
 void ramd_http_handle_prometheus_metrics(ramd_http_request_t* request,
@@ -148,6 +328,7 @@ void ramd_http_handle_cluster_notify(ramd_http_request_t* request, ramd_http_res
 /* Utility functions */
 char* ramd_http_get_query_param(const char* query_string,
                                 const char* param_name);
+const char* ramd_http_request_param(ramd_http_request_t* request, const char* name);
 bool ramd_http_authenticate(const char* authorization,
                             const char* required_token);
 void ramd_http_set_json_response(ramd_http_response_t* response,
@@ -156,5 +337,20 @@ void ramd_http_set_json_response(ramd_http_response_t* response,
 void ramd_http_set_error_response(ramd_http_response_t* response,
                                   ramd_http_status_code_t status,
                                   const char* message);
+void ramd_http_response_reset(ramd_http_response_t* response);
+bool ramd_http_response_appendf(ramd_http_response_t* response,
+                                const char* format, ...)
+    __attribute__((format(printf, 2, 3)));
+void ramd_http_set_owned_body(ramd_http_response_t* response,
+                              ramd_http_status_code_t status,
+                              const char* content_type, char* body,
+                              size_t length);
+void ramd_http_set_shared_body(ramd_http_response_t* response,
+                               ramd_http_status_code_t status,
+                               const char* content_type, const char* body,
+                               size_t length, void (*release)(void* context),
+                               void* context);
+const char* ramd_http_response_body(const ramd_http_response_t* response,
+                                    size_t* length);
 
 #endif /* RAMD_HTTP_API_H */
@@ -0,0 +1,73 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_http_profile.h
+ *		PostgreSQL Auto-Failover Daemon - Per-Endpoint HTTP Request Profiler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Requests are aggregated in-process by method and route, in the spirit
+ * of pg_stat_statements: calls, a latency histogram, bytes in and out,
+ * and the time spent rate limiting, authenticating, in the handler and
+ * holding PostgreSQL sessions.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_HTTP_PROFILE_H
+#define RAMD_HTTP_PROFILE_H
+
+#include "ramd.h"
+#include "ramd_buffer.h"
+#include "ram_json.h"
+
+typedef enum
+{
+	RAMD_HTTP_PROFILE_RATE_LIMIT = 0,
+	RAMD_HTTP_PROFILE_AUTH,       /* token check, rate limit excluded */
+	RAMD_HTTP_PROFILE_HANDLER,    /* routing and the handler itself */
+	RAMD_HTTP_PROFILE_POSTGRESQL, /* pooled sessions checked out, inside the handler */
+	RAMD_HTTP_PROFILE_PHASE_COUNT
+} ramd_http_profile_phase_t;
+
+/* One request's timings; lives in the request and is reset with it */
+typedef struct ramd_http_profile_sample_t
+{
+	int64_t phase_us[RAMD_HTTP_PROFILE_PHASE_COUNT];
+	int64_t total_us;    /* dispatch to response, without a watch's wait */
+	int64_t pg_start_us; /* outermost checkout still held */
+	int32_t pg_depth;
+	bool routed;         /* reached the router, so it has an endpoint */
+	bool unmatched;      /* no route: counted together, not by path */
+	bool recorded;
+} ramd_http_profile_sample_t;
+
+/*
+ * Make sample the calling thread's current request until detached; the
+ * phase and PostgreSQL calls below do nothing without one, so sessions
+ * the monitor or failover threads borrow are not charged to a request.
+ */
+void ramd_http_profile_attach(ramd_http_profile_sample_t* sample);
+void ramd_http_profile_detach(void);
+void ramd_http_profile_add(ramd_http_profile_phase_t phase, int64_t duration_us);
+void ramd_http_profile_pg_enter(void);
+void ramd_http_profile_pg_leave(void);
+
+/*
+ * Fold a finished request into its endpoint.  Numeric path segments are
+ * collapsed to ":id"; past RAMD_HTTP_PROFILE_MAX_ENDPOINTS distinct routes
+ * the rest share one "other" entry.
+ */
+void ramd_http_profile_record(const char* method, const char* path, int status,
+                              const ramd_http_profile_sample_t* sample,
+                              size_t bytes_in, size_t bytes_out);
+
+/* Forget everything recorded, like pg_stat_statements_reset() */
+void ramd_http_profile_reset(void);
+
+/* The busiest limit endpoints by total time; limit <= 0 writes all of them */
+bool ramd_http_profile_write_json(ram_json_writer_t* w, int32_t limit);
+bool ramd_http_profile_render_prometheus(ramd_buffer_t* output);
+
+const char* ramd_http_profile_phase_to_string(ramd_http_profile_phase_t phase);
+
+#endif /* RAMD_HTTP_PROFILE_H */
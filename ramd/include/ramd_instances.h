@@ -0,0 +1,24 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_instances.h
+ *		PostgreSQL Auto-Failover Daemon - Instance Supervisor
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_INSTANCES_H
+#define RAMD_INSTANCES_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+
+/*
+ * Run as the supervisor of the clusters configured in
+ * config->instances_dir, one *.conf per cluster, until SIGTERM or SIGINT.
+ * SIGHUP rescans the directory.  Returns the process exit code.
+ */
+int ramd_instances_run(const ramd_config_t* config, const char* progname);
+
+#endif /* RAMD_INSTANCES_H */
@@ -0,0 +1,86 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_job.h
+ *		PostgreSQL Auto-Failover Daemon - Background Jobs
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_JOB_H
+#define RAMD_JOB_H
+
+#include <time.h>
+
+#include "ramd.h"
+
+typedef enum
+{
+	RAMD_JOB_QUEUED = 0,
+	RAMD_JOB_RUNNING,
+	RAMD_JOB_SUCCEEDED,
+	RAMD_JOB_FAILED
+} ramd_job_state_t;
+
+/* One step of a job; duration_ms is -1 while it is still running */
+typedef struct ramd_job_phase_t
+{
+	char name[32];
+	int64_t started_ms; /* since the job started */
+	int64_t duration_ms;
+} ramd_job_phase_t;
+
+/* Snapshot of a job, as reported over the HTTP API */
+typedef struct ramd_job_status_t
+{
+	uint64_t job_id;
+	char operation[32];
+	ramd_job_state_t state;
+	int32_t queue_position;   /* queued jobs ahead of this one */
+	int32_t progress_percent; /* -1 if the operation does not report it */
+	int32_t phase_count;
+	ramd_job_phase_t phases[RAMD_JOB_MAX_PHASES];
+	int32_t result_status;    /* HTTP status the operation finished with */
+	time_t created_at;
+	time_t started_at;
+	time_t finished_at;
+	int64_t total_ms;
+} ramd_job_status_t;
+
+/* Runs on a job worker; report the outcome with ramd_job_finish */
+typedef void (*ramd_job_fn)(void* arg);
+
+/* Start the worker pool; cleanup waits for running jobs and drops queued ones */
+bool ramd_job_init(void);
+void ramd_job_cleanup(void);
+
+/*
+ * Queue run(arg) under a new job id.  free_arg(arg) is called once run has
+ * returned, or right away if the job cannot be queued.  Fails when
+ * RAMD_JOB_MAX_JOBS jobs are queued or running at once.
+ */
+bool ramd_job_submit(const char* operation, ramd_job_fn run, void* arg,
+                     void (*free_arg)(void* arg), uint64_t* job_id);
+
+/*
+ * Called by a running job, on its own thread; outside a job they do
+ * nothing, so code shared with synchronous paths can call them freely.
+ * A phase ends when the next one starts or the job finishes.
+ */
+void ramd_job_phase(const char* phase);
+void ramd_job_progress(int32_t percent);
+void ramd_job_finish(bool succeeded, int32_t result_status,
+                     const char* result, size_t result_length);
+
+/*
+ * Fetch a job still held in history; *result, if asked for, is a malloc'd
+ * copy of the operation's JSON result, NULL until it finishes.
+ */
+bool ramd_job_get(uint64_t job_id, ramd_job_status_t* status, char** result,
+                  size_t* result_length);
+int32_t ramd_job_list(ramd_job_status_t* statuses, int32_t max_count);
+
+const char* ramd_job_state_to_string(ramd_job_state_t state);
+
+#endif /* RAMD_JOB_H */
@@ -0,0 +1,75 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_lag.h
+ *		PostgreSQL Auto-Failover Daemon - Replication Lag Sampler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_LAG_H
+#define RAMD_LAG_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/* One pg_stat_replication row; *_lag_ms is -1 when the server had no figure */
+typedef struct ramd_lag_sample_t
+{
+	int64_t sampled_at_us; /* CLOCK_MONOTONIC */
+	int64_t write_lag_bytes;
+	int64_t flush_lag_bytes;
+	int64_t replay_lag_bytes;
+	int32_t write_lag_ms;
+	int32_t flush_lag_ms;
+	int32_t replay_lag_ms;
+} ramd_lag_sample_t;
+
+/* Aggregates over a standby's recent samples */
+typedef struct ramd_lag_stats_t
+{
+	int32_t node_id; /* -1 if the walsender could not be matched to a node */
+	char application_name[64];
+	char client_addr[64];
+	bool connected;  /* present in the latest pg_stat_replication read */
+	bool is_sync;    /* sync_state is sync or quorum */
+	int64_t flush_lsn;
+	int64_t replay_lsn;
+	int64_t age_ms;  /* since the latest sample */
+	ramd_lag_sample_t last;
+	double ewma_replay_lag_ms;
+	double ewma_flush_lag_ms;  /* what a synchronous_commit = on commit waits for */
+	int32_t p99_replay_lag_ms;
+	double trend_bytes_per_second; /* growth of replay lag; > 0 is falling behind */
+	int32_t sample_count;
+} ramd_lag_stats_t;
+
+/* Sample the current primary every lag_sample_interval_ms on a background thread */
+bool ramd_lag_start(ramd_cluster_t* cluster, const ramd_config_t* config);
+void ramd_lag_stop(void);
+
+/* Take the next sample now instead of at the end of the interval */
+void ramd_lag_request_sample(void);
+
+/* Stats for one node; false if it has never been seen by the sampler */
+bool ramd_lag_get_stats(int32_t node_id, ramd_lag_stats_t* stats);
+
+/* Stats for every known standby; returns how many were written */
+int32_t ramd_lag_get_all(ramd_lag_stats_t* stats, int32_t max_count);
+
+/* The primary's WAL flush position as of the latest sample, -1 if unknown */
+int64_t ramd_lag_primary_flush_lsn(void);
+
+/*
+ * Wait until node_id, or at least min_standbys synchronous standbys, report
+ * flushing target_lsn.  A negative target_lsn waits for the primary's flush
+ * position at the time of the call.  Waiters are woken as each sample is
+ * recorded, and the sampler speeds up while anyone is waiting.  Returns
+ * false on timeout or if the sampler is not running.
+ */
+bool ramd_lag_wait_for_flush(int32_t node_id, int64_t target_lsn, int32_t timeout_ms);
+bool ramd_lag_wait_for_sync(int32_t min_standbys, int64_t target_lsn, int32_t timeout_ms);
+
+#endif /* RAMD_LAG_H */
@@ -0,0 +1,27 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_leader_watch.h
+ *		PostgreSQL Auto-Failover Daemon - Raft Leader Change Watch
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_LEADER_WATCH_H
+#define RAMD_LEADER_WATCH_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_monitor.h"
+
+/*
+ * Block in pgraft_wait_leader_change() on a session of our own to the
+ * local node and wake the monitor the moment the Raft leader or term
+ * moves.  Without pgraft, or with one too old to have the function, the
+ * watch retries quietly and the monitor's own cycle is all there is.
+ */
+bool ramd_leader_watch_start(ramd_monitor_t* monitor, const ramd_config_t* config);
+void ramd_leader_watch_stop(void);
+
+#endif /* RAMD_LEADER_WATCH_H */
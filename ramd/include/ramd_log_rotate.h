@@ -0,0 +1,37 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_log_rotate.h
+ *		PostgreSQL Auto-Failover Daemon - Rotated Log Compression
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_LOG_ROTATE_H
+#define RAMD_LOG_ROTATE_H
+
+#include "ramd.h"
+
+/* What rotated files are compressed to */
+#if defined(HAVE_LIBZSTD)
+#define RAMD_LOG_ROTATE_SUFFIX ".zst"
+#else
+#define RAMD_LOG_ROTATE_SUFFIX ".gz"
+#endif
+
+/*
+ * Tidy up after the writer has renamed log_file to log_file.<timestamp>:
+ * on a background thread at idle priority, delete all but the newest keep
+ * rotated files and, with compress, compress those not compressed yet.
+ * Never waits: a request made while a pass is running is picked up when
+ * it ends.  Files left over by an earlier run are taken care of too.
+ */
+void ramd_log_rotate_request(const char* log_file, int32_t keep, bool compress);
+
+/* Hold the compressor's lock across fork(), as the logger does its own */
+void ramd_log_rotate_atfork_prepare(void);
+void ramd_log_rotate_atfork_parent(void);
+void ramd_log_rotate_atfork_child(void);
+
+#endif /* RAMD_LOG_ROTATE_H */
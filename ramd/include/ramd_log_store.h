@@ -0,0 +1,84 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_log_store.h
+ *		PostgreSQL Auto-Failover Daemon - In-Memory Log Store
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_LOG_STORE_H
+#define RAMD_LOG_STORE_H
+
+#include "ramd.h"
+#include "ramd_logging.h"
+
+/* One stored log line, as copied out by a query */
+typedef struct ramd_log_record_t
+{
+	uint64_t cursor; /* position in the store, from 1, never reused */
+	int64_t ts_us;   /* unix time in microseconds */
+	ramd_log_level_t level;
+	char component[RAMD_LOG_COMPONENT_MAX];
+	char message[RAMD_LOG_STORE_MESSAGE_MAX];
+} ramd_log_record_t;
+
+/* Which records a query wants; zero fields do not filter */
+typedef struct ramd_log_query_t
+{
+	uint64_t after;            /* only records past this cursor */
+	int64_t since_us;          /* only records logged at or after this time */
+	ramd_log_level_t min_level;
+	const char* component;     /* exact component name, NULL for any */
+	int32_t limit;
+} ramd_log_query_t;
+
+/* Where a query stopped, for the next page */
+typedef struct ramd_log_page_t
+{
+	uint64_t next_cursor;   /* pass as after to continue; covers skipped records too */
+	uint64_t oldest_cursor; /* oldest record still held, 0 if none */
+	uint64_t newest_cursor;
+	bool more;              /* the limit stopped the scan before newest_cursor */
+	bool gap;               /* records past after were evicted before being read */
+} ramd_log_page_t;
+
+/*
+ * Keep a line the logger has accepted, cutting message at
+ * RAMD_LOG_STORE_MESSAGE_MAX.  Called by the log writer thread, or by the
+ * logging caller when there is none.
+ */
+void ramd_log_store_append(ramd_log_level_t level, int64_t ts_us, const char* component,
+                           size_t component_length, const char* message, size_t length);
+
+/* Tell the listener that records were appended; once per batch */
+void ramd_log_store_notify(void);
+
+/*
+ * Copy up to max records matching query, oldest first, into out and
+ * return how many.  Never waits for the logger.
+ */
+int32_t ramd_log_store_query(const ramd_log_query_t* query, ramd_log_record_t* out,
+                             int32_t max, ramd_log_page_t* page);
+
+/*
+ * The after cursor from which the last count records matching query
+ * follow, for a tail; query->after still bounds how far back it looks.
+ */
+uint64_t ramd_log_store_seek_tail(const ramd_log_query_t* query, int32_t count);
+
+/* Cursor of the newest record, 0 while the store is empty */
+uint64_t ramd_log_store_newest(void);
+
+/* Records held per level, indexed by ramd_log_level_t */
+void ramd_log_store_counts(uint64_t counts[RAMD_LOG_LEVEL_FATAL + 1]);
+
+/*
+ * Call listener(arg) after records are appended, e.g. to answer parked
+ * follow requests; NULL removes it.  It runs on the log writer thread
+ * and must neither block nor log.
+ */
+void ramd_log_store_set_listener(void (*listener)(void* arg), void* arg);
+
+#endif /* RAMD_LOG_STORE_H */
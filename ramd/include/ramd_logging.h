@@ -24,6 +24,27 @@ typedef enum ramd_log_level
 	RAMD_LOG_LEVEL_FATAL
 } ramd_log_level_t;
 
+/* Output format of each log line */
+typedef enum ramd_log_format
+{
+	RAMD_LOG_FORMAT_TEXT = 0,
+	RAMD_LOG_FORMAT_JSON /* one JSON object per line */
+} ramd_log_format_t;
+
+/*
+ * Extra key/value pair for ramd_log_kv(); a NULL str means the number is
+ * logged instead.  Build them with RAMD_LOG_STR() and RAMD_LOG_INT().
+ */
+typedef struct ramd_log_field
+{
+	const char* key;
+	const char* str;
+	int64_t num;
+} ramd_log_field_t;
+
+#define RAMD_LOG_STR(k, v) ((ramd_log_field_t){ (k), (v) ? (v) : "", 0 })
+#define RAMD_LOG_INT(k, v) ((ramd_log_field_t){ (k), NULL, (int64_t) (v) })
+
 /* Logging configuration */
 typedef struct ramd_logging_config
 {
@@ -34,6 +55,12 @@ typedef struct ramd_logging_config
 	char log_file[RAMD_MAX_PATH_LENGTH];
 	FILE* log_fp;
 	bool initialized;
+	ramd_log_format_t format;
+	int32_t node_id;
+
+	/* Cached once so logging never calls getpwuid() or getpid() per line */
+	pid_t pid;
+	char username[RAMD_MAX_USERNAME_LENGTH];
 } ramd_logging_config_t;
 
 /* Global logging configuration */
@@ -45,32 +72,62 @@ extern bool ramd_logging_init(const char* log_file, ramd_log_level_t min_level,
                               bool log_to_console);
 extern void ramd_logging_cleanup(void);
 
+/* Wait until every line logged so far has been written out */
+extern void ramd_logging_flush(void);
+
+/* Line format and the node id stamped on JSON lines; call after init */
+extern void ramd_logging_set_format(ramd_log_format_t format, int32_t node_id);
+extern ramd_log_format_t ramd_logging_string_to_format(const char* format_str);
+
+/* Change the minimum level without reopening the sinks */
+extern void ramd_logging_set_level(ramd_log_level_t level);
+
+/*
+ * Rotate the log file at size_mb or every age_min minutes (0 for either
+ * disables it), keeping keep rotated files, compressed if compress.  The
+ * writer thread rotates; callers never wait for it.
+ */
+extern void ramd_logging_set_rotation(int32_t size_mb, int32_t age_min, int32_t keep,
+                                      bool compress);
+
 /* Logging functions */
 extern void ramd_log(ramd_log_level_t level, const char* file, int line,
                      const char* function, const char* format, ...);
+extern void ramd_log_kv(ramd_log_level_t level, const char* file, int line,
+                        const char* function, const ramd_log_field_t* fields,
+                        size_t field_count, const char* format, ...);
 
-/* Convenience macros - simplified for production use */
+/*
+ * Convenience macros.  The call site is recorded for JSON lines; the text
+ * format does not print it.
+ */
 #define ramd_log_debug(...)                                                    \
-	ramd_log(RAMD_LOG_LEVEL_DEBUG, "", 0, "", __VA_ARGS__)
-#define ramd_log_info(...) ramd_log(RAMD_LOG_LEVEL_INFO, "", 0, "", __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_DEBUG, __FILE__, __LINE__, __func__, __VA_ARGS__)
+#define ramd_log_info(...)                                                     \
+	ramd_log(RAMD_LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define ramd_log_notice(...)                                                   \
-	ramd_log(RAMD_LOG_LEVEL_NOTICE, "", 0, "", __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_NOTICE, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define ramd_log_warning(...)                                                  \
-	ramd_log(RAMD_LOG_LEVEL_WARNING, "", 0, "", __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_WARNING, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define ramd_log_error(...)                                                    \
-	ramd_log(RAMD_LOG_LEVEL_ERROR, "", 0, "", __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, __VA_ARGS__)
 #define ramd_log_fatal(...)                                                    \
-	ramd_log(RAMD_LOG_LEVEL_FATAL, "", 0, "", __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_FATAL, __FILE__, __LINE__, __func__, __VA_ARGS__)
+
+/* Log with extra fields, e.g. RAMD_LOG_KV(INFO, f, "done"), f an array */
+#define RAMD_LOG_KV(level, fields, ...)                                        \
+	ramd_log_kv(RAMD_LOG_LEVEL_##level, __FILE__, __LINE__, __func__,          \
+	            (fields), sizeof(fields) / sizeof((fields)[0]), __VA_ARGS__)
 
 /* Professional status logging macros */
 #define ramd_log_success(...) \
-	ramd_log(RAMD_LOG_LEVEL_INFO, "", 0, "", "✓ " __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, "✓ " __VA_ARGS__)
 #define ramd_log_failure(...) \
-	ramd_log(RAMD_LOG_LEVEL_ERROR, "", 0, "", "✗ " __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, "✗ " __VA_ARGS__)
 #define ramd_log_operation(...) \
-	ramd_log(RAMD_LOG_LEVEL_INFO, "", 0, "", "→ " __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, "→ " __VA_ARGS__)
 #define ramd_log_status(...) \
-	ramd_log(RAMD_LOG_LEVEL_NOTICE, "", 0, "", "● " __VA_ARGS__)
+	ramd_log(RAMD_LOG_LEVEL_NOTICE, __FILE__, __LINE__, __func__, "● " __VA_ARGS__)
 
 /* Log level utilities */
 extern const char* ramd_logging_level_to_string(ramd_log_level_t level);
@@ -0,0 +1,60 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_logical_slots.h
+ *		PostgreSQL Auto-Failover Daemon - Logical Failover Slots
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_LOGICAL_SLOTS_H
+#define RAMD_LOGICAL_SLOTS_H
+
+#include <libpq-fe.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/* How this node keeps its copies of the primary's logical slots */
+typedef enum
+{
+	RAMD_LOGICAL_SYNC_OFF = 0,     /* disabled, or nothing to do on this node */
+	RAMD_LOGICAL_SYNC_PRIMARY,     /* this is the primary; its slots are the originals */
+	RAMD_LOGICAL_SYNC_NATIVE,      /* PostgreSQL 17 sync_replication_slots */
+	RAMD_LOGICAL_SYNC_ADVANCE,     /* PostgreSQL 16: ramd creates and advances the copies */
+	RAMD_LOGICAL_SYNC_UNSUPPORTED  /* before 16, or cascaded; lost on failover */
+} ramd_logical_sync_method_t;
+
+/* A logical slot of the primary and this node's copy of it */
+typedef struct ramd_logical_slot_stats_t
+{
+	char slot_name[64];
+	char plugin[64];
+	char database[64];
+	bool active;               /* a consumer is connected on the primary */
+	bool failover;             /* marked for PostgreSQL 17 slot synchronization */
+	int64_t confirmed_lsn;     /* the consumer's confirmed_flush_lsn on the primary */
+	int64_t local_confirmed_lsn; /* this standby's copy, -1 if it has none */
+	bool ready;                /* the copy is not ahead of the consumer; safe to fail over */
+} ramd_logical_slot_stats_t;
+
+/*
+ * One pass, throttled to RAMD_LOGICAL_SLOT_SYNC_INTERVAL_MS: read the
+ * logical slots of the primary behind conn and keep this node's standby
+ * in step with them.  On the primary's own daemon, from PostgreSQL 17,
+ * mark idle slots for failover and list the directly attached healthy
+ * standbys in synchronized_standby_slots.  Called by the lag sampler
+ * after ramd_slots_manage().
+ */
+void ramd_logical_slots_sync(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                             const ramd_config_t* config);
+
+/* Slots seen on the latest pass; returns how many were written */
+int32_t ramd_logical_slots_get_all(ramd_logical_slot_stats_t* stats, int32_t max_count,
+                                   ramd_logical_sync_method_t* method);
+
+const char* ramd_logical_sync_method_to_string(ramd_logical_sync_method_t method);
+
+#endif /* RAMD_LOGICAL_SLOTS_H */
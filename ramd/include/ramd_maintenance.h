@@ -36,6 +36,18 @@ typedef enum
 	RAMD_MAINTENANCE_STATUS_FAILED
 } ramd_maintenance_status_t;
 
+/* Where a connection drain is; exported with its progress as metrics */
+typedef enum
+{
+	RAMD_DRAIN_PHASE_NONE = 0,
+	RAMD_DRAIN_PHASE_PAUSE_POOLER,   /* new clients held by the pooler */
+	RAMD_DRAIN_PHASE_TERMINATE_IDLE, /* idle sessions past the grace period killed */
+	RAMD_DRAIN_PHASE_WAIT_ACTIVE,    /* waiting for running queries to finish */
+	RAMD_DRAIN_PHASE_DONE,
+	RAMD_DRAIN_PHASE_TIMED_OUT,
+	RAMD_DRAIN_PHASE_COUNT
+} ramd_maintenance_drain_phase_t;
+
 /* Maintenance operation configuration */
 typedef struct ramd_maintenance_config_t
 {
@@ -63,6 +75,7 @@ typedef struct ramd_maintenance_state_t
 	time_t start_time;
 	time_t end_time;
 	time_t scheduled_end;
+	int64_t start_ms; /* ramd_clock_now_ms(), for the elapsed time */
 	char reason[RAMD_MAX_HOSTNAME_LENGTH];
 	char contact_info[RAMD_MAX_HOSTNAME_LENGTH];
 	char initiated_by[RAMD_MAX_HOSTNAME_LENGTH];
@@ -101,8 +114,15 @@ bool ramd_maintenance_pre_check(const ramd_maintenance_config_t* config,
                                 ramd_maintenance_check_t* checks);
 bool ramd_maintenance_is_safe_to_enter(const ramd_maintenance_config_t* config);
 
-/* Connection draining */
+/*
+ * Connection draining.  Pauses the configured pooler, then until no session
+ * is running a query or holding a transaction open, keeps terminating
+ * sessions that have been idle for maintenance_drain_idle_grace_ms.  Plain
+ * idle sessions never hold up the drain.  Sessions of ramd itself are left
+ * alone.  True once drained, false on timeout or error.
+ */
 bool ramd_maintenance_drain_connections(int32_t node_id, int32_t timeout_ms);
+const char* ramd_maintenance_drain_phase_to_string(ramd_maintenance_drain_phase_t phase);
 bool ramd_maintenance_get_connection_count(int32_t node_id, int32_t* count);
 bool ramd_maintenance_prevent_new_connections(int32_t node_id, bool prevent);
 
@@ -167,11 +187,18 @@ ramd_maintenance_type_t ramd_maintenance_string_to_type(const char* type_str);
 bool ramd_maintenance_is_cluster_safe_for_maintenance(int32_t target_node_id);
 
 /* Internal functions */
-bool check_backup_availability(void);
-bool check_cluster_health(void);
-bool check_all_nodes_reachable(void);
-bool check_sufficient_standbys(void);
-bool check_replication_current(void);
-bool check_no_active_transactions(void);
+
+/*
+ * The latest backup exists and has not failed verification.  A cached
+ * verification result is used when there is one; otherwise a background
+ * verification is queued and existence is all that counts this time.
+ * note, if given, receives a sentence for the check details.
+ */
+bool check_backup_availability(char* note, size_t note_size);
+bool check_cluster_health(const ramd_cluster_t* cluster);
+bool check_all_nodes_reachable(const ramd_cluster_t* cluster, int32_t timeout_ms);
+bool check_sufficient_standbys(const ramd_cluster_t* cluster);
+bool check_replication_current(const ramd_cluster_t* cluster);
+bool check_no_active_transactions(int32_t timeout_ms, int32_t* active_connections);
 
 #endif /* RAMD_MAINTENANCE_H */
@@ -0,0 +1,85 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_memory.h
+ *		PostgreSQL Auto-Failover Daemon - Memory Accounting and Arenas
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_MEMORY_H
+#define RAMD_MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ramd_buffer_t ramd_buffer_t;
+
+/* Owners memory is charged to; OTHER is zero so untagged buffers land there */
+typedef enum
+{
+	RAMD_MEM_OTHER = 0,
+	RAMD_MEM_HTTP,    /* connections, request arenas, response bodies */
+	RAMD_MEM_METRICS, /* exposition snapshots and render buffers */
+	RAMD_MEM_BACKUP,  /* base backup streams and background job results */
+	RAMD_MEM_LOGGING,
+	RAMD_MEM_PROXY,   /* client sessions and their relay buffers */
+	RAMD_MEM_SUBSYSTEM_COUNT
+} ramd_mem_subsystem_t;
+
+typedef struct ramd_mem_stats_t
+{
+	int64_t bytes;      /* held now, as the allocator sized the blocks */
+	int64_t peak_bytes;
+	int64_t allocations;
+	int64_t frees;
+} ramd_mem_stats_t;
+
+/*
+ * malloc() and friends, charged to a subsystem.  Blocks are plain heap
+ * blocks: one freed with free() instead of ramd_mem_free() is released
+ * all the same but stays on the subsystem's books.
+ */
+void* ramd_mem_alloc(ramd_mem_subsystem_t subsystem, size_t size);
+void* ramd_mem_calloc(ramd_mem_subsystem_t subsystem, size_t count, size_t size);
+void* ramd_mem_realloc(ramd_mem_subsystem_t subsystem, void* ptr, size_t size);
+char* ramd_mem_strdup(ramd_mem_subsystem_t subsystem, const char* s);
+void ramd_mem_free(ramd_mem_subsystem_t subsystem, void* ptr);
+
+/* Charge or release a block allocated some other way, e.g. posix_memalign() */
+void ramd_mem_track(ramd_mem_subsystem_t subsystem, const void* ptr);
+void ramd_mem_untrack(ramd_mem_subsystem_t subsystem, const void* ptr);
+
+/* Charge memory that is not on the heap, such as a static ring */
+void ramd_mem_account(ramd_mem_subsystem_t subsystem, int64_t bytes);
+
+void ramd_mem_get_stats(ramd_mem_subsystem_t subsystem, ramd_mem_stats_t* stats);
+bool ramd_mem_render_prometheus(ramd_buffer_t* output);
+const char* ramd_mem_subsystem_to_string(ramd_mem_subsystem_t subsystem);
+
+/*
+ * Bump allocator whose memory is given back all at once.  Allocations
+ * come from chunks of chunk_size, larger ones get a chunk of their own.
+ * Resetting keeps the first chunk, so an arena reused for one request
+ * after another does not go back to malloc() once it has warmed up.
+ */
+typedef struct ramd_arena_chunk_t ramd_arena_chunk_t;
+
+typedef struct ramd_arena_t
+{
+	ramd_mem_subsystem_t subsystem;
+	size_t chunk_size;
+	ramd_arena_chunk_t* head; /* chunk being filled; the first one is last */
+	size_t used;              /* bytes handed out since the last reset */
+} ramd_arena_t;
+
+void ramd_arena_init(ramd_arena_t* arena, ramd_mem_subsystem_t subsystem, size_t chunk_size);
+void* ramd_arena_alloc(ramd_arena_t* arena, size_t size);
+void* ramd_arena_calloc(ramd_arena_t* arena, size_t count, size_t size);
+char* ramd_arena_strndup(ramd_arena_t* arena, const char* s, size_t length);
+void ramd_arena_reset(ramd_arena_t* arena);
+void ramd_arena_destroy(ramd_arena_t* arena);
+
+#endif /* RAMD_MEMORY_H */
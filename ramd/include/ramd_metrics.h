@@ -12,8 +12,45 @@
 #define RAMD_METRICS_H
 
 #include "ramd.h"
+#include "ramd_buffer.h"
+#include "ramd_maintenance.h"
+#include "ramd_switchover.h"
+#include <stdatomic.h>
 #include <time.h>
 
+/*
+ * Event counters.  Hot paths add to their thread's shard without locking;
+ * the shards are only summed when an exposition is rendered.
+ */
+typedef enum
+{
+	RAMD_METRIC_HEALTH_CHECKS = 0,
+	RAMD_METRIC_HEALTH_CHECKS_FAILED,
+	RAMD_METRIC_FAILOVERS,
+	RAMD_METRIC_PROMOTIONS,
+	RAMD_METRIC_DEMOTIONS,
+	RAMD_METRIC_PROMOTIONS_TIMED,
+	RAMD_METRIC_PROMOTIONS_PG_CTL,
+	RAMD_METRIC_PROMOTION_DURATION_SUM_US,
+	RAMD_METRIC_SWITCHOVERS,
+	RAMD_METRIC_SWITCHOVERS_FAILED,
+	RAMD_METRIC_HTTP_REQUESTS,
+	RAMD_METRIC_HTTP_2XX,
+	RAMD_METRIC_HTTP_4XX,
+	RAMD_METRIC_HTTP_5XX,
+	RAMD_METRIC_HTTP_IN_FLIGHT,
+	RAMD_METRIC_HTTP_DURATION_SUM_US,
+	/* Per-bucket (non-cumulative) latency counts; the last one is +Inf */
+	RAMD_METRIC_HTTP_DURATION_BUCKET,
+	RAMD_METRIC_COUNT = RAMD_METRIC_HTTP_DURATION_BUCKET + RAMD_METRICS_HTTP_BUCKET_COUNT + 1
+} ramd_metric_counter_t;
+
+/* One shard, padded to whole cache lines so writers never share a line */
+typedef struct ramd_metrics_shard_t
+{
+	_Alignas(RAMD_CACHE_LINE_SIZE) _Atomic int64_t values[RAMD_METRIC_COUNT];
+} ramd_metrics_shard_t;
+
 /* Metrics collection context */
 typedef struct ramd_metrics_t
 {
@@ -34,27 +71,24 @@ typedef struct ramd_metrics_t
 	ramd_node_state_t node_state;
 	ramd_role_t node_role;
 	bool node_is_healthy;
-	time_t node_last_seen;
+	int64_t node_last_seen_ms; /* ramd_clock_now_ms() */
 	float node_health_score;
 	int64_t node_wal_lsn;
 	int32_t node_replication_lag_ms;
 	
-	/* Performance metrics */
-	int64_t total_health_checks;
-	int64_t failed_health_checks;
-	int64_t total_failovers;
-	int64_t total_promotions;
-	int64_t total_demotions;
+	/* Performance metrics; the counts live in shards */
 	time_t last_failover_time;
 	time_t last_promotion_time;
 	time_t last_demotion_time;
-	
-	/* HTTP API metrics */
-	int64_t http_requests_total;
-	int64_t http_requests_2xx;
-	int64_t http_requests_4xx;
-	int64_t http_requests_5xx;
-	int64_t http_request_duration_ms;
+	_Atomic int64_t last_promotion_duration_us;
+	_Atomic int64_t last_switchover_phase_ms[RAMD_SWITCHOVER_PHASE_COUNT];
+
+	/* The current or most recent connection drain; node 0 until one runs */
+	_Atomic int32_t drain_node_id;
+	_Atomic int32_t drain_phase;
+	_Atomic int64_t drain_sessions_initial;
+	_Atomic int64_t drain_sessions_remaining;
+	_Atomic int64_t drain_sessions_terminated;
 	
 	/* Replication metrics */
 	int32_t replication_lag_max_ms;
@@ -68,11 +102,16 @@ typedef struct ramd_metrics_t
 	int32_t disk_usage_percent;
 	
 	/* Timestamps */
-	time_t daemon_start_time;
+	int64_t daemon_start_ms; /* ramd_clock_now_ms(), for the uptime */
 	time_t last_metrics_update;
+
+	/* Sharded event counters and HTTP latency histogram */
+	ramd_metrics_shard_t shards[RAMD_METRICS_SHARD_COUNT];
 } ramd_metrics_t;
 
 /* Metrics collection functions */
+ramd_metrics_t* ramd_metrics_create(void);
+void ramd_metrics_destroy(ramd_metrics_t* metrics);
 bool ramd_metrics_init(ramd_metrics_t* metrics);
 void ramd_metrics_cleanup(ramd_metrics_t* metrics);
 bool ramd_metrics_collect(ramd_metrics_t* metrics, const ramd_cluster_t* cluster);
@@ -80,6 +119,10 @@ bool ramd_metrics_update_node(ramd_metrics_t* metrics, const ramd_node_t* node);
 bool ramd_metrics_update_cluster(ramd_metrics_t* metrics, const ramd_cluster_t* cluster);
 
 /* Prometheus format output */
+bool ramd_metrics_render_prometheus(const ramd_metrics_t* metrics,
+                                    ramd_buffer_t* output);
+bool ramd_metrics_render_http_latency(const ramd_metrics_t* metrics,
+                                      ramd_buffer_t* output);
 char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics);
 void ramd_metrics_free_prometheus_output(char* output);
 
@@ -88,7 +131,18 @@ void ramd_metrics_increment_health_checks(ramd_metrics_t* metrics, bool success)
 void ramd_metrics_increment_failovers(ramd_metrics_t* metrics);
 void ramd_metrics_increment_promotions(ramd_metrics_t* metrics);
 void ramd_metrics_increment_demotions(ramd_metrics_t* metrics);
+void ramd_metrics_observe_promotion(ramd_metrics_t* metrics, int64_t duration_us, bool via_sql);
+void ramd_metrics_observe_switchover(ramd_metrics_t* metrics,
+                                     const int64_t phase_ms[RAMD_SWITCHOVER_PHASE_COUNT],
+                                     bool succeeded);
+void ramd_metrics_observe_drain(ramd_metrics_t* metrics, int32_t node_id,
+                                ramd_maintenance_drain_phase_t phase, int64_t initial,
+                                int64_t remaining, int64_t terminated);
 void ramd_metrics_update_http_request(ramd_metrics_t* metrics, int status_code, int duration_ms);
+void ramd_metrics_http_request_started(ramd_metrics_t* metrics);
+void ramd_metrics_http_request_finished(ramd_metrics_t* metrics, int status_code, int64_t duration_us);
+int64_t ramd_metrics_counter_total(const ramd_metrics_t* metrics, ramd_metric_counter_t counter);
+void ramd_metrics_sum_counters(const ramd_metrics_t* metrics, int64_t totals[RAMD_METRIC_COUNT]);
 void ramd_metrics_update_replication_lag(ramd_metrics_t* metrics, int32_t lag_ms);
 void ramd_metrics_update_resource_usage(ramd_metrics_t* metrics, size_t memory_bytes, int32_t cpu_percent, int32_t disk_percent);
 
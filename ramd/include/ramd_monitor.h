@@ -14,9 +14,52 @@
 #include <pthread.h>
 
 #include "ramd.h"
+#include "ramd_buffer.h"
 #include "ramd_config.h"
 #include "ramd_cluster.h"
 #include "ramd_postgresql.h"
+#include "ramd_probe.h"
+
+/* Steps of a monitor cycle, timed separately */
+typedef enum
+{
+	RAMD_MONITOR_STEP_CONSENSUS = 0, /* pgraft snapshot refresh */
+	RAMD_MONITOR_STEP_LOCAL,
+	RAMD_MONITOR_STEP_REMOTE,
+	RAMD_MONITOR_STEP_LEADERSHIP,
+	RAMD_MONITOR_STEP_ROLE_CHANGES,
+	RAMD_MONITOR_STEP_PUBLISH,       /* snapshot, watchers and idle sessions */
+	RAMD_MONITOR_STEP_COUNT
+} ramd_monitor_step_t;
+
+/* Cycle timing; histograms hold per-bucket counts, the last one +Inf */
+typedef struct ramd_monitor_stats_t
+{
+	int64_t step_buckets[RAMD_MONITOR_STEP_COUNT][RAMD_MONITOR_CYCLE_BUCKET_COUNT + 1];
+	int64_t step_sum_us[RAMD_MONITOR_STEP_COUNT];
+	int64_t cycle_buckets[RAMD_MONITOR_CYCLE_BUCKET_COUNT + 1];
+	int64_t cycle_sum_us;
+	int64_t last_cycle_us;
+	int64_t overruns;       /* cycles that took longer than the interval */
+	int64_t missed_cycles;  /* start times skipped to get back on schedule */
+	int64_t last_start_lag_us; /* how late the last cycle started */
+	int64_t woken_cycles;   /* started early by ramd_monitor_wake */
+} ramd_monitor_stats_t;
+
+/*
+ * The local node's health as of the last monitor cycle.  It is updated
+ * from each local status sample, so reading it never touches PostgreSQL.
+ */
+typedef struct ramd_monitor_health_t
+{
+	float score;              /* RAMD_MIN_HEALTH_SCORE..RAMD_MAX_HEALTH_SCORE */
+	bool fresh;               /* last sample succeeded within RAMD_HEALTH_STALE_CYCLES */
+	int64_t sample_age_ms;    /* since the last good sample, -1 if none yet */
+	int32_t consecutive_failures;
+	int32_t host_load;        /* ramd_sysmon_load at the sample, -1 if unknown */
+	float replication_lag_seconds;
+	int32_t long_running_queries;
+} ramd_monitor_health_t;
 
 /* Monitor context */
 typedef struct ramd_monitor_t
@@ -24,12 +67,26 @@ typedef struct ramd_monitor_t
 	bool enabled;
 	bool running;
 	pthread_t thread;
-	time_t last_check;
+	int64_t last_check_ms; /* ramd_clock_now_ms() */
 	int32_t check_interval_ms;
 	int32_t health_check_timeout_ms;
 	ramd_cluster_t* cluster;
 	const ramd_config_t* config;
+	pthread_mutex_t local_lock; /* serialises use of local_connection */
 	ramd_postgresql_connection_t local_connection;
+	bool local_prepared;
+	int32_t local_published_load; /* in the session's application_name; -1: none yet */
+	int64_t local_retry_at_ms;
+	int32_t local_backoff_ms;
+	ramd_postgresql_status_t local_status; /* last local sample */
+	ramd_monitor_health_t health;          /* under stats_lock */
+	int64_t health_sampled_at_ms;          /* CLOCK_MONOTONIC of the last good sample */
+	ramd_probe_engine_t probes;
+	pthread_mutex_t stats_lock;
+	ramd_monitor_stats_t stats;
+	pthread_mutex_t wake_lock;
+	pthread_cond_t wake_cond; /* on CLOCK_MONOTONIC, like the schedule */
+	bool wake_requested;
 } ramd_monitor_t;
 
 /* Monitoring functions */
@@ -44,11 +101,20 @@ bool ramd_monitor_is_running(const ramd_monitor_t* monitor);
 void* ramd_monitor_thread_main(void* arg);
 void ramd_monitor_run_cycle(ramd_monitor_t* monitor);
 
+/* Run the next cycle now rather than at its scheduled start */
+void ramd_monitor_wake(ramd_monitor_t* monitor);
+
+/* Cycle and step duration histograms and overrun counters */
+bool ramd_monitor_render_prometheus(ramd_monitor_t* monitor, ramd_buffer_t* output);
+
 /* Health checking */
 bool ramd_monitor_check_local_node(ramd_monitor_t* monitor);
 bool ramd_monitor_check_remote_nodes(ramd_monitor_t* monitor);
 bool ramd_monitor_check_cluster_health(ramd_monitor_t* monitor);
 
+/* Promote the local node over the monitor's session; pg_ctl is the fallback */
+bool ramd_monitor_promote_local(ramd_monitor_t* monitor);
+
 /* Leadership monitoring */
 bool ramd_monitor_check_leadership(ramd_monitor_t* monitor);
 bool ramd_monitor_detect_leadership_change(ramd_monitor_t* monitor);
@@ -74,6 +140,7 @@ bool ramd_monitor_broadcast_state_change(ramd_monitor_t* monitor,
                                          ramd_node_state_t new_state);
 
 /* Health score calculation */
+void ramd_monitor_get_health(ramd_monitor_t* monitor, ramd_monitor_health_t* health);
 float ramd_monitor_calculate_node_health(ramd_monitor_t* monitor,
                                          ramd_node_t* node);
 bool ramd_monitor_is_node_healthy(const ramd_monitor_t* monitor,
@@ -19,6 +19,9 @@
 extern "C" {
 #endif
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "libpq-fe.h"
 
 /* Return codes for pgraft functions */
@@ -27,6 +30,92 @@ extern "C" {
 #define RAMD_PGRAFT_NOT_INITIALIZED -2
 #define RAMD_PGRAFT_NOT_LEADER -3
 
+/* pgraft tracks at most this many members */
+#define RAMD_PGRAFT_MAX_NODES 64
+
+/* One member in a cluster snapshot; progress is only known on the leader */
+typedef struct ramd_pgraft_node_progress_t
+{
+	int node_id;
+	char address[256];
+	int port;
+	int is_leader;
+	long long match_index; /* -1 if unknown */
+	long long next_index;  /* -1 if unknown */
+	char progress[16];     /* "probe", "replicate", "snapshot" or "" */
+	int voting;            /* 0 for a Raft learner */
+} ramd_pgraft_node_progress_t;
+
+/* Everything pgraft_get_cluster_snapshot() reports, from one shared memory copy */
+typedef struct ramd_pgraft_snapshot_t
+{
+	long long leader_id;
+	long long term;
+	long long commit_index;
+	long long last_applied;
+	long long last_index;
+	char state[32];
+	int local_node_id;
+	int is_leader;
+	int published; /* 0 until the pgraft worker has published a status */
+	int node_count;
+	ramd_pgraft_node_progress_t nodes[RAMD_PGRAFT_MAX_NODES];
+} ramd_pgraft_snapshot_t;
+
+/*
+ * Raft internals the pgraft Go library publishes once a second into
+ * $PGDATA/pgraft/metrics.  Mirrors pgraft_go_metrics_t in pgraft's
+ * include/pgraft_go.h, field for field; the version check rejects a file
+ * written with another layout.
+ */
+#define RAMD_PGRAFT_METRICS_FILE "pgraft/metrics"
+#define RAMD_PGRAFT_METRICS_MAGIC 0x50475246
+#define RAMD_PGRAFT_METRICS_VERSION 2
+#define RAMD_PGRAFT_METRICS_MSG_TYPES 32
+#define RAMD_PGRAFT_METRICS_BUCKETS 16
+
+typedef struct ramd_pgraft_metrics_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t seq;
+	int64_t node_id;
+	int64_t updated_at_ns; /* Unix time of the last publish */
+	int64_t raft_state;
+	int64_t last_index;
+	int64_t commit_index;
+	int64_t applied_index;
+	int64_t msg_sent[RAMD_PGRAFT_METRICS_MSG_TYPES]; /* by raftpb.MessageType */
+	int64_t msg_received[RAMD_PGRAFT_METRICS_MSG_TYPES];
+	int64_t ready_count;
+	int64_t ready_entries_sum;
+	int64_t ready_messages_sum;
+	int64_t ready_committed_sum;
+	int64_t ready_entries[RAMD_PGRAFT_METRICS_BUCKETS]; /* bucket i: up to 1 << i */
+	int64_t append_latency_sum_us;
+	int64_t append_latency[RAMD_PGRAFT_METRICS_BUCKETS]; /* bucket i: up to 16 << i us */
+	int64_t fsync_latency_sum_us;
+	int64_t fsync_latency[RAMD_PGRAFT_METRICS_BUCKETS];
+	int64_t proposal_queue_depth;
+	int64_t proposal_queue_capacity;
+	int64_t num_peers;
+	int64_t peer_id[RAMD_PGRAFT_MAX_NODES];
+	int64_t peer_match[RAMD_PGRAFT_MAX_NODES]; /* -1 unless leader */
+	int64_t peer_next[RAMD_PGRAFT_MAX_NODES];
+	int64_t peer_state[RAMD_PGRAFT_MAX_NODES];
+	int64_t peer_heartbeat_rtt_us[RAMD_PGRAFT_MAX_NODES]; /* -1 until measured */
+	int64_t peer_append_rtt_us[RAMD_PGRAFT_MAX_NODES];
+	int64_t compress_frames;       /* batches and snapshot chunks sent compressed */
+	int64_t compress_skipped;      /* did not shrink enough, sent raw */
+	int64_t compress_raw_bytes;
+	int64_t compress_wire_bytes;   /* headers included */
+	int64_t compress_cpu_us;
+	int64_t decompress_frames;
+	int64_t decompress_raw_bytes;
+	int64_t decompress_wire_bytes;
+	int64_t decompress_cpu_us;
+} ramd_pgraft_metrics_t;
+
 /* Core pgraft functions used by ramd */
 
 /*
@@ -78,13 +167,37 @@ extern long long ramd_pgraft_get_term(PGconn* conn);
  */
 extern char* ramd_pgraft_get_nodes(PGconn* conn);
 
+/*
+ * Fetch leader, term, indexes, membership and progress in one roundtrip
+ * Returns: RAMD_PGRAFT_SUCCESS on success, error code on failure
+ */
+extern int ramd_pgraft_get_cluster_snapshot(PGconn* conn, ramd_pgraft_snapshot_t* snapshot);
+
+/*
+ * Copy the metrics the local pgraft worker publishes under data_dir,
+ * without a database connection.  Returns false if the file is missing,
+ * from another layout, or was not caught between two publishes.
+ */
+extern bool ramd_pgraft_read_metrics(const char* data_dir, ramd_pgraft_metrics_t* out);
+
 /* Cluster management functions */
 
 /*
- * Add a node to the Raft cluster
+ * Add a node to the Raft cluster, as a learner when voting is 0: it
+ * follows the log without voting or counting toward commit
+ * Returns: RAMD_PGRAFT_SUCCESS on success, error code on failure
+ */
+extern int ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port,
+                                int voting);
+
+/*
+ * Add count nodes in one membership change, so Raft goes through a single
+ * joint-consensus step however many join; voting as above, for all of them
  * Returns: RAMD_PGRAFT_SUCCESS on success, error code on failure
  */
-extern int ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port);
+extern int ramd_pgraft_add_nodes(PGconn* conn, const int* node_ids,
+                                 const char* const* hostnames, const int* ports,
+                                 int count, int voting);
 
 /*
  * Remove a node from the Raft cluster
@@ -92,6 +205,80 @@ extern int ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname,
  */
 extern int ramd_pgraft_remove_node(PGconn* conn, int node_id);
 
+/*
+ * Move Raft leadership to node_id and wait up to timeout_ms for it to win
+ * Returns: RAMD_PGRAFT_SUCCESS once node_id leads, error code otherwise
+ */
+extern int ramd_pgraft_transfer_leadership(PGconn* conn, int node_id, int timeout_ms);
+
+/*
+ * Confirm through a quorum that this node still reaches the current leader
+ * Returns: RAMD_PGRAFT_SUCCESS if confirmed within timeout_ms
+ */
+extern int ramd_pgraft_read_barrier(PGconn* conn, int timeout_ms);
+
+/*
+ * Block up to timeout_ms for the Raft leader or term to differ from the
+ * known ones (-1 for unknown); *leader and *term get the current values
+ * and *changed says whether they moved before the timeout
+ * Returns: RAMD_PGRAFT_SUCCESS on success, error code on failure
+ */
+extern int ramd_pgraft_wait_leader_change(PGconn* conn, long long known_leader,
+                                          long long known_term, int timeout_ms,
+                                          long long* leader, long long* term,
+                                          bool* changed);
+
+/* A key-value entry from pgraft_kv_get(), or a change from pgraft_kv_watch() */
+typedef struct ramd_pgraft_kv_event_t
+{
+	long long revision;        /* of the change; mod_revision for a read */
+	bool deleted;
+	const char* key;
+	const char* value;         /* "" for a delete */
+	long long lease;
+} ramd_pgraft_kv_event_t;
+
+typedef void (*ramd_pgraft_kv_event_fn)(const ramd_pgraft_kv_event_t* event, void* arg);
+
+/*
+ * Set key in pgraft's key-value store, only if its mod_revision is
+ * expected_revision (0: only if absent; -1: unconditionally), under lease
+ * (0: none).  *revision gets the write's revision, 0 if the compare failed
+ * Returns: RAMD_PGRAFT_SUCCESS on success, error code on failure
+ */
+extern int ramd_pgraft_kv_put(PGconn* conn, const char* key, const char* value,
+                              long long expected_revision, long long lease,
+                              long long* revision);
+
+/* Delete key, or with prefix every key under it; *revision 0 if none was */
+extern int ramd_pgraft_kv_delete(PGconn* conn, const char* key, bool prefix,
+                                 long long* revision);
+
+extern int ramd_pgraft_kv_lease_grant(PGconn* conn, int ttl_ms, long long* lease);
+
+/* *alive is false once the lease has expired */
+extern int ramd_pgraft_kv_lease_keepalive(PGconn* conn, long long lease, bool* alive);
+
+/* Drop the lease and the keys on it */
+extern int ramd_pgraft_kv_lease_revoke(PGconn* conn, long long lease);
+
+/*
+ * The store revision, then every entry under prefix through fn; watching
+ * from *revision afterwards misses nothing
+ */
+extern int ramd_pgraft_kv_get_prefix(PGconn* conn, const char* prefix, long long* revision,
+                                     ramd_pgraft_kv_event_fn fn, void* arg);
+
+/*
+ * Block up to timeout_ms for changes under prefix after *revision and pass
+ * them to fn in order; *revision advances to the last one.  *compacted is
+ * set, and nothing is passed, when the changes are no longer kept and the
+ * caller must read the prefix again
+ */
+extern int ramd_pgraft_kv_watch(PGconn* conn, const char* prefix, long long* revision,
+                                int timeout_ms, ramd_pgraft_kv_event_fn fn, void* arg,
+                                bool* compacted);
+
 /*
  * Get cluster health information
  * Returns: JSON string with health information, or NULL on error
@@ -25,10 +25,16 @@ typedef struct ramd_postgresql_connection_t
 	char password[RAMD_MAX_HOSTNAME_LENGTH];
 	void* connection; /* PGconn * */
 	bool is_connected;
-	time_t last_activity;
+	bool status_prepared; /* status statement prepared on this session */
+	int64_t last_activity_ms; /* ramd_clock_now_ms() */
 } ramd_postgresql_connection_t;
 
-/* PostgreSQL status information */
+/*
+ * PostgreSQL status information, filled from one status query.
+ *
+ * current_wal_lsn is the insert position on a primary and the furthest of
+ * received/replayed on a standby, so it orders failover candidates.
+ */
 typedef struct ramd_postgresql_status_t
 {
 	bool is_running;
@@ -38,13 +44,57 @@ typedef struct ramd_postgresql_status_t
 	int64_t current_wal_lsn;
 	int64_t received_wal_lsn;
 	int64_t replayed_wal_lsn;
+	int32_t timeline_id;
 	int32_t active_connections;
+	int32_t client_connections;
 	int32_t max_connections;
+	int32_t long_running_queries;
+	int32_t autovacuum_workers;
 	time_t postmaster_start_time;
 	float replication_lag_seconds;
-	time_t last_check;
+	int32_t host_load; /* the node's ramd_sysmon_load, -1 if it publishes none */
+	int64_t last_check_ms; /* ramd_clock_now_ms() */
 } ramd_postgresql_status_t;
 
+/*
+ * The local ramd's monitor session names itself after the host's load, so
+ * whoever runs the status query learns it with no extra roundtrip.
+ */
+#define RAMD_POSTGRESQL_LOAD_PREFIX "ramd_load="
+
+/* Whether the local server is up, from postmaster.pid and a PQping */
+typedef enum
+{
+	RAMD_POSTGRESQL_DOWN = 0,        /* no live postmaster for the data directory */
+	RAMD_POSTGRESQL_NOT_ACCEPTING,   /* postmaster alive, connections not (yet) taken */
+	RAMD_POSTGRESQL_ACCEPTING
+} ramd_postgresql_liveness_t;
+
+/* Status query shared by every health check; one row, one roundtrip */
+#define RAMD_POSTGRESQL_STATUS_STMT "ramd_status"
+#define RAMD_POSTGRESQL_STATUS_SQL \
+	"SELECT r.rec, " \
+	"CASE WHEN r.rec THEN NULL ELSE (pg_current_wal_lsn() - '0/0')::bigint END, " \
+	"(pg_last_wal_receive_lsn() - '0/0')::bigint, " \
+	"(pg_last_wal_replay_lsn() - '0/0')::bigint, " \
+	"CASE WHEN r.rec THEN COALESCE(EXTRACT(EPOCH FROM now() - " \
+	"pg_last_xact_replay_timestamp()), 0) ELSE 0 END::float8, " \
+	"CASE WHEN r.rec THEN COALESCE((SELECT received_tli FROM pg_stat_wal_receiver), 0) " \
+	"ELSE ('x' || substr(pg_walfile_name(pg_current_wal_lsn()), 1, 8))::bit(32)::int END, " \
+	"a.active, a.client, a.long_running, a.autovacuum, " \
+	"current_setting('max_connections')::int, " \
+	"EXTRACT(EPOCH FROM pg_postmaster_start_time())::bigint, " \
+	"a.host_load " \
+	"FROM (SELECT pg_is_in_recovery() AS rec) r, " \
+	"(SELECT count(*) FILTER (WHERE state = 'active') AS active, " \
+	"count(*) FILTER (WHERE backend_type = 'client backend') AS client, " \
+	"count(*) FILTER (WHERE state = 'active' AND " \
+	"query_start < now() - interval '1 hour') AS long_running, " \
+	"count(*) FILTER (WHERE backend_type = 'autovacuum worker') AS autovacuum, " \
+	"max(substring(application_name FROM '^" RAMD_POSTGRESQL_LOAD_PREFIX "([0-9]{1,3})$')::int) " \
+	"AS host_load " \
+	"FROM pg_stat_activity) a"
+
 /* PostgreSQL connection management */
 bool ramd_postgresql_connect(ramd_postgresql_connection_t* conn,
                              const char* host, int32_t port,
@@ -57,7 +107,11 @@ bool ramd_postgresql_reconnect(ramd_postgresql_connection_t* conn);
 /* PostgreSQL status queries */
 bool ramd_postgresql_get_status(ramd_postgresql_connection_t* conn,
                                 ramd_postgresql_status_t* status);
+bool ramd_postgresql_parse_status(const PGresult* res,
+                                  ramd_postgresql_status_t* status);
+float ramd_postgresql_score_status(const ramd_postgresql_status_t* status);
 bool ramd_postgresql_is_running(const ramd_config_t* config);
+ramd_postgresql_liveness_t ramd_postgresql_check_liveness(const ramd_config_t* config);
 bool ramd_postgresql_is_primary(ramd_postgresql_connection_t* conn);
 bool ramd_postgresql_is_standby(ramd_postgresql_connection_t* conn);
 bool ramd_postgresql_accepts_connections(ramd_postgresql_connection_t* conn);
@@ -70,6 +124,16 @@ bool ramd_postgresql_reload(const ramd_config_t* config);
 
 /* PostgreSQL promotion and demotion */
 bool ramd_postgresql_promote(const ramd_config_t* config);
+
+/*
+ * Promote with pg_promote(true, wait_seconds) over an open session; true
+ * once the server has left recovery.  *sql_available is cleared when the
+ * server or role cannot promote over SQL and pg_ctl should be used.
+ */
+bool ramd_postgresql_promote_sql(PGconn* conn, int32_t wait_seconds, bool* sql_available);
+
+/* Promote the local server over conn if given, else or on fallback with pg_ctl */
+bool ramd_postgresql_promote_local(const ramd_config_t* config, PGconn* conn);
 bool ramd_postgresql_demote_to_standby(const ramd_config_t* config,
                                        const char* primary_host,
                                        int32_t primary_port);
@@ -83,6 +147,21 @@ bool ramd_postgresql_create_recovery_conf(const ramd_config_t* config,
                                           int32_t primary_port);
 bool ramd_postgresql_remove_recovery_conf(const ramd_config_t* config);
 
+/* ALTER SYSTEM SET name = value on conn, value quoted as a literal; no reload */
+bool ramd_postgresql_alter_system(PGconn* conn, const char* name, const char* value);
+
+/*
+ * Point the standby behind conn at primary_host:primary_port with ALTER
+ * SYSTEM, as application_name ramd_node_<standby_node_id>; a non-empty
+ * slot_name also sets primary_slot_name.  From PostgreSQL 13 both settings
+ * are reloaded and the walreceiver reconnects with warm buffers; on 12
+ * *needs_restart is set.  Servers before 12 use recovery.conf and fail.
+ */
+bool ramd_postgresql_repoint_standby(PGconn* conn, const ramd_config_t* config,
+                                     const char* primary_host, int32_t primary_port,
+                                     int32_t standby_node_id, const char* slot_name,
+                                     bool* needs_restart);
+
 /* PostgreSQL basebackup operations */
 bool ramd_postgresql_create_basebackup(const ramd_config_t* config,
                                        const char* primary_host,
@@ -100,6 +179,7 @@ bool ramd_postgresql_configure_synchronous_replication(
 bool ramd_postgresql_health_check(ramd_postgresql_connection_t* conn,
                                   float* health_score);
 bool ramd_postgresql_check_connectivity(const ramd_config_t* config);
+float ramd_postgresql_get_health_score(const ramd_config_t* config);
 bool ramd_postgresql_check_replication_lag(ramd_postgresql_connection_t* conn,
                                            float* lag_seconds);
 
@@ -0,0 +1,65 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_prewarm.h
+ *		PostgreSQL Auto-Failover Daemon - Switchover Buffer Prewarm
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_PREWARM_H
+#define RAMD_PREWARM_H
+
+#include <libpq-fe.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+typedef enum
+{
+	RAMD_PREWARM_IDLE = 0,
+	RAMD_PREWARM_RUNNING,
+	RAMD_PREWARM_SUCCEEDED,
+	RAMD_PREWARM_FAILED,   /* nothing could be loaded, see message */
+	RAMD_PREWARM_CANCELLED /* stopped, or switchover_prewarm_timeout_ms ran out */
+} ramd_prewarm_state_t;
+
+typedef struct ramd_prewarm_status_t
+{
+	ramd_prewarm_state_t state;
+	int32_t target_node_id;
+	int32_t workers;
+	int64_t blocks_total;      /* in the old primary's block list */
+	int64_t blocks_done;       /* handed to pg_prewarm, or skipped */
+	int64_t blocks_loaded;     /* what pg_prewarm reported reading */
+	int32_t databases_skipped; /* unreachable, or without the pg_prewarm extension */
+	int64_t duration_ms;       /* so far while running */
+	char message[RAMD_MAX_COMMAND_LENGTH];
+} ramd_prewarm_status_t;
+
+/*
+ * Dump the buffer list of the local primary behind primary with
+ * autoprewarm_dump_now(), read it back from config's data directory and
+ * load the same blocks into the shared buffers of target with
+ * switchover_prewarm_workers parallel pg_prewarm() sessions, on a
+ * background thread.  A job still running from before is cancelled.
+ * False if the list could not be taken; the switchover goes on cold.
+ */
+bool ramd_prewarm_start(const ramd_config_t* config, PGconn* primary,
+                        const ramd_node_t* target);
+
+/* Stop the running job after the ranges in flight */
+void ramd_prewarm_cancel(void);
+
+/* Wait for the current job; returns true if it succeeded */
+bool ramd_prewarm_wait(void);
+
+/* Cancel and wait; for daemon shutdown */
+void ramd_prewarm_cleanup(void);
+
+void ramd_prewarm_get_status(ramd_prewarm_status_t* status);
+const char* ramd_prewarm_state_to_string(ramd_prewarm_state_t state);
+
+#endif /* RAMD_PREWARM_H */
@@ -0,0 +1,88 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_probe.h
+ *		PostgreSQL Auto-Failover Daemon - Concurrent Health Probes
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_PROBE_H
+#define RAMD_PROBE_H
+
+#include <pthread.h>
+#include <libpq-fe.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+#include "ramd_postgresql.h"
+
+/* Connection state of one probe target */
+typedef enum
+{
+	RAMD_PROBE_DISCONNECTED = 0,
+	RAMD_PROBE_CONNECTING,
+	RAMD_PROBE_IDLE,
+	RAMD_PROBE_QUERYING,
+	RAMD_PROBE_DONE,
+	RAMD_PROBE_FAILED
+} ramd_probe_state_t;
+
+/* One remote node; the connection is kept open across cycles */
+typedef struct ramd_probe_target_t
+{
+	int32_t node_id;
+	char host[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+	PGconn* conn;
+	ramd_probe_state_t state;
+	PostgresPollingStatusType poll_status;
+
+	/* In-flight result, owned by the probing thread */
+	bool pending_ok;
+	ramd_postgresql_status_t pending;
+
+	/* Result of the last completed cycle, published under the engine lock */
+	bool healthy;
+	bool in_recovery;
+	ramd_postgresql_status_t status;
+	int64_t sampled_at_us; /* CLOCK_MONOTONIC time of the last good sample */
+	int64_t rtt_us;
+	int32_t consecutive_failures;
+	char error[RAMD_MAX_COMMAND_LENGTH];
+} ramd_probe_target_t;
+
+/* Probe engine: all targets are checked concurrently on one poll loop */
+typedef struct ramd_probe_engine_t
+{
+	ramd_probe_target_t targets[RAMD_MAX_NODES];
+	int32_t target_count;
+	const ramd_config_t* config;
+	pthread_mutex_t lock; /* guards membership and published results */
+} ramd_probe_engine_t;
+
+/* Probe engine lifecycle */
+bool ramd_probe_init(ramd_probe_engine_t* engine, const ramd_config_t* config);
+void ramd_probe_cleanup(ramd_probe_engine_t* engine);
+
+/* Probe every node except skip_node_id within deadline_ms; returns healthy count */
+int32_t ramd_probe_run(ramd_probe_engine_t* engine, const ramd_cluster_t* cluster,
+                       int32_t skip_node_id, int32_t deadline_ms);
+
+/* As above, but return as soon as min_answers nodes have answered */
+int32_t ramd_probe_run_quorum(ramd_probe_engine_t* engine,
+                              const ramd_cluster_t* cluster,
+                              int32_t skip_node_id, int32_t deadline_ms,
+                              int32_t min_answers);
+
+/* Result lookup; only safe from the thread that runs the probes */
+const ramd_probe_target_t* ramd_probe_find(const ramd_probe_engine_t* engine,
+                                           int32_t node_id);
+
+/* Copy a node's last good sample if it is at most max_age_ms old; thread-safe */
+bool ramd_probe_get_sample(ramd_probe_engine_t* engine, int32_t node_id,
+                           int32_t max_age_ms, ramd_postgresql_status_t* status);
+
+#endif /* RAMD_PROBE_H */
@@ -0,0 +1,117 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_process.h
+ *		PostgreSQL Auto-Failover Daemon - External Process Runner
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_PROCESS_H
+#define RAMD_PROCESS_H
+
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#include "ramd.h"
+#include "ramd_defaults.h"
+
+/* Outcome of one command; out and err keep the last RAMD_PROCESS_OUTPUT_MAX bytes */
+typedef struct ramd_process_result_t
+{
+	bool spawned;
+	bool timed_out;
+	bool cancelled;
+	int32_t exit_code;   /* -1 unless the process exited normally */
+	int32_t term_signal; /* signal that ended the process, 0 if none */
+	int64_t duration_us;
+	char out[RAMD_PROCESS_OUTPUT_MAX];
+	char err[RAMD_PROCESS_OUTPUT_MAX];
+	size_t out_length;
+	size_t err_length;
+	bool output_truncated;
+} ramd_process_result_t;
+
+/*
+ * Scheduling for a command that should stay out of the database's way.
+ * nice is added to the daemon's own value; io_class is one of the
+ * RAMD_PROCESS_IOPRIO_CLASS_* values, 0 leaving I/O priority alone.
+ */
+typedef struct ramd_process_priority_t
+{
+	int32_t nice;
+	int32_t io_class;
+	int32_t io_level; /* 0 (highest) to 7 within the best-effort class */
+} ramd_process_priority_t;
+
+#define RAMD_PROCESS_IOPRIO_CLASS_NONE 0
+#define RAMD_PROCESS_IOPRIO_CLASS_BE   2
+#define RAMD_PROCESS_IOPRIO_CLASS_IDLE 3
+
+/*
+ * Called with each line of output while the command runs, on the thread
+ * running it.  line is NUL terminated without its newline; a carriage
+ * return also ends a line, as progress meters use it to redraw in place.
+ * Lines longer than RAMD_PROCESS_LINE_MAX are passed on in pieces.
+ */
+typedef void (*ramd_process_line_fn)(bool is_stderr, const char* line, void* arg);
+
+/* Completion callback for asynchronous commands, run on the runner thread */
+typedef void (*ramd_process_done_fn)(const ramd_process_result_t* result, void* arg);
+
+/*
+ * Run argv (NULL terminated, argv[0] looked up in PATH) without a shell and
+ * wait for it.  The command gets its own process group; past timeout_ms
+ * (0 waits forever) the group is sent SIGTERM and, after a grace period,
+ * SIGKILL.  Returns true only when the command exited with status 0.
+ * result may be NULL.
+ */
+bool ramd_process_run(const char* const argv[], int32_t timeout_ms,
+                      ramd_process_result_t* result);
+
+/* As above; setting *cancel stops the command the same way a timeout does */
+bool ramd_process_run_cancellable(const char* const argv[], int32_t timeout_ms,
+                                  const atomic_bool* cancel,
+                                  ramd_process_result_t* result);
+
+/*
+ * As above, with the command's process group lowered to *priority as soon
+ * as it is started; whatever it forks inherits the lower priority.  Where
+ * I/O priorities are not supported only nice is applied.
+ */
+bool ramd_process_run_with_priority(const char* const argv[], int32_t timeout_ms,
+                                    const atomic_bool* cancel,
+                                    const ramd_process_priority_t* priority,
+                                    ramd_process_result_t* result);
+
+/* As above, also handing every line of stdout and stderr to on_line */
+bool ramd_process_run_streaming(const char* const argv[], int32_t timeout_ms,
+                                const atomic_bool* cancel,
+                                const ramd_process_priority_t* priority,
+                                ramd_process_line_fn on_line, void* line_arg,
+                                ramd_process_result_t* result);
+
+/* As above on a detached thread; done (may be NULL) receives the result */
+bool ramd_process_run_async(const char* const argv[], int32_t timeout_ms,
+                            ramd_process_done_fn done, void* arg);
+
+/*
+ * Give the calling thread the priority a child would get, for work ramd
+ * does itself in the background.  Linux applies both per thread; where
+ * it cannot, this does nothing.
+ */
+void ramd_process_lower_thread_priority(const ramd_process_priority_t* priority);
+
+/* Log a failed command with its exit status and last line of stderr */
+void ramd_process_log_failure(const char* what, const ramd_process_result_t* result);
+
+/* Resolve a program name against PATH */
+bool ramd_process_find_program(const char* name, char* path, size_t path_size);
+
+/* Native replacements for mkdir -p, rm -rf and emptying a directory */
+bool ramd_process_make_directory(const char* path, mode_t mode);
+bool ramd_process_remove_tree(const char* path);
+bool ramd_process_clear_directory(const char* path);
+
+#endif /* RAMD_PROCESS_H */
@@ -0,0 +1,31 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_profiler.h
+ *		PostgreSQL Auto-Failover Daemon - Sampling CPU Profiler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_PROFILER_H
+#define RAMD_PROFILER_H
+
+#include "ramd.h"
+#include "ramd_buffer.h"
+
+/*
+ * Sample the stacks of whichever threads are on CPU, frequency_hz times
+ * per second of process CPU time, for seconds of wall time, and append
+ * them to output in folded form: one "outer;...;leaf count" line per
+ * distinct stack, as flamegraph.pl and speedscope read.  Blocks the caller
+ * for the duration.  Only one profile runs at a time; returns false with
+ * a reason in error when another is running or the timer cannot be set.
+ */
+bool ramd_profiler_collect(int32_t seconds, int32_t frequency_hz, ramd_buffer_t* output,
+                           char* error, size_t error_size);
+
+/* True while a profile is being collected */
+bool ramd_profiler_is_running(void);
+
+#endif /* RAMD_PROFILER_H */
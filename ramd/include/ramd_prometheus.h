@@ -8,15 +8,19 @@
 #ifndef RAMD_PROMETHEUS_H
 #define RAMD_PROMETHEUS_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <libpq-fe.h>
 
+#include "ramd_buffer.h"
+
 /* Prometheus metrics structure */
 typedef struct ramd_prometheus_metrics_t
 {
     /* System metrics */
     time_t timestamp;
-    time_t start_time;
+    int64_t start_ms; /* ramd_clock_now_ms() at init */
     long uptime_seconds;
     long memory_usage_bytes;
     double cpu_usage_percent;
@@ -31,17 +35,43 @@ typedef struct ramd_prometheus_metrics_t
     int raft_healthy;
     int raft_nodes;
     
-    /* HTTP metrics */
-    long http_requests_total;
-    int http_requests_in_flight;
-    double http_request_duration_seconds;
-    
 } ramd_prometheus_metrics_t;
 
+/* Expositions kept pre-rendered by the collector */
+typedef enum
+{
+    RAMD_PROMETHEUS_EXPOSITION_CLUSTER = 0,   /* /metrics */
+    RAMD_PROMETHEUS_EXPOSITION_DAEMON,        /* /prometheus */
+    RAMD_PROMETHEUS_EXPOSITION_COUNT
+} ramd_prometheus_exposition_t;
+
+/*
+ * One rendered exposition.  Scrapes take a reference and write the bytes
+ * straight to the socket; the collector swaps in a new snapshot and the
+ * old one is freed when its last reader releases it.
+ */
+typedef struct ramd_prometheus_snapshot_t
+{
+    int32_t refcount;       /* guarded by the cache lock */
+    char* text;
+    size_t text_length;
+    char* gzip;             /* NULL when compression is off or failed */
+    size_t gzip_length;
+    time_t rendered_at;
+    int64_t rendered_ms;    /* wall clock, the samples' timestamp for remote write */
+} ramd_prometheus_snapshot_t;
+
 /* Function declarations */
 void ramd_prometheus_init(void);
 void ramd_prometheus_update_metrics(PGconn* conn);
+int ramd_prometheus_render(ramd_buffer_t* output);
 int ramd_prometheus_handle_request(const char* request, char* response, size_t response_size);
 void ramd_prometheus_cleanup(void);
 
+/* Background collector refreshing the cached expositions */
+bool ramd_prometheus_start_collector(int32_t interval_ms, bool compress);
+void ramd_prometheus_stop_collector(void);
+ramd_prometheus_snapshot_t* ramd_prometheus_snapshot_acquire(ramd_prometheus_exposition_t which);
+void ramd_prometheus_snapshot_release(ramd_prometheus_snapshot_t* snapshot);
+
 #endif /* RAMD_PROMETHEUS_H */
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_proxy.h
+ *		PostgreSQL Auto-Failover Daemon - Primary-Routing TCP Proxy
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_PROXY_H
+#define RAMD_PROXY_H
+
+#include "ramd.h"
+#include "ramd_buffer.h"
+#include "ramd_config.h"
+
+/*
+ * Listen on proxy_port, and on proxy_read_port unless it is 0, and relay
+ * each client connection to the current primary or the least-lagged
+ * healthy standby.  Does nothing unless proxy_enabled; false if enabled
+ * but a listener could not be set up.
+ */
+bool ramd_proxy_start(const ramd_config_t* config);
+void ramd_proxy_stop(void);
+
+bool ramd_proxy_render_prometheus(ramd_buffer_t* output);
+
+#endif /* RAMD_PROXY_H */
@@ -15,6 +15,8 @@
 #define RAMD_QUERY_H
 
 #include <libpq-fe.h>
+#include <stdbool.h>
+#include <stdint.h>
 
 /* Query result types */
 typedef enum
@@ -25,6 +27,32 @@ typedef enum
 	RAMD_QUERY_CONNECTION_ERROR = -3
 } ramd_query_result_t;
 
+/*
+ * Statements ramd runs every cycle.  Each is prepared once per session,
+ * the first time it is executed there, and then run by name with results
+ * in binary format, so the server neither parses nor plans it again and
+ * no numbers go through text.  A pooled session keeps its statements
+ * across checkouts.
+ */
+typedef enum
+{
+	RAMD_QUERY_STMT_PING = 0,
+	RAMD_QUERY_STMT_IS_IN_RECOVERY,
+	RAMD_QUERY_STMT_VERSION,
+	RAMD_QUERY_STMT_CURRENT_WAL_LSN,
+	RAMD_QUERY_STMT_REPLICATION_LAG,
+	RAMD_QUERY_STMT_OTHER_ACTIVE_BACKENDS,
+	RAMD_QUERY_STMT_ACTIVE_BACKENDS,
+	RAMD_QUERY_STMT_PGRAFT_IS_LEADER,
+	RAMD_QUERY_STMT_PGRAFT_LEADER,
+	RAMD_QUERY_STMT_PGRAFT_TERM,
+	RAMD_QUERY_STMT_PGRAFT_CLUSTER_HEALTHY,
+	RAMD_QUERY_STMT_PGRAFT_SNAPSHOT,
+	RAMD_QUERY_STMT_DRAIN_SESSIONS,
+	RAMD_QUERY_STMT_DRAIN_TERMINATE_IDLE,
+	RAMD_QUERY_STMT_COUNT
+} ramd_query_stmt_t;
+
 /* Initialize query subsystem */
 extern bool ramd_query_init(void);
 
@@ -54,6 +82,41 @@ extern PGresult* ramd_query_exec_params(PGconn* conn, const char* sql,
                                        const int* paramLengths,
                                        const int* paramFormats, int resultFormat);
 
+/*
+ * Execute a registered statement, preparing it on this session first if
+ * needed.  Parameters are passed as text; results come back binary and
+ * are read with the ramd_query_value_* helpers.
+ * Returns PGresult* on success, NULL on error
+ */
+extern PGresult* ramd_query_exec_prepared(PGconn* conn, ramd_query_stmt_t stmt,
+                                          int nParams, const char* const* paramValues);
+
+/*
+ * Execute a registered statement and read the first column of its first row
+ * Returns false on error or when the value is NULL
+ */
+extern bool ramd_query_prepared_bool(PGconn* conn, ramd_query_stmt_t stmt, bool* value);
+extern bool ramd_query_prepared_int64(PGconn* conn, ramd_query_stmt_t stmt, int64_t* value);
+extern bool ramd_query_prepared_double(PGconn* conn, ramd_query_stmt_t stmt, double* value);
+
+/* As above for text; the returned string is owned by the caller */
+extern char* ramd_query_prepared_string(PGconn* conn, ramd_query_stmt_t stmt);
+
+/*
+ * Forget which statements a session has prepared; call before closing it.
+ * Forgetting is only an optimisation, a stale entry is detected and redone.
+ */
+extern void ramd_query_forget_connection(PGconn* conn);
+
+/*
+ * Read a column in either result format, by its type
+ * Return if_null (false, "") for NULL or out of range
+ */
+extern bool ramd_query_value_bool(const PGresult* result, int row, int col);
+extern int64_t ramd_query_value_int64(const PGresult* result, int row, int col, int64_t if_null);
+extern double ramd_query_value_double(const PGresult* result, int row, int col, double if_null);
+extern const char* ramd_query_value_text(const PGresult* result, int row, int col);
+
 /*
  * Check if a query result is successful
  * Returns true if result indicates success, false otherwise
@@ -0,0 +1,82 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_rebuild.h
+ *		PostgreSQL Auto-Failover Daemon - Replica Rebuild Scheduler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_REBUILD_H
+#define RAMD_REBUILD_H
+
+#include <time.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/* Lifecycle of the local rebuild job */
+typedef enum
+{
+	RAMD_REBUILD_IDLE = 0,
+	RAMD_REBUILD_WAITING, /* queued behind other rebuilding standbys */
+	RAMD_REBUILD_RUNNING,
+	RAMD_REBUILD_SUCCEEDED,
+	RAMD_REBUILD_FAILED,
+	RAMD_REBUILD_CANCELLED
+} ramd_rebuild_state_t;
+
+/* How the data directory is being brought back in line with the source */
+typedef enum
+{
+	RAMD_REBUILD_METHOD_NONE = 0,
+	RAMD_REBUILD_METHOD_REWIND,
+	RAMD_REBUILD_METHOD_BASEBACKUP
+} ramd_rebuild_method_t;
+
+/* Snapshot of the local rebuild job, as reported over the HTTP API */
+typedef struct ramd_rebuild_status_t
+{
+	ramd_rebuild_state_t state;
+	ramd_rebuild_method_t method;
+	int32_t node_id;
+	int32_t source_node_id;
+	char source_host[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t source_port;
+	char phase[64];
+	int32_t queue_position;  /* rebuilding standbys ahead of this one */
+	int32_t rate_limit_kbps; /* this node's share of the budget, 0 = unlimited */
+	int64_t bytes_total;     /* server estimate, 0 if unknown */
+	int64_t bytes_done;
+	int64_t bytes_per_second;
+	int64_t eta_seconds;     /* -1 if unknown */
+	time_t started_at;
+	time_t finished_at;
+	char message[RAMD_MAX_COMMAND_LENGTH];
+} ramd_rebuild_status_t;
+
+/* Scheduler lifecycle; init discards any staging directory left by a crash */
+bool ramd_rebuild_init(const ramd_config_t* config);
+void ramd_rebuild_cleanup(void);
+
+/*
+ * Start rebuilding the local data directory from source_node_id on a
+ * background thread.  cluster is consulted while waiting for a slot so that
+ * at most rebuild_max_concurrent standbys copy at once.  Fails if a rebuild
+ * is already queued or running.
+ */
+bool ramd_rebuild_start(ramd_cluster_t* cluster, int32_t source_node_id);
+
+/* Ask the running job to stop; the live data directory is left untouched */
+bool ramd_rebuild_cancel(void);
+
+/* Wait for the current job to finish; returns true if it succeeded */
+bool ramd_rebuild_wait(void);
+
+void ramd_rebuild_get_status(ramd_rebuild_status_t* status);
+const char* ramd_rebuild_state_to_string(ramd_rebuild_state_t state);
+const char* ramd_rebuild_method_to_string(ramd_rebuild_method_t method);
+
+#endif /* RAMD_REBUILD_H */
@@ -0,0 +1,71 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_registry.h
+ *		PostgreSQL Auto-Failover Daemon - Cluster Registry in pgraft
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_REGISTRY_H
+#define RAMD_REGISTRY_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_monitor.h"
+
+typedef struct ramd_registry_status_t
+{
+	bool synced;               /* the prefix has been read and is being watched */
+	long long revision;        /* last store revision seen */
+	long long lease;           /* this daemon's, 0 while it has none */
+	int32_t registered_nodes;  /* daemons whose registration is live */
+	int64_t events;            /* changes received from the watch */
+	int64_t resyncs;           /* full reads after the watch fell behind */
+} ramd_registry_status_t;
+
+/*
+ * Register this daemon under /ramd/<cluster_name>/nodes/<node_id> in
+ * pgraft's key-value store, on a lease kept alive from a thread with its
+ * own session to the local node, and watch the cluster's prefix: a change
+ * made by another daemon wakes the monitor.  Without pgraft's key-value
+ * functions the thread retries quietly.
+ */
+bool ramd_registry_start(ramd_monitor_t* monitor, const ramd_config_t* config);
+void ramd_registry_stop(void);
+
+/*
+ * Publish that node_id entered or left maintenance through this daemon.
+ * The flag lives on this daemon's lease, so it goes away with the daemon,
+ * as the local maintenance state does.
+ */
+void ramd_registry_note_maintenance(int32_t node_id, bool in_maintenance);
+
+/*
+ * Record a failover decision.  Written with compare-and-swap against the
+ * decision last seen, so a second daemon deciding concurrently is told.
+ */
+void ramd_registry_note_failover(int32_t failed_node_id, int32_t new_primary_node_id);
+
+/* True if some daemon has published node_id as being in maintenance */
+bool ramd_registry_node_in_maintenance(int32_t node_id);
+
+void ramd_registry_get_status(ramd_registry_status_t* status);
+
+/*
+ * "/ramd/<cluster_name>/" into prefix.  False if it does not fit in size,
+ * or if cluster_name is empty or holds a '/': either would let a prefix
+ * scan of one cluster return keys of another.
+ */
+bool ramd_registry_make_prefix(char* prefix, size_t size, const char* cluster_name);
+
+/*
+ * <prefix><leaf>, followed by "/<id>" when id > 0, into key; false rather
+ * than a shortened key if it does not fit in size, since two shortened
+ * keys could be the same key
+ */
+bool ramd_registry_make_key(char* key, size_t size, const char* prefix, const char* leaf,
+                            int32_t id);
+
+#endif /* RAMD_REGISTRY_H */
@@ -0,0 +1,58 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_remote_write.h
+ *		PostgreSQL Auto-Failover Daemon - Prometheus Remote Write Exporter
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_REMOTE_WRITE_H
+#define RAMD_REMOTE_WRITE_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_buffer.h"
+
+typedef struct ramd_remote_write_stats_t
+{
+	bool running;
+	int64_t samples_sent;
+	int64_t samples_dropped;   /* queue full, by remote_write_drop_policy */
+	int64_t samples_rejected;  /* answered with a 4xx that retrying cannot fix */
+	int64_t requests_ok;
+	int64_t requests_failed;   /* network errors, 5xx and 429; all retried */
+	int64_t bytes_sent;        /* snappy-compressed request bodies */
+	int64_t pending_bytes;     /* encoded samples waiting in the queue */
+	int64_t pending_samples;
+	int64_t last_success_ms;   /* ramd_clock_now_ms of the last 2xx, 0 if none */
+	int32_t last_status;       /* HTTP status of the last attempt, 0 for a network error */
+} ramd_remote_write_stats_t;
+
+/*
+ * Start pushing the collector's expositions to remote_write_url every
+ * remote_write_interval_ms as snappy-compressed protobuf WriteRequests.
+ * Samples that cannot be sent wait in a queue of remote_write_queue_kb and
+ * are retried with backoff.  Does nothing but return true when
+ * remote_write_url is empty.
+ */
+bool ramd_remote_write_start(const ramd_config_t* config);
+
+/* Stop the exporter; whatever is still queued is discarded */
+void ramd_remote_write_stop(void);
+
+/* Counters and the queue's size; false if the exporter is not running */
+bool ramd_remote_write_get_stats(ramd_remote_write_stats_t* stats);
+
+/* Append the exporter's series to a Prometheus exposition */
+bool ramd_remote_write_render_prometheus(ramd_buffer_t* output);
+
+/*
+ * Snappy block-format compression of input into output, which must hold
+ * ramd_snappy_max_compressed_length(length) bytes.  Returns the size written.
+ */
+size_t ramd_snappy_max_compressed_length(size_t length);
+size_t ramd_snappy_compress(const uint8_t* input, size_t length, uint8_t* output);
+
+#endif /* RAMD_REMOTE_WRITE_H */
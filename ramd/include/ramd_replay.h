@@ -0,0 +1,89 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_replay.h
+ *		PostgreSQL Auto-Failover Daemon - Standby Replay Advisor
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_REPLAY_H
+#define RAMD_REPLAY_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_buffer.h"
+
+/* Which stage of the standby's lag dominates */
+typedef enum ramd_replay_bottleneck_t
+{
+	RAMD_REPLAY_BOTTLENECK_NONE = 0, /* not behind, or not a standby */
+	RAMD_REPLAY_BOTTLENECK_NETWORK,  /* WAL not received yet */
+	RAMD_REPLAY_BOTTLENECK_FLUSH,    /* received but not flushed to disk */
+	RAMD_REPLAY_BOTTLENECK_REPLAY    /* flushed but not applied */
+} ramd_replay_bottleneck_t;
+
+typedef struct ramd_replay_stats_t
+{
+	bool running;
+	bool in_recovery;
+	int64_t sampled_ms;          /* ramd_clock_now_ms of the latest sample, 0 if none */
+
+	/* From pg_stat_wal_receiver and pg_last_wal_replay_lsn() on this node */
+	int64_t receive_lag_bytes;   /* primary's end of WAL - written */
+	int64_t flush_lag_bytes;     /* written - flushed */
+	int64_t replay_lag_bytes;    /* flushed - replayed */
+
+	/* From the primary's pg_stat_replication via the lag sampler; -1 if unknown */
+	int32_t write_lag_ms;
+	int32_t flush_lag_ms;        /* flush - write */
+	int32_t replay_lag_ms;       /* replay - flush */
+
+	ramd_replay_bottleneck_t bottleneck;
+	int32_t replay_bound_samples; /* consecutive samples with replay the bottleneck */
+
+	/* pg_stat_recovery_prefetch, PostgreSQL 15 and later */
+	bool prefetch_available;
+	int64_t prefetch;
+	int64_t hit;
+	int64_t skip_init;
+	int64_t skip_new;
+	int64_t skip_fpw;
+	int64_t skip_rep;
+	int64_t wal_distance;
+	int32_t block_distance;
+	int32_t io_depth;
+
+	/* Current settings */
+	char recovery_prefetch[16];
+	int32_t maintenance_io_concurrency;
+	int32_t wal_decode_buffer_kb;
+	bool restart_pending;        /* wal_decode_buffer_size was changed */
+
+	int64_t tunings;             /* settings changed by replay_autotune */
+	int64_t last_tuned_ms;
+} ramd_replay_stats_t;
+
+/*
+ * While this node is a standby, sample its replay every
+ * replay_advisor_interval_ms on a background thread and say which stage
+ * its lag comes from.  Once replay has been the bottleneck for
+ * RAMD_REPLAY_BOUND_SAMPLES samples in a row, log what would speed it up
+ * and, with replay_autotune, apply it with ALTER SYSTEM within
+ * replay_max_io_concurrency and replay_max_decode_buffer_kb.  Does
+ * nothing but return true when replay_advisor_enabled is off.
+ */
+bool ramd_replay_start(const ramd_config_t* config);
+void ramd_replay_stop(void);
+
+/* The latest sample; false if the advisor is not running */
+bool ramd_replay_get_stats(ramd_replay_stats_t* stats);
+
+/* "none", "network", "flush" or "replay" */
+const char* ramd_replay_bottleneck_name(ramd_replay_bottleneck_t bottleneck);
+
+/* Append the advisor's series to a Prometheus exposition */
+bool ramd_replay_render_prometheus(ramd_buffer_t* output);
+
+#endif /* RAMD_REPLAY_H */
@@ -0,0 +1,72 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_rolling.h
+ *		PostgreSQL Auto-Failover Daemon - Rolling Maintenance
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_ROLLING_H
+#define RAMD_ROLLING_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/* What rolling_node_command is asked to do on each node */
+typedef enum
+{
+	RAMD_ROLLING_RESTART = 0,   /* pick up restart-only configuration */
+	RAMD_ROLLING_MINOR_UPGRADE, /* install new PostgreSQL binaries, restart */
+	RAMD_ROLLING_OS_PATCH       /* patch and possibly reboot the host */
+} ramd_rolling_operation_t;
+
+/* One node's step; times are -1 until it ran */
+typedef struct ramd_rolling_node_t
+{
+	int32_t node_id;
+	ramd_role_t role;   /* when the run started */
+	bool ok;
+	int64_t started_ms; /* since the run started */
+	int64_t command_ms;
+	int64_t catchup_ms; /* back in recovery and streaming again */
+	char message[256];
+} ramd_rolling_node_t;
+
+typedef struct ramd_rolling_report_t
+{
+	ramd_rolling_operation_t operation;
+	bool ok;
+	int32_t parallel;    /* standbys allowed down at once */
+	int32_t node_count;
+	ramd_rolling_node_t nodes[RAMD_MAX_NODES]; /* standbys first, old primary last */
+	int32_t old_primary_node_id;
+	int32_t new_primary_node_id; /* -1 if the switchover did not happen */
+	int64_t switchover_ms;
+	int64_t total_ms;
+	char message[RAMD_MAX_COMMAND_LENGTH];
+} ramd_rolling_report_t;
+
+/*
+ * Run operation across the cluster from the primary's daemon: every standby
+ * through rolling_node_command, at most max_parallel (<= 0 takes
+ * rolling_max_parallel) at a time and never so many that the synchronous
+ * quorum or the Raft majority is lost, then one switchover to
+ * target_node_id (<= 0 picks the most advanced standby), then this node.
+ * Blocks until done and reports through ramd_job_phase and
+ * ramd_job_progress when called from a job.  False if anything failed or
+ * the run was refused; report->message says why.
+ */
+bool ramd_rolling_run(ramd_cluster_t* cluster, const ramd_config_t* config,
+                      ramd_rolling_operation_t operation, int32_t max_parallel,
+                      int32_t target_node_id, ramd_rolling_report_t* report);
+
+/* True while a rolling run is in progress */
+bool ramd_rolling_in_progress(void);
+
+bool ramd_rolling_parse_operation(const char* name, ramd_rolling_operation_t* operation);
+const char* ramd_rolling_operation_to_string(ramd_rolling_operation_t operation);
+
+#endif /* RAMD_ROLLING_H */
@@ -24,11 +24,14 @@
 
 /* Security constants */
 #define RAMD_MAX_USERS 100
-#define RAMD_MAX_TOKEN_LENGTH 64
+#define RAMD_MAX_TOKEN_LENGTH 256
 #define RAMD_MAX_PASSWORD_LENGTH 256
 #define RAMD_MAX_CERT_PATH_LENGTH 512
 #define RAMD_MAX_KEY_PATH_LENGTH 512
 #define RAMD_MAX_CA_PATH_LENGTH 512
+#define RAMD_TOKEN_CACHE_SIZE 64
+#define RAMD_TOKEN_CACHE_TTL_SECONDS 60
+#define RAMD_AUDIT_READ_SUMMARY_SECONDS 60
 
 /* User roles */
 typedef enum
@@ -45,6 +48,7 @@ typedef struct ramd_user_t
 	char username[RAMD_MAX_USERNAME_LENGTH];
 	char password_hash[SHA256_DIGEST_LENGTH * 2 + 1];
 	char token[RAMD_MAX_TOKEN_LENGTH];
+	unsigned char token_digest[SHA256_DIGEST_LENGTH];
 	ramd_user_role_t role;
 	time_t created_at;
 	time_t last_login;
@@ -57,6 +61,7 @@ typedef struct ramd_security_context_t
 	/* Authentication */
 	bool enable_auth;
 	char admin_token[RAMD_MAX_TOKEN_LENGTH];
+	unsigned char admin_token_digest[SHA256_DIGEST_LENGTH];
 	ramd_user_t users[RAMD_MAX_USERS];
 	int user_count;
 
@@ -120,18 +125,38 @@ bool ramd_security_init(ramd_security_context_t *ctx);
 /* Cleanup security subsystem */
 void ramd_security_cleanup(ramd_security_context_t *ctx);
 
-/* Authenticate HTTP request */
+/*
+ * Authenticate HTTP request.  action is "read" for side-effect free
+ * requests; successful reads are summarised in the audit log rather than
+ * recorded one by one.
+ */
 bool ramd_security_authenticate_http(const char *client_ip, const char *authorization,
 									const char *action, const char *resource);
 
+/* Replace the admin token; drops every cached validation */
+bool ramd_security_set_admin_token(const char *token);
+
+/* Requests each client may make per minute; 0 turns rate limiting off */
+void ramd_security_set_rate_limit(int32_t per_minute);
+
+/* Revoke a token: evict it from the cache and rotate the owning user's token */
+bool ramd_security_revoke_token(const char *token);
+
+/* Drop every cached token validation */
+void ramd_security_invalidate_token_cache(void);
+
 /* Validate and sanitize input */
 bool ramd_security_validate_and_sanitize_input(char *input, size_t max_length);
 
 /* Add user */
 bool ramd_security_add_user(const char *username, const char *password, ramd_user_role_t role);
 
-/* Get audit log */
-bool ramd_security_get_audit_log(ramd_audit_entry_t *entries, int max_entries, int *actual_count);
+/*
+ * Get the newest audit records logged between from and until (unix
+ * seconds, 0 for no bound), newest first
+ */
+bool ramd_security_get_audit_log(time_t from, time_t until, ramd_audit_entry_t *entries,
+								 int max_entries, int *actual_count);
 
 /* Get security status */
 bool ramd_security_get_status(ramd_security_status_t *status);
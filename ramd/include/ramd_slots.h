@@ -0,0 +1,55 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_slots.h
+ *		PostgreSQL Auto-Failover Daemon - Replication Slot Manager
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_SLOTS_H
+#define RAMD_SLOTS_H
+
+#include <libpq-fe.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+/* One ramd-managed physical slot on the current primary */
+typedef struct ramd_slot_stats_t
+{
+	char slot_name[64];
+	int32_t node_id;
+	bool active;
+	int64_t retained_bytes; /* WAL kept back by restart_lsn, -1 if unknown */
+	int64_t safe_wal_size;  /* before max_slot_wal_keep_size bites, -1 if unlimited */
+	char wal_status[16];    /* reserved, extended, unreserved, lost; empty before 13 */
+	int64_t inactive_ms;    /* how long no standby has used it, 0 while active */
+	bool released;          /* dropped by policy; recreated once the standby streams */
+} ramd_slot_stats_t;
+
+/* The slot a standby streams through: ramd_node_<node_id> */
+void ramd_slots_name(int32_t node_id, char* name, size_t size);
+
+/*
+ * Create node_id's slot on the primary behind conn unless it exists, so a
+ * base backup taken next has its WAL retained from the start
+ */
+bool ramd_slots_create(PGconn* conn, int32_t node_id);
+
+/*
+ * One pass over pg_replication_slots on the primary behind conn: create a
+ * slot for every registered standby, record what each retains, and drop
+ * or advance those whose standby has been away past slot_inactive_timeout_ms
+ * or holds more than slot_max_retained_mb, as slot_inactive_policy says.
+ * Called by the lag sampler on its own session after every sample.
+ */
+void ramd_slots_manage(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                       const ramd_config_t* config);
+
+/* Slots seen on the latest pass; returns how many were written */
+int32_t ramd_slots_get_all(ramd_slot_stats_t* stats, int32_t max_count);
+
+#endif /* RAMD_SLOTS_H */
@@ -0,0 +1,26 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_status_page.h
+ *		PostgreSQL Auto-Failover Daemon - Shared-Memory Status Page
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_STATUS_PAGE_H
+#define RAMD_STATUS_PAGE_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+
+/*
+ * Publish the watch view in the ram_status_page.h page of http_port and
+ * keep it current: rewritten on every change in the feed, heartbeat
+ * refreshed every RAM_STATUS_PAGE_HEARTBEAT_MS.  Does nothing unless
+ * status_page_enabled is set.  Stopping removes the page.
+ */
+bool ramd_status_page_start(const ramd_config_t* config);
+void ramd_status_page_stop(void);
+
+#endif /* RAMD_STATUS_PAGE_H */
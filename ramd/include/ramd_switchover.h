@@ -0,0 +1,79 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_switchover.h
+ *		PostgreSQL Auto-Failover Daemon - Planned Switchover
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_SWITCHOVER_H
+#define RAMD_SWITCHOVER_H
+
+#include <time.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+
+typedef enum
+{
+	RAMD_SWITCHOVER_IDLE = 0,
+	RAMD_SWITCHOVER_RUNNING,
+	RAMD_SWITCHOVER_SUCCEEDED,
+	RAMD_SWITCHOVER_FAILED,     /* stopped before the old primary went down */
+	RAMD_SWITCHOVER_ROLLED_BACK /* old primary was restarted as primary */
+} ramd_switchover_state_t;
+
+/* Steps in the order they start; repoint overlaps promote and rejoin */
+typedef enum
+{
+	RAMD_SWITCHOVER_PHASE_FENCE = 0, /* read-only, drain writers */
+	RAMD_SWITCHOVER_PHASE_CATCHUP,   /* target flushes the final LSN */
+	RAMD_SWITCHOVER_PHASE_SHUTDOWN,  /* old primary stops cleanly */
+	RAMD_SWITCHOVER_PHASE_PROMOTE,
+	RAMD_SWITCHOVER_PHASE_REPOINT,   /* other standbys follow the target */
+	RAMD_SWITCHOVER_PHASE_REJOIN,    /* old primary starts as a standby */
+	RAMD_SWITCHOVER_PHASE_COUNT
+} ramd_switchover_phase_t;
+
+typedef struct ramd_switchover_status_t
+{
+	ramd_switchover_state_t state;
+	ramd_switchover_phase_t phase; /* current, or where it stopped */
+	int32_t old_primary_node_id;
+	int32_t target_node_id;
+	int64_t target_lsn;            /* -1 until fenced */
+	int64_t phase_ms[RAMD_SWITCHOVER_PHASE_COUNT]; /* -1 if not run */
+	int64_t total_ms;
+	int32_t standbys_repointed;
+	int32_t standbys_total;
+	time_t started_at;
+	time_t finished_at;
+	char message[RAMD_MAX_COMMAND_LENGTH];
+} ramd_switchover_status_t;
+
+bool ramd_switchover_init(const ramd_config_t* config);
+void ramd_switchover_cleanup(void);
+
+/*
+ * Hand the primary role from this node to target_node_id (<= 0 picks the
+ * most advanced standby) on a background thread.  Only the daemon that
+ * runs the current primary can do this, since it stops and restarts its
+ * own PostgreSQL; error receives the reason when it refuses.
+ */
+bool ramd_switchover_start(ramd_cluster_t* cluster, int32_t target_node_id,
+                           char* error, size_t error_size);
+
+/* Wait for the current switchover; returns true if it succeeded */
+bool ramd_switchover_wait(void);
+
+/* True while a switchover runs; automatic failover stands down meanwhile */
+bool ramd_switchover_in_progress(void);
+
+void ramd_switchover_get_status(ramd_switchover_status_t* status);
+const char* ramd_switchover_state_to_string(ramd_switchover_state_t state);
+const char* ramd_switchover_phase_to_string(ramd_switchover_phase_t phase);
+
+#endif /* RAMD_SWITCHOVER_H */
@@ -13,6 +13,7 @@
 
 #include "ramd.h"
 #include "ramd_postgresql.h"
+#include "ramd_lag.h"
 
 /* PostgreSQL replication state enumeration */
 typedef enum
@@ -43,6 +44,10 @@ typedef struct ramd_sync_config_t
 	int32_t sync_timeout_ms;
 	bool enforce_sync_standbys;
 	char application_name_pattern[RAMD_MAX_HOSTNAME_LENGTH];
+	bool adaptive;              /* rank standbys by live flush lag */
+	int32_t adaptive_hold_ms;   /* how long a change must persist */
+	int32_t adaptive_margin_ms; /* how much faster a replacement must be */
+	int32_t adaptive_stall_ms;  /* flush lag that demotes a standby */
 } ramd_sync_config_t;
 
 /* Synchronous Standby Information */
@@ -95,7 +100,20 @@ bool ramd_sync_standby_is_eligible(int32_t node_id);
 
 /* Monitoring and lag checking */
 bool ramd_sync_replication_check_lag(ramd_sync_standby_t* standby);
+/*
+ * Wait until the required synchronous standbys, or one given standby, have
+ * flushed everything the primary had flushed when the call was made.
+ */
 bool ramd_sync_replication_wait_for_sync(int32_t timeout_ms);
+bool ramd_sync_replication_wait_for_standby(int32_t node_id, int32_t timeout_ms);
+
+/*
+ * Feed one round of lag samples taken on conn, a session to primary_node_id.
+ * Refreshes the standby status table and, in adaptive mode, reorders
+ * synchronous_standby_names on that session when the fastest set changes.
+ */
+void ramd_sync_replication_adapt(PGconn* conn, int32_t primary_node_id,
+                                 const ramd_lag_stats_t* stats, int32_t count);
 
 /* Configuration helpers */
 char* ramd_sync_mode_to_string(ramd_sync_mode_t mode);
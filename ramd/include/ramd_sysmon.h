@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_sysmon.h
+ *		PostgreSQL Auto-Failover Daemon - Host Resource Sampler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_SYSMON_H
+#define RAMD_SYSMON_H
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_buffer.h"
+#include "performance_monitor.h"
+
+/* Rolling figures over the sampler's history */
+typedef struct ramd_sysmon_summary_t
+{
+	performance_metrics_t latest;
+	performance_metrics_t average; /* last PERFORMANCE_HEALTH_WINDOW samples */
+	performance_metrics_t p95;     /* the whole history */
+	int32_t load;                  /* see ramd_sysmon_load */
+	int32_t sample_count;
+} ramd_sysmon_summary_t;
+
+/* Sample this host every RAMD_SYSMON_INTERVAL_MS on a background thread */
+bool ramd_sysmon_start(const ramd_config_t* config);
+void ramd_sysmon_stop(void);
+
+/* The monitor's latest round trip to a peer; a negative rtt_us forgets it */
+void ramd_sysmon_note_peer_rtt(int32_t node_id, int64_t rtt_us);
+
+/*
+ * Saturation of this host, 0-100, averaged over the last
+ * PERFORMANCE_HEALTH_WINDOW samples; -1 before the first sample.
+ */
+int32_t ramd_sysmon_load(void);
+
+/* Scale a reachable node's health by its host load (-1: unknown, no change) */
+float ramd_sysmon_health_for_load(int32_t load);
+
+/* A host this loaded should not be promoted over one that is not */
+bool ramd_sysmon_load_is_saturated(int32_t load);
+
+bool ramd_sysmon_get_summary(ramd_sysmon_summary_t* summary);
+bool ramd_sysmon_render_prometheus(ramd_buffer_t* output);
+
+#endif /* RAMD_SYSMON_H */
@@ -0,0 +1,62 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_tls.h
+ *		PostgreSQL Auto-Failover Daemon - TLS for the HTTP API
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_TLS_H
+#define RAMD_TLS_H
+
+#include <openssl/ssl.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+
+typedef struct ramd_tls_status_t
+{
+	bool enabled;
+	bool ktls_requested;       /* ssl_ktls */
+	int64_t handshakes;        /* completed, resumed ones included */
+	int64_t resumed;           /* from a session ticket or the session cache */
+	int64_t ktls_send;         /* connections whose records the kernel seals */
+	int64_t ktls_recv;         /* ... and opens */
+	int64_t reloads;           /* certificate changes picked up */
+	int64_t loaded_wall_ms;    /* when the current certificate was read */
+	char cert_file[RAMD_MAX_PATH_LENGTH];
+} ramd_tls_status_t;
+
+/*
+ * Load ssl_cert_file and ssl_key_file when ssl_enabled is set.  False if
+ * TLS is asked for and the certificate cannot be used; with ssl_enabled
+ * off it only records that plaintext is served.
+ */
+bool ramd_tls_init(const ramd_config_t* config);
+
+/*
+ * Take ssl_enabled, the file names and ssl_ktls from a reloaded
+ * configuration.  A certificate that does not load leaves the previous
+ * one serving; false in that case.
+ */
+bool ramd_tls_configure(const ramd_config_t* config);
+
+void ramd_tls_cleanup(void);
+
+bool ramd_tls_enabled(void);
+
+/*
+ * A server session on the accepted socket fd, to be driven with
+ * SSL_read_ex()/SSL_write_ex(); NULL if TLS is off or OpenSSL failed.
+ * Rereads the certificate first when its files changed.
+ */
+SSL* ramd_tls_session_new(int fd);
+
+/* Count a session whose handshake has just completed */
+void ramd_tls_note_handshake(SSL* ssl);
+
+void ramd_tls_get_status(ramd_tls_status_t* status);
+
+#endif /* RAMD_TLS_H */
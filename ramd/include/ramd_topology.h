@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_topology.h
+ *		PostgreSQL Auto-Failover Daemon - Cascading Replication Planner
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_TOPOLOGY_H
+#define RAMD_TOPOLOGY_H
+
+#include <libpq-fe.h>
+
+#include "ramd.h"
+#include "ramd_config.h"
+#include "ramd_cluster.h"
+#include "ramd_lag.h"
+
+/* Where one standby streams from, as planned and as last applied */
+typedef struct ramd_topology_node_t
+{
+	int32_t node_id;
+	char zone[64];              /* from node_zones; empty if unlabelled */
+	bool is_sync;               /* kept direct to the primary */
+	int32_t upstream_node_id;   /* planned; the primary's id for a direct standby */
+	int32_t applied_upstream_id; /* what it was last repointed to, -1 if unknown */
+	int32_t depth;              /* 1 for a direct standby */
+	int32_t downstream_count;   /* standbys planned to stream from this one */
+	int32_t replay_lag_ms;      /* as the primary sees it, -1 once cascaded */
+} ramd_topology_node_t;
+
+/*
+ * Re-plan the cascade from the lag sampler's latest round and repoint the
+ * standbys whose upstream changed.  conn is the sampler's session to
+ * primary_node_id; only the ramd running beside that primary acts, so two
+ * daemons never fight over a standby.  With cascade_enabled off it only
+ * brings cascaded standbys back to the primary.
+ */
+void ramd_topology_update(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                          const ramd_config_t* config, const ramd_lag_stats_t* stats,
+                          int32_t count);
+
+/* The standby node_id was repointed to, or -1 if it streams from the primary */
+int32_t ramd_topology_upstream(int32_t node_id);
+
+/* The current plan; returns how many were written */
+int32_t ramd_topology_get_all(ramd_topology_node_t* nodes, int32_t max_count,
+                              int32_t* primary_node_id);
+
+#endif /* RAMD_TOPOLOGY_H */
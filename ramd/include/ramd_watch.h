@@ -0,0 +1,130 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_watch.h
+ *		PostgreSQL Auto-Failover Daemon - Cluster Change Feed
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef RAMD_WATCH_H
+#define RAMD_WATCH_H
+
+#include <time.h>
+
+#include "ramd.h"
+#include "ramd_cluster.h"
+
+/* What a watcher sees of one node */
+typedef struct ramd_watch_node_t
+{
+	int32_t node_id;
+	char hostname[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t postgresql_port;
+	ramd_node_state_t state;
+	ramd_role_t role;
+	bool is_primary;
+	bool is_leader;
+	bool is_healthy;
+	bool is_voter;
+	int32_t replay_lag_ms;    /* -1 if unknown */
+	int64_t replay_lag_bytes; /* -1 if unknown */
+	int64_t flush_lsn;        /* -1 if unknown; as of the entry's version */
+	int64_t replay_lsn;       /* -1 if unknown or primary */
+	uint64_t version;         /* feed version of this entry's last change */
+} ramd_watch_node_t;
+
+/*
+ * The published view of the cluster.  version grows by one for every
+ * publish that changed something; a client that last saw version N only
+ * needs the entries whose version is above N.  Adding or removing a node
+ * moves full_since, after which older clients get the whole view again,
+ * as do clients holding a version from another epoch (daemon restart).
+ */
+typedef struct ramd_watch_snapshot_t
+{
+	uint64_t epoch;
+	uint64_t version;
+	uint64_t full_since;
+	uint64_t cluster_version; /* last change to the fields below */
+	char cluster_name[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t primary_node_id;
+	int32_t leader_node_id;
+	bool has_quorum;
+	bool in_failover;
+	int32_t failover_state; /* ramd_failover_state_t of this daemon */
+	int64_t raft_term;      /* -1 until pgraft has reported one */
+	time_t changed_at;      /* wall clock of the latest version */
+	int32_t node_count;
+	ramd_watch_node_t nodes[RAMD_MAX_NODES];
+} ramd_watch_snapshot_t;
+
+/* What one change event is about; old_value and new_value follow the type */
+typedef enum
+{
+	RAMD_WATCH_EVENT_MEMBERSHIP = 0, /* node count; node_id -1, or a node's address or vote moved */
+	RAMD_WATCH_EVENT_NODE_STATE,     /* ramd_node_state_t */
+	RAMD_WATCH_EVENT_NODE_ROLE,      /* ramd_role_t */
+	RAMD_WATCH_EVENT_NODE_HEALTH,    /* 0 or 1 */
+	RAMD_WATCH_EVENT_NODE_LAG,       /* replay lag in ms, -1 if unknown */
+	RAMD_WATCH_EVENT_PRIMARY,        /* primary node id */
+	RAMD_WATCH_EVENT_LEADER,         /* leader node id */
+	RAMD_WATCH_EVENT_QUORUM,         /* 0 or 1 */
+	RAMD_WATCH_EVENT_FAILOVER,       /* ramd_failover_state_t of this daemon */
+	RAMD_WATCH_EVENT_TERM,           /* Raft term, -1 if unknown */
+	RAMD_WATCH_EVENT_COUNT
+} ramd_watch_event_type_t;
+
+typedef struct ramd_watch_event_t
+{
+	uint64_t version; /* the feed version that published it */
+	ramd_watch_event_type_t type;
+	int32_t node_id;  /* -1 for cluster-wide events */
+	int64_t old_value;
+	int64_t new_value;
+	time_t at;
+} ramd_watch_event_t;
+
+/*
+ * Called after every bump with that publish's events, oldest first.  Runs
+ * with the feed lock held, so it must not block or publish.
+ */
+typedef void (*ramd_watch_subscriber_t)(const ramd_watch_event_t* events, int32_t count,
+                                        void* arg);
+
+/*
+ * Compare the cluster with the last published view and bump the version
+ * if a node's state, role or health changed or its lag moved by more than
+ * RAMD_WATCH_LAG_STEP_MS / RAMD_WATCH_LAG_STEP_BYTES.  LSNs ride along
+ * with whatever change is published but never cause one on their own.
+ * Each change is also recorded as a typed event and handed to the
+ * subscribers.
+ */
+void ramd_watch_publish(const ramd_cluster_t* cluster);
+
+uint64_t ramd_watch_version(void);
+void ramd_watch_get(ramd_watch_snapshot_t* snapshot);
+
+/*
+ * Write view to out in the ram_state.h layout, local_node_id being the
+ * daemon that publishes it.  Returns the length, or 0 if size is short.
+ */
+size_t ramd_watch_encode_state(const ramd_watch_snapshot_t* view, int32_t local_node_id,
+                               unsigned char* out, size_t size);
+
+/*
+ * Copy the events published after version since, oldest first, and return
+ * how many were written; -1 if some of them have already been dropped
+ * from the last RAMD_WATCH_EVENT_HISTORY, so the caller must re-read the
+ * whole view.
+ */
+int32_t ramd_watch_events_since(uint64_t since, ramd_watch_event_t* events, int32_t max_count);
+
+/* At most RAMD_WATCH_MAX_SUBSCRIBERS; false when full */
+bool ramd_watch_subscribe(ramd_watch_subscriber_t subscriber, void* arg);
+void ramd_watch_unsubscribe(ramd_watch_subscriber_t subscriber, void* arg);
+
+const char* ramd_watch_event_type_to_string(ramd_watch_event_type_t type);
+
+#endif /* RAMD_WATCH_H */
@@ -0,0 +1,1539 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_sim.c
+ *		PostgreSQL Auto-Failover Daemon - Deterministic Failover Simulation
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Runs a whole cluster in one process on virtual time: every node's
+ * PostgreSQL, its pgraft member and its ramd monitor, a network between
+ * them, and one fault per run.  Nothing waits for real time, so a
+ * thousand failovers take seconds, and everything random is drawn from
+ * the run's seed, so "ramd_sim -s SEED -r 1 -v" replays a run event by
+ * event.
+ *
+ * Only two pieces of ramd run here, on the virtual clock: the
+ * phi-accrual detector (ramd_detector_heartbeat/check, one history per
+ * observing node) and ramd_failover_candidate_is_better(), which ranks
+ * every answer.  The rest of ramd is modelled, written again on top of
+ * the simulated network rather than called:
+ *
+ *   monitor     ramd_monitor's cycle: every monitor_interval_ms each node
+ *               probes every member and counts a member unhealthy if the
+ *               last probe went unanswered; ramd_sim_monitor_cycle()
+ *   selection   ramd_failover_select_new_primary(): LSN samples younger
+ *               than RAMD_FAILOVER_LSN_SAMPLE_MAX_AGE_MS, then a query of
+ *               the rest that stops at a majority, or gives the round up
+ *               at RAMD_FAILOVER_PROBE_DEADLINE_MS; ramd_sim_start_failover()
+ *               and ramd_sim_decide().  The eligibility checks it makes
+ *               against the registry (maintenance, voters) are not
+ *   promotion   ramd_failover_execute() from promote to serving writes, as
+ *               one message and a timeout; fencing, endpoint moves and
+ *               repointing the standbys are not modelled at all
+ *
+ * A change to those paths in ramd_monitor.c or ramd_failover.c has to be
+ * made here as well; the simulation does not notice it.  Around them:
+ *
+ *   network     one-way delay with jitter; a lost segment costs a TCP
+ *               retransmission (200 ms, doubling) rather than the
+ *               message, and partitions drop everything across them
+ *   PostgreSQL  a primary writing WAL at a steady rate, standbys
+ *               replaying it some way behind, probes answered after a
+ *               service time, or not at all while killed or stalled
+ *   pgraft      leader election with randomized timeouts, heartbeats,
+ *               votes and CheckQuorum, at pgraft's timeouts; the log is
+ *               only an index that the leader advances each heartbeat;
+ *               only the leader holding a quorum starts a failover
+ *
+ * Faults (--fault), injected after a warm-up at a random point of the
+ * monitor cycle, as tests/failover/failover_bench.py does on real nodes:
+ *
+ *   kill       the primary's postmaster dies; host and pgraft stay up
+ *   crash      the primary's host goes away
+ *   partition  the primary is cut off from every other node
+ *   stall      the primary's PostgreSQL stops answering for 1-30 s
+ *   flaky      30% segment loss between all nodes, nothing fails
+ *   none       nothing happens
+ *   mixed      each run draws one of the above (default)
+ *
+ * Each run reports detection (fault to FAILED verdict), selection (to the
+ * choice of candidate), promotion (to the candidate serving writes) and
+ * rto (fault to writes), and the WAL the candidate was missing.  The exit
+ * status is 1 if any run promoted a node that was not an up standby, left
+ * a dead primary unreplaced, or failed over with nothing wrong.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "ramd.h"
+#include "ramd_clock.h"
+#include "ramd_config.h"
+#include "ramd_daemon.h"
+#include "ramd_detector.h"
+#include "ramd_failover.h"
+#include "ramd_logging.h"
+
+/* Normally defined by ramd_main.c, which is not linked in */
+ramd_daemon_t *g_ramd_daemon = NULL;
+PGconn       *g_conn = NULL;
+
+#define RAMD_SIM_MAX_NODES           7
+#define RAMD_SIM_ID_STRIDE           8      /* detector id: (observer - 1) * stride + node */
+#define RAMD_SIM_DEFAULT_NODES       3
+#define RAMD_SIM_DEFAULT_RUNS        1000
+#define RAMD_SIM_WARMUP_MS           60000  /* detector history before the fault */
+#define RAMD_SIM_HORIZON_MS          180000 /* after the fault */
+#define RAMD_SIM_DELAY_US            500    /* one-way network delay */
+#define RAMD_SIM_JITTER_US           200    /* mean of its exponential jitter */
+#define RAMD_SIM_DROP                0.001  /* segment loss outside "flaky" */
+#define RAMD_SIM_FLAKY_DROP          0.3
+#define RAMD_SIM_RTO_US              200000 /* first TCP retransmission */
+#define RAMD_SIM_MAX_RETRANSMITS     6
+#define RAMD_SIM_SERVICE_US          2000   /* PostgreSQL answering a probe */
+#define RAMD_SIM_STALL_MIN_MS        1000
+#define RAMD_SIM_STALL_MAX_MS        30000
+#define RAMD_SIM_PROMOTE_MIN_MS      200
+#define RAMD_SIM_PROMOTE_MAX_MS      800
+#define RAMD_SIM_PROMOTE_TIMEOUT_MS  10000
+#define RAMD_SIM_WAL_BYTES_PER_MS    4096
+#define RAMD_SIM_MAX_REPLAY_LAG_MS   500
+#define RAMD_SIM_SATURATED_CHANCE    0.1
+#define RAMD_SIM_RAFT_HEARTBEAT_MS   1000   /* pgraft.heartbeat_interval */
+#define RAMD_SIM_RAFT_ELECTION_MS    5000   /* pgraft.election_timeout */
+#define RAMD_SIM_HISTOGRAM_BUCKETS   12
+
+typedef enum
+{
+	RAMD_SIM_FAULT_KILL = 0,
+	RAMD_SIM_FAULT_CRASH,
+	RAMD_SIM_FAULT_PARTITION,
+	RAMD_SIM_FAULT_STALL,
+	RAMD_SIM_FAULT_FLAKY,
+	RAMD_SIM_FAULT_NONE,
+	RAMD_SIM_FAULT_COUNT,
+	RAMD_SIM_FAULT_MIXED = RAMD_SIM_FAULT_COUNT
+} ramd_sim_fault_t;
+
+static const char *const g_fault_names[RAMD_SIM_FAULT_COUNT] = {
+	"kill", "crash", "partition", "stall", "flaky", "none"
+};
+
+typedef enum
+{
+	RAMD_SIM_PHASE_DETECTION = 0,
+	RAMD_SIM_PHASE_SELECTION,
+	RAMD_SIM_PHASE_PROMOTION,
+	RAMD_SIM_PHASE_RTO,
+	RAMD_SIM_PHASE_COUNT
+} ramd_sim_phase_t;
+
+static const char *const g_phase_names[RAMD_SIM_PHASE_COUNT] = {
+	"detection", "selection", "promotion", "rto"
+};
+
+typedef enum
+{
+	RAMD_SIM_EV_FAULT = 0,
+	RAMD_SIM_EV_HEAL,
+	RAMD_SIM_EV_MESSAGE,
+	RAMD_SIM_EV_ELECTION_TIMER,
+	RAMD_SIM_EV_RAFT_HEARTBEAT,
+	RAMD_SIM_EV_MONITOR,
+	RAMD_SIM_EV_SELECT_DEADLINE,
+	RAMD_SIM_EV_PROMOTE_TIMEOUT,
+	RAMD_SIM_EV_PROMOTED
+} ramd_sim_event_type_t;
+
+typedef enum
+{
+	RAMD_SIM_MSG_APPEND = 0,
+	RAMD_SIM_MSG_APPEND_RESP,
+	RAMD_SIM_MSG_VOTE,
+	RAMD_SIM_MSG_VOTE_RESP,
+	RAMD_SIM_MSG_PROBE,
+	RAMD_SIM_MSG_PROBE_RESP,
+	RAMD_SIM_MSG_SELECT,
+	RAMD_SIM_MSG_SELECT_RESP,
+	RAMD_SIM_MSG_PROMOTE
+} ramd_sim_message_t;
+
+typedef struct ramd_sim_event_t
+{
+	int64_t		at_us;
+	uint64_t	seq;			/* ties are taken in the order they were scheduled */
+	ramd_sim_event_type_t type;
+	ramd_sim_message_t kind;
+	int32_t		from;
+	int32_t		to;
+	int64_t		a;				/* term, sequence number, LSN, failover id... */
+	int64_t		b;
+	int64_t		c;
+} ramd_sim_event_t;
+
+typedef enum
+{
+	RAMD_SIM_FOLLOWER = 0,
+	RAMD_SIM_CANDIDATE,
+	RAMD_SIM_LEADER
+} ramd_sim_raft_role_t;
+
+typedef enum
+{
+	RAMD_SIM_IDLE = 0,
+	RAMD_SIM_SELECTING,
+	RAMD_SIM_PROMOTING
+} ramd_sim_failover_phase_t;
+
+typedef struct ramd_sim_sample_t
+{
+	bool		valid;
+	int64_t		at_us;
+	int64_t		lsn;
+	int32_t		load;
+} ramd_sim_sample_t;
+
+typedef struct ramd_sim_node_t
+{
+	int32_t		id;
+	int32_t		group;			/* nodes talk only within their group */
+	bool		host_up;
+	bool		pg_up;
+	int64_t		stalled_until_us;
+	bool		is_primary;
+	int64_t		replay_lag_us;
+	int32_t		load;
+	ramd_node_t	node;			/* what ramd's candidate ranking is given */
+
+	/* pgraft */
+	ramd_sim_raft_role_t raft_role;
+	int64_t		term;
+	int32_t		voted_for;
+	int32_t		leader_id;
+	int32_t		votes;
+	uint64_t	election_gen;
+	int64_t		last_index;
+	int64_t		commit_index;
+	int64_t		match_index[RAMD_SIM_MAX_NODES + 1];
+	int64_t		ack_us[RAMD_SIM_MAX_NODES + 1];
+
+	/* ramd */
+	int64_t		probe_seq[RAMD_SIM_MAX_NODES + 1];
+	int64_t		probe_sent_us[RAMD_SIM_MAX_NODES + 1];
+	bool		probe_answered[RAMD_SIM_MAX_NODES + 1];
+	bool		healthy[RAMD_SIM_MAX_NODES + 1];
+	ramd_sim_sample_t samples[RAMD_SIM_MAX_NODES + 1];
+	ramd_detector_verdict_t verdict; /* of the primary, to trace changes */
+
+	ramd_sim_failover_phase_t phase;
+	int64_t		failover_id;
+	int32_t		candidates;
+	int32_t		answered;
+	int32_t		best;
+	int64_t		best_lsn;
+	int32_t		best_load;
+	bool		asked[RAMD_SIM_MAX_NODES + 1];
+} ramd_sim_node_t;
+
+typedef struct ramd_sim_options_t
+{
+	int32_t		nodes;
+	int32_t		runs;
+	uint64_t	seed;
+	ramd_sim_fault_t fault;
+	bool		verbose;
+	bool		json;
+	int32_t		raft_heartbeat_ms;
+	int32_t		raft_election_ms;
+	double		drop;
+} ramd_sim_options_t;
+
+typedef struct ramd_sim_result_t
+{
+	uint64_t	seed;
+	ramd_sim_fault_t fault;
+	bool		failed_over;
+	bool		missed;			/* the primary was gone and stayed unreplaced */
+	bool		false_failover;	/* a failover with nothing wrong */
+	bool		violation;
+	int32_t		promoted;
+	double		phase_ms[RAMD_SIM_PHASE_COUNT]; /* -1 if not reached */
+	double		lost_wal_kb;
+	int64_t		events;
+	char		note[160];
+} ramd_sim_result_t;
+
+typedef struct ramd_sim_t
+{
+	const ramd_sim_options_t *options;
+	int64_t		now_us;
+	uint64_t	rng;
+	uint64_t	next_seq;
+	ramd_sim_event_t *heap;
+	size_t		heap_count;
+	size_t		heap_size;
+	ramd_sim_node_t nodes[RAMD_SIM_MAX_NODES + 1];
+	int32_t		node_count;
+	int32_t		primary;		/* node id of the primary */
+	ramd_sim_fault_t fault;
+	int64_t		fault_us;
+	int64_t		heal_us;		/* end of a stall or of flaky, 0 if none */
+	double		drop;
+	int64_t		wal_paused_us;	/* total time the primary did not write */
+	int64_t		wal_pause_start_us; /* 0 while it writes */
+	int64_t		detected_us;
+	int64_t		selected_us;
+	int64_t		next_failover_id;
+	bool		done;
+	ramd_sim_result_t *result;
+} ramd_sim_t;
+
+static ramd_sim_t g_sim;
+
+/* ---------------------------------------------------------------------
+ * Virtual time and randomness
+ * ---------------------------------------------------------------------
+ */
+
+static int64_t
+ramd_sim_clock(void)
+{
+	return g_sim.now_us;
+}
+
+/* splitmix64: one 64-bit state, every value a function of the seed */
+static uint64_t
+ramd_sim_random(void)
+{
+	uint64_t	z = (g_sim.rng += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static double
+ramd_sim_uniform(void)
+{
+	return (double) (ramd_sim_random() >> 11) / 9007199254740992.0;
+}
+
+static int64_t
+ramd_sim_between(int64_t lo, int64_t hi)
+{
+	return lo + (int64_t) (ramd_sim_uniform() * (double) (hi - lo));
+}
+
+static void
+ramd_sim_trace(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void
+ramd_sim_trace(const char *fmt, ...)
+{
+	va_list		args;
+
+	if (!g_sim.options->verbose)
+		return;
+	printf("%10.3f  ", (double) g_sim.now_us / 1e6);
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+	printf("\n");
+}
+
+/* ---------------------------------------------------------------------
+ * Event queue: a binary heap on (time, sequence)
+ * ---------------------------------------------------------------------
+ */
+
+static bool
+ramd_sim_event_before(const ramd_sim_event_t *x, const ramd_sim_event_t *y)
+{
+	return x->at_us < y->at_us || (x->at_us == y->at_us && x->seq < y->seq);
+}
+
+static void
+ramd_sim_schedule(ramd_sim_event_t event)
+{
+	size_t		i;
+
+	if (g_sim.heap_count == g_sim.heap_size)
+	{
+		size_t		size = g_sim.heap_size ? g_sim.heap_size * 2 : 1024;
+		ramd_sim_event_t *heap = realloc(g_sim.heap, size * sizeof(ramd_sim_event_t));
+
+		if (!heap)
+		{
+			fprintf(stderr, "ramd_sim: out of memory\n");
+			exit(2);
+		}
+		g_sim.heap = heap;
+		g_sim.heap_size = size;
+	}
+
+	event.seq = g_sim.next_seq++;
+	i = g_sim.heap_count++;
+	while (i > 0 && ramd_sim_event_before(&event, &g_sim.heap[(i - 1) / 2]))
+	{
+		g_sim.heap[i] = g_sim.heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	g_sim.heap[i] = event;
+}
+
+static ramd_sim_event_t
+ramd_sim_pop(void)
+{
+	ramd_sim_event_t top = g_sim.heap[0];
+	ramd_sim_event_t last = g_sim.heap[--g_sim.heap_count];
+	size_t		i = 0;
+
+	for (;;)
+	{
+		size_t		child = 2 * i + 1;
+
+		if (child >= g_sim.heap_count)
+			break;
+		if (child + 1 < g_sim.heap_count &&
+			ramd_sim_event_before(&g_sim.heap[child + 1], &g_sim.heap[child]))
+			child++;
+		if (!ramd_sim_event_before(&g_sim.heap[child], &last))
+			break;
+		g_sim.heap[i] = g_sim.heap[child];
+		i = child;
+	}
+	if (g_sim.heap_count > 0)
+		g_sim.heap[i] = last;
+	return top;
+}
+
+static void
+ramd_sim_at(int64_t at_us, ramd_sim_event_type_t type, int32_t node, int64_t a)
+{
+	ramd_sim_event_t event = {0};
+
+	event.at_us = at_us;
+	event.type = type;
+	event.to = node;
+	event.a = a;
+	ramd_sim_schedule(event);
+}
+
+/* ---------------------------------------------------------------------
+ * Network and PostgreSQL
+ * ---------------------------------------------------------------------
+ */
+
+static bool
+ramd_sim_connected(int32_t from, int32_t to)
+{
+	const ramd_sim_node_t *x = &g_sim.nodes[from];
+	const ramd_sim_node_t *y = &g_sim.nodes[to];
+
+	return x->host_up && y->host_up && x->group == y->group;
+}
+
+static void
+ramd_sim_send(int32_t from, int32_t to, ramd_sim_message_t kind, int64_t a, int64_t b,
+			  int64_t c, int64_t extra_us)
+{
+	ramd_sim_event_t event = {0};
+	int64_t		delay = RAMD_SIM_DELAY_US +
+		(int64_t) (-log(1.0 - ramd_sim_uniform()) * RAMD_SIM_JITTER_US);
+	int64_t		rto = RAMD_SIM_RTO_US;
+
+	if (!ramd_sim_connected(from, to))
+		return;
+
+	/* A lost segment is sent again; the message is only late */
+	for (int i = 0; i < RAMD_SIM_MAX_RETRANSMITS && ramd_sim_uniform() < g_sim.drop; i++)
+	{
+		delay += rto;
+		rto *= 2;
+	}
+
+	event.at_us = g_sim.now_us + extra_us + delay;
+	event.type = RAMD_SIM_EV_MESSAGE;
+	event.kind = kind;
+	event.from = from;
+	event.to = to;
+	event.a = a;
+	event.b = b;
+	event.c = c;
+	ramd_sim_schedule(event);
+}
+
+/* WAL the primary has written by now, in bytes */
+static int64_t
+ramd_sim_wal_at(int64_t at_us)
+{
+	int64_t		paused = g_sim.wal_paused_us;
+
+	if (g_sim.wal_pause_start_us > 0 && at_us > g_sim.wal_pause_start_us)
+		paused += at_us - g_sim.wal_pause_start_us;
+	return (at_us - paused) / 1000 * RAMD_SIM_WAL_BYTES_PER_MS;
+}
+
+static int64_t
+ramd_sim_lsn(const ramd_sim_node_t *n)
+{
+	int64_t		at_us = g_sim.now_us - (n->is_primary ? 0 : n->replay_lag_us);
+	int64_t		stopped_at = g_sim.wal_pause_start_us;
+
+	/* A standby has only what reached it before the primary stopped */
+	if (!n->is_primary && stopped_at > 0 && at_us > stopped_at)
+		at_us = stopped_at;
+	return ramd_sim_wal_at(at_us > 0 ? at_us : 0);
+}
+
+/* When PostgreSQL on n can answer a query sent now, or -1 if never */
+static int64_t
+ramd_sim_pg_answer_us(const ramd_sim_node_t *n)
+{
+	if (!n->host_up || !n->pg_up)
+		return -1;
+	if (n->stalled_until_us > g_sim.now_us)
+		return n->stalled_until_us - g_sim.now_us + RAMD_SIM_SERVICE_US;
+	return RAMD_SIM_SERVICE_US;
+}
+
+static int32_t
+ramd_sim_detector_id(int32_t observer, int32_t node)
+{
+	return (observer - 1) * RAMD_SIM_ID_STRIDE + node;
+}
+
+/* ---------------------------------------------------------------------
+ * pgraft
+ * ---------------------------------------------------------------------
+ */
+
+static int32_t
+ramd_sim_majority(void)
+{
+	return g_sim.node_count / 2 + 1;
+}
+
+static void
+ramd_sim_reset_election_timer(ramd_sim_node_t *n)
+{
+	int64_t		timeout = ramd_sim_between((int64_t) g_sim.options->raft_election_ms * 1000,
+										   (int64_t) g_sim.options->raft_election_ms * 2000);
+
+	ramd_sim_at(g_sim.now_us + timeout, RAMD_SIM_EV_ELECTION_TIMER, n->id,
+				(int64_t) ++n->election_gen);
+}
+
+static void
+ramd_sim_become_follower(ramd_sim_node_t *n, int64_t term, int32_t leader)
+{
+	if (n->raft_role == RAMD_SIM_LEADER)
+		ramd_sim_trace("node %d steps down as Raft leader (term %lld)", n->id,
+					   (long long) n->term);
+	if (term > n->term)
+	{
+		n->term = term;
+		n->voted_for = 0;
+	}
+	n->raft_role = RAMD_SIM_FOLLOWER;
+	n->leader_id = leader;
+	ramd_sim_reset_election_timer(n);
+}
+
+static void
+ramd_sim_raft_broadcast(ramd_sim_node_t *n)
+{
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+		if (i != n->id)
+			ramd_sim_send(n->id, i, RAMD_SIM_MSG_APPEND, n->term, n->last_index,
+						  n->commit_index, 0);
+}
+
+static void
+ramd_sim_become_leader(ramd_sim_node_t *n)
+{
+	n->raft_role = RAMD_SIM_LEADER;
+	n->leader_id = n->id;
+	n->election_gen++;
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		n->match_index[i] = i == n->id ? n->last_index : -1;
+		n->ack_us[i] = g_sim.now_us;
+	}
+	ramd_sim_trace("node %d is Raft leader (term %lld)", n->id, (long long) n->term);
+	ramd_sim_raft_broadcast(n);
+	ramd_sim_at(g_sim.now_us + (int64_t) g_sim.options->raft_heartbeat_ms * 1000,
+				RAMD_SIM_EV_RAFT_HEARTBEAT, n->id, n->term);
+}
+
+static int32_t
+ramd_sim_acks_within(const ramd_sim_node_t *n, int64_t window_us)
+{
+	int32_t		acks = 0;
+
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+		if (i == n->id || g_sim.now_us - n->ack_us[i] < window_us)
+			acks++;
+	return acks;
+}
+
+static void
+ramd_sim_raft_heartbeat(ramd_sim_node_t *n, int64_t term)
+{
+	int64_t		matches[RAMD_SIM_MAX_NODES];
+	int32_t		count = 0;
+
+	if (!n->host_up || n->raft_role != RAMD_SIM_LEADER || n->term != term)
+		return;
+
+	/* CheckQuorum: a leader that cannot hear a majority steps down */
+	if (ramd_sim_acks_within(n, (int64_t) g_sim.options->raft_election_ms * 1000) <
+		ramd_sim_majority())
+	{
+		ramd_sim_become_follower(n, n->term, 0);
+		return;
+	}
+
+	/* The log advances a little each heartbeat; commit is the majority's match */
+	n->last_index++;
+	n->match_index[n->id] = n->last_index;
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+		matches[count++] = n->match_index[i];
+	for (int32_t i = 1; i < count; i++)
+		for (int32_t j = i; j > 0 && matches[j] > matches[j - 1]; j--)
+		{
+			int64_t		t = matches[j];
+
+			matches[j] = matches[j - 1];
+			matches[j - 1] = t;
+		}
+	if (matches[ramd_sim_majority() - 1] > n->commit_index)
+		n->commit_index = matches[ramd_sim_majority() - 1];
+
+	ramd_sim_raft_broadcast(n);
+	ramd_sim_at(g_sim.now_us + (int64_t) g_sim.options->raft_heartbeat_ms * 1000,
+				RAMD_SIM_EV_RAFT_HEARTBEAT, n->id, term);
+}
+
+static void
+ramd_sim_election_timeout(ramd_sim_node_t *n, uint64_t gen)
+{
+	if (!n->host_up || gen != n->election_gen || n->raft_role == RAMD_SIM_LEADER)
+		return;
+
+	n->raft_role = RAMD_SIM_CANDIDATE;
+	n->term++;
+	n->voted_for = n->id;
+	n->votes = 1;
+	n->leader_id = 0;
+	ramd_sim_trace("node %d starts an election (term %lld)", n->id, (long long) n->term);
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+		if (i != n->id)
+			ramd_sim_send(n->id, i, RAMD_SIM_MSG_VOTE, n->term, n->last_index, 0, 0);
+	ramd_sim_reset_election_timer(n);
+}
+
+/* What pgraft_get_cluster_snapshot() would tell the ramd on n, in its detector ids */
+static void
+ramd_sim_raft_snapshot(const ramd_sim_node_t *n, ramd_pgraft_snapshot_t *snapshot)
+{
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->published = 1;
+	snapshot->local_node_id = ramd_sim_detector_id(n->id, n->id);
+	snapshot->leader_id = n->leader_id > 0 ? ramd_sim_detector_id(n->id, n->leader_id) : 0;
+	snapshot->term = n->term;
+	snapshot->is_leader = n->raft_role == RAMD_SIM_LEADER;
+	snapshot->commit_index = n->commit_index;
+	snapshot->last_index = n->last_index;
+	snapshot->node_count = g_sim.node_count;
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		ramd_pgraft_node_progress_t *p = &snapshot->nodes[i - 1];
+
+		p->node_id = ramd_sim_detector_id(n->id, i);
+		p->voting = 1;
+		p->is_leader = i == n->leader_id;
+		p->match_index = snapshot->is_leader ? n->match_index[i] : -1;
+	}
+}
+
+/* ---------------------------------------------------------------------
+ * ramd: monitor and failover
+ * ---------------------------------------------------------------------
+ */
+
+static const ramd_config_t *
+ramd_sim_config(void)
+{
+	return &g_ramd_daemon->config;
+}
+
+static int64_t
+ramd_sim_probe_deadline_us(void)
+{
+	const ramd_config_t *config = ramd_sim_config();
+	int32_t		deadline = config->health_check_timeout_ms;
+
+	if (deadline <= 0 || deadline > config->monitor_interval_ms)
+		deadline = config->monitor_interval_ms;
+	return (int64_t) deadline * 1000;
+}
+
+static void
+ramd_sim_note_sample(ramd_sim_node_t *observer, int32_t node, int64_t lsn, int32_t load)
+{
+	observer->samples[node].valid = true;
+	observer->samples[node].at_us = g_sim.now_us;
+	observer->samples[node].lsn = lsn;
+	observer->samples[node].load = load;
+}
+
+static void
+ramd_sim_consider(ramd_sim_node_t *acting, int32_t node, int64_t lsn, int32_t load)
+{
+	ramd_sim_node_t *best = acting->best > 0 ? &g_sim.nodes[acting->best] : NULL;
+
+	acting->answered++;
+	if (ramd_failover_candidate_is_better(lsn, load, &g_sim.nodes[node].node, acting->best_lsn,
+										  acting->best_load, best ? &best->node : NULL))
+	{
+		acting->best = node;
+		acting->best_lsn = lsn;
+		acting->best_load = load;
+	}
+}
+
+static void
+ramd_sim_failover_give_up(ramd_sim_node_t *acting, const char *why)
+{
+	ramd_sim_trace("node %d: failover %lld abandoned: %s", acting->id,
+				   (long long) acting->failover_id, why);
+	acting->phase = RAMD_SIM_IDLE;
+}
+
+static void
+ramd_sim_decide(ramd_sim_node_t *acting)
+{
+	if (acting->phase != RAMD_SIM_SELECTING)
+		return;
+	if (acting->best <= 0)
+	{
+		ramd_sim_failover_give_up(acting, "no standby answered");
+		return;
+	}
+	if (acting->answered < acting->candidates / 2 + 1)
+	{
+		ramd_sim_failover_give_up(acting, "no majority of the standbys answered");
+		return;
+	}
+
+	g_sim.selected_us = g_sim.now_us;
+	acting->phase = RAMD_SIM_PROMOTING;
+	ramd_sim_trace("node %d: promoting node %d (%d of %d candidates answered, LSN %lld)",
+				   acting->id, acting->best, acting->answered, acting->candidates,
+				   (long long) acting->best_lsn);
+	if (acting->best == acting->id)
+	{
+		ramd_sim_event_t event = {0};
+
+		event.at_us = g_sim.now_us;
+		event.type = RAMD_SIM_EV_MESSAGE;
+		event.kind = RAMD_SIM_MSG_PROMOTE;
+		event.from = acting->id;
+		event.to = acting->id;
+		event.a = acting->failover_id;
+		ramd_sim_schedule(event);
+	}
+	else
+		ramd_sim_send(acting->id, acting->best, RAMD_SIM_MSG_PROMOTE, acting->failover_id, 0, 0,
+					  0);
+	ramd_sim_at(g_sim.now_us + (int64_t) RAMD_SIM_PROMOTE_TIMEOUT_MS * 1000,
+				RAMD_SIM_EV_PROMOTE_TIMEOUT, acting->id, acting->failover_id);
+}
+
+/* A model of ramd_failover_select_new_primary(), with the probe engine replaced by messages */
+static void
+ramd_sim_start_failover(ramd_sim_node_t *acting)
+{
+	int32_t		quorum;
+
+	acting->phase = RAMD_SIM_SELECTING;
+	acting->failover_id = ++g_sim.next_failover_id;
+	acting->candidates = 0;
+	acting->answered = 0;
+	acting->best = 0;
+	acting->best_lsn = -1;
+	acting->best_load = -1;
+	memset(acting->asked, 0, sizeof(acting->asked));
+	if (g_sim.detected_us == 0)
+		g_sim.detected_us = g_sim.now_us;
+
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		const ramd_sim_sample_t *s = &acting->samples[i];
+
+		if (i == g_sim.primary || !acting->healthy[i])
+			continue;
+		acting->candidates++;
+		if (s->valid && g_sim.now_us - s->at_us <= RAMD_FAILOVER_LSN_SAMPLE_MAX_AGE_MS * 1000)
+			ramd_sim_consider(acting, i, s->lsn, s->load);
+		else
+			acting->asked[i] = true;
+	}
+
+	quorum = acting->candidates / 2 + 1;
+	ramd_sim_trace("node %d: failover %lld, %d candidates, %d sampled", acting->id,
+				   (long long) acting->failover_id, acting->candidates, acting->answered);
+	if (acting->answered >= quorum || acting->candidates == acting->answered)
+	{
+		ramd_sim_decide(acting);
+		return;
+	}
+
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		if (!acting->asked[i])
+			continue;
+		if (i == acting->id)
+		{
+			int64_t		answer = ramd_sim_pg_answer_us(acting);
+
+			if (answer >= 0)
+			{
+				ramd_sim_event_t event = {0};
+
+				event.at_us = g_sim.now_us + answer;
+				event.type = RAMD_SIM_EV_MESSAGE;
+				event.kind = RAMD_SIM_MSG_SELECT_RESP;
+				event.from = i;
+				event.to = i;
+				event.a = acting->failover_id;
+				event.b = -1;	/* LSN taken on delivery */
+				ramd_sim_schedule(event);
+			}
+		}
+		else
+			ramd_sim_send(acting->id, i, RAMD_SIM_MSG_SELECT, acting->failover_id, 0, 0, 0);
+	}
+	ramd_sim_at(g_sim.now_us + (int64_t) RAMD_FAILOVER_PROBE_DEADLINE_MS * 1000,
+				RAMD_SIM_EV_SELECT_DEADLINE, acting->id, acting->failover_id);
+}
+
+/* A model of ramd_monitor's cycle; only the detector it feeds is ramd's own */
+static void
+ramd_sim_monitor_cycle(ramd_sim_node_t *n)
+{
+	const ramd_config_t *config = ramd_sim_config();
+	ramd_pgraft_snapshot_t snapshot;
+	ramd_detector_verdict_t verdict;
+	int64_t		local;
+
+	if (!n->host_up)
+		return;
+	ramd_sim_at(g_sim.now_us + (int64_t) config->monitor_interval_ms * 1000, RAMD_SIM_EV_MONITOR,
+				n->id, 0);
+
+	/* Answers from the last cycle are in; anyone silent is unhealthy */
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		if (i == n->id)
+			continue;
+		n->healthy[i] = n->probe_answered[i];
+		n->probe_answered[i] = false;
+		n->probe_seq[i]++;
+		n->probe_sent_us[i] = g_sim.now_us;
+		ramd_sim_send(n->id, i, RAMD_SIM_MSG_PROBE, n->probe_seq[i], 0, 0, 0);
+	}
+
+	/* The local server, over the monitor's own session */
+	local = ramd_sim_pg_answer_us(n);
+	n->healthy[n->id] = local >= 0 && local <= ramd_sim_probe_deadline_us();
+	if (n->healthy[n->id])
+	{
+		ramd_detector_heartbeat(ramd_sim_detector_id(n->id, n->id), RAMD_DETECTOR_POSTGRESQL);
+		ramd_sim_note_sample(n, n->id, ramd_sim_lsn(n), n->load);
+	}
+
+	ramd_sim_raft_snapshot(n, &snapshot);
+	ramd_detector_observe_raft(&snapshot);
+
+	if (g_sim.primary <= 0 || g_sim.done)
+		return;
+	verdict = ramd_detector_check(ramd_sim_detector_id(n->id, g_sim.primary), config, NULL);
+	if (verdict != n->verdict)
+	{
+		ramd_sim_trace("node %d: primary %d is %s", n->id, g_sim.primary,
+					   ramd_detector_verdict_to_string(verdict));
+		n->verdict = verdict;
+	}
+
+	/* Only the Raft leader acts, and only while it holds a quorum */
+	if (verdict == RAMD_DETECTOR_FAILED && n->phase == RAMD_SIM_IDLE &&
+		n->raft_role == RAMD_SIM_LEADER &&
+		ramd_sim_acks_within(n, (int64_t) g_sim.options->raft_election_ms * 1000) >=
+		ramd_sim_majority() && config->auto_failover_enabled)
+		ramd_sim_start_failover(n);
+}
+
+/* ---------------------------------------------------------------------
+ * Messages
+ * ---------------------------------------------------------------------
+ */
+
+static void
+ramd_sim_deliver(const ramd_sim_event_t *ev)
+{
+	ramd_sim_node_t *to = &g_sim.nodes[ev->to];
+	ramd_sim_node_t *from = &g_sim.nodes[ev->from];
+	int64_t		answer;
+
+	/* A partition or crash since it was sent loses it all the same */
+	if (ev->from != ev->to && !ramd_sim_connected(ev->from, ev->to))
+		return;
+
+	switch (ev->kind)
+	{
+		case RAMD_SIM_MSG_APPEND:
+			if (ev->a < to->term)
+			{
+				ramd_sim_send(to->id, from->id, RAMD_SIM_MSG_APPEND_RESP, to->term, -1, 0, 0);
+				break;
+			}
+			if (ev->a > to->term || to->raft_role != RAMD_SIM_FOLLOWER ||
+				to->leader_id != from->id)
+				ramd_sim_become_follower(to, ev->a, from->id);
+			else
+				ramd_sim_reset_election_timer(to);
+			to->last_index = ev->b;
+			to->commit_index = ev->c;
+			ramd_sim_send(to->id, from->id, RAMD_SIM_MSG_APPEND_RESP, to->term, to->last_index,
+						  0, 0);
+			break;
+
+		case RAMD_SIM_MSG_APPEND_RESP:
+			if (ev->a > to->term)
+			{
+				ramd_sim_become_follower(to, ev->a, 0);
+				break;
+			}
+			if (to->raft_role == RAMD_SIM_LEADER && ev->a == to->term && ev->b >= 0)
+			{
+				to->ack_us[from->id] = g_sim.now_us;
+				if (ev->b > to->match_index[from->id])
+					to->match_index[from->id] = ev->b;
+			}
+			break;
+
+		case RAMD_SIM_MSG_VOTE:
+			{
+				bool		granted;
+
+				if (ev->a > to->term)
+					ramd_sim_become_follower(to, ev->a, 0);
+				granted = ev->a == to->term && ev->b >= to->last_index &&
+					(to->voted_for == 0 || to->voted_for == from->id);
+				if (granted)
+				{
+					to->voted_for = from->id;
+					ramd_sim_reset_election_timer(to);
+				}
+				ramd_sim_send(to->id, from->id, RAMD_SIM_MSG_VOTE_RESP, to->term, granted, 0, 0);
+			}
+			break;
+
+		case RAMD_SIM_MSG_VOTE_RESP:
+			if (ev->a > to->term)
+				ramd_sim_become_follower(to, ev->a, 0);
+			else if (to->raft_role == RAMD_SIM_CANDIDATE && ev->a == to->term && ev->b &&
+					 ++to->votes >= ramd_sim_majority())
+				ramd_sim_become_leader(to);
+			break;
+
+		case RAMD_SIM_MSG_PROBE:
+			answer = ramd_sim_pg_answer_us(to);
+			if (answer >= 0)
+				ramd_sim_send(to->id, from->id, RAMD_SIM_MSG_PROBE_RESP, ev->a, ramd_sim_lsn(to),
+							  to->load, answer);
+			break;
+
+		case RAMD_SIM_MSG_PROBE_RESP:
+			/* Only an answer within the cycle's deadline counts */
+			if (ev->a != to->probe_seq[from->id] ||
+				g_sim.now_us - to->probe_sent_us[from->id] > ramd_sim_probe_deadline_us())
+				break;
+			to->probe_answered[from->id] = true;
+			to->healthy[from->id] = true;
+			ramd_detector_heartbeat(ramd_sim_detector_id(to->id, from->id),
+									RAMD_DETECTOR_POSTGRESQL);
+			ramd_sim_note_sample(to, from->id, ev->b, (int32_t) ev->c);
+			break;
+
+		case RAMD_SIM_MSG_SELECT:
+			answer = ramd_sim_pg_answer_us(to);
+			if (answer >= 0)
+				ramd_sim_send(to->id, from->id, RAMD_SIM_MSG_SELECT_RESP, ev->a, -1, 0, answer);
+			break;
+
+		case RAMD_SIM_MSG_SELECT_RESP:
+			if (to->phase != RAMD_SIM_SELECTING || ev->a != to->failover_id ||
+				!to->asked[from->id])
+				break;
+			to->asked[from->id] = false;
+			ramd_sim_consider(to, from->id, ramd_sim_lsn(from), from->load);
+			if (to->answered >= to->candidates / 2 + 1)
+				ramd_sim_decide(to);
+			break;
+
+		case RAMD_SIM_MSG_PROMOTE:
+			if (!to->host_up || !to->pg_up || to->is_primary)
+				break;
+			ramd_sim_at(g_sim.now_us +
+						ramd_sim_between(RAMD_SIM_PROMOTE_MIN_MS, RAMD_SIM_PROMOTE_MAX_MS) * 1000,
+						RAMD_SIM_EV_PROMOTED, to->id, ev->a);
+			break;
+	}
+}
+
+/* ---------------------------------------------------------------------
+ * Faults and outcomes
+ * ---------------------------------------------------------------------
+ */
+
+static void
+ramd_sim_inject(void)
+{
+	ramd_sim_node_t *p = &g_sim.nodes[g_sim.primary];
+
+	g_sim.fault_us = g_sim.now_us;
+	switch (g_sim.fault)
+	{
+		case RAMD_SIM_FAULT_KILL:
+			p->pg_up = false;
+			g_sim.wal_pause_start_us = g_sim.now_us;
+			break;
+		case RAMD_SIM_FAULT_CRASH:
+			p->host_up = false;
+			p->pg_up = false;
+			g_sim.wal_pause_start_us = g_sim.now_us;
+			break;
+		case RAMD_SIM_FAULT_PARTITION:
+			p->group = 1;
+			g_sim.wal_pause_start_us = g_sim.now_us;
+			break;
+		case RAMD_SIM_FAULT_STALL:
+			g_sim.heal_us = g_sim.now_us +
+				ramd_sim_between(RAMD_SIM_STALL_MIN_MS, RAMD_SIM_STALL_MAX_MS) * 1000;
+			p->stalled_until_us = g_sim.heal_us;
+			g_sim.wal_pause_start_us = g_sim.now_us;
+			ramd_sim_at(g_sim.heal_us, RAMD_SIM_EV_HEAL, 0, 0);
+			break;
+		case RAMD_SIM_FAULT_FLAKY:
+			g_sim.drop = RAMD_SIM_FLAKY_DROP;
+			break;
+		case RAMD_SIM_FAULT_NONE:
+		case RAMD_SIM_FAULT_COUNT:
+			break;
+	}
+	ramd_sim_trace("fault: %s on primary node %d", g_fault_names[g_sim.fault], g_sim.primary);
+}
+
+static void
+ramd_sim_heal(void)
+{
+	if (g_sim.fault == RAMD_SIM_FAULT_STALL && g_sim.wal_pause_start_us > 0)
+	{
+		g_sim.wal_paused_us += g_sim.now_us - g_sim.wal_pause_start_us;
+		g_sim.wal_pause_start_us = 0;
+		ramd_sim_trace("primary node %d answers again", g_sim.primary);
+	}
+}
+
+static void
+ramd_sim_promoted(ramd_sim_node_t *n, int64_t failover_id)
+{
+	ramd_sim_result_t *r = g_sim.result;
+	const ramd_sim_node_t *old = &g_sim.nodes[g_sim.primary];
+	int64_t		written = ramd_sim_lsn(old);
+	int64_t		have = ramd_sim_lsn(n);
+
+	(void) failover_id;
+	r->failed_over = true;
+	r->promoted = n->id;
+	if (n->id == g_sim.primary || !n->host_up || !n->pg_up)
+	{
+		r->violation = true;
+		snprintf(r->note, sizeof(r->note), "promoted node %d, which is not an up standby",
+				 n->id);
+	}
+	if (g_sim.fault == RAMD_SIM_FAULT_NONE)
+	{
+		r->false_failover = true;
+		snprintf(r->note, sizeof(r->note), "failed over with nothing wrong");
+	}
+
+	r->phase_ms[RAMD_SIM_PHASE_DETECTION] = (double) (g_sim.detected_us - g_sim.fault_us) / 1000.0;
+	r->phase_ms[RAMD_SIM_PHASE_SELECTION] = (double) (g_sim.selected_us - g_sim.detected_us) / 1000.0;
+	r->phase_ms[RAMD_SIM_PHASE_PROMOTION] = (double) (g_sim.now_us - g_sim.selected_us) / 1000.0;
+	r->phase_ms[RAMD_SIM_PHASE_RTO] = (double) (g_sim.now_us - g_sim.fault_us) / 1000.0;
+	r->lost_wal_kb = written > have ? (double) (written - have) / 1024.0 : 0.0;
+
+	n->is_primary = true;
+	ramd_sim_trace("node %d is the new primary, %.0f kB of WAL behind", n->id, r->lost_wal_kb);
+	g_sim.done = true;
+}
+
+static void
+ramd_sim_dispatch(const ramd_sim_event_t *ev)
+{
+	ramd_sim_node_t *n = &g_sim.nodes[ev->to];
+
+	switch (ev->type)
+	{
+		case RAMD_SIM_EV_FAULT:
+			ramd_sim_inject();
+			break;
+		case RAMD_SIM_EV_HEAL:
+			ramd_sim_heal();
+			break;
+		case RAMD_SIM_EV_MESSAGE:
+			ramd_sim_deliver(ev);
+			break;
+		case RAMD_SIM_EV_ELECTION_TIMER:
+			ramd_sim_election_timeout(n, (uint64_t) ev->a);
+			break;
+		case RAMD_SIM_EV_RAFT_HEARTBEAT:
+			ramd_sim_raft_heartbeat(n, ev->a);
+			break;
+		case RAMD_SIM_EV_MONITOR:
+			ramd_sim_monitor_cycle(n);
+			break;
+		case RAMD_SIM_EV_SELECT_DEADLINE:
+			if (n->phase == RAMD_SIM_SELECTING && n->failover_id == ev->a)
+				ramd_sim_decide(n);
+			break;
+		case RAMD_SIM_EV_PROMOTE_TIMEOUT:
+			if (n->phase == RAMD_SIM_PROMOTING && n->failover_id == ev->a)
+				ramd_sim_failover_give_up(n, "the candidate did not take over");
+			break;
+		case RAMD_SIM_EV_PROMOTED:
+			if (n->host_up && n->pg_up && !g_sim.done)
+				ramd_sim_promoted(n, ev->a);
+			break;
+	}
+}
+
+static void
+ramd_sim_run(uint64_t seed, ramd_sim_fault_t fault, ramd_sim_result_t *r)
+{
+	const ramd_config_t *config = ramd_sim_config();
+	int64_t		horizon_us;
+
+	free(g_sim.heap);
+	memset(&g_sim.nodes, 0, sizeof(g_sim.nodes));
+	g_sim.heap = NULL;
+	g_sim.heap_count = 0;
+	g_sim.heap_size = 0;
+	g_sim.now_us = 0;
+	g_sim.next_seq = 0;
+	g_sim.rng = seed;
+	g_sim.node_count = g_sim.options->nodes;
+	g_sim.primary = 1;
+	g_sim.fault = fault;
+	g_sim.heal_us = 0;
+	g_sim.drop = g_sim.options->drop;
+	g_sim.wal_paused_us = 0;
+	g_sim.wal_pause_start_us = 0;
+	g_sim.detected_us = 0;
+	g_sim.selected_us = 0;
+	g_sim.next_failover_id = 0;
+	g_sim.done = false;
+	g_sim.result = r;
+
+	memset(r, 0, sizeof(*r));
+	r->seed = seed;
+	r->fault = fault;
+	for (int i = 0; i < RAMD_SIM_PHASE_COUNT; i++)
+		r->phase_ms[i] = -1.0;
+
+	/* Each run starts with no history in any node's detector */
+	for (int32_t id = 1; id <= RAMD_MAX_NODES; id++)
+		ramd_detector_forget(id);
+
+	for (int32_t i = 1; i <= g_sim.node_count; i++)
+	{
+		ramd_sim_node_t *n = &g_sim.nodes[i];
+
+		n->id = i;
+		n->host_up = true;
+		n->pg_up = true;
+		n->is_primary = i == g_sim.primary;
+		n->replay_lag_us = n->is_primary ? 0 :
+			ramd_sim_between(0, (int64_t) RAMD_SIM_MAX_REPLAY_LAG_MS * 1000);
+		n->load = ramd_sim_uniform() < RAMD_SIM_SATURATED_CHANCE ? 95 :
+			(int32_t) ramd_sim_between(10, 60);
+		n->node.node_id = i;
+		n->node.role = n->is_primary ? RAMD_ROLE_PRIMARY : RAMD_ROLE_STANDBY;
+		n->node.is_healthy = true;
+		n->node.is_voter = true;
+		for (int32_t j = 1; j <= g_sim.node_count; j++)
+			n->probe_answered[j] = true;
+
+		ramd_sim_reset_election_timer(n);
+		ramd_sim_at(ramd_sim_between(0, (int64_t) config->monitor_interval_ms * 1000),
+					RAMD_SIM_EV_MONITOR, i, 0);
+	}
+
+	g_sim.fault_us = (int64_t) RAMD_SIM_WARMUP_MS * 1000 +
+		ramd_sim_between(0, (int64_t) config->monitor_interval_ms * 1000);
+	ramd_sim_at(g_sim.fault_us, RAMD_SIM_EV_FAULT, 0, 0);
+	horizon_us = g_sim.fault_us + (int64_t) RAMD_SIM_HORIZON_MS * 1000;
+
+	while (g_sim.heap_count > 0 && !g_sim.done)
+	{
+		ramd_sim_event_t ev = ramd_sim_pop();
+
+		if (ev.at_us > horizon_us)
+			break;
+		g_sim.now_us = ev.at_us;
+		ramd_sim_dispatch(&ev);
+		r->events++;
+	}
+
+	if (!r->failed_over && (fault == RAMD_SIM_FAULT_KILL || fault == RAMD_SIM_FAULT_CRASH ||
+							fault == RAMD_SIM_FAULT_PARTITION))
+	{
+		r->missed = true;
+		snprintf(r->note, sizeof(r->note), "primary not replaced within %d s",
+				 RAMD_SIM_HORIZON_MS / 1000);
+	}
+	if (r->failed_over && fault == RAMD_SIM_FAULT_FLAKY)
+		snprintf(r->note, sizeof(r->note), "failed over on a lossy network");
+}
+
+/* ---------------------------------------------------------------------
+ * Reporting
+ * ---------------------------------------------------------------------
+ */
+
+static int
+ramd_sim_compare_double(const void *x, const void *y)
+{
+	double		a = *(const double *) x;
+	double		b = *(const double *) y;
+
+	return (a > b) - (a < b);
+}
+
+static double
+ramd_sim_percentile(const double *sorted, int32_t count, double p)
+{
+	int32_t		i = (int32_t) ceil(p / 100.0 * count) - 1;
+
+	if (count == 0)
+		return 0.0;
+	return sorted[i < 0 ? 0 : (i >= count ? count - 1 : i)];
+}
+
+static void
+ramd_sim_print_json(const ramd_sim_result_t *r)
+{
+	printf("{\"seed\":%llu,\"fault\":\"%s\",\"failed_over\":%s,\"promoted\":%d",
+		   (unsigned long long) r->seed, g_fault_names[r->fault],
+		   r->failed_over ? "true" : "false", r->promoted);
+	for (int i = 0; i < RAMD_SIM_PHASE_COUNT; i++)
+	{
+		if (r->phase_ms[i] >= 0)
+			printf(",\"%s_ms\":%.3f", g_phase_names[i], r->phase_ms[i]);
+		else
+			printf(",\"%s_ms\":null", g_phase_names[i]);
+	}
+	printf(",\"lost_wal_kb\":%.1f,\"missed\":%s,\"false_failover\":%s,\"violation\":%s,"
+		   "\"events\":%lld}\n",
+		   r->lost_wal_kb, r->missed ? "true" : "false", r->false_failover ? "true" : "false",
+		   r->violation ? "true" : "false", (long long) r->events);
+}
+
+static void
+ramd_sim_print_histogram(const double *sorted, int32_t count)
+{
+	double		lo = sorted[0];
+	double		hi = sorted[count - 1];
+	double		width = (hi - lo) / RAMD_SIM_HISTOGRAM_BUCKETS;
+	int32_t		buckets[RAMD_SIM_HISTOGRAM_BUCKETS] = {0};
+	int32_t		peak = 0;
+
+	if (width <= 0)
+		return;
+	for (int32_t i = 0; i < count; i++)
+	{
+		int32_t		b = (int32_t) ((sorted[i] - lo) / width);
+
+		b = b >= RAMD_SIM_HISTOGRAM_BUCKETS ? RAMD_SIM_HISTOGRAM_BUCKETS - 1 : b;
+		if (++buckets[b] > peak)
+			peak = buckets[b];
+	}
+	for (int32_t b = 0; b < RAMD_SIM_HISTOGRAM_BUCKETS; b++)
+	{
+		int32_t		bar = peak > 0 ? buckets[b] * 40 / peak : 0;
+
+		printf("    %9.1f ms %6d ", lo + width * b, buckets[b]);
+		for (int32_t i = 0; i < bar; i++)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+static void
+ramd_sim_print_summary(const ramd_sim_result_t *results, int32_t runs, double wall_s)
+{
+	double	   *values = malloc(sizeof(double) * (size_t) (runs > 0 ? runs : 1));
+	int32_t		counts[RAMD_SIM_FAULT_COUNT] = {0};
+	int32_t		failovers[RAMD_SIM_FAULT_COUNT] = {0};
+	int32_t		total_failovers = 0;
+	int32_t		missed = 0;
+	int32_t		false_failovers = 0;
+	int32_t		violations = 0;
+	int64_t		events = 0;
+
+	if (!values)
+		return;
+	for (int32_t i = 0; i < runs; i++)
+	{
+		counts[results[i].fault]++;
+		failovers[results[i].fault] += results[i].failed_over;
+		total_failovers += results[i].failed_over;
+		missed += results[i].missed;
+		false_failovers += results[i].false_failover;
+		violations += results[i].violation;
+		events += results[i].events;
+	}
+
+	printf("%d runs, %d nodes, %lld events in %.2f s (%.0f runs/min)\n", runs,
+		   g_sim.options->nodes, (long long) events, wall_s,
+		   wall_s > 0 ? runs / wall_s * 60.0 : 0.0);
+	printf("\n%-10s %6s %9s\n", "fault", "runs", "failovers");
+	for (int f = 0; f < RAMD_SIM_FAULT_COUNT; f++)
+		if (counts[f] > 0)
+			printf("%-10s %6d %9d\n", g_fault_names[f], counts[f], failovers[f]);
+
+	if (total_failovers > 0)
+		printf("\n%-12s %6s %10s %10s %10s %10s %10s\n", "phase (ms)", "n", "min", "p50", "p90",
+			   "p99", "max");
+	for (int phase = 0; phase <= RAMD_SIM_PHASE_COUNT && total_failovers > 0; phase++)
+	{
+		int32_t		n = 0;
+
+		for (int32_t i = 0; i < runs; i++)
+		{
+			if (!results[i].failed_over)
+				continue;
+			values[n++] = phase < RAMD_SIM_PHASE_COUNT ? results[i].phase_ms[phase] :
+				results[i].lost_wal_kb;
+		}
+		if (n == 0)
+			continue;
+		qsort(values, (size_t) n, sizeof(double), ramd_sim_compare_double);
+		printf("%-12s %6d %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			   phase < RAMD_SIM_PHASE_COUNT ? g_phase_names[phase] : "lost WAL kB", n, values[0],
+			   ramd_sim_percentile(values, n, 50), ramd_sim_percentile(values, n, 90),
+			   ramd_sim_percentile(values, n, 99), values[n - 1]);
+		if (phase == RAMD_SIM_PHASE_RTO)
+			ramd_sim_print_histogram(values, n);
+	}
+
+	printf("\nmissed failovers: %d, false failovers: %d, violations: %d\n", missed,
+		   false_failovers, violations);
+	for (int32_t i = 0; i < runs; i++)
+		if (results[i].missed || results[i].false_failover || results[i].violation ||
+			(results[i].failed_over && results[i].fault == RAMD_SIM_FAULT_FLAKY))
+			printf("  seed %llu (%s): %s\n", (unsigned long long) results[i].seed,
+				   g_fault_names[results[i].fault], results[i].note);
+	free(values);
+}
+
+static bool
+ramd_sim_parse_fault(const char *name, ramd_sim_fault_t *fault)
+{
+	if (strcmp(name, "mixed") == 0)
+	{
+		*fault = RAMD_SIM_FAULT_MIXED;
+		return true;
+	}
+	for (int f = 0; f < RAMD_SIM_FAULT_COUNT; f++)
+		if (strcmp(name, g_fault_names[f]) == 0)
+		{
+			*fault = (ramd_sim_fault_t) f;
+			return true;
+		}
+	return false;
+}
+
+static void
+ramd_sim_usage(const char *progname)
+{
+	printf("Usage: %s [OPTIONS]\n\n", progname);
+	printf("Simulate failovers of a cluster on virtual time, one fault per run.\n\n");
+	printf("Options:\n");
+	printf("  -n, --nodes=N          Cluster size, 3 to %d (default: %d)\n", RAMD_SIM_MAX_NODES,
+		   RAMD_SIM_DEFAULT_NODES);
+	printf("  -r, --runs=N           Number of runs (default: %d)\n", RAMD_SIM_DEFAULT_RUNS);
+	printf("  -s, --seed=SEED        Seed of the first run; run i uses SEED + i (default: 1)\n");
+	printf("  -f, --fault=FAULT      kill, crash, partition, stall, flaky, none or mixed\n");
+	printf("                         (default: mixed)\n");
+	printf("  -c, --config=FILE      Take monitor and detector settings from a ramd.conf\n");
+	printf("      --drop=P           Segment loss outside flaky runs (default: %.3f)\n",
+		   RAMD_SIM_DROP);
+	printf("      --raft-heartbeat-ms=MS  pgraft.heartbeat_interval (default: %d)\n",
+		   RAMD_SIM_RAFT_HEARTBEAT_MS);
+	printf("      --raft-election-ms=MS   pgraft.election_timeout (default: %d)\n",
+		   RAMD_SIM_RAFT_ELECTION_MS);
+	printf("  -j, --json             One JSON line per run instead of the summary\n");
+	printf("  -v, --verbose          Trace every run's events on virtual time\n");
+	printf("  -h, --help             Show this help message\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+	static struct option long_options[] = {
+		{"nodes", required_argument, 0, 'n'},
+		{"runs", required_argument, 0, 'r'},
+		{"seed", required_argument, 0, 's'},
+		{"fault", required_argument, 0, 'f'},
+		{"config", required_argument, 0, 'c'},
+		{"drop", required_argument, 0, 'd'},
+		{"raft-heartbeat-ms", required_argument, 0, 'H'},
+		{"raft-election-ms", required_argument, 0, 'E'},
+		{"json", no_argument, 0, 'j'},
+		{"verbose", no_argument, 0, 'v'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	ramd_sim_options_t options = {
+		.nodes = RAMD_SIM_DEFAULT_NODES,
+		.runs = RAMD_SIM_DEFAULT_RUNS,
+		.seed = 1,
+		.fault = RAMD_SIM_FAULT_MIXED,
+		.raft_heartbeat_ms = RAMD_SIM_RAFT_HEARTBEAT_MS,
+		.raft_election_ms = RAMD_SIM_RAFT_ELECTION_MS,
+		.drop = RAMD_SIM_DROP
+	};
+	const char *config_file = NULL;
+	ramd_sim_result_t *results;
+	struct timespec start;
+	struct timespec end;
+	bool		failed = false;
+	int			opt;
+
+	while ((opt = getopt_long(argc, argv, "n:r:s:f:c:jvh", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'n':
+				options.nodes = atoi(optarg);
+				break;
+			case 'r':
+				options.runs = atoi(optarg);
+				break;
+			case 's':
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'f':
+				if (!ramd_sim_parse_fault(optarg, &options.fault))
+				{
+					fprintf(stderr, "ramd_sim: unknown fault \"%s\"\n", optarg);
+					return 1;
+				}
+				break;
+			case 'c':
+				config_file = optarg;
+				break;
+			case 'd':
+				options.drop = strtod(optarg, NULL);
+				break;
+			case 'H':
+				options.raft_heartbeat_ms = atoi(optarg);
+				break;
+			case 'E':
+				options.raft_election_ms = atoi(optarg);
+				break;
+			case 'j':
+				options.json = true;
+				break;
+			case 'v':
+				options.verbose = true;
+				break;
+			case 'h':
+				ramd_sim_usage(argv[0]);
+				return 0;
+			default:
+				ramd_sim_usage(argv[0]);
+				return 1;
+		}
+	}
+	if (options.nodes < 3 || options.nodes > RAMD_SIM_MAX_NODES || options.runs < 1 ||
+		options.raft_heartbeat_ms <= 0 || options.raft_election_ms < 2 * options.raft_heartbeat_ms ||
+		options.drop < 0.0 || options.drop >= 1.0)
+	{
+		fprintf(stderr, "ramd_sim: --nodes must be 3 to %d, --runs positive, --drop below 1 and "
+				"the election timeout at least twice the heartbeat\n", RAMD_SIM_MAX_NODES);
+		return 1;
+	}
+
+	/* ramd describes verdict changes itself; the trace has them on virtual time */
+	if (!ramd_logging_init("/dev/null", RAMD_LOG_LEVEL_ERROR, true, false, false))
+		return 1;
+	g_ramd_daemon = calloc(1, sizeof(ramd_daemon_t));
+	results = calloc((size_t) options.runs, sizeof(ramd_sim_result_t));
+	if (!g_ramd_daemon || !results)
+	{
+		fprintf(stderr, "ramd_sim: out of memory\n");
+		return 1;
+	}
+	pthread_mutex_init(&g_ramd_daemon->mutex, NULL);
+	ramd_config_set_defaults(&g_ramd_daemon->config);
+	if (config_file && !ramd_config_load_file(&g_ramd_daemon->config, config_file))
+	{
+		fprintf(stderr, "ramd_sim: cannot load %s\n", config_file);
+		return 1;
+	}
+	if (g_ramd_daemon->config.monitor_interval_ms <= 0)
+	{
+		fprintf(stderr, "ramd_sim: monitor_interval_ms must be positive\n");
+		return 1;
+	}
+
+	g_sim.options = &options;
+	ramd_clock_set(ramd_sim_clock);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int32_t i = 0; i < options.runs; i++)
+	{
+		uint64_t	seed = options.seed + (uint64_t) i;
+		ramd_sim_fault_t fault = options.fault;
+
+		if (fault == RAMD_SIM_FAULT_MIXED)
+			fault = (ramd_sim_fault_t) (seed % RAMD_SIM_FAULT_COUNT);
+		if (options.verbose)
+			printf("--- seed %llu, fault %s\n", (unsigned long long) seed, g_fault_names[fault]);
+		ramd_sim_run(seed, fault, &results[i]);
+		if (options.json)
+			ramd_sim_print_json(&results[i]);
+		failed |= results[i].missed || results[i].false_failover || results[i].violation;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	ramd_clock_set(NULL);
+
+	if (!options.json)
+		ramd_sim_print_summary(results, options.runs,
+							   (double) (end.tv_sec - start.tv_sec) +
+							   (double) (end.tv_nsec - start.tv_nsec) / 1e9);
+
+	free(g_sim.heap);
+	free(results);
+	ramd_logging_cleanup();
+	return failed ? 1 : 0;
+}
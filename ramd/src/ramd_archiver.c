@@ -0,0 +1,817 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_archiver.c
+ *		PostgreSQL Auto-Failover Daemon - Parallel WAL Archiver
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The other half of pgraft's archive module (pgraft_archive.c).  The
+ * server's archiver queues WAL files in the spool directory; here they
+ * are taken archive_batch_size at a time, gzip-compressed and stored by
+ * archive_workers threads at once, and acknowledged as a batch once one
+ * fsync of the archive directory has made every file of it durable.  A
+ * file is written under a temporary name, fsynced and renamed, so the
+ * archive never holds a partial segment.  A file already in the archive
+ * is acknowledged if its contents match and refused otherwise, the same
+ * rule archive_command scripts are expected to follow.
+ *
+ * Archive lag is read from archive_status rather than the spool: .ready
+ * files are every file the server has finished and not yet been told is
+ * archived, including those the module has not queued yet.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "ramd_archiver.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+
+#define RAMD_ARCHIVE_NAME_MAX 64
+#define RAMD_ARCHIVE_READY_SUFFIX ".ready"
+#define RAMD_ARCHIVE_TMP_SUFFIX ".tmp"
+
+typedef struct ramd_archive_job_t
+{
+	char name[RAMD_ARCHIVE_NAME_MAX];
+	bool ok;
+	char error[RAMD_MAX_PATH_LENGTH * 2]; /* room for the path it names */
+	int64_t bytes_read;
+	int64_t bytes_written;
+} ramd_archive_job_t;
+
+typedef struct ramd_archiver_t
+{
+	pthread_mutex_t lock;  /* guards everything below but the paths */
+	pthread_cond_t cond;   /* wakes the dispatcher: stop, or a batch is done */
+	pthread_cond_t work;   /* wakes the workers: stop, or a batch is posted */
+	bool running;
+	pthread_t thread;
+	pthread_t workers[RAMD_ARCHIVE_MAX_WORKERS];
+	int32_t worker_count;
+	const ramd_config_t* config;
+	char spool_dir[RAMD_MAX_PATH_LENGTH];
+	char archive_dir[RAMD_MAX_PATH_LENGTH];
+	char status_dir[RAMD_MAX_PATH_LENGTH];
+	int32_t level;         /* for the batch being stored */
+	ramd_archive_job_t jobs[RAMD_ARCHIVE_MAX_BATCH];
+	int32_t job_count;
+	int32_t next_job;
+	int32_t jobs_left;
+	int64_t lag_checked_ms;
+	ramd_archiver_stats_t stats;
+} ramd_archiver_t;
+
+static ramd_archiver_t g_archiver = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER
+};
+
+static bool
+ramd_archiver_path(char* buf, size_t size, const char* dir, const char* sub, const char* name,
+                   const char* suffix)
+{
+	int len = snprintf(buf, size, "%s%s%s/%s%s", dir, sub ? "/" : "", sub ? sub : "",
+	                   name, suffix ? suffix : "");
+
+	return len > 0 && (size_t) len < size;
+}
+
+static void
+ramd_archiver_fail(ramd_archive_job_t* job, const char* what, const char* path)
+{
+	snprintf(job->error, sizeof(job->error), "%s %s: %s", what, path, strerror(errno));
+	job->ok = false;
+}
+
+/* The absolute path pgraft wrote into the spool entry */
+static bool
+ramd_archiver_read_entry(ramd_archive_job_t* job, char* source, size_t size)
+{
+	char entry[RAMD_MAX_PATH_LENGTH];
+	FILE* f;
+
+	if (!ramd_archiver_path(entry, sizeof(entry), g_archiver.spool_dir, "queue", job->name, NULL))
+	{
+		snprintf(job->error, sizeof(job->error), "spool path too long");
+		return false;
+	}
+	f = fopen(entry, "r");
+	if (!f)
+	{
+		ramd_archiver_fail(job, "cannot open spool entry", entry);
+		return false;
+	}
+	if (!fgets(source, (int) size, f))
+		source[0] = '\0';
+	/* A path that filled the buffer without its newline did not fit */
+	if (strlen(source) == size - 1 && source[size - 2] != '\n' && fgetc(f) != EOF)
+	{
+		fclose(f);
+		snprintf(job->error, sizeof(job->error), "spool entry %s holds a path too long", entry);
+		return false;
+	}
+	fclose(f);
+	source[strcspn(source, "\n")] = '\0';
+	if (source[0] != '/')
+	{
+		snprintf(job->error, sizeof(job->error), "spool entry %s holds no absolute path", entry);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * An earlier attempt, or another node's ramd sharing the archive, may have
+ * stored the file already.  gzread passes uncompressed files through, so
+ * either form compares against the segment's plain contents.  buffer
+ * holds two I/O blocks.
+ */
+static bool
+ramd_archiver_same_contents(const char* archived, int source_fd, char* buffer, bool* same)
+{
+	char* a = buffer;
+	char* b = buffer + RAMD_ARCHIVE_IO_BLOCK;
+	bool ok = true;
+	gzFile gz;
+
+	*same = false;
+	gz = gzopen(archived, "rb");
+	if (!gz)
+		return false;
+	if (lseek(source_fd, 0, SEEK_SET) != 0)
+	{
+		gzclose(gz);
+		return false;
+	}
+	for (;;)
+	{
+		ssize_t m = read(source_fd, a, RAMD_ARCHIVE_IO_BLOCK);
+		int n;
+
+		if (m < 0)
+		{
+			ok = false;
+			break;
+		}
+		/* At the end of the segment the archived copy must end too */
+		n = gzread(gz, b, m > 0 ? (unsigned) m : 1);
+		if (n < 0)
+		{
+			ok = false;
+			break;
+		}
+		if (m == 0)
+		{
+			*same = n == 0;
+			break;
+		}
+		if (n != (int) m || memcmp(a, b, (size_t) m) != 0)
+			break;
+	}
+	gzclose(gz);
+	return ok;
+}
+
+/* Copy or compress source_fd into tmp, then make it durable */
+static bool
+ramd_archiver_write(ramd_archive_job_t* job, int source_fd, const char* tmp, int32_t level,
+                    char* block)
+{
+	gzFile gz = NULL;
+	struct stat st;
+	int fd;
+	bool ok = true;
+
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0)
+	{
+		ramd_archiver_fail(job, "cannot create", tmp);
+		return false;
+	}
+
+	if (level > 0)
+	{
+		char mode[16];
+		int gz_fd = dup(fd);
+
+		snprintf(mode, sizeof(mode), "wb%d", level);
+		gz = gz_fd >= 0 ? gzdopen(gz_fd, mode) : NULL;
+		if (!gz)
+		{
+			if (gz_fd >= 0)
+				close(gz_fd);
+			ramd_archiver_fail(job, "cannot start compressing", tmp);
+			close(fd);
+			unlink(tmp);
+			return false;
+		}
+		gzbuffer(gz, RAMD_ARCHIVE_IO_BLOCK);
+	}
+
+	while (ok)
+	{
+		ssize_t n = read(source_fd, block, RAMD_ARCHIVE_IO_BLOCK);
+
+		if (n < 0)
+		{
+			ramd_archiver_fail(job, "cannot read", job->name);
+			ok = false;
+			break;
+		}
+		if (n == 0)
+			break;
+		job->bytes_read += n;
+		if (gz ? gzwrite(gz, block, (unsigned) n) != (int) n
+		       : write(fd, block, (size_t) n) != n)
+		{
+			ramd_archiver_fail(job, "cannot write", tmp);
+			ok = false;
+		}
+	}
+	if (gz && gzclose(gz) != Z_OK && ok)
+	{
+		ramd_archiver_fail(job, "cannot finish", tmp);
+		ok = false;
+	}
+	if (ok && fsync(fd) != 0)
+	{
+		ramd_archiver_fail(job, "cannot fsync", tmp);
+		ok = false;
+	}
+	if (ok && fstat(fd, &st) == 0)
+		job->bytes_written = (int64_t) st.st_size;
+	close(fd);
+	if (!ok)
+		unlink(tmp);
+	return ok;
+}
+
+static void
+ramd_archiver_store(ramd_archive_job_t* job, int32_t level, char* buffer)
+{
+	const char* suffix = level > 0 ? RAMD_ARCHIVE_COMPRESSED_SUFFIX : NULL;
+	const char* other = level > 0 ? NULL : RAMD_ARCHIVE_COMPRESSED_SUFFIX;
+	char source[RAMD_MAX_PATH_LENGTH];
+	char target[RAMD_MAX_PATH_LENGTH];
+	char existing[RAMD_MAX_PATH_LENGTH];
+	char tmp[RAMD_MAX_PATH_LENGTH + 8];
+	int fd;
+
+	job->ok = false;
+	job->error[0] = '\0';
+	job->bytes_read = 0;
+	job->bytes_written = 0;
+
+	if (!ramd_archiver_read_entry(job, source, sizeof(source)))
+		return;
+	if (!ramd_archiver_path(target, sizeof(target), g_archiver.archive_dir, NULL, job->name, suffix) ||
+	    !ramd_archiver_path(existing, sizeof(existing), g_archiver.archive_dir, NULL, job->name, other))
+	{
+		snprintf(job->error, sizeof(job->error), "archive path too long");
+		return;
+	}
+
+	fd = open(source, O_RDONLY);
+	if (fd < 0)
+	{
+		ramd_archiver_fail(job, "cannot open", source);
+		return;
+	}
+
+	/* Stored before, compressed or not: acknowledge it if it is the same */
+	if (access(target, F_OK) == 0 || access(existing, F_OK) == 0)
+	{
+		const char* found = access(target, F_OK) == 0 ? target : existing;
+		bool same;
+
+		if (!ramd_archiver_same_contents(found, fd, buffer, &same))
+			ramd_archiver_fail(job, "cannot compare with", found);
+		else if (!same)
+			snprintf(job->error, sizeof(job->error),
+			         "%s is already archived with different contents", job->name);
+		else
+			job->ok = true;
+		close(fd);
+		return;
+	}
+
+	if (snprintf(tmp, sizeof(tmp), "%s%s", target, RAMD_ARCHIVE_TMP_SUFFIX) >= (int) sizeof(tmp))
+	{
+		snprintf(job->error, sizeof(job->error), "archive path too long");
+		close(fd);
+		return;
+	}
+	if (ramd_archiver_write(job, fd, tmp, level, buffer))
+	{
+		if (rename(tmp, target) != 0)
+		{
+			ramd_archiver_fail(job, "cannot rename", tmp);
+			unlink(tmp);
+		}
+		else
+			job->ok = true;
+	}
+	close(fd);
+}
+
+static void*
+ramd_archiver_worker(void* arg)
+{
+	char* buffer = ramd_mem_alloc(RAMD_MEM_BACKUP, 2 * RAMD_ARCHIVE_IO_BLOCK);
+
+	(void) arg;
+
+	pthread_mutex_lock(&g_archiver.lock);
+	for (;;)
+	{
+		ramd_archive_job_t* job;
+		int32_t level;
+
+		while (g_archiver.running && g_archiver.next_job >= g_archiver.job_count)
+			pthread_cond_wait(&g_archiver.work, &g_archiver.lock);
+		if (!g_archiver.running)
+			break;
+
+		job = &g_archiver.jobs[g_archiver.next_job++];
+		level = g_archiver.level;
+		pthread_mutex_unlock(&g_archiver.lock);
+
+		if (buffer)
+			ramd_archiver_store(job, level, buffer);
+		else
+		{
+			job->ok = false;
+			snprintf(job->error, sizeof(job->error), "out of memory");
+		}
+
+		pthread_mutex_lock(&g_archiver.lock);
+		if (--g_archiver.jobs_left == 0)
+			pthread_cond_signal(&g_archiver.cond);
+	}
+	pthread_mutex_unlock(&g_archiver.lock);
+	ramd_mem_free(RAMD_MEM_BACKUP, buffer);
+	return NULL;
+}
+
+static int
+ramd_archiver_name_cmp(const void* a, const void* b)
+{
+	return strcmp((const char*) a, (const char*) b);
+}
+
+/*
+ * The oldest queued entries, at most max; names are what PostgreSQL
+ * archives in order, so sorting them stores the next wanted files first.
+ * Sets *queued to the number of entries there are in all.
+ */
+static int32_t
+ramd_archiver_scan_queue(ramd_archive_job_t* jobs, int32_t max, int32_t* queued)
+{
+	static char names[RAMD_ARCHIVE_MAX_QUEUE_SCAN][RAMD_ARCHIVE_NAME_MAX];
+	char dir_path[RAMD_MAX_PATH_LENGTH];
+	struct dirent* de;
+	DIR* dir;
+	int32_t count = 0;
+	int32_t total = 0;
+
+	*queued = 0;
+	if (!ramd_archiver_path(dir_path, sizeof(dir_path), g_archiver.spool_dir, NULL, "queue", NULL))
+	{
+		ramd_log_error("WAL archiver: spool path %s/queue too long", g_archiver.spool_dir);
+		return 0;
+	}
+	dir = opendir(dir_path);
+	if (!dir)
+		return 0;
+
+	while ((de = readdir(dir)) != NULL)
+	{
+		size_t len = strlen(de->d_name);
+		size_t tmp_len = strlen(RAMD_ARCHIVE_TMP_SUFFIX);
+
+		if (de->d_name[0] == '.' || len >= RAMD_ARCHIVE_NAME_MAX ||
+		    (len > tmp_len && strcmp(de->d_name + len - tmp_len, RAMD_ARCHIVE_TMP_SUFFIX) == 0))
+			continue;
+		total++;
+		if (count < RAMD_ARCHIVE_MAX_QUEUE_SCAN)
+			memcpy(names[count++], de->d_name, len + 1);
+	}
+	closedir(dir);
+
+	qsort(names, (size_t) count, sizeof(names[0]), ramd_archiver_name_cmp);
+	if (count > max)
+		count = max;
+	for (int32_t i = 0; i < count; i++)
+		memcpy(jobs[i].name, names[i], sizeof(jobs[i].name));
+	*queued = total;
+	return count;
+}
+
+/* How much the server has waiting to be archived, and for how long */
+static void
+ramd_archiver_measure_lag(int32_t* pending, int64_t* lag_ms)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	size_t suffix_len = strlen(RAMD_ARCHIVE_READY_SUFFIX);
+	time_t oldest = 0;
+	struct dirent* de;
+	struct stat st;
+	DIR* dir;
+
+	*pending = 0;
+	*lag_ms = 0;
+	dir = opendir(g_archiver.status_dir);
+	if (!dir)
+		return;
+	while ((de = readdir(dir)) != NULL)
+	{
+		size_t len = strlen(de->d_name);
+
+		if (len <= suffix_len ||
+		    strcmp(de->d_name + len - suffix_len, RAMD_ARCHIVE_READY_SUFFIX) != 0)
+			continue;
+		(*pending)++;
+		if (snprintf(path, sizeof(path), "%s/%s", g_archiver.status_dir, de->d_name) <
+		        (int) sizeof(path) &&
+		    stat(path, &st) == 0 && (oldest == 0 || st.st_mtime < oldest))
+			oldest = st.st_mtime;
+	}
+	closedir(dir);
+
+	if (oldest != 0 && time(NULL) > oldest)
+		*lag_ms = (int64_t) (time(NULL) - oldest) * 1000;
+}
+
+static bool
+ramd_archiver_fsync_dir(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	bool ok;
+
+	if (fd < 0)
+		return false;
+	ok = fsync(fd) == 0 || errno == EINVAL;
+	close(fd);
+	return ok;
+}
+
+/* Tell pgraft how each file of the batch went, then clear its entries */
+static void
+ramd_archiver_acknowledge(ramd_archive_job_t* jobs, int32_t count)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	char entry[RAMD_MAX_PATH_LENGTH];
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_archive_job_t* job = &jobs[i];
+		FILE* f;
+
+		if (!ramd_archiver_path(path, sizeof(path), g_archiver.spool_dir,
+		                        job->ok ? "done" : "error", job->name, NULL) ||
+		    !ramd_archiver_path(entry, sizeof(entry), g_archiver.spool_dir, "queue", job->name, NULL))
+			continue;
+
+		/* done/ before the entry goes, or pgraft could queue the file again */
+		f = fopen(path, "w");
+		if (!f)
+		{
+			ramd_log_error("WAL archiver: cannot write %s: %s", path, strerror(errno));
+			continue;
+		}
+		if (!job->ok)
+			fprintf(f, "%s\n", job->error);
+		fclose(f);
+		unlink(entry);
+
+		if (!job->ok)
+			ramd_log_warning("WAL archiver: %s not archived: %s", job->name, job->error);
+	}
+}
+
+/* Store one batch; true if it was acknowledged and more files are queued */
+static bool
+ramd_archiver_run_batch(void)
+{
+	const ramd_config_t* config = g_archiver.config;
+	int32_t batch_size = config->archive_batch_size;
+	int32_t count;
+	int32_t queued;
+	int32_t stored = 0;
+	int64_t read = 0;
+	int64_t written = 0;
+	int64_t now_ms;
+
+	if (batch_size > RAMD_ARCHIVE_MAX_BATCH)
+		batch_size = RAMD_ARCHIVE_MAX_BATCH;
+	count = ramd_archiver_scan_queue(g_archiver.jobs, batch_size, &queued);
+
+	now_ms = ramd_clock_now_ms();
+	if (now_ms - g_archiver.lag_checked_ms >= RAMD_ARCHIVE_LAG_INTERVAL_MS)
+	{
+		int32_t pending;
+		int64_t lag_ms;
+
+		ramd_archiver_measure_lag(&pending, &lag_ms);
+		g_archiver.lag_checked_ms = now_ms;
+		pthread_mutex_lock(&g_archiver.lock);
+		g_archiver.stats.pending = pending;
+		g_archiver.stats.lag_ms = lag_ms;
+		pthread_mutex_unlock(&g_archiver.lock);
+	}
+
+	pthread_mutex_lock(&g_archiver.lock);
+	g_archiver.stats.queued = queued;
+	if (count == 0 || !g_archiver.running)
+	{
+		pthread_mutex_unlock(&g_archiver.lock);
+		return false;
+	}
+
+	g_archiver.level = config->archive_compression_level;
+	g_archiver.job_count = count;
+	g_archiver.next_job = 0;
+	g_archiver.jobs_left = count;
+	pthread_cond_broadcast(&g_archiver.work);
+	while (g_archiver.jobs_left > 0)
+		pthread_cond_wait(&g_archiver.cond, &g_archiver.lock);
+	g_archiver.job_count = 0;
+	g_archiver.next_job = 0;
+	pthread_mutex_unlock(&g_archiver.lock);
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (!g_archiver.jobs[i].ok)
+			continue;
+		stored++;
+		read += g_archiver.jobs[i].bytes_read;
+		written += g_archiver.jobs[i].bytes_written;
+	}
+
+	/* One fsync makes every rename of the batch durable */
+	if (stored > 0 && !ramd_archiver_fsync_dir(g_archiver.archive_dir))
+	{
+		ramd_log_error("WAL archiver: cannot fsync %s: %s; retrying the batch",
+		               g_archiver.archive_dir, strerror(errno));
+		return false;
+	}
+	ramd_archiver_acknowledge(g_archiver.jobs, count);
+
+	pthread_mutex_lock(&g_archiver.lock);
+	g_archiver.stats.archived += stored;
+	g_archiver.stats.failed += count - stored;
+	g_archiver.stats.batches++;
+	g_archiver.stats.bytes_read += read;
+	g_archiver.stats.bytes_written += written;
+	g_archiver.stats.queued = queued > count ? queued - count : 0;
+	for (int32_t i = count - 1; i >= 0; i--)
+	{
+		if (g_archiver.jobs[i].ok)
+		{
+			g_archiver.stats.last_archived_ms = ramd_clock_now_ms();
+			snprintf(g_archiver.stats.last_archived, sizeof(g_archiver.stats.last_archived),
+			         "%s", g_archiver.jobs[i].name);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_archiver.lock);
+
+	ramd_log_debug("WAL archiver: stored %d of %d files, %lld bytes in %lld",
+	               stored, count, (long long) read, (long long) written);
+	return queued > count;
+}
+
+static void*
+ramd_archiver_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_archiver.lock);
+	while (g_archiver.running)
+	{
+		struct timespec deadline;
+		bool more;
+
+		pthread_mutex_unlock(&g_archiver.lock);
+		more = ramd_archiver_run_batch();
+
+		pthread_mutex_lock(&g_archiver.lock);
+		if (!g_archiver.running || more)
+			continue;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += (long) RAMD_ARCHIVE_POLL_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&g_archiver.cond, &g_archiver.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_archiver.lock);
+	return NULL;
+}
+
+static bool
+ramd_archiver_resolve_paths(const ramd_config_t* config)
+{
+	const char* archive_dir = config->archive_dir;
+	const char* spool = config->archive_spool_dir[0] ? config->archive_spool_dir
+	                                                 : RAMD_ARCHIVE_SPOOL_DIR;
+	int len;
+
+	if (!archive_dir[0])
+		archive_dir = getenv("PGARCHIVE");
+	if (!archive_dir || !archive_dir[0])
+		archive_dir = RAMD_DEFAULT_PG_ARCHIVE_DIR;
+
+	/* Relative like pgraft.archive_spool_dir: from the data directory */
+	if (spool[0] == '/')
+		len = snprintf(g_archiver.spool_dir, sizeof(g_archiver.spool_dir), "%s", spool);
+	else
+		len = snprintf(g_archiver.spool_dir, sizeof(g_archiver.spool_dir), "%s/%s",
+		               config->postgresql_data_dir, spool);
+	if (len <= 0 || (size_t) len >= sizeof(g_archiver.spool_dir))
+		return false;
+
+	len = snprintf(g_archiver.archive_dir, sizeof(g_archiver.archive_dir), "%s", archive_dir);
+	if (len <= 0 || (size_t) len >= sizeof(g_archiver.archive_dir))
+		return false;
+
+	len = snprintf(g_archiver.status_dir, sizeof(g_archiver.status_dir), "%s/pg_wal/archive_status",
+	               config->postgresql_data_dir);
+	return len > 0 && (size_t) len < sizeof(g_archiver.status_dir);
+}
+
+bool
+ramd_archiver_start(const ramd_config_t* config)
+{
+	int32_t wanted;
+
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_archiver.lock);
+	g_archiver.config = config;
+	if (g_archiver.running || !config->archive_enabled)
+	{
+		pthread_mutex_unlock(&g_archiver.lock);
+		return true;
+	}
+
+	if (!ramd_archiver_resolve_paths(config))
+	{
+		pthread_mutex_unlock(&g_archiver.lock);
+		ramd_log_error("WAL archiver: archive_dir or archive_spool_dir is too long");
+		return false;
+	}
+	if (mkdir(g_archiver.archive_dir, 0700) != 0 && errno != EEXIST)
+	{
+		pthread_mutex_unlock(&g_archiver.lock);
+		ramd_log_error("WAL archiver: cannot create %s: %s", g_archiver.archive_dir,
+		               strerror(errno));
+		return false;
+	}
+
+	memset(&g_archiver.stats, 0, sizeof(g_archiver.stats));
+	g_archiver.job_count = 0;
+	g_archiver.next_job = 0;
+	g_archiver.jobs_left = 0;
+	g_archiver.lag_checked_ms = 0;
+	g_archiver.running = true;
+
+	wanted = config->archive_workers;
+	if (wanted > RAMD_ARCHIVE_MAX_WORKERS)
+		wanted = RAMD_ARCHIVE_MAX_WORKERS;
+	for (g_archiver.worker_count = 0; g_archiver.worker_count < wanted; g_archiver.worker_count++)
+		if (pthread_create(&g_archiver.workers[g_archiver.worker_count], NULL,
+		                   ramd_archiver_worker, NULL) != 0)
+			break;
+
+	if (g_archiver.worker_count == 0 ||
+	    pthread_create(&g_archiver.thread, NULL, ramd_archiver_thread_main, NULL) != 0)
+	{
+		int32_t started = g_archiver.worker_count;
+
+		g_archiver.running = false;
+		pthread_cond_broadcast(&g_archiver.work);
+		pthread_mutex_unlock(&g_archiver.lock);
+		for (int32_t i = 0; i < started; i++)
+			pthread_join(g_archiver.workers[i], NULL);
+		g_archiver.worker_count = 0;
+		ramd_log_error("WAL archiver: cannot start threads: %s", strerror(errno));
+		return false;
+	}
+	g_archiver.stats.running = true;
+	g_archiver.stats.workers = g_archiver.worker_count;
+	pthread_mutex_unlock(&g_archiver.lock);
+
+	ramd_log_info("WAL archiver started: %d workers, batches of %d, spool %s, archive %s",
+	              g_archiver.worker_count, config->archive_batch_size, g_archiver.spool_dir,
+	              g_archiver.archive_dir);
+	return true;
+}
+
+void
+ramd_archiver_stop(void)
+{
+	int32_t workers;
+
+	pthread_mutex_lock(&g_archiver.lock);
+	if (!g_archiver.running)
+	{
+		pthread_mutex_unlock(&g_archiver.lock);
+		return;
+	}
+	/* A batch in flight finishes first: the dispatcher waits for its workers */
+	g_archiver.running = false;
+	g_archiver.stats.running = false;
+	pthread_cond_broadcast(&g_archiver.cond);
+	pthread_mutex_unlock(&g_archiver.lock);
+
+	pthread_join(g_archiver.thread, NULL);
+
+	pthread_mutex_lock(&g_archiver.lock);
+	workers = g_archiver.worker_count;
+	pthread_cond_broadcast(&g_archiver.work);
+	pthread_mutex_unlock(&g_archiver.lock);
+	for (int32_t i = 0; i < workers; i++)
+		pthread_join(g_archiver.workers[i], NULL);
+	g_archiver.worker_count = 0;
+}
+
+bool
+ramd_archiver_get_stats(ramd_archiver_stats_t* stats)
+{
+	bool running;
+
+	if (!stats)
+		return false;
+	pthread_mutex_lock(&g_archiver.lock);
+	*stats = g_archiver.stats;
+	running = g_archiver.running;
+	pthread_mutex_unlock(&g_archiver.lock);
+	return running;
+}
+
+bool
+ramd_archiver_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_archiver_stats_t stats;
+	bool ok = true;
+
+	if (!output)
+		return false;
+	if (!ramd_archiver_get_stats(&stats))
+		return true; /* archive_enabled is off */
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_archive_lag_seconds Age of the oldest WAL file waiting to be archived\n"
+		"# TYPE ramd_archive_lag_seconds gauge\n"
+		"ramd_archive_lag_seconds %.3f\n"
+		"\n# HELP ramd_archive_pending_files WAL files the server has not been told are archived\n"
+		"# TYPE ramd_archive_pending_files gauge\n"
+		"ramd_archive_pending_files %d\n"
+		"\n# HELP ramd_archive_queued_files WAL files handed to ramd and not yet acknowledged\n"
+		"# TYPE ramd_archive_queued_files gauge\n"
+		"ramd_archive_queued_files %d\n",
+		(double) stats.lag_ms / 1000.0, stats.pending, stats.queued);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_archive_files_total WAL files answered by the archiver\n"
+		"# TYPE ramd_archive_files_total counter\n"
+		"ramd_archive_files_total{result=\"archived\"} %lld\n"
+		"ramd_archive_files_total{result=\"failed\"} %lld\n"
+		"\n# HELP ramd_archive_batches_total Acknowledgement rounds\n"
+		"# TYPE ramd_archive_batches_total counter\n"
+		"ramd_archive_batches_total %lld\n"
+		"\n# HELP ramd_archive_bytes_total WAL read and what it takes in the archive\n"
+		"# TYPE ramd_archive_bytes_total counter\n"
+		"ramd_archive_bytes_total{stage=\"read\"} %lld\n"
+		"ramd_archive_bytes_total{stage=\"written\"} %lld\n",
+		(long long) stats.archived, (long long) stats.failed, (long long) stats.batches,
+		(long long) stats.bytes_read, (long long) stats.bytes_written);
+
+	if (stats.last_archived_ms > 0)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_archive_last_archived_age_seconds Time since a WAL file was last stored\n"
+			"# TYPE ramd_archive_last_archived_age_seconds gauge\n"
+			"ramd_archive_last_archived_age_seconds %.3f\n",
+			(double) (ramd_clock_now_ms() - stats.last_archived_ms) / 1000.0);
+	return ok;
+}
@@ -0,0 +1,819 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_audit_log.c
+ *		PostgreSQL Auto-Failover Daemon - Persistent Audit Log
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Audit records are appended to fixed-size segment files mapped into
+ * memory.  A writer reserves its bytes with one atomic add on the segment
+ * tail, copies the record in and publishes it by storing its length last,
+ * so authentication never waits on a lock or on the disk.  The writer
+ * whose reservation runs off the end marks the rest of the segment as
+ * padding and starts the next one; that is the only step under a lock.
+ * A thread writes the mapped pages back every RAMD_AUDIT_SYNC_INTERVAL_MS:
+ * a crash of ramd loses nothing, a crash of the host at most that much.
+ *
+ * Each segment header keeps the time range of its records and, per
+ * RAMD_AUDIT_INDEX_BLOCK of records, the range of the records starting
+ * in it and where the first of them is.  A time-range read skips
+ * segments and blocks outside the range without touching their pages.
+ *
+ * Mappings live in RAMD_AUDIT_MAPPED_SEGMENTS slots used in turn.  A
+ * thread holds a reference on the slot it writes to or reads, and a slot
+ * is only unmapped or reused once it is no longer the active one and no
+ * references are left.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ramd_audit_log.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+#define RAMD_AUDIT_MAGIC     "RAMAUDT1"
+#define RAMD_AUDIT_FORMAT    1
+#define RAMD_AUDIT_FILE_NAME "audit-%016llx.seg"
+#define RAMD_AUDIT_PAD       0x80000000u /* in length: the rest of the segment is unused */
+#define RAMD_AUDIT_DATA_SIZE (RAMD_AUDIT_SEGMENT_SIZE - RAMD_AUDIT_SEGMENT_HEADER)
+#define RAMD_AUDIT_BLOCKS \
+	((RAMD_AUDIT_DATA_SIZE + RAMD_AUDIT_INDEX_BLOCK - 1) / RAMD_AUDIT_INDEX_BLOCK)
+
+/* Index entry for one block of records */
+typedef struct ramd_audit_block_t
+{
+	_Atomic uint32_t first; /* offset of the first record starting here, 0 if unknown */
+	uint32_t reserved;
+	_Atomic int64_t min_ts_us; /* INT64_MAX while no record starts here */
+	_Atomic int64_t max_ts_us;
+} ramd_audit_block_t;
+
+/* Start of every segment file */
+typedef struct ramd_audit_segment_header_t
+{
+	char magic[8];
+	uint32_t format;
+	uint32_t header_size;
+	uint32_t segment_size;
+	uint32_t block_size;
+	uint64_t sequence;
+	int64_t created_us;
+	_Atomic int64_t min_ts_us;
+	_Atomic int64_t max_ts_us;
+	ramd_audit_block_t blocks[RAMD_AUDIT_BLOCKS];
+} ramd_audit_segment_header_t;
+
+/* One event; the strings follow without terminators, padded to 8 bytes */
+typedef struct ramd_audit_record_t
+{
+	_Atomic uint32_t length; /* whole record; stored last, 0 until then */
+	uint8_t result;
+	uint8_t client_ip_length;
+	uint16_t user_length;
+	int64_t ts_us;
+	uint16_t action_length;
+	uint16_t resource_length;
+	uint16_t details_length;
+	uint16_t reserved;
+} ramd_audit_record_t;
+
+_Static_assert(sizeof(ramd_audit_segment_header_t) <= RAMD_AUDIT_SEGMENT_HEADER,
+               "the block index must fit in the segment header");
+_Static_assert(sizeof(ramd_audit_record_t) == 24, "audit records are 8-byte aligned");
+
+typedef struct ramd_audit_slot_t
+{
+	_Alignas(RAMD_CACHE_LINE_SIZE) _Atomic uint64_t tail; /* next free offset, may pass the end */
+	_Atomic int32_t refs;
+	unsigned char* base; /* NULL while unmapped */
+	int fd;              /* -1 for a segment kept in memory */
+	uint64_t sequence;
+	uint64_t synced;     /* written back up to here; the sync thread's */
+} ramd_audit_slot_t;
+
+typedef struct ramd_audit_state_t
+{
+	pthread_mutex_t lock; /* guards everything but active and the slots' counters */
+	pthread_cond_t cond;
+	_Atomic int32_t active; /* slot appends go to, -1 before the first */
+	ramd_audit_slot_t slots[RAMD_AUDIT_MAPPED_SEGMENTS];
+	char dir[RAMD_MAX_PATH_LENGTH]; /* empty: memory only */
+	int64_t retain_bytes;
+	uint64_t next_sequence;
+	uint64_t segments[RAMD_AUDIT_MAX_SEGMENTS]; /* files, oldest first, the active one last */
+	int32_t segment_count;
+	bool running;
+	pthread_t thread;
+	_Atomic uint64_t dropped;
+} ramd_audit_state_t;
+
+static ramd_audit_state_t g_audit = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.active = -1,
+	.next_sequence = 1,
+};
+
+static int64_t
+ramd_audit_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+ramd_audit_min(_Atomic int64_t* value, int64_t x)
+{
+	int64_t current = atomic_load_explicit(value, memory_order_relaxed);
+
+	while (x < current &&
+	       !atomic_compare_exchange_weak_explicit(value, &current, x, memory_order_relaxed,
+	                                              memory_order_relaxed))
+		;
+}
+
+static void
+ramd_audit_max(_Atomic int64_t* value, int64_t x)
+{
+	int64_t current = atomic_load_explicit(value, memory_order_relaxed);
+
+	while (x > current &&
+	       !atomic_compare_exchange_weak_explicit(value, &current, x, memory_order_relaxed,
+	                                              memory_order_relaxed))
+		;
+}
+
+/* A reference on the active slot, or -1 when there is none */
+static int32_t
+ramd_audit_acquire(void)
+{
+	for (;;)
+	{
+		int32_t index = atomic_load(&g_audit.active);
+
+		if (index < 0)
+			return -1;
+		atomic_fetch_add(&g_audit.slots[index].refs, 1);
+		/* The slot may have been retired in between; it is not touched then */
+		if (atomic_load(&g_audit.active) == index)
+			return index;
+		atomic_fetch_sub(&g_audit.slots[index].refs, 1);
+	}
+}
+
+static void
+ramd_audit_release(int32_t index)
+{
+	atomic_fetch_sub(&g_audit.slots[index].refs, 1);
+}
+
+static void
+ramd_audit_segment_path(char* path, size_t size, uint64_t sequence)
+{
+	snprintf(path, size, "%s/" RAMD_AUDIT_FILE_NAME, g_audit.dir,
+	         (unsigned long long) sequence);
+}
+
+/*
+ * Write back and unmap a retired slot.  Called with the lock held; false
+ * if wait is not set and a reader or a late writer still holds it.
+ */
+static bool
+ramd_audit_slot_unmap(ramd_audit_slot_t* slot, bool wait)
+{
+	while (atomic_load(&slot->refs) != 0)
+	{
+		if (!wait)
+			return false;
+		sched_yield();
+	}
+	if (!slot->base)
+		return true;
+
+	if (slot->fd >= 0)
+	{
+		msync(slot->base, RAMD_AUDIT_SEGMENT_SIZE, MS_SYNC);
+		close(slot->fd);
+	}
+	munmap(slot->base, RAMD_AUDIT_SEGMENT_SIZE);
+	slot->base = NULL;
+	slot->fd = -1;
+	return true;
+}
+
+/* Map a new segment into slot: a file under dir, or memory if that fails */
+static bool
+ramd_audit_slot_map(ramd_audit_slot_t* slot)
+{
+	ramd_audit_segment_header_t* header;
+	char path[RAMD_MAX_PATH_LENGTH + 32];
+	void* map = MAP_FAILED;
+	uint64_t sequence = 0;
+	int fd = -1;
+	int rc;
+
+	for (int attempt = 0; g_audit.dir[0] != '\0' && attempt < 8; attempt++)
+	{
+		sequence = g_audit.next_sequence++;
+		ramd_audit_segment_path(path, sizeof(path), sequence);
+		fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+		if (fd >= 0 || errno != EEXIST)
+			break;
+	}
+	if (fd >= 0)
+	{
+		/* Allocated up front: a full disk must not turn into SIGBUS on a store */
+		rc = posix_fallocate(fd, 0, RAMD_AUDIT_SEGMENT_SIZE);
+		if (rc == 0)
+			map = mmap(NULL, RAMD_AUDIT_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+			           0);
+		else
+			errno = rc;
+		if (map == MAP_FAILED)
+		{
+			ramd_log_error("Audit log: cannot allocate %s: %s; keeping audit records in "
+			               "memory",
+			               path, strerror(errno));
+			close(fd);
+			unlink(path);
+			fd = -1;
+		}
+	}
+	else if (g_audit.dir[0] != '\0')
+		ramd_log_error("Audit log: cannot create a segment in %s: %s; keeping audit records "
+		               "in memory",
+		               g_audit.dir, strerror(errno));
+
+	if (map == MAP_FAILED)
+	{
+		map = mmap(NULL, RAMD_AUDIT_SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+		           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map == MAP_FAILED)
+			return false;
+		sequence = 0;
+	}
+
+	header = (ramd_audit_segment_header_t*) map;
+	memcpy(header->magic, RAMD_AUDIT_MAGIC, sizeof(header->magic));
+	header->format = RAMD_AUDIT_FORMAT;
+	header->header_size = RAMD_AUDIT_SEGMENT_HEADER;
+	header->segment_size = RAMD_AUDIT_SEGMENT_SIZE;
+	header->block_size = RAMD_AUDIT_INDEX_BLOCK;
+	header->sequence = sequence;
+	header->created_us = ramd_audit_now_us();
+	atomic_init(&header->min_ts_us, INT64_MAX);
+	atomic_init(&header->max_ts_us, INT64_MIN);
+	for (int i = 0; i < RAMD_AUDIT_BLOCKS; i++)
+	{
+		atomic_init(&header->blocks[i].first, 0);
+		atomic_init(&header->blocks[i].min_ts_us, INT64_MAX);
+		atomic_init(&header->blocks[i].max_ts_us, INT64_MIN);
+	}
+	atomic_init(&header->blocks[0].first, RAMD_AUDIT_SEGMENT_HEADER);
+
+	slot->base = map;
+	slot->fd = fd;
+	slot->sequence = sequence;
+	slot->synced = 0;
+	atomic_store(&slot->tail, RAMD_AUDIT_SEGMENT_HEADER);
+	return true;
+}
+
+/* Drop the oldest files past retain_bytes; the active one always stays */
+static void
+ramd_audit_retain(void)
+{
+	char path[RAMD_MAX_PATH_LENGTH + 32];
+	int32_t drop = 0;
+
+	while (g_audit.segment_count - drop > 1 &&
+	       (g_audit.segment_count - drop >= RAMD_AUDIT_MAX_SEGMENTS ||
+	        (int64_t) (g_audit.segment_count - drop) * RAMD_AUDIT_SEGMENT_SIZE >
+	            g_audit.retain_bytes))
+	{
+		ramd_audit_segment_path(path, sizeof(path), g_audit.segments[drop]);
+		if (unlink(path) != 0 && errno != ENOENT)
+			ramd_log_warning("Audit log: cannot remove %s: %s", path, strerror(errno));
+		drop++;
+	}
+	if (drop > 0)
+	{
+		memmove(g_audit.segments, g_audit.segments + drop,
+		        sizeof(uint64_t) * (size_t) (g_audit.segment_count - drop));
+		g_audit.segment_count -= drop;
+	}
+}
+
+/*
+ * Start the next segment if expected is still the active slot; whoever
+ * filled it and everyone who came after race here, the first one wins.
+ */
+static bool
+ramd_audit_rotate(int32_t expected)
+{
+	ramd_audit_slot_t* slot;
+	int32_t index;
+
+	pthread_mutex_lock(&g_audit.lock);
+	if (atomic_load(&g_audit.active) != expected)
+	{
+		pthread_mutex_unlock(&g_audit.lock);
+		return true;
+	}
+
+	index = expected < 0 ? 0 : (expected + 1) % RAMD_AUDIT_MAPPED_SEGMENTS;
+	slot = &g_audit.slots[index];
+	ramd_audit_slot_unmap(slot, true);
+	if (!ramd_audit_slot_map(slot))
+	{
+		pthread_mutex_unlock(&g_audit.lock);
+		return false;
+	}
+	atomic_store(&g_audit.active, index);
+
+	if (slot->fd >= 0)
+	{
+		g_audit.segments[g_audit.segment_count++] = slot->sequence;
+		ramd_audit_retain();
+	}
+	pthread_mutex_unlock(&g_audit.lock);
+	return true;
+}
+
+void
+ramd_audit_log_append(const char* client_ip, const char* user, const char* action,
+                      const char* resource, int result, const char* details)
+{
+	const char* fields[5] = { client_ip, user, action, resource, details };
+	const size_t limits[5] = { INET_ADDRSTRLEN - 1, RAMD_MAX_USERNAME_LENGTH - 1,
+		                       RAMD_MAX_COMMAND_LENGTH - 1, RAMD_MAX_PATH_LENGTH - 1,
+		                       RAMD_MAX_COMMAND_LENGTH - 1 };
+	size_t lengths[5];
+	size_t size = sizeof(ramd_audit_record_t);
+	int64_t ts_us = ramd_audit_now_us();
+
+	for (int i = 0; i < 5; i++)
+	{
+		lengths[i] = fields[i] ? strnlen(fields[i], limits[i]) : 0;
+		size += lengths[i];
+	}
+	size = (size + 7) & ~(size_t) 7;
+
+	for (int attempt = 0; attempt < RAMD_AUDIT_MAPPED_SEGMENTS; attempt++)
+	{
+		ramd_audit_segment_header_t* header;
+		ramd_audit_record_t* record;
+		ramd_audit_slot_t* slot;
+		unsigned char* out;
+		uint64_t offset;
+		uint64_t end;
+		uint32_t block;
+		int32_t index = ramd_audit_acquire();
+
+		if (index < 0)
+		{
+			if (!ramd_audit_rotate(-1))
+				break;
+			continue;
+		}
+
+		slot = &g_audit.slots[index];
+		offset = atomic_fetch_add(&slot->tail, size);
+		end = offset + size;
+		if (end > RAMD_AUDIT_SEGMENT_SIZE)
+		{
+			/* Only the first writer past the end finds room for the marker */
+			if (offset < RAMD_AUDIT_SEGMENT_SIZE)
+				atomic_store_explicit(
+				    &((ramd_audit_record_t*) (slot->base + offset))->length,
+				    (uint32_t) (RAMD_AUDIT_SEGMENT_SIZE - offset) | RAMD_AUDIT_PAD,
+				    memory_order_release);
+			ramd_audit_release(index);
+			if (!ramd_audit_rotate(index))
+				break;
+			continue;
+		}
+
+		header = (ramd_audit_segment_header_t*) slot->base;
+		record = (ramd_audit_record_t*) (slot->base + offset);
+		record->result = (uint8_t) (result != 0);
+		record->client_ip_length = (uint8_t) lengths[0];
+		record->user_length = (uint16_t) lengths[1];
+		record->ts_us = ts_us;
+		record->action_length = (uint16_t) lengths[2];
+		record->resource_length = (uint16_t) lengths[3];
+		record->details_length = (uint16_t) lengths[4];
+		record->reserved = 0;
+		out = (unsigned char*) (record + 1);
+		for (int i = 0; i < 5; i++)
+		{
+			if (lengths[i] > 0)
+				memcpy(out, fields[i], lengths[i]);
+			out += lengths[i];
+		}
+
+		block = (uint32_t) ((offset - RAMD_AUDIT_SEGMENT_HEADER) / RAMD_AUDIT_INDEX_BLOCK);
+		ramd_audit_min(&header->blocks[block].min_ts_us, ts_us);
+		ramd_audit_max(&header->blocks[block].max_ts_us, ts_us);
+		ramd_audit_min(&header->min_ts_us, ts_us);
+		ramd_audit_max(&header->max_ts_us, ts_us);
+		/* Ending in a later block makes the next record that block's first */
+		if (end < RAMD_AUDIT_SEGMENT_SIZE &&
+		    (end - RAMD_AUDIT_SEGMENT_HEADER) / RAMD_AUDIT_INDEX_BLOCK != block)
+			atomic_store_explicit(
+			    &header->blocks[(end - RAMD_AUDIT_SEGMENT_HEADER) / RAMD_AUDIT_INDEX_BLOCK]
+			         .first,
+			    (uint32_t) end, memory_order_relaxed);
+
+		atomic_store_explicit(&record->length, (uint32_t) size, memory_order_release);
+		ramd_audit_release(index);
+		return;
+	}
+
+	if (atomic_fetch_add(&g_audit.dropped, 1) == 0)
+		ramd_log_error("Audit log: out of memory for a new segment, audit records are being "
+		               "dropped");
+}
+
+static void
+ramd_audit_copy_field(char* out, size_t size, const unsigned char** in, size_t length)
+{
+	size_t n = length < size - 1 ? length : size - 1;
+
+	memcpy(out, *in, n);
+	out[n] = '\0';
+	*in += length;
+}
+
+static void
+ramd_audit_decode(const ramd_audit_record_t* record, ramd_audit_entry_t* entry)
+{
+	const unsigned char* in = (const unsigned char*) (record + 1);
+
+	entry->timestamp = (time_t) (record->ts_us / 1000000);
+	entry->result = record->result;
+	ramd_audit_copy_field(entry->client_ip, sizeof(entry->client_ip), &in,
+	                      record->client_ip_length);
+	ramd_audit_copy_field(entry->user, sizeof(entry->user), &in, record->user_length);
+	ramd_audit_copy_field(entry->action, sizeof(entry->action), &in, record->action_length);
+	ramd_audit_copy_field(entry->resource, sizeof(entry->resource), &in,
+	                      record->resource_length);
+	ramd_audit_copy_field(entry->details, sizeof(entry->details), &in,
+	                      record->details_length);
+}
+
+static bool
+ramd_audit_outside(_Atomic int64_t* min_ts_us, _Atomic int64_t* max_ts_us, int64_t from_us,
+                   int64_t until_us)
+{
+	return atomic_load_explicit(max_ts_us, memory_order_acquire) < from_us ||
+	       atomic_load_explicit(min_ts_us, memory_order_acquire) > until_us;
+}
+
+/*
+ * Walk the records of one segment in [from_us, until_us] in order and
+ * return how many there are.  Matches skip .. skip + take - 1 go into out
+ * newest first.
+ */
+static int32_t
+ramd_audit_scan(unsigned char* base, int64_t from_us, int64_t until_us, int32_t skip,
+                ramd_audit_entry_t* out, int32_t take)
+{
+	ramd_audit_segment_header_t* header = (ramd_audit_segment_header_t*) base;
+	uint64_t position = RAMD_AUDIT_SEGMENT_HEADER;
+	int32_t matches = 0;
+
+	if (ramd_audit_outside(&header->min_ts_us, &header->max_ts_us, from_us, until_us))
+		return 0;
+
+	while (position + sizeof(ramd_audit_record_t) <= RAMD_AUDIT_SEGMENT_SIZE)
+	{
+		uint32_t block = (uint32_t) ((position - RAMD_AUDIT_SEGMENT_HEADER) /
+		                             RAMD_AUDIT_INDEX_BLOCK);
+		ramd_audit_record_t* record = (ramd_audit_record_t*) (base + position);
+		uint32_t length;
+
+		if (block + 1 < RAMD_AUDIT_BLOCKS &&
+		    ramd_audit_outside(&header->blocks[block].min_ts_us,
+		                       &header->blocks[block].max_ts_us, from_us, until_us))
+		{
+			uint32_t next = atomic_load_explicit(&header->blocks[block + 1].first,
+			                                     memory_order_relaxed);
+
+			if (next > position)
+			{
+				position = next;
+				continue;
+			}
+		}
+
+		length = atomic_load_explicit(&record->length, memory_order_acquire);
+		if (length == 0 || (length & RAMD_AUDIT_PAD) != 0)
+			break;
+		/* A torn write from an earlier crash ends the segment */
+		if (length < sizeof(ramd_audit_record_t) ||
+		    position + length > RAMD_AUDIT_SEGMENT_SIZE ||
+		    sizeof(ramd_audit_record_t) + (size_t) record->client_ip_length +
+		            record->user_length + record->action_length + record->resource_length +
+		            record->details_length >
+		        length)
+			break;
+
+		if (record->ts_us >= from_us && record->ts_us <= until_us)
+		{
+			if (out && matches >= skip && matches < skip + take)
+				ramd_audit_decode(record, &out[take - 1 - (matches - skip)]);
+			matches++;
+		}
+		position += length;
+	}
+	return matches;
+}
+
+/* Newest first matches of a segment, appended to entries[*count] onwards */
+static void
+ramd_audit_collect(unsigned char* base, int64_t from_us, int64_t until_us,
+                   ramd_audit_entry_t* entries, int max, int* count)
+{
+	int32_t matches = ramd_audit_scan(base, from_us, until_us, 0, NULL, 0);
+	int32_t take = matches < max - *count ? matches : max - *count;
+
+	if (take <= 0)
+		return;
+	/* Records committed since the count land past the window and are left out */
+	ramd_audit_scan(base, from_us, until_us, matches - take, entries + *count, take);
+	*count += take;
+}
+
+/* Map one closed segment file read-only and collect from it */
+static void
+ramd_audit_collect_file(uint64_t sequence, int64_t from_us, int64_t until_us,
+                        ramd_audit_entry_t* entries, int max, int* count)
+{
+	const ramd_audit_segment_header_t* header;
+	char path[RAMD_MAX_PATH_LENGTH + 32];
+	struct stat st;
+	void* map;
+	int fd;
+
+	ramd_audit_segment_path(path, sizeof(path), sequence);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return; /* removed by retention meanwhile */
+	if (fstat(fd, &st) != 0 || st.st_size != RAMD_AUDIT_SEGMENT_SIZE)
+	{
+		close(fd);
+		return;
+	}
+	map = mmap(NULL, RAMD_AUDIT_SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return;
+
+	header = (const ramd_audit_segment_header_t*) map;
+	if (memcmp(header->magic, RAMD_AUDIT_MAGIC, sizeof(header->magic)) == 0 &&
+	    header->format == RAMD_AUDIT_FORMAT &&
+	    header->header_size == RAMD_AUDIT_SEGMENT_HEADER &&
+	    header->segment_size == RAMD_AUDIT_SEGMENT_SIZE &&
+	    header->block_size == RAMD_AUDIT_INDEX_BLOCK)
+		ramd_audit_collect(map, from_us, until_us, entries, max, count);
+	munmap(map, RAMD_AUDIT_SEGMENT_SIZE);
+}
+
+int
+ramd_audit_log_read(time_t from, time_t until, ramd_audit_entry_t* entries, int max)
+{
+	int64_t from_us = from > 0 ? (int64_t) from * 1000000 : INT64_MIN;
+	int64_t until_us = until > 0 ? (int64_t) until * 1000000 + 999999 : INT64_MAX;
+	uint64_t* sequences = NULL;
+	uint64_t active_sequence = UINT64_MAX;
+	int32_t sequence_count = 0;
+	int32_t index;
+	int count = 0;
+
+	if (!entries || max <= 0)
+		return 0;
+
+	index = ramd_audit_acquire();
+	if (index >= 0)
+	{
+		active_sequence = g_audit.slots[index].sequence;
+		ramd_audit_collect(g_audit.slots[index].base, from_us, until_us, entries, max,
+		                   &count);
+		ramd_audit_release(index);
+	}
+	if (count >= max)
+		return count;
+
+	pthread_mutex_lock(&g_audit.lock);
+	if (g_audit.segment_count > 0)
+	{
+		sequences = malloc(sizeof(uint64_t) * (size_t) g_audit.segment_count);
+		if (sequences)
+		{
+			memcpy(sequences, g_audit.segments,
+			       sizeof(uint64_t) * (size_t) g_audit.segment_count);
+			sequence_count = g_audit.segment_count;
+		}
+	}
+	pthread_mutex_unlock(&g_audit.lock);
+
+	/*
+	 * Files older than the segment just read; one started since would
+	 * break the order.  A segment kept in memory has sequence 0.
+	 */
+	for (int32_t i = sequence_count - 1; i >= 0 && count < max; i--)
+		if (index < 0 || active_sequence == 0 || sequences[i] < active_sequence)
+			ramd_audit_collect_file(sequences[i], from_us, until_us, entries, max, &count);
+	free(sequences);
+	return count;
+}
+
+static int
+ramd_audit_compare_sequence(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*) a;
+	uint64_t y = *(const uint64_t*) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Pick up the segment files an earlier run left in dir */
+static bool
+ramd_audit_scan_dir(void)
+{
+	struct dirent* entry;
+	DIR* dir;
+
+	if (mkdir(g_audit.dir, 0700) != 0 && errno != EEXIST)
+	{
+		ramd_log_error("Audit log: cannot create %s: %s", g_audit.dir, strerror(errno));
+		return false;
+	}
+	dir = opendir(g_audit.dir);
+	if (!dir)
+	{
+		ramd_log_error("Audit log: cannot open %s: %s", g_audit.dir, strerror(errno));
+		return false;
+	}
+
+	g_audit.segment_count = 0;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		unsigned long long sequence;
+		char tail;
+
+		if (sscanf(entry->d_name, "audit-%16llx.seg%c", &sequence, &tail) != 1 ||
+		    strlen(entry->d_name) != 26 || sequence == 0)
+			continue;
+		if (g_audit.segment_count >= RAMD_AUDIT_MAX_SEGMENTS)
+		{
+			ramd_log_warning("Audit log: more than %d segments in %s, ignoring the rest",
+			                 RAMD_AUDIT_MAX_SEGMENTS, g_audit.dir);
+			break;
+		}
+		g_audit.segments[g_audit.segment_count++] = sequence;
+	}
+	closedir(dir);
+
+	qsort(g_audit.segments, (size_t) g_audit.segment_count, sizeof(uint64_t),
+	      ramd_audit_compare_sequence);
+	if (g_audit.segment_count > 0)
+		g_audit.next_sequence = g_audit.segments[g_audit.segment_count - 1] + 1;
+	return true;
+}
+
+/*
+ * Write back what the active segment gained since the last pass and
+ * release retired slots nobody holds any more.
+ */
+static void*
+ramd_audit_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_audit.lock);
+	while (g_audit.running)
+	{
+		struct timespec deadline;
+		int32_t index;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += RAMD_AUDIT_SYNC_INTERVAL_MS / 1000;
+		deadline.tv_nsec += (long) (RAMD_AUDIT_SYNC_INTERVAL_MS % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&g_audit.cond, &g_audit.lock, &deadline);
+		if (!g_audit.running)
+			break;
+
+		for (int32_t i = 0; i < RAMD_AUDIT_MAPPED_SEGMENTS; i++)
+			if (i != atomic_load(&g_audit.active) && g_audit.slots[i].base)
+				ramd_audit_slot_unmap(&g_audit.slots[i], false);
+		pthread_mutex_unlock(&g_audit.lock);
+
+		index = ramd_audit_acquire();
+		if (index >= 0)
+		{
+			ramd_audit_slot_t* slot = &g_audit.slots[index];
+			uint64_t tail = atomic_load(&slot->tail);
+			uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+			uint64_t start = slot->synced & ~(page - 1);
+
+			if (tail > RAMD_AUDIT_SEGMENT_SIZE)
+				tail = RAMD_AUDIT_SEGMENT_SIZE;
+			if (slot->fd >= 0 && tail > slot->synced)
+			{
+				/* The header first: it holds the index of what follows */
+				msync(slot->base, RAMD_AUDIT_SEGMENT_HEADER, MS_SYNC);
+				msync(slot->base + start, (size_t) (tail - start), MS_SYNC);
+				slot->synced = tail;
+			}
+			ramd_audit_release(index);
+		}
+		pthread_mutex_lock(&g_audit.lock);
+	}
+	pthread_mutex_unlock(&g_audit.lock);
+	return NULL;
+}
+
+bool
+ramd_audit_log_open(const char* dir, int64_t retain_bytes)
+{
+	bool persistent;
+	int32_t active;
+
+	pthread_mutex_lock(&g_audit.lock);
+	if (g_audit.running)
+	{
+		pthread_mutex_unlock(&g_audit.lock);
+		return true;
+	}
+	strncpy(g_audit.dir, dir ? dir : "", sizeof(g_audit.dir) - 1);
+	g_audit.dir[sizeof(g_audit.dir) - 1] = '\0';
+	g_audit.retain_bytes = retain_bytes;
+	persistent = g_audit.dir[0] != '\0' && ramd_audit_scan_dir();
+	if (!persistent)
+		g_audit.dir[0] = '\0';
+	active = atomic_load(&g_audit.active);
+	pthread_mutex_unlock(&g_audit.lock);
+
+	/* Records written before this point stay in the memory segment they went to */
+	if (!ramd_audit_rotate(active))
+		return false;
+
+	pthread_mutex_lock(&g_audit.lock);
+	g_audit.running = true;
+	if (pthread_create(&g_audit.thread, NULL, ramd_audit_thread_main, NULL) != 0)
+	{
+		g_audit.running = false;
+		ramd_log_warning("Audit log: failed to create the sync thread, segments are "
+		                 "written back by the kernel only");
+	}
+	pthread_mutex_unlock(&g_audit.lock);
+
+	if (persistent)
+		ramd_log_info("Audit log: appending to %s (%d segments kept)", g_audit.dir,
+		              g_audit.segment_count);
+	return persistent || !dir || dir[0] == '\0';
+}
+
+void
+ramd_audit_log_close(void)
+{
+	bool running;
+
+	pthread_mutex_lock(&g_audit.lock);
+	running = g_audit.running;
+	g_audit.running = false;
+	pthread_cond_signal(&g_audit.cond);
+	pthread_mutex_unlock(&g_audit.lock);
+	if (running)
+		pthread_join(g_audit.thread, NULL);
+
+	pthread_mutex_lock(&g_audit.lock);
+	atomic_store(&g_audit.active, -1);
+	for (int32_t i = 0; i < RAMD_AUDIT_MAPPED_SEGMENTS; i++)
+		ramd_audit_slot_unmap(&g_audit.slots[i], true);
+	g_audit.segment_count = 0;
+	pthread_mutex_unlock(&g_audit.lock);
+}
@@ -6,10 +6,16 @@
  */
 
 #include "ramd_backup.h"
+#include "ramd_clock.h"
 #include "ramd_logging.h"
 #include "ramd_config.h"
+#include "ramd_daemon.h"
 #include "ramd_postgresql.h"
 #include "ramd_http_api.h"
+#include "ramd_process.h"
+#include "ram_json.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,59 +24,48 @@
 #include <time.h>
 #include <errno.h>
 
-/* Backup tool types */
-typedef enum {
-    RAMD_BACKUP_TOOL_PGBACKREST,
-    RAMD_BACKUP_TOOL_BARMAN,
-    RAMD_BACKUP_TOOL_CUSTOM
-} ramd_backup_tool_type_t;
-
-/* Backup tool configuration */
-typedef struct {
-    ramd_backup_tool_type_t type;
-    char name[64];
-    char command[512];
-    char config_file[256];
-    char backup_path[512];
-    char restore_path[512];
-    bool enabled;
-    int retention_days;
-    char schedule[64];
-    char last_backup[32];
-    char last_restore[32];
-    int backup_count;
-    int restore_count;
-} ramd_backup_tool_t;
-
-/* Backup job status */
+/* One entry of the job table; info is what callers are shown */
 typedef struct {
-    int job_id;
-    char tool_name[64];
-    char operation[32];  /* "backup", "restore", "verify" */
-    char status[32];     /* "running", "completed", "failed" */
-    time_t start_time;
-    time_t end_time;
-    int exit_code;
-    char error_message[512];
-    char backup_name[128];
-    char progress[256];
-} ramd_backup_job_t;
-
-/* Global backup context */
-static ramd_backup_tool_t g_backup_tools[RAMD_MAX_BACKUP_TOOLS];
+    ramd_backup_job_t info;
+    bool in_use;
+    uint64_t sequence;
+    atomic_bool cancel;
+    int64_t started_ms;       /* monotonic, for throughput */
+    size_t log_start;         /* ring of the tool's latest output */
+    size_t log_length;
+    char log[RAMD_BACKUP_LOG_SIZE];
+} ramd_backup_slot_t;
+
+/*
+ * Global backup context.  g_backup_mutex covers everything below, but is
+ * never held while a tool runs: a worker copies what it needs, runs the
+ * tool unlocked, and takes the lock again only to record the outcome.
+ */
+static ramd_backup_tool_config_t g_backup_tools[RAMD_MAX_BACKUP_TOOLS];
+static int g_backup_tool_running[RAMD_MAX_BACKUP_TOOLS];
 static int g_backup_tool_count = 0;
-static ramd_backup_job_t g_backup_jobs[RAMD_MAX_BACKUP_JOBS];
-static int g_backup_job_count = 0;
+static ramd_backup_slot_t g_backup_jobs[RAMD_MAX_BACKUP_JOBS];
+static uint64_t g_backup_sequence = 0;
+static int g_backup_next_job_id = 1;
+static pthread_t g_backup_workers[RAMD_BACKUP_WORKERS];
+static int g_backup_worker_count = 0;
+static bool g_backup_stopping = false;
 static pthread_mutex_t g_backup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_backup_cond = PTHREAD_COND_INITIALIZER;
 
 /* Forward declarations */
-static bool ramd_backup_validate_tool(ramd_backup_tool_t* tool);
-static bool ramd_backup_execute_command(const char* command, char* output, size_t output_size);
-static int ramd_backup_get_next_job_id(void);
+static bool ramd_backup_validate_tool(ramd_backup_tool_config_t* tool);
+static bool ramd_backup_execute_command(const char* const argv[], char* output, size_t output_size);
+static int ramd_backup_find_tool(const char* tool_name);
+static bool ramd_backup_job_finished(const ramd_backup_slot_t* slot);
+static bool ramd_backup_submit(const char* tool_name, const char* operation,
+                               const char* backup_name, ramd_backup_priority_t priority,
+                               const char* target_path, int processes, bool standby,
+                               int* job_id, char* error_message, size_t error_size);
 static void* ramd_backup_job_worker(void* arg);
-static bool ramd_backup_pgbackrest_init(ramd_backup_tool_t* tool);
-static bool ramd_backup_barman_init(ramd_backup_tool_t* tool);
-static bool ramd_backup_custom_init(ramd_backup_tool_t* tool);
+static bool ramd_backup_pgbackrest_init(ramd_backup_tool_config_t* tool);
+static bool ramd_backup_barman_init(ramd_backup_tool_config_t* tool);
+static bool ramd_backup_custom_init(ramd_backup_tool_config_t* tool);
 
 /*
  * Initialize backup system
@@ -81,19 +76,19 @@ ramd_backup_init(void)
     ramd_log_info("Initializing backup system");
     
     /* Initialize backup tools from configuration */
-    for (int i = 0; i < g_ramd_daemon->config.backup_tool_count; i++) {
-        ramd_backup_tool_t* tool = &g_backup_tools[g_backup_tool_count];
+    for (int i = 0; i < RAMD_BACKUP_CONFIG_TOOLS; i++) {
+        ramd_backup_tool_config_t* tool = &g_backup_tools[g_backup_tool_count];
         
-        /* Copy tool configuration */
-        strncpy(tool->name, g_ramd_daemon->config.backup_tools[i].name, sizeof(tool->name) - 1);
-        tool->type = g_ramd_daemon->config.backup_tools[i].type;
-        strncpy(tool->command, g_ramd_daemon->config.backup_tools[i].command, sizeof(tool->command) - 1);
-        strncpy(tool->config_file, g_ramd_daemon->config.backup_tools[i].config_file, sizeof(tool->config_file) - 1);
-        strncpy(tool->backup_path, g_ramd_daemon->config.backup_tools[i].backup_path, sizeof(tool->backup_path) - 1);
-        strncpy(tool->restore_path, g_ramd_daemon->config.backup_tools[i].restore_path, sizeof(tool->restore_path) - 1);
-        tool->enabled = g_ramd_daemon->config.backup_tools[i].enabled;
-        tool->retention_days = g_ramd_daemon->config.backup_tools[i].retention_days;
-        strncpy(tool->schedule, g_ramd_daemon->config.backup_tools[i].schedule, sizeof(tool->schedule) - 1);
+        /* Copy tool configuration; an unnamed slot is unused */
+        if (g_ramd_daemon->config.backup_tools[i].name[0] == '\0')
+            continue;
+        *tool = g_ramd_daemon->config.backup_tools[i];
+        if (!tool->enabled) {
+            ramd_log_info("Backup tool disabled: %s", tool->name);
+            continue;
+        }
+        if (tool->max_concurrent <= 0)
+            tool->max_concurrent = RAMD_BACKUP_TOOL_MAX_CONCURRENT;
         
         /* Initialize tool-specific configuration */
         bool init_success = false;
@@ -112,7 +107,7 @@ ramd_backup_init(void)
                 continue;
         }
         
-        if (init_success && tool->enabled) {
+        if (init_success && ramd_backup_validate_tool(tool)) {
             g_backup_tool_count++;
             ramd_log_success("Backup tool initialized: %s", tool->name);
         } else {
@@ -120,7 +115,30 @@ ramd_backup_init(void)
         }
     }
     
-    ramd_log_success("Backup system initialized with %d tools", g_backup_tool_count);
+    /* Without a tool there is nothing for workers to run */
+    if (g_backup_tool_count == 0) {
+        ramd_log_info("Backup system initialized with no tools");
+        return true;
+    }
+    
+    /* A fixed pool, so a burst of requests queues instead of piling onto the disks */
+    g_backup_stopping = false;
+    for (int i = 0; i < RAMD_BACKUP_WORKERS; i++) {
+        int rc = pthread_create(&g_backup_workers[g_backup_worker_count], NULL,
+                                ramd_backup_job_worker, NULL);
+        if (rc != 0) {
+            ramd_log_error("Cannot start backup worker: %s", strerror(rc));
+            break;
+        }
+        g_backup_worker_count++;
+    }
+    if (g_backup_worker_count == 0) {
+        ramd_log_error("No backup workers could be started");
+        return false;
+    }
+    
+    ramd_log_success("Backup system initialized with %d tools and %d workers",
+                     g_backup_tool_count, g_backup_worker_count);
     return true;
 }
 
@@ -130,128 +148,166 @@ ramd_backup_init(void)
 bool
 ramd_backup_create(const char* tool_name, const char* backup_name, char* error_message, size_t error_size)
 {
-    pthread_mutex_lock(&g_backup_mutex);
-    
-    /* Find the backup tool */
-    ramd_backup_tool_t* tool = NULL;
-    for (int i = 0; i < g_backup_tool_count; i++) {
-        if (strcmp(g_backup_tools[i].name, tool_name) == 0) {
-            tool = &g_backup_tools[i];
-            break;
-        }
-    }
-    
-    if (!tool) {
-        snprintf(error_message, error_size, "Backup tool not found: %s", tool_name);
-        pthread_mutex_unlock(&g_backup_mutex);
+    return ramd_backup_submit(tool_name, "backup", backup_name ? backup_name : "auto",
+                              RAMD_BACKUP_PRIORITY_MANUAL, NULL, 0, false, NULL,
+                              error_message, error_size);
+}
+
+/*
+ * Create a backup on behalf of the schedule
+ */
+bool
+ramd_backup_create_scheduled(const char* tool_name, const char* backup_name, char* error_message, size_t error_size)
+{
+    return ramd_backup_submit(tool_name, "backup", backup_name ? backup_name : "auto",
+                              RAMD_BACKUP_PRIORITY_SCHEDULED, NULL, 0, false, NULL,
+                              error_message, error_size);
+}
+
+/*
+ * Restore from backup using the specified tool
+ */
+bool
+ramd_backup_restore(const char* tool_name, const char* backup_name, char* error_message, size_t error_size)
+{
+    if (!backup_name || backup_name[0] == '\0') {
+        snprintf(error_message, error_size, "Backup name is required for a restore");
         return false;
     }
-    
-    if (!tool->enabled) {
-        snprintf(error_message, error_size, "Backup tool is disabled: %s", tool_name);
-        pthread_mutex_unlock(&g_backup_mutex);
+
+    return ramd_backup_submit(tool_name, "restore", backup_name,
+                              RAMD_BACKUP_PRIORITY_RESTORE, NULL, 0, false, NULL,
+                              error_message, error_size);
+}
+
+/*
+ * Restore into a new standby's data directory
+ */
+bool
+ramd_backup_restore_standby(const char* tool_name, const char* backup_name, const char* target_dir,
+                            int processes, int* job_id, char* error_message, size_t error_size)
+{
+    if (!target_dir || target_dir[0] == '\0') {
+        snprintf(error_message, error_size, "Target directory is required for a standby restore");
         return false;
     }
-    
-    /* Create backup job */
-    if (g_backup_job_count >= RAMD_MAX_BACKUP_JOBS) {
-        snprintf(error_message, error_size, "Maximum number of backup jobs reached");
-        pthread_mutex_unlock(&g_backup_mutex);
-        return false;
+
+    return ramd_backup_submit(tool_name, "restore", backup_name ? backup_name : "latest",
+                              RAMD_BACKUP_PRIORITY_RESTORE, target_dir, processes, true, job_id,
+                              error_message, error_size);
+}
+
+/*
+ * Wait for a job to finish
+ */
+bool
+ramd_backup_wait_job(int job_id, int32_t timeout_ms, ramd_backup_job_t* job)
+{
+    struct timespec deadline;
+    
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
     }
     
-    ramd_backup_job_t* job = &g_backup_jobs[g_backup_job_count];
-    job->job_id = ramd_backup_get_next_job_id();
-    strncpy(job->tool_name, tool_name, sizeof(job->tool_name) - 1);
-    strncpy(job->operation, "backup", sizeof(job->operation) - 1);
-    strncpy(job->status, "running", sizeof(job->status) - 1);
-    job->start_time = time(NULL);
-    job->end_time = 0;
-    job->exit_code = -1;
-    strncpy(job->backup_name, backup_name ? backup_name : "auto", sizeof(job->backup_name) - 1);
-    strcpy(job->error_message, "");
-    strcpy(job->progress, "Starting backup...");
-    
-    g_backup_job_count++;
-    
-    pthread_mutex_unlock(&g_backup_mutex);
-    
-    /* Start backup job in background */
-    pthread_t thread;
-    if (pthread_create(&thread, NULL, ramd_backup_job_worker, job) != 0) {
-        snprintf(error_message, error_size, "Failed to start backup job thread");
-        return false;
+    pthread_mutex_lock(&g_backup_mutex);
+    for (;;) {
+        ramd_backup_slot_t* slot = NULL;
+        
+        for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+            if (g_backup_jobs[i].in_use && g_backup_jobs[i].info.job_id == job_id) {
+                slot = &g_backup_jobs[i];
+                break;
+            }
+        }
+        if (!slot) {
+            pthread_mutex_unlock(&g_backup_mutex);
+            return false;
+        }
+        if (ramd_backup_job_finished(slot)) {
+            if (job)
+                *job = slot->info;
+            pthread_mutex_unlock(&g_backup_mutex);
+            return true;
+        }
+        /* Workers broadcast g_backup_cond whenever a job ends */
+        if (pthread_cond_timedwait(&g_backup_cond, &g_backup_mutex, &deadline) == ETIMEDOUT) {
+            if (job)
+                *job = slot->info;
+            pthread_mutex_unlock(&g_backup_mutex);
+            return false;
+        }
     }
-    
-    pthread_detach(thread);
-    
-    ramd_log_operation("Backup job started: %s (ID: %d)", tool_name, job->job_id);
-    return true;
 }
 
 /*
- * Restore from backup using the specified tool
+ * Cancel a queued or running backup job
  */
 bool
-ramd_backup_restore(const char* tool_name, const char* backup_name, char* error_message, size_t error_size)
+ramd_backup_cancel_job(int job_id, char* error_message, size_t error_size)
 {
     pthread_mutex_lock(&g_backup_mutex);
-    
-    /* Find the backup tool */
-    ramd_backup_tool_t* tool = NULL;
-    for (int i = 0; i < g_backup_tool_count; i++) {
-        if (strcmp(g_backup_tools[i].name, tool_name) == 0) {
-            tool = &g_backup_tools[i];
-            break;
+
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        ramd_backup_slot_t* slot = &g_backup_jobs[i];
+
+        if (!slot->in_use || slot->info.job_id != job_id)
+            continue;
+
+        if (strcmp(slot->info.status, "queued") == 0) {
+            /* Never picked up, so there is nothing to stop */
+            snprintf(slot->info.status, sizeof(slot->info.status), "cancelled");
+            snprintf(slot->info.progress, sizeof(slot->info.progress), "Cancelled before it started");
+            slot->info.end_time = time(NULL);
+        } else if (strcmp(slot->info.status, "running") == 0) {
+            /* The worker's process runner sees this and stops the tool */
+            atomic_store(&slot->cancel, true);
+            snprintf(slot->info.progress, sizeof(slot->info.progress), "Cancelling...");
+        } else {
+            snprintf(error_message, error_size, "Backup job %d has already finished", job_id);
+            pthread_mutex_unlock(&g_backup_mutex);
+            return false;
         }
-    }
-    
-    if (!tool) {
-        snprintf(error_message, error_size, "Backup tool not found: %s", tool_name);
-        pthread_mutex_unlock(&g_backup_mutex);
-        return false;
-    }
-    
-    if (!tool->enabled) {
-        snprintf(error_message, error_size, "Backup tool is disabled: %s", tool_name);
-        pthread_mutex_unlock(&g_backup_mutex);
-        return false;
-    }
-    
-    /* Create restore job */
-    if (g_backup_job_count >= RAMD_MAX_BACKUP_JOBS) {
-        snprintf(error_message, error_size, "Maximum number of backup jobs reached");
+
         pthread_mutex_unlock(&g_backup_mutex);
-        return false;
+        ramd_log_operation("Backup job cancelled: %d", job_id);
+        return true;
     }
-    
-    ramd_backup_job_t* job = &g_backup_jobs[g_backup_job_count];
-    job->job_id = ramd_backup_get_next_job_id();
-    strncpy(job->tool_name, tool_name, sizeof(job->tool_name) - 1);
-    strncpy(job->operation, "restore", sizeof(job->operation) - 1);
-    strncpy(job->status, "running", sizeof(job->status) - 1);
-    job->start_time = time(NULL);
-    job->end_time = 0;
-    job->exit_code = -1;
-    strncpy(job->backup_name, backup_name, sizeof(job->backup_name) - 1);
-    strcpy(job->error_message, "");
-    strcpy(job->progress, "Starting restore...");
-    
-    g_backup_job_count++;
-    
+
     pthread_mutex_unlock(&g_backup_mutex);
-    
-    /* Start restore job in background */
-    pthread_t thread;
-    if (pthread_create(&thread, NULL, ramd_backup_job_worker, job) != 0) {
-        snprintf(error_message, error_size, "Failed to start restore job thread");
-        return false;
+    snprintf(error_message, error_size, "Backup job not found: %d", job_id);
+    return false;
+}
+
+/*
+ * Stop the executor
+ */
+void
+ramd_backup_shutdown(void)
+{
+    pthread_mutex_lock(&g_backup_mutex);
+    g_backup_stopping = true;
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        ramd_backup_slot_t* slot = &g_backup_jobs[i];
+
+        if (!slot->in_use)
+            continue;
+        if (strcmp(slot->info.status, "queued") == 0) {
+            snprintf(slot->info.status, sizeof(slot->info.status), "cancelled");
+            slot->info.end_time = time(NULL);
+        } else if (strcmp(slot->info.status, "running") == 0) {
+            atomic_store(&slot->cancel, true);
+        }
     }
-    
-    pthread_detach(thread);
-    
-    ramd_log_operation("Restore job started: %s (ID: %d)", tool_name, job->job_id);
-    return true;
+    pthread_cond_broadcast(&g_backup_cond);
+    pthread_mutex_unlock(&g_backup_mutex);
+
+    for (int i = 0; i < g_backup_worker_count; i++)
+        pthread_join(g_backup_workers[i], NULL);
+    g_backup_worker_count = 0;
 }
 
 /*
@@ -263,40 +319,39 @@ ramd_backup_list(const char* tool_name, char* output, size_t output_size)
     pthread_mutex_lock(&g_backup_mutex);
     
     /* Find the backup tool */
-    ramd_backup_tool_t* tool = NULL;
-    for (int i = 0; i < g_backup_tool_count; i++) {
-        if (strcmp(g_backup_tools[i].name, tool_name) == 0) {
-            tool = &g_backup_tools[i];
-            break;
-        }
-    }
-    
-    if (!tool) {
+    int index = ramd_backup_find_tool(tool_name);
+    if (index < 0) {
         pthread_mutex_unlock(&g_backup_mutex);
         return false;
     }
+    ramd_backup_tool_config_t tool = g_backup_tools[index];
+    
+    pthread_mutex_unlock(&g_backup_mutex);
     
     /* Build list command based on tool type */
-    char command[1024];
-    switch (tool->type) {
+    const char* argv[6] = {NULL};
+    switch (tool.type) {
         case RAMD_BACKUP_TOOL_PGBACKREST:
-            snprintf(command, sizeof(command), "pgbackrest info --output=json");
+            argv[0] = tool.command;
+            argv[1] = "info";
+            argv[2] = "--output=json";
             break;
         case RAMD_BACKUP_TOOL_BARMAN:
-            snprintf(command, sizeof(command), "barman list-backup %s --json", tool->name);
+            argv[0] = tool.command;
+            argv[1] = "list-backup";
+            argv[2] = tool.name;
+            argv[3] = "--json";
             break;
         case RAMD_BACKUP_TOOL_CUSTOM:
-            snprintf(command, sizeof(command), "%s list", tool->command);
+            argv[0] = tool.command;
+            argv[1] = "list";
             break;
         default:
-            pthread_mutex_unlock(&g_backup_mutex);
             return false;
     }
     
-    pthread_mutex_unlock(&g_backup_mutex);
-    
     /* Execute command and return output */
-    return ramd_backup_execute_command(command, output, output_size);
+    return ramd_backup_execute_command(argv, output, output_size);
 }
 
 /*
@@ -307,9 +362,9 @@ ramd_backup_get_job_status(int job_id, ramd_backup_job_t* job)
 {
     pthread_mutex_lock(&g_backup_mutex);
     
-    for (int i = 0; i < g_backup_job_count; i++) {
-        if (g_backup_jobs[i].job_id == job_id) {
-            *job = g_backup_jobs[i];
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        if (g_backup_jobs[i].in_use && g_backup_jobs[i].info.job_id == job_id) {
+            *job = g_backup_jobs[i].info;
             pthread_mutex_unlock(&g_backup_mutex);
             return true;
         }
@@ -323,82 +378,253 @@ ramd_backup_get_job_status(int job_id, ramd_backup_job_t* job)
  * List all backup jobs
  */
 bool
-ramd_backup_list_jobs(char* output, size_t output_size)
+ramd_backup_list_jobs(ram_json_writer_t* w)
 {
     pthread_mutex_lock(&g_backup_mutex);
     
-    char* ptr = output;
-    size_t remaining = output_size;
-    int written = 0;
-    
-    written = snprintf(ptr, remaining, "{\"jobs\":[");
-    if (written < 0 || (size_t)written >= remaining) {
-        pthread_mutex_unlock(&g_backup_mutex);
-        return false;
+    ram_json_object_begin(w);
+    ram_json_key(w, "jobs");
+    ram_json_array_begin(w);
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS && !w->failed; i++) {
+        ramd_backup_job_t* job = &g_backup_jobs[i].info;
+        
+        if (!g_backup_jobs[i].in_use)
+            continue;
+        
+        ram_json_object_begin(w);
+        ram_json_key(w, "job_id");
+        ram_json_int(w, job->job_id);
+        ram_json_key(w, "tool_name");
+        ram_json_string(w, job->tool_name);
+        ram_json_key(w, "operation");
+        ram_json_string(w, job->operation);
+        ram_json_key(w, "status");
+        ram_json_string(w, job->status);
+        ram_json_key(w, "priority");
+        ram_json_int(w, job->priority);
+        ram_json_key(w, "queued_time");
+        ram_json_int(w, job->queued_time);
+        ram_json_key(w, "start_time");
+        ram_json_int(w, job->start_time);
+        ram_json_key(w, "end_time");
+        ram_json_int(w, job->end_time);
+        ram_json_key(w, "exit_code");
+        ram_json_int(w, job->exit_code);
+        ram_json_key(w, "backup_name");
+        ram_json_string(w, job->backup_name);
+        ram_json_key(w, "bytes_done");
+        ram_json_int(w, job->bytes_done);
+        ram_json_key(w, "bytes_total");
+        ram_json_int(w, job->bytes_total);
+        ram_json_key(w, "percent_done");
+        ram_json_int(w, job->percent_done);
+        ram_json_key(w, "bytes_per_second");
+        ram_json_int(w, job->bytes_per_second);
+        ram_json_key(w, "progress");
+        ram_json_string(w, job->progress);
+        ram_json_object_end(w);
     }
-    ptr += written;
-    remaining -= written;
+    ram_json_array_end(w);
+    ram_json_object_end(w);
+    
+    pthread_mutex_unlock(&g_backup_mutex);
     
-    for (int i = 0; i < g_backup_job_count; i++) {
-        ramd_backup_job_t* job = &g_backup_jobs[i];
+    return ram_json_writer_finish(w);
+}
+
+/*
+ * Bytes in a size as tools print it: "440KB", "29.4MB", "512B"; -1 if
+ * text does not start with one
+ */
+static int64_t
+ramd_backup_parse_size(const char* text)
+{
+    char* end;
+    double value = strtod(text, &end);
+    double scale;
+    
+    if (end == text || value < 0)
+        return -1;
+    while (*end == ' ')
+        end++;
+    
+    switch (*end) {
+        case 'B': scale = 1.0; break;
+        case 'K': case 'k': scale = 1024.0; break;
+        case 'M': scale = 1024.0 * 1024; break;
+        case 'G': scale = 1024.0 * 1024 * 1024; break;
+        case 'T': scale = 1024.0 * 1024 * 1024 * 1024; break;
+        case 'P': scale = 1024.0 * 1024 * 1024 * 1024 * 1024; break;
+        default: return -1;
+    }
+    return (int64_t) (value * scale);
+}
+
+/*
+ * Pick progress out of one line of tool output.  Understood are
+ * pgbackrest's detail lines, "backup file <path> (440KB, 0.39%) ..." (or
+ * "(bundle 1/0, 8KB, 0.01%)"), its closing "backup size = 29.4MB" or
+ * "restore size = 29.4MB", and pg_basebackup's "12345/67890 kB (18%)"
+ * meter that barman passes on.  For a job in the table the caller holds
+ * g_backup_mutex.
+ */
+void
+ramd_backup_parse_progress(ramd_backup_job_t* job, const char* line)
+{
+    const char* p;
+    long long done_kb;
+    long long total_kb;
+    int percent;
+    
+    if ((p = strstr(line, " file ")) != NULL &&
+        (strstr(line, "backup file ") || strstr(line, "restore file "))) {
+        const char* close = strstr(p, "%)");
+        const char* open = close;
         
-        if (i > 0) {
-            written = snprintf(ptr, remaining, ",");
-            if (written < 0 || (size_t)written >= remaining) {
-                pthread_mutex_unlock(&g_backup_mutex);
-                return false;
+        while (open && open > p && *open != '(')
+            open--;
+        if (!close || !open || *open != '(')
+            return;
+        
+        /* Comma separated fields: the file size and the overall percentage */
+        int64_t size = -1;
+        double pct = -1;
+        for (const char* field = open + 1; field < close; ) {
+            while (*field == ' ')
+                field++;
+            const char* comma = memchr(field, ',', (size_t) (close - field));
+            const char* stop = comma ? comma : close;
+            
+            if (stop == close) {
+                pct = strtod(field, NULL);
+            } else {
+                int64_t field_size = ramd_backup_parse_size(field);
+                if (field_size >= 0)
+                    size = field_size;
             }
-            ptr += written;
-            remaining -= written;
+            field = stop + 1;
         }
+        if (size >= 0)
+            job->bytes_done = (job->bytes_done > 0 ? job->bytes_done : 0) + size;
+        if (pct >= 0)
+            job->percent_done = (int) pct;
+        return;
+    }
+    
+    if ((p = strstr(line, "backup size = ")) != NULL ||
+        (p = strstr(line, "restore size = ")) != NULL) {
+        int64_t size = ramd_backup_parse_size(strstr(p, " = ") + strlen(" = "));
+        if (size >= 0)
+            job->bytes_total = size;
+        return;
+    }
+    
+    if (sscanf(line, " %lld/%lld kB (%d%%)", &done_kb, &total_kb, &percent) == 3) {
+        job->bytes_done = (int64_t) done_kb * 1024;
+        job->bytes_total = (int64_t) total_kb * 1024;
+        job->percent_done = percent;
+    }
+}
+
+/*
+ * Append to a job's output ring, dropping the oldest bytes once it is full
+ */
+static void
+ramd_backup_log_append(ramd_backup_slot_t* slot, const char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++) {
+        slot->log[(slot->log_start + slot->log_length) % RAMD_BACKUP_LOG_SIZE] = data[i];
+        if (slot->log_length < RAMD_BACKUP_LOG_SIZE)
+            slot->log_length++;
+        else
+            slot->log_start = (slot->log_start + 1) % RAMD_BACKUP_LOG_SIZE;
+    }
+}
+
+/*
+ * Each line a running tool prints, as it prints it
+ */
+static void
+ramd_backup_on_line(bool is_stderr, const char* line, void* arg)
+{
+    ramd_backup_slot_t* slot = (ramd_backup_slot_t*) arg;
+    ramd_backup_job_t* job = &slot->info;
+    
+    (void) is_stderr;
+    
+    pthread_mutex_lock(&g_backup_mutex);
+    ramd_backup_log_append(slot, line, strlen(line));
+    ramd_backup_log_append(slot, "\n", 1);
+    snprintf(job->progress, sizeof(job->progress), "%s", line);
+    
+    ramd_backup_parse_progress(job, line);
+    int64_t elapsed_ms = ramd_clock_now_ms() - slot->started_ms;
+    if (job->bytes_done > 0 && elapsed_ms > 0)
+        job->bytes_per_second = job->bytes_done * 1000 / elapsed_ms;
+    pthread_mutex_unlock(&g_backup_mutex);
+}
+
+/*
+ * Get backup job logs
+ */
+bool
+ramd_backup_get_job_logs(int job_id, char* logs, size_t logs_size)
+{
+    if (!logs || logs_size == 0)
+        return false;
+    
+    pthread_mutex_lock(&g_backup_mutex);
+    
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        ramd_backup_slot_t* slot = &g_backup_jobs[i];
         
-        written = snprintf(ptr, remaining,
-            "{\"job_id\":%d,\"tool_name\":\"%s\",\"operation\":\"%s\","
-            "\"status\":\"%s\",\"start_time\":%ld,\"end_time\":%ld,"
-            "\"exit_code\":%d,\"backup_name\":\"%s\",\"progress\":\"%s\"}",
-            job->job_id, job->tool_name, job->operation, job->status,
-            job->start_time, job->end_time, job->exit_code,
-            job->backup_name, job->progress);
+        if (!slot->in_use || slot->info.job_id != job_id)
+            continue;
         
-        if (written < 0 || (size_t)written >= remaining) {
-            pthread_mutex_unlock(&g_backup_mutex);
-            return false;
+        /* Keep the newest output that fits, starting on a whole line */
+        size_t skip = 0;
+        if (slot->log_length > logs_size - 1)
+            skip = slot->log_length - (logs_size - 1);
+        if (skip > 0 || slot->log_length == RAMD_BACKUP_LOG_SIZE) {
+            while (skip < slot->log_length &&
+                   slot->log[(slot->log_start + skip) % RAMD_BACKUP_LOG_SIZE] != '\n')
+                skip++;
+            if (skip < slot->log_length)
+                skip++;
         }
-        ptr += written;
-        remaining -= written;
-    }
-    
-    written = snprintf(ptr, remaining, "]}");
-    if (written < 0 || (size_t)written >= remaining) {
+        
+        size_t length = 0;
+        for (size_t n = skip; n < slot->log_length; n++)
+            logs[length++] = slot->log[(slot->log_start + n) % RAMD_BACKUP_LOG_SIZE];
+        logs[length] = '\0';
+        
         pthread_mutex_unlock(&g_backup_mutex);
-        return false;
+        return true;
     }
     
     pthread_mutex_unlock(&g_backup_mutex);
-    return true;
+    return false;
 }
 
 /*
  * Initialize pgBackRest tool
  */
 static bool
-ramd_backup_pgbackrest_init(ramd_backup_tool_t* tool)
+ramd_backup_pgbackrest_init(ramd_backup_tool_config_t* tool)
 {
-    /* Validate pgBackRest installation */
-    char command[512];
-    snprintf(command, sizeof(command), "pgbackrest version");
+    /* Set default commands if not provided */
+    if (strlen(tool->command) == 0) {
+        snprintf(tool->command, sizeof(tool->command), "pgbackrest");
+    }
     
+    /* Validate pgBackRest installation */
+    const char* argv[] = {tool->command, "version", NULL};
     char output[256];
-    if (!ramd_backup_execute_command(command, output, sizeof(output))) {
+    if (!ramd_backup_execute_command(argv, output, sizeof(output))) {
         ramd_log_error("pgBackRest not found or not working");
         return false;
     }
     
-    /* Set default commands if not provided */
-    if (strlen(tool->command) == 0) {
-        snprintf(tool->command, sizeof(tool->command), "pgbackrest");
-    }
-    
     if (strlen(tool->backup_path) == 0) {
         snprintf(tool->backup_path, sizeof(tool->backup_path), "{{VAR_DIR}}lib/pgbackrest");
     }
@@ -408,9 +634,7 @@ ramd_backup_pgbackrest_init(ramd_backup_tool_t* tool)
     }
     
     /* Create backup directory if it doesn't exist */
-    char mkdir_cmd[1024];
-    snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p %s", tool->backup_path);
-    system(mkdir_cmd);
+    ramd_process_make_directory(tool->backup_path, 0700);
     
     ramd_log_debug("pgBackRest tool initialized: %s", tool->name);
     return true;
@@ -420,23 +644,21 @@ ramd_backup_pgbackrest_init(ramd_backup_tool_t* tool)
  * Initialize Barman tool
  */
 static bool
-ramd_backup_barman_init(ramd_backup_tool_t* tool)
+ramd_backup_barman_init(ramd_backup_tool_config_t* tool)
 {
-    /* Validate Barman installation */
-    char command[512];
-    snprintf(command, sizeof(command), "barman --version");
+    /* Set default commands if not provided */
+    if (strlen(tool->command) == 0) {
+        snprintf(tool->command, sizeof(tool->command), "barman");
+    }
     
+    /* Validate Barman installation */
+    const char* argv[] = {tool->command, "--version", NULL};
     char output[256];
-    if (!ramd_backup_execute_command(command, output, sizeof(output))) {
+    if (!ramd_backup_execute_command(argv, output, sizeof(output))) {
         ramd_log_error("Barman not found or not working");
         return false;
     }
     
-    /* Set default commands if not provided */
-    if (strlen(tool->command) == 0) {
-        snprintf(tool->command, sizeof(tool->command), "barman");
-    }
-    
     if (strlen(tool->backup_path) == 0) {
         snprintf(tool->backup_path, sizeof(tool->backup_path), "{{VAR_DIR}}lib/barman");
     }
@@ -446,9 +668,7 @@ ramd_backup_barman_init(ramd_backup_tool_t* tool)
     }
     
     /* Create backup directory if it doesn't exist */
-    char mkdir_cmd[1024];
-    snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p %s", tool->backup_path);
-    system(mkdir_cmd);
+    ramd_process_make_directory(tool->backup_path, 0700);
     
     ramd_log_debug("Barman tool initialized: %s", tool->name);
     return true;
@@ -458,7 +678,7 @@ ramd_backup_barman_init(ramd_backup_tool_t* tool)
  * Initialize custom backup tool
  */
 static bool
-ramd_backup_custom_init(ramd_backup_tool_t* tool)
+ramd_backup_custom_init(ramd_backup_tool_config_t* tool)
 {
     /* Validate custom tool command */
     if (strlen(tool->command) == 0) {
@@ -467,11 +687,8 @@ ramd_backup_custom_init(ramd_backup_tool_t* tool)
     }
     
     /* Test if command exists and is executable */
-    char test_cmd[512];
-    snprintf(test_cmd, sizeof(test_cmd), "which %s", tool->command);
-    
-    char output[256];
-    if (!ramd_backup_execute_command(test_cmd, output, sizeof(output))) {
+    char path[RAMD_MAX_PATH_LENGTH];
+    if (!ramd_process_find_program(tool->command, path, sizeof(path))) {
         ramd_log_error("Custom backup tool not found: %s", tool->command);
         return false;
     }
@@ -486,136 +703,377 @@ ramd_backup_custom_init(ramd_backup_tool_t* tool)
     }
     
     /* Create backup directory if it doesn't exist */
-    char mkdir_cmd[1024];
-    snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p %s", tool->backup_path);
-    system(mkdir_cmd);
+    ramd_process_make_directory(tool->backup_path, 0700);
     
     ramd_log_debug("Custom backup tool initialized: %s", tool->name);
     return true;
 }
 
 /*
- * Execute backup command
+ * Run a short query command (version, list) and capture its stdout
  */
 static bool
-ramd_backup_execute_command(const char* command, char* output, size_t output_size)
+ramd_backup_execute_command(const char* const argv[], char* output, size_t output_size)
 {
-    FILE* pipe = popen(command, "r");
-    if (!pipe) {
-        ramd_log_error("Failed to execute command: %s", command);
+    ramd_process_result_t* result = malloc(sizeof(ramd_process_result_t));
+    if (!result) {
+        ramd_log_error("Out of memory running %s", argv[0]);
         return false;
     }
     
-    size_t total_read = 0;
-    char buffer[1024];
+    bool success = ramd_process_run(argv, RAMD_BACKUP_QUERY_TIMEOUT_MS, result);
+    if (!success)
+        ramd_process_log_failure(argv[0], result);
     
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        size_t len = strlen(buffer);
-        if (total_read + len < output_size - 1) {
-            strncpy(output + total_read, buffer, len);
-            total_read += len;
-        } else {
-            break;
-        }
+    if (output_size > 0) {
+        size_t length = result->out_length < output_size - 1 ? result->out_length : output_size - 1;
+        memcpy(output, result->out, length);
+        output[length] = '\0';
     }
     
-    output[total_read] = '\0';
-    
-    int exit_code = pclose(pipe);
-    return (exit_code == 0);
+    free(result);
+    return success;
 }
 
 /*
- * Get next job ID
+ * Index of a configured tool, -1 if there is none; caller holds g_backup_mutex
  */
 static int
-ramd_backup_get_next_job_id(void)
+ramd_backup_find_tool(const char* tool_name)
 {
-    static int next_job_id = 1;
-    return next_job_id++;
+    if (!tool_name)
+        return -1;
+    
+    for (int i = 0; i < g_backup_tool_count; i++) {
+        if (strcmp(g_backup_tools[i].name, tool_name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static bool
+ramd_backup_job_finished(const ramd_backup_slot_t* slot)
+{
+    return strcmp(slot->info.status, "queued") != 0 &&
+           strcmp(slot->info.status, "running") != 0;
 }
 
 /*
- * Backup job worker thread
+ * Queue a job.  The table is fixed: a free entry is used if there is one,
+ * otherwise the oldest finished job is forgotten to make room.
  */
-static void*
-ramd_backup_job_worker(void* arg)
+static bool
+ramd_backup_submit(const char* tool_name, const char* operation, const char* backup_name,
+                   ramd_backup_priority_t priority, const char* target_path, int processes,
+                   bool standby, int* job_id, char* error_message, size_t error_size)
 {
-    ramd_backup_job_t* job = (ramd_backup_job_t*)arg;
+    pthread_mutex_lock(&g_backup_mutex);
     
-    /* Find the backup tool */
-    ramd_backup_tool_t* tool = NULL;
-    for (int i = 0; i < g_backup_tool_count; i++) {
-        if (strcmp(g_backup_tools[i].name, job->tool_name) == 0) {
-            tool = &g_backup_tools[i];
+    int index = ramd_backup_find_tool(tool_name);
+    if (index < 0) {
+        snprintf(error_message, error_size, "Backup tool not found: %s", tool_name ? tool_name : "");
+        pthread_mutex_unlock(&g_backup_mutex);
+        return false;
+    }
+    
+    if (!g_backup_tools[index].enabled) {
+        snprintf(error_message, error_size, "Backup tool is disabled: %s", tool_name);
+        pthread_mutex_unlock(&g_backup_mutex);
+        return false;
+    }
+    
+    if (g_backup_stopping || g_backup_worker_count == 0) {
+        snprintf(error_message, error_size, "Backup executor is not running");
+        pthread_mutex_unlock(&g_backup_mutex);
+        return false;
+    }
+    
+    ramd_backup_slot_t* slot = NULL;
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        ramd_backup_slot_t* candidate = &g_backup_jobs[i];
+        
+        if (!candidate->in_use) {
+            slot = candidate;
             break;
         }
+        if (ramd_backup_job_finished(candidate) &&
+            (!slot || candidate->sequence < slot->sequence))
+            slot = candidate;
     }
     
-    if (!tool) {
-        pthread_mutex_lock(&g_backup_mutex);
-        strcpy(job->status, "failed");
-        strcpy(job->error_message, "Backup tool not found");
-        job->end_time = time(NULL);
-        job->exit_code = 1;
+    if (!slot) {
+        snprintf(error_message, error_size, "Backup queue is full: %d jobs queued or running",
+                 RAMD_MAX_BACKUP_JOBS);
         pthread_mutex_unlock(&g_backup_mutex);
-        return NULL;
+        return false;
     }
     
-    /* Build command based on operation */
-    char command[1024];
+    memset(&slot->info, 0, sizeof(slot->info));
+    slot->in_use = true;
+    slot->sequence = ++g_backup_sequence;
+    atomic_store(&slot->cancel, false);
+    
+    ramd_backup_job_t* job = &slot->info;
+    job->job_id = g_backup_next_job_id++;
+    snprintf(job->tool_name, sizeof(job->tool_name), "%s", tool_name);
+    snprintf(job->operation, sizeof(job->operation), "%s", operation);
+    snprintf(job->status, sizeof(job->status), "queued");
+    snprintf(job->backup_name, sizeof(job->backup_name), "%s", backup_name);
+    snprintf(job->progress, sizeof(job->progress), "Waiting for a worker");
+    job->priority = priority;
+    job->queued_time = time(NULL);
+    job->exit_code = -1;
+    job->bytes_done = -1;
+    job->bytes_total = -1;
+    job->percent_done = -1;
+    if (target_path)
+        snprintf(job->target_path, sizeof(job->target_path), "%s", target_path);
+    job->processes = processes;
+    job->standby = standby;
+    slot->log_start = 0;
+    slot->log_length = 0;
+    
+    int queued_id = job->job_id;
+    if (job_id)
+        *job_id = queued_id;
+    
+    pthread_cond_signal(&g_backup_cond);
+    pthread_mutex_unlock(&g_backup_mutex);
+    
+    ramd_log_operation("%s job queued: %s (ID: %d)",
+                       strcmp(operation, "restore") == 0 ? "Restore" : "Backup", tool_name, queued_id);
+    return true;
+}
+
+/*
+ * Best queued job to start now: lowest priority value, then oldest, among
+ * tools still under their concurrency limit.  A tool at its limit holds
+ * back only its own jobs.  Caller holds g_backup_mutex; -1 if none.
+ */
+static int
+ramd_backup_next_job(void)
+{
+    int best = -1;
+    
+    for (int i = 0; i < RAMD_MAX_BACKUP_JOBS; i++) {
+        ramd_backup_slot_t* slot = &g_backup_jobs[i];
+        
+        if (!slot->in_use || strcmp(slot->info.status, "queued") != 0)
+            continue;
+        
+        int tool = ramd_backup_find_tool(slot->info.tool_name);
+        if (tool >= 0 && g_backup_tool_running[tool] >= g_backup_tools[tool].max_concurrent)
+            continue;
+        
+        if (best < 0 ||
+            slot->info.priority < g_backup_jobs[best].info.priority ||
+            (slot->info.priority == g_backup_jobs[best].info.priority &&
+             slot->sequence < g_backup_jobs[best].sequence))
+            best = i;
+    }
+    return best;
+}
+
+/* Formatted arguments of one tool run */
+typedef struct {
+    char path[640];
+    char processes[32];
+    char set[160];
+} ramd_backup_args_t;
+
+/*
+ * Build the tool's argv for a job into argv, formatting into args
+ */
+static bool
+ramd_backup_build_argv(const ramd_backup_tool_config_t* tool, const ramd_backup_job_t* job,
+                       const char* argv[], ramd_backup_args_t* args)
+{
+    int argc = 0;
+    const char* target = job->target_path[0] ? job->target_path : tool->restore_path;
+    bool latest = strcmp(job->backup_name, "latest") == 0;
+    
+    argv[argc++] = tool->command;
     if (strcmp(job->operation, "backup") == 0) {
         switch (tool->type) {
             case RAMD_BACKUP_TOOL_PGBACKREST:
-                snprintf(command, sizeof(command), "pgbackrest backup --stanza=main");
+                argv[argc++] = "backup";
+                argv[argc++] = "--stanza=main";
+                argv[argc++] = "--log-level-console=detail";
                 break;
             case RAMD_BACKUP_TOOL_BARMAN:
-                snprintf(command, sizeof(command), "barman backup %s", tool->name);
+                argv[argc++] = "backup";
+                argv[argc++] = tool->name;
                 break;
             case RAMD_BACKUP_TOOL_CUSTOM:
-                snprintf(command, sizeof(command), "%s backup %s", tool->command, job->backup_name);
+                argv[argc++] = "backup";
+                argv[argc++] = job->backup_name;
                 break;
+            default:
+                return false;
         }
     } else if (strcmp(job->operation, "restore") == 0) {
         switch (tool->type) {
             case RAMD_BACKUP_TOOL_PGBACKREST:
-                snprintf(command, sizeof(command), "pgbackrest restore --stanza=main --target=%s", tool->restore_path);
+                /* --type=standby writes standby.signal and an archive-get restore_command */
+                snprintf(args->path, sizeof(args->path), "--pg1-path=%s", target);
+                argv[argc++] = "restore";
+                argv[argc++] = "--stanza=main";
+                argv[argc++] = args->path;
+                if (job->processes > 0) {
+                    snprintf(args->processes, sizeof(args->processes), "--process-max=%d", job->processes);
+                    argv[argc++] = args->processes;
+                }
+                if (!latest) {
+                    snprintf(args->set, sizeof(args->set), "--set=%s", job->backup_name);
+                    argv[argc++] = args->set;
+                }
+                if (job->standby)
+                    argv[argc++] = "--type=standby";
+                argv[argc++] = "--log-level-console=detail";
                 break;
             case RAMD_BACKUP_TOOL_BARMAN:
-                snprintf(command, sizeof(command), "barman recover %s %s %s", tool->name, job->backup_name, tool->restore_path);
+                /* barman takes "latest" as a backup id itself */
+                argv[argc++] = "recover";
+                if (job->processes > 0) {
+                    snprintf(args->processes, sizeof(args->processes), "%d", job->processes);
+                    argv[argc++] = "--jobs";
+                    argv[argc++] = args->processes;
+                }
+                if (job->standby)
+                    argv[argc++] = "--get-wal";
+                argv[argc++] = tool->name;
+                argv[argc++] = job->backup_name;
+                argv[argc++] = target;
                 break;
             case RAMD_BACKUP_TOOL_CUSTOM:
-                snprintf(command, sizeof(command), "%s restore %s %s", tool->command, job->backup_name, tool->restore_path);
+                argv[argc++] = "restore";
+                argv[argc++] = job->backup_name;
+                argv[argc++] = target;
                 break;
+            default:
+                return false;
         }
+    } else {
+        return false;
+    }
+    argv[argc] = NULL;
+    return true;
+}
+
+/*
+ * Run one job to completion; called without g_backup_mutex
+ */
+static void
+ramd_backup_run_job(ramd_backup_slot_t* slot, const ramd_backup_tool_config_t* tool,
+                    const ramd_backup_job_t* job)
+{
+    const ramd_process_priority_t background = {
+        RAMD_BACKUP_NICE, RAMD_BACKUP_IOPRIO_CLASS, RAMD_BACKUP_IOPRIO_LEVEL
+    };
+    const char* argv[12];
+    ramd_backup_args_t args;
+    ramd_process_result_t* result = NULL;
+    bool success = false;
+    
+    if (ramd_backup_build_argv(tool, job, argv, &args))
+        result = malloc(sizeof(ramd_process_result_t));
+    
+    if (result) {
+        /* Backups yield to the database; a restore is what is being waited on */
+        success = ramd_process_run_streaming(argv, 0, &slot->cancel,
+                                             job->priority == RAMD_BACKUP_PRIORITY_RESTORE ? NULL : &background,
+                                             ramd_backup_on_line, slot, result);
+        if (!success)
+            ramd_process_log_failure(job->tool_name, result);
     }
-    
-    /* Execute command */
-    char output[4096];
-    bool success = ramd_backup_execute_command(command, output, sizeof(output));
     
     /* Update job status */
     pthread_mutex_lock(&g_backup_mutex);
-    job->end_time = time(NULL);
+    ramd_backup_job_t* info = &slot->info;
+    info->end_time = time(NULL);
     if (success) {
-        strcpy(job->status, "completed");
-        job->exit_code = 0;
-        strcpy(job->progress, "Operation completed successfully");
+        snprintf(info->status, sizeof(info->status), "completed");
+        info->exit_code = 0;
+        snprintf(info->progress, sizeof(info->progress), "Operation completed successfully");
+    } else if (result && result->cancelled) {
+        snprintf(info->status, sizeof(info->status), "cancelled");
+        info->exit_code = result->exit_code;
+        snprintf(info->progress, sizeof(info->progress), "Operation cancelled");
     } else {
-        strcpy(job->status, "failed");
-        job->exit_code = 1;
-        strncpy(job->error_message, output, sizeof(job->error_message) - 1);
-        strcpy(job->progress, "Operation failed");
+        snprintf(info->status, sizeof(info->status), "failed");
+        info->exit_code = result ? result->exit_code : -1;
+        if (!result)
+            snprintf(info->error_message, sizeof(info->error_message), "Cannot start %s", job->operation);
+        else {
+            /* The end of the output is where tools say what went wrong */
+            const char* text = result->err_length > 0 ? result->err : result->out;
+            size_t length = result->err_length > 0 ? result->err_length : result->out_length;
+            size_t keep = length < sizeof(info->error_message) ? length : sizeof(info->error_message) - 1;
+            memcpy(info->error_message, text + length - keep, keep);
+            info->error_message[keep] = '\0';
+        }
+        snprintf(info->progress, sizeof(info->progress), "Operation failed");
     }
     pthread_mutex_unlock(&g_backup_mutex);
     
     /* Log completion */
-    if (success) {
+    if (success)
         ramd_log_success("Backup job completed: %s (ID: %d)", job->tool_name, job->job_id);
-    } else {
-        ramd_log_failure("Backup job failed: %s (ID: %d) - %s", job->tool_name, job->job_id, job->error_message);
-    }
+    else if (result && result->cancelled)
+        ramd_log_warning("Backup job cancelled: %s (ID: %d)", job->tool_name, job->job_id);
+    else
+        ramd_log_failure("Backup job failed: %s (ID: %d)", job->tool_name, job->job_id);
     
+    free(result);
+}
+
+/*
+ * Executor worker: takes the best runnable job until shutdown
+ */
+static void*
+ramd_backup_job_worker(void* arg)
+{
+    (void) arg;
+    
+    pthread_mutex_lock(&g_backup_mutex);
+    while (!g_backup_stopping) {
+        int index = ramd_backup_next_job();
+        if (index < 0) {
+            pthread_cond_wait(&g_backup_cond, &g_backup_mutex);
+            continue;
+        }
+        
+        ramd_backup_slot_t* slot = &g_backup_jobs[index];
+        int tool_index = ramd_backup_find_tool(slot->info.tool_name);
+        if (tool_index < 0) {
+            snprintf(slot->info.status, sizeof(slot->info.status), "failed");
+            snprintf(slot->info.error_message, sizeof(slot->info.error_message), "Backup tool not found");
+            slot->info.end_time = time(NULL);
+            continue;
+        }
+        
+        snprintf(slot->info.status, sizeof(slot->info.status), "running");
+        slot->info.start_time = time(NULL);
+        slot->started_ms = ramd_clock_now_ms();
+        g_backup_tool_running[tool_index]++;
+        
+        /* Copies, so the tool can run while other jobs are queued and listed */
+        ramd_backup_tool_config_t tool = g_backup_tools[tool_index];
+        ramd_backup_job_t job = slot->info;
+        snprintf(slot->info.progress, sizeof(slot->info.progress), "Running %s", job.operation);
+        pthread_mutex_unlock(&g_backup_mutex);
+        
+        ramd_log_operation("%s job started: %s (ID: %d)",
+                           job.priority == RAMD_BACKUP_PRIORITY_RESTORE ? "Restore" : "Backup",
+                           job.tool_name, job.job_id);
+        ramd_backup_run_job(slot, &tool, &job);
+        
+        pthread_mutex_lock(&g_backup_mutex);
+        g_backup_tool_running[tool_index]--;
+        /* A tool slot freed up: another worker may now have a job to run */
+        pthread_cond_broadcast(&g_backup_cond);
+    }
+    pthread_mutex_unlock(&g_backup_mutex);
     return NULL;
 }
 
@@ -623,7 +1081,7 @@ ramd_backup_job_worker(void* arg)
  * Validate backup tool configuration
  */
 static bool
-ramd_backup_validate_tool(ramd_backup_tool_t* tool)
+ramd_backup_validate_tool(ramd_backup_tool_config_t* tool)
 {
     if (strlen(tool->name) == 0) {
         ramd_log_error("Backup tool name is required");
@@ -0,0 +1,1451 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_backup_verify.c
+ *		PostgreSQL Auto-Failover Daemon - Parallel Backup Verification
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A backup is only as good as the last time it was read back.  For
+ * ramd's own base backups the backup_manifest is the reference: its
+ * Manifest-Checksum proves the manifest itself, then every file's size
+ * and CRC-32C (or SHA) is checked by backup_verify_workers threads that
+ * take the largest files first, so a multi-TB backup is read once at the
+ * speed of the disks rather than of one thread.  The threads share one
+ * token bucket of backup_verify_max_rate_kbps and run at the executor's
+ * background CPU and I/O priority, and what they read is dropped from
+ * the page cache behind them, so the database keeps its I/O and cache.
+ * pg_verifybackup --skip-checksums covers what the file list cannot:
+ * files the manifest does not know and the WAL the backup needs.
+ * pgBackRest and Barman backups go to the tool's own verify command.
+ *
+ * Results are kept per backup for backup_verify_cache_ttl_ms, and a
+ * native result is dropped as soon as the manifest changes, so the
+ * maintenance pre-checks can ask on every run and read a backup only
+ * when nobody has recently.  One run goes at a time: a caller asking for
+ * the backup being verified waits for that run instead of starting its
+ * own.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <jansson.h>
+#include <openssl/evp.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#endif
+
+#include "ramd_backup_verify.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_process.h"
+
+#define RAMD_VERIFY_MANIFEST "backup_manifest"
+#define RAMD_VERIFY_LABEL "backup_label"
+#define RAMD_VERIFY_MAX_CHECKSUM 64 /* SHA-512 */
+#define RAMD_VERIFY_CRC32C_POLY 0x82F63B78U
+
+typedef enum
+{
+	RAMD_VERIFY_ALG_NONE = 0,
+	RAMD_VERIFY_ALG_CRC32C,
+	RAMD_VERIFY_ALG_SHA224,
+	RAMD_VERIFY_ALG_SHA256,
+	RAMD_VERIFY_ALG_SHA384,
+	RAMD_VERIFY_ALG_SHA512
+} ramd_verify_alg_t;
+
+typedef struct ramd_verify_file_t
+{
+	const char* path;    /* relative to the backup, decoded */
+	int64_t size;
+	ramd_verify_alg_t algorithm;
+	unsigned char checksum[RAMD_VERIFY_MAX_CHECKSUM];
+	int32_t checksum_length;
+} ramd_verify_file_t;
+
+/* One native run: the manifest's files and the workers going through them */
+typedef struct ramd_verify_run_t
+{
+	pthread_mutex_t lock;  /* guards everything below but the file list */
+	char root[RAMD_MAX_PATH_LENGTH];
+	ramd_verify_file_t* files;
+	int32_t file_count;
+	int32_t next_file;
+	int32_t files_checked;
+	int32_t files_failed;
+	int64_t bytes_checked;
+	int64_t rate_bytes;    /* per second, 0 for no limit */
+	int64_t next_read_us;  /* when the token bucket allows the next block */
+	char problems[384];    /* the first few, "; " separated */
+} ramd_verify_run_t;
+
+typedef struct ramd_verify_entry_t
+{
+	bool in_use;
+	bool running;
+	bool has_result;
+	char tool[32];
+	char backup_id[RAMD_BACKUP_VERIFY_ID_LENGTH];
+	int64_t stamp;         /* the manifest as it was verified; 0 for the tools */
+	uint64_t sequence;     /* least recently used goes first */
+	ramd_backup_verify_result_t result;
+} ramd_verify_entry_t;
+
+typedef struct ramd_verify_stats_t
+{
+	int64_t runs_valid;
+	int64_t runs_invalid;
+	int64_t cache_hits;
+	int64_t files_checked;
+	int64_t bytes_checked;
+	int64_t last_duration_ms;
+	int64_t last_verified_ms;
+	bool last_valid;
+} ramd_verify_stats_t;
+
+typedef struct ramd_verify_t
+{
+	pthread_mutex_t lock;  /* guards everything below */
+	pthread_cond_t done;   /* a run finished */
+	pthread_cond_t work;   /* wakes the background verifier: stop, or a request */
+	pthread_mutex_t run_lock; /* held for the whole of a run: one at a time */
+	const ramd_config_t* config;
+	bool running;
+	pthread_t thread;
+	ramd_verify_entry_t entries[RAMD_BACKUP_VERIFY_CACHE_SIZE];
+	uint64_t sequence;
+	char queue[RAMD_BACKUP_VERIFY_QUEUE][RAMD_BACKUP_VERIFY_ID_LENGTH];
+	int32_t queue_head;
+	int32_t queue_length;
+	ramd_verify_stats_t stats;
+} ramd_verify_t;
+
+static ramd_verify_t g_verify = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.run_lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Set by ramd_backup_verify_stop; runs in progress give up at the next block */
+static atomic_bool g_verify_cancel;
+
+static uint32_t g_crc32c_table[8][256];
+static bool g_crc32c_sse42;
+static pthread_once_t g_crc32c_once = PTHREAD_ONCE_INIT;
+
+static void
+ramd_crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ RAMD_VERIFY_CRC32C_POLY : crc >> 1;
+		g_crc32c_table[0][i] = crc;
+	}
+	for (int k = 1; k < 8; k++)
+		for (int i = 0; i < 256; i++)
+			g_crc32c_table[k][i] = (g_crc32c_table[k - 1][i] >> 8) ^
+			                       g_crc32c_table[0][g_crc32c_table[k - 1][i] & 0xFF];
+#if defined(__x86_64__) && defined(__GNUC__)
+	g_crc32c_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+/* Slicing-by-8, for CPUs without a CRC-32C instruction */
+static uint32_t
+ramd_crc32c_sb8(uint32_t crc, const unsigned char* p, size_t len)
+{
+	while (len >= 8)
+	{
+		uint32_t a = crc ^ ((uint32_t) p[0] | (uint32_t) p[1] << 8 |
+		                    (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24);
+
+		crc = g_crc32c_table[7][a & 0xFF] ^ g_crc32c_table[6][(a >> 8) & 0xFF] ^
+		      g_crc32c_table[5][(a >> 16) & 0xFF] ^ g_crc32c_table[4][a >> 24] ^
+		      g_crc32c_table[3][p[4]] ^ g_crc32c_table[2][p[5]] ^
+		      g_crc32c_table[1][p[6]] ^ g_crc32c_table[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	while (len-- > 0)
+		crc = g_crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2")))
+static uint32_t
+ramd_crc32c_sse42(uint32_t crc, const unsigned char* p, size_t len)
+{
+	uint64_t crc64 = crc;
+
+	while (len >= 8)
+	{
+		uint64_t word;
+
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+	crc = (uint32_t) crc64;
+	while (len-- > 0)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif
+
+/* Running CRC-32C without the final inversion, as PostgreSQL's COMP_CRC32C */
+static uint32_t
+ramd_crc32c_update(uint32_t crc, const unsigned char* p, size_t len)
+{
+#if defined(__x86_64__) && defined(__GNUC__)
+	if (g_crc32c_sse42)
+		return ramd_crc32c_sse42(crc, p, len);
+#endif
+	return ramd_crc32c_sb8(crc, p, len);
+}
+
+static const EVP_MD*
+ramd_verify_digest(ramd_verify_alg_t algorithm)
+{
+	switch (algorithm)
+	{
+	case RAMD_VERIFY_ALG_SHA224:
+		return EVP_sha224();
+	case RAMD_VERIFY_ALG_SHA256:
+		return EVP_sha256();
+	case RAMD_VERIFY_ALG_SHA384:
+		return EVP_sha384();
+	case RAMD_VERIFY_ALG_SHA512:
+		return EVP_sha512();
+	default:
+		return NULL;
+	}
+}
+
+static bool
+ramd_verify_parse_algorithm(const char* name, ramd_verify_alg_t* algorithm, int32_t* length)
+{
+	static const struct
+	{
+		const char* name;
+		ramd_verify_alg_t algorithm;
+		int32_t length;
+	} algorithms[] = {
+		{"NONE", RAMD_VERIFY_ALG_NONE, 0},
+		{"CRC32C", RAMD_VERIFY_ALG_CRC32C, 4},
+		{"SHA224", RAMD_VERIFY_ALG_SHA224, 28},
+		{"SHA256", RAMD_VERIFY_ALG_SHA256, 32},
+		{"SHA384", RAMD_VERIFY_ALG_SHA384, 48},
+		{"SHA512", RAMD_VERIFY_ALG_SHA512, 64}
+	};
+
+	for (size_t i = 0; i < sizeof(algorithms) / sizeof(algorithms[0]); i++)
+	{
+		if (strcmp(name, algorithms[i].name) == 0)
+		{
+			*algorithm = algorithms[i].algorithm;
+			*length = algorithms[i].length;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int
+ramd_verify_hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+/* Decode hex into out; false unless it is exactly length bytes */
+static bool
+ramd_verify_hex_decode(const char* hex, unsigned char* out, size_t length)
+{
+	if (strlen(hex) != length * 2)
+		return false;
+	for (size_t i = 0; i < length; i++)
+	{
+		int hi = ramd_verify_hex_digit(hex[2 * i]);
+		int lo = ramd_verify_hex_digit(hex[2 * i + 1]);
+
+		if (hi < 0 || lo < 0)
+			return false;
+		out[i] = (unsigned char) (hi << 4 | lo);
+	}
+	return true;
+}
+
+static bool
+ramd_verify_valid_id(const char* backup_id)
+{
+	size_t len;
+
+	if (!backup_id)
+		return false;
+	len = strlen(backup_id);
+	return len > 0 && len < RAMD_BACKUP_VERIFY_ID_LENGTH && backup_id[0] != '.' &&
+	       strchr(backup_id, '/') == NULL;
+}
+
+/* Relative, and never climbing out of the backup */
+static bool
+ramd_verify_safe_path(const char* path)
+{
+	size_t len = strlen(path);
+
+	return len > 0 && path[0] != '/' && strcmp(path, "..") != 0 &&
+	       strncmp(path, "../", 3) != 0 && strstr(path, "/../") == NULL &&
+	       (len < 3 || strcmp(path + len - 3, "/..") != 0);
+}
+
+static bool
+ramd_verify_path(char* buf, size_t size, const char* dir, const char* sub, const char* name)
+{
+	int len = snprintf(buf, size, "%s/%s%s%s", dir, sub, name ? "/" : "", name ? name : "");
+
+	return len > 0 && (size_t) len < size;
+}
+
+/* Append a problem to the run's summary while there is room; caller holds run->lock */
+static void
+ramd_verify_note(ramd_verify_run_t* run, const char* problem)
+{
+	size_t used = strlen(run->problems);
+
+	if (used + 4 >= sizeof(run->problems))
+		return;
+	snprintf(run->problems + used, sizeof(run->problems) - used, "%s%s",
+	         used > 0 ? "; " : "", problem);
+}
+
+static void
+ramd_verify_sleep_us(int64_t us)
+{
+	struct timespec ts;
+
+	ts.tv_sec = (time_t) (us / 1000000);
+	ts.tv_nsec = (long) (us % 1000000) * 1000L;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/*
+ * Wait until the shared bucket allows reading bytes more.  Reads are
+ * charged up front and an idle bucket does not save up, so the rate
+ * holds over any stretch, not just on average.  False when cancelled.
+ */
+static bool
+ramd_verify_throttle(ramd_verify_run_t* run, int64_t bytes)
+{
+	int64_t now;
+	int64_t wait_until;
+
+	if (run->rate_bytes <= 0)
+		return !atomic_load(&g_verify_cancel);
+
+	pthread_mutex_lock(&run->lock);
+	now = ramd_clock_now_us();
+	if (run->next_read_us < now)
+		run->next_read_us = now;
+	wait_until = run->next_read_us;
+	run->next_read_us += bytes * 1000000 / run->rate_bytes;
+	pthread_mutex_unlock(&run->lock);
+
+	while (now < wait_until)
+	{
+		int64_t left = wait_until - now;
+
+		if (atomic_load(&g_verify_cancel))
+			return false;
+		/* In slices, so a stop does not wait out a slow budget */
+		ramd_verify_sleep_us(left < 100000 ? left : 100000);
+		now = ramd_clock_now_us();
+	}
+	return !atomic_load(&g_verify_cancel);
+}
+
+/* Read one file back and compare it with its manifest entry */
+static bool
+ramd_verify_check_file(ramd_verify_run_t* run, const ramd_verify_file_t* file,
+                       unsigned char* buffer, char* problem, size_t problem_size,
+                       int64_t* bytes)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	unsigned char digest[RAMD_VERIFY_MAX_CHECKSUM];
+	const EVP_MD* md = ramd_verify_digest(file->algorithm);
+	EVP_MD_CTX* ctx = NULL;
+	struct stat st;
+	uint32_t crc = 0xFFFFFFFFU;
+	off_t offset = 0;
+	bool ok = true;
+	int fd;
+
+	*bytes = 0;
+	if (!ramd_verify_path(path, sizeof(path), run->root, file->path, NULL))
+	{
+		snprintf(problem, problem_size, "%s: path too long", file->path);
+		return false;
+	}
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		snprintf(problem, problem_size, "%s: %s", file->path, strerror(errno));
+		return false;
+	}
+	if (fstat(fd, &st) != 0)
+	{
+		snprintf(problem, problem_size, "%s: %s", file->path, strerror(errno));
+		close(fd);
+		return false;
+	}
+	if ((int64_t) st.st_size != file->size)
+	{
+		snprintf(problem, problem_size, "%s: size %lld, manifest says %lld", file->path,
+		         (long long) st.st_size, (long long) file->size);
+		close(fd);
+		return false;
+	}
+	if (file->algorithm == RAMD_VERIFY_ALG_NONE)
+	{
+		close(fd);
+		return true;
+	}
+	if (md)
+	{
+		ctx = EVP_MD_CTX_new();
+		if (!ctx || EVP_DigestInit_ex(ctx, md, NULL) != 1)
+		{
+			snprintf(problem, problem_size, "%s: cannot set up the digest", file->path);
+			EVP_MD_CTX_free(ctx);
+			close(fd);
+			return false;
+		}
+	}
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	(void) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	for (;;)
+	{
+		int64_t left = file->size - (int64_t) offset;
+		size_t want = left > RAMD_BACKUP_VERIFY_IO_BLOCK ? RAMD_BACKUP_VERIFY_IO_BLOCK
+		                                                  : (size_t) (left > 0 ? left : 1);
+		ssize_t n;
+
+		if (!ramd_verify_throttle(run, (int64_t) want))
+		{
+			snprintf(problem, problem_size, "%s: cancelled", file->path);
+			ok = false;
+			break;
+		}
+		n = read(fd, buffer, want);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+		{
+			snprintf(problem, problem_size, "%s: %s", file->path, strerror(errno));
+			ok = false;
+			break;
+		}
+		if (n == 0)
+			break;
+		if (md)
+			EVP_DigestUpdate(ctx, buffer, (size_t) n);
+		else
+			crc = ramd_crc32c_update(crc, buffer, (size_t) n);
+#ifdef POSIX_FADV_DONTNEED
+		/* The database's working set stays in the cache, not the backup */
+		(void) posix_fadvise(fd, offset, (off_t) n, POSIX_FADV_DONTNEED);
+#endif
+		offset += (off_t) n;
+		*bytes += (int64_t) n;
+	}
+	close(fd);
+
+	if (ok && (int64_t) offset != file->size)
+	{
+		snprintf(problem, problem_size, "%s: read %lld bytes, manifest says %lld", file->path,
+		         (long long) offset, (long long) file->size);
+		ok = false;
+	}
+	if (ok)
+	{
+		if (md)
+		{
+			unsigned int length = 0;
+
+			ok = EVP_DigestFinal_ex(ctx, digest, &length) == 1 &&
+			     (int32_t) length == file->checksum_length;
+		}
+		else
+		{
+			/* The manifest holds the final value in the server's byte order */
+			crc ^= 0xFFFFFFFFU;
+			memcpy(digest, &crc, sizeof(crc));
+		}
+		if (ok && memcmp(digest, file->checksum, (size_t) file->checksum_length) != 0)
+		{
+			snprintf(problem, problem_size, "%s: checksum mismatch", file->path);
+			ok = false;
+		}
+	}
+	EVP_MD_CTX_free(ctx);
+	return ok;
+}
+
+static void*
+ramd_verify_worker(void* arg)
+{
+	const ramd_process_priority_t background = {
+		RAMD_BACKUP_NICE, RAMD_BACKUP_IOPRIO_CLASS, RAMD_BACKUP_IOPRIO_LEVEL
+	};
+	ramd_verify_run_t* run = arg;
+	unsigned char* buffer;
+
+	ramd_process_lower_thread_priority(&background);
+	buffer = ramd_mem_alloc(RAMD_MEM_BACKUP, RAMD_BACKUP_VERIFY_IO_BLOCK);
+	if (!buffer)
+	{
+		pthread_mutex_lock(&run->lock);
+		ramd_verify_note(run, "out of memory");
+		pthread_mutex_unlock(&run->lock);
+		return NULL;
+	}
+
+	for (;;)
+	{
+		char problem[192];
+		int64_t bytes;
+		int32_t index;
+		bool ok;
+
+		pthread_mutex_lock(&run->lock);
+		if (run->next_file >= run->file_count || atomic_load(&g_verify_cancel))
+		{
+			pthread_mutex_unlock(&run->lock);
+			break;
+		}
+		index = run->next_file++;
+		pthread_mutex_unlock(&run->lock);
+
+		ok = ramd_verify_check_file(run, &run->files[index], buffer, problem, sizeof(problem),
+		                            &bytes);
+
+		pthread_mutex_lock(&run->lock);
+		run->files_checked++;
+		run->bytes_checked += bytes;
+		if (!ok)
+		{
+			run->files_failed++;
+			ramd_verify_note(run, problem);
+		}
+		pthread_mutex_unlock(&run->lock);
+	}
+
+	ramd_mem_free(RAMD_MEM_BACKUP, buffer);
+	return NULL;
+}
+
+/* Largest first, so the last file to finish is a small one */
+static int
+ramd_verify_file_cmp(const void* a, const void* b)
+{
+	const ramd_verify_file_t* fa = a;
+	const ramd_verify_file_t* fb = b;
+
+	return fa->size < fb->size ? 1 : fa->size > fb->size ? -1 : 0;
+}
+
+/* The whole manifest, NUL terminated, in *data; caller frees it */
+static bool
+ramd_verify_read_manifest(const char* path, char** data, size_t* length, char* error,
+                          size_t error_size)
+{
+	struct stat st;
+	size_t done = 0;
+	char* buf;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fstat(fd, &st) != 0)
+	{
+		ramd_format_message(error, error_size, "cannot read %s: %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return false;
+	}
+	if (st.st_size <= 0 || st.st_size > RAMD_BACKUP_VERIFY_MAX_MANIFEST)
+	{
+		ramd_format_message(error, error_size, "%s is %lld bytes", path, (long long) st.st_size);
+		close(fd);
+		return false;
+	}
+	buf = ramd_mem_alloc(RAMD_MEM_BACKUP, (size_t) st.st_size + 1);
+	if (!buf)
+	{
+		ramd_format_message(error, error_size, "out of memory reading %s", path);
+		close(fd);
+		return false;
+	}
+	while (done < (size_t) st.st_size)
+	{
+		ssize_t n = read(fd, buf + done, (size_t) st.st_size - done);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			ramd_format_message(error, error_size, "cannot read %s: %s", path,
+			                    n < 0 ? strerror(errno) : "file shrank");
+			ramd_mem_free(RAMD_MEM_BACKUP, buf);
+			close(fd);
+			return false;
+		}
+		done += (size_t) n;
+	}
+	close(fd);
+	buf[done] = '\0';
+	*data = buf;
+	*length = done;
+	return true;
+}
+
+/*
+ * Manifest-Checksum is SHA-256 of everything up to and including the
+ * newline before its own line, which must be the last one
+ */
+static bool
+ramd_verify_manifest_checksum(const char* data, size_t length, const char* expected,
+                              char* error, size_t error_size)
+{
+	unsigned char want[32];
+	unsigned char got[32];
+	unsigned int got_length = 0;
+	size_t last = 0;
+	size_t before_last = 0;
+	int newlines = 0;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		if (data[i] == '\n')
+		{
+			newlines++;
+			before_last = last;
+			last = i;
+		}
+	}
+	if (newlines < 2 || last != length - 1)
+	{
+		snprintf(error, error_size, "manifest does not end with its checksum line");
+		return false;
+	}
+	if (!expected || !ramd_verify_hex_decode(expected, want, sizeof(want)))
+	{
+		snprintf(error, error_size, "manifest has no valid Manifest-Checksum");
+		return false;
+	}
+	if (EVP_Digest(data, before_last + 1, got, &got_length, EVP_sha256(), NULL) != 1 ||
+	    got_length != sizeof(got) || memcmp(want, got, sizeof(got)) != 0)
+	{
+		snprintf(error, error_size, "manifest checksum mismatch");
+		return false;
+	}
+	return true;
+}
+
+/* Fill run->files from the manifest's "Files" array, paths in arena */
+static bool
+ramd_verify_load_files(ramd_verify_run_t* run, const json_t* manifest, ramd_arena_t* arena,
+                       char* error, size_t error_size)
+{
+	const json_t* files = json_object_get(manifest, "Files");
+	size_t count;
+
+	if (!files || !json_is_array(files))
+	{
+		snprintf(error, error_size, "manifest has no Files array");
+		return false;
+	}
+	count = json_array_size(files);
+	if (count > (size_t) INT32_MAX)
+	{
+		snprintf(error, error_size, "manifest lists too many files");
+		return false;
+	}
+	run->files = ramd_arena_calloc(arena, count > 0 ? count : 1, sizeof(ramd_verify_file_t));
+	if (!run->files)
+	{
+		snprintf(error, error_size, "out of memory for %zu manifest entries", count);
+		return false;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const json_t* entry = json_array_get(files, i);
+		const json_t* path = json_object_get(entry, "Path");
+		const json_t* encoded = json_object_get(entry, "Encoded-Path");
+		const json_t* size = json_object_get(entry, "Size");
+		const json_t* algorithm = json_object_get(entry, "Checksum-Algorithm");
+		const json_t* checksum = json_object_get(entry, "Checksum");
+		ramd_verify_file_t* file = &run->files[i];
+
+		if (path && json_is_string(path))
+		{
+			const char* p = json_string_value(path);
+
+			file->path = ramd_arena_strndup(arena, p, strlen(p));
+		}
+		else if (encoded && json_is_string(encoded))
+		{
+			const char* hex = json_string_value(encoded);
+			size_t len = strlen(hex) / 2;
+			unsigned char* decoded = ramd_arena_alloc(arena, len + 1);
+
+			if (decoded && ramd_verify_hex_decode(hex, decoded, len))
+			{
+				decoded[len] = '\0';
+				file->path = (const char*) decoded;
+			}
+		}
+		if (!file->path || !ramd_verify_safe_path(file->path))
+		{
+			snprintf(error, error_size, "manifest entry %zu has no usable path", i);
+			return false;
+		}
+		if (!size || !json_is_integer(size) || json_integer_value(size) < 0)
+		{
+			snprintf(error, error_size, "%s: manifest entry has no Size", file->path);
+			return false;
+		}
+		file->size = (int64_t) json_integer_value(size);
+
+		if (!algorithm)
+			continue; /* taken with --manifest-checksums=none */
+		if (!json_is_string(algorithm) ||
+		    !ramd_verify_parse_algorithm(json_string_value(algorithm), &file->algorithm,
+		                                 &file->checksum_length))
+		{
+			snprintf(error, error_size, "%s: unknown checksum algorithm", file->path);
+			return false;
+		}
+		if (file->algorithm != RAMD_VERIFY_ALG_NONE &&
+		    (!checksum || !json_is_string(checksum) ||
+		     !ramd_verify_hex_decode(json_string_value(checksum), file->checksum,
+		                             (size_t) file->checksum_length)))
+		{
+			snprintf(error, error_size, "%s: manifest checksum is malformed", file->path);
+			return false;
+		}
+	}
+	run->file_count = (int32_t) count;
+	return true;
+}
+
+/* pg_verifybackup from postgresql_bin_dir, else from PATH */
+static bool
+ramd_verify_find_pg_verifybackup(const ramd_config_t* config, char* path, size_t size)
+{
+	int len = snprintf(path, size, "%s/pg_verifybackup", config->postgresql_bin_dir);
+
+	if (len > 0 && (size_t) len < size && access(path, X_OK) == 0)
+		return true;
+	return ramd_process_find_program("pg_verifybackup", path, size);
+}
+
+/* First non-empty line of a tool's stderr, else stdout */
+static void
+ramd_verify_first_line(const ramd_process_result_t* result, char* out, size_t size)
+{
+	const char* text = result->err_length > 0 ? result->err : result->out;
+	size_t len;
+
+	while (*text == '\n' || *text == '\r')
+		text++;
+	len = strcspn(text, "\r\n");
+	snprintf(out, size, "%.*s", (int) len, text);
+}
+
+/*
+ * Run a verify command at background priority; true if it passed.  On
+ * failure problem says why.
+ */
+static bool
+ramd_verify_run_tool(const char* const argv[], char* problem, size_t problem_size)
+{
+	const ramd_process_priority_t background = {
+		RAMD_BACKUP_NICE, RAMD_BACKUP_IOPRIO_CLASS, RAMD_BACKUP_IOPRIO_LEVEL
+	};
+	ramd_process_result_t* result;
+	bool ok;
+
+	result = ramd_mem_alloc(RAMD_MEM_BACKUP, sizeof(*result));
+	if (!result)
+	{
+		snprintf(problem, problem_size, "out of memory running %s", argv[0]);
+		return false;
+	}
+	ok = ramd_process_run_with_priority(argv, 0, &g_verify_cancel, &background, result);
+	if (!ok)
+	{
+		char line[256];
+
+		ramd_verify_first_line(result, line, sizeof(line));
+		if (!result->spawned)
+			snprintf(problem, problem_size, "cannot run %s", argv[0]);
+		else if (result->cancelled)
+			snprintf(problem, problem_size, "%s cancelled", argv[0]);
+		else
+			snprintf(problem, problem_size, "%s", line[0] ? line : "verify command failed");
+	}
+	ramd_mem_free(RAMD_MEM_BACKUP, result);
+	return ok;
+}
+
+static void
+ramd_verify_native(const ramd_config_t* config, const char* backup_id,
+                   ramd_backup_verify_result_t* result)
+{
+	ramd_verify_run_t run;
+	ramd_arena_t arena;
+	json_error_t json_error;
+	json_t* manifest = NULL;
+	char manifest_path[RAMD_MAX_PATH_LENGTH];
+	char version_path[RAMD_MAX_PATH_LENGTH];
+	char program[RAMD_MAX_PATH_LENGTH];
+	char error[256] = "";
+	char* data = NULL;
+	size_t length = 0;
+	pthread_t workers[RAMD_BACKUP_VERIFY_MAX_WORKERS];
+	int32_t wanted;
+	int32_t started = 0;
+	bool plain;
+	bool have_tool;
+	const json_t* checksum;
+
+	memset(&run, 0, sizeof(run));
+	pthread_mutex_init(&run.lock, NULL);
+	ramd_arena_init(&arena, RAMD_MEM_BACKUP, 64 * 1024);
+
+	if (!ramd_verify_path(run.root, sizeof(run.root), config->backup_dir, backup_id, NULL) ||
+	    !ramd_verify_path(manifest_path, sizeof(manifest_path), run.root, RAMD_VERIFY_MANIFEST, NULL) ||
+	    !ramd_verify_path(version_path, sizeof(version_path), run.root, "PG_VERSION", NULL))
+	{
+		snprintf(result->message, sizeof(result->message), "Backup path is too long");
+		goto done;
+	}
+	if (access(run.root, F_OK) != 0)
+	{
+		ramd_format_message(result->message, sizeof(result->message), "Backup %s not found in %s",
+		                    backup_id, config->backup_dir);
+		goto done;
+	}
+	if (access(manifest_path, R_OK) != 0)
+	{
+		ramd_format_message(result->message, sizeof(result->message),
+		                    "No %s in %s: nothing to verify it against", RAMD_VERIFY_MANIFEST, run.root);
+		goto done;
+	}
+
+	/* The manifest first: if it is damaged nothing it says can be trusted */
+	if (!ramd_verify_read_manifest(manifest_path, &data, &length, error, sizeof(error)))
+		goto failed;
+	manifest = json_loads(data, 0, &json_error);
+	if (!manifest || !json_is_object(manifest))
+	{
+		snprintf(error, sizeof(error), "manifest is not valid JSON (line %d): %s",
+		         json_error.line, json_error.text);
+		goto failed;
+	}
+	checksum = json_object_get(manifest, "Manifest-Checksum");
+	if (!ramd_verify_manifest_checksum(data, length,
+	                                   checksum && json_is_string(checksum) ? json_string_value(checksum) : NULL,
+	                                   error, sizeof(error)) ||
+	    !ramd_verify_load_files(&run, manifest, &arena, error, sizeof(error)))
+		goto failed;
+
+	/*
+	 * The structure next, since it costs a directory walk and catches a
+	 * truncated copy before any of it is read.  A tar backup's files are
+	 * inside the archives, so there pg_verifybackup checks everything.
+	 */
+	plain = access(version_path, F_OK) == 0;
+	have_tool = ramd_verify_find_pg_verifybackup(config, program, sizeof(program));
+	if (have_tool)
+	{
+		const char* argv[5];
+		int argc = 0;
+
+		argv[argc++] = program;
+		if (plain)
+			argv[argc++] = "--skip-checksums";
+		argv[argc++] = "--quiet";
+		argv[argc++] = run.root;
+		argv[argc] = NULL;
+		if (!ramd_verify_run_tool(argv, error, sizeof(error)))
+			goto failed;
+	}
+	if (!plain)
+	{
+		if (!have_tool)
+		{
+			snprintf(error, sizeof(error),
+			         "tar format backup and pg_verifybackup is not installed");
+			goto failed;
+		}
+		result->valid = true;
+		result->files_checked = run.file_count;
+		snprintf(result->message, sizeof(result->message),
+		         "Manifest and pg_verifybackup passed for the tar format backup");
+		goto done;
+	}
+
+	qsort(run.files, (size_t) run.file_count, sizeof(ramd_verify_file_t), ramd_verify_file_cmp);
+	run.rate_bytes = (int64_t) config->backup_verify_max_rate_kbps * 1024;
+	wanted = config->backup_verify_workers;
+	if (wanted > RAMD_BACKUP_VERIFY_MAX_WORKERS)
+		wanted = RAMD_BACKUP_VERIFY_MAX_WORKERS;
+	if (wanted > run.file_count)
+		wanted = run.file_count;
+	for (; started < wanted; started++)
+		if (pthread_create(&workers[started], NULL, ramd_verify_worker, &run) != 0)
+			break;
+	if (started == 0 && run.file_count > 0)
+		ramd_verify_worker(&run);
+	for (int32_t i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	result->files_checked = run.files_checked;
+	result->files_failed = run.files_failed;
+	result->bytes_checked = run.bytes_checked;
+	if (run.files_failed > 0 || run.files_checked < run.file_count)
+	{
+		if (run.files_failed > 0)
+			snprintf(result->message, sizeof(result->message), "%d of %d files failed: %s",
+			         run.files_failed, run.file_count, run.problems);
+		else
+			snprintf(result->message, sizeof(result->message), "%d of %d files checked%s%s",
+			         run.files_checked, run.file_count, run.problems[0] ? ": " : "",
+			         run.problems);
+		goto done;
+	}
+	result->valid = true;
+	snprintf(result->message, sizeof(result->message),
+	         "%d files, %lld MB, match the manifest%s", run.files_checked,
+	         (long long) (run.bytes_checked / (1024 * 1024)),
+	         have_tool ? "; pg_verifybackup found the backup complete"
+	                   : "; pg_verifybackup is not installed, stray files and WAL not checked");
+	goto done;
+
+failed:
+	snprintf(result->message, sizeof(result->message), "%s", error);
+done:
+	if (manifest)
+		json_decref(manifest);
+	if (data)
+		ramd_mem_free(RAMD_MEM_BACKUP, data);
+	ramd_arena_destroy(&arena);
+	pthread_mutex_destroy(&run.lock);
+}
+
+static void
+ramd_verify_with_tool(const ramd_config_t* config, const char* tool, const char* backup_id,
+                      ramd_backup_verify_result_t* result)
+{
+	char program[RAMD_MAX_PATH_LENGTH];
+	char set[RAMD_BACKUP_VERIFY_ID_LENGTH + 8];
+	char processes[32];
+	char error[256] = "";
+	const char* argv[8];
+	int argc = 0;
+
+	if (!ramd_process_find_program(tool, program, sizeof(program)))
+	{
+		snprintf(result->message, sizeof(result->message), "%s is not installed", tool);
+		return;
+	}
+
+	argv[argc++] = program;
+	if (strcmp(tool, "pgbackrest") == 0)
+	{
+		/* The tool parallelises itself; it has no rate limit of its own */
+		snprintf(processes, sizeof(processes), "--process-max=%d", config->backup_verify_workers);
+		argv[argc++] = "--stanza=" RAMD_BACKUP_VERIFY_STANZA;
+		argv[argc++] = processes;
+		if (strcmp(backup_id, "latest") != 0)
+		{
+			snprintf(set, sizeof(set), "--set=%s", backup_id);
+			argv[argc++] = set;
+		}
+		argv[argc++] = "verify";
+	}
+	else
+	{
+		/* barman runs pg_verifybackup on its copy and knows "latest" */
+		argv[argc++] = "verify-backup";
+		argv[argc++] = config->cluster_name;
+		argv[argc++] = backup_id;
+	}
+	argv[argc] = NULL;
+
+	result->valid = ramd_verify_run_tool(argv, error, sizeof(error));
+	snprintf(result->message, sizeof(result->message), "%s verify %s%s%s", tool,
+	         result->valid ? "passed" : "failed", error[0] ? ": " : "", error);
+}
+
+/* What identifies the manifest a native result was for; 0 if there is none */
+static int64_t
+ramd_verify_stamp(const ramd_config_t* config, const char* tool, const char* backup_id)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	struct stat st;
+
+	if (strcmp(tool, "native") != 0 ||
+	    !ramd_verify_path(path, sizeof(path), config->backup_dir, backup_id, RAMD_VERIFY_MANIFEST) ||
+	    stat(path, &st) != 0)
+		return 0;
+	return (int64_t) st.st_mtime * 1000000000LL + (int64_t) st.st_size;
+}
+
+/* Caller holds g_verify.lock */
+static ramd_verify_entry_t*
+ramd_verify_find(const char* tool, const char* backup_id)
+{
+	for (int i = 0; i < RAMD_BACKUP_VERIFY_CACHE_SIZE; i++)
+	{
+		ramd_verify_entry_t* entry = &g_verify.entries[i];
+
+		if (entry->in_use && strcmp(entry->tool, tool) == 0 &&
+		    strcmp(entry->backup_id, backup_id) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+/* A free entry, else the least recently used one not running; caller holds g_verify.lock */
+static ramd_verify_entry_t*
+ramd_verify_claim(const char* tool, const char* backup_id)
+{
+	ramd_verify_entry_t* victim = NULL;
+
+	for (int i = 0; i < RAMD_BACKUP_VERIFY_CACHE_SIZE; i++)
+	{
+		ramd_verify_entry_t* entry = &g_verify.entries[i];
+
+		if (!entry->in_use)
+		{
+			victim = entry;
+			break;
+		}
+		if (!entry->running && (!victim || entry->sequence < victim->sequence))
+			victim = entry;
+	}
+	if (!victim)
+		return NULL;
+	memset(victim, 0, sizeof(*victim));
+	victim->in_use = true;
+	snprintf(victim->tool, sizeof(victim->tool), "%s", tool);
+	snprintf(victim->backup_id, sizeof(victim->backup_id), "%s", backup_id);
+	return victim;
+}
+
+/* Caller holds g_verify.lock */
+static bool
+ramd_verify_fresh(const ramd_config_t* config, const ramd_verify_entry_t* entry, int64_t stamp)
+{
+	return entry->has_result && entry->stamp == stamp &&
+	       ramd_clock_now_ms() - entry->result.verified_ms < config->backup_verify_cache_ttl_ms;
+}
+
+bool
+ramd_backup_verify_run(const char* backup_id, bool force, ramd_backup_verify_result_t* result)
+{
+	const ramd_config_t* config;
+	ramd_verify_entry_t* entry;
+	char tool[32];
+	int64_t stamp;
+	int64_t started_ms;
+	bool cancelled;
+
+	if (!result || !ramd_verify_valid_id(backup_id))
+		return false;
+	memset(result, 0, sizeof(*result));
+
+	pthread_mutex_lock(&g_verify.lock);
+	config = g_verify.config;
+	if (!config)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return false;
+	}
+	snprintf(tool, sizeof(tool), "%s", config->backup_verify_tool);
+	pthread_mutex_unlock(&g_verify.lock);
+
+	stamp = ramd_verify_stamp(config, tool, backup_id);
+
+	pthread_mutex_lock(&g_verify.lock);
+	/* Someone is reading this backup already: their answer is ours */
+	while ((entry = ramd_verify_find(tool, backup_id)) != NULL && entry->running)
+	{
+		if (atomic_load(&g_verify_cancel))
+		{
+			pthread_mutex_unlock(&g_verify.lock);
+			return false;
+		}
+		pthread_cond_wait(&g_verify.done, &g_verify.lock);
+	}
+	if (entry && !force && ramd_verify_fresh(config, entry, stamp))
+	{
+		*result = entry->result;
+		result->cached = true;
+		entry->sequence = ++g_verify.sequence;
+		g_verify.stats.cache_hits++;
+		pthread_mutex_unlock(&g_verify.lock);
+		return true;
+	}
+	if (!entry)
+		entry = ramd_verify_claim(tool, backup_id);
+	if (entry)
+		entry->running = true;
+	pthread_mutex_unlock(&g_verify.lock);
+
+	pthread_mutex_lock(&g_verify.run_lock);
+	started_ms = ramd_clock_now_ms();
+	snprintf(result->backup_id, sizeof(result->backup_id), "%s", backup_id);
+	snprintf(result->tool, sizeof(result->tool), "%s", tool);
+	if (strcmp(tool, "native") == 0)
+		ramd_verify_native(config, backup_id, result);
+	else
+		ramd_verify_with_tool(config, tool, backup_id, result);
+	result->verified_ms = ramd_clock_now_ms();
+	result->verified_at = time(NULL);
+	result->duration_ms = result->verified_ms - started_ms;
+	pthread_mutex_unlock(&g_verify.run_lock);
+
+	/* A run cut short by shutdown says nothing about the backup */
+	cancelled = atomic_load(&g_verify_cancel);
+	pthread_mutex_lock(&g_verify.lock);
+	if (entry)
+	{
+		entry->running = false;
+		entry->has_result = !cancelled;
+		entry->result = *result;
+		entry->stamp = stamp;
+		entry->sequence = ++g_verify.sequence;
+	}
+	if (!cancelled)
+	{
+		if (result->valid)
+			g_verify.stats.runs_valid++;
+		else
+			g_verify.stats.runs_invalid++;
+		g_verify.stats.files_checked += result->files_checked;
+		g_verify.stats.bytes_checked += result->bytes_checked;
+		g_verify.stats.last_duration_ms = result->duration_ms;
+		g_verify.stats.last_verified_ms = result->verified_ms;
+		g_verify.stats.last_valid = result->valid;
+	}
+	pthread_cond_broadcast(&g_verify.done);
+	pthread_mutex_unlock(&g_verify.lock);
+
+	if (cancelled)
+		return false;
+	if (result->valid)
+		ramd_log_info("Backup %s verified in %lld ms: %s", backup_id,
+		              (long long) result->duration_ms, result->message);
+	else
+		ramd_log_warning("Backup %s failed verification: %s", backup_id, result->message);
+	return true;
+}
+
+ramd_backup_verify_state_t
+ramd_backup_verify_lookup(const char* backup_id, ramd_backup_verify_result_t* result)
+{
+	const ramd_config_t* config;
+	ramd_verify_entry_t* entry;
+	ramd_backup_verify_state_t state = RAMD_BACKUP_VERIFY_UNKNOWN;
+	char tool[32];
+	int64_t stamp;
+
+	if (!ramd_verify_valid_id(backup_id))
+		return RAMD_BACKUP_VERIFY_UNKNOWN;
+
+	pthread_mutex_lock(&g_verify.lock);
+	config = g_verify.config;
+	if (!config)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return RAMD_BACKUP_VERIFY_UNKNOWN;
+	}
+	snprintf(tool, sizeof(tool), "%s", config->backup_verify_tool);
+	pthread_mutex_unlock(&g_verify.lock);
+
+	stamp = ramd_verify_stamp(config, tool, backup_id);
+
+	pthread_mutex_lock(&g_verify.lock);
+	entry = ramd_verify_find(tool, backup_id);
+	if (entry && entry->running)
+		state = RAMD_BACKUP_VERIFY_RUNNING;
+	else if (entry && ramd_verify_fresh(config, entry, stamp))
+	{
+		state = RAMD_BACKUP_VERIFY_DONE;
+		if (result)
+		{
+			*result = entry->result;
+			result->cached = true;
+		}
+		g_verify.stats.cache_hits++;
+	}
+	else
+	{
+		for (int32_t i = 0; i < g_verify.queue_length; i++)
+			if (strcmp(g_verify.queue[(g_verify.queue_head + i) % RAMD_BACKUP_VERIFY_QUEUE],
+			           backup_id) == 0)
+				state = RAMD_BACKUP_VERIFY_RUNNING;
+	}
+	pthread_mutex_unlock(&g_verify.lock);
+	return state;
+}
+
+bool
+ramd_backup_verify_request(const char* backup_id)
+{
+	int32_t slot;
+
+	if (!ramd_verify_valid_id(backup_id))
+		return false;
+
+	pthread_mutex_lock(&g_verify.lock);
+	if (!g_verify.running)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return false;
+	}
+	for (int32_t i = 0; i < g_verify.queue_length; i++)
+	{
+		if (strcmp(g_verify.queue[(g_verify.queue_head + i) % RAMD_BACKUP_VERIFY_QUEUE],
+		           backup_id) == 0)
+		{
+			pthread_mutex_unlock(&g_verify.lock);
+			return true;
+		}
+	}
+	if (g_verify.queue_length == RAMD_BACKUP_VERIFY_QUEUE)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return false;
+	}
+	slot = (g_verify.queue_head + g_verify.queue_length) % RAMD_BACKUP_VERIFY_QUEUE;
+	snprintf(g_verify.queue[slot], sizeof(g_verify.queue[slot]), "%s", backup_id);
+	g_verify.queue_length++;
+	pthread_cond_signal(&g_verify.work);
+	pthread_mutex_unlock(&g_verify.lock);
+	return true;
+}
+
+/* Background verifier: runs queued requests one after another */
+static void*
+ramd_verify_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_verify.lock);
+	while (g_verify.running)
+	{
+		char backup_id[RAMD_BACKUP_VERIFY_ID_LENGTH];
+		ramd_backup_verify_result_t result;
+
+		if (g_verify.queue_length == 0)
+		{
+			pthread_cond_wait(&g_verify.work, &g_verify.lock);
+			continue;
+		}
+		snprintf(backup_id, sizeof(backup_id), "%s", g_verify.queue[g_verify.queue_head]);
+		pthread_mutex_unlock(&g_verify.lock);
+
+		/* Still in the queue until it has an entry, so lookups see it as pending */
+		(void) ramd_backup_verify_run(backup_id, false, &result);
+
+		pthread_mutex_lock(&g_verify.lock);
+		g_verify.queue_head = (g_verify.queue_head + 1) % RAMD_BACKUP_VERIFY_QUEUE;
+		g_verify.queue_length--;
+	}
+	pthread_mutex_unlock(&g_verify.lock);
+	return NULL;
+}
+
+bool
+ramd_backup_verify_start(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+
+	pthread_once(&g_crc32c_once, ramd_crc32c_init);
+
+	pthread_mutex_lock(&g_verify.lock);
+	g_verify.config = config;
+	if (g_verify.running)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return true;
+	}
+	atomic_store(&g_verify_cancel, false);
+	g_verify.queue_head = 0;
+	g_verify.queue_length = 0;
+	g_verify.running = true;
+	if (pthread_create(&g_verify.thread, NULL, ramd_verify_thread_main, NULL) != 0)
+	{
+		g_verify.running = false;
+		pthread_mutex_unlock(&g_verify.lock);
+		ramd_log_error("Backup verifier: cannot start thread: %s", strerror(errno));
+		return false;
+	}
+	pthread_mutex_unlock(&g_verify.lock);
+
+	ramd_log_info("Backup verifier started: %s, %d workers, %s", config->backup_verify_tool,
+	              config->backup_verify_workers,
+	              config->backup_verify_max_rate_kbps > 0 ? "rate limited" : "no rate limit");
+	return true;
+}
+
+void
+ramd_backup_verify_stop(void)
+{
+	pthread_mutex_lock(&g_verify.lock);
+	if (!g_verify.running)
+	{
+		pthread_mutex_unlock(&g_verify.lock);
+		return;
+	}
+	g_verify.running = false;
+	atomic_store(&g_verify_cancel, true);
+	pthread_cond_broadcast(&g_verify.work);
+	pthread_cond_broadcast(&g_verify.done);
+	pthread_mutex_unlock(&g_verify.lock);
+
+	pthread_join(g_verify.thread, NULL);
+}
+
+bool
+ramd_backup_verify_latest(char* backup_id, size_t size)
+{
+	const ramd_config_t* config;
+	struct dirent* de;
+	DIR* dir;
+	time_t newest = 0;
+	bool found = false;
+
+	if (!backup_id || size == 0)
+		return false;
+
+	pthread_mutex_lock(&g_verify.lock);
+	config = g_verify.config;
+	pthread_mutex_unlock(&g_verify.lock);
+	if (!config)
+		return false;
+	if (strcmp(config->backup_verify_tool, "native") != 0)
+	{
+		snprintf(backup_id, size, "latest");
+		return true;
+	}
+
+	dir = opendir(config->backup_dir);
+	if (!dir)
+		return false;
+	while ((de = readdir(dir)) != NULL)
+	{
+		char label[RAMD_MAX_PATH_LENGTH];
+		struct stat st;
+
+		if (!ramd_verify_valid_id(de->d_name) || strlen(de->d_name) >= size ||
+		    !ramd_verify_path(label, sizeof(label), config->backup_dir, de->d_name, RAMD_VERIFY_LABEL))
+			continue;
+		/* A tar backup keeps its label inside base.tar; its manifest dates it as well */
+		if (stat(label, &st) != 0 &&
+		    (!ramd_verify_path(label, sizeof(label), config->backup_dir, de->d_name,
+		                       RAMD_VERIFY_MANIFEST) ||
+		     stat(label, &st) != 0))
+			continue;
+		if (!found || st.st_mtime > newest)
+		{
+			newest = st.st_mtime;
+			snprintf(backup_id, size, "%s", de->d_name);
+			found = true;
+		}
+	}
+	closedir(dir);
+	return found;
+}
+
+bool
+ramd_backup_verify_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_verify_stats_t stats;
+	bool running;
+	bool ok = true;
+
+	if (!output)
+		return false;
+	pthread_mutex_lock(&g_verify.lock);
+	stats = g_verify.stats;
+	running = g_verify.running;
+	pthread_mutex_unlock(&g_verify.lock);
+	if (!running)
+		return true;
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_backup_verify_runs_total Backup verifications by outcome\n"
+		"# TYPE ramd_backup_verify_runs_total counter\n"
+		"ramd_backup_verify_runs_total{result=\"valid\"} %lld\n"
+		"ramd_backup_verify_runs_total{result=\"invalid\"} %lld\n"
+		"\n# HELP ramd_backup_verify_cache_hits_total Verification results served from the cache\n"
+		"# TYPE ramd_backup_verify_cache_hits_total counter\n"
+		"ramd_backup_verify_cache_hits_total %lld\n"
+		"\n# HELP ramd_backup_verify_files_total Backup files read back and compared\n"
+		"# TYPE ramd_backup_verify_files_total counter\n"
+		"ramd_backup_verify_files_total %lld\n"
+		"\n# HELP ramd_backup_verify_bytes_total Backup bytes read back and compared\n"
+		"# TYPE ramd_backup_verify_bytes_total counter\n"
+		"ramd_backup_verify_bytes_total %lld\n",
+		(long long) stats.runs_valid, (long long) stats.runs_invalid,
+		(long long) stats.cache_hits, (long long) stats.files_checked,
+		(long long) stats.bytes_checked);
+
+	if (stats.last_verified_ms > 0)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_backup_verify_last_valid Whether the last verified backup was sound\n"
+			"# TYPE ramd_backup_verify_last_valid gauge\n"
+			"ramd_backup_verify_last_valid %d\n"
+			"\n# HELP ramd_backup_verify_last_duration_seconds Duration of the last verification\n"
+			"# TYPE ramd_backup_verify_last_duration_seconds gauge\n"
+			"ramd_backup_verify_last_duration_seconds %.3f\n"
+			"\n# HELP ramd_backup_verify_last_age_seconds Time since a backup was last verified\n"
+			"# TYPE ramd_backup_verify_last_age_seconds gauge\n"
+			"ramd_backup_verify_last_age_seconds %.3f\n",
+			stats.last_valid ? 1 : 0, (double) stats.last_duration_ms / 1000.0,
+			(double) (ramd_clock_now_ms() - stats.last_verified_ms) / 1000.0);
+	return ok;
+}
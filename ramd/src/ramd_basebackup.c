@@ -6,166 +6,1032 @@
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
  * This file implements base backup functionality for the ramd daemon.
- * It provides functions to take and manage base backups using pg_basebackup.
+ * Backups are taken over a physical replication connection with the
+ * BASE_BACKUP command and written directly, either unpacked (plain) or
+ * as the tar archives the server sends.
+ *
+ * Servers before 15 send one COPY stream per tablespace followed by an
+ * optional manifest stream; 15 and later send a single COPY stream of
+ * typed messages ('n' new archive, 'd' data, 'p' progress, 'm' manifest).
+ *
+ * A plain-format backup may also be unpacked into mirror directories as it
+ * streams, so several standbys on one host are seeded from a single read
+ * of the source.  The mirrors get the same files, manifest and recovery
+ * settings as the target directory.
  *
  *-------------------------------------------------------------------------
  */
 
 #include "libpq-fe.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "ramd_basebackup.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
 #include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_process.h"
 
-typedef struct BaseBackupOptions
-{
-    char *label;
-    char *target_dir;
-    bool progress;
-    bool verbose;
-    bool write_recovery_conf;
-    bool verify_checksums;
-    int compression_level;
-    int max_rate;
-    int wal_method;
-    int nthreads;
-} BaseBackupOptions;
-
-static int execute_pg_basebackup(const char *conninfo, BaseBackupOptions *options);
-static void validate_backup_options(BaseBackupOptions *options);
-static char* build_basebackup_command(const char *conninfo, BaseBackupOptions *options);
-
-int 
-ramd_take_basebackup(PGconn *conn, const char *target_dir, const char *label)
+#define TAR_BLOCK_SIZE 512
+
+/* Buffered, aligned output file */
+typedef struct BaseBackupWriter
 {
-    BaseBackupOptions options;
-    char *conninfo;
-    int ret;
+    int fd;
+    char *buf;
+    size_t len;
+    char path[RAMD_MAX_PATH_LENGTH];
+} BaseBackupWriter;
 
-    memset(&options, 0, sizeof(BaseBackupOptions));
-    options.label = (char *)label;
-    options.target_dir = (char *)target_dir;
-    options.progress = true;
-    options.verbose = true;
-    options.write_recovery_conf = true;
-    options.verify_checksums = true;
-    options.compression_level = 9;
-    options.max_rate = 0;
-    options.wal_method = 1;
-    options.nthreads = 4;
+#define BASEBACKUP_MAX_TARGETS (1 + RAMD_BASEBACKUP_MAX_MIRRORS)
 
-    char conninfo_buffer[512];
-    snprintf(conninfo_buffer, sizeof(conninfo_buffer), "host=%s port=%s dbname=%s user=%s",
-             PQhost(conn), PQport(conn), PQdb(conn), PQuser(conn));
-    conninfo = conninfo_buffer;
+/* The archive being received; plain format unpacks it as it arrives */
+typedef struct BaseBackupArchive
+{
+    bool open;
+    char root[RAMD_MAX_PATH_LENGTH]; /* in the target directory; mirrors by name */
+    unsigned char header[TAR_BLOCK_SIZE];
+    size_t header_len;
+    uint64_t file_remaining;
+    uint64_t pad_remaining;
+} BaseBackupArchive;
 
-    validate_backup_options(&options);
+typedef struct BaseBackupTablespace
+{
+    char oid[32];
+    char location[RAMD_MAX_PATH_LENGTH]; /* empty for the base directory */
+} BaseBackupTablespace;
 
-    ret = execute_pg_basebackup(conninfo, &options);
+typedef struct BaseBackupState
+{
+    const ramd_basebackup_options_t *options;
+    PGconn *conn;
+    int server_version;
+    BaseBackupTablespace *tablespaces;
+    int tablespace_count;
+    BaseBackupArchive archive;
+    const char *targets[BASEBACKUP_MAX_TARGETS]; /* target_dir, then the mirrors */
+    int target_count;
+    BaseBackupWriter out[BASEBACKUP_MAX_TARGETS]; /* current file, tar archive or manifest */
+    bool in_manifest;
+    int64_t started_ms;
+    int64_t last_report_ms;
+    ramd_basebackup_progress_t progress;
+} BaseBackupState;
 
-    PQfreemem(conninfo);
-    return ret;
+static bool
+is_cancelled(const BaseBackupState *st)
+{
+    return st->options->cancel && atomic_load(st->options->cancel);
 }
 
 static void
-validate_backup_options(BaseBackupOptions *options)
+report_progress(BaseBackupState *st, bool force)
+{
+    ramd_basebackup_progress_t *p = &st->progress;
+    int64_t now = ramd_clock_now_ms() - st->started_ms;
+
+    if (!force && now - st->last_report_ms < RAMD_BASEBACKUP_PROGRESS_INTERVAL_MS)
+        return;
+    st->last_report_ms = now;
+
+    p->elapsed_ms = now;
+    p->bytes_per_second = now > 0 ? p->bytes_done * 1000 / now : 0;
+    if (p->bytes_total > p->bytes_done && p->bytes_per_second > 0)
+        p->eta_seconds = (p->bytes_total - p->bytes_done) / p->bytes_per_second;
+    else
+        p->eta_seconds = p->bytes_total > 0 ? 0 : -1;
+
+    if (st->options->progress)
+        st->options->progress(p, st->options->progress_arg);
+}
+
+static bool
+write_all(int fd, const char *data, size_t len, const char *path)
 {
-    if (!options->target_dir)
+    while (len > 0)
     {
-        ramd_log_error("Target directory must be specified");
-        exit(1);
+        ssize_t n = write(fd, data, len);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ramd_log_error("Base backup: cannot write %s: %s", path, strerror(errno));
+            return false;
+        }
+        data += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+static bool
+writer_open(BaseBackupWriter *w, const char *path, mode_t mode)
+{
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->len = 0;
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    if (w->fd < 0)
+    {
+        ramd_log_error("Base backup: cannot create %s: %s", path, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool
+writer_flush(BaseBackupWriter *w)
+{
+    bool ok = write_all(w->fd, w->buf, w->len, w->path);
+
+    w->len = 0;
+    return ok;
+}
+
+static bool
+writer_write(BaseBackupWriter *w, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t n;
+
+        /* Whole buffers bypass the copy when nothing is pending */
+        if (w->len == 0 && len >= RAMD_BASEBACKUP_WRITE_BUFFER)
+        {
+            n = len - len % RAMD_BASEBACKUP_WRITE_BUFFER;
+            if (!write_all(w->fd, data, n, w->path))
+                return false;
+            data += n;
+            len -= n;
+            continue;
+        }
+
+        n = RAMD_BASEBACKUP_WRITE_BUFFER - w->len;
+        if (n > len)
+            n = len;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+
+        if (w->len == RAMD_BASEBACKUP_WRITE_BUFFER && !writer_flush(w))
+            return false;
+    }
+    return true;
+}
+
+static bool
+writer_close(BaseBackupWriter *w)
+{
+    bool ok;
+
+    if (w->fd < 0)
+        return true;
+
+    ok = writer_flush(w);
+    if (ok && fsync(w->fd) != 0)
+    {
+        ramd_log_error("Base backup: cannot fsync %s: %s", w->path, strerror(errno));
+        ok = false;
+    }
+    if (close(w->fd) != 0 && ok)
+    {
+        ramd_log_error("Base backup: cannot close %s: %s", w->path, strerror(errno));
+        ok = false;
+    }
+    w->fd = -1;
+    return ok;
+}
+
+/* The same bytes to the current file of every target */
+static bool
+outs_write(BaseBackupState *st, const char *data, size_t len)
+{
+    for (int i = 0; i < st->target_count; i++)
+        if (!writer_write(&st->out[i], data, len))
+            return false;
+    return true;
+}
+
+static bool
+outs_close(BaseBackupState *st)
+{
+    bool ok = true;
+
+    for (int i = 0; i < st->target_count; i++)
+        ok = writer_close(&st->out[i]) && ok;
+    return ok;
+}
+
+/* Where archive member name lands for target i */
+static bool
+member_path(const BaseBackupState *st, int i, const char *name, char *path, size_t size)
+{
+    const char *root = i == 0 ? st->archive.root : st->targets[i];
+
+    if ((size_t) snprintf(path, size, "%s/%s", root, name) >= size)
+    {
+        ramd_log_error("Base backup: path too long for archive member \"%s\"", name);
+        return false;
+    }
+    return true;
+}
+
+/* Create path, or accept it if it is an empty directory, as pg_basebackup does */
+static bool
+prepare_directory(const char *path)
+{
+    DIR *dir;
+    struct dirent *de;
+    bool empty = true;
+
+    dir = opendir(path);
+    if (!dir)
+    {
+        if (errno == ENOENT)
+            return ramd_process_make_directory(path, 0700);
+        ramd_log_error("Base backup: cannot open %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    while ((de = readdir(dir)) != NULL)
+    {
+        if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+        {
+            empty = false;
+            break;
+        }
+    }
+    closedir(dir);
+
+    if (!empty)
+        ramd_log_error("Base backup: directory %s exists and is not empty", path);
+    return empty;
+}
+
+/* Octal, or base-256 for values that do not fit, as written by PostgreSQL */
+static uint64_t
+tar_number(const unsigned char *field, size_t len)
+{
+    uint64_t value = 0;
+
+    if (field[0] & 0x80)
+    {
+        for (size_t i = 1; i < len; i++)
+            value = (value << 8) | field[i];
+        return value;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (field[i] >= '0' && field[i] <= '7')
+            value = (value << 3) | (uint64_t) (field[i] - '0');
+        else if (field[i] != ' ' || value != 0)
+            break;
+    }
+    return value;
+}
+
+/* Member names come from the server; keep them inside the archive root */
+static bool
+tar_name_is_safe(const char *name)
+{
+    const char *p = name;
+
+    if (name[0] == '\0' || name[0] == '/')
+        return false;
+
+    while (*p)
+    {
+        if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+            return false;
+        p = strchr(p, '/');
+        if (!p)
+            break;
+        p++;
+    }
+    return true;
+}
+
+/* Handle one complete tar header */
+static bool
+tar_begin_member(BaseBackupState *st)
+{
+    BaseBackupArchive *a = &st->archive;
+    const unsigned char *h = a->header;
+    char name[256];
+    char path[RAMD_MAX_PATH_LENGTH];
+    char linkname[101];
+    uint64_t size;
+    mode_t mode;
+    size_t len;
+    char type;
+    int i;
+
+    for (i = 0; i < TAR_BLOCK_SIZE && h[i] == 0; i++)
+        ;
+    if (i == TAR_BLOCK_SIZE)
+        return true; /* end-of-archive padding */
+
+    if (memcmp(h + 257, "ustar", 5) == 0 && h[345] != '\0')
+        snprintf(name, sizeof(name), "%.155s/%.100s", (const char *) h + 345, (const char *) h);
+    else
+        snprintf(name, sizeof(name), "%.100s", (const char *) h);
+    len = strlen(name);
+    while (len > 1 && name[len - 1] == '/')
+        name[--len] = '\0';
+
+    size = tar_number(h + 124, 12);
+    mode = (mode_t) (tar_number(h + 100, 8) & 07777);
+    type = (char) h[156];
+    a->pad_remaining = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+
+    if (!tar_name_is_safe(name))
+    {
+        ramd_log_error("Base backup: refusing archive member \"%s\"", name);
+        return false;
+    }
+    if (type != '5' && type != '2' && type != '0' && type != '\0')
+    {
+        /* Nothing else is produced by the server; skip its payload */
+        a->pad_remaining += size;
+        return true;
+    }
+
+    for (i = 0; i < st->target_count; i++)
+    {
+        if (!member_path(st, i, name, path, sizeof(path)))
+            return false;
+
+        if (type == '5')
+        {
+            if (!ramd_process_make_directory(path, mode ? mode : 0700))
+                return false;
+        }
+        else if (type == '2')
+        {
+            snprintf(linkname, sizeof(linkname), "%.100s", (const char *) h + 157);
+            unlink(path);
+            if (symlink(linkname, path) != 0)
+            {
+                ramd_log_error("Base backup: cannot create symlink %s: %s", path,
+                               strerror(errno));
+                return false;
+            }
+        }
+        else if (!writer_open(&st->out[i], path, mode ? mode : 0600))
+            return false;
     }
 
-    if (options->compression_level < 0 || options->compression_level > 9)
+    if (type == '0' || type == '\0')
     {
-        ramd_log_error("Invalid compression level: %d", options->compression_level);
-        exit(1);
+        a->file_remaining = size;
+        return size > 0 || outs_close(st);
     }
+    return true;
+}
+
+static bool
+archive_open(BaseBackupState *st, const char *name, const char *tablespace_path)
+{
+    const ramd_basebackup_options_t *o = st->options;
+    BaseBackupArchive *a = &st->archive;
+    char path[RAMD_MAX_PATH_LENGTH];
+
+    memset(a, 0, sizeof(*a));
+    a->open = true;
 
-    if (options->max_rate < 0)
+    if (o->format == RAMD_BASEBACKUP_TAR)
     {
-        ramd_log_error("Invalid max rate: %d", options->max_rate);
-        exit(1);
+        snprintf(path, sizeof(path), "%s/%s", o->target_dir, name);
+        return writer_open(&st->out[0], path, 0600);
     }
 
-    if (options->nthreads < 1)
+    if (tablespace_path && tablespace_path[0] != '\0')
     {
-        ramd_log_error("Invalid number of threads: %d", options->nthreads);
-        exit(1);
+        /* A tablespace has one location, which the mirrors cannot share */
+        if (st->target_count > 1)
+        {
+            ramd_log_error("Base backup: tablespace %s cannot be mirrored", tablespace_path);
+            return false;
+        }
+        snprintf(a->root, sizeof(a->root), "%s", tablespace_path);
+        return prepare_directory(a->root);
     }
+    snprintf(a->root, sizeof(a->root), "%s", o->target_dir);
+    return true;
 }
 
-static char*
-build_basebackup_command(const char *conninfo, BaseBackupOptions *options)
+static bool
+archive_feed(BaseBackupState *st, const char *data, size_t len)
 {
-    char *cmd;
-    size_t cmd_len = 1024;
-    size_t pos = 0;
-    
-    cmd = malloc(cmd_len);
-    if (!cmd)
+    BaseBackupArchive *a = &st->archive;
+
+    if (!a->open)
+    {
+        ramd_log_error("Base backup: data received outside an archive");
+        return false;
+    }
+
+    if (st->options->format == RAMD_BASEBACKUP_TAR)
+        return writer_write(&st->out[0], data, len);
+
+    while (len > 0)
     {
-        ramd_log_error("Failed to allocate memory for command string");
-        return NULL;
+        size_t n;
+
+        if (a->file_remaining > 0)
+        {
+            n = a->file_remaining < len ? (size_t) a->file_remaining : len;
+            if (!outs_write(st, data, n))
+                return false;
+            a->file_remaining -= n;
+            if (a->file_remaining == 0 && !outs_close(st))
+                return false;
+        }
+        else if (a->pad_remaining > 0)
+        {
+            n = a->pad_remaining < len ? (size_t) a->pad_remaining : len;
+            a->pad_remaining -= n;
+        }
+        else
+        {
+            n = TAR_BLOCK_SIZE - a->header_len;
+            if (n > len)
+                n = len;
+            memcpy(a->header + a->header_len, data, n);
+            a->header_len += n;
+            if (a->header_len == TAR_BLOCK_SIZE)
+            {
+                a->header_len = 0;
+                if (!tar_begin_member(st))
+                    return false;
+            }
+        }
+        data += n;
+        len -= n;
     }
+    return true;
+}
+
+static bool
+archive_close(BaseBackupState *st)
+{
+    BaseBackupArchive *a = &st->archive;
+    bool complete;
 
-    pos += (size_t)snprintf(cmd + pos, cmd_len - pos, "pg_basebackup -D %s", options->target_dir);
+    if (!a->open)
+        return true;
+    a->open = false;
 
-    if (options->label)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -l \"%s\"", options->label);
-    
-    if (options->progress)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -P");
-    
-    if (options->verbose)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -v");
-    
-    if (options->write_recovery_conf)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -R");
-    
-    if (options->verify_checksums)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " --verify-checksums");
+    complete = a->file_remaining == 0 && a->header_len == 0;
+    if (!outs_close(st))
+        return false;
+    if (!complete)
+    {
+        ramd_log_error("Base backup: archive for %s ended mid-member", a->root);
+        return false;
+    }
+    st->progress.archives_done++;
+    return true;
+}
 
-    if (options->compression_level > 0)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -Z %d", options->compression_level);
+static bool
+manifest_open(BaseBackupState *st)
+{
+    char path[RAMD_MAX_PATH_LENGTH];
 
-    if (options->max_rate > 0)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " --max-rate=%d", options->max_rate);
+    if (!archive_close(st))
+        return false;
+    st->in_manifest = true;
+    for (int i = 0; i < st->target_count; i++)
+    {
+        snprintf(path, sizeof(path), "%s/backup_manifest", st->targets[i]);
+        if (!writer_open(&st->out[i], path, 0600))
+            return false;
+    }
+    return true;
+}
 
-    pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -X %s", options->wal_method == 1 ? "stream" : "fetch");
-    
-    if (options->nthreads > 1)
-        pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " -T %d", options->nthreads);
+static bool
+consume_data(BaseBackupState *st, const char *data, size_t len)
+{
+    st->progress.bytes_done += (int64_t) len;
+    if (st->in_manifest)
+        return outs_write(st, data, len);
+    return archive_feed(st, data, len);
+}
 
-    pos += (size_t)snprintf(cmd + pos, cmd_len - pos, " \"%s\"", conninfo);
+static void
+cancel_backup(BaseBackupState *st)
+{
+    PGcancel *cancel = PQgetCancel(st->conn);
+    char errbuf[256];
 
-    return cmd;
+    if (cancel)
+    {
+        PQcancel(cancel, errbuf, sizeof(errbuf));
+        PQfreeCancel(cancel);
+    }
+    ramd_log_warning("Base backup cancelled");
 }
 
+/* Sleep until the socket is readable, giving cancel and progress a chance */
+static bool
+wait_for_input(BaseBackupState *st)
+{
+    struct pollfd pfd;
+
+    if (is_cancelled(st))
+    {
+        cancel_backup(st);
+        return false;
+    }
+    report_progress(st, false);
+
+    pfd.fd = PQsocket(st->conn);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, RAMD_BASEBACKUP_POLL_INTERVAL_MS) < 0 && errno != EINTR)
+        return false;
+
+    if (!PQconsumeInput(st->conn))
+    {
+        ramd_log_error("Base backup: %s", PQerrorMessage(st->conn));
+        return false;
+    }
+    return true;
+}
+
+static PGresult *
+next_result(BaseBackupState *st, bool *failed)
+{
+    *failed = false;
+    while (PQisBusy(st->conn))
+    {
+        if (!wait_for_input(st))
+        {
+            *failed = true;
+            return NULL;
+        }
+    }
+    return PQgetResult(st->conn);
+}
+
+/* Read COPY data until the stream ends; returns bytes, -1 at end, -2 on error */
 static int
-execute_pg_basebackup(const char *conninfo, BaseBackupOptions *options)
+next_copy_chunk(BaseBackupState *st, char **buf)
+{
+    for (;;)
+    {
+        int r = PQgetCopyData(st->conn, buf, 1);
+
+        if (r != 0)
+        {
+            if (r == -2)
+                ramd_log_error("Base backup: %s", PQerrorMessage(st->conn));
+            return r;
+        }
+        if (!wait_for_input(st))
+            return -2;
+    }
+}
+
+/* Pre-15: one stream per tablespace, in list order, then the manifest */
+static bool
+receive_legacy_stream(BaseBackupState *st, int index)
+{
+    char name[64];
+    char *buf;
+    int r;
+    bool ok = true;
+
+    if (index < st->tablespace_count)
+    {
+        const BaseBackupTablespace *ts = &st->tablespaces[index];
+
+        snprintf(name, sizeof(name), "%s.tar", ts->location[0] ? ts->oid : "base");
+        if (!archive_open(st, name, ts->location))
+            return false;
+    }
+    else if (!manifest_open(st))
+        return false;
+
+    while ((r = next_copy_chunk(st, &buf)) > 0)
+    {
+        ok = consume_data(st, buf, (size_t) r);
+        PQfreemem(buf);
+        if (!ok)
+            return false;
+    }
+    if (r == -2)
+        return false;
+
+    if (st->in_manifest)
+    {
+        st->in_manifest = false;
+        return outs_close(st);
+    }
+    return archive_close(st);
+}
+
+/* 15 and later: a single stream of typed messages */
+static bool
+receive_stream(BaseBackupState *st)
+{
+    char *buf;
+    int r;
+    bool ok = true;
+
+    while (ok && (r = next_copy_chunk(st, &buf)) > 0)
+    {
+        switch (buf[0])
+        {
+            case 'n':
+            {
+                const char *name = buf + 1;
+                const char *name_end = memchr(name, '\0', (size_t) r - 1);
+                const char *path = name_end ? name_end + 1 : NULL;
+
+                if (!path || path - buf >= r ||
+                    !memchr(path, '\0', (size_t) (r - (path - buf))))
+                {
+                    ramd_log_error("Base backup: malformed archive header");
+                    ok = false;
+                    break;
+                }
+                ok = archive_close(st) && archive_open(st, name, path);
+                break;
+            }
+            case 'd':
+                ok = consume_data(st, buf + 1, (size_t) r - 1);
+                break;
+            case 'p':
+                break; /* bytes_done is counted as data arrives */
+            case 'm':
+                ok = manifest_open(st);
+                break;
+            default:
+                ramd_log_error("Base backup: unexpected message type '%c'", buf[0]);
+                ok = false;
+                break;
+        }
+        PQfreemem(buf);
+    }
+    if (!ok || r == -2)
+        return false;
+
+    if (st->in_manifest)
+    {
+        st->in_manifest = false;
+        return outs_close(st);
+    }
+    return archive_close(st);
+}
+
+static bool
+read_tablespaces(BaseBackupState *st, const PGresult *res)
+{
+    int n = PQntuples(res);
+
+    st->tablespaces = ramd_mem_calloc(RAMD_MEM_BACKUP, (size_t) (n > 0 ? n : 1),
+                                      sizeof(BaseBackupTablespace));
+    if (!st->tablespaces)
+    {
+        ramd_log_error("Base backup: out of memory");
+        return false;
+    }
+
+    st->tablespace_count = n;
+    st->progress.archive_count = n;
+    for (int i = 0; i < n; i++)
+    {
+        BaseBackupTablespace *ts = &st->tablespaces[i];
+
+        if (!PQgetisnull(res, i, 0))
+            snprintf(ts->oid, sizeof(ts->oid), "%s", PQgetvalue(res, i, 0));
+        if (!PQgetisnull(res, i, 1))
+            snprintf(ts->location, sizeof(ts->location), "%s", PQgetvalue(res, i, 1));
+        if (PQnfields(res) > 2 && !PQgetisnull(res, i, 2))
+            st->progress.bytes_total += strtoll(PQgetvalue(res, i, 2), NULL, 10) * 1024;
+    }
+    return true;
+}
+
+/* Quote a value for a libpq conninfo string */
+static void
+append_conninfo(char *buf, size_t size, const char *key, const char *value)
+{
+    size_t len = strlen(buf);
+
+    if (!value || value[0] == '\0' || len + strlen(key) + 4 >= size)
+        return;
+
+    len += (size_t) snprintf(buf + len, size - len, "%s%s='", len ? " " : "", key);
+    for (const char *p = value; *p && len + 3 < size; p++)
+    {
+        if (*p == '\'' || *p == '\\')
+            buf[len++] = '\\';
+        buf[len++] = *p;
+    }
+    buf[len++] = '\'';
+    buf[len] = '\0';
+}
+
+/* Make the plain-format copy start as a standby of the source, as -R does */
+static bool
+write_recovery_settings(BaseBackupState *st, const char *dir)
 {
-    char *cmd;
-    int ret;
+    char conninfo[RAMD_MAX_COMMAND_LENGTH] = "";
+    char path[RAMD_MAX_PATH_LENGTH];
+    FILE *fp;
+
+    append_conninfo(conninfo, sizeof(conninfo), "user", PQuser(st->conn));
+    append_conninfo(conninfo, sizeof(conninfo), "host", PQhost(st->conn));
+    append_conninfo(conninfo, sizeof(conninfo), "port", PQport(st->conn));
+
+    if (st->server_version >= 120000)
+    {
+        snprintf(path, sizeof(path), "%s/standby.signal", dir);
+        fp = fopen(path, "w");
+        if (!fp)
+        {
+            ramd_log_error("Base backup: cannot create %s: %s", path, strerror(errno));
+            return false;
+        }
+        fclose(fp);
+        snprintf(path, sizeof(path), "%s/postgresql.auto.conf", dir);
+        fp = fopen(path, "a");
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "%s/recovery.conf", dir);
+        fp = fopen(path, "w");
+        if (fp)
+            fprintf(fp, "standby_mode = 'on'\n");
+    }
 
-    cmd = build_basebackup_command(conninfo, options);
-    if (!cmd)
+    if (!fp)
     {
-        ramd_log_error("Failed to build basebackup command");
+        ramd_log_error("Base backup: cannot write %s: %s", path, strerror(errno));
+        return false;
+    }
+    fprintf(fp, "primary_conninfo = '");
+    for (const char *p = conninfo; *p; p++)
+    {
+        if (*p == '\'')
+            fputc('\'', fp);
+        fputc(*p, fp);
+    }
+    fprintf(fp, "'\n");
+    return fclose(fp) == 0;
+}
+
+static void
+build_command(char *cmd, size_t size, const BaseBackupState *st)
+{
+    const ramd_basebackup_options_t *o = st->options;
+    char label[128];
+    int32_t rate = o->max_rate_kbps;
+    size_t i;
+    size_t len;
+
+    /* The replication grammar has no escape syntax worth relying on */
+    snprintf(label, sizeof(label), "%s", o->label ? o->label : "ramd base backup");
+    for (i = 0; label[i]; i++)
+        if (label[i] == '\'' || label[i] == '\\')
+            label[i] = '_';
+
+    if (rate > 0 && rate < 32)
+        rate = 32;
+    if (rate > RAMD_BASEBACKUP_MAX_RATE_KBPS)
+        rate = RAMD_BASEBACKUP_MAX_RATE_KBPS;
+
+    if (st->server_version >= 150000)
+    {
+        len = (size_t) snprintf(cmd, size, "BASE_BACKUP (LABEL '%s', PROGRESS, WAL, CHECKPOINT '%s'",
+                                label, o->fast_checkpoint ? "fast" : "spread");
+        if (rate > 0)
+            len += (size_t) snprintf(cmd + len, size - len, ", MAX_RATE %d", rate);
+        if (!o->verify_checksums)
+            len += (size_t) snprintf(cmd + len, size - len, ", VERIFY_CHECKSUMS false");
+        if (o->manifest)
+            len += (size_t) snprintf(cmd + len, size - len, ", MANIFEST 'yes'");
+        snprintf(cmd + len, size - len, ")");
+        return;
+    }
+
+    len = (size_t) snprintf(cmd, size, "BASE_BACKUP LABEL '%s' PROGRESS WAL%s", label,
+                            o->fast_checkpoint ? " FAST" : "");
+    if (rate > 0)
+        len += (size_t) snprintf(cmd + len, size - len, " MAX_RATE %d", rate);
+    if (!o->verify_checksums && st->server_version >= 110000)
+        len += (size_t) snprintf(cmd + len, size - len, " NOVERIFY_CHECKSUMS");
+    if (o->manifest && st->server_version >= 130000)
+        snprintf(cmd + len, size - len, " MANIFEST 'yes'");
+}
+
+static bool
+stream_backup(BaseBackupState *st)
+{
+    char command[RAMD_MAX_COMMAND_LENGTH];
+    PGresult *res;
+    int tuples_seen = 0;
+    int streams_seen = 0;
+    bool failed = false;
+
+    build_command(command, sizeof(command), st);
+    if (!PQsendQuery(st->conn, command))
+    {
+        ramd_log_error("Base backup: %s", PQerrorMessage(st->conn));
+        return false;
+    }
+
+    while ((res = next_result(st, &failed)) != NULL)
+    {
+        bool ok = true;
+
+        switch (PQresultStatus(res))
+        {
+            case PGRES_TUPLES_OK:
+                /* start position, tablespace list, end position */
+                if (tuples_seen == 1)
+                    ok = read_tablespaces(st, res);
+                else if (tuples_seen == 2 && PQntuples(res) > 0)
+                    ramd_log_info("Base backup ends at WAL position %s", PQgetvalue(res, 0, 0));
+                tuples_seen++;
+                break;
+            case PGRES_COMMAND_OK:
+                break;
+            case PGRES_COPY_OUT:
+                if (st->server_version >= 150000)
+                    ok = receive_stream(st);
+                else
+                    ok = receive_legacy_stream(st, streams_seen++);
+                break;
+            default:
+                ramd_log_error("Base backup failed: %s", PQresultErrorMessage(res));
+                ok = false;
+                break;
+        }
+        PQclear(res);
+
+        if (!ok)
+            return false;
+    }
+
+    return !failed && tuples_seen >= 2;
+}
+
+int
+ramd_basebackup_run(const char *conninfo, const ramd_basebackup_options_t *options,
+                    ramd_basebackup_progress_t *final)
+{
+    const char *keywords[4];
+    const char *values[4];
+    BaseBackupState st;
+    int n = 0;
+    bool ok = false;
+
+    if (!conninfo || !options || !options->target_dir)
+    {
+        ramd_log_error("Target directory must be specified");
         return -1;
     }
-    
-    ramd_log_info("Executing: %s", cmd);
-    
-    ret = system(cmd);
-    free(cmd);
 
-    if (ret != 0)
+    if (options->mirror_count < 0 || options->mirror_count > RAMD_BASEBACKUP_MAX_MIRRORS ||
+        (options->mirror_count > 0 &&
+         (!options->mirror_dirs || options->format != RAMD_BASEBACKUP_PLAIN)))
     {
-        ramd_log_error("pg_basebackup failed with return code %d", ret);
+        ramd_log_error("Base backup: up to %d mirrors of a plain-format backup",
+                       RAMD_BASEBACKUP_MAX_MIRRORS);
         return -1;
     }
 
-    return 0;
+    memset(&st, 0, sizeof(st));
+    st.options = options;
+    st.targets[0] = options->target_dir;
+    st.target_count = 1;
+    for (int i = 0; i < options->mirror_count; i++)
+        st.targets[st.target_count++] = options->mirror_dirs[i];
+    for (int i = 0; i < BASEBACKUP_MAX_TARGETS; i++)
+        st.out[i].fd = -1;
+    st.progress.eta_seconds = -1;
+    st.started_ms = ramd_clock_now_ms();
+
+    keywords[n] = "dbname";
+    values[n++] = conninfo;
+    keywords[n] = "replication";
+    values[n++] = "true";
+    if (options->application_name)
+    {
+        keywords[n] = "application_name";
+        values[n++] = options->application_name;
+    }
+    keywords[n] = NULL;
+    values[n] = NULL;
+
+    for (int i = 0; i < st.target_count; i++)
+    {
+        if (!prepare_directory(st.targets[i]))
+            goto done;
+        if (posix_memalign((void **) &st.out[i].buf, RAMD_BASEBACKUP_WRITE_ALIGN,
+                           RAMD_BASEBACKUP_WRITE_BUFFER) != 0)
+        {
+            ramd_log_error("Base backup: out of memory");
+            goto done;
+        }
+        ramd_mem_track(RAMD_MEM_BACKUP, st.out[i].buf);
+    }
+
+    st.conn = PQconnectdbParams(keywords, values, 1);
+    if (PQstatus(st.conn) != CONNECTION_OK)
+    {
+        ramd_log_error("Base backup: replication connection failed: %s",
+                       PQerrorMessage(st.conn));
+        goto done;
+    }
+    st.server_version = PQserverVersion(st.conn);
+
+    ramd_log_info("Starting base backup from %s:%s into %s%s", PQhost(st.conn),
+                  PQport(st.conn), options->target_dir,
+                  st.target_count > 1 ? " and its mirrors" : "");
+
+    ok = stream_backup(&st);
+    for (int i = 0; ok && i < st.target_count; i++)
+        if (options->write_recovery_conf && options->format == RAMD_BASEBACKUP_PLAIN)
+            ok = write_recovery_settings(&st, st.targets[i]);
+
+    report_progress(&st, true);
+    if (ok)
+        ramd_log_info("Base backup completed: %lld MB in %lld s (%lld kB/s)",
+                      (long long) (st.progress.bytes_done >> 20),
+                      (long long) (st.progress.elapsed_ms / 1000),
+                      (long long) (st.progress.bytes_per_second >> 10));
+
+done:
+    for (int i = 0; i < BASEBACKUP_MAX_TARGETS; i++)
+    {
+        if (st.out[i].fd >= 0)
+        {
+            close(st.out[i].fd);
+            st.out[i].fd = -1;
+        }
+        ramd_mem_untrack(RAMD_MEM_BACKUP, st.out[i].buf);
+        free(st.out[i].buf);
+    }
+    PQfinish(st.conn);
+    ramd_mem_free(RAMD_MEM_BACKUP, st.tablespaces);
+    if (final)
+        *final = st.progress;
+    return ok ? 0 : -1;
+}
+
+int
+ramd_take_basebackup(PGconn *conn, const char *target_dir, const char *label)
+{
+    return ramd_take_basebackup_fanout(conn, target_dir, NULL, 0, label);
+}
+
+int
+ramd_take_basebackup_fanout(PGconn *conn, const char *target_dir,
+                            const char *const *mirror_dirs, int32_t mirror_count,
+                            const char *label)
+{
+    ramd_basebackup_options_t options;
+    char conninfo[RAMD_MAX_COMMAND_LENGTH] = "";
+
+    if (!conn || !target_dir)
+    {
+        ramd_log_error("Target directory must be specified");
+        return -1;
+    }
+
+    append_conninfo(conninfo, sizeof(conninfo), "host", PQhost(conn));
+    append_conninfo(conninfo, sizeof(conninfo), "port", PQport(conn));
+    append_conninfo(conninfo, sizeof(conninfo), "user", PQuser(conn));
+    append_conninfo(conninfo, sizeof(conninfo), "password", PQpass(conn));
+
+    memset(&options, 0, sizeof(options));
+    options.label = label;
+    options.target_dir = target_dir;
+    options.mirror_dirs = mirror_dirs;
+    options.mirror_count = mirror_count;
+    options.format = RAMD_BASEBACKUP_PLAIN;
+    options.fast_checkpoint = true;
+    options.write_recovery_conf = true;
+    options.verify_checksums = true;
+    options.manifest = true;
+
+    return ramd_basebackup_run(conninfo, &options, NULL);
 }
@@ -0,0 +1,206 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_buffer.c
+ *		PostgreSQL Auto-Failover Daemon - Growable Byte Buffers
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ramd_buffer.h"
+
+#define RAMD_BUFFER_MIN_CAPACITY 256
+
+void
+ramd_buffer_init(ramd_buffer_t *buffer)
+{
+	ramd_buffer_init_subsystem(buffer, RAMD_MEM_OTHER);
+}
+
+void
+ramd_buffer_init_subsystem(ramd_buffer_t *buffer, ramd_mem_subsystem_t subsystem)
+{
+	if (!buffer)
+		return;
+
+	buffer->data = NULL;
+	buffer->length = 0;
+	buffer->capacity = 0;
+	buffer->subsystem = subsystem;
+}
+
+void
+ramd_buffer_free(ramd_buffer_t *buffer)
+{
+	if (!buffer)
+		return;
+
+	ramd_mem_free(buffer->subsystem, buffer->data);
+	ramd_buffer_init_subsystem(buffer, buffer->subsystem);
+}
+
+/*
+ * Empty the buffer.  Storage up to keep_capacity bytes is kept for reuse;
+ * anything larger is released so one big response does not pin memory.
+ */
+void
+ramd_buffer_reset(ramd_buffer_t *buffer, size_t keep_capacity)
+{
+	if (!buffer)
+		return;
+
+	if (buffer->capacity > keep_capacity)
+	{
+		ramd_buffer_free(buffer);
+		return;
+	}
+
+	buffer->length = 0;
+	if (buffer->data)
+		buffer->data[0] = '\0';
+}
+
+/* Make room for additional bytes plus the terminator */
+bool
+ramd_buffer_reserve(ramd_buffer_t *buffer, size_t additional)
+{
+	size_t needed;
+	size_t new_capacity;
+	char  *new_data;
+
+	if (!buffer)
+		return false;
+
+	needed = buffer->length + additional + 1;
+	if (needed < buffer->length)
+		return false;
+	if (needed <= buffer->capacity)
+		return true;
+
+	new_capacity = buffer->capacity ? buffer->capacity : RAMD_BUFFER_MIN_CAPACITY;
+	while (new_capacity < needed)
+	{
+		if (new_capacity > ((size_t) -1) / 2)
+		{
+			new_capacity = needed;
+			break;
+		}
+		new_capacity *= 2;
+	}
+
+	new_data = ramd_mem_realloc(buffer->subsystem, buffer->data, new_capacity);
+	if (!new_data)
+		return false;
+
+	buffer->data = new_data;
+	buffer->capacity = new_capacity;
+	return true;
+}
+
+bool
+ramd_buffer_append(ramd_buffer_t *buffer, const char *data, size_t length)
+{
+	if (!buffer || (!data && length > 0))
+		return false;
+
+	if (!ramd_buffer_reserve(buffer, length))
+		return false;
+
+	if (length > 0)
+		memcpy(buffer->data + buffer->length, data, length);
+	buffer->length += length;
+	buffer->data[buffer->length] = '\0';
+	return true;
+}
+
+bool
+ramd_buffer_vappendf(ramd_buffer_t *buffer, const char *format, va_list args)
+{
+	va_list copy;
+	int     needed;
+	size_t  available;
+
+	if (!buffer || !format)
+		return false;
+
+	/* Try in the space we have, grow once if it was not enough */
+	available = buffer->capacity > buffer->length ? buffer->capacity - buffer->length : 0;
+	va_copy(copy, args);
+	needed = vsnprintf(available ? buffer->data + buffer->length : NULL, available,
+					   format, copy);
+	va_end(copy);
+	if (needed < 0)
+		return false;
+
+	if ((size_t) needed >= available)
+	{
+		if (!ramd_buffer_reserve(buffer, (size_t) needed))
+			return false;
+		needed = vsnprintf(buffer->data + buffer->length,
+						   buffer->capacity - buffer->length, format, args);
+		if (needed < 0)
+			return false;
+	}
+
+	buffer->length += (size_t) needed;
+	return true;
+}
+
+bool
+ramd_buffer_appendf(ramd_buffer_t *buffer, const char *format, ...)
+{
+	va_list args;
+	bool    result;
+
+	va_start(args, format);
+	result = ramd_buffer_vappendf(buffer, format, args);
+	va_end(args);
+	return result;
+}
+
+/* Hand the storage to the caller, who frees it with ramd_mem_free() */
+char *
+ramd_buffer_detach(ramd_buffer_t *buffer)
+{
+	char *data;
+
+	if (!buffer)
+		return NULL;
+
+	if (!buffer->data && !ramd_buffer_reserve(buffer, 0))
+		return NULL;
+
+	data = buffer->data;
+	data[buffer->length] = '\0';
+	ramd_buffer_init_subsystem(buffer, buffer->subsystem);
+	return data;
+}
+
+bool
+ramd_format_message(char *out, size_t size, const char *format, ...)
+{
+	va_list args;
+	int     length;
+
+	if (!out || size == 0)
+		return false;
+
+	va_start(args, format);
+	length = vsnprintf(out, size, format, args);
+	va_end(args);
+	if (length < 0)
+	{
+		out[0] = '\0';
+		return false;
+	}
+	if ((size_t) length < size)
+		return true;
+	if (size > 4)
+		memcpy(out + size - 4, "...", 4);
+	return false;
+}
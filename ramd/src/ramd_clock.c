@@ -0,0 +1,61 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_clock.c
+ *		PostgreSQL Auto-Failover Daemon - Replaceable Monotonic Clock
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The timing logic that decides failovers reads its time here rather than
+ * from clock_gettime() itself, so that ramd_sim can run it on virtual
+ * time and replay a scenario exactly from its seed.
+ *
+ * State that ages or times out (when a node was last seen, when the
+ * consensus snapshot was read) is kept on this clock in milliseconds, not
+ * in time(NULL) seconds: those have no sub-second resolution and move
+ * whenever NTP or an operator steps the wall clock.  Wall-clock time is
+ * derived from it only where a timestamp is shown.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <time.h>
+
+#include "ramd_clock.h"
+
+static ramd_clock_fn g_clock = NULL;
+
+int64_t
+ramd_clock_now_us(void)
+{
+	struct timespec ts;
+
+	if (g_clock)
+		return g_clock();
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t
+ramd_clock_now_ms(void)
+{
+	return ramd_clock_now_us() / 1000;
+}
+
+int64_t
+ramd_clock_wall_ms(int64_t monotonic_ms)
+{
+	struct timespec ts;
+
+	if (monotonic_ms == 0)
+		return 0;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000 -
+	       (ramd_clock_now_ms() - monotonic_ms);
+}
+
+void
+ramd_clock_set(ramd_clock_fn clock)
+{
+	g_clock = clock;
+}
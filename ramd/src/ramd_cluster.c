@@ -5,20 +5,50 @@
  *
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
+ * Readers such as HTTP and metrics work on published versions rather than
+ * the live struct the monitor is updating.  A version is immutable and
+ * reference counted; publishing swaps the current pointer, and the old
+ * version is freed when its last reader lets go.  The only window a
+ * reader needs protecting is between loading the pointer and taking its
+ * reference, which is covered by two reader counters: the publisher flips
+ * the epoch and waits for the counter of the one before to drain, which
+ * takes a few instructions, never a reader's whole render.
+ *
  *-------------------------------------------------------------------------
  */
 
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
 #include "ramd_cluster.h"
 #include "ramd_logging.h"
 #include "ramd_pgraft.h"
 #include "ramd_conn.h"
 #include "ramd_query.h"
 #include "ramd_daemon.h"
+#include "ramd_detector.h"
+#include "ramd_clock.h"
 #include <libpq-fe.h>
 
 extern ramd_daemon_t* g_ramd_daemon;
 extern PGconn* g_conn;
 
+typedef struct ramd_cluster_version_t
+{
+	ramd_cluster_t cluster; /* first, so readers are handed a plain ramd_cluster_t */
+	atomic_int refs;        /* one held by the current slot while published */
+} ramd_cluster_version_t;
+
+static struct
+{
+	pthread_mutex_t publish_lock; /* serializes publishers; readers never take it */
+	_Atomic(ramd_cluster_version_t*) current;
+	atomic_uint epoch;
+	atomic_int readers[2]; /* between loading current and taking a ref, per epoch parity */
+} g_cluster_versions = {.publish_lock = PTHREAD_MUTEX_INITIALIZER};
+
 bool
 ramd_cluster_init(ramd_cluster_t* cluster, const ramd_config_t* config)
 {
@@ -32,20 +62,7 @@ ramd_cluster_init(ramd_cluster_t* cluster, const ramd_config_t* config)
 	cluster->local_node_id = config->node_id;
 	cluster->primary_node_id = -1;
 	cluster->leader_node_id = -1;
-	cluster->last_topology_change = time(NULL);
-
-	if (!g_conn)
-	{
-		ramd_log_error("Failed to connect to PostgreSQL for pgraft integration");
-		return false;
-	}
-
-	ramd_log_info("PostgreSQL connection established for pgraft integration");
-		
-	if (ramd_pgraft_check_availability(g_conn) == 1)
-		ramd_log_info("pgraft extension is available and ready");
-	else
-		ramd_log_warning("pgraft extension not available - using fallback logic");
+	cluster->last_topology_change_ms = ramd_clock_now_ms();
 
 	ramd_log_info("Cluster initialized: %s (local_node_id=%d)",
 	              cluster->cluster_name, cluster->local_node_id);
@@ -96,13 +113,113 @@ ramd_cluster_bootstrap_primary(ramd_cluster_t* cluster, const ramd_config_t* con
 void
 ramd_cluster_cleanup(ramd_cluster_t* cluster)
 {
+	ramd_cluster_version_t* published;
+
 	if (!cluster)
 		return;
 
+	published = atomic_exchange(&g_cluster_versions.current, NULL);
+	if (published)
+		ramd_cluster_release(&published->cluster);
+
 	ramd_log_info("Cleaning up cluster: %s", cluster->cluster_name);
 	memset(cluster, 0, sizeof(ramd_cluster_t));
 }
 
+void
+ramd_cluster_publish(const ramd_cluster_t* cluster)
+{
+	ramd_cluster_version_t* fresh;
+	ramd_cluster_version_t* old;
+	unsigned int            epoch;
+
+	if (!cluster)
+		return;
+
+	fresh = malloc(sizeof(*fresh));
+	if (!fresh)
+	{
+		ramd_log_warning("Out of memory publishing the cluster; readers keep the last version");
+		return;
+	}
+	memcpy(&fresh->cluster, cluster, sizeof(fresh->cluster));
+	fresh->cluster.pg_conn = NULL; /* the session stays with its owner */
+	atomic_init(&fresh->refs, 1);
+
+	pthread_mutex_lock(&g_cluster_versions.publish_lock);
+	old = atomic_exchange(&g_cluster_versions.current, fresh);
+
+	/* Anyone who may still be looking at old has its reference once this drains */
+	epoch = atomic_fetch_add(&g_cluster_versions.epoch, 1);
+	while (atomic_load(&g_cluster_versions.readers[epoch & 1]) > 0)
+		sched_yield();
+	pthread_mutex_unlock(&g_cluster_versions.publish_lock);
+
+	if (old)
+		ramd_cluster_release(&old->cluster);
+}
+
+const ramd_cluster_t*
+ramd_cluster_acquire(void)
+{
+	ramd_cluster_version_t* version;
+	unsigned int            epoch;
+
+	/* Count ourselves in before looking, under an epoch no publisher has left */
+	for (;;)
+	{
+		epoch = atomic_load(&g_cluster_versions.epoch);
+		atomic_fetch_add(&g_cluster_versions.readers[epoch & 1], 1);
+		if (atomic_load(&g_cluster_versions.epoch) == epoch)
+			break;
+		atomic_fetch_sub(&g_cluster_versions.readers[epoch & 1], 1);
+	}
+
+	version = atomic_load(&g_cluster_versions.current);
+	if (version)
+		atomic_fetch_add_explicit(&version->refs, 1, memory_order_relaxed);
+	atomic_fetch_sub(&g_cluster_versions.readers[epoch & 1], 1);
+
+	return version ? &version->cluster : NULL;
+}
+
+void
+ramd_cluster_release(const ramd_cluster_t* cluster)
+{
+	ramd_cluster_version_t* version = (ramd_cluster_version_t*) cluster;
+
+	if (version && atomic_fetch_sub(&version->refs, 1) == 1)
+		free(version);
+}
+
+static uint32_t
+ramd_cluster_index_bucket(int32_t node_id)
+{
+	/* Ids are mostly handed out in sequence, which spreads them already */
+	return (uint32_t) node_id & (RAMD_CLUSTER_INDEX_SLOTS - 1);
+}
+
+static void
+ramd_cluster_index_insert(ramd_cluster_t* cluster, int32_t slot)
+{
+	uint32_t b = ramd_cluster_index_bucket(cluster->nodes[slot].node_id);
+
+	/* Twice as many buckets as nodes, so there is always an empty one */
+	while (cluster->node_index[b] != 0)
+		b = (b + 1) & (RAMD_CLUSTER_INDEX_SLOTS - 1);
+	cluster->node_index[b] = (int16_t) (slot + 1);
+	cluster->node_indexed = slot + 1;
+}
+
+static void
+ramd_cluster_index_rebuild(ramd_cluster_t* cluster)
+{
+	memset(cluster->node_index, 0, sizeof(cluster->node_index));
+	cluster->node_indexed = 0;
+	for (int32_t i = 0; i < cluster->node_count; i++)
+		ramd_cluster_index_insert(cluster, i);
+}
+
 bool
 ramd_cluster_add_node(ramd_cluster_t* cluster, int32_t node_id,
                       const char* hostname, int32_t pg_port,
@@ -124,31 +241,52 @@ ramd_cluster_add_node(ramd_cluster_t* cluster, int32_t node_id,
 	node->dstore_port = dstore_port;
 	node->state = RAMD_NODE_STATE_UNKNOWN;
 	node->role = RAMD_ROLE_UNKNOWN;
-	node->last_seen = time(NULL);
-	node->state_changed_at = time(NULL);
+	node->is_voter = true;
+	node->last_seen_ms = ramd_clock_now_ms();
+	node->state_changed_ms = node->last_seen_ms;
 
 	cluster->node_count++;
+	if (cluster->node_indexed == cluster->node_count - 1)
+		ramd_cluster_index_insert(cluster, cluster->node_count - 1);
+	else
+		ramd_cluster_index_rebuild(cluster);
 
 	ramd_log_info("Added node %d (%s:%d) to cluster", node_id, hostname,
 	              pg_port);
 	return true;
 }
 
-ramd_node_t*
-ramd_cluster_find_node(ramd_cluster_t* cluster, int32_t node_id)
+const ramd_node_t*
+ramd_cluster_lookup_node(const ramd_cluster_t* cluster, int32_t node_id)
 {
-	int i;
+	if (!cluster || node_id <= 0)
+		return NULL;
 
-	if (!cluster)
+	if (cluster->node_indexed != cluster->node_count)
+	{
+		for (int32_t i = 0; i < cluster->node_count; i++)
+		{
+			if (cluster->nodes[i].node_id == node_id)
+				return &cluster->nodes[i];
+		}
 		return NULL;
+	}
 
-	for (i = 0; i < cluster->node_count; i++)
+	for (uint32_t b = ramd_cluster_index_bucket(node_id);; b = (b + 1) & (RAMD_CLUSTER_INDEX_SLOTS - 1))
 	{
-		if (cluster->nodes[i].node_id == node_id)
-			return &cluster->nodes[i];
+		int32_t slot = cluster->node_index[b] - 1;
+
+		if (slot < 0)
+			return NULL;
+		if (slot < cluster->node_count && cluster->nodes[slot].node_id == node_id)
+			return &cluster->nodes[slot];
 	}
+}
 
-	return NULL;
+ramd_node_t*
+ramd_cluster_find_node(ramd_cluster_t* cluster, int32_t node_id)
+{
+	return (ramd_node_t*) ramd_cluster_lookup_node(cluster, node_id);
 }
 
 ramd_node_t*
@@ -160,31 +298,78 @@ ramd_cluster_get_local_node(ramd_cluster_t* cluster)
 	return ramd_cluster_find_node(cluster, cluster->local_node_id);
 }
 
+bool
+ramd_cluster_refresh_consensus(ramd_cluster_t* cluster)
+{
+	ramd_pgraft_snapshot_t snapshot;
+
+	if (!cluster || !g_conn)
+		return false;
+
+	if (ramd_pgraft_get_cluster_snapshot(g_conn, &snapshot) != RAMD_PGRAFT_SUCCESS)
+	{
+		ramd_log_debug("ramd_cluster_refresh_consensus: %s", ramd_pgraft_get_last_error());
+		cluster->consensus_refreshed_ms = 0;
+		return false;
+	}
+
+	cluster->consensus = snapshot;
+	cluster->consensus_refreshed_ms = ramd_clock_now_ms();
+	for (int i = 0; i < snapshot.node_count; i++)
+	{
+		ramd_node_t* node = ramd_cluster_find_node(cluster, snapshot.nodes[i].node_id);
+
+		if (node && node->is_voter != (snapshot.nodes[i].voting != 0))
+		{
+			node->is_voter = snapshot.nodes[i].voting != 0;
+			ramd_log_info("Node %d is now a Raft %s", node->node_id,
+			              node->is_voter ? "voter" : "learner");
+		}
+	}
+	ramd_detector_observe_raft(&snapshot);
+	cluster->has_quorum = snapshot.leader_id > 0;
+	if (snapshot.leader_id > 0)
+		cluster->leader_node_id = (int32_t) snapshot.leader_id;
+	return true;
+}
+
+/* A cached snapshot older than two monitor cycles is not trusted */
+static bool
+cluster_consensus_is_fresh(const ramd_cluster_t* cluster)
+{
+	int64_t max_age_ms = 2000;
+
+	if (cluster->consensus_refreshed_ms == 0)
+		return false;
+	if (g_ramd_daemon && g_ramd_daemon->config.monitor_interval_ms > 1000)
+		max_age_ms = 2 * (int64_t) g_ramd_daemon->config.monitor_interval_ms;
+	return ramd_clock_now_ms() - cluster->consensus_refreshed_ms <= max_age_ms;
+}
+
 bool
 ramd_cluster_has_quorum(const ramd_cluster_t* cluster)
 {
-	int leader;
-	int is_healthy;
+	ramd_pgraft_snapshot_t snapshot;
+	long long leader = -1;
 	int healthy_nodes;
 
 	if (!cluster || !g_conn)
 		return false;
 
-	leader = ramd_pgraft_get_leader(g_conn);
+	if (cluster_consensus_is_fresh(cluster))
+		leader = cluster->consensus.leader_id;
+	else if (ramd_pgraft_get_cluster_snapshot(g_conn, &snapshot) == RAMD_PGRAFT_SUCCESS)
+		leader = snapshot.leader_id;
+
 	if (leader > 0)
 	{
-		ramd_log_debug("ramd_cluster_has_quorum: pgraft leader is %d", leader);
+		ramd_log_debug("ramd_cluster_has_quorum: pgraft leader is %lld", leader);
 		return true;
 	}
 
-	ramd_log_debug("ramd_cluster_has_quorum: no pgraft leader, checking health");
-	is_healthy = ramd_pgraft_is_cluster_healthy(g_conn);
-	if (is_healthy > 0)
-		return true;
-
 	ramd_log_debug("ramd_cluster_has_quorum: using simple quorum logic");
-	healthy_nodes = ramd_cluster_count_healthy_nodes(cluster);
-	return healthy_nodes > (cluster->node_count / 2);
+	healthy_nodes = ramd_cluster_count_healthy_voting_nodes(cluster);
+	return healthy_nodes > (ramd_cluster_count_voting_nodes(cluster) / 2);
 }
 
 int32_t
@@ -205,13 +390,46 @@ ramd_cluster_count_healthy_nodes(const ramd_cluster_t* cluster)
 	return count;
 }
 
+/* Raft learners are left out: they never count toward a quorum */
+int32_t
+ramd_cluster_count_voting_nodes(const ramd_cluster_t* cluster)
+{
+	int32_t count = 0;
+
+	if (!cluster)
+		return 0;
+
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		if (cluster->nodes[i].is_voter)
+			count++;
+	}
+	return count;
+}
+
+int32_t
+ramd_cluster_count_healthy_voting_nodes(const ramd_cluster_t* cluster)
+{
+	int32_t count = 0;
+
+	if (!cluster)
+		return 0;
+
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		if (cluster->nodes[i].is_voter && cluster->nodes[i].is_healthy)
+			count++;
+	}
+	return count;
+}
+
 bool
 ramd_cluster_remove_node(ramd_cluster_t* cluster, int32_t node_id)
 {
 	int32_t i;
 	int32_t j;
 
-	if (!cluster || node_id <= 0 || node_id > cluster->node_count)
+	if (!cluster || node_id <= 0)
 		return false;
 
 	for (i = 0; i < cluster->node_count; i++)
@@ -222,6 +440,7 @@ ramd_cluster_remove_node(ramd_cluster_t* cluster, int32_t node_id)
 				cluster->nodes[j] = cluster->nodes[j + 1];
 
 			cluster->node_count--;
+			ramd_cluster_index_rebuild(cluster);
 			ramd_log_info("Removed node %d from cluster", node_id);
 			return true;
 		}
@@ -232,33 +451,19 @@ ramd_cluster_remove_node(ramd_cluster_t* cluster, int32_t node_id)
 ramd_node_t*
 ramd_cluster_get_primary_node(ramd_cluster_t* cluster)
 {
-	int32_t i;
-
 	if (!cluster || cluster->primary_node_id <= 0)
 		return NULL;
 
-	for (i = 0; i < cluster->node_count; i++)
-	{
-		if (cluster->nodes[i].node_id == cluster->primary_node_id)
-			return &cluster->nodes[i];
-	}
-	return NULL;
+	return ramd_cluster_find_node(cluster, cluster->primary_node_id);
 }
 
 ramd_node_t*
 ramd_cluster_get_leader_node(ramd_cluster_t* cluster)
 {
-	int32_t i;
-
 	if (!cluster || cluster->leader_node_id <= 0)
 		return NULL;
 
-	for (i = 0; i < cluster->node_count; i++)
-	{
-		if (cluster->nodes[i].node_id == cluster->leader_node_id)
-			return &cluster->nodes[i];
-	}
-	return NULL;
+	return ramd_cluster_find_node(cluster, cluster->leader_node_id);
 }
 
 bool
@@ -275,7 +480,7 @@ ramd_cluster_update_node_state(ramd_cluster_t* cluster, int32_t node_id,
 		return false;
 
 	node->state = new_state;
-	node->state_changed_at = time(NULL);
+	node->state_changed_ms = ramd_clock_now_ms();
 	ramd_log_info("Updated node %d state to %d", node_id, new_state);
 	return true;
 }
@@ -313,7 +518,7 @@ ramd_cluster_update_node_health(ramd_cluster_t* cluster, int32_t node_id,
 		return false;
 
 	node->health_score = health_score;
-	node->last_seen = time(NULL);
+	node->last_seen_ms = ramd_clock_now_ms();
 	node->is_healthy = (health_score >= RAMD_HEALTH_SCORE_THRESHOLD);
 	return true;
 }
@@ -357,17 +562,17 @@ bool
 ramd_cluster_detect_topology_change(ramd_cluster_t* cluster)
 {
 	int32_t i;
-	time_t   now;
+	int64_t now_ms;
 	ramd_node_t* node;
 
 	if (!cluster)
 		return false;
 
-	now = time(NULL);
+	now_ms = ramd_clock_now_ms();
 	for (i = 0; i < cluster->node_count; i++)
 	{
 		node = &cluster->nodes[i];
-		if (difftime(now, node->last_seen) > RAMD_NODE_TIMEOUT_SECONDS)
+		if (now_ms - node->last_seen_ms > RAMD_NODE_TIMEOUT_MS)
 		{
 			if (node->is_healthy)
 			{
@@ -395,6 +600,7 @@ ramd_cluster_update_topology(ramd_cluster_t* cluster)
 		if (cluster->nodes[i].node_id > 0)
 			cluster->node_count++;
 	}
+	ramd_cluster_index_rebuild(cluster);
 
 	ramd_log_debug("Updated cluster topology: %d nodes", cluster->node_count);
 }
@@ -487,7 +693,8 @@ ramd_cluster_get_node_by_id(int32_t node_id, ramd_node_t* node)
 	node->rale_port = g_ramd_daemon->config.rale_port;
 	node->dstore_port = g_ramd_daemon->config.dstore_port;
 	node->is_healthy = true;
-	node->last_seen = time(NULL);
+	node->is_voter = true;
+	node->last_seen_ms = ramd_clock_now_ms();
 	node->health_score = 1.0f;
 
 	ramd_log_debug("Retrieved node %d info", node_id);
@@ -18,6 +18,7 @@
 #include "ramd_backup.h"
 #include "ramd_postgresql_params.h"
 #include "ramd_cluster.h"
+#include "ramd_clock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -531,7 +532,7 @@ ramd_api_handle_cluster_status(ramd_http_request_t* req, ramd_http_response_t* r
             g_ramd_daemon->cluster.nodes[i].role == RAMD_ROLE_PRIMARY ? "primary" : "standby",
             g_ramd_daemon->cluster.nodes[i].state == RAMD_NODE_STATE_PRIMARY ? "primary" : "standby",
             g_ramd_daemon->cluster.nodes[i].is_healthy ? "true" : "false",
-            g_ramd_daemon->cluster.nodes[i].last_seen,
+            (long) (ramd_clock_wall_ms(g_ramd_daemon->cluster.nodes[i].last_seen_ms) / 1000),
             g_ramd_daemon->cluster.nodes[i].replication_lag_ms);
         
         if (written < 0 || (size_t)written >= remaining) {
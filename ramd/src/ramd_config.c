@@ -11,7 +11,11 @@
 #include "ramd_config.h"
 #include "ramd_logging.h"
 #include "ramd_defaults.h"
+#include "ramd_endpoint.h"
+#include "ram_conf.h"
 #include <errno.h>
+#include <sys/un.h>
+#include <pthread.h>
 
 bool ramd_config_init(ramd_config_t* config)
 {
@@ -31,6 +35,7 @@ void ramd_config_set_defaults(ramd_config_t* config)
 	char*       pglog;
 	const char* pgdb;
 	const char* pguser;
+	int         i;
 
 	if (!config)
 		return;
@@ -78,23 +83,127 @@ void ramd_config_set_defaults(ramd_config_t* config)
 	config->health_check_timeout_ms = RAMD_HEALTH_CHECK_TIMEOUT_MS;
 	config->failover_timeout_ms = RAMD_FAILOVER_TIMEOUT_MS;
 	config->recovery_timeout_ms = RAMD_DEFAULT_RECOVERY_TIMEOUT_MS;
+	config->failover_trace_file[0] = '\0';
+	config->failover_saturated_max_lag_mb = RAMD_FAILOVER_SATURATED_MAX_LAG_MB;
 	config->log_file[0] = '\0';
 	config->log_level = RAMD_LOG_LEVEL_INFO;
+	config->log_format = RAMD_LOG_FORMAT_TEXT;
 	config->log_to_syslog = false;
 	config->log_to_console = true;
+	config->log_rotation_size_mb = RAMD_LOG_ROTATION_SIZE_MB;
+	config->log_rotation_age_min = RAMD_LOG_ROTATION_AGE_MIN;
+	config->log_rotation_count = RAMD_LOG_ROTATION_COUNT;
+	config->log_compress = true;
 	config->http_api_enabled = true;
 	config->http_port = RAMD_DEFAULT_HTTP_PORT;
 	config->http_auth_enabled = false;
 	config->http_auth_token[0] = '\0';
+	config->http_rate_limit_per_minute = RAMD_DEFAULT_HTTP_RATE_LIMIT;
+	strncpy(config->http_unix_socket_dir, RAMD_HTTP_UNIX_SOCKET_DIR,
+	        sizeof(config->http_unix_socket_dir) - 1);
+	config->http_unix_socket_dir[sizeof(config->http_unix_socket_dir) - 1] = '\0';
+	config->status_page_enabled = true;
+	config->audit_log_dir[0] = '\0';
+	config->audit_log_retain_mb = RAMD_DEFAULT_AUDIT_RETAIN_MB;
+	config->metrics_refresh_interval_ms = RAMD_METRICS_COLLECTION_INTERVAL_MS;
+	config->metrics_compression = true;
+	config->metrics_history_file[0] = '\0';
+	config->remote_write_url[0] = '\0';
+	config->remote_write_auth_token[0] = '\0';
+	config->remote_write_interval_ms = RAMD_REMOTE_WRITE_INTERVAL_MS;
+	config->remote_write_timeout_ms = RAMD_REMOTE_WRITE_TIMEOUT_MS;
+	config->remote_write_queue_kb = RAMD_REMOTE_WRITE_QUEUE_KB;
+	strncpy(config->remote_write_drop_policy, RAMD_REMOTE_WRITE_DROP_POLICY,
+	        sizeof(config->remote_write_drop_policy) - 1);
+	config->remote_write_drop_policy[sizeof(config->remote_write_drop_policy) - 1] = '\0';
+	config->profiling_enabled = false;
 	config->sync_standby_names[0] = '\0';
 	config->num_sync_standbys = 1;
 	config->sync_timeout_ms = RAMD_DEFAULT_SYNC_TIMEOUT_MS;
 	config->enforce_sync_standbys = true;
+	config->sync_adaptive = false;
+	config->sync_adaptive_hold_ms = RAMD_SYNC_ADAPTIVE_HOLD_MS;
+	config->sync_adaptive_margin_ms = RAMD_SYNC_ADAPTIVE_MARGIN_MS;
+	config->sync_adaptive_stall_ms = RAMD_SYNC_ADAPTIVE_STALL_MS;
 	config->maintenance_mode_enabled = true;
 	config->maintenance_drain_timeout_ms = RAMD_DEFAULT_MAINTENANCE_TIMEOUT_MS;
+	config->maintenance_drain_idle_grace_ms = RAMD_DRAIN_IDLE_GRACE_MS;
 	config->maintenance_backup_before = false;
+	config->maintenance_pooler_admin[0] = '\0';
+	strncpy(config->maintenance_pooler_pause_command, RAMD_DRAIN_POOLER_PAUSE_COMMAND,
+	        sizeof(config->maintenance_pooler_pause_command) - 1);
+	strncpy(config->maintenance_pooler_resume_command, RAMD_DRAIN_POOLER_RESUME_COMMAND,
+	        sizeof(config->maintenance_pooler_resume_command) - 1);
+	config->switchover_drain_timeout_ms = RAMD_SWITCHOVER_DRAIN_TIMEOUT_MS;
+	config->switchover_catchup_timeout_ms = RAMD_SWITCHOVER_CATCHUP_TIMEOUT_MS;
+	config->switchover_prewarm_workers = RAMD_SWITCHOVER_PREWARM_WORKERS;
+	config->switchover_prewarm_timeout_ms = RAMD_SWITCHOVER_PREWARM_TIMEOUT_MS;
+	config->rolling_node_command[0] = '\0';
+	config->rolling_max_parallel = RAMD_ROLLING_MAX_PARALLEL;
+	config->rolling_node_timeout_ms = RAMD_ROLLING_NODE_TIMEOUT_MS;
+	config->rebuild_max_concurrent = RAMD_REBUILD_MAX_CONCURRENT;
+	config->rebuild_max_rate_kbps = 0;
+	config->rebuild_use_rewind = true;
+	config->replication_slots_enabled = true;
+	config->slot_inactive_timeout_ms = RAMD_SLOT_INACTIVE_TIMEOUT_MS;
+	config->slot_max_retained_mb = RAMD_SLOT_MAX_RETAINED_MB;
+	config->slot_inactive_policy = RAMD_SLOT_POLICY_DROP;
+	config->logical_slot_sync_enabled = true;
+	config->failure_detector_phi_suspect = RAMD_DETECTOR_PHI_SUSPECT;
+	config->failure_detector_phi_failover = RAMD_DETECTOR_PHI_FAILOVER;
+	config->failure_detector_min_stddev_ms = RAMD_DETECTOR_MIN_STDDEV_MS;
+	config->failure_detector_pause_ms = RAMD_DETECTOR_PAUSE_MS;
+	config->fencing_enabled = false;
+	config->fencing_lease_ms = RAMD_FENCING_LEASE_MS;
+	config->fencing_action = RAMD_FENCING_READ_ONLY;
+	config->cascade_enabled = false;
+	config->cascade_max_fanout = RAMD_CASCADE_MAX_FANOUT;
+	config->cascade_max_lag_ms = RAMD_CASCADE_MAX_LAG_MS;
+	config->node_zones[0] = '\0';
+	config->bootstrap_backup_tool[0] = '\0';
+	config->bootstrap_restore_processes = RAMD_BOOTSTRAP_RESTORE_PROCESSES;
+	config->bootstrap_max_parallel = RAMD_BOOTSTRAP_MAX_PARALLEL;
+	config->bootstrap_fanout = false;
+	for (i = 0; i < RAMD_BACKUP_CONFIG_TOOLS; i++)
+	{
+		config->backup_tools[i].enabled = true;
+		config->backup_tools[i].retention_days = RAMD_BACKUP_RETENTION_DAYS;
+	}
+	config->lag_sample_interval_ms = RAMD_LAG_SAMPLE_INTERVAL_MS;
+	config->replay_advisor_enabled = true;
+	config->replay_advisor_interval_ms = RAMD_REPLAY_ADVISOR_INTERVAL_MS;
+	config->replay_autotune = false;
+	config->replay_max_io_concurrency = RAMD_REPLAY_MAX_IO_CONCURRENCY;
+	config->replay_max_decode_buffer_kb = RAMD_REPLAY_MAX_DECODE_BUFFER_KB;
+	config->archive_enabled = false;
+	config->archive_dir[0] = '\0';
+	config->archive_spool_dir[0] = '\0';
+	config->archive_workers = RAMD_ARCHIVE_WORKERS;
+	config->archive_batch_size = RAMD_ARCHIVE_BATCH_SIZE;
+	config->archive_compression_level = RAMD_ARCHIVE_COMPRESSION_LEVEL;
+	strncpy(config->backup_dir, RAMD_BACKUP_DEFAULT_DIR, sizeof(config->backup_dir) - 1);
+	config->backup_dir[sizeof(config->backup_dir) - 1] = '\0';
+	strncpy(config->backup_verify_tool, RAMD_BACKUP_VERIFY_TOOL,
+	        sizeof(config->backup_verify_tool) - 1);
+	config->backup_verify_tool[sizeof(config->backup_verify_tool) - 1] = '\0';
+	config->backup_verify_workers = RAMD_BACKUP_VERIFY_WORKERS;
+	config->backup_verify_max_rate_kbps = 0;
+	config->backup_verify_cache_ttl_ms = RAMD_BACKUP_VERIFY_CACHE_TTL_MS;
+	config->proxy_enabled = false;
+	strncpy(config->proxy_bind_address, RAMD_PROXY_BIND_ADDRESS,
+	        sizeof(config->proxy_bind_address) - 1);
+	config->proxy_bind_address[sizeof(config->proxy_bind_address) - 1] = '\0';
+	config->proxy_port = RAMD_PROXY_PORT;
+	config->proxy_read_port = RAMD_PROXY_READ_PORT;
+	config->proxy_read_max_lag_ms = RAMD_PROXY_READ_MAX_LAG_MS;
+	config->proxy_max_connections = RAMD_PROXY_MAX_CONNECTIONS;
+	config->endpoint_vip[0] = '\0';
+	config->endpoint_vip_interface[0] = '\0';
+	config->endpoint_move_command[0] = '\0';
 	config->pid_file[0] = '\0';
 	config->daemonize = false;
+	config->instances_dir[0] = '\0';
+	config->config_watch_enabled = true;
 	config->user[0] = '\0';
 	config->group[0] = '\0';
 	
@@ -117,6 +226,8 @@ void ramd_config_set_defaults(ramd_config_t* config)
 	config->pam_service[sizeof(config->pam_service) - 1] = '\0';
 	config->require_ssl = false;
 	config->verify_ssl = true;
+	config->ssl_enabled = false;
+	config->ssl_ktls = false;
 
 	strncpy(config->http_bind_address, RAMD_DEFAULT_HTTP_BIND_ADDRESS,
 	        sizeof(config->http_bind_address) - 1);
@@ -143,13 +254,20 @@ bool ramd_config_load_file(ramd_config_t* config, const char* config_file)
 	line_number = 0;
 	while (fgets(line, sizeof(line), fp))
 	{
+		char* key;
+		char* value;
+
 		line_number++;
-		if (line[0] == '\0' || line[0] == '\n' || line[0] == '#')
+		if (!ram_conf_split(line, &key, &value))
+		{
+			if (key)
+				ramd_log_warning("Invalid configuration line %d: no \"=\"", line_number);
 			continue;
+		}
 
-		if (!ramd_config_parse_line(config, line))
-			ramd_log_warning("Invalid configuration line %d: %s",
-			                 line_number, line);
+		if (!ramd_config_parse_key_value(config, key, value))
+			ramd_log_warning("Invalid configuration line %d: unknown key or bad value for %s",
+			                 line_number, key);
 	}
 
 	fclose(fp);
@@ -164,314 +282,724 @@ bool ramd_config_load_file(ramd_config_t* config, const char* config_file)
 	return true;
 }
 
+static bool
+ramd_config_parse_log_level(void* member, const char* value)
+{
+	*(ramd_log_level_t*) member = ramd_logging_string_to_level(value);
+	return true;
+}
+
+static bool
+ramd_config_parse_log_format(void* member, const char* value)
+{
+	*(ramd_log_format_t*) member = ramd_logging_string_to_format(value);
+	return true;
+}
+
+static bool
+ramd_config_parse_slot_policy(void* member, const char* value)
+{
+	if (strcmp(value, "drop") == 0)
+		*(ramd_slot_policy_t*) member = RAMD_SLOT_POLICY_DROP;
+	else if (strcmp(value, "advance") == 0)
+		*(ramd_slot_policy_t*) member = RAMD_SLOT_POLICY_ADVANCE;
+	else if (strcmp(value, "keep") == 0)
+		*(ramd_slot_policy_t*) member = RAMD_SLOT_POLICY_KEEP;
+	else
+		return false;
+	return true;
+}
+
+static bool
+ramd_config_parse_fencing_action(void* member, const char* value)
+{
+	if (strcmp(value, "read_only") == 0)
+		*(ramd_fencing_action_t*) member = RAMD_FENCING_READ_ONLY;
+	else if (strcmp(value, "stop") == 0)
+		*(ramd_fencing_action_t*) member = RAMD_FENCING_STOP;
+	else
+		return false;
+	return true;
+}
+
+static bool
+ramd_config_parse_backup_tool_type(void* member, const char* value)
+{
+	if (strcmp(value, "pgbackrest") == 0)
+		*(ramd_backup_tool_type_t*) member = RAMD_BACKUP_TOOL_PGBACKREST;
+	else if (strcmp(value, "barman") == 0)
+		*(ramd_backup_tool_type_t*) member = RAMD_BACKUP_TOOL_BARMAN;
+	else if (strcmp(value, "custom") == 0)
+		*(ramd_backup_tool_type_t*) member = RAMD_BACKUP_TOOL_CUSTOM;
+	else
+		return false;
+	return true;
+}
+
+/* The keys of one backup tool slot: backup_tool<n>_name and so on */
+#define RAMD_CONFIG_BACKUP_TOOL_FIELDS(n, i)                                              \
+	RAM_CONF_FIELD_AS("backup_tool" n "_name", STRING, ramd_config_t,                    \
+	                  backup_tools[i].name),                                               \
+	RAM_CONF_FIELD_CUSTOM_AS("backup_tool" n "_type", ramd_config_t, backup_tools[i].type, \
+	                         ramd_config_parse_backup_tool_type),                          \
+	RAM_CONF_FIELD_AS("backup_tool" n "_command", STRING, ramd_config_t,                 \
+	                  backup_tools[i].command),                                            \
+	RAM_CONF_FIELD_AS("backup_tool" n "_config_file", STRING, ramd_config_t,             \
+	                  backup_tools[i].config_file),                                        \
+	RAM_CONF_FIELD_AS("backup_tool" n "_backup_path", STRING, ramd_config_t,             \
+	                  backup_tools[i].backup_path),                                        \
+	RAM_CONF_FIELD_AS("backup_tool" n "_restore_path", STRING, ramd_config_t,            \
+	                  backup_tools[i].restore_path),                                       \
+	RAM_CONF_FIELD_AS("backup_tool" n "_enabled", BOOL, ramd_config_t,                   \
+	                  backup_tools[i].enabled),                                            \
+	RAM_CONF_FIELD_AS("backup_tool" n "_retention_days", INT, ramd_config_t,             \
+	                  backup_tools[i].retention_days),                                     \
+	RAM_CONF_FIELD_AS("backup_tool" n "_schedule", STRING, ramd_config_t,                \
+	                  backup_tools[i].schedule),                                           \
+	RAM_CONF_FIELD_AS("backup_tool" n "_max_concurrent", INT, ramd_config_t,             \
+	                  backup_tools[i].max_concurrent)
+
+/* Every key ramd.conf may set; each is named after its ramd_config_t member */
+static const ram_conf_field_t g_config_fields[] = {
+	/* Node identification and PostgreSQL connection */
+	RAM_CONF_FIELD(INT, ramd_config_t, node_id),
+	RAM_CONF_FIELD(STRING, ramd_config_t, hostname),
+	RAM_CONF_FIELD(INT, ramd_config_t, postgresql_port),
+	RAM_CONF_FIELD(INT, ramd_config_t, rale_port),
+	RAM_CONF_FIELD(INT, ramd_config_t, dstore_port),
+	RAM_CONF_FIELD(STRING, ramd_config_t, postgresql_bin_dir),
+	RAM_CONF_FIELD(STRING, ramd_config_t, postgresql_data_dir),
+	RAM_CONF_FIELD(STRING, ramd_config_t, database_name),
+	RAM_CONF_FIELD(STRING, ramd_config_t, database_user),
+	RAM_CONF_FIELD(STRING, ramd_config_t, postgresql_user),
+	RAM_CONF_FIELD(STRING, ramd_config_t, database_password),
+
+	/* Authentication */
+	RAM_CONF_FIELD(STRING, ramd_config_t, auth_method),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ssl_cert_file),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ssl_key_file),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ssl_ca_file),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ssl_mode),
+	RAM_CONF_FIELD(STRING, ramd_config_t, kerberos_service),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ldap_server),
+	RAM_CONF_FIELD(INT, ramd_config_t, ldap_port),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ldap_basedn),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ldap_binddn),
+	RAM_CONF_FIELD(STRING, ramd_config_t, ldap_bindpasswd),
+	RAM_CONF_FIELD(STRING, ramd_config_t, pam_service),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, require_ssl),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, verify_ssl),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, ssl_enabled),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, ssl_ktls),
+
+	/* Cluster, monitoring and logging */
+	RAM_CONF_FIELD(STRING, ramd_config_t, cluster_name),
+	RAM_CONF_FIELD(INT, ramd_config_t, cluster_size),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, auto_failover_enabled),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, synchronous_replication),
+	RAM_CONF_FIELD(INT, ramd_config_t, monitor_interval_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, health_check_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, failover_timeout_ms),
+	RAM_CONF_FIELD(STRING, ramd_config_t, failover_trace_file),
+	RAM_CONF_FIELD(INT, ramd_config_t, failover_saturated_max_lag_mb),
+	RAM_CONF_FIELD(STRING, ramd_config_t, log_file),
+	RAM_CONF_FIELD_CUSTOM(ramd_config_t, log_level, ramd_config_parse_log_level),
+	RAM_CONF_FIELD_CUSTOM(ramd_config_t, log_format, ramd_config_parse_log_format),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, log_to_syslog),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, log_to_console),
+	RAM_CONF_FIELD(INT, ramd_config_t, log_rotation_size_mb),
+	RAM_CONF_FIELD(INT, ramd_config_t, log_rotation_age_min),
+	RAM_CONF_FIELD(INT, ramd_config_t, log_rotation_count),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, log_compress),
+
+	/* HTTP API and metrics */
+	RAM_CONF_FIELD(BOOL, ramd_config_t, http_api_enabled),
+	RAM_CONF_FIELD(STRING, ramd_config_t, http_bind_address),
+	RAM_CONF_FIELD(INT, ramd_config_t, http_port),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, http_auth_enabled),
+	RAM_CONF_FIELD(STRING, ramd_config_t, http_auth_token),
+	RAM_CONF_FIELD(INT, ramd_config_t, http_rate_limit_per_minute),
+	RAM_CONF_FIELD(STRING, ramd_config_t, http_unix_socket_dir),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, status_page_enabled),
+	RAM_CONF_FIELD(STRING, ramd_config_t, audit_log_dir),
+	RAM_CONF_FIELD(INT, ramd_config_t, audit_log_retain_mb),
+	RAM_CONF_FIELD(INT, ramd_config_t, metrics_refresh_interval_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, metrics_compression),
+	RAM_CONF_FIELD(STRING, ramd_config_t, metrics_history_file),
+	RAM_CONF_FIELD(STRING, ramd_config_t, remote_write_url),
+	RAM_CONF_FIELD(STRING, ramd_config_t, remote_write_auth_token),
+	RAM_CONF_FIELD(INT, ramd_config_t, remote_write_interval_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, remote_write_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, remote_write_queue_kb),
+	RAM_CONF_FIELD(STRING, ramd_config_t, remote_write_drop_policy),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, profiling_enabled),
+
+	/* Client proxy */
+	RAM_CONF_FIELD(BOOL, ramd_config_t, proxy_enabled),
+	RAM_CONF_FIELD(STRING, ramd_config_t, proxy_bind_address),
+	RAM_CONF_FIELD(INT, ramd_config_t, proxy_port),
+	RAM_CONF_FIELD(INT, ramd_config_t, proxy_read_port),
+	RAM_CONF_FIELD(INT, ramd_config_t, proxy_read_max_lag_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, proxy_max_connections),
+
+	/* Client endpoint */
+	RAM_CONF_FIELD(STRING, ramd_config_t, endpoint_vip),
+	RAM_CONF_FIELD(STRING, ramd_config_t, endpoint_vip_interface),
+	RAM_CONF_FIELD(STRING, ramd_config_t, endpoint_move_command),
+
+	/* Synchronous replication */
+	RAM_CONF_FIELD(STRING, ramd_config_t, sync_standby_names),
+	RAM_CONF_FIELD(INT, ramd_config_t, num_sync_standbys),
+	RAM_CONF_FIELD(INT, ramd_config_t, sync_timeout_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, enforce_sync_standbys),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, sync_adaptive),
+	RAM_CONF_FIELD(INT, ramd_config_t, sync_adaptive_hold_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, sync_adaptive_margin_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, sync_adaptive_stall_ms),
+
+	/* Maintenance, switchover and rolling runs */
+	RAM_CONF_FIELD(BOOL, ramd_config_t, maintenance_mode_enabled),
+	RAM_CONF_FIELD(INT, ramd_config_t, maintenance_drain_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, maintenance_drain_idle_grace_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, maintenance_backup_before),
+	RAM_CONF_FIELD(STRING, ramd_config_t, maintenance_pooler_admin),
+	RAM_CONF_FIELD(STRING, ramd_config_t, maintenance_pooler_pause_command),
+	RAM_CONF_FIELD(STRING, ramd_config_t, maintenance_pooler_resume_command),
+	RAM_CONF_FIELD(INT, ramd_config_t, switchover_drain_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, switchover_catchup_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, switchover_prewarm_workers),
+	RAM_CONF_FIELD(INT, ramd_config_t, switchover_prewarm_timeout_ms),
+	RAM_CONF_FIELD(STRING, ramd_config_t, rolling_node_command),
+	RAM_CONF_FIELD(INT, ramd_config_t, rolling_max_parallel),
+	RAM_CONF_FIELD(INT, ramd_config_t, rolling_node_timeout_ms),
+
+	/* Rebuild, slots, failure detection and fencing */
+	RAM_CONF_FIELD(INT, ramd_config_t, rebuild_max_concurrent),
+	RAM_CONF_FIELD(INT, ramd_config_t, rebuild_max_rate_kbps),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, rebuild_use_rewind),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, replication_slots_enabled),
+	RAM_CONF_FIELD(INT, ramd_config_t, slot_inactive_timeout_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, slot_max_retained_mb),
+	RAM_CONF_FIELD_CUSTOM(ramd_config_t, slot_inactive_policy, ramd_config_parse_slot_policy),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, logical_slot_sync_enabled),
+	RAM_CONF_FIELD(DOUBLE, ramd_config_t, failure_detector_phi_suspect),
+	RAM_CONF_FIELD(DOUBLE, ramd_config_t, failure_detector_phi_failover),
+	RAM_CONF_FIELD(INT, ramd_config_t, failure_detector_min_stddev_ms),
+	RAM_CONF_FIELD(INT, ramd_config_t, failure_detector_pause_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, fencing_enabled),
+	RAM_CONF_FIELD(INT, ramd_config_t, fencing_lease_ms),
+	RAM_CONF_FIELD_CUSTOM(ramd_config_t, fencing_action, ramd_config_parse_fencing_action),
+
+	/* Cascading replication and bootstrap */
+	RAM_CONF_FIELD(BOOL, ramd_config_t, cascade_enabled),
+	RAM_CONF_FIELD(INT, ramd_config_t, cascade_max_fanout),
+	RAM_CONF_FIELD(INT, ramd_config_t, cascade_max_lag_ms),
+	RAM_CONF_FIELD(STRING, ramd_config_t, node_zones),
+	RAM_CONF_FIELD(STRING, ramd_config_t, bootstrap_backup_tool),
+	RAM_CONF_FIELD(INT, ramd_config_t, bootstrap_restore_processes),
+	RAM_CONF_FIELD(INT, ramd_config_t, bootstrap_max_parallel),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, bootstrap_fanout),
+
+	/* Backup tools */
+	RAMD_CONFIG_BACKUP_TOOL_FIELDS("1", 0),
+	RAMD_CONFIG_BACKUP_TOOL_FIELDS("2", 1),
+	RAMD_CONFIG_BACKUP_TOOL_FIELDS("3", 2),
+	RAMD_CONFIG_BACKUP_TOOL_FIELDS("4", 3),
+
+	/* Lag sampling, replay advice, WAL archiving, backup verification and daemon */
+	RAM_CONF_FIELD(INT, ramd_config_t, lag_sample_interval_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, replay_advisor_enabled),
+	RAM_CONF_FIELD(INT, ramd_config_t, replay_advisor_interval_ms),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, replay_autotune),
+	RAM_CONF_FIELD(INT, ramd_config_t, replay_max_io_concurrency),
+	RAM_CONF_FIELD(INT, ramd_config_t, replay_max_decode_buffer_kb),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, archive_enabled),
+	RAM_CONF_FIELD(STRING, ramd_config_t, archive_dir),
+	RAM_CONF_FIELD(STRING, ramd_config_t, archive_spool_dir),
+	RAM_CONF_FIELD(INT, ramd_config_t, archive_workers),
+	RAM_CONF_FIELD(INT, ramd_config_t, archive_batch_size),
+	RAM_CONF_FIELD(INT, ramd_config_t, archive_compression_level),
+	RAM_CONF_FIELD(STRING, ramd_config_t, backup_dir),
+	RAM_CONF_FIELD(STRING, ramd_config_t, backup_verify_tool),
+	RAM_CONF_FIELD(INT, ramd_config_t, backup_verify_workers),
+	RAM_CONF_FIELD(INT, ramd_config_t, backup_verify_max_rate_kbps),
+	RAM_CONF_FIELD(INT, ramd_config_t, backup_verify_cache_ttl_ms),
+	RAM_CONF_FIELD(STRING, ramd_config_t, pid_file),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, daemonize),
+	RAM_CONF_FIELD(STRING, ramd_config_t, instances_dir),
+	RAM_CONF_FIELD(BOOL, ramd_config_t, config_watch_enabled),
+};
+
+static ram_conf_schema_t g_config_schema;
+static pthread_once_t    g_config_schema_once = PTHREAD_ONCE_INIT;
+static bool              g_config_schema_ok = false;
+
+static void
+ramd_config_schema_build(void)
+{
+	g_config_schema_ok = ram_conf_schema_init(&g_config_schema, g_config_fields,
+	                                          sizeof(g_config_fields) / sizeof(g_config_fields[0]));
+	if (!g_config_schema_ok)
+		ramd_log_error("Configuration key table is invalid");
+}
+
 bool ramd_config_parse_line(ramd_config_t* config, const char* line)
 {
+	char  buf[RAMD_MAX_LINE_LENGTH];
 	char* key;
 	char* value;
-	char* line_copy;
-	char* equals_pos;
-	char* newline;
-	char* key_end;
-	char* value_end;
-	bool  result;
 
 	if (!config || !line)
 		return false;
 
-	line_copy = strdup(line);
-	if (!line_copy)
+	strncpy(buf, line, sizeof(buf) - 1);
+	buf[sizeof(buf) - 1] = '\0';
+	if (!ram_conf_split(buf, &key, &value))
+		return key == NULL;
+
+	return ramd_config_parse_key_value(config, key, value);
+}
+
+bool ramd_config_parse_key_value(ramd_config_t* config, const char* key,
+                                const char* value)
+{
+	if (!config || !key || !value)
 		return false;
 
-	newline = strchr(line_copy, '\n');
-	if (newline)
-		*newline = '\0';
+	pthread_once(&g_config_schema_once, ramd_config_schema_build);
+	return g_config_schema_ok && ram_conf_set(&g_config_schema, config, key, value);
+}
+
+/* The named backup tool slots, and the one bootstrap_backup_tool restores from */
+static bool
+ramd_config_validate_backup_tools(const ramd_config_t* config)
+{
+	int i;
+	int j;
+
+	for (i = 0; i < RAMD_BACKUP_CONFIG_TOOLS; i++)
+	{
+		const ramd_backup_tool_config_t* tool = &config->backup_tools[i];
+
+		if (tool->name[0] == '\0')
+			continue;
+
+		if (tool->type != RAMD_BACKUP_TOOL_PGBACKREST &&
+		    tool->type != RAMD_BACKUP_TOOL_BARMAN &&
+		    tool->type != RAMD_BACKUP_TOOL_CUSTOM)
+		{
+			ramd_log_error("backup_tool%d_type must be pgbackrest, barman or custom", i + 1);
+			return false;
+		}
+
+		if (tool->type == RAMD_BACKUP_TOOL_CUSTOM && tool->command[0] == '\0')
+		{
+			ramd_log_error("backup_tool%d_command must be set for a custom tool", i + 1);
+			return false;
+		}
 
-	equals_pos = strchr(line_copy, '=');
-	if (!equals_pos)
+		if (tool->retention_days <= 0)
+		{
+			ramd_log_error("backup_tool%d_retention_days must be positive", i + 1);
+			return false;
+		}
+
+		if (tool->max_concurrent < 0 || tool->max_concurrent > RAMD_BACKUP_WORKERS)
+		{
+			ramd_log_error("backup_tool%d_max_concurrent must be between 0 and %d",
+			               i + 1, RAMD_BACKUP_WORKERS);
+			return false;
+		}
+
+		for (j = 0; j < i; j++)
+		{
+			if (strcmp(config->backup_tools[j].name, tool->name) == 0)
+			{
+				ramd_log_error("backup_tool%d_name repeats backup_tool%d_name: %s",
+				               i + 1, j + 1, tool->name);
+				return false;
+			}
+		}
+	}
+
+	if (config->bootstrap_backup_tool[0] == '\0')
+		return true;
+
+	for (i = 0; i < RAMD_BACKUP_CONFIG_TOOLS; i++)
+	{
+		if (strcmp(config->backup_tools[i].name, config->bootstrap_backup_tool) == 0)
+			break;
+	}
+	if (i == RAMD_BACKUP_CONFIG_TOOLS || !config->backup_tools[i].enabled)
 	{
-		free(line_copy);
+		ramd_log_error("bootstrap_backup_tool must name an enabled backup tool: %s",
+		               config->bootstrap_backup_tool);
 		return false;
 	}
 
-	*equals_pos = '\0';
-	key = line_copy;
-	value = equals_pos + 1;
+	return true;
+}
 
-	while (*key == ' ' || *key == '\t')
-		key++;
-	while (*value == ' ' || *value == '\t')
-		value++;
+bool ramd_config_validate(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
 
-	key_end = key + strlen(key) - 1;
-	while (key_end > key && (*key_end == ' ' || *key_end == '\t'))
+	if (config->node_id <= 0 || config->node_id > RAMD_MAX_NODES)
 	{
-		*key_end = '\0';
-		key_end--;
+		ramd_log_error("Invalid node_id: %d (must be 1-%d)", config->node_id,
+		               RAMD_MAX_NODES);
+		return false;
 	}
 
-	value_end = value + strlen(value) - 1;
-	while (value_end > value && (*value_end == ' ' || *value_end == '\t'))
+	if (strlen(config->hostname) == 0)
 	{
-		*value_end = '\0';
-		value_end--;
+		ramd_log_error("hostname cannot be empty");
+		return false;
 	}
 
-	result = ramd_config_parse_key_value(config, key, value);
-	free(line_copy);
+	if (config->log_rotation_size_mb < 0 || config->log_rotation_size_mb > 1024)
+	{
+		ramd_log_error("Invalid log_rotation_size_mb: %d (must be 0-1024)",
+		               config->log_rotation_size_mb);
+		return false;
+	}
 
-	return result;
-}
+	if (config->log_rotation_age_min < 0)
+	{
+		ramd_log_error("log_rotation_age_min cannot be negative");
+		return false;
+	}
 
-bool ramd_config_parse_key_value(ramd_config_t* config, const char* key,
-                                const char* value)
-{
-	if (!config || !key || !value)
+	if (config->log_rotation_count < 1 || config->log_rotation_count > 100)
+	{
+		ramd_log_error("Invalid log_rotation_count: %d (must be 1-100)",
+		               config->log_rotation_count);
 		return false;
+	}
 
-	if (strcmp(key, "node_id") == 0)
-		config->node_id = atoi(value);
-	else if (strcmp(key, "hostname") == 0)
+	if (config->postgresql_port <= 0 || config->postgresql_port > 65535)
 	{
-		strncpy(config->hostname, value, sizeof(config->hostname) - 1);
-		config->hostname[sizeof(config->hostname) - 1] = '\0';
+		ramd_log_error("Invalid postgresql_port: %d", config->postgresql_port);
+		return false;
 	}
-	else if (strcmp(key, "postgresql_port") == 0)
-		config->postgresql_port = atoi(value);
-	else if (strcmp(key, "rale_port") == 0)
-		config->rale_port = atoi(value);
-	else if (strcmp(key, "dstore_port") == 0)
-		config->dstore_port = atoi(value);
-	else if (strcmp(key, "postgresql_bin_dir") == 0)
+
+	if (strlen(config->postgresql_data_dir) == 0)
 	{
-		strncpy(config->postgresql_bin_dir, value,
-		        sizeof(config->postgresql_bin_dir) - 1);
-		config->postgresql_bin_dir[sizeof(config->postgresql_bin_dir) - 1] = '\0';
+		ramd_log_error("postgresql_data_dir cannot be empty");
+		return false;
 	}
-	else if (strcmp(key, "postgresql_data_dir") == 0)
+
+	if (config->cluster_size < 1 || config->cluster_size > RAMD_MAX_NODES)
 	{
-		strncpy(config->postgresql_data_dir, value,
-		        sizeof(config->postgresql_data_dir) - 1);
-		config->postgresql_data_dir[sizeof(config->postgresql_data_dir) - 1] = '\0';
+		ramd_log_error("Invalid cluster_size: %d (must be 1-%d)",
+		               config->cluster_size, RAMD_MAX_NODES);
+		return false;
 	}
-	else if (strcmp(key, "database_name") == 0)
+
+	if (config->monitor_interval_ms <= 0)
 	{
-		strncpy(config->database_name, value,
-		        sizeof(config->database_name) - 1);
-		config->database_name[sizeof(config->database_name) - 1] = '\0';
+		ramd_log_error("monitor_interval_ms must be positive");
+		return false;
 	}
-	else if (strcmp(key, "database_user") == 0)
+
+	if (config->http_rate_limit_per_minute < 0)
 	{
-		strncpy(config->database_user, value,
-		        sizeof(config->database_user) - 1);
-		config->database_user[sizeof(config->database_user) - 1] = '\0';
+		ramd_log_error("http_rate_limit_per_minute must not be negative");
+		return false;
 	}
-	else if (strcmp(key, "postgresql_user") == 0)
+
+	/* Room for "/.s.ramd.65535" in sun_path */
+	if (strlen(config->http_unix_socket_dir) + 15 > sizeof(((struct sockaddr_un*) 0)->sun_path))
 	{
-		strncpy(config->postgresql_user, value,
-		        sizeof(config->postgresql_user) - 1);
-		config->postgresql_user[sizeof(config->postgresql_user) - 1] = '\0';
+		ramd_log_error("http_unix_socket_dir is too long for a Unix socket path");
+		return false;
 	}
-	else if (strcmp(key, "database_password") == 0)
+
+	/* At least the segment being written */
+	if (config->audit_log_retain_mb < RAMD_AUDIT_SEGMENT_SIZE / (1024 * 1024))
 	{
-		strncpy(config->database_password, value,
-		        sizeof(config->database_password) - 1);
-		config->database_password[sizeof(config->database_password) - 1] = '\0';
+		ramd_log_error("audit_log_retain_mb must be at least %d",
+		               RAMD_AUDIT_SEGMENT_SIZE / (1024 * 1024));
+		return false;
 	}
-	/* Authentication settings */
-	else if (strcmp(key, "auth_method") == 0)
+
+	if (config->metrics_refresh_interval_ms <= 0)
 	{
-		strncpy(config->auth_method, value, sizeof(config->auth_method) - 1);
-		config->auth_method[sizeof(config->auth_method) - 1] = '\0';
+		ramd_log_error("metrics_refresh_interval_ms must be positive");
+		return false;
 	}
-	else if (strcmp(key, "ssl_cert_file") == 0)
+
+	if (config->remote_write_url[0] != '\0' &&
+	    strncmp(config->remote_write_url, "http://", 7) != 0 &&
+	    strncmp(config->remote_write_url, "https://", 8) != 0)
 	{
-		strncpy(config->ssl_cert_file, value, sizeof(config->ssl_cert_file) - 1);
-		config->ssl_cert_file[sizeof(config->ssl_cert_file) - 1] = '\0';
+		ramd_log_error("remote_write_url must start with http:// or https://");
+		return false;
 	}
-	else if (strcmp(key, "ssl_key_file") == 0)
+
+	if (config->remote_write_interval_ms < 1000)
 	{
-		strncpy(config->ssl_key_file, value, sizeof(config->ssl_key_file) - 1);
-		config->ssl_key_file[sizeof(config->ssl_key_file) - 1] = '\0';
+		ramd_log_error("remote_write_interval_ms must be at least 1000");
+		return false;
 	}
-	else if (strcmp(key, "ssl_ca_file") == 0)
+
+	if (config->remote_write_timeout_ms < 100)
 	{
-		strncpy(config->ssl_ca_file, value, sizeof(config->ssl_ca_file) - 1);
-		config->ssl_ca_file[sizeof(config->ssl_ca_file) - 1] = '\0';
+		ramd_log_error("remote_write_timeout_ms must be at least 100");
+		return false;
 	}
-	else if (strcmp(key, "ssl_mode") == 0)
+
+	if (config->remote_write_queue_kb < RAMD_REMOTE_WRITE_MIN_QUEUE_KB)
 	{
-		strncpy(config->ssl_mode, value, sizeof(config->ssl_mode) - 1);
-		config->ssl_mode[sizeof(config->ssl_mode) - 1] = '\0';
+		ramd_log_error("remote_write_queue_kb must be at least %d", RAMD_REMOTE_WRITE_MIN_QUEUE_KB);
+		return false;
 	}
-	else if (strcmp(key, "kerberos_service") == 0)
+
+	if (strcmp(config->remote_write_drop_policy, "oldest") != 0 &&
+	    strcmp(config->remote_write_drop_policy, "newest") != 0)
 	{
-		strncpy(config->kerberos_service, value, sizeof(config->kerberos_service) - 1);
-		config->kerberos_service[sizeof(config->kerberos_service) - 1] = '\0';
+		ramd_log_error("remote_write_drop_policy must be oldest or newest");
+		return false;
 	}
-	else if (strcmp(key, "ldap_server") == 0)
+
+	if (config->sync_adaptive_hold_ms < 0 || config->sync_adaptive_margin_ms < 0)
 	{
-		strncpy(config->ldap_server, value, sizeof(config->ldap_server) - 1);
-		config->ldap_server[sizeof(config->ldap_server) - 1] = '\0';
+		ramd_log_error("sync_adaptive_hold_ms and sync_adaptive_margin_ms must not be negative");
+		return false;
 	}
-	else if (strcmp(key, "ldap_port") == 0)
+
+	if (config->sync_adaptive_stall_ms <= 0)
 	{
-		config->ldap_port = atoi(value);
+		ramd_log_error("sync_adaptive_stall_ms must be positive");
+		return false;
 	}
-	else if (strcmp(key, "ldap_basedn") == 0)
+
+	if (config->maintenance_drain_idle_grace_ms < 0)
 	{
-		strncpy(config->ldap_basedn, value, sizeof(config->ldap_basedn) - 1);
-		config->ldap_basedn[sizeof(config->ldap_basedn) - 1] = '\0';
+		ramd_log_error("maintenance_drain_idle_grace_ms must not be negative");
+		return false;
 	}
-	else if (strcmp(key, "ldap_binddn") == 0)
+
+	if (config->switchover_drain_timeout_ms < 0)
 	{
-		strncpy(config->ldap_binddn, value, sizeof(config->ldap_binddn) - 1);
-		config->ldap_binddn[sizeof(config->ldap_binddn) - 1] = '\0';
+		ramd_log_error("switchover_drain_timeout_ms must not be negative");
+		return false;
 	}
-	else if (strcmp(key, "ldap_bindpasswd") == 0)
+
+	if (config->switchover_catchup_timeout_ms <= 0)
 	{
-		strncpy(config->ldap_bindpasswd, value, sizeof(config->ldap_bindpasswd) - 1);
-		config->ldap_bindpasswd[sizeof(config->ldap_bindpasswd) - 1] = '\0';
+		ramd_log_error("switchover_catchup_timeout_ms must be positive");
+		return false;
 	}
-	else if (strcmp(key, "pam_service") == 0)
+
+	if (config->ssl_enabled &&
+	    (config->ssl_cert_file[0] == '\0' || config->ssl_key_file[0] == '\0'))
 	{
-		strncpy(config->pam_service, value, sizeof(config->pam_service) - 1);
-		config->pam_service[sizeof(config->pam_service) - 1] = '\0';
+		ramd_log_error("ssl_enabled requires ssl_cert_file and ssl_key_file");
+		return false;
 	}
-	else if (strcmp(key, "require_ssl") == 0)
+
+	if (config->switchover_prewarm_workers < 0 ||
+	    config->switchover_prewarm_workers > RAMD_PREWARM_MAX_WORKERS)
 	{
-		config->require_ssl = (strcasecmp(value, "true") == 0 || strcmp(value, "1") == 0);
+		ramd_log_error("switchover_prewarm_workers must be between 0 and %d",
+		               RAMD_PREWARM_MAX_WORKERS);
+		return false;
 	}
-	else if (strcmp(key, "verify_ssl") == 0)
+
+	if (config->switchover_prewarm_timeout_ms <= 0)
 	{
-		config->verify_ssl = (strcasecmp(value, "true") == 0 || strcmp(value, "1") == 0);
+		ramd_log_error("switchover_prewarm_timeout_ms must be positive");
+		return false;
 	}
-	else if (strcmp(key, "cluster_name") == 0)
+
+	if (config->rolling_max_parallel <= 0)
 	{
-		strncpy(config->cluster_name, value, sizeof(config->cluster_name) - 1);
-		config->cluster_name[sizeof(config->cluster_name) - 1] = '\0';
+		ramd_log_error("rolling_max_parallel must be positive");
+		return false;
 	}
-	else if (strcmp(key, "cluster_size") == 0)
-		config->cluster_size = atoi(value);
-	else if (strcmp(key, "auto_failover_enabled") == 0)
-		config->auto_failover_enabled =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "synchronous_replication") == 0)
-		config->synchronous_replication =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "monitor_interval_ms") == 0)
-		config->monitor_interval_ms = atoi(value);
-	else if (strcmp(key, "health_check_timeout_ms") == 0)
-		config->health_check_timeout_ms = atoi(value);
-	else if (strcmp(key, "failover_timeout_ms") == 0)
-		config->failover_timeout_ms = atoi(value);
-	else if (strcmp(key, "log_file") == 0)
-	{
-		strncpy(config->log_file, value, sizeof(config->log_file) - 1);
-		config->log_file[sizeof(config->log_file) - 1] = '\0';
-	}
-	else if (strcmp(key, "log_level") == 0)
-		config->log_level = ramd_logging_string_to_level(value);
-	else if (strcmp(key, "log_to_syslog") == 0)
-		config->log_to_syslog =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "log_to_console") == 0)
-		config->log_to_console =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "http_api_enabled") == 0)
-		config->http_api_enabled =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "http_bind_address") == 0)
-	{
-		strncpy(config->http_bind_address, value,
-		        sizeof(config->http_bind_address) - 1);
-		config->http_bind_address[sizeof(config->http_bind_address) - 1] = '\0';
-	}
-	else if (strcmp(key, "http_port") == 0)
-		config->http_port = atoi(value);
-	else if (strcmp(key, "http_auth_enabled") == 0)
-		config->http_auth_enabled =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "http_auth_token") == 0)
-	{
-		strncpy(config->http_auth_token, value,
-		        sizeof(config->http_auth_token) - 1);
-		config->http_auth_token[sizeof(config->http_auth_token) - 1] = '\0';
-	}
-	else if (strcmp(key, "sync_standby_names") == 0)
-	{
-		strncpy(config->sync_standby_names, value,
-		        sizeof(config->sync_standby_names) - 1);
-		config->sync_standby_names[sizeof(config->sync_standby_names) - 1] = '\0';
-	}
-	else if (strcmp(key, "num_sync_standbys") == 0)
-		config->num_sync_standbys = atoi(value);
-	else if (strcmp(key, "sync_timeout_ms") == 0)
-		config->sync_timeout_ms = atoi(value);
-	else if (strcmp(key, "enforce_sync_standbys") == 0)
-		config->enforce_sync_standbys =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "maintenance_mode_enabled") == 0)
-		config->maintenance_mode_enabled =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "maintenance_drain_timeout_ms") == 0)
-		config->maintenance_drain_timeout_ms = atoi(value);
-	else if (strcmp(key, "maintenance_backup_before") == 0)
-		config->maintenance_backup_before =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else if (strcmp(key, "pid_file") == 0)
-	{
-		strncpy(config->pid_file, value, sizeof(config->pid_file) - 1);
-		config->pid_file[sizeof(config->pid_file) - 1] = '\0';
-	}
-	else if (strcmp(key, "daemonize") == 0)
-		config->daemonize =
-		    (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
-	else
+
+	if (config->rolling_node_timeout_ms <= 0)
+	{
+		ramd_log_error("rolling_node_timeout_ms must be positive");
 		return false;
+	}
 
-	return true;
-}
+	if (config->rebuild_max_concurrent <= 0)
+	{
+		ramd_log_error("rebuild_max_concurrent must be positive");
+		return false;
+	}
 
-bool ramd_config_validate(const ramd_config_t* config)
-{
-	if (!config)
+	if (config->rebuild_max_rate_kbps < 0)
+	{
+		ramd_log_error("rebuild_max_rate_kbps must not be negative");
 		return false;
+	}
 
-	if (config->node_id <= 0 || config->node_id > RAMD_MAX_NODES)
+	if (config->slot_inactive_timeout_ms < 0)
 	{
-		ramd_log_error("Invalid node_id: %d (must be 1-%d)", config->node_id,
-		               RAMD_MAX_NODES);
+		ramd_log_error("slot_inactive_timeout_ms must not be negative");
 		return false;
 	}
 
-	if (strlen(config->hostname) == 0)
+	if (config->slot_max_retained_mb < 0)
 	{
-		ramd_log_error("hostname cannot be empty");
+		ramd_log_error("slot_max_retained_mb must not be negative");
 		return false;
 	}
 
-	if (config->postgresql_port <= 0 || config->postgresql_port > 65535)
+	if (config->failure_detector_phi_suspect <= 0.0 ||
+	    config->failure_detector_phi_failover < config->failure_detector_phi_suspect)
 	{
-		ramd_log_error("Invalid postgresql_port: %d", config->postgresql_port);
+		ramd_log_error("failure_detector_phi_suspect must be positive and no more than "
+		               "failure_detector_phi_failover");
 		return false;
 	}
 
-	if (strlen(config->postgresql_data_dir) == 0)
+	if (config->failure_detector_min_stddev_ms <= 0 || config->failure_detector_pause_ms < 0)
 	{
-		ramd_log_error("postgresql_data_dir cannot be empty");
+		ramd_log_error("failure_detector_min_stddev_ms must be positive and "
+		               "failure_detector_pause_ms not negative");
 		return false;
 	}
 
-	if (config->cluster_size < 1 || config->cluster_size > RAMD_MAX_NODES)
+	if (config->fencing_lease_ms < RAMD_FENCING_MIN_LEASE_MS)
 	{
-		ramd_log_error("Invalid cluster_size: %d (must be 1-%d)",
-		               config->cluster_size, RAMD_MAX_NODES);
+		ramd_log_error("fencing_lease_ms must be at least %d", RAMD_FENCING_MIN_LEASE_MS);
 		return false;
 	}
 
-	if (config->monitor_interval_ms <= 0)
+	if (config->cascade_max_fanout <= 0)
 	{
-		ramd_log_error("monitor_interval_ms must be positive");
+		ramd_log_error("cascade_max_fanout must be positive");
+		return false;
+	}
+
+	if (config->cascade_max_lag_ms <= 0)
+	{
+		ramd_log_error("cascade_max_lag_ms must be positive");
+		return false;
+	}
+
+	if (config->bootstrap_restore_processes <= 0)
+	{
+		ramd_log_error("bootstrap_restore_processes must be positive");
+		return false;
+	}
+
+	if (config->bootstrap_max_parallel <= 0)
+	{
+		ramd_log_error("bootstrap_max_parallel must be positive");
+		return false;
+	}
+
+	if (!ramd_config_validate_backup_tools(config))
+		return false;
+
+	if (config->failover_saturated_max_lag_mb < 0)
+	{
+		ramd_log_error("failover_saturated_max_lag_mb must not be negative");
+		return false;
+	}
+
+	if (config->lag_sample_interval_ms <= 0)
+	{
+		ramd_log_error("lag_sample_interval_ms must be positive");
+		return false;
+	}
+
+	if (config->replay_advisor_interval_ms < 1000)
+	{
+		ramd_log_error("replay_advisor_interval_ms must be at least 1000");
+		return false;
+	}
+
+	if (config->replay_max_io_concurrency < 1 ||
+	    config->replay_max_io_concurrency > RAMD_REPLAY_IO_CONCURRENCY_LIMIT)
+	{
+		ramd_log_error("replay_max_io_concurrency must be between 1 and %d",
+		               RAMD_REPLAY_IO_CONCURRENCY_LIMIT);
+		return false;
+	}
+
+	if (config->replay_max_decode_buffer_kb < 64 ||
+	    config->replay_max_decode_buffer_kb > RAMD_REPLAY_DECODE_BUFFER_LIMIT_KB)
+	{
+		ramd_log_error("replay_max_decode_buffer_kb must be between 64 and %d",
+		               RAMD_REPLAY_DECODE_BUFFER_LIMIT_KB);
+		return false;
+	}
+
+	if (config->archive_workers < 1 || config->archive_workers > RAMD_ARCHIVE_MAX_WORKERS)
+	{
+		ramd_log_error("archive_workers must be between 1 and %d", RAMD_ARCHIVE_MAX_WORKERS);
+		return false;
+	}
+
+	if (config->archive_batch_size < 1 || config->archive_batch_size > RAMD_ARCHIVE_MAX_BATCH)
+	{
+		ramd_log_error("archive_batch_size must be between 1 and %d", RAMD_ARCHIVE_MAX_BATCH);
+		return false;
+	}
+
+	if (config->archive_compression_level < 0 || config->archive_compression_level > 9)
+	{
+		ramd_log_error("archive_compression_level must be between 0 and 9");
+		return false;
+	}
+
+	if (strcmp(config->backup_verify_tool, "native") != 0 &&
+	    strcmp(config->backup_verify_tool, "pgbackrest") != 0 &&
+	    strcmp(config->backup_verify_tool, "barman") != 0)
+	{
+		ramd_log_error("backup_verify_tool must be native, pgbackrest or barman");
+		return false;
+	}
+
+	if (config->backup_verify_workers < 1 ||
+	    config->backup_verify_workers > RAMD_BACKUP_VERIFY_MAX_WORKERS)
+	{
+		ramd_log_error("backup_verify_workers must be between 1 and %d",
+		               RAMD_BACKUP_VERIFY_MAX_WORKERS);
+		return false;
+	}
+
+	if (config->backup_verify_max_rate_kbps < 0)
+	{
+		ramd_log_error("backup_verify_max_rate_kbps must not be negative");
+		return false;
+	}
+
+	if (config->backup_verify_cache_ttl_ms < 0)
+	{
+		ramd_log_error("backup_verify_cache_ttl_ms must not be negative");
+		return false;
+	}
+
+	if (config->proxy_enabled)
+	{
+		if (config->proxy_port <= 0 || config->proxy_port > 65535 ||
+		    config->proxy_read_port < 0 || config->proxy_read_port > 65535 ||
+		    config->proxy_read_port == config->proxy_port)
+		{
+			ramd_log_error("proxy_port must be a port and proxy_read_port another one, or 0");
+			return false;
+		}
+		if (config->proxy_read_max_lag_ms < 0 || config->proxy_max_connections <= 0)
+		{
+			ramd_log_error("proxy_read_max_lag_ms must not be negative and "
+			               "proxy_max_connections must be positive");
+			return false;
+		}
+	}
+
+	if (config->endpoint_vip[0] != '\0' &&
+	    !ramd_endpoint_vip_is_valid(config->endpoint_vip, config->endpoint_vip_interface))
+	{
+		ramd_log_error("endpoint_vip must be an address with an optional /prefix, "
+		               "and endpoint_vip_interface must be set with it");
 		return false;
 	}
 
@@ -21,11 +21,13 @@
 #include "ramd_http_api.h"
 #include "ramd_maintenance.h"
 #include "ramd_postgresql.h"
+#include "ramd_tls.h"
 
 static bool g_config_reload_initialized = false;
 static ramd_config_t g_current_config;
 static pthread_mutex_t g_config_mutex = PTHREAD_MUTEX_INITIALIZER;
 static char g_config_file_path[RAMD_MAX_PATH_LENGTH];
+static volatile sig_atomic_t g_reload_requested = 0;
 
 extern ramd_daemon_t* g_ramd_daemon;
 extern PGconn* g_conn;
@@ -193,7 +195,12 @@ ramd_config_change_flags_t ramd_config_compare(const ramd_config_t* old_config,
 	if (old_config->log_level != new_config->log_level ||
 	    strcmp(old_config->log_file, new_config->log_file) != 0 ||
 	    old_config->log_to_syslog != new_config->log_to_syslog ||
-	    old_config->log_to_console != new_config->log_to_console)
+	    old_config->log_to_console != new_config->log_to_console ||
+	    old_config->log_format != new_config->log_format ||
+	    old_config->log_rotation_size_mb != new_config->log_rotation_size_mb ||
+	    old_config->log_rotation_age_min != new_config->log_rotation_age_min ||
+	    old_config->log_rotation_count != new_config->log_rotation_count ||
+	    old_config->log_compress != new_config->log_compress)
 	{
 		changes |= RAMD_CONFIG_CHANGE_LOGGING;
 	}
@@ -228,6 +235,19 @@ ramd_config_change_flags_t ramd_config_compare(const ramd_config_t* old_config,
 		changes |= RAMD_CONFIG_CHANGE_SYNCHRONOUS_REP;
 	}
 
+	if (old_config->http_port != new_config->http_port ||
+	    strcmp(old_config->http_bind_address, new_config->http_bind_address) != 0 ||
+	    old_config->http_auth_enabled != new_config->http_auth_enabled ||
+	    strcmp(old_config->http_auth_token, new_config->http_auth_token) != 0 ||
+	    old_config->http_rate_limit_per_minute != new_config->http_rate_limit_per_minute ||
+	    old_config->ssl_enabled != new_config->ssl_enabled ||
+	    old_config->ssl_ktls != new_config->ssl_ktls ||
+	    strcmp(old_config->ssl_cert_file, new_config->ssl_cert_file) != 0 ||
+	    strcmp(old_config->ssl_key_file, new_config->ssl_key_file) != 0)
+	{
+		changes |= RAMD_CONFIG_CHANGE_HTTP_API;
+	}
+
 	return changes;
 }
 
@@ -274,7 +294,20 @@ bool ramd_config_validate_reload(const ramd_config_t* new_config,
 bool ramd_config_reload_logging(const ramd_config_t* old_config,
                                 const ramd_config_t* new_config)
 {
-	(void) old_config;
+	/* Level and format changes leave the open sinks and the writer alone */
+	if (strcmp(old_config->log_file, new_config->log_file) == 0 &&
+	    old_config->log_to_syslog == new_config->log_to_syslog &&
+	    old_config->log_to_console == new_config->log_to_console)
+	{
+		ramd_logging_set_level(new_config->log_level);
+		ramd_logging_set_format(new_config->log_format, new_config->node_id);
+		ramd_logging_set_rotation(new_config->log_rotation_size_mb,
+		                          new_config->log_rotation_age_min,
+		                          new_config->log_rotation_count, new_config->log_compress);
+		ramd_log_info("Log level set to %s",
+		              ramd_logging_level_to_string(new_config->log_level));
+		return true;
+	}
 
 	if (!ramd_logging_init(new_config->log_file, new_config->log_level,
 	                       strlen(new_config->log_file) > 0,
@@ -284,17 +317,27 @@ bool ramd_config_reload_logging(const ramd_config_t* old_config,
 		ramd_log_error("Failed to reload logging configuration");
 		return false;
 	}
+	ramd_logging_set_format(new_config->log_format, new_config->node_id);
+	ramd_logging_set_rotation(new_config->log_rotation_size_mb, new_config->log_rotation_age_min,
+	                          new_config->log_rotation_count, new_config->log_compress);
 
 	ramd_log_info("Logging configuration reloaded successfully");
 	return true;
 }
 
+/* The monitor reads both values afresh on every cycle */
 bool ramd_config_reload_monitoring(const ramd_config_t* old_config,
                                    const ramd_config_t* new_config)
 {
 	if (!old_config || !new_config)
 		return false;
 
+	if (g_ramd_daemon)
+	{
+		g_ramd_daemon->monitor.check_interval_ms = new_config->monitor_interval_ms;
+		g_ramd_daemon->monitor.health_check_timeout_ms = new_config->health_check_timeout_ms;
+	}
+
 	if (old_config->monitor_interval_ms != new_config->monitor_interval_ms)
 	{
 		ramd_log_info("Monitor interval changed from %d ms to %d ms",
@@ -377,11 +420,23 @@ void ramd_config_reload_signal_setup(void)
 	}
 }
 
+/*
+ * The reload itself takes locks and logs, neither of which is safe in a
+ * signal handler, so SIGHUP only flags it for ramd_config_reload_run_pending()
+ */
 void ramd_config_reload_signal_sighup(int sig)
+{
+	(void) sig;
+	g_reload_requested = 1;
+}
+
+void ramd_config_reload_run_pending(void)
 {
 	ramd_config_reload_result_t result;
 
-	(void) sig;
+	if (!g_reload_requested)
+		return;
+	g_reload_requested = 0;
 
 	ramd_log_info("Received SIGHUP signal, triggering configuration reload");
 
@@ -471,28 +526,74 @@ bool ramd_config_reload_cluster(const ramd_config_t* old_config,
 	return true;
 }
 
+/*
+ * Authentication and rate limits are swapped in place; an address change
+ * moves the listener without closing client connections.  Nothing here
+ * stops the server, so the API stays up across a reload.
+ */
 bool ramd_config_reload_http_api(const ramd_config_t* old_config,
                                  const ramd_config_t* new_config)
 {
-	bool port_changed;
-	bool bind_addr_changed;
+	bool ok = true;
 
-	if (!old_config || !new_config)
+	if (!old_config || !new_config || !g_ramd_daemon)
 		return false;
 
-	port_changed = (old_config->http_port != new_config->http_port);
-	bind_addr_changed = strcmp(old_config->http_bind_address, new_config->http_bind_address) != 0;
+	if (old_config->http_api_enabled != new_config->http_api_enabled)
+	{
+		ramd_log_warning("Turning the HTTP API %s requires a daemon restart",
+		                 new_config->http_api_enabled ? "on" : "off");
+		ok = false;
+	}
+	if (!old_config->http_api_enabled)
+		return ok;
 
-	if (port_changed || bind_addr_changed)
+	if (old_config->http_auth_enabled != new_config->http_auth_enabled ||
+	    strcmp(old_config->http_auth_token, new_config->http_auth_token) != 0)
 	{
-		ramd_log_info("HTTP API configuration changed - port: %d->%d, bind_addr: %s->%s",
-		    old_config->http_port, new_config->http_port,
-		    old_config->http_bind_address, new_config->http_bind_address);
+		if (strlen(new_config->http_auth_token) > 0 &&
+		    !ramd_security_set_admin_token(new_config->http_auth_token))
+		{
+			ramd_log_error("Invalid http_auth_token; keeping the previous token");
+			ok = false;
+		}
+		g_ramd_daemon->security.enable_auth = new_config->http_auth_enabled;
+		ramd_log_info("HTTP API authentication %s",
+		              new_config->http_auth_enabled ? "enabled" : "disabled");
+	}
 
-		ramd_log_warning("HTTP API port change requires daemon restart");
+	if (old_config->http_rate_limit_per_minute != new_config->http_rate_limit_per_minute)
+	{
+		ramd_security_set_rate_limit(new_config->http_rate_limit_per_minute);
+		ramd_log_info("HTTP API rate limit changed from %d to %d requests per minute",
+		              old_config->http_rate_limit_per_minute,
+		              new_config->http_rate_limit_per_minute);
 	}
 
-	return true;
+	/* Open connections keep the session they started with */
+	if (!ramd_tls_configure(new_config))
+	{
+		ramd_log_error("HTTP API TLS settings not applied");
+		ok = false;
+	}
+
+	if (old_config->http_port != new_config->http_port ||
+	    strcmp(old_config->http_bind_address, new_config->http_bind_address) != 0)
+	{
+		ramd_log_info("HTTP API address changed from %s:%d to %s:%d",
+		              old_config->http_bind_address, old_config->http_port,
+		              new_config->http_bind_address, new_config->http_port);
+		if (!ramd_http_server_rebind(&g_ramd_daemon->http_server,
+		                             new_config->http_bind_address,
+		                             new_config->http_port))
+		{
+			ramd_log_error("HTTP API stays on %s:%d", old_config->http_bind_address,
+			               old_config->http_port);
+			ok = false;
+		}
+	}
+
+	return ok;
 }
 
 bool ramd_config_reload_maintenance(const ramd_config_t* old_config,
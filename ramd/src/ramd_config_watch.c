@@ -0,0 +1,362 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_config_watch.c
+ *		PostgreSQL Auto-Failover Daemon - Configuration File Watcher
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The directory holding the configuration file is watched rather than the
+ * file itself: editors and Kubernetes ConfigMaps replace the file (a
+ * ConfigMap by renaming its ..data link) instead of writing to it, which
+ * a watch on the old inode would never see.  Events only wake the thread;
+ * whether anything changed is decided by the file's contents.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#define RAMD_CONFIG_WATCH_INOTIFY
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+	defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#define RAMD_CONFIG_WATCH_KQUEUE
+#endif
+
+#include "ramd_config_watch.h"
+#include "ramd_config_reload.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+typedef struct ramd_config_watch_t
+{
+	pthread_t thread;
+	bool running;
+	int notify_fd;  /* inotify instance or kqueue */
+	int wake_fd[2]; /* written by ramd_config_watch_stop() */
+	int dir_fd;     /* kqueue only: the directory and the file */
+	int file_fd;
+	char path[RAMD_MAX_PATH_LENGTH];
+	char dir[RAMD_MAX_PATH_LENGTH];
+	char name[RAMD_MAX_PATH_LENGTH];      /* entry in dir */
+	char real_dir[RAMD_MAX_PATH_LENGTH];  /* where a symlinked file really lives */
+	char real_name[RAMD_MAX_PATH_LENGTH];
+	uint64_t digest; /* of the contents last reloaded */
+} ramd_config_watch_t;
+
+static ramd_config_watch_t g_config_watch = {
+	.notify_fd = -1, .wake_fd = {-1, -1}, .dir_fd = -1, .file_fd = -1};
+
+/* FNV-1a over the file; false if it cannot be read right now */
+static bool
+config_watch_digest(const char* path, uint64_t* digest)
+{
+	unsigned char buf[4096];
+	uint64_t      hash = 14695981039346656037ULL;
+	size_t        n;
+	FILE*         f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return false;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		for (size_t i = 0; i < n; i++)
+			hash = (hash ^ buf[i]) * 1099511628211ULL;
+	fclose(f);
+	*digest = hash;
+	return true;
+}
+
+/* Split path into its directory and final entry */
+static void
+config_watch_split(const char* path, char* dir, char* name)
+{
+	const char* slash = strrchr(path, '/');
+
+	if (!slash)
+	{
+		strcpy(dir, ".");
+		strncpy(name, path, RAMD_MAX_PATH_LENGTH - 1);
+	}
+	else
+	{
+		size_t len = slash == path ? 1 : (size_t) (slash - path);
+
+		memcpy(dir, path, len);
+		dir[len] = '\0';
+		strncpy(name, slash + 1, RAMD_MAX_PATH_LENGTH - 1);
+	}
+	name[RAMD_MAX_PATH_LENGTH - 1] = '\0';
+}
+
+static void
+config_watch_close(void)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+
+	if (w->notify_fd >= 0)
+		close(w->notify_fd);
+	if (w->dir_fd >= 0)
+		close(w->dir_fd);
+	if (w->file_fd >= 0)
+		close(w->file_fd);
+	for (int i = 0; i < 2; i++)
+		if (w->wake_fd[i] >= 0)
+			close(w->wake_fd[i]);
+	w->notify_fd = w->dir_fd = w->file_fd = -1;
+	w->wake_fd[0] = w->wake_fd[1] = -1;
+}
+
+#if defined(RAMD_CONFIG_WATCH_INOTIFY)
+
+#define RAMD_CONFIG_WATCH_MASK \
+	(IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+static bool
+config_watch_open(void)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+
+	w->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (w->notify_fd < 0 || inotify_add_watch(w->notify_fd, w->dir, RAMD_CONFIG_WATCH_MASK) < 0)
+		return false;
+	if (w->real_dir[0] && strcmp(w->real_dir, w->dir) != 0 &&
+	    inotify_add_watch(w->notify_fd, w->real_dir, RAMD_CONFIG_WATCH_MASK) < 0)
+		ramd_log_warning("Cannot watch %s: %s", w->real_dir, strerror(errno));
+	return true;
+}
+
+/* The directory watches follow replacements; nothing to re-arm */
+static void
+config_watch_rearm(void)
+{
+}
+
+/*
+ * Wait up to timeout_ms (-1 forever) for an event that concerns the file:
+ * its own entry, the entry it links to, or a ConfigMap's ".."-prefixed
+ * bookkeeping.  1 on such an event, 0 on timeout, -1 once asked to stop.
+ */
+static int
+config_watch_wait(int timeout_ms)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+	struct pollfd        fds[2];
+	char                 buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t              len;
+	bool                 relevant = false;
+
+	fds[0].fd = w->notify_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = w->wake_fd[0];
+	fds[1].events = POLLIN;
+	if (poll(fds, 2, timeout_ms) < 0)
+		return errno == EINTR ? 0 : -1;
+	if (fds[1].revents)
+		return -1;
+	if (!fds[0].revents)
+		return 0;
+
+	while ((len = read(w->notify_fd, buf, sizeof(buf))) > 0)
+	{
+		for (char* p = buf; p < buf + len;)
+		{
+			const struct inotify_event* ev = (const struct inotify_event*) p;
+
+			if (ev->len == 0 || strcmp(ev->name, w->name) == 0 ||
+			    strcmp(ev->name, w->real_name) == 0 || strncmp(ev->name, "..", 2) == 0)
+				relevant = true;
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+	return relevant ? 1 : 0;
+}
+
+#elif defined(RAMD_CONFIG_WATCH_KQUEUE)
+
+#ifndef O_EVTONLY
+#define O_EVTONLY O_RDONLY
+#endif
+
+/* (Re)attach to the file's current inode; a replaced file leaves the old one */
+static void
+config_watch_rearm(void)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+	struct kevent        change;
+
+	if (w->file_fd >= 0)
+		close(w->file_fd);
+	w->file_fd = open(w->path, O_EVTONLY | O_CLOEXEC);
+	if (w->file_fd < 0)
+		return;
+	EV_SET(&change, w->file_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+	       NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME, 0, NULL);
+	if (kevent(w->notify_fd, &change, 1, NULL, 0, NULL) < 0)
+		ramd_log_warning("Cannot watch %s: %s", w->path, strerror(errno));
+}
+
+static bool
+config_watch_open(void)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+	struct kevent        changes[2];
+
+	w->notify_fd = kqueue();
+	if (w->notify_fd < 0)
+		return false;
+	w->dir_fd = open(w->dir, O_EVTONLY | O_CLOEXEC);
+	if (w->dir_fd < 0)
+		return false;
+	EV_SET(&changes[0], w->dir_fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE, 0, NULL);
+	EV_SET(&changes[1], w->wake_fd[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	if (kevent(w->notify_fd, changes, 2, NULL, 0, NULL) < 0)
+		return false;
+	config_watch_rearm();
+	return true;
+}
+
+/* 1 on a directory or file event, 0 on timeout, -1 once asked to stop */
+static int
+config_watch_wait(int timeout_ms)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+	struct kevent        events[4];
+	struct timespec      ts;
+	int                  n;
+
+	if (timeout_ms >= 0)
+	{
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+	}
+	n = kevent(w->notify_fd, NULL, 0, events, 4, timeout_ms >= 0 ? &ts : NULL);
+	if (n < 0)
+		return errno == EINTR ? 0 : -1;
+	for (int i = 0; i < n; i++)
+		if ((int) events[i].ident == w->wake_fd[0] && events[i].filter == EVFILT_READ)
+			return -1;
+	return n > 0 ? 1 : 0;
+}
+
+#endif
+
+#if defined(RAMD_CONFIG_WATCH_INOTIFY) || defined(RAMD_CONFIG_WATCH_KQUEUE)
+
+/* Reload if the contents differ from what was last applied */
+static void
+config_watch_apply(void)
+{
+	ramd_config_watch_t*        w = &g_config_watch;
+	ramd_config_reload_result_t result;
+	uint64_t                    digest;
+
+	/* Mid-replacement the file can briefly be missing; its arrival wakes us */
+	if (!config_watch_digest(w->path, &digest) || digest == w->digest)
+		return;
+	w->digest = digest;
+
+	ramd_log_info("Configuration file %s changed on disk, reloading", w->path);
+	if (!ramd_config_reload_from_file(NULL, &result))
+		ramd_log_error("Configuration change not applied, running configuration kept: %s",
+		               result.error_message);
+}
+
+static void*
+config_watch_thread(void* arg)
+{
+	int ready;
+
+	(void) arg;
+	ramd_log_debug("Configuration watch thread started");
+
+	while ((ready = config_watch_wait(-1)) >= 0)
+	{
+		if (ready == 0)
+			continue;
+
+		/* A save or a ConfigMap update is several events; wait for quiet */
+		while ((ready = config_watch_wait(RAMD_CONFIG_WATCH_DEBOUNCE_MS)) > 0)
+			;
+		if (ready < 0)
+			break;
+		config_watch_rearm();
+		config_watch_apply();
+	}
+
+	ramd_log_debug("Configuration watch thread stopped");
+	return NULL;
+}
+
+#endif
+
+bool
+ramd_config_watch_start(const char* config_file)
+{
+#if defined(RAMD_CONFIG_WATCH_INOTIFY) || defined(RAMD_CONFIG_WATCH_KQUEUE)
+	ramd_config_watch_t* w = &g_config_watch;
+	char                 real_path[PATH_MAX];
+
+	if (!config_file || config_file[0] == '\0')
+		return false;
+	if (w->running)
+		return true;
+
+	strncpy(w->path, config_file, sizeof(w->path) - 1);
+	w->path[sizeof(w->path) - 1] = '\0';
+	config_watch_split(w->path, w->dir, w->name);
+	w->real_dir[0] = w->real_name[0] = '\0';
+	if (realpath(w->path, real_path) && strlen(real_path) < sizeof(w->real_dir))
+		config_watch_split(real_path, w->real_dir, w->real_name);
+	if (!config_watch_digest(w->path, &w->digest))
+		w->digest = 0;
+
+	if (pipe(w->wake_fd) != 0 || !config_watch_open())
+	{
+		ramd_log_warning("Cannot watch %s for changes: %s; reload with SIGHUP",
+		                 w->dir, strerror(errno));
+		config_watch_close();
+		return false;
+	}
+
+	if (pthread_create(&w->thread, NULL, config_watch_thread, NULL) != 0)
+	{
+		ramd_log_warning("Failed to create configuration watch thread; reload with SIGHUP");
+		config_watch_close();
+		return false;
+	}
+	w->running = true;
+
+	ramd_log_info("Watching %s for configuration changes", w->path);
+	return true;
+#else
+	(void) config_file;
+	ramd_log_warning("No file change notification on this platform; reload with SIGHUP");
+	return false;
+#endif
+}
+
+void
+ramd_config_watch_stop(void)
+{
+	ramd_config_watch_t* w = &g_config_watch;
+
+	if (!w->running)
+		return;
+
+	if (write(w->wake_fd[1], "x", 1) < 0)
+		ramd_log_warning("Failed to wake configuration watch thread: %s", strerror(errno));
+	pthread_join(w->thread, NULL);
+	config_watch_close();
+	w->running = false;
+}
@@ -5,31 +5,109 @@
  *
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
+ * Short-lived users borrow sessions from a pool of up to
+ * RAMD_CONN_POOL_SIZE per node.  A session checked out belongs to its
+ * borrower alone until it is checked in, so the monitor, failover, HTTP
+ * and metrics threads can talk to the same server at once.  Each node has
+ * its own lock; opening a connection happens outside it.  A session that
+ * sat idle for RAMD_CONN_POOL_VALIDATE_MS is pinged before it is handed
+ * out, one idle for RAMD_CONN_POOL_IDLE_MS is closed, and one checked in
+ * broken or inside a transaction is dropped.  Sessions live across
+ * checkouts, so statements prepared on one stay prepared.
+ *
  *-------------------------------------------------------------------------
  */
 
+#include <errno.h>
 #include <libpq-fe.h>
+#include <poll.h>
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "ramd_conn.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_http_profile.h"
 #include "ramd_logging.h"
 #include "ramd_postgresql_auth.h"
+#include "ramd_query.h"
 
-static PGconn* g_conn_cache[RAMD_MAX_NODES] = {NULL};
-static pthread_mutex_t g_conn_mutex = PTHREAD_MUTEX_INITIALIZER;
+typedef struct ramd_conn_slot_t
+{
+	PGconn* conn;
+	bool busy;
+	uint32_t generation; /* of the pool's address when it was opened */
+	int64_t idle_since_us;
+} ramd_conn_slot_t;
+
+typedef struct ramd_conn_pool_t
+{
+	pthread_mutex_t lock;
+	pthread_cond_t available;
+	char host[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+	uint32_t generation; /* bumped when the node's address changes */
+	ramd_conn_slot_t slots[RAMD_CONN_POOL_SIZE];
+} ramd_conn_pool_t;
+
+static ramd_conn_pool_t g_conn_pools[RAMD_MAX_NODES];
+static pthread_once_t g_conn_pools_once = PTHREAD_ONCE_INIT;
 
 /* External authentication context */
 extern ramd_auth_context_t g_auth_context;
 
+static void
+ramd_conn_pools_init_once(void)
+{
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		pthread_mutex_init(&g_conn_pools[i].lock, NULL);
+		pthread_cond_init(&g_conn_pools[i].available, NULL);
+	}
+}
+
+static ramd_conn_pool_t*
+ramd_conn_pool(int32_t node_id)
+{
+	if (node_id <= 0 || node_id > RAMD_MAX_NODES)
+		return NULL;
+	pthread_once(&g_conn_pools_once, ramd_conn_pools_init_once);
+	return &g_conn_pools[node_id - 1];
+}
+
+/* Close a session and drop what the statement registry knows about it */
+static void
+ramd_conn_finish(PGconn* conn)
+{
+	ramd_query_forget_connection(conn);
+	PQfinish(conn);
+}
+
+/* Close the pool's idle sessions that are stale or idle too long; lock held */
+static void
+ramd_conn_pool_reap(ramd_conn_pool_t* pool, int64_t now_us)
+{
+	for (int i = 0; i < RAMD_CONN_POOL_SIZE; i++)
+	{
+		ramd_conn_slot_t* slot = &pool->slots[i];
+
+		if (!slot->conn || slot->busy)
+			continue;
+		if (slot->generation == pool->generation &&
+		    now_us - slot->idle_since_us < (int64_t) RAMD_CONN_POOL_IDLE_MS * 1000)
+			continue;
+		ramd_conn_finish(slot->conn);
+		slot->conn = NULL;
+	}
+}
+
 bool
 ramd_conn_init(void)
 {
-	pthread_mutex_lock(&g_conn_mutex);
-	memset(g_conn_cache, 0, sizeof(g_conn_cache));
-	pthread_mutex_unlock(&g_conn_mutex);
-	
+	pthread_once(&g_conn_pools_once, ramd_conn_pools_init_once);
+
 	ramd_log_info("Connection subsystem initialized");
 	return true;
 }
@@ -37,17 +115,26 @@ ramd_conn_init(void)
 void
 ramd_conn_cleanup(void)
 {
-	pthread_mutex_lock(&g_conn_mutex);
+	pthread_once(&g_conn_pools_once, ramd_conn_pools_init_once);
+
 	for (int i = 0; i < RAMD_MAX_NODES; i++)
 	{
-		if (g_conn_cache[i])
+		ramd_conn_pool_t* pool = &g_conn_pools[i];
+
+		pthread_mutex_lock(&pool->lock);
+		for (int j = 0; j < RAMD_CONN_POOL_SIZE; j++)
 		{
-			PQfinish(g_conn_cache[i]);
-			g_conn_cache[i] = NULL;
+			/* A borrowed session is closed by its checkin instead */
+			if (pool->slots[j].conn && !pool->slots[j].busy)
+			{
+				ramd_conn_finish(pool->slots[j].conn);
+				pool->slots[j].conn = NULL;
+			}
 		}
+		pool->generation++;
+		pthread_mutex_unlock(&pool->lock);
 	}
-	pthread_mutex_unlock(&g_conn_mutex);
-	
+
 	ramd_log_info("Connection subsystem cleaned up");
 }
 
@@ -55,30 +142,44 @@ PGconn*
 ramd_conn_get(const char* host, int32_t port, const char* dbname,
               const char* user, const char* password)
 {
-	PGconn* conn;
-	
-	/* Use authentication system if available */
-	if (g_auth_context.method != RAMD_AUTH_METHOD_UNKNOWN)
+	const char* keywords[8];
+	const char* values[8];
+	char        port_str[16];
+	char        timeout[16];
+	PGconn*     conn;
+	int         n = 0;
+
+	/* The auth settings describe the local server, so only use them there */
+	if (g_auth_context.method != RAMD_AUTH_METHOD_UNKNOWN && g_auth_context.hostname &&
+	    host && strcmp(host, g_auth_context.hostname) == 0 && port == g_auth_context.port)
 	{
 		conn = ramd_postgresql_auth_connect();
 		if (conn)
 		{
-			ramd_log_info("Connected to PostgreSQL using %s authentication: %s:%d/%s", 
+			ramd_log_info("Connected to PostgreSQL using %s authentication: %s:%d/%s",
 			              ramd_auth_get_method_name(g_auth_context.method), host, port, dbname);
 			return conn;
 		}
 		ramd_log_warning("Authentication-based connection failed, falling back to basic connection");
 	}
-	
-	/* Fallback to basic connection */
-	char conninfo[512];
-	snprintf(conninfo, sizeof(conninfo),
-	         "host=%s port=%d dbname=%s user=%s password=%s",
-	         host, port, dbname ? dbname : "postgres",
-	         user ? user : "postgres",
-	         password ? password : "");
-	
-	conn = PQconnectdb(conninfo);
+
+	/* Parameters rather than a conninfo string keep the password out of any text */
+	snprintf(port_str, sizeof(port_str), "%d", port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = host ? host : "localhost";
+	keywords[n] = "port";            values[n++] = port_str;
+	keywords[n] = "dbname";          values[n++] = dbname ? dbname : "postgres";
+	keywords[n] = "user";            values[n++] = user ? user : "postgres";
+	if (password && password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	conn = PQconnectdbParams(keywords, values, 0);
 	if (PQstatus(conn) != CONNECTION_OK)
 	{
 		ramd_log_error("Failed to connect to PostgreSQL: %s",
@@ -86,51 +187,296 @@ ramd_conn_get(const char* host, int32_t port, const char* dbname,
 		PQfinish(conn);
 		return NULL;
 	}
-	
+
 	ramd_log_info("Connected to PostgreSQL: %s:%d/%s", host, port, dbname);
 	return conn;
 }
 
-PGconn*
-ramd_conn_get_cached(int32_t node_id, const char* host, int32_t port,
-                     const char* dbname, const char* user, const char* password)
+/* A session idle for a while may have been dropped by the server or a proxy */
+static bool
+ramd_conn_validate(PGconn* conn)
 {
-	PGconn* conn = NULL;
-	
-	if (node_id <= 0 || node_id > RAMD_MAX_NODES)
+	PGresult* res;
+	bool      ok;
+
+	if (PQstatus(conn) != CONNECTION_OK)
+		return false;
+	res = ramd_conn_exec_timeout(conn, "SELECT 1", RAMD_CONN_POOL_PING_TIMEOUT_MS);
+	ok = res && PQresultStatus(res) == PGRES_TUPLES_OK;
+	PQclear(res);
+	return ok;
+}
+
+static PGconn*
+ramd_conn_checkout_pooled(int32_t node_id, const char* host, int32_t port,
+                          const char* dbname, const char* user, const char* password)
+{
+	ramd_conn_pool_t* pool = ramd_conn_pool(node_id);
+	struct timespec   deadline;
+	PGconn*           conn;
+	uint32_t          generation;
+	int64_t           now_us;
+	int               free_slot;
+
+	if (!pool || !host)
 		return NULL;
-	
-	pthread_mutex_lock(&g_conn_mutex);
-	
-	if (g_conn_cache[node_id - 1])
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += RAMD_CONN_POOL_WAIT_MS / 1000;
+	deadline.tv_nsec += (long) (RAMD_CONN_POOL_WAIT_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (pool->port != port || strcmp(pool->host, host) != 0)
 	{
-		if (PQstatus(g_conn_cache[node_id - 1]) == CONNECTION_OK)
+		/* The node moved; sessions to the old address are closed as they come back */
+		snprintf(pool->host, sizeof(pool->host), "%s", host);
+		pool->port = port;
+		pool->generation++;
+	}
+
+	for (;;)
+	{
+		now_us = ramd_clock_now_us();
+		ramd_conn_pool_reap(pool, now_us);
+
+		free_slot = -1;
+		for (int i = 0; i < RAMD_CONN_POOL_SIZE; i++)
 		{
-			conn = g_conn_cache[node_id - 1];
-			pthread_mutex_unlock(&g_conn_mutex);
-			return conn;
+			ramd_conn_slot_t* slot = &pool->slots[i];
+			bool              stale;
+
+			if (slot->busy)
+				continue; /* borrowed, or being opened when it has no conn yet */
+			if (!slot->conn)
+			{
+				if (free_slot < 0)
+					free_slot = i;
+				continue;
+			}
+
+			slot->busy = true;
+			stale = now_us - slot->idle_since_us >= (int64_t) RAMD_CONN_POOL_VALIDATE_MS * 1000;
+			pthread_mutex_unlock(&pool->lock);
+
+			if (!stale || ramd_conn_validate(slot->conn))
+				return slot->conn;
+
+			pthread_mutex_lock(&pool->lock);
+			ramd_log_debug("Connection pool: dropping a dead session to node %d", node_id);
+			ramd_conn_finish(slot->conn);
+			slot->conn = NULL;
+			slot->busy = false;
+			free_slot = i;
+			break;
+		}
+
+		if (free_slot >= 0)
+			break;
+
+		if (pthread_cond_timedwait(&pool->available, &pool->lock, &deadline) == ETIMEDOUT)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			ramd_log_warning("Connection pool: all %d sessions to node %d are in use",
+			                 RAMD_CONN_POOL_SIZE, node_id);
+			return NULL;
 		}
-		
-		PQfinish(g_conn_cache[node_id - 1]);
-		g_conn_cache[node_id - 1] = NULL;
 	}
-	
+
+	/* Open outside the lock; the slot is claimed so nobody else fills it */
+	pool->slots[free_slot].busy = true;
+	generation = pool->generation;
+	pthread_mutex_unlock(&pool->lock);
+
 	conn = ramd_conn_get(host, port, dbname, user, password);
+
+	pthread_mutex_lock(&pool->lock);
 	if (conn)
-		g_conn_cache[node_id - 1] = conn;
-	
-	pthread_mutex_unlock(&g_conn_mutex);
+	{
+		pool->slots[free_slot].conn = conn;
+		pool->slots[free_slot].generation = generation;
+	}
+	else
+	{
+		pool->slots[free_slot].busy = false;
+		pthread_cond_signal(&pool->available);
+	}
+	pthread_mutex_unlock(&pool->lock);
 	return conn;
 }
 
+/*
+ * A request being served on this thread is charged for the session from
+ * checkout to checkin, waiting for a free slot included.
+ */
+PGconn*
+ramd_conn_checkout(int32_t node_id, const char* host, int32_t port,
+                   const char* dbname, const char* user, const char* password)
+{
+	PGconn* conn;
+
+	ramd_http_profile_pg_enter();
+	conn = ramd_conn_checkout_pooled(node_id, host, port, dbname, user, password);
+	if (!conn)
+		ramd_http_profile_pg_leave();
+	return conn;
+}
+
+void
+ramd_conn_checkin(int32_t node_id, PGconn* conn)
+{
+	ramd_conn_pool_t* pool = ramd_conn_pool(node_id);
+
+	if (!conn)
+		return;
+	ramd_http_profile_pg_leave();
+	if (!pool)
+	{
+		ramd_conn_finish(conn);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	for (int i = 0; i < RAMD_CONN_POOL_SIZE; i++)
+	{
+		ramd_conn_slot_t* slot = &pool->slots[i];
+
+		if (slot->conn != conn)
+			continue;
+
+		/* Only a clean, idle session to the current address goes back */
+		if (PQstatus(conn) != CONNECTION_OK ||
+		    PQtransactionStatus(conn) != PQTRANS_IDLE ||
+		    slot->generation != pool->generation)
+		{
+			ramd_conn_finish(conn);
+			slot->conn = NULL;
+		}
+		slot->busy = false;
+		slot->idle_since_us = ramd_clock_now_us();
+		pthread_cond_signal(&pool->available);
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	/* Not one of ours, e.g. checked in after cleanup emptied the pool */
+	ramd_conn_finish(conn);
+}
+
+void
+ramd_conn_reap_idle(void)
+{
+	int64_t now_us = ramd_clock_now_us();
+
+	pthread_once(&g_conn_pools_once, ramd_conn_pools_init_once);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		pthread_mutex_lock(&g_conn_pools[i].lock);
+		ramd_conn_pool_reap(&g_conn_pools[i], now_us);
+		pthread_mutex_unlock(&g_conn_pools[i].lock);
+	}
+}
+
+bool
+ramd_conn_send(PGconn* conn, const char* query)
+{
+	if (!conn || !query)
+		return false;
+
+	if (!PQsendQuery(conn, query))
+	{
+		ramd_log_error("Query could not be sent: %s", PQerrorMessage(conn));
+		return false;
+	}
+	return true;
+}
+
+PGresult*
+ramd_conn_wait_result(PGconn* conn, int32_t timeout_ms)
+{
+	PGresult* last = NULL;
+	PGresult* res;
+	int64_t   deadline_us = ramd_clock_now_us() + (int64_t) timeout_ms * 1000;
+
+	if (!conn)
+		return NULL;
+
+	for (;;)
+	{
+		while (PQisBusy(conn))
+		{
+			struct pollfd pfd = {.fd = PQsocket(conn), .events = POLLIN};
+			int64_t       remaining_ms = (deadline_us - ramd_clock_now_us()) / 1000;
+			int           rc;
+
+			if (pfd.fd < 0)
+			{
+				PQclear(last);
+				return NULL;
+			}
+			if (remaining_ms <= 0)
+			{
+				PGcancel* cancel = PQgetCancel(conn);
+				char      errbuf[256];
+
+				ramd_log_warning("Query did not finish within %d ms, cancelling", timeout_ms);
+				if (cancel)
+				{
+					PQcancel(cancel, errbuf, sizeof(errbuf));
+					PQfreeCancel(cancel);
+				}
+				/* Drain what the cancelled query still sends, so the session stays usable */
+				while ((res = PQgetResult(conn)) != NULL)
+					PQclear(res);
+				PQclear(last);
+				return NULL;
+			}
+
+			rc = poll(&pfd, 1, (int) remaining_ms);
+			if (rc < 0 && errno != EINTR)
+			{
+				PQclear(last);
+				return NULL;
+			}
+			if (rc > 0 && !PQconsumeInput(conn))
+			{
+				ramd_log_error("Connection lost while waiting for a result: %s",
+				               PQerrorMessage(conn));
+				PQclear(last);
+				return NULL;
+			}
+		}
+
+		res = PQgetResult(conn);
+		if (!res)
+			break;
+		PQclear(last);
+		last = res;
+	}
+	return last;
+}
+
+PGresult*
+ramd_conn_exec_timeout(PGconn* conn, const char* query, int32_t timeout_ms)
+{
+	if (!ramd_conn_send(conn, query))
+		return NULL;
+	return ramd_conn_wait_result(conn, timeout_ms);
+}
+
 PGresult*
 ramd_conn_exec(PGconn* conn, const char* query)
 {
 	PGresult* res;
-	
+
 	if (!conn || !query)
 		return NULL;
-	
+
 	res = PQexec(conn, query);
 	if (PQresultStatus(res) != PGRES_TUPLES_OK &&
 	    PQresultStatus(res) != PGRES_COMMAND_OK)
@@ -139,7 +485,7 @@ ramd_conn_exec(PGconn* conn, const char* query)
 		PQclear(res);
 		return NULL;
 	}
-	
+
 	return res;
 }
 
@@ -147,5 +493,5 @@ void
 ramd_conn_close(PGconn* conn)
 {
 	if (conn)
-		PQfinish(conn);
+		ramd_conn_finish(conn);
 }
@@ -0,0 +1,330 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_detector.c
+ *		PostgreSQL Auto-Failover Daemon - Phi-Accrual Failure Detector
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Instead of calling a node dead after one missed probe, every heartbeat
+ * from it is timed and the gaps between them are kept.  phi is how
+ * unlikely the current silence is given those gaps, as -log10 of the
+ * chance that a heartbeat would still arrive this late (Hayashibara et
+ * al., with the logistic approximation of the normal tail also used by
+ * Akka and Cassandra).  phi 1 means a 10% chance of being wrong, phi 8 one
+ * in a hundred million.  The window adapts to how regularly a node
+ * answers, so a short probe interval detects fast without flapping on a
+ * single lost probe, and failure_detector_pause_ms absorbs the pauses a
+ * healthy server is known to take.
+ *
+ * PostgreSQL probes and pgraft liveness are tracked separately: a server
+ * whose own process is down still has a live consensus worker and must
+ * fail over, so Raft cannot keep a node alive, but when both have gone
+ * quiet the host itself is gone and the lower suspect threshold is
+ * enough to act on.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include "ramd_detector.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+typedef struct ramd_detector_history_t
+{
+	int64_t last_us; /* ramd_clock time of the latest heartbeat, 0 if none */
+	double intervals_ms[RAMD_DETECTOR_WINDOW];
+	int32_t head;
+	int32_t count;
+	double sum;
+	double sum_sq;
+} ramd_detector_history_t;
+
+typedef struct ramd_detector_entry_t
+{
+	bool used;
+	int32_t node_id;
+	int64_t watched_since_us;
+	ramd_detector_verdict_t verdict; /* as last reported, to log changes once */
+	long long match_index;           /* in the previous snapshot, if we lead */
+	ramd_detector_history_t history[RAMD_DETECTOR_SOURCE_COUNT];
+} ramd_detector_entry_t;
+
+static struct
+{
+	pthread_mutex_t lock; /* fed by the monitor thread, read by the failover loop */
+	ramd_detector_entry_t entries[RAMD_MAX_NODES];
+} g_detector = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char* const ramd_detector_source_names[RAMD_DETECTOR_SOURCE_COUNT] = {
+	"postgresql", "raft"
+};
+
+static int64_t
+ramd_detector_now_us(void)
+{
+	return ramd_clock_now_us();
+}
+
+static ramd_detector_entry_t*
+ramd_detector_find(int32_t node_id, int64_t now_us)
+{
+	ramd_detector_entry_t* free_entry = NULL;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_detector_entry_t* e = &g_detector.entries[i];
+
+		if (e->used && e->node_id == node_id)
+			return e;
+		if (!e->used && !free_entry)
+			free_entry = e;
+	}
+
+	if (!free_entry)
+		return NULL;
+
+	memset(free_entry, 0, sizeof(*free_entry));
+	free_entry->used = true;
+	free_entry->node_id = node_id;
+	free_entry->watched_since_us = now_us;
+	free_entry->match_index = -1;
+	return free_entry;
+}
+
+static void
+ramd_detector_record(ramd_detector_entry_t* e, ramd_detector_source_t source, int64_t now_us)
+{
+	ramd_detector_history_t* h = &e->history[source];
+	double                   interval_ms;
+
+	if (h->last_us == 0)
+	{
+		h->last_us = now_us;
+		return;
+	}
+
+	/* Two probes of one cycle say nothing about the gap between cycles */
+	interval_ms = (double) (now_us - h->last_us) / 1000.0;
+	if (interval_ms < RAMD_DETECTOR_MIN_INTERVAL_MS)
+		return;
+
+	if (h->count == RAMD_DETECTOR_WINDOW)
+	{
+		double oldest = h->intervals_ms[h->head];
+
+		h->sum -= oldest;
+		h->sum_sq -= oldest * oldest;
+		h->count--;
+	}
+	h->intervals_ms[h->head] = interval_ms;
+	h->head = (h->head + 1) % RAMD_DETECTOR_WINDOW;
+	h->count++;
+	h->sum += interval_ms;
+	h->sum_sq += interval_ms * interval_ms;
+	h->last_us = now_us;
+}
+
+void
+ramd_detector_heartbeat(int32_t node_id, ramd_detector_source_t source)
+{
+	int64_t                now_us = ramd_detector_now_us();
+	ramd_detector_entry_t* e;
+
+	if (node_id <= 0 || source >= RAMD_DETECTOR_SOURCE_COUNT)
+		return;
+
+	pthread_mutex_lock(&g_detector.lock);
+	e = ramd_detector_find(node_id, now_us);
+	if (e)
+		ramd_detector_record(e, source, now_us);
+	pthread_mutex_unlock(&g_detector.lock);
+}
+
+void
+ramd_detector_observe_raft(const ramd_pgraft_snapshot_t* snapshot)
+{
+	int64_t now_us = ramd_detector_now_us();
+
+	if (!snapshot || !snapshot->published)
+		return;
+
+	pthread_mutex_lock(&g_detector.lock);
+
+	/* A follower that lost its leader would have started an election */
+	if (!snapshot->is_leader)
+	{
+		ramd_detector_entry_t* e;
+
+		if (snapshot->leader_id > 0 && snapshot->leader_id != snapshot->local_node_id)
+		{
+			e = ramd_detector_find((int32_t) snapshot->leader_id, now_us);
+			if (e)
+				ramd_detector_record(e, RAMD_DETECTOR_RAFT, now_us);
+		}
+		pthread_mutex_unlock(&g_detector.lock);
+		return;
+	}
+
+	/*
+	 * An idle log does not move, so a follower that has everything committed
+	 * counts as heard from.  That can keep a dead follower "alive" on this
+	 * channel, which only costs the faster corroborated verdict.
+	 */
+	for (int i = 0; i < snapshot->node_count && i < RAMD_PGRAFT_MAX_NODES; i++)
+	{
+		const ramd_pgraft_node_progress_t* n = &snapshot->nodes[i];
+		ramd_detector_entry_t*             e;
+		bool                               heard;
+
+		if (n->node_id <= 0 || n->node_id == snapshot->local_node_id)
+			continue;
+		e = ramd_detector_find(n->node_id, now_us);
+		if (!e)
+			continue;
+		heard = n->match_index >= 0 &&
+		        (n->match_index != e->match_index || n->match_index >= snapshot->commit_index);
+		e->match_index = n->match_index;
+		if (heard)
+			ramd_detector_record(e, RAMD_DETECTOR_RAFT, now_us);
+	}
+	pthread_mutex_unlock(&g_detector.lock);
+}
+
+/* -log10 of the chance a heartbeat is still to come after elapsed_ms */
+static double
+ramd_detector_phi(double elapsed_ms, double mean_ms, double stddev_ms)
+{
+	double y = (elapsed_ms - mean_ms) / stddev_ms;
+	double e = exp(-y * (1.5976 + 0.070566 * y * y));
+	double p_later = elapsed_ms > mean_ms ? e / (1.0 + e) : 1.0 - 1.0 / (1.0 + e);
+
+	if (p_later <= 0.0)
+		return RAMD_DETECTOR_PHI_MAX;
+	return fmin(-log10(p_later), RAMD_DETECTOR_PHI_MAX);
+}
+
+static void
+ramd_detector_source_stats(const ramd_detector_entry_t* e, ramd_detector_source_t source,
+                           const ramd_config_t* config, int64_t now_us,
+                           ramd_detector_stats_t* stats)
+{
+	const ramd_detector_history_t* h = &e->history[source];
+	int64_t                        last_us = h->last_us;
+	double                         mean_ms;
+	double                         variance;
+
+	stats->samples[source] = h->count;
+	stats->since_last_ms[source] = last_us ? (now_us - last_us) / 1000 : -1;
+	stats->phi[source] = 0.0;
+	stats->mean_interval_ms[source] = 0.0;
+
+	/* Raft only speaks up once it has a rhythm; PostgreSQL is timed from the start */
+	if (source == RAMD_DETECTOR_RAFT && h->count < RAMD_DETECTOR_MIN_SAMPLES)
+		return;
+	if (last_us == 0)
+		last_us = e->watched_since_us;
+
+	if (h->count > 0)
+	{
+		mean_ms = h->sum / h->count;
+		variance = h->sum_sq / h->count - mean_ms * mean_ms;
+	}
+	else
+	{
+		/* Until the first gap is seen, expect one probe per monitor cycle */
+		mean_ms = config->monitor_interval_ms;
+		variance = (mean_ms / 4.0) * (mean_ms / 4.0);
+	}
+
+	stats->mean_interval_ms[source] = mean_ms;
+	stats->phi[source] = ramd_detector_phi((double) (now_us - last_us) / 1000.0,
+	                                       mean_ms + config->failure_detector_pause_ms,
+	                                       fmax(sqrt(fmax(variance, 0.0)),
+	                                            config->failure_detector_min_stddev_ms));
+}
+
+ramd_detector_verdict_t
+ramd_detector_check(int32_t node_id, const ramd_config_t* config, ramd_detector_stats_t* stats)
+{
+	ramd_detector_stats_t   local;
+	ramd_detector_stats_t*  s = stats ? stats : &local;
+	int64_t                 now_us = ramd_detector_now_us();
+	ramd_detector_entry_t*  e;
+	ramd_detector_verdict_t verdict = RAMD_DETECTOR_ALIVE;
+	double                  pg_phi;
+	double                  raft_phi;
+
+	memset(s, 0, sizeof(*s));
+	s->node_id = node_id;
+	if (!config || node_id <= 0)
+		return RAMD_DETECTOR_ALIVE;
+
+	pthread_mutex_lock(&g_detector.lock);
+	e = ramd_detector_find(node_id, now_us);
+	if (!e)
+	{
+		pthread_mutex_unlock(&g_detector.lock);
+		return RAMD_DETECTOR_ALIVE;
+	}
+
+	for (int source = 0; source < RAMD_DETECTOR_SOURCE_COUNT; source++)
+		ramd_detector_source_stats(e, (ramd_detector_source_t) source, config, now_us, s);
+
+	pg_phi = s->phi[RAMD_DETECTOR_POSTGRESQL];
+	raft_phi = s->phi[RAMD_DETECTOR_RAFT];
+	if (pg_phi >= config->failure_detector_phi_failover ||
+	    (pg_phi >= config->failure_detector_phi_suspect &&
+	     raft_phi >= config->failure_detector_phi_suspect))
+		verdict = RAMD_DETECTOR_FAILED;
+	else if (pg_phi >= config->failure_detector_phi_suspect)
+		verdict = RAMD_DETECTOR_SUSPECT;
+	s->verdict = verdict;
+
+	if (verdict != e->verdict)
+	{
+		if (verdict == RAMD_DETECTOR_ALIVE)
+			ramd_log_info("Failure detector: node %d is answering again", node_id);
+		else
+			ramd_log_warning("Failure detector: node %d %s (phi %s=%.1f, %s=%.1f; "
+			                 "silent for %lld ms)",
+			                 node_id,
+			                 verdict == RAMD_DETECTOR_FAILED ? "has failed" : "is suspected",
+			                 ramd_detector_source_names[RAMD_DETECTOR_POSTGRESQL], pg_phi,
+			                 ramd_detector_source_names[RAMD_DETECTOR_RAFT], raft_phi,
+			                 (long long) s->since_last_ms[RAMD_DETECTOR_POSTGRESQL]);
+		e->verdict = verdict;
+	}
+	pthread_mutex_unlock(&g_detector.lock);
+	return verdict;
+}
+
+void
+ramd_detector_forget(int32_t node_id)
+{
+	pthread_mutex_lock(&g_detector.lock);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		if (g_detector.entries[i].used && g_detector.entries[i].node_id == node_id)
+			g_detector.entries[i].used = false;
+	}
+	pthread_mutex_unlock(&g_detector.lock);
+}
+
+const char*
+ramd_detector_verdict_to_string(ramd_detector_verdict_t verdict)
+{
+	switch (verdict)
+	{
+		case RAMD_DETECTOR_ALIVE:
+			return "alive";
+		case RAMD_DETECTOR_SUSPECT:
+			return "suspect";
+		case RAMD_DETECTOR_FAILED:
+			return "failed";
+	}
+	return "unknown";
+}
@@ -0,0 +1,772 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_endpoint.c
+ *		PostgreSQL Auto-Failover Daemon - Client Endpoint Movers
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Promoting a standby does nothing for clients that still resolve the old
+ * primary's address.  The movers here carry the client-facing endpoint
+ * over as soon as the promotion is confirmed:
+ *
+ *   endpoint_vip      a virtual IP added with RTM_NEWADDR over rtnetlink
+ *                     and announced with gratuitous ARP (IPv4) or an
+ *                     unsolicited neighbour advertisement (IPv6), so
+ *                     switches and clients on the segment update their
+ *                     caches at once instead of when the entries expire.
+ *                     Needs CAP_NET_ADMIN and CAP_NET_RAW; Linux only.
+ *   endpoint_command  endpoint_move_command run as
+ *                       endpoint_move_command <node_id> <host> <port>
+ *                     for what ramd cannot do itself: reassigning an AWS
+ *                     secondary IP or ENI, a GCP alias IP, or patching a
+ *                     Kubernetes Service's Endpoints.
+ *
+ * A VIP can only be brought up by the host that is to hold it, and the
+ * daemon running a failover is often another one: the failover brings the
+ * VIP up when it promoted the local node and otherwise only makes sure
+ * this host no longer holds it, as after a switchover.  Every daemon
+ * also watches its own role in the watch feed and adds or drops the VIP
+ * to match, which covers remote promotions, switchovers, and a demoted
+ * primary that must give the address up.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* struct ifreq, if_nametoindex */
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#ifdef __linux__
+#include <linux/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <netinet/icmp6.h>
+#endif
+
+#include "ramd_endpoint.h"
+#include "ramd_defaults.h"
+#include "ramd_failover_trace.h"
+#include "ramd_logging.h"
+#include "ramd_process.h"
+#include "ramd_watch.h"
+
+/* endpoint_vip, parsed */
+typedef struct ramd_endpoint_vip_t
+{
+	int family;
+	uint8_t address[16];
+	size_t address_length;
+	uint8_t prefix;
+	unsigned int ifindex;
+	char text[INET6_ADDRSTRLEN];
+	char interface[IF_NAMESIZE];
+} ramd_endpoint_vip_t;
+
+typedef enum
+{
+	RAMD_ENDPOINT_VIP_UNKNOWN = 0, /* not yet reconciled since start */
+	RAMD_ENDPOINT_VIP_HELD,
+	RAMD_ENDPOINT_VIP_RELEASED
+} ramd_endpoint_vip_state_t;
+
+/* A way of moving the endpoint; applies() false skips it for this move */
+typedef struct ramd_endpoint_mover_t
+{
+	const char* name;
+	ramd_failover_phase_t phase;
+	bool (*applies)(const ramd_endpoint_target_t* target);
+	bool (*move)(const ramd_endpoint_target_t* target);
+} ramd_endpoint_mover_t;
+
+typedef struct ramd_endpoint_arg_t
+{
+	ramd_endpoint_move_t* move;
+	int32_t index;
+} ramd_endpoint_arg_t;
+
+typedef struct ramd_endpoint_t
+{
+	pthread_mutex_t lock;  /* guards everything below */
+	pthread_cond_t cond;   /* wakes the reconciler */
+	bool running;
+	bool pending;          /* the feed moved since the last reconcile */
+	pthread_t thread;
+	const ramd_config_t* config;
+	ramd_endpoint_vip_state_t vip_state;
+} ramd_endpoint_t;
+
+static ramd_endpoint_t g_endpoint = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* "10.0.0.10/24" or "fd00::10/64"; without a prefix the address alone */
+static bool
+ramd_endpoint_parse_vip(const char* text, const char* interface, ramd_endpoint_vip_t* vip)
+{
+	char address[INET6_ADDRSTRLEN];
+	const char* slash = strchr(text, '/');
+	size_t length = slash ? (size_t) (slash - text) : strlen(text);
+	long prefix;
+	char* end;
+
+	memset(vip, 0, sizeof(*vip));
+	if (length == 0 || length >= sizeof(address) || !interface || interface[0] == '\0' ||
+	    strlen(interface) >= sizeof(vip->interface))
+		return false;
+	memcpy(address, text, length);
+	address[length] = '\0';
+
+	if (inet_pton(AF_INET, address, vip->address) == 1)
+	{
+		vip->family = AF_INET;
+		vip->address_length = 4;
+	}
+	else if (inet_pton(AF_INET6, address, vip->address) == 1)
+	{
+		vip->family = AF_INET6;
+		vip->address_length = 16;
+	}
+	else
+		return false;
+
+	prefix = (long) vip->address_length * 8;
+	if (slash)
+	{
+		prefix = strtol(slash + 1, &end, 10);
+		if (end == slash + 1 || *end != '\0' || prefix < 1 ||
+		    prefix > (long) vip->address_length * 8)
+			return false;
+	}
+	vip->prefix = (uint8_t) prefix;
+
+	memcpy(vip->text, address, length + 1);
+	memcpy(vip->interface, interface, strlen(interface) + 1);
+	vip->ifindex = if_nametoindex(interface);
+	return true;
+}
+
+bool
+ramd_endpoint_vip_is_valid(const char* vip, const char* interface)
+{
+	ramd_endpoint_vip_t parsed;
+
+	return ramd_endpoint_parse_vip(vip, interface, &parsed);
+}
+
+#ifdef __linux__
+
+static void
+ramd_endpoint_add_attr(struct nlmsghdr* message, unsigned short type, const void* data,
+                       size_t length)
+{
+	struct rtattr* attr = (struct rtattr*) (void*) ((char*) message +
+	                                                 NLMSG_ALIGN(message->nlmsg_len));
+
+	attr->rta_type = type;
+	attr->rta_len = (unsigned short) RTA_LENGTH(length);
+	memcpy(RTA_DATA(attr), data, length);
+	message->nlmsg_len = NLMSG_ALIGN(message->nlmsg_len) + RTA_ALIGN(attr->rta_len);
+}
+
+/* Send one RTM_NEWADDR or RTM_DELADDR for vip; 0 or the kernel's errno */
+static int
+ramd_endpoint_netlink(const ramd_endpoint_vip_t* vip, unsigned short type, unsigned short flags)
+{
+	struct
+	{
+		struct nlmsghdr header;
+		struct ifaddrmsg ifa;
+		char attrs[128];
+	} request;
+	struct sockaddr_nl kernel = {.nl_family = AF_NETLINK};
+	struct timeval timeout = {
+		.tv_sec = RAMD_ENDPOINT_NETLINK_TIMEOUT_MS / 1000,
+		.tv_usec = (RAMD_ENDPOINT_NETLINK_TIMEOUT_MS % 1000) * 1000,
+	};
+	char reply[1024];
+	ssize_t n;
+	int result = EIO;
+	int fd;
+
+	memset(&request, 0, sizeof(request));
+	request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+	request.header.nlmsg_type = type;
+	request.header.nlmsg_flags = (unsigned short) (NLM_F_REQUEST | NLM_F_ACK | flags);
+	request.header.nlmsg_seq = 1;
+	request.ifa.ifa_family = (unsigned char) vip->family;
+	request.ifa.ifa_prefixlen = vip->prefix;
+	request.ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+	request.ifa.ifa_index = vip->ifindex;
+	/* Usable at once: duplicate detection would hold it back a second or more */
+	if (vip->family == AF_INET6)
+		request.ifa.ifa_flags = IFA_F_NODAD;
+	ramd_endpoint_add_attr(&request.header, IFA_LOCAL, vip->address, vip->address_length);
+	ramd_endpoint_add_attr(&request.header, IFA_ADDRESS, vip->address, vip->address_length);
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (fd < 0)
+		return errno;
+	(void) setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	if (sendto(fd, &request, request.header.nlmsg_len, 0, (struct sockaddr*) &kernel,
+	           sizeof(kernel)) < 0)
+	{
+		result = errno;
+		close(fd);
+		return result;
+	}
+
+	n = recv(fd, reply, sizeof(reply), 0);
+	if (n < 0)
+		result = errno;
+	else
+	{
+		struct nlmsghdr* header = (struct nlmsghdr*) (void*) reply;
+		size_t remaining = (size_t) n;
+
+		for (; NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining))
+		{
+			if (header->nlmsg_type == NLMSG_ERROR)
+			{
+				const struct nlmsgerr* error = (const struct nlmsgerr*) NLMSG_DATA(header);
+
+				result = -error->error;
+				break;
+			}
+		}
+	}
+	close(fd);
+	return result;
+}
+
+static bool
+ramd_endpoint_hwaddr(const ramd_endpoint_vip_t* vip, uint8_t mac[ETH_ALEN])
+{
+	struct ifreq ifr;
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	bool ok;
+
+	if (fd < 0)
+		return false;
+	memset(&ifr, 0, sizeof(ifr));
+	memcpy(ifr.ifr_name, vip->interface, strlen(vip->interface) + 1);
+	ok = ioctl(fd, SIOCGIFHWADDR, &ifr) == 0;
+	if (ok)
+		memcpy(mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+	close(fd);
+	return ok;
+}
+
+/* A gratuitous ARP request: sender and target are both the VIP */
+static bool
+ramd_endpoint_send_garp(int fd, const ramd_endpoint_vip_t* vip, const uint8_t mac[ETH_ALEN])
+{
+	struct sockaddr_ll to;
+	uint8_t packet[28];
+
+	memset(&to, 0, sizeof(to));
+	to.sll_family = AF_PACKET;
+	to.sll_protocol = htons(ETH_P_ARP);
+	to.sll_ifindex = (int) vip->ifindex;
+	to.sll_halen = ETH_ALEN;
+	memset(to.sll_addr, 0xff, ETH_ALEN);
+
+	memset(packet, 0, sizeof(packet));
+	packet[1] = ARPHRD_ETHER;        /* hardware type */
+	packet[2] = ETH_P_IP >> 8;       /* protocol type */
+	packet[4] = ETH_ALEN;
+	packet[5] = 4;
+	packet[7] = ARPOP_REQUEST;
+	memcpy(packet + 8, mac, ETH_ALEN);
+	memcpy(packet + 14, vip->address, 4);
+	memcpy(packet + 24, vip->address, 4);
+
+	return sendto(fd, packet, sizeof(packet), 0, (struct sockaddr*) &to, sizeof(to)) ==
+	       (ssize_t) sizeof(packet);
+}
+
+/* An unsolicited neighbour advertisement to all nodes, override set */
+static bool
+ramd_endpoint_send_na(int fd, const ramd_endpoint_vip_t* vip, const uint8_t mac[ETH_ALEN])
+{
+	struct sockaddr_in6 to;
+	struct
+	{
+		struct nd_neighbor_advert na;
+		struct nd_opt_hdr option;
+		uint8_t mac[ETH_ALEN];
+	} packet;
+
+	memset(&to, 0, sizeof(to));
+	to.sin6_family = AF_INET6;
+	to.sin6_scope_id = vip->ifindex;
+	(void) inet_pton(AF_INET6, "ff02::1", &to.sin6_addr);
+
+	memset(&packet, 0, sizeof(packet));
+	packet.na.nd_na_type = ND_NEIGHBOR_ADVERT;
+	packet.na.nd_na_flags_reserved = ND_NA_FLAG_OVERRIDE;
+	memcpy(&packet.na.nd_na_target, vip->address, 16);
+	packet.option.nd_opt_type = ND_OPT_TARGET_LINKADDR;
+	packet.option.nd_opt_len = 1; /* in units of 8 bytes */
+	memcpy(packet.mac, mac, ETH_ALEN);
+
+	/* The kernel fills in the ICMPv6 checksum on a raw ICMPv6 socket */
+	return sendto(fd, &packet, sizeof(packet), 0, (struct sockaddr*) &to, sizeof(to)) ==
+	       (ssize_t) sizeof(packet);
+}
+
+/* RAMD_ENDPOINT_ANNOUNCE_COUNT announcements, RAMD_ENDPOINT_ANNOUNCE_INTERVAL_MS apart */
+static bool
+ramd_endpoint_announce(const ramd_endpoint_vip_t* vip)
+{
+	struct timespec gap = {
+		.tv_sec = RAMD_ENDPOINT_ANNOUNCE_INTERVAL_MS / 1000,
+		.tv_nsec = (long) (RAMD_ENDPOINT_ANNOUNCE_INTERVAL_MS % 1000) * 1000000L,
+	};
+	uint8_t mac[ETH_ALEN];
+	bool sent = false;
+	int fd;
+
+	if (!ramd_endpoint_hwaddr(vip, mac))
+	{
+		ramd_log_warning("Endpoint: cannot read the hardware address of %s: %s",
+		                 vip->interface, strerror(errno));
+		return false;
+	}
+
+	if (vip->family == AF_INET)
+		fd = socket(AF_PACKET, SOCK_DGRAM | SOCK_CLOEXEC, htons(ETH_P_ARP));
+	else
+	{
+		struct sockaddr_in6 from;
+		int hops = 255;
+
+		fd = socket(AF_INET6, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_ICMPV6);
+		if (fd >= 0)
+		{
+			/* A neighbour advertisement is dropped unless sent with hop limit 255 */
+			(void) setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+			(void) setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_IF, &vip->ifindex,
+			                  sizeof(vip->ifindex));
+			memset(&from, 0, sizeof(from));
+			from.sin6_family = AF_INET6;
+			memcpy(&from.sin6_addr, vip->address, 16);
+			(void) bind(fd, (struct sockaddr*) &from, sizeof(from));
+		}
+	}
+	if (fd < 0)
+	{
+		ramd_log_warning("Endpoint: cannot open a socket to announce %s: %s", vip->text,
+		                 strerror(errno));
+		return false;
+	}
+
+	for (int i = 0; i < RAMD_ENDPOINT_ANNOUNCE_COUNT; i++)
+	{
+		if (i > 0)
+			nanosleep(&gap, NULL);
+		if (vip->family == AF_INET ? ramd_endpoint_send_garp(fd, vip, mac)
+		                           : ramd_endpoint_send_na(fd, vip, mac))
+			sent = true;
+	}
+	if (!sent)
+		ramd_log_warning("Endpoint: cannot announce %s on %s: %s", vip->text, vip->interface,
+		                 strerror(errno));
+	close(fd);
+	return sent;
+}
+
+/* Bring the VIP up and announce it, or drop it */
+static bool
+ramd_endpoint_vip_apply(const ramd_endpoint_vip_t* vip, bool hold)
+{
+	int rc;
+
+	if (vip->ifindex == 0)
+	{
+		ramd_log_error("Endpoint: interface %s does not exist", vip->interface);
+		return false;
+	}
+
+	if (!hold)
+	{
+		rc = ramd_endpoint_netlink(vip, RTM_DELADDR, 0);
+		if (rc != 0 && rc != EADDRNOTAVAIL)
+		{
+			ramd_log_error("Endpoint: cannot remove %s/%u from %s: %s", vip->text,
+			               vip->prefix, vip->interface, strerror(rc));
+			return false;
+		}
+		if (rc == 0)
+			ramd_log_info("Endpoint: removed %s/%u from %s", vip->text, vip->prefix,
+			              vip->interface);
+		return true;
+	}
+
+	rc = ramd_endpoint_netlink(vip, RTM_NEWADDR, NLM_F_CREATE | NLM_F_EXCL);
+	if (rc != 0 && rc != EEXIST)
+	{
+		ramd_log_error("Endpoint: cannot add %s/%u to %s: %s", vip->text, vip->prefix,
+		               vip->interface, strerror(rc));
+		return false;
+	}
+	if (rc == 0)
+		ramd_log_info("Endpoint: added %s/%u to %s", vip->text, vip->prefix, vip->interface);
+
+	/* Announce even if it was there: the segment may still point elsewhere */
+	return ramd_endpoint_announce(vip);
+}
+
+#else
+
+static bool
+ramd_endpoint_vip_apply(const ramd_endpoint_vip_t* vip, bool hold)
+{
+	(void) hold;
+	ramd_log_error("Endpoint: moving %s needs rtnetlink, which this platform lacks",
+	               vip->text);
+	return false;
+}
+
+#endif /* __linux__ */
+
+/*
+ * Hold or release the VIP unless it is already known to be in that state;
+ * the reconciler and a local failover may both get here for one change.
+ */
+static bool
+ramd_endpoint_vip_set(const char* text, const char* interface, bool hold)
+{
+	ramd_endpoint_vip_state_t wanted = hold ? RAMD_ENDPOINT_VIP_HELD : RAMD_ENDPOINT_VIP_RELEASED;
+	ramd_endpoint_vip_t vip;
+	bool ok;
+
+	if (!ramd_endpoint_parse_vip(text, interface, &vip))
+	{
+		ramd_log_error("Endpoint: endpoint_vip '%s' on '%s' is not usable", text, interface);
+		return false;
+	}
+
+	pthread_mutex_lock(&g_endpoint.lock);
+	if (g_endpoint.vip_state == wanted)
+	{
+		pthread_mutex_unlock(&g_endpoint.lock);
+		return true;
+	}
+	pthread_mutex_unlock(&g_endpoint.lock);
+
+	ok = ramd_endpoint_vip_apply(&vip, hold);
+
+	pthread_mutex_lock(&g_endpoint.lock);
+	g_endpoint.vip_state = ok ? wanted : RAMD_ENDPOINT_VIP_UNKNOWN;
+	pthread_mutex_unlock(&g_endpoint.lock);
+	return ok;
+}
+
+static bool
+ramd_endpoint_vip_applies(const ramd_endpoint_target_t* target)
+{
+	return target->vip[0] != '\0';
+}
+
+/* Up here for a local promotion; otherwise make sure this host lets go */
+static bool
+ramd_endpoint_vip_move(const ramd_endpoint_target_t* target)
+{
+	return ramd_endpoint_vip_set(target->vip, target->vip_interface, target->local);
+}
+
+static bool
+ramd_endpoint_command_applies(const ramd_endpoint_target_t* target)
+{
+	return target->move_command[0] != '\0';
+}
+
+static bool
+ramd_endpoint_command_move(const ramd_endpoint_target_t* target)
+{
+	ramd_process_result_t result;
+	char node_id[16];
+	char port[16];
+	const char* argv[5];
+
+	snprintf(node_id, sizeof(node_id), "%d", target->node_id);
+	snprintf(port, sizeof(port), "%d", target->port);
+	argv[0] = target->move_command;
+	argv[1] = node_id;
+	argv[2] = target->hostname;
+	argv[3] = port;
+	argv[4] = NULL;
+
+	if (!ramd_process_run(argv, RAMD_ENDPOINT_COMMAND_TIMEOUT_MS, &result))
+	{
+		ramd_process_log_failure("endpoint_move_command", &result);
+		return false;
+	}
+	return true;
+}
+
+static const ramd_endpoint_mover_t g_endpoint_movers[RAMD_ENDPOINT_MOVER_COUNT] = {
+	{"endpoint_vip", RAMD_FAILOVER_PHASE_ENDPOINT_VIP, ramd_endpoint_vip_applies,
+	 ramd_endpoint_vip_move},
+	{"endpoint_command", RAMD_FAILOVER_PHASE_ENDPOINT_COMMAND, ramd_endpoint_command_applies,
+	 ramd_endpoint_command_move},
+};
+
+static void*
+ramd_endpoint_mover_main(void* arg)
+{
+	ramd_endpoint_arg_t* mover_arg = (ramd_endpoint_arg_t*) arg;
+	ramd_endpoint_move_t* move = mover_arg->move;
+	const ramd_endpoint_mover_t* mover = &g_endpoint_movers[mover_arg->index];
+	int32_t span;
+	bool ok;
+
+	span = ramd_failover_trace_span_start(mover->phase, move->target.node_id);
+	ok = mover->move(&move->target);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
+		ramd_log_warning("Endpoint: %s did not move clients to node %d", mover->name,
+		                 move->target.node_id);
+
+	move->ok[mover_arg->index] = ok;
+	free(mover_arg);
+	return NULL;
+}
+
+/* Copy src into dst whole; false, and nothing copied, if it does not fit */
+static bool
+ramd_endpoint_copy(char* dst, size_t size, const char* src)
+{
+	size_t length = strnlen(src, size);
+
+	if (length == size)
+		return false;
+	memcpy(dst, src, length + 1);
+	return true;
+}
+
+void
+ramd_endpoint_move_begin(ramd_endpoint_move_t* move, const ramd_config_t* config,
+                         const ramd_node_t* node)
+{
+	ramd_endpoint_target_t* target;
+
+	if (!move)
+		return;
+	memset(move, 0, sizeof(*move));
+	if (!config || !node)
+		return;
+
+	target = &move->target;
+	target->node_id = node->node_id;
+	target->local = node->node_id == config->node_id;
+	target->port = node->postgresql_port;
+
+	/* A cut host, address or command would move clients to the wrong place */
+	if (!ramd_endpoint_copy(target->hostname, sizeof(target->hostname), node->hostname) ||
+	    !ramd_endpoint_copy(target->vip, sizeof(target->vip), config->endpoint_vip) ||
+	    !ramd_endpoint_copy(target->vip_interface, sizeof(target->vip_interface),
+	                        config->endpoint_vip_interface) ||
+	    !ramd_endpoint_copy(target->move_command, sizeof(target->move_command),
+	                        config->endpoint_move_command))
+	{
+		ramd_log_error("Endpoint: host, endpoint_vip, endpoint_vip_interface or "
+		               "endpoint_move_command is too long; not moving clients to node %d",
+		               node->node_id);
+		for (int32_t i = 0; i < RAMD_ENDPOINT_MOVER_COUNT; i++)
+			move->ok[i] = false;
+		return;
+	}
+
+	for (int32_t i = 0; i < RAMD_ENDPOINT_MOVER_COUNT; i++)
+	{
+		ramd_endpoint_arg_t* arg;
+
+		move->ok[i] = true;
+		if (!g_endpoint_movers[i].applies(target))
+			continue;
+
+		arg = malloc(sizeof(*arg));
+		if (arg)
+		{
+			arg->move = move;
+			arg->index = i;
+			move->started[i] = pthread_create(&move->threads[i], NULL,
+			                                  ramd_endpoint_mover_main, arg) == 0;
+		}
+		if (!move->started[i])
+		{
+			/* No thread to spare: run it here rather than not at all */
+			free(arg);
+			move->ok[i] = g_endpoint_movers[i].move(target);
+		}
+	}
+}
+
+bool
+ramd_endpoint_move_finish(ramd_endpoint_move_t* move)
+{
+	bool ok = true;
+
+	if (!move)
+		return true;
+
+	for (int32_t i = 0; i < RAMD_ENDPOINT_MOVER_COUNT; i++)
+	{
+		if (move->started[i])
+			pthread_join(move->threads[i], NULL);
+		move->started[i] = false;
+		ok = ok && move->ok[i];
+	}
+	return ok;
+}
+
+/* Watch subscriber; runs under the feed lock, so only flags the reconciler */
+static void
+ramd_endpoint_wake(const ramd_watch_event_t* events, int32_t count, void* arg)
+{
+	bool relevant = false;
+
+	(void) arg;
+	for (int32_t i = 0; i < count && !relevant; i++)
+		relevant = events[i].type == RAMD_WATCH_EVENT_MEMBERSHIP ||
+		           events[i].type == RAMD_WATCH_EVENT_NODE_ROLE ||
+		           events[i].type == RAMD_WATCH_EVENT_NODE_STATE ||
+		           events[i].type == RAMD_WATCH_EVENT_NODE_HEALTH ||
+		           events[i].type == RAMD_WATCH_EVENT_PRIMARY;
+	if (!relevant)
+		return;
+
+	pthread_mutex_lock(&g_endpoint.lock);
+	g_endpoint.pending = true;
+	pthread_cond_signal(&g_endpoint.cond);
+	pthread_mutex_unlock(&g_endpoint.lock);
+}
+
+/*
+ * Hold the VIP while the local node is the healthy primary.  Give it up
+ * only on evidence that someone else should have it, a standby role or
+ * another primary, never because the view is momentarily empty.
+ */
+static void
+ramd_endpoint_reconcile(const ramd_config_t* config)
+{
+	ramd_watch_snapshot_t view;
+	const ramd_watch_node_t* self = NULL;
+
+	ramd_watch_get(&view);
+	for (int32_t i = 0; i < view.node_count; i++)
+	{
+		if (view.nodes[i].node_id == config->node_id)
+		{
+			self = &view.nodes[i];
+			break;
+		}
+	}
+	if (!self)
+		return;
+
+	if (self->is_primary && self->is_healthy)
+		(void) ramd_endpoint_vip_set(config->endpoint_vip, config->endpoint_vip_interface, true);
+	else if (self->role == RAMD_ROLE_STANDBY ||
+	         (view.primary_node_id > 0 && view.primary_node_id != self->node_id))
+		(void) ramd_endpoint_vip_set(config->endpoint_vip, config->endpoint_vip_interface, false);
+}
+
+static void*
+ramd_endpoint_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_endpoint.lock);
+	while (g_endpoint.running)
+	{
+		struct timespec deadline;
+
+		if (!g_endpoint.pending)
+		{
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += RAMD_ENDPOINT_RECONCILE_INTERVAL_MS / 1000;
+			pthread_cond_timedwait(&g_endpoint.cond, &g_endpoint.lock, &deadline);
+			if (!g_endpoint.running)
+				break;
+		}
+		g_endpoint.pending = false;
+
+		/* Never read the feed with our lock held: its subscriber takes it */
+		pthread_mutex_unlock(&g_endpoint.lock);
+		ramd_endpoint_reconcile(g_endpoint.config);
+		pthread_mutex_lock(&g_endpoint.lock);
+	}
+	pthread_mutex_unlock(&g_endpoint.lock);
+	return NULL;
+}
+
+bool
+ramd_endpoint_start(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+	if (config->endpoint_vip[0] == '\0')
+		return true;
+
+	pthread_mutex_lock(&g_endpoint.lock);
+	if (g_endpoint.running)
+	{
+		pthread_mutex_unlock(&g_endpoint.lock);
+		return true;
+	}
+	g_endpoint.config = config;
+	g_endpoint.running = true;
+	g_endpoint.pending = true;
+	if (pthread_create(&g_endpoint.thread, NULL, ramd_endpoint_thread_main, NULL) != 0)
+	{
+		g_endpoint.running = false;
+		pthread_mutex_unlock(&g_endpoint.lock);
+		ramd_log_error("Endpoint: failed to create thread");
+		return false;
+	}
+	pthread_mutex_unlock(&g_endpoint.lock);
+
+	if (!ramd_watch_subscribe(ramd_endpoint_wake, NULL))
+		ramd_log_warning("Endpoint: watch feed full, the VIP follows role changes "
+		                 "every %d ms only", RAMD_ENDPOINT_RECONCILE_INTERVAL_MS);
+
+	ramd_log_info("Endpoint: keeping %s on %s while this node is primary",
+	              config->endpoint_vip, config->endpoint_vip_interface);
+	return true;
+}
+
+void
+ramd_endpoint_stop(void)
+{
+	pthread_mutex_lock(&g_endpoint.lock);
+	if (!g_endpoint.running)
+	{
+		pthread_mutex_unlock(&g_endpoint.lock);
+		return;
+	}
+	g_endpoint.running = false;
+	pthread_cond_broadcast(&g_endpoint.cond);
+	pthread_mutex_unlock(&g_endpoint.lock);
+
+	ramd_watch_unsubscribe(ramd_endpoint_wake, NULL);
+	pthread_join(g_endpoint.thread, NULL);
+}
@@ -9,6 +9,7 @@
  */
 
 #include "ramd_failover.h"
+#include "ramd_failover_trace.h"
 #include "ramd_logging.h"
 #include "ramd_postgresql.h"
 #include "ramd_cluster.h"
@@ -16,6 +17,20 @@
 #include "ramd_basebackup.h"
 #include "ramd_conn.h"
 #include "ramd_query.h"
+#include "ramd_probe.h"
+#include "ramd_daemon.h"
+#include "ramd_detector.h"
+#include "ramd_clock.h"
+#include "ramd_endpoint.h"
+#include "ramd_fencing.h"
+#include "ramd_metrics.h"
+#include "ramd_process.h"
+#include "ramd_lag.h"
+#include "ramd_rebuild.h"
+#include "ramd_registry.h"
+#include "ramd_slots.h"
+#include "ramd_switchover.h"
+#include "ramd_sysmon.h"
 
 #include <libpq-fe.h>
 
@@ -66,14 +81,32 @@ ramd_failover_should_trigger(const ramd_cluster_t* cluster,
 	if (cluster->node_count == 1)
 		return false;
 
-	return ramd_failover_detect_primary_failure((ramd_cluster_t*) cluster) &&
+	/* The primary is down on purpose while a switchover promotes its successor */
+	if (ramd_switchover_in_progress())
+		return false;
+
+	return ramd_failover_detect_primary_failure((ramd_cluster_t*) cluster, config) &&
 	       ramd_cluster_has_quorum(cluster);
 }
 
+/* Mark the failover failed and close its trace */
+static bool
+ramd_failover_abort(const ramd_config_t* config, ramd_failover_context_t* context)
+{
+	context->state = RAMD_FAILOVER_STATE_FAILED;
+	ramd_failover_trace_end(false, config->failover_trace_file, config->node_id);
+	return false;
+}
+
 bool
 ramd_failover_execute(ramd_cluster_t* cluster, const ramd_config_t* config,
                            ramd_failover_context_t* context)
 {
+	ramd_endpoint_move_t move;
+	uint64_t trace;
+	int32_t span;
+	bool ok;
+
 	if (!cluster || !config || !context)
 		return false;
 
@@ -83,14 +116,30 @@ ramd_failover_execute(ramd_cluster_t* cluster, const ramd_config_t* config,
 
 	context->state = RAMD_FAILOVER_STATE_DETECTING;
 	context->started_at = time(NULL);
-
-	if (!ramd_failover_select_new_primary(cluster,
-	                                      &context->new_primary_node_id))
+	context->started_ms = ramd_clock_now_ms();
+	context->failed_node_id = cluster->primary_node_id;
+	trace = ramd_failover_trace_begin(context->failed_node_id, context->auto_triggered);
+
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_SELECT, -1);
+	ok = ramd_failover_select_new_primary(cluster, &context->new_primary_node_id);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
 	{
 		ramd_log_error("Critical error: Unable to identify suitable candidate "
 		               "for primary node promotion");
-		context->state = RAMD_FAILOVER_STATE_FAILED;
-		return false;
+		return ramd_failover_abort(config, context);
+	}
+	ramd_failover_trace_set_new_primary(context->new_primary_node_id);
+
+	/* The old primary may still be up behind a partition; outlast its lease */
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_VALIDATE, cluster->primary_node_id);
+	ok = ramd_fencing_wait_expired(cluster->primary_node_id, config->fencing_lease_ms * 2);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
+	{
+		ramd_log_error("Failover postponed: node %d may still accept writes",
+		               cluster->primary_node_id);
+		return ramd_failover_abort(config, context);
 	}
 
 	context->state = RAMD_FAILOVER_STATE_PROMOTING;
@@ -100,28 +149,62 @@ ramd_failover_execute(ramd_cluster_t* cluster, const ramd_config_t* config,
 		ramd_log_error("Primary promotion failed: Unable to promote node %d to "
 		               "primary role",
 		               context->new_primary_node_id);
-		context->state = RAMD_FAILOVER_STATE_FAILED;
-		return false;
+		return ramd_failover_abort(config, context);
 	}
+	(void) ramd_fencing_hand_over(context->new_primary_node_id);
 
+	/* Clients follow the new primary while the standbys are repointed */
+	ramd_endpoint_move_begin(&move, config,
+	                         ramd_cluster_find_node(cluster, context->new_primary_node_id));
+
+	/* If the old primary comes back it does so as a new standby */
+	ramd_detector_forget(cluster->primary_node_id);
 	cluster->primary_node_id = context->new_primary_node_id;
+
+	context->state = RAMD_FAILOVER_STATE_RECOVERING;
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_REPOINT, -1);
+	ok = ramd_failover_update_standby_nodes(cluster, config, context->new_primary_node_id);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
+		ramd_log_warning("Some standbys still follow the old primary");
+	if (!ramd_endpoint_move_finish(&move))
+		ramd_log_warning("Some clients may still be sent to the old primary");
+
+	/* Only queues the rebuild; the scheduler runs it in the background */
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_REBUILD, -1);
+	ok = ramd_failover_rebuild_failed_replicas(cluster, config);
+	ramd_failover_trace_span_end(span, ok);
+
 	context->state = RAMD_FAILOVER_STATE_COMPLETED;
 	context->completed_at = time(NULL);
+	ramd_registry_note_failover(context->failed_node_id, context->new_primary_node_id);
+	ramd_metrics_increment_failovers(g_ramd_metrics);
+	ramd_failover_trace_end(true, config->failover_trace_file, config->node_id);
 
-	ramd_log_info("Automated failover procedure completed successfully: Node "
-	              "%d has been promoted to primary role",
-	              context->new_primary_node_id);
+	{
+		ramd_log_field_t fields[] = {
+			RAMD_LOG_INT("new_primary", context->new_primary_node_id),
+			RAMD_LOG_INT("duration_ms", ramd_clock_now_ms() - context->started_ms),
+			RAMD_LOG_INT("trace", (int64_t) trace),
+		};
+
+		RAMD_LOG_KV(INFO, fields,
+		            "Automated failover procedure completed successfully: Node "
+		            "%d has been promoted to primary role",
+		            context->new_primary_node_id);
+	}
 	return true;
 }
 
 bool
-ramd_failover_detect_primary_failure(ramd_cluster_t* cluster)
+ramd_failover_detect_primary_failure(ramd_cluster_t* cluster, const ramd_config_t* config)
 {
 	ramd_node_t* primary;
 	ramd_postgresql_connection_t conn;
+	ramd_detector_stats_t stats;
 	bool primary_accessible = false;
 
-	if (!cluster)
+	if (!cluster || !config)
 		return false;
 
 	primary = ramd_cluster_get_primary_node(cluster);
@@ -145,53 +228,182 @@ ramd_failover_detect_primary_failure(ramd_cluster_t* cluster)
 		ramd_postgresql_disconnect(&conn);
 	}
 
-	if (!primary_accessible)
-	{
-		ramd_log_warning("Primary node failure confirmed: Node %d (%s) is "
-		                 "unresponsive and cannot accept connections",
-		                 primary->node_id, primary->hostname);
+	/* One missed probe is only evidence; the detector weighs it against history */
+	if (primary_accessible)
+		ramd_detector_heartbeat(primary->node_id, RAMD_DETECTOR_POSTGRESQL);
+	if (ramd_detector_check(primary->node_id, config, &stats) != RAMD_DETECTOR_FAILED)
+		return false;
+
+	ramd_failover_trace_note_detection(primary->node_id,
+	                                   stats.since_last_ms[RAMD_DETECTOR_POSTGRESQL]);
+	ramd_log_warning("Primary node failure confirmed: Node %d (%s) has not answered "
+	                 "for %lld ms (phi %.1f)",
+	                 primary->node_id, primary->hostname,
+	                 (long long) stats.since_last_ms[RAMD_DETECTOR_POSTGRESQL],
+	                 stats.phi[RAMD_DETECTOR_POSTGRESQL]);
+	return true;
+}
+
+/*
+ * The furthest LSN wins, except that a standby whose host is saturated
+ * loses to one that is not and is behind by at most
+ * failover_saturated_max_lag_mb: promoting a node that cannot keep up with
+ * its own disk trades a little WAL for an outage of another kind.  On a
+ * tie, prefer the standby that the lag sampler last saw applying WAL
+ * fastest: lower smoothed replay lag, then lower p99.
+ */
+bool
+ramd_failover_candidate_is_better(int64_t lsn, int32_t load, const ramd_node_t* node,
+                                  int64_t best_lsn, int32_t best_load,
+                                  const ramd_node_t* best)
+{
+	ramd_lag_stats_t mine;
+	ramd_lag_stats_t theirs;
+	bool saturated = ramd_sysmon_load_is_saturated(load);
+	int64_t window;
+
+	if (!best)
 		return true;
+
+	if (saturated != ramd_sysmon_load_is_saturated(best_load))
+	{
+		window = (int64_t) g_ramd_daemon->config.failover_saturated_max_lag_mb * 1024 * 1024;
+		if (saturated)
+			return lsn > best_lsn + window;
+		return lsn >= best_lsn - window;
 	}
 
-	return false;
+	if (lsn > best_lsn)
+		return true;
+	if (lsn < best_lsn)
+		return false;
+
+	if (!ramd_lag_get_stats(node->node_id, &mine) || mine.ewma_replay_lag_ms < 0)
+		return false;
+	if (!ramd_lag_get_stats(best->node_id, &theirs) || theirs.ewma_replay_lag_ms < 0)
+		return true;
+
+	if (mine.ewma_replay_lag_ms != theirs.ewma_replay_lag_ms)
+		return mine.ewma_replay_lag_ms < theirs.ewma_replay_lag_ms;
+	return mine.p99_replay_lag_ms < theirs.p99_replay_lag_ms;
 }
 
+/*
+ * Pick the healthy standby with the most WAL.
+ *
+ * Standbys the monitor sampled within the last
+ * RAMD_FAILOVER_LSN_SAMPLE_MAX_AGE_MS are ranked from that sample.  The rest
+ * are queried concurrently, and the query stops as soon as a majority of all
+ * candidates has answered, so a dead standby never delays the decision.  If
+ * no majority answers by RAMD_FAILOVER_PROBE_DEADLINE_MS, no standby is
+ * chosen.
+ */
 bool
 ramd_failover_select_new_primary(const ramd_cluster_t* cluster,
                                       int32_t* new_primary_id)
 {
-	ramd_node_t* best_candidate = NULL;
-	int64_t highest_wal_lsn = 0;
-	int i;
+	const ramd_node_t*       best_candidate = NULL;
+	const ramd_probe_target_t* target;
+	ramd_postgresql_status_t status;
+	ramd_probe_engine_t*     engine;
+	ramd_cluster_t*          unsampled;
+	int64_t                  highest_wal_lsn = -1;
+	int32_t                  best_load = -1;
+	int32_t                  candidates = 0;
+	int32_t                  answered = 0;
+	int32_t                  quorum;
+	int                      i;
 
 	if (!cluster || !new_primary_id)
 		return false;
 
-	for (i = 0; i < cluster->node_count; i++)
+	if (!g_ramd_daemon)
 	{
-		const ramd_node_t* node;
-		ramd_postgresql_connection_t conn;
+		ramd_log_error("Primary candidate selection failed: daemon not initialized");
+		return false;
+	}
 
-		node = &cluster->nodes[i];
+	unsampled = calloc(1, sizeof(ramd_cluster_t));
+	if (!unsampled)
+		return false;
 
-		if (node->role != RAMD_ROLE_STANDBY || !node->is_healthy)
+	for (i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+
+		/* A learner could not take over Raft leadership, and the lease with it */
+		if (node->role != RAMD_ROLE_STANDBY || !node->is_healthy || !node->is_voter)
+			continue;
+		/* Even if the maintenance was started through another daemon */
+		if (ramd_registry_node_in_maintenance(node->node_id))
 			continue;
 
-		if (ramd_postgresql_connect(&conn, node->hostname,
-		                            node->postgresql_port, "postgres",
-		                            "postgres", ""))
+		candidates++;
+		if (ramd_probe_get_sample(&g_ramd_daemon->monitor.probes, node->node_id,
+		                          RAMD_FAILOVER_LSN_SAMPLE_MAX_AGE_MS, &status) &&
+		    status.is_in_recovery)
+		{
+			answered++;
+			if (ramd_failover_candidate_is_better(status.current_wal_lsn, status.host_load,
+			                                      node, highest_wal_lsn, best_load,
+			                                      best_candidate))
+			{
+				highest_wal_lsn = status.current_wal_lsn;
+				best_load = status.host_load;
+				best_candidate = node;
+			}
+		}
+		else
+			unsampled->nodes[unsampled->node_count++] = *node;
+	}
+
+	quorum = candidates / 2 + 1;
+
+	if (unsampled->node_count > 0 && answered < quorum)
+	{
+		engine = malloc(sizeof(ramd_probe_engine_t));
+		if (engine && ramd_probe_init(engine, &g_ramd_daemon->config))
 		{
-			ramd_postgresql_status_t status;
-			if (ramd_postgresql_get_status(&conn, &status))
+			ramd_probe_run_quorum(engine, unsampled, -1,
+			                      RAMD_FAILOVER_PROBE_DEADLINE_MS,
+			                      quorum - answered);
+
+			for (i = 0; i < unsampled->node_count; i++)
 			{
-				if (status.current_wal_lsn > highest_wal_lsn)
+				target = ramd_probe_find(engine, unsampled->nodes[i].node_id);
+				if (!target || !target->healthy || !target->status.is_in_recovery)
+					continue;
+
+				answered++;
+				if (ramd_failover_candidate_is_better(target->status.current_wal_lsn,
+				                                      target->status.host_load,
+				                                      &unsampled->nodes[i],
+				                                      highest_wal_lsn, best_load,
+				                                      best_candidate))
 				{
-					highest_wal_lsn = status.current_wal_lsn;
-					best_candidate = (ramd_node_t*) node;
+					highest_wal_lsn = target->status.current_wal_lsn;
+					best_load = target->status.host_load;
+					best_candidate = ramd_cluster_find_node((ramd_cluster_t*) cluster,
+					                                        target->node_id);
 				}
 			}
-			ramd_postgresql_disconnect(&conn);
+			ramd_probe_cleanup(engine);
 		}
+		free(engine);
+	}
+	free(unsampled);
+
+	/*
+	 * Without a majority the most advanced standby may be among those that
+	 * did not answer; promoting the best of the rest could lose commits it
+	 * has.  Give up this round and let the next one ask again.
+	 */
+	if (candidates > 0 && answered < quorum)
+	{
+		ramd_log_error("Primary candidate selection: only %d of %d standbys answered "
+		               "within %d ms, not choosing without a majority",
+		               answered, candidates, RAMD_FAILOVER_PROBE_DEADLINE_MS);
+		return false;
 	}
 
 	if (best_candidate)
@@ -208,12 +420,57 @@ ramd_failover_select_new_primary(const ramd_cluster_t* cluster,
 	return false;
 }
 
+/*
+ * The local node is promoted over the monitor's open session (pg_ctl as the
+ * fallback); a remote one over a fresh SQL session, since pg_ctl cannot
+ * reach it.
+ */
+static bool
+ramd_failover_promote_postgresql(const ramd_config_t* config, const ramd_node_t* node)
+{
+	PGconn* conn;
+	bool sql_available = false;
+	bool promoted;
+	int64_t started;
+
+	if (node->node_id == config->node_id)
+	{
+		if (g_ramd_daemon && g_ramd_daemon->monitor.config)
+			return ramd_monitor_promote_local(&g_ramd_daemon->monitor);
+		return ramd_postgresql_promote(config);
+	}
+
+	conn = ramd_conn_get(node->hostname, node->postgresql_port, config->database_name,
+	                     config->database_user, config->database_password);
+	if (!conn)
+	{
+		ramd_log_error("Cannot connect to node %d (%s:%d) to promote it", node->node_id,
+		               node->hostname, node->postgresql_port);
+		return false;
+	}
+
+	started = ramd_clock_now_us();
+	promoted = ramd_postgresql_promote_sql(conn, RAMD_PROMOTE_WAIT_SECONDS, &sql_available);
+	ramd_conn_close(conn);
+
+	if (promoted)
+	{
+		ramd_metrics_observe_promotion(g_ramd_metrics, ramd_clock_now_us() - started, true);
+	}
+	else if (!sql_available)
+		ramd_log_error("Node %d cannot be promoted over SQL (needs PostgreSQL 12+ and "
+		               "EXECUTE on pg_promote)", node->node_id);
+	return promoted;
+}
+
 bool
 ramd_failover_promote_node(ramd_cluster_t* cluster,
                                 const ramd_config_t* config, int32_t node_id)
 {
 	ramd_node_t* node;
 	bool promotion_success;
+	int32_t span;
+	bool ok;
 
 	if (!cluster || !config)
 		return false;
@@ -231,30 +488,35 @@ ramd_failover_promote_node(ramd_cluster_t* cluster,
 	              "promoted to primary role",
 	              node_id, node->hostname);
 
-	if (!ramd_failover_stop_replication_on_node(config, node_id))
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_STOP_REPLICATION, node_id);
+	ok = ramd_failover_stop_replication_on_node(config, node_id);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
 	{
 		ramd_log_warning(
 		    "Failed to stop replication on node %d, continuing with promotion",
 		    node_id);
 	}
 
-	promotion_success = ramd_postgresql_promote(config);
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_PROMOTE, node_id);
+	promotion_success = ramd_failover_promote_postgresql(config, node);
 
 	if (!promotion_success)
 	{
+		ramd_failover_trace_span_end(span, false);
 		ramd_log_error("PostgreSQL promotion failure: Unable to promote "
 		               "PostgreSQL instance on node %d",
 		               node_id);
 		return false;
 	}
 
+	/* Both paths wait for the end of recovery, so there is nothing to sleep off */
 	node->role = RAMD_ROLE_PRIMARY;
 	cluster->primary_node_id = node_id;
 
-	ramd_log_info("Waiting for PostgreSQL promotion to complete...");
-	sleep(RAMD_FAILOVER_SLEEP_SECONDS);
-
-	if (!ramd_failover_validate_promotion(cluster, node_id))
+	ok = ramd_failover_validate_promotion(cluster, node_id);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
 	{
 		ramd_log_error("Promotion validation failure: Node %d promotion could "
 		               "not be verified as successful",
@@ -262,12 +524,16 @@ ramd_failover_promote_node(ramd_cluster_t* cluster,
 		return false;
 	}
 
-	if (!ramd_failover_update_sync_replication_config(cluster, node_id))
+	span = ramd_failover_trace_span_start(RAMD_FAILOVER_PHASE_SYNC_CONFIG, node_id);
+	ok = ramd_failover_update_sync_replication_config(cluster, node_id);
+	ramd_failover_trace_span_end(span, ok);
+	if (!ok)
 	{
 		ramd_log_warning("Failed to update synchronous replication "
 		                 "configuration, continuing");
 	}
 
+	ramd_metrics_increment_promotions(g_ramd_metrics);
 	ramd_log_info("Primary promotion completed successfully: Node %d is now "
 	              "operational as the primary database server",
 	              node_id);
@@ -413,44 +679,41 @@ bool
 ramd_failover_rebuild_failed_replicas(ramd_cluster_t* cluster,
                                            const ramd_config_t* config)
 {
-	int rebuilt_count = 0;
+	ramd_node_t* local;
+	ramd_node_t* primary;
+	int32_t remote_count = 0;
 	int i;
 
 	if (!cluster || !config)
 		return false;
 
-	ramd_log_info("Starting automatic rebuild of failed replica nodes");
-
 	for (i = 0; i < cluster->node_count; i++)
 	{
 		ramd_node_t* node = &cluster->nodes[i];
 
-		if (node->state == RAMD_NODE_STATE_FAILED &&
+		if (node->node_id != config->node_id &&
+		    node->state == RAMD_NODE_STATE_FAILED &&
 		    node->role == RAMD_ROLE_STANDBY)
-		{
-			ramd_log_info("Rebuilding failed replica node %d (%s)",
-			              node->node_id, node->hostname);
+			remote_count++;
+	}
+	if (remote_count > 0)
+		ramd_log_info("%d failed remote replicas will be rebuilt by their own daemons",
+		              remote_count);
 
-			if (ramd_failover_rebuild_replica_node(cluster, config,
-			                                       node->node_id))
-			{
-				node->state = RAMD_NODE_STATE_UNKNOWN;
-				node->is_healthy = true;
-				rebuilt_count++;
-				ramd_log_info("Successfully rebuilt replica node %d",
-				              node->node_id);
-			}
-			else
-			{
-				ramd_log_error("Failed to rebuild replica node %d",
-				               node->node_id);
-			}
-		}
+	local = ramd_cluster_find_node(cluster, config->node_id);
+	if (!local || local->state != RAMD_NODE_STATE_FAILED ||
+	    local->role != RAMD_ROLE_STANDBY)
+		return remote_count == 0;
+
+	primary = ramd_cluster_get_primary_node(cluster);
+	if (!primary)
+	{
+		ramd_log_error("Cannot rebuild replica: No primary node available");
+		return false;
 	}
 
-	ramd_log_info("Replica rebuild completed: %d nodes rebuilt successfully",
-	              rebuilt_count);
-	return rebuilt_count > 0;
+	/* The scheduler queues behind other rebuilding standbys; don't block here */
+	return ramd_rebuild_start(cluster, primary->node_id);
 }
 
 bool
@@ -460,10 +723,6 @@ ramd_failover_rebuild_replica_node(ramd_cluster_t* cluster,
 {
 	ramd_node_t* node;
 	ramd_node_t* primary;
-	char rm_cmd[RAMD_MAX_COMMAND_LENGTH];
-	ramd_postgresql_connection_t conn;
-	PGresult* res;
-	bool is_recovering;
 
 	if (!cluster || !config)
 		return false;
@@ -472,6 +731,13 @@ ramd_failover_rebuild_replica_node(ramd_cluster_t* cluster,
 	if (!node)
 		return false;
 
+	if (node_id != config->node_id)
+	{
+		ramd_log_error("Cannot rebuild node %d: only the local data directory "
+		               "can be rebuilt, node %d must rebuild itself", node_id, node_id);
+		return false;
+	}
+
 	primary = ramd_cluster_get_primary_node(cluster);
 	if (!primary)
 	{
@@ -482,65 +748,16 @@ ramd_failover_rebuild_replica_node(ramd_cluster_t* cluster,
 	ramd_log_info("Rebuilding replica node %d from primary %d", node_id,
 	              primary->node_id);
 
-	if (!ramd_postgresql_stop(config))
-	{
-		ramd_log_warning(
-		    "Could not stop PostgreSQL on node %d, continuing with rebuild",
-		    node_id);
-	}
-
-	snprintf(rm_cmd, sizeof(rm_cmd), "rm -rf %s/*",
-	         config->postgresql_data_dir);
-	if (system(rm_cmd) != 0)
-	{
-		ramd_log_warning("Could not clean data directory on node %d", node_id);
-	}
-
-	if (!ramd_failover_take_basebackup(config, primary->hostname,
-	                                   primary->postgresql_port))
-	{
-		ramd_log_error("Failed to take base backup for node %d", node_id);
-		return false;
-	}
-
-	if (!ramd_failover_configure_recovery(config, primary->hostname,
-	                                      primary->postgresql_port))
+	if (!ramd_rebuild_start(cluster, primary->node_id) || !ramd_rebuild_wait())
 	{
-		ramd_log_error("Failed to configure recovery for node %d", node_id);
+		ramd_log_error("Replica node %d is not replicating after rebuild", node_id);
 		return false;
 	}
 
-	if (!ramd_postgresql_start(config))
-	{
-		ramd_log_error("Failed to start PostgreSQL on rebuilt node %d",
-		               node_id);
-		return false;
-	}
-
-	sleep(RAMD_FAILOVER_VALIDATION_SLEEP_SECONDS);
-
-	if (ramd_postgresql_connect(&conn, node->hostname, node->postgresql_port,
-	                            "postgres", "postgres", ""))
-	{
-		res = ramd_query_exec_with_result((PGconn*) conn.connection, "SELECT pg_is_in_recovery()");
-		if (res && PQntuples(res) > 0)
-		{
-			is_recovering = (strcmp(PQgetvalue(res, 0, 0), "t") == 0);
-			PQclear(res);
-
-			if (is_recovering)
-			{
-				ramd_log_info("Replica node %d is successfully replicating",
-				              node_id);
-				ramd_postgresql_disconnect(&conn);
-				return true;
-			}
-		}
-		ramd_postgresql_disconnect(&conn);
-	}
-
-	ramd_log_error("Replica node %d is not replicating after rebuild", node_id);
-	return false;
+	node->state = RAMD_NODE_STATE_UNKNOWN;
+	node->is_healthy = true;
+	ramd_log_info("Replica node %d is successfully replicating", node_id);
+	return true;
 }
 
 bool
@@ -560,11 +777,25 @@ ramd_failover_demote_failed_primary(ramd_cluster_t* cluster,
 	ramd_log_info("Demoting failed primary node %d (%s)", failed_node_id,
 	              failed_node->hostname);
 
-	ramd_postgresql_stop(config);
+	/* A remote primary cannot be stopped from here, but it fences itself */
+	if (failed_node_id != config->node_id)
+	{
+		if (!config->fencing_enabled)
+		{
+			ramd_log_error("Cannot demote remote node %d: fencing_enabled is off",
+			               failed_node_id);
+			return false;
+		}
+		if (!ramd_fencing_wait_expired(failed_node_id, config->fencing_lease_ms * 2))
+			return false;
+	}
+	else
+		ramd_postgresql_stop(config);
 
 	failed_node->role = RAMD_ROLE_STANDBY;
 	failed_node->state = RAMD_NODE_STATE_FAILED;
 	failed_node->is_healthy = false;
+	ramd_metrics_increment_demotions(g_ramd_metrics);
 
 	return true;
 }
@@ -575,6 +806,11 @@ ramd_failover_update_standby_nodes(ramd_cluster_t* cluster,
                                         int32_t new_primary_id)
 {
 	ramd_node_t* new_primary;
+	PGconn* conn;
+	char slot_name[64] = "";
+	bool needs_restart;
+	bool repointed;
+	bool all_ok = true;
 	int i;
 
 	if (!cluster || !config)
@@ -590,23 +826,57 @@ ramd_failover_update_standby_nodes(ramd_cluster_t* cluster,
 	for (i = 0; i < cluster->node_count; i++)
 	{
 		ramd_node_t* node = &cluster->nodes[i];
+		bool local = node->node_id == config->node_id;
 
 		if (node->node_id == new_primary_id ||
-		    node->state == RAMD_NODE_STATE_FAILED)
+		    node->state == RAMD_NODE_STATE_FAILED ||
+		    node->role != RAMD_ROLE_STANDBY)
 			continue;
 
-		if (node->role == RAMD_ROLE_STANDBY)
+		/* Online where the server allows it, so the standby keeps its cache */
+		needs_restart = false;
+		if (config->replication_slots_enabled)
+			ramd_slots_name(node->node_id, slot_name, sizeof(slot_name));
+		conn = ramd_conn_get(node->hostname, node->postgresql_port,
+		                     config->database_name, config->database_user,
+		                     config->database_password);
+		repointed = conn && ramd_postgresql_repoint_standby(conn, config,
+		                                                     new_primary->hostname,
+		                                                     new_primary->postgresql_port,
+		                                                     node->node_id,
+		                                                     config->replication_slots_enabled
+		                                                         ? slot_name : NULL,
+		                                                     &needs_restart);
+		ramd_conn_close(conn);
+
+		if (repointed && !needs_restart)
 		{
-			ramd_log_info(
-			    "Reconfiguring standby node %d to replicate from new primary",
-			    node->node_id);
+			ramd_log_info("Standby node %d now follows node %d without a restart",
+			              node->node_id, new_primary_id);
+			continue;
+		}
 
-			ramd_postgresql_setup_replication(config, new_primary->hostname,
-			                                  new_primary->postgresql_port);
+		/* Only this node's server can be restarted or have its files rewritten */
+		if (local)
+		{
+			if (!repointed && !ramd_postgresql_create_recovery_conf(
+			                      config, new_primary->hostname,
+			                      new_primary->postgresql_port))
+				all_ok = false;
+			else if (!ramd_postgresql_restart(config))
+				all_ok = false;
+			continue;
 		}
+
+		ramd_log_warning("Standby node %d %s; its daemon or an operator must "
+		                 "restart it to follow node %d", node->node_id,
+		                 repointed ? "needs a restart to apply primary_conninfo"
+		                           : "could not be repointed over SQL",
+		                 new_primary_id);
+		all_ok = false;
 	}
 
-	return true;
+	return all_ok;
 }
 
 bool
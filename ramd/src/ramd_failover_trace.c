@@ -0,0 +1,561 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_failover_trace.c
+ *		PostgreSQL Auto-Failover Daemon - Per-Phase Failover Tracing
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Each failover is recorded as a trace of timed spans, one per step, with
+ * microsecond monotonic timestamps, so a post-incident review can say
+ * where the seconds went without lining up log lines.  The last
+ * RAMD_FAILOVER_TRACE_HISTORY traces stay in a ring for the HTTP API, and
+ * every finished span also lands in a per-phase Prometheus histogram.
+ * Failovers are rare, so a single mutex guards all of it.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramd_failover_trace.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+typedef struct ramd_failover_trace_ring_t
+{
+	pthread_mutex_t lock; /* guards everything below */
+	uint64_t next_sequence;
+	int32_t head;         /* slot the next trace is written to */
+	int32_t count;
+	ramd_failover_trace_t traces[RAMD_FAILOVER_TRACE_HISTORY];
+
+	/* The latest confirmed failure, until a trace for that node claims it */
+	int32_t detect_node_id;
+	int64_t detect_start_us;
+	int64_t detect_end_us;
+
+	/* Per-bucket (non-cumulative) counts; the last one is +Inf */
+	int64_t phase_buckets[RAMD_FAILOVER_PHASE_COUNT][RAMD_FAILOVER_TRACE_BUCKET_COUNT + 1];
+	int64_t phase_sum_us[RAMD_FAILOVER_PHASE_COUNT];
+	int64_t total_buckets[RAMD_FAILOVER_TRACE_BUCKET_COUNT + 1];
+	int64_t total_sum_us;
+} ramd_failover_trace_ring_t;
+
+static ramd_failover_trace_ring_t g_failover_traces = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.next_sequence = 1,
+	.detect_node_id = -1
+};
+
+/* Upper bounds of the duration buckets, in microseconds */
+static const int64_t g_failover_bucket_bounds_us[RAMD_FAILOVER_TRACE_BUCKET_COUNT] = {
+	1000, 5000, 10000, 50000, 100000, 250000, 500000,
+	1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+};
+
+/*
+ * The trace the calling thread opened.  The sequence is kept alongside
+ * because the ring may have reused the slot if the trace ran very long.
+ */
+static _Thread_local ramd_failover_trace_t* t_trace = NULL;
+static _Thread_local uint64_t t_sequence = 0;
+
+static uint64_t
+ramd_failover_trace_mix(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/* Called with the lock held */
+static ramd_failover_trace_t*
+ramd_failover_trace_current(void)
+{
+	if (!t_trace || t_trace->sequence != t_sequence)
+		return NULL;
+	return t_trace;
+}
+
+static int
+ramd_failover_trace_bucket(int64_t duration_us)
+{
+	int bucket;
+
+	for (bucket = 0; bucket < RAMD_FAILOVER_TRACE_BUCKET_COUNT; bucket++)
+		if (duration_us <= g_failover_bucket_bounds_us[bucket])
+			break;
+	return bucket;
+}
+
+const char*
+ramd_failover_phase_to_string(ramd_failover_phase_t phase)
+{
+	switch (phase)
+	{
+		case RAMD_FAILOVER_PHASE_DETECT:
+			return "detect";
+		case RAMD_FAILOVER_PHASE_VALIDATE:
+			return "validate";
+		case RAMD_FAILOVER_PHASE_SELECT:
+			return "select";
+		case RAMD_FAILOVER_PHASE_STOP_REPLICATION:
+			return "stop_replication";
+		case RAMD_FAILOVER_PHASE_PROMOTE:
+			return "promote";
+		case RAMD_FAILOVER_PHASE_SYNC_CONFIG:
+			return "sync_config";
+		case RAMD_FAILOVER_PHASE_REPOINT:
+			return "repoint";
+		case RAMD_FAILOVER_PHASE_ENDPOINT_VIP:
+			return "endpoint_vip";
+		case RAMD_FAILOVER_PHASE_ENDPOINT_COMMAND:
+			return "endpoint_command";
+		case RAMD_FAILOVER_PHASE_REBUILD:
+			return "rebuild";
+		case RAMD_FAILOVER_PHASE_COUNT:
+			break;
+	}
+	return "unknown";
+}
+
+void
+ramd_failover_trace_note_detection(int32_t node_id, int64_t silent_ms)
+{
+	int64_t now = ramd_clock_now_us();
+
+	if (silent_ms < 0)
+		silent_ms = 0;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	g_failover_traces.detect_node_id = node_id;
+	g_failover_traces.detect_start_us = now - silent_ms * 1000;
+	g_failover_traces.detect_end_us = now;
+	pthread_mutex_unlock(&g_failover_traces.lock);
+}
+
+uint64_t
+ramd_failover_trace_begin(int32_t failed_node_id, bool auto_triggered)
+{
+	ramd_failover_trace_t* trace;
+	struct timespec wall;
+	int64_t now = ramd_clock_now_us();
+	uint64_t seed;
+
+	clock_gettime(CLOCK_REALTIME, &wall);
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	trace = &g_failover_traces.traces[g_failover_traces.head];
+	g_failover_traces.head = (g_failover_traces.head + 1) % RAMD_FAILOVER_TRACE_HISTORY;
+	if (g_failover_traces.count < RAMD_FAILOVER_TRACE_HISTORY)
+		g_failover_traces.count++;
+
+	memset(trace, 0, sizeof(*trace));
+	trace->sequence = g_failover_traces.next_sequence++;
+	trace->start_us = now;
+	trace->wall_offset_us = (int64_t) wall.tv_sec * 1000000 + wall.tv_nsec / 1000 - now;
+	trace->failed_node_id = failed_node_id;
+	trace->new_primary_node_id = -1;
+	trace->auto_triggered = auto_triggered;
+
+	seed = (uint64_t) trace->wall_offset_us ^ ((uint64_t) getpid() << 32) ^ trace->sequence;
+	trace->trace_id[0] = ramd_failover_trace_mix(seed);
+	trace->trace_id[1] = ramd_failover_trace_mix(trace->trace_id[0]);
+
+	/* Time from the primary's last answer belongs to this failover too */
+	if (g_failover_traces.detect_node_id == failed_node_id &&
+	    g_failover_traces.detect_end_us > 0)
+	{
+		ramd_failover_span_t* span = &trace->spans[trace->span_count++];
+
+		span->phase = RAMD_FAILOVER_PHASE_DETECT;
+		span->node_id = failed_node_id;
+		span->start_us = g_failover_traces.detect_start_us;
+		span->end_us = g_failover_traces.detect_end_us;
+		span->ok = true;
+		trace->start_us = span->start_us;
+		g_failover_traces.detect_node_id = -1;
+		g_failover_traces.detect_end_us = 0;
+	}
+
+	t_trace = trace;
+	t_sequence = trace->sequence;
+	pthread_mutex_unlock(&g_failover_traces.lock);
+	return t_sequence;
+}
+
+int32_t
+ramd_failover_trace_span_start(ramd_failover_phase_t phase, int32_t node_id)
+{
+	ramd_failover_trace_t* trace;
+	int32_t span = -1;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	trace = ramd_failover_trace_current();
+	if (trace && trace->span_count < RAMD_FAILOVER_TRACE_MAX_SPANS)
+	{
+		span = trace->span_count++;
+		trace->spans[span].phase = phase;
+		trace->spans[span].node_id = node_id;
+		trace->spans[span].start_us = ramd_clock_now_us();
+		trace->spans[span].end_us = 0;
+		trace->spans[span].ok = false;
+	}
+	pthread_mutex_unlock(&g_failover_traces.lock);
+	return span;
+}
+
+void
+ramd_failover_trace_span_end(int32_t span, bool ok)
+{
+	ramd_failover_trace_t* trace;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	trace = ramd_failover_trace_current();
+	if (trace && span >= 0 && span < trace->span_count && trace->spans[span].end_us == 0)
+	{
+		trace->spans[span].end_us = ramd_clock_now_us();
+		trace->spans[span].ok = ok;
+	}
+	pthread_mutex_unlock(&g_failover_traces.lock);
+}
+
+void
+ramd_failover_trace_set_new_primary(int32_t node_id)
+{
+	ramd_failover_trace_t* trace;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	trace = ramd_failover_trace_current();
+	if (trace)
+		trace->new_primary_node_id = node_id;
+	pthread_mutex_unlock(&g_failover_traces.lock);
+}
+
+static bool
+ramd_failover_trace_file_flush(void* context, const char* data, size_t length)
+{
+	return fwrite(data, 1, length, (FILE*) context) == length;
+}
+
+static void
+ramd_failover_trace_export(const ramd_failover_trace_t* trace, const char* path,
+                           int32_t local_node_id)
+{
+	ram_json_writer_t w;
+	char buf[4096];
+	FILE* file;
+	bool ok;
+
+	file = fopen(path, "a");
+	if (!file)
+	{
+		ramd_log_warning("Cannot open failover trace file %s: %s", path, strerror(errno));
+		return;
+	}
+
+	ram_json_writer_init(&w, buf, sizeof(buf), ramd_failover_trace_file_flush, file);
+	ok = ramd_failover_trace_write_otlp(&w, trace, 1, local_node_id) &&
+	     ram_json_writer_finish(&w) && fputc('\n', file) != EOF;
+	if (fclose(file) != 0 || !ok)
+		ramd_log_warning("Cannot write failover trace %llu to %s",
+		                 (unsigned long long) trace->sequence, path);
+}
+
+void
+ramd_failover_trace_end(bool succeeded, const char* export_file, int32_t local_node_id)
+{
+	ramd_failover_trace_t* trace;
+	ramd_failover_trace_t finished;
+	int64_t now = ramd_clock_now_us();
+	int32_t i;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	trace = ramd_failover_trace_current();
+	if (!trace)
+	{
+		pthread_mutex_unlock(&g_failover_traces.lock);
+		return;
+	}
+
+	trace->end_us = now;
+	trace->succeeded = succeeded;
+	for (i = 0; i < trace->span_count; i++)
+	{
+		ramd_failover_span_t* span = &trace->spans[i];
+		int64_t duration_us;
+
+		/* A step left open was abandoned by an early return */
+		if (span->end_us == 0)
+			span->end_us = now;
+		duration_us = span->end_us - span->start_us;
+		g_failover_traces.phase_buckets[span->phase][ramd_failover_trace_bucket(duration_us)]++;
+		g_failover_traces.phase_sum_us[span->phase] += duration_us;
+	}
+	g_failover_traces.total_buckets[ramd_failover_trace_bucket(now - trace->start_us)]++;
+	g_failover_traces.total_sum_us += now - trace->start_us;
+
+	finished = *trace;
+	t_trace = NULL;
+	t_sequence = 0;
+	pthread_mutex_unlock(&g_failover_traces.lock);
+
+	if (export_file && export_file[0] != '\0')
+		ramd_failover_trace_export(&finished, export_file, local_node_id);
+}
+
+int32_t
+ramd_failover_trace_history(ramd_failover_trace_t* traces, int32_t max_count)
+{
+	int32_t count = 0;
+	int32_t slot;
+
+	if (!traces || max_count <= 0)
+		return 0;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	slot = g_failover_traces.head;
+	while (count < g_failover_traces.count && count < max_count)
+	{
+		slot = (slot + RAMD_FAILOVER_TRACE_HISTORY - 1) % RAMD_FAILOVER_TRACE_HISTORY;
+		traces[count++] = g_failover_traces.traces[slot];
+	}
+	pthread_mutex_unlock(&g_failover_traces.lock);
+	return count;
+}
+
+static bool
+ramd_failover_trace_render_histogram(ramd_buffer_t* output, const char* name,
+                                     const char* labels, const int64_t* buckets,
+                                     int64_t sum_us)
+{
+	int64_t cumulative = 0;
+	bool ok = true;
+	int i;
+
+	for (i = 0; i < RAMD_FAILOVER_TRACE_BUCKET_COUNT; i++)
+	{
+		cumulative += buckets[i];
+		ok &= ramd_buffer_appendf(output, "%s_bucket{%s%sle=\"%g\"} %lld\n", name, labels,
+		                          labels[0] ? "," : "",
+		                          (double) g_failover_bucket_bounds_us[i] / 1e6,
+		                          (long long) cumulative);
+	}
+	cumulative += buckets[RAMD_FAILOVER_TRACE_BUCKET_COUNT];
+	ok &= ramd_buffer_appendf(output, "%s_bucket{%s%sle=\"+Inf\"} %lld\n", name, labels,
+	                          labels[0] ? "," : "", (long long) cumulative);
+	ok &= ramd_buffer_appendf(output, "%s_sum%s%s%s %.6f\n%s_count%s%s%s %lld\n",
+	                          name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+	                          (double) sum_us / 1e6,
+	                          name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+	                          (long long) cumulative);
+	return ok;
+}
+
+bool
+ramd_failover_trace_render_prometheus(ramd_buffer_t* output)
+{
+	int64_t phase_buckets[RAMD_FAILOVER_PHASE_COUNT][RAMD_FAILOVER_TRACE_BUCKET_COUNT + 1];
+	int64_t phase_sum_us[RAMD_FAILOVER_PHASE_COUNT];
+	int64_t total_buckets[RAMD_FAILOVER_TRACE_BUCKET_COUNT + 1];
+	int64_t total_sum_us;
+	char labels[64];
+	bool ok = true;
+	int i;
+
+	if (!output)
+		return false;
+
+	pthread_mutex_lock(&g_failover_traces.lock);
+	memcpy(phase_buckets, g_failover_traces.phase_buckets, sizeof(phase_buckets));
+	memcpy(phase_sum_us, g_failover_traces.phase_sum_us, sizeof(phase_sum_us));
+	memcpy(total_buckets, g_failover_traces.total_buckets, sizeof(total_buckets));
+	total_sum_us = g_failover_traces.total_sum_us;
+	pthread_mutex_unlock(&g_failover_traces.lock);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_failover_phase_duration_seconds Time spent in each failover step\n"
+		"# TYPE ramd_failover_phase_duration_seconds histogram\n");
+	for (i = 0; i < RAMD_FAILOVER_PHASE_COUNT; i++)
+	{
+		snprintf(labels, sizeof(labels), "phase=\"%s\"",
+		         ramd_failover_phase_to_string((ramd_failover_phase_t) i));
+		ok &= ramd_failover_trace_render_histogram(output, "ramd_failover_phase_duration_seconds",
+		                                           labels, phase_buckets[i], phase_sum_us[i]);
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_failover_duration_seconds Failover time from the primary's last answer to the last step\n"
+		"# TYPE ramd_failover_duration_seconds histogram\n");
+	ok &= ramd_failover_trace_render_histogram(output, "ramd_failover_duration_seconds", "",
+	                                           total_buckets, total_sum_us);
+	return ok;
+}
+
+static bool
+ramd_failover_trace_hex(ram_json_writer_t* w, const uint64_t* words, int count)
+{
+	char hex[33];
+	int i;
+
+	for (i = 0; i < count; i++)
+		snprintf(hex + i * 16, sizeof(hex) - (size_t) i * 16, "%016llx",
+		         (unsigned long long) words[i]);
+	return ram_json_string(w, hex);
+}
+
+bool
+ramd_failover_trace_write_json(ram_json_writer_t* w, const ramd_failover_trace_t* trace)
+{
+	bool ok;
+	int32_t i;
+
+	ok = ram_json_object_begin(w) &&
+	     ram_json_kv_uint(w, "sequence", trace->sequence) &&
+	     ram_json_key(w, "trace_id") && ramd_failover_trace_hex(w, trace->trace_id, 2) &&
+	     ram_json_kv_string(w, "state", trace->end_us == 0 ? "running" :
+	                                    trace->succeeded ? "succeeded" : "failed") &&
+	     ram_json_kv_bool(w, "auto_triggered", trace->auto_triggered) &&
+	     ram_json_kv_int(w, "failed_node_id", trace->failed_node_id) &&
+	     ram_json_kv_int(w, "new_primary_node_id", trace->new_primary_node_id) &&
+	     ram_json_kv_int(w, "started_at_us", trace->start_us + trace->wall_offset_us) &&
+	     ram_json_kv_int(w, "duration_us",
+	                     trace->end_us == 0 ? -1 : trace->end_us - trace->start_us) &&
+	     ram_json_key(w, "phases") && ram_json_array_begin(w);
+
+	for (i = 0; ok && i < trace->span_count; i++)
+	{
+		const ramd_failover_span_t* span = &trace->spans[i];
+
+		ok = ram_json_object_begin(w) &&
+		     ram_json_kv_string(w, "phase", ramd_failover_phase_to_string(span->phase)) &&
+		     ram_json_kv_int(w, "node_id", span->node_id) &&
+		     ram_json_kv_int(w, "started_at_us", span->start_us + trace->wall_offset_us) &&
+		     ram_json_kv_int(w, "offset_us", span->start_us - trace->start_us) &&
+		     ram_json_kv_int(w, "duration_us",
+		                     span->end_us == 0 ? -1 : span->end_us - span->start_us) &&
+		     ram_json_kv_bool(w, "ok", span->ok) &&
+		     ram_json_object_end(w);
+	}
+	return ok && ram_json_array_end(w) && ram_json_object_end(w);
+}
+
+/* OTLP/JSON carries 64-bit integers as strings */
+static bool
+ramd_failover_trace_otlp_int(ram_json_writer_t* w, int64_t value)
+{
+	char text[24];
+
+	snprintf(text, sizeof(text), "%lld", (long long) value);
+	return ram_json_string(w, text);
+}
+
+static bool
+ramd_failover_trace_otlp_attr_int(ram_json_writer_t* w, const char* key, int64_t value)
+{
+	return ram_json_object_begin(w) && ram_json_kv_string(w, "key", key) &&
+	       ram_json_key(w, "value") && ram_json_object_begin(w) &&
+	       ram_json_key(w, "intValue") && ramd_failover_trace_otlp_int(w, value) &&
+	       ram_json_object_end(w) && ram_json_object_end(w);
+}
+
+static bool
+ramd_failover_trace_otlp_span(ram_json_writer_t* w, const ramd_failover_trace_t* trace,
+                              int32_t index)
+{
+	const ramd_failover_span_t* span = index >= 0 ? &trace->spans[index] : NULL;
+	uint64_t span_id = ramd_failover_trace_mix(trace->trace_id[1] + (uint64_t) (index + 1));
+	uint64_t root_id = ramd_failover_trace_mix(trace->trace_id[1]);
+	char name[48];
+	bool ok;
+
+	if (span)
+		snprintf(name, sizeof(name), "failover.%s", ramd_failover_phase_to_string(span->phase));
+	else
+		snprintf(name, sizeof(name), "failover");
+
+	ok = ram_json_object_begin(w) &&
+	     ram_json_key(w, "traceId") && ramd_failover_trace_hex(w, trace->trace_id, 2) &&
+	     ram_json_key(w, "spanId") && ramd_failover_trace_hex(w, span ? &span_id : &root_id, 1);
+	if (ok && span)
+		ok = ram_json_key(w, "parentSpanId") && ramd_failover_trace_hex(w, &root_id, 1);
+	ok = ok && ram_json_kv_string(w, "name", name) &&
+	     ram_json_kv_int(w, "kind", 1) &&
+	     ram_json_key(w, "startTimeUnixNano") &&
+	     ramd_failover_trace_otlp_int(w, ((span ? span->start_us : trace->start_us) +
+	                                      trace->wall_offset_us) * 1000) &&
+	     ram_json_key(w, "endTimeUnixNano") &&
+	     ramd_failover_trace_otlp_int(w, ((span ? span->end_us : trace->end_us) +
+	                                      trace->wall_offset_us) * 1000) &&
+	     ram_json_key(w, "attributes") && ram_json_array_begin(w);
+
+	if (ok && span && span->node_id >= 0)
+		ok = ramd_failover_trace_otlp_attr_int(w, "ramd.node_id", span->node_id);
+	if (ok && !span)
+		ok = ramd_failover_trace_otlp_attr_int(w, "ramd.failover.sequence",
+		                                       (int64_t) trace->sequence) &&
+		     ramd_failover_trace_otlp_attr_int(w, "ramd.failover.failed_node_id",
+		                                       trace->failed_node_id) &&
+		     ramd_failover_trace_otlp_attr_int(w, "ramd.failover.new_primary_node_id",
+		                                       trace->new_primary_node_id) &&
+		     ram_json_object_begin(w) &&
+		     ram_json_kv_string(w, "key", "ramd.failover.auto_triggered") &&
+		     ram_json_key(w, "value") && ram_json_object_begin(w) &&
+		     ram_json_kv_bool(w, "boolValue", trace->auto_triggered) &&
+		     ram_json_object_end(w) && ram_json_object_end(w);
+
+	/* STATUS_CODE_OK = 1, STATUS_CODE_ERROR = 2 */
+	return ok && ram_json_array_end(w) &&
+	       ram_json_key(w, "status") && ram_json_object_begin(w) &&
+	       ram_json_kv_int(w, "code", (span ? span->ok : trace->succeeded) ? 1 : 2) &&
+	       ram_json_object_end(w) && ram_json_object_end(w);
+}
+
+/*
+ * An ExportTraceServiceRequest: one root "failover" span per trace with a
+ * child span per step.  Traces still running are left out.
+ */
+bool
+ramd_failover_trace_write_otlp(ram_json_writer_t* w, const ramd_failover_trace_t* traces,
+                               int32_t count, int32_t local_node_id)
+{
+	bool ok;
+	int32_t i;
+	int32_t s;
+
+	ok = ram_json_object_begin(w) &&
+	     ram_json_key(w, "resourceSpans") && ram_json_array_begin(w) &&
+	     ram_json_object_begin(w) &&
+	     ram_json_key(w, "resource") && ram_json_object_begin(w) &&
+	     ram_json_key(w, "attributes") && ram_json_array_begin(w) &&
+	     ram_json_object_begin(w) && ram_json_kv_string(w, "key", "service.name") &&
+	     ram_json_key(w, "value") && ram_json_object_begin(w) &&
+	     ram_json_kv_string(w, "stringValue", "ramd") &&
+	     ram_json_object_end(w) && ram_json_object_end(w) &&
+	     ramd_failover_trace_otlp_attr_int(w, "ramd.node_id", local_node_id) &&
+	     ram_json_array_end(w) && ram_json_object_end(w) &&
+	     ram_json_key(w, "scopeSpans") && ram_json_array_begin(w) &&
+	     ram_json_object_begin(w) &&
+	     ram_json_key(w, "scope") && ram_json_object_begin(w) &&
+	     ram_json_kv_string(w, "name", "ramd.failover") && ram_json_object_end(w) &&
+	     ram_json_key(w, "spans") && ram_json_array_begin(w);
+
+	for (i = 0; ok && i < count; i++)
+	{
+		if (traces[i].end_us == 0)
+			continue;
+		ok = ramd_failover_trace_otlp_span(w, &traces[i], -1);
+		for (s = 0; ok && s < traces[i].span_count; s++)
+			ok = ramd_failover_trace_otlp_span(w, &traces[i], s);
+	}
+
+	return ok && ram_json_array_end(w) && ram_json_object_end(w) &&
+	       ram_json_array_end(w) && ram_json_object_end(w) &&
+	       ram_json_array_end(w) && ram_json_object_end(w);
+}
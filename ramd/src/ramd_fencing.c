@@ -0,0 +1,586 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_fencing.c
+ *		PostgreSQL Auto-Failover Daemon - Lease-Based Primary Fencing
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A partitioned primary cannot be reached to be demoted, so it has to stop
+ * taking writes on its own.  The writable server holds a lease of
+ * fencing_lease_ms, and the lease is Raft leadership: it is renewed from
+ * the moment a read barrier is sent, each time the barrier comes back with
+ * this node confirmed as leader by a quorum.  A primary that cannot renew
+ * in time fences itself one renewal period before the lease ends, either
+ * read-only or by stopping the server.  A new leader can only be elected
+ * after a quorum stopped answering the old one, so once a daemon has
+ * confirmed, without a gap, that someone else leads for a whole lease
+ * plus a clock drift allowance, the old primary has fenced itself and
+ * promotion can go ahead.  Failover therefore takes a known time, however
+ * unreachable the old host is.
+ *
+ * The writable server pulls Raft leadership to itself, but only while no
+ * other reachable server accepts writes, so a stale primary that comes
+ * back cannot take the lease from its successor.  A fenced primary is
+ * let go again when it renews in the term it lost the lease in, or when
+ * every other server is reachable and in recovery.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_fencing.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_pgraft.h"
+#include "ramd_postgresql.h"
+
+typedef struct ramd_fencing_watch_t
+{
+	bool used;
+	int32_t node_id;
+	int64_t away_since_us; /* first confirmed look at another leader, 0 if none */
+} ramd_fencing_watch_t;
+
+static struct
+{
+	pthread_mutex_t lock; /* guards everything below but conn */
+	pthread_cond_t cond;  /* wakes the lease thread */
+	pthread_cond_t observed; /* broadcast after every look at the leader */
+	bool running;
+	pthread_t thread;
+	ramd_cluster_t* cluster;
+	const ramd_config_t* config;
+	PGconn* conn; /* to the local server, used by the lease thread only */
+
+	/* Holder side, while the local server accepts writes */
+	bool holder;
+	bool fenced;
+	int64_t lease_expires_us;
+	long long lease_term; /* term of the last renewal, -1 before the first */
+	long long fenced_term;
+
+	/* Observer side */
+	int64_t confirmed_at_us; /* last confirmed look at the leader, 0 if the last one failed */
+	ramd_fencing_watch_t watches[RAMD_MAX_NODES];
+} g_fencing = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.observed = PTHREAD_COND_INITIALIZER,
+	.lease_term = -1,
+	.fenced_term = -1
+};
+
+/* Renewals are tried four times per lease, so two may fail before fencing */
+static int32_t
+ramd_fencing_period_ms(const ramd_config_t* config)
+{
+	return config->fencing_lease_ms / 4;
+}
+
+static int64_t
+ramd_fencing_safe_after_us(const ramd_config_t* config)
+{
+	return (int64_t) config->fencing_lease_ms * (100 + RAMD_FENCING_DRIFT_PERCENT) * 10;
+}
+
+static PGconn*
+ramd_fencing_connect(const char* host, int32_t postgresql_port)
+{
+	const ramd_config_t* config = g_fencing.config;
+	const char* keywords[8];
+	const char* values[8];
+	char port[16];
+	char timeout[16];
+	int n = 0;
+	PGconn* conn;
+
+	snprintf(port, sizeof(port), "%d", postgresql_port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = host;
+	keywords[n] = "port";            values[n++] = port;
+	keywords[n] = "dbname";          values[n++] = config->database_name;
+	keywords[n] = "user";            values[n++] = config->database_user;
+	if (config->database_password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = config->database_password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd_fencing";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	conn = PQconnectdbParams(keywords, values, 0);
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		ramd_log_debug("Fencing: cannot connect to %s:%d: %s", host, postgresql_port,
+		               PQerrorMessage(conn));
+		PQfinish(conn);
+		return NULL;
+	}
+	return conn;
+}
+
+static void
+ramd_fencing_disconnect(void)
+{
+	if (g_fencing.conn)
+		PQfinish(g_fencing.conn);
+	g_fencing.conn = NULL;
+}
+
+static bool
+ramd_fencing_exec(PGconn* conn, const char* sql)
+{
+	PGresult* res = PQexec(conn, sql);
+	ExecStatusType status = PQresultStatus(res);
+
+	if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+		ramd_log_error("Fencing: %s failed: %s", sql, PQerrorMessage(conn));
+	PQclear(res);
+	return status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK;
+}
+
+/*
+ * 1 in recovery, 0 writable, -1 if the server did not answer.  With
+ * count_fenced, a primary fenced read-only counts as in recovery.
+ */
+static int
+ramd_fencing_in_recovery(PGconn* conn, bool count_fenced)
+{
+	PGresult* res = PQexec(conn, count_fenced
+	    ? "SELECT pg_is_in_recovery() OR current_setting('default_transaction_read_only')::boolean"
+	    : "SELECT pg_is_in_recovery()");
+	int in_recovery = -1;
+
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+		in_recovery = strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+	PQclear(res);
+	return in_recovery;
+}
+
+/* How many other unfenced servers accept writes; *unknown if any did not answer */
+static int32_t
+ramd_fencing_other_primaries(bool* unknown)
+{
+	const ramd_cluster_t* cluster = g_fencing.cluster;
+	int32_t writable = 0;
+
+	*unknown = false;
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+		PGconn* conn;
+		int in_recovery;
+
+		if (node->node_id == g_fencing.config->node_id)
+			continue;
+
+		conn = ramd_fencing_connect(node->hostname, node->postgresql_port);
+		in_recovery = conn ? ramd_fencing_in_recovery(conn, true) : -1;
+		if (conn)
+			PQfinish(conn);
+
+		if (in_recovery < 0)
+			*unknown = true;
+		else if (in_recovery == 0)
+		{
+			ramd_log_warning("Fencing: node %d (%s) accepts writes as well", node->node_id,
+			                 node->hostname);
+			writable++;
+		}
+	}
+	return writable;
+}
+
+static void
+ramd_fencing_fence(long long term)
+{
+	const ramd_config_t* config = g_fencing.config;
+	bool done;
+
+	ramd_log_error("Fencing: write lease of node %d ran out without a quorum "
+	               "confirming it; fencing the local server (%s)",
+	               config->node_id,
+	               config->fencing_action == RAMD_FENCING_STOP ? "stop" : "read_only");
+
+	if (config->fencing_action == RAMD_FENCING_STOP)
+		done = ramd_postgresql_stop(config);
+	else
+	{
+		/* New sessions come up read-only; current ones are ended */
+		done = ramd_fencing_exec(g_fencing.conn,
+		                         "ALTER SYSTEM SET default_transaction_read_only = on") &&
+		       ramd_fencing_exec(g_fencing.conn, "SELECT pg_reload_conf()") &&
+		       ramd_fencing_exec(g_fencing.conn,
+		                         "SELECT pg_terminate_backend(pid) FROM pg_stat_activity "
+		                         "WHERE backend_type = 'client backend' "
+		                         "AND pid <> pg_backend_pid()");
+	}
+
+	/* Retried on the next round if the server would not take it */
+	if (!done)
+		return;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	g_fencing.fenced = true;
+	g_fencing.fenced_term = term;
+	pthread_mutex_unlock(&g_fencing.lock);
+}
+
+static bool
+ramd_fencing_unfence(void)
+{
+	if (!ramd_fencing_exec(g_fencing.conn, "ALTER SYSTEM RESET default_transaction_read_only") ||
+	    !ramd_fencing_exec(g_fencing.conn, "SELECT pg_reload_conf()"))
+		return false;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	g_fencing.fenced = false;
+	g_fencing.fenced_term = -1;
+	pthread_mutex_unlock(&g_fencing.lock);
+	return true;
+}
+
+static ramd_fencing_watch_t*
+ramd_fencing_find_watch(int32_t node_id)
+{
+	ramd_fencing_watch_t* free_watch = NULL;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_fencing_watch_t* w = &g_fencing.watches[i];
+
+		if (w->used && w->node_id == node_id)
+			return w;
+		if (!w->used && !free_watch)
+			free_watch = w;
+	}
+
+	if (free_watch)
+	{
+		memset(free_watch, 0, sizeof(*free_watch));
+		free_watch->used = true;
+		free_watch->node_id = node_id;
+	}
+	return free_watch;
+}
+
+/* Called with the lock held; leader_id is -1 when the look was not confirmed */
+static void
+ramd_fencing_observe(int32_t leader_id, int64_t now_us)
+{
+	const ramd_cluster_t* cluster = g_fencing.cluster;
+
+	/* Any gap and nobody can tell who led meanwhile */
+	g_fencing.confirmed_at_us = leader_id > 0 ? now_us : 0;
+	for (int32_t i = 0; i < cluster->node_count; i++)
+		(void) ramd_fencing_find_watch(cluster->nodes[i].node_id);
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_fencing_watch_t* w = &g_fencing.watches[i];
+
+		if (!w->used)
+			continue;
+		if (leader_id <= 0 || w->node_id == leader_id)
+			w->away_since_us = 0;
+		else if (w->away_since_us == 0)
+			w->away_since_us = now_us;
+	}
+	pthread_cond_broadcast(&g_fencing.observed);
+}
+
+static void
+ramd_fencing_release(void)
+{
+	bool holder;
+	bool fenced;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	holder = g_fencing.holder;
+	fenced = g_fencing.fenced;
+	pthread_mutex_unlock(&g_fencing.lock);
+	if (!holder)
+		return;
+
+	/* Demoted or rebuilt: a later promotion must not come up read-only */
+	if (fenced && g_fencing.config->fencing_action == RAMD_FENCING_READ_ONLY &&
+	    !ramd_fencing_unfence())
+		return;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	g_fencing.holder = false;
+	g_fencing.fenced = false;
+	g_fencing.lease_term = -1;
+	pthread_mutex_unlock(&g_fencing.lock);
+	ramd_log_info("Fencing: local server is a standby, holding no write lease");
+}
+
+static void
+ramd_fencing_hold(const ramd_pgraft_snapshot_t* snapshot, bool confirmed, int64_t sent_us)
+{
+	const ramd_config_t* config = g_fencing.config;
+	int32_t period_ms = ramd_fencing_period_ms(config);
+	bool renewed = confirmed && snapshot->is_leader;
+	bool claimed = false;
+	bool fenced;
+	bool unknown;
+	long long lease_term;
+	long long fenced_term;
+	int64_t expires_us;
+
+	/* Not leading: claim it, unless that would take it from a live primary */
+	if (confirmed && !snapshot->is_leader && ramd_fencing_other_primaries(&unknown) == 0)
+	{
+		/* Winning the election is a quorum's confirmation as well */
+		claimed = ramd_pgraft_transfer_leadership(g_fencing.conn, config->node_id, period_ms) ==
+		          RAMD_PGRAFT_SUCCESS;
+		if (!claimed)
+			ramd_log_warning("Fencing: cannot take Raft leadership for the write lease: %s",
+			                 ramd_pgraft_get_last_error());
+	}
+
+	pthread_mutex_lock(&g_fencing.lock);
+	if (!g_fencing.holder || (g_fencing.fenced && config->fencing_action == RAMD_FENCING_STOP))
+	{
+		/* Started writable, or restarted after being stopped: no lease until renewed */
+		g_fencing.holder = true;
+		g_fencing.fenced = false;
+		g_fencing.lease_expires_us = sent_us;
+		ramd_log_info("Fencing: local server accepts writes; it needs the write lease");
+	}
+	if (renewed || claimed)
+	{
+		g_fencing.lease_expires_us = sent_us + (int64_t) config->fencing_lease_ms * 1000;
+		g_fencing.lease_term = renewed ? snapshot->term : -1;
+	}
+	fenced = g_fencing.fenced;
+	fenced_term = g_fencing.fenced_term;
+	lease_term = g_fencing.lease_term;
+	expires_us = g_fencing.lease_expires_us;
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	if (fenced)
+	{
+		/*
+		 * In the same term nobody else can have been promoted; after an
+		 * election only a full check of the others rules that out.
+		 */
+		if ((renewed || claimed) && config->fencing_action == RAMD_FENCING_READ_ONLY &&
+		    ((lease_term >= 0 && lease_term == fenced_term) ||
+		     (ramd_fencing_other_primaries(&unknown) == 0 && !unknown)) &&
+		    ramd_fencing_unfence())
+			ramd_log_info("Fencing: write lease renewed; local server accepts writes again");
+		return;
+	}
+
+	/* Act while there is still a period left for the fence to take hold */
+	if (ramd_clock_now_us() + (int64_t) period_ms * 1000 >= expires_us)
+		ramd_fencing_fence(lease_term);
+}
+
+static void
+ramd_fencing_cycle(void)
+{
+	const ramd_config_t* config = g_fencing.config;
+	ramd_pgraft_snapshot_t snapshot;
+	int64_t sent_us;
+	int in_recovery;
+	bool confirmed;
+
+	if (!g_fencing.conn)
+		g_fencing.conn = ramd_fencing_connect(config->hostname, config->postgresql_port);
+	if (!g_fencing.conn)
+	{
+		pthread_mutex_lock(&g_fencing.lock);
+		ramd_fencing_observe(-1, ramd_clock_now_us());
+		pthread_mutex_unlock(&g_fencing.lock);
+		return;
+	}
+
+	in_recovery = ramd_fencing_in_recovery(g_fencing.conn, false);
+	sent_us = ramd_clock_now_us();
+	confirmed = ramd_pgraft_read_barrier(g_fencing.conn, ramd_fencing_period_ms(config)) ==
+	                RAMD_PGRAFT_SUCCESS &&
+	            ramd_pgraft_get_cluster_snapshot(g_fencing.conn, &snapshot) ==
+	                RAMD_PGRAFT_SUCCESS &&
+	            snapshot.leader_id > 0;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	ramd_fencing_observe(confirmed ? (int32_t) snapshot.leader_id : -1, sent_us);
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	if (in_recovery == 1)
+		ramd_fencing_release();
+	else if (in_recovery == 0)
+		ramd_fencing_hold(&snapshot, confirmed, sent_us);
+
+	if (PQstatus(g_fencing.conn) != CONNECTION_OK)
+		ramd_fencing_disconnect();
+}
+
+static void*
+ramd_fencing_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	while (g_fencing.running)
+	{
+		int32_t interval_ms = ramd_fencing_period_ms(g_fencing.config);
+		struct timespec deadline;
+
+		pthread_mutex_unlock(&g_fencing.lock);
+		ramd_fencing_cycle();
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += interval_ms / 1000;
+		deadline.tv_nsec += (long) (interval_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&g_fencing.lock);
+		if (g_fencing.running)
+			pthread_cond_timedwait(&g_fencing.cond, &g_fencing.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	ramd_fencing_disconnect();
+	return NULL;
+}
+
+bool
+ramd_fencing_start(ramd_cluster_t* cluster, const ramd_config_t* config)
+{
+	if (!cluster || !config)
+		return false;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	g_fencing.cluster = cluster;
+	g_fencing.config = config;
+	if (g_fencing.running || !config->fencing_enabled)
+	{
+		pthread_mutex_unlock(&g_fencing.lock);
+		return true;
+	}
+	memset(g_fencing.watches, 0, sizeof(g_fencing.watches));
+	g_fencing.confirmed_at_us = 0;
+	g_fencing.running = true;
+	if (pthread_create(&g_fencing.thread, NULL, ramd_fencing_thread_main, NULL) != 0)
+	{
+		g_fencing.running = false;
+		pthread_mutex_unlock(&g_fencing.lock);
+		ramd_log_error("Fencing: failed to create lease thread");
+		return false;
+	}
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	ramd_log_info("Primary fencing started (lease %d ms, action %s)", config->fencing_lease_ms,
+	              config->fencing_action == RAMD_FENCING_STOP ? "stop" : "read_only");
+	return true;
+}
+
+void
+ramd_fencing_stop(void)
+{
+	pthread_mutex_lock(&g_fencing.lock);
+	if (!g_fencing.running)
+	{
+		pthread_mutex_unlock(&g_fencing.lock);
+		return;
+	}
+	g_fencing.running = false;
+	pthread_cond_broadcast(&g_fencing.cond);
+	pthread_cond_broadcast(&g_fencing.observed);
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	pthread_join(g_fencing.thread, NULL);
+}
+
+bool
+ramd_fencing_wait_expired(int32_t node_id, int32_t timeout_ms)
+{
+	int64_t deadline_us = ramd_clock_now_us() + (int64_t) timeout_ms * 1000;
+	bool expired = false;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	if (!g_fencing.running)
+	{
+		pthread_mutex_unlock(&g_fencing.lock);
+		return true;
+	}
+
+	ramd_log_info("Fencing: waiting for the write lease of node %d to run out", node_id);
+	while (g_fencing.running)
+	{
+		ramd_fencing_watch_t* w = ramd_fencing_find_watch(node_id);
+		int64_t now_us = ramd_clock_now_us();
+		struct timespec wake;
+
+		/* Judged on a fresh look, so a leader regained just now is not missed */
+		if (w && w->away_since_us > 0 &&
+		    g_fencing.confirmed_at_us - w->away_since_us >=
+		        ramd_fencing_safe_after_us(g_fencing.config))
+		{
+			expired = true;
+			break;
+		}
+		if (now_us >= deadline_us)
+			break;
+
+		clock_gettime(CLOCK_REALTIME, &wake);
+		wake.tv_sec += (time_t) ((deadline_us - now_us) / 1000000);
+		wake.tv_nsec += (long) ((deadline_us - now_us) % 1000000) * 1000L;
+		if (wake.tv_nsec >= 1000000000L)
+		{
+			wake.tv_sec++;
+			wake.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&g_fencing.observed, &g_fencing.lock, &wake);
+	}
+	pthread_mutex_unlock(&g_fencing.lock);
+
+	if (expired)
+		ramd_log_info("Fencing: write lease of node %d has run out", node_id);
+	else
+		ramd_log_error("Fencing: cannot confirm that the write lease of node %d ran out "
+		               "within %d ms", node_id, timeout_ms);
+	return expired;
+}
+
+bool
+ramd_fencing_hand_over(int32_t node_id)
+{
+	const ramd_config_t* config;
+	PGconn* conn;
+	bool handed;
+
+	pthread_mutex_lock(&g_fencing.lock);
+	config = g_fencing.running ? g_fencing.config : NULL;
+	pthread_mutex_unlock(&g_fencing.lock);
+	if (!config)
+		return true;
+
+	/* pgraft forwards the request to the leader from any member */
+	conn = ramd_fencing_connect(config->hostname, config->postgresql_port);
+	if (!conn)
+		return false;
+	handed = ramd_pgraft_transfer_leadership(conn, node_id,
+	                                         ramd_fencing_period_ms(config) * 2) ==
+	         RAMD_PGRAFT_SUCCESS;
+	PQfinish(conn);
+
+	if (!handed)
+		ramd_log_warning("Fencing: node %d did not take Raft leadership; it will "
+		                 "claim it itself", node_id);
+	return handed;
+}
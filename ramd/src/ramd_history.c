@@ -0,0 +1,769 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_history.c
+ *		PostgreSQL Auto-Failover Daemon - Metrics History
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Once a second this records a handful of figures that say how the node
+ * has been doing: the worst standby lag, the local health score, the mean
+ * API request time, an estimate of the Raft commit time and the mean
+ * monitor cycle time.  They are kept at three resolutions, an hour of
+ * seconds, a day of minutes and a month of hours, each a fixed ring of
+ * blocks, so the history costs the same memory from the first sample on.
+ * Minutes and hours keep the average and the worst of the seconds they
+ * cover, gathered in an accumulator until their step is over.
+ *
+ * A block holds RAMD_HISTORY_BLOCK_POINTS consecutive steps.  It stores
+ * the first value of each series in full and every later one as a 32-bit
+ * difference from the one before, about half the size of plain values.
+ * A step the sampler missed starts a new block, so points never need a
+ * timestamp of their own, and so does a jump too large for a difference.
+ *
+ * With metrics_history_file set the whole store is a shared mapping of
+ * that file, and a restarted ramd carries on where the last one stopped;
+ * ramctrl show performance then has context even from hosts that were
+ * not being scraped.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ramd_history.h"
+#include "ramd_daemon.h"
+#include "ramd_defaults.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_metrics.h"
+#include "ramd_monitor.h"
+#include "ramd_pgraft.h"
+
+#define RAMD_HISTORY_MAGIC  "RAMHIST1"
+#define RAMD_HISTORY_FORMAT 1
+#define RAMD_HISTORY_BLOCKS \
+	(RAMD_HISTORY_SECOND_BLOCKS + RAMD_HISTORY_MINUTE_BLOCKS + RAMD_HISTORY_HOUR_BLOCKS)
+
+/* Channel 0 is the average, channel 1 the maximum; seconds only use 0 */
+#define RAMD_HISTORY_CHANNELS 2
+
+typedef struct ramd_history_block_t
+{
+	int64_t start;  /* unix seconds of point 0; 0: unused */
+	int32_t count;
+	uint32_t seen;  /* bit s: base and last of series s are set */
+	uint8_t present[RAMD_HISTORY_BLOCK_POINTS];
+	int64_t base[RAMD_HISTORY_SERIES_COUNT][RAMD_HISTORY_CHANNELS];
+	int64_t last[RAMD_HISTORY_SERIES_COUNT][RAMD_HISTORY_CHANNELS];
+	int32_t delta[RAMD_HISTORY_SERIES_COUNT][RAMD_HISTORY_CHANNELS][RAMD_HISTORY_BLOCK_POINTS];
+} ramd_history_block_t;
+
+/* The step of a coarser resolution still being filled */
+typedef struct ramd_history_accumulator_t
+{
+	int64_t step_start; /* 0: empty */
+	int64_t sum[RAMD_HISTORY_SERIES_COUNT];
+	int64_t max[RAMD_HISTORY_SERIES_COUNT];
+	int32_t samples[RAMD_HISTORY_SERIES_COUNT];
+} ramd_history_accumulator_t;
+
+typedef struct ramd_history_ring_t
+{
+	int32_t head; /* block being filled */
+	int32_t reserved;
+	ramd_history_accumulator_t pending;
+} ramd_history_ring_t;
+
+/* Everything that survives a restart, laid out as in the file */
+typedef struct ramd_history_store_t
+{
+	char magic[8];
+	uint32_t format;
+	uint32_t size;
+	uint32_t series;
+	uint32_t block_points;
+	ramd_history_ring_t rings[RAMD_HISTORY_RESOLUTION_COUNT];
+	ramd_history_block_t blocks[RAMD_HISTORY_BLOCKS];
+} ramd_history_store_t;
+
+/* Cumulative counters from the previous sample, for the deltas */
+typedef struct ramd_history_counters_t
+{
+	bool http_valid;
+	int64_t http_requests;
+	int64_t http_sum_us;
+	bool cycle_valid;
+	int64_t cycles;
+	int64_t cycle_sum_us;
+	bool raft_valid;
+	int64_t raft_appends;
+	int64_t raft_sum_us;
+} ramd_history_counters_t;
+
+typedef struct ramd_history_t
+{
+	pthread_mutex_t lock; /* guards everything below but counters */
+	pthread_cond_t cond;  /* wakes the sampler to stop */
+	bool running;
+	pthread_t thread;
+	ramd_history_store_t* store;
+	bool persistent; /* store maps metrics_history_file */
+	char data_dir[RAMD_MAX_PATH_LENGTH];
+	ramd_history_counters_t counters; /* sampler thread only */
+} ramd_history_t;
+
+static ramd_history_t g_history = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static const char* const g_history_series_names[RAMD_HISTORY_SERIES_COUNT] = {
+	"lag_ms", "health", "http_us", "raft_commit_us", "cycle_us"
+};
+
+static const char* const g_history_resolution_names[RAMD_HISTORY_RESOLUTION_COUNT] = {
+	"1s", "1m", "1h"
+};
+
+static const int32_t g_history_step[RAMD_HISTORY_RESOLUTION_COUNT] = {1, 60, 3600};
+
+static const int32_t g_history_ring_blocks[RAMD_HISTORY_RESOLUTION_COUNT] = {
+	RAMD_HISTORY_SECOND_BLOCKS, RAMD_HISTORY_MINUTE_BLOCKS, RAMD_HISTORY_HOUR_BLOCKS
+};
+
+static const int32_t g_history_first_block[RAMD_HISTORY_RESOLUTION_COUNT] = {
+	0, RAMD_HISTORY_SECOND_BLOCKS, RAMD_HISTORY_SECOND_BLOCKS + RAMD_HISTORY_MINUTE_BLOCKS
+};
+
+const char*
+ramd_history_series_name(ramd_history_series_t series)
+{
+	if (series < 0 || series >= RAMD_HISTORY_SERIES_COUNT)
+		return "unknown";
+	return g_history_series_names[series];
+}
+
+const char*
+ramd_history_resolution_name(ramd_history_resolution_t resolution)
+{
+	if (resolution < 0 || resolution >= RAMD_HISTORY_RESOLUTION_COUNT)
+		return "unknown";
+	return g_history_resolution_names[resolution];
+}
+
+bool
+ramd_history_parse_resolution(const char* name, ramd_history_resolution_t* resolution)
+{
+	for (int i = 0; name && i < RAMD_HISTORY_RESOLUTION_COUNT; i++)
+	{
+		if (strcmp(name, g_history_resolution_names[i]) == 0)
+		{
+			*resolution = (ramd_history_resolution_t) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+int32_t
+ramd_history_step_seconds(ramd_history_resolution_t resolution)
+{
+	if (resolution < 0 || resolution >= RAMD_HISTORY_RESOLUTION_COUNT)
+		return 0;
+	return g_history_step[resolution];
+}
+
+int32_t
+ramd_history_capacity(ramd_history_resolution_t resolution)
+{
+	if (resolution < 0 || resolution >= RAMD_HISTORY_RESOLUTION_COUNT)
+		return 0;
+	return g_history_ring_blocks[resolution] * RAMD_HISTORY_BLOCK_POINTS;
+}
+
+static int
+ramd_history_channels(ramd_history_resolution_t resolution)
+{
+	return resolution == RAMD_HISTORY_SECONDS ? 1 : RAMD_HISTORY_CHANNELS;
+}
+
+static ramd_history_block_t*
+ramd_history_block(ramd_history_resolution_t resolution, int32_t index)
+{
+	return &g_history.store->blocks[g_history_first_block[resolution] + index];
+}
+
+/* Whether every value differs from the block's last one by what 32 bits hold */
+static bool
+ramd_history_block_fits(const ramd_history_block_t* block, int channels, const int64_t* avg,
+                        const int64_t* max, uint32_t present)
+{
+	for (int s = 0; s < RAMD_HISTORY_SERIES_COUNT; s++)
+	{
+		if (!(present & block->seen & (1u << s)))
+			continue;
+		for (int c = 0; c < channels; c++)
+		{
+			int64_t value = c == 0 ? avg[s] : max[s];
+			int64_t last = block->last[s][c];
+
+			if ((value > last && value - last > INT32_MAX) ||
+				(value < last && value - last < INT32_MIN))
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Append the next point; the caller has checked it fits */
+static void
+ramd_history_block_put(ramd_history_block_t* block, int channels, const int64_t* avg,
+                       const int64_t* max, uint32_t present)
+{
+	int32_t index = block->count;
+
+	for (int s = 0; s < RAMD_HISTORY_SERIES_COUNT; s++)
+	{
+		uint32_t bit = 1u << s;
+
+		if (!(present & bit))
+			continue;
+		for (int c = 0; c < channels; c++)
+		{
+			int64_t value = c == 0 ? avg[s] : max[s];
+
+			if (!(block->seen & bit))
+			{
+				block->base[s][c] = value;
+				block->delta[s][c][index] = 0;
+			}
+			else
+				block->delta[s][c][index] = (int32_t) (value - block->last[s][c]);
+			block->last[s][c] = value;
+		}
+		block->seen |= bit;
+	}
+	block->present[index] = (uint8_t) present;
+	block->count = index + 1;
+}
+
+static int32_t
+ramd_history_block_decode(const ramd_history_block_t* block, ramd_history_resolution_t resolution,
+                          ramd_history_point_t* points)
+{
+	int64_t value[RAMD_HISTORY_SERIES_COUNT][RAMD_HISTORY_CHANNELS];
+	int channels = ramd_history_channels(resolution);
+
+	memcpy(value, block->base, sizeof(value));
+	for (int32_t i = 0; i < block->count; i++)
+	{
+		ramd_history_point_t* point = &points[i];
+
+		memset(point, 0, sizeof(*point));
+		point->ts = block->start + (int64_t) i * g_history_step[resolution];
+		point->present = block->present[i];
+		for (int s = 0; s < RAMD_HISTORY_SERIES_COUNT; s++)
+		{
+			if (!(point->present & (1u << s)))
+				continue;
+			for (int c = 0; c < channels; c++)
+				value[s][c] += block->delta[s][c][i];
+			point->avg[s] = value[s][0];
+			point->max[s] = value[s][channels - 1];
+		}
+	}
+	return block->count;
+}
+
+/*
+ * Add a point, starting a new block after a missed step, when the block
+ * is full or when a value jumps further than a difference holds.  False
+ * if the ring already has a point for ts.
+ */
+static bool
+ramd_history_ring_append(ramd_history_resolution_t resolution, int64_t ts, const int64_t* avg,
+                         const int64_t* max, uint32_t present)
+{
+	ramd_history_ring_t* ring = &g_history.store->rings[resolution];
+	ramd_history_block_t* block = ramd_history_block(resolution, ring->head);
+	int64_t step = g_history_step[resolution];
+	int channels = ramd_history_channels(resolution);
+
+	if (block->start != 0)
+	{
+		int64_t next = block->start + block->count * step;
+
+		/* Woken twice within one step */
+		if (ts >= block->start && ts < next)
+			return false;
+		if (ts != next || block->count == RAMD_HISTORY_BLOCK_POINTS ||
+			!ramd_history_block_fits(block, channels, avg, max, present))
+		{
+			ring->head = (ring->head + 1) % g_history_ring_blocks[resolution];
+			block = ramd_history_block(resolution, ring->head);
+			memset(block, 0, sizeof(*block));
+		}
+	}
+	if (block->start == 0)
+		block->start = ts;
+	ramd_history_block_put(block, channels, avg, max, present);
+	return true;
+}
+
+static uint32_t
+ramd_history_pending_point(const ramd_history_accumulator_t* pending, ramd_history_point_t* point)
+{
+	memset(point, 0, sizeof(*point));
+	point->ts = pending->step_start;
+	for (int s = 0; s < RAMD_HISTORY_SERIES_COUNT; s++)
+	{
+		if (pending->samples[s] == 0)
+			continue;
+		point->present |= 1u << s;
+		point->avg[s] = pending->sum[s] / pending->samples[s];
+		point->max[s] = pending->max[s];
+	}
+	return point->present;
+}
+
+/* Fold a one-second sample into a coarser resolution, closing its step when it is over */
+static void
+ramd_history_accumulate(ramd_history_resolution_t resolution, int64_t ts, const int64_t* values,
+                        uint32_t present)
+{
+	ramd_history_accumulator_t* pending = &g_history.store->rings[resolution].pending;
+	int64_t step_start = ts - ts % g_history_step[resolution];
+
+	if (pending->step_start != step_start)
+	{
+		ramd_history_point_t point;
+
+		if (pending->step_start != 0 && ramd_history_pending_point(pending, &point) != 0)
+			ramd_history_ring_append(resolution, point.ts, point.avg, point.max, point.present);
+		memset(pending, 0, sizeof(*pending));
+		pending->step_start = step_start;
+	}
+
+	for (int s = 0; s < RAMD_HISTORY_SERIES_COUNT; s++)
+	{
+		if (!(present & (1u << s)))
+			continue;
+		pending->sum[s] += values[s];
+		if (pending->samples[s] == 0 || values[s] > pending->max[s])
+			pending->max[s] = values[s];
+		pending->samples[s]++;
+	}
+}
+
+static void
+ramd_history_record(int64_t ts, const int64_t* values, uint32_t present)
+{
+	pthread_mutex_lock(&g_history.lock);
+	if (g_history.store && ramd_history_ring_append(RAMD_HISTORY_SECONDS, ts, values, values,
+	                                                present))
+	{
+		ramd_history_accumulate(RAMD_HISTORY_MINUTES, ts, values, present);
+		ramd_history_accumulate(RAMD_HISTORY_HOURS, ts, values, present);
+	}
+	pthread_mutex_unlock(&g_history.lock);
+}
+
+int32_t
+ramd_history_read(ramd_history_resolution_t resolution, int64_t since,
+                  ramd_history_point_t* points, int32_t max, bool* partial)
+{
+	ramd_history_point_t decoded[RAMD_HISTORY_BLOCK_POINTS];
+	ramd_history_point_t pending;
+	const ramd_history_ring_t* ring;
+	int32_t blocks;
+	int32_t total = 0;
+	int32_t skip;
+	int32_t count = 0;
+	bool has_pending = false;
+
+	if (partial)
+		*partial = false;
+	if (resolution < 0 || resolution >= RAMD_HISTORY_RESOLUTION_COUNT || !points || max <= 0)
+		return 0;
+
+	pthread_mutex_lock(&g_history.lock);
+	if (!g_history.store)
+	{
+		pthread_mutex_unlock(&g_history.lock);
+		return 0;
+	}
+	ring = &g_history.store->rings[resolution];
+	blocks = g_history_ring_blocks[resolution];
+
+	/* Count first, so only the newest max are decoded into points */
+	for (int32_t n = 1; n <= blocks; n++)
+	{
+		const ramd_history_block_t* block =
+			ramd_history_block(resolution, (ring->head + n) % blocks);
+
+		for (int32_t i = 0; block->start != 0 && i < block->count; i++)
+			if (block->start + (int64_t) i * g_history_step[resolution] >= since)
+				total++;
+	}
+	if (resolution != RAMD_HISTORY_SECONDS && ring->pending.step_start >= since &&
+		ramd_history_pending_point(&ring->pending, &pending) != 0)
+	{
+		has_pending = true;
+		total++;
+	}
+	skip = total > max ? total - max : 0;
+
+	for (int32_t n = 1; n <= blocks && count < max; n++)
+	{
+		const ramd_history_block_t* block =
+			ramd_history_block(resolution, (ring->head + n) % blocks);
+		int32_t decoded_count;
+
+		if (block->start == 0)
+			continue;
+		decoded_count = ramd_history_block_decode(block, resolution, decoded);
+		for (int32_t i = 0; i < decoded_count && count < max; i++)
+		{
+			if (decoded[i].ts < since)
+				continue;
+			if (skip > 0)
+			{
+				skip--;
+				continue;
+			}
+			points[count++] = decoded[i];
+		}
+	}
+	if (has_pending && count < max)
+	{
+		points[count++] = pending;
+		if (partial)
+			*partial = true;
+	}
+	pthread_mutex_unlock(&g_history.lock);
+	return count;
+}
+
+/* Mean of a counter pair's growth since the last sample; false if there was none */
+static bool
+ramd_history_mean(bool* valid, int64_t* prev_count, int64_t* prev_sum, int64_t count,
+                  int64_t sum, int64_t* mean)
+{
+	bool ok = *valid && count > *prev_count && sum >= *prev_sum;
+
+	if (ok)
+		*mean = (sum - *prev_sum) / (count - *prev_count);
+	*valid = true;
+	*prev_count = count;
+	*prev_sum = sum;
+	return ok;
+}
+
+/*
+ * What a commit waits for beyond the local WAL write: on the leader the
+ * append round trip of the slowest follower a majority needs.  0 for a
+ * single voter, -1 off the leader or before enough round trips are known.
+ */
+static int64_t
+ramd_history_quorum_rtt_us(const ramd_pgraft_metrics_t* m)
+{
+	int64_t rtts[RAMD_PGRAFT_MAX_NODES];
+	int64_t peers = m->num_peers;
+	int32_t known = 0;
+	int32_t needed;
+	bool leader = false;
+
+	if (peers < 0)
+		peers = 0;
+	if (peers > RAMD_PGRAFT_MAX_NODES)
+		peers = RAMD_PGRAFT_MAX_NODES;
+
+	for (int32_t i = 0; i < peers; i++)
+	{
+		/* Progress, and with it the leader itself among the peers, is only kept by the leader */
+		if (m->peer_match[i] >= 0)
+			leader = true;
+		if (m->peer_id[i] != m->node_id && m->peer_append_rtt_us[i] >= 0)
+		{
+			int32_t j = known++;
+
+			while (j > 0 && rtts[j - 1] > m->peer_append_rtt_us[i])
+			{
+				rtts[j] = rtts[j - 1];
+				j--;
+			}
+			rtts[j] = m->peer_append_rtt_us[i];
+		}
+	}
+	if (!leader)
+		return -1;
+
+	needed = (int32_t) (peers / 2);
+	if (needed == 0)
+		return 0;
+	return known >= needed ? rtts[needed - 1] : -1;
+}
+
+static uint32_t
+ramd_history_collect(int64_t* values)
+{
+	ramd_history_counters_t* counters = &g_history.counters;
+	ramd_lag_stats_t lag[RAMD_MAX_NODES];
+	ramd_pgraft_metrics_t raft;
+	ramd_monitor_health_t health;
+	uint32_t present = 0;
+	int64_t worst_lag = -1;
+	int64_t cycles = 0;
+	int64_t cycle_sum_us;
+	int32_t lag_count;
+
+	memset(values, 0, sizeof(int64_t) * RAMD_HISTORY_SERIES_COUNT);
+
+	/* On a primary the sampled standbys, on a standby its own lag */
+	lag_count = ramd_lag_get_all(lag, RAMD_MAX_NODES);
+	for (int32_t i = 0; i < lag_count; i++)
+		if (lag[i].connected && (int64_t) (lag[i].ewma_replay_lag_ms + 0.5) > worst_lag)
+			worst_lag = (int64_t) (lag[i].ewma_replay_lag_ms + 0.5);
+
+	if (g_ramd_daemon)
+	{
+		ramd_monitor_get_health(&g_ramd_daemon->monitor, &health);
+		if (health.sample_age_ms >= 0)
+		{
+			values[RAMD_HISTORY_HEALTH] = (int64_t) (health.score * 1000.0f + 0.5f);
+			present |= 1u << RAMD_HISTORY_HEALTH;
+			if (worst_lag < 0)
+				worst_lag = (int64_t) (health.replication_lag_seconds * 1000.0f + 0.5f);
+		}
+
+		pthread_mutex_lock(&g_ramd_daemon->monitor.stats_lock);
+		for (int i = 0; i <= RAMD_MONITOR_CYCLE_BUCKET_COUNT; i++)
+			cycles += g_ramd_daemon->monitor.stats.cycle_buckets[i];
+		cycle_sum_us = g_ramd_daemon->monitor.stats.cycle_sum_us;
+		pthread_mutex_unlock(&g_ramd_daemon->monitor.stats_lock);
+		if (ramd_history_mean(&counters->cycle_valid, &counters->cycles, &counters->cycle_sum_us,
+		                      cycles, cycle_sum_us, &values[RAMD_HISTORY_CYCLE_US]))
+			present |= 1u << RAMD_HISTORY_CYCLE_US;
+	}
+	if (worst_lag >= 0)
+	{
+		values[RAMD_HISTORY_LAG_MS] = worst_lag;
+		present |= 1u << RAMD_HISTORY_LAG_MS;
+	}
+
+	if (g_ramd_metrics &&
+		ramd_history_mean(&counters->http_valid, &counters->http_requests, &counters->http_sum_us,
+		                  ramd_metrics_counter_total(g_ramd_metrics, RAMD_METRIC_HTTP_REQUESTS),
+		                  ramd_metrics_counter_total(g_ramd_metrics,
+		                                             RAMD_METRIC_HTTP_DURATION_SUM_US),
+		                  &values[RAMD_HISTORY_HTTP_US]))
+		present |= 1u << RAMD_HISTORY_HTTP_US;
+
+	if (g_history.data_dir[0] != '\0' && ramd_pgraft_read_metrics(g_history.data_dir, &raft))
+	{
+		int64_t appends = 0;
+		int64_t quorum_us;
+
+		for (int i = 0; i < RAMD_PGRAFT_METRICS_BUCKETS; i++)
+			appends += raft.append_latency[i];
+		if (ramd_history_mean(&counters->raft_valid, &counters->raft_appends,
+		                      &counters->raft_sum_us, appends, raft.append_latency_sum_us,
+		                      &values[RAMD_HISTORY_RAFT_COMMIT_US]))
+		{
+			quorum_us = ramd_history_quorum_rtt_us(&raft);
+			if (quorum_us > 0)
+				values[RAMD_HISTORY_RAFT_COMMIT_US] += quorum_us;
+			present |= 1u << RAMD_HISTORY_RAFT_COMMIT_US;
+		}
+	}
+	else
+		counters->raft_valid = false;
+
+	return present;
+}
+
+static void*
+ramd_history_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_history.lock);
+	while (g_history.running)
+	{
+		struct timespec now;
+		struct timespec deadline;
+		int64_t values[RAMD_HISTORY_SERIES_COUNT];
+		uint32_t present;
+
+		pthread_mutex_unlock(&g_history.lock);
+		clock_gettime(CLOCK_REALTIME, &now);
+		present = ramd_history_collect(values);
+		ramd_history_record((int64_t) now.tv_sec, values, present);
+
+		/*
+		 * Wake on the next second boundary rather than an interval after
+		 * this sample, so sampling time never pushes a step past a second
+		 * and splits the block.
+		 */
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += RAMD_HISTORY_INTERVAL_MS / 1000;
+		deadline.tv_nsec = 0;
+
+		pthread_mutex_lock(&g_history.lock);
+		if (g_history.running)
+			pthread_cond_timedwait(&g_history.cond, &g_history.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_history.lock);
+	return NULL;
+}
+
+static bool
+ramd_history_store_valid(const ramd_history_store_t* store)
+{
+	if (memcmp(store->magic, RAMD_HISTORY_MAGIC, sizeof(store->magic)) != 0 ||
+		store->format != RAMD_HISTORY_FORMAT || store->size != sizeof(*store) ||
+		store->series != RAMD_HISTORY_SERIES_COUNT ||
+		store->block_points != RAMD_HISTORY_BLOCK_POINTS)
+		return false;
+
+	for (int r = 0; r < RAMD_HISTORY_RESOLUTION_COUNT; r++)
+		if (store->rings[r].head < 0 || store->rings[r].head >= g_history_ring_blocks[r])
+			return false;
+	for (int b = 0; b < RAMD_HISTORY_BLOCKS; b++)
+		if (store->blocks[b].count < 0 || store->blocks[b].count > RAMD_HISTORY_BLOCK_POINTS)
+			return false;
+	return true;
+}
+
+/* Map metrics_history_file, or anonymous memory if there is none or it cannot be used */
+static ramd_history_store_t*
+ramd_history_map(const char* path, bool* persistent)
+{
+	ramd_history_store_t* store = MAP_FAILED;
+	struct stat st;
+	int fd;
+
+	*persistent = false;
+	if (path[0] != '\0')
+	{
+		fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+		if (fd < 0)
+			ramd_log_warning("Metrics history: cannot open %s: %s", path, strerror(errno));
+		else
+		{
+			int rc = 0;
+
+			/* A file of another size is from another layout and starts over */
+			if (fstat(fd, &st) != 0 || st.st_size != (off_t) sizeof(*store))
+				rc = ftruncate(fd, 0) != 0 ? errno : 0;
+			/* Allocated up front: a full disk must not turn into SIGBUS on a write */
+			if (rc == 0)
+				rc = posix_fallocate(fd, 0, (off_t) sizeof(*store));
+			if (rc == 0)
+				store = mmap(NULL, sizeof(*store), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (rc != 0 || store == MAP_FAILED)
+				ramd_log_warning("Metrics history: cannot map %s: %s", path,
+				                 strerror(rc != 0 ? rc : errno));
+			close(fd);
+		}
+		*persistent = store != MAP_FAILED;
+	}
+	if (store == MAP_FAILED)
+	{
+		store = mmap(NULL, sizeof(*store), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+		             -1, 0);
+		if (store == MAP_FAILED)
+			return NULL;
+	}
+
+	if (!ramd_history_store_valid(store))
+	{
+		if (*persistent && store->magic[0] != '\0')
+			ramd_log_info("Metrics history: %s is from another layout, starting over", path);
+		memset(store, 0, sizeof(*store));
+		memcpy(store->magic, RAMD_HISTORY_MAGIC, sizeof(store->magic));
+		store->format = RAMD_HISTORY_FORMAT;
+		store->size = sizeof(*store);
+		store->series = RAMD_HISTORY_SERIES_COUNT;
+		store->block_points = RAMD_HISTORY_BLOCK_POINTS;
+	}
+	return store;
+}
+
+bool
+ramd_history_start(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_history.lock);
+	if (g_history.running)
+	{
+		pthread_mutex_unlock(&g_history.lock);
+		return true;
+	}
+
+	g_history.store = ramd_history_map(config->metrics_history_file, &g_history.persistent);
+	if (!g_history.store)
+	{
+		pthread_mutex_unlock(&g_history.lock);
+		ramd_log_error("Metrics history: cannot map %zu bytes: %s",
+		               sizeof(ramd_history_store_t), strerror(errno));
+		return false;
+	}
+	if (!g_history.persistent)
+		ramd_mem_account(RAMD_MEM_METRICS, (int64_t) sizeof(ramd_history_store_t));
+	strncpy(g_history.data_dir, config->postgresql_data_dir, sizeof(g_history.data_dir) - 1);
+	g_history.data_dir[sizeof(g_history.data_dir) - 1] = '\0';
+	memset(&g_history.counters, 0, sizeof(g_history.counters));
+
+	g_history.running = true;
+	if (pthread_create(&g_history.thread, NULL, ramd_history_thread_main, NULL) != 0)
+	{
+		g_history.running = false;
+		if (!g_history.persistent)
+			ramd_mem_account(RAMD_MEM_METRICS, -(int64_t) sizeof(ramd_history_store_t));
+		munmap(g_history.store, sizeof(ramd_history_store_t));
+		g_history.store = NULL;
+		pthread_mutex_unlock(&g_history.lock);
+		ramd_log_error("Metrics history: cannot start thread: %s", strerror(errno));
+		return false;
+	}
+	pthread_mutex_unlock(&g_history.lock);
+	return true;
+}
+
+void
+ramd_history_stop(void)
+{
+	pthread_mutex_lock(&g_history.lock);
+	if (!g_history.running)
+	{
+		pthread_mutex_unlock(&g_history.lock);
+		return;
+	}
+	g_history.running = false;
+	pthread_cond_broadcast(&g_history.cond);
+	pthread_mutex_unlock(&g_history.lock);
+
+	pthread_join(g_history.thread, NULL);
+
+	pthread_mutex_lock(&g_history.lock);
+	if (g_history.persistent)
+		msync(g_history.store, sizeof(ramd_history_store_t), MS_SYNC);
+	else
+		ramd_mem_account(RAMD_MEM_METRICS, -(int64_t) sizeof(ramd_history_store_t));
+	munmap(g_history.store, sizeof(ramd_history_store_t));
+	g_history.store = NULL;
+	pthread_mutex_unlock(&g_history.lock);
+}
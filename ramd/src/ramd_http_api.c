@@ -8,7 +8,14 @@
  *-------------------------------------------------------------------------
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* struct ucred */
+#endif
+
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -19,9 +26,23 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <libpq-fe.h>
+#include <openssl/err.h>
 #include <signal.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define RAMD_HTTP_USE_EPOLL
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+	defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#define RAMD_HTTP_USE_KQUEUE
+#else
+#error "ramd HTTP server requires epoll or kqueue"
+#endif
 
 #include "ramd_http_api.h"
+#include "ramd_clock.h"
 #include "ramd_logging.h"
 #include "ramd_postgresql.h"
 #include "ramd_cluster.h"
@@ -39,12 +60,6 @@
 #include "ramd_metrics.h"
 
 /* Stub functions for missing API handlers */
-bool ramd_api_handle_switchover(ramd_http_request_t* request __attribute__((unused)), ramd_http_response_t* response) {
-    response->status = 200;
-    strcpy(response->body, "{\"status\":\"switchover_initiated\"}");
-    return true;
-}
-
 bool ramd_api_handle_config_get(ramd_http_request_t* request __attribute__((unused)), ramd_http_response_t* response) {
     response->status = 200;
     strcpy(response->body, "{\"config\":{}}");
@@ -94,8 +109,26 @@ bool ramd_api_handle_cluster_health(ramd_http_request_t* request __attribute__((
 }
 #include "ramd_daemon.h"
 #include "ramd_failover.h"
+#include "ramd_failover_trace.h"
 #include "ramd_prometheus.h"
+#include "ramd_registry.h"
+#include "ramd_profiler.h"
 #include "ramd_security.h"
+#include "ramd_rebuild.h"
+#include "ramd_lag.h"
+#include "ramd_slots.h"
+#include "ramd_logical_slots.h"
+#include "ramd_topology.h"
+#include "ramd_rolling.h"
+#include "ramd_switchover.h"
+#include "ramd_prewarm.h"
+#include "ramd_tls.h"
+#include "ramd_watch.h"
+#include "ramd_job.h"
+#include "ramd_log_store.h"
+#include "ramd_history.h"
+#include "ram_json.h"
+#include "ram_state.h"
 
 extern ramd_daemon_t *g_ramd_daemon;
 extern PGconn *g_conn;
@@ -103,9 +136,168 @@ extern PGconn *g_conn;
 static ramd_http_server_t *g_http_server = NULL;
 
 static void *ramd_http_server_thread(void *arg);
-static void *ramd_http_connection_handler(void *arg);
+static void *ramd_http_worker_thread(void *arg);
+static void ramd_http_connection_write(ramd_http_connection_t *conn);
+static void ramd_http_connection_finish(ramd_http_connection_t *conn);
+static void ramd_http_connection_read(ramd_http_connection_t *conn);
+static ssize_t ramd_http_format_head(ramd_http_response_t *response, bool keep_alive,
+									 size_t body_length, char *buf, size_t size);
+static bool ramd_http_connection_next(ramd_http_connection_t *conn);
 static void ramd_http_route_request(ramd_http_request_t *request, ramd_http_response_t *response);
-static int get_healthy_nodes_count(void);
+static void ramd_http_dispatch_routes(ramd_http_request_t *request, ramd_http_response_t *response);
+static const char *ramd_http_method_name(ramd_http_method_t method);
+static void ramd_http_watch_render(ramd_http_request_t *request, ramd_http_response_t *response,
+								   bool may_wait);
+static void ramd_http_logs_render(ramd_http_request_t *request, ramd_http_response_t *response,
+								  bool may_wait);
+static void ramd_http_view_cache_clear(void);
+static const char *ramd_http_node_state_name(ramd_node_state_t state);
+static void ramd_http_run_failover(ramd_http_request_t *request, ramd_http_response_t *response);
+static void ramd_http_run_bootstrap_primary(ramd_http_request_t *request,
+											ramd_http_response_t *response);
+static void ramd_http_run_add_replica(ramd_http_request_t *request, ramd_http_response_t *response);
+static void ramd_http_run_rolling(ramd_http_request_t *request, ramd_http_response_t *response);
+
+/*
+ * Readiness notification: epoll on Linux, kqueue on the BSDs and macOS.
+ * Only what the event loop needs is abstracted; every registration carries
+ * a pointer that comes back with its events.
+ */
+typedef struct ramd_http_event_t
+{
+	void* ptr;
+	bool  readable;
+	bool  writable;
+	bool  failed;
+} ramd_http_event_t;
+
+static int
+ramd_http_poller_create(void)
+{
+	int fd;
+
+#ifdef RAMD_HTTP_USE_EPOLL
+	fd = epoll_create1(EPOLL_CLOEXEC);
+#else
+	fd = kqueue();
+	if (fd >= 0)
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+	return fd;
+}
+
+static bool
+ramd_http_poller_set(int poll_fd, int fd, void *ptr, bool want_read,
+					 bool want_write, bool add)
+{
+#ifdef RAMD_HTTP_USE_EPOLL
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (want_read ? EPOLLIN : 0) | (want_write ? EPOLLOUT : 0);
+	ev.data.ptr = ptr;
+	return epoll_ctl(poll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+#else
+	struct kevent changes[2];
+
+	(void) add;
+	EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | (want_read ? EV_ENABLE : EV_DISABLE),
+		   0, 0, ptr);
+	EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | (want_write ? EV_ENABLE : EV_DISABLE),
+		   0, 0, ptr);
+	return kevent(poll_fd, changes, 2, NULL, 0, NULL) == 0;
+#endif
+}
+
+static void
+ramd_http_poller_remove(int poll_fd, int fd)
+{
+#ifdef RAMD_HTTP_USE_EPOLL
+	epoll_ctl(poll_fd, EPOLL_CTL_DEL, fd, NULL);
+#else
+	struct kevent changes[2];
+
+	EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	kevent(poll_fd, changes, 2, NULL, 0, NULL);
+#endif
+}
+
+static int
+ramd_http_poller_wait(int poll_fd, ramd_http_event_t *events, int max_events,
+					  int timeout_ms)
+{
+	int i;
+	int n;
+
+#ifdef RAMD_HTTP_USE_EPOLL
+	struct epoll_event raw[RAMD_HTTP_MAX_EVENTS];
+
+	if (max_events > RAMD_HTTP_MAX_EVENTS)
+		max_events = RAMD_HTTP_MAX_EVENTS;
+	n = epoll_wait(poll_fd, raw, max_events, timeout_ms);
+	for (i = 0; i < n; i++)
+	{
+		events[i].ptr = raw[i].data.ptr;
+		events[i].readable = (raw[i].events & EPOLLIN) != 0;
+		events[i].writable = (raw[i].events & EPOLLOUT) != 0;
+		events[i].failed = (raw[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+	}
+#else
+	struct kevent   raw[RAMD_HTTP_MAX_EVENTS];
+	struct timespec ts;
+
+	if (max_events > RAMD_HTTP_MAX_EVENTS)
+		max_events = RAMD_HTTP_MAX_EVENTS;
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+	n = kevent(poll_fd, NULL, 0, raw, max_events, &ts);
+	for (i = 0; i < n; i++)
+	{
+		events[i].ptr = raw[i].udata;
+		/* EOF is reported as readable so that recv() observes it */
+		events[i].readable = raw[i].filter == EVFILT_READ;
+		events[i].writable = raw[i].filter == EVFILT_WRITE;
+		events[i].failed = (raw[i].flags & EV_ERROR) != 0;
+	}
+#endif
+	return n;
+}
+
+static bool
+ramd_http_set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		return false;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return true;
+}
+
+/* Watch feed subscriber: the event loop answers parked requests when woken */
+static void
+ramd_http_server_wake(const ramd_watch_event_t *events, int32_t count, void *arg)
+{
+	ramd_http_server_t *server = (ramd_http_server_t *) arg;
+
+	(void) events;
+	(void) count;
+
+	if (write(server->wake_fd[1], "w", 1) < 0 && errno != EAGAIN)
+		ramd_log_warning("Failed to wake HTTP server thread: %s", strerror(errno));
+}
+
+/* Log store listener; runs on the log writer thread, so it must not log */
+static void
+ramd_http_server_wake_logs(void *arg)
+{
+	ramd_http_server_t *server = (ramd_http_server_t *) arg;
+
+	/* A full pipe means the loop is due to wake anyway */
+	if (write(server->wake_fd[1], "l", 1) < 0)
+		return;
+}
 
 bool
 ramd_http_server_init(ramd_http_server_t *server, const char *bind_address, int port)
@@ -122,6 +314,14 @@ ramd_http_server_init(ramd_http_server_t *server, const char *bind_address, int
 		server->bind_address[0] = '\0';
 
 	server->listen_fd = -1;
+	server->pending_listen_fd = -1;
+	server->unix_fd = -1;
+	if (g_ramd_daemon->config.http_unix_socket_dir[0] != '\0')
+		snprintf(server->unix_path, sizeof(server->unix_path), "%s/" RAMD_HTTP_UNIX_SOCKET_NAME,
+				 g_ramd_daemon->config.http_unix_socket_dir, server->port);
+	server->poll_fd = -1;
+	server->wake_fd[0] = -1;
+	server->wake_fd[1] = -1;
 	server->running = false;
 	server->auth_enabled = false;
 
@@ -131,92 +331,361 @@ ramd_http_server_init(ramd_http_server_t *server, const char *bind_address, int
 		return false;
 	}
 
+	if (pthread_cond_init(&server->work_cond, NULL) != 0)
+	{
+		ramd_log_error("Failed to initialize HTTP server condition variable");
+		pthread_mutex_destroy(&server->mutex);
+		return false;
+	}
+
 	ramd_log_info("HTTP API server initialized on %s:%d", server->bind_address, server->port);
 	return true;
 }
 
-bool
-ramd_http_server_start(ramd_http_server_t *server)
+/* Release everything ramd_http_server_start() created, in reverse order */
+static void
+ramd_http_server_release(ramd_http_server_t *server)
+{
+	int i;
+
+	if (server->listen_fd >= 0)
+	{
+		close(server->listen_fd);
+		server->listen_fd = -1;
+	}
+	if (server->pending_listen_fd >= 0)
+	{
+		close(server->pending_listen_fd);
+		server->pending_listen_fd = -1;
+	}
+	if (server->unix_fd >= 0)
+	{
+		close(server->unix_fd);
+		server->unix_fd = -1;
+		unlink(server->unix_path);
+	}
+	if (server->poll_fd >= 0)
+	{
+		close(server->poll_fd);
+		server->poll_fd = -1;
+	}
+	for (i = 0; i < 2; i++)
+	{
+		if (server->wake_fd[i] >= 0)
+		{
+			close(server->wake_fd[i]);
+			server->wake_fd[i] = -1;
+		}
+	}
+
+	if (server->connections)
+	{
+		for (i = 0; i < RAMD_HTTP_MAX_CONNECTIONS; i++)
+		{
+			if (server->connections[i].ssl)
+				SSL_free(server->connections[i].ssl);
+			ramd_mem_free(RAMD_MEM_HTTP, server->connections[i].in_buf);
+			ramd_http_response_reset(&server->connections[i].response);
+			ramd_buffer_free(&server->connections[i].response.content);
+			ramd_arena_destroy(&server->connections[i].arena);
+		}
+	}
+	ramd_mem_free(RAMD_MEM_HTTP, server->connections);
+	server->connections = NULL;
+	server->free_list = NULL;
+	server->work_head = server->work_tail = server->done_head = NULL;
+	server->active_connections = 0;
+}
+
+/*
+ * Open a non-blocking listening socket.  SO_REUSEPORT lets a replacement
+ * bind the same port while the current one is still accepting.
+ */
+static int
+ramd_http_server_listen(const char *bind_address, int port)
 {
 	struct sockaddr_in server_addr;
 	int                opt = 1;
+	int                fd;
 
-	if (!server)
-		return false;
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sin_family = AF_INET;
+	server_addr.sin_port = htons((uint16_t) port);
 
-	server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-	if (server->listen_fd < 0)
+	if (inet_pton(AF_INET, bind_address, &server_addr.sin_addr) <= 0)
+	{
+		ramd_log_error("Invalid bind address: %s", bind_address);
+		return -1;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
 	{
 		ramd_log_error("Failed to create HTTP server socket: %s", strerror(errno));
-		return false;
+		return -1;
 	}
 
-	if (setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
 		ramd_log_warning("Failed to set SO_REUSEADDR: %s", strerror(errno));
+#ifdef SO_REUSEPORT
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0)
+		ramd_log_warning("Failed to set SO_REUSEPORT: %s", strerror(errno));
+#endif
 
-	memset(&server_addr, 0, sizeof(server_addr));
-	server_addr.sin_family = AF_INET;
-	server_addr.sin_port = htons((uint16_t) server->port);
+	if (bind(fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0)
+	{
+		ramd_log_error("Failed to bind HTTP server socket to %s:%d: %s",
+					   bind_address, port, strerror(errno));
+		close(fd);
+		return -1;
+	}
 
-	if (inet_pton(AF_INET, server->bind_address, &server_addr.sin_addr) <= 0)
+	if (listen(fd, RAMD_HTTP_MAX_CONNECTIONS) < 0 || !ramd_http_set_nonblocking(fd))
 	{
-		ramd_log_error("Invalid bind address: %s", server->bind_address);
-		close(server->listen_fd);
-		return false;
+		ramd_log_error("Failed to listen on HTTP server socket: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Open the local control socket.  A socket file left behind by a daemon
+ * that died is replaced, one that still answers is not.  Anyone may
+ * connect; ramd_http_peer_trusted() decides who skips authentication.
+ */
+static int
+ramd_http_server_listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat        st;
+	int                fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		ramd_log_error("Unix socket path too long: %s", path);
+		return -1;
 	}
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
 
-	if (bind(server->listen_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0)
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
 	{
-		ramd_log_error("Failed to bind HTTP server socket: %s", strerror(errno));
-		close(server->listen_fd);
+		ramd_log_error("Failed to create Unix socket: %s", strerror(errno));
+		return -1;
+	}
+
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+	{
+		if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+		{
+			ramd_log_error("Unix socket %s is in use by another ramd", path);
+			close(fd);
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+	{
+		ramd_log_error("Failed to bind Unix socket %s: %s", path, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	if (chmod(path, 0777) < 0 || listen(fd, RAMD_HTTP_MAX_CONNECTIONS) < 0 ||
+		!ramd_http_set_nonblocking(fd))
+	{
+		ramd_log_error("Failed to listen on Unix socket %s: %s", path, strerror(errno));
+		close(fd);
+		unlink(path);
+		return -1;
+	}
+	return fd;
+}
+
+/* Root and the user this daemon runs as are trusted like the daemon itself */
+static bool
+ramd_http_peer_trusted(int fd)
+{
+	uid_t uid;
+
+#if defined(SO_PEERCRED)
+	struct ucred cred;
+	socklen_t    len = sizeof(cred);
+
+	if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+		return false;
+	uid = cred.uid;
+#else
+	gid_t gid;
+
+	if (getpeereid(fd, &uid, &gid) != 0)
+		return false;
+#endif
+	return uid == 0 || uid == geteuid();
+}
+
+bool
+ramd_http_server_start(ramd_http_server_t *server)
+{
+	int i;
+
+	if (!server)
+		return false;
+
+	server->listen_fd = ramd_http_server_listen(server->bind_address, server->port);
+	if (server->listen_fd < 0)
+		return false;
+
+	server->connections = ramd_mem_calloc(RAMD_MEM_HTTP, RAMD_HTTP_MAX_CONNECTIONS,
+									  sizeof(ramd_http_connection_t));
+	if (!server->connections)
+	{
+		ramd_log_error("Failed to allocate HTTP connection pool");
+		ramd_http_server_release(server);
 		return false;
 	}
+	for (i = RAMD_HTTP_MAX_CONNECTIONS - 1; i >= 0; i--)
+	{
+		server->connections[i].client_fd = -1;
+		server->connections[i].server = server;
+		ramd_buffer_init_subsystem(&server->connections[i].response.content, RAMD_MEM_HTTP);
+		ramd_arena_init(&server->connections[i].arena, RAMD_MEM_HTTP, RAMD_HTTP_ARENA_CHUNK_SIZE);
+		server->connections[i].next = server->free_list;
+		server->free_list = &server->connections[i];
+	}
 
-	if (listen(server->listen_fd, RAMD_HTTP_MAX_CONNECTIONS) < 0)
+	server->poll_fd = ramd_http_poller_create();
+	if (server->poll_fd < 0 || pipe(server->wake_fd) != 0 ||
+		!ramd_http_set_nonblocking(server->wake_fd[0]) ||
+		!ramd_http_set_nonblocking(server->wake_fd[1]) ||
+		!ramd_http_poller_set(server->poll_fd, server->listen_fd, server, true, false, true) ||
+		!ramd_http_poller_set(server->poll_fd, server->wake_fd[0], server->wake_fd, true, false, true))
 	{
-		ramd_log_error("Failed to listen on HTTP server socket: %s", strerror(errno));
-		close(server->listen_fd);
+		ramd_log_error("Failed to set up HTTP event loop: %s", strerror(errno));
+		ramd_http_server_release(server);
 		return false;
 	}
 
+	/* Local tools fall back to TCP without it, so it is not fatal */
+	if (server->unix_path[0] != '\0')
+	{
+		server->unix_fd = ramd_http_server_listen_unix(server->unix_path);
+		if (server->unix_fd >= 0 &&
+			!ramd_http_poller_set(server->poll_fd, server->unix_fd, &server->unix_fd,
+								  true, false, true))
+		{
+			ramd_log_error("Failed to register Unix socket: %s", strerror(errno));
+			close(server->unix_fd);
+			server->unix_fd = -1;
+			unlink(server->unix_path);
+		}
+	}
+
 	server->running = true;
-	if (pthread_create(&server->server_thread, NULL, ramd_http_server_thread, server) != 0)
+	for (i = 0; i < RAMD_HTTP_WORKER_THREADS; i++)
+	{
+		if (pthread_create(&server->workers[i], NULL, ramd_http_worker_thread, server) != 0)
+			break;
+		server->worker_count++;
+	}
+	if (server->worker_count == 0 ||
+		pthread_create(&server->server_thread, NULL, ramd_http_server_thread, server) != 0)
 	{
-		ramd_log_error("Failed to create HTTP server thread");
+		ramd_log_error("Failed to create HTTP server threads");
+		pthread_mutex_lock(&server->mutex);
 		server->running = false;
-		close(server->listen_fd);
+		pthread_cond_broadcast(&server->work_cond);
+		pthread_mutex_unlock(&server->mutex);
+		for (i = 0; i < server->worker_count; i++)
+			pthread_join(server->workers[i], NULL);
+		server->worker_count = 0;
+		ramd_http_server_release(server);
 		return false;
 	}
 
 	g_http_server = server;
-	ramd_log_info("HTTP API server started on %s:%d", server->bind_address, server->port);
+	if (!ramd_watch_subscribe(ramd_http_server_wake, server))
+		ramd_log_warning("HTTP API: no room to follow cluster changes; watch requests "
+						 "are answered when their wait ends");
+	ramd_log_store_set_listener(ramd_http_server_wake_logs, server);
+	ramd_log_info("HTTP API server started on %s:%d (%d workers)",
+				  server->bind_address, server->port, server->worker_count);
+	if (server->unix_fd >= 0)
+		ramd_log_info("HTTP API also listening on %s", server->unix_path);
 	return true;
 }
 
 void
 ramd_http_server_stop(ramd_http_server_t *server)
 {
+	int i;
+
 	if (!server || !server->running)
 		return;
 
 	ramd_log_info("Stopping HTTP API server");
 
+	ramd_watch_unsubscribe(ramd_http_server_wake, server);
+	ramd_log_store_set_listener(NULL, NULL);
+
 	pthread_mutex_lock(&server->mutex);
 	server->running = false;
+	pthread_cond_broadcast(&server->work_cond);
 	pthread_mutex_unlock(&server->mutex);
 
-	if (server->listen_fd >= 0)
-	{
-		close(server->listen_fd);
-		server->listen_fd = -1;
-	}
+	if (write(server->wake_fd[1], "x", 1) < 0 && errno != EAGAIN)
+		ramd_log_warning("Failed to wake HTTP server thread: %s", strerror(errno));
 
 	pthread_join(server->server_thread, NULL);
+	for (i = 0; i < server->worker_count; i++)
+		pthread_join(server->workers[i], NULL);
+	server->worker_count = 0;
+
+	ramd_http_server_release(server);
+	ramd_http_view_cache_clear();
 
 	g_http_server = NULL;
 	ramd_log_info("HTTP API server stopped");
 }
 
+bool
+ramd_http_server_rebind(ramd_http_server_t *server, const char *bind_address, int port)
+{
+	int fd;
+
+	if (!server || !bind_address || port <= 0)
+		return false;
+
+	fd = ramd_http_server_listen(bind_address, port);
+	if (fd < 0)
+		return false;
+
+	pthread_mutex_lock(&server->mutex);
+	if (!server->running)
+	{
+		pthread_mutex_unlock(&server->mutex);
+		close(fd);
+		return false;
+	}
+	if (server->pending_listen_fd >= 0)
+		close(server->pending_listen_fd);
+	server->pending_listen_fd = fd;
+	strncpy(server->bind_address, bind_address, sizeof(server->bind_address) - 1);
+	server->bind_address[sizeof(server->bind_address) - 1] = '\0';
+	server->port = port;
+	pthread_mutex_unlock(&server->mutex);
+
+	if (write(server->wake_fd[1], "l", 1) < 0 && errno != EAGAIN)
+		ramd_log_warning("Failed to wake HTTP server thread: %s", strerror(errno));
+
+	ramd_log_info("HTTP API server moving to %s:%d", bind_address, port);
+	return true;
+}
+
 void
 ramd_http_server_cleanup(ramd_http_server_t *server)
 {
@@ -224,310 +693,1286 @@ ramd_http_server_cleanup(ramd_http_server_t *server)
 		return;
 
 	ramd_http_server_stop(server);
+	pthread_cond_destroy(&server->work_cond);
 	pthread_mutex_destroy(&server->mutex);
 }
 
-static void *
-ramd_http_server_thread(void *arg)
+/* Loopback clients, like those on the Unix socket, are served without TLS */
+static bool
+ramd_http_is_loopback(const struct sockaddr_in *addr)
 {
-	ramd_http_server_t     *server = (ramd_http_server_t *) arg;
-	struct sockaddr_in      client_addr;
-	socklen_t              client_len = sizeof(client_addr);
-	int                    client_fd;
-	pthread_t              connection_thread;
-	ramd_http_connection_t *connection;
-
-	ramd_log_debug("HTTP server thread started");
+	return (ntohl(addr->sin_addr.s_addr) >> 24) == 127;
+}
 
-	while (server->running)
+/*
+ * SSL_read_ex() and SSL_write_ex() reported like recv() and writev(): -1
+ * with EAGAIN while the record layer waits for the socket.  A read may
+ * have to write first and a write read first (the handshake, a TLS 1.3
+ * key update), so the socket is then watched for the other direction
+ * until the call gets through.
+ */
+static ssize_t
+ramd_http_tls_io(ramd_http_connection_t *conn, void *buf, size_t len, bool writing)
+{
+	size_t done = 0;
+	int    ret;
+	int    err;
+	bool   want_read;
+
+	ERR_clear_error();
+	if (writing)
+		ret = SSL_write_ex(conn->ssl, buf, len, &done);
+	else
+		ret = SSL_read_ex(conn->ssl, buf, len, &done);
+	if (ret == 1)
 	{
-		client_fd = accept(server->listen_fd, (struct sockaddr *) &client_addr, &client_len);
-		if (client_fd < 0)
+		if (!conn->tls_established && SSL_is_init_finished(conn->ssl))
 		{
-			if (server->running && errno != EINTR)
-				ramd_log_error("HTTP accept failed: %s", strerror(errno));
-			continue;
+			conn->tls_established = true;
+			ramd_tls_note_handshake(conn->ssl);
 		}
-
-		connection = malloc(sizeof(ramd_http_connection_t));
-		if (!connection)
+		if (conn->tls_flipped)
 		{
-			ramd_log_error("Failed to allocate connection structure");
-			close(client_fd);
-			continue;
+			conn->tls_flipped = false;
+			if (!ramd_http_poller_set(conn->server->poll_fd, conn->client_fd, conn,
+									  !writing, writing, false))
+			{
+				conn->tls_failed = true;
+				errno = EIO;
+				return -1;
+			}
 		}
+		return (ssize_t) done;
+	}
 
-		connection->client_fd = client_fd;
-		connection->client_addr = client_addr;
-		connection->server = server;
-
-		if (pthread_create(&connection_thread, NULL, ramd_http_connection_handler, connection) != 0)
+	err = SSL_get_error(conn->ssl, ret);
+	if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE)
+	{
+		want_read = err == SSL_ERROR_WANT_READ;
+		if (want_read == writing || conn->tls_flipped)
 		{
-			ramd_log_error("Failed to create connection handler thread");
-			close(client_fd);
-			free(connection);
-			continue;
+			conn->tls_flipped = want_read == writing;
+			if (!ramd_http_poller_set(conn->server->poll_fd, conn->client_fd, conn,
+									  want_read, !want_read, false))
+			{
+				conn->tls_failed = true;
+				errno = EIO;
+				return -1;
+			}
 		}
-
-		pthread_detach(connection_thread);
+		errno = EAGAIN;
+		return -1;
 	}
+	if (err == SSL_ERROR_ZERO_RETURN)
+		return 0;
 
-	ramd_log_debug("HTTP server thread stopped");
-	return NULL;
+	conn->tls_failed = true;
+	ERR_clear_error();
+	errno = ECONNRESET;
+	return -1;
 }
 
-static void *
-ramd_http_connection_handler(void *arg)
+static void
+ramd_http_connection_close(ramd_http_connection_t *conn)
 {
-	ramd_http_connection_t *connection = (ramd_http_connection_t *) arg;
-	char                   buffer[RAMD_MAX_COMMAND_LENGTH];
-	ssize_t                bytes_read;
-	ramd_http_request_t    request;
-	ramd_http_response_t   response;
+	ramd_http_server_t *server = conn->server;
+
+	if (conn->state == RAMD_HTTP_CONN_FREE)
+		return;
 
-	bytes_read = recv(connection->client_fd, buffer, sizeof(buffer) - 1, 0);
-	if (bytes_read <= 0)
+	ramd_http_poller_remove(server->poll_fd, conn->client_fd);
+	if (conn->ssl)
 	{
-		close(connection->client_fd);
-		free(connection);
-		return NULL;
+		/* close_notify if the socket takes it now; a broken session gets none */
+		if (conn->tls_established && !conn->tls_failed)
+			(void) SSL_shutdown(conn->ssl);
+		ERR_clear_error();
+		SSL_free(conn->ssl);
+		conn->ssl = NULL;
 	}
+	close(conn->client_fd);
+	conn->client_fd = -1;
+	conn->state = RAMD_HTTP_CONN_FREE;
 
-	buffer[bytes_read] = '\0';
-
-	if (!ramd_http_parse_request(buffer, &request))
-		ramd_http_set_error_response(&response, RAMD_HTTP_400_BAD_REQUEST, "Invalid HTTP request");
-	else
-		ramd_http_route_request(&request, &response);
-
-	ramd_http_send_response(connection->client_fd, &response);
+	/* A request that never got its response still leaves the in-flight gauge */
+	if (conn->started_us > 0)
+	{
+		ramd_metrics_http_request_finished(g_ramd_metrics, 0,
+										   ramd_clock_now_us() - conn->started_us);
+		conn->started_us = 0;
+	}
+	ramd_http_response_reset(&conn->response);
+	ramd_arena_reset(&conn->arena);
 
-	close(connection->client_fd);
-	free(connection);
-	return NULL;
+	/* Give back memory taken by a bulk request */
+	if (conn->in_cap > RAMD_HTTP_INITIAL_BUFFER_SIZE)
+	{
+		ramd_mem_free(RAMD_MEM_HTTP, conn->in_buf);
+		conn->in_buf = NULL;
+		conn->in_cap = 0;
+	}
+	conn->next = server->free_list;
+	server->free_list = conn;
+	server->active_connections--;
 }
 
-bool
-ramd_http_parse_request(const char *raw_request, ramd_http_request_t *request)
+/*
+ * Handlers on this list change cluster state, talk to other nodes or run
+ * external commands, so they go to the worker pool.  Everything else only
+ * reads in-memory state and runs on the event loop.  A CPU profile is a
+ * GET but holds its thread for the whole duration.
+ */
+static bool
+ramd_http_is_slow_request(const ramd_http_request_t *request)
 {
-	char *line;
-	char *method_str;
-	char *path_str;
-	char *version_str __attribute__((unused));
-	char *saveptr;
-	char *request_copy;
-	char *query;
+	return (request->method != RAMD_HTTP_GET && request->method != RAMD_HTTP_HEAD) ||
+		strncmp(request->path, "/api/v1/debug/pprof/", 20) == 0;
+}
 
-	if (!raw_request || !request)
-		return false;
+/* Format the headers and start sending them together with the body */
+static void
+ramd_http_connection_respond(ramd_http_connection_t *conn)
+{
+	ssize_t len;
 
-	memset(request, 0, sizeof(ramd_http_request_t));
+	if (conn->requests_served + 1 >= RAMD_HTTP_KEEPALIVE_MAX_REQUESTS)
+		conn->keep_alive = false;
 
-	request_copy = strdup(raw_request);
-	if (!request_copy)
-		return false;
+	if (conn->started_us > 0)
+	{
+		conn->request.profile.total_us = ramd_clock_now_us() - conn->started_us;
+		ramd_metrics_http_request_finished(g_ramd_metrics, conn->response.status,
+										   conn->request.profile.total_us);
+		conn->started_us = 0;
+	}
 
-	line = strtok_r(request_copy, "\r\n", &saveptr);
-	if (!line)
+	conn->out_body = ramd_http_response_body(&conn->response, &conn->out_body_len);
+	len = ramd_http_format_head(&conn->response, conn->keep_alive, conn->out_body_len,
+								conn->out_head, sizeof(conn->out_head));
+	if (len < 0)
 	{
-		free(request_copy);
-		return false;
+		ramd_http_connection_close(conn);
+		return;
 	}
 
-	method_str = strtok(line, " ");
-	path_str = strtok(NULL, " ");
-	version_str = strtok(NULL, " ");
+	/* HEAD gets the same headers, Content-Length included, and no body */
+	if (conn->request.method == RAMD_HTTP_HEAD)
+		conn->out_body_len = 0;
 
-	if (!method_str || !path_str)
+	conn->out_head_len = (size_t) len;
+	if (conn->request.profile.routed && !conn->request.profile.recorded)
 	{
-		free(request_copy);
-		return false;
+		conn->request.profile.recorded = true;
+		ramd_http_profile_record(ramd_http_method_name(conn->request.method),
+								 conn->request.path, conn->response.status,
+								 &conn->request.profile, conn->request_len,
+								 conn->out_head_len + conn->out_body_len);
 	}
+	conn->out_sent = 0;
+	conn->state = RAMD_HTTP_CONN_WRITING;
+	conn->deadline_ms = ramd_clock_now_ms() + RAMD_HTTP_IO_TIMEOUT_MS;
+	ramd_http_connection_write(conn);
+}
 
-	if (strcmp(method_str, "GET") == 0)
-		request->method = RAMD_HTTP_GET;
-	else if (strcmp(method_str, "POST") == 0)
-		request->method = RAMD_HTTP_POST;
-	else if (strcmp(method_str, "PUT") == 0)
-		request->method = RAMD_HTTP_PUT;
-	else if (strcmp(method_str, "DELETE") == 0)
-		request->method = RAMD_HTTP_DELETE;
-	else if (strcmp(method_str, "PATCH") == 0)
-		request->method = RAMD_HTTP_PATCH;
-	else
+/*
+ * Send what is left of the headers and the body with one writev() per
+ * wakeup; the body is never copied into a connection buffer.  Over TLS
+ * each piece is its own SSL_write_ex(), and a body that fits behind the
+ * headers is copied there so a small response is one record.
+ */
+static void
+ramd_http_connection_write(ramd_http_connection_t *conn)
+{
+	struct iovec iov[2];
+	int          iovcnt;
+	size_t       total;
+	size_t       body_offset;
+	ssize_t      n;
+
+	if (conn->ssl && conn->out_sent == 0 && conn->out_body_len > 0 &&
+		conn->out_head_len + conn->out_body_len <= sizeof(conn->out_head))
 	{
-		free(request_copy);
-		return false;
+		memcpy(conn->out_head + conn->out_head_len, conn->out_body, conn->out_body_len);
+		conn->out_head_len += conn->out_body_len;
+		conn->out_body_len = 0;
 	}
+	total = conn->out_head_len + conn->out_body_len;
 
-	query = strchr(path_str, '?');
-	if (query)
+	while (conn->out_sent < total)
 	{
-		*query = '\0';
-		query++;
-		strncpy(request->query_string, query, sizeof(request->query_string) - 1);
+		iovcnt = 0;
+		if (conn->out_sent < conn->out_head_len)
+		{
+			iov[iovcnt].iov_base = conn->out_head + conn->out_sent;
+			iov[iovcnt].iov_len = conn->out_head_len - conn->out_sent;
+			iovcnt++;
+			body_offset = 0;
+		}
+		else
+			body_offset = conn->out_sent - conn->out_head_len;
+
+		if (body_offset < conn->out_body_len)
+		{
+			iov[iovcnt].iov_base = (void *) (conn->out_body + body_offset);
+			iov[iovcnt].iov_len = conn->out_body_len - body_offset;
+			iovcnt++;
+		}
+
+		if (conn->ssl)
+			n = ramd_http_tls_io(conn, iov[0].iov_base, iov[0].iov_len, true);
+		else
+			n = writev(conn->client_fd, iov, iovcnt);
+		if (n > 0)
+		{
+			conn->out_sent += (size_t) n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			if (!conn->tls_flipped &&
+				!ramd_http_poller_set(conn->server->poll_fd, conn->client_fd, conn,
+									  false, true, false))
+				ramd_http_connection_close(conn);
+			return;
+		}
+		ramd_http_connection_close(conn);
+		return;
+	}
+
+	ramd_http_connection_finish(conn);
+}
+
+/*
+ * The response is out: close, or keep the connection for the next request.
+ * Bytes after the current request are a pipelined request and are kept.
+ */
+static void
+ramd_http_connection_finish(ramd_http_connection_t *conn)
+{
+	conn->out_body = NULL;
+	conn->out_body_len = 0;
+	ramd_http_response_reset(&conn->response);
+	ramd_arena_reset(&conn->arena);
+
+	if (!conn->keep_alive)
+	{
+		ramd_http_connection_close(conn);
+		return;
+	}
+
+	conn->in_buf[conn->request_len] = conn->saved_byte;
+	conn->in_len -= conn->request_len;
+	memmove(conn->in_buf, conn->in_buf + conn->request_len, conn->in_len);
+	conn->in_buf[conn->in_len] = '\0';
+	conn->request_len = 0;
+	memset(&conn->parser, 0, sizeof(conn->parser));
+	conn->requests_served++;
+	conn->state = RAMD_HTTP_CONN_READING;
+	conn->deadline_ms = ramd_clock_now_ms() + RAMD_HTTP_KEEPALIVE_TIMEOUT_MS;
+
+	if (!ramd_http_poller_set(conn->server->poll_fd, conn->client_fd, conn,
+							  true, false, false))
+	{
+		ramd_http_connection_close(conn);
+		return;
+	}
+
+	if (conn->in_len > 0 && ramd_http_connection_next(conn))
+		return;
+
+	/* Bytes OpenSSL has already decrypted never show up in the poller */
+	if (conn->ssl && SSL_pending(conn->ssl) > 0)
+		ramd_http_connection_read(conn);
+}
+
+static void
+ramd_http_connection_reject(ramd_http_connection_t *conn,
+							ramd_http_status_code_t status, const char *message)
+{
+	ramd_http_response_reset(&conn->response);
+	ramd_http_set_error_response(&conn->response, status, message);
+	conn->keep_alive = false;
+	ramd_http_connection_respond(conn);
+}
+
+/*
+ * Hold a watch request until the feed moves past the version it asked
+ * about or its wait runs out.  The socket stays registered with no events
+ * wanted, so a reset is still noticed; otherwise the deadline frees it.
+ */
+static void
+ramd_http_connection_park(ramd_http_connection_t *conn)
+{
+	if (!ramd_http_poller_set(conn->server->poll_fd, conn->client_fd, conn,
+							  false, false, false))
+	{
+		ramd_http_connection_close(conn);
+		return;
+	}
+
+	/* The handler has finished; time spent waiting is not request latency */
+	if (conn->started_us > 0)
+	{
+		conn->request.profile.total_us = ramd_clock_now_us() - conn->started_us;
+		ramd_metrics_http_request_finished(g_ramd_metrics, RAMD_HTTP_200_OK,
+										   conn->request.profile.total_us);
+		conn->started_us = 0;
+	}
+
+	conn->state = RAMD_HTTP_CONN_PARKED;
+	conn->deadline_ms = ramd_clock_now_ms() + conn->response.watch_wait_ms;
+}
+
+static void
+ramd_http_connection_dispatch(ramd_http_connection_t *conn)
+{
+	ramd_http_server_t *server = conn->server;
+	ramd_http_parser_t *parser = &conn->parser;
+
+	ramd_http_response_reset(&conn->response);
+	conn->started_us = ramd_clock_now_us();
+	ramd_metrics_http_request_started(g_ramd_metrics);
+
+	/*
+	 * Terminate the body in place.  A pipelined request may start right
+	 * behind it, so the byte there is saved and put back once we are done.
+	 */
+	conn->saved_byte = conn->in_buf[conn->request_len];
+	conn->in_buf[conn->request_len] = '\0';
+	conn->in_buf[parser->header_len + parser->body_len] = '\0';
+
+	if (!ramd_http_parse_request(conn->in_buf, parser->header_len, &conn->request))
+	{
+		ramd_http_connection_reject(conn, RAMD_HTTP_400_BAD_REQUEST, "Invalid HTTP request");
+		return;
+	}
+	conn->request.body = conn->in_buf + parser->header_len;
+	conn->request.body_length = parser->body_len;
+	conn->request.arena = &conn->arena;
+	conn->keep_alive = conn->request.keep_alive;
+	conn->request.peer_trusted = conn->peer_trusted;
+	if (conn->local || !inet_ntop(AF_INET, &conn->client_addr.sin_addr, conn->request.client_ip,
+								  sizeof(conn->request.client_ip)))
+		conn->request.client_ip[0] = '\0';
+
+	if (!ramd_http_is_slow_request(&conn->request))
+	{
+		ramd_http_route_request(&conn->request, &conn->response);
+		if (conn->response.watch_wait_ms > 0)
+			ramd_http_connection_park(conn);
+		else
+			ramd_http_connection_respond(conn);
+		return;
 	}
 
-	strncpy(request->path, path_str, sizeof(request->path) - 1);
+	/*
+	 * Stop watching the socket while a worker owns the request; a hangup
+	 * would otherwise be reported on every loop iteration.
+	 */
+	ramd_http_poller_remove(server->poll_fd, conn->client_fd);
+	conn->state = RAMD_HTTP_CONN_DISPATCHED;
+	conn->next = NULL;
+
+	pthread_mutex_lock(&server->mutex);
+	if (server->work_tail)
+		server->work_tail->next = conn;
+	else
+		server->work_head = conn;
+	server->work_tail = conn;
+	pthread_cond_signal(&server->work_cond);
+	pthread_mutex_unlock(&server->mutex);
+}
 
-	while ((line = strtok_r(NULL, "\r\n", &saveptr)) != NULL)
+/* Start the next buffered request if it is complete; false to keep reading */
+static bool
+ramd_http_connection_next(ramd_http_connection_t *conn)
+{
+	switch (ramd_http_parser_feed(&conn->parser, conn->in_buf, conn->in_len))
 	{
-		if (strlen(line) == 0)
+		case RAMD_HTTP_PARSE_DONE:
 			break;
+		case RAMD_HTTP_PARSE_ERROR:
+			ramd_http_connection_reject(conn, conn->parser.error,
+										conn->parser.error == RAMD_HTTP_413_PAYLOAD_TOO_LARGE ?
+										"Request too large" : "Invalid HTTP request");
+			return true;
+		default:
+			return false;
+	}
+
+	conn->request_len = conn->parser.scan_pos;
+	conn->deadline_ms = ramd_clock_now_ms() + RAMD_HTTP_IO_TIMEOUT_MS;
+	ramd_http_connection_dispatch(conn);
+	return true;
+}
+
+/* Make room for at least one more byte plus the terminator */
+static bool
+ramd_http_connection_reserve(ramd_http_connection_t *conn)
+{
+	size_t new_cap;
+	char  *new_buf;
+
+	if (conn->in_len + 1 < conn->in_cap)
+		return true;
+
+	if (conn->in_cap > RAMD_HTTP_MAX_REQUEST_SIZE)
+		return false;
+
+	new_cap = conn->in_cap ? conn->in_cap * 2 : RAMD_HTTP_INITIAL_BUFFER_SIZE;
+	if (new_cap > RAMD_HTTP_MAX_REQUEST_SIZE + 1)
+		new_cap = RAMD_HTTP_MAX_REQUEST_SIZE + 1;
+
+	new_buf = ramd_mem_realloc(RAMD_MEM_HTTP, conn->in_buf, new_cap);
+	if (!new_buf)
+		return false;
 
-		if (strncasecmp(line, "Authorization:", 14) == 0)
+	conn->in_buf = new_buf;
+	conn->in_cap = new_cap;
+	return true;
+}
+
+static void
+ramd_http_connection_read(ramd_http_connection_t *conn)
+{
+	ssize_t n;
+
+	while (conn->state == RAMD_HTTP_CONN_READING)
+	{
+		if (!ramd_http_connection_reserve(conn))
+		{
+			ramd_http_connection_reject(conn, RAMD_HTTP_413_PAYLOAD_TOO_LARGE, "Request too large");
+			return;
+		}
+
+		if (conn->ssl)
+			n = ramd_http_tls_io(conn, conn->in_buf + conn->in_len,
+								 conn->in_cap - 1 - conn->in_len, false);
+		else
+			n = recv(conn->client_fd, conn->in_buf + conn->in_len,
+					 conn->in_cap - 1 - conn->in_len, 0);
+		if (n > 0)
 		{
-			strncpy(request->authorization, line + 14, sizeof(request->authorization) - 1);
-			char *auth = request->authorization;
-			while (*auth == ' ' || *auth == '\t')
-				auth++;
-			memmove(request->authorization, auth, strlen(auth) + 1);
+			conn->in_len += (size_t) n;
+			conn->in_buf[conn->in_len] = '\0';
+			if (ramd_http_connection_next(conn))
+				return;
+			continue;
 		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+
+		ramd_http_connection_close(conn);
+		return;
 	}
+}
+
+/* Accept all queued clients on listen_fd; local is set for the Unix socket */
+static void
+ramd_http_server_accept(ramd_http_server_t *server, int listen_fd, bool local)
+{
+	ramd_http_connection_t *conn;
+	struct sockaddr_in      client_addr;
+	socklen_t               client_len;
+	int                     client_fd;
+	SSL                    *ssl;
 
-	if (line)
+	for (;;)
 	{
-		char *body_start = line + strlen(line) + 2;
-		if (body_start < raw_request + strlen(raw_request))
+		memset(&client_addr, 0, sizeof(client_addr));
+		client_len = sizeof(client_addr);
+		client_fd = accept(listen_fd, local ? NULL : (struct sockaddr *) &client_addr,
+						   local ? NULL : &client_len);
+		if (client_fd < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK && server->running)
+				ramd_log_error("HTTP accept failed: %s", strerror(errno));
+			return;
+		}
+
+		conn = server->free_list;
+		if (!conn)
+		{
+			ramd_log_warning("HTTP connection limit (%d) reached, rejecting client",
+							 RAMD_HTTP_MAX_CONNECTIONS);
+			close(client_fd);
+			continue;
+		}
+
+		ssl = NULL;
+		if (!local && !ramd_http_is_loopback(&client_addr) && ramd_tls_enabled())
 		{
-			size_t body_len = strlen(body_start);
-			if (body_len < sizeof(request->body))
+			ssl = ramd_tls_session_new(client_fd);
+			if (!ssl)
 			{
-				strncpy(request->body, body_start, body_len);
-				request->body_length = body_len;
+				ramd_log_warning("Rejecting HTTP client: no TLS certificate to serve");
+				close(client_fd);
+				continue;
 			}
 		}
+
+		if (!ramd_http_set_nonblocking(client_fd) ||
+			!ramd_http_poller_set(server->poll_fd, client_fd, conn, true, false, true))
+		{
+			ramd_log_error("Failed to register HTTP client: %s", strerror(errno));
+			if (ssl)
+				SSL_free(ssl);
+			close(client_fd);
+			continue;
+		}
+
+		server->free_list = conn->next;
+		server->active_connections++;
+		conn->next = NULL;
+		conn->client_fd = client_fd;
+		conn->client_addr = client_addr;
+		conn->local = local;
+		conn->peer_trusted = local && ramd_http_peer_trusted(client_fd);
+		conn->ssl = ssl;
+		conn->tls_established = false;
+		conn->tls_failed = false;
+		conn->tls_flipped = false;
+		conn->state = RAMD_HTTP_CONN_READING;
+		conn->in_len = 0;
+		memset(&conn->parser, 0, sizeof(conn->parser));
+		conn->request_len = 0;
+		conn->requests_served = 0;
+		conn->keep_alive = false;
+		conn->deadline_ms = ramd_clock_now_ms() + RAMD_HTTP_IO_TIMEOUT_MS;
 	}
+}
 
-	free(request_copy);
-	return true;
+/*
+ * Answer parked watch requests the feed has moved for, and log follow
+ * requests the store has, or whose wait is over.  A follow request whose
+ * new records all miss its filters stays parked until its deadline.
+ */
+static void
+ramd_http_server_wake_watchers(ramd_http_server_t *server, int64_t now_ms)
+{
+	ramd_http_connection_t *conn;
+	uint64_t                version = ramd_watch_version();
+	uint64_t                newest_log = ramd_log_store_newest();
+	int                     i;
+
+	for (i = 0; i < RAMD_HTTP_MAX_CONNECTIONS; i++)
+	{
+		conn = &server->connections[i];
+		if (conn->state != RAMD_HTTP_CONN_PARKED)
+			continue;
+
+		if (conn->response.watch_logs)
+		{
+			if (conn->response.watch_since >= newest_log && now_ms < conn->deadline_ms)
+				continue;
+			ramd_http_response_reset(&conn->response);
+			ramd_http_logs_render(&conn->request, &conn->response, now_ms < conn->deadline_ms);
+			if (conn->response.watch_wait_ms > 0)
+				continue;
+			ramd_http_connection_respond(conn);
+			continue;
+		}
+
+		if (conn->response.watch_since >= version && now_ms < conn->deadline_ms)
+			continue;
+
+		ramd_http_response_reset(&conn->response);
+		ramd_http_watch_render(&conn->request, &conn->response, false);
+		ramd_http_connection_respond(conn);
+	}
 }
 
+/* Collect responses finished by the worker pool and start sending them */
 static void
-ramd_http_route_request(ramd_http_request_t *request, ramd_http_response_t *response)
+ramd_http_server_drain_workers(ramd_http_server_t *server)
 {
-	/* Security check for all API endpoints */
-	if (strncmp(request->path, "/api/", 5) == 0)
+	ramd_http_connection_t *done;
+	ramd_http_connection_t *next;
+	char                    buf[64];
+	int                     listen_fd;
+
+	while (read(server->wake_fd[0], buf, sizeof(buf)) > 0)
+		;
+
+	pthread_mutex_lock(&server->mutex);
+	done = server->done_head;
+	server->done_head = NULL;
+	listen_fd = server->pending_listen_fd;
+	server->pending_listen_fd = -1;
+	pthread_mutex_unlock(&server->mutex);
+
+	/* Rebind: empty the old accept queue before the old socket goes away */
+	if (listen_fd >= 0)
 	{
-		/* Extract client IP from request (simplified) */
-		/* Extract real client IP from request headers */
-		char client_ip[INET_ADDRSTRLEN];
-		const char *default_client_ip = "127.0.0.1";
-		strncpy(client_ip, default_client_ip, sizeof(client_ip) - 1);
-		client_ip[sizeof(client_ip) - 1] = '\0';
-		const char *x_forwarded_for = NULL;
-		const char *x_real_ip = NULL;
-		
-		/* Simple header extraction from request */
-		if (request->headers[0] != '\0')
+		if (ramd_http_poller_set(server->poll_fd, listen_fd, server, true, false, true))
 		{
-			/* Look for X-Forwarded-For header */
-			if (strstr(request->headers, "X-Forwarded-For:"))
-			{
-				char *start = strstr(request->headers, "X-Forwarded-For:");
-				if (start)
-				{
-					start += 15; /* Skip "X-Forwarded-For:" */
-					while (*start == ' ') start++; /* Skip spaces */
-					x_forwarded_for = start;
-				}
-			}
-			
-			/* Look for X-Real-IP header */
-			if (strstr(request->headers, "X-Real-IP:"))
-			{
-				char *start = strstr(request->headers, "X-Real-IP:");
-				if (start)
-				{
-					start += 9; /* Skip "X-Real-IP:" */
-					while (*start == ' ') start++; /* Skip spaces */
-					x_real_ip = start;
-				}
-			}
+			ramd_http_server_accept(server, server->listen_fd, false);
+			ramd_http_poller_remove(server->poll_fd, server->listen_fd);
+			close(server->listen_fd);
+			server->listen_fd = listen_fd;
 		}
-		
-		if (x_real_ip && strlen(x_real_ip) > 0)
+		else
+		{
+			ramd_log_error("Failed to register new HTTP listener: %s", strerror(errno));
+			close(listen_fd);
+		}
+	}
+
+	for (; done; done = next)
+	{
+		next = done->next;
+		done->next = NULL;
+		if (!ramd_http_poller_set(server->poll_fd, done->client_fd, done, false, false, true))
 		{
-			strncpy(client_ip, x_real_ip, sizeof(client_ip) - 1);
-			client_ip[sizeof(client_ip) - 1] = '\0';
+			ramd_http_connection_close(done);
+			continue;
 		}
-		else if (x_forwarded_for && strlen(x_forwarded_for) > 0)
+		ramd_http_connection_respond(done);
+	}
+
+	ramd_http_server_wake_watchers(server, ramd_clock_now_ms());
+}
+
+/* Close connections that have been reading or writing for too long */
+static void
+ramd_http_server_expire(ramd_http_server_t *server, int64_t now_ms)
+{
+	ramd_http_connection_t *conn;
+	int                     i;
+
+	for (i = 0; i < RAMD_HTTP_MAX_CONNECTIONS; i++)
+	{
+		conn = &server->connections[i];
+		if ((conn->state == RAMD_HTTP_CONN_READING ||
+			 conn->state == RAMD_HTTP_CONN_WRITING) &&
+			now_ms >= conn->deadline_ms)
+			ramd_http_connection_close(conn);
+	}
+
+	/* Watchers whose wait ran out get an empty delta */
+	ramd_http_server_wake_watchers(server, now_ms);
+}
+
+static void *
+ramd_http_server_thread(void *arg)
+{
+	ramd_http_server_t     *server = (ramd_http_server_t *) arg;
+	ramd_http_event_t       events[RAMD_HTTP_MAX_EVENTS];
+	ramd_http_connection_t *conn;
+	int64_t                 next_expire_ms;
+	int64_t                 now_ms;
+	int                     n;
+	int                     i;
+
+	ramd_log_debug("HTTP server thread started");
+
+	next_expire_ms = ramd_clock_now_ms() + RAMD_HTTP_POLL_INTERVAL_MS;
+
+	while (server->running)
+	{
+		n = ramd_http_poller_wait(server->poll_fd, events, RAMD_HTTP_MAX_EVENTS,
+								  RAMD_HTTP_POLL_INTERVAL_MS);
+		if (n < 0 && errno != EINTR)
 		{
-			/* Take the first IP from X-Forwarded-For header */
-			char *comma = strchr(x_forwarded_for, ',');
-			if (comma)
+			ramd_log_error("HTTP event wait failed: %s", strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < n; i++)
+		{
+			if (events[i].ptr == server)
+			{
+				ramd_http_server_accept(server, server->listen_fd, false);
+				continue;
+			}
+			if (events[i].ptr == &server->unix_fd)
+			{
+				ramd_http_server_accept(server, server->unix_fd, true);
+				continue;
+			}
+			if (events[i].ptr == server->wake_fd)
 			{
-				*comma = '\0';
+				ramd_http_server_drain_workers(server);
+				continue;
 			}
-			strncpy(client_ip, x_forwarded_for, sizeof(client_ip) - 1);
-			client_ip[sizeof(client_ip) - 1] = '\0';
+
+			/* A TLS session may be waiting for the other direction */
+			conn = (ramd_http_connection_t *) events[i].ptr;
+			if (conn->state == RAMD_HTTP_CONN_READING &&
+				(events[i].readable || events[i].writable || events[i].failed))
+				ramd_http_connection_read(conn);
+			else if (conn->state == RAMD_HTTP_CONN_WRITING &&
+					 (events[i].readable || events[i].writable || events[i].failed))
+				ramd_http_connection_write(conn);
+			else if (conn->state == RAMD_HTTP_CONN_PARKED && events[i].failed)
+				ramd_http_connection_close(conn);
 		}
-		
-		/* Authenticate request */
-		if (!ramd_security_authenticate_http(client_ip, request->authorization, "api_access", request->path))
+
+		now_ms = ramd_clock_now_ms();
+		if (now_ms >= next_expire_ms)
 		{
-			ramd_http_set_error_response(response, RAMD_HTTP_401_UNAUTHORIZED, "Authentication required");
-			return;
+			ramd_http_server_expire(server, now_ms);
+			next_expire_ms = now_ms + RAMD_HTTP_POLL_INTERVAL_MS;
 		}
-		
-		/* Validate and sanitize input */
-		if (!ramd_security_validate_and_sanitize_input(request->body, sizeof(request->body)))
+	}
+
+	/* Connections owned by a worker are released by ramd_http_server_release() */
+	for (i = 0; i < RAMD_HTTP_MAX_CONNECTIONS; i++)
+	{
+		conn = &server->connections[i];
+		if (conn->state != RAMD_HTTP_CONN_FREE)
 		{
-			ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "Invalid input data");
-			return;
+			close(conn->client_fd);
+			conn->client_fd = -1;
+			if (conn->state != RAMD_HTTP_CONN_DISPATCHED)
+				conn->state = RAMD_HTTP_CONN_FREE;
 		}
 	}
 
-	if (strcmp(request->path, "/api/v1/cluster/status") == 0)
-		ramd_http_handle_cluster_status(request, response);
-	else if (strcmp(request->path, "/api/v1/nodes") == 0)
-		ramd_http_handle_nodes_list(request, response);
-	else if (strncmp(request->path, "/api/v1/nodes/", 14) == 0)
-		ramd_http_handle_node_detail(request, response);
-	else if (strncmp(request->path, "/api/v1/promote/", 16) == 0)
-		ramd_http_handle_promote_node(request, response);
-	else if (strncmp(request->path, "/api/v1/demote/", 15) == 0)
-		ramd_http_handle_demote_node(request, response);
-	else if (strcmp(request->path, "/api/v1/failover") == 0)
-		ramd_http_handle_failover(request, response);
-	else if (strncmp(request->path, "/api/v1/maintenance/", 20) == 0)
-		ramd_http_handle_maintenance_mode(request, response);
-	else if (strcmp(request->path, "/api/v1/config/reload") == 0)
-		ramd_http_handle_config_reload(request, response);
-	else if (strcmp(request->path, "/api/v1/replication/sync") == 0)
-		ramd_http_handle_sync_replication(request, response);
-	else if (strcmp(request->path, "/api/v1/bootstrap/primary") == 0)
-		ramd_http_handle_bootstrap_primary(request, response);
-	else if (strcmp(request->path, "/api/v1/replica/add") == 0)
-		ramd_http_handle_add_replica(request, response);
-	else if (strcmp(request->path, "/api/v1/cluster/add-node") == 0)
-		ramd_http_handle_add_node(request, response);
-	else if (strcmp(request->path, "/api/v1/cluster/remove-node") == 0)
-		ramd_http_handle_remove_node(request, response);
-	else if (strcmp(request->path, "/api/v1/cluster/health") == 0)
-		ramd_http_handle_cluster_health(request, response);
-	else if (strcmp(request->path, "/api/v1/cluster/notify") == 0)
-		ramd_http_handle_cluster_notify(request, response);
-	/* Enhanced API endpoints */
-	else if (strcmp(request->path, "/api/v1/cluster/switchover") == 0)
-		ramd_api_handle_switchover(request, response);
-	else if (strcmp(request->path, "/api/v1/config") == 0)
+	ramd_log_debug("HTTP server thread stopped");
+	return NULL;
+}
+
+static void *
+ramd_http_worker_thread(void *arg)
+{
+	ramd_http_server_t     *server = (ramd_http_server_t *) arg;
+	ramd_http_connection_t *conn;
+
+	pthread_mutex_lock(&server->mutex);
+	for (;;)
 	{
-		if (request->method == RAMD_HTTP_GET)
-			ramd_api_handle_config_get(request, response);
-		else if (request->method == RAMD_HTTP_POST)
-			ramd_api_handle_config_set(request, response);
-		else
-			ramd_http_send_response(0, response);
-	}
+		while (server->running && !server->work_head)
+			pthread_cond_wait(&server->work_cond, &server->mutex);
+		if (!server->running)
+			break;
+
+		conn = server->work_head;
+		server->work_head = conn->next;
+		if (!server->work_head)
+			server->work_tail = NULL;
+		pthread_mutex_unlock(&server->mutex);
+
+		ramd_http_route_request(&conn->request, &conn->response);
+
+		pthread_mutex_lock(&server->mutex);
+		conn->next = server->done_head;
+		server->done_head = conn;
+		if (write(server->wake_fd[1], "x", 1) < 0 && errno != EAGAIN)
+			ramd_log_warning("Failed to wake HTTP server thread: %s", strerror(errno));
+	}
+	pthread_mutex_unlock(&server->mutex);
+	return NULL;
+}
+
+/*
+ * Find a header in a block of CRLF-terminated header lines.  Returns the
+ * value with surrounding blanks trimmed, or NULL.
+ */
+static const char *
+ramd_http_find_header(const char *block, const char *block_end, const char *name,
+					  size_t *value_length)
+{
+	const char *line;
+	const char *eol;
+	const char *value;
+	size_t      name_len = strlen(name);
+
+	for (line = block; line < block_end; line = eol + 2)
+	{
+		eol = memchr(line, '\r', (size_t) (block_end - line));
+		if (!eol)
+			eol = block_end;
+
+		if ((size_t) (eol - line) > name_len && line[name_len] == ':' &&
+			strncasecmp(line, name, name_len) == 0)
+		{
+			value = line + name_len + 1;
+			while (value < eol && (*value == ' ' || *value == '\t'))
+				value++;
+			while (eol > value && (eol[-1] == ' ' || eol[-1] == '\t'))
+				eol--;
+			*value_length = (size_t) (eol - value);
+			return value;
+		}
+	}
+	return NULL;
+}
+
+const char *
+ramd_http_get_header(const ramd_http_request_t *request, const char *name,
+					 size_t *value_length)
+{
+	if (!request || !request->headers || !name || !value_length)
+		return NULL;
+
+	return ramd_http_find_header(request->headers,
+								 request->headers + request->headers_length,
+								 name, value_length);
+}
+
+/*
+ * Advance the parser over newly buffered bytes.  buffer[length] must be
+ * addressable and NUL.  On RAMD_HTTP_PARSE_DONE the request occupies
+ * buffer[0 .. scan_pos) and its body buffer[header_len .. header_len + body_len).
+ */
+ramd_http_parse_state_t
+ramd_http_parser_feed(ramd_http_parser_t *parser, char *buffer, size_t length)
+{
+	const char   *end;
+	const char   *value;
+	size_t        value_len;
+	size_t        take;
+	unsigned long chunk_size;
+	char         *digits_end;
+
+	while (parser->scan_pos <= length)
+	{
+		switch (parser->state)
+		{
+			case RAMD_HTTP_PARSE_HEADERS:
+				end = strstr(buffer + (parser->scan_pos > 3 ? parser->scan_pos - 3 : 0),
+							 "\r\n\r\n");
+				if (!end)
+				{
+					parser->scan_pos = length;
+					if (length > RAMD_HTTP_MAX_HEADER_SIZE)
+					{
+						parser->error = RAMD_HTTP_413_PAYLOAD_TOO_LARGE;
+						parser->state = RAMD_HTTP_PARSE_ERROR;
+					}
+					return parser->state;
+				}
+
+				parser->header_len = (size_t) (end - buffer) + 4;
+				parser->scan_pos = parser->header_len;
+				parser->body_len = 0;
+
+				value = ramd_http_find_header(buffer, end + 2, "Transfer-Encoding", &value_len);
+				if (value && value_len >= 7 && strncasecmp(value + value_len - 7, "chunked", 7) == 0)
+				{
+					parser->chunked = true;
+					parser->state = RAMD_HTTP_PARSE_CHUNK_SIZE;
+					break;
+				}
+
+				parser->remaining = 0;
+				value = ramd_http_find_header(buffer, end + 2, "Content-Length", &value_len);
+				if (value)
+				{
+					errno = 0;
+					parser->remaining = strtoul(value, &digits_end, 10);
+					if (digits_end == value || digits_end != value + value_len || errno != 0)
+					{
+						parser->error = RAMD_HTTP_400_BAD_REQUEST;
+						parser->state = RAMD_HTTP_PARSE_ERROR;
+						return parser->state;
+					}
+					if (parser->remaining > RAMD_HTTP_MAX_BODY_SIZE)
+					{
+						parser->error = RAMD_HTTP_413_PAYLOAD_TOO_LARGE;
+						parser->state = RAMD_HTTP_PARSE_ERROR;
+						return parser->state;
+					}
+				}
+				parser->state = parser->remaining > 0 ? RAMD_HTTP_PARSE_BODY : RAMD_HTTP_PARSE_DONE;
+				break;
+
+			case RAMD_HTTP_PARSE_BODY:
+				take = length - parser->scan_pos;
+				if (take > parser->remaining)
+					take = parser->remaining;
+				parser->scan_pos += take;
+				parser->body_len += take;
+				parser->remaining -= take;
+				if (parser->remaining > 0)
+					return parser->state;
+				parser->state = RAMD_HTTP_PARSE_DONE;
+				break;
+
+			case RAMD_HTTP_PARSE_CHUNK_SIZE:
+				end = strstr(buffer + parser->scan_pos, "\r\n");
+				if (!end)
+				{
+					if (length - parser->scan_pos > RAMD_MAX_HOSTNAME_LENGTH)
+					{
+						parser->error = RAMD_HTTP_400_BAD_REQUEST;
+						parser->state = RAMD_HTTP_PARSE_ERROR;
+					}
+					return parser->state;
+				}
+
+				errno = 0;
+				chunk_size = strtoul(buffer + parser->scan_pos, &digits_end, 16);
+				if (digits_end == buffer + parser->scan_pos || errno != 0 ||
+					(*digits_end != ';' && digits_end != end))
+				{
+					parser->error = RAMD_HTTP_400_BAD_REQUEST;
+					parser->state = RAMD_HTTP_PARSE_ERROR;
+					return parser->state;
+				}
+				if (chunk_size > RAMD_HTTP_MAX_BODY_SIZE - parser->body_len)
+				{
+					parser->error = RAMD_HTTP_413_PAYLOAD_TOO_LARGE;
+					parser->state = RAMD_HTTP_PARSE_ERROR;
+					return parser->state;
+				}
+
+				parser->scan_pos = (size_t) (end - buffer) + 2;
+				parser->remaining = chunk_size;
+				parser->state = chunk_size > 0 ? RAMD_HTTP_PARSE_CHUNK_DATA : RAMD_HTTP_PARSE_TRAILERS;
+				break;
+
+			case RAMD_HTTP_PARSE_CHUNK_DATA:
+				take = length - parser->scan_pos;
+				if (take > parser->remaining)
+					take = parser->remaining;
+
+				/* Close the gap left by the chunk framing */
+				memmove(buffer + parser->header_len + parser->body_len,
+						buffer + parser->scan_pos, take);
+				parser->scan_pos += take;
+				parser->body_len += take;
+				parser->remaining -= take;
+				if (parser->remaining > 0)
+					return parser->state;
+				parser->state = RAMD_HTTP_PARSE_CHUNK_END;
+				break;
+
+			case RAMD_HTTP_PARSE_CHUNK_END:
+				if (length - parser->scan_pos < 2)
+					return parser->state;
+				if (buffer[parser->scan_pos] != '\r' || buffer[parser->scan_pos + 1] != '\n')
+				{
+					parser->error = RAMD_HTTP_400_BAD_REQUEST;
+					parser->state = RAMD_HTTP_PARSE_ERROR;
+					return parser->state;
+				}
+				parser->scan_pos += 2;
+				parser->state = RAMD_HTTP_PARSE_CHUNK_SIZE;
+				break;
+
+			case RAMD_HTTP_PARSE_TRAILERS:
+				/* Trailer fields are accepted and ignored */
+				end = strstr(buffer + parser->scan_pos, "\r\n");
+				if (!end)
+				{
+					if (length - parser->scan_pos > RAMD_HTTP_MAX_HEADER_SIZE)
+					{
+						parser->error = RAMD_HTTP_413_PAYLOAD_TOO_LARGE;
+						parser->state = RAMD_HTTP_PARSE_ERROR;
+					}
+					return parser->state;
+				}
+				parser->state = end == buffer + parser->scan_pos ?
+					RAMD_HTTP_PARSE_DONE : RAMD_HTTP_PARSE_TRAILERS;
+				parser->scan_pos = (size_t) (end - buffer) + 2;
+				break;
+
+			case RAMD_HTTP_PARSE_DONE:
+			case RAMD_HTTP_PARSE_ERROR:
+				return parser->state;
+		}
+	}
+	return parser->state;
+}
+
+/*
+ * Parse the request line and headers in place.  buffer[0 .. header_len)
+ * holds them, blank line included; separators are overwritten with NULs
+ * so that path, query_string and headers can point into the buffer.
+ */
+bool
+ramd_http_parse_request(char *buffer, size_t header_len, ramd_http_request_t *request)
+{
+	char       *line_end;
+	char       *block_end;
+	char       *method_str;
+	char       *path_str;
+	char       *version_str;
+	char       *separator;
+	char       *query;
+	const char *value;
+	size_t      value_len;
+
+	if (!buffer || !request || header_len < 4)
+		return false;
+
+	memset(request, 0, sizeof(ramd_http_request_t));
+
+	block_end = buffer + header_len - 2;
+	line_end = strstr(buffer, "\r\n");
+	if (!line_end || line_end >= block_end)
+		return false;
+	*line_end = '\0';
+
+	method_str = buffer;
+	separator = strchr(method_str, ' ');
+	if (!separator)
+		return false;
+	*separator = '\0';
+	path_str = separator + 1;
+
+	version_str = strchr(path_str, ' ');
+	if (version_str)
+		*version_str++ = '\0';
+
+	if (*path_str == '\0')
+		return false;
+
+	if (strcmp(method_str, "GET") == 0)
+		request->method = RAMD_HTTP_GET;
+	else if (strcmp(method_str, "HEAD") == 0)
+		request->method = RAMD_HTTP_HEAD;
+	else if (strcmp(method_str, "POST") == 0)
+		request->method = RAMD_HTTP_POST;
+	else if (strcmp(method_str, "PUT") == 0)
+		request->method = RAMD_HTTP_PUT;
+	else if (strcmp(method_str, "DELETE") == 0)
+		request->method = RAMD_HTTP_DELETE;
+	else if (strcmp(method_str, "PATCH") == 0)
+		request->method = RAMD_HTTP_PATCH;
+	else
+		return false;
+
+	query = strchr(path_str, '?');
+	if (query)
+	{
+		*query = '\0';
+		request->query_string = query + 1;
+	}
+	else
+		request->query_string = path_str + strlen(path_str);
+	request->path = path_str;
+
+	request->headers = line_end + 2;
+	request->headers_length = (size_t) (block_end - request->headers);
+	*block_end = '\0';
+
+	request->keep_alive = version_str && strcmp(version_str, "HTTP/1.1") == 0;
+
+	value = ramd_http_get_header(request, "Connection", &value_len);
+	if (value && value_len >= 5 && strncasecmp(value, "close", 5) == 0)
+		request->keep_alive = false;
+	else if (value && value_len >= 10 && strncasecmp(value, "keep-alive", 10) == 0)
+		request->keep_alive = true;
+
+	value = ramd_http_get_header(request, "Authorization", &value_len);
+	if (value)
+	{
+		if (value_len >= sizeof(request->authorization))
+			value_len = sizeof(request->authorization) - 1;
+		memcpy(request->authorization, value, value_len);
+		request->authorization[value_len] = '\0';
+	}
+
+	return true;
+}
+
+static const char *
+ramd_http_method_name(ramd_http_method_t method)
+{
+	switch (method)
+	{
+		case RAMD_HTTP_GET:
+			return "GET";
+		case RAMD_HTTP_HEAD:
+			return "HEAD";
+		case RAMD_HTTP_POST:
+			return "POST";
+		case RAMD_HTTP_PUT:
+			return "PUT";
+		case RAMD_HTTP_DELETE:
+			return "DELETE";
+		case RAMD_HTTP_PATCH:
+			return "PATCH";
+	}
+	return "UNKNOWN";
+}
+
+/*
+ * Run the request with its profile attached to this thread, so that auth,
+ * rate limiting and pooled PostgreSQL sessions are charged to it.  The
+ * handler phase is what remains of the routing time after auth.
+ */
+static void
+ramd_http_route_request(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_profile_sample_t *profile = &request->profile;
+	int64_t                     start_us;
+	int64_t                     checks_us;
+
+	ramd_http_profile_attach(profile);
+	profile->routed = true;
+	start_us = ramd_clock_now_us();
+
+	ramd_http_dispatch_routes(request, response);
+
+	checks_us = profile->phase_us[RAMD_HTTP_PROFILE_RATE_LIMIT] +
+		profile->phase_us[RAMD_HTTP_PROFILE_AUTH];
+	ramd_http_profile_add(RAMD_HTTP_PROFILE_HANDLER,
+						  ramd_clock_now_us() - start_us - checks_us);
+	ramd_http_profile_detach();
+}
+
+static void
+ramd_http_dispatch_routes(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	/* Security check for all API endpoints */
+	if (strncmp(request->path, "/api/", 5) == 0)
+	{
+		/* Extract client IP from request (simplified) */
+		/* Extract real client IP from request headers */
+		char client_ip[INET6_ADDRSTRLEN];
+		strncpy(client_ip, request->client_ip[0] ? request->client_ip : "127.0.0.1",
+				sizeof(client_ip) - 1);
+		client_ip[sizeof(client_ip) - 1] = '\0';
+		const char *x_forwarded_for;
+		const char *x_real_ip;
+		size_t      value_len;
+
+		x_real_ip = ramd_http_get_header(request, "X-Real-IP", &value_len);
+		if (x_real_ip && value_len > 0)
+		{
+			if (value_len >= sizeof(client_ip))
+				value_len = sizeof(client_ip) - 1;
+			memcpy(client_ip, x_real_ip, value_len);
+			client_ip[value_len] = '\0';
+		}
+		else if ((x_forwarded_for = ramd_http_get_header(request, "X-Forwarded-For",
+														 &value_len)) != NULL && value_len > 0)
+		{
+			/* Take the first IP from X-Forwarded-For header */
+			const char *comma = memchr(x_forwarded_for, ',', value_len);
+
+			if (comma)
+				value_len = (size_t) (comma - x_forwarded_for);
+			if (value_len >= sizeof(client_ip))
+				value_len = sizeof(client_ip) - 1;
+			memcpy(client_ip, x_forwarded_for, value_len);
+			client_ip[value_len] = '\0';
+		}
+		
+		/*
+		 * Authenticate request; GETs are reads and are audited in aggregate.
+		 * A trusted peer on the Unix socket needs no token and is not rate
+		 * limited: it could read the token from the configuration anyway.
+		 */
+		int64_t auth_start_us = ramd_clock_now_us();
+		bool    authenticated = request->peer_trusted ||
+			ramd_security_authenticate_http(client_ip, request->authorization,
+											request->method == RAMD_HTTP_GET ||
+											request->method == RAMD_HTTP_HEAD ? "read" : "write",
+											request->path);
+
+		/* The rate limit check inside it has already charged its own phase */
+		ramd_http_profile_add(RAMD_HTTP_PROFILE_AUTH,
+							  ramd_clock_now_us() - auth_start_us -
+							  request->profile.phase_us[RAMD_HTTP_PROFILE_RATE_LIMIT]);
+		if (!authenticated)
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_401_UNAUTHORIZED, "Authentication required");
+			return;
+		}
+		
+		/* Validate and sanitize input */
+		if (!ramd_security_validate_and_sanitize_input(request->body, request->body_length))
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "Invalid input data");
+			return;
+		}
+	}
+
+	if (strcmp(request->path, "/health") == 0)
+		ramd_http_handle_health(request, response);
+	else if (strcmp(request->path, "/primary") == 0 ||
+			 strcmp(request->path, "/replica") == 0 ||
+			 strcmp(request->path, "/read-only") == 0 ||
+			 strcmp(request->path, "/sync") == 0)
+		ramd_http_handle_role_check(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/status") == 0)
+		ramd_http_handle_cluster_status(request, response);
+	else if (strcmp(request->path, "/api/v1/nodes") == 0)
+		ramd_http_handle_nodes_list(request, response);
+	else if (strcmp(request->path, "/api/v1/state") == 0)
+		ramd_http_handle_state(request, response);
+	else if (strncmp(request->path, "/api/v1/nodes/", 14) == 0)
+		ramd_http_handle_node_detail(request, response);
+	else if (strncmp(request->path, "/api/v1/promote/", 16) == 0)
+		ramd_http_handle_promote_node(request, response);
+	else if (strncmp(request->path, "/api/v1/demote/", 15) == 0)
+		ramd_http_handle_demote_node(request, response);
+	else if (strcmp(request->path, "/api/v1/failover") == 0)
+		ramd_http_handle_failover(request, response);
+	else if (strcmp(request->path, "/api/v1/failover/history") == 0)
+		ramd_http_handle_failover_history(request, response);
+	else if (strcmp(request->path, "/api/v1/debug/endpoints") == 0)
+		ramd_http_handle_debug_endpoints(request, response);
+	else if (strcmp(request->path, "/api/v1/debug/pprof/profile") == 0)
+		ramd_http_handle_debug_pprof_profile(request, response);
+	else if (strncmp(request->path, "/api/v1/maintenance/", 20) == 0)
+		ramd_http_handle_maintenance_mode(request, response);
+	else if (strcmp(request->path, "/api/v1/config/reload") == 0)
+		ramd_http_handle_config_reload(request, response);
+	else if (strcmp(request->path, "/api/v1/replication/lag") == 0)
+		ramd_http_handle_replication_lag(request, response);
+	else if (strcmp(request->path, "/api/v1/replication/topology") == 0)
+		ramd_http_handle_replication_topology(request, response);
+	else if (strcmp(request->path, "/api/v1/watch") == 0)
+		ramd_http_handle_watch(request, response);
+	else if (strcmp(request->path, "/api/v1/logs") == 0)
+		ramd_http_handle_logs(request, response);
+	else if (strcmp(request->path, "/api/v1/metrics/history") == 0)
+		ramd_http_handle_metrics_history(request, response);
+	else if (strcmp(request->path, "/api/v1/jobs") == 0 ||
+			 strncmp(request->path, "/api/v1/jobs/", 13) == 0)
+		ramd_http_handle_jobs(request, response);
+	else if (strcmp(request->path, "/api/v1/replication/sync") == 0)
+		ramd_http_handle_sync_replication(request, response);
+	else if (strcmp(request->path, "/api/v1/bootstrap/primary") == 0)
+		ramd_http_handle_bootstrap_primary(request, response);
+	else if (strcmp(request->path, "/api/v1/replica/add") == 0)
+		ramd_http_handle_add_replica(request, response);
+	else if (strcmp(request->path, "/api/v1/rebuild") == 0)
+		ramd_http_handle_rebuild(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/add-node") == 0)
+		ramd_http_handle_add_node(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/remove-node") == 0)
+		ramd_http_handle_remove_node(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/health") == 0)
+		ramd_http_handle_cluster_health(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/notify") == 0)
+		ramd_http_handle_cluster_notify(request, response);
+	/* Enhanced API endpoints */
+	else if (strcmp(request->path, "/api/v1/cluster/switchover") == 0)
+		ramd_http_handle_switchover(request, response);
+	else if (strcmp(request->path, "/api/v1/cluster/rolling") == 0)
+		ramd_http_handle_rolling(request, response);
+	else if (strcmp(request->path, "/api/v1/config") == 0)
+	{
+		if (request->method == RAMD_HTTP_GET)
+			ramd_api_handle_config_get(request, response);
+		else if (request->method == RAMD_HTTP_POST)
+			ramd_api_handle_config_set(request, response);
+		else
+			ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
+										 "Method not allowed");
+	}
 	else if (strcmp(request->path, "/api/v1/backup/start") == 0)
 		ramd_api_handle_backup_start(request, response);
 	else if (strcmp(request->path, "/api/v1/backup/restore") == 0)
 		ramd_api_handle_backup_restore(request, response);
 	else if (strcmp(request->path, "/api/v1/backup/list") == 0)
 		ramd_api_handle_backup_list(request, response);
-	else if (strcmp(request->path, "/api/v1/backup/jobs") == 0)
-		ramd_api_handle_backup_jobs(request, response);
+	else if (strcmp(request->path, "/api/v1/backup/jobs") == 0 ||
+			 strncmp(request->path, "/api/v1/backup/jobs/", 20) == 0)
+		ramd_http_handle_backup_jobs(request, response);
 	else if (strcmp(request->path, "/api/v1/parameter/validate") == 0)
 		ramd_api_handle_parameter_validate(request, response);
 	else if (strcmp(request->path, "/api/v1/parameter/list") == 0)
@@ -749,269 +2194,1737 @@ ramd_http_route_request(ramd_http_request_t *request, ramd_http_response_t *resp
 	else if (strcmp(request->path, "/api/v1/security/users") == 0)
 		ramd_http_handle_security_users(request, response);
 	else
+	{
+		request->profile.unmatched = true;
 		ramd_http_set_error_response(response, RAMD_HTTP_404_NOT_FOUND, "Endpoint not found");
+	}
 }
 
-void
-ramd_http_handle_cluster_status(ramd_http_request_t *request, ramd_http_response_t *response)
+static bool
+ramd_http_json_flush(void *context, const char *data, size_t length)
 {
-	char    json_buffer[RAMD_MAX_COMMAND_LENGTH];
-	int32_t pgraft_node_count;
-	int32_t pgraft_leader_id;
-	bool    pgraft_is_leader;
-	bool    pgraft_has_quorum;
+	return ramd_buffer_append(&((ramd_http_response_t *) context)->content, data, length);
+}
 
-	(void) request;
+/*
+ * Start a JSON body written with ram_json.h.  The writer stages output in
+ * the response's inline body and spills into content only when that
+ * fills, so a typical response is written in place and never copied.
+ */
+static void
+ramd_http_json_begin(ramd_http_response_t *response, ram_json_writer_t *w)
+{
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, NULL);
+	ram_json_writer_init(w, response->body, sizeof(response->body),
+						 ramd_http_json_flush, response);
+}
+
+static bool
+ramd_http_json_end(ramd_http_response_t *response, ram_json_writer_t *w)
+{
+	if (response->content.length == 0 && !w->failed && w->depth == 0)
+	{
+		response->body[w->length] = '\0';
+		response->body_length = w->length;
+		return true;
+	}
+	return ram_json_writer_finish(w);
+}
+
+static const char *
+ramd_http_failover_state_name(int32_t state)
+{
+	switch (state)
+	{
+		case RAMD_FAILOVER_STATE_NORMAL:
+			return "normal";
+		case RAMD_FAILOVER_STATE_DETECTING:
+			return "detecting";
+		case RAMD_FAILOVER_STATE_PROMOTING:
+			return "promoting";
+		case RAMD_FAILOVER_STATE_RECOVERING:
+			return "recovering";
+		case RAMD_FAILOVER_STATE_COMPLETED:
+			return "completed";
+		default:
+			return "failed";
+	}
+}
+
+/*
+ * Cluster-state views served from the watch feed.  The feed's (epoch,
+ * version) is the generation: each view is rendered at most once per
+ * generation and the cached copy is lent to every response until the
+ * feed moves, so a poller that already has the current ETag gets a 304
+ * and one that does not gets the bytes without any rendering.
+ */
+typedef enum
+{
+	RAMD_HTTP_VIEW_CLUSTER_STATUS = 0,
+	RAMD_HTTP_VIEW_NODES,
+	RAMD_HTTP_VIEW_STATE_JSON,
+	RAMD_HTTP_VIEW_STATE_BINARY,
+	RAMD_HTTP_VIEW_COUNT
+} ramd_http_view_t;
+
+typedef struct ramd_http_cached_view_t
+{
+	int32_t  refcount; /* the cache's own reference plus one per response */
+	uint64_t epoch;
+	uint64_t version;
+	size_t   length;
+	char     body[];
+} ramd_http_cached_view_t;
+
+static pthread_mutex_t g_view_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static ramd_http_cached_view_t *g_view_cache[RAMD_HTTP_VIEW_COUNT];
+
+static void
+ramd_http_view_release(void *context)
+{
+	ramd_http_cached_view_t *cached = context;
+	bool                     last;
+
+	pthread_mutex_lock(&g_view_cache_lock);
+	last = --cached->refcount == 0;
+	pthread_mutex_unlock(&g_view_cache_lock);
+	if (last)
+		free(cached);
+}
+
+static void
+ramd_http_view_cache_clear(void)
+{
+	int i;
+
+	for (i = 0; i < RAMD_HTTP_VIEW_COUNT; i++)
+	{
+		ramd_http_cached_view_t *cached;
+
+		pthread_mutex_lock(&g_view_cache_lock);
+		cached = g_view_cache[i];
+		g_view_cache[i] = NULL;
+		pthread_mutex_unlock(&g_view_cache_lock);
+		if (cached)
+			ramd_http_view_release(cached);
+	}
+}
+
+/* True if an If-None-Match list names etag, weakly or not, or is "*" */
+static bool
+ramd_http_etag_matches(const ramd_http_request_t *request, const char *etag)
+{
+	const char *value;
+	size_t      length;
+	size_t      etag_length = strlen(etag);
+	size_t      i = 0;
+
+	value = ramd_http_get_header(request, "If-None-Match", &length);
+	if (!value)
+		return false;
+
+	while (i < length)
+	{
+		size_t start;
+		size_t end;
+
+		while (i < length && (value[i] == ' ' || value[i] == '\t' || value[i] == ','))
+			i++;
+		start = i;
+		while (i < length && value[i] != ',')
+			i++;
+		end = i;
+		while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t'))
+			end--;
+
+		if (end - start == 1 && value[start] == '*')
+			return true;
+		if (end - start > 2 && strncmp(value + start, "W/", 2) == 0)
+			start += 2;
+		if (end - start == etag_length && strncmp(value + start, etag, etag_length) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool
+ramd_http_render_cluster_status(const ramd_watch_snapshot_t *view, ramd_http_response_t *response)
+{
+	ramd_registry_status_t registry;
+	ram_json_writer_t w;
+	int32_t           leader_id = view->leader_node_id > 0 ? view->leader_node_id : view->primary_node_id;
+	int32_t           healthy = 0;
+	int32_t           i;
+
+	for (i = 0; i < view->node_count; i++)
+		if (view->nodes[i].is_healthy)
+			healthy++;
+	ramd_registry_get_status(&registry);
+
+	ramd_http_json_begin(response, &w);
+	return ram_json_object_begin(&w) &&
+		   ram_json_kv_string(&w, "cluster_name", view->cluster_name) &&
+		   ram_json_kv_string(&w, "status", view->has_quorum ? "operational" : "degraded") &&
+		   ram_json_kv_int(&w, "primary_node_id", leader_id) &&
+		   ram_json_kv_int(&w, "node_count", view->node_count) &&
+		   ram_json_kv_int(&w, "healthy_nodes", healthy) &&
+		   ram_json_kv_bool(&w, "has_quorum", view->has_quorum) &&
+		   ram_json_kv_bool(&w, "is_leader", leader_id == g_ramd_daemon->config.node_id) &&
+		   ram_json_kv_string(&w, "data_source", "pgraft") &&
+		   ram_json_kv_int(&w, "timestamp", view->changed_at) &&
+		   ram_json_kv_string(&w, "failover_state",
+							  ramd_http_failover_state_name(view->failover_state)) &&
+		   ram_json_key(&w, "registry") && ram_json_object_begin(&w) &&
+		   ram_json_kv_bool(&w, "synced", registry.synced) &&
+		   ram_json_kv_int(&w, "revision", registry.revision) &&
+		   ram_json_kv_int(&w, "lease", registry.lease) &&
+		   ram_json_kv_int(&w, "registered_nodes", registry.registered_nodes) &&
+		   ram_json_kv_int(&w, "events", registry.events) &&
+		   ram_json_kv_int(&w, "resyncs", registry.resyncs) &&
+		   ram_json_object_end(&w) &&
+		   ram_json_object_end(&w) &&
+		   ramd_http_json_end(response, &w);
+}
+
+static bool
+ramd_http_render_nodes(const ramd_watch_snapshot_t *view, ramd_http_response_t *response)
+{
+	ram_json_writer_t w;
+	bool              ok;
+	int32_t           i;
+
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) &&
+		 ram_json_kv_string(&w, "status", "success") &&
+		 ram_json_key(&w, "data") && ram_json_object_begin(&w) &&
+		 ram_json_key(&w, "nodes") && ram_json_array_begin(&w);
+
+	for (i = 0; ok && i < view->node_count; i++)
+	{
+		const ramd_watch_node_t *node = &view->nodes[i];
+
+		ok = ram_json_object_begin(&w) &&
+			 ram_json_kv_int(&w, "node_id", node->node_id) &&
+			 ram_json_kv_string(&w, "name", node->hostname) &&
+			 ram_json_kv_string(&w, "hostname", node->hostname) &&
+			 ram_json_kv_int(&w, "postgresql_port", node->postgresql_port) &&
+			 ram_json_kv_string(&w, "role", (node->role == RAMD_ROLE_PRIMARY) ? "primary" : "standby") &&
+			 ram_json_kv_string(&w, "state",
+								(node->state == RAMD_NODE_STATE_UNKNOWN) ? "healthy" :
+								(node->state == RAMD_NODE_STATE_FAILED) ? "failed" : "unknown") &&
+			 ram_json_kv_bool(&w, "is_healthy", node->is_healthy) &&
+			 ram_json_kv_bool(&w, "is_primary", node->is_primary) &&
+			 ram_json_kv_bool(&w, "voting", node->is_voter) &&
+			 ram_json_object_end(&w);
+	}
+
+	return ok && ram_json_array_end(&w) &&
+		   ram_json_kv_int(&w, "total_count", view->node_count) &&
+		   ram_json_object_end(&w) && ram_json_object_end(&w) &&
+		   ramd_http_json_end(response, &w);
+}
+
+/* Everything a controller reconciles against, in one object */
+static bool
+ramd_http_render_state_json(const ramd_watch_snapshot_t *view, ramd_http_response_t *response)
+{
+	ram_json_writer_t w;
+	bool              ok;
+	int32_t           i;
+
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) &&
+		 ram_json_kv_int(&w, "schema_version", RAM_STATE_SCHEMA_VERSION) &&
+		 ram_json_kv_uint(&w, "epoch", view->epoch) &&
+		 ram_json_kv_uint(&w, "version", view->version) &&
+		 ram_json_kv_int(&w, "changed_at", view->changed_at) &&
+		 ram_json_kv_string(&w, "cluster_name", view->cluster_name) &&
+		 ram_json_kv_int(&w, "raft_term", view->raft_term) &&
+		 ram_json_kv_int(&w, "primary_node_id", view->primary_node_id) &&
+		 ram_json_kv_int(&w, "leader_node_id", view->leader_node_id) &&
+		 ram_json_kv_int(&w, "local_node_id", g_ramd_daemon->config.node_id) &&
+		 ram_json_kv_bool(&w, "has_quorum", view->has_quorum) &&
+		 ram_json_kv_bool(&w, "in_failover", view->in_failover) &&
+		 ram_json_kv_string(&w, "failover_state",
+							ramd_http_failover_state_name(view->failover_state)) &&
+		 ram_json_key(&w, "nodes") && ram_json_array_begin(&w);
+
+	for (i = 0; ok && i < view->node_count; i++)
+	{
+		const ramd_watch_node_t *node = &view->nodes[i];
+
+		ok = ram_json_object_begin(&w) &&
+			 ram_json_kv_int(&w, "node_id", node->node_id) &&
+			 ram_json_kv_string(&w, "hostname", node->hostname) &&
+			 ram_json_kv_int(&w, "postgresql_port", node->postgresql_port) &&
+			 ram_json_kv_string(&w, "role", node->role == RAMD_ROLE_PRIMARY ? "primary" : "standby") &&
+			 ram_json_kv_string(&w, "state", ramd_http_node_state_name(node->state)) &&
+			 ram_json_kv_bool(&w, "is_primary", node->is_primary) &&
+			 ram_json_kv_bool(&w, "is_leader", node->is_leader) &&
+			 ram_json_kv_bool(&w, "is_healthy", node->is_healthy) &&
+			 ram_json_kv_bool(&w, "voting", node->is_voter) &&
+			 ram_json_kv_int(&w, "replay_lag_ms", node->replay_lag_ms) &&
+			 ram_json_kv_int(&w, "replay_lag_bytes", node->replay_lag_bytes) &&
+			 ram_json_kv_int(&w, "flush_lsn", node->flush_lsn) &&
+			 ram_json_kv_int(&w, "replay_lsn", node->replay_lsn) &&
+			 ram_json_kv_uint(&w, "version", node->version) &&
+			 ram_json_object_end(&w);
+	}
+
+	return ok && ram_json_array_end(&w) && ram_json_object_end(&w) &&
+		   ramd_http_json_end(response, &w);
+}
+
+/* The same picture in the fixed little-endian layout of ram_state.h */
+static bool
+ramd_http_render_state_binary(const ramd_watch_snapshot_t *view, ramd_http_response_t *response)
+{
+	unsigned char *out;
+	size_t         length;
+
+	length = RAM_STATE_HEADER_SIZE + (size_t) view->node_count * RAM_STATE_NODE_SIZE;
+	out = calloc(1, length);
+	if (!out)
+		return false;
+
+	(void) ramd_watch_encode_state(view, g_ramd_daemon->config.node_id, out, length);
+	ramd_http_set_owned_body(response, RAMD_HTTP_200_OK, RAM_STATE_CONTENT_TYPE,
+							 (char *) out, length);
+	return true;
+}
+
+static bool
+ramd_http_render_view(ramd_http_view_t which, const ramd_watch_snapshot_t *view,
+					  ramd_http_response_t *response)
+{
+	switch (which)
+	{
+		case RAMD_HTTP_VIEW_CLUSTER_STATUS:
+			return ramd_http_render_cluster_status(view, response);
+		case RAMD_HTTP_VIEW_NODES:
+			return ramd_http_render_nodes(view, response);
+		case RAMD_HTTP_VIEW_STATE_JSON:
+			return ramd_http_render_state_json(view, response);
+		case RAMD_HTTP_VIEW_STATE_BINARY:
+			return ramd_http_render_state_binary(view, response);
+		default:
+			return false;
+	}
+}
+
+static void
+ramd_http_serve_view(ramd_http_request_t *request, ramd_http_response_t *response,
+					 ramd_http_view_t which)
+{
+	ramd_watch_snapshot_t    view;
+	ramd_http_cached_view_t *cached;
+	ramd_http_cached_view_t *stale = NULL;
+	char                     etag[48];
+	const char              *body;
+	size_t                   length;
+	bool                     ok;
+
+	ramd_watch_get(&view);
+	if (view.epoch == 0)
+	{
+		/* Nothing published before the first monitor cycle */
+		ramd_watch_publish(&g_ramd_daemon->cluster);
+		ramd_watch_get(&view);
+	}
+	snprintf(etag, sizeof(etag), "\"%llx-%llu\"",
+			 (unsigned long long) view.epoch, (unsigned long long) view.version);
+
+	if (ramd_http_etag_matches(request, etag))
+	{
+		ramd_http_response_reset(response);
+		response->status = RAMD_HTTP_304_NOT_MODIFIED;
+	}
+	else
+	{
+		pthread_mutex_lock(&g_view_cache_lock);
+		cached = g_view_cache[which];
+		if (cached && cached->epoch == view.epoch && cached->version == view.version)
+			cached->refcount++;
+		else
+			cached = NULL;
+		pthread_mutex_unlock(&g_view_cache_lock);
+
+		if (cached)
+			ramd_http_set_shared_body(response, RAMD_HTTP_200_OK,
+									  which == RAMD_HTTP_VIEW_STATE_BINARY ?
+									  RAM_STATE_CONTENT_TYPE : "application/json",
+									  cached->body, cached->length,
+									  ramd_http_view_release, cached);
+		else
+		{
+			ok = ramd_http_render_view(which, &view, response);
+			if (!ok)
+			{
+				ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+											 "Out of memory");
+				return;
+			}
+
+			body = ramd_http_response_body(response, &length);
+			cached = malloc(sizeof(*cached) + length);
+			if (cached)
+			{
+				cached->refcount = 1;
+				cached->epoch = view.epoch;
+				cached->version = view.version;
+				cached->length = length;
+				memcpy(cached->body, body, length);
+
+				pthread_mutex_lock(&g_view_cache_lock);
+				stale = g_view_cache[which];
+				/* Keep whichever is newer if two renders of a view raced */
+				if (stale && stale->epoch == view.epoch && stale->version > view.version)
+				{
+					stale = cached;
+					cached = NULL;
+				}
+				else
+					g_view_cache[which] = cached;
+				pthread_mutex_unlock(&g_view_cache_lock);
+				if (stale)
+					ramd_http_view_release(stale);
+			}
+		}
+	}
+
+	snprintf(response->headers, sizeof(response->headers),
+			 "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+}
+
+/*
+ * GET /api/v1/cluster/status
+ *
+ * Leader, quorum and failover state as of the monitor's last cycle; an
+ * If-None-Match carrying the previous ETag is answered with 304.
+ */
+void
+ramd_http_handle_cluster_status(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_serve_view(request, response, RAMD_HTTP_VIEW_CLUSTER_STATUS);
+}
+
+/*
+ * GET /api/v1/state[?format=json|bin]
+ *
+ * Nodes, roles, LSNs, lag, health, Raft term and leader in one response,
+ * from the same cached generation and with the same ETag as the views
+ * above.  format=bin answers with the ram_state.h layout.
+ */
+void
+ramd_http_handle_state(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	const char      *format = ramd_http_request_param(request, "format");
+	ramd_http_view_t which = RAMD_HTTP_VIEW_STATE_JSON;
+
+	if (format && (strcmp(format, "bin") == 0 || strcmp(format, "binary") == 0))
+		which = RAMD_HTTP_VIEW_STATE_BINARY;
+	else if (format && strcmp(format, "json") != 0)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "format must be json or bin");
+		return;
+	}
+	ramd_http_serve_view(request, response, which);
+}
+
+/*
+ * GET /api/v1/failover/history[?limit=N][&format=otlp]
+ *
+ * The most recent failovers with the timing of each step, newest first.
+ * format=otlp answers with the finished ones as an OTLP/JSON
+ * ExportTraceServiceRequest instead.
+ */
+void
+ramd_http_handle_failover_history(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_failover_trace_t traces[RAMD_FAILOVER_TRACE_HISTORY];
+	const char           *limit_str;
+	const char           *format;
+	ram_json_writer_t     w;
+	int32_t               limit = RAMD_FAILOVER_TRACE_HISTORY;
+	int32_t               count;
+	bool                  otlp = false;
+	bool                  ok;
+	int32_t               i;
+
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
+									 "Method not allowed");
+		return;
+	}
+
+	limit_str = ramd_http_request_param(request, "limit");
+	if (limit_str)
+	{
+		limit = atoi(limit_str);
+		if (limit <= 0 || limit > RAMD_FAILOVER_TRACE_HISTORY)
+			limit = RAMD_FAILOVER_TRACE_HISTORY;
+	}
+
+	format = ramd_http_request_param(request, "format");
+	if (format && strcmp(format, "otlp") == 0)
+		otlp = true;
+	else if (format && strcmp(format, "json") != 0)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "format must be json or otlp");
+		return;
+	}
+
+	count = ramd_failover_trace_history(traces, limit);
+
+	ramd_http_json_begin(response, &w);
+	if (otlp)
+	{
+		ok = ramd_failover_trace_write_otlp(&w, traces, count, g_ramd_daemon->config.node_id) &&
+			 ramd_http_json_end(response, &w);
+	}
+	else
+	{
+		ok = ram_json_object_begin(&w) &&
+			 ram_json_kv_string(&w, "status", "success") &&
+			 ram_json_key(&w, "failovers") && ram_json_array_begin(&w);
+		for (i = 0; ok && i < count; i++)
+			ok = ramd_failover_trace_write_json(&w, &traces[i]);
+		ok = ok && ram_json_array_end(&w) &&
+			 ram_json_kv_int(&w, "count", count) &&
+			 ram_json_object_end(&w) && ramd_http_json_end(response, &w);
+	}
+
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+									 "Failed to render failover history");
+}
+
+/*
+ * GET /api/v1/debug/endpoints[?limit=N]
+ * DELETE /api/v1/debug/endpoints
+ *
+ * Per-endpoint request statistics since start or the last DELETE,
+ * busiest first by total time.
+ */
+void
+ramd_http_handle_debug_endpoints(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	const char       *limit_str;
+	ram_json_writer_t w;
+	int32_t           limit = 0;
+
+	if (request->method == RAMD_HTTP_DELETE)
+	{
+		ramd_http_profile_reset();
+		ramd_http_set_json_response(response, RAMD_HTTP_200_OK,
+									"{\"status\": \"success\", \"message\": \"Endpoint statistics reset\"}");
+		return;
+	}
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
+									 "Method not allowed");
+		return;
+	}
+
+	limit_str = ramd_http_request_param(request, "limit");
+	if (limit_str)
+		limit = atoi(limit_str);
+
+	ramd_http_json_begin(response, &w);
+	if (!ramd_http_profile_write_json(&w, limit) || !ramd_http_json_end(response, &w))
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+									 "Failed to render endpoint statistics");
+}
+
+/*
+ * GET /api/v1/debug/pprof/profile[?seconds=N][&hz=N]
+ *
+ * Sample the daemon's CPU for N seconds and answer with folded stacks for
+ * flamegraph.pl or speedscope.  Refused unless profiling_enabled is set;
+ * runs on a worker thread, one profile at a time.
+ */
+void
+ramd_http_handle_debug_pprof_profile(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	const char *param;
+	char        error[RAMD_MAX_COMMAND_LENGTH];
+	int32_t     seconds = RAMD_PROFILER_DEFAULT_SECONDS;
+	int32_t hz = RAMD_PROFILER_DEFAULT_HZ;
+
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
+									 "Method not allowed");
+		return;
+	}
+	if (!g_ramd_daemon || !g_ramd_daemon->config.profiling_enabled)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_403_FORBIDDEN,
+									 "Profiling is disabled; set profiling_enabled = true");
+		return;
+	}
+
+	param = ramd_http_request_param(request, "seconds");
+	if (param)
+		seconds = atoi(param);
+	param = ramd_http_request_param(request, "hz");
+	if (param)
+		hz = atoi(param);
+	if (seconds <= 0 || seconds > RAMD_PROFILER_MAX_SECONDS ||
+		hz <= 0 || hz > RAMD_PROFILER_MAX_HZ)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "seconds must be 1-60 and hz 1-1000");
+		return;
+	}
+
+	ramd_http_response_reset(response);
+	if (!ramd_profiler_collect(seconds, hz, &response->content, error, sizeof(error)))
+	{
+		ramd_http_set_error_response(response, ramd_profiler_is_running() ?
+									 RAMD_HTTP_409_CONFLICT : RAMD_HTTP_500_INTERNAL_ERROR,
+									 error);
+		return;
+	}
+
+	strncpy(response->content_type, "text/plain; charset=utf-8",
+			sizeof(response->content_type) - 1);
+	response->status = RAMD_HTTP_200_OK;
+}
+
+/*
+ * GET /health
+ *
+ * Unauthenticated and answered from memory, so it is served from the
+ * moment the listener is up and costs nothing however often probes call
+ * it.  "starting" until the main loop runs, "degraded" while the monitor
+ * has no fresh sample of the local server, "ok" otherwise; anything but
+ * "ok" is a 503 so that readiness probes hold traffic back.
+ */
+void
+ramd_http_handle_health(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ram_json_writer_t     w;
+	ramd_monitor_health_t health;
+	bool                  running = g_ramd_daemon && g_ramd_daemon->running;
+	bool                  connected;
+	const char           *status;
+
+	if (request->method != RAMD_HTTP_GET && request->method != RAMD_HTTP_HEAD)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	ramd_monitor_get_health(g_ramd_daemon ? &g_ramd_daemon->monitor : NULL, &health);
+	connected = health.fresh;
+	status = !running ? "starting" : connected ? "ok" : "degraded";
+
+	ramd_http_json_begin(response, &w);
+	if (!(ram_json_object_begin(&w) &&
+		  ram_json_kv_string(&w, "status", status) &&
+		  ram_json_kv_bool(&w, "postgresql", connected) &&
+		  ram_json_kv_bool(&w, "monitor", g_ramd_daemon && g_ramd_daemon->monitor.running) &&
+		  ram_json_kv_double(&w, "health_score", health.score, 2) &&
+		  ram_json_kv_int(&w, "sample_age_ms", health.sample_age_ms) &&
+		  ram_json_kv_int(&w, "host_load", health.host_load) &&
+		  ram_json_object_end(&w) &&
+		  ramd_http_json_end(response, &w)))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Failed to render health");
+		return;
+	}
+	if (!running || !connected)
+		response->status = RAMD_HTTP_503_SERVICE_UNAVAILABLE;
+}
+
+/*
+ * Role checks for load balancers: /primary, /replica, /read-only and
+ * /sync answer 200 when this node may take that kind of traffic and 503
+ * otherwise, with a one-word body and HEAD allowed.  They read the watch
+ * feed, the monitor's health and the lag sampler, all in memory, so
+ * several proxies probing each node twice a second cost next to nothing.
+ * A stale local sample fails every check; so does a failover under way
+ * for /primary.  max_lag_ms bounds a standby's replay lag, and a standby
+ * whose lag is unknown fails a bounded check.
+ */
+void
+ramd_http_handle_role_check(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_watch_snapshot_t    view;
+	ramd_monitor_health_t    health;
+	ramd_lag_stats_t         stats;
+	const ramd_watch_node_t *self = NULL;
+	const char              *max_lag_param;
+	const char              *body;
+	char                    *end;
+	long                     max_lag_ms = -1;
+	bool                     standby;
+	bool                     pass = false;
+	int32_t                  i;
+
+	if (request->method != RAMD_HTTP_GET && request->method != RAMD_HTTP_HEAD)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	max_lag_param = ramd_http_request_param(request, "max_lag_ms");
+	if (max_lag_param)
+	{
+		max_lag_ms = strtol(max_lag_param, &end, 10);
+		if (end == max_lag_param || *end != '\0' || max_lag_ms < 0)
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+										 "max_lag_ms must be a non-negative integer");
+			return;
+		}
+	}
+
+	ramd_monitor_get_health(g_ramd_daemon ? &g_ramd_daemon->monitor : NULL, &health);
+	ramd_watch_get(&view);
+	for (i = 0; i < view.node_count && g_ramd_daemon; i++)
+	{
+		if (view.nodes[i].node_id == g_ramd_daemon->config.node_id)
+		{
+			self = &view.nodes[i];
+			break;
+		}
+	}
+
+	if (self && health.fresh && self->is_healthy)
+	{
+		standby = !self->is_primary &&
+			(max_lag_ms < 0 ||
+			 (self->replay_lag_ms >= 0 && self->replay_lag_ms <= max_lag_ms));
+
+		if (strcmp(request->path, "/primary") == 0)
+			pass = self->is_primary && !view.in_failover;
+		else if (strcmp(request->path, "/replica") == 0)
+			pass = standby;
+		else if (strcmp(request->path, "/read-only") == 0)
+			pass = self->is_primary || standby;
+		else
+			pass = standby && ramd_lag_get_stats(self->node_id, &stats) &&
+				stats.connected && stats.is_sync;
+	}
+
+	body = !self || !health.fresh ? "unavailable\n" :
+		self->is_primary ? "primary\n" : "standby\n";
+
+	ramd_http_response_reset(response);
+	response->status = pass ? RAMD_HTTP_200_OK : RAMD_HTTP_503_SERVICE_UNAVAILABLE;
+	strncpy(response->content_type, "text/plain", sizeof(response->content_type) - 1);
+	response->body_length = strlen(body);
+	memcpy(response->body, body, response->body_length + 1);
+}
+
+void
+ramd_http_handle_config_reload(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_config_reload_result_t result;
+	char                       json_buffer[RAMD_MAX_COMMAND_LENGTH];
+
+	if (request->method != RAMD_HTTP_POST)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	if (!ramd_config_reload_from_file(NULL, &result))
+	{
+		snprintf(json_buffer, sizeof(json_buffer),
+				"{\n"
+				"  \"status\": \"failed\",\n"
+				"  \"error\": \"%s\"\n"
+				"}",
+				result.error_message);
+		ramd_http_set_json_response(response, RAMD_HTTP_500_INTERNAL_ERROR, json_buffer);
+		return;
+	}
+
+	snprintf(json_buffer, sizeof(json_buffer),
+			"{\n"
+			"  \"status\": \"%s\",\n"
+			"  \"reload_time\": %ld,\n"
+			"  \"changes_detected\": %d,\n"
+			"  \"changes_applied\": %d\n"
+			"}",
+			ramd_config_reload_status_to_string(result.status),
+			result.reload_time,
+			result.changes_detected,
+			result.changes_applied);
+
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
+}
+
+static const char *
+ramd_http_status_text(ramd_http_status_code_t status)
+{
+	switch (status)
+	{
+		case RAMD_HTTP_200_OK:
+			return "OK";
+		case RAMD_HTTP_202_ACCEPTED:
+			return "Accepted";
+		case RAMD_HTTP_304_NOT_MODIFIED:
+			return "Not Modified";
+		case RAMD_HTTP_400_BAD_REQUEST:
+			return "Bad Request";
+		case RAMD_HTTP_401_UNAUTHORIZED:
+			return "Unauthorized";
+		case RAMD_HTTP_403_FORBIDDEN:
+			return "Forbidden";
+		case RAMD_HTTP_404_NOT_FOUND:
+			return "Not Found";
+		case RAMD_HTTP_405_METHOD_NOT_ALLOWED:
+			return "Method Not Allowed";
+		case RAMD_HTTP_409_CONFLICT:
+			return "Conflict";
+		case RAMD_HTTP_413_PAYLOAD_TOO_LARGE:
+			return "Payload Too Large";
+		case RAMD_HTTP_500_INTERNAL_ERROR:
+			return "Internal Server Error";
+		case RAMD_HTTP_501_NOT_IMPLEMENTED:
+			return "Not Implemented";
+		case RAMD_HTTP_503_SERVICE_UNAVAILABLE:
+			return "Service Unavailable";
+	}
+	return "Unknown";
+}
+
+/* Write status line and headers into buf; returns the length or -1 */
+static ssize_t
+ramd_http_format_head(ramd_http_response_t *response, bool keep_alive,
+					  size_t body_length, char *buf, size_t size)
+{
+	char keep_alive_header[64] = "";
+	char entity_header[RAMD_MAX_HOSTNAME_LENGTH + 64];
+	int  header_len;
+
+	if (keep_alive)
+		snprintf(keep_alive_header, sizeof(keep_alive_header),
+				 "Keep-Alive: timeout=%d, max=%d\r\n",
+				 RAMD_HTTP_KEEPALIVE_TIMEOUT_MS / 1000, RAMD_HTTP_KEEPALIVE_MAX_REQUESTS);
+
+	if (response->status == 0)
+		response->status = RAMD_HTTP_200_OK;
+
+	/* A 304 carries no body, so no entity headers either */
+	if (response->status == RAMD_HTTP_304_NOT_MODIFIED)
+		entity_header[0] = '\0';
+	else
+		snprintf(entity_header, sizeof(entity_header),
+				 "Content-Type: %s\r\n"
+				 "Content-Length: %zu\r\n",
+				 strlen(response->content_type) > 0 ? response->content_type : "application/json",
+				 body_length);
+
+	header_len = snprintf(buf, size,
+						  "HTTP/1.1 %d %s\r\n"
+						  "%s"
+						  "Server: ramd/1.0\r\n"
+						  "Connection: %s\r\n"
+						  "%s"
+						  "%s"
+						  "\r\n",
+						  response->status,
+						  ramd_http_status_text(response->status),
+						  entity_header,
+						  keep_alive ? "keep-alive" : "close",
+						  keep_alive_header,
+						  response->headers);
+	if (header_len < 0 || (size_t) header_len >= size)
+		return -1;
+	return header_len;
+}
+
+const char *
+ramd_http_response_body(const ramd_http_response_t *response, size_t *length)
+{
+	if (response->owned_body)
+	{
+		*length = response->owned_body_length;
+		return response->owned_body;
+	}
+	if (response->content.length > 0)
+	{
+		*length = response->content.length;
+		return response->content.data;
+	}
+
+	/* Some handlers fill the body without setting its length */
+	*length = response->body_length > 0 ? response->body_length :
+		strnlen(response->body, sizeof(response->body));
+	return response->body;
+}
+
+bool
+ramd_http_send_response(int client_fd, ramd_http_response_t *response)
+{
+	char         head[RAMD_MAX_COMMAND_LENGTH * 2];
+	struct iovec iov[2];
+	const char  *body;
+	size_t       body_length;
+	ssize_t      head_length;
+	ssize_t      sent;
+
+	if (!response)
+		return false;
+
+	body = ramd_http_response_body(response, &body_length);
+	head_length = ramd_http_format_head(response, false, body_length, head, sizeof(head));
+	if (head_length < 0)
+		return false;
+
+	iov[0].iov_base = head;
+	iov[0].iov_len = (size_t) head_length;
+	iov[1].iov_base = (void *) body;
+	iov[1].iov_len = body_length;
+
+	while (iov[0].iov_len + iov[1].iov_len > 0)
+	{
+		sent = writev(client_fd, iov[0].iov_len > 0 ? &iov[0] : &iov[1],
+					  iov[0].iov_len > 0 ? 2 : 1);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+
+		if ((size_t) sent >= iov[0].iov_len)
+		{
+			sent -= (ssize_t) iov[0].iov_len;
+			iov[0].iov_len = 0;
+			iov[1].iov_base = (char *) iov[1].iov_base + sent;
+			iov[1].iov_len -= (size_t) sent;
+		}
+		else
+		{
+			iov[0].iov_base = (char *) iov[0].iov_base + sent;
+			iov[0].iov_len -= (size_t) sent;
+		}
+	}
+	return true;
+}
+
+/* Clear a response for reuse, keeping the content buffer's storage */
+void
+ramd_http_response_reset(ramd_http_response_t *response)
+{
+	if (!response)
+		return;
+
+	if (response->owned_body_release)
+		response->owned_body_release(response->owned_body_context);
+	else
+		free(response->owned_body);
+	response->owned_body = NULL;
+	response->owned_body_length = 0;
+	response->owned_body_release = NULL;
+	response->owned_body_context = NULL;
+	ramd_buffer_reset(&response->content, RAMD_HTTP_POOLED_BUFFER_SIZE);
+
+	response->status = 0;
+	response->content_type[0] = '\0';
+	response->body[0] = '\0';
+	response->body_length = 0;
+	response->headers[0] = '\0';
+	response->watch_since = 0;
+	response->watch_wait_ms = 0;
+	response->watch_logs = false;
+}
+
+/* Append to the response body; it is not limited to RAMD_HTTP_MAX_RESPONSE_SIZE */
+bool
+ramd_http_response_appendf(ramd_http_response_t *response, const char *format, ...)
+{
+	va_list args;
+	bool    result;
+
+	if (!response || !format)
+		return false;
+
+	va_start(args, format);
+	result = ramd_buffer_vappendf(&response->content, format, args);
+	va_end(args);
+	return result;
+}
+
+/* Send a malloc'd body as is; the response frees it once it is written */
+void
+ramd_http_set_owned_body(ramd_http_response_t *response, ramd_http_status_code_t status,
+						 const char *content_type, char *body, size_t length)
+{
+	if (!response)
+	{
+		free(body);
+		return;
+	}
+
+	ramd_http_response_reset(response);
+	response->status = status;
+	strncpy(response->content_type, content_type ? content_type : "application/json",
+			sizeof(response->content_type) - 1);
+	response->owned_body = body;
+	response->owned_body_length = body ? length : 0;
+}
+
+/*
+ * Send a body owned by someone else without copying it; release(context)
+ * is called once the response no longer needs it.
+ */
+void
+ramd_http_set_shared_body(ramd_http_response_t *response, ramd_http_status_code_t status,
+						  const char *content_type, const char *body, size_t length,
+						  void (*release) (void *context), void *context)
+{
+	if (!response)
+	{
+		if (release)
+			release(context);
+		return;
+	}
+
+	ramd_http_response_reset(response);
+	response->status = status;
+	strncpy(response->content_type, content_type ? content_type : "application/json",
+			sizeof(response->content_type) - 1);
+	response->owned_body = (char *) body;
+	response->owned_body_length = body ? length : 0;
+	response->owned_body_release = release;
+	response->owned_body_context = context;
+}
+
+void
+ramd_http_set_json_response(ramd_http_response_t *response, ramd_http_status_code_t status,
+						   const char *json)
+{
+	size_t length;
+
+	if (!response)
+		return;
+
+	ramd_http_response_reset(response);
+	response->status = status;
+	strncpy(response->content_type, "application/json", sizeof(response->content_type) - 1);
+
+	if (!json)
+		return;
+
+	length = strlen(json);
+	if (length < sizeof(response->body))
+	{
+		memcpy(response->body, json, length + 1);
+		response->body_length = length;
+	}
+	else if (!ramd_buffer_append(&response->content, json, length))
+	{
+		response->status = RAMD_HTTP_500_INTERNAL_ERROR;
+		snprintf(response->body, sizeof(response->body),
+				 "{\n  \"error\": \"Out of memory\",\n  \"status\": %d\n}",
+				 RAMD_HTTP_500_INTERNAL_ERROR);
+		response->body_length = strlen(response->body);
+	}
+}
+
+void
+ramd_http_set_error_response(ramd_http_response_t *response, ramd_http_status_code_t status,
+							const char *message)
+{
+	char json_buffer[RAMD_MAX_COMMAND_LENGTH];
+
+	snprintf(json_buffer, sizeof(json_buffer),
+			"{\n"
+			"  \"error\": \"%s\",\n"
+			"  \"status\": %d\n"
+			"}",
+			message ? message : "Unknown error",
+			status);
+
+	ramd_http_set_json_response(response, status, json_buffer);
+}
+
+void
+ramd_http_handle_nodes_list(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_serve_view(request, response, RAMD_HTTP_VIEW_NODES);
+}
+
+static const char *
+ramd_http_node_state_name(ramd_node_state_t state)
+{
+	switch (state)
+	{
+		case RAMD_NODE_STATE_PRIMARY:
+			return "primary";
+		case RAMD_NODE_STATE_STANDBY:
+			return "standby";
+		case RAMD_NODE_STATE_FAILED:
+			return "failed";
+		case RAMD_NODE_STATE_RECOVERING:
+			return "recovering";
+		case RAMD_NODE_STATE_LEADER:
+			return "leader";
+		case RAMD_NODE_STATE_FOLLOWER:
+			return "follower";
+		default:
+			return "unknown";
+	}
+}
+
+static uint64_t
+ramd_http_query_u64(ramd_http_request_t *request, const char *name, bool *present)
+{
+	const char *value = ramd_http_request_param(request, name);
+	uint64_t    result = 0;
+
+	if (present)
+		*present = value != NULL;
+	if (value)
+		result = strtoull(value, NULL, 10);
+	return result;
+}
+
+/*
+ * Answer a watch request from the current feed.  A client with no since,
+ * or one from another epoch or from before the last membership change,
+ * gets the whole view; otherwise only entries newer than since.  With
+ * may_wait and nothing newer, the response is left empty with
+ * watch_wait_ms set and the event loop parks the connection.
+ */
+static void
+ramd_http_watch_render(ramd_http_request_t *request, ramd_http_response_t *response,
+					   bool may_wait)
+{
+	ramd_watch_snapshot_t view;
+	uint64_t              since;
+	uint64_t              epoch;
+	uint64_t              wait_ms;
+	bool                  has_since;
+	bool                  has_wait;
+	bool                  full;
+	bool                  ok;
+	ram_json_writer_t     w;
+	int32_t               i;
+
+	since = ramd_http_query_u64(request, "since", &has_since);
+	epoch = ramd_http_query_u64(request, "epoch", NULL);
+	wait_ms = ramd_http_query_u64(request, "wait_ms", &has_wait);
+	if (!has_wait)
+		wait_ms = RAMD_WATCH_DEFAULT_WAIT_MS;
+	if (wait_ms > RAMD_WATCH_MAX_WAIT_MS)
+		wait_ms = RAMD_WATCH_MAX_WAIT_MS;
+
+	ramd_watch_get(&view);
+	full = !has_since || epoch != view.epoch || since < view.full_since ||
+		   since > view.version;
+
+	if (!full && since >= view.version && may_wait && wait_ms > 0)
+	{
+		response->watch_since = since;
+		response->watch_wait_ms = (int32_t) wait_ms;
+		return;
+	}
+
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) &&
+		 ram_json_kv_uint(&w, "epoch", view.epoch) &&
+		 ram_json_kv_uint(&w, "version", view.version) &&
+		 ram_json_kv_bool(&w, "full", full);
+
+	if (ok && (full || view.cluster_version > since))
+		ok = ram_json_key(&w, "cluster") && ram_json_object_begin(&w) &&
+			 ram_json_kv_string(&w, "cluster_name", view.cluster_name) &&
+			 ram_json_kv_int(&w, "primary_node_id", view.primary_node_id) &&
+			 ram_json_kv_int(&w, "leader_node_id", view.leader_node_id) &&
+			 ram_json_kv_int(&w, "node_count", view.node_count) &&
+			 ram_json_kv_bool(&w, "has_quorum", view.has_quorum) &&
+			 ram_json_kv_bool(&w, "in_failover", view.in_failover) &&
+			 ram_json_object_end(&w);
+
+	ok = ok && ram_json_key(&w, "nodes") && ram_json_array_begin(&w);
+
+	for (i = 0; ok && i < view.node_count; i++)
+	{
+		const ramd_watch_node_t *n = &view.nodes[i];
+
+		if (!full && n->version <= since)
+			continue;
+
+		ok = ram_json_object_begin(&w) &&
+			 ram_json_kv_int(&w, "node_id", n->node_id) &&
+			 ram_json_kv_string(&w, "hostname", n->hostname) &&
+			 ram_json_kv_int(&w, "postgresql_port", n->postgresql_port) &&
+			 ram_json_kv_string(&w, "role",
+								(n->role == RAMD_ROLE_PRIMARY) ? "primary" :
+								(n->role == RAMD_ROLE_STANDBY) ? "standby" : "unknown") &&
+			 ram_json_kv_string(&w, "state", ramd_http_node_state_name(n->state)) &&
+			 ram_json_kv_bool(&w, "is_healthy", n->is_healthy) &&
+			 ram_json_kv_bool(&w, "is_primary", n->is_primary) &&
+			 ram_json_kv_bool(&w, "is_leader", n->is_leader) &&
+			 ram_json_kv_bool(&w, "voting", n->is_voter) &&
+			 ram_json_kv_int(&w, "replay_lag_ms", n->replay_lag_ms) &&
+			 ram_json_kv_int(&w, "replay_lag_bytes", n->replay_lag_bytes) &&
+			 ram_json_kv_uint(&w, "version", n->version) &&
+			 ram_json_object_end(&w);
+	}
+
+	ok = ok && ram_json_array_end(&w);
+
+	/* What moved, in order, while the feed still remembers back to since */
+	if (ok && !full)
+	{
+		ramd_watch_event_t events[RAMD_WATCH_EVENT_HISTORY];
+		int32_t            count = ramd_watch_events_since(since, events, RAMD_WATCH_EVENT_HISTORY);
+
+		if (count >= 0)
+		{
+			ok = ram_json_key(&w, "events") && ram_json_array_begin(&w);
+			for (i = 0; ok && i < count; i++)
+			{
+				const ramd_watch_event_t *e = &events[i];
+
+				if (e->version > view.version)
+					break;
+				ok = ram_json_object_begin(&w) &&
+					 ram_json_kv_uint(&w, "version", e->version) &&
+					 ram_json_kv_string(&w, "type", ramd_watch_event_type_to_string(e->type)) &&
+					 ram_json_kv_int(&w, "node_id", e->node_id) &&
+					 ram_json_kv_int(&w, "old", e->old_value) &&
+					 ram_json_kv_int(&w, "new", e->new_value) &&
+					 ram_json_kv_int(&w, "at", e->at) &&
+					 ram_json_object_end(&w);
+			}
+			ok = ok && ram_json_array_end(&w);
+		}
+	}
+
+	ok = ok && ram_json_object_end(&w) && ramd_http_json_end(response, &w);
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+}
+
+/*
+ * GET /api/v1/watch?since=<version>&epoch=<epoch>&wait_ms=<ms>
+ *
+ * Long-poll for cluster changes: returns as soon as the feed moves past
+ * since, or after wait_ms (default RAMD_WATCH_DEFAULT_WAIT_MS) with an
+ * empty delta.  Parked requests cost the daemon nothing until then.  A
+ * delta also lists the typed events behind it, unless the feed has
+ * already forgotten some of them.
+ */
+void
+ramd_http_handle_watch(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	ramd_http_watch_render(request, response, true);
+}
+
+/* level=: a level name, warn allowed for warning */
+static bool
+ramd_http_parse_log_level(const char *value, ramd_log_level_t *level)
+{
+	if (strcasecmp(value, "warn") == 0)
+	{
+		*level = RAMD_LOG_LEVEL_WARNING;
+		return true;
+	}
+	for (int i = RAMD_LOG_LEVEL_DEBUG; i <= RAMD_LOG_LEVEL_FATAL; i++)
+	{
+		if (strcasecmp(value, ramd_logging_level_to_string((ramd_log_level_t) i)) == 0)
+		{
+			*level = (ramd_log_level_t) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* since=: unix seconds, or an age such as 90s, 15m, 2h or 1d */
+static bool
+ramd_http_parse_log_since(const char *value, int64_t *since_us)
+{
+	struct timespec now;
+	char           *end;
+	double          number = strtod(value, &end);
+	double          unit = 0;
+
+	if (end == value || number < 0)
+		return false;
+	switch (*end)
+	{
+		case '\0':
+			*since_us = (int64_t) (number * 1000000.0);
+			return true;
+		case 's':
+			unit = 1;
+			break;
+		case 'm':
+			unit = 60;
+			break;
+		case 'h':
+			unit = 3600;
+			break;
+		case 'd':
+			unit = 86400;
+			break;
+		default:
+			return false;
+	}
+	if (end[1] != '\0')
+		return false;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	*since_us = (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000 -
+				(int64_t) (number * unit * 1000000.0);
+	return true;
+}
+
+/*
+ * Answer a log query from the store.  With may_wait, follow set and
+ * nothing matching past cursor, the response is left empty with
+ * watch_wait_ms set and the event loop parks the connection until the
+ * store moves.
+ */
+static void
+ramd_http_logs_render(ramd_http_request_t *request, ramd_http_response_t *response,
+					  bool may_wait)
+{
+	ramd_log_record_t records[32];
+	ramd_log_query_t  query;
+	ramd_log_page_t   page;
+	ram_json_writer_t w;
+	const char       *value;
+	uint64_t          counts[RAMD_LOG_LEVEL_FATAL + 1];
+	uint64_t          limit;
+	uint64_t          tail;
+	uint64_t          wait_ms;
+	uint64_t          remaining;
+	bool              has_limit;
+	bool              has_tail;
+	bool              has_wait;
+	bool              follow;
+	bool              gap = false;
+	bool              ok;
+	int32_t           count;
+
+	memset(&query, 0, sizeof(query));
+	query.min_level = RAMD_LOG_LEVEL_DEBUG;
+	if ((value = ramd_http_request_param(request, "level")) &&
+		!ramd_http_parse_log_level(value, &query.min_level))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "level must be debug, info, notice, warning, error or fatal");
+		return;
+	}
+	if ((value = ramd_http_request_param(request, "since")) &&
+		!ramd_http_parse_log_since(value, &query.since_us))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "since must be unix seconds or an age like 15m");
+		return;
+	}
+	query.component = ramd_http_request_param(request, "component");
+	query.after = ramd_http_query_u64(request, "cursor", NULL);
+	limit = ramd_http_query_u64(request, "limit", &has_limit);
+	if (!has_limit)
+		limit = RAMD_LOG_QUERY_DEFAULT_LIMIT;
+	tail = ramd_http_query_u64(request, "tail", &has_tail);
+	if (has_tail)
+		limit = tail;
+	if (limit > RAMD_LOG_QUERY_MAX_LIMIT)
+		limit = RAMD_LOG_QUERY_MAX_LIMIT;
+	if (has_tail)
+		query.after = ramd_log_store_seek_tail(&query, (int32_t) limit);
+	value = ramd_http_request_param(request, "follow");
+	follow = value && (strcmp(value, "1") == 0 || strcasecmp(value, "true") == 0);
+	wait_ms = ramd_http_query_u64(request, "wait_ms", &has_wait);
+	if (!has_wait)
+		wait_ms = RAMD_LOG_FOLLOW_DEFAULT_WAIT_MS;
+	if (wait_ms > RAMD_LOG_FOLLOW_MAX_WAIT_MS)
+		wait_ms = RAMD_LOG_FOLLOW_MAX_WAIT_MS;
+
+	/* A first page that finds nothing decides whether to park */
+	query.limit = (int32_t) (limit < 32 ? limit : 32);
+	count = ramd_log_store_query(&query, records, 32, &page);
+	if (count == 0 && !page.more && !page.gap && follow && may_wait && wait_ms > 0)
+	{
+		response->watch_since = page.next_cursor;
+		response->watch_wait_ms = (int32_t) wait_ms;
+		response->watch_logs = true;
+		return;
+	}
 
-	if (!ramd_postgresql_query_pgraft_cluster_status(&g_ramd_daemon->config, &pgraft_node_count,
-												   &pgraft_is_leader, &pgraft_leader_id,
-												   &pgraft_has_quorum))
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) && ram_json_key(&w, "records") && ram_json_array_begin(&w);
+	remaining = limit;
+	for (;;)
 	{
-		ramd_log_warning("Failed to query pgraft cluster status, falling back to internal state");
+		gap = gap || page.gap;
+		for (int32_t i = 0; ok && i < count; i++)
+			ok = ram_json_object_begin(&w) &&
+				 ram_json_kv_uint(&w, "cursor", records[i].cursor) &&
+				 ram_json_kv_int(&w, "ts", records[i].ts_us) &&
+				 ram_json_kv_string(&w, "level", ramd_logging_level_to_string(records[i].level)) &&
+				 ram_json_kv_string(&w, "component", records[i].component) &&
+				 ram_json_kv_string(&w, "msg", records[i].message) &&
+				 ram_json_object_end(&w);
+		remaining -= (uint64_t) count;
+		if (!ok || !page.more || remaining == 0)
+			break;
+		query.after = page.next_cursor;
+		query.limit = (int32_t) (remaining < 32 ? remaining : 32);
+		count = ramd_log_store_query(&query, records, 32, &page);
+	}
 
-		ramd_cluster_t *cluster = &g_ramd_daemon->cluster;
-		if (!cluster)
-		{
-			ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
-									   "Cluster not initialized and pg_ram unavailable");
-			return;
-		}
+	ramd_log_store_counts(counts);
+	ok = ok && ram_json_array_end(&w) &&
+		 ram_json_kv_uint(&w, "next_cursor", page.next_cursor) &&
+		 ram_json_kv_uint(&w, "oldest_cursor", page.oldest_cursor) &&
+		 ram_json_kv_uint(&w, "newest_cursor", page.newest_cursor) &&
+		 ram_json_kv_bool(&w, "more", page.more) &&
+		 ram_json_kv_bool(&w, "gap", gap) &&
+		 ram_json_key(&w, "retained") && ram_json_object_begin(&w);
+	for (int i = RAMD_LOG_LEVEL_DEBUG; ok && i <= RAMD_LOG_LEVEL_FATAL; i++)
+	{
+		const char *name = ramd_logging_level_to_string((ramd_log_level_t) i);
 
-		pgraft_node_count = cluster->node_count;
-		pgraft_is_leader = (cluster->primary_node_id == g_ramd_daemon->config.node_id);
-		pgraft_leader_id = cluster->primary_node_id;
-		pgraft_has_quorum = ramd_cluster_has_quorum(cluster);
+		ok = ram_json_key_n(&w, name, strlen(name)) && ram_json_uint(&w, counts[i]);
 	}
+	ok = ok && ram_json_object_end(&w) && ram_json_object_end(&w) &&
+		 ramd_http_json_end(response, &w);
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+}
 
-	snprintf(json_buffer, sizeof(json_buffer),
-			"{\n"
-			"  \"cluster_name\": \"%s\",\n"
-			"  \"status\": \"%s\",\n"
-			"  \"primary_node_id\": %d,\n"
-			"  \"node_count\": %d,\n"
-			"  \"healthy_nodes\": %d,\n"
-			"  \"has_quorum\": %s,\n"
-			"  \"is_leader\": %s,\n"
-			"  \"data_source\": \"pgraft\",\n"
-			"  \"timestamp\": %ld,\n"
-			"  \"failover_state\": \"%s\"\n"
-			"}",
-			g_ramd_daemon->cluster.cluster_name,
-			pgraft_has_quorum ? "operational" : "degraded",
-			pgraft_leader_id,
-			pgraft_node_count,
-			get_healthy_nodes_count(),
-			pgraft_has_quorum ? "true" : "false",
-			pgraft_is_leader ? "true" : "false",
-			time(NULL),
-			(g_ramd_daemon->failover_context.state == RAMD_FAILOVER_STATE_NORMAL) ? "normal" :
-			(g_ramd_daemon->failover_context.state == RAMD_FAILOVER_STATE_DETECTING) ? "detecting" :
-			(g_ramd_daemon->failover_context.state == RAMD_FAILOVER_STATE_PROMOTING) ? "promoting" :
-			(g_ramd_daemon->failover_context.state == RAMD_FAILOVER_STATE_RECOVERING) ? "recovering" :
-			(g_ramd_daemon->failover_context.state == RAMD_FAILOVER_STATE_COMPLETED) ? "completed" :
-			"failed");
+/*
+ * GET /api/v1/logs?level=&component=&since=&cursor=&limit=&tail=&follow=1&wait_ms=
+ *
+ * Recent log records from ramd's in-memory store, oldest first: at least
+ * level, from component, logged since then and past cursor; tail=N gives
+ * the last N of them instead of the first limit.  Pass next_cursor back
+ * as cursor for the next page; more says one is ready.
+ * With follow=1 a request with nothing to return is held until a record
+ * matches or wait_ms runs out, which makes a live tail of repeated calls.
+ * gap reports records that were evicted before they could be read.
+ */
+void
+ramd_http_handle_logs(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
 
-	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
+	ramd_http_logs_render(request, response, true);
 }
 
+/*
+ * GET /api/v1/metrics/history?resolution=1s|1m|1h&points=&since=
+ *
+ * The newest points steps of the metrics history, oldest first, as one
+ * array of step start times and, per series, arrays of averages and
+ * maxima with null where the series had no value.  since, unix seconds
+ * or an age as for /api/v1/logs, drops older steps.  partial says the
+ * last step is still being filled.
+ */
 void
-ramd_http_handle_config_reload(ramd_http_request_t *request, ramd_http_response_t *response)
+ramd_http_handle_metrics_history(ramd_http_request_t *request, ramd_http_response_t *response)
 {
-	ramd_config_reload_result_t result;
-	char                       json_buffer[RAMD_MAX_COMMAND_LENGTH];
+	ramd_history_resolution_t resolution = RAMD_HISTORY_MINUTES;
+	ramd_history_point_t *points;
+	ram_json_writer_t     w;
+	const char           *value;
+	int64_t               since_us = 0;
+	uint64_t              max;
+	bool                  has_max;
+	bool                  partial;
+	bool                  ok;
+	int32_t               count;
 
-	if (request->method != RAMD_HTTP_POST)
+	if (request->method != RAMD_HTTP_GET)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
 		return;
 	}
 
-	if (!ramd_config_reload_from_file(NULL, &result))
+	if ((value = ramd_http_request_param(request, "resolution")) &&
+		!ramd_history_parse_resolution(value, &resolution))
 	{
-		snprintf(json_buffer, sizeof(json_buffer),
-				"{\n"
-				"  \"status\": \"failed\",\n"
-				"  \"error\": \"%s\"\n"
-				"}",
-				result.error_message);
-		ramd_http_set_json_response(response, RAMD_HTTP_500_INTERNAL_ERROR, json_buffer);
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "resolution must be 1s, 1m or 1h");
 		return;
 	}
+	if ((value = ramd_http_request_param(request, "since")) &&
+		!ramd_http_parse_log_since(value, &since_us))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "since must be unix seconds or an age like 15m");
+		return;
+	}
+	max = ramd_http_query_u64(request, "points", &has_max);
+	if (!has_max || max == 0)
+		max = RAMD_HISTORY_DEFAULT_POINTS;
+	if (max > (uint64_t) ramd_history_capacity(resolution))
+		max = (uint64_t) ramd_history_capacity(resolution);
+
+	points = ramd_mem_alloc(RAMD_MEM_HTTP, sizeof(*points) * max);
+	if (!points)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+	count = ramd_history_read(resolution, since_us / 1000000, points, (int32_t) max, &partial);
+
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) &&
+		 ram_json_kv_string(&w, "resolution", ramd_history_resolution_name(resolution)) &&
+		 ram_json_kv_int(&w, "step_s", ramd_history_step_seconds(resolution)) &&
+		 ram_json_kv_bool(&w, "partial", partial) &&
+		 ram_json_key(&w, "ts") && ram_json_array_begin(&w);
+	for (int32_t i = 0; ok && i < count; i++)
+		ok = ram_json_int(&w, points[i].ts);
+	ok = ok && ram_json_array_end(&w) && ram_json_key(&w, "series") && ram_json_object_begin(&w);
+	for (int s = 0; ok && s < RAMD_HISTORY_SERIES_COUNT; s++)
+	{
+		const char *name = ramd_history_series_name((ramd_history_series_t) s);
 
-	snprintf(json_buffer, sizeof(json_buffer),
-			"{\n"
-			"  \"status\": \"%s\",\n"
-			"  \"reload_time\": %ld,\n"
-			"  \"changes_detected\": %d,\n"
-			"  \"changes_applied\": %d\n"
-			"}",
-			ramd_config_reload_status_to_string(result.status),
-			result.reload_time,
-			result.changes_detected,
-			result.changes_applied);
-
-	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
-}
-
-bool
-ramd_http_send_response(int client_fd, ramd_http_response_t *response)
-{
-	char response_buffer[RAMD_MAX_COMMAND_LENGTH * 2];
-	int  response_len;
-
-	if (!response)
-		return false;
-
-	response_len = snprintf(response_buffer, sizeof(response_buffer),
-						   "HTTP/1.1 %d %s\r\n"
-						   "Content-Type: %s\r\n"
-						   "Content-Length: %zu\r\n"
-						   "Server: ramd/1.0\r\n"
-						   "Connection: close\r\n"
-						   "%s"
-						   "\r\n"
-						   "%s",
-						   response->status,
-						   response->status == RAMD_HTTP_200_OK ? "OK" :
-						   response->status == RAMD_HTTP_400_BAD_REQUEST ? "Bad Request" :
-						   response->status == RAMD_HTTP_404_NOT_FOUND ? "Not Found" :
-						   response->status == RAMD_HTTP_500_INTERNAL_ERROR ? "Internal Server Error" :
-						   "Unknown",
-						   strlen(response->content_type) > 0 ? response->content_type : "application/json",
-						   response->body_length,
-						   response->headers,
-						   response->body);
-
-	return send(client_fd, response_buffer, (size_t) response_len, 0) > 0;
+		ok = ram_json_key_n(&w, name, strlen(name)) && ram_json_object_begin(&w);
+		for (int c = 0; ok && c < 2; c++)
+		{
+			ok = (c == 0 ? ram_json_key(&w, "avg") : ram_json_key(&w, "max")) &&
+				 ram_json_array_begin(&w);
+			for (int32_t i = 0; ok && i < count; i++)
+			{
+				int64_t v = c == 0 ? points[i].avg[s] : points[i].max[s];
+
+				if (!(points[i].present & (1u << s)))
+					ok = ram_json_null(&w);
+				else if (s == RAMD_HISTORY_HEALTH)
+					ok = ram_json_double(&w, (double) v / 1000.0, 3); /* kept per mille */
+				else
+					ok = ram_json_int(&w, v);
+			}
+			ok = ok && ram_json_array_end(&w);
+		}
+		ok = ok && ram_json_object_end(&w);
+	}
+	ok = ok && ram_json_object_end(&w) && ram_json_object_end(&w) &&
+		 ramd_http_json_end(response, &w);
+	ramd_mem_free(RAMD_MEM_HTTP, points);
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
 }
 
 void
-ramd_http_set_json_response(ramd_http_response_t *response, ramd_http_status_code_t status,
-						   const char *json)
+ramd_http_handle_replication_lag(ramd_http_request_t *request, ramd_http_response_t *response)
 {
-	if (!response)
+	ramd_lag_stats_t  stats[RAMD_MAX_NODES];
+	ramd_slot_stats_t slots[RAMD_MAX_NODES];
+	ramd_logical_slot_stats_t  logical[RAMD_MAX_LOGICAL_SLOTS];
+	ramd_logical_sync_method_t logical_method;
+	int32_t           count;
+	int32_t           slot_count;
+	int32_t           logical_count;
+	bool              ok;
+	int32_t           i;
+
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
 		return;
+	}
 
-	response->status = status;
-	strncpy(response->content_type, "application/json", sizeof(response->content_type) - 1);
+	count = ramd_lag_get_all(stats, RAMD_MAX_NODES);
 
-	if (json)
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, NULL);
+	ok = ramd_http_response_appendf(response, "{\n  \"standbys\": [");
+
+	for (i = 0; ok && i < count; i++)
 	{
-		strncpy(response->body, json, sizeof(response->body) - 1);
-		response->body_length = strlen(response->body);
+		const ramd_lag_stats_t *s = &stats[i];
+
+		ok = ramd_http_response_appendf(response,
+				"%s\n    {\n"
+				"      \"node_id\": %d,\n"
+				"      \"application_name\": \"%s\",\n"
+				"      \"client_addr\": \"%s\",\n"
+				"      \"connected\": %s,\n"
+				"      \"is_sync\": %s,\n"
+				"      \"sample_age_ms\": %lld,\n"
+				"      \"samples\": %d,\n"
+				"      \"write_lag_ms\": %d,\n"
+				"      \"flush_lag_ms\": %d,\n"
+				"      \"flush_lag_ewma_ms\": %.1f,\n"
+				"      \"replay_lag_ms\": %d,\n"
+				"      \"replay_lag_bytes\": %lld,\n"
+				"      \"replay_lag_ewma_ms\": %.1f,\n"
+				"      \"replay_lag_p99_ms\": %d,\n"
+				"      \"replay_lag_trend_bytes_per_second\": %.1f\n"
+				"    }",
+				i > 0 ? "," : "",
+				s->node_id,
+				s->application_name,
+				s->client_addr,
+				s->connected ? "true" : "false",
+				s->is_sync ? "true" : "false",
+				(long long) s->age_ms,
+				s->sample_count,
+				s->last.write_lag_ms,
+				s->last.flush_lag_ms,
+				s->ewma_flush_lag_ms,
+				s->last.replay_lag_ms,
+				(long long) s->last.replay_lag_bytes,
+				s->ewma_replay_lag_ms,
+				s->p99_replay_lag_ms,
+				s->trend_bytes_per_second);
 	}
-	else
+
+	slot_count = ramd_slots_get_all(slots, RAMD_MAX_NODES);
+	if (ok)
+		ok = ramd_http_response_appendf(response, "%s],\n  \"slots\": [",
+				count > 0 ? "\n  " : "");
+
+	for (i = 0; ok && i < slot_count; i++)
 	{
-		response->body[0] = '\0';
-		response->body_length = 0;
-	}
+		const ramd_slot_stats_t *s = &slots[i];
 
-	response->headers[0] = '\0';
-}
+		ok = ramd_http_response_appendf(response,
+				"%s\n    {\n"
+				"      \"slot_name\": \"%s\",\n"
+				"      \"node_id\": %d,\n"
+				"      \"active\": %s,\n"
+				"      \"released\": %s,\n"
+				"      \"retained_bytes\": %lld,\n"
+				"      \"safe_wal_size\": %lld,\n"
+				"      \"wal_status\": \"%s\",\n"
+				"      \"inactive_ms\": %lld\n"
+				"    }",
+				i > 0 ? "," : "",
+				s->slot_name,
+				s->node_id,
+				s->active ? "true" : "false",
+				s->released ? "true" : "false",
+				(long long) s->retained_bytes,
+				(long long) s->safe_wal_size,
+				s->wal_status,
+				(long long) s->inactive_ms);
+	}
 
-void
-ramd_http_set_error_response(ramd_http_response_t *response, ramd_http_status_code_t status,
-							const char *message)
-{
-	char json_buffer[RAMD_MAX_COMMAND_LENGTH];
+	logical_count = ramd_logical_slots_get_all(logical, RAMD_MAX_LOGICAL_SLOTS, &logical_method);
+	if (ok)
+		ok = ramd_http_response_appendf(response,
+				"%s],\n  \"logical_slot_sync\": \"%s\",\n  \"logical_slots\": [",
+				slot_count > 0 ? "\n  " : "",
+				ramd_logical_sync_method_to_string(logical_method));
 
-	snprintf(json_buffer, sizeof(json_buffer),
-			"{\n"
-			"  \"error\": \"%s\",\n"
-			"  \"status\": %d\n"
-			"}",
-			message ? message : "Unknown error",
-			status);
+	for (i = 0; ok && i < logical_count; i++)
+	{
+		const ramd_logical_slot_stats_t *s = &logical[i];
+
+		ok = ramd_http_response_appendf(response,
+				"%s\n    {\n"
+				"      \"slot_name\": \"%s\",\n"
+				"      \"plugin\": \"%s\",\n"
+				"      \"database\": \"%s\",\n"
+				"      \"active\": %s,\n"
+				"      \"failover\": %s,\n"
+				"      \"confirmed_lsn\": %lld,\n"
+				"      \"local_confirmed_lsn\": %lld,\n"
+				"      \"ready\": %s\n"
+				"    }",
+				i > 0 ? "," : "",
+				s->slot_name,
+				s->plugin,
+				s->database,
+				s->active ? "true" : "false",
+				s->failover ? "true" : "false",
+				(long long) s->confirmed_lsn,
+				(long long) s->local_confirmed_lsn,
+				s->ready ? "true" : "false");
+	}
 
-	ramd_http_set_json_response(response, status, json_buffer);
+	if (ok)
+		ok = ramd_http_response_appendf(response, "%s]\n}", logical_count > 0 ? "\n  " : "");
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
 }
 
 void
-ramd_http_handle_nodes_list(ramd_http_request_t *request, ramd_http_response_t *response)
+ramd_http_handle_replication_topology(ramd_http_request_t *request, ramd_http_response_t *response)
 {
-	char           json_buffer[RAMD_MAX_COMMAND_LENGTH];
-	ramd_cluster_t *cluster = &g_ramd_daemon->cluster;
-	char           nodes_array[RAMD_MAX_COMMAND_LENGTH] = "";
-	int            i;
-	size_t         current_len = 0;
-
-	(void) request;
+	ramd_topology_node_t nodes[RAMD_MAX_NODES];
+	int32_t              count;
+	int32_t              primary_node_id;
+	bool                 ok;
+	int32_t              i;
 
-	if (!cluster)
+	if (request->method != RAMD_HTTP_GET)
 	{
-		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Cluster not initialized");
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
 		return;
 	}
 
-	for (i = 0; i < cluster->node_count; i++)
+	/* Only the primary's daemon plans; elsewhere the list is empty */
+	count = ramd_topology_get_all(nodes, RAMD_MAX_NODES, &primary_node_id);
+
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, NULL);
+	ok = ramd_http_response_appendf(response,
+			"{\n  \"cascade_enabled\": %s,\n  \"primary_node_id\": %d,\n  \"standbys\": [",
+			g_ramd_daemon->config.cascade_enabled ? "true" : "false", primary_node_id);
+
+	for (i = 0; ok && i < count; i++)
 	{
-		const ramd_node_t *node = &cluster->nodes[i];
-		char              node_json[RAMD_MAX_COMMAND_LENGTH];
-		size_t            node_json_len;
+		const ramd_topology_node_t *n = &nodes[i];
 
-		snprintf(node_json, sizeof(node_json),
-				"%s{\n"
+		ok = ramd_http_response_appendf(response,
+				"%s\n    {\n"
 				"      \"node_id\": %d,\n"
-				"      \"name\": \"%s\",\n"
-				"      \"hostname\": \"%s\",\n"
-				"      \"postgresql_port\": %d,\n"
-				"      \"role\": \"%s\",\n"
-				"      \"state\": \"%s\",\n"
-				"      \"is_healthy\": %s,\n"
-				"      \"is_primary\": %s\n"
+				"      \"zone\": \"%s\",\n"
+				"      \"is_sync\": %s,\n"
+				"      \"upstream_node_id\": %d,\n"
+				"      \"applied_upstream_node_id\": %d,\n"
+				"      \"depth\": %d,\n"
+				"      \"downstream_count\": %d,\n"
+				"      \"replay_lag_ms\": %d\n"
 				"    }",
-				(i > 0) ? "," : "",
-				node->node_id,
-				node->hostname,
-				node->hostname,
-				node->postgresql_port,
-				(node->role == RAMD_ROLE_PRIMARY) ? "primary" : "standby",
-				(node->state == RAMD_NODE_STATE_UNKNOWN) ? "healthy" :
-				(node->state == RAMD_NODE_STATE_FAILED) ? "failed" : "unknown",
-				node->is_healthy ? "true" : "false",
-				(node->node_id == cluster->primary_node_id) ? "true" : "false");
-
-		node_json_len = strlen(node_json);
-		if (current_len + node_json_len < sizeof(nodes_array) - 1)
-		{
-			strncat(nodes_array, node_json, sizeof(nodes_array) - current_len - 1);
-			current_len += node_json_len;
-		}
-		else
-		{
-			ramd_log_error("Node JSON too large for buffer");
-			break;
-		}
+				i > 0 ? "," : "",
+				n->node_id,
+				n->zone,
+				n->is_sync ? "true" : "false",
+				n->upstream_node_id,
+				n->applied_upstream_id,
+				n->depth,
+				n->downstream_count,
+				n->replay_lag_ms);
 	}
 
-	snprintf(json_buffer, sizeof(json_buffer),
-			"{\n"
-			"  \"status\": \"success\",\n"
-			"  \"data\": {\n"
-			"    \"nodes\": [\n"
-			"      %s\n"
-			"    ],\n"
-			"    \"total_count\": %d\n"
-			"  }\n"
-			"}",
-			nodes_array,
-			cluster->node_count);
-
-	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
+	if (ok)
+		ok = ramd_http_response_appendf(response, "%s]\n}", count > 0 ? "\n  " : "");
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
 }
 
-void
-ramd_http_handle_failover(ramd_http_request_t *request, ramd_http_response_t *response)
+/* Runs as a job; see ramd_http_handle_failover */
+static void
+ramd_http_run_failover(ramd_http_request_t *request, ramd_http_response_t *response)
 {
 	char                    json_buffer[RAMD_MAX_COMMAND_LENGTH];
 	ramd_cluster_t         *cluster = &g_ramd_daemon->cluster;
 	ramd_failover_context_t failover_context;
 
-	if (request->method != RAMD_HTTP_POST)
-	{
-		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
-		return;
-	}
+	(void) request;
+	ramd_job_phase("evaluate");
 
 	if (!cluster)
 	{
@@ -1032,6 +3945,7 @@ ramd_http_handle_failover(ramd_http_request_t *request, ramd_http_response_t *re
 
 	ramd_failover_context_init(&failover_context);
 
+	ramd_job_phase("execute");
 	if (ramd_failover_execute(cluster, &g_ramd_daemon->config, &failover_context))
 	{
 		snprintf(json_buffer, sizeof(json_buffer),
@@ -1060,6 +3974,273 @@ ramd_http_handle_failover(ramd_http_request_t *request, ramd_http_response_t *re
 	ramd_failover_context_cleanup(&failover_context);
 }
 
+void
+ramd_http_handle_rebuild(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	char                  json_buffer[RAMD_MAX_COMMAND_LENGTH * 2];
+	ramd_rebuild_status_t status;
+	ramd_cluster_t       *cluster = &g_ramd_daemon->cluster;
+	ramd_node_t          *primary;
+	double                percent = 0.0;
+
+	if (request->method == RAMD_HTTP_POST)
+	{
+		primary = ramd_cluster_get_primary_node(cluster);
+		if (!primary || primary->node_id == g_ramd_daemon->config.node_id)
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_409_CONFLICT,
+										 "No remote primary to rebuild from");
+			return;
+		}
+		if (!ramd_rebuild_start(cluster, primary->node_id))
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_409_CONFLICT,
+										 "Rebuild already in progress");
+			return;
+		}
+	}
+	else if (request->method == RAMD_HTTP_DELETE)
+	{
+		if (!ramd_rebuild_cancel())
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_409_CONFLICT,
+										 "No rebuild in progress");
+			return;
+		}
+	}
+	else if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	ramd_rebuild_get_status(&status);
+	if (status.bytes_total > 0)
+		percent = 100.0 * (double) status.bytes_done / (double) status.bytes_total;
+
+	snprintf(json_buffer, sizeof(json_buffer),
+			"{\n"
+			"  \"node_id\": %d,\n"
+			"  \"state\": \"%s\",\n"
+			"  \"method\": \"%s\",\n"
+			"  \"phase\": \"%s\",\n"
+			"  \"source_node_id\": %d,\n"
+			"  \"source\": \"%s:%d\",\n"
+			"  \"queue_position\": %d,\n"
+			"  \"rate_limit_kbps\": %d,\n"
+			"  \"bytes_total\": %lld,\n"
+			"  \"bytes_done\": %lld,\n"
+			"  \"percent\": %.1f,\n"
+			"  \"bytes_per_second\": %lld,\n"
+			"  \"eta_seconds\": %lld,\n"
+			"  \"started_at\": %ld,\n"
+			"  \"finished_at\": %ld,\n"
+			"  \"message\": \"%s\"\n"
+			"}",
+			status.node_id,
+			ramd_rebuild_state_to_string(status.state),
+			ramd_rebuild_method_to_string(status.method),
+			status.phase,
+			status.source_node_id,
+			status.source_host, status.source_port,
+			status.queue_position,
+			status.rate_limit_kbps,
+			(long long) status.bytes_total,
+			(long long) status.bytes_done,
+			percent,
+			(long long) status.bytes_per_second,
+			(long long) status.eta_seconds,
+			(long) status.started_at,
+			(long) status.finished_at,
+			status.message);
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
+}
+
+void
+ramd_http_handle_switchover(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	char                     json_buffer[RAMD_MAX_COMMAND_LENGTH * 3];
+	char                     error[RAMD_MAX_COMMAND_LENGTH];
+	ramd_switchover_status_t status;
+	ramd_prewarm_status_t    prewarm;
+	int32_t                  target_node_id = 0;
+	json_t                  *json;
+	json_t                  *target_json;
+
+	if (request->method == RAMD_HTTP_POST)
+	{
+		/* The body is optional; without a target the best standby is chosen */
+		if (request->body_length > 0)
+		{
+			json = json_loads(request->body, 0, NULL);
+			if (!json)
+			{
+				ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "Invalid JSON");
+				return;
+			}
+			target_json = json_object_get(json, "target_node_id");
+			if (target_json && !json_is_integer(target_json))
+			{
+				json_decref(json);
+				ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+											 "target_node_id must be an integer");
+				return;
+			}
+			if (target_json)
+				target_node_id = (int32_t) json_integer_value(target_json);
+			json_decref(json);
+		}
+
+		if (!ramd_switchover_start(&g_ramd_daemon->cluster, target_node_id,
+								   error, sizeof(error)))
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_409_CONFLICT, error);
+			return;
+		}
+	}
+	else if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	ramd_switchover_get_status(&status);
+	ramd_prewarm_get_status(&prewarm);
+	snprintf(json_buffer, sizeof(json_buffer),
+			"{\n"
+			"  \"state\": \"%s\",\n"
+			"  \"phase\": \"%s\",\n"
+			"  \"old_primary_node_id\": %d,\n"
+			"  \"target_node_id\": %d,\n"
+			"  \"target_lsn\": %lld,\n"
+			"  \"phase_ms\": {\"fence\": %lld, \"catchup\": %lld, \"shutdown\": %lld, "
+			"\"promote\": %lld, \"repoint\": %lld, \"rejoin\": %lld},\n"
+			"  \"total_ms\": %lld,\n"
+			"  \"standbys_repointed\": %d,\n"
+			"  \"standbys_total\": %d,\n"
+			"  \"prewarm\": {\"state\": \"%s\", \"target_node_id\": %d, \"workers\": %d, "
+			"\"blocks_total\": %lld, \"blocks_done\": %lld, \"blocks_loaded\": %lld, "
+			"\"databases_skipped\": %d, \"duration_ms\": %lld, \"message\": \"%s\"},\n"
+			"  \"started_at\": %ld,\n"
+			"  \"finished_at\": %ld,\n"
+			"  \"message\": \"%s\"\n"
+			"}",
+			ramd_switchover_state_to_string(status.state),
+			ramd_switchover_phase_to_string(status.phase),
+			status.old_primary_node_id,
+			status.target_node_id,
+			(long long) status.target_lsn,
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_FENCE],
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_CATCHUP],
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_SHUTDOWN],
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_PROMOTE],
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_REPOINT],
+			(long long) status.phase_ms[RAMD_SWITCHOVER_PHASE_REJOIN],
+			(long long) status.total_ms,
+			status.standbys_repointed,
+			status.standbys_total,
+			ramd_prewarm_state_to_string(prewarm.state),
+			prewarm.target_node_id,
+			prewarm.workers,
+			(long long) prewarm.blocks_total,
+			(long long) prewarm.blocks_done,
+			(long long) prewarm.blocks_loaded,
+			prewarm.databases_skipped,
+			(long long) prewarm.duration_ms,
+			prewarm.message,
+			(long) status.started_at,
+			(long) status.finished_at,
+			status.message);
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
+}
+
+static bool
+ramd_http_write_rolling(ram_json_writer_t *w, const ramd_rolling_report_t *report)
+{
+	bool ok;
+
+	ok = ram_json_object_begin(w) &&
+		 ram_json_kv_string(w, "operation", ramd_rolling_operation_to_string(report->operation)) &&
+		 ram_json_kv_bool(w, "ok", report->ok) &&
+		 ram_json_kv_int(w, "parallel", report->parallel) &&
+		 ram_json_kv_int(w, "old_primary_node_id", report->old_primary_node_id) &&
+		 ram_json_kv_int(w, "new_primary_node_id", report->new_primary_node_id) &&
+		 ram_json_kv_int(w, "switchover_ms", report->switchover_ms) &&
+		 ram_json_kv_int(w, "total_ms", report->total_ms) &&
+		 ram_json_kv_string(w, "message", report->message) &&
+		 ram_json_key(w, "nodes") && ram_json_array_begin(w);
+
+	for (int32_t i = 0; ok && i < report->node_count; i++)
+	{
+		const ramd_rolling_node_t *node = &report->nodes[i];
+
+		ok = ram_json_object_begin(w) &&
+			 ram_json_kv_int(w, "node_id", node->node_id) &&
+			 ram_json_kv_string(w, "role", node->role == RAMD_ROLE_PRIMARY ? "primary" : "standby") &&
+			 ram_json_kv_bool(w, "ok", node->ok) &&
+			 ram_json_kv_int(w, "started_ms", node->started_ms) &&
+			 ram_json_kv_int(w, "command_ms", node->command_ms) &&
+			 ram_json_kv_int(w, "catchup_ms", node->catchup_ms) &&
+			 ram_json_kv_string(w, "message", node->message) &&
+			 ram_json_object_end(w);
+	}
+
+	return ok && ram_json_array_end(w) && ram_json_object_end(w);
+}
+
+/* Runs as a job; see ramd_http_handle_rolling */
+static void
+ramd_http_run_rolling(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_rolling_report_t   *report;
+	ramd_rolling_operation_t operation;
+	ram_json_writer_t        w;
+	int32_t                  max_parallel = 0;
+	int32_t                  target_node_id = 0;
+	json_t                  *json;
+	json_t                  *value;
+	bool                     ok;
+
+	json = json_loads(request->body, 0, NULL);
+	if (!json)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "Invalid JSON");
+		return;
+	}
+	if (!ramd_rolling_parse_operation(json_string_value(json_object_get(json, "operation")),
+									  &operation))
+	{
+		json_decref(json);
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "operation must be restart, minor_upgrade or os_patch");
+		return;
+	}
+	value = json_object_get(json, "max_parallel");
+	if (value && json_is_integer(value))
+		max_parallel = (int32_t) json_integer_value(value);
+	value = json_object_get(json, "target_node_id");
+	if (value && json_is_integer(value))
+		target_node_id = (int32_t) json_integer_value(value);
+	json_decref(json);
+
+	report = ramd_arena_alloc(request->arena, sizeof(*report));
+	if (!report)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	ok = ramd_rolling_run(&g_ramd_daemon->cluster, &g_ramd_daemon->config, operation,
+						  max_parallel, target_node_id, report);
+
+	ramd_http_json_begin(response, &w);
+	if (!ramd_http_write_rolling(&w, report) || !ramd_http_json_end(response, &w))
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+	else if (!ok)
+		response->status = report->node_count > 0 ? RAMD_HTTP_500_INTERNAL_ERROR
+												  : RAMD_HTTP_409_CONFLICT;
+}
+
 void
 ramd_http_handle_sync_replication(ramd_http_request_t *request, ramd_http_response_t *response)
 {
@@ -1320,18 +4501,19 @@ void ramd_http_handle_node_detail(ramd_http_request_t* request __attribute__((un
 		return;
 	}
 
-	
-	ramd_cluster_t* cluster = &g_ramd_daemon->cluster;
+	/* The monitor's last published cycle, not the struct it is updating */
+	const ramd_cluster_t* cluster = ramd_cluster_acquire();
 	if (!cluster)
 	{
-		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+		ramd_http_set_error_response(response, RAMD_HTTP_503_SERVICE_UNAVAILABLE,
 		                             "Cluster not initialized");
 		return;
 	}
 
-	const ramd_node_t* node = ramd_cluster_find_node(cluster, node_id);
+	const ramd_node_t* node = ramd_cluster_find_node((ramd_cluster_t*) cluster, node_id);
 	if (!node)
 	{
+		ramd_cluster_release(cluster);
 		ramd_http_set_error_response(response, RAMD_HTTP_404_NOT_FOUND,
 		                             "Node not found");
 		return;
@@ -1348,7 +4530,8 @@ void ramd_http_handle_node_detail(ramd_http_request_t* request __attribute__((un
 	         "    \"role\": \"%s\",\n"
 	         "    \"state\": \"%s\",\n"
 	         "    \"is_healthy\": %s,\n"
-	         "    \"is_primary\": %s\n"
+	         "    \"is_primary\": %s,\n"
+	         "    \"voting\": %s\n"
 	         "  }\n"
 	         "}",
 	         node->node_id, node->hostname, node->hostname,
@@ -1358,7 +4541,9 @@ void ramd_http_handle_node_detail(ramd_http_request_t* request __attribute__((un
 	         : (node->state == RAMD_NODE_STATE_FAILED) ? "failed"
 	                                                   : "unknown",
 	         node->is_healthy ? "true" : "false",
-	         (node->node_id == cluster->primary_node_id) ? "true" : "false");
+	         (node->node_id == cluster->primary_node_id) ? "true" : "false",
+	         node->is_voter ? "true" : "false");
+	ramd_cluster_release(cluster);
 
 	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_buffer);
 }
@@ -1427,17 +4612,13 @@ void ramd_http_handle_maintenance_mode(ramd_http_request_t* request __attribute_
 	}
 }
 
-void ramd_http_handle_bootstrap_primary(ramd_http_request_t* request __attribute__((unused)),
-                                        ramd_http_response_t* response)
+/* Runs as a job; see ramd_http_handle_bootstrap_primary */
+static void ramd_http_run_bootstrap_primary(ramd_http_request_t* request __attribute__((unused)),
+                                            ramd_http_response_t* response)
 {
 	char json_buffer[RAMD_MAX_COMMAND_LENGTH];
 
-	if (request->method != RAMD_HTTP_POST)
-	{
-		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
-		                             "Method not allowed");
-		return;
-	}
+	ramd_job_phase("register");
 
 	ramd_cluster_t* cluster = &g_ramd_daemon->cluster;
 	if (!cluster)
@@ -1475,6 +4656,7 @@ void ramd_http_handle_bootstrap_primary(ramd_http_request_t* request __attribute
 		         g_ramd_daemon->config.postgresql_data_dir,
 		         cluster->cluster_name);
 
+		ramd_job_phase("initdb");
 		if (ramd_maintenance_bootstrap_primary_node(
 		        &g_ramd_daemon->config, cluster->cluster_name,
 		        g_ramd_daemon->config.hostname,
@@ -1489,11 +4671,13 @@ void ramd_http_handle_bootstrap_primary(ramd_http_request_t* request __attribute
 			        sizeof(g_ramd_daemon->config.postgresql_data_dir) - 1);
 
 			
+			ramd_job_phase("start");
 			if (ramd_postgresql_start(&g_ramd_daemon->config))
 			{
 				
 				ramd_log_info("PostgreSQL started successfully, creating "
 				              "pgraft extension");
+				ramd_job_phase("pgraft");
 
 				if (!ramd_postgresql_create_pgraft_extension(
 				        &g_ramd_daemon->config))
@@ -1573,39 +4757,62 @@ void ramd_http_handle_bootstrap_primary(ramd_http_request_t* request __attribute
 }
 
 
+/* Find name's value in a query string; its length goes to value_length */
+static const char*
+ramd_http_query_find(const char* query_string, const char* name, size_t* value_length)
+{
+	size_t name_length = strlen(name);
+	const char* pair = query_string;
+
+	while (pair && *pair)
+	{
+		const char* end = strchr(pair, '&');
+		size_t pair_length = end ? (size_t) (end - pair) : strlen(pair);
+
+		if (pair_length > name_length && pair[name_length] == '=' &&
+			strncmp(pair, name, name_length) == 0)
+		{
+			*value_length = pair_length - name_length - 1;
+			return pair + name_length + 1;
+		}
+		pair = end ? end + 1 : NULL;
+	}
+	return NULL;
+}
+
 char* ramd_http_get_query_param(const char* query_string,
                                 const char* param_name)
 {
+	const char* value;
+	size_t length;
+	char* copy;
+
 	if (!query_string || !param_name)
-	{
 		return NULL;
-	}
-	
-	char* query_copy = strdup(query_string);
-	if (!query_copy)
-	{
+
+	value = ramd_http_query_find(query_string, param_name, &length);
+	if (!value)
 		return NULL;
-	}
-	
-	char* token = strtok(query_copy, "&");
-	while (token != NULL)
+	copy = malloc(length + 1);
+	if (copy)
 	{
-		char* equals = strchr(token, '=');
-		if (equals)
-		{
-			*equals = '\0';
-			if (strcmp(token, param_name) == 0)
-			{
-				char* value = strdup(equals + 1);
-				free(query_copy);
-				return value;
-			}
-		}
-		token = strtok(NULL, "&");
+		memcpy(copy, value, length);
+		copy[length] = '\0';
 	}
-	
-	free(query_copy);
-	return NULL;
+	return copy;
+}
+
+/* A query parameter copied into the request's arena, NULL when absent */
+const char* ramd_http_request_param(ramd_http_request_t* request, const char* name)
+{
+	const char* value;
+	size_t length;
+
+	if (!request || !request->query_string || !name)
+		return NULL;
+
+	value = ramd_http_query_find(request->query_string, name, &length);
+	return value ? ramd_arena_strndup(request->arena, value, length) : NULL;
 }
 
 bool ramd_http_authenticate(const char* authorization,
@@ -1618,20 +4825,17 @@ bool ramd_http_authenticate(const char* authorization,
 }
 
 
-void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((unused)),
-                                  ramd_http_response_t* response)
+/* Runs as a job; see ramd_http_handle_add_replica */
+static void ramd_http_run_add_replica(ramd_http_request_t* request,
+                                      ramd_http_response_t* response)
 {
 	char json_buffer[RAMD_MAX_COMMAND_LENGTH];
 	char hostname[RAMD_MAX_USERNAME_LENGTH] = {0};
 	int32_t port = g_ramd_daemon->config.postgresql_port;
 	int32_t new_node_id;
+	bool voting = true;
 
-	if (request->method != RAMD_HTTP_POST)
-	{
-		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
-		                             "Method not allowed - use POST");
-		return;
-	}
+	ramd_job_phase("register");
 
 	
 	if (request->body[0] != '\0')
@@ -1666,6 +4870,11 @@ void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((un
 				port_start++;
 			port = atoi(port_start);
 		}
+
+		/* "voting": false sets the replica up as a Raft learner */
+		if (strstr(request->body, "\"voting\": false") ||
+		    strstr(request->body, "\"voting\":false"))
+			voting = false;
 	}
 
 	if (strlen(hostname) == 0)
@@ -1707,6 +4916,7 @@ void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((un
 
 	
 	ramd_log_info("Setting up PostgreSQL replica for node %d", new_node_id);
+	ramd_job_phase("basebackup");
 
 	if (!ramd_maintenance_setup_replica(&g_ramd_daemon->config,
 	                                    cluster->cluster_name, hostname, port,
@@ -1729,6 +4939,7 @@ void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((un
 	
 	ramd_log_info("Installing pgraft extension on replica node %d",
 	              new_node_id);
+	ramd_job_phase("pgraft");
 	
 	
 	
@@ -1819,6 +5030,34 @@ void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((un
 
 	
 	ramd_log_info("Adding node %d to pgraft consensus", new_node_id);
+	ramd_job_phase("consensus");
+
+	/* This node proposes the learner, so the replica never enters the quorum */
+	if (!voting)
+	{
+		PGconn *local_conn = ramd_conn_checkout(g_ramd_daemon->config.node_id,
+		                                        g_ramd_daemon->config.hostname,
+		                                        g_ramd_daemon->config.postgresql_port,
+		                                        g_ramd_daemon->config.database_name,
+		                                        g_ramd_daemon->config.database_user,
+		                                        g_ramd_daemon->config.database_password);
+		ramd_node_t *new_node = ramd_cluster_find_node(cluster, new_node_id);
+		bool added = local_conn &&
+		             ramd_pgraft_add_node(local_conn, new_node_id, hostname, port, false) ==
+		                 RAMD_PGRAFT_SUCCESS;
+
+		ramd_conn_checkin(g_ramd_daemon->config.node_id, local_conn);
+		if (!added)
+		{
+			ramd_log_error("Failed to add node %d as a Raft learner: %s", new_node_id,
+			               ramd_pgraft_get_last_error());
+			ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+			                             "Failed to add replica as a Raft learner");
+			return;
+		}
+		if (new_node)
+			new_node->is_voter = false;
+	}
 	
 	
 	
@@ -1897,6 +5136,387 @@ void ramd_http_handle_add_replica(ramd_http_request_t* request __attribute__((un
 	              hostname, port);
 }
 
+/*
+ * Long-running operations are answered with 202 Accepted and a job id and
+ * then run on the job pool (ramd_job.c), so neither the client's socket
+ * nor an HTTP worker is held for the minutes a base backup can take.  The
+ * operation itself is the synchronous handler above, run against a copy
+ * of the request; whatever it would have answered becomes the job result.
+ */
+typedef struct ramd_http_job_t
+{
+	void (*run)(ramd_http_request_t *request, ramd_http_response_t *response);
+	char   path[RAMD_MAX_PATH_LENGTH];
+	size_t body_length;
+	char   body[];
+} ramd_http_job_t;
+
+static void
+ramd_http_job_run(void *arg)
+{
+	ramd_http_job_t      *job = arg;
+	ramd_http_request_t   request;
+	ramd_http_response_t *response;
+	ramd_arena_t          arena;
+	const char           *body;
+	size_t                length;
+
+	response = ramd_mem_calloc(RAMD_MEM_BACKUP, 1, sizeof(*response));
+	if (!response)
+	{
+		ramd_job_finish(false, RAMD_HTTP_500_INTERNAL_ERROR, NULL, 0);
+		return;
+	}
+	ramd_buffer_init_subsystem(&response->content, RAMD_MEM_BACKUP);
+	ramd_arena_init(&arena, RAMD_MEM_BACKUP, 0);
+
+	memset(&request, 0, sizeof(request));
+	request.method = RAMD_HTTP_POST;
+	request.path = job->path;
+	request.query_string = job->path + strlen(job->path);
+	request.body = job->body;
+	request.body_length = job->body_length;
+	request.arena = &arena;
+
+	job->run(&request, response);
+
+	/* Some failure paths only log; report those as a plain error */
+	if (response->status == 0)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+									 "Operation failed, see the ramd log");
+
+	body = ramd_http_response_body(response, &length);
+	ramd_job_finish(response->status < 300, (int32_t) response->status, body, length);
+
+	ramd_http_response_reset(response);
+	ramd_buffer_free(&response->content);
+	ramd_mem_free(RAMD_MEM_BACKUP, response);
+	ramd_arena_destroy(&arena);
+}
+
+static bool
+ramd_http_write_job(ram_json_writer_t *w, const ramd_job_status_t *status,
+					const char *result, size_t result_length)
+{
+	bool ok;
+
+	ok = ram_json_object_begin(w) &&
+		 ram_json_kv_uint(w, "job_id", status->job_id) &&
+		 ram_json_kv_string(w, "operation", status->operation) &&
+		 ram_json_kv_string(w, "state", ramd_job_state_to_string(status->state)) &&
+		 ram_json_kv_string(w, "phase", status->phase_count > 0 ?
+							status->phases[status->phase_count - 1].name : "") &&
+		 ram_json_kv_int(w, "queue_position", status->queue_position) &&
+		 ram_json_kv_int(w, "progress_percent", status->progress_percent) &&
+		 ram_json_key(w, "phases") && ram_json_array_begin(w);
+
+	for (int32_t i = 0; ok && i < status->phase_count; i++)
+		ok = ram_json_object_begin(w) &&
+			 ram_json_kv_string(w, "name", status->phases[i].name) &&
+			 ram_json_kv_int(w, "started_ms", status->phases[i].started_ms) &&
+			 ram_json_kv_int(w, "duration_ms", status->phases[i].duration_ms) &&
+			 ram_json_object_end(w);
+
+	ok = ok && ram_json_array_end(w) &&
+		 ram_json_kv_int(w, "total_ms", status->total_ms) &&
+		 ram_json_kv_int(w, "created_at", status->created_at) &&
+		 ram_json_kv_int(w, "started_at", status->started_at) &&
+		 ram_json_kv_int(w, "finished_at", status->finished_at);
+
+	if (ok && status->state >= RAMD_JOB_SUCCEEDED)
+	{
+		ok = ram_json_kv_int(w, "result_status", status->result_status) &&
+			 ram_json_key(w, "result");
+		if (ok && result && result_length > 0 && (result[0] == '{' || result[0] == '['))
+			ok = ram_json_raw(w, result, result_length);
+		else if (ok)
+			ok = ram_json_null(w);
+	}
+
+	return ok && ram_json_object_end(w);
+}
+
+/* Queue run for the request and answer 202 with where to poll */
+static void
+ramd_http_submit_job(ramd_http_request_t *request, ramd_http_response_t *response,
+					 const char *operation,
+					 void (*run)(ramd_http_request_t *request, ramd_http_response_t *response))
+{
+	ramd_http_job_t  *job;
+	ramd_job_status_t status;
+	ram_json_writer_t w;
+	uint64_t          job_id;
+
+	if (request->method != RAMD_HTTP_POST)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
+									 "Method not allowed - use POST");
+		return;
+	}
+
+	job = malloc(sizeof(*job) + request->body_length + 1);
+	if (!job)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+	job->run = run;
+	snprintf(job->path, sizeof(job->path), "%s", request->path);
+	job->body_length = request->body_length;
+	if (request->body_length > 0)
+		memcpy(job->body, request->body, request->body_length);
+	job->body[request->body_length] = '\0';
+
+	if (!ramd_job_submit(operation, ramd_http_job_run, job, free, &job_id))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_503_SERVICE_UNAVAILABLE,
+									 "Too many jobs in progress");
+		return;
+	}
+
+	if (!ramd_job_get(job_id, &status, NULL, NULL))
+	{
+		/* Evicted already; only possible under a flood of finished jobs */
+		memset(&status, 0, sizeof(status));
+		status.job_id = job_id;
+		snprintf(status.operation, sizeof(status.operation), "%s", operation);
+	}
+
+	ramd_http_json_begin(response, &w);
+	if (!ramd_http_write_job(&w, &status, NULL, 0) || !ramd_http_json_end(response, &w))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+	response->status = RAMD_HTTP_202_ACCEPTED;
+	snprintf(response->headers, sizeof(response->headers),
+			 "Location: /api/v1/jobs/%llu\r\n", (unsigned long long) job_id);
+}
+
+/* POST /api/v1/failover: 202 with a job id; poll /api/v1/jobs/{id} */
+void
+ramd_http_handle_failover(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_submit_job(request, response, "failover", ramd_http_run_failover);
+}
+
+/* POST /api/v1/bootstrap/primary: 202 with a job id */
+void
+ramd_http_handle_bootstrap_primary(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_submit_job(request, response, "bootstrap_primary", ramd_http_run_bootstrap_primary);
+}
+
+/* POST /api/v1/replica/add: 202 with a job id; the base backup runs in the job */
+void
+ramd_http_handle_add_replica(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_http_submit_job(request, response, "add_replica", ramd_http_run_add_replica);
+}
+
+/*
+ * POST /api/v1/cluster/rolling: 202 with a job id.  The body names the
+ * operation ("restart", "minor_upgrade" or "os_patch") and optionally
+ * max_parallel and the switchover's target_node_id; the job's phases time
+ * precheck, standbys, switchover and old_primary, and its result times
+ * every node.
+ */
+void
+ramd_http_handle_rolling(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	if (request->method == RAMD_HTTP_POST && g_ramd_daemon->config.rolling_node_command[0] == '\0')
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_409_CONFLICT,
+									 "rolling_node_command is not configured");
+		return;
+	}
+	ramd_http_submit_job(request, response, "rolling", ramd_http_run_rolling);
+}
+
+/*
+ * GET /api/v1/jobs, GET /api/v1/jobs/{id}
+ *
+ * The list holds the last RAMD_JOB_HISTORY_SIZE jobs, newest first, without
+ * their results; a single job carries phase timings and, once finished,
+ * the HTTP status and JSON body the operation produced.
+ */
+void
+ramd_http_handle_jobs(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ramd_job_status_t *statuses;
+	ramd_job_status_t  status;
+	ram_json_writer_t  w;
+	const char        *id;
+	char              *end;
+	char              *result;
+	size_t             result_length;
+	uint64_t           job_id;
+	int32_t            count;
+	bool               ok;
+
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	id = request->path + strlen("/api/v1/jobs");
+	if (*id == '/' && id[1] != '\0')
+	{
+		job_id = strtoull(id + 1, &end, 10);
+		if (*end != '\0' || !ramd_job_get(job_id, &status, &result, &result_length))
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_404_NOT_FOUND, "Job not found");
+			return;
+		}
+
+		ramd_http_json_begin(response, &w);
+		ok = ramd_http_write_job(&w, &status, result, result_length) &&
+			 ramd_http_json_end(response, &w);
+		free(result);
+		if (!ok)
+			ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	statuses = ramd_arena_calloc(request->arena, RAMD_JOB_HISTORY_SIZE, sizeof(*statuses));
+	if (!statuses)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+	count = ramd_job_list(statuses, RAMD_JOB_HISTORY_SIZE);
+
+	ramd_http_json_begin(response, &w);
+	ok = ram_json_object_begin(&w) && ram_json_key(&w, "jobs") && ram_json_array_begin(&w);
+	for (int32_t i = 0; ok && i < count; i++)
+		ok = ramd_http_write_job(&w, &statuses[i], NULL, 0);
+	ok = ok && ram_json_array_end(&w) && ram_json_object_end(&w) &&
+		 ramd_http_json_end(response, &w);
+	if (!ok)
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+}
+
+/*
+ * GET /api/v1/backup/jobs, GET /api/v1/backup/jobs/{id}/logs
+ *
+ * The list carries each job's progress as parsed from the tool's output;
+ * the logs are the newest RAMD_BACKUP_LOG_SIZE bytes of that output as
+ * plain text, oldest line first.
+ */
+void
+ramd_http_handle_backup_jobs(ramd_http_request_t *request, ramd_http_response_t *response)
+{
+	ram_json_writer_t w;
+	const char       *id;
+	char             *end;
+	char             *logs;
+	long              job_id;
+
+	if (request->method != RAMD_HTTP_GET)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED, "Method not allowed");
+		return;
+	}
+
+	id = request->path + strlen("/api/v1/backup/jobs");
+	if (*id == '/' && id[1] != '\0')
+	{
+		job_id = strtol(id + 1, &end, 10);
+		if (strcmp(end, "/logs") != 0 || job_id <= 0 || job_id > INT32_MAX)
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_404_NOT_FOUND, "Not found");
+			return;
+		}
+
+		logs = malloc(RAMD_BACKUP_LOG_SIZE + 1);
+		if (!logs)
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+			return;
+		}
+		if (!ramd_backup_get_job_logs((int) job_id, logs, RAMD_BACKUP_LOG_SIZE + 1))
+		{
+			free(logs);
+			ramd_http_set_error_response(response, RAMD_HTTP_404_NOT_FOUND, "Backup job not found");
+			return;
+		}
+		ramd_http_set_owned_body(response, RAMD_HTTP_200_OK, "text/plain; charset=utf-8",
+								 logs, strlen(logs));
+		return;
+	}
+
+	ramd_http_json_begin(response, &w);
+	if (!ramd_backup_list_jobs(&w) || !ramd_http_json_end(response, &w))
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Out of memory");
+}
+
+
+/* True if the client listed gzip in Accept-Encoding */
+static bool
+ramd_http_accepts_gzip(const ramd_http_request_t* request)
+{
+	const char* value;
+	size_t      length;
+	size_t      i;
+
+	value = ramd_http_get_header(request, "Accept-Encoding", &length);
+	if (!value)
+		return false;
+
+	for (i = 0; i + 4 <= length; i++)
+	{
+		if (strncasecmp(value + i, "gzip", 4) == 0 &&
+		    (i == 0 || value[i - 1] == ' ' || value[i - 1] == ',') &&
+		    (i + 4 == length || value[i + 4] == ' ' || value[i + 4] == ',' ||
+		     value[i + 4] == ';'))
+			return true;
+	}
+	return false;
+}
+
+static void
+ramd_http_release_snapshot(void* context)
+{
+	ramd_prometheus_snapshot_release((ramd_prometheus_snapshot_t*) context);
+}
+
+/*
+ * Serve the collector's pre-rendered exposition; the response borrows the
+ * snapshot so nothing is rendered or copied per scrape.  Returns false if
+ * no snapshot exists yet and the caller should render on demand.
+ */
+static bool
+ramd_http_serve_snapshot(ramd_http_request_t* request, ramd_http_response_t* response,
+                         ramd_prometheus_exposition_t which)
+{
+	ramd_prometheus_snapshot_t* snapshot;
+
+	snapshot = ramd_prometheus_snapshot_acquire(which);
+	if (!snapshot)
+		return false;
+
+	if (snapshot->gzip && ramd_http_accepts_gzip(request))
+	{
+		ramd_http_set_shared_body(response, RAMD_HTTP_200_OK,
+		                          "text/plain; version=0.0.4; charset=utf-8",
+		                          snapshot->gzip, snapshot->gzip_length,
+		                          ramd_http_release_snapshot, snapshot);
+		strncpy(response->headers, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n",
+		        sizeof(response->headers) - 1);
+	}
+	else
+	{
+		ramd_http_set_shared_body(response, RAMD_HTTP_200_OK,
+		                          "text/plain; version=0.0.4; charset=utf-8",
+		                          snapshot->text, snapshot->text_length,
+		                          ramd_http_release_snapshot, snapshot);
+		if (snapshot->gzip)
+			strncpy(response->headers, "Vary: Accept-Encoding\r\n",
+			        sizeof(response->headers) - 1);
+	}
+	return true;
+}
 
 void ramd_http_handle_metrics(ramd_http_request_t* request __attribute__((unused)),
                               ramd_http_response_t* response)
@@ -1908,6 +5528,9 @@ void ramd_http_handle_metrics(ramd_http_request_t* request __attribute__((unused
 		return;
 	}
 
+	if (ramd_http_serve_snapshot(request, response, RAMD_PROMETHEUS_EXPOSITION_CLUSTER))
+		return;
+
 	if (!g_ramd_daemon || !g_ramd_metrics)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_503_SERVICE_UNAVAILABLE,
@@ -1915,54 +5538,46 @@ void ramd_http_handle_metrics(ramd_http_request_t* request __attribute__((unused
 		return;
 	}
 
-	
-	ramd_metrics_collect(g_ramd_metrics, &g_ramd_daemon->cluster);
+	{
+		const ramd_cluster_t* cluster = ramd_cluster_acquire();
+
+		if (cluster)
+		{
+			ramd_metrics_collect(g_ramd_metrics, cluster);
+			ramd_cluster_release(cluster);
+		}
+	}
 
 	
-	char* prometheus_output = ramd_metrics_to_prometheus(g_ramd_metrics);
-	if (!prometheus_output)
+	ramd_http_response_reset(response);
+	if (!ramd_metrics_render_prometheus(g_ramd_metrics, &response->content))
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
 		                             "Failed to generate metrics");
 		return;
 	}
 
-	
 	strncpy(response->content_type, "text/plain; version=0.0.4; charset=utf-8",
 	        sizeof(response->content_type) - 1);
-	
-	
-	size_t output_len = strlen(prometheus_output);
-	if (output_len < sizeof(response->body))
-	{
-		strncpy(response->body, prometheus_output, output_len);
-		response->body_length = output_len;
-		response->status = RAMD_HTTP_200_OK;
-	}
-	else
-	{
-		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
-		                             "Metrics output too large");
-	}
-
-	
-	ramd_metrics_free_prometheus_output(prometheus_output);
+	response->status = RAMD_HTTP_200_OK;
 }
 
 void
 ramd_http_handle_prometheus_metrics(ramd_http_request_t* request __attribute__((unused)), ramd_http_response_t* response)
 {
-	char prometheus_buffer[8192];
-	
 	if (request->method != RAMD_HTTP_GET)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_405_METHOD_NOT_ALLOWED,
 		                             "Method not allowed");
 		return;
 	}
+
+	if (ramd_http_serve_snapshot(request, response, RAMD_PROMETHEUS_EXPOSITION_DAEMON))
+		return;
 	
-	/* Generate Prometheus metrics */
-	if (ramd_prometheus_handle_request(request->path, prometheus_buffer, sizeof(prometheus_buffer)) != 0)
+	/* Render straight into the response so the series count is not capped */
+	ramd_http_response_reset(response);
+	if (ramd_prometheus_render(&response->content) != 0)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
 		                             "Failed to generate Prometheus metrics");
@@ -1972,29 +5587,90 @@ ramd_http_handle_prometheus_metrics(ramd_http_request_t* request __attribute__((
 	/* Set response headers */
 	strncpy(response->content_type, "text/plain; version=0.0.4; charset=utf-8",
 	        sizeof(response->content_type) - 1);
-	
-	/* Set response body */
-	strncpy(response->body, prometheus_buffer, sizeof(response->body) - 1);
-	response->body[sizeof(response->body) - 1] = '\0';
-	response->body_length = strlen(response->body);
 	response->status = RAMD_HTTP_200_OK;
 }
 
+/* Enhanced integration: New HTTP API handlers for ramctrl communication */
+
 /*
- * Get number of healthy nodes
+ * "nodes": [{"node_id", "hostname", "port"}, ...] adds them all in one
+ * membership change, so a formation of several nodes costs one round of
+ * Raft however many join.  "voting" applies to every node listed.
  */
-static int
-get_healthy_nodes_count(void)
+static void
+ramd_http_add_nodes(json_t* nodes_json, json_t* voting_json, ramd_http_response_t* response)
 {
-	
-	if (g_ramd_daemon && g_ramd_daemon->cluster.node_count > 0)
+	int node_ids[RAMD_MAX_NODES];
+	const char* hostnames[RAMD_MAX_NODES];
+	int ports[RAMD_MAX_NODES];
+	char json_response[512];
+	bool voting;
+	size_t count;
+	size_t i;
+	int result;
+
+	if (!json_is_array(nodes_json) || json_array_size(nodes_json) == 0 ||
+	    json_array_size(nodes_json) > RAMD_MAX_NODES)
+	{
+		snprintf(json_response, sizeof(json_response),
+		         "nodes must be an array of 1 to %d nodes", RAMD_MAX_NODES);
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, json_response);
+		return;
+	}
+	if (voting_json && !json_is_boolean(voting_json))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "voting must be a boolean");
+		return;
+	}
+	voting = !voting_json || json_is_true(voting_json);
+
+	count = json_array_size(nodes_json);
+	for (i = 0; i < count; i++)
+	{
+		json_t* node = json_array_get(nodes_json, i);
+		json_t* id = json_object_get(node, "node_id");
+		json_t* host = json_object_get(node, "hostname");
+		json_t* port = json_object_get(node, "port");
+
+		if (!json_is_integer(id) || !json_is_string(host) || !json_is_integer(port))
+		{
+			ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+			                             "every node needs node_id, hostname and port");
+			return;
+		}
+		node_ids[i] = (int) json_integer_value(id);
+		hostnames[i] = json_string_value(host);
+		ports[i] = (int) json_integer_value(port);
+	}
+
+	PGconn* conn = ramd_conn_checkout(g_ramd_daemon->config.node_id,
+	                                  g_ramd_daemon->config.hostname,
+	                                  g_ramd_daemon->config.postgresql_port,
+	                                  g_ramd_daemon->config.database_name,
+	                                  g_ramd_daemon->config.database_user,
+	                                  g_ramd_daemon->config.database_password);
+	if (!conn)
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Database connection failed");
+		return;
+	}
+
+	result = ramd_pgraft_add_nodes(conn, node_ids, hostnames, ports, (int) count, voting);
+	ramd_conn_checkin(g_ramd_daemon->config.node_id, conn);
+	if (result != RAMD_PGRAFT_SUCCESS)
 	{
-		return g_ramd_daemon->cluster.node_count;
+		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR,
+		                             "Failed to add nodes to consensus");
+		return;
 	}
-	return 1; 
+
+	snprintf(json_response, sizeof(json_response),
+	         "{\"success\":true,\"message\":\"%zu nodes added in one membership change\","
+	         "\"nodes_added\":%zu,\"voting\":%s}",
+	         count, count, voting ? "true" : "false");
+	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_response);
 }
 
-/* Enhanced integration: New HTTP API handlers for ramctrl communication */
 
 void
 ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)), ramd_http_response_t* response)
@@ -2018,6 +5694,15 @@ ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)),
 	json_t* hostname_json = json_object_get(json, "hostname");
 	json_t* address_json = json_object_get(json, "address");
 	json_t* port_json = json_object_get(json, "port");
+	json_t* voting_json = json_object_get(json, "voting");
+	json_t* nodes_json = json_object_get(json, "nodes");
+
+	if (nodes_json)
+	{
+		ramd_http_add_nodes(nodes_json, voting_json, response);
+		json_decref(json);
+		return;
+	}
 
 	if (!node_id_json || !hostname_json || !address_json || !port_json)
 	{
@@ -2026,6 +5711,15 @@ ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)),
 		return;
 	}
 
+	/* "voting": false adds a Raft learner, e.g. a read replica */
+	if (voting_json && !json_is_boolean(voting_json))
+	{
+		json_decref(json);
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST, "voting must be a boolean");
+		return;
+	}
+	bool voting = !voting_json || json_is_true(voting_json);
+
 	int node_id = (int)json_integer_value(node_id_json);
 	const char* hostname = json_string_value(hostname_json);
 	const char* address = json_string_value(address_json);
@@ -2035,12 +5729,12 @@ ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)),
 	(void)address;
 
 	/* Get PostgreSQL connection */
-	PGconn* conn = ramd_conn_get_cached(g_ramd_daemon->config.node_id,
-									   g_ramd_daemon->config.hostname,
-									   g_ramd_daemon->config.postgresql_port,
-									   g_ramd_daemon->config.database_name,
-									   g_ramd_daemon->config.database_user,
-									   g_ramd_daemon->config.database_password);
+	PGconn* conn = ramd_conn_checkout(g_ramd_daemon->config.node_id,
+									 g_ramd_daemon->config.hostname,
+									 g_ramd_daemon->config.postgresql_port,
+									 g_ramd_daemon->config.database_name,
+									 g_ramd_daemon->config.database_user,
+									 g_ramd_daemon->config.database_password);
 	if (!conn)
 	{
 		json_decref(json);
@@ -2049,7 +5743,8 @@ ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)),
 	}
 
 	/* Add node to pgraft */
-	int result = ramd_pgraft_add_node(conn, node_id, hostname, port);
+	int result = ramd_pgraft_add_node(conn, node_id, hostname, port, voting);
+	ramd_conn_checkin(g_ramd_daemon->config.node_id, conn);
 	json_decref(json);
 
 	if (result != RAMD_PGRAFT_SUCCESS)
@@ -2061,8 +5756,8 @@ ramd_http_handle_add_node(ramd_http_request_t* request __attribute__((unused)),
 	/* Return success response */
 	char json_response[512];
 	snprintf(json_response, sizeof(json_response),
-		"{\"success\":true,\"message\":\"Node %d added successfully\",\"node_id\":%d}",
-		node_id, node_id);
+		"{\"success\":true,\"message\":\"Node %d added successfully\",\"node_id\":%d,\"voting\":%s}",
+		node_id, node_id, voting ? "true" : "false");
 	
 	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_response);
 }
@@ -2097,12 +5792,12 @@ ramd_http_handle_remove_node(ramd_http_request_t* request __attribute__((unused)
 	json_decref(json);
 
 	/* Get PostgreSQL connection */
-	PGconn* conn = ramd_conn_get_cached(g_ramd_daemon->config.node_id,
-									   g_ramd_daemon->config.hostname,
-									   g_ramd_daemon->config.postgresql_port,
-									   g_ramd_daemon->config.database_name,
-									   g_ramd_daemon->config.database_user,
-									   g_ramd_daemon->config.database_password);
+	PGconn* conn = ramd_conn_checkout(g_ramd_daemon->config.node_id,
+									 g_ramd_daemon->config.hostname,
+									 g_ramd_daemon->config.postgresql_port,
+									 g_ramd_daemon->config.database_name,
+									 g_ramd_daemon->config.database_user,
+									 g_ramd_daemon->config.database_password);
 	if (!conn)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Database connection failed");
@@ -2111,6 +5806,7 @@ ramd_http_handle_remove_node(ramd_http_request_t* request __attribute__((unused)
 
 	/* Remove node from pgraft */
 	int result = ramd_pgraft_remove_node(conn, node_id);
+	ramd_conn_checkin(g_ramd_daemon->config.node_id, conn);
 	if (result != RAMD_PGRAFT_SUCCESS)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Failed to remove node from consensus");
@@ -2136,12 +5832,12 @@ ramd_http_handle_cluster_health(ramd_http_request_t* request __attribute__((unus
 	}
 
 	/* Get PostgreSQL connection */
-	PGconn* conn = ramd_conn_get_cached(g_ramd_daemon->config.node_id,
-									   g_ramd_daemon->config.hostname,
-									   g_ramd_daemon->config.postgresql_port,
-									   g_ramd_daemon->config.database_name,
-									   g_ramd_daemon->config.database_user,
-									   g_ramd_daemon->config.database_password);
+	PGconn* conn = ramd_conn_checkout(g_ramd_daemon->config.node_id,
+									 g_ramd_daemon->config.hostname,
+									 g_ramd_daemon->config.postgresql_port,
+									 g_ramd_daemon->config.database_name,
+									 g_ramd_daemon->config.database_user,
+									 g_ramd_daemon->config.database_password);
 	if (!conn)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Database connection failed");
@@ -2150,6 +5846,7 @@ ramd_http_handle_cluster_health(ramd_http_request_t* request __attribute__((unus
 
 	/* Get cluster health from pgraft */
 	char* health_json = ramd_pgraft_get_cluster_health(conn);
+	ramd_conn_checkin(g_ramd_daemon->config.node_id, conn);
 	if (!health_json)
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Failed to get cluster health");
@@ -2220,15 +5917,23 @@ ramd_http_handle_security_status(ramd_http_request_t* request __attribute__((unu
 		return;
 	}
 
+	ramd_tls_status_t tls;
+	ramd_tls_get_status(&tls);
+
 	char json_response[1024];
 	snprintf(json_response, sizeof(json_response),
 		"{\"auth_enabled\":%s,\"ssl_enabled\":%s,\"rate_limiting_enabled\":%s,"
-		"\"audit_enabled\":%s,\"user_count\":%d,\"active_connections\":%d,\"blocked_ips\":%d}",
+		"\"audit_enabled\":%s,\"user_count\":%d,\"active_connections\":%d,\"blocked_ips\":%d,"
+		"\"tls\":{\"serving\":%s,\"ktls_requested\":%s,\"handshakes\":%lld,\"resumed\":%lld,"
+		"\"ktls_send\":%lld,\"ktls_recv\":%lld,\"reloads\":%lld,\"loaded_at\":%lld}}",
 		status.auth_enabled ? "true" : "false",
 		status.ssl_enabled ? "true" : "false",
 		status.rate_limiting_enabled ? "true" : "false",
 		status.audit_enabled ? "true" : "false",
-		status.user_count, status.active_connections, status.blocked_ips);
+		status.user_count, status.active_connections, status.blocked_ips,
+		tls.enabled ? "true" : "false", tls.ktls_requested ? "true" : "false",
+		(long long) tls.handshakes, (long long) tls.resumed, (long long) tls.ktls_send,
+		(long long) tls.ktls_recv, (long long) tls.reloads, (long long) (tls.loaded_wall_ms / 1000));
 
 	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_response);
 }
@@ -2244,18 +5949,31 @@ ramd_http_handle_security_audit(ramd_http_request_t* request __attribute__((unus
 
 	/* Get limit from query parameters */
 	int limit = 100;
-	char* limit_str = ramd_http_get_query_param(request->query_string, "limit");
+	const char* limit_str = ramd_http_request_param(request, "limit");
 	if (limit_str)
 	{
 		limit = atoi(limit_str);
-		free(limit_str);
 		if (limit <= 0 || limit > 1000)
 			limit = 100;
 	}
 
+	/* Time range, as for /api/v1/logs; the segment index skips the rest */
+	int64_t since_us = 0;
+	int64_t until_us = 0;
+	const char* since_str = ramd_http_request_param(request, "since");
+	const char* until_str = ramd_http_request_param(request, "until");
+	if ((since_str && !ramd_http_parse_log_since(since_str, &since_us)) ||
+		(until_str && !ramd_http_parse_log_since(until_str, &until_us)))
+	{
+		ramd_http_set_error_response(response, RAMD_HTTP_400_BAD_REQUEST,
+									 "since and until must be unix seconds or an age like 15m");
+		return;
+	}
+
 	ramd_audit_entry_t entries[1000];
 	int actual_count;
-	if (!ramd_security_get_audit_log(entries, limit, &actual_count))
+	if (!ramd_security_get_audit_log((time_t) (since_us / 1000000), (time_t) (until_us / 1000000),
+									 entries, limit, &actual_count))
 	{
 		ramd_http_set_error_response(response, RAMD_HTTP_500_INTERNAL_ERROR, "Failed to get audit log");
 		return;
@@ -2285,8 +6003,8 @@ ramd_http_handle_security_audit(ramd_http_request_t* request __attribute__((unus
 		return;
 	}
 
-	ramd_http_set_json_response(response, RAMD_HTTP_200_OK, json_string);
-	free(json_string);
+	ramd_http_set_owned_body(response, RAMD_HTTP_200_OK, "application/json",
+							 json_string, strlen(json_string));
 }
 
 void
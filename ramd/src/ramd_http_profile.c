@@ -0,0 +1,510 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_http_profile.c
+ *		PostgreSQL Auto-Failover Daemon - Per-Endpoint HTTP Request Profiler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The router attaches the request's sample to its thread, so auth, rate
+ * limiting and the connection pool can charge time to it without being
+ * handed anything.  A finished request is folded into its endpoint's
+ * entry in an open-addressed table under one mutex; the work done under
+ * it is a hash probe and a few additions.  Readers copy the table out and
+ * format it without the lock.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramd_http_profile.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+
+typedef struct ramd_http_profile_entry_t
+{
+	bool used;
+	char method[8];
+	char route[RAMD_HTTP_PROFILE_ROUTE_LENGTH];
+	int64_t calls;
+	int64_t errors_4xx;
+	int64_t errors_5xx;
+	int64_t total_us;
+	int64_t min_us;
+	int64_t max_us;
+	int64_t buckets[RAMD_HTTP_PROFILE_BUCKET_COUNT + 1]; /* per bucket, last is +Inf */
+	int64_t phase_us[RAMD_HTTP_PROFILE_PHASE_COUNT];
+	int64_t bytes_in;
+	int64_t bytes_out;
+} ramd_http_profile_entry_t;
+
+typedef struct ramd_http_profile_table_t
+{
+	pthread_mutex_t lock; /* guards everything below */
+	time_t since;          /* start, or the last reset */
+	int32_t count;
+	ramd_http_profile_entry_t slots[RAMD_HTTP_PROFILE_SLOTS];
+	ramd_http_profile_entry_t other;     /* routes past the maximum */
+	ramd_http_profile_entry_t unmatched; /* requests no route took */
+} ramd_http_profile_table_t;
+
+static ramd_http_profile_table_t g_http_profile = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+/* Upper bounds of the latency buckets, in microseconds; most reads are sub-millisecond */
+static const int64_t g_http_profile_bounds_us[RAMD_HTTP_PROFILE_BUCKET_COUNT] = {
+	100, 250, 500, 1000, 2500, 5000, 10000,
+	25000, 50000, 100000, 250000, 1000000, 5000000
+};
+
+static _Thread_local ramd_http_profile_sample_t* t_sample = NULL;
+
+const char*
+ramd_http_profile_phase_to_string(ramd_http_profile_phase_t phase)
+{
+	switch (phase)
+	{
+		case RAMD_HTTP_PROFILE_RATE_LIMIT:
+			return "rate_limit";
+		case RAMD_HTTP_PROFILE_AUTH:
+			return "auth";
+		case RAMD_HTTP_PROFILE_HANDLER:
+			return "handler";
+		case RAMD_HTTP_PROFILE_POSTGRESQL:
+			return "postgresql";
+		case RAMD_HTTP_PROFILE_PHASE_COUNT:
+			break;
+	}
+	return "unknown";
+}
+
+void
+ramd_http_profile_attach(ramd_http_profile_sample_t* sample)
+{
+	t_sample = sample;
+}
+
+void
+ramd_http_profile_detach(void)
+{
+	/* A session still held when the handler returns is charged up to here */
+	if (t_sample && t_sample->pg_depth > 0)
+	{
+		t_sample->phase_us[RAMD_HTTP_PROFILE_POSTGRESQL] +=
+			ramd_clock_now_us() - t_sample->pg_start_us;
+		t_sample->pg_depth = 0;
+	}
+	t_sample = NULL;
+}
+
+void
+ramd_http_profile_add(ramd_http_profile_phase_t phase, int64_t duration_us)
+{
+	if (t_sample && phase < RAMD_HTTP_PROFILE_PHASE_COUNT && duration_us > 0)
+		t_sample->phase_us[phase] += duration_us;
+}
+
+/* Nested checkouts count once, from the first out to the last back */
+void
+ramd_http_profile_pg_enter(void)
+{
+	if (t_sample && t_sample->pg_depth++ == 0)
+		t_sample->pg_start_us = ramd_clock_now_us();
+}
+
+void
+ramd_http_profile_pg_leave(void)
+{
+	if (!t_sample || t_sample->pg_depth <= 0)
+		return;
+	if (--t_sample->pg_depth == 0)
+		t_sample->phase_us[RAMD_HTTP_PROFILE_POSTGRESQL] +=
+			ramd_clock_now_us() - t_sample->pg_start_us;
+}
+
+/*
+ * Reduce a path to its route: numeric segments become ":id" and anything
+ * that could break a label or a JSON string becomes '_'.
+ */
+static void
+ramd_http_profile_route(const char* path, char* route, size_t size)
+{
+	size_t out = 0;
+	const char* p = path;
+
+	while (*p && out + 1 < size)
+	{
+		const char* segment_end;
+		bool numeric = true;
+
+		if (*p == '/')
+		{
+			route[out++] = *p++;
+			continue;
+		}
+
+		segment_end = p;
+		while (*segment_end && *segment_end != '/')
+		{
+			if (!isdigit((unsigned char) *segment_end))
+				numeric = false;
+			segment_end++;
+		}
+
+		if (numeric)
+		{
+			if (out + 3 >= size)
+				break;
+			memcpy(route + out, ":id", 3);
+			out += 3;
+			p = segment_end;
+			continue;
+		}
+
+		for (; p < segment_end && out + 1 < size; p++)
+			route[out++] = (isalnum((unsigned char) *p) || *p == '-' || *p == '_' || *p == '.') ?
+			               *p : '_';
+	}
+	route[out] = '\0';
+}
+
+static uint64_t
+ramd_http_profile_hash(const char* method, const char* route)
+{
+	uint64_t h = 1469598103934665603ULL;
+	const char* s;
+
+	for (s = method; *s; s++)
+		h = (h ^ (unsigned char) *s) * 1099511628211ULL;
+	h = (h ^ ' ') * 1099511628211ULL;
+	for (s = route; *s; s++)
+		h = (h ^ (unsigned char) *s) * 1099511628211ULL;
+	return h;
+}
+
+/* Called with the lock held */
+static ramd_http_profile_entry_t*
+ramd_http_profile_lookup(const char* method, const char* route)
+{
+	uint64_t h = ramd_http_profile_hash(method, route);
+	uint32_t mask = RAMD_HTTP_PROFILE_SLOTS - 1;
+	uint32_t i;
+
+	for (i = 0; i <= mask; i++)
+	{
+		ramd_http_profile_entry_t* entry = &g_http_profile.slots[(h + i) & mask];
+
+		if (entry->used)
+		{
+			if (strcmp(entry->route, route) == 0 && strcmp(entry->method, method) == 0)
+				return entry;
+			continue;
+		}
+
+		if (g_http_profile.count >= RAMD_HTTP_PROFILE_MAX_ENDPOINTS)
+			break;
+		entry->used = true;
+		snprintf(entry->method, sizeof(entry->method), "%s", method);
+		snprintf(entry->route, sizeof(entry->route), "%s", route);
+		g_http_profile.count++;
+		return entry;
+	}
+	return &g_http_profile.other;
+}
+
+void
+ramd_http_profile_record(const char* method, const char* path, int status,
+                         const ramd_http_profile_sample_t* sample,
+                         size_t bytes_in, size_t bytes_out)
+{
+	char route[RAMD_HTTP_PROFILE_ROUTE_LENGTH];
+	ramd_http_profile_entry_t* entry;
+	int64_t total_us;
+	int bucket;
+	int i;
+
+	if (!sample || !method)
+		return;
+
+	if (!sample->unmatched && path)
+		ramd_http_profile_route(path, route, sizeof(route));
+
+	total_us = sample->total_us > 0 ? sample->total_us : 0;
+	for (bucket = 0; bucket < RAMD_HTTP_PROFILE_BUCKET_COUNT; bucket++)
+		if (total_us <= g_http_profile_bounds_us[bucket])
+			break;
+
+	pthread_mutex_lock(&g_http_profile.lock);
+	if (g_http_profile.since == 0)
+		g_http_profile.since = time(NULL);
+	entry = (sample->unmatched || !path) ? &g_http_profile.unmatched :
+	        ramd_http_profile_lookup(method, route);
+
+	if (entry->calls == 0 || total_us < entry->min_us)
+		entry->min_us = total_us;
+	if (total_us > entry->max_us)
+		entry->max_us = total_us;
+	entry->calls++;
+	if (status >= 400 && status < 500)
+		entry->errors_4xx++;
+	else if (status >= 500)
+		entry->errors_5xx++;
+	entry->total_us += total_us;
+	entry->buckets[bucket]++;
+	for (i = 0; i < RAMD_HTTP_PROFILE_PHASE_COUNT; i++)
+		entry->phase_us[i] += sample->phase_us[i];
+	entry->bytes_in += (int64_t) bytes_in;
+	entry->bytes_out += (int64_t) bytes_out;
+	pthread_mutex_unlock(&g_http_profile.lock);
+}
+
+void
+ramd_http_profile_reset(void)
+{
+	pthread_mutex_lock(&g_http_profile.lock);
+	memset(g_http_profile.slots, 0, sizeof(g_http_profile.slots));
+	memset(&g_http_profile.other, 0, sizeof(g_http_profile.other));
+	memset(&g_http_profile.unmatched, 0, sizeof(g_http_profile.unmatched));
+	g_http_profile.count = 0;
+	g_http_profile.since = time(NULL);
+	pthread_mutex_unlock(&g_http_profile.lock);
+}
+
+/*
+ * Copy the entries with calls into a malloc'd array, busiest first by
+ * total time as pg_stat_statements is usually read.  Returns the count,
+ * or -1 when out of memory.
+ */
+static int
+ramd_http_profile_compare(const void* a, const void* b)
+{
+	const ramd_http_profile_entry_t* x = a;
+	const ramd_http_profile_entry_t* y = b;
+
+	if (x->total_us != y->total_us)
+		return x->total_us < y->total_us ? 1 : -1;
+	return strcmp(x->route, y->route);
+}
+
+static int
+ramd_http_profile_snapshot(ramd_http_profile_entry_t** entries, time_t* since)
+{
+	ramd_http_profile_entry_t* out;
+	int count = 0;
+	int i;
+
+	out = malloc(sizeof(*out) * (RAMD_HTTP_PROFILE_MAX_ENDPOINTS + 2));
+	if (!out)
+		return -1;
+
+	pthread_mutex_lock(&g_http_profile.lock);
+	for (i = 0; i < RAMD_HTTP_PROFILE_SLOTS && count < RAMD_HTTP_PROFILE_MAX_ENDPOINTS; i++)
+		if (g_http_profile.slots[i].used && g_http_profile.slots[i].calls > 0)
+			out[count++] = g_http_profile.slots[i];
+	if (g_http_profile.other.calls > 0)
+	{
+		out[count] = g_http_profile.other;
+		snprintf(out[count].method, sizeof(out[count].method), "*");
+		snprintf(out[count].route, sizeof(out[count].route), "other");
+		count++;
+	}
+	if (g_http_profile.unmatched.calls > 0)
+	{
+		out[count] = g_http_profile.unmatched;
+		snprintf(out[count].method, sizeof(out[count].method), "*");
+		snprintf(out[count].route, sizeof(out[count].route), "unmatched");
+		count++;
+	}
+	*since = g_http_profile.since;
+	pthread_mutex_unlock(&g_http_profile.lock);
+
+	qsort(out, (size_t) count, sizeof(*out), ramd_http_profile_compare);
+	*entries = out;
+	return count;
+}
+
+/* Upper bound of the bucket holding quantile q, -1 for +Inf */
+static int64_t
+ramd_http_profile_quantile_us(const ramd_http_profile_entry_t* entry, double q)
+{
+	int64_t rank = (int64_t) ((double) entry->calls * q);
+	int64_t cumulative = 0;
+	int i;
+
+	if (rank < 1)
+		rank = 1;
+	for (i = 0; i < RAMD_HTTP_PROFILE_BUCKET_COUNT; i++)
+	{
+		cumulative += entry->buckets[i];
+		if (cumulative >= rank)
+			return g_http_profile_bounds_us[i];
+	}
+	return -1;
+}
+
+static bool
+ramd_http_profile_write_entry(ram_json_writer_t* w, const ramd_http_profile_entry_t* entry)
+{
+	int64_t p50 = ramd_http_profile_quantile_us(entry, 0.50);
+	int64_t p99 = ramd_http_profile_quantile_us(entry, 0.99);
+	int64_t outside_pg = entry->phase_us[RAMD_HTTP_PROFILE_HANDLER] -
+	                     entry->phase_us[RAMD_HTTP_PROFILE_POSTGRESQL];
+	bool ok;
+	int i;
+
+	ok = ram_json_object_begin(w) &&
+	     ram_json_kv_string(w, "method", entry->method) &&
+	     ram_json_kv_string(w, "route", entry->route) &&
+	     ram_json_kv_int(w, "calls", entry->calls) &&
+	     ram_json_kv_int(w, "errors_4xx", entry->errors_4xx) &&
+	     ram_json_kv_int(w, "errors_5xx", entry->errors_5xx) &&
+	     ram_json_kv_double(w, "total_ms", (double) entry->total_us / 1000.0, 3) &&
+	     ram_json_kv_double(w, "mean_ms",
+	                        (double) entry->total_us / 1000.0 / (double) entry->calls, 3) &&
+	     ram_json_kv_double(w, "min_ms", (double) entry->min_us / 1000.0, 3) &&
+	     ram_json_kv_double(w, "max_ms", (double) entry->max_us / 1000.0, 3) &&
+	     ram_json_key(w, "p50_ms_le") &&
+	     (p50 < 0 ? ram_json_null(w) : ram_json_double(w, (double) p50 / 1000.0, 3)) &&
+	     ram_json_key(w, "p99_ms_le") &&
+	     (p99 < 0 ? ram_json_null(w) : ram_json_double(w, (double) p99 / 1000.0, 3)) &&
+	     ram_json_kv_int(w, "bytes_in", entry->bytes_in) &&
+	     ram_json_kv_int(w, "bytes_out", entry->bytes_out) &&
+	     ram_json_key(w, "phases_ms") && ram_json_object_begin(w);
+	for (i = 0; ok && i < RAMD_HTTP_PROFILE_PHASE_COUNT; i++)
+	{
+		const char* name = ramd_http_profile_phase_to_string((ramd_http_profile_phase_t) i);
+
+		ok = ram_json_key_n(w, name, strlen(name)) &&
+		     ram_json_double(w, (double) entry->phase_us[i] / 1000.0, 3);
+	}
+	/* JSON rendering and in-memory work: the handler minus its PostgreSQL time */
+	return ok &&
+	       ram_json_kv_double(w, "handler_outside_postgresql",
+	                          (double) (outside_pg > 0 ? outside_pg : 0) / 1000.0, 3) &&
+	       ram_json_object_end(w) && ram_json_object_end(w);
+}
+
+bool
+ramd_http_profile_write_json(ram_json_writer_t* w, int32_t limit)
+{
+	ramd_http_profile_entry_t* entries;
+	time_t since;
+	int count;
+	bool ok;
+	int i;
+
+	count = ramd_http_profile_snapshot(&entries, &since);
+	if (count < 0)
+		return false;
+	if (limit > 0 && limit < count)
+		count = limit;
+
+	ok = ram_json_object_begin(w) &&
+	     ram_json_kv_string(w, "status", "success") &&
+	     ram_json_kv_int(w, "since", (int64_t) since) &&
+	     ram_json_key(w, "endpoints") && ram_json_array_begin(w);
+	for (i = 0; ok && i < count; i++)
+		ok = ramd_http_profile_write_entry(w, &entries[i]);
+	ok = ok && ram_json_array_end(w) &&
+	     ram_json_kv_int(w, "count", count) &&
+	     ram_json_object_end(w);
+
+	free(entries);
+	return ok;
+}
+
+bool
+ramd_http_profile_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_http_profile_entry_t* entries;
+	time_t since;
+	int count;
+	bool ok = true;
+	int i;
+	int j;
+
+	if (!output)
+		return false;
+
+	count = ramd_http_profile_snapshot(&entries, &since);
+	if (count < 0)
+		return false;
+	if (count == 0)
+	{
+		free(entries);
+		return true;
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_http_endpoint_duration_seconds Request time by endpoint\n"
+		"# TYPE ramd_http_endpoint_duration_seconds histogram\n");
+	for (i = 0; i < count; i++)
+	{
+		const ramd_http_profile_entry_t* e = &entries[i];
+		int64_t cumulative = 0;
+
+		for (j = 0; j < RAMD_HTTP_PROFILE_BUCKET_COUNT; j++)
+		{
+			cumulative += e->buckets[j];
+			ok &= ramd_buffer_appendf(output,
+				"ramd_http_endpoint_duration_seconds_bucket{method=\"%s\",route=\"%s\",le=\"%g\"} %lld\n",
+				e->method, e->route, (double) g_http_profile_bounds_us[j] / 1e6,
+				(long long) cumulative);
+		}
+		cumulative += e->buckets[RAMD_HTTP_PROFILE_BUCKET_COUNT];
+		ok &= ramd_buffer_appendf(output,
+			"ramd_http_endpoint_duration_seconds_bucket{method=\"%s\",route=\"%s\",le=\"+Inf\"} %lld\n"
+			"ramd_http_endpoint_duration_seconds_sum{method=\"%s\",route=\"%s\"} %.6f\n"
+			"ramd_http_endpoint_duration_seconds_count{method=\"%s\",route=\"%s\"} %lld\n",
+			e->method, e->route, (long long) cumulative,
+			e->method, e->route, (double) e->total_us / 1e6,
+			e->method, e->route, (long long) cumulative);
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_http_endpoint_phase_seconds_total Request time by endpoint and phase\n"
+		"# TYPE ramd_http_endpoint_phase_seconds_total counter\n");
+	for (i = 0; i < count; i++)
+		for (j = 0; j < RAMD_HTTP_PROFILE_PHASE_COUNT; j++)
+			ok &= ramd_buffer_appendf(output,
+				"ramd_http_endpoint_phase_seconds_total{method=\"%s\",route=\"%s\",phase=\"%s\"} %.6f\n",
+				entries[i].method, entries[i].route,
+				ramd_http_profile_phase_to_string((ramd_http_profile_phase_t) j),
+				(double) entries[i].phase_us[j] / 1e6);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_http_endpoint_errors_total Error responses by endpoint and class\n"
+		"# TYPE ramd_http_endpoint_errors_total counter\n");
+	for (i = 0; i < count; i++)
+		ok &= ramd_buffer_appendf(output,
+			"ramd_http_endpoint_errors_total{method=\"%s\",route=\"%s\",class=\"4xx\"} %lld\n"
+			"ramd_http_endpoint_errors_total{method=\"%s\",route=\"%s\",class=\"5xx\"} %lld\n",
+			entries[i].method, entries[i].route, (long long) entries[i].errors_4xx,
+			entries[i].method, entries[i].route, (long long) entries[i].errors_5xx);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_http_endpoint_received_bytes_total Request bytes by endpoint\n"
+		"# TYPE ramd_http_endpoint_received_bytes_total counter\n");
+	for (i = 0; i < count; i++)
+		ok &= ramd_buffer_appendf(output,
+			"ramd_http_endpoint_received_bytes_total{method=\"%s\",route=\"%s\"} %lld\n",
+			entries[i].method, entries[i].route, (long long) entries[i].bytes_in);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_http_endpoint_sent_bytes_total Response bytes by endpoint\n"
+		"# TYPE ramd_http_endpoint_sent_bytes_total counter\n");
+	for (i = 0; i < count; i++)
+		ok &= ramd_buffer_appendf(output,
+			"ramd_http_endpoint_sent_bytes_total{method=\"%s\",route=\"%s\"} %lld\n",
+			entries[i].method, entries[i].route, (long long) entries[i].bytes_out);
+	ok &= ramd_buffer_appendf(output, "\n");
+
+	free(entries);
+	return ok;
+}
@@ -0,0 +1,995 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_instances.c
+ *		PostgreSQL Auto-Failover Daemon - Instance Supervisor
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * With instances_dir set, ramd manages every PostgreSQL cluster that has
+ * a configuration file there instead of one of its own.  Each NAME.conf
+ * gets a ramd of its own, started with that file and restarted with a
+ * growing delay when it exits, so the failover state, pools and monitor
+ * of one cluster can never reach another's, and one crashing is only its
+ * own outage.  The instances share the supervisor's program text, and
+ * one HTTP listener on the supervisor's own http_port serves them all:
+ *
+ *   GET /api/v1/clusters                 every instance and its state
+ *   ANY /api/v1/clusters/NAME/PATH       /api/v1/PATH of instance NAME
+ *   ANY /api/v1/clusters/NAME/health     /health of NAME, also primary,
+ *                                        replica, read-only, sync, metrics
+ *   GET /health                          200 while every instance runs
+ *
+ * Requests are passed to the instance's own listener over loopback, so
+ * its authentication, rate limits and audit log apply, with the client's
+ * address in X-Real-IP; each ends its connection.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+#include "ramd_instances.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ram_json.h"
+
+typedef struct ramd_instance_t
+{
+	bool used;
+	bool removed; /* its file is gone: stop it and forget it */
+	bool invalid; /* its file does not load; not started */
+	bool seen;    /* found by the scan in progress */
+	char name[RAMD_INSTANCE_NAME_LENGTH];
+	char config_file[RAMD_MAX_PATH_LENGTH];
+	char cluster_name[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t node_id;
+	char http_address[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t http_port;
+	pid_t pid; /* 0: not running */
+	int64_t started_ms;
+	int64_t next_start_ms;
+	int32_t backoff_ms;
+	int32_t restarts;
+	int last_status; /* from waitpid, -1 if it never exited */
+} ramd_instance_t;
+
+typedef struct ramd_instances_t
+{
+	pthread_mutex_t lock; /* guards instances; the front reads them */
+	ramd_instance_t instances[RAMD_MAX_INSTANCES];
+	const ramd_config_t* config;
+	char exe[PATH_MAX];
+	int listen_fd;
+	pthread_t front;
+	atomic_bool front_running;
+	atomic_int connections;
+} ramd_instances_t;
+
+/* A request handed from the front to its own thread */
+typedef struct ramd_instances_conn_t
+{
+	int fd;
+	char client_ip[INET6_ADDRSTRLEN];
+} ramd_instances_conn_t;
+
+static ramd_instances_t g_instances = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.listen_fd = -1
+};
+
+static volatile sig_atomic_t g_instances_stop = 0;
+static volatile sig_atomic_t g_instances_rescan = 0;
+
+/* Root paths of an instance, served outside /api/v1 */
+static const char* const g_instances_root_paths[] = {
+	"health", "primary", "replica", "read-only", "sync", "metrics"
+};
+
+static void
+ramd_instances_signal(int sig)
+{
+	if (sig == SIGHUP)
+		g_instances_rescan = 1;
+	else
+		g_instances_stop = 1;
+}
+
+static bool
+ramd_instances_valid_name(const char* name, size_t length)
+{
+	if (length == 0 || length >= RAMD_INSTANCE_NAME_LENGTH || name[0] == '.')
+		return false;
+	for (size_t i = 0; i < length; i++)
+	{
+		char c = name[i];
+
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+		      c == '-' || c == '_' || c == '.'))
+			return false;
+	}
+	return true;
+}
+
+static ramd_instance_t*
+ramd_instances_find(const char* name, size_t length)
+{
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+	{
+		ramd_instance_t* instance = &g_instances.instances[i];
+
+		if (instance->used && strlen(instance->name) == length &&
+		    strncmp(instance->name, name, length) == 0)
+			return instance;
+	}
+	return NULL;
+}
+
+/* Read what the supervisor needs to know of an instance from its file */
+static void
+ramd_instances_load(ramd_instance_t* instance)
+{
+	ramd_config_t* config = malloc(sizeof(ramd_config_t));
+
+	instance->invalid = true;
+	if (!config)
+		return;
+	if (ramd_config_init(config) && ramd_config_load_file(config, instance->config_file))
+	{
+		if (config->instances_dir[0] != '\0')
+			ramd_log_error("Instances: %s sets instances_dir itself, not started",
+			               instance->config_file);
+		else if (snprintf(instance->cluster_name, sizeof(instance->cluster_name), "%s",
+		                  config->cluster_name) >= (int) sizeof(instance->cluster_name) ||
+		         snprintf(instance->http_address, sizeof(instance->http_address), "%s",
+		                  config->http_bind_address) >= (int) sizeof(instance->http_address))
+			ramd_log_error("Instances: %s has a cluster_name or http_bind_address that is "
+			               "too long, not started", instance->config_file);
+		else
+		{
+			instance->invalid = false;
+			instance->node_id = config->node_id;
+			instance->http_port = config->http_api_enabled ? config->http_port : 0;
+			if (instance->http_port == g_instances.config->http_port)
+				ramd_log_warning("Instances: %s uses the supervisor's http_port %d",
+				                 instance->name, instance->http_port);
+		}
+	}
+	else
+		ramd_log_error("Instances: %s does not load, not started", instance->config_file);
+	ramd_config_cleanup(config);
+	free(config);
+}
+
+/* Pick up new configuration files and let go of removed ones */
+static void
+ramd_instances_scan(const char* dir)
+{
+	DIR* d = opendir(dir);
+	struct dirent* entry;
+
+	if (!d)
+	{
+		ramd_log_error("Instances: cannot read %s: %s", dir, strerror(errno));
+		return;
+	}
+
+	pthread_mutex_lock(&g_instances.lock);
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+		g_instances.instances[i].seen = false;
+
+	while ((entry = readdir(d)) != NULL)
+	{
+		size_t length = strlen(entry->d_name);
+		ramd_instance_t* instance;
+
+		if (length <= 5 || strcmp(entry->d_name + length - 5, ".conf") != 0)
+			continue;
+		length -= 5;
+		if (!ramd_instances_valid_name(entry->d_name, length))
+		{
+			ramd_log_warning("Instances: skipping %s: names are letters, digits, '-', '_' "
+			                 "and '.'", entry->d_name);
+			continue;
+		}
+
+		instance = ramd_instances_find(entry->d_name, length);
+		if (!instance)
+		{
+			for (int i = 0; i < RAMD_MAX_INSTANCES && !instance; i++)
+				if (!g_instances.instances[i].used)
+					instance = &g_instances.instances[i];
+			if (!instance)
+			{
+				ramd_log_error("Instances: more than %d configurations in %s, skipping %s",
+				               RAMD_MAX_INSTANCES, dir, entry->d_name);
+				continue;
+			}
+			memset(instance, 0, sizeof(*instance));
+			instance->used = true;
+			memcpy(instance->name, entry->d_name, length);
+			snprintf(instance->config_file, sizeof(instance->config_file), "%s/%s", dir,
+			         entry->d_name);
+			instance->backoff_ms = RAMD_INSTANCES_RESTART_MIN_MS;
+			instance->last_status = -1;
+			ramd_instances_load(instance);
+			ramd_log_info("Instances: found %s (%s)", instance->name, instance->config_file);
+		}
+		instance->seen = true;
+		instance->removed = false;
+	}
+	closedir(d);
+
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+	{
+		ramd_instance_t* instance = &g_instances.instances[i];
+
+		if (!instance->used || instance->seen)
+			continue;
+		ramd_log_info("Instances: %s was removed, stopping it", instance->name);
+		instance->removed = true;
+		if (instance->pid > 0)
+			kill(instance->pid, SIGTERM);
+		else
+			instance->used = false;
+	}
+	pthread_mutex_unlock(&g_instances.lock);
+}
+
+/* Called with the lock held */
+static void
+ramd_instances_spawn(ramd_instance_t* instance)
+{
+	char* argv[] = {g_instances.exe, "--config", instance->config_file, "--foreground", NULL};
+	pid_t pid = fork();
+
+	if (pid == 0)
+	{
+#if defined(__linux__)
+		/* An instance must not outlive the supervisor that would restart it twice */
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+		execv(g_instances.exe, argv);
+		_exit(127);
+	}
+	if (pid < 0)
+	{
+		ramd_log_error("Instances: cannot start %s: %s", instance->name, strerror(errno));
+		instance->next_start_ms = ramd_clock_now_ms() + instance->backoff_ms;
+		return;
+	}
+	instance->pid = pid;
+	instance->started_ms = ramd_clock_now_ms();
+	ramd_log_info("Instances: started %s as pid %d", instance->name, (int) pid);
+}
+
+/* Note exited instances and schedule their restart */
+static void
+ramd_instances_reap(void)
+{
+	int status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+	{
+		pthread_mutex_lock(&g_instances.lock);
+		for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+		{
+			ramd_instance_t* instance = &g_instances.instances[i];
+			int64_t now = ramd_clock_now_ms();
+
+			if (!instance->used || instance->pid != pid)
+				continue;
+			instance->pid = 0;
+			instance->last_status = status;
+			if (instance->removed || g_instances_stop)
+			{
+				ramd_log_info("Instances: %s stopped", instance->name);
+				if (instance->removed)
+					instance->used = false;
+				break;
+			}
+
+			/* One that ran a while starts over from the shortest delay */
+			if (now - instance->started_ms >= RAMD_INSTANCES_RESTART_MAX_MS)
+				instance->backoff_ms = RAMD_INSTANCES_RESTART_MIN_MS;
+			if (WIFSIGNALED(status))
+				ramd_log_error("Instances: %s was killed by signal %d, restarting in %d ms",
+				               instance->name, WTERMSIG(status), instance->backoff_ms);
+			else
+				ramd_log_error("Instances: %s exited with status %d, restarting in %d ms",
+				               instance->name, WEXITSTATUS(status), instance->backoff_ms);
+			instance->next_start_ms = now + instance->backoff_ms;
+			instance->restarts++;
+			instance->backoff_ms = instance->backoff_ms * 2 > RAMD_INSTANCES_RESTART_MAX_MS
+			                       ? RAMD_INSTANCES_RESTART_MAX_MS : instance->backoff_ms * 2;
+			break;
+		}
+		pthread_mutex_unlock(&g_instances.lock);
+	}
+}
+
+static void
+ramd_instances_start_due(void)
+{
+	int64_t now = ramd_clock_now_ms();
+
+	pthread_mutex_lock(&g_instances.lock);
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+	{
+		ramd_instance_t* instance = &g_instances.instances[i];
+
+		if (instance->used && !instance->removed && !instance->invalid && instance->pid == 0 &&
+		    now >= instance->next_start_ms)
+			ramd_instances_spawn(instance);
+	}
+	pthread_mutex_unlock(&g_instances.lock);
+}
+
+/* SIGTERM every instance, then SIGKILL what is left after the timeout */
+static void
+ramd_instances_stop_all(void)
+{
+	int64_t deadline = ramd_clock_now_ms() + RAMD_INSTANCES_STOP_TIMEOUT_MS;
+	bool killed = false;
+
+	pthread_mutex_lock(&g_instances.lock);
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+		if (g_instances.instances[i].used && g_instances.instances[i].pid > 0)
+			kill(g_instances.instances[i].pid, SIGTERM);
+	pthread_mutex_unlock(&g_instances.lock);
+
+	for (;;)
+	{
+		int running = 0;
+
+		ramd_instances_reap();
+		pthread_mutex_lock(&g_instances.lock);
+		for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+		{
+			ramd_instance_t* instance = &g_instances.instances[i];
+
+			if (!instance->used || instance->pid <= 0)
+				continue;
+			running++;
+			if (!killed && ramd_clock_now_ms() >= deadline)
+			{
+				ramd_log_warning("Instances: %s did not stop in time, killing it",
+				                 instance->name);
+				kill(instance->pid, SIGKILL);
+			}
+		}
+		pthread_mutex_unlock(&g_instances.lock);
+		if (running == 0)
+			return;
+		if (ramd_clock_now_ms() >= deadline)
+			killed = true;
+		usleep(100000);
+	}
+}
+
+/* ---------------------------------------------------------------------
+ * HTTP front
+ * ---------------------------------------------------------------------
+ */
+
+static bool
+ramd_instances_write_all(int fd, const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		data += n;
+		length -= (size_t) n;
+	}
+	return true;
+}
+
+static void
+ramd_instances_respond(int fd, int status, const char* reason, const char* body)
+{
+	char head[256];
+	int length = snprintf(head, sizeof(head),
+	                      "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+	                      "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+	                      status, reason, strlen(body));
+
+	if (length > 0 && ramd_instances_write_all(fd, head, (size_t) length))
+		ramd_instances_write_all(fd, body, strlen(body));
+}
+
+static void
+ramd_instances_respond_error(int fd, int status, const char* reason, const char* message)
+{
+	char body[512];
+	ram_json_writer_t w;
+
+	ram_json_writer_init(&w, body, sizeof(body), NULL, NULL);
+	if (ram_json_object_begin(&w) && ram_json_kv_string(&w, "error", message) &&
+	    ram_json_kv_int(&w, "status", status) && ram_json_object_end(&w))
+		body[w.length] = '\0';
+	else
+		snprintf(body, sizeof(body), "{\"status\":%d}", status);
+	ramd_instances_respond(fd, status, reason, body);
+}
+
+/* Value of header name in the request head, or NULL */
+static const char*
+ramd_instances_header(const char* head, const char* name, size_t* length)
+{
+	size_t name_length = strlen(name);
+	const char* line = strstr(head, "\r\n");
+
+	while (line && line[2] != '\r' && line[2] != '\0')
+	{
+		const char* start = line + 2;
+		const char* end = strstr(start, "\r\n");
+
+		if (!end)
+			return NULL;
+		if ((size_t) (end - start) > name_length && start[name_length] == ':' &&
+		    strncasecmp(start, name, name_length) == 0)
+		{
+			start += name_length + 1;
+			while (*start == ' ' || *start == '\t')
+				start++;
+			*length = (size_t) (end - start);
+			return start;
+		}
+		line = end;
+	}
+	return NULL;
+}
+
+/* The supervisor's own endpoints carry its http_auth_token, if it has one */
+static bool
+ramd_instances_authorized(const char* head)
+{
+	const ramd_config_t* config = g_instances.config;
+	const char* value;
+	size_t length = 0;
+	size_t token_length = strlen(config->http_auth_token);
+	unsigned char diff = 0;
+
+	if (!config->http_auth_enabled || token_length == 0)
+		return true;
+	value = ramd_instances_header(head, "Authorization", &length);
+	if (!value || length != token_length + 7 || strncmp(value, "Bearer ", 7) != 0)
+		return false;
+	for (size_t i = 0; i < token_length; i++)
+		diff |= (unsigned char) (value[7 + i] ^ config->http_auth_token[i]);
+	return diff == 0;
+}
+
+static void
+ramd_instances_respond_list(int fd)
+{
+	char body[RAMD_INSTANCES_LIST_SIZE];
+	ram_json_writer_t w;
+	int64_t now = ramd_clock_now_ms();
+	bool ok;
+
+	ram_json_writer_init(&w, body, sizeof(body), NULL, NULL);
+	ok = ram_json_object_begin(&w) && ram_json_key(&w, "clusters") && ram_json_array_begin(&w);
+	pthread_mutex_lock(&g_instances.lock);
+	for (int i = 0; ok && i < RAMD_MAX_INSTANCES; i++)
+	{
+		const ramd_instance_t* instance = &g_instances.instances[i];
+		const char* state;
+
+		if (!instance->used)
+			continue;
+		if (instance->invalid)
+			state = "invalid";
+		else if (instance->removed)
+			state = "stopping";
+		else if (instance->pid > 0)
+			state = "running";
+		else
+			state = "restarting";
+
+		ok = ram_json_object_begin(&w) && ram_json_kv_string(&w, "name", instance->name) &&
+		     ram_json_kv_string(&w, "state", state) &&
+		     ram_json_kv_string(&w, "config_file", instance->config_file) &&
+		     ram_json_kv_string(&w, "cluster_name", instance->cluster_name) &&
+		     ram_json_kv_int(&w, "node_id", instance->node_id) &&
+		     ram_json_kv_int(&w, "http_port", instance->http_port) &&
+		     ram_json_kv_int(&w, "pid", instance->pid) &&
+		     ram_json_kv_int(&w, "uptime_s",
+		                     instance->pid > 0 ? (now - instance->started_ms) / 1000 : 0) &&
+		     ram_json_kv_int(&w, "restarts", instance->restarts);
+		if (ok && instance->last_status >= 0 && WIFSIGNALED(instance->last_status))
+			ok = ram_json_kv_int(&w, "last_signal", WTERMSIG(instance->last_status));
+		else if (ok && instance->last_status >= 0)
+			ok = ram_json_kv_int(&w, "last_exit_code", WEXITSTATUS(instance->last_status));
+		ok = ok && ram_json_object_end(&w);
+	}
+	pthread_mutex_unlock(&g_instances.lock);
+	ok = ok && ram_json_array_end(&w) && ram_json_object_end(&w);
+	if (!ok)
+	{
+		ramd_instances_respond_error(fd, 500, "Internal Server Error", "Too many clusters to list");
+		return;
+	}
+	body[w.length] = '\0';
+	ramd_instances_respond(fd, 200, "OK", body);
+}
+
+static void
+ramd_instances_respond_health(int fd)
+{
+	int running = 0;
+	int total = 0;
+	char body[128];
+
+	pthread_mutex_lock(&g_instances.lock);
+	for (int i = 0; i < RAMD_MAX_INSTANCES; i++)
+	{
+		if (!g_instances.instances[i].used || g_instances.instances[i].removed)
+			continue;
+		total++;
+		if (g_instances.instances[i].pid > 0)
+			running++;
+	}
+	pthread_mutex_unlock(&g_instances.lock);
+
+	snprintf(body, sizeof(body), "{\"status\":\"%s\",\"clusters\":%d,\"running\":%d}",
+	         running == total ? "healthy" : "degraded", total, running);
+	if (running == total)
+		ramd_instances_respond(fd, 200, "OK", body);
+	else
+		ramd_instances_respond(fd, 503, "Service Unavailable", body);
+}
+
+static int
+ramd_instances_connect(const char* address, int32_t port)
+{
+	struct sockaddr_in addr;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t) port);
+	/* An instance listening on every address is reached over loopback */
+	if (address[0] == '\0' || strcmp(address, "0.0.0.0") == 0 ||
+	    inet_pton(AF_INET, address, &addr.sin_addr) <= 0)
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Copy both ways until the instance has sent its whole response */
+static void
+ramd_instances_relay(int client_fd, int upstream_fd)
+{
+	char buf[RAMD_INSTANCES_RELAY_BUFFER];
+	struct pollfd fds[2];
+	bool client_open = true;
+
+	fds[0].fd = client_fd;
+	fds[1].fd = upstream_fd;
+	for (;;)
+	{
+		ssize_t n;
+
+		fds[0].events = client_open ? POLLIN : 0;
+		fds[1].events = POLLIN;
+		if (poll(fds, 2, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		if (fds[1].revents & (POLLIN | POLLHUP | POLLERR))
+		{
+			n = recv(upstream_fd, buf, sizeof(buf), 0);
+			if (n <= 0 || !ramd_instances_write_all(client_fd, buf, (size_t) n))
+				return;
+		}
+		if (client_open && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)))
+		{
+			n = recv(client_fd, buf, sizeof(buf), 0);
+			if (n == 0)
+			{
+				/* Half-closed after its request: the response may still come */
+				client_open = false;
+				shutdown(upstream_fd, SHUT_WR);
+			}
+			else if (n < 0 || !ramd_instances_write_all(upstream_fd, buf, (size_t) n))
+				return;
+		}
+	}
+}
+
+/*
+ * Send the request to the instance with its target rewritten, without
+ * the client's Connection and X-Real-IP headers, then relay.
+ */
+static void
+ramd_instances_forward(int client_fd, const char* client_ip, const char* head,
+                       size_t head_length, const char* method, const char* target,
+                       const char* version, const char* body, size_t body_length)
+{
+	char out[RAMD_INSTANCES_HEAD_SIZE + 512];
+	const char* name = target + strlen("/api/v1/clusters/");
+	const char* rest = name + strcspn(name, "/?");
+	size_t name_length = (size_t) (rest - name);
+	const char* line;
+	ramd_instance_t* instance;
+	char address[RAMD_MAX_HOSTNAME_LENGTH];
+	char message[160];
+	int32_t port = 0;
+	bool running = false;
+	size_t length;
+	int upstream_fd;
+
+	pthread_mutex_lock(&g_instances.lock);
+	instance = ramd_instances_find(name, name_length);
+	if (instance)
+	{
+		strncpy(address, instance->http_address, sizeof(address) - 1);
+		address[sizeof(address) - 1] = '\0';
+		port = instance->http_port;
+		running = instance->pid > 0 && !instance->removed;
+	}
+	pthread_mutex_unlock(&g_instances.lock);
+
+	if (!instance)
+	{
+		snprintf(message, sizeof(message), "No cluster named %.*s", (int) name_length, name);
+		ramd_instances_respond_error(client_fd, 404, "Not Found", message);
+		return;
+	}
+	if (!running || port <= 0)
+	{
+		snprintf(message, sizeof(message), "Cluster %.*s is not %s", (int) name_length, name,
+		         port <= 0 ? "serving HTTP" : "running");
+		ramd_instances_respond_error(client_fd, 503, "Service Unavailable", message);
+		return;
+	}
+
+	/* /clusters/NAME alone is its status; root probes keep their place */
+	if (*rest == '\0' || *rest == '?' || strncmp(rest, "/?", 2) == 0 || strcmp(rest, "/") == 0)
+		length = (size_t) snprintf(out, sizeof(out), "%s /api/v1/cluster/status%s %s\r\n", method,
+		                           strchr(rest, '?') ? strchr(rest, '?') : "", version);
+	else
+	{
+		const char* prefix = "/api/v1";
+
+		for (size_t i = 0; i < sizeof(g_instances_root_paths) / sizeof(g_instances_root_paths[0]);
+		     i++)
+		{
+			size_t n = strlen(g_instances_root_paths[i]);
+
+			if (strncmp(rest + 1, g_instances_root_paths[i], n) == 0 &&
+			    (rest[n + 1] == '\0' || rest[n + 1] == '?'))
+				prefix = "";
+		}
+		length = (size_t) snprintf(out, sizeof(out), "%s %s%s %s\r\n", method, prefix, rest,
+		                           version);
+	}
+
+	/* Headers, as they came but for the ones the supervisor sets itself */
+	line = strstr(head, "\r\n");
+	while (line && line + 2 < head + head_length && line[2] != '\r' && length < sizeof(out))
+	{
+		const char* start = line + 2;
+		const char* end = strstr(start, "\r\n");
+
+		if (!end)
+			break;
+		if (strncasecmp(start, "Connection:", 11) != 0 &&
+		    strncasecmp(start, "Keep-Alive:", 11) != 0 &&
+		    strncasecmp(start, "X-Real-IP:", 10) != 0)
+		{
+			size_t n = (size_t) (end - start) + 2;
+
+			if (length + n >= sizeof(out))
+				break;
+			memcpy(out + length, start, n);
+			length += n;
+		}
+		line = end;
+	}
+	if (length < sizeof(out))
+		length += (size_t) snprintf(out + length, sizeof(out) - length,
+		                            "X-Real-IP: %s\r\nConnection: close\r\n\r\n", client_ip);
+	if (length >= sizeof(out))
+	{
+		ramd_instances_respond_error(client_fd, 431, "Request Header Fields Too Large",
+		                             "Request headers too large");
+		return;
+	}
+
+	upstream_fd = ramd_instances_connect(address, port);
+	if (upstream_fd < 0)
+	{
+		snprintf(message, sizeof(message), "Cluster %.*s is not answering on port %d",
+		         (int) name_length, name, port);
+		ramd_instances_respond_error(client_fd, 502, "Bad Gateway", message);
+		return;
+	}
+	if (ramd_instances_write_all(upstream_fd, out, length) &&
+	    (body_length == 0 || ramd_instances_write_all(upstream_fd, body, body_length)))
+		ramd_instances_relay(client_fd, upstream_fd);
+	close(upstream_fd);
+}
+
+static void*
+ramd_instances_conn_main(void* arg)
+{
+	ramd_instances_conn_t* conn = arg;
+	char head[RAMD_INSTANCES_HEAD_SIZE];
+	char method[16];
+	char target[RAMD_INSTANCES_HEAD_SIZE];
+	char version[16];
+	struct timeval timeout = {RAMD_INSTANCES_HEAD_TIMEOUT_MS / 1000,
+	                          (RAMD_INSTANCES_HEAD_TIMEOUT_MS % 1000) * 1000};
+	size_t length = 0;
+	char* end = NULL;
+
+	setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	while (!end && length < sizeof(head) - 1)
+	{
+		ssize_t n = recv(conn->fd, head + length, sizeof(head) - 1 - length, 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		length += (size_t) n;
+		head[length] = '\0';
+		end = strstr(head, "\r\n\r\n");
+	}
+
+	if (!end)
+	{
+		if (length >= sizeof(head) - 1)
+			ramd_instances_respond_error(conn->fd, 431, "Request Header Fields Too Large",
+			                             "Request headers too large");
+	}
+	else if (sscanf(head, "%15s %16383s %15s", method, target, version) != 3 ||
+	         strncmp(version, "HTTP/", 5) != 0)
+		ramd_instances_respond_error(conn->fd, 400, "Bad Request", "Malformed request line");
+	else
+	{
+		size_t head_length = (size_t) (end - head) + 4;
+		size_t path_length = strcspn(target, "?");
+
+		/* Relayed requests may be held open by the instance, as watches are */
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 0;
+		setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		if (strncmp(target, "/api/v1/clusters/", 17) == 0 && path_length > 17)
+			ramd_instances_forward(conn->fd, conn->client_ip, head, head_length, method,
+			                       target, version, head + head_length, length - head_length);
+		else if ((path_length == 16 && strncmp(target, "/api/v1/clusters", 16) == 0) ||
+		         (path_length == 17 && strncmp(target, "/api/v1/clusters/", 17) == 0))
+		{
+			if (strcmp(method, "GET") != 0)
+				ramd_instances_respond_error(conn->fd, 405, "Method Not Allowed",
+				                             "Method not allowed");
+			else if (!ramd_instances_authorized(head))
+				ramd_instances_respond_error(conn->fd, 401, "Unauthorized",
+				                             "Authentication required");
+			else
+				ramd_instances_respond_list(conn->fd);
+		}
+		else if (path_length == 7 && strncmp(target, "/health", 7) == 0)
+			ramd_instances_respond_health(conn->fd);
+		else
+			ramd_instances_respond_error(conn->fd, 404, "Not Found",
+			                             "Use /api/v1/clusters/NAME/...");
+	}
+
+	close(conn->fd);
+	free(conn);
+	atomic_fetch_sub(&g_instances.connections, 1);
+	return NULL;
+}
+
+static void*
+ramd_instances_front_main(void* arg)
+{
+	(void) arg;
+
+	while (atomic_load(&g_instances.front_running))
+	{
+		struct pollfd pfd = {g_instances.listen_fd, POLLIN, 0};
+		struct sockaddr_storage peer;
+		socklen_t peer_length = sizeof(peer);
+		ramd_instances_conn_t* conn;
+		pthread_t thread;
+		int fd;
+
+		if (poll(&pfd, 1, RAMD_INSTANCES_POLL_MS) <= 0)
+			continue;
+		fd = accept4(g_instances.listen_fd, (struct sockaddr*) &peer, &peer_length,
+		             SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		if (atomic_fetch_add(&g_instances.connections, 1) >= RAMD_INSTANCES_MAX_CONNECTIONS ||
+		    !(conn = calloc(1, sizeof(*conn))))
+		{
+			atomic_fetch_sub(&g_instances.connections, 1);
+			ramd_instances_respond_error(fd, 503, "Service Unavailable", "Too many connections");
+			close(fd);
+			continue;
+		}
+		conn->fd = fd;
+		if (peer.ss_family == AF_INET6)
+			inet_ntop(AF_INET6, &((struct sockaddr_in6*) &peer)->sin6_addr, conn->client_ip,
+			          sizeof(conn->client_ip));
+		else
+			inet_ntop(AF_INET, &((struct sockaddr_in*) &peer)->sin_addr, conn->client_ip,
+			          sizeof(conn->client_ip));
+
+		if (pthread_create(&thread, NULL, ramd_instances_conn_main, conn) != 0)
+		{
+			ramd_instances_respond_error(fd, 503, "Service Unavailable", "Too many connections");
+			close(fd);
+			free(conn);
+			atomic_fetch_sub(&g_instances.connections, 1);
+			continue;
+		}
+		pthread_detach(thread);
+	}
+	return NULL;
+}
+
+static bool
+ramd_instances_front_start(const ramd_config_t* config)
+{
+	struct sockaddr_in addr;
+	int opt = 1;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t) config->http_port);
+	if (inet_pton(AF_INET, config->http_bind_address, &addr.sin_addr) <= 0)
+	{
+		ramd_log_error("Instances: invalid http_bind_address: %s", config->http_bind_address);
+		return false;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		ramd_log_error("Instances: failed to create socket: %s", strerror(errno));
+		return false;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+		ramd_log_warning("Instances: failed to set SO_REUSEADDR: %s", strerror(errno));
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+	{
+		ramd_log_error("Instances: failed to listen on %s:%d: %s", config->http_bind_address,
+		               config->http_port, strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	g_instances.listen_fd = fd;
+	atomic_store(&g_instances.front_running, true);
+	if (pthread_create(&g_instances.front, NULL, ramd_instances_front_main, NULL) != 0)
+	{
+		atomic_store(&g_instances.front_running, false);
+		close(fd);
+		g_instances.listen_fd = -1;
+		ramd_log_error("Instances: cannot start HTTP thread: %s", strerror(errno));
+		return false;
+	}
+	ramd_log_info("Instances: serving /api/v1/clusters on %s:%d", config->http_bind_address,
+	              config->http_port);
+	return true;
+}
+
+static void
+ramd_instances_front_stop(void)
+{
+	if (!atomic_load(&g_instances.front_running))
+		return;
+	atomic_store(&g_instances.front_running, false);
+	pthread_join(g_instances.front, NULL);
+	close(g_instances.listen_fd);
+	g_instances.listen_fd = -1;
+}
+
+int
+ramd_instances_run(const ramd_config_t* config, const char* progname)
+{
+	struct sigaction sa;
+	ssize_t n;
+
+	if (!config)
+		return 1;
+	g_instances.config = config;
+
+	/* Instances are started from the same binary, wherever it was run from */
+	n = readlink("/proc/self/exe", g_instances.exe, sizeof(g_instances.exe) - 1);
+	if (n > 0)
+		g_instances.exe[n] = '\0';
+	else
+		strncpy(g_instances.exe, progname, sizeof(g_instances.exe) - 1);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = ramd_instances_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	/* Before any thread is started, since only the caller survives fork() */
+	if (config->daemonize && !ramd_daemonize())
+	{
+		ramd_log_fatal("Daemonization failure: Unable to detach process and run as system daemon");
+		return 1;
+	}
+	if (config->pid_file[0] != '\0' && !ramd_write_pidfile(config->pid_file))
+		ramd_log_warning("PID file operation warning: Unable to write process ID to file '%s'",
+		                 config->pid_file);
+
+	ramd_log_info("Instance supervisor starting for the clusters in %s", config->instances_dir);
+	ramd_instances_scan(config->instances_dir);
+	if (config->http_api_enabled && !ramd_instances_front_start(config))
+		ramd_log_warning("Instances: no shared HTTP front; each cluster is still on its own "
+		                 "http_port");
+
+	while (!g_instances_stop)
+	{
+		ramd_instances_reap();
+		if (g_instances_rescan)
+		{
+			g_instances_rescan = 0;
+			ramd_log_info("Instances: rescanning %s", config->instances_dir);
+			ramd_instances_scan(config->instances_dir);
+		}
+		if (!g_instances_stop)
+			ramd_instances_start_due();
+		usleep(RAMD_INSTANCES_POLL_MS * 1000);
+	}
+
+	ramd_log_info("Instance supervisor stopping");
+	ramd_instances_front_stop();
+	ramd_instances_stop_all();
+	if (config->pid_file[0] != '\0')
+		ramd_remove_pidfile(config->pid_file);
+	return 0;
+}
@@ -0,0 +1,434 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_job.c
+ *		PostgreSQL Auto-Failover Daemon - Background Jobs
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Operations that can run for minutes (failover, bootstrap, adding a
+ * replica with its base backup) are queued here instead of being run on
+ * an HTTP thread.  A fixed pool of RAMD_JOB_WORKERS threads takes jobs in
+ * submission order from a FIFO of queued records; the caller gets a job id back at once and polls for
+ * the outcome.  Finished jobs stay in a fixed-size history, oldest evicted
+ * first, so a client that polls late still sees the result.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramd_job.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "thread_safety.h"
+
+typedef struct ramd_job_record_t
+{
+	bool used;
+	bool finished;
+	ramd_job_status_t status;
+	int64_t started_us;       /* ramd_clock_now_us, when a worker took it */
+	int64_t phase_started_us;
+	ramd_job_fn run;
+	void* arg;
+	void (*free_arg)(void* arg);
+	char* result;
+	size_t result_length;
+} ramd_job_record_t;
+
+typedef struct ramd_job_pool_t
+{
+	pthread_mutex_t lock; /* guards everything below */
+	pthread_cond_t cond;  /* a job was queued, or the pool is stopping */
+	bool running;
+	int32_t thread_count;
+	pthread_t threads[RAMD_JOB_WORKERS];
+	uint64_t next_id;
+	thread_safe_queue_t* queued; /* records to run, in submission order */
+	ramd_job_record_t records[RAMD_JOB_HISTORY_SIZE];
+} ramd_job_pool_t;
+
+static ramd_job_pool_t g_jobs = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.next_id = 1
+};
+
+/* The job the calling worker is running, for ramd_job_phase and friends */
+static _Thread_local ramd_job_record_t* t_job = NULL;
+
+/* Close the current phase; called with the lock held */
+static void
+ramd_job_end_phase(ramd_job_record_t* job, int64_t now_us)
+{
+	ramd_job_phase_t* phase;
+
+	if (job->status.phase_count == 0)
+		return;
+
+	phase = &job->status.phases[job->status.phase_count - 1];
+	if (phase->duration_ms < 0)
+		phase->duration_ms = (now_us - job->phase_started_us) / 1000;
+}
+
+static void*
+ramd_job_worker(void* arg)
+{
+	ramd_job_record_t* job;
+
+	(void) arg;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&g_jobs.lock);
+		while (g_jobs.running && (job = thread_safe_queue_dequeue(g_jobs.queued)) == NULL)
+			pthread_cond_wait(&g_jobs.cond, &g_jobs.lock);
+		if (!g_jobs.running)
+		{
+			pthread_mutex_unlock(&g_jobs.lock);
+			break;
+		}
+
+		job->status.state = RAMD_JOB_RUNNING;
+		job->status.started_at = time(NULL);
+		job->started_us = ramd_clock_now_us();
+		pthread_mutex_unlock(&g_jobs.lock);
+
+		ramd_log_info("Job %llu (%s) started", (unsigned long long) job->status.job_id,
+					  job->status.operation);
+
+		t_job = job;
+		job->run(job->arg);
+		if (!job->finished)
+			ramd_job_finish(false, 500, NULL, 0);
+		t_job = NULL;
+
+		if (job->free_arg)
+			job->free_arg(job->arg);
+		job->arg = NULL;
+	}
+	return NULL;
+}
+
+bool
+ramd_job_init(void)
+{
+	pthread_mutex_lock(&g_jobs.lock);
+	if (g_jobs.running)
+	{
+		pthread_mutex_unlock(&g_jobs.lock);
+		return true;
+	}
+
+	if (!g_jobs.queued)
+		g_jobs.queued = thread_safe_queue_create(RAMD_JOB_MAX_JOBS);
+	if (!g_jobs.queued)
+	{
+		pthread_mutex_unlock(&g_jobs.lock);
+		ramd_log_error("Failed to allocate the job queue");
+		return false;
+	}
+
+	g_jobs.running = true;
+	g_jobs.thread_count = 0;
+	for (int i = 0; i < RAMD_JOB_WORKERS; i++)
+	{
+		if (pthread_create(&g_jobs.threads[i], NULL, ramd_job_worker, NULL) != 0)
+		{
+			ramd_log_error("Failed to start job worker %d", i);
+			break;
+		}
+		g_jobs.thread_count++;
+	}
+	if (g_jobs.thread_count == 0)
+		g_jobs.running = false;
+	pthread_mutex_unlock(&g_jobs.lock);
+
+	return g_jobs.thread_count > 0;
+}
+
+void
+ramd_job_cleanup(void)
+{
+	int32_t thread_count;
+
+	pthread_mutex_lock(&g_jobs.lock);
+	g_jobs.running = false;
+	thread_count = g_jobs.thread_count;
+	g_jobs.thread_count = 0;
+	pthread_cond_broadcast(&g_jobs.cond);
+	pthread_mutex_unlock(&g_jobs.lock);
+
+	/* A running job cannot be interrupted; wait for it to finish */
+	for (int i = 0; i < thread_count; i++)
+		pthread_join(g_jobs.threads[i], NULL);
+
+	for (int i = 0; i < RAMD_JOB_HISTORY_SIZE; i++)
+	{
+		ramd_job_record_t* job = &g_jobs.records[i];
+
+		if (job->used && job->status.state == RAMD_JOB_QUEUED)
+		{
+			ramd_log_warning("Job %llu (%s) dropped at shutdown",
+							 (unsigned long long) job->status.job_id, job->status.operation);
+			if (job->free_arg)
+				job->free_arg(job->arg);
+		}
+		ramd_mem_free(RAMD_MEM_BACKUP, job->result);
+		memset(job, 0, sizeof(*job));
+	}
+	thread_safe_queue_destroy(g_jobs.queued);
+	g_jobs.queued = NULL;
+}
+
+bool
+ramd_job_submit(const char* operation, ramd_job_fn run, void* arg,
+				void (*free_arg)(void* arg), uint64_t* job_id)
+{
+	ramd_job_record_t* slot = NULL;
+	int32_t            active = 0;
+
+	if (!operation || !run)
+	{
+		if (free_arg)
+			free_arg(arg);
+		return false;
+	}
+
+	pthread_mutex_lock(&g_jobs.lock);
+	for (int i = 0; i < RAMD_JOB_HISTORY_SIZE; i++)
+	{
+		ramd_job_record_t* job = &g_jobs.records[i];
+
+		if (!job->used)
+		{
+			if (!slot || slot->used)
+				slot = job;
+		}
+		else if (!job->finished)
+			active++;
+		else if (!slot || (slot->used && job->status.job_id < slot->status.job_id))
+			slot = job; /* oldest finished job, reused if no slot is free */
+	}
+
+	if (!g_jobs.running || active >= RAMD_JOB_MAX_JOBS || !slot)
+	{
+		pthread_mutex_unlock(&g_jobs.lock);
+		if (free_arg)
+			free_arg(arg);
+		return false;
+	}
+
+	ramd_mem_free(RAMD_MEM_BACKUP, slot->result);
+	memset(slot, 0, sizeof(*slot));
+	slot->used = true;
+	slot->run = run;
+	slot->arg = arg;
+	slot->free_arg = free_arg;
+	slot->status.job_id = g_jobs.next_id++;
+	strncpy(slot->status.operation, operation, sizeof(slot->status.operation) - 1);
+	slot->status.state = RAMD_JOB_QUEUED;
+	slot->status.progress_percent = -1;
+	slot->status.created_at = time(NULL);
+	if (job_id)
+		*job_id = slot->status.job_id;
+
+	/* Cannot fail: it holds RAMD_JOB_MAX_JOBS and fewer are active */
+	(void) thread_safe_queue_enqueue(g_jobs.queued, slot);
+	pthread_cond_signal(&g_jobs.cond);
+	pthread_mutex_unlock(&g_jobs.lock);
+	return true;
+}
+
+void
+ramd_job_phase(const char* phase)
+{
+	ramd_job_record_t* job = t_job;
+	int64_t            now_us;
+
+	if (!job || !phase)
+		return;
+
+	now_us = ramd_clock_now_us();
+	pthread_mutex_lock(&g_jobs.lock);
+	ramd_job_end_phase(job, now_us);
+	if (job->status.phase_count < RAMD_JOB_MAX_PHASES)
+	{
+		ramd_job_phase_t* next = &job->status.phases[job->status.phase_count++];
+
+		strncpy(next->name, phase, sizeof(next->name) - 1);
+		next->name[sizeof(next->name) - 1] = '\0';
+		next->started_ms = (now_us - job->started_us) / 1000;
+		next->duration_ms = -1;
+		job->phase_started_us = now_us;
+	}
+	pthread_mutex_unlock(&g_jobs.lock);
+
+	ramd_log_info("Job %llu (%s): %s", (unsigned long long) job->status.job_id,
+				  job->status.operation, phase);
+}
+
+void
+ramd_job_progress(int32_t percent)
+{
+	ramd_job_record_t* job = t_job;
+
+	if (!job)
+		return;
+
+	pthread_mutex_lock(&g_jobs.lock);
+	job->status.progress_percent = percent < 0 ? 0 : percent > 100 ? 100 : percent;
+	pthread_mutex_unlock(&g_jobs.lock);
+}
+
+void
+ramd_job_finish(bool succeeded, int32_t result_status, const char* result,
+				size_t result_length)
+{
+	ramd_job_record_t* job = t_job;
+	char*              copy = NULL;
+	int64_t            now_us;
+
+	if (!job || job->finished)
+		return;
+
+	if (result && result_length > 0)
+	{
+		copy = ramd_mem_alloc(RAMD_MEM_BACKUP, result_length + 1);
+		if (copy)
+		{
+			memcpy(copy, result, result_length);
+			copy[result_length] = '\0';
+		}
+	}
+
+	now_us = ramd_clock_now_us();
+	pthread_mutex_lock(&g_jobs.lock);
+	ramd_job_end_phase(job, now_us);
+	job->finished = true;
+	job->status.state = succeeded ? RAMD_JOB_SUCCEEDED : RAMD_JOB_FAILED;
+	job->status.result_status = result_status;
+	job->status.finished_at = time(NULL);
+	job->status.total_ms = (now_us - job->started_us) / 1000;
+	if (succeeded)
+		job->status.progress_percent = 100;
+	job->result = copy;
+	job->result_length = copy ? result_length : 0;
+	pthread_mutex_unlock(&g_jobs.lock);
+
+	ramd_log_info("Job %llu (%s) %s in %lld ms", (unsigned long long) job->status.job_id,
+				  job->status.operation, succeeded ? "succeeded" : "failed",
+				  (long long) job->status.total_ms);
+}
+
+/* Copy a record's status, filling in the live fields; lock held */
+static void
+ramd_job_snapshot(const ramd_job_record_t* job, ramd_job_status_t* status)
+{
+	*status = job->status;
+	status->queue_position = 0;
+	if (job->status.state == RAMD_JOB_QUEUED)
+	{
+		for (int i = 0; i < RAMD_JOB_HISTORY_SIZE; i++)
+		{
+			const ramd_job_record_t* other = &g_jobs.records[i];
+
+			if (other->used && other->status.state == RAMD_JOB_QUEUED &&
+				other->status.job_id < job->status.job_id)
+				status->queue_position++;
+		}
+	}
+	else if (job->status.state == RAMD_JOB_RUNNING)
+		status->total_ms = (ramd_clock_now_us() - job->started_us) / 1000;
+}
+
+bool
+ramd_job_get(uint64_t job_id, ramd_job_status_t* status, char** result,
+			 size_t* result_length)
+{
+	bool found = false;
+
+	if (!status)
+		return false;
+	if (result)
+		*result = NULL;
+	if (result_length)
+		*result_length = 0;
+
+	pthread_mutex_lock(&g_jobs.lock);
+	for (int i = 0; i < RAMD_JOB_HISTORY_SIZE && !found; i++)
+	{
+		const ramd_job_record_t* job = &g_jobs.records[i];
+
+		if (!job->used || job->status.job_id != job_id)
+			continue;
+
+		found = true;
+		ramd_job_snapshot(job, status);
+		if (result && job->result)
+		{
+			*result = malloc(job->result_length + 1);
+			if (*result)
+			{
+				memcpy(*result, job->result, job->result_length + 1);
+				if (result_length)
+					*result_length = job->result_length;
+			}
+		}
+	}
+	pthread_mutex_unlock(&g_jobs.lock);
+	return found;
+}
+
+static int
+ramd_job_compare_newest_first(const void* a, const void* b)
+{
+	uint64_t x = ((const ramd_job_status_t*) a)->job_id;
+	uint64_t y = ((const ramd_job_status_t*) b)->job_id;
+
+	return (x < y) - (x > y);
+}
+
+int32_t
+ramd_job_list(ramd_job_status_t* statuses, int32_t max_count)
+{
+	int32_t count = 0;
+
+	if (!statuses || max_count <= 0)
+		return 0;
+
+	pthread_mutex_lock(&g_jobs.lock);
+	for (int i = 0; i < RAMD_JOB_HISTORY_SIZE && count < max_count; i++)
+	{
+		if (g_jobs.records[i].used)
+			ramd_job_snapshot(&g_jobs.records[i], &statuses[count++]);
+	}
+	pthread_mutex_unlock(&g_jobs.lock);
+
+	qsort(statuses, (size_t) count, sizeof(*statuses), ramd_job_compare_newest_first);
+	return count;
+}
+
+const char*
+ramd_job_state_to_string(ramd_job_state_t state)
+{
+	switch (state)
+	{
+		case RAMD_JOB_QUEUED:
+			return "queued";
+		case RAMD_JOB_RUNNING:
+			return "running";
+		case RAMD_JOB_SUCCEEDED:
+			return "succeeded";
+		case RAMD_JOB_FAILED:
+			return "failed";
+		default:
+			return "unknown";
+	}
+}
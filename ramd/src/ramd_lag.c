@@ -0,0 +1,638 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_lag.c
+ *		PostgreSQL Auto-Failover Daemon - Replication Lag Sampler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Lag is measured on the primary: one read of pg_stat_replication gives
+ * the write/flush/replay lag times and WAL byte distances of every standby
+ * at once.  Unlike now() - pg_last_xact_replay_timestamp() on each standby,
+ * this does not grow while the primary is idle.  Every daemon samples the
+ * current primary, so the last figures are still known locally after the
+ * primary fails and can inform the choice of its successor.  The same
+ * session keeps the standbys' replication slots (ramd_slots.c) and, on
+ * the primary's own daemon, the cascade plan (ramd_topology.c).  Standbys
+ * cascaded off another standby are not in the primary's pg_stat_replication
+ * and so have no lag figures here.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_lag.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_slots.h"
+#include "ramd_logical_slots.h"
+#include "ramd_topology.h"
+#include "ramd_sync_replication.h"
+#include "ramd_watch.h"
+
+#define RAMD_LAG_QUERY \
+	"SELECT application_name, COALESCE(host(client_addr), ''), state, sync_state, " \
+	"pg_wal_lsn_diff(w.lsn, write_lsn)::bigint, " \
+	"pg_wal_lsn_diff(w.lsn, flush_lsn)::bigint, " \
+	"pg_wal_lsn_diff(w.lsn, replay_lsn)::bigint, " \
+	"(EXTRACT(EPOCH FROM write_lag) * 1000)::integer, " \
+	"(EXTRACT(EPOCH FROM flush_lag) * 1000)::integer, " \
+	"(EXTRACT(EPOCH FROM replay_lag) * 1000)::integer, " \
+	"pg_wal_lsn_diff(flush_lsn, '0/0')::bigint, " \
+	"pg_wal_lsn_diff(replay_lsn, '0/0')::bigint, " \
+	"pg_wal_lsn_diff(w.flush, '0/0')::bigint " \
+	"FROM pg_stat_replication, " \
+	"(SELECT CASE WHEN pg_is_in_recovery() THEN pg_last_wal_receive_lsn() " \
+	"ELSE pg_current_wal_lsn() END AS lsn, " \
+	"CASE WHEN pg_is_in_recovery() THEN pg_last_wal_receive_lsn() " \
+	"ELSE pg_current_wal_flush_lsn() END AS flush) w"
+
+typedef struct ramd_lag_standby_t
+{
+	bool used;
+	int32_t node_id;
+	char application_name[64];
+	char client_addr[64];
+	bool connected;
+	bool is_sync;
+	int64_t flush_lsn;
+	int64_t replay_lsn;
+	ramd_lag_sample_t ring[RAMD_LAG_HISTORY_SIZE];
+	int32_t ring_head; /* next slot to write */
+	int32_t ring_count;
+	double ewma_replay_lag_ms;
+	bool ewma_valid;
+	double ewma_flush_lag_ms;
+	bool ewma_flush_valid;
+} ramd_lag_standby_t;
+
+typedef struct ramd_lag_sampler_t
+{
+	pthread_mutex_t lock; /* guards everything below but conn */
+	pthread_cond_t cond;  /* wakes the sampler */
+	pthread_cond_t sampled; /* broadcast after every recorded sample */
+	bool running;
+	uint64_t generation;      /* recorded samples so far */
+	int32_t waiters;          /* threads in ramd_lag_wait */
+	int64_t primary_flush_lsn; /* as of the latest sample, -1 if unknown */
+	int64_t primary_flush_at_us; /* when that sample's query was sent */
+	pthread_t thread;
+	ramd_cluster_t* cluster;
+	const ramd_config_t* config;
+	PGconn* conn;
+	int32_t conn_node_id;
+	ramd_lag_standby_t standbys[RAMD_MAX_NODES];
+} ramd_lag_sampler_t;
+
+static ramd_lag_sampler_t g_lag = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.sampled = PTHREAD_COND_INITIALIZER,
+	.primary_flush_lsn = -1,
+	.conn_node_id = -1
+};
+
+static int64_t
+ramd_lag_value(const PGresult* res, int row, int col, int64_t if_null)
+{
+	if (PQgetisnull(res, row, col))
+		return if_null;
+	return strtoll(PQgetvalue(res, row, col), NULL, 10);
+}
+
+/* Standbys name themselves ramd_node_<id>; otherwise match the address */
+static int32_t
+ramd_lag_match_node(const char* application_name, const char* client_addr)
+{
+	ramd_cluster_t* cluster = g_lag.cluster;
+	int32_t node_id;
+
+	if (sscanf(application_name, "ramd_node_%d", &node_id) == 1)
+		return node_id;
+
+	for (int32_t i = 0; cluster && client_addr[0] && i < cluster->node_count; i++)
+	{
+		if (strcmp(cluster->nodes[i].hostname, client_addr) == 0)
+			return cluster->nodes[i].node_id;
+	}
+	return -1;
+}
+
+static ramd_lag_standby_t*
+ramd_lag_find_slot(const char* application_name, const char* client_addr)
+{
+	ramd_lag_standby_t* free_slot = NULL;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_lag_standby_t* s = &g_lag.standbys[i];
+
+		if (!s->used)
+		{
+			if (!free_slot)
+				free_slot = s;
+			continue;
+		}
+		if (strcmp(s->application_name, application_name) == 0 &&
+		    strcmp(s->client_addr, client_addr) == 0)
+			return s;
+	}
+
+	if (free_slot)
+	{
+		memset(free_slot, 0, sizeof(*free_slot));
+		free_slot->used = true;
+		snprintf(free_slot->application_name, sizeof(free_slot->application_name), "%s",
+		         application_name);
+		snprintf(free_slot->client_addr, sizeof(free_slot->client_addr), "%s", client_addr);
+	}
+	return free_slot;
+}
+
+static void
+ramd_lag_record(const PGresult* res, int64_t sent_us, int64_t now_us)
+{
+	int rows = PQntuples(res);
+
+	pthread_mutex_lock(&g_lag.lock);
+	/* Without walsenders there is no row to carry the primary's position */
+	g_lag.primary_flush_lsn = rows > 0 ? ramd_lag_value(res, 0, 12, -1) : -1;
+	g_lag.primary_flush_at_us = sent_us;
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+		g_lag.standbys[i].connected = false;
+
+	for (int row = 0; row < rows; row++)
+	{
+		const char* sync_state = PQgetvalue(res, row, 3);
+		ramd_lag_standby_t* s;
+		ramd_lag_sample_t* sample;
+
+		s = ramd_lag_find_slot(PQgetvalue(res, row, 0), PQgetvalue(res, row, 1));
+		if (!s)
+			continue;
+
+		s->node_id = ramd_lag_match_node(s->application_name, s->client_addr);
+		s->connected = strcmp(PQgetvalue(res, row, 2), "streaming") == 0;
+		s->is_sync = strcmp(sync_state, "sync") == 0 || strcmp(sync_state, "quorum") == 0;
+		s->flush_lsn = ramd_lag_value(res, row, 10, 0);
+		s->replay_lsn = ramd_lag_value(res, row, 11, 0);
+
+		sample = &s->ring[s->ring_head];
+		sample->sampled_at_us = now_us;
+		sample->write_lag_bytes = ramd_lag_value(res, row, 4, -1);
+		sample->flush_lag_bytes = ramd_lag_value(res, row, 5, -1);
+		sample->replay_lag_bytes = ramd_lag_value(res, row, 6, -1);
+
+		/* The server clears the lag times once an idle standby has caught up */
+		sample->write_lag_ms = (int32_t) ramd_lag_value(res, row, 7,
+		                                               sample->write_lag_bytes == 0 ? 0 : -1);
+		sample->flush_lag_ms = (int32_t) ramd_lag_value(res, row, 8,
+		                                               sample->flush_lag_bytes == 0 ? 0 : -1);
+		sample->replay_lag_ms = (int32_t) ramd_lag_value(res, row, 9,
+		                                                sample->replay_lag_bytes == 0 ? 0 : -1);
+
+		s->ring_head = (s->ring_head + 1) % RAMD_LAG_HISTORY_SIZE;
+		if (s->ring_count < RAMD_LAG_HISTORY_SIZE)
+			s->ring_count++;
+
+		if (sample->replay_lag_ms >= 0)
+		{
+			s->ewma_replay_lag_ms = s->ewma_valid
+			    ? RAMD_LAG_EWMA_ALPHA * sample->replay_lag_ms +
+			      (1.0 - RAMD_LAG_EWMA_ALPHA) * s->ewma_replay_lag_ms
+			    : sample->replay_lag_ms;
+			s->ewma_valid = true;
+		}
+		if (sample->flush_lag_ms >= 0)
+		{
+			s->ewma_flush_lag_ms = s->ewma_flush_valid
+			    ? RAMD_LAG_EWMA_ALPHA * sample->flush_lag_ms +
+			      (1.0 - RAMD_LAG_EWMA_ALPHA) * s->ewma_flush_lag_ms
+			    : sample->flush_lag_ms;
+			s->ewma_flush_valid = true;
+		}
+	}
+	g_lag.generation++;
+	pthread_cond_broadcast(&g_lag.sampled);
+	pthread_mutex_unlock(&g_lag.lock);
+
+	/* Publish outside the lock; the cluster node is read without one */
+	for (int row = 0; row < rows; row++)
+	{
+		int32_t lag_ms = (int32_t) ramd_lag_value(res, row, 9, 0);
+		int32_t node_id = ramd_lag_match_node(PQgetvalue(res, row, 0), PQgetvalue(res, row, 1));
+		ramd_node_t* node;
+
+		node = node_id >= 0 && g_lag.cluster
+		    ? ramd_cluster_find_node(g_lag.cluster, node_id) : NULL;
+		if (node)
+			node->replication_lag_ms = lag_ms;
+	}
+}
+
+static void
+ramd_lag_disconnect(void)
+{
+	if (g_lag.conn)
+		PQfinish(g_lag.conn);
+	g_lag.conn = NULL;
+	g_lag.conn_node_id = -1;
+}
+
+/* Keep a session to whichever node the cluster currently calls primary */
+static bool
+ramd_lag_ensure_connection(void)
+{
+	const ramd_config_t* config = g_lag.config;
+	const ramd_node_t* primary = ramd_cluster_get_primary_node(g_lag.cluster);
+	const char* keywords[8];
+	const char* values[8];
+	char port[16];
+	char timeout[16];
+	int n = 0;
+
+	if (!primary)
+	{
+		ramd_lag_disconnect();
+		return false;
+	}
+
+	if (g_lag.conn && g_lag.conn_node_id == primary->node_id &&
+	    PQstatus(g_lag.conn) == CONNECTION_OK)
+		return true;
+
+	ramd_lag_disconnect();
+
+	snprintf(port, sizeof(port), "%d", primary->postgresql_port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = primary->hostname;
+	keywords[n] = "port";            values[n++] = port;
+	keywords[n] = "dbname";          values[n++] = config->database_name;
+	keywords[n] = "user";            values[n++] = config->database_user;
+	if (config->database_password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = config->database_password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd_lag";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	g_lag.conn = PQconnectdbParams(keywords, values, 0);
+	if (PQstatus(g_lag.conn) != CONNECTION_OK)
+	{
+		ramd_log_debug("Lag sampler: cannot connect to primary %d: %s", primary->node_id,
+		               PQerrorMessage(g_lag.conn));
+		ramd_lag_disconnect();
+		return false;
+	}
+
+	g_lag.conn_node_id = primary->node_id;
+	ramd_log_info("Lag sampler: sampling pg_stat_replication on node %d (%s:%d)",
+	              primary->node_id, primary->hostname, primary->postgresql_port);
+	return true;
+}
+
+static void
+ramd_lag_sample_once(void)
+{
+	PGresult* res;
+	int64_t sent_us;
+
+	if (!ramd_lag_ensure_connection())
+		return;
+
+	sent_us = ramd_clock_now_us();
+	res = PQexec(g_lag.conn, RAMD_LAG_QUERY);
+	if (PQresultStatus(res) == PGRES_TUPLES_OK)
+	{
+		ramd_lag_stats_t stats[RAMD_MAX_NODES];
+		int32_t count;
+
+		ramd_lag_record(res, sent_us, ramd_clock_now_us());
+
+		/* Same session, so synchronous_standby_names follows the sampled primary */
+		count = ramd_lag_get_all(stats, RAMD_MAX_NODES);
+		ramd_sync_replication_adapt(g_lag.conn, g_lag.conn_node_id, stats, count);
+		ramd_topology_update(g_lag.conn, g_lag.conn_node_id, g_lag.cluster, g_lag.config,
+		                     stats, count);
+		ramd_slots_manage(g_lag.conn, g_lag.conn_node_id, g_lag.cluster, g_lag.config);
+		ramd_logical_slots_sync(g_lag.conn, g_lag.conn_node_id, g_lag.cluster, g_lag.config);
+
+		/* Lag moves between monitor cycles; let watchers see it now */
+		ramd_watch_publish(g_lag.cluster);
+	}
+	else
+	{
+		ramd_log_debug("Lag sampler: query failed: %s", PQerrorMessage(g_lag.conn));
+		if (PQstatus(g_lag.conn) != CONNECTION_OK)
+			ramd_lag_disconnect();
+	}
+	PQclear(res);
+}
+
+static void*
+ramd_lag_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_lag.lock);
+	while (g_lag.running)
+	{
+		int32_t interval_ms = g_lag.config->lag_sample_interval_ms;
+		struct timespec deadline;
+
+		/* Someone is waiting for a standby to catch up; keep them informed */
+		if (g_lag.waiters > 0 && interval_ms > RAMD_LAG_WAIT_INTERVAL_MS)
+			interval_ms = RAMD_LAG_WAIT_INTERVAL_MS;
+
+		pthread_mutex_unlock(&g_lag.lock);
+		ramd_lag_sample_once();
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += interval_ms / 1000;
+		deadline.tv_nsec += (long) (interval_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&g_lag.lock);
+		if (g_lag.running)
+			pthread_cond_timedwait(&g_lag.cond, &g_lag.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_lag.lock);
+
+	ramd_lag_disconnect();
+	return NULL;
+}
+
+bool
+ramd_lag_start(ramd_cluster_t* cluster, const ramd_config_t* config)
+{
+	if (!cluster || !config)
+		return false;
+
+	pthread_mutex_lock(&g_lag.lock);
+	if (g_lag.running)
+	{
+		pthread_mutex_unlock(&g_lag.lock);
+		return true;
+	}
+	memset(g_lag.standbys, 0, sizeof(g_lag.standbys));
+	g_lag.primary_flush_lsn = -1;
+	g_lag.cluster = cluster;
+	g_lag.config = config;
+	g_lag.running = true;
+	if (pthread_create(&g_lag.thread, NULL, ramd_lag_thread_main, NULL) != 0)
+	{
+		g_lag.running = false;
+		pthread_mutex_unlock(&g_lag.lock);
+		ramd_log_error("Lag sampler: failed to create thread");
+		return false;
+	}
+	pthread_mutex_unlock(&g_lag.lock);
+
+	ramd_log_info("Replication lag sampler started (interval %d ms)",
+	              config->lag_sample_interval_ms);
+	return true;
+}
+
+void
+ramd_lag_stop(void)
+{
+	pthread_mutex_lock(&g_lag.lock);
+	if (!g_lag.running)
+	{
+		pthread_mutex_unlock(&g_lag.lock);
+		return;
+	}
+	g_lag.running = false;
+	pthread_cond_broadcast(&g_lag.cond);
+	pthread_cond_broadcast(&g_lag.sampled);
+	pthread_mutex_unlock(&g_lag.lock);
+
+	pthread_join(g_lag.thread, NULL);
+}
+
+void
+ramd_lag_request_sample(void)
+{
+	pthread_mutex_lock(&g_lag.lock);
+	pthread_cond_signal(&g_lag.cond);
+	pthread_mutex_unlock(&g_lag.lock);
+}
+
+static int
+ramd_lag_compare_int32(const void* a, const void* b)
+{
+	int32_t x = *(const int32_t*) a;
+	int32_t y = *(const int32_t*) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Summarise one standby's ring; called with the lock held */
+static void
+ramd_lag_summarise(const ramd_lag_standby_t* s, int64_t now_us, ramd_lag_stats_t* stats)
+{
+	int32_t values[RAMD_LAG_HISTORY_SIZE];
+	int32_t valid = 0;
+	int32_t newest = (s->ring_head + RAMD_LAG_HISTORY_SIZE - 1) % RAMD_LAG_HISTORY_SIZE;
+	int32_t oldest = (s->ring_head + RAMD_LAG_HISTORY_SIZE - s->ring_count) % RAMD_LAG_HISTORY_SIZE;
+	const ramd_lag_sample_t* first = &s->ring[oldest];
+	const ramd_lag_sample_t* last = &s->ring[newest];
+
+	memset(stats, 0, sizeof(*stats));
+	stats->node_id = s->node_id;
+	snprintf(stats->application_name, sizeof(stats->application_name), "%s", s->application_name);
+	snprintf(stats->client_addr, sizeof(stats->client_addr), "%s", s->client_addr);
+	stats->connected = s->connected;
+	stats->is_sync = s->is_sync;
+	stats->flush_lsn = s->flush_lsn;
+	stats->replay_lsn = s->replay_lsn;
+	stats->sample_count = s->ring_count;
+	stats->ewma_replay_lag_ms = s->ewma_valid ? s->ewma_replay_lag_ms : -1.0;
+	stats->ewma_flush_lag_ms = s->ewma_flush_valid ? s->ewma_flush_lag_ms : -1.0;
+	stats->p99_replay_lag_ms = -1;
+
+	if (s->ring_count == 0)
+		return;
+
+	stats->last = *last;
+	stats->age_ms = (now_us - last->sampled_at_us) / 1000;
+
+	for (int32_t i = 0; i < s->ring_count; i++)
+	{
+		const ramd_lag_sample_t* sample = &s->ring[(oldest + i) % RAMD_LAG_HISTORY_SIZE];
+
+		if (sample->replay_lag_ms >= 0)
+			values[valid++] = sample->replay_lag_ms;
+	}
+	if (valid > 0)
+	{
+		qsort(values, (size_t) valid, sizeof(int32_t), ramd_lag_compare_int32);
+		stats->p99_replay_lag_ms = values[(valid * 99 + 99) / 100 - 1];
+	}
+
+	if (last->sampled_at_us > first->sampled_at_us &&
+	    first->replay_lag_bytes >= 0 && last->replay_lag_bytes >= 0)
+		stats->trend_bytes_per_second =
+		    (double) (last->replay_lag_bytes - first->replay_lag_bytes) * 1000000.0 /
+		    (double) (last->sampled_at_us - first->sampled_at_us);
+}
+
+bool
+ramd_lag_get_stats(int32_t node_id, ramd_lag_stats_t* stats)
+{
+	int64_t now_us = ramd_clock_now_us();
+	bool found = false;
+
+	if (!stats || node_id < 0)
+		return false;
+
+	pthread_mutex_lock(&g_lag.lock);
+	for (int i = 0; i < RAMD_MAX_NODES && !found; i++)
+	{
+		const ramd_lag_standby_t* s = &g_lag.standbys[i];
+
+		if (s->used && s->node_id == node_id)
+		{
+			ramd_lag_summarise(s, now_us, stats);
+			found = true;
+		}
+	}
+	pthread_mutex_unlock(&g_lag.lock);
+	return found;
+}
+
+int64_t
+ramd_lag_primary_flush_lsn(void)
+{
+	int64_t lsn;
+
+	pthread_mutex_lock(&g_lag.lock);
+	lsn = g_lag.primary_flush_lsn;
+	pthread_mutex_unlock(&g_lag.lock);
+	return lsn;
+}
+
+int32_t
+ramd_lag_get_all(ramd_lag_stats_t* stats, int32_t max_count)
+{
+	int64_t now_us = ramd_clock_now_us();
+	int32_t count = 0;
+
+	if (!stats)
+		return 0;
+
+	pthread_mutex_lock(&g_lag.lock);
+	for (int i = 0; i < RAMD_MAX_NODES && count < max_count; i++)
+	{
+		if (g_lag.standbys[i].used)
+			ramd_lag_summarise(&g_lag.standbys[i], now_us, &stats[count++]);
+	}
+	pthread_mutex_unlock(&g_lag.lock);
+	return count;
+}
+
+/* Called with the lock held */
+static bool
+ramd_lag_reached(int32_t node_id, int32_t min_standbys, int64_t target_lsn)
+{
+	int32_t reached = 0;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		const ramd_lag_standby_t* s = &g_lag.standbys[i];
+
+		if (!s->used || !s->connected || s->flush_lsn < target_lsn)
+			continue;
+		if (node_id >= 0 ? s->node_id == node_id : s->is_sync)
+			reached++;
+	}
+	return reached >= (node_id >= 0 ? 1 : min_standbys);
+}
+
+/*
+ * Block until the standbys report flushing target_lsn, judged on every
+ * sample as it is recorded.  A negative target means the primary's flush
+ * position as read by the first sample sent after the call, so that
+ * everything committed before it is covered.
+ */
+static bool
+ramd_lag_wait(int32_t node_id, int32_t min_standbys, int64_t target_lsn, int32_t timeout_ms)
+{
+	int64_t called_us = ramd_clock_now_us();
+	struct timespec deadline;
+	uint64_t seen;
+	bool reached = false;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&g_lag.lock);
+	if (!g_lag.running)
+	{
+		pthread_mutex_unlock(&g_lag.lock);
+		return false;
+	}
+
+	g_lag.waiters++;
+	pthread_cond_signal(&g_lag.cond); /* cut the sampler's sleep short */
+	seen = g_lag.generation;
+
+	while (g_lag.running)
+	{
+		if (g_lag.generation != seen)
+		{
+			seen = g_lag.generation;
+			if (target_lsn < 0 && g_lag.primary_flush_lsn >= 0 &&
+			    g_lag.primary_flush_at_us >= called_us)
+				target_lsn = g_lag.primary_flush_lsn;
+			if (target_lsn >= 0 && ramd_lag_reached(node_id, min_standbys, target_lsn))
+			{
+				reached = true;
+				break;
+			}
+		}
+		if (pthread_cond_timedwait(&g_lag.sampled, &g_lag.lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	g_lag.waiters--;
+	pthread_mutex_unlock(&g_lag.lock);
+	return reached;
+}
+
+bool
+ramd_lag_wait_for_flush(int32_t node_id, int64_t target_lsn, int32_t timeout_ms)
+{
+	if (node_id < 0 || timeout_ms <= 0)
+		return false;
+	return ramd_lag_wait(node_id, 1, target_lsn, timeout_ms);
+}
+
+bool
+ramd_lag_wait_for_sync(int32_t min_standbys, int64_t target_lsn, int32_t timeout_ms)
+{
+	if (min_standbys <= 0)
+		return true;
+	if (timeout_ms <= 0)
+		return false;
+	return ramd_lag_wait(-1, min_standbys, target_lsn, timeout_ms);
+}
@@ -0,0 +1,239 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_leader_watch.c
+ *		PostgreSQL Auto-Failover Daemon - Raft Leader Change Watch
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The monitor learns the Raft leader from the snapshot it reads at the
+ * start of each cycle, so on its own it reacts to an election up to one
+ * interval late.  This thread closes the gap.  pgraft's worker wakes
+ * every backend in pgraft_wait_leader_change() as soon as the Go Raft
+ * node publishes a new leader or term, and the function returns the new
+ * pair; the thread then wakes the monitor to run its cycle at once.  A
+ * long poll stands in for LISTEN/NOTIFY because pgraft's worker has no
+ * database connection to notify from.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_leader_watch.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_pgraft.h"
+
+typedef struct ramd_leader_watch_t
+{
+	pthread_mutex_t lock; /* guards running and cancel */
+	pthread_cond_t cond;  /* wakes the retry wait */
+	bool running;
+	pthread_t thread;
+	ramd_monitor_t* monitor;
+	const ramd_config_t* config;
+	PGconn* conn;         /* the watch thread's alone */
+	PGcancel* cancel;     /* for conn, so stop need not wait out a call */
+} ramd_leader_watch_t;
+
+static ramd_leader_watch_t g_leader_watch = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+ramd_leader_watch_disconnect(void)
+{
+	pthread_mutex_lock(&g_leader_watch.lock);
+	if (g_leader_watch.cancel)
+		PQfreeCancel(g_leader_watch.cancel);
+	g_leader_watch.cancel = NULL;
+	pthread_mutex_unlock(&g_leader_watch.lock);
+
+	if (g_leader_watch.conn)
+		PQfinish(g_leader_watch.conn);
+	g_leader_watch.conn = NULL;
+}
+
+static bool
+ramd_leader_watch_ensure_connection(void)
+{
+	const ramd_config_t* config = g_leader_watch.config;
+	const char* keywords[8];
+	const char* values[8];
+	char port[16];
+	char timeout[16];
+	int n = 0;
+
+	if (g_leader_watch.conn && PQstatus(g_leader_watch.conn) == CONNECTION_OK)
+		return true;
+
+	ramd_leader_watch_disconnect();
+
+	snprintf(port, sizeof(port), "%d", config->postgresql_port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = config->hostname;
+	keywords[n] = "port";            values[n++] = port;
+	keywords[n] = "dbname";          values[n++] = config->database_name;
+	keywords[n] = "user";            values[n++] = config->database_user;
+	if (config->database_password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = config->database_password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd_leader_watch";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	g_leader_watch.conn = PQconnectdbParams(keywords, values, 0);
+	if (PQstatus(g_leader_watch.conn) != CONNECTION_OK)
+	{
+		ramd_log_debug("Leader watch: cannot connect to %s:%d: %s", config->hostname,
+		               config->postgresql_port, PQerrorMessage(g_leader_watch.conn));
+		PQfinish(g_leader_watch.conn);
+		g_leader_watch.conn = NULL;
+		return false;
+	}
+
+	pthread_mutex_lock(&g_leader_watch.lock);
+	g_leader_watch.cancel = PQgetCancel(g_leader_watch.conn);
+	pthread_mutex_unlock(&g_leader_watch.lock);
+	return true;
+}
+
+/* Sleep RAMD_LEADER_WATCH_RETRY_MS unless stopped first; lock held */
+static void
+ramd_leader_watch_retry_wait(void)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += RAMD_LEADER_WATCH_RETRY_MS / 1000;
+	deadline.tv_nsec += (long) (RAMD_LEADER_WATCH_RETRY_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	if (g_leader_watch.running)
+		pthread_cond_timedwait(&g_leader_watch.cond, &g_leader_watch.lock, &deadline);
+}
+
+static void*
+ramd_leader_watch_thread_main(void* arg)
+{
+	long long leader = -1;
+	long long term = -1;
+	bool failing = false;
+
+	(void) arg;
+
+	pthread_mutex_lock(&g_leader_watch.lock);
+	while (g_leader_watch.running)
+	{
+		long long new_leader;
+		long long new_term;
+		bool changed = false;
+		int rc = RAMD_PGRAFT_ERROR;
+
+		pthread_mutex_unlock(&g_leader_watch.lock);
+		if (ramd_leader_watch_ensure_connection())
+			rc = ramd_pgraft_wait_leader_change(g_leader_watch.conn, leader, term,
+			                                    RAMD_LEADER_WATCH_WAIT_MS,
+			                                    &new_leader, &new_term, &changed);
+		pthread_mutex_lock(&g_leader_watch.lock);
+
+		if (!g_leader_watch.running)
+			break;
+
+		if (rc != RAMD_PGRAFT_SUCCESS)
+		{
+			if (!failing)
+				ramd_log_warning("Leader watch: %s; Raft leader changes will wait for the "
+				                 "next monitor cycle", ramd_pgraft_get_last_error());
+			failing = true;
+			if (g_leader_watch.conn && PQstatus(g_leader_watch.conn) != CONNECTION_OK)
+			{
+				pthread_mutex_unlock(&g_leader_watch.lock);
+				ramd_leader_watch_disconnect();
+				pthread_mutex_lock(&g_leader_watch.lock);
+			}
+			ramd_leader_watch_retry_wait();
+			continue;
+		}
+
+		if (failing)
+			ramd_log_info("Leader watch: watching Raft leadership on the local node");
+		failing = false;
+		if (!changed)
+			continue;
+
+		/* The first answer only tells us where we stand */
+		if (term >= 0)
+		{
+			ramd_log_info("Leader watch: Raft leader %lld -> %lld (term %lld -> %lld)",
+			              leader, new_leader, term, new_term);
+			ramd_monitor_wake(g_leader_watch.monitor);
+		}
+		leader = new_leader;
+		term = new_term;
+	}
+	pthread_mutex_unlock(&g_leader_watch.lock);
+
+	ramd_leader_watch_disconnect();
+	return NULL;
+}
+
+bool
+ramd_leader_watch_start(ramd_monitor_t* monitor, const ramd_config_t* config)
+{
+	if (!monitor || !config)
+		return false;
+
+	pthread_mutex_lock(&g_leader_watch.lock);
+	if (g_leader_watch.running)
+	{
+		pthread_mutex_unlock(&g_leader_watch.lock);
+		return true;
+	}
+	g_leader_watch.monitor = monitor;
+	g_leader_watch.config = config;
+	g_leader_watch.running = true;
+	if (pthread_create(&g_leader_watch.thread, NULL, ramd_leader_watch_thread_main, NULL) != 0)
+	{
+		g_leader_watch.running = false;
+		pthread_mutex_unlock(&g_leader_watch.lock);
+		ramd_log_error("Leader watch: failed to create thread");
+		return false;
+	}
+	pthread_mutex_unlock(&g_leader_watch.lock);
+
+	ramd_log_info("Raft leader watch started");
+	return true;
+}
+
+void
+ramd_leader_watch_stop(void)
+{
+	char errbuf[256];
+
+	pthread_mutex_lock(&g_leader_watch.lock);
+	if (!g_leader_watch.running)
+	{
+		pthread_mutex_unlock(&g_leader_watch.lock);
+		return;
+	}
+	g_leader_watch.running = false;
+	/* Cut the long poll short; the thread sees the error and exits */
+	if (g_leader_watch.cancel)
+		(void) PQcancel(g_leader_watch.cancel, errbuf, sizeof(errbuf));
+	pthread_cond_broadcast(&g_leader_watch.cond);
+	pthread_mutex_unlock(&g_leader_watch.lock);
+
+	pthread_join(g_leader_watch.thread, NULL);
+}
@@ -0,0 +1,409 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_log_rotate.c
+ *		PostgreSQL Auto-Failover Daemon - Rotated Log Compression
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The log writer only renames the file and opens a new one; everything
+ * slow about rotation happens here, on one thread that runs at nice 19
+ * and idle I/O priority.  A pass lists log_file's rotated copies in the
+ * same directory, deletes the oldest beyond log_rotation_count, then
+ * compresses the rest: with zstd where ramd was built against libzstd,
+ * with gzip otherwise.  Each is written to a temporary file, fsynced and
+ * renamed over before the original goes, so a crash leaves either copy
+ * whole and the next pass finishes the job.
+ *
+ * The thread is detached and never stopped: neither a reload nor shutdown
+ * waits for a compression to finish, and one cut short by exit is simply
+ * redone.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(HAVE_LIBZSTD)
+#include <zstd.h>
+#else
+#include <zlib.h>
+#endif
+
+#include "ramd_log_rotate.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_process.h"
+
+#define RAMD_LOG_ROTATE_IO_SIZE (256 * 1024)
+#define RAMD_LOG_ROTATE_TMP_SUFFIX ".tmp"
+
+typedef struct ramd_log_rotate_t
+{
+	pthread_mutex_t lock;   /* guards everything below */
+	pthread_cond_t cond;    /* wakes the thread: a pass is wanted */
+	bool started;
+	bool pending;
+	char log_file[RAMD_MAX_PATH_LENGTH];
+	int32_t keep;
+	bool compress;
+} ramd_log_rotate_t;
+
+static ramd_log_rotate_t g_log_rotate = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static bool
+ramd_log_rotate_has_suffix(const char* name, const char* suffix)
+{
+	size_t length = strlen(name);
+	size_t suffix_length = strlen(suffix);
+
+	return length >= suffix_length && strcmp(name + length - suffix_length, suffix) == 0;
+}
+
+static int
+ramd_log_rotate_name_cmp(const void* a, const void* b)
+{
+	return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static bool
+ramd_log_rotate_write_all(int fd, const void* data, size_t length)
+{
+	const char* p = data;
+
+	while (length > 0)
+	{
+		ssize_t n = write(fd, p, length);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		length -= (size_t) n;
+	}
+	return true;
+}
+
+#if defined(HAVE_LIBZSTD)
+static bool
+ramd_log_rotate_encode(int in, int out, char* buffer, char* encoded, size_t size)
+{
+	ZSTD_CCtx* cctx = ZSTD_createCCtx();
+	bool ok = cctx != NULL;
+
+	if (ok)
+		ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, RAMD_LOG_COMPRESS_LEVEL);
+	while (ok)
+	{
+		ssize_t n = read(in, buffer, size);
+		ZSTD_EndDirective mode = n == 0 ? ZSTD_e_end : ZSTD_e_continue;
+		ZSTD_inBuffer input = {buffer, n > 0 ? (size_t) n : 0, 0};
+		bool finished;
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ok = false;
+			break;
+		}
+		do
+		{
+			ZSTD_outBuffer output = {encoded, size, 0};
+			size_t left = ZSTD_compressStream2(cctx, &output, &input, mode);
+
+			if (ZSTD_isError(left) || !ramd_log_rotate_write_all(out, encoded, output.pos))
+			{
+				ok = false;
+				break;
+			}
+			finished = mode == ZSTD_e_end ? left == 0 : input.pos == input.size;
+		} while (!finished);
+		if (n == 0)
+			break;
+		posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+	}
+	ZSTD_freeCCtx(cctx);
+	return ok;
+}
+#else
+static bool
+ramd_log_rotate_encode(int in, int out, char* buffer, char* encoded, size_t size)
+{
+	z_stream zs;
+	bool ok = true;
+	int flush = Z_NO_FLUSH;
+
+	memset(&zs, 0, sizeof(zs));
+	/* 15 + 16: a gzip header, so the result is an ordinary .gz file */
+	if (deflateInit2(&zs, RAMD_LOG_COMPRESS_LEVEL, Z_DEFLATED, 15 + 16, 8,
+	                 Z_DEFAULT_STRATEGY) != Z_OK)
+		return false;
+
+	while (ok && flush != Z_FINISH)
+	{
+		ssize_t n = read(in, buffer, size);
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ok = false;
+			break;
+		}
+		flush = n == 0 ? Z_FINISH : Z_NO_FLUSH;
+		zs.next_in = (Bytef*) buffer;
+		zs.avail_in = (uInt) n;
+		do
+		{
+			int rc;
+
+			zs.next_out = (Bytef*) encoded;
+			zs.avail_out = (uInt) size;
+			rc = deflate(&zs, flush);
+			if (rc == Z_STREAM_ERROR ||
+			    !ramd_log_rotate_write_all(out, encoded, size - zs.avail_out))
+			{
+				ok = false;
+				break;
+			}
+		} while (zs.avail_out == 0);
+		if (n > 0)
+			posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+	}
+	deflateEnd(&zs);
+	return ok;
+}
+#endif
+
+/* path -> path.RAMD_LOG_ROTATE_SUFFIX, removing path once the copy is durable */
+static bool
+ramd_log_rotate_compress(const char* path, char* buffer, char* encoded)
+{
+	char target[RAMD_MAX_PATH_LENGTH + 8];
+	char tmp[RAMD_MAX_PATH_LENGTH + 16];
+	struct stat st;
+	bool ok;
+	int in;
+	int out;
+
+	snprintf(target, sizeof(target), "%s%s", path, RAMD_LOG_ROTATE_SUFFIX);
+	snprintf(tmp, sizeof(tmp), "%s%s", target, RAMD_LOG_ROTATE_TMP_SUFFIX);
+
+	in = open(path, O_RDONLY | O_CLOEXEC);
+	if (in < 0)
+		return false;
+	if (fstat(in, &st) != 0)
+	{
+		close(in);
+		return false;
+	}
+	out = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+	if (out < 0)
+	{
+		ramd_log_warning("Log rotation: cannot create %s: %s", tmp, strerror(errno));
+		close(in);
+		return false;
+	}
+
+	ok = ramd_log_rotate_encode(in, out, buffer, encoded, RAMD_LOG_ROTATE_IO_SIZE) &&
+	     fsync(out) == 0;
+	close(in);
+	if (close(out) != 0)
+		ok = false;
+	if (ok && rename(tmp, target) != 0)
+		ok = false;
+	if (!ok)
+	{
+		ramd_log_warning("Log rotation: cannot compress %s: %s", path, strerror(errno));
+		unlink(tmp);
+		return false;
+	}
+	unlink(path);
+	return true;
+}
+
+/* One pass over the directory log_file lives in */
+static void
+ramd_log_rotate_pass(const char* log_file, int32_t keep, bool compress, char* buffer,
+                     char* encoded)
+{
+	char dir_path[RAMD_MAX_PATH_LENGTH];
+	char prefix[RAMD_MAX_PATH_LENGTH];
+	const char* slash = strrchr(log_file, '/');
+	size_t prefix_length;
+	char** names;
+	int32_t count = 0;
+	int32_t capacity = 32;
+	int32_t rotated = 0;
+	DIR* dir;
+	struct dirent* de;
+
+	if (slash)
+	{
+		snprintf(dir_path, sizeof(dir_path), "%.*s", (int) (slash - log_file), log_file);
+		if (dir_path[0] == '\0')
+			strcpy(dir_path, "/");
+	}
+	else
+		strcpy(dir_path, ".");
+	/* log_file.<YYYYmmdd-HHMMSS-mmm>[.gz|.zst] */
+	snprintf(prefix, sizeof(prefix), "%s.", slash ? slash + 1 : log_file);
+	prefix_length = strlen(prefix);
+
+	dir = opendir(dir_path);
+	if (!dir)
+		return;
+	names = ramd_mem_alloc(RAMD_MEM_LOGGING, sizeof(char*) * (size_t) capacity);
+	while (names && (de = readdir(dir)) != NULL)
+	{
+		char path[RAMD_MAX_PATH_LENGTH * 2];
+
+		if (strncmp(de->d_name, prefix, prefix_length) != 0 ||
+		    de->d_name[prefix_length] < '0' || de->d_name[prefix_length] > '9')
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir_path, de->d_name);
+		/* Only this thread writes them, so any left over is from a crash */
+		if (ramd_log_rotate_has_suffix(de->d_name, RAMD_LOG_ROTATE_TMP_SUFFIX))
+		{
+			unlink(path);
+			continue;
+		}
+		if (count == capacity)
+		{
+			char** grown = ramd_mem_realloc(RAMD_MEM_LOGGING, names,
+			                                sizeof(char*) * (size_t) capacity * 2);
+
+			if (!grown)
+				break;
+			names = grown;
+			capacity *= 2;
+		}
+		names[count] = ramd_mem_strdup(RAMD_MEM_LOGGING, path);
+		if (names[count])
+			count++;
+	}
+	closedir(dir);
+	if (!names)
+		return;
+
+	/* The timestamp sorts oldest first; a stem and its compressed copy count once */
+	qsort(names, (size_t) count, sizeof(char*), ramd_log_rotate_name_cmp);
+	for (int32_t i = 0; i < count; i++)
+		if (i == 0 || strncmp(names[i], names[i - 1], strlen(names[i - 1])) != 0)
+			rotated++;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		bool compressed = ramd_log_rotate_has_suffix(names[i], ".gz") ||
+		                  ramd_log_rotate_has_suffix(names[i], ".zst");
+		bool same_stem = i + 1 < count &&
+		                 strncmp(names[i + 1], names[i], strlen(names[i])) == 0;
+
+		if (rotated > keep)
+		{
+			unlink(names[i]);
+			if (!same_stem)
+				rotated--;
+		}
+		else if (!compressed && !same_stem && compress)
+			ramd_log_rotate_compress(names[i], buffer, encoded);
+		else if (!compressed && same_stem)
+			unlink(names[i]);  /* its compressed copy is complete */
+		ramd_mem_free(RAMD_MEM_LOGGING, names[i]);
+	}
+	ramd_mem_free(RAMD_MEM_LOGGING, names);
+}
+
+static void*
+ramd_log_rotate_thread_main(void* arg)
+{
+	const ramd_process_priority_t idle = {19, RAMD_PROCESS_IOPRIO_CLASS_IDLE, 7};
+	char log_file[RAMD_MAX_PATH_LENGTH];
+	char* buffer;
+	char* encoded;
+	int32_t keep;
+	bool compress;
+
+	(void) arg;
+
+	ramd_process_lower_thread_priority(&idle);
+	buffer = ramd_mem_alloc(RAMD_MEM_LOGGING, RAMD_LOG_ROTATE_IO_SIZE * 2);
+	encoded = buffer ? buffer + RAMD_LOG_ROTATE_IO_SIZE : NULL;
+
+	pthread_mutex_lock(&g_log_rotate.lock);
+	for (;;)
+	{
+		while (!g_log_rotate.pending)
+			pthread_cond_wait(&g_log_rotate.cond, &g_log_rotate.lock);
+		g_log_rotate.pending = false;
+		memcpy(log_file, g_log_rotate.log_file, sizeof(log_file));
+		keep = g_log_rotate.keep;
+		compress = g_log_rotate.compress && buffer;
+		pthread_mutex_unlock(&g_log_rotate.lock);
+
+		ramd_log_rotate_pass(log_file, keep, compress, buffer, encoded);
+
+		pthread_mutex_lock(&g_log_rotate.lock);
+	}
+	return NULL;
+}
+
+void
+ramd_log_rotate_request(const char* log_file, int32_t keep, bool compress)
+{
+	pthread_t thread;
+
+	if (!log_file || !log_file[0])
+		return;
+
+	pthread_mutex_lock(&g_log_rotate.lock);
+	snprintf(g_log_rotate.log_file, sizeof(g_log_rotate.log_file), "%s", log_file);
+	g_log_rotate.keep = keep;
+	g_log_rotate.compress = compress;
+	g_log_rotate.pending = true;
+	if (!g_log_rotate.started)
+	{
+		if (pthread_create(&thread, NULL, ramd_log_rotate_thread_main, NULL) == 0)
+		{
+			pthread_detach(thread);
+			g_log_rotate.started = true;
+		}
+	}
+	pthread_cond_signal(&g_log_rotate.cond);
+	pthread_mutex_unlock(&g_log_rotate.lock);
+}
+
+void
+ramd_log_rotate_atfork_prepare(void)
+{
+	pthread_mutex_lock(&g_log_rotate.lock);
+}
+
+void
+ramd_log_rotate_atfork_parent(void)
+{
+	pthread_mutex_unlock(&g_log_rotate.lock);
+}
+
+/* The thread does not survive fork(); a child that rotates starts its own */
+void
+ramd_log_rotate_atfork_child(void)
+{
+	g_log_rotate.started = false;
+	g_log_rotate.pending = false;
+	pthread_mutex_unlock(&g_log_rotate.lock);
+}
@@ -0,0 +1,398 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_log_store.c
+ *		PostgreSQL Auto-Failover Daemon - In-Memory Log Store
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The newest RAMD_LOG_STORE_RECORDS lines, kept by the log writer for
+ * GET /api/v1/logs so operators can filter recent logs without reading
+ * files on the host.  Records sit in a ring addressed by cursor, and the
+ * ring is cut into buckets of RAMD_LOG_STORE_BUCKET records that each
+ * summarise which levels and components they hold: a filtered query only
+ * reads the buckets that can match.  Timestamps never go backwards along
+ * the ring, so since is a binary search.
+ *
+ * A bucket is emptied as a whole when the ring comes round to it, so its
+ * summary always describes what it holds.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+
+#include "ramd_log_store.h"
+#include "ramd_memory.h"
+
+#define RAMD_LOG_STORE_BUCKETS (RAMD_LOG_STORE_RECORDS / RAMD_LOG_STORE_BUCKET)
+#define RAMD_LOG_STORE_OTHER   (RAMD_LOG_STORE_COMPONENTS - 1) /* once the table is full */
+
+_Static_assert((RAMD_LOG_STORE_RECORDS & (RAMD_LOG_STORE_RECORDS - 1)) == 0,
+               "RAMD_LOG_STORE_RECORDS must be a power of two");
+_Static_assert(RAMD_LOG_STORE_RECORDS % RAMD_LOG_STORE_BUCKET == 0,
+               "RAMD_LOG_STORE_BUCKET must divide RAMD_LOG_STORE_RECORDS");
+_Static_assert(RAMD_LOG_STORE_COMPONENTS <= 64, "component masks are 64 bits");
+
+typedef struct ramd_log_entry_t
+{
+	uint64_t cursor; /* 0 while never written */
+	int64_t ts_us;
+	uint16_t length;
+	uint8_t level;
+	uint8_t component;
+	char message[RAMD_LOG_STORE_MESSAGE_MAX];
+} ramd_log_entry_t;
+
+typedef struct ramd_log_bucket_t
+{
+	uint32_t levels;     /* bit per ramd_log_level_t present */
+	uint64_t components; /* bit per component id present */
+} ramd_log_bucket_t;
+
+typedef struct ramd_log_store_t
+{
+	pthread_mutex_t lock;
+	uint64_t newest;
+	int64_t last_ts_us;
+	uint64_t counts[RAMD_LOG_LEVEL_FATAL + 1];
+	int32_t component_count;
+	char components[RAMD_LOG_STORE_COMPONENTS][RAMD_LOG_COMPONENT_MAX];
+	void (*listener)(void* arg);
+	void* listener_arg;
+	bool accounted;
+	ramd_log_bucket_t buckets[RAMD_LOG_STORE_BUCKETS];
+	ramd_log_entry_t entries[RAMD_LOG_STORE_RECORDS];
+} ramd_log_store_t;
+
+static ramd_log_store_t g_log_store = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.components = { [RAMD_LOG_STORE_OTHER] = "other" },
+};
+
+static inline uint32_t
+ramd_log_store_index(uint64_t cursor)
+{
+	return (uint32_t) ((cursor - 1) & (RAMD_LOG_STORE_RECORDS - 1));
+}
+
+/* Oldest cursor still held; the bucket being refilled has lost its old records */
+static uint64_t
+ramd_log_store_oldest(void)
+{
+	uint64_t newest = g_log_store.newest;
+	uint64_t bucket_start;
+
+	if (newest == 0)
+		return 0;
+	bucket_start = newest - ramd_log_store_index(newest) % RAMD_LOG_STORE_BUCKET;
+	if (bucket_start <= RAMD_LOG_STORE_RECORDS - RAMD_LOG_STORE_BUCKET)
+		return 1;
+	return bucket_start - (RAMD_LOG_STORE_RECORDS - RAMD_LOG_STORE_BUCKET);
+}
+
+/* Component id of name, interned on first sight; -1 if unknown and !add */
+static int32_t
+ramd_log_store_component_id(const char* name, size_t length, bool add)
+{
+	int32_t i;
+
+	if (length >= RAMD_LOG_COMPONENT_MAX)
+		length = RAMD_LOG_COMPONENT_MAX - 1;
+	for (i = 0; i < g_log_store.component_count; i++)
+	{
+		if (strncmp(g_log_store.components[i], name, length) == 0 &&
+		    g_log_store.components[i][length] == '\0')
+			return i;
+	}
+	if (strncmp(g_log_store.components[RAMD_LOG_STORE_OTHER], name, length) == 0 &&
+	    g_log_store.components[RAMD_LOG_STORE_OTHER][length] == '\0')
+		return RAMD_LOG_STORE_OTHER;
+	if (!add)
+		return -1;
+	if (g_log_store.component_count >= RAMD_LOG_STORE_OTHER)
+		return RAMD_LOG_STORE_OTHER;
+
+	memcpy(g_log_store.components[i], name, length);
+	g_log_store.components[i][length] = '\0';
+	g_log_store.component_count++;
+	return i;
+}
+
+void
+ramd_log_store_append(ramd_log_level_t level, int64_t ts_us, const char* component,
+                      size_t component_length, const char* message, size_t length)
+{
+	ramd_log_entry_t* entry;
+	ramd_log_bucket_t* bucket;
+	uint64_t cursor;
+	uint32_t index;
+	int32_t component_id;
+
+	if (level < RAMD_LOG_LEVEL_DEBUG || level > RAMD_LOG_LEVEL_FATAL)
+		level = RAMD_LOG_LEVEL_INFO;
+
+	/* Cut on a character boundary so the API never serves half a UTF-8 sequence */
+	if (length >= RAMD_LOG_STORE_MESSAGE_MAX)
+	{
+		length = RAMD_LOG_STORE_MESSAGE_MAX - 1;
+		while (length > 0 && ((unsigned char) message[length] & 0xC0) == 0x80)
+			length--;
+	}
+
+	pthread_mutex_lock(&g_log_store.lock);
+	if (!g_log_store.accounted)
+	{
+		ramd_mem_account(RAMD_MEM_LOGGING, (int64_t) sizeof(g_log_store.entries));
+		g_log_store.accounted = true;
+	}
+
+	cursor = ++g_log_store.newest;
+	index = ramd_log_store_index(cursor);
+	bucket = &g_log_store.buckets[index / RAMD_LOG_STORE_BUCKET];
+
+	if (index % RAMD_LOG_STORE_BUCKET == 0)
+	{
+		for (uint32_t i = index; i < index + RAMD_LOG_STORE_BUCKET; i++)
+		{
+			if (g_log_store.entries[i].cursor != 0)
+				g_log_store.counts[g_log_store.entries[i].level]--;
+			g_log_store.entries[i].cursor = 0;
+		}
+		memset(bucket, 0, sizeof(*bucket));
+	}
+
+	/* Lines from racing threads may be a microsecond out of order */
+	if (ts_us < g_log_store.last_ts_us)
+		ts_us = g_log_store.last_ts_us;
+	g_log_store.last_ts_us = ts_us;
+
+	component_id = ramd_log_store_component_id(component ? component : "",
+	                                           component ? component_length : 0, true);
+
+	entry = &g_log_store.entries[index];
+	entry->cursor = cursor;
+	entry->ts_us = ts_us;
+	entry->level = (uint8_t) level;
+	entry->component = (uint8_t) component_id;
+	entry->length = (uint16_t) length;
+	memcpy(entry->message, message, length);
+	entry->message[length] = '\0';
+
+	bucket->levels |= 1u << level;
+	bucket->components |= 1ull << component_id;
+	g_log_store.counts[level]++;
+	pthread_mutex_unlock(&g_log_store.lock);
+}
+
+void
+ramd_log_store_notify(void)
+{
+	pthread_mutex_lock(&g_log_store.lock);
+	if (g_log_store.listener)
+		g_log_store.listener(g_log_store.listener_arg);
+	pthread_mutex_unlock(&g_log_store.lock);
+}
+
+void
+ramd_log_store_set_listener(void (*listener)(void* arg), void* arg)
+{
+	pthread_mutex_lock(&g_log_store.lock);
+	g_log_store.listener = listener;
+	g_log_store.listener_arg = arg;
+	pthread_mutex_unlock(&g_log_store.lock);
+}
+
+/* First cursor in [first, last] logged at or after since_us, last + 1 if none */
+static uint64_t
+ramd_log_store_seek_time(uint64_t first, uint64_t last, int64_t since_us)
+{
+	while (first <= last)
+	{
+		uint64_t middle = first + (last - first) / 2;
+
+		if (g_log_store.entries[ramd_log_store_index(middle)].ts_us < since_us)
+			first = middle + 1;
+		else if (middle == first)
+			return first;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+/* A query's filters resolved against the store; call with the lock held */
+typedef struct ramd_log_filter_t
+{
+	uint32_t level_mask;
+	uint64_t component_mask; /* 0 for any component */
+	int32_t component_id;
+	uint64_t first;          /* first cursor that may match */
+	bool gap;
+} ramd_log_filter_t;
+
+static void
+ramd_log_store_filter(const ramd_log_query_t* query, uint64_t newest, uint64_t oldest,
+                      ramd_log_filter_t* filter)
+{
+	filter->level_mask = ~((1u << query->min_level) - 1);
+	filter->component_mask = 0;
+	filter->component_id = -1;
+
+	/* A cursor past newest is from before a restart: start over */
+	if (query->after > newest)
+	{
+		filter->first = 1;
+		filter->gap = true;
+	}
+	else
+	{
+		filter->first = query->after + 1;
+		filter->gap = query->after > 0 && filter->first < oldest;
+	}
+	if (filter->first < oldest)
+		filter->first = oldest;
+	if (query->since_us > 0 && filter->first <= newest)
+		filter->first = ramd_log_store_seek_time(filter->first, newest, query->since_us);
+
+	if (query->component && query->component[0] != '\0')
+	{
+		filter->component_id = ramd_log_store_component_id(query->component,
+		                                                   strlen(query->component), false);
+		if (filter->component_id < 0)
+			filter->first = newest + 1; /* never logged: nothing can match */
+		else
+			filter->component_mask = 1ull << filter->component_id;
+	}
+}
+
+/* The bucket holding cursor cannot contain a match */
+static inline bool
+ramd_log_store_bucket_skips(const ramd_log_filter_t* filter, uint32_t index)
+{
+	const ramd_log_bucket_t* bucket = &g_log_store.buckets[index / RAMD_LOG_STORE_BUCKET];
+
+	return !(bucket->levels & filter->level_mask) ||
+	       (filter->component_mask && !(bucket->components & filter->component_mask));
+}
+
+static inline bool
+ramd_log_store_matches(const ramd_log_filter_t* filter, const ramd_log_entry_t* entry)
+{
+	return (filter->level_mask & (1u << entry->level)) &&
+	       (filter->component_id < 0 || entry->component == filter->component_id);
+}
+
+int32_t
+ramd_log_store_query(const ramd_log_query_t* query, ramd_log_record_t* out, int32_t max,
+                     ramd_log_page_t* page)
+{
+	ramd_log_filter_t filter;
+	uint64_t newest;
+	uint64_t cursor;
+	int32_t limit;
+	int32_t count = 0;
+
+	if (!query || !page || (max > 0 && !out))
+		return 0;
+
+	limit = query->limit < max ? query->limit : max;
+	memset(page, 0, sizeof(*page));
+
+	pthread_mutex_lock(&g_log_store.lock);
+	newest = g_log_store.newest;
+	page->newest_cursor = newest;
+	page->oldest_cursor = ramd_log_store_oldest();
+	page->next_cursor = newest;
+	ramd_log_store_filter(query, newest, page->oldest_cursor, &filter);
+	page->gap = filter.gap;
+
+	for (cursor = filter.first; cursor <= newest;)
+	{
+		uint32_t index = ramd_log_store_index(cursor);
+		const ramd_log_entry_t* entry = &g_log_store.entries[index];
+		ramd_log_record_t* record;
+
+		if (ramd_log_store_bucket_skips(&filter, index))
+		{
+			cursor += RAMD_LOG_STORE_BUCKET - index % RAMD_LOG_STORE_BUCKET;
+			continue;
+		}
+		if (ramd_log_store_matches(&filter, entry))
+		{
+			if (count >= limit)
+			{
+				page->more = true;
+				page->next_cursor = cursor - 1;
+				break;
+			}
+			record = &out[count++];
+			record->cursor = entry->cursor;
+			record->ts_us = entry->ts_us;
+			record->level = (ramd_log_level_t) entry->level;
+			memcpy(record->component, g_log_store.components[entry->component],
+			       RAMD_LOG_COMPONENT_MAX);
+			memcpy(record->message, entry->message, (size_t) entry->length + 1);
+		}
+		cursor++;
+	}
+	pthread_mutex_unlock(&g_log_store.lock);
+	return count;
+}
+
+uint64_t
+ramd_log_store_seek_tail(const ramd_log_query_t* query, int32_t count)
+{
+	ramd_log_filter_t filter;
+	uint64_t newest;
+	uint64_t cursor;
+	int32_t found = 0;
+
+	if (!query)
+		return 0;
+
+	pthread_mutex_lock(&g_log_store.lock);
+	newest = g_log_store.newest;
+	ramd_log_store_filter(query, newest, ramd_log_store_oldest(), &filter);
+
+	for (cursor = newest; cursor >= filter.first && found < count;)
+	{
+		uint32_t index = ramd_log_store_index(cursor);
+
+		if (ramd_log_store_bucket_skips(&filter, index))
+		{
+			/* Step to the last record of the bucket before */
+			if (cursor <= index % RAMD_LOG_STORE_BUCKET + 1)
+				break;
+			cursor -= index % RAMD_LOG_STORE_BUCKET + 1;
+			continue;
+		}
+		if (ramd_log_store_matches(&filter, &g_log_store.entries[index]))
+			found++;
+		cursor--;
+	}
+	pthread_mutex_unlock(&g_log_store.lock);
+
+	/* Past the last record examined, or from where the filter starts */
+	if (found < count)
+		return filter.first > 0 ? filter.first - 1 : 0;
+	return cursor;
+}
+
+uint64_t
+ramd_log_store_newest(void)
+{
+	uint64_t newest;
+
+	pthread_mutex_lock(&g_log_store.lock);
+	newest = g_log_store.newest;
+	pthread_mutex_unlock(&g_log_store.lock);
+	return newest;
+}
+
+void
+ramd_log_store_counts(uint64_t counts[RAMD_LOG_LEVEL_FATAL + 1])
+{
+	pthread_mutex_lock(&g_log_store.lock);
+	memcpy(counts, g_log_store.counts, sizeof(g_log_store.counts));
+	pthread_mutex_unlock(&g_log_store.lock);
+}
@@ -8,26 +8,485 @@
  *-------------------------------------------------------------------------
  */
 
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <syslog.h>
 #include <pwd.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "ramd_logging.h"
+#include "ramd_log_rotate.h"
+#include "ramd_log_store.h"
+#include "ramd_memory.h"
 
 ramd_logging_config_t g_ramd_logging = {0};
 
+/*
+ * Lines are formatted by the caller into a bounded multi-producer ring
+ * and written by a single writer thread, so monitor and HTTP threads never
+ * wait on disk, the console or syslog.  Producers claim a slot with a CAS
+ * on head; each slot's sequence number says whether it is free (== pos),
+ * published (== pos + 1) or still owned by the writer.  A full ring drops
+ * the line rather than blocking, and the writer reports how many it lost.
+ * The writer also files every line in the log store (ramd_log_store.h),
+ * which is why a slot carries the bare message and its component.
+ */
+typedef struct ramd_log_slot
+{
+	_Atomic uint64_t   seq;
+	ramd_log_level_t   level;
+	uint32_t           length;
+	uint32_t           message_offset;	/* start of the bare message, for syslog */
+	char               line[RAMD_LOG_LINE_MAX];
+	int64_t            ts_us;
+	const char*        component;		/* points into the caller's __FILE__ */
+	uint32_t           component_length;
+	uint32_t           message_length;
+	char               message[RAMD_LOG_STORE_MESSAGE_MAX];
+} ramd_log_slot_t;
+
+static ramd_log_slot_t g_log_ring[RAMD_LOG_RING_SLOTS];
+static _Atomic uint64_t g_log_head = 0;
+static _Atomic uint64_t g_log_tail = 0;
+static _Atomic uint64_t g_log_dropped = 0;
+static bool g_log_ring_ready = false;
+
+static pthread_mutex_t g_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_log_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t g_log_drained = PTHREAD_COND_INITIALIZER;
+static pthread_t g_log_writer;
+static atomic_bool g_log_writer_running = false;
+static bool g_log_writer_stop = false;
+static bool g_log_writer_failed = false;
+static bool g_log_atfork_registered = false;
+
+/*
+ * Rotation is the writer's job too, between drains, so no producer ever
+ * waits for it: the file is renamed to log_file.<timestamp>, a new one
+ * opened and the old stream closed, and lines logged meanwhile simply
+ * wait in the ring.  If the new file cannot be opened the writer carries
+ * on with the renamed one and tries again later.  Compression and
+ * deleting old files are left to ramd_log_rotate.c.  Settings are copied
+ * under g_log_mutex; the rest belongs to the writer, or to whoever writes
+ * through while there is none.
+ */
+typedef struct ramd_log_rotation
+{
+	int64_t size_bytes;   /* 0: no size limit */
+	int64_t age_s;        /* 0: no time limit */
+	int32_t keep;
+	bool compress;
+	bool changed;         /* settings moved; recompute the next boundary */
+} ramd_log_rotation_t;
+
+static ramd_log_rotation_t g_log_rotation = {
+	.size_bytes = (int64_t) RAMD_LOG_ROTATION_SIZE_MB * 1024 * 1024,
+	.age_s = (int64_t) RAMD_LOG_ROTATION_AGE_MIN * 60,
+	.keep = RAMD_LOG_ROTATION_COUNT,
+	.compress = true
+};
+static int64_t g_log_file_bytes = 0;
+static time_t g_log_file_mtime = 0;  /* when the open file was last written before us */
+static time_t g_log_rotate_at = 0;   /* next time boundary, 0 to recompute */
+static time_t g_log_checked_at = 0;  /* last look for an outside rename */
+static time_t g_log_retry_at = 0;    /* after a rotation that failed */
+
+/* Per-thread timestamp, re-rendered at most once per second */
+static _Thread_local time_t t_log_second = (time_t) -1;
+static _Thread_local char t_log_timestamp[RAMD_MAX_TIMESTAMP_LENGTH];
+
+static void ramd_logging_start_writer(void);
+
+static int64_t
+ramd_logging_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static int
+ramd_logging_syslog_priority(ramd_log_level_t level)
+{
+	switch (level)
+	{
+		case RAMD_LOG_LEVEL_DEBUG:
+			return LOG_DEBUG;
+		case RAMD_LOG_LEVEL_INFO:
+			return LOG_INFO;
+		case RAMD_LOG_LEVEL_NOTICE:
+			return LOG_NOTICE;
+		case RAMD_LOG_LEVEL_WARNING:
+			return LOG_WARNING;
+		case RAMD_LOG_LEVEL_ERROR:
+			return LOG_ERR;
+		case RAMD_LOG_LEVEL_FATAL:
+			return LOG_CRIT;
+		default:
+			return LOG_INFO;
+	}
+}
+
+/* Write one line to every sink; stdio flushing is left to the caller */
+static void
+ramd_logging_emit(ramd_log_level_t level, const char* line, size_t length,
+                  size_t message_offset)
+{
+	if (g_ramd_logging.log_to_console)
+	{
+		FILE* output = (level >= RAMD_LOG_LEVEL_WARNING) ? stderr : stdout;
+
+		fwrite(line, 1, length, output);
+		fputc('\n', output);
+	}
+
+	if (g_ramd_logging.log_to_file && g_ramd_logging.log_fp)
+	{
+		fwrite(line, 1, length, g_ramd_logging.log_fp);
+		fputc('\n', g_ramd_logging.log_fp);
+		g_log_file_bytes += (int64_t) length + 1;
+	}
+
+	if (g_ramd_logging.log_to_syslog)
+		syslog(ramd_logging_syslog_priority(level), "%s", line + message_offset);
+}
+
+static void
+ramd_logging_flush_streams(void)
+{
+	if (g_ramd_logging.log_to_console)
+	{
+		fflush(stdout);
+		fflush(stderr);
+	}
+	if (g_ramd_logging.log_fp)
+		fflush(g_ramd_logging.log_fp);
+}
+
+/* Claim a free slot, or NULL if the ring is full */
+static ramd_log_slot_t*
+ramd_logging_claim(uint64_t* pos_out)
+{
+	uint64_t         pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+	ramd_log_slot_t* slot;
+	int64_t          diff;
+
+	for (;;)
+	{
+		slot = &g_log_ring[pos & (RAMD_LOG_RING_SLOTS - 1)];
+		diff = (int64_t) (atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+		if (diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&g_log_head, &pos, pos + 1,
+			                                          memory_order_relaxed,
+			                                          memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return NULL;
+		else
+			pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+	}
+
+	*pos_out = pos;
+	return slot;
+}
+
+/* Write out everything published so far; only the writer thread calls this */
+static void
+ramd_logging_drain(void)
+{
+	uint64_t         tail = atomic_load_explicit(&g_log_tail, memory_order_relaxed);
+	uint64_t         dropped;
+	ramd_log_slot_t* slot;
+	bool             wrote = false;
+
+	for (;;)
+	{
+		slot = &g_log_ring[tail & (RAMD_LOG_RING_SLOTS - 1)];
+		if (atomic_load_explicit(&slot->seq, memory_order_acquire) != tail + 1)
+			break;
+
+		ramd_logging_emit(slot->level, slot->line, slot->length, slot->message_offset);
+		ramd_log_store_append(slot->level, slot->ts_us, slot->component,
+		                      slot->component_length, slot->message, slot->message_length);
+		atomic_store_explicit(&slot->seq, tail + RAMD_LOG_RING_SLOTS, memory_order_release);
+		tail++;
+		atomic_store_explicit(&g_log_tail, tail, memory_order_release);
+		wrote = true;
+	}
+
+	dropped = atomic_exchange_explicit(&g_log_dropped, 0, memory_order_relaxed);
+	if (dropped > 0)
+	{
+		char notice[128];
+		int  len = snprintf(notice, sizeof(notice),
+		                    "ramd: log ring full, %llu lines dropped",
+		                    (unsigned long long) dropped);
+
+		ramd_logging_emit(RAMD_LOG_LEVEL_WARNING, notice, (size_t) len, 0);
+		ramd_log_store_append(RAMD_LOG_LEVEL_WARNING, ramd_logging_now_us(), "logging", 7,
+		                      notice, (size_t) len);
+		wrote = true;
+	}
+
+	if (wrote)
+	{
+		ramd_logging_flush_streams();
+		ramd_log_store_notify();
+	}
+}
+
+static bool
+ramd_logging_ring_pending(void)
+{
+	uint64_t tail = atomic_load_explicit(&g_log_tail, memory_order_relaxed);
+
+	return atomic_load_explicit(&g_log_ring[tail & (RAMD_LOG_RING_SLOTS - 1)].seq,
+	                            memory_order_acquire) == tail + 1;
+}
+
+/* Size and age of the file just opened, and so when it is due */
+static void
+ramd_logging_note_open(FILE* fp)
+{
+	struct stat st;
+
+	g_log_file_bytes = 0;
+	g_log_file_mtime = 0;
+	if (fp && fstat(fileno(fp), &st) == 0 && st.st_size > 0)
+	{
+		g_log_file_bytes = (int64_t) st.st_size;
+		g_log_file_mtime = st.st_mtime;
+	}
+	g_log_rotate_at = 0;
+}
+
+/*
+ * Rename the file aside and switch to a fresh one.  Only the writer calls
+ * this, with everything drained so far already flushed to the old stream.
+ */
+static void
+ramd_logging_rotate(const ramd_log_rotation_t* rotation, time_t now)
+{
+	char       rotated[RAMD_MAX_PATH_LENGTH + 32];
+	struct tm  tm_info;
+	struct timespec ts;
+	FILE*      fp;
+	size_t     len;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	gmtime_r(&ts.tv_sec, &tm_info);
+	len = (size_t) snprintf(rotated, sizeof(rotated), "%s.", g_ramd_logging.log_file);
+	len += strftime(rotated + len, sizeof(rotated) - len, "%Y%m%d-%H%M%S", &tm_info);
+	snprintf(rotated + len, sizeof(rotated) - len, "-%03ld", ts.tv_nsec / 1000000L);
+
+	/* rename() replaces the path atomically; the open stream follows the file */
+	if (access(rotated, F_OK) == 0 || rename(g_ramd_logging.log_file, rotated) != 0)
+	{
+		g_log_retry_at = now + RAMD_LOG_ROTATION_RETRY_S;
+		ramd_log_warning("Log rotation: cannot rename %s: %s", g_ramd_logging.log_file,
+		                 strerror(errno));
+		return;
+	}
+	fp = fopen(g_ramd_logging.log_file, "a");
+	if (!fp)
+	{
+		/* Keep writing to the renamed file rather than lose lines */
+		g_log_retry_at = now + RAMD_LOG_ROTATION_RETRY_S;
+		ramd_log_warning("Log rotation: cannot open %s, still writing to %s: %s",
+		                 g_ramd_logging.log_file, rotated, strerror(errno));
+		return;
+	}
+
+	fclose(g_ramd_logging.log_fp);
+	g_ramd_logging.log_fp = fp;
+	ramd_logging_note_open(fp);
+	ramd_log_rotate_request(g_ramd_logging.log_file, rotation->keep, rotation->compress);
+}
+
+/*
+ * Rotate once the file has reached its size or crossed a multiple of the
+ * age since the epoch, so every node cuts its log at the same moments.
+ * A file moved away by another tool (logrotate without copytruncate) is
+ * noticed within a second and reopened under its configured name.
+ */
+static void
+ramd_logging_check_rotation(ramd_log_rotation_t* rotation)
+{
+	time_t      now;
+	struct stat path_st;
+	struct stat fp_st;
+
+	if (!g_ramd_logging.log_fp || g_ramd_logging.log_file[0] == '\0')
+		return;
+
+	now = time(NULL);
+	if (rotation->changed || g_log_rotate_at == 0)
+	{
+		time_t base = g_log_file_bytes > 0 && g_log_file_mtime > 0 ? g_log_file_mtime : now;
+
+		g_log_rotate_at = rotation->age_s > 0
+			? (time_t) (base / rotation->age_s * rotation->age_s + rotation->age_s)
+			: (time_t) -1;
+		rotation->changed = false;
+	}
+
+	if (now >= g_log_retry_at &&
+	    ((rotation->size_bytes > 0 && g_log_file_bytes >= rotation->size_bytes) ||
+	     (g_log_rotate_at != (time_t) -1 && now >= g_log_rotate_at && g_log_file_bytes > 0)))
+	{
+		ramd_logging_rotate(rotation, now);
+		return;
+	}
+
+	if (now == g_log_checked_at)
+		return;
+	g_log_checked_at = now;
+	if (fstat(fileno(g_ramd_logging.log_fp), &fp_st) == 0 &&
+	    (stat(g_ramd_logging.log_file, &path_st) != 0 ||
+	     path_st.st_ino != fp_st.st_ino || path_st.st_dev != fp_st.st_dev))
+	{
+		FILE* fp = fopen(g_ramd_logging.log_file, "a");
+
+		if (fp)
+		{
+			fclose(g_ramd_logging.log_fp);
+			g_ramd_logging.log_fp = fp;
+			ramd_logging_note_open(fp);
+		}
+	}
+}
+
+static void*
+ramd_logging_writer_thread(void* arg)
+{
+	struct timespec deadline;
+	bool            stopping;
+	ramd_log_rotation_t rotation = {0};
+
+	(void) arg;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&g_log_mutex);
+		if (!g_log_writer_stop && !ramd_logging_ring_pending())
+		{
+			/* Sleep out the flush interval unless a severe line wakes us */
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long) RAMD_LOG_FLUSH_INTERVAL_MS * 1000000L;
+			while (deadline.tv_nsec >= 1000000000L)
+			{
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&g_log_wakeup, &g_log_mutex, &deadline);
+		}
+		stopping = g_log_writer_stop;
+		if (g_log_rotation.changed || rotation.keep == 0)
+		{
+			rotation = g_log_rotation;
+			rotation.changed = true;
+			g_log_rotation.changed = false;
+		}
+		pthread_mutex_unlock(&g_log_mutex);
+
+		/* Before draining, so a file that is due gets none of the new lines */
+		if (!stopping)
+			ramd_logging_check_rotation(&rotation);
+		ramd_logging_drain();
+
+		pthread_mutex_lock(&g_log_mutex);
+		pthread_cond_broadcast(&g_log_drained);
+		pthread_mutex_unlock(&g_log_mutex);
+
+		if (stopping && !ramd_logging_ring_pending())
+			break;
+	}
+	return NULL;
+}
+
+/* Drain before fork() so the child does not inherit and repeat our lines */
+static void
+ramd_logging_atfork_prepare(void)
+{
+	ramd_logging_flush();
+	pthread_mutex_lock(&g_log_mutex);
+	ramd_log_rotate_atfork_prepare();
+}
+
+static void
+ramd_logging_atfork_parent(void)
+{
+	ramd_log_rotate_atfork_parent();
+	pthread_mutex_unlock(&g_log_mutex);
+}
+
+/* The writer does not survive fork(); the child restarts it on first use */
+static void
+ramd_logging_atfork_child(void)
+{
+	atomic_store(&g_log_writer_running, false);
+	g_log_writer_stop = false;
+	g_ramd_logging.pid = getpid();
+	ramd_log_rotate_atfork_child();
+	pthread_mutex_unlock(&g_log_mutex);
+}
+
+static void
+ramd_logging_start_writer(void)
+{
+	pthread_mutex_lock(&g_log_mutex);
+	if (!atomic_load(&g_log_writer_running) && !g_log_writer_failed)
+	{
+		g_log_writer_stop = false;
+		if (pthread_create(&g_log_writer, NULL, ramd_logging_writer_thread, NULL) == 0)
+			atomic_store(&g_log_writer_running, true);
+		else
+			g_log_writer_failed = true;	/* log synchronously from now on */
+	}
+	pthread_mutex_unlock(&g_log_mutex);
+}
+
+static void
+ramd_logging_stop_writer(void)
+{
+	if (!atomic_load(&g_log_writer_running))
+		return;
+
+	pthread_mutex_lock(&g_log_mutex);
+	g_log_writer_stop = true;
+	pthread_cond_signal(&g_log_wakeup);
+	pthread_mutex_unlock(&g_log_mutex);
+
+	pthread_join(g_log_writer, NULL);
+	atomic_store(&g_log_writer_running, false);
+}
+
 bool
 ramd_logging_init(const char* log_file, ramd_log_level_t min_level,
                  bool log_to_file, bool log_to_syslog,
                  bool log_to_console)
 {
+	struct passwd* pw;
+	uint64_t       i;
+
+	/* Re-initialization (config reload) writes out the old sinks first */
+	ramd_logging_cleanup();
 	memset(&g_ramd_logging, 0, sizeof(g_ramd_logging));
 
 	g_ramd_logging.min_level = min_level;
 	g_ramd_logging.log_to_file = log_to_file;
 	g_ramd_logging.log_to_syslog = log_to_syslog;
 	g_ramd_logging.log_to_console = log_to_console;
+	g_ramd_logging.pid = getpid();
+
+	pw = getpwuid(getuid());
+	strncpy(g_ramd_logging.username, pw ? pw->pw_name : "unknown",
+	        sizeof(g_ramd_logging.username) - 1);
 
 	if (log_to_file && log_file && strlen(log_file) > 0)
 	{
@@ -42,12 +501,28 @@ ramd_logging_init(const char* log_file, ramd_log_level_t min_level,
 			        log_file);
 			return false;
 		}
+		ramd_logging_note_open(g_ramd_logging.log_fp);
 	}
 
 	if (log_to_syslog)
 		openlog("ramd", LOG_PID | LOG_NDELAY, LOG_DAEMON);
 
+	if (!g_log_ring_ready)
+	{
+		for (i = 0; i < RAMD_LOG_RING_SLOTS; i++)
+			atomic_init(&g_log_ring[i].seq, i);
+		ramd_mem_account(RAMD_MEM_LOGGING, (int64_t) sizeof(g_log_ring));
+		g_log_ring_ready = true;
+	}
+	if (!g_log_atfork_registered)
+	{
+		pthread_atfork(ramd_logging_atfork_prepare, ramd_logging_atfork_parent,
+		               ramd_logging_atfork_child);
+		g_log_atfork_registered = true;
+	}
+
 	g_ramd_logging.initialized = true;
+	ramd_logging_start_writer();
 	return true;
 }
 
@@ -57,6 +532,9 @@ ramd_logging_cleanup(void)
 	if (!g_ramd_logging.initialized)
 		return;
 
+	ramd_logging_stop_writer();
+	ramd_logging_flush_streams();
+
 	if (g_ramd_logging.log_fp)
 	{
 		fclose(g_ramd_logging.log_fp);
@@ -70,98 +548,335 @@ ramd_logging_cleanup(void)
 }
 
 void
-ramd_log(ramd_log_level_t level, const char* file, int line,
-         const char* function, const char* format, ...)
+ramd_logging_flush(void)
 {
-	va_list      args;
-	char         timestamp[RAMD_MAX_TIMESTAMP_LENGTH];
-	char         message[RAMD_MAX_LOG_MESSAGE];
-	char         full_message[RAMD_MAX_LOG_MESSAGE + RAMD_MAX_USERNAME_LENGTH];
-	char         username[RAMD_MAX_USERNAME_LENGTH];
-	struct passwd *pw;
-	time_t       now;
-	struct tm*   tm_info;
-	pid_t        pid;
+	uint64_t target;
 
-	if (!g_ramd_logging.initialized || level < g_ramd_logging.min_level)
+	if (!atomic_load(&g_log_writer_running))
 		return;
 
-	va_start(args, format);
-	vsnprintf(message, sizeof(message), format, args);
-	va_end(args);
-
-	time(&now);
-	tm_info = localtime(&now);
-	strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", tm_info);
+	target = atomic_load(&g_log_head);
+	pthread_mutex_lock(&g_log_mutex);
+	pthread_cond_signal(&g_log_wakeup);
+	while (atomic_load(&g_log_tail) < target && atomic_load(&g_log_writer_running))
+		pthread_cond_wait(&g_log_drained, &g_log_mutex);
+	pthread_mutex_unlock(&g_log_mutex);
+}
 
-	pid = getpid();
+static const char*
+ramd_logging_timestamp(void)
+{
+	time_t    now = time(NULL);
+	struct tm tm_info;
 
-	pw = getpwuid(getuid());
-	if (pw != NULL)
+	if (now != t_log_second)
 	{
-		strncpy(username, pw->pw_name, sizeof(username) - 1);
-		username[sizeof(username) - 1] = '\0';
+		localtime_r(&now, &tm_info);
+		strftime(t_log_timestamp, sizeof(t_log_timestamp), "%Y-%m-%d %H:%M:%S", &tm_info);
+		t_log_second = now;
 	}
-	else
-		strncpy(username, "unknown", sizeof(username) - 1);
+	return t_log_timestamp;
+}
 
-	if (file && strlen(file) > 0 && line > 0)
-	{
-		snprintf(full_message, sizeof(full_message),
-		         "✓ - %d  %s %s ramd: %s:%d %s(): %s",
-		         (int)pid, username, timestamp, file, line, function, message);
-	}
-	else
-	{
-		snprintf(full_message, sizeof(full_message),
-		         "✓ - %d  %s %s ramd: %s",
-		         (int)pid, username, timestamp, message);
-	}
+/* Bounded line builder; len never exceeds cap and data stays terminated */
+typedef struct ramd_log_line
+{
+	char*  data;
+	size_t len;
+	size_t cap;
+} ramd_log_line_t;
 
-	if (g_ramd_logging.log_to_console)
-	{
-		FILE* output = (level >= RAMD_LOG_LEVEL_WARNING) ? stderr : stdout;
-		fprintf(output, "%s\n", full_message);
-		fflush(output);
-	}
+static void
+ramd_log_line_vputf(ramd_log_line_t* out, const char* format, va_list args)
+{
+	int n;
 
-	if (g_ramd_logging.log_to_file && g_ramd_logging.log_fp)
-	{
-		fprintf(g_ramd_logging.log_fp, "%s\n", full_message);
-		fflush(g_ramd_logging.log_fp);
-	}
+	if (out->len >= out->cap)
+		return;
+	n = vsnprintf(out->data + out->len, out->cap - out->len + 1, format, args);
+	if (n > 0)
+		out->len = (out->len + (size_t) n > out->cap) ? out->cap : out->len + (size_t) n;
+}
 
-	if (g_ramd_logging.log_to_syslog)
-	{
-		int syslog_priority;
+static void
+ramd_log_line_putf(ramd_log_line_t* out, const char* format, ...)
+{
+	va_list args;
 
-		switch (level)
+	va_start(args, format);
+	ramd_log_line_vputf(out, format, args);
+	va_end(args);
+}
+
+/* Append a quoted JSON string; truncates but always closes the quote */
+static void
+ramd_log_line_put_json(ramd_log_line_t* out, const char* str)
+{
+	const unsigned char* p;
+
+	if (out->len + 2 > out->cap)
+		return;
+	out->data[out->len++] = '"';
+	for (p = (const unsigned char*) str; *p && out->len + 7 <= out->cap; p++)
+	{
+		switch (*p)
 		{
-			case RAMD_LOG_LEVEL_DEBUG:
-				syslog_priority = LOG_DEBUG;
+			case '"':
+				ramd_log_line_putf(out, "\\\"");
 				break;
-			case RAMD_LOG_LEVEL_INFO:
-				syslog_priority = LOG_INFO;
+			case '\\':
+				ramd_log_line_putf(out, "\\\\");
 				break;
-			case RAMD_LOG_LEVEL_NOTICE:
-				syslog_priority = LOG_NOTICE;
+			case '\n':
+				ramd_log_line_putf(out, "\\n");
 				break;
-			case RAMD_LOG_LEVEL_WARNING:
-				syslog_priority = LOG_WARNING;
+			case '\r':
+				ramd_log_line_putf(out, "\\r");
 				break;
-			case RAMD_LOG_LEVEL_ERROR:
-				syslog_priority = LOG_ERR;
-				break;
-			case RAMD_LOG_LEVEL_FATAL:
-				syslog_priority = LOG_CRIT;
+			case '\t':
+				ramd_log_line_putf(out, "\\t");
 				break;
 			default:
-				syslog_priority = LOG_INFO;
+				if (*p < 0x20)
+					ramd_log_line_putf(out, "\\u%04x", *p);
+				else
+					out->data[out->len++] = (char) *p;
 				break;
 		}
+	}
+	out->data[out->len++] = '"';
+	out->data[out->len] = '\0';
+}
+
+static const char*
+ramd_logging_basename(const char* file)
+{
+	const char* slash = file ? strrchr(file, '/') : NULL;
+
+	return slash ? slash + 1 : (file ? file : "");
+}
+
+/* "src/ramd_http_api.c" -> "http_api" */
+static void
+ramd_logging_component(const char* file, const char** start, int* length)
+{
+	const char* base = ramd_logging_basename(file);
+	const char* dot;
+
+	if (strncmp(base, "ramd_", 5) == 0)
+		base += 5;
+	dot = strchr(base, '.');
+	*start = base;
+	*length = dot ? (int) (dot - base) : (int) strlen(base);
+}
+
+static void
+ramd_logging_format_json(ramd_log_line_t* out, ramd_log_level_t level, int64_t ts_us,
+                         const char* component, int component_len,
+                         const char* file, int line, const char* function,
+                         const ramd_log_field_t* fields, size_t field_count,
+                         const char* message)
+{
+	size_t          i;
+
+	/* Keep room for the closing brace whatever the message length */
+	out->cap -= 1;
+	ramd_log_line_putf(out,
+	                   "{\"ts\":%lld,\"level\":\"%s\",\"node_id\":%d,\"pid\":%d,"
+	                   "\"component\":\"%.*s\",\"caller\":\"%s:%d\",\"func\":\"%s\"",
+	                   (long long) ts_us,
+	                   ramd_logging_level_to_string(level), g_ramd_logging.node_id,
+	                   (int) g_ramd_logging.pid, component_len, component,
+	                   ramd_logging_basename(file), line, function ? function : "");
+
+	for (i = 0; i < field_count; i++)
+	{
+		ramd_log_line_putf(out, ",");
+		ramd_log_line_put_json(out, fields[i].key);
+		if (fields[i].str)
+		{
+			ramd_log_line_putf(out, ":");
+			ramd_log_line_put_json(out, fields[i].str);
+		}
+		else
+			ramd_log_line_putf(out, ":%lld", (long long) fields[i].num);
+	}
+
+	ramd_log_line_putf(out, ",\"msg\":");
+	ramd_log_line_put_json(out, message);
+	out->cap += 1;
+	ramd_log_line_putf(out, "}");
+}
+
+static void
+ramd_logging_format_text(ramd_log_line_t* out, const ramd_log_field_t* fields,
+                         size_t field_count, const char* message,
+                         size_t* message_offset)
+{
+	size_t i;
+
+	ramd_log_line_putf(out, "✓ - %d  %s %s ramd: ",
+	                   (int) g_ramd_logging.pid, g_ramd_logging.username,
+	                   ramd_logging_timestamp());
+	*message_offset = out->len;
+	ramd_log_line_putf(out, "%s", message);
+
+	for (i = 0; i < field_count; i++)
+	{
+		if (fields[i].str)
+			ramd_log_line_putf(out, " %s=%s", fields[i].key, fields[i].str);
+		else
+			ramd_log_line_putf(out, " %s=%lld", fields[i].key, (long long) fields[i].num);
+	}
+}
 
-		syslog(syslog_priority, "%s", message);
+static void
+ramd_log_va(ramd_log_level_t level, const char* file, int line,
+            const char* function, const ramd_log_field_t* fields,
+            size_t field_count, const char* format, va_list args)
+{
+	char             local_line[RAMD_LOG_LINE_MAX];
+	char             message[RAMD_MAX_LOG_MESSAGE];
+	ramd_log_slot_t* slot = NULL;
+	ramd_log_line_t  out;
+	uint64_t         pos = 0;
+	size_t           message_offset = 0;
+	size_t           message_length;
+	const char*      component;
+	int              component_len;
+	int64_t          ts_us;
+	int              n;
+
+	if (!g_ramd_logging.initialized || level < g_ramd_logging.min_level)
+		return;
+
+	if (!atomic_load_explicit(&g_log_writer_running, memory_order_relaxed) &&
+	    !g_log_writer_failed)
+		ramd_logging_start_writer();
+
+	if (atomic_load_explicit(&g_log_writer_running, memory_order_relaxed))
+	{
+		slot = ramd_logging_claim(&pos);
+		if (!slot)
+		{
+			atomic_fetch_add_explicit(&g_log_dropped, 1, memory_order_relaxed);
+			return;
+		}
+	}
+
+	n = vsnprintf(message, sizeof(message), format, args);
+	message_length = n < 0 ? 0 : ((size_t) n >= sizeof(message) ? sizeof(message) - 1 : (size_t) n);
+	ts_us = ramd_logging_now_us();
+	ramd_logging_component(file, &component, &component_len);
+
+	out.data = slot ? slot->line : local_line;
+	out.len = 0;
+	out.cap = RAMD_LOG_LINE_MAX - 1;
+	out.data[0] = '\0';
+
+	/* JSON lines go to syslog whole, text lines without the prefix */
+	if (g_ramd_logging.format == RAMD_LOG_FORMAT_JSON)
+		ramd_logging_format_json(&out, level, ts_us, component, component_len,
+		                         file, line, function, fields, field_count, message);
+	else
+		ramd_logging_format_text(&out, fields, field_count, message, &message_offset);
+
+	if (!slot)
+	{
+		/* No writer thread: write through on the calling thread */
+		ramd_logging_emit(level, out.data, out.len, message_offset);
+		ramd_logging_flush_streams();
+		ramd_log_store_append(level, ts_us, component, (size_t) component_len, message,
+		                      message_length);
+		ramd_log_store_notify();
+		return;
 	}
+
+	slot->level = level;
+	slot->length = (uint32_t) out.len;
+	slot->message_offset = (uint32_t) message_offset;
+	slot->ts_us = ts_us;
+	slot->component = component;
+	slot->component_length = (uint32_t) component_len;
+	/* The store cuts it again, on a character boundary */
+	if (message_length > sizeof(slot->message))
+		message_length = sizeof(slot->message);
+	memcpy(slot->message, message, message_length);
+	slot->message_length = (uint32_t) message_length;
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+	/*
+	 * Severe lines go out now, and fatal ones before the process exits.
+	 * A half-full ring also wakes the writer early so bursts are not lost.
+	 */
+	if (level >= RAMD_LOG_LEVEL_WARNING ||
+	    pos - atomic_load_explicit(&g_log_tail, memory_order_relaxed) >= RAMD_LOG_RING_SLOTS / 2)
+		pthread_cond_signal(&g_log_wakeup);
+	if (level >= RAMD_LOG_LEVEL_FATAL)
+		ramd_logging_flush();
+}
+
+void
+ramd_log(ramd_log_level_t level, const char* file, int line,
+         const char* function, const char* format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	ramd_log_va(level, file, line, function, NULL, 0, format, args);
+	va_end(args);
+}
+
+void
+ramd_log_kv(ramd_log_level_t level, const char* file, int line,
+            const char* function, const ramd_log_field_t* fields,
+            size_t field_count, const char* format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	ramd_log_va(level, file, line, function, fields, field_count, format, args);
+	va_end(args);
+}
+
+void
+ramd_logging_set_format(ramd_log_format_t format, int32_t node_id)
+{
+	g_ramd_logging.format = format;
+	g_ramd_logging.node_id = node_id;
+}
+
+void
+ramd_logging_set_level(ramd_log_level_t level)
+{
+	g_ramd_logging.min_level = level;
+}
+
+void
+ramd_logging_set_rotation(int32_t size_mb, int32_t age_min, int32_t keep, bool compress)
+{
+	if (keep < 1)
+		keep = 1;
+
+	pthread_mutex_lock(&g_log_mutex);
+	g_log_rotation.size_bytes = (int64_t) size_mb * 1024 * 1024;
+	g_log_rotation.age_s = (int64_t) age_min * 60;
+	g_log_rotation.keep = keep;
+	g_log_rotation.compress = compress;
+	g_log_rotation.changed = true;
+	pthread_mutex_unlock(&g_log_mutex);
+
+	/* Apply a lower count, and compress what an earlier run left, right away */
+	if (g_ramd_logging.log_file[0] != '\0')
+		ramd_log_rotate_request(g_ramd_logging.log_file, keep, compress);
+}
+
+ramd_log_format_t
+ramd_logging_string_to_format(const char* format_str)
+{
+	if (format_str && strcasecmp(format_str, "json") == 0)
+		return RAMD_LOG_FORMAT_JSON;
+	return RAMD_LOG_FORMAT_TEXT;
 }
 
 const char*
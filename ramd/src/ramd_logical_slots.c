@@ -0,0 +1,626 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_logical_slots.c
+ *		PostgreSQL Auto-Failover Daemon - Logical Failover Slots
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A logical slot lives only on the primary it was created on, so after a
+ * failover a CDC consumer finds no slot on the new primary and has to
+ * snapshot again.  Every daemon whose node is a standby therefore keeps
+ * copies of the primary's logical slots on it, each no further ahead than
+ * the consumer has confirmed:
+ *
+ *   PostgreSQL 17  the slot sync worker does it.  ramd turns on
+ *                  sync_replication_slots and hot_standby_feedback and adds
+ *                  dbname to primary_conninfo on the standby; the primary's
+ *                  own daemon marks idle slots FAILOVER through a
+ *                  replication connection and lists the healthy standbys
+ *                  streaming from it in synchronized_standby_slots, so no
+ *                  consumer is sent changes those standbys have not got.
+ *   PostgreSQL 16  ramd creates each missing slot on the standby with
+ *                  pg_create_logical_replication_slot() and follows the
+ *                  consumer with pg_replication_slot_advance(), at most
+ *                  RAMD_LOGICAL_SLOT_ADVANCE_STEP bytes a pass.
+ *
+ * A fresh copy starts at the standby's replay position, usually ahead of
+ * the consumer; it is reported ready only once the consumer's
+ * confirmed_flush_lsn has passed it, since a consumer that failed over to
+ * it earlier would skip what lies between.  Copies ramd made of slots
+ * that have since been dropped on the primary are dropped in turn.
+ * Physical slots (replication_slots_enabled) are needed on 17, which
+ * synchronizes only for standbys that stream through one.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libpq-fe.h>
+
+#include "ramd_logical_slots.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_postgresql.h"
+#include "ramd_slots.h"
+#include "ramd_topology.h"
+
+/* "XXXXXXXX/XXXXXXXX" and its terminator, with room to spare */
+#define RAMD_LOGICAL_LSN_TEXT 32
+
+#define RAMD_LOGICAL_SLOTS_QUERY \
+	"SELECT slot_name, plugin, database, active, %s, %s, confirmed_flush_lsn::text, " \
+	"pg_wal_lsn_diff(confirmed_flush_lsn, '0/0')::bigint " \
+	"FROM pg_replication_slots WHERE slot_type = 'logical' AND NOT temporary " \
+	"AND confirmed_flush_lsn IS NOT NULL ORDER BY database, slot_name"
+
+#define RAMD_LOGICAL_LOCAL_QUERY \
+	"SELECT slot_name, pg_wal_lsn_diff(confirmed_flush_lsn, '0/0')::bigint " \
+	"FROM pg_replication_slots WHERE slot_type = 'logical' AND NOT temporary " \
+	"AND confirmed_flush_lsn IS NOT NULL"
+
+typedef struct ramd_logical_entry_t
+{
+	bool two_phase;
+	bool copied; /* ramd created this copy, so it drops it too */
+	bool warned; /* in use without FAILOVER, logged once */
+	bool marking_tried; /* ALTER_REPLICATION_SLOT attempted; not retried every pass */
+	ramd_logical_slot_stats_t stats;
+} ramd_logical_entry_t;
+
+typedef struct ramd_logical_state_t
+{
+	pthread_mutex_t lock; /* readers are the HTTP threads */
+	int32_t primary_node_id;
+	ramd_logical_sync_method_t method;
+	bool warned_unsupported;
+	int64_t next_pass_ms;
+	int32_t count;
+	ramd_logical_entry_t entries[RAMD_MAX_LOGICAL_SLOTS];
+} ramd_logical_state_t;
+
+static ramd_logical_state_t g_logical = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.primary_node_id = -1
+};
+
+/* The previous pass's entry for slot_name; only the lag thread writes entries */
+static const ramd_logical_entry_t*
+logical_find(const char* slot_name)
+{
+	for (int32_t i = 0; i < g_logical.count; i++)
+		if (strcmp(g_logical.entries[i].stats.slot_name, slot_name) == 0)
+			return &g_logical.entries[i];
+	return NULL;
+}
+
+static int32_t
+logical_read_primary(PGconn* conn, ramd_logical_entry_t* slots, char lsn_text[][RAMD_LOGICAL_LSN_TEXT],
+                     int32_t max)
+{
+	int version = PQserverVersion(conn);
+	char sql[768];
+	PGresult* res;
+	int32_t count = 0;
+
+	snprintf(sql, sizeof(sql), RAMD_LOGICAL_SLOTS_QUERY,
+	         version >= 140000 ? "two_phase" : "false",
+	         version >= 170000 ? "failover" : "false");
+	res = PQexec(conn, sql);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		ramd_log_debug("Logical slots: query failed: %s", PQerrorMessage(conn));
+		PQclear(res);
+		return -1;
+	}
+
+	for (int row = 0; row < PQntuples(res) && count < max; row++)
+	{
+		ramd_logical_entry_t* e = &slots[count];
+		const ramd_logical_entry_t* previous = logical_find(PQgetvalue(res, row, 0));
+
+		/* A truncated LSN would advance the copy to the wrong place */
+		if (PQgetlength(res, row, 6) >= RAMD_LOGICAL_LSN_TEXT)
+		{
+			ramd_log_warning("Logical slot %s: ignoring confirmed_flush_lsn %s",
+			                 PQgetvalue(res, row, 0), PQgetvalue(res, row, 6));
+			continue;
+		}
+
+		memset(e, 0, sizeof(*e));
+		snprintf(e->stats.slot_name, sizeof(e->stats.slot_name), "%s", PQgetvalue(res, row, 0));
+		snprintf(e->stats.plugin, sizeof(e->stats.plugin), "%s", PQgetvalue(res, row, 1));
+		snprintf(e->stats.database, sizeof(e->stats.database), "%s", PQgetvalue(res, row, 2));
+		e->stats.active = strcmp(PQgetvalue(res, row, 3), "t") == 0;
+		e->two_phase = strcmp(PQgetvalue(res, row, 4), "t") == 0;
+		e->stats.failover = strcmp(PQgetvalue(res, row, 5), "t") == 0;
+		memcpy(lsn_text[count], PQgetvalue(res, row, 6), (size_t) PQgetlength(res, row, 6) + 1);
+		e->stats.confirmed_lsn = strtoll(PQgetvalue(res, row, 7), NULL, 10);
+		e->stats.local_confirmed_lsn = -1;
+		if (previous)
+		{
+			e->copied = previous->copied;
+			e->warned = previous->warned;
+			e->marking_tried = previous->marking_tried;
+		}
+		count++;
+	}
+	PQclear(res);
+	return count;
+}
+
+static bool
+logical_exec(PGconn* conn, const char* sql)
+{
+	PGresult* res = PQexec(conn, sql);
+	bool ok = PQresultStatus(res) == PGRES_TUPLES_OK || PQresultStatus(res) == PGRES_COMMAND_OK;
+
+	if (!ok)
+		ramd_log_warning("Logical slots: \"%s\" failed: %s", sql, PQerrorMessage(conn));
+	PQclear(res);
+	return ok;
+}
+
+/* PostgreSQL 17 syncs only slots created, or altered, with FAILOVER */
+static void
+logical_mark_failover(const ramd_node_t* primary, const ramd_config_t* config,
+                      ramd_logical_entry_t* slots, int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_logical_entry_t* e = &slots[i];
+		const char* keywords[9];
+		const char* values[9];
+		char port[16];
+		char sql[256];
+		char* ident;
+		PGconn* repl;
+		int n = 0;
+
+		if (e->stats.failover || e->marking_tried)
+			continue;
+
+		/* The slot must be acquired to alter it, so only once its consumer is gone */
+		if (e->stats.active)
+		{
+			if (!e->warned)
+				ramd_log_warning("Logical slot %s is not synchronized to standbys while its "
+				                 "consumer stays connected; create it with failover = true",
+				                 e->stats.slot_name);
+			e->warned = true;
+			continue;
+		}
+
+		e->marking_tried = true;
+		snprintf(port, sizeof(port), "%d", primary->postgresql_port);
+		keywords[n] = "host";             values[n++] = primary->hostname;
+		keywords[n] = "port";             values[n++] = port;
+		keywords[n] = "dbname";           values[n++] = e->stats.database;
+		keywords[n] = "user";             values[n++] = config->database_user;
+		if (config->database_password[0] != '\0')
+		{
+			keywords[n] = "password";     values[n++] = config->database_password;
+		}
+		keywords[n] = "replication";      values[n++] = "database";
+		keywords[n] = "application_name"; values[n++] = "ramd_slots";
+		keywords[n] = NULL;               values[n] = NULL;
+
+		repl = PQconnectdbParams(keywords, values, 0);
+		if (PQstatus(repl) != CONNECTION_OK)
+		{
+			ramd_log_debug("Logical slots: no replication connection to %s: %s",
+			               e->stats.database, PQerrorMessage(repl));
+			PQfinish(repl);
+			continue;
+		}
+		ident = PQescapeIdentifier(repl, e->stats.slot_name, strlen(e->stats.slot_name));
+		if (ident)
+		{
+			snprintf(sql, sizeof(sql), "ALTER_REPLICATION_SLOT %s ( FAILOVER true )", ident);
+			PQfreemem(ident);
+			if (logical_exec(repl, sql))
+			{
+				e->stats.failover = true;
+				ramd_log_info("Marked logical slot %s for failover", e->stats.slot_name);
+			}
+		}
+		PQfinish(repl);
+	}
+}
+
+/*
+ * Logical walsenders wait for the physical slots of the standbys that can
+ * take over, so no consumer gets ahead of them; a standby that is down
+ * drops out of the list on the next pass instead of stalling the consumers
+ */
+static void
+logical_set_standby_slots(PGconn* conn, int32_t primary_node_id, const ramd_cluster_t* cluster,
+                          const ramd_config_t* config)
+{
+	char wanted[RAMD_MAX_COMMAND_LENGTH] = "";
+	size_t used = 0;
+	PGresult* res;
+	bool same;
+
+	if (!config->replication_slots_enabled)
+		return;
+
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+		ramd_lag_stats_t lag;
+		char name[64];
+
+		if (node->node_id == primary_node_id || node->role != RAMD_ROLE_STANDBY ||
+		    !node->is_voter || !node->is_healthy || ramd_topology_upstream(node->node_id) > 0 ||
+		    !(ramd_lag_get_stats(node->node_id, &lag) && lag.connected))
+			continue;
+		ramd_slots_name(node->node_id, name, sizeof(name));
+		used += (size_t) snprintf(wanted + used, sizeof(wanted) - used, "%s%s",
+		                          used > 0 ? "," : "", name);
+		if (used >= sizeof(wanted))
+			return;
+	}
+
+	res = PQexec(conn, "SELECT current_setting('synchronized_standby_slots')");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+	{
+		PQclear(res);
+		return;
+	}
+	same = strcmp(PQgetvalue(res, 0, 0), wanted) == 0;
+	PQclear(res);
+	if (same)
+		return;
+
+	if ((wanted[0] ? ramd_postgresql_alter_system(conn, "synchronized_standby_slots", wanted)
+	               : logical_exec(conn, "ALTER SYSTEM RESET synchronized_standby_slots")) &&
+	    logical_exec(conn, "SELECT pg_reload_conf()"))
+		ramd_log_info("synchronized_standby_slots set to '%s'", wanted);
+}
+
+/* Turn each boolean GUC of names on; true if any had to be reloaded */
+static bool
+logical_ensure_on(PGconn* conn, const char* const* names, int count)
+{
+	bool changed = false;
+
+	for (int i = 0; i < count; i++)
+	{
+		char sql[128];
+		PGresult* res;
+		bool on;
+
+		snprintf(sql, sizeof(sql), "SELECT current_setting('%s')::bool", names[i]);
+		res = PQexec(conn, sql);
+		on = PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1 &&
+		     strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+		PQclear(res);
+		if (!on && ramd_postgresql_alter_system(conn, names[i], "on"))
+		{
+			ramd_log_info("Set %s = on for logical slot failover", names[i]);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/* The slot sync worker needs a database in primary_conninfo */
+static bool
+logical_ensure_dbname(PGconn* conn, const ramd_config_t* config)
+{
+	char conninfo[RAMD_MAX_COMMAND_LENGTH];
+	PGresult* res = PQexec(conn, "SELECT current_setting('primary_conninfo')");
+	bool changed = false;
+
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1 &&
+	    PQgetvalue(res, 0, 0)[0] != '\0' && !strstr(PQgetvalue(res, 0, 0), "dbname="))
+	{
+		snprintf(conninfo, sizeof(conninfo), "%s dbname=%s", PQgetvalue(res, 0, 0),
+		         config->database_name);
+		changed = ramd_postgresql_alter_system(conn, "primary_conninfo", conninfo);
+	}
+	PQclear(res);
+	return changed;
+}
+
+/* Fill in local_confirmed_lsn from the standby's own slots */
+static void
+logical_read_local(PGconn* local, ramd_logical_entry_t* slots, int32_t count)
+{
+	PGresult* res = PQexec(local, RAMD_LOGICAL_LOCAL_QUERY);
+
+	if (PQresultStatus(res) == PGRES_TUPLES_OK)
+		for (int row = 0; row < PQntuples(res); row++)
+			for (int32_t i = 0; i < count; i++)
+				if (strcmp(slots[i].stats.slot_name, PQgetvalue(res, row, 0)) == 0)
+					slots[i].stats.local_confirmed_lsn = strtoll(PQgetvalue(res, row, 1), NULL, 10);
+	PQclear(res);
+}
+
+/* Run format with arg1 and arg2 quoted as literals in its two %s, arg2 NULL for none */
+static PGresult*
+logical_call(PGconn* conn, const char* format, const char* arg1, const char* arg2, int32_t timeout_ms)
+{
+	char sql[512];
+	char* lit1 = PQescapeLiteral(conn, arg1, strlen(arg1));
+	char* lit2 = arg2 ? PQescapeLiteral(conn, arg2, strlen(arg2)) : NULL;
+	PGresult* res = NULL;
+
+	if (lit1 && (!arg2 || lit2))
+	{
+		snprintf(sql, sizeof(sql), format, lit1, lit2 ? lit2 : "");
+		res = ramd_conn_exec_timeout(conn, sql, timeout_ms);
+	}
+	if (lit1)
+		PQfreemem(lit1);
+	if (lit2)
+		PQfreemem(lit2);
+	return res;
+}
+
+/* PostgreSQL 16: create missing copies and move them up behind the consumer */
+static void
+logical_advance_copies(PGconn* primary, const ramd_node_t* self, const ramd_config_t* config,
+                       ramd_logical_entry_t* slots, char lsn_text[][RAMD_LOGICAL_LSN_TEXT], int32_t count)
+{
+	PGconn* conn = NULL;
+	const char* connected = NULL;
+	bool snapshot_logged = false;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_logical_entry_t* e = &slots[i];
+		PGresult* res;
+		char target[RAMD_LOGICAL_LSN_TEXT];
+		char sql[256];
+		int64_t to;
+
+		if (e->stats.database[0] == '\0')
+			continue;
+		if (!connected || strcmp(connected, e->stats.database) != 0)
+		{
+			if (conn)
+				ramd_conn_close(conn);
+			conn = ramd_conn_get(self->hostname, self->postgresql_port, e->stats.database,
+			                     config->database_user, config->database_password);
+			connected = conn ? e->stats.database : NULL;
+			if (!conn)
+				continue;
+		}
+
+		if (e->stats.local_confirmed_lsn < 0)
+		{
+			/* Creation on a standby waits for a running-xacts record; have one written */
+			if (!snapshot_logged)
+				snapshot_logged = logical_exec(primary, "SELECT pg_log_standby_snapshot()");
+			snprintf(sql, sizeof(sql), "SELECT pg_wal_lsn_diff(lsn, '0/0')::bigint FROM "
+			         "pg_create_logical_replication_slot(%%s, %%s, false, %s)",
+			         e->two_phase ? "true" : "false");
+			res = logical_call(conn, sql, e->stats.slot_name, e->stats.plugin,
+			                   RAMD_LOGICAL_SLOT_CALL_TIMEOUT_MS);
+			if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+			{
+				e->stats.local_confirmed_lsn = strtoll(PQgetvalue(res, 0, 0), NULL, 10);
+				e->copied = true;
+				ramd_log_info("Created a copy of logical slot %s on this standby; ready for "
+				              "failover once its consumer confirms past it",
+				              e->stats.slot_name);
+			}
+			else
+				ramd_log_warning("Logical slot %s: cannot create a copy on this standby: %s",
+				                 e->stats.slot_name, PQerrorMessage(conn));
+			PQclear(res);
+			continue;
+		}
+
+		if (e->stats.local_confirmed_lsn >= e->stats.confirmed_lsn)
+			continue;
+
+		/* A cancelled advance loses its decoding work, so take bounded steps */
+		to = e->stats.confirmed_lsn;
+		if (to - e->stats.local_confirmed_lsn > RAMD_LOGICAL_SLOT_ADVANCE_STEP)
+		{
+			to = e->stats.local_confirmed_lsn + RAMD_LOGICAL_SLOT_ADVANCE_STEP;
+			snprintf(target, sizeof(target), "%X/%X", (unsigned) ((uint64_t) to >> 32),
+			         (unsigned) ((uint64_t) to & 0xFFFFFFFF));
+		}
+		else
+			memcpy(target, lsn_text[i], sizeof(target));
+
+		res = logical_call(conn, "SELECT pg_wal_lsn_diff(end_lsn, '0/0')::bigint FROM "
+		                   "pg_replication_slot_advance(%s, %s::pg_lsn)",
+		                   e->stats.slot_name, target, RAMD_LOGICAL_SLOT_CALL_TIMEOUT_MS);
+		if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+			e->stats.local_confirmed_lsn = strtoll(PQgetvalue(res, 0, 0), NULL, 10);
+		else
+			ramd_log_debug("Logical slot %s: advance failed: %s", e->stats.slot_name,
+			               PQerrorMessage(conn));
+		PQclear(res);
+	}
+	if (conn)
+		ramd_conn_close(conn);
+}
+
+/* Drop copies ramd made of slots no longer on the primary */
+static void
+logical_drop_stale(PGconn* local, const ramd_logical_entry_t* slots, int32_t count)
+{
+	for (int32_t i = 0; i < g_logical.count; i++)
+	{
+		const ramd_logical_entry_t* old = &g_logical.entries[i];
+		bool present = false;
+		PGresult* res;
+
+		if (!old->copied)
+			continue;
+		for (int32_t j = 0; j < count && !present; j++)
+			present = strcmp(slots[j].stats.slot_name, old->stats.slot_name) == 0;
+		if (present)
+			continue;
+
+		res = logical_call(local, "SELECT pg_drop_replication_slot(%s)%s", old->stats.slot_name,
+		                   NULL, RAMD_LOGICAL_SLOT_CALL_TIMEOUT_MS);
+		if (PQresultStatus(res) == PGRES_TUPLES_OK)
+			ramd_log_info("Dropped the copy of logical slot %s, gone from the primary",
+			              old->stats.slot_name);
+		PQclear(res);
+	}
+}
+
+static void
+logical_publish(ramd_logical_sync_method_t method, ramd_logical_entry_t* slots, int32_t count)
+{
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_logical_slot_stats_t* s = &slots[i].stats;
+
+		s->ready = method == RAMD_LOGICAL_SYNC_PRIMARY ||
+		           (s->local_confirmed_lsn >= 0 && s->local_confirmed_lsn <= s->confirmed_lsn);
+	}
+
+	pthread_mutex_lock(&g_logical.lock);
+	g_logical.method = method;
+	g_logical.count = count;
+	memcpy(g_logical.entries, slots, sizeof(slots[0]) * (size_t) count);
+	pthread_mutex_unlock(&g_logical.lock);
+}
+
+void
+ramd_logical_slots_sync(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                        const ramd_config_t* config)
+{
+	ramd_logical_entry_t slots[RAMD_MAX_LOGICAL_SLOTS];
+	char lsn_text[RAMD_MAX_LOGICAL_SLOTS][RAMD_LOGICAL_LSN_TEXT];
+	ramd_logical_sync_method_t method;
+	const ramd_node_t* self;
+	PGconn* local;
+	int64_t now_ms = ramd_clock_now_ms();
+	int32_t count;
+	int version;
+
+	if (!conn || !cluster || !config)
+		return;
+	if (!config->logical_slot_sync_enabled)
+	{
+		logical_publish(RAMD_LOGICAL_SYNC_OFF, slots, 0);
+		return;
+	}
+	if (now_ms < g_logical.next_pass_ms && g_logical.primary_node_id == primary_node_id)
+		return;
+	g_logical.next_pass_ms = now_ms + RAMD_LOGICAL_SLOT_SYNC_INTERVAL_MS;
+
+	/* Copies of the old primary's slots are the new primary's slots now */
+	if (g_logical.primary_node_id != primary_node_id)
+	{
+		pthread_mutex_lock(&g_logical.lock);
+		g_logical.count = 0;
+		g_logical.primary_node_id = primary_node_id;
+		pthread_mutex_unlock(&g_logical.lock);
+	}
+
+	count = logical_read_primary(conn, slots, lsn_text, RAMD_MAX_LOGICAL_SLOTS);
+	if (count < 0)
+		return;
+
+	if (config->node_id == primary_node_id)
+	{
+		const ramd_node_t* primary = ramd_cluster_find_node(cluster, primary_node_id);
+
+		if (PQserverVersion(conn) >= 170000 && primary)
+		{
+			logical_mark_failover(primary, config, slots, count);
+			if (count > 0)
+				logical_set_standby_slots(conn, primary_node_id, cluster, config);
+		}
+		logical_publish(RAMD_LOGICAL_SYNC_PRIMARY, slots, count);
+		return;
+	}
+
+	self = ramd_cluster_find_node(cluster, config->node_id);
+	if (!self || self->role != RAMD_ROLE_STANDBY || (count == 0 && g_logical.count == 0))
+	{
+		logical_publish(RAMD_LOGICAL_SYNC_OFF, slots, count);
+		return;
+	}
+
+	local = ramd_conn_get(self->hostname, self->postgresql_port, config->database_name,
+	                      config->database_user, config->database_password);
+	if (!local)
+		return;
+	version = PQserverVersion(local);
+
+	if (version >= 170000 && PQserverVersion(conn) >= 170000 && config->replication_slots_enabled)
+	{
+		static const char* const native[] = {"sync_replication_slots", "hot_standby_feedback"};
+		bool changed = logical_ensure_on(local, native, 2);
+
+		changed = logical_ensure_dbname(local, config) || changed;
+		if (changed)
+			logical_exec(local, "SELECT pg_reload_conf()");
+		method = RAMD_LOGICAL_SYNC_NATIVE;
+		logical_read_local(local, slots, count);
+	}
+	else if (version >= 160000)
+	{
+		static const char* const feedback[] = {"hot_standby_feedback"};
+
+		if (logical_ensure_on(local, feedback, 1))
+			logical_exec(local, "SELECT pg_reload_conf()");
+		method = RAMD_LOGICAL_SYNC_ADVANCE;
+		logical_read_local(local, slots, count);
+		logical_advance_copies(conn, self, config, slots, lsn_text, count);
+		logical_drop_stale(local, slots, count);
+	}
+	else
+	{
+		method = RAMD_LOGICAL_SYNC_UNSUPPORTED;
+		if (!g_logical.warned_unsupported && count > 0)
+			ramd_log_warning("Logical slots cannot follow a failover to node %d: PostgreSQL %d "
+			                 "keeps no logical slots on a standby before 16",
+			                 config->node_id, version / 10000);
+		g_logical.warned_unsupported = true;
+	}
+	ramd_conn_close(local);
+	logical_publish(method, slots, count);
+}
+
+int32_t
+ramd_logical_slots_get_all(ramd_logical_slot_stats_t* stats, int32_t max_count,
+                           ramd_logical_sync_method_t* method)
+{
+	int32_t count = 0;
+
+	pthread_mutex_lock(&g_logical.lock);
+	for (int32_t i = 0; i < g_logical.count && count < max_count; i++)
+		stats[count++] = g_logical.entries[i].stats;
+	if (method)
+		*method = g_logical.method;
+	pthread_mutex_unlock(&g_logical.lock);
+	return count;
+}
+
+const char*
+ramd_logical_sync_method_to_string(ramd_logical_sync_method_t method)
+{
+	switch (method)
+	{
+		case RAMD_LOGICAL_SYNC_OFF:
+			return "off";
+		case RAMD_LOGICAL_SYNC_PRIMARY:
+			return "primary";
+		case RAMD_LOGICAL_SYNC_NATIVE:
+			return "native";
+		case RAMD_LOGICAL_SYNC_ADVANCE:
+			return "advance";
+		case RAMD_LOGICAL_SYNC_UNSUPPORTED:
+			return "unsupported";
+	}
+	return "unknown";
+}
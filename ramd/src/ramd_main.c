@@ -17,17 +17,38 @@
 #include "ramd_cluster.h"
 #include "ramd_config.h"
 #include "ramd_config_reload.h"
+#include "ramd_config_watch.h"
 #include "ramd_conn.h"
 #include "ramd_daemon.h"
 #include "ramd_failover.h"
+#include "ramd_fencing.h"
+#include "ramd_archiver.h"
+#include "ramd_remote_write.h"
+#include "ramd_backup_verify.h"
+#include "ramd_replay.h"
 #include "ramd_http_api.h"
+#include "ramd_lag.h"
 #include "ramd_logging.h"
 #include "ramd_maintenance.h"
+#include "ramd_metrics.h"
 #include "ramd_monitor.h"
+#include "ramd_pgraft.h"
 #include "ramd_postgresql_params.h"
 #include "ramd_prometheus.h"
+#include "ramd_rebuild.h"
+#include "ramd_switchover.h"
+#include "ramd_job.h"
 #include "ramd_sync_replication.h"
 #include "ramd_sync_standbys.h"
+#include "ramd_sysmon.h"
+#include "ramd_history.h"
+#include "ramd_instances.h"
+#include "ramd_leader_watch.h"
+#include "ramd_registry.h"
+#include "ramd_proxy.h"
+#include "ramd_endpoint.h"
+#include "ramd_status_page.h"
+#include "ramd_audit_log.h"
 
 ramd_daemon_t *g_ramd_daemon = NULL;
 PGconn       *g_conn = NULL;
@@ -45,12 +66,12 @@ ramd_establish_postgres_connection(void)
 				  g_ramd_daemon->config.hostname,
 				  g_ramd_daemon->config.postgresql_port);
 
-	conn = ramd_conn_get_cached(g_ramd_daemon->config.node_id,
-								g_ramd_daemon->config.hostname,
-								g_ramd_daemon->config.postgresql_port,
-								g_ramd_daemon->config.database_name,
-								g_ramd_daemon->config.database_user,
-								g_ramd_daemon->config.database_password);
+	/* Long-lived and shared, so it stays outside the connection pool */
+	conn = ramd_conn_get(g_ramd_daemon->config.hostname,
+						 g_ramd_daemon->config.postgresql_port,
+						 g_ramd_daemon->config.database_name,
+						 g_ramd_daemon->config.database_user,
+						 g_ramd_daemon->config.database_password);
 
 	if (!conn)
 	{
@@ -71,11 +92,67 @@ ramd_get_postgres_connection(void)
 	return g_conn;
 }
 
+/*
+ * Connect to the local PostgreSQL, probing with PQping first so that a
+ * server still starting up is retried after a short, doubling delay rather
+ * than after a whole monitor interval.  False only if shutdown was asked
+ * for first.
+ */
+static bool
+ramd_wait_for_postgres(void)
+{
+	const ramd_config_t *config = &g_ramd_daemon->config;
+	const char *keywords[] = {"host", "port", "dbname", "user", "connect_timeout", NULL};
+	const char *values[6];
+	char        port[16];
+	int32_t     delay_ms = RAMD_PG_CONNECT_BACKOFF_MIN_MS;
+
+	snprintf(port, sizeof(port), "%d", config->postgresql_port);
+	values[0] = config->hostname;
+	values[1] = port;
+	values[2] = config->database_name;
+	values[3] = config->database_user;
+	values[4] = "2";
+	values[5] = NULL;
+
+	while (!g_shutdown_requested)
+	{
+		PGPing ping = PQpingParams(keywords, values, 0);
+
+		if (ping == PQPING_OK && ramd_establish_postgres_connection())
+			return true;
+		if (ping == PQPING_NO_ATTEMPT)
+		{
+			ramd_log_error("PostgreSQL connection parameters for %s:%d are invalid",
+						   config->hostname, config->postgresql_port);
+			delay_ms = RAMD_PG_CONNECT_BACKOFF_MAX_MS;
+		}
+
+		usleep((useconds_t) delay_ms * 1000);
+		delay_ms = delay_ms * 2 > RAMD_PG_CONNECT_BACKOFF_MAX_MS ?
+			RAMD_PG_CONNECT_BACKOFF_MAX_MS : delay_ms * 2;
+	}
+	return false;
+}
+
+/*
+ * Makes the first connection in the background, so that the HTTP API and
+ * monitor start straight away and report a degraded /health until it is
+ * made, then watches for the connection being lost.
+ */
 static void *
 ramd_connection_monitor_thread(void *arg)
 {
 	(void)arg;
 
+	if (!ramd_wait_for_postgres())
+		return NULL;
+
+	if (ramd_pgraft_check_availability(g_conn) == 1)
+		ramd_log_info("pgraft extension is available and ready");
+	else
+		ramd_log_warning("pgraft extension not available - using fallback logic");
+
 	while (!g_shutdown_requested)
 	{
 		PGconn *conn;
@@ -89,14 +166,7 @@ ramd_connection_monitor_thread(void *arg)
 		if (!conn)
 		{
 			ramd_log_warning("PostgreSQL connection lost, attempting to reconnect...");
-
-			while (!g_shutdown_requested && !ramd_establish_postgres_connection())
-			{
-				ramd_log_error("Failed to reconnect to PostgreSQL, retrying in 60 seconds...");
-				sleep(RAMD_MONITOR_INTERVAL_MS / 1000);
-			}
-
-			if (!g_shutdown_requested)
+			if (ramd_wait_for_postgres())
 				ramd_log_info("Successfully reconnected to PostgreSQL");
 		}
 	}
@@ -149,6 +219,7 @@ ramd_usage(const char *progname)
 	printf("Configuration Options:\n");
 	printf("  -c, --config FILE     Primary configuration file path (required)\n");
 	printf("  -D, --daemonize       Execute as system daemon process\n");
+	printf("  -F, --foreground      Stay in the foreground whatever daemonize is set to\n");
 	printf("  -l, --log-level LEVEL Logging verbosity level (debug, info, notice, warning, error, fatal)\n");
 	printf("  -L, --log-file FILE   Log output file path (default: stderr)\n");
 	printf("  -p, --pid-file FILE   Process identifier file path\n");
@@ -210,6 +281,10 @@ ramd_init(const char *config_file)
 		return false;
 	}
 
+	/* A supervisor runs no cluster of its own; its instances do */
+	if (g_ramd_daemon->config.instances_dir[0] != '\0')
+		return true;
+
 	if (!ramd_conn_init())
 	{
 		fprintf(stderr, "Failed to initialize connection subsystem\n");
@@ -217,14 +292,6 @@ ramd_init(const char *config_file)
 		return false;
 	}
 
-	fprintf(stderr, "Establishing PostgreSQL connection...\n");
-	while (!ramd_establish_postgres_connection())
-	{
-		fprintf(stderr, "Failed to connect to PostgreSQL, retrying in 60 seconds...\n");
-		sleep(RAMD_MONITOR_INTERVAL_MS / 1000);
-	}
-	fprintf(stderr, "PostgreSQL connection established successfully\n");
-
 	if (!ramd_cluster_init(&g_ramd_daemon->cluster, &g_ramd_daemon->config))
 	{
 		fprintf(stderr, "Cluster initialization failure: Unable to initialize cluster management subsystem\n");
@@ -241,8 +308,15 @@ ramd_init(const char *config_file)
 	}
 
 	ramd_failover_context_init(&g_ramd_daemon->failover_context);
+	ramd_rebuild_init(&g_ramd_daemon->config);
+	ramd_switchover_init(&g_ramd_daemon->config);
+	if (!ramd_job_init())
+		ramd_log_warning("Job workers unavailable: long-running API operations will be refused");
 
 	/* Initialize Prometheus metrics */
+	g_ramd_metrics = ramd_metrics_create();
+	if (!g_ramd_metrics)
+		ramd_log_warning("Metrics context unavailable: event counters are disabled");
 	ramd_prometheus_init();
 
 	/* Initialize backup system */
@@ -282,6 +356,26 @@ ramd_init(const char *config_file)
 					sizeof(g_ramd_daemon->http_server.auth_token) - 1);
 			g_ramd_daemon->http_server.auth_token[sizeof(g_ramd_daemon->http_server.auth_token) - 1] = '\0';
 		}
+
+		if (!ramd_security_init(&g_ramd_daemon->security))
+		{
+			ramd_log_error("HTTP API initialization failure: Unable to initialize security subsystem");
+			ramd_cleanup();
+			return false;
+		}
+		g_ramd_daemon->security.enable_auth = g_ramd_daemon->config.http_auth_enabled;
+		if (g_ramd_daemon->config.http_auth_enabled &&
+			strlen(g_ramd_daemon->config.http_auth_token) > 0 &&
+			!ramd_security_set_admin_token(g_ramd_daemon->config.http_auth_token))
+		{
+			ramd_log_error("HTTP API initialization failure: Invalid http_auth_token");
+			ramd_cleanup();
+			return false;
+		}
+		ramd_security_set_rate_limit(g_ramd_daemon->config.http_rate_limit_per_minute);
+		if (!ramd_audit_log_open(g_ramd_daemon->config.audit_log_dir,
+								 (int64_t) g_ramd_daemon->config.audit_log_retain_mb * 1024 * 1024))
+			ramd_log_warning("Audit log unavailable on disk: audit records are kept in memory only");
 	}
 
 	ramd_sync_config_t sync_config;
@@ -292,6 +386,10 @@ ramd_init(const char *config_file)
 	sync_config.num_sync_standbys = g_ramd_daemon->config.num_sync_standbys;
 	sync_config.sync_timeout_ms = g_ramd_daemon->config.sync_timeout_ms;
 	sync_config.enforce_sync_standbys = g_ramd_daemon->config.enforce_sync_standbys;
+	sync_config.adaptive = g_ramd_daemon->config.sync_adaptive;
+	sync_config.adaptive_hold_ms = g_ramd_daemon->config.sync_adaptive_hold_ms;
+	sync_config.adaptive_margin_ms = g_ramd_daemon->config.sync_adaptive_margin_ms;
+	sync_config.adaptive_stall_ms = g_ramd_daemon->config.sync_adaptive_stall_ms;
 
 	if (!ramd_sync_replication_init(&sync_config))
 	{
@@ -332,15 +430,41 @@ ramd_cleanup(void)
 	if (g_ramd_daemon->config.maintenance_mode_enabled)
 		ramd_maintenance_cleanup();
 
+	ramd_config_watch_stop();
 	ramd_config_reload_cleanup();
 	ramd_sync_replication_cleanup();
 
 	if (g_ramd_daemon->config.http_api_enabled)
+	{
 		ramd_http_server_cleanup(&g_ramd_daemon->http_server);
+		ramd_security_cleanup(&g_ramd_daemon->security);
+	}
 
+	/* The exporter reads the collector's snapshots, so it goes first */
+	ramd_remote_write_stop();
+	ramd_prometheus_cleanup();
+
+	ramd_job_cleanup();
+	ramd_backup_shutdown();
+	ramd_switchover_cleanup();
+	ramd_rebuild_cleanup();
+	ramd_history_stop();
+	ramd_replay_stop(); /* reads the lag sampler's stats */
+	ramd_lag_stop();
+	ramd_sysmon_stop();
+	ramd_registry_stop();
+	ramd_leader_watch_stop();
+	ramd_proxy_stop();
+	ramd_endpoint_stop();
+	ramd_status_page_stop();
+	ramd_fencing_stop();
+	ramd_archiver_stop();
+	ramd_backup_verify_stop();
 	ramd_monitor_stop(&g_ramd_daemon->monitor);
 	ramd_monitor_cleanup(&g_ramd_daemon->monitor);
 	ramd_failover_context_cleanup(&g_ramd_daemon->failover_context);
+	ramd_metrics_destroy(g_ramd_metrics);
+	g_ramd_metrics = NULL;
 	ramd_cluster_cleanup(&g_ramd_daemon->cluster);
 	ramd_config_cleanup(&g_ramd_daemon->config);
 
@@ -348,6 +472,8 @@ ramd_cleanup(void)
 		ramd_remove_pidfile(g_ramd_daemon->config.pid_file);
 
 	pthread_mutex_destroy(&g_ramd_daemon->mutex);
+	ramd_conn_close(g_conn);
+	g_conn = NULL;
 	ramd_conn_cleanup();
 	ramd_logging_cleanup();
 
@@ -370,6 +496,27 @@ ramd_run(void)
 				  g_ramd_daemon->config.node_id,
 				  g_ramd_daemon->config.cluster_name);
 
+	if (g_ramd_daemon->config.daemonize)
+	{
+		/* Before any thread is started here, since only the caller survives fork() */
+		if (!ramd_daemonize())
+		{
+			ramd_log_fatal("Daemonization failure: Unable to detach process and run as system daemon");
+			return;
+		}
+	}
+
+	/* PostgreSQL may still be starting; nothing below waits for it */
+	if (pthread_create(&conn_monitor_thread, NULL, ramd_connection_monitor_thread, NULL) != 0)
+	{
+		ramd_log_error("Failed to create PostgreSQL connection monitoring thread");
+	}
+	else
+	{
+		ramd_log_info("PostgreSQL connection monitoring thread started");
+		pthread_detach(conn_monitor_thread);
+	}
+
 	if (g_ramd_daemon->config.http_api_enabled)
 	{
 		if (!ramd_http_server_start(&g_ramd_daemon->http_server))
@@ -385,15 +532,6 @@ ramd_run(void)
 					  g_ramd_daemon->config.http_port);
 	}
 
-	if (g_ramd_daemon->config.daemonize)
-	{
-		if (!ramd_daemonize())
-		{
-			ramd_log_fatal("Daemonization failure: Unable to detach process and run as system daemon");
-			return;
-		}
-	}
-
 	if (strlen(g_ramd_daemon->config.pid_file) > 0)
 	{
 		if (!ramd_write_pidfile(g_ramd_daemon->config.pid_file))
@@ -409,15 +547,52 @@ ramd_run(void)
 		return;
 	}
 
-	if (pthread_create(&conn_monitor_thread, NULL, ramd_connection_monitor_thread, NULL) != 0)
-	{
-		ramd_log_error("Failed to create PostgreSQL connection monitoring thread");
-	}
-	else
-	{
-		ramd_log_info("PostgreSQL connection monitoring thread started");
-		pthread_detach(conn_monitor_thread);
-	}
+	/* Scrapes are served from this cache instead of querying per request */
+	if (!ramd_prometheus_start_collector(g_ramd_daemon->config.metrics_refresh_interval_ms,
+										 g_ramd_daemon->config.metrics_compression))
+		ramd_log_warning("Metrics collector unavailable: metrics will be rendered per scrape");
+
+	if (!ramd_lag_start(&g_ramd_daemon->cluster, &g_ramd_daemon->config))
+		ramd_log_warning("Lag sampler unavailable: standby lag will not be tracked");
+
+	if (!ramd_sysmon_start(&g_ramd_daemon->config))
+		ramd_log_warning("System sampler unavailable: host load will not affect health");
+
+	if (!ramd_history_start(&g_ramd_daemon->config))
+		ramd_log_warning("Metrics history unavailable: ramctrl show performance will have no history");
+
+	if (!ramd_leader_watch_start(&g_ramd_daemon->monitor, &g_ramd_daemon->config))
+		ramd_log_warning("Leader watch unavailable: Raft leader changes will wait for the next monitor cycle");
+
+	if (!ramd_registry_start(&g_ramd_daemon->monitor, &g_ramd_daemon->config))
+		ramd_log_warning("Cluster registry unavailable: daemons learn of each other only by probing");
+
+	if (!ramd_proxy_start(&g_ramd_daemon->config))
+		ramd_log_warning("Proxy unavailable: clients must reach PostgreSQL some other way");
+
+	if (!ramd_endpoint_start(&g_ramd_daemon->config))
+		ramd_log_warning("Endpoint reconciler unavailable: endpoint_vip moves only when this daemon promotes");
+
+	if (!ramd_status_page_start(&g_ramd_daemon->config))
+		ramd_log_warning("Status page unavailable: local tools fall back to the HTTP API");
+
+	if (!ramd_fencing_start(&g_ramd_daemon->cluster, &g_ramd_daemon->config))
+		ramd_log_warning("Fencing unavailable: failover cannot wait for the old primary's lease");
+
+	if (!ramd_archiver_start(&g_ramd_daemon->config))
+		ramd_log_warning("WAL archiver unavailable: archive_library = 'pgraft' calls will time out");
+
+	if (!ramd_backup_verify_start(&g_ramd_daemon->config))
+		ramd_log_warning("Backup verifier unavailable: maintenance pre-checks only see that a backup exists");
+
+	if (!ramd_remote_write_start(&g_ramd_daemon->config))
+		ramd_log_warning("Remote write unavailable: metrics are served for scraping only");
+
+	if (!ramd_replay_start(&g_ramd_daemon->config))
+		ramd_log_warning("Replay advisor unavailable: standby lag is not split by stage");
+
+	if (g_ramd_daemon->config.config_watch_enabled && g_ramd_daemon->config_file)
+		ramd_config_watch_start(g_ramd_daemon->config_file);
 
 	g_ramd_daemon->running = true;
 
@@ -425,11 +600,14 @@ ramd_run(void)
 	{
 		sleep(1);
 
+		ramd_config_reload_run_pending();
+
 		if (ramd_failover_should_trigger(&g_ramd_daemon->cluster,
 										&g_ramd_daemon->config))
 		{
 			ramd_log_warning("Failover trigger detected: Automatic failover conditions met - initiating failover procedure");
 
+			g_ramd_daemon->failover_context.auto_triggered = true;
 			if (!ramd_failover_execute(&g_ramd_daemon->cluster,
 									 &g_ramd_daemon->config,
 									 &g_ramd_daemon->failover_context))
@@ -516,11 +694,13 @@ main(int argc, char *argv[])
 	const char *pid_file      = NULL;
 	const char *log_level_str = NULL;
 	bool        daemonize_flag = false;
+	bool        foreground_flag = false;
 	int         c;
 
 	static struct option long_options[] = {
 		{"config", required_argument, 0, 'c'},
 		{"daemonize", no_argument, 0, 'D'},
+		{"foreground", no_argument, 0, 'F'},
 		{"log-level", required_argument, 0, 'l'},
 		{"log-file", required_argument, 0, 'L'},
 		{"pid-file", required_argument, 0, 'p'},
@@ -529,7 +709,7 @@ main(int argc, char *argv[])
 		{0, 0, 0, 0}
 	};
 
-	while ((c = getopt_long(argc, argv, "c:Dl:L:p:hV", long_options, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "c:DFl:L:p:hV", long_options, NULL)) != -1)
 	{
 		switch (c)
 		{
@@ -539,6 +719,9 @@ main(int argc, char *argv[])
 			case 'D':
 				daemonize_flag = true;
 				break;
+			case 'F':
+				foreground_flag = true;
+				break;
 			case 'l':
 				log_level_str = optarg;
 				break;
@@ -570,6 +753,8 @@ main(int argc, char *argv[])
 
 	if (daemonize_flag)
 		g_ramd_daemon->config.daemonize = true;
+	if (foreground_flag)
+		g_ramd_daemon->config.daemonize = false;
 	if (log_file)
 		strncpy(g_ramd_daemon->config.log_file, log_file,
 				sizeof(g_ramd_daemon->config.log_file) - 1);
@@ -589,6 +774,24 @@ main(int argc, char *argv[])
 		ramd_cleanup();
 		exit(1);
 	}
+	ramd_logging_set_format(g_ramd_daemon->config.log_format,
+							g_ramd_daemon->config.node_id);
+	ramd_logging_set_rotation(g_ramd_daemon->config.log_rotation_size_mb,
+							  g_ramd_daemon->config.log_rotation_age_min,
+							  g_ramd_daemon->config.log_rotation_count,
+							  g_ramd_daemon->config.log_compress);
+
+	if (g_ramd_daemon->config.instances_dir[0] != '\0')
+	{
+		int status = ramd_instances_run(&g_ramd_daemon->config, argv[0]);
+
+		ramd_config_cleanup(&g_ramd_daemon->config);
+		ramd_logging_cleanup();
+		pthread_mutex_destroy(&g_ramd_daemon->mutex);
+		free(g_ramd_daemon);
+		g_ramd_daemon = NULL;
+		return status;
+	}
 
 	ramd_run();
 	ramd_cleanup();
@@ -21,14 +21,24 @@
 #include <netdb.h>
 
 #include "ramd_maintenance.h"
+#include "ramd_metrics.h"
+#include "ramd_backup.h"
+#include "ramd_backup_verify.h"
 #include "ramd_logging.h"
 #include "ramd_defaults.h"
+#include "ramd_clock.h"
 #include "ramd_query.h"
 #include "ramd_postgresql.h"
 #include "ramd_daemon.h"
 #include "ramd_cluster.h"
 #include "ramd_basebackup.h"
 #include "ramd_conn.h"
+#include "ramd_lag.h"
+#include "ramd_probe.h"
+#include "ramd_process.h"
+#include "ramd_slots.h"
+#include "ramd_sync_replication.h"
+#include "ramd_registry.h"
 
 extern ramd_daemon_t* g_ramd_daemon;
 #include "ramd_query.h"
@@ -50,8 +60,11 @@ typedef struct ramd_maintenance_schedule_t
 static ramd_maintenance_schedule_t g_maintenance_schedule;
 
 
-static bool ping_node(const char* hostname, int32_t port);
-static double get_replication_lag(ramd_node_t* node);
+static bool ramd_maintenance_seed_standby(const ramd_config_t* config,
+                                          const char* data_dir,
+                                          const char* primary_host,
+                                          int32_t primary_port);
+static PGconn* drain_pooler_send(const char* command);
 
 bool ramd_maintenance_init(void)
 {
@@ -125,6 +138,7 @@ bool ramd_maintenance_enter(const ramd_maintenance_config_t* config)
 	state->status = RAMD_MAINTENANCE_STATUS_PENDING;
 	state->target_node_id = config->target_node_id;
 	state->start_time = time(NULL);
+	state->start_ms = ramd_clock_now_ms();
 	state->scheduled_end = config->scheduled_end;
 	strncpy(state->reason, config->reason, sizeof(state->reason) - 1);
 	strncpy(state->contact_info, config->contact_info,
@@ -136,6 +150,9 @@ bool ramd_maintenance_enter(const ramd_maintenance_config_t* config)
 
 	pthread_mutex_unlock(&g_maintenance_mutex);
 
+	/* Other daemons stop counting on the node before it drains */
+	ramd_registry_note_maintenance(config->target_node_id, true);
+
 	ramd_log_info(
 	    "Entering maintenance mode for node %d (type: %s, reason: %s)",
 	    config->target_node_id, ramd_maintenance_type_to_string(config->type),
@@ -185,6 +202,17 @@ bool ramd_maintenance_enter(const ramd_maintenance_config_t* config)
 			ramd_log_warning("Failed to drain all connections for node %d",
 			                 config->target_node_id);
 		}
+
+		/* Let the synchronous standbys take the primary's last writes */
+		if (g_ramd_daemon &&
+		    config->target_node_id == g_ramd_daemon->cluster.primary_node_id &&
+		    g_ramd_daemon->config.synchronous_replication &&
+		    !ramd_sync_replication_wait_for_sync(config->drain_timeout_ms))
+		{
+			ramd_log_warning("Synchronous standbys did not catch up with node %d "
+			                 "within %d ms", config->target_node_id,
+			                 config->drain_timeout_ms);
+		}
 	}
 
 	
@@ -237,7 +265,18 @@ bool ramd_maintenance_exit(int32_t node_id)
 	}
 
 	
-	if (!ramd_maintenance_prevent_new_connections(node_id, false))
+	if (g_ramd_daemon && g_ramd_daemon->config.maintenance_pooler_admin[0] != '\0')
+	{
+		PGconn* pooler = drain_pooler_send(g_ramd_daemon->config.maintenance_pooler_resume_command);
+		PGresult* res = ramd_conn_wait_result(pooler, RAMD_DRAIN_POOLER_TIMEOUT_MS);
+
+		if (!res || PQresultStatus(res) != PGRES_COMMAND_OK)
+			ramd_log_warning("Failed to resume the connection pooler for node %d",
+			                 node_id);
+		PQclear(res);
+		PQfinish(pooler);
+	}
+	else if (!ramd_maintenance_prevent_new_connections(node_id, false))
 	{
 		ramd_log_warning("Failed to re-enable connections for node %d",
 		                 node_id);
@@ -248,6 +287,7 @@ bool ramd_maintenance_exit(int32_t node_id)
 	memset(state, 0, sizeof(ramd_maintenance_state_t));
 	state->status = RAMD_MAINTENANCE_STATUS_INACTIVE;
 	pthread_mutex_unlock(&g_maintenance_mutex);
+	ramd_registry_note_maintenance(node_id, false);
 
 	ramd_log_info("Node %d has exited maintenance mode", node_id);
 	return true;
@@ -270,79 +310,272 @@ bool ramd_maintenance_get_status(int32_t node_id,
 }
 
 
-bool ramd_maintenance_pre_check(const ramd_maintenance_config_t* config,
-                                ramd_maintenance_check_t* checks)
+/*
+ * Pre-checks that talk to servers or the filesystem run on their own
+ * threads against one copy of the latest published cluster, and the
+ * caller waits for them no longer than RAMD_MAINTENANCE_PRECHECK_TIMEOUT_MS.
+ * A check still running then counts as failed; its thread finishes on its
+ * own and the last one out frees the run.
+ */
+typedef struct maintenance_precheck_run_t
 {
-	if (!config || !checks)
-		return false;
+	pthread_mutex_t lock; /* guards everything below the cluster */
+	pthread_cond_t  cond;
+	ramd_cluster_t  cluster;
+	int32_t         timeout_ms;
+	int32_t         refs;    /* the caller plus each running check */
+	int32_t         pending;
+	bool            reachable_done;
+	bool            reachable;
+	bool            sessions_done;
+	bool            no_active_transactions;
+	int32_t         active_connections;
+	bool            backup_done;
+	bool            backup_available;
+	char            backup_note[320];
+} maintenance_precheck_run_t;
+
+/* The last result, handed to callers asking again within the cache time */
+static struct
+{
+	pthread_mutex_t          lock; /* held while a check runs, so callers share it */
+	bool                     valid;
+	int32_t                  target_node_id;
+	int64_t                  checked_ms;
+	bool                     passed;
+	ramd_maintenance_check_t checks;
+} g_precheck_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
 
-	memset(checks, 0, sizeof(ramd_maintenance_check_t));
 
-	
-	checks->cluster_healthy = check_cluster_health();
-	checks->all_nodes_reachable = check_all_nodes_reachable();
-	checks->sufficient_standbys = check_sufficient_standbys();
+static void
+precheck_run_put(maintenance_precheck_run_t* run)
+{
+	bool last;
+
+	pthread_mutex_lock(&run->lock);
+	last = --run->refs == 0;
+	pthread_mutex_unlock(&run->lock);
+	if (!last)
+		return;
+	pthread_cond_destroy(&run->cond);
+	pthread_mutex_destroy(&run->lock);
+	free(run);
+}
 
-	
-	checks->replication_current = check_replication_current();
+static void
+precheck_run_done(maintenance_precheck_run_t* run)
+{
+	pthread_mutex_lock(&run->lock);
+	run->pending--;
+	pthread_cond_broadcast(&run->cond);
+	pthread_mutex_unlock(&run->lock);
+	precheck_run_put(run);
+}
 
-	
-	if (!ramd_maintenance_get_connection_count(config->target_node_id,
-	                                           &checks->active_connections))
-	{
-		checks->active_connections = -1; 
-	}
+static void*
+precheck_reachable_thread(void* arg)
+{
+	maintenance_precheck_run_t* run = arg;
+	bool                        reachable;
+
+	reachable = check_all_nodes_reachable(&run->cluster, run->timeout_ms);
+	pthread_mutex_lock(&run->lock);
+	run->reachable = reachable;
+	run->reachable_done = true;
+	pthread_mutex_unlock(&run->lock);
+	precheck_run_done(run);
+	return NULL;
+}
 
-	
-	checks->no_active_transactions = check_no_active_transactions();
+static void*
+precheck_sessions_thread(void* arg)
+{
+	maintenance_precheck_run_t* run = arg;
+	int32_t                     active_connections;
+	bool                        no_active_transactions;
+
+	no_active_transactions = check_no_active_transactions(run->timeout_ms, &active_connections);
+	pthread_mutex_lock(&run->lock);
+	run->no_active_transactions = no_active_transactions;
+	run->active_connections = active_connections;
+	run->sessions_done = true;
+	pthread_mutex_unlock(&run->lock);
+	precheck_run_done(run);
+	return NULL;
+}
 
-	
-	checks->backup_available = check_backup_availability();
+static void*
+precheck_backup_thread(void* arg)
+{
+	maintenance_precheck_run_t* run = arg;
+	bool                        backup_available;
+	char                        note[sizeof(run->backup_note)];
+
+	backup_available = check_backup_availability(note, sizeof(note));
+	pthread_mutex_lock(&run->lock);
+	run->backup_available = backup_available;
+	snprintf(run->backup_note, sizeof(run->backup_note), "%s", note);
+	run->backup_done = true;
+	pthread_mutex_unlock(&run->lock);
+	precheck_run_done(run);
+	return NULL;
+}
 
-	
-	if (!checks->cluster_healthy)
-	{
-		strncat(checks->check_details, "Cluster is not healthy. ",
-		        sizeof(checks->check_details) - strlen(checks->check_details) -
-		            1);
-	}
+/* Start check on a detached thread, or run it here if no thread can be had */
+static void
+precheck_run_start(maintenance_precheck_run_t* run, void* (*check)(void*))
+{
+	pthread_attr_t attr;
+	pthread_t      thread;
+	bool           started;
+
+	pthread_mutex_lock(&run->lock);
+	run->refs++;
+	run->pending++;
+	pthread_mutex_unlock(&run->lock);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	started = pthread_create(&thread, &attr, check, run) == 0;
+	pthread_attr_destroy(&attr);
+	if (!started)
+		check(run);
+}
 
+static void
+precheck_note(ramd_maintenance_check_t* checks, const char* note)
+{
+	strncat(checks->check_details, note,
+	        sizeof(checks->check_details) - strlen(checks->check_details) - 1);
+}
+
+static void
+precheck_evaluate(const ramd_maintenance_config_t* config, ramd_maintenance_check_t* checks)
+{
+	maintenance_precheck_run_t* run;
+	const ramd_cluster_t*       published;
+	struct timespec             deadline;
+	int32_t                     healthy_standbys = 0;
+
+	run = calloc(1, sizeof(*run));
+	if (!run)
+	{
+		precheck_note(checks, "Out of memory. ");
+		checks->active_connections = -1;
+		return;
+	}
+	pthread_mutex_init(&run->lock, NULL);
+	pthread_cond_init(&run->cond, NULL);
+	run->refs = 1;
+	run->timeout_ms = RAMD_MAINTENANCE_PRECHECK_TIMEOUT_MS;
+	run->active_connections = -1;
+
+	/* Before the monitor's first publish the live view is all there is */
+	published = ramd_cluster_acquire();
+	run->cluster = published ? *published : g_ramd_daemon->cluster;
+	if (published)
+		ramd_cluster_release(published);
+
+	precheck_run_start(run, precheck_reachable_thread);
+	precheck_run_start(run, precheck_sessions_thread);
+	precheck_run_start(run, precheck_backup_thread);
+
+	/* The rest only reads the copy and the lag sampler's figures */
+	checks->cluster_healthy = check_cluster_health(&run->cluster);
+	checks->sufficient_standbys = check_sufficient_standbys(&run->cluster);
+	checks->replication_current = check_replication_current(&run->cluster);
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += RAMD_MAINTENANCE_PRECHECK_TIMEOUT_MS / 1000;
+	deadline.tv_nsec += (long) (RAMD_MAINTENANCE_PRECHECK_TIMEOUT_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&run->lock);
+	while (run->pending > 0 &&
+	       pthread_cond_timedwait(&run->cond, &run->lock, &deadline) != ETIMEDOUT)
+		;
+	checks->all_nodes_reachable = run->reachable;
+	checks->no_active_transactions = run->no_active_transactions;
+	checks->active_connections = run->active_connections;
+	checks->backup_available = run->backup_available;
+	if (!run->reachable_done)
+		precheck_note(checks, "Node reachability check timed out. ");
+	if (!run->sessions_done)
+		precheck_note(checks, "Active transaction check timed out. ");
+	if (!run->backup_done)
+		precheck_note(checks, "Backup availability check timed out. ");
+	else
+		precheck_note(checks, run->backup_note);
+	pthread_mutex_unlock(&run->lock);
+
+	if (!checks->cluster_healthy)
+		precheck_note(checks, "Cluster is not healthy. ");
 	if (!checks->sufficient_standbys)
-	{
-		strncat(checks->check_details, "Insufficient standby nodes. ",
-		        sizeof(checks->check_details) - strlen(checks->check_details) -
-		            1);
-	}
+		precheck_note(checks, "Insufficient standby nodes. ");
 
-	/* For primary node maintenance, ensure we have at least one healthy standby
-	 */
-	if (config &&
-	    config->target_node_id == g_ramd_daemon->cluster.primary_node_id)
+	/* For primary node maintenance, ensure we have at least one healthy standby */
+	if (config->target_node_id == run->cluster.primary_node_id)
 	{
-		
-		int32_t healthy_standbys = 0;
-		for (int32_t i = 0; i < g_ramd_daemon->cluster.node_count; i++)
+		for (int32_t i = 0; i < run->cluster.node_count; i++)
 		{
-			ramd_node_t* node = &g_ramd_daemon->cluster.nodes[i];
+			const ramd_node_t* node = &run->cluster.nodes[i];
+
 			if (node->node_id != config->target_node_id &&
 			    node->state == RAMD_NODE_STATE_STANDBY && node->is_healthy)
-			{
 				healthy_standbys++;
-			}
 		}
 
 		if (healthy_standbys == 0)
 		{
 			checks->sufficient_standbys = false;
-			strncat(
-			    checks->check_details,
-			    "No healthy standby nodes available for primary maintenance. ",
-			    sizeof(checks->check_details) - strlen(checks->check_details) -
-			        1);
+			precheck_note(checks, "No healthy standby nodes available for primary maintenance. ");
 		}
 	}
 
-	return (checks->cluster_healthy && checks->sufficient_standbys);
+	precheck_run_put(run);
+}
+
+bool ramd_maintenance_pre_check(const ramd_maintenance_config_t* config,
+                                ramd_maintenance_check_t* checks)
+{
+	int64_t now;
+	bool    passed;
+
+	if (!config || !checks)
+		return false;
+
+	pthread_mutex_lock(&g_precheck_cache.lock);
+	now = ramd_clock_now_ms();
+	if (g_precheck_cache.valid &&
+	    g_precheck_cache.target_node_id == config->target_node_id &&
+	    now - g_precheck_cache.checked_ms < RAMD_MAINTENANCE_PRECHECK_CACHE_MS)
+	{
+		*checks = g_precheck_cache.checks;
+		passed = g_precheck_cache.passed;
+		pthread_mutex_unlock(&g_precheck_cache.lock);
+		return passed;
+	}
+
+	memset(checks, 0, sizeof(ramd_maintenance_check_t));
+	precheck_evaluate(config, checks);
+	passed = checks->cluster_healthy && checks->sufficient_standbys;
+
+	g_precheck_cache.valid = true;
+	g_precheck_cache.target_node_id = config->target_node_id;
+	g_precheck_cache.checked_ms = ramd_clock_now_ms();
+	g_precheck_cache.passed = passed;
+	g_precheck_cache.checks = *checks;
+	pthread_mutex_unlock(&g_precheck_cache.lock);
+
+	ramd_log_debug("Maintenance pre-checks for node %d took %lld ms",
+	               config->target_node_id, (long long) (ramd_clock_now_ms() - now));
+	return passed;
 }
 
 
@@ -353,59 +586,236 @@ bool ramd_maintenance_is_safe_to_enter(const ramd_maintenance_config_t* config)
 }
 
 
+/* Borrow a pooled session to node_id's server */
+static PGconn*
+drain_checkout(int32_t node_id)
+{
+	const ramd_config_t* config = &g_ramd_daemon->config;
+	char                 host[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t              port = config->postgresql_port;
+	ramd_node_t*         node;
+
+	snprintf(host, sizeof(host), "%s", config->hostname);
+	node = ramd_cluster_find_node(&g_ramd_daemon->cluster, node_id);
+	if (node && node_id != config->node_id)
+	{
+		snprintf(host, sizeof(host), "%s", node->hostname);
+		port = node->postgresql_port;
+	}
+
+	return ramd_conn_checkout(node_id, host, port, config->database_name,
+	                          config->database_user, config->database_password);
+}
+
+/*
+ * Send a command to the pooler's admin console.  pgbouncer answers PAUSE
+ * only once its server connections are released, but holds new clients
+ * from the moment it is sent, so the drain does not wait for the answer.
+ */
+static PGconn*
+drain_pooler_send(const char* command)
+{
+	const char* conninfo = g_ramd_daemon->config.maintenance_pooler_admin;
+	PGconn*     conn;
+
+	if (conninfo[0] == '\0' || command[0] == '\0')
+		return NULL;
+
+	conn = PQconnectdb(conninfo);
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		ramd_log_warning("Drain: cannot reach the pooler admin console: %s",
+		                 PQerrorMessage(conn));
+		PQfinish(conn);
+		return NULL;
+	}
+	if (!ramd_conn_send(conn, command))
+	{
+		PQfinish(conn);
+		return NULL;
+	}
+	ramd_log_info("Drain: sent %s to the connection pooler", command);
+	return conn;
+}
+
+/* True once the pooler has answered; NULL-safe, never blocks */
+static bool
+drain_pooler_answered(PGconn* conn)
+{
+	PGresult* res;
+
+	if (!conn || !PQconsumeInput(conn) || PQisBusy(conn))
+		return false;
+
+	while ((res = PQgetResult(conn)) != NULL)
+	{
+		if (PQresultStatus(res) != PGRES_COMMAND_OK && PQresultStatus(res) != PGRES_TUPLES_OK)
+			ramd_log_warning("Drain: pooler refused the command: %s",
+			                 PQresultErrorMessage(res));
+		PQclear(res);
+	}
+	return true;
+}
+
+static void
+drain_observe(int32_t node_id, ramd_maintenance_drain_phase_t phase, int64_t initial,
+              int64_t remaining, int64_t terminated)
+{
+	ramd_metrics_observe_drain(g_ramd_metrics, node_id, phase, initial, remaining, terminated);
+
+	pthread_mutex_lock(&g_maintenance_mutex);
+	if (node_id > 0 && node_id <= RAMD_MAX_NODES)
+	{
+		g_maintenance_states[node_id - 1].active_connections = (int32_t) remaining;
+		snprintf(g_maintenance_states[node_id - 1].status_message,
+		         sizeof(g_maintenance_states[node_id - 1].status_message),
+		         "Draining: %s, %lld busy sessions left, %lld idle terminated",
+		         ramd_maintenance_drain_phase_to_string(phase), (long long) remaining,
+		         (long long) terminated);
+	}
+	pthread_mutex_unlock(&g_maintenance_mutex);
+}
+
 bool ramd_maintenance_drain_connections(int32_t node_id, int32_t timeout_ms)
 {
-	int32_t connection_count;
-	int32_t elapsed_ms = 0;
-	const int32_t check_interval_ms = 1000;
+	ramd_maintenance_drain_phase_t phase = RAMD_DRAIN_PHASE_PAUSE_POOLER;
+	PGconn*     conn;
+	PGconn*     pooler;
+	char        grace[16];
+	const char* params[1] = {grace};
+	int64_t     deadline_ms = ramd_clock_now_ms() + timeout_ms;
+	int64_t     initial = -1;
+	int64_t     remaining = -1;
+	int64_t     terminated = 0;
+	bool        pooler_paused = false;
+	bool        drained = false;
+
+	if (!g_ramd_daemon || node_id <= 0 || node_id > RAMD_MAX_NODES)
+		return false;
 
 	ramd_log_info("Draining connections for node %d (timeout: %d ms)", node_id,
 	              timeout_ms);
+	snprintf(grace, sizeof(grace), "%d", g_ramd_daemon->config.maintenance_drain_idle_grace_ms);
 
-	
-	if (!ramd_maintenance_prevent_new_connections(node_id, true))
+	/* Hold new clients at the pooler first, so the count only goes down */
+	drain_observe(node_id, phase, 0, 0, 0);
+	pooler = drain_pooler_send(g_ramd_daemon->config.maintenance_pooler_pause_command);
+	if (!pooler && g_ramd_daemon->config.maintenance_pooler_admin[0] == '\0' &&
+	    !ramd_maintenance_prevent_new_connections(node_id, true))
 	{
 		ramd_log_error("Failed to prevent new connections for node %d",
 		               node_id);
 		return false;
 	}
 
-	
-	while (elapsed_ms < timeout_ms)
+	conn = drain_checkout(node_id);
+	if (!conn)
 	{
-		if (!ramd_maintenance_get_connection_count(node_id, &connection_count))
+		ramd_log_error("Drain: cannot connect to node %d", node_id);
+		PQfinish(pooler);
+		drain_observe(node_id, RAMD_DRAIN_PHASE_TIMED_OUT, 0, -1, 0);
+		return false;
+	}
+
+	phase = RAMD_DRAIN_PHASE_TERMINATE_IDLE;
+	for (;;)
+	{
+		PGresult* res;
+
+		/* Sessions that go idle while we wait get their grace period too */
+		res = ramd_query_exec_prepared(conn, RAMD_QUERY_STMT_DRAIN_TERMINATE_IDLE, 1, params);
+		if (res)
+			terminated += ramd_query_value_int64(res, 0, 0, 0);
+		PQclear(res);
+
+		/* A session in a transaction holds the drain until it ends or idles out */
+		res = ramd_query_exec_prepared(conn, RAMD_QUERY_STMT_DRAIN_SESSIONS, 0, NULL);
+		if (!res)
 		{
-			ramd_log_warning("Failed to get connection count for node %d",
-			                 node_id);
+			ramd_log_warning("Failed to get connection count for node %d", node_id);
 			break;
 		}
+		remaining = ramd_query_value_int64(res, 0, 0, 0) + ramd_query_value_int64(res, 0, 1, 0);
+		if (initial < 0)
+			initial = remaining;
+		PQclear(res);
 
-		if (connection_count <= 1) 
+		if (!pooler_paused && drain_pooler_answered(pooler))
 		{
-			ramd_log_info("Successfully drained connections for node %d",
-			              node_id);
-
-			pthread_mutex_lock(&g_maintenance_mutex);
-			if (node_id <= RAMD_MAX_NODES)
-				g_maintenance_states[node_id - 1].connections_drained = true;
-			pthread_mutex_unlock(&g_maintenance_mutex);
+			pooler_paused = true;
+			ramd_log_info("Drain: connection pooler paused");
+		}
 
-			return true;
+		if (remaining == 0)
+		{
+			drained = true;
+			break;
 		}
+		drain_observe(node_id, phase, initial, remaining, terminated);
+		if (ramd_clock_now_ms() >= deadline_ms)
+			break;
 
-		ramd_log_debug("Node %d still has %d active connections", node_id,
-		               connection_count);
+		ramd_log_debug("Node %d still has %lld busy sessions", node_id, (long long) remaining);
+		phase = RAMD_DRAIN_PHASE_WAIT_ACTIVE;
+		usleep(RAMD_DRAIN_POLL_MS * 1000);
+	}
+	ramd_conn_checkin(node_id, conn);
+
+	/* With no server sessions left the pooler's PAUSE completes momentarily */
+	if (pooler && !pooler_paused && drained)
+	{
+		int64_t pause_deadline_ms = ramd_clock_now_ms() + RAMD_DRAIN_POOLER_TIMEOUT_MS;
 
-		usleep((useconds_t) (check_interval_ms * 1000));
-		elapsed_ms += check_interval_ms;
+		while (!(pooler_paused = drain_pooler_answered(pooler)) &&
+		       ramd_clock_now_ms() < pause_deadline_ms)
+			usleep(RAMD_DRAIN_POLL_MS * 1000);
+		if (!pooler_paused)
+			ramd_log_warning("Drain: the connection pooler did not confirm the pause");
+	}
+	PQfinish(pooler);
+
+	drain_observe(node_id, drained ? RAMD_DRAIN_PHASE_DONE : RAMD_DRAIN_PHASE_TIMED_OUT,
+	              initial, remaining, terminated);
+	if (drained)
+	{
+		ramd_log_info("Successfully drained connections for node %d "
+		              "(%lld idle sessions terminated)", node_id, (long long) terminated);
+
+		pthread_mutex_lock(&g_maintenance_mutex);
+		g_maintenance_states[node_id - 1].connections_drained = true;
+		pthread_mutex_unlock(&g_maintenance_mutex);
+		return true;
 	}
 
 	ramd_log_warning(
-	    "Connection drain timeout for node %d (%d connections remaining)",
-	    node_id, connection_count);
+	    "Connection drain timeout for node %d (%lld connections remaining)",
+	    node_id, (long long) remaining);
 	return false;
 }
 
+const char*
+ramd_maintenance_drain_phase_to_string(ramd_maintenance_drain_phase_t phase)
+{
+	switch (phase)
+	{
+		case RAMD_DRAIN_PHASE_NONE:
+			return "none";
+		case RAMD_DRAIN_PHASE_PAUSE_POOLER:
+			return "pause_pooler";
+		case RAMD_DRAIN_PHASE_TERMINATE_IDLE:
+			return "terminate_idle";
+		case RAMD_DRAIN_PHASE_WAIT_ACTIVE:
+			return "wait_active";
+		case RAMD_DRAIN_PHASE_DONE:
+			return "done";
+		case RAMD_DRAIN_PHASE_TIMED_OUT:
+			return "timed_out";
+		case RAMD_DRAIN_PHASE_COUNT:
+			break;
+	}
+	return "unknown";
+}
+
 
 bool ramd_maintenance_get_connection_count(int32_t node_id
                                            __attribute__((unused)),
@@ -561,15 +971,16 @@ bool ramd_maintenance_create_backup(int32_t node_id, char* backup_id,
 	ramd_log_info("Creating backup for node %d: %s", node_id, backup_id);
 
 	
-	const char *backup_dir = g_ramd_daemon->config.backup_dir;
-	if (backup_dir == NULL) {
-		backup_dir = "{{VAR_DIR}}lib/postgresql/backups";
-	}
-	
+	/* One directory per backup, named by its id, as the verifier expects */
+	const char *backup_dir = g_ramd_daemon->config.backup_dir[0] ?
+	                         g_ramd_daemon->config.backup_dir : RAMD_BACKUP_DEFAULT_DIR;
+	char target_dir[RAMD_MAX_PATH_LENGTH];
+	int len = snprintf(target_dir, sizeof(target_dir), "%s/%s", backup_dir, backup_id);
+	if (len < 0 || (size_t) len >= sizeof(target_dir))
+		return false;
 	
-	char backup_cmd[RAMD_MAX_COMMAND_LENGTH];
-	snprintf(backup_cmd, sizeof(backup_cmd), "mkdir -p %s", backup_dir);
-	system(backup_cmd);
+	if (!ramd_process_make_directory(target_dir, 0700))
+		return false;
 	
 	
 	PGconn *conn = ramd_conn_get(g_ramd_daemon->config.hostname, g_ramd_daemon->config.postgresql_port, 
@@ -579,7 +990,7 @@ bool ramd_maintenance_create_backup(int32_t node_id, char* backup_id,
 		return false;
 	}
 	
-	int result = ramd_take_basebackup(conn, backup_dir, backup_id);
+	int result = ramd_take_basebackup(conn, target_dir, backup_id);
 	ramd_conn_close(conn);
 	
 	if (result != 0) {
@@ -588,6 +999,11 @@ bool ramd_maintenance_create_backup(int32_t node_id, char* backup_id,
 	}
 
 	ramd_log_info("Backup created successfully: %s", backup_id);
+
+	/* Read it back while nobody waits on it, so the next pre-check has a result */
+	if (strcmp(g_ramd_daemon->config.backup_verify_tool, "native") == 0 &&
+	    !ramd_backup_verify_request(backup_id))
+		ramd_log_warning("Backup %s not queued for verification", backup_id);
 	return true;
 }
 
@@ -676,40 +1092,24 @@ bool ramd_maintenance_is_cluster_safe_for_maintenance(int32_t target_node_id)
 
 bool ramd_maintenance_verify_backup(const char* backup_id)
 {
+	ramd_backup_verify_result_t result;
+
 	if (!backup_id)
 		return false;
 
-	
-	ramd_postgresql_connection_t pg_conn;
-	if (!ramd_postgresql_connect(&pg_conn, g_ramd_daemon->config.hostname,
-	                             g_ramd_daemon->config.postgresql_port,
-	                             "postgres", "postgres", ""))
+	/* Reads the whole backup back unless a recent run already has */
+	if (!ramd_backup_verify_run(backup_id, false, &result))
 	{
-		ramd_log_error("Failed to connect to PostgreSQL to verify backup %s",
-		               backup_id);
+		ramd_log_error("Backup %s could not be verified", backup_id);
 		return false;
 	}
 
-	PGconn* conn = (PGconn*) pg_conn.connection;
-	PGresult* res;
-	bool backup_valid = false;
-
-	
-	res = ramd_query_exec_with_result(conn, "SELECT last_archived_wal FROM pg_stat_archiver");
-	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
-	{
-		const char* last_wal = PQgetvalue(res, 0, 0);
-		if (last_wal && strlen(last_wal) > 0)
-		{
-			backup_valid = true;
-			ramd_log_info("Backup %s verified - last archived WAL: %s",
-			              backup_id, last_wal);
-		}
-	}
-	PQclear(res);
-
-	ramd_postgresql_disconnect(&pg_conn);
-	return backup_valid;
+	if (result.cached)
+		ramd_log_info("Backup %s %s verification %lld s ago: %s", backup_id,
+		              result.valid ? "passed" : "failed",
+		              (long long) ((ramd_clock_now_ms() - result.verified_ms) / 1000),
+		              result.message);
+	return result.valid;
 }
 
 
@@ -726,8 +1126,7 @@ bool ramd_maintenance_monitor_progress(int32_t node_id)
 
 	if (in_progress)
 	{
-		time_t now = time(NULL);
-		double elapsed = difftime(now, state->start_time);
+		double elapsed = (double) (ramd_clock_now_ms() - state->start_ms) / 1000.0;
 		ramd_log_info(
 		    "Maintenance progress for node %d: %s (%.1f seconds elapsed)",
 		    node_id, state->status_message, elapsed);
@@ -819,16 +1218,14 @@ bool ramd_maintenance_bootstrap_new_node(
 	}
 
 	
-	char initdb_cmd[RAMD_MAX_COMMAND_LENGTH];
-	snprintf(initdb_cmd, sizeof(initdb_cmd),
-	         "initdb -D %s --auth=trust --encoding=UTF8 --locale=C",
-	         node_data_dir);
+	const char* initdb_argv[] = {"initdb", "-D", node_data_dir, "--auth=trust",
+	                             "--encoding=UTF8", "--locale=C", NULL};
+	ramd_process_result_t initdb_result;
 
-	ramd_log_info("Executing: %s", initdb_cmd);
-	int result = system(initdb_cmd);
-	if (result != 0)
+	ramd_log_info("Executing: initdb -D %s", node_data_dir);
+	if (!ramd_process_run(initdb_argv, RAMD_DEFAULT_MAINTENANCE_TIMEOUT_MS, &initdb_result))
 	{
-		ramd_log_error("initdb failed with exit code %d", result);
+		ramd_process_log_failure("initdb", &initdb_result);
 		return false;
 	}
 
@@ -891,10 +1288,10 @@ bool ramd_maintenance_bootstrap_new_node(
 	fclose(pg_hba_conf);
 
 	
-	if (!ramd_maintenance_take_basebackup_from_primary(
-	        node_data_dir, primary_host, primary_port))
+	if (!ramd_maintenance_seed_standby(config, node_data_dir, primary_host,
+	                                   primary_port))
 	{
-		ramd_log_error("Failed to take base backup from primary");
+		ramd_log_error("Failed to seed data directory for the new node");
 		return false;
 	}
 
@@ -912,6 +1309,81 @@ bool ramd_maintenance_bootstrap_new_node(
 
 
 
+/*
+ * Fill a new standby's data directory.  With bootstrap_backup_tool set the
+ * latest backup is restored from the repository through the backup job
+ * queue, configured to replay the WAL archive first: PostgreSQL switches
+ * to streaming from the primary only once restore_command runs out of
+ * archived WAL, so seeding the standby reads nothing from the primary.
+ * Otherwise a base backup is taken from the primary.
+ */
+static bool
+ramd_maintenance_seed_standby(const ramd_config_t* config, const char* data_dir,
+                              const char* primary_host, int32_t primary_port)
+{
+	ramd_backup_job_t job;
+	char error_message[512] = {0};
+	char path[RAMD_MAX_PATH_LENGTH];
+	int job_id = 0;
+
+	if (config->bootstrap_backup_tool[0] == '\0')
+		return ramd_maintenance_take_basebackup_from_primary(data_dir, primary_host,
+		                                                     primary_port);
+
+	ramd_log_info("Restoring latest %s backup into %s with %d processes",
+	              config->bootstrap_backup_tool, data_dir,
+	              config->bootstrap_restore_processes);
+
+	/* Both pgbackrest and barman refuse to restore over existing files */
+	if (!ramd_process_clear_directory(data_dir))
+	{
+		ramd_log_error("Cannot empty %s for the restore", data_dir);
+		return false;
+	}
+
+	if (!ramd_backup_restore_standby(config->bootstrap_backup_tool, "latest", data_dir,
+	                                 config->bootstrap_restore_processes, &job_id,
+	                                 error_message, sizeof(error_message)))
+	{
+		ramd_log_error("Cannot queue restore from %s: %s",
+		               config->bootstrap_backup_tool, error_message);
+		return false;
+	}
+
+	if (!ramd_backup_wait_job(job_id, RAMD_BOOTSTRAP_RESTORE_TIMEOUT_MS, &job))
+	{
+		ramd_log_error("Restore job %d did not finish in time; cancelling it", job_id);
+		ramd_backup_cancel_job(job_id, error_message, sizeof(error_message));
+		return false;
+	}
+
+	if (strcmp(job.status, "completed") != 0)
+	{
+		ramd_log_error("Restore job %d %s: %s", job_id, job.status, job.error_message);
+		return false;
+	}
+
+	/* barman and custom tools leave standby mode to us */
+	snprintf(path, sizeof(path), "%s/standby.signal", data_dir);
+	if (access(path, F_OK) != 0)
+	{
+		FILE* signal_file = fopen(path, "w");
+
+		if (!signal_file)
+		{
+			ramd_log_error("Failed to create %s: %s", path, strerror(errno));
+			return false;
+		}
+		fclose(signal_file);
+	}
+
+	ramd_log_info("Restored %s from the repository in %ld s; it replays the WAL "
+	              "archive before streaming from %s:%d",
+	              data_dir, (long) (job.end_time - job.start_time), primary_host,
+	              primary_port);
+	return true;
+}
+
 bool ramd_maintenance_take_basebackup_from_primary(const char* data_dir,
                                                    const char* primary_host,
                                                    int32_t primary_port)
@@ -1033,72 +1505,273 @@ bool ramd_maintenance_configure_recovery_for_primary(const char* data_dir,
 
 
 
+/*
+ * Whole-cluster bootstrap.  Every node lives under postgresql_data_dir on
+ * this host, the primary in <cluster_name> and standby i in standby_<i>,
+ * and the work overlaps wherever it can: standby directories are prepared
+ * while initdb runs, the pgraft extension is created on the new primary
+ * while the standbys are seeded, up to bootstrap_max_parallel seeds run at
+ * once, and each standby starts as soon as its own copy has landed.  With
+ * bootstrap_fanout one streamed base backup seeds up to
+ * 1 + RAMD_BASEBACKUP_MAX_MIRRORS standbys.
+ */
+typedef struct bootstrap_standby_t
+{
+	char data_dir[RAMD_MAX_PATH_LENGTH];
+	int32_t port;
+} bootstrap_standby_t;
+
+typedef struct bootstrap_run_t
+{
+	pthread_mutex_t lock; /* guards next and failed */
+	const ramd_config_t* config;
+	const char* cluster_name;
+	const char* primary_host;
+	int32_t primary_port;
+	bootstrap_standby_t standbys[RAMD_MAX_NODES];
+	int32_t standby_count;
+	int32_t group_size; /* standbys seeded by one base backup */
+	int32_t next;       /* first standby of the next group */
+	bool failed;
+	bool primary_ok;
+	bool pgraft_ok;
+} bootstrap_run_t;
+
+static bool
+bootstrap_start_instance(const ramd_config_t* config, const char* data_dir, int32_t port)
+{
+	char                  pg_ctl[RAMD_MAX_PATH_LENGTH];
+	char                  port_option[32];
+	const char*           argv[8];
+	ramd_process_result_t result;
+
+	snprintf(pg_ctl, sizeof(pg_ctl), "%s/pg_ctl", config->postgresql_bin_dir);
+	snprintf(port_option, sizeof(port_option), "-p %d", port);
+	argv[0] = pg_ctl;
+	argv[1] = "-D";
+	argv[2] = data_dir;
+	argv[3] = "-o";
+	argv[4] = port_option;
+	argv[5] = "-w";
+	argv[6] = "start";
+	argv[7] = NULL;
+
+	if (!ramd_process_run(argv, RAMD_PG_CTL_TIMEOUT_MS, &result))
+	{
+		ramd_process_log_failure("pg_ctl start", &result);
+		return false;
+	}
+	ramd_log_info("Started PostgreSQL in %s on port %d", data_dir, port);
+	return true;
+}
+
+static void*
+bootstrap_primary_thread(void* arg)
+{
+	bootstrap_run_t* run = arg;
+	char             data_dir[RAMD_MAX_PATH_LENGTH];
+
+	snprintf(data_dir, sizeof(data_dir), "%s/%s", run->config->postgresql_data_dir,
+	         run->cluster_name);
+	run->primary_ok = ramd_maintenance_bootstrap_primary_node(run->config, run->cluster_name,
+	                                                          run->primary_host,
+	                                                          run->primary_port) &&
+	                  bootstrap_start_instance(run->config, data_dir, run->primary_port);
+	return NULL;
+}
+
+static void*
+bootstrap_pgraft_thread(void* arg)
+{
+	bootstrap_run_t* run = arg;
+	PGconn*          conn;
+	PGresult*        res;
+
+	conn = ramd_conn_get(run->primary_host, run->primary_port, "postgres", "postgres", NULL);
+	if (!conn)
+	{
+		ramd_log_error("Cannot connect to the new primary to create the pgraft extension");
+		return NULL;
+	}
+	res = ramd_query_exec_with_result(conn, "CREATE EXTENSION IF NOT EXISTS pgraft");
+	run->pgraft_ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+	if (!run->pgraft_ok)
+		ramd_log_error("Failed to create pgraft extension: %s", PQerrorMessage(conn));
+	PQclear(res);
+	ramd_conn_close(conn);
+	return NULL;
+}
+
+/* Seed standbys [first, first + count) and start each of them */
+static bool
+bootstrap_seed_group(bootstrap_run_t* run, int32_t first, int32_t count)
+{
+	const char* mirrors[RAMD_BASEBACKUP_MAX_MIRRORS];
+	PGconn*     conn;
+	bool        ok;
+
+	if (count == 1)
+		ok = ramd_maintenance_seed_standby(run->config, run->standbys[first].data_dir,
+		                                   run->primary_host, run->primary_port);
+	else
+	{
+		for (int32_t i = 1; i < count; i++)
+			mirrors[i - 1] = run->standbys[first + i].data_dir;
+
+		conn = ramd_conn_get(run->primary_host, run->primary_port, "postgres", "postgres", NULL);
+		ok = conn && ramd_take_basebackup_fanout(conn, run->standbys[first].data_dir, mirrors,
+		                                         count - 1, "ramd_bootstrap") == 0;
+		ramd_conn_close(conn);
+	}
+	if (!ok)
+	{
+		ramd_log_error("Failed to seed standby %d%s", first + 1,
+		               count > 1 ? " and its mirrors" : "");
+		return false;
+	}
+
+	for (int32_t i = first; i < first + count; i++)
+		if (!bootstrap_start_instance(run->config, run->standbys[i].data_dir,
+		                              run->standbys[i].port))
+			return false;
+	return true;
+}
+
+static void*
+bootstrap_seed_thread(void* arg)
+{
+	bootstrap_run_t* run = arg;
+
+	pthread_mutex_lock(&run->lock);
+	while (!run->failed && run->next < run->standby_count)
+	{
+		int32_t first = run->next;
+		int32_t count = run->standby_count - first;
+		bool    ok;
+
+		if (count > run->group_size)
+			count = run->group_size;
+		run->next += count;
+		pthread_mutex_unlock(&run->lock);
+
+		ok = bootstrap_seed_group(run, first, count);
+
+		pthread_mutex_lock(&run->lock);
+		if (!ok)
+			run->failed = true;
+	}
+	pthread_mutex_unlock(&run->lock);
+	return NULL;
+}
+
 bool ramd_maintenance_bootstrap_cluster(
     const ramd_config_t* config, const char* cluster_name,
     const char* primary_host, int32_t primary_port, const char** standby_hosts,
     int32_t* standby_ports, int32_t standby_count)
 {
+	bootstrap_run_t* run;
+	pthread_t        primary_thread;
+	pthread_t        pgraft_thread;
+	pthread_t        seed_threads[RAMD_MAX_NODES];
+	int32_t          groups;
+	int32_t          workers = 0;
+	bool             pgraft_started;
+	bool             ok;
+	int64_t          started = ramd_clock_now_ms();
+	int64_t          deadline;
+
 	if (!config || !cluster_name || !primary_host || !standby_hosts ||
-	    !standby_ports)
+	    !standby_ports || standby_count < 0 || standby_count >= RAMD_MAX_NODES)
 		return false;
 
 	ramd_log_info("Bootstrapping complete cluster: %s with %d standby nodes",
 	              cluster_name, standby_count);
 
-	
-	if (!ramd_maintenance_bootstrap_primary_node(config, cluster_name,
-	                                             primary_host, primary_port))
-	{
-		ramd_log_error("Failed to bootstrap primary node");
-		return false;
-	}
+	run = calloc(1, sizeof(*run));
+	if (!run)
+		return false;
+	pthread_mutex_init(&run->lock, NULL);
+	run->config = config;
+	run->cluster_name = cluster_name;
+	run->primary_host = primary_host;
+	run->primary_port = primary_port;
+	run->standby_count = standby_count;
+	run->group_size = 1;
+	if (config->bootstrap_fanout && config->bootstrap_backup_tool[0] == '\0')
+		run->group_size = 1 + RAMD_BASEBACKUP_MAX_MIRRORS;
+
+	/* initdb runs while the standby directories are made ready for their copies */
+	if (pthread_create(&primary_thread, NULL, bootstrap_primary_thread, run) != 0)
+		bootstrap_primary_thread(run);
+	else
+		workers = 1;
 
-	
-	for (int i = 0; i < standby_count; i++)
+	ok = true;
+	for (int32_t i = 0; i < standby_count; i++)
 	{
-		char node_name[64];
-		snprintf(node_name, sizeof(node_name), "standby_%d", i + 1);
+		bootstrap_standby_t* standby = &run->standbys[i];
 
-		if (!ramd_maintenance_bootstrap_new_node(
-		        config, node_name, standby_hosts[i], standby_ports[i],
-		        primary_host, primary_port))
+		snprintf(standby->data_dir, sizeof(standby->data_dir), "%s/standby_%d",
+		         config->postgresql_data_dir, i + 1);
+		standby->port = standby_ports[i];
+		ramd_process_remove_tree(standby->data_dir);
+		if (!ramd_process_make_directory(standby->data_dir, 0700))
 		{
-			ramd_log_error("Failed to bootstrap standby node %d", i + 1);
-			return false;
+			ramd_log_error("Failed to create data directory %s", standby->data_dir);
+			ok = false;
 		}
 	}
 
-	
-	if (!ramd_maintenance_start_postgresql_node(config, primary_host,
-	                                            primary_port))
+	if (workers == 1)
+		pthread_join(primary_thread, NULL);
+	if (!run->primary_ok)
+		ramd_log_error("Failed to bootstrap primary node");
+	ok = ok && run->primary_ok;
+
+	if (ok)
 	{
-		ramd_log_error("Failed to start primary PostgreSQL node");
-		return false;
+		/* The extension is created while the standbys copy the primary */
+		pgraft_started = pthread_create(&pgraft_thread, NULL, bootstrap_pgraft_thread, run) == 0;
+		if (!pgraft_started)
+			bootstrap_pgraft_thread(run);
+
+		groups = (standby_count + run->group_size - 1) / run->group_size;
+		for (workers = 0; workers < groups && workers < config->bootstrap_max_parallel; workers++)
+			if (pthread_create(&seed_threads[workers], NULL, bootstrap_seed_thread, run) != 0)
+				break;
+		if (workers == 0)
+			bootstrap_seed_thread(run);
+		for (int32_t i = 0; i < workers; i++)
+			pthread_join(seed_threads[i], NULL);
+
+		if (pgraft_started)
+			pthread_join(pgraft_thread, NULL);
+		ok = !run->failed && run->pgraft_ok;
 	}
 
-	
-	for (int i = 0; i < standby_count; i++)
+	pthread_mutex_destroy(&run->lock);
+	free(run);
+	if (!ok)
+		return false;
+
+	ramd_log_info("Cluster %s seeded in %lld ms, waiting for every node",
+	              cluster_name, (long long) (ramd_clock_now_ms() - started));
+
+	deadline = ramd_clock_now_ms() + RAMD_BOOTSTRAP_READY_TIMEOUT_MS;
+	while (!ramd_maintenance_verify_cluster_health(config, primary_host, primary_port,
+	                                               standby_hosts, standby_ports,
+	                                               standby_count))
 	{
-		if (!ramd_maintenance_start_postgresql_node(config, standby_hosts[i],
-		                                            standby_ports[i]))
+		if (ramd_clock_now_ms() >= deadline)
 		{
-			ramd_log_error("Failed to start standby PostgreSQL node %d", i + 1);
+			ramd_log_error("Cluster health verification failed");
 			return false;
 		}
+		usleep(RAMD_BOOTSTRAP_READY_POLL_MS * 1000);
 	}
 
-	
-	sleep(10); 
-
-	if (!ramd_maintenance_verify_cluster_health(config, primary_host,
-	                                            primary_port, standby_hosts,
-	                                            standby_ports, standby_count))
-	{
-		ramd_log_error("Cluster health verification failed");
-		return false;
-	}
-
-	ramd_log_info("Cluster bootstrap completed successfully: %s", cluster_name);
+	ramd_log_info("Cluster bootstrap completed successfully: %s in %lld ms", cluster_name,
+	              (long long) (ramd_clock_now_ms() - started));
 	return true;
 }
 
@@ -1128,16 +1801,17 @@ bool ramd_maintenance_bootstrap_primary_node(const ramd_config_t* config,
 	}
 
 	
-	char initdb_cmd[RAMD_MAX_COMMAND_LENGTH];
-	snprintf(initdb_cmd, sizeof(initdb_cmd),
-	         "%s/initdb -D %s --auth=trust --encoding=UTF8 --locale=C",
-	         config->postgresql_bin_dir, primary_data_dir);
+	char initdb_path[RAMD_MAX_PATH_LENGTH];
+	snprintf(initdb_path, sizeof(initdb_path), "%s/initdb", config->postgresql_bin_dir);
 
-	ramd_log_info("Executing: %s", initdb_cmd);
-	int result = system(initdb_cmd);
-	if (result != 0)
+	const char* initdb_argv[] = {initdb_path, "-D", primary_data_dir, "--auth=trust",
+	                             "--encoding=UTF8", "--locale=C", NULL};
+	ramd_process_result_t initdb_result;
+
+	ramd_log_info("Executing: %s -D %s", initdb_path, primary_data_dir);
+	if (!ramd_process_run(initdb_argv, RAMD_DEFAULT_MAINTENANCE_TIMEOUT_MS, &initdb_result))
 	{
-		ramd_log_error("initdb failed with exit code %d", result);
+		ramd_process_log_failure("initdb", &initdb_result);
 		return false;
 	}
 
@@ -1222,16 +1896,19 @@ bool ramd_maintenance_start_postgresql_node(const ramd_config_t* config,
 	ramd_log_info("Starting PostgreSQL node on %s:%d", host, port);
 
 	
-	char start_cmd[1024];
-	snprintf(start_cmd, sizeof(start_cmd), "pg_ctl -D %s -o \"-p %d\" start",
-	         config->postgresql_data_dir, port);
+	char port_option[32];
+	snprintf(port_option, sizeof(port_option), "-p %d", port);
 
-	ramd_log_info("Executing: %s", start_cmd);
+	const char* start_argv[] = {"pg_ctl", "-D", config->postgresql_data_dir,
+	                            "-o", port_option, "start", NULL};
+	ramd_process_result_t start_result;
 
-	int result = system(start_cmd);
-	if (result != 0)
+	ramd_log_info("Executing: pg_ctl -D %s -o \"%s\" start",
+	              config->postgresql_data_dir, port_option);
+
+	if (!ramd_process_run(start_argv, RAMD_PG_CTL_TIMEOUT_MS, &start_result))
 	{
-		ramd_log_error("pg_ctl start failed with exit code %d", result);
+		ramd_process_log_failure("pg_ctl start", &start_result);
 		return false;
 	}
 
@@ -1437,33 +2114,24 @@ bool ramd_maintenance_setup_replica(const ramd_config_t* config,
 	ramd_log_info("Creating replica data directory: %s", replica_data_dir);
 
 	
-	char remove_cmd[1024];
-	snprintf(remove_cmd, sizeof(remove_cmd), "rm -rf %s", replica_data_dir);
-	int result = system(remove_cmd);
-	if (result != 0)
+	if (!ramd_process_remove_tree(replica_data_dir))
 	{
 		ramd_log_warning(
 		    "Failed to remove existing replica directory, continuing...");
 	}
 
 	
-	char mkdir_cmd[512];
-	snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p %s", replica_data_dir);
-	result = system(mkdir_cmd);
-	if (result != 0)
+	if (!ramd_process_make_directory(replica_data_dir, 0700))
 	{
 		ramd_log_error("Failed to create replica data directory");
 		return false;
 	}
 
 	
-	ramd_log_info("Taking base backup from primary %s:%d", primary_host,
-	              primary_port);
-
-	if (!ramd_maintenance_take_basebackup_from_primary(
-	        replica_data_dir, primary_host, primary_port))
+	if (!ramd_maintenance_seed_standby(config, replica_data_dir, primary_host,
+	                                   primary_port))
 	{
-		ramd_log_error("Failed to take base backup for replica");
+		ramd_log_error("Failed to seed data directory for replica");
 		return false;
 	}
 
@@ -1524,7 +2192,13 @@ bool ramd_maintenance_setup_replica(const ramd_config_t* config,
 	        "primary_conninfo = 'host=%s port=%d user=%s dbname=${POSTGRESQL_DATABASE}'\n",
 	        primary_host, primary_port, config->postgresql_user);
 	fprintf(auto_conf, "recovery_target_timeline = 'latest'\n");
-	fprintf(auto_conf, "primary_slot_name = 'replica_%d_slot'\n", node_id);
+	if (config->replication_slots_enabled)
+	{
+		char slot_name[64];
+
+		ramd_slots_name(node_id, slot_name, sizeof(slot_name));
+		fprintf(auto_conf, "primary_slot_name = '%s'\n", slot_name);
+	}
 
 	fclose(auto_conf);
 
@@ -1536,102 +2210,129 @@ bool ramd_maintenance_setup_replica(const ramd_config_t* config,
  * Check if backup is available
  */
 bool
-check_backup_availability(void)
+check_backup_availability(char* note, size_t note_size)
 {
-	
-	const char *backup_dir = g_ramd_daemon->config.backup_dir;
-	if (backup_dir == NULL) {
-		backup_dir = "{{VAR_DIR}}lib/postgresql/backups";
+	ramd_backup_verify_result_t result;
+	char backup_id[RAMD_BACKUP_VERIFY_ID_LENGTH];
+	char scratch[8];
+
+	if (!note)
+	{
+		note = scratch;
+		note_size = sizeof(scratch);
 	}
-	
-	if (access(backup_dir, R_OK | W_OK) != 0)
+	note[0] = '\0';
+
+	const char *backup_dir = g_ramd_daemon->config.backup_dir[0] ?
+	                         g_ramd_daemon->config.backup_dir : RAMD_BACKUP_DEFAULT_DIR;
+	bool native = strcmp(g_ramd_daemon->config.backup_verify_tool, "native") == 0;
+
+	if (native && access(backup_dir, R_OK | W_OK) != 0)
 	{
 		ramd_log_warning("Backup directory %s is not accessible: %s", 
 		                 backup_dir, strerror(errno));
+		snprintf(note, note_size, "Backup directory %s is not accessible. ", backup_dir);
 		return false;
 	}
 	
-	
-	if (system("which pg_basebackup > /dev/null 2>&1") != 0)
+	if (!ramd_backup_verify_latest(backup_id, sizeof(backup_id)))
 	{
-		ramd_log_warning("pg_basebackup is not available");
+		ramd_log_warning("No backup found in %s", backup_dir);
+		snprintf(note, note_size, "No backup found in %s. ", backup_dir);
 		return false;
 	}
-	
-	
-	char test_file[256];
-	snprintf(test_file, sizeof(test_file), "%s/test_backup_%ld", backup_dir, time(NULL));
-	
-	FILE *fp = fopen(test_file, "w");
-	if (fp == NULL)
+
+	/* Never read a backup here: the pre-check has seconds, a backup takes minutes */
+	switch (ramd_backup_verify_lookup(backup_id, &result))
 	{
-		ramd_log_warning("Cannot create test backup file in %s: %s", 
-		                 backup_dir, strerror(errno));
-		return false;
+	case RAMD_BACKUP_VERIFY_DONE:
+		if (!result.valid)
+		{
+			ramd_log_warning("Backup %s failed verification: %s", backup_id, result.message);
+			snprintf(note, note_size, "Backup %s failed verification: %s. ", backup_id,
+			         result.message);
+			return false;
+		}
+		snprintf(note, note_size, "Backup %s verified %lld s ago. ", backup_id,
+		         (long long) ((ramd_clock_now_ms() - result.verified_ms) / 1000));
+		return true;
+	case RAMD_BACKUP_VERIFY_RUNNING:
+		snprintf(note, note_size, "Backup %s is being verified. ", backup_id);
+		return true;
+	default:
+		if (ramd_backup_verify_request(backup_id))
+			snprintf(note, note_size, "Backup %s not verified yet; verification queued. ",
+			         backup_id);
+		else
+			snprintf(note, note_size, "Backup %s not verified. ", backup_id);
+		return true;
 	}
-	
-	fprintf(fp, "test backup availability\n");
-	fclose(fp);
-	
-	
-	unlink(test_file);
-	
-	ramd_log_info("Backup availability check passed");
-	return true;
 }
 
+
 /*
  * Check cluster health
  */
 bool
-check_cluster_health(void)
+check_cluster_health(const ramd_cluster_t* cluster)
 {
-	
-	if (!g_ramd_daemon || !g_ramd_daemon->cluster.node_count)
+	if (!cluster || !cluster->node_count)
 	{
 		ramd_log_warning("Cluster health check failed: no cluster data");
 		return false;
 	}
-	
-	
-	if (g_ramd_daemon->cluster.primary_node_id <= 0)
+
+	if (cluster->primary_node_id <= 0)
 	{
 		ramd_log_warning("Cluster health check failed: no primary node");
 		return false;
 	}
-	
-	
-	if (g_ramd_daemon->cluster.node_count < 1)
-	{
-		ramd_log_warning("Cluster health check failed: insufficient nodes");
-		return false;
-	}
-	
-	ramd_log_info("Cluster health check passed");
+
+	ramd_log_debug("Cluster health check passed");
 	return true;
 }
 
 /*
- * Check if all nodes are reachable
+ * Check that every other node answers; all are probed at once on one
+ * poll loop, so an unreachable host costs timeout_ms once, not per node
  */
 bool
-check_all_nodes_reachable(void)
+check_all_nodes_reachable(const ramd_cluster_t* cluster, int32_t timeout_ms)
 {
-	
-	if (!g_ramd_daemon || !g_ramd_daemon->cluster.node_count)
+	ramd_probe_engine_t* engine;
+	int32_t              expected = 0;
+	int32_t              healthy;
+
+	if (!cluster || !cluster->node_count)
+		return false;
+
+	for (int i = 0; i < cluster->node_count; i++)
+		if (cluster->nodes[i].node_id != g_ramd_daemon->config.node_id)
+			expected++;
+	if (expected == 0)
+		return true;
+
+	engine = malloc(sizeof(*engine));
+	if (!engine || !ramd_probe_init(engine, &g_ramd_daemon->config))
 	{
+		free(engine);
 		return false;
 	}
-	for (int i = 0; i < g_ramd_daemon->cluster.node_count; i++)
+	healthy = ramd_probe_run(engine, cluster, g_ramd_daemon->config.node_id, timeout_ms);
+	for (int32_t i = 0; healthy < expected && i < engine->target_count; i++)
 	{
-		ramd_node_t *node = &g_ramd_daemon->cluster.nodes[i];
-		if (!ping_node(node->hostname, node->port))
-		{
-			ramd_log_warning("Node %d (%s) is not reachable", node->node_id, node->hostname);
-			return false;
-		}
+		const ramd_probe_target_t* target = &engine->targets[i];
+
+		if (!target->healthy)
+			ramd_log_warning("Node %d (%s:%d) is not reachable: %s", target->node_id,
+			                 target->host, target->port, target->error);
 	}
-	ramd_log_info("All nodes reachability check passed");
+	ramd_probe_cleanup(engine);
+	free(engine);
+
+	if (healthy < expected)
+		return false;
+	ramd_log_debug("All nodes reachability check passed");
 	return true;
 }
 
@@ -1639,147 +2340,104 @@ check_all_nodes_reachable(void)
  * Check if there are sufficient standbys
  */
 bool
-check_sufficient_standbys(void)
+check_sufficient_standbys(const ramd_cluster_t* cluster)
 {
-	if (!g_ramd_daemon || !g_ramd_daemon->cluster.node_count)
-	{
-		return false;
-	}
-	
 	int standby_count = 0;
-	for (int i = 0; i < g_ramd_daemon->cluster.node_count; i++)
+
+	if (!cluster || !cluster->node_count)
+		return false;
+
+	for (int i = 0; i < cluster->node_count; i++)
 	{
-		ramd_node_t *node = &g_ramd_daemon->cluster.nodes[i];
-		if (node->node_id != g_ramd_daemon->cluster.primary_node_id && 
+		const ramd_node_t* node = &cluster->nodes[i];
+
+		if (node->node_id != cluster->primary_node_id &&
 		    (node->state == RAMD_NODE_STATE_PRIMARY || node->state == RAMD_NODE_STATE_STANDBY))
-		{
 			standby_count++;
-		}
 	}
-	
-	
+
 	if (standby_count < 1)
 	{
 		ramd_log_warning("Insufficient standbys for maintenance: %d", standby_count);
 		return false;
 	}
-	
-	ramd_log_info("Sufficient standbys check passed: %d standbys", standby_count);
+
+	ramd_log_debug("Sufficient standbys check passed: %d standbys", standby_count);
 	return true;
 }
 
 /*
- * Check if replication is current
+ * Check that no standby is far behind, from the lag sampler's latest
+ * pg_stat_replication reading rather than a connection per standby.  A
+ * standby the sampler has not seen yet does not fail the check.
  */
 bool
-check_replication_current(void)
+check_replication_current(const ramd_cluster_t* cluster)
 {
-	
-	if (!g_ramd_daemon || !g_ramd_daemon->cluster.node_count)
-	{
+	ramd_lag_stats_t stats;
+
+	if (!cluster || !cluster->node_count)
 		return false;
-	}
-	for (int i = 0; i < g_ramd_daemon->cluster.node_count; i++)
+
+	for (int i = 0; i < cluster->node_count; i++)
 	{
-		ramd_node_t *node = &g_ramd_daemon->cluster.nodes[i];
-		if (node->node_id != g_ramd_daemon->cluster.primary_node_id && node->state == RAMD_NODE_STATE_STANDBY)
+		const ramd_node_t* node = &cluster->nodes[i];
+
+		if (node->node_id == cluster->primary_node_id ||
+		    node->state != RAMD_NODE_STATE_STANDBY ||
+		    !ramd_lag_get_stats(node->node_id, &stats))
+			continue;
+		if (stats.last.replay_lag_bytes > RAMD_MAINTENANCE_PRECHECK_MAX_LAG_BYTES)
 		{
-			double lag = get_replication_lag(node);  // Real function to calculate lag
-			if (lag > 10.0) {
-				ramd_log_warning("Replication lag on node %d is %.2f seconds", node->node_id, lag);
-				return false;
-			}
+			ramd_log_warning("Replication lag on node %d is %lld bytes", node->node_id,
+			                 (long long) stats.last.replay_lag_bytes);
+			return false;
 		}
 	}
-	ramd_log_info("Replication current check passed");
+	ramd_log_debug("Replication current check passed");
 	return true;
 }
 
 /*
- * Check if there are no active transactions
+ * Check that no other session on the local server is running a query;
+ * *active_connections receives the active client sessions, -1 if the
+ * server could not be asked within timeout_ms
  */
 bool
-check_no_active_transactions(void)
-{
-	
-	char connection_string[512];
-	snprintf(connection_string, sizeof(connection_string),
-	         "host=%s port=%d dbname=%s user=%s password=%s",
-	         g_ramd_daemon->config.hostname,
-	         g_ramd_daemon->config.postgresql_port,
-	         g_ramd_daemon->config.database_name,
-	         g_ramd_daemon->config.database_user,
-	         g_ramd_daemon->config.database_password);
-	PGconn *conn = ramd_conn_get(g_ramd_daemon->config.hostname,
-	                             g_ramd_daemon->config.postgresql_port,
-	                             g_ramd_daemon->config.database_name,
-	                             g_ramd_daemon->config.database_user,
-	                             g_ramd_daemon->config.database_password);
+check_no_active_transactions(int32_t timeout_ms, int32_t* active_connections)
+{
+	const ramd_config_t* config = &g_ramd_daemon->config;
+	PGconn*              conn;
+	PGresult*            result;
+	bool                 no_active_transactions = false;
+
+	*active_connections = -1;
+	conn = ramd_conn_checkout(config->node_id, config->hostname, config->postgresql_port,
+	                          config->database_name, config->database_user,
+	                          config->database_password);
 	if (!conn)
 	{
 		ramd_log_warning("Cannot check active transactions: connection failed");
 		return false;
 	}
-	PGresult *result = ramd_conn_exec(conn, "SELECT count(*) FROM pg_stat_activity WHERE state = 'active' AND pid != pg_backend_pid()");
-	bool no_active_transactions = true;
-	if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
+
+	result = ramd_conn_exec_timeout(conn,
+	                                "SELECT count(*) FILTER (WHERE pid <> pg_backend_pid()), "
+	                                "count(*) FILTER (WHERE datname IS NOT NULL) "
+	                                "FROM pg_stat_activity WHERE state = 'active'",
+	                                timeout_ms);
+	if (result && PQresultStatus(result) == PGRES_TUPLES_OK && PQntuples(result) > 0)
 	{
 		int active_count = atoi(PQgetvalue(result, 0, 0));
-		if (active_count > 0)
-		{
+
+		*active_connections = atoi(PQgetvalue(result, 0, 1));
+		no_active_transactions = active_count == 0;
+		if (!no_active_transactions)
 			ramd_log_warning("Active transactions found: %d", active_count);
-			no_active_transactions = false;
-		}
 	}
 	else
-	{
 		ramd_log_warning("Failed to check active transactions");
-		no_active_transactions = false;
-	}
 	PQclear(result);
-	ramd_conn_close(conn);
-	ramd_log_info("No active transactions check %s", no_active_transactions ? "passed" : "failed");
+	ramd_conn_checkin(config->node_id, conn);
 	return no_active_transactions;
 }
-
-static bool ping_node(const char* hostname, int32_t port) {
-    int sock_fd;
-    struct sockaddr_in serv_addr;
-    struct hostent* server;
-    
-    if ((sock_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) return false;
-    server = gethostbyname(hostname);
-    if (server == NULL) {
-        close(sock_fd);
-        return false;
-    }
-    
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    memcpy(&serv_addr.sin_addr.s_addr, server->h_addr, server->h_length);
-    serv_addr.sin_port = htons(port);
-    
-    if (connect(sock_fd, (struct sockaddr*)&serv_addr, sizeof(serv_addr)) < 0) {
-        close(sock_fd);
-        return false;
-    }
-    close(sock_fd);
-    return true;
-}
-
-static double get_replication_lag(ramd_node_t* node) {
-    PGconn* conn = ramd_conn_get(node->hostname, node->port, 
-                                g_ramd_daemon->config.database_name,
-                                g_ramd_daemon->config.database_user, "");
-    if (!conn) {
-        return -1;  // Error value
-    }
-    PGresult* res = ramd_query_exec_with_result(conn, "SELECT pg_wal_lsn_diff(pg_current_wal_lsn(), pg_last_wal_replay_lsn()) / 1024.0 / 1024.0 AS lag_mb;");
-    double lag = 0;
-    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
-        lag = atof(PQgetvalue(res, 0, 0));  // Convert to double
-    }
-    PQclear(res);
-    ramd_conn_close(conn);
-    return lag;
-}
@@ -0,0 +1,418 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_memory.c
+ *		PostgreSQL Auto-Failover Daemon - Memory Accounting and Arenas
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Each subsystem has its own cache line of relaxed atomic counters, so
+ * threads charging different owners do not share one.  Sizes are what the
+ * allocator reports for the block rather than what was asked for, which
+ * is what shows up in RSS.  The exposition puts the process's resident
+ * size and the allocator's own totals next to them: a gap that keeps
+ * growing there while the subsystems stay flat is fragmentation or
+ * memory held by untagged code.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#define ramd_mem_block_size(ptr) malloc_size(ptr)
+#else
+#include <malloc.h>
+#define ramd_mem_block_size(ptr) malloc_usable_size((void*) (ptr))
+#endif
+
+#include "ramd_memory.h"
+#include "ramd_buffer.h"
+#include "ramd_defaults.h"
+
+typedef struct ramd_mem_counters_t
+{
+	alignas(RAMD_CACHE_LINE_SIZE) atomic_llong bytes;
+	atomic_llong peak_bytes;
+	atomic_llong allocations;
+	atomic_llong frees;
+} ramd_mem_counters_t;
+
+static ramd_mem_counters_t g_mem_counters[RAMD_MEM_SUBSYSTEM_COUNT];
+
+struct ramd_arena_chunk_t
+{
+	ramd_arena_chunk_t* next;
+	size_t size;         /* usable bytes after the header */
+	size_t used;
+	max_align_t data[];  /* keeps every allocation maximally aligned */
+};
+
+const char*
+ramd_mem_subsystem_to_string(ramd_mem_subsystem_t subsystem)
+{
+	switch (subsystem)
+	{
+		case RAMD_MEM_OTHER:
+			return "other";
+		case RAMD_MEM_HTTP:
+			return "http";
+		case RAMD_MEM_METRICS:
+			return "metrics";
+		case RAMD_MEM_BACKUP:
+			return "backup";
+		case RAMD_MEM_LOGGING:
+			return "logging";
+		case RAMD_MEM_PROXY:
+			return "proxy";
+		case RAMD_MEM_SUBSYSTEM_COUNT:
+			break;
+	}
+	return "unknown";
+}
+
+static ramd_mem_counters_t*
+ramd_mem_counters(ramd_mem_subsystem_t subsystem)
+{
+	if ((unsigned) subsystem >= RAMD_MEM_SUBSYSTEM_COUNT)
+		subsystem = RAMD_MEM_OTHER;
+	return &g_mem_counters[subsystem];
+}
+
+static void
+ramd_mem_charge(ramd_mem_subsystem_t subsystem, int64_t bytes, int64_t allocations,
+                int64_t frees)
+{
+	ramd_mem_counters_t* c = ramd_mem_counters(subsystem);
+	long long now;
+	long long peak;
+
+	now = atomic_fetch_add_explicit(&c->bytes, bytes, memory_order_relaxed) + bytes;
+	if (allocations)
+		atomic_fetch_add_explicit(&c->allocations, allocations, memory_order_relaxed);
+	if (frees)
+		atomic_fetch_add_explicit(&c->frees, frees, memory_order_relaxed);
+
+	peak = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+	while (now > peak &&
+	       !atomic_compare_exchange_weak_explicit(&c->peak_bytes, &peak, now,
+	                                              memory_order_relaxed, memory_order_relaxed))
+		;
+}
+
+void*
+ramd_mem_alloc(ramd_mem_subsystem_t subsystem, size_t size)
+{
+	void* ptr = malloc(size);
+
+	if (ptr)
+		ramd_mem_charge(subsystem, (int64_t) ramd_mem_block_size(ptr), 1, 0);
+	return ptr;
+}
+
+void*
+ramd_mem_calloc(ramd_mem_subsystem_t subsystem, size_t count, size_t size)
+{
+	void* ptr = calloc(count, size);
+
+	if (ptr)
+		ramd_mem_charge(subsystem, (int64_t) ramd_mem_block_size(ptr), 1, 0);
+	return ptr;
+}
+
+void*
+ramd_mem_realloc(ramd_mem_subsystem_t subsystem, void* ptr, size_t size)
+{
+	int64_t old_size = ptr ? (int64_t) ramd_mem_block_size(ptr) : 0;
+	void* new_ptr = realloc(ptr, size);
+
+	if (!new_ptr)
+		return NULL; /* the old block is untouched */
+	ramd_mem_charge(subsystem, (int64_t) ramd_mem_block_size(new_ptr) - old_size,
+	                ptr ? 0 : 1, 0);
+	return new_ptr;
+}
+
+char*
+ramd_mem_strdup(ramd_mem_subsystem_t subsystem, const char* s)
+{
+	size_t length;
+	char* copy;
+
+	if (!s)
+		return NULL;
+	length = strlen(s) + 1;
+	copy = ramd_mem_alloc(subsystem, length);
+	if (copy)
+		memcpy(copy, s, length);
+	return copy;
+}
+
+void
+ramd_mem_free(ramd_mem_subsystem_t subsystem, void* ptr)
+{
+	if (!ptr)
+		return;
+	ramd_mem_charge(subsystem, -(int64_t) ramd_mem_block_size(ptr), 0, 1);
+	free(ptr);
+}
+
+void
+ramd_mem_track(ramd_mem_subsystem_t subsystem, const void* ptr)
+{
+	if (ptr)
+		ramd_mem_charge(subsystem, (int64_t) ramd_mem_block_size(ptr), 1, 0);
+}
+
+void
+ramd_mem_untrack(ramd_mem_subsystem_t subsystem, const void* ptr)
+{
+	if (ptr)
+		ramd_mem_charge(subsystem, -(int64_t) ramd_mem_block_size(ptr), 0, 1);
+}
+
+void
+ramd_mem_account(ramd_mem_subsystem_t subsystem, int64_t bytes)
+{
+	ramd_mem_charge(subsystem, bytes, 0, 0);
+}
+
+void
+ramd_mem_get_stats(ramd_mem_subsystem_t subsystem, ramd_mem_stats_t* stats)
+{
+	ramd_mem_counters_t* c = ramd_mem_counters(subsystem);
+
+	if (!stats)
+		return;
+	stats->bytes = atomic_load_explicit(&c->bytes, memory_order_relaxed);
+	stats->peak_bytes = atomic_load_explicit(&c->peak_bytes, memory_order_relaxed);
+	stats->allocations = atomic_load_explicit(&c->allocations, memory_order_relaxed);
+	stats->frees = atomic_load_explicit(&c->frees, memory_order_relaxed);
+}
+
+/* Resident set size from /proc, -1 where there is none */
+static int64_t
+ramd_mem_resident_bytes(void)
+{
+	long long pages_total;
+	long long pages_resident;
+	FILE* file;
+	int n;
+
+	file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return -1;
+	n = fscanf(file, "%lld %lld", &pages_total, &pages_resident);
+	fclose(file);
+	if (n != 2)
+		return -1;
+	return (int64_t) pages_resident * (int64_t) sysconf(_SC_PAGESIZE);
+}
+
+bool
+ramd_mem_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_mem_stats_t stats[RAMD_MEM_SUBSYSTEM_COUNT];
+	int64_t resident;
+	bool ok = true;
+	int i;
+
+	if (!output)
+		return false;
+
+	for (i = 0; i < RAMD_MEM_SUBSYSTEM_COUNT; i++)
+		ramd_mem_get_stats((ramd_mem_subsystem_t) i, &stats[i]);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_memory_bytes Heap bytes held, by subsystem\n"
+		"# TYPE ramd_memory_bytes gauge\n");
+	for (i = 0; i < RAMD_MEM_SUBSYSTEM_COUNT; i++)
+		ok &= ramd_buffer_appendf(output, "ramd_memory_bytes{subsystem=\"%s\"} %lld\n",
+		                          ramd_mem_subsystem_to_string((ramd_mem_subsystem_t) i),
+		                          (long long) stats[i].bytes);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_memory_peak_bytes Most heap bytes held at once, by subsystem\n"
+		"# TYPE ramd_memory_peak_bytes gauge\n");
+	for (i = 0; i < RAMD_MEM_SUBSYSTEM_COUNT; i++)
+		ok &= ramd_buffer_appendf(output, "ramd_memory_peak_bytes{subsystem=\"%s\"} %lld\n",
+		                          ramd_mem_subsystem_to_string((ramd_mem_subsystem_t) i),
+		                          (long long) stats[i].peak_bytes);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_memory_allocations_total Blocks allocated, by subsystem\n"
+		"# TYPE ramd_memory_allocations_total counter\n");
+	for (i = 0; i < RAMD_MEM_SUBSYSTEM_COUNT; i++)
+		ok &= ramd_buffer_appendf(output, "ramd_memory_allocations_total{subsystem=\"%s\"} %lld\n",
+		                          ramd_mem_subsystem_to_string((ramd_mem_subsystem_t) i),
+		                          (long long) stats[i].allocations);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_memory_frees_total Blocks freed, by subsystem\n"
+		"# TYPE ramd_memory_frees_total counter\n");
+	for (i = 0; i < RAMD_MEM_SUBSYSTEM_COUNT; i++)
+		ok &= ramd_buffer_appendf(output, "ramd_memory_frees_total{subsystem=\"%s\"} %lld\n",
+		                          ramd_mem_subsystem_to_string((ramd_mem_subsystem_t) i),
+		                          (long long) stats[i].frees);
+
+	resident = ramd_mem_resident_bytes();
+	if (resident >= 0)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_process_resident_bytes Resident set size of the daemon\n"
+			"# TYPE ramd_process_resident_bytes gauge\n"
+			"ramd_process_resident_bytes %lld\n", (long long) resident);
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	{
+		struct mallinfo2 info = mallinfo2();
+
+		/* Free bytes are held by malloc for reuse and count towards RSS */
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_malloc_bytes Heap as seen by the allocator\n"
+			"# TYPE ramd_malloc_bytes gauge\n"
+			"ramd_malloc_bytes{state=\"in_use\"} %zu\n"
+			"ramd_malloc_bytes{state=\"free\"} %zu\n"
+			"ramd_malloc_bytes{state=\"mmapped\"} %zu\n",
+			info.uordblks, info.fordblks, info.hblkhd);
+	}
+#endif
+
+	ok &= ramd_buffer_appendf(output, "\n");
+	return ok;
+}
+
+void
+ramd_arena_init(ramd_arena_t* arena, ramd_mem_subsystem_t subsystem, size_t chunk_size)
+{
+	if (!arena)
+		return;
+	arena->subsystem = subsystem;
+	arena->chunk_size = chunk_size > 0 ? chunk_size : RAMD_ARENA_DEFAULT_CHUNK_SIZE;
+	arena->head = NULL;
+	arena->used = 0;
+}
+
+static ramd_arena_chunk_t*
+ramd_arena_add_chunk(ramd_arena_t* arena, size_t size)
+{
+	ramd_arena_chunk_t* chunk;
+
+	if (size < arena->chunk_size)
+		size = arena->chunk_size;
+	if (size > SIZE_MAX - sizeof(ramd_arena_chunk_t))
+		return NULL;
+
+	chunk = ramd_mem_alloc(arena->subsystem, sizeof(ramd_arena_chunk_t) + size);
+	if (!chunk)
+		return NULL;
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->next = arena->head;
+	arena->head = chunk;
+	return chunk;
+}
+
+void*
+ramd_arena_alloc(ramd_arena_t* arena, size_t size)
+{
+	const size_t align = alignof(max_align_t);
+	ramd_arena_chunk_t* chunk;
+	size_t rounded;
+	void* ptr;
+
+	if (!arena)
+		return NULL;
+	if (size == 0)
+		size = 1;
+	if (size > SIZE_MAX - align)
+		return NULL;
+	rounded = (size + align - 1) & ~(align - 1);
+
+	chunk = arena->head;
+	if (!chunk || chunk->size - chunk->used < rounded)
+	{
+		chunk = ramd_arena_add_chunk(arena, rounded);
+		if (!chunk)
+			return NULL;
+	}
+
+	ptr = (char*) chunk->data + chunk->used;
+	chunk->used += rounded;
+	arena->used += rounded;
+	return ptr;
+}
+
+void*
+ramd_arena_calloc(ramd_arena_t* arena, size_t count, size_t size)
+{
+	void* ptr;
+
+	if (size && count > SIZE_MAX / size)
+		return NULL;
+	ptr = ramd_arena_alloc(arena, count * size);
+	if (ptr)
+		memset(ptr, 0, count * size);
+	return ptr;
+}
+
+char*
+ramd_arena_strndup(ramd_arena_t* arena, const char* s, size_t length)
+{
+	char* copy;
+
+	if (!s)
+		return NULL;
+	copy = ramd_arena_alloc(arena, length + 1);
+	if (copy)
+	{
+		memcpy(copy, s, length);
+		copy[length] = '\0';
+	}
+	return copy;
+}
+
+void
+ramd_arena_reset(ramd_arena_t* arena)
+{
+	ramd_arena_chunk_t* chunk;
+
+	if (!arena || !arena->head)
+		return;
+
+	/* Keep the oldest chunk when it is a standard one; big one-offs go back */
+	while (arena->head->next)
+	{
+		chunk = arena->head;
+		arena->head = chunk->next;
+		ramd_mem_free(arena->subsystem, chunk);
+	}
+	if (arena->head->size > arena->chunk_size)
+	{
+		ramd_mem_free(arena->subsystem, arena->head);
+		arena->head = NULL;
+	}
+	else
+		arena->head->used = 0;
+	arena->used = 0;
+}
+
+void
+ramd_arena_destroy(ramd_arena_t* arena)
+{
+	ramd_arena_chunk_t* chunk;
+
+	if (!arena)
+		return;
+	while (arena->head)
+	{
+		chunk = arena->head;
+		arena->head = chunk->next;
+		ramd_mem_free(arena->subsystem, chunk);
+	}
+	arena->used = 0;
+}
@@ -11,6 +11,7 @@
 #include "ramd_metrics.h"
 #include "ramd_logging.h"
 #include "ramd_cluster.h"
+#include "ramd_clock.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,6 +21,64 @@
 
 ramd_metrics_t* g_ramd_metrics = NULL;
 
+/* Upper bounds of the HTTP latency buckets, in microseconds */
+static const int64_t g_http_bucket_bounds_us[RAMD_METRICS_HTTP_BUCKET_COUNT] = {
+	1000, 5000, 10000, 25000, 50000, 100000,
+	250000, 500000, 1000000, 2500000, 5000000, 10000000
+};
+
+/* Threads are spread over the shards round-robin on first use */
+static atomic_int g_next_shard = 0;
+static _Thread_local int t_shard = -1;
+
+static inline _Atomic int64_t* ramd_metrics_slot(ramd_metrics_t* metrics,
+                                                 ramd_metric_counter_t counter)
+{
+	if (t_shard < 0)
+		t_shard = atomic_fetch_add_explicit(&g_next_shard, 1, memory_order_relaxed) %
+		          RAMD_METRICS_SHARD_COUNT;
+	return &metrics->shards[t_shard].values[counter];
+}
+
+static inline void ramd_metrics_add(ramd_metrics_t* metrics,
+                                    ramd_metric_counter_t counter, int64_t delta)
+{
+	atomic_fetch_add_explicit(ramd_metrics_slot(metrics, counter), delta,
+	                          memory_order_relaxed);
+}
+
+/* Shards are cache-line aligned, so plain malloc() is not enough */
+ramd_metrics_t* ramd_metrics_create(void)
+{
+	ramd_metrics_t* metrics;
+	size_t size;
+
+	size = (sizeof(ramd_metrics_t) + RAMD_CACHE_LINE_SIZE - 1) &
+	       ~((size_t) RAMD_CACHE_LINE_SIZE - 1);
+	metrics = aligned_alloc(RAMD_CACHE_LINE_SIZE, size);
+	if (!metrics)
+	{
+		ramd_log_error("Failed to allocate metrics context");
+		return NULL;
+	}
+
+	if (!ramd_metrics_init(metrics))
+	{
+		free(metrics);
+		return NULL;
+	}
+	return metrics;
+}
+
+void ramd_metrics_destroy(ramd_metrics_t* metrics)
+{
+	if (!metrics)
+		return;
+
+	ramd_metrics_cleanup(metrics);
+	free(metrics);
+}
+
 bool ramd_metrics_init(ramd_metrics_t* metrics)
 {
 	if (!metrics)
@@ -29,19 +88,10 @@ bool ramd_metrics_init(ramd_metrics_t* metrics)
 
 	metrics->enabled = true;
 	metrics->collection_interval_ms = RAMD_METRICS_COLLECTION_INTERVAL_MS;
-	metrics->daemon_start_time = time(NULL);
+	metrics->daemon_start_ms = ramd_clock_now_ms();
 	metrics->last_metrics_update = time(NULL);
-	
-	
-	metrics->total_health_checks = 0;
-	metrics->failed_health_checks = 0;
-	metrics->total_failovers = 0;
-	metrics->total_promotions = 0;
-	metrics->total_demotions = 0;
-	metrics->http_requests_total = 0;
-	metrics->http_requests_2xx = 0;
-	metrics->http_requests_4xx = 0;
-	metrics->http_requests_5xx = 0;
+	for (int i = 0; i < RAMD_SWITCHOVER_PHASE_COUNT; i++)
+		atomic_init(&metrics->last_switchover_phase_ms[i], -1);
 	
 	ramd_log_info("Metrics collection subsystem initialized");
 	return true;
@@ -79,7 +129,7 @@ bool ramd_metrics_collect(ramd_metrics_t* metrics, const ramd_cluster_t* cluster
 		metrics->node_state = local_node->state;
 		metrics->node_role = local_node->role;
 		metrics->node_is_healthy = local_node->is_healthy;
-		metrics->node_last_seen = local_node->last_seen;
+		metrics->node_last_seen_ms = local_node->last_seen_ms;
 		metrics->node_health_score = local_node->health_score;
 		metrics->node_wal_lsn = local_node->wal_lsn;
 		metrics->node_replication_lag_ms = local_node->replication_lag_ms;
@@ -132,7 +182,7 @@ bool ramd_metrics_update_node(ramd_metrics_t* metrics, const ramd_node_t* node)
 		metrics->node_state = node->state;
 		metrics->node_role = node->role;
 		metrics->node_is_healthy = node->is_healthy;
-		metrics->node_last_seen = node->last_seen;
+		metrics->node_last_seen_ms = node->last_seen_ms;
 		metrics->node_health_score = node->health_score;
 		metrics->node_wal_lsn = node->wal_lsn;
 		metrics->node_replication_lag_ms = node->replication_lag_ms;
@@ -155,20 +205,144 @@ bool ramd_metrics_update_cluster(ramd_metrics_t* metrics, const ramd_cluster_t*
 	return true;
 }
 
-char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
+int64_t ramd_metrics_counter_total(const ramd_metrics_t* metrics,
+                                   ramd_metric_counter_t counter)
 {
+	int64_t total = 0;
+	int i;
+
+	if (!metrics || counter >= RAMD_METRIC_COUNT)
+		return 0;
+
+	for (i = 0; i < RAMD_METRICS_SHARD_COUNT; i++)
+		total += atomic_load_explicit(&metrics->shards[i].values[counter],
+		                              memory_order_relaxed);
+	return total;
+}
+
+/*
+ * Sum every counter across the shards.  Counters are read one at a time,
+ * so the totals are not an atomic snapshot, which Prometheus tolerates.
+ */
+void ramd_metrics_sum_counters(const ramd_metrics_t* metrics,
+                               int64_t totals[RAMD_METRIC_COUNT])
+{
+	int i;
+	int c;
+
+	memset(totals, 0, sizeof(int64_t) * RAMD_METRIC_COUNT);
 	if (!metrics)
-		return NULL;
-		
-	char* output = malloc(RAMD_MAX_COMMAND_LENGTH); 
-	if (!output)
-		return NULL;
-		
-	char* ptr = output;
-	size_t remaining = RAMD_MAX_COMMAND_LENGTH;
-	
-	
-	ptr += snprintf(ptr, remaining,
+		return;
+
+	for (i = 0; i < RAMD_METRICS_SHARD_COUNT; i++)
+		for (c = 0; c < RAMD_METRIC_COUNT; c++)
+			totals[c] += atomic_load_explicit(&metrics->shards[i].values[c],
+			                                  memory_order_relaxed);
+}
+
+static bool ramd_metrics_render_histogram(const int64_t totals[RAMD_METRIC_COUNT],
+                                          ramd_buffer_t* output)
+{
+	int64_t cumulative = 0;
+	bool ok = true;
+	int i;
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_http_request_duration_seconds HTTP request handling time\n"
+		"# TYPE ramd_http_request_duration_seconds histogram\n");
+	for (i = 0; i < RAMD_METRICS_HTTP_BUCKET_COUNT; i++)
+	{
+		cumulative += totals[RAMD_METRIC_HTTP_DURATION_BUCKET + i];
+		ok &= ramd_buffer_appendf(output,
+			"ramd_http_request_duration_seconds_bucket{le=\"%g\"} %lld\n",
+			(double) g_http_bucket_bounds_us[i] / 1e6, (long long) cumulative);
+	}
+	cumulative += totals[RAMD_METRIC_HTTP_DURATION_BUCKET + RAMD_METRICS_HTTP_BUCKET_COUNT];
+	ok &= ramd_buffer_appendf(output,
+		"ramd_http_request_duration_seconds_bucket{le=\"+Inf\"} %lld\n"
+		"ramd_http_request_duration_seconds_sum %.6f\n"
+		"ramd_http_request_duration_seconds_count %lld\n",
+		(long long) cumulative,
+		(double) totals[RAMD_METRIC_HTTP_DURATION_SUM_US] / 1e6,
+		(long long) cumulative);
+	return ok;
+}
+
+/* Request counters and the latency histogram, for the daemon exposition */
+bool ramd_metrics_render_http_latency(const ramd_metrics_t* metrics,
+                                      ramd_buffer_t* output)
+{
+	int64_t totals[RAMD_METRIC_COUNT];
+	bool ok = true;
+
+	if (!metrics || !output)
+		return false;
+
+	ramd_metrics_sum_counters(metrics, totals);
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_http_requests_total Total HTTP requests\n"
+		"# TYPE ramd_http_requests_total counter\n"
+		"ramd_http_requests_total %lld\n"
+		"# HELP ramd_http_requests_in_flight Current in-flight HTTP requests\n"
+		"# TYPE ramd_http_requests_in_flight gauge\n"
+		"ramd_http_requests_in_flight %lld\n",
+		(long long) totals[RAMD_METRIC_HTTP_REQUESTS],
+		(long long) totals[RAMD_METRIC_HTTP_IN_FLIGHT]);
+	ok &= ramd_metrics_render_histogram(totals, output);
+	return ok;
+}
+
+static bool ramd_metrics_render_drain(const ramd_metrics_t* metrics, ramd_buffer_t* output)
+{
+	int32_t node_id = atomic_load_explicit(&metrics->drain_node_id, memory_order_relaxed);
+	int32_t phase = atomic_load_explicit(&metrics->drain_phase, memory_order_relaxed);
+	int64_t initial = atomic_load_explicit(&metrics->drain_sessions_initial, memory_order_relaxed);
+	int64_t remaining = atomic_load_explicit(&metrics->drain_sessions_remaining,
+	                                         memory_order_relaxed);
+	bool ok = true;
+
+	if (node_id <= 0)
+		return true;
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_maintenance_drain_phase Phase of the current or last connection drain\n"
+		"# TYPE ramd_maintenance_drain_phase gauge\n");
+	for (int i = RAMD_DRAIN_PHASE_PAUSE_POOLER; i < RAMD_DRAIN_PHASE_COUNT; i++)
+		ok &= ramd_buffer_appendf(output,
+			"ramd_maintenance_drain_phase{node_id=\"%d\",phase=\"%s\"} %d\n",
+			node_id, ramd_maintenance_drain_phase_to_string((ramd_maintenance_drain_phase_t) i),
+			i == phase ? 1 : 0);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_maintenance_drain_sessions_remaining Sessions the drain still waits for\n"
+		"# TYPE ramd_maintenance_drain_sessions_remaining gauge\n"
+		"ramd_maintenance_drain_sessions_remaining{node_id=\"%d\"} %lld\n"
+		"# HELP ramd_maintenance_drain_sessions_terminated Idle sessions the drain terminated\n"
+		"# TYPE ramd_maintenance_drain_sessions_terminated gauge\n"
+		"ramd_maintenance_drain_sessions_terminated{node_id=\"%d\"} %lld\n"
+		"# HELP ramd_maintenance_drain_progress Share of the initially busy sessions gone (0.0-1.0)\n"
+		"# TYPE ramd_maintenance_drain_progress gauge\n"
+		"ramd_maintenance_drain_progress{node_id=\"%d\"} %.3f\n",
+		node_id, (long long) remaining,
+		node_id, (long long) atomic_load_explicit(&metrics->drain_sessions_terminated,
+		                                          memory_order_relaxed),
+		node_id, initial > 0 && remaining < initial ? 1.0 - (double) remaining / (double) initial
+		                                            : (remaining == 0 ? 1.0 : 0.0));
+	return ok;
+}
+
+bool ramd_metrics_render_prometheus(const ramd_metrics_t* metrics,
+                                    ramd_buffer_t* output)
+{
+	int64_t totals[RAMD_METRIC_COUNT];
+	bool ok = true;
+
+	if (!metrics || !output)
+		return false;
+
+	ramd_metrics_sum_counters(metrics, totals);
+
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_cluster_nodes_total Total number of nodes in cluster\n"
 		"# TYPE ramd_cluster_nodes_total gauge\n"
 		"ramd_cluster_nodes_total %d\n"
@@ -190,10 +364,7 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		metrics->cluster_is_leader ? 1 : 0,
 		metrics->cluster_primary_node_id);
 	
-	remaining -= (size_t)(ptr - output);
-	
-	
-	ptr += snprintf(ptr, remaining,
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_node_healthy Whether this node is healthy (1=yes, 0=no)\n"
 		"# TYPE ramd_node_healthy gauge\n"
 		"ramd_node_healthy{node_id=\"%d\",hostname=\"%s\"} %d\n"
@@ -211,10 +382,7 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		metrics->node_id, metrics->node_hostname, metrics->node_replication_lag_ms,
 		metrics->node_id, metrics->node_hostname, metrics->node_wal_lsn);
 	
-	remaining -= (size_t)(ptr - output);
-	
-	
-	ptr += snprintf(ptr, remaining,
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_health_checks_total Total number of health checks performed\n"
 		"# TYPE ramd_health_checks_total counter\n"
 		"ramd_health_checks_total %lld\n"
@@ -230,16 +398,55 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		"# HELP ramd_demotions_total Total number of node demotions\n"
 		"# TYPE ramd_demotions_total counter\n"
 		"ramd_demotions_total %lld\n",
-		metrics->total_health_checks,
-		metrics->failed_health_checks,
-		metrics->total_failovers,
-		metrics->total_promotions,
-		metrics->total_demotions);
-	
-	remaining -= (size_t)(ptr - output);
-	
+		(long long) totals[RAMD_METRIC_HEALTH_CHECKS],
+		(long long) totals[RAMD_METRIC_HEALTH_CHECKS_FAILED],
+		(long long) totals[RAMD_METRIC_FAILOVERS],
+		(long long) totals[RAMD_METRIC_PROMOTIONS],
+		(long long) totals[RAMD_METRIC_DEMOTIONS]);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_promotion_duration_seconds Time for a promotion to complete\n"
+		"# TYPE ramd_promotion_duration_seconds summary\n"
+		"ramd_promotion_duration_seconds_sum %.6f\n"
+		"ramd_promotion_duration_seconds_count %lld\n"
+		"# HELP ramd_last_promotion_duration_seconds Duration of the most recent promotion\n"
+		"# TYPE ramd_last_promotion_duration_seconds gauge\n"
+		"ramd_last_promotion_duration_seconds %.6f\n"
+		"# HELP ramd_promotions_pg_ctl_total Promotions that fell back to pg_ctl\n"
+		"# TYPE ramd_promotions_pg_ctl_total counter\n"
+		"ramd_promotions_pg_ctl_total %lld\n",
+		(double) totals[RAMD_METRIC_PROMOTION_DURATION_SUM_US] / 1e6,
+		(long long) totals[RAMD_METRIC_PROMOTIONS_TIMED],
+		(double) atomic_load_explicit(&metrics->last_promotion_duration_us,
+		                              memory_order_relaxed) / 1e6,
+		(long long) totals[RAMD_METRIC_PROMOTIONS_PG_CTL]);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_switchovers_total Planned switchovers started from this node\n"
+		"# TYPE ramd_switchovers_total counter\n"
+		"ramd_switchovers_total %lld\n"
+		"# HELP ramd_switchovers_failed_total Switchovers that failed or were rolled back\n"
+		"# TYPE ramd_switchovers_failed_total counter\n"
+		"ramd_switchovers_failed_total %lld\n"
+		"# HELP ramd_last_switchover_phase_seconds Phase durations of the most recent switchover\n"
+		"# TYPE ramd_last_switchover_phase_seconds gauge\n",
+		(long long) totals[RAMD_METRIC_SWITCHOVERS],
+		(long long) totals[RAMD_METRIC_SWITCHOVERS_FAILED]);
+	for (int i = 0; i < RAMD_SWITCHOVER_PHASE_COUNT; i++)
+	{
+		int64_t phase_ms = atomic_load_explicit(&metrics->last_switchover_phase_ms[i],
+		                                        memory_order_relaxed);
+
+		if (phase_ms >= 0)
+			ok &= ramd_buffer_appendf(output,
+				"ramd_last_switchover_phase_seconds{phase=\"%s\"} %.3f\n",
+				ramd_switchover_phase_to_string((ramd_switchover_phase_t) i),
+				(double) phase_ms / 1e3);
+	}
 	
-	ptr += snprintf(ptr, remaining,
+	ok &= ramd_metrics_render_drain(metrics, output);
+
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_http_requests_total Total number of HTTP requests\n"
 		"# TYPE ramd_http_requests_total counter\n"
 		"ramd_http_requests_total %lld\n"
@@ -252,15 +459,13 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		"# HELP ramd_http_requests_5xx Total number of 5xx HTTP responses\n"
 		"# TYPE ramd_http_requests_5xx counter\n"
 		"ramd_http_requests_5xx %lld\n",
-		metrics->http_requests_total,
-		metrics->http_requests_2xx,
-		metrics->http_requests_4xx,
-		metrics->http_requests_5xx);
-	
-	remaining -= (size_t)(ptr - output);
-	
+		(long long) totals[RAMD_METRIC_HTTP_REQUESTS],
+		(long long) totals[RAMD_METRIC_HTTP_2XX],
+		(long long) totals[RAMD_METRIC_HTTP_4XX],
+		(long long) totals[RAMD_METRIC_HTTP_5XX]);
+	ok &= ramd_metrics_render_histogram(totals, output);
 	
-	ptr += snprintf(ptr, remaining,
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_replication_lag_max_ms Maximum replication lag in milliseconds\n"
 		"# TYPE ramd_replication_lag_max_ms gauge\n"
 		"ramd_replication_lag_max_ms %d\n"
@@ -278,10 +483,7 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		metrics->replication_connections_active,
 		metrics->replication_connections_total);
 	
-	remaining -= (size_t)(ptr - output);
-	
-	
-	ptr += snprintf(ptr, remaining,
+	ok &= ramd_buffer_appendf(output,
 		"# HELP ramd_memory_usage_bytes Memory usage in bytes\n"
 		"# TYPE ramd_memory_usage_bytes gauge\n"
 		"ramd_memory_usage_bytes %zu\n"
@@ -289,20 +491,28 @@ char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
 		"# TYPE ramd_daemon_uptime_seconds gauge\n"
 		"ramd_daemon_uptime_seconds %ld\n",
 		metrics->memory_usage_bytes,
-		time(NULL) - metrics->daemon_start_time);
-	
-	
-	*ptr = '\n';
-	ptr++;
-	*ptr = '\0';
-	
-	return output;
+		(long) ((ramd_clock_now_ms() - metrics->daemon_start_ms) / 1000));
+	ok &= ramd_buffer_append(output, "\n", 1);
+
+	return ok;
+}
+
+char* ramd_metrics_to_prometheus(const ramd_metrics_t* metrics)
+{
+	ramd_buffer_t output;
+
+	ramd_buffer_init_subsystem(&output, RAMD_MEM_METRICS);
+	if (!ramd_metrics_render_prometheus(metrics, &output))
+	{
+		ramd_buffer_free(&output);
+		return NULL;
+	}
+	return ramd_buffer_detach(&output);
 }
 
 void ramd_metrics_free_prometheus_output(char* output)
 {
-	if (output)
-		free(output);
+	ramd_mem_free(RAMD_MEM_METRICS, output);
 }
 
 
@@ -311,9 +521,9 @@ void ramd_metrics_increment_health_checks(ramd_metrics_t* metrics, bool success)
 	if (!metrics)
 		return;
 		
-	metrics->total_health_checks++;
+	ramd_metrics_add(metrics, RAMD_METRIC_HEALTH_CHECKS, 1);
 	if (!success)
-		metrics->failed_health_checks++;
+		ramd_metrics_add(metrics, RAMD_METRIC_HEALTH_CHECKS_FAILED, 1);
 }
 
 void ramd_metrics_increment_failovers(ramd_metrics_t* metrics)
@@ -321,7 +531,7 @@ void ramd_metrics_increment_failovers(ramd_metrics_t* metrics)
 	if (!metrics)
 		return;
 		
-	metrics->total_failovers++;
+	ramd_metrics_add(metrics, RAMD_METRIC_FAILOVERS, 1);
 	metrics->last_failover_time = time(NULL);
 }
 
@@ -330,33 +540,112 @@ void ramd_metrics_increment_promotions(ramd_metrics_t* metrics)
 	if (!metrics)
 		return;
 		
-	metrics->total_promotions++;
+	ramd_metrics_add(metrics, RAMD_METRIC_PROMOTIONS, 1);
 	metrics->last_promotion_time = time(NULL);
 }
 
+/* Time from issuing a promotion until the server left recovery */
+void ramd_metrics_observe_promotion(ramd_metrics_t* metrics, int64_t duration_us,
+                                    bool via_sql)
+{
+	if (!metrics)
+		return;
+
+	ramd_metrics_add(metrics, RAMD_METRIC_PROMOTIONS_TIMED, 1);
+	ramd_metrics_add(metrics, RAMD_METRIC_PROMOTION_DURATION_SUM_US, duration_us);
+	if (!via_sql)
+		ramd_metrics_add(metrics, RAMD_METRIC_PROMOTIONS_PG_CTL, 1);
+	atomic_store_explicit(&metrics->last_promotion_duration_us, duration_us,
+	                      memory_order_relaxed);
+}
+
+/* remaining counts sessions still running a query or holding a transaction */
+void ramd_metrics_observe_drain(ramd_metrics_t* metrics, int32_t node_id,
+                                ramd_maintenance_drain_phase_t phase, int64_t initial,
+                                int64_t remaining, int64_t terminated)
+{
+	if (!metrics)
+		return;
+
+	atomic_store_explicit(&metrics->drain_sessions_initial, initial, memory_order_relaxed);
+	atomic_store_explicit(&metrics->drain_sessions_remaining, remaining, memory_order_relaxed);
+	atomic_store_explicit(&metrics->drain_sessions_terminated, terminated, memory_order_relaxed);
+	atomic_store_explicit(&metrics->drain_phase, (int32_t) phase, memory_order_relaxed);
+	atomic_store_explicit(&metrics->drain_node_id, node_id, memory_order_relaxed);
+}
+
+/* Phases that did not run are -1 and drop out of the exposition */
+void ramd_metrics_observe_switchover(ramd_metrics_t* metrics,
+                                     const int64_t phase_ms[RAMD_SWITCHOVER_PHASE_COUNT],
+                                     bool succeeded)
+{
+	if (!metrics)
+		return;
+
+	ramd_metrics_add(metrics, RAMD_METRIC_SWITCHOVERS, 1);
+	if (!succeeded)
+		ramd_metrics_add(metrics, RAMD_METRIC_SWITCHOVERS_FAILED, 1);
+	for (int i = 0; i < RAMD_SWITCHOVER_PHASE_COUNT; i++)
+		atomic_store_explicit(&metrics->last_switchover_phase_ms[i], phase_ms[i],
+		                      memory_order_relaxed);
+}
+
 void ramd_metrics_increment_demotions(ramd_metrics_t* metrics)
 {
 	if (!metrics)
 		return;
 		
-	metrics->total_demotions++;
+	ramd_metrics_add(metrics, RAMD_METRIC_DEMOTIONS, 1);
 	metrics->last_demotion_time = time(NULL);
 }
 
+static void ramd_metrics_observe_http(ramd_metrics_t* metrics, int status_code,
+                                      int64_t duration_us)
+{
+	int bucket;
+
+	if (duration_us < 0)
+		duration_us = 0;
+	for (bucket = 0; bucket < RAMD_METRICS_HTTP_BUCKET_COUNT; bucket++)
+		if (duration_us <= g_http_bucket_bounds_us[bucket])
+			break;
+
+	ramd_metrics_add(metrics, RAMD_METRIC_HTTP_REQUESTS, 1);
+	ramd_metrics_add(metrics, RAMD_METRIC_HTTP_DURATION_SUM_US, duration_us);
+	ramd_metrics_add(metrics, (ramd_metric_counter_t) (RAMD_METRIC_HTTP_DURATION_BUCKET + bucket), 1);
+
+	if (status_code >= 200 && status_code < 300)
+		ramd_metrics_add(metrics, RAMD_METRIC_HTTP_2XX, 1);
+	else if (status_code >= 400 && status_code < 500)
+		ramd_metrics_add(metrics, RAMD_METRIC_HTTP_4XX, 1);
+	else if (status_code >= 500)
+		ramd_metrics_add(metrics, RAMD_METRIC_HTTP_5XX, 1);
+}
+
 void ramd_metrics_update_http_request(ramd_metrics_t* metrics, int status_code, int duration_ms)
 {
 	if (!metrics)
 		return;
 		
-	metrics->http_requests_total++;
-	metrics->http_request_duration_ms = duration_ms;
-	
-	if (status_code >= 200 && status_code < 300)
-		metrics->http_requests_2xx++;
-	else if (status_code >= 400 && status_code < 500)
-		metrics->http_requests_4xx++;
-	else if (status_code >= 500)
-		metrics->http_requests_5xx++;
+	ramd_metrics_observe_http(metrics, status_code, (int64_t) duration_ms * 1000);
+}
+
+void ramd_metrics_http_request_started(ramd_metrics_t* metrics)
+{
+	if (!metrics)
+		return;
+
+	ramd_metrics_add(metrics, RAMD_METRIC_HTTP_IN_FLIGHT, 1);
+}
+
+void ramd_metrics_http_request_finished(ramd_metrics_t* metrics, int status_code,
+                                        int64_t duration_us)
+{
+	if (!metrics)
+		return;
+
+	ramd_metrics_add(metrics, RAMD_METRIC_HTTP_IN_FLIGHT, -1);
+	ramd_metrics_observe_http(metrics, status_code, duration_us);
 }
 
 void ramd_metrics_update_replication_lag(ramd_metrics_t* metrics, int32_t lag_ms)
@@ -7,7 +7,6 @@
 
 #include "ramd.h"
 #include "ramd_cluster_management.h"
-#include "ramd_backup.h"
 #include "ramd_sync_standbys.h"
 
 #include <stdio.h>
@@ -16,13 +15,6 @@
 
 /* Stub implementations for missing API handlers */
 
-bool ramd_api_handle_backup_jobs(ramd_http_request_t* request, ramd_http_response_t* response) {
-    (void) request;
-    response->status = 200;
-    strcpy(response->body, "{\"jobs\":[]}");
-    return true;
-}
-
 bool ramd_api_handle_cluster_accounting(ramd_http_request_t* request, ramd_http_response_t* response) {
     (void) request;
     response->status = 200;
@@ -688,11 +680,6 @@ bool ramd_api_handle_parameter_validate(ramd_http_request_t* request, ramd_http_
     return true;
 }
 
-/* Backup functions */
-bool ramd_backup_init(void) {
-    return true;
-}
-
 /* Sync standbys functions */
 bool ramd_sync_standbys_init(void) {
     return true;
@@ -8,26 +8,259 @@
  *-------------------------------------------------------------------------
  */
 
+#include <errno.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "ramd_monitor.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_detector.h"
 #include "ramd_logging.h"
+#include "ramd_metrics.h"
+#include "ramd_sysmon.h"
+#include "ramd_watch.h"
 
 extern PGconn *g_conn;
 
+/* Upper bounds of the cycle and step duration buckets, in microseconds */
+static const int64_t g_monitor_bucket_bounds_us[RAMD_MONITOR_CYCLE_BUCKET_COUNT] = {
+	1000, 5000, 10000, 25000, 50000, 100000, 250000,
+	500000, 1000000, 2500000, 5000000, 10000000
+};
+
+static const char *const g_monitor_step_names[RAMD_MONITOR_STEP_COUNT] = {
+	"consensus", "local", "remote", "leadership", "role_changes", "publish"
+};
+
+static int
+ramd_monitor_bucket(int64_t duration_us)
+{
+	int bucket;
+
+	for (bucket = 0; bucket < RAMD_MONITOR_CYCLE_BUCKET_COUNT; bucket++)
+		if (duration_us <= g_monitor_bucket_bounds_us[bucket])
+			break;
+	return bucket;
+}
+
+/* Microseconds since *mark_us, which moves to now */
+static int64_t
+ramd_monitor_lap(int64_t *mark_us)
+{
+	int64_t now_us = ramd_clock_now_us();
+	int64_t elapsed = now_us - *mark_us;
+
+	*mark_us = now_us;
+	return elapsed;
+}
+
+/*
+ * Sleep until the ramd_clock time at_us (CLOCK_MONOTONIC, which wake_cond
+ * waits on, unless a simulator has replaced it), or until ramd_monitor_wake
+ * or ramd_monitor_stop; true if it was a wake
+ */
+static bool
+ramd_monitor_sleep_until(ramd_monitor_t *monitor, int64_t at_us)
+{
+	struct timespec ts;
+	bool            woken;
+
+	ts.tv_sec = (time_t) (at_us / 1000000);
+	ts.tv_nsec = (long) (at_us % 1000000) * 1000;
+
+	pthread_mutex_lock(&monitor->wake_lock);
+	while (!monitor->wake_requested && monitor->running)
+	{
+		if (pthread_cond_timedwait(&monitor->wake_cond, &monitor->wake_lock, &ts) == ETIMEDOUT)
+			break;
+	}
+	woken = monitor->wake_requested;
+	monitor->wake_requested = false;
+	pthread_mutex_unlock(&monitor->wake_lock);
+	return woken;
+}
+
+static void
+ramd_monitor_local_disconnect(ramd_monitor_t *monitor)
+{
+	if (monitor->local_connection.connection)
+		ramd_postgresql_disconnect(&monitor->local_connection);
+	monitor->local_prepared = false;
+	monitor->local_published_load = -1;
+}
+
+/*
+ * Name the local session after this host's load for the status query to
+ * pick up (see RAMD_POSTGRESQL_LOAD_PREFIX).  It is renamed only when the
+ * load has moved by RAMD_SYSMON_PUBLISH_STEP or crossed into or out of
+ * saturation, so most cycles cost nothing.
+ */
+static void
+ramd_monitor_local_publish_load(ramd_monitor_t *monitor, PGconn *conn)
+{
+	int32_t   load = ramd_sysmon_load();
+	int32_t   published = monitor->local_published_load;
+	char      sql[64];
+	PGresult *res;
+
+	if (load < 0)
+		return;
+	if (published >= 0 && abs(load - published) < RAMD_SYSMON_PUBLISH_STEP &&
+	    ramd_sysmon_load_is_saturated(load) == ramd_sysmon_load_is_saturated(published))
+		return;
+
+	snprintf(sql, sizeof(sql), "SET application_name = '" RAMD_POSTGRESQL_LOAD_PREFIX "%d'",
+	         load);
+	res = PQexec(conn, sql);
+	if (PQresultStatus(res) == PGRES_COMMAND_OK)
+		monitor->local_published_load = load;
+	else
+		ramd_log_debug("Local load publication failed: %s", PQerrorMessage(conn));
+	PQclear(res);
+}
+
+/*
+ * Make sure the persistent local session is usable.  A new connection is
+ * only attempted once PQstatus reports the old one broken, and then no more
+ * often than the current backoff allows.
+ */
+static bool
+ramd_monitor_local_ensure(ramd_monitor_t *monitor)
+{
+	ramd_postgresql_connection_t *conn = &monitor->local_connection;
+	PGresult                     *res;
+	int64_t                       now_ms;
+
+	if (conn->is_connected && conn->connection &&
+	    PQstatus((PGconn *) conn->connection) == CONNECTION_OK &&
+	    monitor->local_prepared)
+		return true;
+
+	ramd_monitor_local_disconnect(monitor);
+
+	now_ms = ramd_clock_now_ms();
+	if (now_ms < monitor->local_retry_at_ms)
+		return false;
+
+	if (ramd_postgresql_connect(conn, monitor->config->hostname,
+	                            monitor->config->postgresql_port,
+	                            monitor->config->database_name,
+	                            monitor->config->database_user,
+	                            monitor->config->database_password))
+	{
+		res = PQprepare((PGconn *) conn->connection, RAMD_POSTGRESQL_STATUS_STMT,
+		                RAMD_POSTGRESQL_STATUS_SQL, 0, NULL);
+		if (PQresultStatus(res) == PGRES_COMMAND_OK)
+		{
+			PQclear(res);
+			conn->status_prepared = true;
+			monitor->local_prepared = true;
+			monitor->local_backoff_ms = 0;
+			monitor->local_retry_at_ms = 0;
+			return true;
+		}
+
+		ramd_log_error("Failed to prepare local status statement: %s",
+		               PQerrorMessage((PGconn *) conn->connection));
+		PQclear(res);
+		ramd_monitor_local_disconnect(monitor);
+	}
+
+	if (monitor->local_backoff_ms == 0)
+		monitor->local_backoff_ms = RAMD_LOCAL_RECONNECT_MIN_MS;
+	else if (monitor->local_backoff_ms < RAMD_LOCAL_RECONNECT_MAX_MS / 2)
+		monitor->local_backoff_ms *= 2;
+	else
+		monitor->local_backoff_ms = RAMD_LOCAL_RECONNECT_MAX_MS;
+	monitor->local_retry_at_ms = now_ms + monitor->local_backoff_ms;
+
+	ramd_log_debug("Local PostgreSQL reconnect backing off for %d ms",
+	               monitor->local_backoff_ms);
+	return false;
+}
+
+/*
+ * Ping the idle local session between cycles so a dead server or a
+ * middlebox that dropped the connection is noticed before the next check.
+ */
+static void
+ramd_monitor_local_keepalive(ramd_monitor_t *monitor)
+{
+	PGresult *res;
+	PGconn   *conn;
+
+	pthread_mutex_lock(&monitor->local_lock);
+	if (!monitor->local_connection.is_connected || !monitor->local_connection.connection)
+	{
+		pthread_mutex_unlock(&monitor->local_lock);
+		return;
+	}
+
+	conn = (PGconn *) monitor->local_connection.connection;
+	res = PQexec(conn, "");
+	if (PQresultStatus(res) != PGRES_EMPTY_QUERY)
+		ramd_log_debug("Local PostgreSQL keepalive failed: %s", PQerrorMessage(conn));
+	else
+		monitor->local_connection.last_activity_ms = ramd_clock_now_ms();
+	PQclear(res);
+	pthread_mutex_unlock(&monitor->local_lock);
+}
+
+/*
+ * Promotion is the most latency-critical thing ramd does, so it goes over
+ * the session the monitor already holds: pg_promote() with wait returns
+ * once the server accepts writes, with no process to spawn and nothing to
+ * poll.  Without a usable session ramd_postgresql_promote_local falls back
+ * to pg_ctl.
+ */
+bool
+ramd_monitor_promote_local(ramd_monitor_t *monitor)
+{
+	PGconn *conn = NULL;
+	bool    ok;
+
+	if (!monitor || !monitor->config)
+		return false;
+
+	pthread_mutex_lock(&monitor->local_lock);
+	if (ramd_monitor_local_ensure(monitor))
+		conn = (PGconn *) monitor->local_connection.connection;
+	ok = ramd_postgresql_promote_local(monitor->config, conn);
+	pthread_mutex_unlock(&monitor->local_lock);
+
+	return ok;
+}
+
 bool
 ramd_monitor_init(ramd_monitor_t *monitor, ramd_cluster_t *cluster,
                  const ramd_config_t *config)
 {
+	pthread_condattr_t cond_attr;
+
 	if (!monitor || !cluster || !config)
 		return false;
 
 	memset(monitor, 0, sizeof(ramd_monitor_t));
+	pthread_mutex_init(&monitor->local_lock, NULL);
+	pthread_mutex_init(&monitor->stats_lock, NULL);
+	pthread_mutex_init(&monitor->wake_lock, NULL);
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&monitor->wake_cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
 
 	monitor->enabled = true;
 	monitor->cluster = cluster;
 	monitor->config = config;
 	monitor->check_interval_ms = config->monitor_interval_ms;
 	monitor->health_check_timeout_ms = config->health_check_timeout_ms;
+	monitor->local_published_load = -1;
+
+	if (!ramd_probe_init(&monitor->probes, config))
+		return false;
 
 	ramd_log_info("Database monitoring subsystem initialized successfully for cluster '%s'",
 	              cluster->cluster_name);
@@ -41,6 +274,12 @@ ramd_monitor_cleanup(ramd_monitor_t *monitor)
 		return;
 
 	ramd_log_info("Cleaning up monitor");
+	ramd_probe_cleanup(&monitor->probes);
+	ramd_monitor_local_disconnect(monitor);
+	pthread_mutex_destroy(&monitor->local_lock);
+	pthread_mutex_destroy(&monitor->stats_lock);
+	pthread_cond_destroy(&monitor->wake_cond);
+	pthread_mutex_destroy(&monitor->wake_lock);
 	memset(monitor, 0, sizeof(ramd_monitor_t));
 }
 
@@ -55,13 +294,14 @@ ramd_monitor_start(ramd_monitor_t *monitor)
 
 	ramd_log_info("Starting monitor thread");
 
+	/* Set first: the thread's loop and sleeps test it */
+	monitor->running = true;
 	if (pthread_create(&monitor->thread, NULL, ramd_monitor_thread_main, monitor) != 0)
 	{
+		monitor->running = false;
 		ramd_log_error("Failed to create monitor thread");
 		return false;
 	}
-
-	monitor->running = true;
 	return true;
 }
 
@@ -73,23 +313,92 @@ ramd_monitor_stop(ramd_monitor_t *monitor)
 
 	ramd_log_info("Stopping monitor thread");
 
+	pthread_mutex_lock(&monitor->wake_lock);
 	monitor->running = false;
+	pthread_cond_signal(&monitor->wake_cond);
+	pthread_mutex_unlock(&monitor->wake_lock);
 	pthread_join(monitor->thread, NULL);
 }
 
+void
+ramd_monitor_wake(ramd_monitor_t *monitor)
+{
+	if (!monitor)
+		return;
+
+	pthread_mutex_lock(&monitor->wake_lock);
+	monitor->wake_requested = true;
+	pthread_cond_signal(&monitor->wake_cond);
+	pthread_mutex_unlock(&monitor->wake_lock);
+}
+
+/*
+ * Cycles start at fixed times, one interval apart, so the time a check
+ * takes does not stretch the period and detection latency stays bounded
+ * by the interval.  A cycle that runs past its successor's start time is
+ * followed at once, and the schedule restarts from there rather than
+ * bursting to catch up on the starts it missed.  A wake (a Raft leader
+ * change, say) starts a cycle at once and restarts the schedule the same
+ * way.
+ */
 void*
 ramd_monitor_thread_main(void *arg)
 {
 	ramd_monitor_t *monitor;
+	int64_t         interval_us;
+	int64_t         scheduled_us;
+	int64_t         now_us;
+	int64_t         missed;
+	bool            woken;
 
 	monitor = (ramd_monitor_t *) arg;
 
 	ramd_log_info("Monitor thread started");
 
+	scheduled_us = ramd_clock_now_us();
 	while (monitor->running)
 	{
+		interval_us = (int64_t) monitor->check_interval_ms * 1000;
+		if (interval_us <= 0)
+			interval_us = (int64_t) RAMD_MONITOR_INTERVAL_MS * 1000;
+
+		pthread_mutex_lock(&monitor->stats_lock);
+		monitor->stats.last_start_lag_us = ramd_clock_now_us() - scheduled_us;
+		pthread_mutex_unlock(&monitor->stats_lock);
+
 		ramd_monitor_run_cycle(monitor);
-		usleep((useconds_t) (monitor->check_interval_ms * 1000));
+
+		now_us = ramd_clock_now_us();
+		scheduled_us += interval_us;
+		if (now_us >= scheduled_us)
+		{
+			missed = (now_us - scheduled_us) / interval_us;
+			pthread_mutex_lock(&monitor->stats_lock);
+			monitor->stats.missed_cycles += missed;
+			pthread_mutex_unlock(&monitor->stats_lock);
+			scheduled_us = now_us;
+			continue;
+		}
+
+		/* Keep the local session warm halfway through the interval */
+		woken = false;
+		if (now_us < scheduled_us - interval_us / 2)
+		{
+			woken = ramd_monitor_sleep_until(monitor, scheduled_us - interval_us / 2);
+			if (!monitor->running)
+				break;
+			if (!woken)
+				ramd_monitor_local_keepalive(monitor);
+		}
+		if (!woken)
+			woken = ramd_monitor_sleep_until(monitor, scheduled_us);
+		if (woken)
+		{
+			pthread_mutex_lock(&monitor->stats_lock);
+			monitor->stats.woken_cycles++;
+			pthread_mutex_unlock(&monitor->stats_lock);
+			scheduled_us = ramd_clock_now_us();
+		}
 	}
 
 	ramd_log_info("Monitor thread stopped");
@@ -99,15 +408,150 @@ ramd_monitor_thread_main(void *arg)
 void
 ramd_monitor_run_cycle(ramd_monitor_t *monitor)
 {
+	ramd_monitor_stats_t *stats;
+	int64_t               step_us[RAMD_MONITOR_STEP_COUNT];
+	int64_t               start_us;
+	int64_t               mark_us;
+	int64_t               cycle_us;
+	int64_t               budget_us;
+	int                   slowest = 0;
+	int                   i;
+
 	if (!monitor)
 		return;
 
-	monitor->last_check = time(NULL);
+	monitor->last_check_ms = ramd_clock_now_ms();
+	start_us = mark_us = ramd_clock_now_us();
+
+	/* One pgraft roundtrip serves every consensus question this cycle */
+	if (monitor->cluster)
+		ramd_cluster_refresh_consensus(monitor->cluster);
+	step_us[RAMD_MONITOR_STEP_CONSENSUS] = ramd_monitor_lap(&mark_us);
 
 	ramd_monitor_check_local_node(monitor);
+	step_us[RAMD_MONITOR_STEP_LOCAL] = ramd_monitor_lap(&mark_us);
 	ramd_monitor_check_remote_nodes(monitor);
+	step_us[RAMD_MONITOR_STEP_REMOTE] = ramd_monitor_lap(&mark_us);
 	ramd_monitor_check_leadership(monitor);
+	step_us[RAMD_MONITOR_STEP_LEADERSHIP] = ramd_monitor_lap(&mark_us);
 	ramd_monitor_detect_role_changes(monitor);
+	step_us[RAMD_MONITOR_STEP_ROLE_CHANGES] = ramd_monitor_lap(&mark_us);
+
+	/* Readers get this cycle whole; watchers only if it changed what they see */
+	ramd_cluster_publish(monitor->cluster);
+	ramd_watch_publish(monitor->cluster);
+
+	ramd_conn_reap_idle();
+	step_us[RAMD_MONITOR_STEP_PUBLISH] = ramd_monitor_lap(&mark_us);
+
+	cycle_us = mark_us - start_us;
+	budget_us = (int64_t) monitor->check_interval_ms * 1000;
+
+	stats = &monitor->stats;
+	pthread_mutex_lock(&monitor->stats_lock);
+	for (i = 0; i < RAMD_MONITOR_STEP_COUNT; i++)
+	{
+		stats->step_buckets[i][ramd_monitor_bucket(step_us[i])]++;
+		stats->step_sum_us[i] += step_us[i];
+		if (step_us[i] > step_us[slowest])
+			slowest = i;
+	}
+	stats->cycle_buckets[ramd_monitor_bucket(cycle_us)]++;
+	stats->cycle_sum_us += cycle_us;
+	stats->last_cycle_us = cycle_us;
+	if (budget_us > 0 && cycle_us > budget_us)
+		stats->overruns++;
+	pthread_mutex_unlock(&monitor->stats_lock);
+
+	if (budget_us > 0 && cycle_us > budget_us)
+		ramd_log_warning("Monitor cycle took %lld ms, over its %d ms interval; "
+		                 "slowest step was %s at %lld ms",
+		                 (long long) (cycle_us / 1000), monitor->check_interval_ms,
+		                 g_monitor_step_names[slowest], (long long) (step_us[slowest] / 1000));
+}
+
+static bool
+ramd_monitor_render_histogram(ramd_buffer_t *output, const char *name,
+                              const char *labels, const int64_t *buckets,
+                              int64_t sum_us)
+{
+	int64_t cumulative = 0;
+	bool    ok = true;
+	int     i;
+
+	for (i = 0; i < RAMD_MONITOR_CYCLE_BUCKET_COUNT; i++)
+	{
+		cumulative += buckets[i];
+		ok &= ramd_buffer_appendf(output, "%s_bucket{%s%sle=\"%g\"} %lld\n", name, labels,
+		                          labels[0] ? "," : "",
+		                          (double) g_monitor_bucket_bounds_us[i] / 1e6,
+		                          (long long) cumulative);
+	}
+	cumulative += buckets[RAMD_MONITOR_CYCLE_BUCKET_COUNT];
+	ok &= ramd_buffer_appendf(output, "%s_bucket{%s%sle=\"+Inf\"} %lld\n", name, labels,
+	                          labels[0] ? "," : "", (long long) cumulative);
+	ok &= ramd_buffer_appendf(output, "%s_sum%s%s%s %.6f\n%s_count%s%s%s %lld\n",
+	                          name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+	                          (double) sum_us / 1e6,
+	                          name, labels[0] ? "{" : "", labels, labels[0] ? "}" : "",
+	                          (long long) cumulative);
+	return ok;
+}
+
+bool
+ramd_monitor_render_prometheus(ramd_monitor_t *monitor, ramd_buffer_t *output)
+{
+	ramd_monitor_stats_t stats;
+	char                 labels[64];
+	bool                 ok = true;
+	int                  i;
+
+	if (!monitor || !output)
+		return false;
+	if (!monitor->config)
+		return true;		/* not initialized, or already cleaned up */
+
+	pthread_mutex_lock(&monitor->stats_lock);
+	stats = monitor->stats;
+	pthread_mutex_unlock(&monitor->stats_lock);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_monitor_step_duration_seconds Time spent in each step of a monitor cycle\n"
+		"# TYPE ramd_monitor_step_duration_seconds histogram\n");
+	for (i = 0; i < RAMD_MONITOR_STEP_COUNT; i++)
+	{
+		snprintf(labels, sizeof(labels), "step=\"%s\"", g_monitor_step_names[i]);
+		ok &= ramd_monitor_render_histogram(output, "ramd_monitor_step_duration_seconds",
+		                                    labels, stats.step_buckets[i], stats.step_sum_us[i]);
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_monitor_cycle_duration_seconds Time a whole monitor cycle took\n"
+		"# TYPE ramd_monitor_cycle_duration_seconds histogram\n");
+	ok &= ramd_monitor_render_histogram(output, "ramd_monitor_cycle_duration_seconds", "",
+	                                    stats.cycle_buckets, stats.cycle_sum_us);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_monitor_last_cycle_seconds Duration of the most recent monitor cycle\n"
+		"# TYPE ramd_monitor_last_cycle_seconds gauge\n"
+		"ramd_monitor_last_cycle_seconds %.6f\n\n"
+		"# HELP ramd_monitor_cycle_start_lag_seconds How late the most recent cycle started\n"
+		"# TYPE ramd_monitor_cycle_start_lag_seconds gauge\n"
+		"ramd_monitor_cycle_start_lag_seconds %.6f\n\n"
+		"# HELP ramd_monitor_cycle_overruns_total Cycles that took longer than the monitor interval\n"
+		"# TYPE ramd_monitor_cycle_overruns_total counter\n"
+		"ramd_monitor_cycle_overruns_total %lld\n\n"
+		"# HELP ramd_monitor_missed_cycles_total Scheduled cycle starts skipped after overruns\n"
+		"# TYPE ramd_monitor_missed_cycles_total counter\n"
+		"ramd_monitor_missed_cycles_total %lld\n\n"
+		"# HELP ramd_monitor_woken_cycles_total Cycles started early by an event such as a Raft leader change\n"
+		"# TYPE ramd_monitor_woken_cycles_total counter\n"
+		"ramd_monitor_woken_cycles_total %lld\n\n",
+		(double) stats.last_cycle_us / 1e6, (double) stats.last_start_lag_us / 1e6,
+		(long long) stats.overruns, (long long) stats.missed_cycles,
+		(long long) stats.woken_cycles);
+
+	return ok;
 }
 
 bool
@@ -116,28 +560,124 @@ ramd_monitor_is_running(const ramd_monitor_t *monitor)
 	return monitor && monitor->running;
 }
 
+/*
+ * Score a good local sample: host load first (ramd_sysmon_health_for_load),
+ * less a little for a standby far behind or for queries running past an
+ * hour.  None of these stop the node from serving, so the score stays at
+ * or above the healthy threshold; only a failed or stale sample fails it.
+ */
+static float
+ramd_monitor_score_local(const ramd_postgresql_status_t *status, int32_t load)
+{
+	float score = ramd_sysmon_health_for_load(load);
+	float penalty;
+
+	if (status->is_in_recovery)
+	{
+		if (status->replication_lag_seconds >= RAMD_HEALTH_LAG_CRITICAL_SECONDS)
+			score -= 2.0f * RAMD_HEALTH_LAG_PENALTY;
+		else if (status->replication_lag_seconds >= RAMD_HEALTH_LAG_WARN_SECONDS)
+			score -= RAMD_HEALTH_LAG_PENALTY;
+	}
+
+	penalty = (float) status->long_running_queries * RAMD_HEALTH_LONG_QUERY_PENALTY;
+	score -= penalty < RAMD_HEALTH_LONG_QUERY_MAX_PENALTY ? penalty
+	                                                     : RAMD_HEALTH_LONG_QUERY_MAX_PENALTY;
+
+	return score < RAMD_HEALTH_SCORE_THRESHOLD ? RAMD_HEALTH_SCORE_THRESHOLD : score;
+}
+
+/* Fold this cycle's local sample, or its absence, into monitor->health */
+static void
+ramd_monitor_update_health(ramd_monitor_t *monitor, const ramd_postgresql_status_t *status)
+{
+	int32_t load = ramd_sysmon_load();
+
+	pthread_mutex_lock(&monitor->stats_lock);
+	monitor->health.host_load = load;
+	if (status && status->is_running && status->accepts_connections)
+	{
+		monitor->health_sampled_at_ms = ramd_clock_now_ms();
+		monitor->health.consecutive_failures = 0;
+		monitor->health.replication_lag_seconds = status->replication_lag_seconds;
+		monitor->health.long_running_queries = status->long_running_queries;
+		monitor->health.score = ramd_monitor_score_local(status, load);
+	}
+	else
+	{
+		monitor->health.consecutive_failures++;
+		monitor->health.score = RAMD_MIN_HEALTH_SCORE;
+	}
+	pthread_mutex_unlock(&monitor->stats_lock);
+}
+
+/*
+ * The local node's health as the monitor last saw it.  A copy under a
+ * mutex, so HTTP handlers and probes may ask as often as they like.
+ */
+void
+ramd_monitor_get_health(ramd_monitor_t *monitor, ramd_monitor_health_t *health)
+{
+	int64_t stale_ms;
+
+	if (!health)
+		return;
+
+	memset(health, 0, sizeof(*health));
+	health->sample_age_ms = -1;
+	health->host_load = -1;
+	if (!monitor)
+		return;
+
+	pthread_mutex_lock(&monitor->stats_lock);
+	*health = monitor->health;
+	health->sample_age_ms = monitor->health_sampled_at_ms > 0
+	                        ? ramd_clock_now_ms() - monitor->health_sampled_at_ms : -1;
+	pthread_mutex_unlock(&monitor->stats_lock);
+
+	stale_ms = (int64_t) RAMD_HEALTH_STALE_CYCLES *
+	           (monitor->check_interval_ms > 0 ? monitor->check_interval_ms
+	                                           : RAMD_MONITOR_INTERVAL_MS);
+	health->fresh = health->sample_age_ms >= 0 && health->sample_age_ms <= stale_ms &&
+	                health->consecutive_failures == 0;
+	if (!health->fresh)
+		health->score = RAMD_MIN_HEALTH_SCORE;
+}
+
 bool
 ramd_monitor_check_local_node(ramd_monitor_t *monitor)
 {
 	ramd_postgresql_status_t pg_status;
-	ramd_postgresql_connection_t local_conn;
+	PGconn                    *conn;
+	PGresult                  *res;
 	bool                       local_healthy = false;
 	float                     health_score;
 
 	if (!monitor)
 		return false;
 
-	if (ramd_postgresql_connect(&local_conn, monitor->config->hostname,
-	                           monitor->config->postgresql_port,
-	                           monitor->config->database_name,
-	                           monitor->config->database_user,
-	                           monitor->config->database_password))
+	memset(&pg_status, 0, sizeof(pg_status));
+
+	pthread_mutex_lock(&monitor->local_lock);
+	if (ramd_monitor_local_ensure(monitor))
 	{
-		if (ramd_postgresql_get_status(&local_conn, &pg_status))
+		conn = (PGconn *) monitor->local_connection.connection;
+		res = PQexecPrepared(conn, RAMD_POSTGRESQL_STATUS_STMT, 0, NULL, NULL, NULL, 0);
+		if (ramd_postgresql_parse_status(res, &pg_status))
+		{
+			monitor->local_connection.last_activity_ms = pg_status.last_check_ms;
+			monitor->local_status = pg_status;
 			local_healthy = true;
-
-		ramd_postgresql_disconnect(&local_conn);
+		}
+		else
+			ramd_log_debug("Local status query failed: %s", PQerrorMessage(conn));
+		PQclear(res);
+		if (local_healthy)
+			ramd_monitor_local_publish_load(monitor, conn);
 	}
+	pthread_mutex_unlock(&monitor->local_lock);
+
+	ramd_monitor_update_health(monitor, local_healthy ? &pg_status : NULL);
 
 	if (!local_healthy)
 	{
@@ -146,6 +686,7 @@ ramd_monitor_check_local_node(ramd_monitor_t *monitor)
 	}
 
 	health_score = ramd_monitor_calculate_node_health(monitor, NULL);
+	ramd_cluster_update_node_health(monitor->cluster, monitor->config->node_id, health_score);
 
 	if (!pg_status.is_running)
 	{
@@ -159,11 +700,12 @@ ramd_monitor_check_local_node(ramd_monitor_t *monitor)
 		return false;
 	}
 
-	ramd_log_debug("Local node health check: score=%.2f, role=%s, state=%s, uptime=%lds",
+	ramd_log_debug("Local node health check: score=%.2f, role=%s, state=%s, last seen %ld ms ago",
 	               health_score, 
 	               monitor->cluster->nodes[monitor->cluster->local_node_id].role == RAMD_ROLE_PRIMARY ? "primary" : "standby",
 	               monitor->cluster->nodes[monitor->cluster->local_node_id].state == RAMD_NODE_STATE_PRIMARY ? "primary" : "standby",
-	               time(NULL) - monitor->cluster->nodes[monitor->cluster->local_node_id].last_seen);
+	               (long) (ramd_clock_now_ms() -
+	                       monitor->cluster->nodes[monitor->cluster->local_node_id].last_seen_ms));
 	return true;
 }
 
@@ -171,58 +713,50 @@ bool
 ramd_monitor_check_remote_nodes(ramd_monitor_t *monitor)
 {
 	bool     all_healthy = true;
-	int32_t  healthy_count = 0;
+	int32_t  healthy_count;
 	int32_t  i;
 	int32_t  remote_node_count;
 
 	if (!monitor || !monitor->cluster)
 		return false;
 
+	/* All nodes are probed concurrently under one deadline */
+	healthy_count = ramd_probe_run(&monitor->probes, monitor->cluster,
+	                               monitor->config->node_id,
+	                               monitor->health_check_timeout_ms);
+
 	for (i = 0; i < monitor->cluster->node_count; i++)
 	{
-		ramd_node_t                 *node = &monitor->cluster->nodes[i];
-		ramd_postgresql_connection_t remote_conn;
-		bool                        node_healthy = false;
+		ramd_node_t               *node = &monitor->cluster->nodes[i];
+		const ramd_probe_target_t *probe;
 
 		if (node->node_id == monitor->config->node_id)
 			continue;
 
-		if (ramd_postgresql_connect(&remote_conn, node->hostname,
-		                           node->postgresql_port,
-		                           monitor->config->database_name,
-		                           monitor->config->database_user,
-		                           monitor->config->database_password))
+		probe = ramd_probe_find(&monitor->probes, node->node_id);
+		ramd_metrics_increment_health_checks(g_ramd_metrics, probe && probe->healthy);
+		if (!probe || !probe->healthy)
 		{
-			ramd_postgresql_status_t remote_status;
-			float                    health_score;
-
-			if (ramd_postgresql_get_status(&remote_conn, &remote_status))
-			{
-				node_healthy = remote_status.is_running && remote_status.accepts_connections;
-				health_score = remote_status.is_running ? RAMD_MAX_HEALTH_SCORE : RAMD_MIN_HEALTH_SCORE;
-
-				ramd_cluster_update_node_health(monitor->cluster, node->node_id, health_score);
-
-				if (node_healthy)
-					healthy_count++;
-			}
-
-			ramd_postgresql_disconnect(&remote_conn);
-		}
-
-		if (!node_healthy)
-		{
-			ramd_log_warning("Node %d (%s) health check failed",
-			                node->node_id, node->hostname);
+			/* Leave last_seen alone: it records the last successful contact */
+			node->health_score = RAMD_MIN_HEALTH_SCORE;
+			node->is_healthy = false;
+			ramd_sysmon_note_peer_rtt(node->node_id, -1);
+			ramd_log_warning("Node %d (%s) health check failed: %s",
+			                node->node_id, node->hostname,
+			                probe && probe->error[0] ? probe->error : "not probed");
 			all_healthy = false;
+			continue;
 		}
-		else
-		{
-			ramd_log_debug("Remote node health check: node=%d (%s), score=%.2f, role=%s, lag=%dms",
-			              node->node_id, node->hostname, node->health_score,
-			              node->role == RAMD_ROLE_PRIMARY ? "primary" : "standby",
-			              node->replication_lag_ms);
-		}
+
+		ramd_detector_heartbeat(node->node_id, RAMD_DETECTOR_POSTGRESQL);
+		ramd_sysmon_note_peer_rtt(node->node_id, probe->rtt_us);
+		ramd_cluster_update_node_health(monitor->cluster, node->node_id,
+		                                ramd_monitor_calculate_node_health(monitor, node));
+		ramd_log_debug("Remote node health check: node=%d (%s), score=%.2f, role=%s, "
+		              "rtt=%lldus, load=%d",
+		              node->node_id, node->hostname, node->health_score,
+		              probe->in_recovery ? "standby" : "primary",
+		              (long long) probe->rtt_us, probe->status.host_load);
 	}
 
 	remote_node_count = monitor->cluster->node_count > 0 ? monitor->cluster->node_count - 1 : 0;
@@ -236,18 +770,21 @@ bool
 ramd_monitor_check_cluster_health(ramd_monitor_t *monitor)
 {
 	int32_t healthy_nodes;
+	int32_t voting_nodes;
 	int32_t required_for_quorum;
 
 	if (!monitor || !monitor->cluster)
 		return false;
 
-	healthy_nodes = ramd_cluster_count_healthy_nodes(monitor->cluster);
-	required_for_quorum = (monitor->cluster->node_count / 2) + 1;
+	/* Learners, typically read replicas, do not make or break the quorum */
+	healthy_nodes = ramd_cluster_count_healthy_voting_nodes(monitor->cluster);
+	voting_nodes = ramd_cluster_count_voting_nodes(monitor->cluster);
+	required_for_quorum = (voting_nodes / 2) + 1;
 
 	if (healthy_nodes < required_for_quorum)
 	{
-		ramd_log_error("Cluster does not have quorum: %d/%d nodes healthy (need %d)",
-		               healthy_nodes, monitor->cluster->node_count, required_for_quorum);
+		ramd_log_error("Cluster does not have quorum: %d/%d voting nodes healthy (need %d)",
+		               healthy_nodes, voting_nodes, required_for_quorum);
 		return false;
 	}
 
@@ -330,7 +867,7 @@ ramd_monitor_handle_leadership_gained(ramd_monitor_t *monitor)
 	ramd_cluster_update_node_role(monitor->cluster, monitor->config->node_id,
 	                             RAMD_ROLE_PRIMARY);
 
-	if (!ramd_postgresql_promote(monitor->config))
+	if (!ramd_monitor_promote_local(monitor))
 	{
 		ramd_log_error("Failed to promote PostgreSQL to primary");
 		return false;
@@ -460,41 +997,19 @@ ramd_monitor_check_primary_health(ramd_monitor_t *monitor)
 bool
 ramd_monitor_detect_primary_failure(ramd_monitor_t *monitor)
 {
-	static int      consecutive_failures = 0;
-	static time_t   last_failure_time __attribute__((unused)) = 0;
-	const int       failover_threshold = RAMD_FAILOVER_THRESHOLD;
+	ramd_node_t *primary;
 
 	if (!monitor || !monitor->cluster)
 		return false;
 
-	if (!ramd_monitor_check_primary_health(monitor))
-	{
-		consecutive_failures++;
-		last_failure_time = time(NULL);
+	primary = ramd_cluster_get_primary_node(monitor->cluster);
+	if (!primary || primary->node_id == monitor->config->node_id)
+		return false;
 
-		if (consecutive_failures >= failover_threshold)
-		{
-			ramd_log_error("Primary failure detected after %d consecutive failures",
-			               consecutive_failures);
-			return true;
-		}
-		else
-		{
-			ramd_log_warning("Primary health check failed (%d/%d)",
-			                 consecutive_failures, failover_threshold);
-		}
-	}
-	else
-	{
-		if (consecutive_failures > 0)
-		{
-			ramd_log_info("Primary health restored after %d failures",
-			              consecutive_failures);
-			consecutive_failures = 0;
-		}
-	}
+	if (ramd_monitor_check_primary_health(monitor))
+		ramd_detector_heartbeat(primary->node_id, RAMD_DETECTOR_POSTGRESQL);
 
-	return false;
+	return ramd_detector_check(primary->node_id, monitor->config, NULL) == RAMD_DETECTOR_FAILED;
 }
 
 bool
@@ -537,11 +1052,30 @@ ramd_monitor_broadcast_state_change(ramd_monitor_t *monitor __attribute__((unuse
 	return true;
 }
 
+/*
+ * Health of a node this cycle's checks reached.  NULL or the local node
+ * gets the monitor's local health model (ramd_monitor_get_health); a peer
+ * is scored by the load its status query reported.
+ */
 float
-ramd_monitor_calculate_node_health(ramd_monitor_t *monitor __attribute__((unused)),
-                                  ramd_node_t *node __attribute__((unused)))
+ramd_monitor_calculate_node_health(ramd_monitor_t *monitor, ramd_node_t *node)
 {
-	return 1.0f;
+	const ramd_probe_target_t *probe;
+	ramd_monitor_health_t      health;
+
+	if (!monitor)
+		return RAMD_MIN_HEALTH_SCORE;
+
+	if (!monitor->config || !node || node->node_id == monitor->config->node_id)
+	{
+		ramd_monitor_get_health(monitor, &health);
+		return health.score;
+	}
+
+	probe = ramd_probe_find(&monitor->probes, node->node_id);
+	if (!probe || !probe->healthy)
+		return RAMD_MIN_HEALTH_SCORE;
+	return ramd_sysmon_health_for_load(probe->status.host_load);
 }
 
 bool
@@ -13,18 +13,35 @@
  */
 
 #include "libpq-fe.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "ramd_pgraft.h"
 #include "ramd_logging.h"
 #include "ramd_basebackup.h"
 #include "ramd_conn.h"
 #include "ramd_query.h"
+#include "ramd_daemon.h"
+#include "ramd_slots.h"
 
 static char g_last_error[512] = {0};
 
+/* Read-only mapping of the pgraft metrics file, kept across scrapes */
+static pthread_mutex_t g_metrics_map_lock = PTHREAD_MUTEX_INITIALIZER;
+static const ramd_pgraft_metrics_t* g_metrics_map = NULL;
+static char g_metrics_map_path[512] = {0};
+
+/* Readers retry this often while the writer is mid-publish */
+#define RAMD_PGRAFT_METRICS_READ_RETRIES 8
+
 /* Enhanced integration helper functions */
 static void
 ramd_pgraft_update_cluster_state(PGconn* conn)
@@ -86,28 +103,53 @@ execute_simple_query(PGconn* conn, const char* query)
 	return value;
 }
 
-static int
-execute_boolean_query(PGconn* conn, const char* query)
+static long long
+execute_int_query(PGconn* conn, const char* query)
 {
 	char* result = execute_simple_query(conn, query);
 	if (!result)
 		return -1;
 
-	int value = (strcmp(result, "t") == 0) ? 1 : 0;
+	long long value = atoll(result);
 	free(result);
 	return value;
 }
 
-static long long
-execute_int_query(PGconn* conn, const char* query)
+/* The per-cycle calls go through the prepared statement registry */
+static int
+execute_prepared_boolean(PGconn* conn, ramd_query_stmt_t stmt)
 {
-	char* result = execute_simple_query(conn, query);
-	if (!result)
+	bool value;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return -1;
+	}
+	if (!ramd_query_prepared_bool(conn, stmt, &value))
+	{
+		set_last_error("Query failed: %s", PQerrorMessage(conn));
 		return -1;
+	}
+	return value ? 1 : 0;
+}
 
-	long long value = atoll(result);
-	free(result);
-	return value;
+static long long
+execute_prepared_int(PGconn* conn, ramd_query_stmt_t stmt)
+{
+	int64_t value;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return -1;
+	}
+	if (!ramd_query_prepared_int64(conn, stmt, &value))
+	{
+		set_last_error("Query failed: %s", PQerrorMessage(conn));
+		return -1;
+	}
+	return (long long) value;
 }
 
 int
@@ -204,20 +246,80 @@ ramd_pgraft_get_state(PGconn* conn)
 int
 ramd_pgraft_is_leader(PGconn* conn)
 {
-	return execute_boolean_query(conn, "SELECT pgraft_is_leader()");
+	return execute_prepared_boolean(conn, RAMD_QUERY_STMT_PGRAFT_IS_LEADER);
 }
 
 int
 ramd_pgraft_get_leader(PGconn* conn)
 {
-	long long leader = execute_int_query(conn, "SELECT pgraft_get_leader()");
+	long long leader = execute_prepared_int(conn, RAMD_QUERY_STMT_PGRAFT_LEADER);
 	return (int)leader;
 }
 
 long long
 ramd_pgraft_get_term(PGconn* conn)
 {
-	return execute_int_query(conn, "SELECT pgraft_get_term()");
+	return execute_prepared_int(conn, RAMD_QUERY_STMT_PGRAFT_TERM);
+}
+
+static long long
+snapshot_int(const PGresult* result, int row, int column, long long if_null)
+{
+	return (long long) ramd_query_value_int64(result, row, column, if_null);
+}
+
+int
+ramd_pgraft_get_cluster_snapshot(PGconn* conn, ramd_pgraft_snapshot_t* snapshot)
+{
+	PGresult* result;
+	int rows;
+
+	if (!conn || !snapshot)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	result = ramd_query_exec_prepared(conn, RAMD_QUERY_STMT_PGRAFT_SNAPSHOT, 0, NULL);
+	if (!result || PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) == 0)
+	{
+		set_last_error("pgraft_get_cluster_snapshot failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	memset(snapshot, 0, sizeof(*snapshot));
+	snapshot->leader_id = snapshot_int(result, 0, 0, -1);
+	snapshot->term = snapshot_int(result, 0, 1, -1);
+	snapshot->commit_index = snapshot_int(result, 0, 2, -1);
+	snapshot->last_applied = snapshot_int(result, 0, 3, -1);
+	snapshot->last_index = snapshot_int(result, 0, 4, -1);
+	snprintf(snapshot->state, sizeof(snapshot->state), "%s", ramd_query_value_text(result, 0, 5));
+	snapshot->local_node_id = (int) snapshot_int(result, 0, 6, -1);
+	snapshot->is_leader = ramd_query_value_bool(result, 0, 7);
+	snapshot->published = ramd_query_value_bool(result, 0, 8);
+
+	/* A lone row with a NULL node_id means no members */
+	rows = PQntuples(result);
+	for (int i = 0; i < rows && snapshot->node_count < RAMD_PGRAFT_MAX_NODES; i++)
+	{
+		ramd_pgraft_node_progress_t* node = &snapshot->nodes[snapshot->node_count];
+
+		if (PQgetisnull(result, i, 9))
+			continue;
+		node->node_id = (int) snapshot_int(result, i, 9, -1);
+		snprintf(node->address, sizeof(node->address), "%s", ramd_query_value_text(result, i, 10));
+		node->port = (int) snapshot_int(result, i, 11, -1);
+		node->is_leader = ramd_query_value_bool(result, i, 12);
+		node->match_index = snapshot_int(result, i, 13, -1);
+		node->next_index = snapshot_int(result, i, 14, -1);
+		snprintf(node->progress, sizeof(node->progress), "%s", ramd_query_value_text(result, i, 15));
+		node->voting = PQgetisnull(result, i, 16) || ramd_query_value_bool(result, i, 16);
+		snapshot->node_count++;
+	}
+
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
 }
 
 char*
@@ -227,7 +329,8 @@ ramd_pgraft_get_nodes(PGconn* conn)
 }
 
 int
-ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port)
+ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port,
+                     int voting)
 {
 	char query[512];
 	PGresult* result;
@@ -245,7 +348,8 @@ ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port)
 	}
 
 	snprintf(query, sizeof(query),
-	         "SELECT pgraft_add_node(%d, '%s', %d)", node_id, hostname, port);
+	         "SELECT pgraft_add_node(%d, '%s', %d, %s)", node_id, hostname, port,
+	         voting ? "true" : "false");
 
 	result = ramd_query_exec_with_result(conn, query);
 	if (!result)
@@ -261,9 +365,17 @@ ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port)
 		return RAMD_PGRAFT_ERROR;
 	}
 
+	/* false: proposed, but not applied within the function's timeout */
+	if (PQntuples(result) != 1 || strcmp(PQgetvalue(result, 0, 0), "t") != 0)
+	{
+		set_last_error("pgraft_add_node: adding node %d was not applied in time", node_id);
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
 	PQclear(result);
-	ramd_log_info("Successfully added node %d at %s:%d to Raft cluster",
-	              node_id, hostname, port);
+	ramd_log_info("Successfully added node %d at %s:%d to Raft cluster%s",
+	              node_id, hostname, port, voting ? "" : " as a learner");
 	
 	/* Enhanced integration: Update cluster state */
 	ramd_pgraft_update_cluster_state(conn);
@@ -271,6 +383,114 @@ ramd_pgraft_add_node(PGconn* conn, int node_id, const char* hostname, int port)
 	return RAMD_PGRAFT_SUCCESS;
 }
 
+/*
+ * Arrays go over as text literals.  Hostnames are quoted, with the two
+ * characters that are special inside a quoted element escaped.
+ */
+int
+ramd_pgraft_add_nodes(PGconn* conn, const int* node_ids, const char* const* hostnames,
+                      const int* ports, int count, int voting)
+{
+	char* ids_text;
+	char* hosts_text;
+	char* ports_text;
+	size_t ids_len = 0;
+	size_t hosts_len = 0;
+	size_t ports_len = 0;
+	const char* params[3];
+	PGresult* result;
+	int rc = RAMD_PGRAFT_ERROR;
+	int i;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	if (count <= 0 || count > RAMD_MAX_NODES)
+	{
+		set_last_error("pgraft_add_nodes: %d nodes asked for, 1 to %d allowed", count,
+		               RAMD_MAX_NODES);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	ids_text = malloc((size_t) count * 12 + 3);
+	ports_text = malloc((size_t) count * 12 + 3);
+	hosts_text = malloc((size_t) count * (RAMD_MAX_HOSTNAME_LENGTH * 2 + 3) + 3);
+	if (!ids_text || !ports_text || !hosts_text)
+	{
+		set_last_error("pgraft_add_nodes: out of memory");
+		goto done;
+	}
+
+	ids_text[ids_len++] = '{';
+	hosts_text[hosts_len++] = '{';
+	ports_text[ports_len++] = '{';
+	for (i = 0; i < count; i++)
+	{
+		const char* h = hostnames[i];
+		size_t n = 0;
+
+		if (!h)
+		{
+			set_last_error("Hostname is NULL");
+			goto done;
+		}
+
+		ids_len += (size_t) sprintf(ids_text + ids_len, "%s%d", i ? "," : "", node_ids[i]);
+		ports_len += (size_t) sprintf(ports_text + ports_len, "%s%d", i ? "," : "", ports[i]);
+
+		if (i)
+			hosts_text[hosts_len++] = ',';
+		hosts_text[hosts_len++] = '"';
+		for (; h[n] && n < RAMD_MAX_HOSTNAME_LENGTH; n++)
+		{
+			if (h[n] == '"' || h[n] == '\\')
+				hosts_text[hosts_len++] = '\\';
+			hosts_text[hosts_len++] = h[n];
+		}
+		hosts_text[hosts_len++] = '"';
+	}
+	memcpy(ids_text + ids_len, "}", 2);
+	memcpy(hosts_text + hosts_len, "}", 2);
+	memcpy(ports_text + ports_len, "}", 2);
+
+	params[0] = ids_text;
+	params[1] = hosts_text;
+	params[2] = ports_text;
+	result = PQexecParams(conn,
+	                      voting ? "SELECT pgraft_add_nodes($1::integer[], $2::text[], $3::integer[], true)"
+	                             : "SELECT pgraft_add_nodes($1::integer[], $2::text[], $3::integer[], false)",
+	                      3, NULL, params, NULL, NULL, 0);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("pgraft_add_nodes failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		goto done;
+	}
+
+	/* false: proposed, but not applied within the function's timeout */
+	if (strcmp(PQgetvalue(result, 0, 0), "t") != 0)
+	{
+		set_last_error("pgraft_add_nodes: adding %d nodes was not applied in time", count);
+		PQclear(result);
+		goto done;
+	}
+
+	PQclear(result);
+	ramd_log_info("Added %d nodes to the Raft cluster in one membership change%s", count,
+	              voting ? "" : " as learners");
+	ramd_pgraft_update_cluster_state(conn);
+	rc = RAMD_PGRAFT_SUCCESS;
+
+done:
+	free(ids_text);
+	free(hosts_text);
+	free(ports_text);
+	return rc;
+}
+
 int
 ramd_pgraft_remove_node(PGconn* conn, int node_id)
 {
@@ -299,11 +519,373 @@ ramd_pgraft_remove_node(PGconn* conn, int node_id)
 		return RAMD_PGRAFT_ERROR;
 	}
 
+	if (PQntuples(result) != 1 || strcmp(PQgetvalue(result, 0, 0), "t") != 0)
+	{
+		set_last_error("pgraft_remove_node: removing node %d was not applied in time", node_id);
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
 	PQclear(result);
 	ramd_log_info("Successfully removed node %d from Raft cluster", node_id);
 	return RAMD_PGRAFT_SUCCESS;
 }
 
+int
+ramd_pgraft_transfer_leadership(PGconn* conn, int node_id, int timeout_ms)
+{
+	char query[256];
+	PGresult* result;
+	bool transferred;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(query, sizeof(query),
+	         "SELECT pgraft_transfer_leadership(%d, make_interval(secs => %d / 1000.0))",
+	         node_id, timeout_ms);
+
+	result = ramd_query_exec_with_result(conn, query);
+	if (!result)
+	{
+		set_last_error("Failed to execute pgraft_transfer_leadership: %s", PQerrorMessage(conn));
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("pgraft_transfer_leadership failed: %s", PQresultErrorMessage(result));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	transferred = strcmp(PQgetvalue(result, 0, 0), "t") == 0;
+	PQclear(result);
+	if (!transferred)
+	{
+		set_last_error("node %d did not become Raft leader within %d ms", node_id, timeout_ms);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	ramd_log_info("Transferred Raft leadership to node %d", node_id);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+int
+ramd_pgraft_read_barrier(PGconn* conn, int timeout_ms)
+{
+	char query[128];
+	PGresult* result;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(query, sizeof(query),
+	         "SELECT pgraft_read_barrier(make_interval(secs => %d / 1000.0))", timeout_ms);
+
+	result = ramd_query_exec_with_result(conn, query);
+	if (!result)
+	{
+		set_last_error("Failed to execute pgraft_read_barrier: %s", PQerrorMessage(conn));
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("pgraft_read_barrier failed: %s", PQresultErrorMessage(result));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+int
+ramd_pgraft_wait_leader_change(PGconn* conn, long long known_leader, long long known_term,
+                               int timeout_ms, long long* leader, long long* term,
+                               bool* changed)
+{
+	char query[192];
+	PGresult* result;
+
+	if (!conn || !leader || !term || !changed)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(query, sizeof(query),
+	         "SELECT leader_id, term, changed FROM pgraft_wait_leader_change(%lld, %lld, "
+	         "make_interval(secs => %d / 1000.0))",
+	         known_leader, known_term, timeout_ms);
+
+	/* Plain PQexec: the caller retries, and an error logged per retry is noise */
+	result = PQexec(conn, query);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("pgraft_wait_leader_change failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	*leader = (long long) ramd_query_value_int64(result, 0, 0, -1);
+	*term = (long long) ramd_query_value_int64(result, 0, 1, -1);
+	*changed = strcmp(PQgetvalue(result, 0, 2), "t") == 0;
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+/* Run a KV call whose one row's first column is a bigint, NULL as 0 */
+static int
+ramd_pgraft_kv_exec(PGconn* conn, const char* what, const char* sql, int nparams,
+                    const char* const* params, long long* value)
+{
+	PGresult* result;
+
+	if (!conn)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	result = PQexecParams(conn, sql, nparams, NULL, params, NULL, NULL, 0);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("%s failed: %s", what, PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	if (value)
+		*value = (long long) ramd_query_value_int64(result, 0, 0, 0);
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+int
+ramd_pgraft_kv_put(PGconn* conn, const char* key, const char* value,
+                   long long expected_revision, long long lease, long long* revision)
+{
+	char expected[32];
+	char lease_text[32];
+	const char* params[4];
+
+	if (!key || !value || !revision)
+	{
+		set_last_error("Key-value put needs a key and a value");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(expected, sizeof(expected), "%lld", expected_revision);
+	snprintf(lease_text, sizeof(lease_text), "%lld", lease);
+	params[0] = key;
+	params[1] = value;
+	params[2] = expected_revision >= 0 ? expected : NULL;
+	params[3] = lease_text;
+	return ramd_pgraft_kv_exec(conn, "pgraft_kv_put",
+	                           "SELECT pgraft_kv_put($1, convert_to($2, 'UTF8'), $3::bigint, "
+	                           "$4::bigint)",
+	                           4, params, revision);
+}
+
+int
+ramd_pgraft_kv_delete(PGconn* conn, const char* key, bool prefix, long long* revision)
+{
+	const char* params[2];
+
+	if (!key || !revision)
+	{
+		set_last_error("Key-value delete needs a key");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	params[0] = key;
+	params[1] = prefix ? "true" : "false";
+	return ramd_pgraft_kv_exec(conn, "pgraft_kv_delete",
+	                           "SELECT pgraft_kv_delete($1, prefix => $2::boolean)",
+	                           2, params, revision);
+}
+
+int
+ramd_pgraft_kv_lease_grant(PGconn* conn, int ttl_ms, long long* lease)
+{
+	char ttl[32];
+	const char* params[1];
+
+	if (!lease)
+	{
+		set_last_error("Lease output is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(ttl, sizeof(ttl), "%d", ttl_ms);
+	params[0] = ttl;
+	return ramd_pgraft_kv_exec(conn, "pgraft_kv_lease_grant",
+	                           "SELECT pgraft_kv_lease_grant(make_interval(secs => "
+	                           "$1::integer / 1000.0))",
+	                           1, params, lease);
+}
+
+int
+ramd_pgraft_kv_lease_keepalive(PGconn* conn, long long lease, bool* alive)
+{
+	char lease_text[32];
+	const char* params[1];
+	PGresult* result;
+
+	if (!conn || !alive)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	snprintf(lease_text, sizeof(lease_text), "%lld", lease);
+	params[0] = lease_text;
+	result = PQexecParams(conn, "SELECT pgraft_kv_lease_keepalive($1::bigint)", 1, NULL,
+	                      params, NULL, NULL, 0);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+	{
+		set_last_error("pgraft_kv_lease_keepalive failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	*alive = strcmp(PQgetvalue(result, 0, 0), "t") == 0;
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+int
+ramd_pgraft_kv_lease_revoke(PGconn* conn, long long lease)
+{
+	char lease_text[32];
+	const char* params[1];
+
+	snprintf(lease_text, sizeof(lease_text), "%lld", lease);
+	params[0] = lease_text;
+	return ramd_pgraft_kv_exec(conn, "pgraft_kv_lease_revoke",
+	                           "SELECT pgraft_kv_lease_revoke($1::bigint)::integer",
+	                           1, params, NULL);
+}
+
+/* Rows of (revision, deleted, key, value, lease) to fn */
+static void
+ramd_pgraft_kv_emit(PGresult* result, ramd_pgraft_kv_event_fn fn, void* arg)
+{
+	int row;
+
+	for (row = 0; fn && row < PQntuples(result); row++)
+	{
+		ramd_pgraft_kv_event_t event;
+
+		event.revision = (long long) ramd_query_value_int64(result, row, 0, 0);
+		event.deleted = strcmp(PQgetvalue(result, row, 1), "t") == 0;
+		event.key = PQgetvalue(result, row, 2);
+		event.value = PQgetvalue(result, row, 3);
+		event.lease = (long long) ramd_query_value_int64(result, row, 4, 0);
+		fn(&event, arg);
+	}
+}
+
+int
+ramd_pgraft_kv_get_prefix(PGconn* conn, const char* prefix, long long* revision,
+                          ramd_pgraft_kv_event_fn fn, void* arg)
+{
+	const char* params[1];
+	PGresult* result;
+
+	if (!conn || !prefix || !revision)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	/*
+	 * Revision first: a change landing between the two calls is then both
+	 * in the rows and replayed by the next watch, never in neither
+	 */
+	if (ramd_pgraft_kv_exec(conn, "pgraft_kv_revision", "SELECT pgraft_kv_revision()", 0,
+	                        NULL, revision) != RAMD_PGRAFT_SUCCESS)
+		return RAMD_PGRAFT_ERROR;
+
+	params[0] = prefix;
+	result = PQexecParams(conn,
+	                      "SELECT mod_revision, false, key, convert_from(value, 'UTF8'), "
+	                      "lease FROM pgraft_kv_get($1, prefix => true)",
+	                      1, NULL, params, NULL, NULL, 0);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK)
+	{
+		set_last_error("pgraft_kv_get failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	ramd_pgraft_kv_emit(result, fn, arg);
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
+int
+ramd_pgraft_kv_watch(PGconn* conn, const char* prefix, long long* revision,
+                     int timeout_ms, ramd_pgraft_kv_event_fn fn, void* arg,
+                     bool* compacted)
+{
+	char after[32];
+	char timeout[32];
+	const char* params[3];
+	const char* sqlstate;
+	PGresult* result;
+	int rows;
+
+	if (!conn || !prefix || !revision || !compacted)
+	{
+		set_last_error("Database connection is NULL");
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	*compacted = false;
+	snprintf(after, sizeof(after), "%lld", *revision);
+	snprintf(timeout, sizeof(timeout), "%d", timeout_ms);
+	params[0] = prefix;
+	params[1] = after;
+	params[2] = timeout;
+
+	/* Plain PQexecParams: the caller retries, and an error logged per retry is noise */
+	result = PQexecParams(conn,
+	                      "SELECT revision, event = 'delete', key, "
+	                      "coalesce(convert_from(value, 'UTF8'), ''), lease "
+	                      "FROM pgraft_kv_watch($1, $2::bigint, "
+	                      "make_interval(secs => $3::integer / 1000.0))",
+	                      3, NULL, params, NULL, NULL, 0);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK)
+	{
+		sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+		if (sqlstate && strcmp(sqlstate, "72000") == 0)
+		{
+			*compacted = true;
+			PQclear(result);
+			return RAMD_PGRAFT_SUCCESS;
+		}
+		set_last_error("pgraft_kv_watch failed: %s", PQerrorMessage(conn));
+		PQclear(result);
+		return RAMD_PGRAFT_ERROR;
+	}
+
+	ramd_pgraft_kv_emit(result, fn, arg);
+	rows = PQntuples(result);
+	if (rows > 0)
+		*revision = (long long) ramd_query_value_int64(result, rows - 1, 0, *revision);
+	PQclear(result);
+	return RAMD_PGRAFT_SUCCESS;
+}
+
 char*
 ramd_pgraft_get_cluster_health(PGconn* conn)
 {
@@ -313,7 +895,7 @@ ramd_pgraft_get_cluster_health(PGconn* conn)
 int
 ramd_pgraft_is_cluster_healthy(PGconn* conn)
 {
-	return execute_boolean_query(conn, "SELECT pgraft_is_cluster_healthy()");
+	return execute_prepared_boolean(conn, RAMD_QUERY_STMT_PGRAFT_CLUSTER_HEALTHY);
 }
 
 char*
@@ -446,6 +1028,12 @@ ramd_pgraft_setup_replica(PGconn* conn, int replica_node_id,
 	ramd_log_info("Setting up replica node %d at %s:%d", replica_node_id, replica_hostname, replica_port);
 	ramd_log_info("Taking base backup to directory: %s", replica_backup_dir);
 
+	/* Slot first, so the WAL the backup needs to catch up is kept for it */
+	if (g_ramd_daemon && g_ramd_daemon->config.replication_slots_enabled &&
+	    !ramd_slots_create(conn, replica_node_id))
+		ramd_log_warning("Could not create a replication slot for replica node %d",
+		                 replica_node_id);
+
 	result = ramd_take_basebackup(conn, replica_backup_dir, backup_label);
 	if (result != 0)
 	{
@@ -455,7 +1043,7 @@ ramd_pgraft_setup_replica(PGconn* conn, int replica_node_id,
 
 	ramd_log_info("Base backup completed successfully for replica %d", replica_node_id);
 
-	result = ramd_pgraft_add_node(conn, replica_node_id, replica_hostname, replica_port);
+	result = ramd_pgraft_add_node(conn, replica_node_id, replica_hostname, replica_port, true);
 	if (result != RAMD_PGRAFT_SUCCESS)
 	{
 		set_last_error("Failed to add replica %d to Raft cluster", replica_node_id);
@@ -465,3 +1053,94 @@ ramd_pgraft_setup_replica(PGconn* conn, int replica_node_id,
 	ramd_log_info("Successfully set up replica node %d and added to Raft cluster", replica_node_id);
 	return RAMD_PGRAFT_SUCCESS;
 }
+
+static void
+metrics_unmap(void)
+{
+	if (g_metrics_map)
+		munmap((void*) g_metrics_map, sizeof(ramd_pgraft_metrics_t));
+	g_metrics_map = NULL;
+	g_metrics_map_path[0] = '\0';
+}
+
+/* Map path read-only; the caller holds g_metrics_map_lock */
+static bool
+metrics_map(const char* path)
+{
+	struct stat st;
+	void* addr;
+	int fd;
+
+	if (g_metrics_map && strcmp(g_metrics_map_path, path) == 0)
+		return true;
+	metrics_unmap();
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(ramd_pgraft_metrics_t))
+	{
+		close(fd);
+		return false;
+	}
+	addr = mmap(NULL, sizeof(ramd_pgraft_metrics_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return false;
+
+	g_metrics_map = addr;
+	strncpy(g_metrics_map_path, path, sizeof(g_metrics_map_path) - 1);
+	g_metrics_map_path[sizeof(g_metrics_map_path) - 1] = '\0';
+	return true;
+}
+
+bool
+ramd_pgraft_read_metrics(const char* data_dir, ramd_pgraft_metrics_t* out)
+{
+	char path[512];
+	const volatile uint64_t* seq;
+	uint64_t before;
+	uint64_t after;
+	bool ok = false;
+	int attempt;
+
+	if (!data_dir || !data_dir[0] || !out)
+		return false;
+	snprintf(path, sizeof(path), "%s/%s", data_dir, RAMD_PGRAFT_METRICS_FILE);
+
+	pthread_mutex_lock(&g_metrics_map_lock);
+	if (!metrics_map(path))
+	{
+		pthread_mutex_unlock(&g_metrics_map_lock);
+		return false;
+	}
+
+	/* The magic is stored last when pgraft initializes the file */
+	if (g_metrics_map->magic != RAMD_PGRAFT_METRICS_MAGIC ||
+	    g_metrics_map->version != RAMD_PGRAFT_METRICS_VERSION)
+	{
+		/* Drop the mapping so a restarted worker's file is picked up */
+		metrics_unmap();
+		pthread_mutex_unlock(&g_metrics_map_lock);
+		return false;
+	}
+
+	seq = &g_metrics_map->seq;
+	for (attempt = 0; attempt < RAMD_PGRAFT_METRICS_READ_RETRIES && !ok; attempt++)
+	{
+		before = *seq;
+		if (before & 1)
+		{
+			usleep(50);
+			continue;
+		}
+		atomic_thread_fence(memory_order_acquire);
+		memcpy(out, (const void*) g_metrics_map, sizeof(*out));
+		atomic_thread_fence(memory_order_acquire);
+		after = *seq;
+		ok = before == after && before != 0;
+	}
+	pthread_mutex_unlock(&g_metrics_map_lock);
+
+	return ok;
+}
@@ -14,11 +14,48 @@
 #include "ramd_basebackup.h"
 #include "ramd_conn.h"
 #include "ramd_query.h"
+#include "ramd_process.h"
+#include "ramd_metrics.h"
+#include "ramd_pgraft.h"
+#include "ramd_daemon.h"
+#include "ramd_clock.h"
 #include <libpq-fe.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <signal.h>
+#include <stdio.h>
+
+/*
+ * Run "pg_ctl <action> -D <data dir> <extra...>" without a shell.  When
+ * result is NULL a failure is logged here.
+ */
+static bool
+ramd_postgresql_pg_ctl(const ramd_config_t *config, const char *action,
+                       const char *const extra[], int32_t timeout_ms,
+                       ramd_process_result_t *result)
+{
+	ramd_process_result_t local;
+	const char *argv[16];
+	char        pg_ctl[RAMD_MAX_PATH_LENGTH];
+	int         n = 0;
+	bool        ok;
+
+	snprintf(pg_ctl, sizeof(pg_ctl), "%s/pg_ctl", config->postgresql_bin_dir);
+	argv[n++] = pg_ctl;
+	argv[n++] = action;
+	argv[n++] = "-D";
+	argv[n++] = config->postgresql_data_dir;
+	for (int i = 0; extra && extra[i] && n < 15; i++)
+		argv[n++] = extra[i];
+	argv[n] = NULL;
+
+	ok = ramd_process_run(argv, timeout_ms, result ? result : &local);
+	if (!ok && !result)
+		ramd_process_log_failure("pg_ctl", &local);
+	return ok;
+}
 
 bool
 ramd_postgresql_connect(ramd_postgresql_connection_t *conn,
@@ -56,11 +93,13 @@ ramd_postgresql_connect(ramd_postgresql_connection_t *conn,
 		ramd_log_error("PostgreSQL connection failed");
 		conn->connection = NULL;
 		conn->is_connected = false;
+		conn->status_prepared = false;
 		return false;
 	}
 
 	conn->is_connected = true;
-	conn->last_activity = time(NULL);
+	conn->status_prepared = false;
+	conn->last_activity_ms = ramd_clock_now_ms();
 
 	ramd_log_info("Connected to PostgreSQL: %s:%d/%s", host, port, database);
 	return true;
@@ -79,53 +118,146 @@ ramd_postgresql_disconnect(ramd_postgresql_connection_t *conn)
 	}
 
 	conn->is_connected = false;
+	conn->status_prepared = false;
 	ramd_log_debug("Disconnected from PostgreSQL: %s:%d", conn->host, conn->port);
 }
 
+/*
+ * Read postmaster.pid: the postmaster's pid and, since PostgreSQL 10, its
+ * state on line 8 ("starting", "stopping", "ready" or "standby"; empty if
+ * the file has no such line).  False if there is no readable pid.
+ */
+static bool
+ramd_postgresql_read_pidfile(const ramd_config_t *config, pid_t *pid,
+                             char *state, size_t state_size)
+{
+	char  path[RAMD_MAX_PATH_LENGTH];
+	char  line[RAMD_MAX_PATH_LENGTH];
+	FILE *file;
+	long  value = 0;
+
+	snprintf(path, sizeof(path), "%s/postmaster.pid", config->postgresql_data_dir);
+	file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	state[0] = '\0';
+	for (int n = 1; fgets(line, sizeof(line), file); n++)
+	{
+		if (n == 1)
+			value = strtol(line, NULL, 10);
+		else if (n == 8)
+		{
+			size_t len = strcspn(line, " \n");
+
+			if (len >= state_size)
+				len = state_size - 1;
+			memcpy(state, line, len);
+			state[len] = '\0';
+			break;
+		}
+	}
+	fclose(file);
+
+	if (value <= 0)
+		return false;
+	*pid = (pid_t) value;
+	return true;
+}
+
+/* A postmaster.pid whose process still exists; what pg_ctl status checks */
+static bool
+ramd_postgresql_postmaster_alive(const ramd_config_t *config, char *state, size_t state_size)
+{
+	pid_t pid;
+
+	if (!ramd_postgresql_read_pidfile(config, &pid, state, state_size))
+		return false;
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+/*
+ * Liveness without a process: a stale postmaster.pid or none at all is
+ * settled by kill(pid, 0) in microseconds, and only a live postmaster
+ * costs a PQping to tell whether it takes connections yet.
+ */
+ramd_postgresql_liveness_t
+ramd_postgresql_check_liveness(const ramd_config_t *config)
+{
+	const char *keywords[] = {"host", "port", "dbname", "connect_timeout", NULL};
+	const char *values[5];
+	char        port[16];
+	char        state[16];
+	PGPing      ping;
+
+	if (!config || !ramd_postgresql_postmaster_alive(config, state, sizeof(state)))
+		return RAMD_POSTGRESQL_DOWN;
+
+	if (strcmp(state, "starting") == 0 || strcmp(state, "stopping") == 0)
+		return RAMD_POSTGRESQL_NOT_ACCEPTING;
+
+	snprintf(port, sizeof(port), "%d", config->postgresql_port);
+	values[0] = config->hostname;
+	values[1] = port;
+	values[2] = config->database_name;
+	values[3] = "2";
+	values[4] = NULL;
+
+	ping = PQpingParams(keywords, values, 0);
+	return ping == PQPING_OK ? RAMD_POSTGRESQL_ACCEPTING : RAMD_POSTGRESQL_NOT_ACCEPTING;
+}
+
 bool
 ramd_postgresql_is_running(const ramd_config_t *config)
 {
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
+	char state[16];
+	bool running;
 
 	if (!config)
 		return false;
 
-	snprintf(command, sizeof(command), "%s/pg_ctl status -D %s >/dev/null 2>&1",
-	         config->postgresql_bin_dir, config->postgresql_data_dir);
+	running = ramd_postgresql_postmaster_alive(config, state, sizeof(state));
+	ramd_log_debug("PostgreSQL status check: node %d is %s (port %d%s%s)", config->node_id,
+	               running ? "running" : "not running", config->postgresql_port,
+	               running && state[0] ? ", " : "", running ? state : "");
+	return running;
+}
 
-	status = system(command);
+/* Poll postmaster.pid until the server reports state; pg_ctl promote -w does the same */
+static bool
+ramd_postgresql_wait_for_state(const ramd_config_t *config, const char *wanted,
+                               int32_t timeout_ms)
+{
+	int64_t deadline = ramd_clock_now_us() + (int64_t) timeout_ms * 1000;
+	char    state[16];
 
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	while (ramd_clock_now_us() < deadline)
 	{
-		ramd_log_debug("PostgreSQL status check: node %d is running (port %d)", config->node_id, config->postgresql_port);
-		return true;
+		if (!ramd_postgresql_postmaster_alive(config, state, sizeof(state)))
+			return false;
+		if (state[0] == '\0' || strcmp(state, wanted) == 0)
+			return true; /* no state line before PostgreSQL 10: nothing to wait for */
+		usleep(RAMD_PG_LIVENESS_POLL_MS * 1000);
 	}
-
-	ramd_log_debug("PostgreSQL status check: node %d is not running (port %d, exit_code=%d)", 
-	               config->node_id, config->postgresql_port, WEXITSTATUS(status));
 	return false;
 }
 
 bool
 ramd_postgresql_start(const ramd_config_t *config)
 {
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
+	char        log_file[RAMD_MAX_PATH_LENGTH];
+	const char *extra[] = {"-l", log_file, "-W", NULL};
 
 	if (!config)
 		return false;
 
 	ramd_log_info("Starting PostgreSQL on node %d", config->node_id);
 
-	snprintf(command, sizeof(command),
-	         "%s/pg_ctl start -D %s -l %s/postgresql.log -w -t 60",
-	         config->postgresql_bin_dir, config->postgresql_data_dir,
-	         config->postgresql_data_dir);
-
-	status = system(command);
+	snprintf(log_file, sizeof(log_file), "%s/postgresql.log", config->postgresql_data_dir);
 
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	/* pg_ctl -w polls every 100 ms; the wait below polls every few */
+	if (ramd_postgresql_pg_ctl(config, "start", extra, RAMD_PG_CTL_TIMEOUT_MS, NULL) &&
+	    ramd_postgresql_wait_for_startup(config, RAMD_PG_WAIT_SECONDS))
 	{
 		ramd_log_info("PostgreSQL started successfully on node %d", config->node_id);
 		return true;
@@ -138,20 +270,15 @@ ramd_postgresql_start(const ramd_config_t *config)
 bool
 ramd_postgresql_stop(const ramd_config_t *config)
 {
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
+	const char *extra[] = {"-m", "fast", "-W", NULL};
 
 	if (!config)
 		return false;
 
 	ramd_log_info("Stopping PostgreSQL on node %d", config->node_id);
 
-	snprintf(command, sizeof(command), "%s/pg_ctl stop -D %s -m fast -w -t 60",
-	         config->postgresql_bin_dir, config->postgresql_data_dir);
-
-	status = system(command);
-
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	if (ramd_postgresql_pg_ctl(config, "stop", extra, RAMD_PG_CTL_TIMEOUT_MS, NULL) &&
+	    ramd_postgresql_wait_for_shutdown(config, RAMD_PG_WAIT_SECONDS))
 	{
 		ramd_log_info("PostgreSQL stopped successfully on node %d", config->node_id);
 		return true;
@@ -164,23 +291,84 @@ ramd_postgresql_stop(const ramd_config_t *config)
 bool
 ramd_postgresql_promote(const ramd_config_t *config)
 {
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
+	return ramd_postgresql_promote_local(config, NULL);
+}
+
+bool
+ramd_postgresql_promote_sql(PGconn *conn, int32_t wait_seconds, bool *sql_available)
+{
+	const char *params[2];
+	char        wait[16];
+	PGresult   *res;
+	const char *sqlstate;
+	bool        promoted = false;
+
+	*sql_available = false;
+	if (!conn || PQstatus(conn) != CONNECTION_OK || PQserverVersion(conn) < 120000)
+		return false;
+
+	snprintf(wait, sizeof(wait), "%d", wait_seconds);
+	params[0] = "true";
+	params[1] = wait;
+
+	res = PQexecParams(conn, "SELECT pg_promote($1::boolean, $2::integer)",
+	                   2, NULL, params, NULL, NULL, 0);
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+	{
+		*sql_available = true;
+		promoted = strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+		if (!promoted)
+			ramd_log_error("pg_promote() did not finish within %d s", wait_seconds);
+	}
+	else
+	{
+		sqlstate = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+
+		/*
+		 * Missing privilege or function, or a broken session, mean pg_ctl
+		 * may still work; anything else (not in recovery, for one) would
+		 * fail the same way there.
+		 */
+		*sql_available = sqlstate && strcmp(sqlstate, "42501") != 0 &&
+			strcmp(sqlstate, "42883") != 0 && PQstatus(conn) == CONNECTION_OK;
+		ramd_log_warning("pg_promote() failed: %s", PQerrorMessage(conn));
+	}
+	PQclear(res);
+	return promoted;
+}
+
+bool
+ramd_postgresql_promote_local(const ramd_config_t *config, PGconn *conn)
+{
+	const char *extra[] = {"-W", NULL};
+	bool        sql_available = false;
+	bool        ok;
+	int64_t     started;
+	int64_t     duration_us;
 
 	if (!config)
 		return false;
 
 	ramd_log_info("Promoting PostgreSQL to primary on node %d", config->node_id);
 
-	snprintf(command, sizeof(command), "%s/pg_ctl promote -D %s -w -t 60",
-	         config->postgresql_bin_dir, config->postgresql_data_dir);
-
-	status = system(command);
+	started = ramd_clock_now_us();
+	ok = ramd_postgresql_promote_sql(conn, RAMD_PROMOTE_WAIT_SECONDS, &sql_available);
+	if (!ok && !sql_available)
+	{
+		if (conn)
+			ramd_log_info("Promotion over SQL unavailable on node %d, using pg_ctl",
+			              config->node_id);
+		ok = ramd_postgresql_pg_ctl(config, "promote", extra, RAMD_PG_CTL_TIMEOUT_MS, NULL) &&
+		     ramd_postgresql_wait_for_state(config, "ready", RAMD_PG_WAIT_SECONDS * 1000);
+	}
+	duration_us = ramd_clock_now_us() - started;
 
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	if (ok)
 	{
-		ramd_log_info("PostgreSQL promoted to primary successfully on node %d",
-		              config->node_id);
+		ramd_metrics_observe_promotion(g_ramd_metrics, duration_us, sql_available);
+		ramd_log_info("PostgreSQL promoted to primary successfully on node %d in %.3f s (%s)",
+		              config->node_id, (double) duration_us / 1e6,
+		              sql_available ? "pg_promote" : "pg_ctl");
 		return true;
 	}
 
@@ -249,30 +437,101 @@ bool
 ramd_postgresql_get_status(ramd_postgresql_connection_t *conn,
                           ramd_postgresql_status_t *status)
 {
+	PGconn   *pgconn;
 	PGresult *res;
+	bool      ok;
 
 	if (!conn || !status || !conn->is_connected)
 		return false;
 
-	res = ramd_query_exec_with_result((PGconn *)conn->connection,
-	                                 "SELECT pg_is_in_recovery()");
+	pgconn = (PGconn *) conn->connection;
 
-	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	if (!conn->status_prepared)
 	{
+		res = PQprepare(pgconn, RAMD_POSTGRESQL_STATUS_STMT,
+		                RAMD_POSTGRESQL_STATUS_SQL, 0, NULL);
+		ok = (PQresultStatus(res) == PGRES_COMMAND_OK);
 		PQclear(res);
-		return false;
+		if (!ok)
+		{
+			ramd_log_error("Failed to prepare status query: %s", PQerrorMessage(pgconn));
+			return false;
+		}
+		conn->status_prepared = true;
 	}
 
+	res = PQexecPrepared(pgconn, RAMD_POSTGRESQL_STATUS_STMT, 0, NULL, NULL, NULL, 0);
+	ok = ramd_postgresql_parse_status(res, status);
+	if (!ok)
+		ramd_log_debug("Status query failed: %s", PQerrorMessage(pgconn));
+	PQclear(res);
+
+	if (ok)
+		conn->last_activity_ms = status->last_check_ms;
+	return ok;
+}
+
+/*
+ * Fill a status sample from the result of RAMD_POSTGRESQL_STATUS_SQL
+ */
+bool
+ramd_postgresql_parse_status(const PGresult *res, ramd_postgresql_status_t *status)
+{
+	if (!res || !status)
+		return false;
+
+	memset(status, 0, sizeof(*status));
+
+	if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1 ||
+	    PQnfields(res) < 12)
+		return false;
+
 	status->is_in_recovery = (strcmp(PQgetvalue(res, 0, 0), "t") == 0);
 	status->is_running = true;
 	status->is_primary = !status->is_in_recovery;
 	status->accepts_connections = true;
-	status->last_check = time(NULL);
-
-	PQclear(res);
+	status->received_wal_lsn = atoll(PQgetvalue(res, 0, 2));
+	status->replayed_wal_lsn = atoll(PQgetvalue(res, 0, 3));
+	if (status->is_in_recovery)
+		status->current_wal_lsn = status->received_wal_lsn > status->replayed_wal_lsn
+		                          ? status->received_wal_lsn : status->replayed_wal_lsn;
+	else
+		status->current_wal_lsn = atoll(PQgetvalue(res, 0, 1));
+	status->replication_lag_seconds = (float) atof(PQgetvalue(res, 0, 4));
+	status->timeline_id = (int32_t) atoi(PQgetvalue(res, 0, 5));
+	status->active_connections = (int32_t) atoi(PQgetvalue(res, 0, 6));
+	status->client_connections = (int32_t) atoi(PQgetvalue(res, 0, 7));
+	status->long_running_queries = (int32_t) atoi(PQgetvalue(res, 0, 8));
+	status->autovacuum_workers = (int32_t) atoi(PQgetvalue(res, 0, 9));
+	status->max_connections = (int32_t) atoi(PQgetvalue(res, 0, 10));
+	status->postmaster_start_time = (time_t) atoll(PQgetvalue(res, 0, 11));
+	status->host_load = PQnfields(res) > 12 && !PQgetisnull(res, 0, 12)
+	                    ? (int32_t) atoi(PQgetvalue(res, 0, 12)) : -1;
+	status->last_check_ms = ramd_clock_now_ms();
 	return true;
 }
 
+/*
+ * Health score of one status sample, on the RAMD_HEALTH_* scale
+ */
+float
+ramd_postgresql_score_status(const ramd_postgresql_status_t *status)
+{
+	float score = 0.0f;
+
+	if (!status || !status->is_running || !status->accepts_connections)
+		return 0.0f;
+
+	score += RAMD_HEALTH_BASE_SCORE;
+	score += status->is_primary ? RAMD_HEALTH_PRIMARY_BONUS : RAMD_HEALTH_STANDBY_SCORE;
+	if (status->current_wal_lsn > 0)
+		score += RAMD_HEALTH_WAL_SCORE;
+	if (status->autovacuum_workers < RAMD_MAX_VACUUM_PROCESSES)
+		score += RAMD_HEALTH_VACUUM_BONUS;
+
+	return score;
+}
+
 bool
 ramd_postgresql_is_primary(ramd_postgresql_connection_t *conn)
 {
@@ -323,31 +582,22 @@ ramd_postgresql_restart(const ramd_config_t *config)
 
 	ramd_log_info("Restarting PostgreSQL on node %d", config->node_id);
 
+	/* stop returns once the postmaster has exited, so start can follow at once */
 	if (!ramd_postgresql_stop(config))
 		return false;
 
-	sleep(RAMD_POSTGRESQL_RESTART_DELAY);
-
 	return ramd_postgresql_start(config);
 }
 
 bool
 ramd_postgresql_reload(const ramd_config_t *config)
 {
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
-
 	if (!config)
 		return false;
 
 	ramd_log_info("Reloading PostgreSQL configuration on node %d", config->node_id);
 
-	snprintf(command, sizeof(command), "%s/pg_ctl reload -D %s",
-	         config->postgresql_bin_dir, config->postgresql_data_dir);
-
-	status = system(command);
-
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	if (ramd_postgresql_pg_ctl(config, "reload", NULL, RAMD_PG_CTL_STATUS_TIMEOUT_MS, NULL))
 	{
 		ramd_log_info("PostgreSQL configuration reloaded successfully on node %d",
 		              config->node_id);
@@ -452,6 +702,77 @@ ramd_postgresql_remove_recovery_conf(const ramd_config_t *config)
 	return false;
 }
 
+bool
+ramd_postgresql_alter_system(PGconn *conn, const char *name, const char *value)
+{
+	char      sql[RAMD_MAX_COMMAND_LENGTH * 2];
+	char     *literal;
+	PGresult *res;
+	bool      ok;
+
+	literal = PQescapeLiteral(conn, value, strlen(value));
+	if (!literal)
+		return false;
+	snprintf(sql, sizeof(sql), "ALTER SYSTEM SET %s = %s", name, literal);
+	PQfreemem(literal);
+
+	res = PQexec(conn, sql);
+	ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+	if (!ok)
+		ramd_log_error("ALTER SYSTEM SET %s failed: %s", name, PQerrorMessage(conn));
+	PQclear(res);
+	return ok;
+}
+
+bool
+ramd_postgresql_repoint_standby(PGconn *conn, const ramd_config_t *config,
+                                const char *primary_host, int32_t primary_port,
+                                int32_t standby_node_id, const char *slot_name,
+                                bool *needs_restart)
+{
+	char      conninfo[RAMD_MAX_COMMAND_LENGTH];
+	int       version;
+	PGresult *res;
+	bool      ok;
+
+	*needs_restart = false;
+	if (!conn || !config || !primary_host || PQstatus(conn) != CONNECTION_OK)
+		return false;
+
+	version = PQserverVersion(conn);
+	if (version < 120000)
+	{
+		ramd_log_warning("Server version %d keeps primary_conninfo in recovery.conf", version);
+		return false;
+	}
+
+	/* dbname is ignored by streaming, but the 17 slot sync worker needs it */
+	snprintf(conninfo, sizeof(conninfo),
+	         "host=%s port=%d user=%s application_name=ramd_node_%d%s%s",
+	         primary_host, primary_port, config->replication_user, standby_node_id,
+	         config->logical_slot_sync_enabled && version >= 170000 ? " dbname=" : "",
+	         config->logical_slot_sync_enabled && version >= 170000 ? config->database_name : "");
+	if (!ramd_postgresql_alter_system(conn, "primary_conninfo", conninfo))
+		return false;
+	if (slot_name && slot_name[0] != '\0' &&
+	    !ramd_postgresql_alter_system(conn, "primary_slot_name", slot_name))
+		return false;
+
+	/* Before 13 the walreceiver only picks them up on restart */
+	if (version < 130000)
+	{
+		*needs_restart = true;
+		return true;
+	}
+
+	res = PQexec(conn, "SELECT pg_reload_conf()");
+	ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+	if (!ok)
+		ramd_log_error("pg_reload_conf() failed: %s", PQerrorMessage(conn));
+	PQclear(res);
+	return ok;
+}
+
 bool
 ramd_postgresql_validate_data_directory(const ramd_config_t *config)
 {
@@ -496,8 +817,9 @@ ramd_postgresql_update_config(const ramd_config_t *config,
                             const char *value)
 {
 	char postgresql_conf_path[RAMD_MAX_PATH_LENGTH];
-	char command[RAMD_MAX_COMMAND_LENGTH];
-	int  status;
+	char expression[RAMD_MAX_COMMAND_LENGTH];
+	const char *argv[] = {"sed", "-i.bak", expression, postgresql_conf_path, NULL};
+	ramd_process_result_t result;
 
 	if (!config || !parameter || !value)
 		return false;
@@ -505,13 +827,10 @@ ramd_postgresql_update_config(const ramd_config_t *config,
 	snprintf(postgresql_conf_path, sizeof(postgresql_conf_path),
 	         "%s/postgresql.conf", config->postgresql_data_dir);
 
-	snprintf(command, sizeof(command),
-	         "sed -i.bak 's/^#\\?%s.*$/%s = %s/' %s",
-	         parameter, parameter, value, postgresql_conf_path);
+	snprintf(expression, sizeof(expression), "s/^#\\?%s.*$/%s = %s/",
+	         parameter, parameter, value);
 
-	status = system(command);
-
-	if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	if (ramd_process_run(argv, RAMD_PG_CTL_STATUS_TIMEOUT_MS, &result))
 	{
 		ramd_log_info("Updated PostgreSQL configuration: %s = %s",
 		              parameter, value);
@@ -522,6 +841,24 @@ ramd_postgresql_update_config(const ramd_config_t *config,
 	return false;
 }
 
+/* Major version from the data directory's PG_VERSION, 0 if unreadable */
+static int
+ramd_postgresql_data_dir_major(const ramd_config_t *config)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	int major = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/PG_VERSION", config->postgresql_data_dir);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%d", &major) != 1)
+		major = 0;
+	fclose(f);
+	return major;
+}
+
 bool
 ramd_postgresql_enable_archiving(const ramd_config_t *config)
 {
@@ -534,6 +871,16 @@ ramd_postgresql_enable_archiving(const ramd_config_t *config)
 	if (!ramd_postgresql_update_config(config, "archive_mode", "on"))
 		return false;
 
+	/* 15+ loads pgraft as the archive module and hands us the files */
+	if (config->archive_enabled && ramd_postgresql_data_dir_major(config) >= 15)
+	{
+		if (!ramd_postgresql_update_config(config, "archive_command", "''") ||
+		    !ramd_postgresql_update_config(config, "archive_library", "'pgraft'"))
+			return false;
+		ramd_log_info("Enabled WAL archiving through ramd on node %d", config->node_id);
+		return true;
+	}
+
 	pgarchive = getenv("PGARCHIVE");
 	if (pgarchive && strlen(pgarchive) > 0)
 		snprintf(archive_command, sizeof(archive_command),
@@ -573,49 +920,18 @@ bool
 ramd_postgresql_health_check(ramd_postgresql_connection_t *conn,
                            float *health_score)
 {
-	PGresult *res;
-	float     score = 0.0f;
+	ramd_postgresql_status_t status;
 
 	if (!conn || !health_score)
 		return false;
 
-	if (!ramd_postgresql_accepts_connections(conn))
+	if (!ramd_postgresql_get_status(conn, &status))
 	{
 		*health_score = 0.0f;
 		return false;
 	}
 
-	score += RAMD_HEALTH_BASE_SCORE;
-
-	res = ramd_query_exec_with_result((PGconn *)conn->connection,
-	                                 "SELECT pg_is_in_recovery()");
-	if (PQresultStatus(res) == PGRES_TUPLES_OK)
-	{
-		if (strcmp(PQgetvalue(res, 0, 0), "f") == 0)
-			score += RAMD_HEALTH_PRIMARY_BONUS;
-		else
-			score += RAMD_HEALTH_STANDBY_SCORE;
-	}
-	PQclear(res);
-
-	res = ramd_query_exec_with_result((PGconn *)conn->connection,
-	                                 "SELECT pg_current_wal_lsn()");
-	if (PQresultStatus(res) == PGRES_TUPLES_OK)
-		score += RAMD_HEALTH_WAL_SCORE;
-	PQclear(res);
-
-	res = ramd_query_exec_with_result((PGconn *)conn->connection,
-	                                 "SELECT count(*) FROM pg_stat_activity "
-	                                 "WHERE query LIKE '%autovacuum%'");
-	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
-	{
-		int vacuum_count = atoi(PQgetvalue(res, 0, 0));
-		if (vacuum_count < RAMD_MAX_VACUUM_PROCESSES)
-			score += RAMD_HEALTH_VACUUM_BONUS;
-	}
-	PQclear(res);
-
-	*health_score = score;
+	*health_score = ramd_postgresql_score_status(&status);
 	return true;
 }
 
@@ -648,9 +964,12 @@ ramd_postgresql_check_replication_lag(ramd_postgresql_connection_t *conn,
 	if (!conn || !lag_seconds || !conn->is_connected)
 		return false;
 
+	/* A standby that has replayed everything it received is not lagging */
 	res = ramd_query_exec_with_result((PGconn *)conn->connection,
-	                                 "SELECT EXTRACT(EPOCH FROM (now() - "
-	                                 "pg_last_xact_replay_timestamp()))");
+	                                 "SELECT CASE WHEN pg_last_wal_receive_lsn() = "
+	                                 "pg_last_wal_replay_lsn() THEN 0 "
+	                                 "ELSE EXTRACT(EPOCH FROM (now() - "
+	                                 "pg_last_xact_replay_timestamp())) END");
 
 	if (PQresultStatus(res) != PGRES_TUPLES_OK)
 	{
@@ -708,11 +1027,18 @@ ramd_postgresql_execute_query(ramd_postgresql_connection_t *conn,
 	return true;
 }
 
+/*
+ * Both waits poll ramd_postgresql_check_liveness every
+ * RAMD_PG_LIVENESS_POLL_MS, so they return within a few milliseconds of
+ * the change rather than at the next whole second.
+ */
 bool
 ramd_postgresql_wait_for_startup(const ramd_config_t *config,
                                 int32_t timeout_seconds)
 {
-	int elapsed = 0;
+	ramd_postgresql_liveness_t liveness;
+	int64_t                    started;
+	int64_t                    elapsed_ms;
 
 	if (!config)
 		return false;
@@ -720,16 +1046,28 @@ ramd_postgresql_wait_for_startup(const ramd_config_t *config,
 	ramd_log_info("Waiting for PostgreSQL startup (timeout: %d seconds)",
 	              timeout_seconds);
 
-	while (elapsed < timeout_seconds)
+	started = ramd_clock_now_us();
+	for (;;)
 	{
-		if (ramd_postgresql_check_connectivity(config))
+		liveness = ramd_postgresql_check_liveness(config);
+		elapsed_ms = (ramd_clock_now_us() - started) / 1000;
+		if (liveness == RAMD_POSTGRESQL_ACCEPTING)
 		{
-			ramd_log_info("PostgreSQL is ready after %d seconds", elapsed);
+			ramd_log_info("PostgreSQL is ready after %lld ms", (long long) elapsed_ms);
 			return true;
 		}
 
-		sleep(1);
-		elapsed++;
+		/* The postmaster writes its pid file first thing; without one it has exited */
+		if (liveness == RAMD_POSTGRESQL_DOWN && elapsed_ms >= RAMD_PG_START_GRACE_MS)
+		{
+			ramd_log_error("PostgreSQL exited during startup after %lld ms",
+			               (long long) elapsed_ms);
+			return false;
+		}
+		if (elapsed_ms >= (int64_t) timeout_seconds * 1000)
+			break;
+
+		usleep(RAMD_PG_LIVENESS_POLL_MS * 1000);
 	}
 
 	ramd_log_error("PostgreSQL startup timeout after %d seconds", timeout_seconds);
@@ -740,7 +1078,9 @@ bool
 ramd_postgresql_wait_for_shutdown(const ramd_config_t *config,
                                  int32_t timeout_seconds)
 {
-	int elapsed = 0;
+	char    state[16];
+	int64_t started;
+	int64_t elapsed_ms;
 
 	if (!config)
 		return false;
@@ -748,17 +1088,20 @@ ramd_postgresql_wait_for_shutdown(const ramd_config_t *config,
 	ramd_log_info("Waiting for PostgreSQL shutdown (timeout: %d seconds)",
 	              timeout_seconds);
 
-	while (elapsed < timeout_seconds)
+	started = ramd_clock_now_us();
+	for (;;)
 	{
-		if (!ramd_postgresql_is_running(config))
+		elapsed_ms = (ramd_clock_now_us() - started) / 1000;
+		if (!ramd_postgresql_postmaster_alive(config, state, sizeof(state)))
 		{
-			ramd_log_info("PostgreSQL shutdown completed after %d seconds",
-			              elapsed);
+			ramd_log_info("PostgreSQL shutdown completed after %lld ms",
+			              (long long) elapsed_ms);
 			return true;
 		}
+		if (elapsed_ms >= (int64_t) timeout_seconds * 1000)
+			break;
 
-		sleep(1);
-		elapsed++;
+		usleep(RAMD_PG_LIVENESS_POLL_MS * 1000);
 	}
 
 	ramd_log_error("PostgreSQL shutdown timeout after %d seconds", timeout_seconds);
@@ -851,9 +1194,13 @@ ramd_postgresql_update_recovery_conf(const char *path,
 			archive_dir[sizeof(archive_dir) - 1] = '\0';
 	}
 
-	fprintf(f, "restore_command = 'cp %s/%%f %%p'\n", archive_dir);
-	fprintf(f, "archive_cleanup_command = 'pg_archivecleanup %s %%r'\n",
-	        archive_dir);
+	/* ramd's archiver stores files gzip-compressed; plain copies still work */
+	fprintf(f, "restore_command = 'if [ -f %s/%%f" RAMD_ARCHIVE_COMPRESSED_SUFFIX " ]; "
+	        "then gzip -dc %s/%%f" RAMD_ARCHIVE_COMPRESSED_SUFFIX " > %%p; "
+	        "else cp %s/%%f %%p; fi'\n", archive_dir, archive_dir, archive_dir);
+	fprintf(f, "archive_cleanup_command = 'pg_archivecleanup %s %%r && "
+	        "pg_archivecleanup -x " RAMD_ARCHIVE_COMPRESSED_SUFFIX " %s %%r'\n",
+	        archive_dir, archive_dir);
 
 	fclose(f);
 
@@ -861,76 +1208,21 @@ ramd_postgresql_update_recovery_conf(const char *path,
 	return true;
 }
 
+/*
+ * The local node's health as the monitor last sampled it.  Nothing here
+ * connects, forks or stats: it is a read of ramd_monitor_get_health, and
+ * 0 before the monitor has a fresh sample.
+ */
 float
 ramd_postgresql_get_health_score(const ramd_config_t *config)
 {
-	float     health = 0.0f;
-	PGconn   *conn = NULL;
-	PGresult *res = NULL;
-	char      conninfo[512];
-	float     lag_seconds = 0.0f;
+	ramd_monitor_health_t health;
 
-	if (!config)
-		return 0.0f;
-
-	if (ramd_postgresql_is_running(config))
-		health += 0.5f;
-
-	if (ramd_postgresql_validate_data_directory(config))
-		health += 0.3f;
-
-	snprintf(conninfo, sizeof(conninfo),
-	         "host=%s port=%d dbname=%s user=%s",
-	         config->hostname, config->postgresql_port,
-	         config->database_name, config->database_user);
-
-	conn = ramd_conn_get(config->hostname, config->postgresql_port,
-	                    "postgres", config->database_user, "");
-	if (conn)
-	{
-		res = ramd_query_exec_with_result(conn,
-		                                 "SELECT CASE WHEN pg_is_in_recovery() "
-		                                 "THEN EXTRACT(EPOCH FROM (now() - "
-		                                 "pg_last_xact_replay_timestamp())) "
-		                                 "ELSE 0 END");
-		if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
-		{
-			lag_seconds = (float)atof(PQgetvalue(res, 0, 0));
-			if (lag_seconds < 60.0f)
-				health += 0.2f;
-			else if (lag_seconds > 300.0f)
-				health -= 0.3f;
-		}
-		PQclear(res);
+	if (!config || !g_ramd_daemon)
+		return RAMD_MIN_HEALTH_SCORE;
 
-		res = ramd_query_exec_with_result(conn,
-		                                 "SELECT count(*) FROM pg_stat_activity "
-		                                 "WHERE state = 'active' AND "
-		                                 "query_start < now() - interval '1 hour'");
-		if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
-		{
-			int long_queries = atoi(PQgetvalue(res, 0, 0));
-			if (long_queries == 0)
-				health += 0.1f;
-			else
-				health -= (long_queries * 0.05f); 
-		}
-		PQclear(res);
-
-		ramd_conn_close(conn);
-	}
-	else
-	{
-		
-		health -= 0.2f;
-		if (conn)
-			ramd_conn_close(conn);
-	}
-
-	ramd_log_debug("PostgreSQL health assessment: score=%.2f, connection=%s, replication_lag=%.2fs",
-	               health, conn ? "active" : "inactive", lag_seconds);
-
-	return health;
+	ramd_monitor_get_health(&g_ramd_daemon->monitor, &health);
+	return health.score;
 }
 
 
@@ -980,8 +1272,8 @@ bool ramd_postgresql_query_pgraft_cluster_status(const ramd_config_t* config,
                                                 bool* has_quorum)
 {
 	ramd_postgresql_connection_t conn;
+	ramd_pgraft_snapshot_t snapshot;
 	bool result = false;
-	PGresult* res;
 
 	if (!config || !node_count || !is_leader || !leader_id || !has_quorum)
 		return false;
@@ -996,27 +1288,24 @@ bool ramd_postgresql_query_pgraft_cluster_status(const ramd_config_t* config,
 	}
 
 	
-	res = ramd_query_exec_with_result((PGconn*) conn.connection,
-	             "SELECT * FROM pgraft_get_cluster_status();");
-
-	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
+	if (ramd_pgraft_get_cluster_snapshot((PGconn*) conn.connection, &snapshot) ==
+	    RAMD_PGRAFT_SUCCESS)
 	{
-		*node_count = atoi(PQgetvalue(res, 0, 0));
-		*is_leader = (PQgetvalue(res, 0, 1)[0] == 't');
-		*leader_id = atoi(PQgetvalue(res, 0, 2));
-		*has_quorum = (PQgetvalue(res, 0, 3)[0] == 't');
+		*node_count = snapshot.node_count;
+		*is_leader = snapshot.is_leader != 0;
+		*leader_id = (int32_t) snapshot.leader_id;
+		*has_quorum = snapshot.leader_id > 0;
 		result = true;
-		ramd_log_debug("pgraft cluster status: nodes=%d, leader=%s (id=%d), quorum=%s, term=%d",
+		ramd_log_debug("pgraft cluster status: nodes=%d, leader=%s (id=%d), quorum=%s, term=%lld",
 		               *node_count, *is_leader ? "true" : "false", *leader_id,
-		               *has_quorum ? "true" : "false", 0);
+		               *has_quorum ? "true" : "false", snapshot.term);
 	}
 	else
 	{
 		ramd_log_error("Failed to query pgraft cluster status: %s",
-		               PQerrorMessage((PGconn*) conn.connection));
+		               ramd_pgraft_get_last_error());
 	}
 
-	PQclear(res);
 	ramd_postgresql_disconnect(&conn);
 	return result;
 }
@@ -215,7 +215,10 @@ ramd_postgresql_auth_connect(void)
         return NULL;
     }
     
-    ramd_log_debug("Connecting to PostgreSQL with: %s", conninfo);
+    /* The conninfo may carry a password, so only the target is logged */
+    ramd_log_debug("Connecting to PostgreSQL at %s:%d",
+                   g_auth_context.hostname ? g_auth_context.hostname : "localhost",
+                   g_auth_context.port);
     
     /* Attempt connection */
     conn = PQconnectdb(conninfo);
@@ -0,0 +1,576 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_prewarm.c
+ *		PostgreSQL Auto-Failover Daemon - Switchover Buffer Prewarm
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A promoted standby starts with the buffers of its read traffic, not the
+ * primary's write working set, and a planned switchover would otherwise
+ * pay for that with minutes of cold reads.  Before the fence, the old
+ * primary's autoprewarm_dump_now() writes its buffer list to
+ * autoprewarm.blocks, which ramd reads from the local data directory: a
+ * line "database,tablespace,relfilenode,fork,block" per buffer, sorted.
+ * Runs of consecutive blocks become ranges of at most
+ * RAMD_PREWARM_RANGE_BLOCKS, and switchover_prewarm_workers sessions on
+ * the target take them in turn:
+ *
+ *   SELECT pg_prewarm(pg_filenode_relation(tablespace, relfilenode),
+ *                     'buffer', fork, first, last)
+ *
+ * The target is a physical copy, so relfilenodes match.  This overlaps
+ * the fence, catch-up and promotion and carries on afterwards; the
+ * switchover never waits for it.  Blocks of relations that are gone or
+ * shorter by now are skipped, and so are databases that lack the
+ * pg_prewarm extension.  Shared catalogs (database 0) are loaded through
+ * database_name.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ramd_prewarm.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_query.h"
+
+/* A run of consecutive blocks of one relation fork */
+typedef struct ramd_prewarm_range_t
+{
+	uint32_t database;
+	uint32_t tablespace;
+	uint32_t filenode;
+	uint32_t fork;
+	uint32_t first;
+	uint32_t last;
+} ramd_prewarm_range_t;
+
+/* A database of the block list and what became of it on the target */
+typedef struct ramd_prewarm_database_t
+{
+	uint32_t oid;
+	char name[RAMD_MAX_HOSTNAME_LENGTH];
+	atomic_bool skipped;
+} ramd_prewarm_database_t;
+
+typedef struct ramd_prewarm_job_t
+{
+	pthread_mutex_t lock; /* guards the status and the thread handle */
+	bool thread_joinable;
+	pthread_t thread;
+	ramd_prewarm_status_t status;
+
+	ramd_config_t config;
+	char target_host[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t target_port;
+	int64_t started_ms;
+	int64_t deadline_ms;
+	atomic_bool stop;
+
+	ramd_prewarm_range_t* ranges;
+	int32_t range_count;
+	atomic_int next_range;
+	ramd_prewarm_database_t* databases;
+	int32_t database_count;
+	atomic_llong blocks_done;
+	atomic_llong blocks_loaded;
+} ramd_prewarm_job_t;
+
+static ramd_prewarm_job_t g_prewarm = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static const char* const g_fork_names[] = {"main", "fsm", "vm", "init"};
+
+static const char* const g_prewarm_sql =
+    "SELECT pg_prewarm(r, 'buffer', $3, $4::int8, "
+    "least($5::int8, pg_relation_size(r, $3) / current_setting('block_size')::int8 - 1)) "
+    "FROM pg_filenode_relation($1::oid, $2::oid) r "
+    "WHERE $4::int8 < pg_relation_size(r, $3) / current_setting('block_size')::int8";
+
+static bool
+prewarm_add_range(ramd_prewarm_range_t** ranges, int32_t* count, int32_t* capacity,
+                  const ramd_prewarm_range_t* range)
+{
+	if (*count == *capacity)
+	{
+		int32_t grown = *capacity ? *capacity * 2 : 256;
+		ramd_prewarm_range_t* bigger = ramd_mem_realloc(RAMD_MEM_OTHER, *ranges,
+		                                                sizeof(**ranges) * (size_t) grown);
+
+		if (!bigger)
+			return false;
+		*ranges = bigger;
+		*capacity = grown;
+	}
+	(*ranges)[(*count)++] = *range;
+	return true;
+}
+
+/* Read autoprewarm.blocks into ranges; returns the number of blocks or -1 */
+static int64_t
+prewarm_read_blocks(const char* path, ramd_prewarm_range_t** ranges, int32_t* count)
+{
+	ramd_prewarm_range_t current;
+	ramd_prewarm_range_t block;
+	int32_t capacity = 0;
+	bool have = false;
+	int64_t blocks = 0;
+	char line[128];
+	FILE* fp;
+
+	*ranges = NULL;
+	*count = 0;
+	fp = fopen(path, "r");
+	if (!fp)
+	{
+		ramd_log_warning("Prewarm: cannot read %s: %s", path, strerror(errno));
+		return -1;
+	}
+
+	/* The first line is the block count, "<<N>>" */
+	if (!fgets(line, sizeof(line), fp) || strncmp(line, "<<", 2) != 0)
+	{
+		fclose(fp);
+		ramd_log_warning("Prewarm: %s is not an autoprewarm block list", path);
+		return -1;
+	}
+
+	memset(&current, 0, sizeof(current));
+	while (fgets(line, sizeof(line), fp))
+	{
+		if (sscanf(line, "%u,%u,%u,%u,%u", &block.database, &block.tablespace,
+		           &block.filenode, &block.fork, &block.first) != 5 ||
+		    block.fork >= sizeof(g_fork_names) / sizeof(g_fork_names[0]))
+			continue;
+		block.last = block.first;
+		blocks++;
+
+		if (have && block.database == current.database &&
+		    block.tablespace == current.tablespace && block.filenode == current.filenode &&
+		    block.fork == current.fork && block.first == current.last + 1 &&
+		    current.last - current.first + 1 < RAMD_PREWARM_RANGE_BLOCKS)
+		{
+			current.last = block.first;
+			continue;
+		}
+		if (have && !prewarm_add_range(ranges, count, &capacity, &current))
+			break;
+		current = block;
+		have = true;
+	}
+	fclose(fp);
+
+	if (have && !prewarm_add_range(ranges, count, &capacity, &current))
+	{
+		ramd_mem_free(RAMD_MEM_OTHER, *ranges);
+		*ranges = NULL;
+		*count = 0;
+		return -1;
+	}
+	return blocks;
+}
+
+/* Name the block list's databases after the target's pg_database */
+static bool
+prewarm_map_databases(void)
+{
+	const ramd_config_t* config = &g_prewarm.config;
+	PGconn* conn;
+	PGresult* res;
+	int32_t capacity = 0;
+
+	g_prewarm.databases = NULL;
+	g_prewarm.database_count = 0;
+	for (int32_t i = 0; i < g_prewarm.range_count; i++)
+	{
+		uint32_t oid = g_prewarm.ranges[i].database;
+
+		if (g_prewarm.database_count > 0 &&
+		    g_prewarm.databases[g_prewarm.database_count - 1].oid == oid)
+			continue;
+		if (g_prewarm.database_count == capacity)
+		{
+			int32_t grown = capacity ? capacity * 2 : 16;
+			ramd_prewarm_database_t* bigger =
+			    ramd_mem_realloc(RAMD_MEM_OTHER, g_prewarm.databases,
+			                     sizeof(*bigger) * (size_t) grown);
+
+			if (!bigger)
+				return false;
+			g_prewarm.databases = bigger;
+			capacity = grown;
+		}
+		memset(&g_prewarm.databases[g_prewarm.database_count], 0,
+		       sizeof(g_prewarm.databases[0]));
+		g_prewarm.databases[g_prewarm.database_count].oid = oid;
+		atomic_init(&g_prewarm.databases[g_prewarm.database_count].skipped, true);
+		g_prewarm.database_count++;
+	}
+
+	conn = ramd_conn_get(g_prewarm.target_host, g_prewarm.target_port, config->database_name,
+	                     config->database_user, config->database_password);
+	if (!conn)
+		return false;
+	res = ramd_query_exec_with_result(conn, "SELECT oid, datname FROM pg_database WHERE datallowconn");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		PQclear(res);
+		ramd_conn_close(conn);
+		return false;
+	}
+
+	for (int32_t i = 0; i < g_prewarm.database_count; i++)
+	{
+		ramd_prewarm_database_t* db = &g_prewarm.databases[i];
+
+		if (db->oid == 0)
+		{
+			snprintf(db->name, sizeof(db->name), "%s", config->database_name);
+			atomic_store(&db->skipped, false);
+			continue;
+		}
+		for (int row = 0; row < PQntuples(res); row++)
+			if (strtoul(PQgetvalue(res, row, 0), NULL, 10) == db->oid)
+			{
+				snprintf(db->name, sizeof(db->name), "%s", PQgetvalue(res, row, 1));
+				atomic_store(&db->skipped, false);
+				break;
+			}
+	}
+	PQclear(res);
+	ramd_conn_close(conn);
+	return true;
+}
+
+static ramd_prewarm_database_t*
+prewarm_find_database(uint32_t oid)
+{
+	for (int32_t i = 0; i < g_prewarm.database_count; i++)
+		if (g_prewarm.databases[i].oid == oid)
+			return &g_prewarm.databases[i];
+	return NULL;
+}
+
+/* Load one range on conn; false if the session or the database is unusable */
+static bool
+prewarm_load_range(PGconn* conn, const ramd_prewarm_range_t* range)
+{
+	char tablespace[16];
+	char filenode[16];
+	char first[16];
+	char last[16];
+	const char* values[5];
+	const char* sqlstate;
+	PGresult* res;
+	bool usable;
+	bool ok;
+
+	snprintf(tablespace, sizeof(tablespace), "%u", range->tablespace);
+	snprintf(filenode, sizeof(filenode), "%u", range->filenode);
+	snprintf(first, sizeof(first), "%u", range->first);
+	snprintf(last, sizeof(last), "%u", range->last);
+	values[0] = tablespace;
+	values[1] = filenode;
+	values[2] = g_fork_names[range->fork];
+	values[3] = first;
+	values[4] = last;
+
+	res = ramd_query_exec_params(conn, g_prewarm_sql, 5, NULL, values, NULL, NULL, 0);
+	ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+	if (ok && PQntuples(res) == 1 && !PQgetisnull(res, 0, 0))
+		atomic_fetch_add(&g_prewarm.blocks_loaded, strtoll(PQgetvalue(res, 0, 0), NULL, 10));
+	else if (!ok)
+		ramd_log_debug("Prewarm: range %u/%u/%u %s %u-%u failed: %s", range->database,
+		               range->tablespace, range->filenode, g_fork_names[range->fork],
+		               range->first, range->last, PQerrorMessage(conn));
+
+	/*
+	 * A relation dropped mid-way is not worth giving up the database for; a
+	 * lost session or a database without pg_prewarm() (undefined_function) is
+	 */
+	sqlstate = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : NULL;
+	usable = ok || (PQstatus(conn) == CONNECTION_OK && !(sqlstate && strcmp(sqlstate, "42883") == 0));
+	PQclear(res);
+	return usable;
+}
+
+static void*
+prewarm_worker(void* arg)
+{
+	const ramd_config_t* config = &g_prewarm.config;
+	ramd_prewarm_database_t* connected = NULL;
+	PGconn* conn = NULL;
+
+	(void) arg;
+	for (;;)
+	{
+		int32_t i = atomic_fetch_add(&g_prewarm.next_range, 1);
+		const ramd_prewarm_range_t* range;
+		ramd_prewarm_database_t* db;
+
+		if (i >= g_prewarm.range_count || atomic_load(&g_prewarm.stop) ||
+		    ramd_clock_now_ms() >= g_prewarm.deadline_ms)
+			break;
+		range = &g_prewarm.ranges[i];
+		db = prewarm_find_database(range->database);
+
+		if (db && db != connected && !atomic_load(&db->skipped))
+		{
+			if (conn)
+				ramd_conn_close(conn);
+			conn = ramd_conn_get(g_prewarm.target_host, g_prewarm.target_port, db->name,
+			                     config->database_user, config->database_password);
+			connected = conn ? db : NULL;
+			if (!conn)
+			{
+				atomic_store(&db->skipped, true);
+				ramd_log_warning("Prewarm: cannot connect to database \"%s\" on %s:%d",
+				                 db->name, g_prewarm.target_host, g_prewarm.target_port);
+			}
+		}
+		if (db && db == connected && !atomic_load(&db->skipped) &&
+		    !prewarm_load_range(conn, range))
+		{
+			atomic_store(&db->skipped, true);
+			ramd_log_warning("Prewarm: giving up on database \"%s\": %s", db->name,
+			                 PQerrorMessage(conn));
+		}
+		atomic_fetch_add(&g_prewarm.blocks_done, (long long) (range->last - range->first + 1));
+	}
+
+	if (conn)
+		ramd_conn_close(conn);
+	return NULL;
+}
+
+static void*
+prewarm_thread(void* arg)
+{
+	pthread_t workers[RAMD_PREWARM_MAX_WORKERS];
+	ramd_prewarm_state_t state = RAMD_PREWARM_SUCCEEDED;
+	int32_t started = 0;
+	int32_t wanted = g_prewarm.config.switchover_prewarm_workers;
+	int32_t skipped = 0;
+	char message[RAMD_MAX_COMMAND_LENGTH] = "";
+
+	(void) arg;
+	if (wanted > g_prewarm.range_count)
+		wanted = g_prewarm.range_count;
+
+	if (!prewarm_map_databases())
+	{
+		state = RAMD_PREWARM_FAILED;
+		snprintf(message, sizeof(message), "cannot list the databases of %s:%d",
+		         g_prewarm.target_host, g_prewarm.target_port);
+	}
+	else
+	{
+		for (; started < wanted; started++)
+			if (pthread_create(&workers[started], NULL, prewarm_worker, NULL) != 0)
+				break;
+		pthread_mutex_lock(&g_prewarm.lock);
+		g_prewarm.status.workers = started;
+		pthread_mutex_unlock(&g_prewarm.lock);
+
+		if (started == 0 && g_prewarm.range_count > 0)
+			prewarm_worker(NULL);
+		for (int32_t i = 0; i < started; i++)
+			pthread_join(workers[i], NULL);
+
+		for (int32_t i = 0; i < g_prewarm.database_count; i++)
+			if (atomic_load(&g_prewarm.databases[i].skipped))
+				skipped++;
+		if (atomic_load(&g_prewarm.next_range) < g_prewarm.range_count)
+		{
+			state = RAMD_PREWARM_CANCELLED;
+			snprintf(message, sizeof(message), "%s", atomic_load(&g_prewarm.stop)
+			         ? "cancelled" : "switchover_prewarm_timeout_ms reached");
+		}
+		else if (skipped > 0 && skipped == g_prewarm.database_count)
+		{
+			state = RAMD_PREWARM_FAILED;
+			snprintf(message, sizeof(message),
+			         "no database could be prewarmed; is the pg_prewarm extension installed?");
+		}
+	}
+
+	pthread_mutex_lock(&g_prewarm.lock);
+	g_prewarm.status.state = state;
+	g_prewarm.status.databases_skipped = skipped;
+	g_prewarm.status.blocks_done = atomic_load(&g_prewarm.blocks_done);
+	g_prewarm.status.blocks_loaded = atomic_load(&g_prewarm.blocks_loaded);
+	g_prewarm.status.duration_ms = ramd_clock_now_ms() - g_prewarm.started_ms;
+	snprintf(g_prewarm.status.message, sizeof(g_prewarm.status.message), "%s", message);
+	pthread_mutex_unlock(&g_prewarm.lock);
+
+	ramd_mem_free(RAMD_MEM_OTHER, g_prewarm.ranges);
+	ramd_mem_free(RAMD_MEM_OTHER, g_prewarm.databases);
+	g_prewarm.ranges = NULL;
+	g_prewarm.databases = NULL;
+
+	{
+		ramd_log_field_t fields[] = {
+			RAMD_LOG_INT("target", g_prewarm.status.target_node_id),
+			RAMD_LOG_INT("blocks_total", g_prewarm.status.blocks_total),
+			RAMD_LOG_INT("blocks_loaded", g_prewarm.status.blocks_loaded),
+			RAMD_LOG_INT("workers", started),
+			RAMD_LOG_INT("duration_ms", g_prewarm.status.duration_ms),
+		};
+
+		RAMD_LOG_KV(INFO, fields, "Prewarm of node %d %s%s%s", g_prewarm.status.target_node_id,
+		            ramd_prewarm_state_to_string(state), message[0] ? ": " : "", message);
+	}
+	return NULL;
+}
+
+bool
+ramd_prewarm_start(const ramd_config_t* config, PGconn* primary, const ramd_node_t* target)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	ramd_prewarm_range_t* ranges;
+	int32_t count;
+	int64_t blocks;
+	PGresult* res;
+
+	if (!config || !primary || !target || config->switchover_prewarm_workers <= 0)
+		return false;
+
+	/* One list at a time; the previous one is for a node no longer promoting */
+	ramd_prewarm_cleanup();
+
+	res = ramd_query_exec_with_result(primary, "SELECT autoprewarm_dump_now()");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		ramd_log_warning("Prewarm: autoprewarm_dump_now() failed, switching over cold: %s",
+		                 PQerrorMessage(primary));
+		PQclear(res);
+		return false;
+	}
+	PQclear(res);
+
+	if (snprintf(path, sizeof(path), "%s/%s", config->postgresql_data_dir,
+	             RAMD_PREWARM_BLOCKS_FILE) >= (int) sizeof(path))
+	{
+		ramd_log_warning("Prewarm: data directory path too long, switching over cold");
+		return false;
+	}
+	blocks = prewarm_read_blocks(path, &ranges, &count);
+	if (blocks < 0)
+		return false;
+
+	pthread_mutex_lock(&g_prewarm.lock);
+	memset(&g_prewarm.status, 0, sizeof(g_prewarm.status));
+	g_prewarm.status.state = RAMD_PREWARM_RUNNING;
+	g_prewarm.status.target_node_id = target->node_id;
+	g_prewarm.status.blocks_total = blocks;
+	g_prewarm.config = *config;
+	snprintf(g_prewarm.target_host, sizeof(g_prewarm.target_host), "%s", target->hostname);
+	g_prewarm.target_port = target->postgresql_port;
+	g_prewarm.started_ms = ramd_clock_now_ms();
+	g_prewarm.deadline_ms = g_prewarm.started_ms + config->switchover_prewarm_timeout_ms;
+	atomic_store(&g_prewarm.stop, false);
+	g_prewarm.ranges = ranges;
+	g_prewarm.range_count = count;
+	atomic_store(&g_prewarm.next_range, 0);
+	atomic_store(&g_prewarm.blocks_done, 0);
+	atomic_store(&g_prewarm.blocks_loaded, 0);
+
+	if (pthread_create(&g_prewarm.thread, NULL, prewarm_thread, NULL) != 0)
+	{
+		g_prewarm.status.state = RAMD_PREWARM_FAILED;
+		snprintf(g_prewarm.status.message, sizeof(g_prewarm.status.message),
+		         "failed to create prewarm thread");
+		g_prewarm.ranges = NULL;
+		pthread_mutex_unlock(&g_prewarm.lock);
+		ramd_mem_free(RAMD_MEM_OTHER, ranges);
+		return false;
+	}
+	g_prewarm.thread_joinable = true;
+	pthread_mutex_unlock(&g_prewarm.lock);
+
+	ramd_log_info("Prewarm: loading %lld blocks in %d ranges into node %d (%s:%d)",
+	              (long long) blocks, count, target->node_id, target->hostname,
+	              target->postgresql_port);
+	return true;
+}
+
+void
+ramd_prewarm_cancel(void)
+{
+	atomic_store(&g_prewarm.stop, true);
+}
+
+bool
+ramd_prewarm_wait(void)
+{
+	bool joinable;
+	pthread_t thread;
+	bool ok;
+
+	pthread_mutex_lock(&g_prewarm.lock);
+	joinable = g_prewarm.thread_joinable;
+	thread = g_prewarm.thread;
+	g_prewarm.thread_joinable = false;
+	pthread_mutex_unlock(&g_prewarm.lock);
+
+	if (joinable)
+		pthread_join(thread, NULL);
+
+	pthread_mutex_lock(&g_prewarm.lock);
+	ok = g_prewarm.status.state == RAMD_PREWARM_SUCCEEDED;
+	pthread_mutex_unlock(&g_prewarm.lock);
+	return ok;
+}
+
+void
+ramd_prewarm_cleanup(void)
+{
+	ramd_prewarm_cancel();
+	ramd_prewarm_wait();
+}
+
+void
+ramd_prewarm_get_status(ramd_prewarm_status_t* status)
+{
+	if (!status)
+		return;
+
+	pthread_mutex_lock(&g_prewarm.lock);
+	*status = g_prewarm.status;
+	if (status->state == RAMD_PREWARM_RUNNING)
+	{
+		status->blocks_done = atomic_load(&g_prewarm.blocks_done);
+		status->blocks_loaded = atomic_load(&g_prewarm.blocks_loaded);
+		status->duration_ms = ramd_clock_now_ms() - g_prewarm.started_ms;
+	}
+	pthread_mutex_unlock(&g_prewarm.lock);
+}
+
+const char*
+ramd_prewarm_state_to_string(ramd_prewarm_state_t state)
+{
+	switch (state)
+	{
+		case RAMD_PREWARM_IDLE:
+			return "idle";
+		case RAMD_PREWARM_RUNNING:
+			return "running";
+		case RAMD_PREWARM_SUCCEEDED:
+			return "succeeded";
+		case RAMD_PREWARM_FAILED:
+			return "failed";
+		case RAMD_PREWARM_CANCELLED:
+			return "cancelled";
+	}
+	return "unknown";
+}
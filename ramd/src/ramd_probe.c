@@ -0,0 +1,443 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_probe.c
+ *		PostgreSQL Auto-Failover Daemon - Concurrent Health Probes
+ *
+ * Every remote node keeps one libpq connection that survives across monitor
+ * cycles.  A cycle starts a non-blocking connect for nodes without a usable
+ * connection, sends the status query on the others, and drives all of them
+ * from a single poll() loop until they finish or the cycle deadline passes.
+ * A dead or black-holed host therefore costs at most one deadline per cycle,
+ * no matter how many nodes are probed.
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+
+#include "ramd_probe.h"
+#include "ramd_clock.h"
+#include "ramd_logging.h"
+#include "ramd_postgresql.h"
+
+static void
+ramd_probe_close(ramd_probe_target_t* target)
+{
+	if (target->conn)
+	{
+		PQfinish(target->conn);
+		target->conn = NULL;
+	}
+	target->state = RAMD_PROBE_DISCONNECTED;
+}
+
+static void
+ramd_probe_fail(ramd_probe_target_t* target, const char* reason)
+{
+	snprintf(target->error, sizeof(target->error), "%s", reason);
+	ramd_probe_close(target);
+	target->state = RAMD_PROBE_FAILED;
+}
+
+static void
+ramd_probe_start_connect(ramd_probe_engine_t* engine, ramd_probe_target_t* target)
+{
+	const char* keywords[8];
+	const char* values[8];
+	char        port[16];
+	char        timeout[16];
+	int         n = 0;
+
+	snprintf(port, sizeof(port), "%d", target->port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = target->host;
+	keywords[n] = "port";            values[n++] = port;
+	keywords[n] = "dbname";          values[n++] = engine->config->database_name;
+	keywords[n] = "user";            values[n++] = engine->config->database_user;
+	if (engine->config->database_password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = engine->config->database_password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd_probe";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	target->conn = PQconnectStartParams(keywords, values, 0);
+	if (!target->conn || PQstatus(target->conn) == CONNECTION_BAD)
+	{
+		ramd_probe_fail(target, target->conn ? PQerrorMessage(target->conn)
+		                                     : "out of memory");
+		return;
+	}
+
+	if (PQsetnonblocking(target->conn, 1) != 0)
+	{
+		ramd_probe_fail(target, PQerrorMessage(target->conn));
+		return;
+	}
+
+	target->state = RAMD_PROBE_CONNECTING;
+	target->poll_status = PGRES_POLLING_WRITING;
+}
+
+static bool
+ramd_probe_send(ramd_probe_target_t* target)
+{
+	if (!PQsendQuery(target->conn, RAMD_POSTGRESQL_STATUS_SQL))
+		return false;
+
+	target->state = RAMD_PROBE_QUERYING;
+	return PQflush(target->conn) >= 0;
+}
+
+/* Collect whatever results have arrived; returns false on a protocol error */
+static bool
+ramd_probe_consume(ramd_probe_target_t* target)
+{
+	PGresult* res;
+
+	if (!PQconsumeInput(target->conn))
+		return false;
+
+	while (!PQisBusy(target->conn))
+	{
+		res = PQgetResult(target->conn);
+		if (!res)
+		{
+			target->state = RAMD_PROBE_DONE;
+			return true;
+		}
+
+		if (ramd_postgresql_parse_status(res, &target->pending))
+			target->pending_ok = true;
+		else
+		{
+			snprintf(target->error, sizeof(target->error), "%s",
+			         PQresultErrorMessage(res));
+			target->pending_ok = false;
+		}
+		PQclear(res);
+	}
+
+	return true;
+}
+
+/* Bring the target list in line with the cluster's current membership */
+static void
+ramd_probe_sync_targets(ramd_probe_engine_t* engine, const ramd_cluster_t* cluster,
+                        int32_t skip_node_id)
+{
+	ramd_probe_target_t* target;
+	const ramd_node_t*   node;
+	int32_t              i;
+	int32_t              j;
+	bool                 found;
+
+	pthread_mutex_lock(&engine->lock);
+
+	/* Drop targets that left the cluster */
+	for (i = 0; i < engine->target_count;)
+	{
+		target = &engine->targets[i];
+		found = false;
+		for (j = 0; j < cluster->node_count; j++)
+		{
+			node = &cluster->nodes[j];
+			if (node->node_id == target->node_id && node->node_id != skip_node_id &&
+			    node->postgresql_port == target->port &&
+			    strcmp(node->hostname, target->host) == 0)
+			{
+				found = true;
+				break;
+			}
+		}
+
+		if (found)
+		{
+			i++;
+			continue;
+		}
+
+		ramd_probe_close(target);
+		engine->targets[i] = engine->targets[engine->target_count - 1];
+		engine->target_count--;
+	}
+
+	/* Add nodes that have no target yet */
+	for (j = 0; j < cluster->node_count; j++)
+	{
+		node = &cluster->nodes[j];
+		if (node->node_id == skip_node_id || ramd_probe_find(engine, node->node_id))
+			continue;
+		if (engine->target_count >= RAMD_MAX_NODES)
+			break;
+
+		target = &engine->targets[engine->target_count++];
+		memset(target, 0, sizeof(*target));
+		target->node_id = node->node_id;
+		strncpy(target->host, node->hostname, sizeof(target->host) - 1);
+		target->port = node->postgresql_port;
+		target->state = RAMD_PROBE_DISCONNECTED;
+	}
+
+	pthread_mutex_unlock(&engine->lock);
+}
+
+bool
+ramd_probe_init(ramd_probe_engine_t* engine, const ramd_config_t* config)
+{
+	if (!engine || !config)
+		return false;
+
+	memset(engine, 0, sizeof(*engine));
+	engine->config = config;
+	pthread_mutex_init(&engine->lock, NULL);
+	return true;
+}
+
+void
+ramd_probe_cleanup(ramd_probe_engine_t* engine)
+{
+	int32_t i;
+
+	if (!engine)
+		return;
+
+	pthread_mutex_lock(&engine->lock);
+	for (i = 0; i < engine->target_count; i++)
+		ramd_probe_close(&engine->targets[i]);
+	engine->target_count = 0;
+	pthread_mutex_unlock(&engine->lock);
+	pthread_mutex_destroy(&engine->lock);
+}
+
+int32_t
+ramd_probe_run(ramd_probe_engine_t* engine, const ramd_cluster_t* cluster,
+               int32_t skip_node_id, int32_t deadline_ms)
+{
+	return ramd_probe_run_quorum(engine, cluster, skip_node_id, deadline_ms, 0);
+}
+
+int32_t
+ramd_probe_run_quorum(ramd_probe_engine_t* engine, const ramd_cluster_t* cluster,
+                      int32_t skip_node_id, int32_t deadline_ms,
+                      int32_t min_answers)
+{
+	struct pollfd        fds[RAMD_MAX_NODES];
+	int32_t              owner[RAMD_MAX_NODES];
+	bool                 reused[RAMD_MAX_NODES];
+	ramd_probe_target_t* target;
+	int64_t              start_us;
+	int64_t              deadline_us;
+	int64_t              now_us;
+	int32_t              pending;
+	int32_t              answered;
+	int32_t              nfds;
+	int32_t              healthy = 0;
+	int32_t              i;
+	int                  rc;
+	int                  timeout_ms;
+
+	if (!engine || !cluster)
+		return 0;
+
+	if (deadline_ms <= 0)
+		deadline_ms = RAMD_HEALTH_CHECK_TIMEOUT_MS;
+
+	ramd_probe_sync_targets(engine, cluster, skip_node_id);
+
+	start_us = ramd_clock_now_us();
+	deadline_us = start_us + (int64_t) deadline_ms * 1000;
+
+	/* Kick off every probe before waiting on any of them */
+	for (i = 0; i < engine->target_count; i++)
+	{
+		target = &engine->targets[i];
+		target->pending_ok = false;
+		target->error[0] = '\0';
+		reused[i] = false;
+
+		if (target->conn && PQstatus(target->conn) == CONNECTION_OK)
+		{
+			reused[i] = true;
+			if (!ramd_probe_send(target))
+			{
+				/* The server dropped our idle session; reconnect right away */
+				ramd_probe_close(target);
+				reused[i] = false;
+			}
+		}
+		else
+			ramd_probe_close(target);
+
+		if (!target->conn)
+			ramd_probe_start_connect(engine, target);
+	}
+
+	for (;;)
+	{
+		nfds = 0;
+		pending = 0;
+		answered = 0;
+
+		for (i = 0; i < engine->target_count; i++)
+		{
+			target = &engine->targets[i];
+			if (target->state == RAMD_PROBE_DONE && target->pending_ok)
+				answered++;
+			if (target->state != RAMD_PROBE_CONNECTING &&
+			    target->state != RAMD_PROBE_QUERYING)
+				continue;
+
+			pending++;
+			fds[nfds].fd = PQsocket(target->conn);
+			fds[nfds].revents = 0;
+			if (target->state == RAMD_PROBE_CONNECTING)
+				fds[nfds].events = target->poll_status == PGRES_POLLING_READING
+				                   ? POLLIN : POLLOUT;
+			else
+				fds[nfds].events = (short) (POLLIN |
+				                   (PQflush(target->conn) == 1 ? POLLOUT : 0));
+			owner[nfds++] = i;
+		}
+
+		if (pending == 0 || (min_answers > 0 && answered >= min_answers))
+			break;
+
+		now_us = ramd_clock_now_us();
+		if (now_us >= deadline_us)
+			break;
+
+		timeout_ms = (int) ((deadline_us - now_us + 999) / 1000);
+		rc = poll(fds, (nfds_t) nfds, timeout_ms);
+		if (rc < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			ramd_log_error("Health probe poll failed: %s", strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < nfds; i++)
+		{
+			if (fds[i].revents == 0)
+				continue;
+
+			target = &engine->targets[owner[i]];
+			if (target->state == RAMD_PROBE_CONNECTING)
+			{
+				target->poll_status = PQconnectPoll(target->conn);
+				if (target->poll_status == PGRES_POLLING_OK)
+				{
+					target->state = RAMD_PROBE_IDLE;
+					if (!ramd_probe_send(target))
+						ramd_probe_fail(target, PQerrorMessage(target->conn));
+				}
+				else if (target->poll_status == PGRES_POLLING_FAILED)
+					ramd_probe_fail(target, PQerrorMessage(target->conn));
+			}
+			else if (ramd_probe_consume(target))
+			{
+				if (target->state == RAMD_PROBE_DONE)
+					target->rtt_us = ramd_clock_now_us() - start_us;
+			}
+			else
+			{
+				if (reused[owner[i]] && ramd_clock_now_us() < deadline_us)
+				{
+					/* Stale session; one fresh attempt within the same deadline */
+					ramd_probe_close(target);
+					reused[owner[i]] = false;
+					ramd_probe_start_connect(engine, target);
+				}
+				else
+					ramd_probe_fail(target, PQerrorMessage(target->conn));
+			}
+		}
+	}
+
+	/*
+	 * Settle the cycle: anything still in flight missed the deadline (or was
+	 * not needed once enough answers arrived) and loses its connection.
+	 */
+	now_us = ramd_clock_now_us();
+	pthread_mutex_lock(&engine->lock);
+	for (i = 0; i < engine->target_count; i++)
+	{
+		target = &engine->targets[i];
+
+		if (target->state == RAMD_PROBE_CONNECTING ||
+		    target->state == RAMD_PROBE_QUERYING)
+		{
+			snprintf(target->error, sizeof(target->error),
+			         "no response within %d ms", deadline_ms);
+			ramd_probe_close(target);
+			target->state = RAMD_PROBE_FAILED;
+		}
+
+		if (target->state == RAMD_PROBE_DONE && target->pending_ok)
+		{
+			target->state = RAMD_PROBE_IDLE;
+			target->healthy = true;
+			target->status = target->pending;
+			target->in_recovery = target->pending.is_in_recovery;
+			target->sampled_at_us = now_us;
+			target->consecutive_failures = 0;
+			healthy++;
+		}
+		else
+		{
+			if (target->state == RAMD_PROBE_DONE)
+				target->state = RAMD_PROBE_IDLE;
+			target->healthy = false;
+			target->consecutive_failures++;
+		}
+	}
+	pthread_mutex_unlock(&engine->lock);
+
+	return healthy;
+}
+
+const ramd_probe_target_t*
+ramd_probe_find(const ramd_probe_engine_t* engine, int32_t node_id)
+{
+	int32_t i;
+
+	if (!engine)
+		return NULL;
+
+	for (i = 0; i < engine->target_count; i++)
+	{
+		if (engine->targets[i].node_id == node_id)
+			return &engine->targets[i];
+	}
+	return NULL;
+}
+
+bool
+ramd_probe_get_sample(ramd_probe_engine_t* engine, int32_t node_id,
+                      int32_t max_age_ms, ramd_postgresql_status_t* status)
+{
+	const ramd_probe_target_t* target;
+	bool                       fresh = false;
+
+	if (!engine || !status)
+		return false;
+
+	pthread_mutex_lock(&engine->lock);
+	target = ramd_probe_find(engine, node_id);
+	if (target && target->healthy && target->sampled_at_us > 0 &&
+	    ramd_clock_now_us() - target->sampled_at_us <= (int64_t) max_age_ms * 1000)
+	{
+		*status = target->status;
+		fresh = true;
+	}
+	pthread_mutex_unlock(&engine->lock);
+
+	return fresh;
+}
@@ -0,0 +1,720 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_process.c
+ *		PostgreSQL Auto-Failover Daemon - External Process Runner
+ *
+ * Commands are started with posix_spawnp() from an argv array, so there is
+ * no /bin/sh in between and no quoting to get wrong, and the daemon is not
+ * duplicated the way fork() would duplicate it.  stdout and stderr are
+ * read through non-blocking pipes while the runner waits, and every
+ * command runs in its own process group so a timeout can take down
+ * whatever it started.  posix_spawn has no hook that runs in the child,
+ * so background commands are reniced from the parent the moment they are
+ * started, before they have had time to fork anything of their own.
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "ramd_process.h"
+#include "ramd_clock.h"
+#include "ramd_logging.h"
+
+extern char** environ;
+
+/* One queued asynchronous command; argv and its strings live in this block */
+typedef struct ramd_process_job
+{
+	int32_t timeout_ms;
+	ramd_process_done_fn done;
+	void* arg;
+	char** argv;
+} ramd_process_job_t;
+
+/* Partial line of one stream, carried over between reads */
+typedef struct ramd_process_lines
+{
+	bool is_stderr;
+	ramd_process_line_fn on_line;
+	void* arg;
+	size_t length;
+	char line[RAMD_PROCESS_LINE_MAX];
+} ramd_process_lines_t;
+
+static void
+ramd_process_sleep_ms(int32_t ms)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+
+/* Pipe whose descriptors close on exec; the parent's read end never blocks */
+static bool
+ramd_process_open_pipe(int fds[2])
+{
+	if (pipe(fds) != 0)
+		return false;
+
+	if (fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0 ||
+	    fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0 ||
+	    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK) != 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		fds[0] = fds[1] = -1;
+		return false;
+	}
+	return true;
+}
+
+static void
+ramd_process_close(int* fd)
+{
+	if (*fd >= 0)
+	{
+		close(*fd);
+		*fd = -1;
+	}
+}
+
+static void
+ramd_process_emit_line(ramd_process_lines_t* lines)
+{
+	lines->line[lines->length] = '\0';
+	lines->on_line(lines->is_stderr, lines->line, lines->arg);
+	lines->length = 0;
+}
+
+/* Split a chunk of output into lines; empty lines are not passed on */
+static void
+ramd_process_split_lines(ramd_process_lines_t* lines, const char* data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if (data[i] == '\n' || data[i] == '\r')
+		{
+			if (lines->length > 0)
+				ramd_process_emit_line(lines);
+			continue;
+		}
+		lines->line[lines->length++] = data[i];
+		if (lines->length == sizeof(lines->line) - 1)
+			ramd_process_emit_line(lines);
+	}
+}
+
+/*
+ * Read whatever is available, keeping the most recent output when it does
+ * not fit: error messages come last.  Closes *fd at end of file.
+ */
+static void
+ramd_process_drain(int* fd, char* buffer, size_t* length, bool* truncated,
+                   ramd_process_lines_t* lines)
+{
+	char    chunk[1024];
+	ssize_t n;
+
+	while (*fd >= 0)
+	{
+		n = read(*fd, chunk, sizeof(chunk));
+		if (n > 0)
+		{
+			const size_t cap = RAMD_PROCESS_OUTPUT_MAX - 1;
+			size_t       len = (size_t) n;
+
+			if (lines && lines->on_line)
+				ramd_process_split_lines(lines, chunk, len);
+			if (*length + len > cap)
+			{
+				size_t drop = *length + len - cap;
+
+				/* chunk is smaller than the buffer, so drop <= *length */
+				*truncated = true;
+				memmove(buffer, buffer + drop, *length - drop);
+				*length -= drop;
+			}
+			memcpy(buffer + *length, chunk, len);
+			*length += len;
+			buffer[*length] = '\0';
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		ramd_process_close(fd);
+	}
+}
+
+static void
+ramd_process_decode_status(ramd_process_result_t* result, int status)
+{
+	if (WIFEXITED(status))
+		result->exit_code = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		result->term_signal = WTERMSIG(status);
+}
+
+/*
+ * Lower the priority of a just-started child.  Failures only cost the
+ * throttling, never the command, so they are logged and otherwise ignored.
+ */
+static void
+ramd_process_apply_priority(pid_t pid, const char* name,
+                            const ramd_process_priority_t* priority)
+{
+	if (priority->nice > 0)
+	{
+		int current;
+
+		errno = 0;
+		current = getpriority(PRIO_PROCESS, 0);
+		if (errno == 0 && setpriority(PRIO_PROCESS, (id_t) pid, current + priority->nice) != 0)
+			ramd_log_debug("Cannot renice %s (pid %d): %s", name, (int) pid, strerror(errno));
+	}
+
+	if (priority->io_class != RAMD_PROCESS_IOPRIO_CLASS_NONE)
+	{
+#if defined(__linux__) && defined(SYS_ioprio_set)
+		/* IOPRIO_WHO_PROCESS; class in the top bits as in linux/ioprio.h */
+		int value = (priority->io_class << 13) | (priority->io_level & 0x7);
+
+		if (syscall(SYS_ioprio_set, 1, (int) pid, value) != 0)
+			ramd_log_debug("Cannot set I/O priority of %s (pid %d): %s", name, (int) pid,
+			               strerror(errno));
+#else
+		(void) name;
+#endif
+	}
+}
+
+void
+ramd_process_lower_thread_priority(const ramd_process_priority_t* priority)
+{
+#if defined(__linux__) && defined(SYS_gettid)
+	if (priority)
+		ramd_process_apply_priority((pid_t) syscall(SYS_gettid), "worker thread", priority);
+#else
+	(void) priority;
+#endif
+}
+
+bool
+ramd_process_run(const char* const argv[], int32_t timeout_ms,
+                 ramd_process_result_t* result)
+{
+	return ramd_process_run_with_priority(argv, timeout_ms, NULL, NULL, result);
+}
+
+bool
+ramd_process_run_cancellable(const char* const argv[], int32_t timeout_ms,
+                             const atomic_bool* cancel,
+                             ramd_process_result_t* result)
+{
+	return ramd_process_run_with_priority(argv, timeout_ms, cancel, NULL, result);
+}
+
+bool
+ramd_process_run_with_priority(const char* const argv[], int32_t timeout_ms,
+                               const atomic_bool* cancel,
+                               const ramd_process_priority_t* priority,
+                               ramd_process_result_t* result)
+{
+	return ramd_process_run_streaming(argv, timeout_ms, cancel, priority, NULL, NULL, result);
+}
+
+bool
+ramd_process_run_streaming(const char* const argv[], int32_t timeout_ms,
+                           const atomic_bool* cancel,
+                           const ramd_process_priority_t* priority,
+                           ramd_process_line_fn on_line, void* line_arg,
+                           ramd_process_result_t* result)
+{
+	ramd_process_result_t      local;
+	ramd_process_result_t*     r = result ? result : &local;
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t          attr;
+	sigset_t                   signals;
+	int                        out[2] = {-1, -1};
+	int                        err[2] = {-1, -1};
+	pid_t                      pid = -1;
+	int                        status = 0;
+	int                        rc;
+	bool                       exited = false;
+	bool                       killed = false;
+	int64_t                    started;
+	int64_t                    deadline;
+	int64_t                    term_sent = 0;
+	ramd_process_lines_t*      lines = NULL;
+
+	memset(r, 0, sizeof(*r));
+	r->exit_code = -1;
+
+	if (!argv || !argv[0])
+		return false;
+
+	if (!ramd_process_open_pipe(out) || !ramd_process_open_pipe(err))
+	{
+		ramd_log_error("Cannot create pipes for %s: %s", argv[0], strerror(errno));
+		ramd_process_close(&out[0]);
+		ramd_process_close(&out[1]);
+		return false;
+	}
+
+	/* stdin from /dev/null; stdout and stderr into our pipes */
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, err[1], STDERR_FILENO);
+
+	/* Undo whatever the daemon's threads blocked or ignored */
+	posix_spawnattr_init(&attr);
+	sigemptyset(&signals);
+	posix_spawnattr_setsigmask(&attr, &signals);
+	sigfillset(&signals);
+	sigdelset(&signals, SIGKILL);
+	sigdelset(&signals, SIGSTOP);
+	posix_spawnattr_setsigdefault(&attr, &signals);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF |
+	                                 POSIX_SPAWN_SETPGROUP);
+
+	started = ramd_clock_now_us();
+	rc = posix_spawnp(&pid, argv[0], &actions, &attr, (char* const*) argv, environ);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+	ramd_process_close(&out[1]);
+	ramd_process_close(&err[1]);
+
+	if (rc != 0)
+	{
+		ramd_log_error("Cannot run %s: %s", argv[0], strerror(rc));
+		ramd_process_close(&out[0]);
+		ramd_process_close(&err[0]);
+		return false;
+	}
+	r->spawned = true;
+
+	/* Only the last RAMD_PROCESS_OUTPUT_MAX bytes are kept; lines see it all */
+	if (on_line)
+	{
+		lines = calloc(2, sizeof(ramd_process_lines_t));
+		if (lines)
+		{
+			lines[0].on_line = lines[1].on_line = on_line;
+			lines[0].arg = lines[1].arg = line_arg;
+			lines[1].is_stderr = true;
+		}
+		else
+			ramd_log_warning("Out of memory: output of %s will not be streamed", argv[0]);
+	}
+	if (priority)
+		ramd_process_apply_priority(pid, argv[0], priority);
+	deadline = timeout_ms > 0 ? started + (int64_t) timeout_ms * 1000 : 0;
+
+	/*
+	 * Wait on the pipes, but check on the child every poll interval: a
+	 * daemon it leaves behind (pg_ctl start without -l) can hold the pipes
+	 * open long after the command itself is gone.
+	 */
+	while (!exited)
+	{
+		struct pollfd fds[2];
+		nfds_t        nfds = 0;
+		pid_t         w;
+		int64_t       now;
+
+		if (out[0] >= 0)
+		{
+			fds[nfds].fd = out[0];
+			fds[nfds].events = POLLIN;
+			nfds++;
+		}
+		if (err[0] >= 0)
+		{
+			fds[nfds].fd = err[0];
+			fds[nfds].events = POLLIN;
+			nfds++;
+		}
+
+		if (nfds > 0)
+		{
+			if (poll(fds, nfds, RAMD_PROCESS_POLL_INTERVAL_MS) < 0 && errno != EINTR)
+				break;
+			ramd_process_drain(&out[0], r->out, &r->out_length, &r->output_truncated,
+			                   lines ? &lines[0] : NULL);
+			ramd_process_drain(&err[0], r->err, &r->err_length, &r->output_truncated,
+			                   lines ? &lines[1] : NULL);
+		}
+
+		w = waitpid(pid, &status, nfds > 0 || deadline > 0 || cancel ? WNOHANG : 0);
+		if (w == pid)
+		{
+			exited = true;
+			break;
+		}
+		if (w < 0 && errno != EINTR)
+			break;
+
+		now = ramd_clock_now_us();
+		if (term_sent == 0 && cancel && atomic_load(cancel))
+		{
+			ramd_log_warning("%s cancelled; terminating it", argv[0]);
+			r->cancelled = true;
+			kill(-pid, SIGTERM);
+			term_sent = now;
+		}
+		else if ((deadline > 0 && now >= deadline) || term_sent != 0)
+		{
+			if (term_sent == 0)
+			{
+				ramd_log_warning("%s did not finish within %d ms; terminating it",
+				                 argv[0], timeout_ms);
+				r->timed_out = true;
+				kill(-pid, SIGTERM);
+				term_sent = now;
+			}
+			else if (!killed && now - term_sent >= (int64_t) RAMD_PROCESS_KILL_GRACE_MS * 1000)
+			{
+				kill(-pid, SIGKILL);
+				killed = true;
+			}
+		}
+
+		/* Both pipes are closed: only the exit remains to wait for */
+		if (nfds == 0 && (deadline > 0 || cancel))
+			ramd_process_sleep_ms(10);
+	}
+
+	ramd_process_drain(&out[0], r->out, &r->out_length, &r->output_truncated,
+	                   lines ? &lines[0] : NULL);
+	ramd_process_drain(&err[0], r->err, &r->err_length, &r->output_truncated,
+	                   lines ? &lines[1] : NULL);
+	ramd_process_close(&out[0]);
+	ramd_process_close(&err[0]);
+	if (lines)
+	{
+		/* A last line without a newline */
+		for (int i = 0; i < 2; i++)
+			if (lines[i].length > 0)
+				ramd_process_emit_line(&lines[i]);
+		free(lines);
+	}
+
+	r->duration_us = ramd_clock_now_us() - started;
+	if (!exited)
+	{
+		ramd_log_error("Lost track of %s (pid %d): %s", argv[0], (int) pid, strerror(errno));
+		return false;
+	}
+
+	ramd_process_decode_status(r, status);
+	return r->exit_code == 0 && !r->timed_out && !r->cancelled;
+}
+
+static void*
+ramd_process_job_main(void* arg)
+{
+	ramd_process_job_t*    job = (ramd_process_job_t*) arg;
+	ramd_process_result_t* result = malloc(sizeof(ramd_process_result_t));
+
+	if (result)
+	{
+		ramd_process_run((const char* const*) job->argv, job->timeout_ms, result);
+		if (job->done)
+			job->done(result, job->arg);
+		free(result);
+	}
+	else
+		ramd_log_error("Out of memory running %s", job->argv[0]);
+
+	free(job);
+	return NULL;
+}
+
+bool
+ramd_process_run_async(const char* const argv[], int32_t timeout_ms,
+                       ramd_process_done_fn done, void* arg)
+{
+	ramd_process_job_t* job;
+	pthread_attr_t      attr;
+	pthread_t           thread;
+	size_t              argc = 0;
+	size_t              bytes = 0;
+	char*               strings;
+	int                 rc;
+
+	if (!argv || !argv[0])
+		return false;
+
+	/* Copy argv so the caller's buffers may go away immediately */
+	for (argc = 0; argv[argc]; argc++)
+		bytes += strlen(argv[argc]) + 1;
+
+	job = malloc(sizeof(ramd_process_job_t) + (argc + 1) * sizeof(char*) + bytes);
+	if (!job)
+		return false;
+
+	job->timeout_ms = timeout_ms;
+	job->done = done;
+	job->arg = arg;
+	job->argv = (char**) (job + 1);
+	strings = (char*) (job->argv + argc + 1);
+	for (size_t i = 0; i < argc; i++)
+	{
+		size_t len = strlen(argv[i]) + 1;
+
+		memcpy(strings, argv[i], len);
+		job->argv[i] = strings;
+		strings += len;
+	}
+	job->argv[argc] = NULL;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	rc = pthread_create(&thread, &attr, ramd_process_job_main, job);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0)
+	{
+		ramd_log_error("Cannot start runner thread for %s: %s", argv[0], strerror(rc));
+		free(job);
+		return false;
+	}
+	return true;
+}
+
+void
+ramd_process_log_failure(const char* what, const ramd_process_result_t* result)
+{
+	const char* detail;
+	int         len;
+
+	if (!result || !result->spawned)
+	{
+		ramd_log_error("%s: command could not be started", what);
+		return;
+	}
+
+	/* Last line of stderr, falling back to stdout */
+	detail = result->err_length > 0 ? result->err : result->out;
+	len = (int) strlen(detail);
+	while (len > 0 && (detail[len - 1] == '\n' || detail[len - 1] == '\r'))
+		len--;
+	for (int start = len; start > 0; start--)
+	{
+		if (detail[start - 1] == '\n')
+		{
+			detail += start;
+			len -= start;
+			break;
+		}
+	}
+	if (len > 256)
+		len = 256;
+
+	if (result->cancelled)
+		ramd_log_error("%s: cancelled%s%.*s", what, len ? ": " : "", len, detail);
+	else if (result->timed_out)
+		ramd_log_error("%s: timed out after %lld ms%s%.*s", what,
+		               (long long) (result->duration_us / 1000), len ? ": " : "", len, detail);
+	else if (result->term_signal != 0)
+		ramd_log_error("%s: killed by signal %d%s%.*s", what, result->term_signal,
+		               len ? ": " : "", len, detail);
+	else
+		ramd_log_error("%s: exit code %d%s%.*s", what, result->exit_code,
+		               len ? ": " : "", len, detail);
+}
+
+bool
+ramd_process_find_program(const char* name, char* path, size_t path_size)
+{
+	const char* search;
+	const char* dir;
+
+	if (!name || !name[0] || !path || path_size == 0)
+		return false;
+
+	if (strchr(name, '/'))
+	{
+		if (access(name, X_OK) != 0)
+			return false;
+		snprintf(path, path_size, "%s", name);
+		return true;
+	}
+
+	search = getenv("PATH");
+	if (!search || !search[0])
+		search = "/usr/local/bin:/usr/bin:/bin";
+
+	for (dir = search; dir; dir = strchr(dir, ':') ? strchr(dir, ':') + 1 : NULL)
+	{
+		size_t dir_len = strcspn(dir, ":");
+		int    n;
+
+		if (dir_len == 0)
+			n = snprintf(path, path_size, "./%s", name);
+		else
+			n = snprintf(path, path_size, "%.*s/%s", (int) dir_len, dir, name);
+		if (n > 0 && (size_t) n < path_size && access(path, X_OK) == 0)
+			return true;
+	}
+
+	path[0] = '\0';
+	return false;
+}
+
+bool
+ramd_process_make_directory(const char* path, mode_t mode)
+{
+	char        buffer[RAMD_MAX_PATH_LENGTH];
+	struct stat st;
+	size_t      len;
+
+	if (!path || !path[0])
+		return false;
+
+	len = strlen(path);
+	if (len >= sizeof(buffer))
+	{
+		ramd_log_error("Path too long: %s", path);
+		return false;
+	}
+	memcpy(buffer, path, len + 1);
+
+	/* Create every missing parent, then the directory itself */
+	for (char* p = buffer + 1; ; p++)
+	{
+		bool last = *p == '\0';
+
+		if (*p != '/' && !last)
+			continue;
+
+		*p = '\0';
+		if (mkdir(buffer, mode) != 0 && errno != EEXIST)
+		{
+			ramd_log_error("Cannot create directory %s: %s", buffer, strerror(errno));
+			return false;
+		}
+		if (last)
+			break;
+		*p = '/';
+	}
+
+	if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+	{
+		ramd_log_error("%s exists and is not a directory", path);
+		return false;
+	}
+	return true;
+}
+
+/* Remove everything below path; with remove_self also path itself */
+static bool
+ramd_process_remove_entries(const char* path, bool remove_self)
+{
+	DIR*           dir;
+	struct dirent* entry;
+	bool           ok = true;
+
+	dir = opendir(path);
+	if (!dir)
+	{
+		if (errno == ENOENT)
+			return true;
+		ramd_log_error("Cannot open directory %s: %s", path, strerror(errno));
+		return false;
+	}
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		char        child[RAMD_MAX_PATH_LENGTH];
+		struct stat st;
+		int         n;
+
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		n = snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+		if (n < 0 || (size_t) n >= sizeof(child))
+		{
+			ramd_log_error("Path too long below %s", path);
+			ok = false;
+			continue;
+		}
+
+		/* lstat: a symlink is removed, never followed */
+		if (lstat(child, &st) != 0)
+		{
+			if (errno != ENOENT)
+				ok = false;
+			continue;
+		}
+
+		if (S_ISDIR(st.st_mode))
+			ok = ramd_process_remove_entries(child, true) && ok;
+		else if (unlink(child) != 0 && errno != ENOENT)
+		{
+			ramd_log_error("Cannot remove %s: %s", child, strerror(errno));
+			ok = false;
+		}
+	}
+	closedir(dir);
+
+	if (remove_self && rmdir(path) != 0 && errno != ENOENT)
+	{
+		ramd_log_error("Cannot remove directory %s: %s", path, strerror(errno));
+		ok = false;
+	}
+	return ok;
+}
+
+bool
+ramd_process_remove_tree(const char* path)
+{
+	struct stat st;
+
+	if (!path || !path[0] || strcmp(path, "/") == 0)
+		return false;
+
+	if (lstat(path, &st) != 0)
+		return errno == ENOENT;
+
+	if (!S_ISDIR(st.st_mode))
+		return unlink(path) == 0;
+
+	return ramd_process_remove_entries(path, true);
+}
+
+bool
+ramd_process_clear_directory(const char* path)
+{
+	if (!path || !path[0] || strcmp(path, "/") == 0)
+		return false;
+
+	return ramd_process_remove_entries(path, false);
+}
@@ -0,0 +1,355 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_profiler.c
+ *		PostgreSQL Auto-Failover Daemon - Sampling CPU Profiler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * ITIMER_PROF counts CPU time across all threads and raises SIGPROF,
+ * which the kernel delivers to the thread that was running, so samples
+ * land where the CPU goes.  The handler only unwinds into a slot of a
+ * preallocated array; frames are symbolized with dladdr() once the timer
+ * is off.  Functions that are not exported show up as "ramd+0x1234",
+ * which addr2line resolves against the same binary.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* dladdr */
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "ramd_profiler.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+/* The handler and the kernel's signal trampoline sit on top of every stack */
+#define RAMD_PROFILER_SKIP_FRAMES 2
+
+typedef struct ramd_profiler_sample_t
+{
+	int32_t depth;
+	void* frames[RAMD_PROFILER_MAX_DEPTH]; /* leaf first */
+} ramd_profiler_sample_t;
+
+static pthread_mutex_t g_profiler_lock = PTHREAD_MUTEX_INITIALIZER; /* one profile at a time */
+static bool g_profiler_handler_installed = false;
+static atomic_bool g_profiler_running = false;
+static ramd_profiler_sample_t* g_profiler_samples = NULL;
+static int32_t g_profiler_capacity = 0;
+static atomic_int g_profiler_next = 0;
+
+static void
+ramd_profiler_signal(int signo, siginfo_t* info, void* ucontext)
+{
+	void* frames[RAMD_PROFILER_MAX_DEPTH + RAMD_PROFILER_SKIP_FRAMES];
+	int saved_errno = errno;
+	int depth;
+	int slot;
+
+	(void) signo;
+	(void) info;
+	(void) ucontext;
+
+	/* A tick still pending when the timer was stopped lands here too */
+	if (!atomic_load_explicit(&g_profiler_running, memory_order_acquire))
+		return;
+
+	slot = atomic_fetch_add_explicit(&g_profiler_next, 1, memory_order_relaxed);
+	if (slot < g_profiler_capacity)
+	{
+		depth = backtrace(frames, RAMD_PROFILER_MAX_DEPTH + RAMD_PROFILER_SKIP_FRAMES) -
+		        RAMD_PROFILER_SKIP_FRAMES;
+		if (depth < 0)
+			depth = 0;
+		memcpy(g_profiler_samples[slot].frames, frames + RAMD_PROFILER_SKIP_FRAMES,
+		       sizeof(void*) * (size_t) depth);
+		g_profiler_samples[slot].depth = depth;
+	}
+	errno = saved_errno;
+}
+
+/*
+ * The handler stays installed once set: SIGPROF's default action ends the
+ * process, and a tick can still be in flight after the timer is stopped.
+ */
+static bool
+ramd_profiler_install_handler(void)
+{
+	struct sigaction action;
+	void* warmup[4];
+
+	if (g_profiler_handler_installed)
+		return true;
+
+	/* The first backtrace() loads the unwinder, which must not happen in a handler */
+	(void) backtrace(warmup, 4);
+
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = ramd_profiler_signal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, NULL) != 0)
+		return false;
+
+	g_profiler_handler_installed = true;
+	return true;
+}
+
+static bool
+ramd_profiler_set_timer(int32_t frequency_hz)
+{
+	struct itimerval timer;
+
+	memset(&timer, 0, sizeof(timer));
+	if (frequency_hz > 0)
+	{
+		timer.it_interval.tv_sec = 1 / frequency_hz;
+		timer.it_interval.tv_usec = frequency_hz > 1 ? 1000000 / frequency_hz : 0;
+		timer.it_value = timer.it_interval;
+	}
+	return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+/* Sleep out the profile; ticks interrupt sleeps, so keep to a deadline */
+static void
+ramd_profiler_wait(int32_t seconds)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += seconds;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+		;
+}
+
+static int
+ramd_profiler_compare(const void* a, const void* b)
+{
+	const ramd_profiler_sample_t* x = a;
+	const ramd_profiler_sample_t* y = b;
+
+	if (x->depth != y->depth)
+		return x->depth < y->depth ? -1 : 1;
+	return memcmp(x->frames, y->frames, sizeof(void*) * (size_t) x->depth);
+}
+
+/* Append one frame's name: the symbol, or the object and offset without one */
+static bool
+ramd_profiler_append_frame(ramd_buffer_t* output, void* frame, bool leaf)
+{
+	/* Outer frames hold return addresses, one past the call */
+	const char* lookup = (const char*) frame - (leaf ? 0 : 1);
+	const char* object;
+	Dl_info info;
+
+	if (dladdr(lookup, &info) == 0 || !info.dli_fname)
+		return ramd_buffer_appendf(output, "0x%lx", (unsigned long) (uintptr_t) frame);
+	if (info.dli_sname)
+		return ramd_buffer_appendf(output, "%s", info.dli_sname);
+
+	object = strrchr(info.dli_fname, '/');
+	object = object ? object + 1 : info.dli_fname;
+	return ramd_buffer_appendf(output, "%s+0x%lx", object[0] ? object : "?",
+	                           (unsigned long) ((uintptr_t) frame - (uintptr_t) info.dli_fbase));
+}
+
+typedef struct ramd_profiler_stack_t
+{
+	char* folded;
+	int32_t count;
+} ramd_profiler_stack_t;
+
+static int
+ramd_profiler_compare_folded(const void* a, const void* b)
+{
+	return strcmp(((const ramd_profiler_stack_t*) a)->folded,
+	              ((const ramd_profiler_stack_t*) b)->folded);
+}
+
+/* Write one stack outermost frame first, ';' between frames */
+static bool
+ramd_profiler_format_stack(const ramd_profiler_sample_t* sample, ramd_buffer_t* line)
+{
+	bool ok = true;
+	int32_t f;
+
+	line->length = 0;
+	if (sample->depth == 0)
+		return ramd_buffer_appendf(line, "[unknown]");
+	for (f = sample->depth - 1; ok && f >= 0; f--)
+	{
+		ok = ramd_profiler_append_frame(line, sample->frames[f], f == 0);
+		if (ok && f > 0)
+			ok = ramd_buffer_append(line, ";", 1);
+	}
+	return ok;
+}
+
+/*
+ * Samples taken at different instructions of the same functions fold into
+ * one line, so stacks are merged twice: by address, which makes each
+ * distinct stack symbolized once, then by the names they come out as.
+ */
+static bool
+ramd_profiler_fold(ramd_profiler_sample_t* samples, int32_t count, ramd_buffer_t* output)
+{
+	ramd_profiler_stack_t* stacks;
+	ramd_buffer_t line;
+	int32_t unique = 0;
+	bool ok = true;
+	int32_t i = 0;
+
+	if (count == 0)
+		return true;
+
+	stacks = calloc((size_t) count, sizeof(*stacks));
+	if (!stacks)
+		return false;
+	ramd_buffer_init(&line);
+
+	qsort(samples, (size_t) count, sizeof(*samples), ramd_profiler_compare);
+	while (ok && i < count)
+	{
+		int32_t run = 1;
+
+		while (i + run < count && ramd_profiler_compare(&samples[i], &samples[i + run]) == 0)
+			run++;
+
+		ok = ramd_profiler_format_stack(&samples[i], &line) &&
+		     ramd_buffer_append(&line, "", 1) &&
+		     (stacks[unique].folded = strdup(line.data)) != NULL;
+		stacks[unique++].count = run;
+		i += run;
+	}
+
+	if (ok)
+		qsort(stacks, (size_t) unique, sizeof(*stacks), ramd_profiler_compare_folded);
+	for (i = 0; ok && i < unique;)
+	{
+		int32_t total = stacks[i].count;
+		int32_t next = i + 1;
+
+		while (next < unique && strcmp(stacks[i].folded, stacks[next].folded) == 0)
+			total += stacks[next++].count;
+		ok = ramd_buffer_appendf(output, "%s %d\n", stacks[i].folded, total);
+		i = next;
+	}
+
+	for (i = 0; i < unique; i++)
+		free(stacks[i].folded);
+	free(stacks);
+	ramd_buffer_free(&line);
+	return ok;
+}
+
+/* Run the timer for the profile and fold what it caught; the array is set up */
+static bool
+ramd_profiler_sample(int32_t seconds, int32_t frequency_hz, ramd_buffer_t* output,
+                     char* error, size_t error_size)
+{
+	struct timespec settle = {0, 1000000};
+	int32_t taken;
+
+	if (!ramd_profiler_install_handler())
+	{
+		snprintf(error, error_size, "cannot install SIGPROF handler: %s", strerror(errno));
+		return false;
+	}
+
+	ramd_log_info("CPU profile started: %d seconds at %d Hz", seconds, frequency_hz);
+	atomic_store_explicit(&g_profiler_running, true, memory_order_release);
+	if (!ramd_profiler_set_timer(frequency_hz))
+	{
+		atomic_store(&g_profiler_running, false);
+		snprintf(error, error_size, "cannot start the profiling timer: %s", strerror(errno));
+		return false;
+	}
+
+	ramd_profiler_wait(seconds);
+
+	(void) ramd_profiler_set_timer(0);
+	atomic_store_explicit(&g_profiler_running, false, memory_order_release);
+
+	/*
+	 * A handler that read the flag just before it was cleared may still be
+	 * writing its slot; give it a moment before the array is read.
+	 */
+	nanosleep(&settle, NULL);
+
+	taken = atomic_load(&g_profiler_next);
+	if (taken > g_profiler_capacity)
+	{
+		ramd_log_warning("CPU profile: %d samples dropped past %d", taken - g_profiler_capacity,
+		                 g_profiler_capacity);
+		taken = g_profiler_capacity;
+	}
+	ramd_log_info("CPU profile finished: %d samples", taken);
+
+	if (!ramd_profiler_fold(g_profiler_samples, taken, output))
+	{
+		snprintf(error, error_size, "out of memory formatting the profile");
+		return false;
+	}
+	return true;
+}
+
+bool
+ramd_profiler_collect(int32_t seconds, int32_t frequency_hz, ramd_buffer_t* output,
+                      char* error, size_t error_size)
+{
+	int64_t capacity;
+	bool ok;
+
+	if (!output || seconds <= 0 || frequency_hz <= 0)
+	{
+		snprintf(error, error_size, "invalid profile parameters");
+		return false;
+	}
+
+	if (pthread_mutex_trylock(&g_profiler_lock) != 0)
+	{
+		snprintf(error, error_size, "a profile is already being collected");
+		return false;
+	}
+
+	/* Several busy threads consume CPU time faster than the wall clock */
+	capacity = (int64_t) seconds * frequency_hz * 4;
+	if (capacity > RAMD_PROFILER_MAX_SAMPLES)
+		capacity = RAMD_PROFILER_MAX_SAMPLES;
+	g_profiler_samples = calloc((size_t) capacity, sizeof(ramd_profiler_sample_t));
+	if (!g_profiler_samples)
+	{
+		pthread_mutex_unlock(&g_profiler_lock);
+		snprintf(error, error_size, "out of memory for %lld samples", (long long) capacity);
+		return false;
+	}
+	g_profiler_capacity = (int32_t) capacity;
+	atomic_store(&g_profiler_next, 0);
+
+	ok = ramd_profiler_sample(seconds, frequency_hz, output, error, error_size);
+
+	free(g_profiler_samples);
+	g_profiler_samples = NULL;
+	g_profiler_capacity = 0;
+	pthread_mutex_unlock(&g_profiler_lock);
+	return ok;
+}
+
+bool
+ramd_profiler_is_running(void)
+{
+	return atomic_load(&g_profiler_running);
+}
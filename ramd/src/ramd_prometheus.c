@@ -11,21 +11,66 @@
  *-------------------------------------------------------------------------
  */
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include "ramd_clock.h"
 #include "ramd_config.h"
 #include "ramd_conn.h"
+#include "ramd_daemon.h"
+#include "ramd_failover_trace.h"
+#include "ramd_http_profile.h"
+#include "ramd_memory.h"
+#include "ramd_metrics.h"
 #include "ramd_pgraft.h"
 #include "ramd_prometheus.h"
+#include "ramd_query.h"
+#include "ramd_sysmon.h"
+#include "ramd_archiver.h"
+#include "ramd_remote_write.h"
+#include "ramd_backup_verify.h"
+#include "ramd_replay.h"
+#include "ramd_proxy.h"
+#include "ramd_watch.h"
 
 /* Global metrics storage */
 static ramd_prometheus_metrics_t g_metrics = {0};
-static time_t g_metrics_last_update = 0;
+static int64_t g_metrics_last_update_ms = 0;
+
+/*
+ * Exposition cache.  The collector thread owns rendering; scrapes only
+ * take a reference to the current snapshot, so their number does not
+ * change how often the database is queried.
+ */
+static pthread_mutex_t g_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_collector_cond = PTHREAD_COND_INITIALIZER;
+static ramd_prometheus_snapshot_t* g_snapshots[RAMD_PROMETHEUS_EXPOSITION_COUNT];
+static pthread_t g_collector_thread;
+static bool g_collector_running = false;
+static bool g_collector_stop = false;
+static bool g_collector_dirty = false; /* the cluster changed since the last refresh */
+static int32_t g_collector_interval_ms = RAMD_METRICS_COLLECTION_INTERVAL_MS;
+static bool g_collector_compress = true;
+
+/* Raft internals from the pgraft metrics file, valid if the last read worked */
+static ramd_pgraft_metrics_t g_raft_internals;
+static bool g_raft_internals_valid = false;
+
+/* raftpb.MessageType names, indexed by value */
+static const char* const g_raft_message_types[] = {
+	"MsgHup", "MsgBeat", "MsgProp", "MsgApp", "MsgAppResp", "MsgVote",
+	"MsgVoteResp", "MsgSnap", "MsgHeartbeat", "MsgHeartbeatResp",
+	"MsgUnreachable", "MsgSnapStatus", "MsgCheckQuorum", "MsgTransferLeader",
+	"MsgTimeoutNow", "MsgReadIndex", "MsgReadIndexResp", "MsgPreVote",
+	"MsgPreVoteResp", "MsgStorageAppend", "MsgStorageAppendResp",
+	"MsgStorageApply", "MsgStorageApplyResp", "MsgForgetLeader"
+};
 
 /* Prometheus metric types */
 #define METRIC_TYPE_COUNTER   "counter"
@@ -48,7 +93,7 @@ ramd_prometheus_collect_system_metrics(void)
 	}
 
 	g_metrics.timestamp = tv.tv_sec;
-	g_metrics.uptime_seconds = tv.tv_sec - g_metrics.start_time;
+	g_metrics.uptime_seconds = (long) ((ramd_clock_now_ms() - g_metrics.start_ms) / 1000);
 
 	/* Get actual memory usage */
 	meminfo = fopen("/proc/self/status", "r");
@@ -137,9 +182,7 @@ ramd_prometheus_collect_system_metrics(void)
 static void
 ramd_prometheus_collect_postgresql_metrics(PGconn *conn)
 {
-	PGresult   *result;
-	char		query[512];
-	const char *value;
+	int64_t		count;
 
 	if (conn == NULL || PQstatus(conn) != CONNECTION_OK)
 	{
@@ -151,34 +194,14 @@ ramd_prometheus_collect_postgresql_metrics(PGconn *conn)
 	g_metrics.postgresql_connected = 1;
 
 	/* Get connection count */
-	snprintf(query, sizeof(query),
-			 "SELECT COUNT(*) FROM pg_stat_activity WHERE state = 'active'");
-
-	result = PQexec(conn, query);
-	if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
-	{
-		value = PQgetvalue(result, 0, 0);
-		if (value)
-		{
-			g_metrics.postgresql_connections = atoi(value);
-		}
-		else
-		{
-			ramd_log_warning("Failed to get connection count from PostgreSQL");
-			g_metrics.postgresql_connections = 0;
-		}
-	}
+	if (ramd_query_prepared_int64(conn, RAMD_QUERY_STMT_ACTIVE_BACKENDS, &count))
+		g_metrics.postgresql_connections = (int) count;
 	else
 	{
 		ramd_log_warning("Failed to execute PostgreSQL connection count query: %s",
 						 PQerrorMessage(conn));
 		g_metrics.postgresql_connections = 0;
 	}
-
-	if (result)
-	{
-		PQclear(result);
-	}
 }
 
 static void
@@ -186,7 +209,14 @@ ramd_prometheus_collect_raft_metrics(PGconn* conn)
 {
     PGresult* result;
     char query[512];
+    int64_t value;
+    bool healthy;
     
+    /* pgraft's own counters come from a file, so they survive a lost session */
+    g_raft_internals_valid = g_ramd_daemon &&
+        ramd_pgraft_read_metrics(g_ramd_daemon->config.postgresql_data_dir,
+                                 &g_raft_internals);
+
     if (conn == NULL || PQstatus(conn) != CONNECTION_OK)
     {
         g_metrics.raft_leader = -1;
@@ -196,56 +226,21 @@ ramd_prometheus_collect_raft_metrics(PGconn* conn)
         return;
     }
     
-    /* Get Raft leader */
-    snprintf(query, sizeof(query), "SELECT pgraft_get_leader()");
-    result = PQexec(conn, query);
-    if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
-    {
-        g_metrics.raft_leader = atoi(PQgetvalue(result, 0, 0));
-    }
+    /* Leader, term and health are prepared once per session */
+    if (ramd_query_prepared_int64(conn, RAMD_QUERY_STMT_PGRAFT_LEADER, &value))
+        g_metrics.raft_leader = (int) value;
     else
-    {
         g_metrics.raft_leader = -1;
-    }
-    
-    if (result)
-    {
-        PQclear(result);
-    }
-    
-    /* Get Raft term */
-    snprintf(query, sizeof(query), "SELECT pgraft_get_term()");
-    result = PQexec(conn, query);
-    if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
-    {
-        g_metrics.raft_term = atoi(PQgetvalue(result, 0, 0));
-    }
+
+    if (ramd_query_prepared_int64(conn, RAMD_QUERY_STMT_PGRAFT_TERM, &value))
+        g_metrics.raft_term = (int) value;
     else
-    {
         g_metrics.raft_term = -1;
-    }
-    
-    if (result)
-    {
-        PQclear(result);
-    }
-    
-    /* Get Raft health */
-    snprintf(query, sizeof(query), "SELECT pgraft_is_cluster_healthy()");
-    result = PQexec(conn, query);
-    if (result && PQresultStatus(result) == PGRES_TUPLES_OK)
-    {
-        g_metrics.raft_healthy = strcmp(PQgetvalue(result, 0, 0), "true") == 0 ? 1 : 0;
-    }
+
+    if (ramd_query_prepared_bool(conn, RAMD_QUERY_STMT_PGRAFT_CLUSTER_HEALTHY, &healthy))
+        g_metrics.raft_healthy = healthy ? 1 : 0;
     else
-    {
         g_metrics.raft_healthy = 0;
-    }
-    
-    if (result)
-    {
-        PQclear(result);
-    }
     
     /* Get Raft node count */
     snprintf(query, sizeof(query), "SELECT pgraft_get_nodes()");
@@ -283,38 +278,13 @@ ramd_prometheus_collect_raft_metrics(PGconn* conn)
     }
 }
 
-static void
-ramd_prometheus_collect_http_metrics(void)
-{
-    /* HTTP request metrics */
-    g_metrics.http_requests_total = g_metrics.http_requests_total + 1;
-    /* Track in-flight requests using a simple counter */
-    static int in_flight_requests = 0;
-    g_metrics.http_requests_in_flight = in_flight_requests;
-    
-    /* Track request duration using a simple average */
-    static double total_duration = 0.0;
-    static int request_count = 0;
-    if (request_count > 0)
-    {
-        g_metrics.http_request_duration_seconds = total_duration / request_count;
-    }
-    else
-    {
-        g_metrics.http_request_duration_seconds = 0.0;
-    }
-}
-
 /* Public functions */
 void
 ramd_prometheus_init(void)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    
     memset(&g_metrics, 0, sizeof(ramd_prometheus_metrics_t));
-    g_metrics.start_time = tv.tv_sec;
-    g_metrics_last_update = 0;
+    g_metrics.start_ms = ramd_clock_now_ms();
+    g_metrics_last_update_ms = 0;
     
     ramd_log_info("Prometheus metrics initialized");
 }
@@ -322,11 +292,10 @@ ramd_prometheus_init(void)
 void
 ramd_prometheus_update_metrics(PGconn* conn)
 {
-    time_t now;
-    time(&now);
+    int64_t now_ms = ramd_clock_now_ms();
     
     /* Update metrics every 5 seconds */
-    if (now - g_metrics_last_update < 5)
+    if (g_metrics_last_update_ms != 0 && now_ms - g_metrics_last_update_ms < 5000)
     {
         return;
     }
@@ -334,106 +303,605 @@ ramd_prometheus_update_metrics(PGconn* conn)
     ramd_prometheus_collect_system_metrics();
     ramd_prometheus_collect_postgresql_metrics(conn);
     ramd_prometheus_collect_raft_metrics(conn);
-    ramd_prometheus_collect_http_metrics();
     
-    g_metrics_last_update = now;
+    g_metrics_last_update_ms = now_ms;
 }
 
-int
-ramd_prometheus_handle_request(const char* request, char* response, size_t response_size)
+/*
+ * One histogram from pgraft's per-bucket counts; bucket i's bound is
+ * base << i divided by scale, and the last bucket is +Inf.
+ */
+static bool
+ramd_prometheus_render_raft_histogram(ramd_buffer_t* output, const char* name,
+                                      const char* help, const int64_t* buckets,
+                                      int64_t base, double scale, double sum)
 {
-	PGconn	   *conn;
-	char		metrics_buffer[8192];
-	size_t		offset = 0;
+	int64_t cumulative = 0;
+	bool ok = true;
+	int i;
 
-	(void) request;		/* Suppress unused parameter warning */
+	ok &= ramd_buffer_appendf(output, "# HELP %s %s\n# TYPE %s %s\n",
+	                          name, help, name, METRIC_TYPE_HISTOGRAM);
+	for (i = 0; i < RAMD_PGRAFT_METRICS_BUCKETS - 1; i++)
+	{
+		cumulative += buckets[i];
+		ok &= ramd_buffer_appendf(output, "%s_bucket{le=\"%g\"} %lld\n", name,
+		                          (double) (base << i) / scale, (long long) cumulative);
+	}
+	cumulative += buckets[RAMD_PGRAFT_METRICS_BUCKETS - 1];
+	ok &= ramd_buffer_appendf(output, "%s_bucket{le=\"+Inf\"} %lld\n%s_sum %.6f\n%s_count %lld\n\n",
+	                          name, (long long) cumulative, name, sum, name,
+	                          (long long) cumulative);
+	return ok;
+}
+
+/* Message, batch, storage and per-peer series from the pgraft metrics file */
+static bool
+ramd_prometheus_render_raft_internals(ramd_buffer_t* output)
+{
+	const ramd_pgraft_metrics_t* m = &g_raft_internals;
+	struct timespec now;
+	int64_t num_peers;
+	bool ok = true;
+	int i;
+
+	if (!g_raft_internals_valid)
+		return true;
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_raft_messages_total Raft messages by direction and type\n"
+		"# TYPE ramd_raft_messages_total %s\n", METRIC_TYPE_COUNTER);
+	for (i = 0; i < (int) (sizeof(g_raft_message_types) / sizeof(g_raft_message_types[0])); i++)
+	{
+		if (m->msg_sent[i] == 0 && m->msg_received[i] == 0)
+			continue;
+		ok &= ramd_buffer_appendf(output,
+			"ramd_raft_messages_total{direction=\"sent\",type=\"%s\"} %lld\n"
+			"ramd_raft_messages_total{direction=\"received\",type=\"%s\"} %lld\n",
+			g_raft_message_types[i], (long long) m->msg_sent[i],
+			g_raft_message_types[i], (long long) m->msg_received[i]);
+	}
+	ok &= ramd_buffer_appendf(output, "\n");
+
+	ok &= ramd_prometheus_render_raft_histogram(output, "ramd_raft_ready_batch_entries",
+		"Log entries persisted per Raft Ready", m->ready_entries, 1, 1.0,
+		(double) m->ready_entries_sum);
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_raft_ready_messages_total Messages sent from Raft Readys\n"
+		"# TYPE ramd_raft_ready_messages_total %s\n"
+		"ramd_raft_ready_messages_total %lld\n\n"
+		"# HELP ramd_raft_ready_committed_entries_total Committed entries handed to apply\n"
+		"# TYPE ramd_raft_ready_committed_entries_total %s\n"
+		"ramd_raft_ready_committed_entries_total %lld\n\n",
+		METRIC_TYPE_COUNTER, (long long) m->ready_messages_sum,
+		METRIC_TYPE_COUNTER, (long long) m->ready_committed_sum);
+
+	ok &= ramd_prometheus_render_raft_histogram(output, "ramd_raft_storage_append_seconds",
+		"Raft WAL write time per Ready", m->append_latency, 16, 1e6,
+		(double) m->append_latency_sum_us / 1e6);
+	ok &= ramd_prometheus_render_raft_histogram(output, "ramd_raft_storage_fsync_seconds",
+		"Raft WAL fsync time per Ready", m->fsync_latency, 16, 1e6,
+		(double) m->fsync_latency_sum_us / 1e6);
+
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_raft_proposal_queue_depth Proposals waiting to be batched\n"
+		"# TYPE ramd_raft_proposal_queue_depth %s\n"
+		"ramd_raft_proposal_queue_depth %lld\n\n"
+		"# HELP ramd_raft_proposal_queue_capacity Proposals the queue holds before writers fail\n"
+		"# TYPE ramd_raft_proposal_queue_capacity %s\n"
+		"ramd_raft_proposal_queue_capacity %lld\n\n",
+		METRIC_TYPE_GAUGE, (long long) m->proposal_queue_depth,
+		METRIC_TYPE_GAUGE, (long long) m->proposal_queue_capacity);
+
+	num_peers = m->num_peers;
+	if (num_peers < 0)
+		num_peers = 0;
+	if (num_peers > RAMD_PGRAFT_MAX_NODES)
+		num_peers = RAMD_PGRAFT_MAX_NODES;
+
+	/* Replication progress is only tracked on the leader */
+	ok &= ramd_buffer_appendf(output,
+		"# HELP ramd_raft_peer_match_index Highest log index known replicated to the peer\n"
+		"# TYPE ramd_raft_peer_match_index %s\n", METRIC_TYPE_GAUGE);
+	for (i = 0; i < num_peers; i++)
+		if (m->peer_match[i] >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_raft_peer_match_index{peer=\"%lld\"} %lld\n",
+			                          (long long) m->peer_id[i], (long long) m->peer_match[i]);
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_peer_next_index Next log index the leader sends the peer\n"
+		"# TYPE ramd_raft_peer_next_index %s\n", METRIC_TYPE_GAUGE);
+	for (i = 0; i < num_peers; i++)
+		if (m->peer_next[i] >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_raft_peer_next_index{peer=\"%lld\"} %lld\n",
+			                          (long long) m->peer_id[i], (long long) m->peer_next[i]);
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_peer_lag_entries Entries the peer is behind the leader's log\n"
+		"# TYPE ramd_raft_peer_lag_entries %s\n", METRIC_TYPE_GAUGE);
+	for (i = 0; i < num_peers; i++)
+		if (m->peer_match[i] >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_raft_peer_lag_entries{peer=\"%lld\"} %lld\n",
+			                          (long long) m->peer_id[i],
+			                          (long long) (m->last_index > m->peer_match[i] ?
+			                                       m->last_index - m->peer_match[i] : 0));
+
+	/* RTTs are measured by every node that talks to the peer */
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_peer_heartbeat_rtt_seconds Smoothed heartbeat and vote round trip\n"
+		"# TYPE ramd_raft_peer_heartbeat_rtt_seconds %s\n", METRIC_TYPE_GAUGE);
+	for (i = 0; i < num_peers; i++)
+		if (m->peer_heartbeat_rtt_us[i] >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_raft_peer_heartbeat_rtt_seconds{peer=\"%lld\"} %.6f\n",
+			                          (long long) m->peer_id[i],
+			                          (double) m->peer_heartbeat_rtt_us[i] / 1e6);
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_peer_append_rtt_seconds Smoothed append round trip, including the peer's fsync\n"
+		"# TYPE ramd_raft_peer_append_rtt_seconds %s\n", METRIC_TYPE_GAUGE);
+	for (i = 0; i < num_peers; i++)
+		if (m->peer_append_rtt_us[i] >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_raft_peer_append_rtt_seconds{peer=\"%lld\"} %.6f\n",
+			                          (long long) m->peer_id[i],
+			                          (double) m->peer_append_rtt_us[i] / 1e6);
+
+	/* Peer links compress only with pgraft.peer_compression on both ends */
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_compression_bytes_total Bytes of compressed peer frames before and after compression\n"
+		"# TYPE ramd_raft_compression_bytes_total %s\n"
+		"ramd_raft_compression_bytes_total{direction=\"sent\",stage=\"raw\"} %lld\n"
+		"ramd_raft_compression_bytes_total{direction=\"sent\",stage=\"wire\"} %lld\n"
+		"ramd_raft_compression_bytes_total{direction=\"received\",stage=\"raw\"} %lld\n"
+		"ramd_raft_compression_bytes_total{direction=\"received\",stage=\"wire\"} %lld\n\n"
+		"# HELP ramd_raft_compression_frames_total Peer frames offered to compression, by outcome\n"
+		"# TYPE ramd_raft_compression_frames_total %s\n"
+		"ramd_raft_compression_frames_total{result=\"compressed\"} %lld\n"
+		"ramd_raft_compression_frames_total{result=\"skipped\"} %lld\n"
+		"ramd_raft_compression_frames_total{result=\"decompressed\"} %lld\n\n"
+		"# HELP ramd_raft_compression_seconds_total CPU time spent compressing and decompressing peer frames\n"
+		"# TYPE ramd_raft_compression_seconds_total %s\n"
+		"ramd_raft_compression_seconds_total{op=\"compress\"} %.6f\n"
+		"ramd_raft_compression_seconds_total{op=\"decompress\"} %.6f\n",
+		METRIC_TYPE_COUNTER,
+		(long long) m->compress_raw_bytes, (long long) m->compress_wire_bytes,
+		(long long) m->decompress_raw_bytes, (long long) m->decompress_wire_bytes,
+		METRIC_TYPE_COUNTER,
+		(long long) m->compress_frames, (long long) m->compress_skipped,
+		(long long) m->decompress_frames,
+		METRIC_TYPE_COUNTER,
+		(double) m->compress_cpu_us / 1e6, (double) m->decompress_cpu_us / 1e6);
+	if (m->compress_wire_bytes > 0)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_raft_compression_ratio Raw to wire bytes of the frames this node compressed\n"
+			"# TYPE ramd_raft_compression_ratio %s\n"
+			"ramd_raft_compression_ratio %.3f\n",
+			METRIC_TYPE_GAUGE,
+			(double) m->compress_raw_bytes / (double) m->compress_wire_bytes);
+
+	/* Alert on this to catch a stalled Go runtime */
+	clock_gettime(CLOCK_REALTIME, &now);
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_raft_metrics_age_seconds Time since pgraft last published these metrics\n"
+		"# TYPE ramd_raft_metrics_age_seconds %s\n"
+		"ramd_raft_metrics_age_seconds %.3f\n\n",
+		METRIC_TYPE_GAUGE,
+		((double) now.tv_sec * 1e9 + (double) now.tv_nsec - (double) m->updated_at_ns) / 1e9);
+
+	return ok;
+}
+
+/* Format the last collected values without touching the database */
+static bool
+ramd_prometheus_render_series(ramd_buffer_t* output)
+{
+	bool		ok = true;
 
-	/* Update metrics before serving using default values */
-	conn = ramd_conn_get_cached(1, "localhost", 5432, "postgres", "postgres", "postgres");
-	ramd_prometheus_update_metrics(conn);
-    
     /* Build Prometheus metrics response */
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_uptime_seconds Total uptime in seconds\n"
         "# TYPE ramd_uptime_seconds %s\n"
         "ramd_uptime_seconds %ld\n\n",
         METRIC_TYPE_GAUGE, g_metrics.uptime_seconds);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_memory_usage_bytes Memory usage in bytes\n"
         "# TYPE ramd_memory_usage_bytes %s\n"
         "ramd_memory_usage_bytes %ld\n\n",
         METRIC_TYPE_GAUGE, g_metrics.memory_usage_bytes);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_cpu_usage_percent CPU usage percentage\n"
         "# TYPE ramd_cpu_usage_percent %s\n"
         "ramd_cpu_usage_percent %.2f\n\n",
         METRIC_TYPE_GAUGE, g_metrics.cpu_usage_percent);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_postgresql_connected PostgreSQL connection status\n"
         "# TYPE ramd_postgresql_connected %s\n"
         "ramd_postgresql_connected %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.postgresql_connected);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_postgresql_connections Number of active PostgreSQL connections\n"
         "# TYPE ramd_postgresql_connections %s\n"
         "ramd_postgresql_connections %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.postgresql_connections);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_raft_leader Current Raft leader node ID\n"
         "# TYPE ramd_raft_leader %s\n"
         "ramd_raft_leader %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.raft_leader);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_raft_term Current Raft term\n"
         "# TYPE ramd_raft_term %s\n"
         "ramd_raft_term %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.raft_term);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_raft_healthy Raft cluster health status\n"
         "# TYPE ramd_raft_healthy %s\n"
         "ramd_raft_healthy %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.raft_healthy);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
+    ok &= ramd_buffer_appendf(output,
         "# HELP ramd_raft_nodes Number of Raft nodes\n"
         "# TYPE ramd_raft_nodes %s\n"
         "ramd_raft_nodes %d\n\n",
         METRIC_TYPE_GAUGE, g_metrics.raft_nodes);
     
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
-        "# HELP ramd_http_requests_total Total HTTP requests\n"
-        "# TYPE ramd_http_requests_total %s\n"
-        "ramd_http_requests_total %ld\n\n",
-        METRIC_TYPE_COUNTER, g_metrics.http_requests_total);
-    
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
-        "# HELP ramd_http_requests_in_flight Current in-flight HTTP requests\n"
-        "# TYPE ramd_http_requests_in_flight %s\n"
-        "ramd_http_requests_in_flight %d\n\n",
-        METRIC_TYPE_GAUGE, g_metrics.http_requests_in_flight);
-    
-    offset += (size_t)snprintf(metrics_buffer + offset, sizeof(metrics_buffer) - offset,
-        "# HELP ramd_http_request_duration_seconds HTTP request duration\n"
-        "# TYPE ramd_http_request_duration_seconds %s\n"
-        "ramd_http_request_duration_seconds %.3f\n\n",
-        METRIC_TYPE_GAUGE, g_metrics.http_request_duration_seconds);
-    
-    /* Copy to response buffer */
-    strncpy(response, metrics_buffer, response_size - 1);
-    response[response_size - 1] = '\0';
+    ok &= ramd_prometheus_render_raft_internals(output);
+    if (g_ramd_daemon)
+        ok &= ramd_monitor_render_prometheus(&g_ramd_daemon->monitor, output);
+
+    /* Request counts and latency come from the sharded HTTP counters */
+    if (g_ramd_metrics)
+        ok &= ramd_metrics_render_http_latency(g_ramd_metrics, output);
+    ok &= ramd_failover_trace_render_prometheus(output);
+    ok &= ramd_http_profile_render_prometheus(output);
+    ok &= ramd_mem_render_prometheus(output);
+    ok &= ramd_sysmon_render_prometheus(output);
+    ok &= ramd_proxy_render_prometheus(output);
+    ok &= ramd_archiver_render_prometheus(output);
+    ok &= ramd_backup_verify_render_prometheus(output);
+    ok &= ramd_remote_write_render_prometheus(output);
+    ok &= ramd_replay_render_prometheus(output);
     
-    return 0;
+    return ok;
+}
+
+/* Borrow a pooled session to the local server, NULL if unavailable */
+static PGconn *
+ramd_prometheus_checkout(void)
+{
+	const ramd_config_t *config;
+
+	if (!g_ramd_daemon)
+		return NULL;
+	config = &g_ramd_daemon->config;
+	return ramd_conn_checkout(config->node_id, config->hostname, config->postgresql_port,
+							  config->database_name, config->database_user,
+							  config->database_password);
+}
+
+static void
+ramd_prometheus_checkin(PGconn *conn)
+{
+	if (conn && g_ramd_daemon)
+		ramd_conn_checkin(g_ramd_daemon->config.node_id, conn);
+}
+
+/*
+ * Append the exposition text to output; it grows as needed, so the
+ * number of series is not bounded by a fixed buffer.
+ */
+int
+ramd_prometheus_render(ramd_buffer_t* output)
+{
+	PGconn	   *conn;
+
+	if (!output)
+		return -1;
+
+	/* Update metrics before serving */
+	conn = ramd_prometheus_checkout();
+	ramd_prometheus_update_metrics(conn);
+	ramd_prometheus_checkin(conn);
+
+	return ramd_prometheus_render_series(output) ? 0 : -1;
+}
+
+int
+ramd_prometheus_handle_request(const char* request, char* response, size_t response_size)
+{
+	ramd_buffer_t output;
+
+	(void) request;		/* Suppress unused parameter warning */
+
+	if (!response || response_size == 0)
+		return -1;
+
+	ramd_buffer_init(&output);
+	if (ramd_prometheus_render(&output) != 0)
+	{
+		ramd_buffer_free(&output);
+		return -1;
+	}
+
+	/* Copy to response buffer */
+	strncpy(response, output.data, response_size - 1);
+	response[response_size - 1] = '\0';
+	ramd_buffer_free(&output);
+
+	return 0;
 }
 
 void
 ramd_prometheus_cleanup(void)
 {
+    ramd_prometheus_stop_collector();
     ramd_log_info("Prometheus metrics cleanup completed");
 }
+
+/* Gzip text into a new buffer charged to METRICS; returns NULL on failure */
+static char*
+ramd_prometheus_gzip(const char* text, size_t length, size_t* out_length)
+{
+	z_stream	stream;
+	char	   *out;
+	uLong		bound;
+
+	memset(&stream, 0, sizeof(stream));
+	/* windowBits 15 + 16 selects the gzip wrapper browsers and scrapers expect */
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+					 Z_DEFAULT_STRATEGY) != Z_OK)
+		return NULL;
+
+	bound = deflateBound(&stream, (uLong) length);
+	out = ramd_mem_alloc(RAMD_MEM_METRICS, bound);
+	if (!out)
+	{
+		deflateEnd(&stream);
+		return NULL;
+	}
+
+	stream.next_in = (Bytef *) text;
+	stream.avail_in = (uInt) length;
+	stream.next_out = (Bytef *) out;
+	stream.avail_out = (uInt) bound;
+	if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+	{
+		deflateEnd(&stream);
+		ramd_mem_free(RAMD_MEM_METRICS, out);
+		return NULL;
+	}
+
+	*out_length = (size_t) stream.total_out;
+	deflateEnd(&stream);
+	return out;
+}
+
+static void
+ramd_prometheus_snapshot_free(ramd_prometheus_snapshot_t* snapshot)
+{
+	ramd_mem_free(RAMD_MEM_METRICS, snapshot->text);
+	ramd_mem_free(RAMD_MEM_METRICS, snapshot->gzip);
+	ramd_mem_free(RAMD_MEM_METRICS, snapshot);
+}
+
+/* Render one exposition into a fresh snapshot, or NULL if unavailable */
+static ramd_prometheus_snapshot_t*
+ramd_prometheus_build_snapshot(ramd_prometheus_exposition_t which, PGconn* conn)
+{
+	ramd_prometheus_snapshot_t *snapshot;
+	ramd_buffer_t output;
+	bool		ok;
+
+	ramd_buffer_init_subsystem(&output, RAMD_MEM_METRICS);
+	if (which == RAMD_PROMETHEUS_EXPOSITION_CLUSTER)
+	{
+		const ramd_cluster_t* cluster;
+
+		if (!g_ramd_daemon || !g_ramd_metrics)
+			return NULL;
+		cluster = ramd_cluster_acquire();
+		if (cluster)
+		{
+			ramd_metrics_collect(g_ramd_metrics, cluster);
+			ramd_cluster_release(cluster);
+		}
+		ok = ramd_metrics_render_prometheus(g_ramd_metrics, &output);
+	}
+	else
+	{
+		ramd_prometheus_collect_system_metrics();
+		ramd_prometheus_collect_postgresql_metrics(conn);
+		ramd_prometheus_collect_raft_metrics(conn);
+		g_metrics_last_update_ms = ramd_clock_now_ms();
+		ok = ramd_prometheus_render_series(&output);
+	}
+
+	snapshot = ok ? ramd_mem_calloc(RAMD_MEM_METRICS, 1, sizeof(*snapshot)) : NULL;
+	if (!snapshot)
+	{
+		ramd_buffer_free(&output);
+		return NULL;
+	}
+
+	snapshot->refcount = 1;
+	snapshot->text_length = output.length;
+	snapshot->text = ramd_buffer_detach(&output);
+	if (!snapshot->text)
+	{
+		ramd_mem_free(RAMD_MEM_METRICS, snapshot);
+		return NULL;
+	}
+	if (g_collector_compress)
+		snapshot->gzip = ramd_prometheus_gzip(snapshot->text, snapshot->text_length,
+											  &snapshot->gzip_length);
+	snapshot->rendered_at = time(NULL);
+	snapshot->rendered_ms = ramd_clock_wall_ms(ramd_clock_now_ms());
+	return snapshot;
+}
+
+/* Re-render every exposition and publish the results */
+static void
+ramd_prometheus_refresh(void)
+{
+	ramd_prometheus_snapshot_t *fresh;
+	ramd_prometheus_snapshot_t *old;
+	PGconn	   *conn;
+	int			i;
+
+	conn = ramd_prometheus_checkout();
+	for (i = 0; i < RAMD_PROMETHEUS_EXPOSITION_COUNT; i++)
+	{
+		fresh = ramd_prometheus_build_snapshot((ramd_prometheus_exposition_t) i, conn);
+		if (!fresh)
+			continue;	/* keep serving the previous snapshot */
+
+		pthread_mutex_lock(&g_cache_lock);
+		old = g_snapshots[i];
+		g_snapshots[i] = fresh;
+		pthread_mutex_unlock(&g_cache_lock);
+
+		if (old)
+			ramd_prometheus_snapshot_release(old);
+	}
+	ramd_prometheus_checkin(conn);
+}
+
+/* Role, health and membership show up at once; lag waits for the interval */
+static void
+ramd_prometheus_on_watch_events(const ramd_watch_event_t* events, int32_t count, void* arg)
+{
+	(void) arg;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (events[i].type != RAMD_WATCH_EVENT_NODE_LAG)
+		{
+			pthread_mutex_lock(&g_cache_lock);
+			g_collector_dirty = true;
+			pthread_cond_signal(&g_collector_cond);
+			pthread_mutex_unlock(&g_cache_lock);
+			return;
+		}
+	}
+}
+
+static void*
+ramd_prometheus_collector_thread(void* arg)
+{
+	struct timespec deadline;
+
+	(void) arg;
+
+	pthread_mutex_lock(&g_cache_lock);
+	while (!g_collector_stop)
+	{
+		g_collector_dirty = false;
+		pthread_mutex_unlock(&g_cache_lock);
+		ramd_prometheus_refresh();
+		pthread_mutex_lock(&g_cache_lock);
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += g_collector_interval_ms / 1000;
+		deadline.tv_nsec += (long) (g_collector_interval_ms % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+		while (!g_collector_stop && !g_collector_dirty &&
+			   pthread_cond_timedwait(&g_collector_cond, &g_cache_lock, &deadline) == 0)
+			;
+	}
+	pthread_mutex_unlock(&g_cache_lock);
+	return NULL;
+}
+
+bool
+ramd_prometheus_start_collector(int32_t interval_ms, bool compress)
+{
+	if (g_collector_running)
+		return true;
+
+	g_collector_interval_ms = interval_ms > 0 ? interval_ms : RAMD_METRICS_COLLECTION_INTERVAL_MS;
+	g_collector_compress = compress;
+	g_collector_stop = false;
+
+	if (pthread_create(&g_collector_thread, NULL, ramd_prometheus_collector_thread, NULL) != 0)
+	{
+		ramd_log_error("Failed to start Prometheus metrics collector thread");
+		return false;
+	}
+
+	g_collector_running = true;
+	if (!ramd_watch_subscribe(ramd_prometheus_on_watch_events, NULL))
+		ramd_log_warning("Metrics collector: no room to follow cluster changes");
+	ramd_log_info("Prometheus metrics collector started (refresh every %d ms, gzip %s)",
+				  g_collector_interval_ms, compress ? "on" : "off");
+	return true;
+}
+
+void
+ramd_prometheus_stop_collector(void)
+{
+	ramd_prometheus_snapshot_t *old;
+	int			i;
+
+	if (!g_collector_running)
+		return;
+
+	ramd_watch_unsubscribe(ramd_prometheus_on_watch_events, NULL);
+
+	pthread_mutex_lock(&g_cache_lock);
+	g_collector_stop = true;
+	pthread_cond_signal(&g_collector_cond);
+	pthread_mutex_unlock(&g_cache_lock);
+	pthread_join(g_collector_thread, NULL);
+	g_collector_running = false;
+
+	/* Drop the cache's own references; in-flight scrapes keep theirs */
+	for (i = 0; i < RAMD_PROMETHEUS_EXPOSITION_COUNT; i++)
+	{
+		pthread_mutex_lock(&g_cache_lock);
+		old = g_snapshots[i];
+		g_snapshots[i] = NULL;
+		pthread_mutex_unlock(&g_cache_lock);
+		if (old)
+			ramd_prometheus_snapshot_release(old);
+	}
+}
+
+/* Take a reference to the current snapshot; NULL until the first render */
+ramd_prometheus_snapshot_t*
+ramd_prometheus_snapshot_acquire(ramd_prometheus_exposition_t which)
+{
+	ramd_prometheus_snapshot_t *snapshot;
+
+	if ((int) which < 0 || which >= RAMD_PROMETHEUS_EXPOSITION_COUNT)
+		return NULL;
+
+	pthread_mutex_lock(&g_cache_lock);
+	snapshot = g_snapshots[which];
+	if (snapshot)
+		snapshot->refcount++;
+	pthread_mutex_unlock(&g_cache_lock);
+	return snapshot;
+}
+
+void
+ramd_prometheus_snapshot_release(ramd_prometheus_snapshot_t* snapshot)
+{
+	bool		last;
+
+	if (!snapshot)
+		return;
+
+	pthread_mutex_lock(&g_cache_lock);
+	last = --snapshot->refcount == 0;
+	pthread_mutex_unlock(&g_cache_lock);
+
+	if (last)
+		ramd_prometheus_snapshot_free(snapshot);
+}
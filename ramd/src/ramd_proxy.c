@@ -0,0 +1,974 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_proxy.c
+ *		PostgreSQL Auto-Failover Daemon - Primary-Routing TCP Proxy
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Clients connect to proxy_port for the primary, or to proxy_read_port for
+ * the healthy standby with the least replay lag, and ramd relays the
+ * connection to PostgreSQL byte for byte without parsing the protocol.
+ * This takes the place of a load balancer that polls the HTTP API: routes
+ * come from the watch feed, whose subscriber wakes the proxy thread the
+ * moment the monitor publishes a change.  A new primary therefore serves
+ * the next connection right away.  Sessions to a node that lost its role
+ * are cut, so their clients reconnect.  Write connections are refused
+ * while a failover runs or no healthy primary is known.
+ *
+ * One thread runs the event loop, on epoll or kqueue like the HTTP server.
+ * On Linux each direction of a session moves through a kernel pipe with
+ * splice(), so relayed bytes never enter user space.  Elsewhere they pass
+ * through a buffer per direction.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* splice, pipe2 */
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define RAMD_PROXY_USE_EPOLL
+#define RAMD_PROXY_USE_SPLICE
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+	defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#else
+#error "ramd proxy requires epoll or kqueue"
+#endif
+
+#include "ramd_proxy.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_watch.h"
+
+typedef enum
+{
+	RAMD_PROXY_WRITE = 0, /* proxy_port, to the primary */
+	RAMD_PROXY_READ,      /* proxy_read_port, to a standby */
+	RAMD_PROXY_KIND_COUNT
+} ramd_proxy_kind_t;
+
+static const char* const g_proxy_kind_names[RAMD_PROXY_KIND_COUNT] = {"write", "read"};
+
+/* Where new connections of one kind go; node_id -1 when nowhere */
+typedef struct ramd_proxy_route_t
+{
+	int32_t node_id;
+	char hostname[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+} ramd_proxy_route_t;
+
+/* Bytes read from one socket of a session and not yet written to the other */
+typedef struct ramd_proxy_flow_t
+{
+#ifdef RAMD_PROXY_USE_SPLICE
+	int pipe_fd[2];
+#else
+	char* buf;      /* RAMD_PROXY_FLOW_SIZE bytes */
+	size_t head;    /* first byte not yet written */
+#endif
+	size_t pending;
+	bool eof;       /* the source closed its side */
+	bool shut;      /* and the destination was told */
+} ramd_proxy_flow_t;
+
+struct ramd_proxy_session_t;
+
+/* One socket of a session as the poller knows it */
+typedef struct ramd_proxy_end_t
+{
+	struct ramd_proxy_session_t* session;
+	int fd;
+	bool want_read;
+	bool want_write;
+} ramd_proxy_end_t;
+
+typedef struct ramd_proxy_session_t
+{
+	ramd_proxy_end_t client;
+	ramd_proxy_end_t server;
+	ramd_proxy_flow_t up;   /* client to server */
+	ramd_proxy_flow_t down; /* server to client */
+	ramd_proxy_kind_t kind;
+	int32_t node_id;
+	bool connecting;
+	int64_t connect_deadline_ms;
+	bool in_use;
+	struct ramd_proxy_session_t* next_free;
+} ramd_proxy_session_t;
+
+/* Poller event, as the HTTP server reduces epoll and kqueue events */
+typedef struct ramd_proxy_event_t
+{
+	void* ptr;
+	bool readable;
+	bool writable;
+	bool failed;
+} ramd_proxy_event_t;
+
+typedef struct ramd_proxy_stats_t
+{
+	atomic_llong accepted[RAMD_PROXY_KIND_COUNT];
+	atomic_llong refused[RAMD_PROXY_KIND_COUNT];  /* no route, or no free session */
+	atomic_llong failed[RAMD_PROXY_KIND_COUNT];   /* could not reach the node */
+	atomic_llong rerouted[RAMD_PROXY_KIND_COUNT]; /* cut when their node lost its role */
+	atomic_llong active[RAMD_PROXY_KIND_COUNT];
+	atomic_llong bytes_up;
+	atomic_llong bytes_down;
+	atomic_int route_node[RAMD_PROXY_KIND_COUNT];
+} ramd_proxy_stats_t;
+
+typedef struct ramd_proxy_t
+{
+	bool running;             /* proxy thread only, after start */
+	atomic_bool stop;
+	pthread_t thread;
+	const ramd_config_t* config;
+	int poll_fd;
+	int wake_fd[2];
+	int listen_fd[RAMD_PROXY_KIND_COUNT];
+	ramd_proxy_session_t* sessions; /* proxy_max_connections */
+	ramd_proxy_session_t* free_list;
+	ramd_proxy_route_t routes[RAMD_PROXY_KIND_COUNT];
+	uint64_t seen_version;    /* watch feed version the routes follow */
+	bool unresolved;          /* a target's address lookup failed; retry it */
+	ramd_watch_snapshot_t view;
+	ramd_proxy_stats_t stats;
+} ramd_proxy_t;
+
+static ramd_proxy_t g_proxy = {
+	.poll_fd = -1,
+	.wake_fd = {-1, -1},
+	.listen_fd = {-1, -1},
+};
+
+static bool
+ramd_proxy_set_nonblocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		return false;
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return true;
+}
+
+static int
+ramd_proxy_poller_create(void)
+{
+#ifdef RAMD_PROXY_USE_EPOLL
+	return epoll_create1(EPOLL_CLOEXEC);
+#else
+	return kqueue();
+#endif
+}
+
+static bool
+ramd_proxy_poller_set(int fd, void* ptr, bool want_read, bool want_write, bool add)
+{
+#ifdef RAMD_PROXY_USE_EPOLL
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = (want_read ? EPOLLIN : 0) | (want_write ? EPOLLOUT : 0);
+	ev.data.ptr = ptr;
+	return epoll_ctl(g_proxy.poll_fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+#else
+	struct kevent changes[2];
+
+	(void) add;
+	EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | (want_read ? EV_ENABLE : EV_DISABLE),
+	       0, 0, ptr);
+	EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | (want_write ? EV_ENABLE : EV_DISABLE),
+	       0, 0, ptr);
+	return kevent(g_proxy.poll_fd, changes, 2, NULL, 0, NULL) == 0;
+#endif
+}
+
+static int
+ramd_proxy_poller_wait(ramd_proxy_event_t* events, int timeout_ms)
+{
+	int n;
+
+#ifdef RAMD_PROXY_USE_EPOLL
+	struct epoll_event raw[RAMD_PROXY_MAX_EVENTS];
+
+	n = epoll_wait(g_proxy.poll_fd, raw, RAMD_PROXY_MAX_EVENTS, timeout_ms);
+	for (int i = 0; i < n; i++)
+	{
+		events[i].ptr = raw[i].data.ptr;
+		events[i].readable = (raw[i].events & EPOLLIN) != 0;
+		events[i].writable = (raw[i].events & EPOLLOUT) != 0;
+		events[i].failed = (raw[i].events & (EPOLLERR | EPOLLHUP)) != 0;
+	}
+#else
+	struct kevent raw[RAMD_PROXY_MAX_EVENTS];
+	struct timespec ts;
+
+	ts.tv_sec = timeout_ms / 1000;
+	ts.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+	n = kevent(g_proxy.poll_fd, NULL, 0, raw, RAMD_PROXY_MAX_EVENTS, &ts);
+	for (int i = 0; i < n; i++)
+	{
+		events[i].ptr = raw[i].udata;
+		/* EOF is reported as readable so that the read observes it */
+		events[i].readable = raw[i].filter == EVFILT_READ;
+		events[i].writable = raw[i].filter == EVFILT_WRITE;
+		events[i].failed = (raw[i].flags & EV_ERROR) != 0;
+	}
+#endif
+	return n;
+}
+
+/* Watch feed subscriber; runs under the feed lock, so only wakes the loop */
+static void
+ramd_proxy_wake(const ramd_watch_event_t* events, int32_t count, void* arg)
+{
+	(void) events;
+	(void) count;
+	(void) arg;
+
+	if (write(g_proxy.wake_fd[1], "w", 1) < 0 && errno != EAGAIN)
+		ramd_log_warning("Proxy: failed to wake proxy thread: %s", strerror(errno));
+}
+
+static int
+ramd_proxy_listen(const char* bind_address, int32_t port)
+{
+	struct sockaddr_in addr;
+	int opt = 1;
+	int fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t) port);
+	if (inet_pton(AF_INET, bind_address, &addr.sin_addr) <= 0)
+	{
+		ramd_log_error("Proxy: invalid bind address: %s", bind_address);
+		return -1;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		ramd_log_error("Proxy: failed to create socket: %s", strerror(errno));
+		return -1;
+	}
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0)
+		ramd_log_warning("Proxy: failed to set SO_REUSEADDR: %s", strerror(errno));
+
+	if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+	    listen(fd, SOMAXCONN) < 0 || !ramd_proxy_set_nonblocking(fd))
+	{
+		ramd_log_error("Proxy: failed to listen on %s:%d: %s", bind_address, port,
+		               strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static void
+ramd_proxy_flow_init(ramd_proxy_flow_t* flow)
+{
+#ifdef RAMD_PROXY_USE_SPLICE
+	flow->pipe_fd[0] = -1;
+	flow->pipe_fd[1] = -1;
+#else
+	flow->head = 0;
+#endif
+	flow->pending = 0;
+	flow->eof = false;
+	flow->shut = false;
+}
+
+static bool
+ramd_proxy_flow_open(ramd_proxy_flow_t* flow)
+{
+	ramd_proxy_flow_init(flow);
+#ifdef RAMD_PROXY_USE_SPLICE
+	if (pipe2(flow->pipe_fd, O_NONBLOCK | O_CLOEXEC) != 0)
+	{
+		flow->pipe_fd[0] = flow->pipe_fd[1] = -1;
+		return false;
+	}
+#endif
+	return true;
+}
+
+static void
+ramd_proxy_flow_close(ramd_proxy_flow_t* flow)
+{
+#ifdef RAMD_PROXY_USE_SPLICE
+	for (int i = 0; i < 2; i++)
+	{
+		if (flow->pipe_fd[i] >= 0)
+			close(flow->pipe_fd[i]);
+		flow->pipe_fd[i] = -1;
+	}
+#endif
+	flow->pending = 0;
+}
+
+/* Read what src has into the flow: > 0 bytes, 0 at EOF, -1 with errno */
+static ssize_t
+ramd_proxy_flow_fill(ramd_proxy_flow_t* flow, int src_fd)
+{
+#ifdef RAMD_PROXY_USE_SPLICE
+	return splice(src_fd, NULL, flow->pipe_fd[1], NULL, RAMD_PROXY_FLOW_SIZE - flow->pending,
+	              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+	/* Only filled once drained, so the data always starts at the front */
+	flow->head = 0;
+	return recv(src_fd, flow->buf + flow->pending, RAMD_PROXY_FLOW_SIZE - flow->pending, 0);
+#endif
+}
+
+/* Write staged bytes to dst: how many, or -1 with errno */
+static ssize_t
+ramd_proxy_flow_drain(ramd_proxy_flow_t* flow, int dst_fd)
+{
+#ifdef RAMD_PROXY_USE_SPLICE
+	return splice(flow->pipe_fd[0], NULL, dst_fd, NULL, flow->pending,
+	              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+	ssize_t n = send(dst_fd, flow->buf + flow->head, flow->pending, 0);
+
+	if (n > 0)
+		flow->head += (size_t) n;
+	return n;
+#endif
+}
+
+/*
+ * Move bytes from src to dst until one of them would block.  The flow is
+ * refilled only once drained, so a slow reader stops the writer instead of
+ * piling data up here.  False when the session has to end.
+ */
+static bool
+ramd_proxy_flow_pump(ramd_proxy_flow_t* flow, int src_fd, int dst_fd, atomic_llong* bytes)
+{
+	for (;;)
+	{
+		ssize_t n;
+
+		if (flow->pending > 0)
+		{
+			n = ramd_proxy_flow_drain(flow, dst_fd);
+			if (n < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return errno == EAGAIN || errno == EWOULDBLOCK;
+			}
+			flow->pending -= (size_t) n;
+			atomic_fetch_add_explicit(bytes, (long long) n, memory_order_relaxed);
+			continue;
+		}
+
+		if (flow->eof)
+		{
+			if (!flow->shut)
+				shutdown(dst_fd, SHUT_WR);
+			flow->shut = true;
+			return true;
+		}
+
+		n = ramd_proxy_flow_fill(flow, src_fd);
+		if (n == 0)
+			flow->eof = true;
+		else if (n > 0)
+			flow->pending = (size_t) n;
+		else if (errno == EINTR)
+			continue;
+		else
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+	}
+}
+
+static bool
+ramd_proxy_end_update(ramd_proxy_end_t* end, bool want_read, bool want_write)
+{
+	if (end->want_read == want_read && end->want_write == want_write)
+		return true;
+	end->want_read = want_read;
+	end->want_write = want_write;
+	return ramd_proxy_poller_set(end->fd, end, want_read, want_write, false);
+}
+
+static void
+ramd_proxy_session_close(ramd_proxy_session_t* session)
+{
+	/* Closing a descriptor takes it out of the poller as well */
+	if (session->client.fd >= 0)
+		close(session->client.fd);
+	if (session->server.fd >= 0)
+		close(session->server.fd);
+	session->client.fd = -1;
+	session->server.fd = -1;
+	ramd_proxy_flow_close(&session->up);
+	ramd_proxy_flow_close(&session->down);
+	atomic_fetch_sub_explicit(&g_proxy.stats.active[session->kind], 1, memory_order_relaxed);
+
+	session->in_use = false;
+	session->next_free = g_proxy.free_list;
+	g_proxy.free_list = session;
+}
+
+/* Relay what can be relayed and ask for the events that would unblock the rest */
+static void
+ramd_proxy_session_pump(ramd_proxy_session_t* session)
+{
+	if (!ramd_proxy_flow_pump(&session->up, session->client.fd, session->server.fd,
+	                          &g_proxy.stats.bytes_up) ||
+	    !ramd_proxy_flow_pump(&session->down, session->server.fd, session->client.fd,
+	                          &g_proxy.stats.bytes_down) ||
+	    (session->up.shut && session->down.shut))
+	{
+		ramd_proxy_session_close(session);
+		return;
+	}
+
+	if (!ramd_proxy_end_update(&session->client,
+	                           !session->up.eof && session->up.pending == 0,
+	                           session->down.pending > 0) ||
+	    !ramd_proxy_end_update(&session->server,
+	                           !session->down.eof && session->down.pending == 0,
+	                           session->up.pending > 0))
+		ramd_proxy_session_close(session);
+}
+
+static void
+ramd_proxy_session_connected(ramd_proxy_session_t* session)
+{
+	int error = 0;
+	socklen_t len = sizeof(error);
+
+	if (getsockopt(session->server.fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0)
+		error = errno;
+	if (error != 0)
+	{
+		ramd_log_debug("Proxy: cannot reach node %d at %s:%d: %s", session->node_id,
+		               g_proxy.routes[session->kind].hostname,
+		               g_proxy.routes[session->kind].port, strerror(error));
+		atomic_fetch_add_explicit(&g_proxy.stats.failed[session->kind], 1,
+		                          memory_order_relaxed);
+		ramd_proxy_session_close(session);
+		return;
+	}
+	session->connecting = false;
+	ramd_proxy_session_pump(session);
+}
+
+static void
+ramd_proxy_accept(ramd_proxy_kind_t kind)
+{
+	for (;;)
+	{
+		const ramd_proxy_route_t* route = &g_proxy.routes[kind];
+		ramd_proxy_session_t* session;
+		int one = 1;
+		int client_fd;
+		int server_fd;
+
+		client_fd = accept(g_proxy.listen_fd[kind], NULL, NULL);
+		if (client_fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				ramd_log_warning("Proxy: accept failed: %s", strerror(errno));
+			return;
+		}
+
+		session = g_proxy.free_list;
+		if (route->node_id < 0 || !session)
+		{
+			/* The client sees the connection drop and retries, as after a failover */
+			atomic_fetch_add_explicit(&g_proxy.stats.refused[kind], 1, memory_order_relaxed);
+			close(client_fd);
+			continue;
+		}
+
+		server_fd = socket(route->addr.ss_family, SOCK_STREAM, 0);
+		if (server_fd < 0 || !ramd_proxy_set_nonblocking(client_fd) ||
+		    !ramd_proxy_set_nonblocking(server_fd))
+		{
+			ramd_log_warning("Proxy: cannot open a connection to node %d: %s", route->node_id,
+			                 strerror(errno));
+			if (server_fd >= 0)
+				close(server_fd);
+			close(client_fd);
+			atomic_fetch_add_explicit(&g_proxy.stats.failed[kind], 1, memory_order_relaxed);
+			continue;
+		}
+		setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		g_proxy.free_list = session->next_free;
+		session->in_use = true;
+		session->kind = kind;
+		session->node_id = route->node_id;
+		session->client.fd = client_fd;
+		session->server.fd = server_fd;
+		session->client.want_read = session->client.want_write = false;
+		session->server.want_read = false;
+		session->server.want_write = true;
+		session->connecting = true;
+		session->connect_deadline_ms = ramd_clock_now_ms() + RAMD_PROXY_CONNECT_TIMEOUT_MS;
+		atomic_fetch_add_explicit(&g_proxy.stats.accepted[kind], 1, memory_order_relaxed);
+		atomic_fetch_add_explicit(&g_proxy.stats.active[kind], 1, memory_order_relaxed);
+
+		if (!ramd_proxy_flow_open(&session->up) || !ramd_proxy_flow_open(&session->down) ||
+		    (connect(server_fd, (const struct sockaddr*) &route->addr, route->addr_len) != 0 &&
+		     errno != EINPROGRESS) ||
+		    !ramd_proxy_poller_set(client_fd, &session->client, false, false, true) ||
+		    !ramd_proxy_poller_set(server_fd, &session->server, false, true, true))
+		{
+			ramd_log_debug("Proxy: cannot connect to node %d: %s", route->node_id,
+			               strerror(errno));
+			atomic_fetch_add_explicit(&g_proxy.stats.failed[kind], 1, memory_order_relaxed);
+			ramd_proxy_session_close(session);
+		}
+	}
+}
+
+/* Point route at node, resolving its address only when it moved */
+static void
+ramd_proxy_set_route(ramd_proxy_kind_t kind, const ramd_watch_node_t* node)
+{
+	ramd_proxy_route_t* route = &g_proxy.routes[kind];
+	struct addrinfo hints;
+	struct addrinfo* found = NULL;
+	char port[16];
+	int rc;
+
+	if (!node)
+	{
+		if (route->node_id >= 0)
+			ramd_log_info("Proxy: no %s target; new %s connections are refused",
+			              g_proxy_kind_names[kind], g_proxy_kind_names[kind]);
+		route->node_id = -1;
+		atomic_store(&g_proxy.stats.route_node[kind], -1);
+		return;
+	}
+	if (route->node_id == node->node_id && route->port == node->postgresql_port &&
+	    strcmp(route->hostname, node->hostname) == 0)
+		return;
+	/* A cut copy would never compare equal and re-resolve on every view */
+	if (strnlen(node->hostname, sizeof(route->hostname)) == sizeof(route->hostname))
+	{
+		ramd_log_warning("Proxy: hostname of node %d is too long", node->node_id);
+		route->node_id = -1;
+		atomic_store(&g_proxy.stats.route_node[kind], -1);
+		return;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof(port), "%d", node->postgresql_port);
+	rc = getaddrinfo(node->hostname, port, &hints, &found);
+	if (rc != 0 || !found || found->ai_addrlen > sizeof(route->addr))
+	{
+		ramd_log_warning("Proxy: cannot resolve node %d (%s): %s", node->node_id,
+		                 node->hostname, rc != 0 ? gai_strerror(rc) : "no address");
+		if (found)
+			freeaddrinfo(found);
+		g_proxy.unresolved = true;
+		route->node_id = -1;
+		atomic_store(&g_proxy.stats.route_node[kind], -1);
+		return;
+	}
+
+	memcpy(&route->addr, found->ai_addr, found->ai_addrlen);
+	route->addr_len = found->ai_addrlen;
+	freeaddrinfo(found);
+	route->node_id = node->node_id;
+	route->port = node->postgresql_port;
+	snprintf(route->hostname, sizeof(route->hostname), "%s", node->hostname);
+	atomic_store(&g_proxy.stats.route_node[kind], node->node_id);
+	ramd_log_info("Proxy: %s connections go to node %d at %s:%d", g_proxy_kind_names[kind],
+	              node->node_id, node->hostname, node->postgresql_port);
+}
+
+/*
+ * Follow the published view: writes to the healthy primary unless a
+ * failover is running, reads to the standby furthest ahead within
+ * proxy_read_max_lag_ms, or the primary when there is none.  Write
+ * sessions to anything but the primary are cut, and read sessions to a
+ * node no longer healthy.
+ */
+static void
+ramd_proxy_refresh_routes(void)
+{
+	const ramd_watch_snapshot_t* view = &g_proxy.view;
+	const ramd_watch_node_t* primary = NULL;
+	const ramd_watch_node_t* standby = NULL;
+	uint64_t version = ramd_watch_version();
+
+	if (version == g_proxy.seen_version && !g_proxy.unresolved)
+		return;
+	ramd_watch_get(&g_proxy.view);
+	g_proxy.seen_version = view->version;
+	g_proxy.unresolved = false;
+
+	for (int32_t i = 0; i < view->node_count; i++)
+	{
+		const ramd_watch_node_t* node = &view->nodes[i];
+
+		if (!node->is_healthy)
+			continue;
+		if (node->is_primary)
+			primary = node;
+		else if (node->replay_lag_ms >= 0 &&
+		         node->replay_lag_ms <= g_proxy.config->proxy_read_max_lag_ms &&
+		         (!standby || node->replay_lag_ms < standby->replay_lag_ms))
+			standby = node;
+	}
+	if (view->in_failover)
+		primary = NULL;
+
+	ramd_proxy_set_route(RAMD_PROXY_WRITE, primary);
+	ramd_proxy_set_route(RAMD_PROXY_READ, standby ? standby : primary);
+
+	for (int32_t i = 0; i < g_proxy.config->proxy_max_connections; i++)
+	{
+		ramd_proxy_session_t* session = &g_proxy.sessions[i];
+		bool keep = true;
+
+		if (!session->in_use)
+			continue;
+		if (session->kind == RAMD_PROXY_WRITE)
+			keep = session->node_id == g_proxy.routes[RAMD_PROXY_WRITE].node_id;
+		else
+		{
+			keep = false;
+			for (int32_t j = 0; j < view->node_count; j++)
+				if (view->nodes[j].node_id == session->node_id)
+					keep = view->nodes[j].is_healthy;
+		}
+		if (!keep)
+		{
+			atomic_fetch_add_explicit(&g_proxy.stats.rerouted[session->kind], 1,
+			                          memory_order_relaxed);
+			ramd_proxy_session_close(session);
+		}
+	}
+}
+
+static void
+ramd_proxy_expire_connects(void)
+{
+	int64_t now = ramd_clock_now_ms();
+
+	for (int32_t i = 0; i < g_proxy.config->proxy_max_connections; i++)
+	{
+		ramd_proxy_session_t* session = &g_proxy.sessions[i];
+
+		if (session->in_use && session->connecting && now >= session->connect_deadline_ms)
+		{
+			ramd_log_debug("Proxy: connecting to node %d timed out", session->node_id);
+			atomic_fetch_add_explicit(&g_proxy.stats.failed[session->kind], 1,
+			                          memory_order_relaxed);
+			ramd_proxy_session_close(session);
+		}
+	}
+}
+
+static void*
+ramd_proxy_thread_main(void* arg)
+{
+	ramd_proxy_event_t events[RAMD_PROXY_MAX_EVENTS];
+	int64_t next_sweep = ramd_clock_now_ms() + RAMD_PROXY_POLL_INTERVAL_MS;
+
+	(void) arg;
+
+	ramd_proxy_refresh_routes();
+	while (!atomic_load(&g_proxy.stop))
+	{
+		bool woken = false;
+		int n;
+
+		n = ramd_proxy_poller_wait(events, RAMD_PROXY_POLL_INTERVAL_MS);
+		if (n < 0 && errno != EINTR)
+		{
+			ramd_log_error("Proxy: event loop failed: %s", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			void* ptr = events[i].ptr;
+			ramd_proxy_end_t* end;
+			ramd_proxy_session_t* session;
+
+			if (ptr == (void*) g_proxy.wake_fd)
+			{
+				char drain[64];
+
+				while (read(g_proxy.wake_fd[0], drain, sizeof(drain)) > 0)
+					;
+				woken = true;
+				continue;
+			}
+			if (ptr == (void*) &g_proxy.listen_fd[RAMD_PROXY_WRITE])
+			{
+				ramd_proxy_accept(RAMD_PROXY_WRITE);
+				continue;
+			}
+			if (ptr == (void*) &g_proxy.listen_fd[RAMD_PROXY_READ])
+			{
+				ramd_proxy_accept(RAMD_PROXY_READ);
+				continue;
+			}
+
+			/* A session closed by an earlier event of this batch is skipped */
+			end = (ramd_proxy_end_t*) ptr;
+			session = end->session;
+			if (!session->in_use || end->fd < 0)
+				continue;
+
+			if (session->connecting)
+			{
+				if (end == &session->server && (events[i].writable || events[i].failed))
+					ramd_proxy_session_connected(session);
+				else if (end == &session->client && events[i].failed)
+					ramd_proxy_session_close(session);
+				continue;
+			}
+
+			ramd_proxy_session_pump(session);
+			/* A hung-up end gets no more useful events; relay what is left and end */
+			if (events[i].failed && session->in_use)
+				ramd_proxy_session_close(session);
+		}
+
+		/* Routes are rechecked on every wakeup and at least once per interval */
+		if (woken || ramd_clock_now_ms() >= next_sweep)
+			ramd_proxy_refresh_routes();
+		if (ramd_clock_now_ms() >= next_sweep)
+		{
+			ramd_proxy_expire_connects();
+			next_sweep = ramd_clock_now_ms() + RAMD_PROXY_POLL_INTERVAL_MS;
+		}
+	}
+
+	for (int32_t i = 0; i < g_proxy.config->proxy_max_connections; i++)
+		if (g_proxy.sessions[i].in_use)
+			ramd_proxy_session_close(&g_proxy.sessions[i]);
+	return NULL;
+}
+
+/* Release what ramd_proxy_start() set up, in reverse order */
+static void
+ramd_proxy_release(void)
+{
+	for (int i = 0; i < RAMD_PROXY_KIND_COUNT; i++)
+	{
+		if (g_proxy.listen_fd[i] >= 0)
+			close(g_proxy.listen_fd[i]);
+		g_proxy.listen_fd[i] = -1;
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (g_proxy.wake_fd[i] >= 0)
+			close(g_proxy.wake_fd[i]);
+		g_proxy.wake_fd[i] = -1;
+	}
+	if (g_proxy.poll_fd >= 0)
+		close(g_proxy.poll_fd);
+	g_proxy.poll_fd = -1;
+
+	if (g_proxy.sessions)
+	{
+#ifndef RAMD_PROXY_USE_SPLICE
+		for (int32_t i = 0; i < g_proxy.config->proxy_max_connections; i++)
+		{
+			ramd_mem_free(RAMD_MEM_PROXY, g_proxy.sessions[i].up.buf);
+			ramd_mem_free(RAMD_MEM_PROXY, g_proxy.sessions[i].down.buf);
+		}
+#endif
+		ramd_mem_free(RAMD_MEM_PROXY, g_proxy.sessions);
+	}
+	g_proxy.sessions = NULL;
+	g_proxy.free_list = NULL;
+}
+
+bool
+ramd_proxy_start(const ramd_config_t* config)
+{
+	int32_t ports[RAMD_PROXY_KIND_COUNT];
+
+	if (!config || !config->proxy_enabled)
+		return true;
+	if (g_proxy.running)
+		return true;
+
+	g_proxy.config = config;
+	ports[RAMD_PROXY_WRITE] = config->proxy_port;
+	ports[RAMD_PROXY_READ] = config->proxy_read_port;
+
+	g_proxy.sessions = ramd_mem_calloc(RAMD_MEM_PROXY, (size_t) config->proxy_max_connections,
+	                                   sizeof(ramd_proxy_session_t));
+	if (!g_proxy.sessions)
+	{
+		ramd_log_error("Proxy: failed to allocate %d sessions", config->proxy_max_connections);
+		return false;
+	}
+	for (int32_t i = config->proxy_max_connections - 1; i >= 0; i--)
+	{
+		ramd_proxy_session_t* session = &g_proxy.sessions[i];
+
+		session->client.session = session->server.session = session;
+		session->client.fd = session->server.fd = -1;
+		ramd_proxy_flow_init(&session->up);
+		ramd_proxy_flow_init(&session->down);
+#ifndef RAMD_PROXY_USE_SPLICE
+		session->up.buf = ramd_mem_calloc(RAMD_MEM_PROXY, 1, RAMD_PROXY_FLOW_SIZE);
+		session->down.buf = ramd_mem_calloc(RAMD_MEM_PROXY, 1, RAMD_PROXY_FLOW_SIZE);
+		if (!session->up.buf || !session->down.buf)
+		{
+			ramd_log_error("Proxy: failed to allocate relay buffers");
+			ramd_proxy_release();
+			return false;
+		}
+#endif
+		session->next_free = g_proxy.free_list;
+		g_proxy.free_list = session;
+	}
+	for (int i = 0; i < RAMD_PROXY_KIND_COUNT; i++)
+	{
+		g_proxy.routes[i].node_id = -1;
+		atomic_store(&g_proxy.stats.route_node[i], -1);
+	}
+	g_proxy.seen_version = 0;
+
+	g_proxy.poll_fd = ramd_proxy_poller_create();
+	if (g_proxy.poll_fd < 0 || pipe(g_proxy.wake_fd) != 0 ||
+	    !ramd_proxy_set_nonblocking(g_proxy.wake_fd[0]) ||
+	    !ramd_proxy_set_nonblocking(g_proxy.wake_fd[1]) ||
+	    !ramd_proxy_poller_set(g_proxy.wake_fd[0], g_proxy.wake_fd, true, false, true))
+	{
+		ramd_log_error("Proxy: failed to set up event loop: %s", strerror(errno));
+		ramd_proxy_release();
+		return false;
+	}
+	for (int i = 0; i < RAMD_PROXY_KIND_COUNT; i++)
+	{
+		if (ports[i] == 0)
+			continue;
+		g_proxy.listen_fd[i] = ramd_proxy_listen(config->proxy_bind_address, ports[i]);
+		if (g_proxy.listen_fd[i] < 0 ||
+		    !ramd_proxy_poller_set(g_proxy.listen_fd[i], &g_proxy.listen_fd[i], true, false, true))
+		{
+			ramd_proxy_release();
+			return false;
+		}
+	}
+
+	atomic_store(&g_proxy.stop, false);
+	if (pthread_create(&g_proxy.thread, NULL, ramd_proxy_thread_main, NULL) != 0)
+	{
+		ramd_log_error("Proxy: failed to create thread");
+		ramd_proxy_release();
+		return false;
+	}
+	g_proxy.running = true;
+
+	if (!ramd_watch_subscribe(ramd_proxy_wake, NULL))
+		ramd_log_warning("Proxy: no room to follow cluster changes; routes are rechecked "
+		                 "every %d ms", RAMD_PROXY_POLL_INTERVAL_MS);
+	ramd_log_info("Proxy listening on %s, port %d for the primary%s", config->proxy_bind_address,
+	              config->proxy_port, config->proxy_read_port > 0 ? " and a read port" : "");
+	return true;
+}
+
+void
+ramd_proxy_stop(void)
+{
+	if (!g_proxy.running)
+		return;
+
+	ramd_watch_unsubscribe(ramd_proxy_wake, NULL);
+	atomic_store(&g_proxy.stop, true);
+	if (write(g_proxy.wake_fd[1], "x", 1) < 0 && errno != EAGAIN)
+		ramd_log_warning("Proxy: failed to wake proxy thread: %s", strerror(errno));
+	pthread_join(g_proxy.thread, NULL);
+	g_proxy.running = false;
+
+	ramd_proxy_release();
+	ramd_log_info("Proxy stopped");
+}
+
+bool
+ramd_proxy_render_prometheus(ramd_buffer_t* output)
+{
+	const ramd_proxy_stats_t* stats = &g_proxy.stats;
+	struct
+	{
+		const char* name;
+		const char* help;
+		const char* type;
+		const atomic_llong* values;
+	} series[] = {
+		{"ramd_proxy_connections_total", "Client connections accepted", "counter", stats->accepted},
+		{"ramd_proxy_refused_total", "Client connections closed for want of a target or a free session",
+		 "counter", stats->refused},
+		{"ramd_proxy_failed_total", "Client connections whose target could not be reached",
+		 "counter", stats->failed},
+		{"ramd_proxy_rerouted_total", "Sessions cut because their node lost its role", "counter",
+		 stats->rerouted},
+		{"ramd_proxy_active_connections", "Sessions being relayed", "gauge", stats->active},
+	};
+	bool ok = true;
+
+	if (!output)
+		return false;
+	if (!g_proxy.running)
+		return true;
+
+	for (size_t i = 0; i < sizeof(series) / sizeof(series[0]); i++)
+	{
+		ok &= ramd_buffer_appendf(output, "\n# HELP %s %s\n# TYPE %s %s\n", series[i].name,
+		                          series[i].help, series[i].name, series[i].type);
+		for (int k = 0; k < RAMD_PROXY_KIND_COUNT; k++)
+			ok &= ramd_buffer_appendf(output, "%s{port=\"%s\"} %lld\n", series[i].name,
+			                          g_proxy_kind_names[k], atomic_load(&series[i].values[k]));
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_proxy_bytes_total Bytes relayed, by direction\n"
+		"# TYPE ramd_proxy_bytes_total counter\n"
+		"ramd_proxy_bytes_total{direction=\"to_server\"} %lld\n"
+		"ramd_proxy_bytes_total{direction=\"to_client\"} %lld\n",
+		atomic_load(&stats->bytes_up), atomic_load(&stats->bytes_down));
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_proxy_target_node Node new connections are routed to, -1 if none\n"
+		"# TYPE ramd_proxy_target_node gauge\n");
+	for (int k = 0; k < RAMD_PROXY_KIND_COUNT; k++)
+		ok &= ramd_buffer_appendf(output, "ramd_proxy_target_node{port=\"%s\"} %d\n",
+		                          g_proxy_kind_names[k], atomic_load(&stats->route_node[k]));
+	return ok;
+}
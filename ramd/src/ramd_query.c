@@ -5,10 +5,16 @@
  *
  * Copyright (c) 2024-2025, pgElephant, Inc.
  *
+ * Registered statements are tracked per session by PGconn address and
+ * backend pid.  A session whose entry went stale, e.g. a freed PGconn
+ * whose address was reused, answers "prepared statement does not exist"
+ * and is prepared again, so the table can forget without harm.
+ *
  *-------------------------------------------------------------------------
  */
 
 #include <libpq-fe.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -17,6 +23,81 @@
 #include "ramd_logging.h"
 #include "ramd_defaults.h"
 
+/* Type OIDs the binary readers understand, from pg_type */
+#define RAMD_QUERY_BOOLOID   16
+#define RAMD_QUERY_INT8OID   20
+#define RAMD_QUERY_INT2OID   21
+#define RAMD_QUERY_INT4OID   23
+#define RAMD_QUERY_OIDOID    26
+#define RAMD_QUERY_FLOAT4OID 700
+#define RAMD_QUERY_FLOAT8OID 701
+
+#define RAMD_QUERY_SQLSTATE_UNDEFINED_PSTATEMENT "26000"
+#define RAMD_QUERY_SQLSTATE_DUPLICATE_PSTATEMENT "42P05"
+
+typedef struct ramd_query_stmt_def_t
+{
+	const char* name;
+	const char* sql;
+} ramd_query_stmt_def_t;
+
+/* Types are pinned with casts where the server's choice could vary */
+static const ramd_query_stmt_def_t g_query_stmts[RAMD_QUERY_STMT_COUNT] = {
+	[RAMD_QUERY_STMT_PING] = {"ramd_ping", "SELECT 1"},
+	[RAMD_QUERY_STMT_IS_IN_RECOVERY] = {"ramd_is_in_recovery", "SELECT pg_is_in_recovery()"},
+	[RAMD_QUERY_STMT_VERSION] = {"ramd_version", "SELECT version()"},
+	[RAMD_QUERY_STMT_CURRENT_WAL_LSN] = {"ramd_current_wal_lsn",
+	                                     "SELECT pg_current_wal_lsn()::text"},
+	/* A standby that has replayed everything it received is not lagging */
+	[RAMD_QUERY_STMT_REPLICATION_LAG] = {"ramd_replication_lag",
+	    "SELECT (CASE WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+	    "ELSE EXTRACT(EPOCH FROM (now() - pg_last_xact_replay_timestamp())) END)::float8"},
+	[RAMD_QUERY_STMT_OTHER_ACTIVE_BACKENDS] = {"ramd_other_active_backends",
+	    "SELECT count(*) FROM pg_stat_activity WHERE state = 'active' AND pid != pg_backend_pid()"},
+	[RAMD_QUERY_STMT_ACTIVE_BACKENDS] = {"ramd_active_backends",
+	    "SELECT count(*) FROM pg_stat_activity WHERE state = 'active'"},
+	[RAMD_QUERY_STMT_PGRAFT_IS_LEADER] = {"ramd_pgraft_is_leader", "SELECT pgraft_is_leader()"},
+	[RAMD_QUERY_STMT_PGRAFT_LEADER] = {"ramd_pgraft_leader", "SELECT pgraft_get_leader()"},
+	[RAMD_QUERY_STMT_PGRAFT_TERM] = {"ramd_pgraft_term", "SELECT pgraft_get_term()"},
+	[RAMD_QUERY_STMT_PGRAFT_CLUSTER_HEALTHY] = {"ramd_pgraft_cluster_healthy",
+	                                            "SELECT pgraft_is_cluster_healthy()"},
+	[RAMD_QUERY_STMT_PGRAFT_SNAPSHOT] = {"ramd_pgraft_snapshot",
+	    "SELECT leader_id, current_term, commit_index, last_applied, last_index, state, "
+	    "local_node_id, is_leader, published_at IS NOT NULL, node_id, address, port, "
+	    "node_is_leader, match_index, next_index, progress, voting "
+	    "FROM pgraft_get_cluster_snapshot()"},
+	/* Client sessions other than ramd's own: running, in a transaction, idle */
+	[RAMD_QUERY_STMT_DRAIN_SESSIONS] = {"ramd_drain_sessions",
+	    "SELECT count(*) FILTER (WHERE state = 'active'), "
+	    "count(*) FILTER (WHERE state LIKE 'idle in transaction%'), "
+	    "count(*) FILTER (WHERE state = 'idle') "
+	    "FROM pg_stat_activity WHERE backend_type = 'client backend' "
+	    "AND pid <> pg_backend_pid() AND application_name NOT LIKE 'ramd%'"},
+	/* $1: grace period in milliseconds */
+	[RAMD_QUERY_STMT_DRAIN_TERMINATE_IDLE] = {"ramd_drain_terminate_idle",
+	    "SELECT count(*) FILTER (WHERE pg_terminate_backend(pid)) "
+	    "FROM pg_stat_activity WHERE backend_type = 'client backend' "
+	    "AND pid <> pg_backend_pid() AND application_name NOT LIKE 'ramd%' "
+	    "AND state IN ('idle', 'idle in transaction', 'idle in transaction (aborted)') "
+	    "AND state_change < now() - make_interval(secs => $1::float8 / 1000)"},
+};
+
+typedef struct ramd_query_session_t
+{
+	const PGconn* conn;
+	int backend_pid;
+	uint32_t prepared; /* bit per ramd_query_stmt_t */
+} ramd_query_session_t;
+
+_Static_assert(RAMD_QUERY_STMT_COUNT <= 32, "prepared bitmask is 32 bits");
+
+static struct
+{
+	pthread_mutex_t lock;
+	ramd_query_session_t sessions[RAMD_QUERY_PREPARED_SESSIONS];
+	int32_t next_victim;
+} g_query_registry = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
 static bool g_query_initialized = false;
 
 bool
@@ -151,6 +232,343 @@ ramd_query_exec_params(PGconn *conn, const char *sql,
 	return result;
 }
 
+/* The session's entry, created if create is set; lock held */
+static ramd_query_session_t *
+ramd_query_session(const PGconn *conn, int backend_pid, bool create)
+{
+	ramd_query_session_t *slot = NULL;
+
+	for (int i = 0; i < RAMD_QUERY_PREPARED_SESSIONS; i++)
+	{
+		ramd_query_session_t *s = &g_query_registry.sessions[i];
+
+		if (s->conn == conn)
+		{
+			if (s->backend_pid == backend_pid)
+				return s;
+			/* Same address, different session: what it prepared is gone */
+			s->backend_pid = backend_pid;
+			s->prepared = 0;
+			return s;
+		}
+		if (!s->conn && !slot)
+			slot = s;
+	}
+
+	if (!create)
+		return NULL;
+	if (!slot)
+	{
+		/* Full: evict round-robin, the evicted session just prepares again */
+		slot = &g_query_registry.sessions[g_query_registry.next_victim];
+		g_query_registry.next_victim = (g_query_registry.next_victim + 1) %
+		                               RAMD_QUERY_PREPARED_SESSIONS;
+	}
+	slot->conn = conn;
+	slot->backend_pid = backend_pid;
+	slot->prepared = 0;
+	return slot;
+}
+
+static bool
+ramd_query_is_prepared(const PGconn *conn, ramd_query_stmt_t stmt)
+{
+	ramd_query_session_t *s;
+	bool                  prepared;
+
+	pthread_mutex_lock(&g_query_registry.lock);
+	s = ramd_query_session(conn, PQbackendPID(conn), false);
+	prepared = s && (s->prepared & (1u << stmt));
+	pthread_mutex_unlock(&g_query_registry.lock);
+	return prepared;
+}
+
+static void
+ramd_query_mark_prepared(const PGconn *conn, ramd_query_stmt_t stmt, bool prepared)
+{
+	ramd_query_session_t *s;
+
+	pthread_mutex_lock(&g_query_registry.lock);
+	s = ramd_query_session(conn, PQbackendPID(conn), prepared);
+	if (s)
+	{
+		if (prepared)
+			s->prepared |= 1u << stmt;
+		else
+			s->prepared &= ~(1u << stmt);
+	}
+	pthread_mutex_unlock(&g_query_registry.lock);
+}
+
+void
+ramd_query_forget_connection(PGconn *conn)
+{
+	if (!conn)
+		return;
+
+	pthread_mutex_lock(&g_query_registry.lock);
+	for (int i = 0; i < RAMD_QUERY_PREPARED_SESSIONS; i++)
+	{
+		if (g_query_registry.sessions[i].conn == conn)
+		{
+			memset(&g_query_registry.sessions[i], 0, sizeof(g_query_registry.sessions[i]));
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_query_registry.lock);
+}
+
+static bool
+ramd_query_sqlstate_is(const PGresult *result, const char *sqlstate)
+{
+	const char *state = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+
+	return state && strcmp(state, sqlstate) == 0;
+}
+
+static bool
+ramd_query_prepare(PGconn *conn, ramd_query_stmt_t stmt)
+{
+	const ramd_query_stmt_def_t *def = &g_query_stmts[stmt];
+	PGresult                    *result;
+	bool                         ok;
+
+	result = PQprepare(conn, def->name, def->sql, 0, NULL);
+	ok = result && (PQresultStatus(result) == PGRES_COMMAND_OK ||
+	                ramd_query_sqlstate_is(result, RAMD_QUERY_SQLSTATE_DUPLICATE_PSTATEMENT));
+	if (!ok)
+		ramd_log_error("Failed to prepare %s: %s", def->name,
+		               result ? PQresultErrorMessage(result) : PQerrorMessage(conn));
+	PQclear(result);
+
+	if (ok)
+		ramd_query_mark_prepared(conn, stmt, true);
+	return ok;
+}
+
+PGresult *
+ramd_query_exec_prepared(PGconn *conn, ramd_query_stmt_t stmt,
+						 int nParams, const char *const *paramValues)
+{
+	PGresult *result;
+
+	if (!conn || (int) stmt < 0 || stmt >= RAMD_QUERY_STMT_COUNT)
+	{
+		ramd_log_error("Invalid parameters for prepared statement execution");
+		return NULL;
+	}
+
+	if (PQstatus(conn) != CONNECTION_OK)
+	{
+		ramd_log_error("Database connection is not OK: %s", PQerrorMessage(conn));
+		return NULL;
+	}
+
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		if (!ramd_query_is_prepared(conn, stmt) && !ramd_query_prepare(conn, stmt))
+			return NULL;
+
+		result = PQexecPrepared(conn, g_query_stmts[stmt].name, nParams, paramValues,
+								NULL, NULL, 1);
+		if (!result)
+		{
+			ramd_log_error("Failed to execute %s: %s", g_query_stmts[stmt].name,
+						   PQerrorMessage(conn));
+			return NULL;
+		}
+		if (PQresultStatus(result) == PGRES_TUPLES_OK ||
+			PQresultStatus(result) == PGRES_COMMAND_OK)
+			return result;
+
+		/* Our bookkeeping was stale; prepare it and try once more */
+		if (attempt == 0 &&
+			ramd_query_sqlstate_is(result, RAMD_QUERY_SQLSTATE_UNDEFINED_PSTATEMENT))
+		{
+			PQclear(result);
+			ramd_query_mark_prepared(conn, stmt, false);
+			continue;
+		}
+
+		ramd_log_error("Execution of %s failed: %s", g_query_stmts[stmt].name,
+					   PQresultErrorMessage(result));
+		PQclear(result);
+		return NULL;
+	}
+
+	return NULL;
+}
+
+static uint64_t
+ramd_query_be_uint(const unsigned char *p, int len)
+{
+	uint64_t v = 0;
+
+	for (int i = 0; i < len; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+static bool
+ramd_query_value_present(const PGresult *result, int row, int col)
+{
+	return result && row >= 0 && col >= 0 &&
+		   row < PQntuples(result) && col < PQnfields(result) &&
+		   !PQgetisnull(result, row, col);
+}
+
+bool
+ramd_query_value_bool(const PGresult *result, int row, int col)
+{
+	const char *value;
+
+	if (!ramd_query_value_present(result, row, col))
+		return false;
+
+	value = PQgetvalue(result, row, col);
+	if (PQfformat(result, col) == 1)
+	{
+		if (PQftype(result, col) == RAMD_QUERY_BOOLOID)
+			return value[0] != 0;
+		return ramd_query_value_int64(result, row, col, 0) != 0;
+	}
+	return (strcmp(value, "t") == 0 || strcmp(value, "true") == 0 ||
+			strcmp(value, "1") == 0 || strcmp(value, "yes") == 0);
+}
+
+int64_t
+ramd_query_value_int64(const PGresult *result, int row, int col, int64_t if_null)
+{
+	const unsigned char *value;
+	int                  len;
+
+	if (!ramd_query_value_present(result, row, col))
+		return if_null;
+
+	if (PQfformat(result, col) == 0)
+		return atoll(PQgetvalue(result, row, col));
+
+	value = (const unsigned char *) PQgetvalue(result, row, col);
+	len = PQgetlength(result, row, col);
+	switch (PQftype(result, col))
+	{
+		case RAMD_QUERY_BOOLOID:
+			return len == 1 ? value[0] != 0 : if_null;
+		case RAMD_QUERY_INT2OID:
+			return len == 2 ? (int16_t) ramd_query_be_uint(value, 2) : if_null;
+		case RAMD_QUERY_INT4OID:
+			return len == 4 ? (int32_t) ramd_query_be_uint(value, 4) : if_null;
+		case RAMD_QUERY_OIDOID:
+			return len == 4 ? (int64_t) ramd_query_be_uint(value, 4) : if_null;
+		case RAMD_QUERY_INT8OID:
+			return len == 8 ? (int64_t) ramd_query_be_uint(value, 8) : if_null;
+		case RAMD_QUERY_FLOAT4OID:
+		case RAMD_QUERY_FLOAT8OID:
+			return (int64_t) ramd_query_value_double(result, row, col, (double) if_null);
+	}
+
+	ramd_log_debug("No binary integer reader for type %u", PQftype(result, col));
+	return if_null;
+}
+
+double
+ramd_query_value_double(const PGresult *result, int row, int col, double if_null)
+{
+	const unsigned char *value;
+	int                  len;
+
+	if (!ramd_query_value_present(result, row, col))
+		return if_null;
+
+	if (PQfformat(result, col) == 0)
+		return atof(PQgetvalue(result, row, col));
+
+	value = (const unsigned char *) PQgetvalue(result, row, col);
+	len = PQgetlength(result, row, col);
+	switch (PQftype(result, col))
+	{
+		case RAMD_QUERY_FLOAT8OID:
+			if (len == 8)
+			{
+				uint64_t bits = ramd_query_be_uint(value, 8);
+				double   d;
+
+				memcpy(&d, &bits, sizeof(d));
+				return d;
+			}
+			return if_null;
+		case RAMD_QUERY_FLOAT4OID:
+			if (len == 4)
+			{
+				uint32_t bits = (uint32_t) ramd_query_be_uint(value, 4);
+				float    f;
+
+				memcpy(&f, &bits, sizeof(f));
+				return f;
+			}
+			return if_null;
+		default:
+			return (double) ramd_query_value_int64(result, row, col, (int64_t) if_null);
+	}
+}
+
+/* Text types are sent as their bytes in both formats; libpq terminates them */
+const char *
+ramd_query_value_text(const PGresult *result, int row, int col)
+{
+	if (!ramd_query_value_present(result, row, col))
+		return "";
+	return PQgetvalue(result, row, col);
+}
+
+bool
+ramd_query_prepared_bool(PGconn *conn, ramd_query_stmt_t stmt, bool *value)
+{
+	PGresult *result = ramd_query_exec_prepared(conn, stmt, 0, NULL);
+	bool      found = result && ramd_query_value_present(result, 0, 0);
+
+	if (found && value)
+		*value = ramd_query_value_bool(result, 0, 0);
+	PQclear(result);
+	return found;
+}
+
+bool
+ramd_query_prepared_int64(PGconn *conn, ramd_query_stmt_t stmt, int64_t *value)
+{
+	PGresult *result = ramd_query_exec_prepared(conn, stmt, 0, NULL);
+	bool      found = result && ramd_query_value_present(result, 0, 0);
+
+	if (found && value)
+		*value = ramd_query_value_int64(result, 0, 0, 0);
+	PQclear(result);
+	return found;
+}
+
+bool
+ramd_query_prepared_double(PGconn *conn, ramd_query_stmt_t stmt, double *value)
+{
+	PGresult *result = ramd_query_exec_prepared(conn, stmt, 0, NULL);
+	bool      found = result && ramd_query_value_present(result, 0, 0);
+
+	if (found && value)
+		*value = ramd_query_value_double(result, 0, 0, 0.0);
+	PQclear(result);
+	return found;
+}
+
+char *
+ramd_query_prepared_string(PGconn *conn, ramd_query_stmt_t stmt)
+{
+	PGresult *result = ramd_query_exec_prepared(conn, stmt, 0, NULL);
+	char     *value = NULL;
+
+	if (result && ramd_query_value_present(result, 0, 0))
+		value = strdup(ramd_query_value_text(result, 0, 0));
+	PQclear(result);
+	return value;
+}
+
 bool
 ramd_query_result_ok(PGresult *result)
 {
@@ -179,6 +597,8 @@ ramd_query_get_int_value(PGresult *result, int row, int col)
 	value = ramd_query_get_string_value(result, row, col);
 	if (!value)
 		return 0;
+	if (PQfformat(result, col) == 1)
+		return (int) ramd_query_value_int64(result, row, col, 0);
 
 	return atoi(value);
 }
@@ -191,6 +611,8 @@ ramd_query_get_bool_value(PGresult *result, int row, int col)
 	value = ramd_query_get_string_value(result, row, col);
 	if (!value)
 		return false;
+	if (PQfformat(result, col) == 1)
+		return ramd_query_value_bool(result, row, col);
 
 	return (strcmp(value, "t") == 0 || strcmp(value, "true") == 0 ||
 			strcmp(value, "1") == 0 || strcmp(value, "yes") == 0);
@@ -260,30 +682,22 @@ ramd_query_get_single_bool(PGconn *conn, const char *sql)
 bool
 ramd_query_is_in_recovery(PGconn *conn)
 {
+	bool in_recovery = false;
+
 	if (!conn)
 		return false;
 
-	return ramd_query_get_single_bool(conn, "SELECT pg_is_in_recovery()");
+	ramd_query_prepared_bool(conn, RAMD_QUERY_STMT_IS_IN_RECOVERY, &in_recovery);
+	return in_recovery;
 }
 
 bool
 ramd_query_is_accepting_connections(PGconn *conn)
 {
-	PGresult *result;
-	bool      success;
-
 	if (!conn)
 		return false;
 
-	result = ramd_query_exec_with_result(conn, "SELECT 1");
-	if (result)
-	{
-		success = ramd_query_result_ok(result);
-		PQclear(result);
-		return success;
-	}
-
-	return false;
+	return ramd_query_prepared_int64(conn, RAMD_QUERY_STMT_PING, NULL);
 }
 
 char *
@@ -292,7 +706,7 @@ ramd_query_get_version(PGconn *conn)
 	if (!conn)
 		return NULL;
 
-	return ramd_query_get_single_string(conn, "SELECT version()");
+	return ramd_query_prepared_string(conn, RAMD_QUERY_STMT_VERSION);
 }
 
 char *
@@ -301,60 +715,36 @@ ramd_query_get_current_wal_lsn(PGconn *conn)
 	if (!conn)
 		return NULL;
 
-	return ramd_query_get_single_string(conn, "SELECT pg_current_wal_lsn()");
+	return ramd_query_prepared_string(conn, RAMD_QUERY_STMT_CURRENT_WAL_LSN);
 }
 
 double
 ramd_query_get_replication_lag(PGconn *conn)
 {
-	PGresult    *result;
-	double       lag = -1.0;
-	const char  *lag_str;
+	PGresult *result;
+	double    lag = -1.0;
 
 	if (!conn)
 		return lag;
 
-	result = ramd_query_exec_with_result(conn,
-		"SELECT EXTRACT(EPOCH FROM (now() - pg_last_xact_replay_timestamp()))");
-
+	/* NULL, i.e. nothing replayed yet, reads as no lag */
+	result = ramd_query_exec_prepared(conn, RAMD_QUERY_STMT_REPLICATION_LAG, 0, NULL);
 	if (result && PQntuples(result) > 0)
-	{
-		lag_str = PQgetvalue(result, 0, 0);
-		if (lag_str)
-		{
-			lag = atof(lag_str);
-		}
-	}
-
-	if (result)
-		PQclear(result);
-
+		lag = ramd_query_value_double(result, 0, 0, 0.0);
+	PQclear(result);
 	return lag;
 }
 
 bool
 ramd_query_has_active_transactions(PGconn *conn)
 {
-	PGresult *result;
-	bool      has_active = false;
-	int       active_count;
+	int64_t active_count = 0;
 
 	if (!conn)
 		return false;
 
-	result = ramd_query_exec_with_result(conn,
-		"SELECT count(*) FROM pg_stat_activity WHERE state = 'active' AND pid != pg_backend_pid()");
-
-	if (result && PQntuples(result) > 0)
-	{
-		active_count = ramd_query_get_int_value(result, 0, 0);
-		has_active = (active_count > 0);
-	}
-
-	if (result)
-		PQclear(result);
-
-	return has_active;
+	ramd_query_prepared_int64(conn, RAMD_QUERY_STMT_OTHER_ACTIVE_BACKENDS, &active_count);
+	return active_count > 0;
 }
 
 bool
@@ -0,0 +1,656 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_rebuild.c
+ *		PostgreSQL Auto-Failover Daemon - Replica Rebuild Scheduler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Every ramd can only rebuild its own data directory, so the scheduler
+ * runs at most one job per daemon and coordinates with its peers through
+ * the shared cluster view: failed standbys queue by node id, at most
+ * rebuild_max_concurrent of them copy at once, and rebuild_max_rate_kbps
+ * is split evenly between those copies.
+ *
+ * A job first tries pg_rewind, which only copies blocks that diverged.
+ * Failing that, a base backup is streamed into a staging directory next
+ * to the live one, which is swapped in only after the copy completes; an
+ * interrupted copy therefore leaves the old data directory intact for the
+ * next attempt to rewind.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+
+#include "ramd_rebuild.h"
+#include "ramd_basebackup.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_postgresql.h"
+#include "ramd_process.h"
+
+#define RAMD_REBUILD_STAGING_SUFFIX ".rebuild"
+#define RAMD_REBUILD_OLD_SUFFIX     ".old"
+
+typedef struct ramd_rebuild_scheduler_t
+{
+	pthread_mutex_t lock; /* guards everything below except cancel */
+	pthread_cond_t cond;
+	bool initialized;
+	bool thread_joinable;
+	pthread_t thread;
+	atomic_bool cancel;
+
+	ramd_config_t config; /* private copy, the job outlives config reloads */
+	ramd_cluster_t* cluster;
+	ramd_rebuild_status_t status;
+} ramd_rebuild_scheduler_t;
+
+static ramd_rebuild_scheduler_t g_rebuild = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static void
+rebuild_set_phase(const char* phase, const char* message)
+{
+	pthread_mutex_lock(&g_rebuild.lock);
+	strncpy(g_rebuild.status.phase, phase, sizeof(g_rebuild.status.phase) - 1);
+	g_rebuild.status.phase[sizeof(g_rebuild.status.phase) - 1] = '\0';
+	if (message)
+	{
+		strncpy(g_rebuild.status.message, message, sizeof(g_rebuild.status.message) - 1);
+		g_rebuild.status.message[sizeof(g_rebuild.status.message) - 1] = '\0';
+	}
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	ramd_log_info("Rebuild: %s%s%s", phase, message ? " - " : "", message ? message : "");
+}
+
+static void
+rebuild_timed_wait(int32_t ms)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += ms / 1000;
+	deadline.tv_nsec += (long) (ms % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	pthread_cond_timedwait(&g_rebuild.cond, &g_rebuild.lock, &deadline);
+}
+
+/* Failed standbys with a lower node id than ours, and all failed standbys */
+static int32_t
+rebuild_queue_position(int32_t* candidates)
+{
+	ramd_cluster_t* cluster = g_rebuild.cluster;
+	int32_t ahead = 0;
+	int32_t total = 1;
+
+	for (int32_t i = 0; cluster && i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+
+		if (node->node_id == g_rebuild.config.node_id ||
+		    node->role != RAMD_ROLE_STANDBY || node->state != RAMD_NODE_STATE_FAILED)
+			continue;
+		total++;
+		if (node->node_id < g_rebuild.config.node_id)
+			ahead++;
+	}
+
+	if (candidates)
+		*candidates = total;
+	return ahead;
+}
+
+/* Wait for a concurrency slot, then take this node's share of the bandwidth */
+static bool
+rebuild_admit(void)
+{
+	int32_t limit = g_rebuild.config.rebuild_max_concurrent;
+	int32_t candidates = 1;
+	int32_t ahead;
+	bool announced = false;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	while ((ahead = rebuild_queue_position(&candidates)) >= limit)
+	{
+		if (atomic_load(&g_rebuild.cancel))
+		{
+			pthread_mutex_unlock(&g_rebuild.lock);
+			return false;
+		}
+		g_rebuild.status.state = RAMD_REBUILD_WAITING;
+		g_rebuild.status.queue_position = ahead;
+		if (!announced)
+		{
+			ramd_log_info("Rebuild queued: %d standbys ahead, %d may run at once",
+			              ahead, limit);
+			announced = true;
+		}
+		rebuild_timed_wait(RAMD_REBUILD_POLL_INTERVAL_MS);
+	}
+
+	g_rebuild.status.state = RAMD_REBUILD_RUNNING;
+	g_rebuild.status.queue_position = 0;
+	if (g_rebuild.config.rebuild_max_rate_kbps > 0)
+	{
+		int32_t share = candidates < limit ? candidates : limit;
+		int32_t rate = g_rebuild.config.rebuild_max_rate_kbps / share;
+
+		g_rebuild.status.rate_limit_kbps =
+		    rate < RAMD_REBUILD_MIN_RATE_KBPS ? RAMD_REBUILD_MIN_RATE_KBPS : rate;
+	}
+	else
+		g_rebuild.status.rate_limit_kbps = 0;
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	return !atomic_load(&g_rebuild.cancel);
+}
+
+static bool
+rebuild_has_data_directory(const char* path)
+{
+	char version_file[RAMD_MAX_PATH_LENGTH];
+	struct stat st;
+
+	if (snprintf(version_file, sizeof(version_file), "%s/PG_VERSION", path) >=
+	    (int) sizeof(version_file))
+		return false;
+	return stat(version_file, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/* A mount point cannot be renamed, so it has to be rebuilt in place */
+static bool
+rebuild_is_mount_point(const char* path)
+{
+	char parent[RAMD_MAX_PATH_LENGTH];
+	struct stat st;
+	struct stat parent_st;
+	char* slash;
+
+	snprintf(parent, sizeof(parent), "%s", path);
+	slash = strrchr(parent, '/');
+	if (!slash)
+		snprintf(parent, sizeof(parent), ".");
+	else if (slash == parent)
+		slash[1] = '\0';
+	else
+		*slash = '\0';
+
+	if (stat(path, &st) != 0 || stat(parent, &parent_st) != 0)
+		return false;
+	return st.st_dev != parent_st.st_dev;
+}
+
+static bool
+rebuild_rewind(void)
+{
+	const ramd_config_t* config = &g_rebuild.config;
+	ramd_process_result_t result;
+	char pg_rewind[RAMD_MAX_PATH_LENGTH];
+	char conninfo[RAMD_MAX_COMMAND_LENGTH];
+	const char* argv[8];
+	int n = 0;
+
+	if (!config->rebuild_use_rewind || !rebuild_has_data_directory(config->postgresql_data_dir))
+		return false;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	g_rebuild.status.method = RAMD_REBUILD_METHOD_REWIND;
+	snprintf(conninfo, sizeof(conninfo), "host=%s port=%d dbname=%s user=%s",
+	         g_rebuild.status.source_host, g_rebuild.status.source_port,
+	         config->database_name, config->database_user);
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	rebuild_set_phase("rewinding", NULL);
+
+	if (snprintf(pg_rewind, sizeof(pg_rewind), "%s/pg_rewind", config->postgresql_bin_dir) >=
+	    (int) sizeof(pg_rewind))
+	{
+		ramd_log_error("Rebuild: postgresql_bin_dir is too long to run pg_rewind");
+		return false;
+	}
+	argv[n++] = pg_rewind;
+	argv[n++] = "--target-pgdata";
+	argv[n++] = config->postgresql_data_dir;
+	argv[n++] = "--source-server";
+	argv[n++] = conninfo;
+	argv[n++] = "--write-recovery-conf";
+	argv[n] = NULL;
+
+	if (ramd_process_run_cancellable(argv, 0, &g_rebuild.cancel, &result))
+		return true;
+
+	if (!result.cancelled)
+		ramd_process_log_failure("pg_rewind", &result);
+	return false;
+}
+
+static void
+rebuild_progress(const ramd_basebackup_progress_t* progress, void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	g_rebuild.status.bytes_total = progress->bytes_total;
+	g_rebuild.status.bytes_done = progress->bytes_done;
+	g_rebuild.status.bytes_per_second = progress->bytes_per_second;
+	g_rebuild.status.eta_seconds = progress->eta_seconds;
+	pthread_mutex_unlock(&g_rebuild.lock);
+}
+
+static bool
+rebuild_basebackup(const char* target_dir)
+{
+	const ramd_config_t* config = &g_rebuild.config;
+	ramd_basebackup_options_t options;
+	char conninfo[RAMD_MAX_COMMAND_LENGTH];
+	char label[64];
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	g_rebuild.status.method = RAMD_REBUILD_METHOD_BASEBACKUP;
+	g_rebuild.status.bytes_total = 0;
+	g_rebuild.status.bytes_done = 0;
+	g_rebuild.status.bytes_per_second = 0;
+	g_rebuild.status.eta_seconds = -1;
+	snprintf(conninfo, sizeof(conninfo), "host=%s port=%d user=%s",
+	         g_rebuild.status.source_host, g_rebuild.status.source_port,
+	         config->replication_user);
+	memset(&options, 0, sizeof(options));
+	options.max_rate_kbps = g_rebuild.status.rate_limit_kbps;
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	snprintf(label, sizeof(label), "ramd_rebuild_%d", config->node_id);
+	options.label = label;
+	options.application_name = label;
+	options.target_dir = target_dir;
+	options.format = RAMD_BASEBACKUP_PLAIN;
+	options.fast_checkpoint = true;
+	options.write_recovery_conf = true;
+	options.verify_checksums = true;
+	options.manifest = true;
+	options.cancel = &g_rebuild.cancel;
+	options.progress = rebuild_progress;
+
+	rebuild_set_phase("copying", NULL);
+	return ramd_basebackup_run(conninfo, &options, NULL) == 0;
+}
+
+/* Replace the data directory with the finished staging copy */
+static bool
+rebuild_swap(const char* data_dir, const char* staging_dir)
+{
+	char old_dir[RAMD_MAX_PATH_LENGTH];
+	bool had_data = access(data_dir, F_OK) == 0;
+
+	if (snprintf(old_dir, sizeof(old_dir), "%s" RAMD_REBUILD_OLD_SUFFIX, data_dir) >=
+	    (int) sizeof(old_dir))
+	{
+		ramd_log_error("Rebuild: %s is too long to move aside", data_dir);
+		return false;
+	}
+	ramd_process_remove_tree(old_dir);
+
+	if (had_data && rename(data_dir, old_dir) != 0)
+	{
+		ramd_log_error("Rebuild: cannot move %s aside: %s", data_dir, strerror(errno));
+		return false;
+	}
+
+	if (rename(staging_dir, data_dir) != 0)
+	{
+		ramd_log_error("Rebuild: cannot move %s into place: %s", staging_dir,
+		               strerror(errno));
+		if (had_data && rename(old_dir, data_dir) != 0)
+			ramd_log_error("Rebuild: cannot restore %s: %s", data_dir, strerror(errno));
+		return false;
+	}
+
+	if (had_data && !ramd_process_remove_tree(old_dir))
+		ramd_log_warning("Rebuild: could not remove %s", old_dir);
+	return true;
+}
+
+static bool
+rebuild_verify(void)
+{
+	const ramd_config_t* config = &g_rebuild.config;
+	PGconn* conn;
+	PGresult* res;
+	bool in_recovery = false;
+
+	rebuild_set_phase("starting", NULL);
+	if (!ramd_postgresql_start(config))
+		return false;
+
+	conn = ramd_conn_get(config->hostname, config->postgresql_port, config->database_name,
+	                     config->database_user, config->database_password);
+	if (!conn)
+		return false;
+
+	res = PQexec(conn, "SELECT pg_is_in_recovery()");
+	if (res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0)
+		in_recovery = strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+	PQclear(res);
+	ramd_conn_close(conn);
+
+	if (!in_recovery)
+		ramd_log_error("Rebuild: PostgreSQL started but is not in recovery");
+	return in_recovery;
+}
+
+static bool
+rebuild_run(void)
+{
+	const ramd_config_t* config = &g_rebuild.config;
+	char staging_dir[RAMD_MAX_PATH_LENGTH];
+	bool in_place;
+
+	if (!rebuild_admit())
+		return false;
+
+	/* The staging and old copies are siblings; refuse before anything is stopped */
+	if (strlen(config->postgresql_data_dir) + strlen(RAMD_REBUILD_STAGING_SUFFIX) >=
+	        sizeof(staging_dir) ||
+	    strlen(config->postgresql_data_dir) + strlen(RAMD_REBUILD_OLD_SUFFIX) >=
+	        sizeof(staging_dir))
+	{
+		ramd_log_error("Rebuild: data directory path is too long: %s",
+		               config->postgresql_data_dir);
+		return false;
+	}
+
+	rebuild_set_phase("stopping", NULL);
+	if (!ramd_postgresql_stop(config))
+		ramd_log_warning("Rebuild: could not stop PostgreSQL, continuing");
+
+	if (rebuild_rewind())
+		return rebuild_verify();
+	if (atomic_load(&g_rebuild.cancel))
+		return false;
+
+	in_place = rebuild_is_mount_point(config->postgresql_data_dir);
+	if (in_place)
+	{
+		/* No sibling on the same filesystem; the old copy is lost up front */
+		ramd_log_warning("Rebuild: %s is a mount point, rebuilding in place",
+		                 config->postgresql_data_dir);
+		if (!ramd_process_clear_directory(config->postgresql_data_dir))
+			return false;
+		snprintf(staging_dir, sizeof(staging_dir), "%s", config->postgresql_data_dir);
+	}
+	else
+	{
+		if (snprintf(staging_dir, sizeof(staging_dir), "%s" RAMD_REBUILD_STAGING_SUFFIX,
+		             config->postgresql_data_dir) >= (int) sizeof(staging_dir))
+		{
+			ramd_log_error("Rebuild: data directory path is too long: %s",
+			               config->postgresql_data_dir);
+			return false;
+		}
+		ramd_process_remove_tree(staging_dir);
+	}
+
+	if (!rebuild_basebackup(staging_dir))
+	{
+		if (!in_place)
+			ramd_process_remove_tree(staging_dir);
+		return false;
+	}
+
+	if (!in_place)
+	{
+		rebuild_set_phase("swapping", NULL);
+		if (!rebuild_swap(config->postgresql_data_dir, staging_dir))
+			return false;
+	}
+
+	return rebuild_verify();
+}
+
+static void*
+rebuild_thread(void* arg)
+{
+	ramd_rebuild_state_t state;
+	long elapsed;
+	bool ok;
+
+	(void) arg;
+	ok = rebuild_run();
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	if (ok)
+		g_rebuild.status.state = RAMD_REBUILD_SUCCEEDED;
+	else if (atomic_load(&g_rebuild.cancel))
+		g_rebuild.status.state = RAMD_REBUILD_CANCELLED;
+	else
+		g_rebuild.status.state = RAMD_REBUILD_FAILED;
+	g_rebuild.status.finished_at = time(NULL);
+	strncpy(g_rebuild.status.phase, "done", sizeof(g_rebuild.status.phase) - 1);
+	state = g_rebuild.status.state;
+	elapsed = (long) (g_rebuild.status.finished_at - g_rebuild.status.started_at);
+	pthread_cond_broadcast(&g_rebuild.cond);
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	ramd_log_info("Rebuild of node %d %s after %ld seconds", g_rebuild.config.node_id,
+	              ramd_rebuild_state_to_string(state), elapsed);
+	return NULL;
+}
+
+bool
+ramd_rebuild_init(const ramd_config_t* config)
+{
+	char staging_dir[RAMD_MAX_PATH_LENGTH];
+
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	g_rebuild.config = *config;
+	memset(&g_rebuild.status, 0, sizeof(g_rebuild.status));
+	g_rebuild.status.node_id = config->node_id;
+	g_rebuild.status.source_node_id = -1;
+	atomic_store(&g_rebuild.cancel, false);
+	g_rebuild.initialized = true;
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	if (snprintf(staging_dir, sizeof(staging_dir), "%s" RAMD_REBUILD_STAGING_SUFFIX,
+	             config->postgresql_data_dir) >= (int) sizeof(staging_dir))
+	{
+		ramd_log_error("Rebuild: data directory path is too long: %s; rebuilds will be refused",
+		               config->postgresql_data_dir);
+		return false;
+	}
+	if (access(staging_dir, F_OK) == 0)
+	{
+		ramd_log_info("Removing staging directory %s left by an interrupted rebuild",
+		              staging_dir);
+		ramd_process_remove_tree(staging_dir);
+	}
+	return true;
+}
+
+void
+ramd_rebuild_cleanup(void)
+{
+	ramd_rebuild_cancel();
+	ramd_rebuild_wait();
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	g_rebuild.initialized = false;
+	g_rebuild.cluster = NULL;
+	pthread_mutex_unlock(&g_rebuild.lock);
+}
+
+bool
+ramd_rebuild_start(ramd_cluster_t* cluster, int32_t source_node_id)
+{
+	ramd_node_t* source;
+	bool joinable;
+	pthread_t previous;
+
+	if (!cluster)
+		return false;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	if (!g_rebuild.initialized ||
+	    g_rebuild.status.state == RAMD_REBUILD_WAITING ||
+	    g_rebuild.status.state == RAMD_REBUILD_RUNNING)
+	{
+		pthread_mutex_unlock(&g_rebuild.lock);
+		ramd_log_warning("Rebuild not started: %s",
+		                 g_rebuild.initialized ? "a rebuild is already in progress"
+		                                       : "scheduler not initialized");
+		return false;
+	}
+
+	source = ramd_cluster_find_node(cluster, source_node_id);
+	if (!source || source_node_id == g_rebuild.config.node_id)
+	{
+		pthread_mutex_unlock(&g_rebuild.lock);
+		ramd_log_error("Rebuild not started: invalid source node %d", source_node_id);
+		return false;
+	}
+
+	/* Reap the previous job before reusing the slot */
+	joinable = g_rebuild.thread_joinable;
+	previous = g_rebuild.thread;
+	g_rebuild.thread_joinable = false;
+	pthread_mutex_unlock(&g_rebuild.lock);
+	if (joinable)
+		pthread_join(previous, NULL);
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	memset(&g_rebuild.status, 0, sizeof(g_rebuild.status));
+	g_rebuild.status.state = RAMD_REBUILD_WAITING;
+	g_rebuild.status.node_id = g_rebuild.config.node_id;
+	g_rebuild.status.source_node_id = source_node_id;
+	snprintf(g_rebuild.status.source_host, sizeof(g_rebuild.status.source_host), "%s",
+	         source->hostname);
+	g_rebuild.status.source_port = source->postgresql_port;
+	snprintf(g_rebuild.status.phase, sizeof(g_rebuild.status.phase), "queued");
+	g_rebuild.status.started_at = time(NULL);
+	g_rebuild.cluster = cluster;
+	atomic_store(&g_rebuild.cancel, false);
+
+	if (pthread_create(&g_rebuild.thread, NULL, rebuild_thread, NULL) != 0)
+	{
+		g_rebuild.status.state = RAMD_REBUILD_FAILED;
+		snprintf(g_rebuild.status.message, sizeof(g_rebuild.status.message),
+		         "failed to create rebuild thread");
+		pthread_mutex_unlock(&g_rebuild.lock);
+		ramd_log_error("Rebuild not started: failed to create thread");
+		return false;
+	}
+	g_rebuild.thread_joinable = true;
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	ramd_log_info("Rebuild of node %d from node %d (%s:%d) scheduled",
+	              g_rebuild.config.node_id, source_node_id, source->hostname,
+	              source->postgresql_port);
+	return true;
+}
+
+bool
+ramd_rebuild_cancel(void)
+{
+	bool active;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	active = g_rebuild.status.state == RAMD_REBUILD_WAITING ||
+	         g_rebuild.status.state == RAMD_REBUILD_RUNNING;
+	if (active)
+	{
+		atomic_store(&g_rebuild.cancel, true);
+		pthread_cond_broadcast(&g_rebuild.cond);
+	}
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	if (active)
+		ramd_log_info("Rebuild cancellation requested");
+	return active;
+}
+
+bool
+ramd_rebuild_wait(void)
+{
+	bool joinable;
+	pthread_t thread;
+	bool ok;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	joinable = g_rebuild.thread_joinable;
+	thread = g_rebuild.thread;
+	g_rebuild.thread_joinable = false;
+	pthread_mutex_unlock(&g_rebuild.lock);
+
+	if (joinable)
+		pthread_join(thread, NULL);
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	ok = g_rebuild.status.state == RAMD_REBUILD_SUCCEEDED;
+	pthread_mutex_unlock(&g_rebuild.lock);
+	return ok;
+}
+
+void
+ramd_rebuild_get_status(ramd_rebuild_status_t* status)
+{
+	if (!status)
+		return;
+
+	pthread_mutex_lock(&g_rebuild.lock);
+	*status = g_rebuild.status;
+	pthread_mutex_unlock(&g_rebuild.lock);
+}
+
+const char*
+ramd_rebuild_state_to_string(ramd_rebuild_state_t state)
+{
+	switch (state)
+	{
+		case RAMD_REBUILD_IDLE:
+			return "idle";
+		case RAMD_REBUILD_WAITING:
+			return "waiting";
+		case RAMD_REBUILD_RUNNING:
+			return "running";
+		case RAMD_REBUILD_SUCCEEDED:
+			return "succeeded";
+		case RAMD_REBUILD_FAILED:
+			return "failed";
+		case RAMD_REBUILD_CANCELLED:
+			return "cancelled";
+	}
+	return "unknown";
+}
+
+const char*
+ramd_rebuild_method_to_string(ramd_rebuild_method_t method)
+{
+	switch (method)
+	{
+		case RAMD_REBUILD_METHOD_NONE:
+			return "none";
+		case RAMD_REBUILD_METHOD_REWIND:
+			return "pg_rewind";
+		case RAMD_REBUILD_METHOD_BASEBACKUP:
+			return "pg_basebackup";
+	}
+	return "unknown";
+}
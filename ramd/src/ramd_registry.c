@@ -0,0 +1,621 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_registry.c
+ *		PostgreSQL Auto-Failover Daemon - Cluster Registry in pgraft
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Each daemon learns about the others by probing them, which grows with
+ * the square of the cluster.  pgraft's key-value store gives every daemon
+ * the same view for the cost of one watch on its local node.  Under
+ * /ramd/<cluster_name>/ the registry keeps:
+ *
+ *   nodes/<node_id>        this daemon, on a lease it keeps alive
+ *   maintenance/<node_id>  nodes put into maintenance through this daemon
+ *   failover               the last failover decision, written by CAS
+ *
+ * A lease outlives a dead daemon by at most RAMD_REGISTRY_LEASE_TTL_MS,
+ * after which the leader revokes it and the daemon's keys go with it.
+ * The thread reads the prefix once, then watches from the revision it
+ * read at, so it never polls; a change made by another daemon wakes the
+ * monitor.  When the watch falls behind pgraft's history it reads the
+ * prefix again.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_registry.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_pgraft.h"
+
+typedef struct ramd_registry_t
+{
+	pthread_mutex_t lock; /* guards everything below but conn */
+	pthread_cond_t cond;  /* wakes the retry wait */
+	bool running;
+	pthread_t thread;
+	ramd_monitor_t* monitor;
+	const ramd_config_t* config;
+	PGconn* conn;         /* the registry thread's alone */
+	PGcancel* cancel;     /* for conn, so stop need not wait out a watch */
+	char prefix[RAMD_REGISTRY_KEY_LENGTH];
+
+	/* Writes for the thread to make: +1 set, -1 clear, 0 nothing */
+	int8_t maintenance_pending[RAMD_MAX_NODES];
+	bool failover_pending;
+	int32_t failover_failed_node_id;
+	int32_t failover_new_primary_node_id;
+
+	/* The cluster as read from the store */
+	bool synced;
+	long long revision;
+	long long lease;
+	long long failover_revision; /* mod_revision of failover, 0 if absent */
+	bool registered[RAMD_MAX_NODES];
+	bool in_maintenance[RAMD_MAX_NODES];
+	int64_t events;
+	int64_t resyncs;
+} ramd_registry_t;
+
+static ramd_registry_t g_registry = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+ramd_registry_disconnect(void)
+{
+	pthread_mutex_lock(&g_registry.lock);
+	if (g_registry.cancel)
+		PQfreeCancel(g_registry.cancel);
+	g_registry.cancel = NULL;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (g_registry.conn)
+		PQfinish(g_registry.conn);
+	g_registry.conn = NULL;
+}
+
+static bool
+ramd_registry_ensure_connection(void)
+{
+	const ramd_config_t* config = g_registry.config;
+	const char* keywords[8];
+	const char* values[8];
+	char port[16];
+	char timeout[16];
+	int n = 0;
+
+	if (g_registry.conn && PQstatus(g_registry.conn) == CONNECTION_OK)
+		return true;
+
+	ramd_registry_disconnect();
+
+	snprintf(port, sizeof(port), "%d", config->postgresql_port);
+	snprintf(timeout, sizeof(timeout), "%d", RAMD_DEFAULT_CONNECTION_TIMEOUT);
+
+	keywords[n] = "host";            values[n++] = config->hostname;
+	keywords[n] = "port";            values[n++] = port;
+	keywords[n] = "dbname";          values[n++] = config->database_name;
+	keywords[n] = "user";            values[n++] = config->database_user;
+	if (config->database_password[0] != '\0')
+	{
+		keywords[n] = "password";    values[n++] = config->database_password;
+	}
+	keywords[n] = "connect_timeout"; values[n++] = timeout;
+	keywords[n] = "application_name"; values[n++] = "ramd_registry";
+	keywords[n] = NULL;              values[n] = NULL;
+
+	g_registry.conn = PQconnectdbParams(keywords, values, 0);
+	if (PQstatus(g_registry.conn) != CONNECTION_OK)
+	{
+		ramd_log_debug("Registry: cannot connect to %s:%d: %s", config->hostname,
+		               config->postgresql_port, PQerrorMessage(g_registry.conn));
+		PQfinish(g_registry.conn);
+		g_registry.conn = NULL;
+		return false;
+	}
+
+	pthread_mutex_lock(&g_registry.lock);
+	g_registry.cancel = PQgetCancel(g_registry.conn);
+	pthread_mutex_unlock(&g_registry.lock);
+	return true;
+}
+
+/* Sleep RAMD_REGISTRY_RETRY_MS unless stopped first; lock held */
+static void
+ramd_registry_retry_wait(void)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += RAMD_REGISTRY_RETRY_MS / 1000;
+	deadline.tv_nsec += (long) (RAMD_REGISTRY_RETRY_MS % 1000) * 1000000L;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+	if (g_registry.running)
+		pthread_cond_timedwait(&g_registry.cond, &g_registry.lock, &deadline);
+}
+
+/* node_id from "<dir>/<node_id>" under the prefix, -1 if key is not that */
+static int32_t
+ramd_registry_key_node(const char* key, const char* dir)
+{
+	size_t len = strlen(dir);
+	char* end;
+	long id;
+
+	if (strncmp(key, dir, len) != 0 || key[len] != '/')
+		return -1;
+	id = strtol(key + len + 1, &end, 10);
+	if (*end != '\0' || id <= 0 || id > RAMD_MAX_NODES)
+		return -1;
+	return (int32_t) id;
+}
+
+/* Fold an entry or change into the cached view; lock not held */
+static void
+ramd_registry_apply(const ramd_pgraft_kv_event_t* event, void* arg)
+{
+	bool* woken = arg;
+	const char* key = event->key;
+	size_t prefix_len = strlen(g_registry.prefix);
+	int32_t node_id;
+	bool other = false;
+
+	if (strncmp(key, g_registry.prefix, prefix_len) != 0)
+		return;
+	key += prefix_len;
+
+	pthread_mutex_lock(&g_registry.lock);
+	if ((node_id = ramd_registry_key_node(key, "nodes")) > 0)
+	{
+		g_registry.registered[node_id - 1] = !event->deleted;
+		other = node_id != g_registry.config->node_id;
+	}
+	else if ((node_id = ramd_registry_key_node(key, "maintenance")) > 0)
+	{
+		/* Flags we set ourselves are not news to the monitor */
+		other = g_registry.in_maintenance[node_id - 1] == event->deleted &&
+		        g_registry.maintenance_pending[node_id - 1] == 0;
+		g_registry.in_maintenance[node_id - 1] = !event->deleted;
+	}
+	else if (strcmp(key, "failover") == 0)
+	{
+		g_registry.failover_revision = event->deleted ? 0 : event->revision;
+		other = true;
+	}
+	if (g_registry.synced)
+		g_registry.events++;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (other && woken)
+		*woken = true;
+}
+
+/* Lease and registration; a fresh lease whenever the old one expired */
+static bool
+ramd_registry_keep_registered(int64_t* keepalive_ms)
+{
+	const ramd_config_t* config = g_registry.config;
+	char key[RAMD_REGISTRY_KEY_LENGTH];
+	char value[RAMD_REGISTRY_VALUE_LENGTH];
+	long long lease;
+	long long revision;
+	bool alive = false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	lease = g_registry.lease;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (lease > 0)
+	{
+		if (ramd_clock_now_ms() - *keepalive_ms < RAMD_REGISTRY_LEASE_TTL_MS / 3)
+			return true;
+		if (ramd_pgraft_kv_lease_keepalive(g_registry.conn, lease, &alive) !=
+		    RAMD_PGRAFT_SUCCESS)
+			return false;
+		if (alive)
+		{
+			*keepalive_ms = ramd_clock_now_ms();
+			return true;
+		}
+		ramd_log_warning("Registry: lease %lld expired; registering again", lease);
+	}
+
+	if (ramd_pgraft_kv_lease_grant(g_registry.conn, RAMD_REGISTRY_LEASE_TTL_MS, &lease) !=
+	    RAMD_PGRAFT_SUCCESS)
+		return false;
+
+	if (!ramd_registry_make_key(key, sizeof(key), g_registry.prefix, "nodes", config->node_id))
+	{
+		ramd_log_error("Registry: key for node %d does not fit under %s", config->node_id,
+		               g_registry.prefix);
+		return false;
+	}
+	snprintf(value, sizeof(value),
+	         "{\"node_id\":%d,\"hostname\":\"%s\",\"postgresql_port\":%d,\"http_port\":%d}",
+	         config->node_id, config->hostname, config->postgresql_port, config->http_port);
+	if (ramd_pgraft_kv_put(g_registry.conn, key, value, -1, lease, &revision) !=
+	    RAMD_PGRAFT_SUCCESS)
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	g_registry.lease = lease;
+	/* The old lease took our maintenance flags with it */
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		if (g_registry.in_maintenance[i] && g_registry.maintenance_pending[i] == 0)
+			g_registry.maintenance_pending[i] = 1;
+	}
+	pthread_mutex_unlock(&g_registry.lock);
+
+	*keepalive_ms = ramd_clock_now_ms();
+	ramd_log_info("Registry: registered node %d under %s on lease %lld", config->node_id,
+	              g_registry.prefix, lease);
+	return true;
+}
+
+/* Make the writes other threads asked for; lock not held */
+static bool
+ramd_registry_publish(void)
+{
+	char key[RAMD_REGISTRY_KEY_LENGTH];
+	char value[RAMD_REGISTRY_VALUE_LENGTH];
+	long long revision;
+	long long lease;
+	long long expected;
+	int32_t failed;
+	int32_t new_primary;
+	int8_t pending;
+	int rc;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		pthread_mutex_lock(&g_registry.lock);
+		pending = g_registry.maintenance_pending[i];
+		lease = g_registry.lease;
+		pthread_mutex_unlock(&g_registry.lock);
+		if (pending == 0)
+			continue;
+
+		if (!ramd_registry_make_key(key, sizeof(key), g_registry.prefix, "maintenance", i + 1))
+		{
+			ramd_log_error("Registry: maintenance key for node %d does not fit under %s",
+			               i + 1, g_registry.prefix);
+			return false;
+		}
+		if (pending > 0)
+		{
+			snprintf(value, sizeof(value), "{\"node_id\":%d,\"by\":%d}", i + 1,
+			         g_registry.config->node_id);
+			rc = ramd_pgraft_kv_put(g_registry.conn, key, value, -1, lease, &revision);
+		}
+		else
+			rc = ramd_pgraft_kv_delete(g_registry.conn, key, false, &revision);
+		if (rc != RAMD_PGRAFT_SUCCESS)
+			return false;
+
+		pthread_mutex_lock(&g_registry.lock);
+		if (g_registry.maintenance_pending[i] == pending)
+			g_registry.maintenance_pending[i] = 0;
+		pthread_mutex_unlock(&g_registry.lock);
+	}
+
+	pthread_mutex_lock(&g_registry.lock);
+	if (!g_registry.failover_pending)
+	{
+		pthread_mutex_unlock(&g_registry.lock);
+		return true;
+	}
+	failed = g_registry.failover_failed_node_id;
+	new_primary = g_registry.failover_new_primary_node_id;
+	expected = g_registry.failover_revision;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (!ramd_registry_make_key(key, sizeof(key), g_registry.prefix, "failover", 0))
+	{
+		ramd_log_error("Registry: failover key does not fit under %s", g_registry.prefix);
+		return false;
+	}
+	snprintf(value, sizeof(value),
+	         "{\"failed_node_id\":%d,\"new_primary_node_id\":%d,\"by\":%d,\"at_ms\":%lld}",
+	         failed, new_primary, g_registry.config->node_id,
+	         (long long) ramd_clock_wall_ms(ramd_clock_now_ms()));
+	if (ramd_pgraft_kv_put(g_registry.conn, key, value, expected, 0, &revision) !=
+	    RAMD_PGRAFT_SUCCESS)
+		return false;
+
+	if (revision == 0)
+		ramd_log_warning("Registry: another daemon recorded a failover since revision %lld; "
+		                 "node %d -> %d not recorded", expected, failed, new_primary);
+	else
+		ramd_log_info("Registry: recorded failover of node %d to node %d at revision %lld",
+		              failed, new_primary, revision);
+
+	pthread_mutex_lock(&g_registry.lock);
+	if (g_registry.failover_failed_node_id == failed &&
+	    g_registry.failover_new_primary_node_id == new_primary)
+		g_registry.failover_pending = false;
+	pthread_mutex_unlock(&g_registry.lock);
+	return true;
+}
+
+/* Read the whole prefix afresh, then watch from the revision read at */
+static bool
+ramd_registry_sync(void)
+{
+	long long revision = 0;
+
+	pthread_mutex_lock(&g_registry.lock);
+	memset(g_registry.registered, 0, sizeof(g_registry.registered));
+	memset(g_registry.in_maintenance, 0, sizeof(g_registry.in_maintenance));
+	g_registry.failover_revision = 0;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (ramd_pgraft_kv_get_prefix(g_registry.conn, g_registry.prefix, &revision,
+	                              ramd_registry_apply, NULL) != RAMD_PGRAFT_SUCCESS)
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	g_registry.revision = revision;
+	g_registry.synced = true;
+	pthread_mutex_unlock(&g_registry.lock);
+	return true;
+}
+
+static bool
+ramd_registry_cycle(int64_t* keepalive_ms)
+{
+	long long revision;
+	bool compacted = false;
+	bool woken = false;
+	bool synced;
+	int wait_ms;
+
+	if (!ramd_registry_keep_registered(keepalive_ms) || !ramd_registry_publish())
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	synced = g_registry.synced;
+	revision = g_registry.revision;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (!synced)
+		return ramd_registry_sync();
+
+	/* Back in time for the next keepalive */
+	wait_ms = RAMD_REGISTRY_LEASE_TTL_MS / 3 - (int) (ramd_clock_now_ms() - *keepalive_ms);
+	if (ramd_pgraft_kv_watch(g_registry.conn, g_registry.prefix, &revision,
+	                         wait_ms > 100 ? wait_ms : 100, ramd_registry_apply, &woken,
+	                         &compacted) != RAMD_PGRAFT_SUCCESS)
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	if (compacted)
+	{
+		ramd_log_warning("Registry: watch fell behind at revision %lld; reading %s again",
+		                 revision, g_registry.prefix);
+		g_registry.synced = false;
+		g_registry.resyncs++;
+	}
+	g_registry.revision = revision;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (woken)
+		ramd_monitor_wake(g_registry.monitor);
+	return true;
+}
+
+static void*
+ramd_registry_thread_main(void* arg)
+{
+	int64_t keepalive_ms = 0;
+	long long lease;
+	bool failing = false;
+
+	(void) arg;
+
+	pthread_mutex_lock(&g_registry.lock);
+	while (g_registry.running)
+	{
+		bool ok = false;
+
+		pthread_mutex_unlock(&g_registry.lock);
+		if (ramd_registry_ensure_connection())
+			ok = ramd_registry_cycle(&keepalive_ms);
+		pthread_mutex_lock(&g_registry.lock);
+
+		if (!g_registry.running)
+			break;
+
+		if (!ok)
+		{
+			if (!failing)
+				ramd_log_warning("Registry: %s; cluster changes will wait for the next "
+				                 "monitor cycle", ramd_pgraft_get_last_error());
+			failing = true;
+			/* What happened meanwhile is unknown; start over from a full read */
+			g_registry.synced = false;
+			if (g_registry.conn && PQstatus(g_registry.conn) != CONNECTION_OK)
+			{
+				pthread_mutex_unlock(&g_registry.lock);
+				ramd_registry_disconnect();
+				pthread_mutex_lock(&g_registry.lock);
+			}
+			ramd_registry_retry_wait();
+			continue;
+		}
+
+		if (failing)
+			ramd_log_info("Registry: watching %s on the local node", g_registry.prefix);
+		failing = false;
+	}
+	/* Leave at once rather than a lease TTL later; the TTL covers a failure */
+	lease = g_registry.lease;
+	g_registry.lease = 0;
+	g_registry.synced = false;
+	pthread_mutex_unlock(&g_registry.lock);
+
+	if (lease > 0 && g_registry.conn && PQstatus(g_registry.conn) == CONNECTION_OK)
+		(void) ramd_pgraft_kv_lease_revoke(g_registry.conn, lease);
+
+	ramd_registry_disconnect();
+	return NULL;
+}
+
+bool
+ramd_registry_make_prefix(char* prefix, size_t size, const char* cluster_name)
+{
+	int length;
+
+	if (!prefix || !cluster_name || cluster_name[0] == '\0' || strchr(cluster_name, '/'))
+		return false;
+
+	length = snprintf(prefix, size, "/ramd/%s/", cluster_name);
+	return length >= 0 && (size_t) length < size;
+}
+
+bool
+ramd_registry_make_key(char* key, size_t size, const char* prefix, const char* leaf, int32_t id)
+{
+	int length;
+
+	if (!key || !prefix || !leaf)
+		return false;
+
+	if (id > 0)
+		length = snprintf(key, size, "%s%s/%d", prefix, leaf, id);
+	else
+		length = snprintf(key, size, "%s%s", prefix, leaf);
+	return length >= 0 && (size_t) length < size;
+}
+
+bool
+ramd_registry_start(ramd_monitor_t* monitor, const ramd_config_t* config)
+{
+	char probe[RAMD_REGISTRY_KEY_LENGTH];
+
+	if (!monitor || !config)
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	if (g_registry.running)
+	{
+		pthread_mutex_unlock(&g_registry.lock);
+		return true;
+	}
+	/* The longest key the registry writes has to fit as well */
+	if (!ramd_registry_make_prefix(g_registry.prefix, sizeof(g_registry.prefix),
+	                               config->cluster_name) ||
+	    !ramd_registry_make_key(probe, sizeof(probe), g_registry.prefix, "maintenance",
+	                            RAMD_MAX_NODES))
+	{
+		pthread_mutex_unlock(&g_registry.lock);
+		ramd_log_error("Registry: cluster_name \"%s\" is empty, holds a '/' or is too long "
+		               "for a registry key", config->cluster_name);
+		return false;
+	}
+	g_registry.monitor = monitor;
+	g_registry.config = config;
+	g_registry.running = true;
+	if (pthread_create(&g_registry.thread, NULL, ramd_registry_thread_main, NULL) != 0)
+	{
+		g_registry.running = false;
+		pthread_mutex_unlock(&g_registry.lock);
+		ramd_log_error("Registry: failed to create thread");
+		return false;
+	}
+	pthread_mutex_unlock(&g_registry.lock);
+
+	ramd_log_info("Cluster registry started under %s", g_registry.prefix);
+	return true;
+}
+
+void
+ramd_registry_stop(void)
+{
+	char errbuf[256];
+
+	pthread_mutex_lock(&g_registry.lock);
+	if (!g_registry.running)
+	{
+		pthread_mutex_unlock(&g_registry.lock);
+		return;
+	}
+	g_registry.running = false;
+	/* Cut the watch short; the thread sees the error and exits */
+	if (g_registry.cancel)
+		(void) PQcancel(g_registry.cancel, errbuf, sizeof(errbuf));
+	pthread_cond_broadcast(&g_registry.cond);
+	pthread_mutex_unlock(&g_registry.lock);
+
+	pthread_join(g_registry.thread, NULL);
+}
+
+void
+ramd_registry_note_maintenance(int32_t node_id, bool in_maintenance)
+{
+	if (node_id <= 0 || node_id > RAMD_MAX_NODES)
+		return;
+
+	pthread_mutex_lock(&g_registry.lock);
+	g_registry.maintenance_pending[node_id - 1] = in_maintenance ? 1 : -1;
+	g_registry.in_maintenance[node_id - 1] = in_maintenance;
+	pthread_mutex_unlock(&g_registry.lock);
+}
+
+void
+ramd_registry_note_failover(int32_t failed_node_id, int32_t new_primary_node_id)
+{
+	pthread_mutex_lock(&g_registry.lock);
+	g_registry.failover_pending = true;
+	g_registry.failover_failed_node_id = failed_node_id;
+	g_registry.failover_new_primary_node_id = new_primary_node_id;
+	pthread_mutex_unlock(&g_registry.lock);
+}
+
+bool
+ramd_registry_node_in_maintenance(int32_t node_id)
+{
+	bool in_maintenance;
+
+	if (node_id <= 0 || node_id > RAMD_MAX_NODES)
+		return false;
+
+	pthread_mutex_lock(&g_registry.lock);
+	in_maintenance = g_registry.in_maintenance[node_id - 1];
+	pthread_mutex_unlock(&g_registry.lock);
+	return in_maintenance;
+}
+
+void
+ramd_registry_get_status(ramd_registry_status_t* status)
+{
+	if (!status)
+		return;
+
+	memset(status, 0, sizeof(*status));
+	pthread_mutex_lock(&g_registry.lock);
+	status->synced = g_registry.synced;
+	status->revision = g_registry.revision;
+	status->lease = g_registry.lease;
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+		status->registered_nodes += g_registry.registered[i] ? 1 : 0;
+	status->events = g_registry.events;
+	status->resyncs = g_registry.resyncs;
+	pthread_mutex_unlock(&g_registry.lock);
+}
@@ -0,0 +1,1291 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_remote_write.c
+ *		PostgreSQL Auto-Failover Daemon - Prometheus Remote Write Exporter
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Push mode for clusters that Prometheus cannot scrape.  Every
+ * remote_write_interval_ms the exporter takes the expositions the
+ * collector already keeps rendered for /metrics and /prometheus, turns
+ * each series into a protobuf TimeSeries stamped with the time the
+ * snapshot was rendered, and queues the result as one batch.  A snapshot
+ * the collector has not replaced since the last round is skipped, so no
+ * sample is ever sent twice.  Series are labelled job="ramd", instance
+ * and cluster unless they carry those labels already.
+ *
+ * Batches leave oldest first, as many per WriteRequest as fit in
+ * RAMD_REMOTE_WRITE_MAX_REQUEST, snappy-compressed and POSTed over
+ * HTTP/1.1 or TLS.  A network error, 5xx or 429 keeps them queued and
+ * backs off exponentially with jitter; any other 4xx means the receiver
+ * will never take them and they are dropped.  The queue is bounded by
+ * remote_write_queue_kb: "oldest" discards the head to make room,
+ * "newest" refuses the batch that does not fit.
+ *
+ * WriteRequest, TimeSeries, Label and Sample are encoded by hand, and the
+ * snappy block format is written here too; neither is worth a library for
+ * four message types and a compressor.  Only the exporter's thread
+ * touches the queue, so the lock guards just the counters.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "ramd_remote_write.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_memory.h"
+#include "ramd_prometheus.h"
+
+#define RAMD_REMOTE_WRITE_LINE_MAX 16384
+
+typedef struct ramd_remote_write_batch_t
+{
+	struct ramd_remote_write_batch_t* next;
+	int64_t samples;
+	size_t length;
+	uint8_t data[];          /* encoded WriteRequest.timeseries entries */
+} ramd_remote_write_batch_t;
+
+typedef struct ramd_remote_write_label_t
+{
+	const char* name;
+	size_t name_length;
+	const char* value;
+	size_t value_length;
+} ramd_remote_write_label_t;
+
+/* Scratch for turning one exposition line into one TimeSeries */
+typedef struct ramd_remote_write_scratch_t
+{
+	char line[RAMD_REMOTE_WRITE_LINE_MAX];
+	uint8_t series[RAMD_REMOTE_WRITE_LINE_MAX * 2];
+	ramd_remote_write_label_t labels[RAMD_REMOTE_WRITE_MAX_LABELS];
+	char instance[RAMD_MAX_HOSTNAME_LENGTH + 16];
+	uint64_t* seen;          /* hashes of the series in this round */
+	size_t seen_size;        /* a power of two */
+} ramd_remote_write_scratch_t;
+
+typedef struct ramd_remote_write_t
+{
+	pthread_mutex_t lock;    /* guards running and stats */
+	pthread_cond_t cond;     /* wakes the exporter to stop */
+	bool running;
+	pthread_t thread;
+	const ramd_config_t* config;
+	bool tls;
+	char host[RAMD_MAX_HOSTNAME_LENGTH];
+	char port[8];
+	char host_header[RAMD_MAX_HOSTNAME_LENGTH + 8];
+	char path[RAMD_MAX_PATH_LENGTH];
+	SSL_CTX* ssl_ctx;
+	ramd_remote_write_batch_t* head;
+	ramd_remote_write_batch_t* tail;
+	int64_t last_rendered_ms[RAMD_PROMETHEUS_EXPOSITION_COUNT];
+	int64_t backoff_ms;
+	uint32_t jitter;
+	ramd_remote_write_stats_t stats;
+} ramd_remote_write_t;
+
+static ramd_remote_write_t g_remote_write = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+/* Snappy */
+
+#define RAMD_SNAPPY_BLOCK 65536
+#define RAMD_SNAPPY_HASH_BITS 14
+
+static inline uint32_t
+ramd_snappy_load32(const uint8_t* p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t
+ramd_snappy_hash(uint32_t v)
+{
+	return (v * 0x1e35a7bdU) >> (32 - RAMD_SNAPPY_HASH_BITS);
+}
+
+static uint8_t*
+ramd_snappy_emit_literal(uint8_t* op, const uint8_t* literal, size_t length)
+{
+	size_t n = length - 1;
+
+	if (n < 60)
+		*op++ = (uint8_t) (n << 2);
+	else if (n < 256)
+	{
+		*op++ = 60 << 2;
+		*op++ = (uint8_t) n;
+	}
+	else
+	{
+		/* a literal never spans a block, so two bytes always do */
+		*op++ = 61 << 2;
+		*op++ = (uint8_t) n;
+		*op++ = (uint8_t) (n >> 8);
+	}
+	memcpy(op, literal, length);
+	return op + length;
+}
+
+static uint8_t*
+ramd_snappy_emit_copy_upto64(uint8_t* op, size_t offset, size_t length)
+{
+	if (length < 12 && offset < 2048)
+	{
+		*op++ = (uint8_t) (1 | ((length - 4) << 2) | ((offset >> 8) << 5));
+		*op++ = (uint8_t) offset;
+	}
+	else
+	{
+		*op++ = (uint8_t) (2 | ((length - 1) << 2));
+		*op++ = (uint8_t) offset;
+		*op++ = (uint8_t) (offset >> 8);
+	}
+	return op;
+}
+
+static uint8_t*
+ramd_snappy_emit_copy(uint8_t* op, size_t offset, size_t length)
+{
+	/* Split so that no piece is shorter than the four bytes a copy needs */
+	while (length >= 68)
+	{
+		op = ramd_snappy_emit_copy_upto64(op, offset, 64);
+		length -= 64;
+	}
+	if (length > 64)
+	{
+		op = ramd_snappy_emit_copy_upto64(op, offset, 60);
+		length -= 60;
+	}
+	return ramd_snappy_emit_copy_upto64(op, offset, length);
+}
+
+/* One block of at most RAMD_SNAPPY_BLOCK bytes; copies never reach outside it */
+static uint8_t*
+ramd_snappy_compress_block(const uint8_t* input, size_t length, uint8_t* op, uint16_t* table)
+{
+	size_t ip = 1;
+	size_t next_emit = 0;
+	size_t limit;
+
+	if (length < 16)
+		goto emit_remainder;
+
+	memset(table, 0, sizeof(uint16_t) << RAMD_SNAPPY_HASH_BITS);
+	limit = length - 15;
+
+	while (ip < limit)
+	{
+		uint32_t skip = 32;
+		size_t candidate;
+		size_t matched;
+
+		/* Look further apart the longer nothing matches */
+		for (;;)
+		{
+			uint32_t h = ramd_snappy_hash(ramd_snappy_load32(input + ip));
+
+			candidate = table[h];
+			table[h] = (uint16_t) ip;
+			if (candidate < ip &&
+			    ramd_snappy_load32(input + candidate) == ramd_snappy_load32(input + ip))
+				break;
+			ip += skip++ >> 5;
+			if (ip >= limit)
+				goto emit_remainder;
+		}
+
+		if (ip > next_emit)
+			op = ramd_snappy_emit_literal(op, input + next_emit, ip - next_emit);
+
+		matched = 4;
+		while (ip + matched < length && input[candidate + matched] == input[ip + matched])
+			matched++;
+		op = ramd_snappy_emit_copy(op, ip - candidate, matched);
+		ip += matched;
+		next_emit = ip;
+		if (ip >= limit)
+			break;
+		table[ramd_snappy_hash(ramd_snappy_load32(input + ip - 1))] = (uint16_t) (ip - 1);
+	}
+
+emit_remainder:
+	if (next_emit < length)
+		op = ramd_snappy_emit_literal(op, input + next_emit, length - next_emit);
+	return op;
+}
+
+size_t
+ramd_snappy_max_compressed_length(size_t length)
+{
+	return 32 + length + length / 6;
+}
+
+size_t
+ramd_snappy_compress(const uint8_t* input, size_t length, uint8_t* output)
+{
+	uint16_t table[1 << RAMD_SNAPPY_HASH_BITS];
+	uint8_t* op = output;
+	size_t v = length;
+
+	while (v >= 0x80)
+	{
+		*op++ = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	*op++ = (uint8_t) v;
+
+	for (size_t pos = 0; pos < length; pos += RAMD_SNAPPY_BLOCK)
+	{
+		size_t n = length - pos < RAMD_SNAPPY_BLOCK ? length - pos : RAMD_SNAPPY_BLOCK;
+
+		op = ramd_snappy_compress_block(input + pos, n, op, table);
+	}
+	return (size_t) (op - output);
+}
+
+/* Protobuf */
+
+static size_t
+ramd_remote_write_varint_size(uint64_t v)
+{
+	size_t n = 1;
+
+	while (v >= 0x80)
+	{
+		v >>= 7;
+		n++;
+	}
+	return n;
+}
+
+static uint8_t*
+ramd_remote_write_put_varint(uint8_t* p, uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		*p++ = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (uint8_t) v;
+	return p;
+}
+
+/* Length-delimited field: tag, length, bytes */
+static uint8_t*
+ramd_remote_write_put_bytes(uint8_t* p, uint8_t tag, const void* data, size_t length)
+{
+	*p++ = tag;
+	p = ramd_remote_write_put_varint(p, length);
+	memcpy(p, data, length);
+	return p + length;
+}
+
+static size_t
+ramd_remote_write_label_size(const ramd_remote_write_label_t* label)
+{
+	return 1 + ramd_remote_write_varint_size(label->name_length) + label->name_length +
+	       1 + ramd_remote_write_varint_size(label->value_length) + label->value_length;
+}
+
+/*
+ * WriteRequest field 1, a TimeSeries: Label{name = 1, value = 2} as field
+ * 1 and one Sample{double value = 1, int64 timestamp = 2} as field 2.
+ * Returns the bytes written, 0 if they do not fit.
+ */
+static size_t
+ramd_remote_write_encode_series(const ramd_remote_write_label_t* labels, int32_t count,
+                                double value, int64_t timestamp_ms, uint8_t* out, size_t size)
+{
+	size_t sample_size = 1 + 8 + 1 + ramd_remote_write_varint_size((uint64_t) timestamp_ms);
+	size_t series_size = 1 + ramd_remote_write_varint_size(sample_size) + sample_size;
+	uint64_t bits;
+	uint8_t* p = out;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		size_t label_size = ramd_remote_write_label_size(&labels[i]);
+
+		series_size += 1 + ramd_remote_write_varint_size(label_size) + label_size;
+	}
+	if (1 + ramd_remote_write_varint_size(series_size) + series_size > size)
+		return 0;
+
+	*p++ = 0x0a;
+	p = ramd_remote_write_put_varint(p, series_size);
+	for (int32_t i = 0; i < count; i++)
+	{
+		*p++ = 0x0a;
+		p = ramd_remote_write_put_varint(p, ramd_remote_write_label_size(&labels[i]));
+		p = ramd_remote_write_put_bytes(p, 0x0a, labels[i].name, labels[i].name_length);
+		p = ramd_remote_write_put_bytes(p, 0x12, labels[i].value, labels[i].value_length);
+	}
+	*p++ = 0x12;
+	p = ramd_remote_write_put_varint(p, sample_size);
+	*p++ = 0x09;
+	memcpy(&bits, &value, sizeof(bits));
+	for (int i = 0; i < 8; i++)
+		*p++ = (uint8_t) (bits >> (8 * i));
+	*p++ = 0x10;
+	p = ramd_remote_write_put_varint(p, (uint64_t) timestamp_ms);
+	return (size_t) (p - out);
+}
+
+/* Exposition parsing */
+
+static int
+ramd_remote_write_label_cmp(const void* a, const void* b)
+{
+	const ramd_remote_write_label_t* x = a;
+	const ramd_remote_write_label_t* y = b;
+	size_t n = x->name_length < y->name_length ? x->name_length : y->name_length;
+	int c = memcmp(x->name, y->name, n);
+
+	if (c != 0)
+		return c;
+	return (x->name_length > y->name_length) - (x->name_length < y->name_length);
+}
+
+static bool
+ramd_remote_write_has_label(const ramd_remote_write_label_t* labels, int32_t count,
+                            const char* name)
+{
+	size_t length = strlen(name);
+
+	for (int32_t i = 0; i < count; i++)
+		if (labels[i].name_length == length && memcmp(labels[i].name, name, length) == 0)
+			return true;
+	return false;
+}
+
+static int32_t
+ramd_remote_write_add_label(ramd_remote_write_label_t* labels, int32_t count, const char* name,
+                            const char* value)
+{
+	if (count >= RAMD_REMOTE_WRITE_MAX_LABELS || !value[0] ||
+	    ramd_remote_write_has_label(labels, count, name))
+		return count;
+	labels[count].name = name;
+	labels[count].name_length = strlen(name);
+	labels[count].value = value;
+	labels[count].value_length = strlen(value);
+	return count + 1;
+}
+
+static bool
+ramd_remote_write_name_char(char c, bool first)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' ||
+	       (!first && c >= '0' && c <= '9');
+}
+
+/*
+ * Split one sample line, name{label="value",...} value [timestamp], into
+ * labels pointing into line, with escapes in the values undone in place.
+ * __name__ comes first.  Returns the number of labels, -1 if the line is
+ * not a sample.
+ */
+static int32_t
+ramd_remote_write_parse_line(char* line, ramd_remote_write_label_t* labels, double* value,
+                             int64_t* timestamp_ms)
+{
+	char* p = line;
+	char* end;
+	int32_t count = 1;
+
+	if (!ramd_remote_write_name_char(*p, true))
+		return -1;
+	labels[0].name = "__name__";
+	labels[0].name_length = 8;
+	labels[0].value = p;
+	while (ramd_remote_write_name_char(*p, false))
+		p++;
+	labels[0].value_length = (size_t) (p - labels[0].value);
+
+	if (*p == '{')
+	{
+		p++;
+		for (;;)
+		{
+			char* out;
+
+			while (*p == ' ' || *p == ',')
+				p++;
+			if (*p == '}')
+			{
+				p++;
+				break;
+			}
+			if (!ramd_remote_write_name_char(*p, true) || count >= RAMD_REMOTE_WRITE_MAX_LABELS)
+				return -1;
+			labels[count].name = p;
+			while (ramd_remote_write_name_char(*p, false))
+				p++;
+			labels[count].name_length = (size_t) (p - labels[count].name);
+			if (p[0] != '=' || p[1] != '"')
+				return -1;
+			p += 2;
+			labels[count].value = out = p;
+			while (*p && *p != '"')
+			{
+				if (*p == '\\' && p[1])
+				{
+					p++;
+					*out++ = *p == 'n' ? '\n' : *p;
+					p++;
+				}
+				else
+					*out++ = *p++;
+			}
+			if (*p != '"')
+				return -1;
+			labels[count].value_length = (size_t) (out - labels[count].value);
+			p++;
+			count++;
+		}
+	}
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	errno = 0;
+	*value = strtod(p, &end);
+	if (end == p || errno == ERANGE || (*end && *end != ' ' && *end != '\t'))
+		return -1;
+	p = end;
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p)
+	{
+		long long ts = strtoll(p, &end, 10);
+
+		if (end != p && ts > 0)
+			*timestamp_ms = ts;
+	}
+	return count;
+}
+
+/* FNV-1a over the sorted label set; true the first time a series is seen */
+static bool
+ramd_remote_write_first_seen(ramd_remote_write_scratch_t* scratch,
+                             const ramd_remote_write_label_t* labels, int32_t count)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t slot;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		for (size_t j = 0; j < labels[i].name_length; j++)
+			h = (h ^ (uint8_t) labels[i].name[j]) * 0x100000001b3ULL;
+		h = (h ^ 0xff) * 0x100000001b3ULL;
+		for (size_t j = 0; j < labels[i].value_length; j++)
+			h = (h ^ (uint8_t) labels[i].value[j]) * 0x100000001b3ULL;
+		h = (h ^ 0xfe) * 0x100000001b3ULL;
+	}
+	if (h == 0)
+		h = 1;
+
+	for (slot = h & (scratch->seen_size - 1); scratch->seen[slot] != 0;
+	     slot = (slot + 1) & (scratch->seen_size - 1))
+		if (scratch->seen[slot] == h)
+			return false;
+	scratch->seen[slot] = h;
+	return true;
+}
+
+/* Append every sample of one exposition to batch */
+static int64_t
+ramd_remote_write_encode_exposition(ramd_remote_write_scratch_t* scratch, const char* text,
+                                    size_t length, int64_t timestamp_ms, ramd_buffer_t* batch)
+{
+	const ramd_config_t* config = g_remote_write.config;
+	const char* p = text;
+	const char* end = text + length;
+	int64_t samples = 0;
+
+	while (p < end)
+	{
+		const char* eol = memchr(p, '\n', (size_t) (end - p));
+		size_t line_length = (size_t) ((eol ? eol : end) - p);
+		int64_t sample_ms = timestamp_ms;
+		double value;
+		int32_t count;
+		size_t encoded;
+
+		if (line_length == 0 || *p == '#' || line_length >= sizeof(scratch->line))
+		{
+			p += line_length + 1;
+			continue;
+		}
+		memcpy(scratch->line, p, line_length);
+		scratch->line[line_length] = '\0';
+		p += line_length + 1;
+
+		count = ramd_remote_write_parse_line(scratch->line, scratch->labels, &value, &sample_ms);
+		if (count < 0)
+			continue;
+		count = ramd_remote_write_add_label(scratch->labels, count, "job", "ramd");
+		count = ramd_remote_write_add_label(scratch->labels, count, "instance", scratch->instance);
+		count = ramd_remote_write_add_label(scratch->labels, count, "cluster", config->cluster_name);
+		qsort(scratch->labels, (size_t) count, sizeof(scratch->labels[0]),
+		      ramd_remote_write_label_cmp);
+		if (!ramd_remote_write_first_seen(scratch, scratch->labels, count))
+			continue;
+
+		encoded = ramd_remote_write_encode_series(scratch->labels, count, value, sample_ms,
+		                                          scratch->series, sizeof(scratch->series));
+		if (encoded > 0 && ramd_buffer_append(batch, (const char*) scratch->series, encoded))
+			samples++;
+	}
+	return samples;
+}
+
+/* Queue */
+
+static void
+ramd_remote_write_pop(int64_t* samples)
+{
+	ramd_remote_write_batch_t* batch = g_remote_write.head;
+
+	g_remote_write.head = batch->next;
+	if (!g_remote_write.head)
+		g_remote_write.tail = NULL;
+	*samples = batch->samples;
+	pthread_mutex_lock(&g_remote_write.lock);
+	g_remote_write.stats.pending_bytes -= (int64_t) batch->length;
+	g_remote_write.stats.pending_samples -= batch->samples;
+	pthread_mutex_unlock(&g_remote_write.lock);
+	ramd_mem_free(RAMD_MEM_METRICS, batch);
+}
+
+static void
+ramd_remote_write_enqueue(const ramd_buffer_t* encoded, int64_t samples)
+{
+	const ramd_config_t* config = g_remote_write.config;
+	int64_t limit = (int64_t) config->remote_write_queue_kb * 1024;
+	bool drop_oldest = strcmp(config->remote_write_drop_policy, "newest") != 0;
+	int64_t dropped = 0;
+	ramd_remote_write_batch_t* batch;
+
+	if ((int64_t) encoded->length > limit)
+		goto drop;
+
+	while (drop_oldest && g_remote_write.head &&
+	       g_remote_write.stats.pending_bytes + (int64_t) encoded->length > limit)
+	{
+		int64_t n;
+
+		ramd_remote_write_pop(&n);
+		dropped += n;
+	}
+	if (g_remote_write.stats.pending_bytes + (int64_t) encoded->length > limit)
+		goto drop;
+
+	batch = ramd_mem_alloc(RAMD_MEM_METRICS, sizeof(*batch) + encoded->length);
+	if (!batch)
+		goto drop;
+	batch->next = NULL;
+	batch->samples = samples;
+	batch->length = encoded->length;
+	memcpy(batch->data, encoded->data, encoded->length);
+	if (g_remote_write.tail)
+		g_remote_write.tail->next = batch;
+	else
+		g_remote_write.head = batch;
+	g_remote_write.tail = batch;
+
+	pthread_mutex_lock(&g_remote_write.lock);
+	g_remote_write.stats.pending_bytes += (int64_t) batch->length;
+	g_remote_write.stats.pending_samples += samples;
+	g_remote_write.stats.samples_dropped += dropped;
+	pthread_mutex_unlock(&g_remote_write.lock);
+	if (dropped > 0)
+		ramd_log_warning("Remote write: queue full, dropped %lld oldest samples",
+		                 (long long) dropped);
+	return;
+
+drop:
+	pthread_mutex_lock(&g_remote_write.lock);
+	g_remote_write.stats.samples_dropped += dropped + samples;
+	pthread_mutex_unlock(&g_remote_write.lock);
+	ramd_log_warning("Remote write: queue full, dropped %lld new samples", (long long) samples);
+}
+
+/* Encode whatever the collector has rendered since the last round */
+static void
+ramd_remote_write_collect(ramd_remote_write_scratch_t* scratch)
+{
+	ramd_prometheus_snapshot_t* snapshots[RAMD_PROMETHEUS_EXPOSITION_COUNT] = {NULL};
+	ramd_buffer_t batch;
+	size_t lines = 0;
+	size_t size = 1024;
+	int64_t samples = 0;
+
+	for (int i = 0; i < RAMD_PROMETHEUS_EXPOSITION_COUNT; i++)
+	{
+		ramd_prometheus_snapshot_t* snapshot =
+			ramd_prometheus_snapshot_acquire((ramd_prometheus_exposition_t) i);
+
+		if (snapshot && snapshot->rendered_ms == g_remote_write.last_rendered_ms[i])
+		{
+			ramd_prometheus_snapshot_release(snapshot);
+			continue;
+		}
+		snapshots[i] = snapshot;
+		for (size_t j = 0; snapshot && j < snapshot->text_length; j++)
+			lines += snapshot->text[j] == '\n';
+	}
+
+	while (size < lines * 2)
+		size *= 2;
+	if (size > scratch->seen_size)
+	{
+		uint64_t* seen = ramd_mem_realloc(RAMD_MEM_METRICS, scratch->seen, size * sizeof(uint64_t));
+
+		if (!seen)
+			goto done;
+		scratch->seen = seen;
+		scratch->seen_size = size;
+	}
+	memset(scratch->seen, 0, scratch->seen_size * sizeof(uint64_t));
+
+	ramd_buffer_init_subsystem(&batch, RAMD_MEM_METRICS);
+	for (int i = 0; i < RAMD_PROMETHEUS_EXPOSITION_COUNT; i++)
+	{
+		if (!snapshots[i])
+			continue;
+		g_remote_write.last_rendered_ms[i] = snapshots[i]->rendered_ms;
+		samples += ramd_remote_write_encode_exposition(scratch, snapshots[i]->text,
+		                                               snapshots[i]->text_length,
+		                                               snapshots[i]->rendered_ms, &batch);
+	}
+	if (samples > 0)
+		ramd_remote_write_enqueue(&batch, samples);
+	ramd_buffer_free(&batch);
+
+done:
+	for (int i = 0; i < RAMD_PROMETHEUS_EXPOSITION_COUNT; i++)
+		ramd_prometheus_snapshot_release(snapshots[i]);
+}
+
+/* HTTP */
+
+static bool
+ramd_remote_write_parse_url(const char* url)
+{
+	const char* p = url;
+	const char* host_end;
+	const char* slash;
+	size_t host_length;
+	int len;
+
+	g_remote_write.tls = strncmp(p, "https://", 8) == 0;
+	p += g_remote_write.tls ? 8 : 7;
+	slash = strchr(p, '/');
+	if (!slash)
+		slash = p + strlen(p);
+
+	if (*p == '[')
+	{
+		host_end = memchr(p, ']', (size_t) (slash - p));
+		if (!host_end)
+			return false;
+		host_length = (size_t) (host_end - p - 1);
+		if (host_length == 0 || host_length >= sizeof(g_remote_write.host))
+			return false;
+		memcpy(g_remote_write.host, p + 1, host_length);
+		host_end++;
+	}
+	else
+	{
+		host_end = memchr(p, ':', (size_t) (slash - p));
+		if (!host_end)
+			host_end = slash;
+		host_length = (size_t) (host_end - p);
+		if (host_length == 0 || host_length >= sizeof(g_remote_write.host))
+			return false;
+		memcpy(g_remote_write.host, p, host_length);
+	}
+	g_remote_write.host[host_length] = '\0';
+
+	if (*host_end == ':')
+	{
+		size_t port_length = (size_t) (slash - host_end - 1);
+
+		if (port_length == 0 || port_length >= sizeof(g_remote_write.port))
+			return false;
+		memcpy(g_remote_write.port, host_end + 1, port_length);
+		g_remote_write.port[port_length] = '\0';
+	}
+	else if (host_end == slash)
+		strcpy(g_remote_write.port, g_remote_write.tls ? "443" : "80");
+	else
+		return false;
+
+	len = snprintf(g_remote_write.host_header, sizeof(g_remote_write.host_header), "%.*s",
+	               (int) (slash - p), p);
+	if (len < 0 || (size_t) len >= sizeof(g_remote_write.host_header))
+		return false;
+	len = snprintf(g_remote_write.path, sizeof(g_remote_write.path), "%s", *slash ? slash : "/");
+	return len > 0 && (size_t) len < sizeof(g_remote_write.path);
+}
+
+static int
+ramd_remote_write_connect(int32_t timeout_ms, char* error, size_t error_size)
+{
+	struct addrinfo hints;
+	struct addrinfo* addrs = NULL;
+	struct timeval tv;
+	int fd = -1;
+	int rc;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	rc = getaddrinfo(g_remote_write.host, g_remote_write.port, &hints, &addrs);
+	if (rc != 0)
+	{
+		snprintf(error, error_size, "cannot resolve %s: %s", g_remote_write.host,
+		         gai_strerror(rc));
+		return -1;
+	}
+
+	snprintf(error, error_size, "cannot connect to %s:%s", g_remote_write.host,
+	         g_remote_write.port);
+	for (struct addrinfo* ai = addrs; ai; ai = ai->ai_next)
+	{
+		struct pollfd pfd;
+		int err = 0;
+		socklen_t err_len = sizeof(err);
+
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+		{
+			if (errno != EINPROGRESS)
+				err = errno;
+			else
+			{
+				pfd.fd = fd;
+				pfd.events = POLLOUT;
+				rc = poll(&pfd, 1, timeout_ms);
+				if (rc == 0)
+					err = ETIMEDOUT;
+				else if (rc < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0)
+					err = errno;
+			}
+		}
+		if (err == 0)
+			break;
+		snprintf(error, error_size, "cannot connect to %s:%s: %s", g_remote_write.host,
+		         g_remote_write.port, strerror(err));
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addrs);
+	if (fd < 0)
+		return -1;
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	return fd;
+}
+
+static bool
+ramd_remote_write_send_all(int fd, SSL* ssl, const void* data, size_t length)
+{
+	const char* p = data;
+
+	while (length > 0)
+	{
+		ssize_t n;
+
+		if (ssl)
+			n = SSL_write(ssl, p, length > INT32_MAX ? INT32_MAX : (int) length);
+		else
+			n = send(fd, p, length, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			if (!ssl && n < 0 && errno == EINTR)
+				continue;
+			return false;
+		}
+		p += n;
+		length -= (size_t) n;
+	}
+	return true;
+}
+
+/*
+ * POST one compressed WriteRequest.  Returns the HTTP status, or 0 with
+ * reply holding the reason when there is none; otherwise reply holds the
+ * start of the response body for the log.
+ */
+static int
+ramd_remote_write_post(const uint8_t* body, size_t length, char* reply, size_t reply_size)
+{
+	const ramd_config_t* config = g_remote_write.config;
+	char header[RAMD_MAX_PATH_LENGTH * 3];
+	char response[RAMD_REMOTE_WRITE_RESPONSE_MAX];
+	size_t received = 0;
+	const char* text;
+	SSL* ssl = NULL;
+	int status = 0;
+	int header_length;
+	int fd;
+
+	fd = ramd_remote_write_connect(config->remote_write_timeout_ms, reply, reply_size);
+	if (fd < 0)
+		return 0;
+
+	if (g_remote_write.tls)
+	{
+		ssl = SSL_new(g_remote_write.ssl_ctx);
+		if (!ssl || SSL_set_fd(ssl, fd) != 1 ||
+		    SSL_set_tlsext_host_name(ssl, g_remote_write.host) != 1 ||
+		    SSL_set1_host(ssl, g_remote_write.host) != 1 || SSL_connect(ssl) != 1)
+		{
+			snprintf(reply, reply_size, "TLS handshake with %s failed: %s", g_remote_write.host,
+			         ERR_reason_error_string(ERR_peek_last_error())
+			             ? ERR_reason_error_string(ERR_peek_last_error()) : "connection closed");
+			ERR_clear_error();
+			goto done;
+		}
+	}
+
+	header_length = snprintf(header, sizeof(header),
+		"POST %s HTTP/1.1\r\n"
+		"Host: %s\r\n"
+		"User-Agent: ramd/" RAMD_VERSION_STRING "\r\n"
+		"Content-Type: application/x-protobuf\r\n"
+		"Content-Encoding: snappy\r\n"
+		"X-Prometheus-Remote-Write-Version: 0.1.0\r\n"
+		"Content-Length: %zu\r\n"
+		"%s%s%s"
+		"Connection: close\r\n\r\n",
+		g_remote_write.path, g_remote_write.host_header, length,
+		config->remote_write_auth_token[0] ? "Authorization: Bearer " : "",
+		config->remote_write_auth_token,
+		config->remote_write_auth_token[0] ? "\r\n" : "");
+	if (header_length < 0 || (size_t) header_length >= sizeof(header))
+	{
+		snprintf(reply, reply_size, "request header too long");
+		goto done;
+	}
+	if (!ramd_remote_write_send_all(fd, ssl, header, (size_t) header_length) ||
+	    !ramd_remote_write_send_all(fd, ssl, body, length))
+	{
+		snprintf(reply, reply_size, "cannot send to %s: %s", g_remote_write.host,
+		         ssl ? "TLS write failed" : strerror(errno));
+		goto done;
+	}
+
+	/* The status line and the start of the body are all that is wanted */
+	while (received < sizeof(response) - 1)
+	{
+		ssize_t n = ssl ? SSL_read(ssl, response + received, (int) (sizeof(response) - 1 - received))
+		                : recv(fd, response + received, sizeof(response) - 1 - received, 0);
+
+		if (n <= 0)
+		{
+			if (!ssl && n < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+		received += (size_t) n;
+	}
+	response[received] = '\0';
+
+	if (received < 12 || strncmp(response, "HTTP/1.", 7) != 0 ||
+	    sscanf(response + 8, " %3d", &status) != 1)
+	{
+		snprintf(reply, reply_size, "no HTTP response from %s", g_remote_write.host);
+		status = 0;
+		goto done;
+	}
+	text = strstr(response, "\r\n\r\n");
+	snprintf(reply, reply_size, "%s", text ? text + 4 : "");
+	reply[strcspn(reply, "\r\n")] = '\0';
+
+done:
+	if (ssl)
+	{
+		SSL_shutdown(ssl);
+		SSL_free(ssl);
+	}
+	close(fd);
+	return status;
+}
+
+/* Next delay after a failure: doubling from the minimum, plus up to a quarter more */
+static int64_t
+ramd_remote_write_backoff(void)
+{
+	int64_t delay;
+
+	if (g_remote_write.backoff_ms == 0)
+		g_remote_write.backoff_ms = RAMD_REMOTE_WRITE_BACKOFF_MIN_MS;
+	else if (g_remote_write.backoff_ms < RAMD_REMOTE_WRITE_BACKOFF_MAX_MS)
+		g_remote_write.backoff_ms *= 2;
+	if (g_remote_write.backoff_ms > RAMD_REMOTE_WRITE_BACKOFF_MAX_MS)
+		g_remote_write.backoff_ms = RAMD_REMOTE_WRITE_BACKOFF_MAX_MS;
+
+	g_remote_write.jitter ^= g_remote_write.jitter << 13;
+	g_remote_write.jitter ^= g_remote_write.jitter >> 17;
+	g_remote_write.jitter ^= g_remote_write.jitter << 5;
+	delay = g_remote_write.backoff_ms;
+	return delay + (int64_t) (g_remote_write.jitter % (uint32_t) (delay / 4 + 1));
+}
+
+/*
+ * Send the oldest batches as one request.  Returns the delay before the
+ * next attempt: 0 to carry on with the queue, the backoff after a failure.
+ */
+static int64_t
+ramd_remote_write_send(void)
+{
+	ramd_remote_write_batch_t* batch;
+	const uint8_t* body;
+	uint8_t* joined = NULL;
+	uint8_t* compressed;
+	size_t length = 0;
+	size_t compressed_length;
+	int32_t batches = 0;
+	int64_t samples = 0;
+	char reply[RAMD_REMOTE_WRITE_RESPONSE_MAX];
+	int status;
+
+	for (batch = g_remote_write.head; batch; batch = batch->next)
+	{
+		if (batches > 0 && length + batch->length > RAMD_REMOTE_WRITE_MAX_REQUEST)
+			break;
+		length += batch->length;
+		samples += batch->samples;
+		batches++;
+	}
+
+	/* A WriteRequest is nothing but its timeseries, so batches simply concatenate */
+	if (batches == 1)
+		body = g_remote_write.head->data;
+	else
+	{
+		uint8_t* p;
+
+		joined = ramd_mem_alloc(RAMD_MEM_METRICS, length);
+		if (!joined)
+			return RAMD_REMOTE_WRITE_BACKOFF_MIN_MS;
+		p = joined;
+		batch = g_remote_write.head;
+		for (int32_t i = 0; i < batches; i++, batch = batch->next)
+		{
+			memcpy(p, batch->data, batch->length);
+			p += batch->length;
+		}
+		body = joined;
+	}
+
+	compressed = ramd_mem_alloc(RAMD_MEM_METRICS, ramd_snappy_max_compressed_length(length));
+	if (!compressed)
+	{
+		ramd_mem_free(RAMD_MEM_METRICS, joined);
+		return RAMD_REMOTE_WRITE_BACKOFF_MIN_MS;
+	}
+	compressed_length = ramd_snappy_compress(body, length, compressed);
+	ramd_mem_free(RAMD_MEM_METRICS, joined);
+
+	status = ramd_remote_write_post(compressed, compressed_length, reply, sizeof(reply));
+	ramd_mem_free(RAMD_MEM_METRICS, compressed);
+
+	if (status >= 200 && status < 300)
+	{
+		int64_t n;
+
+		for (int32_t i = 0; i < batches; i++)
+			ramd_remote_write_pop(&n);
+		pthread_mutex_lock(&g_remote_write.lock);
+		g_remote_write.stats.samples_sent += samples;
+		g_remote_write.stats.requests_ok++;
+		g_remote_write.stats.bytes_sent += (int64_t) compressed_length;
+		g_remote_write.stats.last_success_ms = ramd_clock_now_ms();
+		g_remote_write.stats.last_status = status;
+		pthread_mutex_unlock(&g_remote_write.lock);
+		if (g_remote_write.backoff_ms > 0)
+			ramd_log_info("Remote write: %s:%s accepts samples again", g_remote_write.host,
+			              g_remote_write.port);
+		g_remote_write.backoff_ms = 0;
+		return 0;
+	}
+
+	if (status >= 400 && status < 500 && status != 429)
+	{
+		int64_t n;
+
+		for (int32_t i = 0; i < batches; i++)
+			ramd_remote_write_pop(&n);
+		pthread_mutex_lock(&g_remote_write.lock);
+		g_remote_write.stats.samples_rejected += samples;
+		g_remote_write.stats.last_status = status;
+		pthread_mutex_unlock(&g_remote_write.lock);
+		ramd_log_warning("Remote write: %s rejected %lld samples with HTTP %d: %s",
+		                 g_remote_write.host, (long long) samples, status, reply);
+		g_remote_write.backoff_ms = 0;
+		return 0;
+	}
+
+	pthread_mutex_lock(&g_remote_write.lock);
+	g_remote_write.stats.requests_failed++;
+	g_remote_write.stats.last_status = status;
+	pthread_mutex_unlock(&g_remote_write.lock);
+	if (g_remote_write.backoff_ms == 0)
+	{
+		if (status > 0)
+			ramd_log_warning("Remote write: %s answered HTTP %d, retrying: %s",
+			                 g_remote_write.host, status, reply);
+		else
+			ramd_log_warning("Remote write: %s, retrying", reply);
+	}
+	return ramd_remote_write_backoff();
+}
+
+static void*
+ramd_remote_write_thread_main(void* arg)
+{
+	ramd_remote_write_scratch_t* scratch;
+	int64_t next_collect_ms = ramd_clock_now_ms();
+	int64_t next_send_ms = 0;
+
+	(void) arg;
+
+	scratch = ramd_mem_calloc(RAMD_MEM_METRICS, 1, sizeof(*scratch));
+	if (!scratch)
+	{
+		ramd_log_error("Remote write: cannot allocate the encoder");
+		return NULL;
+	}
+	snprintf(scratch->instance, sizeof(scratch->instance), "%s:%d",
+	         g_remote_write.config->hostname, g_remote_write.config->http_port);
+
+	pthread_mutex_lock(&g_remote_write.lock);
+	while (g_remote_write.running)
+	{
+		int64_t now = ramd_clock_now_ms();
+		int64_t wake;
+		struct timespec deadline;
+
+		pthread_mutex_unlock(&g_remote_write.lock);
+		if (now >= next_collect_ms)
+		{
+			ramd_remote_write_collect(scratch);
+			next_collect_ms = now + g_remote_write.config->remote_write_interval_ms;
+		}
+		if (g_remote_write.head && now >= next_send_ms)
+			next_send_ms = ramd_clock_now_ms() + ramd_remote_write_send();
+		pthread_mutex_lock(&g_remote_write.lock);
+
+		wake = next_collect_ms;
+		if (g_remote_write.head && next_send_ms < wake)
+			wake = next_send_ms;
+		now = ramd_clock_now_ms();
+		if (!g_remote_write.running || wake <= now)
+			continue;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (wake - now) / 1000;
+		deadline.tv_nsec += ((wake - now) % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&g_remote_write.cond, &g_remote_write.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_remote_write.lock);
+
+	ramd_mem_free(RAMD_MEM_METRICS, scratch->seen);
+	ramd_mem_free(RAMD_MEM_METRICS, scratch);
+	return NULL;
+}
+
+static SSL_CTX*
+ramd_remote_write_ssl_ctx(const ramd_config_t* config)
+{
+	SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+
+	if (!ctx)
+		return NULL;
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+	if (SSL_CTX_set_default_verify_paths(ctx) != 1)
+		ERR_clear_error();
+	if (config->ssl_ca_file[0] &&
+	    SSL_CTX_load_verify_locations(ctx, config->ssl_ca_file, NULL) != 1)
+	{
+		ramd_log_error("Remote write: cannot load ssl_ca_file %s", config->ssl_ca_file);
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+bool
+ramd_remote_write_start(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_remote_write.lock);
+	g_remote_write.config = config;
+	if (g_remote_write.running || !config->remote_write_url[0])
+	{
+		pthread_mutex_unlock(&g_remote_write.lock);
+		return true;
+	}
+
+	if (!ramd_remote_write_parse_url(config->remote_write_url))
+	{
+		pthread_mutex_unlock(&g_remote_write.lock);
+		ramd_log_error("Remote write: cannot parse remote_write_url %s", config->remote_write_url);
+		return false;
+	}
+	if (g_remote_write.tls && !(g_remote_write.ssl_ctx = ramd_remote_write_ssl_ctx(config)))
+	{
+		pthread_mutex_unlock(&g_remote_write.lock);
+		return false;
+	}
+
+	memset(&g_remote_write.stats, 0, sizeof(g_remote_write.stats));
+	memset(g_remote_write.last_rendered_ms, 0, sizeof(g_remote_write.last_rendered_ms));
+	g_remote_write.backoff_ms = 0;
+	g_remote_write.jitter = (uint32_t) ramd_clock_now_us() | 1;
+	g_remote_write.running = true;
+	if (pthread_create(&g_remote_write.thread, NULL, ramd_remote_write_thread_main, NULL) != 0)
+	{
+		g_remote_write.running = false;
+		SSL_CTX_free(g_remote_write.ssl_ctx);
+		g_remote_write.ssl_ctx = NULL;
+		pthread_mutex_unlock(&g_remote_write.lock);
+		ramd_log_error("Remote write: cannot start thread: %s", strerror(errno));
+		return false;
+	}
+	g_remote_write.stats.running = true;
+	pthread_mutex_unlock(&g_remote_write.lock);
+
+	ramd_log_info("Remote write started: %s every %d ms, queue of %d KB dropping %s samples",
+	              config->remote_write_url, config->remote_write_interval_ms,
+	              config->remote_write_queue_kb, config->remote_write_drop_policy);
+	return true;
+}
+
+void
+ramd_remote_write_stop(void)
+{
+	int64_t n;
+
+	pthread_mutex_lock(&g_remote_write.lock);
+	if (!g_remote_write.running)
+	{
+		pthread_mutex_unlock(&g_remote_write.lock);
+		return;
+	}
+	/* A request in flight finishes first, bounded by remote_write_timeout_ms */
+	g_remote_write.running = false;
+	g_remote_write.stats.running = false;
+	pthread_cond_broadcast(&g_remote_write.cond);
+	pthread_mutex_unlock(&g_remote_write.lock);
+
+	pthread_join(g_remote_write.thread, NULL);
+
+	while (g_remote_write.head)
+		ramd_remote_write_pop(&n);
+	SSL_CTX_free(g_remote_write.ssl_ctx);
+	g_remote_write.ssl_ctx = NULL;
+}
+
+bool
+ramd_remote_write_get_stats(ramd_remote_write_stats_t* stats)
+{
+	bool running;
+
+	if (!stats)
+		return false;
+	pthread_mutex_lock(&g_remote_write.lock);
+	*stats = g_remote_write.stats;
+	running = g_remote_write.running;
+	pthread_mutex_unlock(&g_remote_write.lock);
+	return running;
+}
+
+bool
+ramd_remote_write_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_remote_write_stats_t stats;
+	bool ok = true;
+
+	if (!output)
+		return false;
+	if (!ramd_remote_write_get_stats(&stats))
+		return true; /* remote_write_url is empty */
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_remote_write_samples_total Samples handed to remote write, by outcome\n"
+		"# TYPE ramd_remote_write_samples_total counter\n"
+		"ramd_remote_write_samples_total{result=\"sent\"} %lld\n"
+		"ramd_remote_write_samples_total{result=\"dropped\"} %lld\n"
+		"ramd_remote_write_samples_total{result=\"rejected\"} %lld\n"
+		"\n# HELP ramd_remote_write_requests_total Remote write requests, by outcome\n"
+		"# TYPE ramd_remote_write_requests_total counter\n"
+		"ramd_remote_write_requests_total{result=\"ok\"} %lld\n"
+		"ramd_remote_write_requests_total{result=\"retried\"} %lld\n"
+		"\n# HELP ramd_remote_write_sent_bytes_total Compressed request bodies sent\n"
+		"# TYPE ramd_remote_write_sent_bytes_total counter\n"
+		"ramd_remote_write_sent_bytes_total %lld\n",
+		(long long) stats.samples_sent, (long long) stats.samples_dropped,
+		(long long) stats.samples_rejected, (long long) stats.requests_ok,
+		(long long) stats.requests_failed, (long long) stats.bytes_sent);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_remote_write_pending_samples Samples queued for the next requests\n"
+		"# TYPE ramd_remote_write_pending_samples gauge\n"
+		"ramd_remote_write_pending_samples %lld\n"
+		"\n# HELP ramd_remote_write_pending_bytes Encoded size of the queued samples\n"
+		"# TYPE ramd_remote_write_pending_bytes gauge\n"
+		"ramd_remote_write_pending_bytes %lld\n",
+		(long long) stats.pending_samples, (long long) stats.pending_bytes);
+
+	if (stats.last_success_ms > 0)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_remote_write_last_success_age_seconds Time since a request was last accepted\n"
+			"# TYPE ramd_remote_write_last_success_age_seconds gauge\n"
+			"ramd_remote_write_last_success_age_seconds %.3f\n",
+			(double) (ramd_clock_now_ms() - stats.last_success_ms) / 1000.0);
+	return ok;
+}
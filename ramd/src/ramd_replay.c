@@ -0,0 +1,631 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_replay.c
+ *		PostgreSQL Auto-Failover Daemon - Standby Replay Advisor
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * On a write-heavy primary a standby usually falls behind in replay, not
+ * on the network, and a standby that falls far enough behind loses its
+ * place among the synchronous standbys.  Every replay_advisor_interval_ms
+ * this node's own session is asked where its WAL is: how far the
+ * walreceiver has written and flushed behind the primary's end of WAL
+ * (pg_stat_wal_receiver), and how far replay is behind the flush.  The
+ * lag sampler's pg_stat_replication figures for this node split the same
+ * lag into time.  The largest stage is the bottleneck.
+ *
+ * Once replay has been the bottleneck for RAMD_REPLAY_BOUND_SAMPLES
+ * samples in a row, pg_stat_recovery_prefetch says why.  Prefetching off
+ * is turned on; an I/O queue at maintenance_io_concurrency gets a deeper
+ * one, doubling up to replay_max_io_concurrency; a prefetcher that looks
+ * as far ahead as wal_decode_buffer_size allows gets a bigger buffer, up
+ * to replay_max_decode_buffer_kb.  When nearly every block is already in
+ * shared buffers prefetch cannot help: replay is bound by the startup
+ * process's CPU and that is only logged.  With replay_autotune the change
+ * is made with ALTER SYSTEM and a reload, at most one per
+ * RAMD_REPLAY_TUNE_COOLDOWN_MS so the previous one can show; otherwise it
+ * is logged as advice.
+ *
+ * wal_decode_buffer_size only changes at a restart, which ramd never does
+ * for this; the new value waits for the next one and is not raised again
+ * meanwhile.  Settings are never lowered: what helped at one peak is
+ * wanted at the next.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramd_replay.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_postgresql.h"
+
+/*
+ * latest_end_lsn trails written_lsn between keepalives, hence GREATEST.
+ * written_lsn and flushed_lsn arrived in 13; before that received_lsn was
+ * the flush position.
+ */
+#define RAMD_REPLAY_QUERY \
+	"SELECT pg_is_in_recovery(), " \
+	"GREATEST(pg_wal_lsn_diff(r.latest_end_lsn, r.written_lsn), 0)::bigint, " \
+	"GREATEST(pg_wal_lsn_diff(r.written_lsn, r.flushed_lsn), 0)::bigint, " \
+	"GREATEST(pg_wal_lsn_diff(COALESCE(r.flushed_lsn, pg_last_wal_receive_lsn()), " \
+	"pg_last_wal_replay_lsn()), 0)::bigint " \
+	"FROM (SELECT 1) AS one LEFT JOIN pg_stat_wal_receiver AS r ON true"
+
+#define RAMD_REPLAY_QUERY_12 \
+	"SELECT pg_is_in_recovery(), " \
+	"GREATEST(pg_wal_lsn_diff(r.latest_end_lsn, r.received_lsn), 0)::bigint, " \
+	"0, " \
+	"GREATEST(pg_wal_lsn_diff(pg_last_wal_receive_lsn(), pg_last_wal_replay_lsn()), 0)::bigint " \
+	"FROM (SELECT 1) AS one LEFT JOIN pg_stat_wal_receiver AS r ON true"
+
+#define RAMD_REPLAY_PREFETCH_QUERY \
+	"SELECT prefetch, hit, skip_init, skip_new, skip_fpw, skip_rep, " \
+	"wal_distance, block_distance, io_depth FROM pg_stat_recovery_prefetch"
+
+#define RAMD_REPLAY_SETTINGS_QUERY \
+	"SELECT name, setting, unit, pending_restart FROM pg_settings WHERE name IN " \
+	"('recovery_prefetch', 'maintenance_io_concurrency', 'wal_decode_buffer_size')"
+
+typedef struct ramd_replay_t
+{
+	pthread_mutex_t lock;  /* guards everything below but the thread's own state */
+	pthread_cond_t cond;   /* wakes the thread: stop */
+	pthread_t thread;
+	bool running;
+	const ramd_config_t* config;
+	ramd_replay_stats_t stats;
+} ramd_replay_t;
+
+static ramd_replay_t g_replay = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* Only the advisor's thread touches these */
+static int64_t g_replay_prev_prefetch;
+static int64_t g_replay_prev_hit;
+static char g_replay_advice[256]; /* last logged, so each is logged once per episode */
+
+static int64_t
+ramd_replay_value(const PGresult* res, int row, int col)
+{
+	if (PQgetisnull(res, row, col))
+		return 0;
+	return strtoll(PQgetvalue(res, row, col), NULL, 10);
+}
+
+/* pg_settings reports memory in its own unit */
+static int32_t
+ramd_replay_setting_kb(const char* setting, const char* unit)
+{
+	int64_t value = strtoll(setting, NULL, 10);
+
+	if (strcmp(unit, "B") == 0)
+		value /= 1024;
+	else if (strcmp(unit, "8kB") == 0)
+		value *= 8;
+	else if (strcmp(unit, "MB") == 0)
+		value *= 1024;
+	return (int32_t) value;
+}
+
+static bool
+ramd_replay_read_settings(PGconn* conn, ramd_replay_stats_t* s, int32_t timeout_ms)
+{
+	PGresult* res = ramd_conn_exec_timeout(conn, RAMD_REPLAY_SETTINGS_QUERY, timeout_ms);
+	bool ok = res && PQresultStatus(res) == PGRES_TUPLES_OK;
+	int row;
+
+	s->restart_pending = false;
+	for (row = 0; ok && row < PQntuples(res); row++)
+	{
+		const char* name = PQgetvalue(res, row, 0);
+		const char* setting = PQgetvalue(res, row, 1);
+
+		if (strcmp(name, "recovery_prefetch") == 0)
+			snprintf(s->recovery_prefetch, sizeof(s->recovery_prefetch), "%s", setting);
+		else if (strcmp(name, "maintenance_io_concurrency") == 0)
+			s->maintenance_io_concurrency = atoi(setting);
+		else
+		{
+			s->wal_decode_buffer_kb = ramd_replay_setting_kb(setting, PQgetvalue(res, row, 2));
+			s->restart_pending = strcmp(PQgetvalue(res, row, 3), "t") == 0;
+		}
+	}
+	PQclear(res);
+	return ok;
+}
+
+static bool
+ramd_replay_read_prefetch(PGconn* conn, ramd_replay_stats_t* s, int32_t timeout_ms)
+{
+	PGresult* res = ramd_conn_exec_timeout(conn, RAMD_REPLAY_PREFETCH_QUERY, timeout_ms);
+	bool ok = res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0;
+
+	if (ok)
+	{
+		s->prefetch = ramd_replay_value(res, 0, 0);
+		s->hit = ramd_replay_value(res, 0, 1);
+		s->skip_init = ramd_replay_value(res, 0, 2);
+		s->skip_new = ramd_replay_value(res, 0, 3);
+		s->skip_fpw = ramd_replay_value(res, 0, 4);
+		s->skip_rep = ramd_replay_value(res, 0, 5);
+		s->wal_distance = ramd_replay_value(res, 0, 6);
+		s->block_distance = (int32_t) ramd_replay_value(res, 0, 7);
+		s->io_depth = (int32_t) ramd_replay_value(res, 0, 8);
+	}
+	PQclear(res);
+	return ok;
+}
+
+/* The same lag in time, from the primary's side; -1 where it has no figure */
+static void
+ramd_replay_split_time(const ramd_config_t* config, ramd_replay_stats_t* s)
+{
+	ramd_lag_stats_t lag;
+	const ramd_lag_sample_t* last = &lag.last;
+
+	s->write_lag_ms = s->flush_lag_ms = s->replay_lag_ms = -1;
+	if (!ramd_lag_get_stats(config->node_id, &lag) || !lag.connected || lag.sample_count == 0)
+		return;
+
+	s->write_lag_ms = last->write_lag_ms;
+	if (last->flush_lag_ms >= 0 && last->write_lag_ms >= 0)
+		s->flush_lag_ms = last->flush_lag_ms > last->write_lag_ms
+		                      ? last->flush_lag_ms - last->write_lag_ms : 0;
+	if (last->replay_lag_ms >= 0 && last->flush_lag_ms >= 0)
+		s->replay_lag_ms = last->replay_lag_ms > last->flush_lag_ms
+		                       ? last->replay_lag_ms - last->flush_lag_ms : 0;
+}
+
+/*
+ * The stage holding most WAL, once there is enough of it to matter.  Below
+ * that, replay still counts when applying takes long enough to threaten
+ * the standby's place among the synchronous ones.
+ */
+static ramd_replay_bottleneck_t
+ramd_replay_classify(const ramd_config_t* config, const ramd_replay_stats_t* s)
+{
+	int64_t worst = s->replay_lag_bytes;
+	ramd_replay_bottleneck_t bottleneck = RAMD_REPLAY_BOTTLENECK_REPLAY;
+
+	if (s->flush_lag_bytes > worst)
+	{
+		worst = s->flush_lag_bytes;
+		bottleneck = RAMD_REPLAY_BOTTLENECK_FLUSH;
+	}
+	if (s->receive_lag_bytes > worst)
+	{
+		worst = s->receive_lag_bytes;
+		bottleneck = RAMD_REPLAY_BOTTLENECK_NETWORK;
+	}
+	if (worst >= RAMD_REPLAY_MIN_LAG_BYTES)
+		return bottleneck;
+
+	if (s->replay_lag_ms >= config->sync_adaptive_stall_ms / 2 &&
+	    s->replay_lag_ms >= s->write_lag_ms && s->replay_lag_ms >= s->flush_lag_ms)
+		return RAMD_REPLAY_BOTTLENECK_REPLAY;
+	return RAMD_REPLAY_BOTTLENECK_NONE;
+}
+
+/* Log advice unless it is what was said last */
+static void
+ramd_replay_advise(const char* advice)
+{
+	if (strcmp(advice, g_replay_advice) == 0)
+		return;
+	snprintf(g_replay_advice, sizeof(g_replay_advice), "%s", advice);
+	ramd_log_info("Replay advisor: %s", advice);
+}
+
+static bool
+ramd_replay_apply(PGconn* conn, const char* name, const char* value)
+{
+	PGresult* res;
+	bool ok;
+
+	if (!ramd_postgresql_alter_system(conn, name, value))
+		return false;
+	res = PQexec(conn, "SELECT pg_reload_conf()");
+	ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+	if (!ok)
+		ramd_log_error("pg_reload_conf() failed: %s", PQerrorMessage(conn));
+	PQclear(res);
+	return ok;
+}
+
+/*
+ * Replay has been the bottleneck for long enough: find the first setting
+ * that would help and change it, or say what it would be.  Returns true
+ * if a setting was changed.
+ */
+static bool
+ramd_replay_tune(PGconn* conn, const ramd_config_t* config, const ramd_replay_stats_t* s,
+                 int64_t last_tuned_ms)
+{
+	char advice[sizeof(g_replay_advice)];
+	char value[32];
+	const char* name = NULL;
+	int64_t prefetched = s->prefetch - g_replay_prev_prefetch;
+	int64_t hits = s->hit - g_replay_prev_hit;
+	int64_t decode_bytes = (int64_t) s->wal_decode_buffer_kb * 1024;
+
+	if (!s->prefetch_available)
+	{
+		ramd_replay_advise("replay is behind; recovery prefetch needs PostgreSQL 15 or later");
+		return false;
+	}
+
+	if (strcmp(s->recovery_prefetch, "off") == 0)
+	{
+		name = "recovery_prefetch";
+		snprintf(value, sizeof(value), "try");
+	}
+	else if (prefetched >= 0 && hits >= 0 && prefetched + hits > 0 &&
+	         hits * 100 >= (prefetched + hits) * RAMD_REPLAY_CPU_BOUND_HIT_PCT)
+	{
+		snprintf(advice, sizeof(advice),
+		         "replay is behind with %lld%% of blocks already in shared buffers: "
+		         "the startup process is CPU-bound and prefetching cannot help",
+		         (long long) (hits * 100 / (prefetched + hits)));
+		ramd_replay_advise(advice);
+		return false;
+	}
+	else if (s->maintenance_io_concurrency < config->replay_max_io_concurrency &&
+	         (int64_t) s->io_depth * 100 >=
+	             (int64_t) s->maintenance_io_concurrency * RAMD_REPLAY_SATURATION_PCT)
+	{
+		/* 0 turns prefetching off, so start it where PostgreSQL would */
+		int32_t next = s->maintenance_io_concurrency > 0 ? s->maintenance_io_concurrency * 2
+		                                                 : RAMD_REPLAY_INITIAL_IO_CONCURRENCY;
+
+		if (next > config->replay_max_io_concurrency)
+			next = config->replay_max_io_concurrency;
+		name = "maintenance_io_concurrency";
+		snprintf(value, sizeof(value), "%d", next);
+	}
+	else if (!s->restart_pending && s->wal_decode_buffer_kb > 0 &&
+	         s->wal_decode_buffer_kb < config->replay_max_decode_buffer_kb &&
+	         s->wal_distance * 100 >= decode_bytes * RAMD_REPLAY_SATURATION_PCT)
+	{
+		int32_t next = s->wal_decode_buffer_kb * 2;
+
+		if (next > config->replay_max_decode_buffer_kb)
+			next = config->replay_max_decode_buffer_kb;
+		name = "wal_decode_buffer_size";
+		snprintf(value, sizeof(value), "%dkB", next);
+	}
+	else
+	{
+		snprintf(advice, sizeof(advice),
+		         "replay is behind with nothing left to raise within bounds "
+		         "(maintenance_io_concurrency %d, wal_decode_buffer_size %d kB%s)",
+		         s->maintenance_io_concurrency, s->wal_decode_buffer_kb,
+		         s->restart_pending ? ", a larger one waiting for a restart" : "");
+		ramd_replay_advise(advice);
+		return false;
+	}
+
+	if (!config->replay_autotune)
+	{
+		snprintf(advice, sizeof(advice), "replay is behind; set %s = '%s' to speed it up", name, value);
+		ramd_replay_advise(advice);
+		return false;
+	}
+	if (last_tuned_ms > 0 && ramd_clock_now_ms() - last_tuned_ms < RAMD_REPLAY_TUNE_COOLDOWN_MS)
+		return false;
+	if (!ramd_replay_apply(conn, name, value))
+		return false;
+
+	if (strcmp(name, "wal_decode_buffer_size") == 0)
+		ramd_log_warning("Replay advisor: set wal_decode_buffer_size = '%s'; "
+		                 "it takes effect at the next restart of PostgreSQL", value);
+	else
+		ramd_log_notice("Replay advisor: replay is behind by %lld bytes, set %s = '%s'",
+		                (long long) s->replay_lag_bytes, name, value);
+	g_replay_advice[0] = '\0';
+	return true;
+}
+
+/* One round; fills next and returns false if the node could not be asked */
+static bool
+ramd_replay_sample(const ramd_config_t* config, const ramd_replay_stats_t* prev,
+                   ramd_replay_stats_t* next)
+{
+	PGconn* conn;
+	PGresult* res;
+	int32_t timeout_ms = config->health_check_timeout_ms;
+	bool ok;
+
+	conn = ramd_conn_checkout(config->node_id, config->hostname, config->postgresql_port,
+	                          config->database_name, config->database_user,
+	                          config->database_password);
+	if (!conn)
+	{
+		ramd_log_debug("Replay advisor: cannot connect to the local node");
+		return false;
+	}
+
+	res = ramd_conn_exec_timeout(conn,
+	                             PQserverVersion(conn) >= 130000 ? RAMD_REPLAY_QUERY
+	                                                             : RAMD_REPLAY_QUERY_12,
+	                             timeout_ms);
+	ok = res && PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0;
+	if (!ok)
+	{
+		ramd_log_debug("Replay advisor: query failed: %s", PQerrorMessage(conn));
+		PQclear(res);
+		ramd_conn_checkin(config->node_id, conn);
+		return false;
+	}
+
+	next->in_recovery = strcmp(PQgetvalue(res, 0, 0), "t") == 0;
+	next->sampled_ms = ramd_clock_now_ms();
+	if (!next->in_recovery)
+	{
+		/* A primary, perhaps just promoted: start afresh if it is demoted again */
+		PQclear(res);
+		ramd_conn_checkin(config->node_id, conn);
+		next->write_lag_ms = next->flush_lag_ms = next->replay_lag_ms = -1;
+		g_replay_advice[0] = '\0';
+		return true;
+	}
+	next->receive_lag_bytes = ramd_replay_value(res, 0, 1);
+	next->flush_lag_bytes = ramd_replay_value(res, 0, 2);
+	next->replay_lag_bytes = ramd_replay_value(res, 0, 3);
+	PQclear(res);
+
+	ramd_replay_split_time(config, next);
+	next->prefetch_available = PQserverVersion(conn) >= 150000 &&
+	                           ramd_replay_read_prefetch(conn, next, timeout_ms);
+	ramd_replay_read_settings(conn, next, timeout_ms);
+
+	next->bottleneck = ramd_replay_classify(config, next);
+	if (next->bottleneck == RAMD_REPLAY_BOTTLENECK_REPLAY)
+		next->replay_bound_samples = prev->replay_bound_samples + 1;
+	else if (prev->replay_bound_samples > 0)
+		g_replay_advice[0] = '\0';
+
+	if (next->replay_bound_samples >= RAMD_REPLAY_BOUND_SAMPLES &&
+	    ramd_replay_tune(conn, config, next, prev->last_tuned_ms))
+	{
+		next->tunings++;
+		next->last_tuned_ms = ramd_clock_now_ms();
+		ramd_replay_read_settings(conn, next, timeout_ms);
+	}
+	g_replay_prev_prefetch = next->prefetch;
+	g_replay_prev_hit = next->hit;
+
+	ramd_conn_checkin(config->node_id, conn);
+	return true;
+}
+
+static void*
+ramd_replay_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_replay.lock);
+	while (g_replay.running)
+	{
+		const ramd_config_t* config = g_replay.config;
+		ramd_replay_stats_t prev = g_replay.stats;
+		ramd_replay_stats_t next;
+		int64_t interval_ms = config->replay_advisor_interval_ms;
+		struct timespec deadline;
+
+		pthread_mutex_unlock(&g_replay.lock);
+
+		/* Only the counters carry over; everything else is this round's */
+		memset(&next, 0, sizeof(next));
+		next.running = true;
+		next.tunings = prev.tunings;
+		next.last_tuned_ms = prev.last_tuned_ms;
+		if (ramd_replay_sample(config, &prev, &next))
+		{
+			pthread_mutex_lock(&g_replay.lock);
+			g_replay.stats = next;
+		}
+		else
+			pthread_mutex_lock(&g_replay.lock);
+
+		if (!g_replay.running)
+			break;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += interval_ms / 1000;
+		deadline.tv_nsec += (interval_ms % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&g_replay.cond, &g_replay.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_replay.lock);
+	return NULL;
+}
+
+bool
+ramd_replay_start(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_replay.lock);
+	g_replay.config = config;
+	if (g_replay.running || !config->replay_advisor_enabled)
+	{
+		pthread_mutex_unlock(&g_replay.lock);
+		return true;
+	}
+
+	memset(&g_replay.stats, 0, sizeof(g_replay.stats));
+	g_replay_prev_prefetch = g_replay_prev_hit = 0;
+	g_replay_advice[0] = '\0';
+	g_replay.running = true;
+	if (pthread_create(&g_replay.thread, NULL, ramd_replay_thread_main, NULL) != 0)
+	{
+		g_replay.running = false;
+		pthread_mutex_unlock(&g_replay.lock);
+		ramd_log_error("Replay advisor: cannot start thread: %s", strerror(errno));
+		return false;
+	}
+	g_replay.stats.running = true;
+	pthread_mutex_unlock(&g_replay.lock);
+
+	ramd_log_info("Replay advisor started: every %d ms, %s (maintenance_io_concurrency up to %d, "
+	              "wal_decode_buffer_size up to %d kB)",
+	              config->replay_advisor_interval_ms,
+	              config->replay_autotune ? "tuning replay" : "advising only",
+	              config->replay_max_io_concurrency, config->replay_max_decode_buffer_kb);
+	return true;
+}
+
+void
+ramd_replay_stop(void)
+{
+	pthread_mutex_lock(&g_replay.lock);
+	if (!g_replay.running)
+	{
+		pthread_mutex_unlock(&g_replay.lock);
+		return;
+	}
+	/* A round in progress finishes first, bounded by health_check_timeout_ms per query */
+	g_replay.running = false;
+	g_replay.stats.running = false;
+	pthread_cond_broadcast(&g_replay.cond);
+	pthread_mutex_unlock(&g_replay.lock);
+
+	pthread_join(g_replay.thread, NULL);
+}
+
+bool
+ramd_replay_get_stats(ramd_replay_stats_t* stats)
+{
+	bool running;
+
+	if (!stats)
+		return false;
+	pthread_mutex_lock(&g_replay.lock);
+	*stats = g_replay.stats;
+	running = g_replay.running;
+	pthread_mutex_unlock(&g_replay.lock);
+	return running;
+}
+
+const char*
+ramd_replay_bottleneck_name(ramd_replay_bottleneck_t bottleneck)
+{
+	switch (bottleneck)
+	{
+		case RAMD_REPLAY_BOTTLENECK_NETWORK:
+			return "network";
+		case RAMD_REPLAY_BOTTLENECK_FLUSH:
+			return "flush";
+		case RAMD_REPLAY_BOTTLENECK_REPLAY:
+			return "replay";
+		case RAMD_REPLAY_BOTTLENECK_NONE:
+		default:
+			return "none";
+	}
+}
+
+bool
+ramd_replay_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_replay_stats_t stats;
+	ramd_replay_bottleneck_t b;
+	bool ok = true;
+
+	if (!output)
+		return false;
+	if (!ramd_replay_get_stats(&stats))
+		return true; /* replay_advisor_enabled is off */
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_replay_tunings_total Settings changed by the replay advisor\n"
+		"# TYPE ramd_replay_tunings_total counter\n"
+		"ramd_replay_tunings_total %lld\n",
+		(long long) stats.tunings);
+	if (!stats.in_recovery || stats.sampled_ms == 0)
+		return ok;
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_replay_lag_bytes WAL this standby is behind, by stage\n"
+		"# TYPE ramd_replay_lag_bytes gauge\n"
+		"ramd_replay_lag_bytes{stage=\"network\"} %lld\n"
+		"ramd_replay_lag_bytes{stage=\"flush\"} %lld\n"
+		"ramd_replay_lag_bytes{stage=\"replay\"} %lld\n",
+		(long long) stats.receive_lag_bytes, (long long) stats.flush_lag_bytes,
+		(long long) stats.replay_lag_bytes);
+
+	if (stats.write_lag_ms >= 0)
+	{
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_replay_lag_seconds Time this standby is behind, by stage, from pg_stat_replication\n"
+			"# TYPE ramd_replay_lag_seconds gauge\n"
+			"ramd_replay_lag_seconds{stage=\"network\"} %.3f\n",
+			stats.write_lag_ms / 1000.0);
+		if (stats.flush_lag_ms >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_replay_lag_seconds{stage=\"flush\"} %.3f\n",
+			                          stats.flush_lag_ms / 1000.0);
+		if (stats.replay_lag_ms >= 0)
+			ok &= ramd_buffer_appendf(output, "ramd_replay_lag_seconds{stage=\"replay\"} %.3f\n",
+			                          stats.replay_lag_ms / 1000.0);
+	}
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_replay_bottleneck Stage this standby's lag comes from\n"
+		"# TYPE ramd_replay_bottleneck gauge\n");
+	for (b = RAMD_REPLAY_BOTTLENECK_NONE; b <= RAMD_REPLAY_BOTTLENECK_REPLAY; b++)
+		ok &= ramd_buffer_appendf(output, "ramd_replay_bottleneck{stage=\"%s\"} %d\n",
+		                          ramd_replay_bottleneck_name(b), stats.bottleneck == b);
+
+	if (stats.prefetch_available)
+		ok &= ramd_buffer_appendf(output,
+			"\n# HELP ramd_replay_prefetch_blocks_total Blocks seen by recovery prefetch, by outcome\n"
+			"# TYPE ramd_replay_prefetch_blocks_total counter\n"
+			"ramd_replay_prefetch_blocks_total{result=\"prefetch\"} %lld\n"
+			"ramd_replay_prefetch_blocks_total{result=\"hit\"} %lld\n"
+			"ramd_replay_prefetch_blocks_total{result=\"skip_init\"} %lld\n"
+			"ramd_replay_prefetch_blocks_total{result=\"skip_new\"} %lld\n"
+			"ramd_replay_prefetch_blocks_total{result=\"skip_fpw\"} %lld\n"
+			"ramd_replay_prefetch_blocks_total{result=\"skip_rep\"} %lld\n"
+			"\n# HELP ramd_replay_prefetch_wal_distance_bytes How far ahead recovery prefetch is reading WAL\n"
+			"# TYPE ramd_replay_prefetch_wal_distance_bytes gauge\n"
+			"ramd_replay_prefetch_wal_distance_bytes %lld\n"
+			"\n# HELP ramd_replay_prefetch_block_distance Blocks recovery prefetch is ahead of replay\n"
+			"# TYPE ramd_replay_prefetch_block_distance gauge\n"
+			"ramd_replay_prefetch_block_distance %d\n"
+			"\n# HELP ramd_replay_prefetch_io_depth Prefetches in flight\n"
+			"# TYPE ramd_replay_prefetch_io_depth gauge\n"
+			"ramd_replay_prefetch_io_depth %d\n",
+			(long long) stats.prefetch, (long long) stats.hit, (long long) stats.skip_init,
+			(long long) stats.skip_new, (long long) stats.skip_fpw, (long long) stats.skip_rep,
+			(long long) stats.wal_distance, stats.block_distance, stats.io_depth);
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_replay_maintenance_io_concurrency Current maintenance_io_concurrency\n"
+		"# TYPE ramd_replay_maintenance_io_concurrency gauge\n"
+		"ramd_replay_maintenance_io_concurrency %d\n"
+		"\n# HELP ramd_replay_wal_decode_buffer_bytes Current wal_decode_buffer_size\n"
+		"# TYPE ramd_replay_wal_decode_buffer_bytes gauge\n"
+		"ramd_replay_wal_decode_buffer_bytes %lld\n"
+		"\n# HELP ramd_replay_restart_pending Whether a changed wal_decode_buffer_size waits for a restart\n"
+		"# TYPE ramd_replay_restart_pending gauge\n"
+		"ramd_replay_restart_pending %d\n",
+		stats.maintenance_io_concurrency, (long long) stats.wal_decode_buffer_kb * 1024,
+		stats.restart_pending ? 1 : 0);
+	return ok;
+}
@@ -0,0 +1,516 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_rolling.c
+ *		PostgreSQL Auto-Failover Daemon - Rolling Maintenance
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A rolling run takes every node through a restart, a minor upgrade or an
+ * OS patch with the cluster writable throughout except for the one planned
+ * switchover.  ramd cannot install packages or reboot other hosts itself,
+ * so the node-local work is done by rolling_node_command, run without a
+ * shell as
+ *
+ *   rolling_node_command <operation> <node_id> <host> <port>
+ *
+ * and expected to return once the node's PostgreSQL is starting again.
+ * ramd orders the steps and decides when the next one may begin:
+ *
+ *   precheck     the maintenance pre-checks pass and every standby is
+ *                healthy
+ *   standbys     standbys go through the command on worker threads, a
+ *                node counting as done once it is back in recovery and
+ *                has flushed the primary's WAL position of that moment
+ *   switchover   the primary role moves to a standby that has already
+ *                been through the operation
+ *   old_primary  this node, now a standby, goes through it last
+ *
+ * The number of standbys down at once is capped so that neither the
+ * synchronous standby count nor the Raft majority is ever lost.  The first
+ * failure stops further standbys from starting and skips the switchover,
+ * leaving the primary untouched.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+
+#include "ramd_rolling.h"
+#include "ramd_buffer.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_job.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_maintenance.h"
+#include "ramd_process.h"
+#include "ramd_query.h"
+#include "ramd_switchover.h"
+
+/* What a step needs of a node, copied so the cluster view may change */
+typedef struct rolling_target_t
+{
+	int32_t node_id;
+	char hostname[RAMD_MAX_HOSTNAME_LENGTH];
+	int32_t port;
+} rolling_target_t;
+
+typedef struct rolling_run_t
+{
+	pthread_mutex_t lock; /* guards next, done, workers and failed */
+	pthread_cond_t cond;  /* signalled as each standby finishes */
+	ramd_config_t config; /* private copy, the run outlives config reloads */
+	ramd_rolling_report_t* report;
+	rolling_target_t targets[RAMD_MAX_NODES];
+	int32_t standby_count; /* targets[0 .. standby_count) are the standbys */
+	int32_t next;
+	int32_t done;
+	int32_t workers;
+	bool failed;
+	int64_t started_ms;
+} rolling_run_t;
+
+static atomic_bool g_rolling_running;
+
+/* Wait for the node to accept connections in recovery and catch up */
+static bool
+rolling_wait_ready(const ramd_config_t* config, const rolling_target_t* target,
+                   int64_t deadline_ms, char* message, size_t message_size)
+{
+	int64_t remaining;
+
+	for (;;)
+	{
+		PGconn* conn = ramd_conn_get(target->hostname, target->port, config->database_name,
+		                             config->database_user, config->database_password);
+		bool in_recovery = false;
+
+		if (conn)
+		{
+			in_recovery = ramd_query_is_in_recovery(conn);
+			ramd_conn_close(conn);
+		}
+		if (in_recovery)
+			break;
+		if (ramd_clock_now_ms() >= deadline_ms)
+		{
+			snprintf(message, message_size, "did not come back as a standby in time");
+			return false;
+		}
+		usleep(RAMD_ROLLING_POLL_MS * 1000);
+	}
+
+	remaining = deadline_ms - ramd_clock_now_ms();
+	if (remaining <= 0 ||
+	    !ramd_lag_wait_for_flush(target->node_id, -1, (int32_t) remaining))
+	{
+		snprintf(message, message_size, "did not catch up with the primary in time");
+		return false;
+	}
+	return true;
+}
+
+/* One node through the command and back; fills in its report entry */
+static bool
+rolling_step(rolling_run_t* run, const rolling_target_t* target, ramd_rolling_node_t* entry)
+{
+	const ramd_config_t* config = &run->config;
+	const char* operation = ramd_rolling_operation_to_string(run->report->operation);
+	ramd_process_result_t* result;
+	char node_id[16];
+	char port[16];
+	const char* argv[6];
+	int64_t started = ramd_clock_now_ms();
+	int64_t deadline = started + config->rolling_node_timeout_ms;
+	int64_t command_done;
+	bool ok;
+
+	entry->started_ms = started - run->started_ms;
+	ramd_log_info("Rolling %s: node %d (%s:%d) starting", operation, target->node_id,
+	              target->hostname, target->port);
+
+	result = malloc(sizeof(*result));
+	if (!result)
+	{
+		snprintf(entry->message, sizeof(entry->message), "out of memory");
+		return false;
+	}
+	snprintf(node_id, sizeof(node_id), "%d", target->node_id);
+	snprintf(port, sizeof(port), "%d", target->port);
+	argv[0] = config->rolling_node_command;
+	argv[1] = operation;
+	argv[2] = node_id;
+	argv[3] = target->hostname;
+	argv[4] = port;
+	argv[5] = NULL;
+
+	ok = ramd_process_run(argv, config->rolling_node_timeout_ms, result);
+	command_done = ramd_clock_now_ms();
+	entry->command_ms = command_done - started;
+	if (!ok)
+	{
+		ramd_process_log_failure("rolling_node_command", result);
+		if (result->timed_out)
+			snprintf(entry->message, sizeof(entry->message), "command timed out");
+		else
+			snprintf(entry->message, sizeof(entry->message), "command exited with status %d",
+			         result->exit_code);
+		free(result);
+		return false;
+	}
+	free(result);
+
+	ok = rolling_wait_ready(config, target, deadline, entry->message, sizeof(entry->message));
+	entry->catchup_ms = ramd_clock_now_ms() - command_done;
+	entry->ok = ok;
+	if (ok)
+		ramd_log_info("Rolling %s: node %d done in %lld ms", operation, target->node_id,
+		              (long long) (ramd_clock_now_ms() - started));
+	else
+		ramd_log_error("Rolling %s: node %d %s", operation, target->node_id, entry->message);
+	return ok;
+}
+
+/* Takes standbys off the queue until it is empty or one has failed */
+static void*
+rolling_worker(void* arg)
+{
+	rolling_run_t* run = arg;
+
+	pthread_mutex_lock(&run->lock);
+	while (!run->failed && run->next < run->standby_count)
+	{
+		int32_t index = run->next++;
+		bool ok;
+
+		pthread_mutex_unlock(&run->lock);
+		ok = rolling_step(run, &run->targets[index], &run->report->nodes[index]);
+		pthread_mutex_lock(&run->lock);
+
+		run->done++;
+		if (!ok)
+			run->failed = true;
+		pthread_cond_signal(&run->cond);
+	}
+	run->workers--;
+	pthread_cond_signal(&run->cond);
+	pthread_mutex_unlock(&run->lock);
+	return NULL;
+}
+
+/*
+ * Standbys that may be down together: the requested parallelism, less
+ * whatever would take the primary below num_sync_standbys or the voters
+ * below a majority.
+ */
+static int32_t
+rolling_parallel_limit(const ramd_cluster_t* cluster, const ramd_config_t* config,
+                       int32_t requested, int32_t standbys, char* why, size_t why_size)
+{
+	int32_t limit = requested;
+	int32_t voters = ramd_cluster_count_voting_nodes(cluster);
+	int32_t spare_voters = ramd_cluster_count_healthy_voting_nodes(cluster) - (voters / 2 + 1);
+
+	if (config->synchronous_replication && config->num_sync_standbys > 0 &&
+	    standbys - config->num_sync_standbys < limit)
+	{
+		limit = standbys - config->num_sync_standbys;
+		snprintf(why, why_size, "%d of %d standbys must stay up as synchronous standbys",
+		         config->num_sync_standbys, standbys);
+	}
+	if (spare_voters < limit)
+	{
+		limit = spare_voters;
+		snprintf(why, why_size, "%d voting nodes leave no voter to spare for a majority",
+		         voters);
+	}
+	return limit;
+}
+
+static bool
+rolling_refuse(ramd_rolling_report_t* report, const char* message)
+{
+	snprintf(report->message, sizeof(report->message), "%s", message);
+	ramd_log_error("Rolling %s refused: %s",
+	               ramd_rolling_operation_to_string(report->operation), message);
+	return false;
+}
+
+/* Everything up to the switchover; false leaves the primary untouched */
+static bool
+rolling_run_standbys(rolling_run_t* run, int32_t parallel)
+{
+	pthread_t threads[RAMD_MAX_NODES];
+	int32_t started = 0;
+
+	pthread_mutex_lock(&run->lock);
+	for (int32_t i = 0; i < parallel; i++)
+	{
+		if (pthread_create(&threads[started], NULL, rolling_worker, run) != 0)
+		{
+			ramd_log_warning("Rolling: could only start %d of %d workers", started, parallel);
+			break;
+		}
+		started++;
+		run->workers++;
+	}
+	if (started == 0)
+		run->failed = true;
+
+	/* Job progress can only be reported from the job's own thread */
+	while (run->workers > 0)
+	{
+		pthread_cond_wait(&run->cond, &run->lock);
+		ramd_job_progress(run->done * 100 / (run->standby_count + 1));
+	}
+	pthread_mutex_unlock(&run->lock);
+
+	for (int32_t i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	return !run->failed && run->done == run->standby_count;
+}
+
+static void
+rolling_run_free(rolling_run_t* run)
+{
+	pthread_cond_destroy(&run->cond);
+	pthread_mutex_destroy(&run->lock);
+	free(run);
+}
+
+bool
+ramd_rolling_run(ramd_cluster_t* cluster, const ramd_config_t* config,
+                 ramd_rolling_operation_t operation, int32_t max_parallel,
+                 int32_t target_node_id, ramd_rolling_report_t* report)
+{
+	ramd_maintenance_config_t maintenance;
+	ramd_maintenance_check_t checks;
+	ramd_switchover_status_t switchover;
+	rolling_run_t* run;
+	rolling_target_t* self;
+	char error[RAMD_MAX_COMMAND_LENGTH];
+	char why[RAMD_MAX_COMMAND_LENGTH] = "max_parallel";
+	int32_t parallel;
+	int64_t switchover_started;
+	bool expected = false;
+	bool ok;
+
+	if (!cluster || !config || !report)
+		return false;
+
+	memset(report, 0, sizeof(*report));
+	report->operation = operation;
+	report->old_primary_node_id = cluster->primary_node_id;
+	report->new_primary_node_id = -1;
+	report->switchover_ms = -1;
+
+	if (config->rolling_node_command[0] == '\0')
+		return rolling_refuse(report, "rolling_node_command is not configured");
+	if (cluster->primary_node_id != config->node_id)
+	{
+		snprintf(error, sizeof(error), "node %d is not the primary; ask node %d",
+		         config->node_id, cluster->primary_node_id);
+		return rolling_refuse(report, error);
+	}
+	if (!atomic_compare_exchange_strong(&g_rolling_running, &expected, true))
+		return rolling_refuse(report, "a rolling run is already in progress");
+
+	run = calloc(1, sizeof(*run));
+	if (!run)
+	{
+		atomic_store(&g_rolling_running, false);
+		return rolling_refuse(report, "out of memory");
+	}
+	pthread_mutex_init(&run->lock, NULL);
+	pthread_cond_init(&run->cond, NULL);
+	run->config = *config;
+	run->report = report;
+	run->started_ms = ramd_clock_now_ms();
+
+	ramd_job_phase("precheck");
+	ok = true;
+	for (int32_t i = 0; i < cluster->node_count && ok; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+		rolling_target_t* target;
+
+		if (node->node_id == config->node_id)
+			continue;
+		if (node->role != RAMD_ROLE_STANDBY || !node->is_healthy)
+		{
+			snprintf(error, sizeof(error), "node %d is not a healthy standby", node->node_id);
+			ok = false;
+			break;
+		}
+		target = &run->targets[run->standby_count];
+		target->node_id = node->node_id;
+		snprintf(target->hostname, sizeof(target->hostname), "%s", node->hostname);
+		target->port = node->postgresql_port;
+		report->nodes[run->standby_count].node_id = node->node_id;
+		report->nodes[run->standby_count].role = RAMD_ROLE_STANDBY;
+		run->standby_count++;
+	}
+	if (ok && run->standby_count == 0)
+	{
+		snprintf(error, sizeof(error), "no standby to hand the primary role to");
+		ok = false;
+	}
+
+	memset(&maintenance, 0, sizeof(maintenance));
+	maintenance.type = RAMD_MAINTENANCE_CLUSTER;
+	maintenance.target_node_id = config->node_id;
+	if (ok && !ramd_maintenance_pre_check(&maintenance, &checks))
+	{
+		ramd_format_message(error, sizeof(error), "pre-checks failed: %s", checks.check_details);
+		ok = false;
+	}
+
+	parallel = max_parallel > 0 ? max_parallel : config->rolling_max_parallel;
+	if (ok)
+	{
+		parallel = rolling_parallel_limit(cluster, config, parallel, run->standby_count,
+		                                  why, sizeof(why));
+		if (parallel <= 0)
+		{
+			snprintf(error, sizeof(error), "no standby can be taken down: %s", why);
+			ok = false;
+		}
+	}
+	if (!ok)
+	{
+		rolling_run_free(run);
+		atomic_store(&g_rolling_running, false);
+		return rolling_refuse(report, error);
+	}
+
+	/* The old primary's entry comes last */
+	self = &run->targets[run->standby_count];
+	self->node_id = config->node_id;
+	snprintf(self->hostname, sizeof(self->hostname), "%s", config->hostname);
+	self->port = config->postgresql_port;
+	report->nodes[run->standby_count].node_id = config->node_id;
+	report->nodes[run->standby_count].role = RAMD_ROLE_PRIMARY;
+	report->node_count = run->standby_count + 1;
+	for (int32_t i = 0; i < report->node_count; i++)
+	{
+		report->nodes[i].started_ms = -1;
+		report->nodes[i].command_ms = -1;
+		report->nodes[i].catchup_ms = -1;
+	}
+	if (parallel > run->standby_count)
+		parallel = run->standby_count;
+	report->parallel = parallel;
+
+	ramd_log_info("Rolling %s of %d nodes started, %d standbys at a time (limited by %s)",
+	              ramd_rolling_operation_to_string(operation), report->node_count,
+	              parallel, why);
+
+	ramd_job_phase("standbys");
+	ok = rolling_run_standbys(run, parallel);
+	if (!ok)
+		snprintf(report->message, sizeof(report->message),
+		         "a standby failed; switchover skipped and the primary left untouched");
+
+	if (ok)
+	{
+		ramd_job_phase("switchover");
+		switchover_started = ramd_clock_now_ms();
+		if (!ramd_switchover_start(cluster, target_node_id, error, sizeof(error)))
+		{
+			ramd_format_message(report->message, sizeof(report->message),
+			                    "switchover refused: %s", error);
+			ok = false;
+		}
+		else
+		{
+			ok = ramd_switchover_wait();
+			ramd_switchover_get_status(&switchover);
+			report->switchover_ms = ramd_clock_now_ms() - switchover_started;
+			if (ok)
+				report->new_primary_node_id = switchover.target_node_id;
+			else
+				ramd_format_message(report->message, sizeof(report->message), "switchover %s: %s",
+				                    ramd_switchover_state_to_string(switchover.state),
+				                    switchover.message);
+		}
+	}
+
+	if (ok)
+	{
+		ramd_job_phase("old_primary");
+		ok = rolling_step(run, self, &report->nodes[run->standby_count]);
+		if (!ok)
+			snprintf(report->message, sizeof(report->message), "old primary: %s",
+			         report->nodes[run->standby_count].message);
+		ramd_job_progress(100);
+	}
+
+	report->ok = ok;
+	report->total_ms = ramd_clock_now_ms() - run->started_ms;
+	if (ok)
+		snprintf(report->message, sizeof(report->message), "all %d nodes done",
+		         report->node_count);
+
+	{
+		ramd_log_field_t fields[] = {
+			RAMD_LOG_INT("nodes", report->node_count),
+			RAMD_LOG_INT("parallel", report->parallel),
+			RAMD_LOG_INT("switchover_ms", report->switchover_ms),
+			RAMD_LOG_INT("total_ms", report->total_ms),
+		};
+
+		RAMD_LOG_KV(INFO, fields, "Rolling %s %s: %s",
+		            ramd_rolling_operation_to_string(operation),
+		            ok ? "succeeded" : "failed", report->message);
+	}
+
+	rolling_run_free(run);
+	atomic_store(&g_rolling_running, false);
+	return ok;
+}
+
+bool
+ramd_rolling_in_progress(void)
+{
+	return atomic_load(&g_rolling_running);
+}
+
+bool
+ramd_rolling_parse_operation(const char* name, ramd_rolling_operation_t* operation)
+{
+	if (!name || !operation)
+		return false;
+
+	if (strcmp(name, "restart") == 0)
+		*operation = RAMD_ROLLING_RESTART;
+	else if (strcmp(name, "minor_upgrade") == 0)
+		*operation = RAMD_ROLLING_MINOR_UPGRADE;
+	else if (strcmp(name, "os_patch") == 0)
+		*operation = RAMD_ROLLING_OS_PATCH;
+	else
+		return false;
+	return true;
+}
+
+const char*
+ramd_rolling_operation_to_string(ramd_rolling_operation_t operation)
+{
+	switch (operation)
+	{
+		case RAMD_ROLLING_RESTART:
+			return "restart";
+		case RAMD_ROLLING_MINOR_UPGRADE:
+			return "minor_upgrade";
+		case RAMD_ROLLING_OS_PATCH:
+			return "os_patch";
+	}
+	return "unknown";
+}
@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <openssl/crypto.h>
 #include <openssl/sha.h>
 #include <openssl/hmac.h>
 #include <openssl/rand.h>
@@ -30,51 +31,108 @@
 #include <signal.h>
 
 #include "ramd_security.h"
+#include "ramd_clock.h"
+#include "ramd_audit_log.h"
 #include "ramd_logging.h"
 #include "ramd_config.h"
+#include "ramd_daemon.h"
+#include "ramd_tls.h"
+#include "ramd_http_profile.h"
 
 /* Security context */
 static ramd_security_context_t *g_security_ctx = NULL;
 static pthread_mutex_t g_security_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* Rate limiting structures */
-typedef struct ramd_rate_limit_entry
-{
-	char client_ip[INET_ADDRSTRLEN];
-	time_t first_request;
-	int request_count;
-	time_t last_request;
-	bool blocked;
-} ramd_rate_limit_entry_t;
-
-#define RAMD_MAX_RATE_LIMIT_ENTRIES 1000
+/*
+ * Rate limiting structures
+ *
+ * Clients are keyed on their binary address (IPv4 as v4-mapped IPv6) and
+ * hashed with a per-process seed into one of RAMD_RATE_LIMIT_SHARDS
+ * shards, each with its own lock, hash chains and LRU list, so unrelated
+ * clients never contend.  Every client has a token bucket refilled at
+ * max_requests_per_minute; emptying it blocks the client for
+ * RAMD_BLOCK_DURATION_SECONDS.  A full shard recycles its least recently
+ * seen entry.
+ */
+#define RAMD_MAX_RATE_LIMIT_ENTRIES 1024
 #define RAMD_RATE_LIMIT_WINDOW_SECONDS 60
 #define RAMD_MAX_REQUESTS_PER_WINDOW 100
 #define RAMD_BLOCK_DURATION_SECONDS 300
+#define RAMD_RATE_LIMIT_SHARDS 16
+#define RAMD_RATE_LIMIT_SHARD_ENTRIES (RAMD_MAX_RATE_LIMIT_ENTRIES / RAMD_RATE_LIMIT_SHARDS)
+#define RAMD_RATE_LIMIT_BUCKETS (RAMD_RATE_LIMIT_SHARD_ENTRIES * 2)
 
-static ramd_rate_limit_entry_t g_rate_limit_entries[RAMD_MAX_RATE_LIMIT_ENTRIES];
-static int g_rate_limit_count = 0;
-
-/* Security audit log - using the same structure as in header */
+typedef struct ramd_rate_limit_entry
+{
+	uint8_t addr[16];
+	double tokens;
+	int64_t last_refill_us;
+	int64_t blocked_until_us;
+	int32_t hash_next;	/* bucket chain, or free list when unused */
+	int32_t lru_prev;
+	int32_t lru_next;
+} ramd_rate_limit_entry_t;
 
-#define RAMD_MAX_AUDIT_ENTRIES 10000
-static ramd_audit_entry_t g_audit_log[RAMD_MAX_AUDIT_ENTRIES];
-static int g_audit_count = 0;
-static int g_audit_index = 0;
+typedef struct ramd_rate_limit_shard
+{
+	_Alignas(RAMD_CACHE_LINE_SIZE) pthread_mutex_t lock;
+	int32_t buckets[RAMD_RATE_LIMIT_BUCKETS];
+	int32_t lru_head;	/* most recently seen */
+	int32_t lru_tail;	/* eviction candidate */
+	int32_t free_head;
+	ramd_rate_limit_entry_t entries[RAMD_RATE_LIMIT_SHARD_ENTRIES];
+} ramd_rate_limit_shard_t;
+
+static ramd_rate_limit_shard_t g_rate_limit_shards[RAMD_RATE_LIMIT_SHARDS];
+static uint64_t g_rate_limit_seed = 0;
+
+/*
+ * Validated token cache
+ *
+ * Successful validations are remembered for RAMD_TOKEN_CACHE_TTL_SECONDS,
+ * keyed on the SHA-256 of the bearer token so no token text is kept here.
+ * A hit costs one digest and one constant-time compare instead of a scan
+ * of every user.  Entries remember the generation they were validated
+ * under; bumping g_token_generation on token rotation or revocation
+ * invalidates all of them at once.
+ */
+typedef struct ramd_token_cache_entry
+{
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	char user[RAMD_MAX_USERNAME_LENGTH];
+	ramd_user_role_t role;
+	uint64_t generation;	/* 0 marks an empty slot */
+	int64_t expires_us;
+} ramd_token_cache_entry_t;
+
+static ramd_token_cache_entry_t g_token_cache[RAMD_TOKEN_CACHE_SIZE];
+static pthread_mutex_t g_token_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_token_generation = 1;
+
+/*
+ * Successful read-only requests are counted and written to the audit log
+ * as one summary every RAMD_AUDIT_READ_SUMMARY_SECONDS, so scrapes and
+ * health probes do not drown out state-changing operations.
+ */
+static pthread_mutex_t g_audit_read_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int64_t g_audit_read_count = 0;
+static int64_t g_audit_read_since_us = 0;
 
 /* Forward declarations */
 static bool ramd_security_init_ssl(void);
 static void ramd_security_cleanup_ssl(void);
 static bool ramd_security_generate_token(char *token, size_t token_size);
-static bool ramd_security_validate_token(const char *token);
+static bool ramd_security_validate_token(const unsigned char *digest, char *user,
+										  size_t user_size, ramd_user_role_t *role);
 static bool ramd_security_check_rate_limit(const char *client_ip);
 static void ramd_security_log_audit(const char *client_ip, const char *user,
 									const char *action, const char *resource,
 									int result, const char *details);
 static bool ramd_security_validate_input(const char *input, size_t max_length);
 static bool ramd_security_sanitize_input(char *input, size_t max_length);
-static bool ramd_security_check_permissions(const char *user, const char *action);
+static bool ramd_security_check_permissions(ramd_user_role_t role, const char *action);
 static void ramd_security_cleanup_rate_limits(void);
+static void ramd_security_audit_reads(int64_t count, bool force);
 
 /* Initialize security subsystem */
 bool
@@ -93,13 +151,19 @@ ramd_security_init(ramd_security_context_t *ctx)
 	}
 
 	/* Initialize rate limiting */
-	memset(g_rate_limit_entries, 0, sizeof(g_rate_limit_entries));
-	g_rate_limit_count = 0;
+	if (RAND_bytes((unsigned char *) &g_rate_limit_seed, sizeof(g_rate_limit_seed)) != 1)
+		g_rate_limit_seed = (uint64_t) time(NULL) ^ (uint64_t) getpid();
+	for (int i = 0; i < RAMD_RATE_LIMIT_SHARDS; i++)
+		pthread_mutex_init(&g_rate_limit_shards[i].lock, NULL);
+	ramd_security_cleanup_rate_limits();
+
+	/* Initialize the read summary; records go to ramd_audit_log */
+	g_audit_read_count = 0;
+	g_audit_read_since_us = 0;
 
-	/* Initialize audit log */
-	memset(g_audit_log, 0, sizeof(g_audit_log));
-	g_audit_count = 0;
-	g_audit_index = 0;
+	/* Initialize token cache */
+	memset(g_token_cache, 0, sizeof(g_token_cache));
+	g_token_generation = 1;
 
 	/* Generate default admin token if not provided */
 	if (strlen(ctx->admin_token) == 0)
@@ -111,6 +175,8 @@ ramd_security_init(ramd_security_context_t *ctx)
 		}
 		ramd_log_info("Generated admin token: %s", ctx->admin_token);
 	}
+	SHA256((const unsigned char *) ctx->admin_token, strlen(ctx->admin_token),
+		   ctx->admin_token_digest);
 
 	/* Initialize user roles */
 	ctx->users[0].username[0] = '\0';
@@ -124,7 +190,7 @@ ramd_security_init(ramd_security_context_t *ctx)
 	ctx->session_timeout = 3600; /* 1 hour */
 	ctx->enable_audit = true;
 	ctx->enable_rate_limiting = true;
-	ctx->enable_ssl = false; /* Will be enabled if certificates are provided */
+	ctx->enable_ssl = ramd_tls_enabled();
 
 	/* Initialize mutexes */
 	if (pthread_mutex_init(&ctx->mutex, NULL) != 0)
@@ -148,9 +214,13 @@ ramd_security_init(ramd_security_context_t *ctx)
 void
 ramd_security_cleanup(ramd_security_context_t *ctx)
 {
-	if (!ctx)
+	if (!ctx || ctx != g_security_ctx)
 		return;
 
+	/* Write out the pending read summary while the audit log still exists */
+	ramd_security_audit_reads(0, true);
+	ramd_audit_log_close();
+
 	pthread_mutex_lock(&g_security_mutex);
 
 	/* Cleanup SSL/TLS */
@@ -159,10 +229,8 @@ ramd_security_cleanup(ramd_security_context_t *ctx)
 	/* Cleanup rate limits */
 	ramd_security_cleanup_rate_limits();
 
-	/* Cleanup audit log */
-	memset(g_audit_log, 0, sizeof(g_audit_log));
-	g_audit_count = 0;
-	g_audit_index = 0;
+	/* Cleanup token cache */
+	ramd_security_invalidate_token_cache();
 
 	/* Cleanup mutexes */
 	pthread_mutex_unlock(&g_security_mutex);
@@ -176,7 +244,7 @@ ramd_security_cleanup(ramd_security_context_t *ctx)
 	ramd_log_info("Security subsystem cleaned up");
 }
 
-/* Initialize SSL/TLS */
+/* Initialize SSL/TLS; the HTTP API's certificate is loaded by ramd_tls */
 static bool
 ramd_security_init_ssl(void)
 {
@@ -185,13 +253,14 @@ ramd_security_init_ssl(void)
 	SSL_load_error_strings();
 	OpenSSL_add_all_algorithms();
 
-	return true;
+	return ramd_tls_init(g_ramd_daemon ? &g_ramd_daemon->config : NULL);
 }
 
 /* Cleanup SSL/TLS */
 static void
 ramd_security_cleanup_ssl(void)
 {
+	ramd_tls_cleanup();
 	EVP_cleanup();
 	ERR_free_strings();
 }
@@ -224,122 +293,312 @@ ramd_security_generate_token(char *token, size_t token_size)
 	return true;
 }
 
-/* Validate token */
+/*
+ * Validate a token by its SHA-256 digest.  Every candidate is compared in
+ * constant time and the scan never stops early, so response timing says
+ * nothing about which prefix or which user matched.  Called with
+ * g_security_ctx->mutex held.
+ */
 static bool
-ramd_security_validate_token(const char *token)
+ramd_security_validate_token(const unsigned char *digest, char *user,
+							 size_t user_size, ramd_user_role_t *role)
 {
-	if (!token || !g_security_ctx)
+	const char *matched_user = NULL;
+	ramd_user_role_t matched_role = RAMD_ROLE_NONE;
+
+	if (!digest || !g_security_ctx)
 		return false;
 
 	/* Check admin token */
-	if (strcmp(token, g_security_ctx->admin_token) == 0)
-		return true;
+	if (CRYPTO_memcmp(digest, g_security_ctx->admin_token_digest, SHA256_DIGEST_LENGTH) == 0 &&
+		g_security_ctx->admin_token[0] != '\0')
+	{
+		matched_user = "admin";
+		matched_role = RAMD_ROLE_ADMIN;
+	}
 
 	/* Check user tokens */
 	for (int i = 0; i < g_security_ctx->user_count; i++)
 	{
-		if (strcmp(token, g_security_ctx->users[i].token) == 0)
-			return true;
+		ramd_user_t *entry = &g_security_ctx->users[i];
+
+		if (CRYPTO_memcmp(digest, entry->token_digest, SHA256_DIGEST_LENGTH) == 0 &&
+			entry->active && entry->token[0] != '\0' && !matched_user)
+		{
+			matched_user = entry->username;
+			matched_role = entry->role;
+		}
 	}
 
-	return false;
+	if (!matched_user)
+		return false;
+
+	strncpy(user, matched_user, user_size - 1);
+	user[user_size - 1] = '\0';
+	*role = matched_role;
+	return true;
+}
+
+/* Strip an optional "Bearer " scheme from an Authorization value */
+static const char *
+ramd_security_bearer_token(const char *authorization)
+{
+	if (!authorization)
+		return NULL;
+
+	while (*authorization == ' ')
+		authorization++;
+	if ((authorization[0] == 'B' || authorization[0] == 'b') &&
+		strncmp(authorization + 1, "earer ", 6) == 0)
+	{
+		authorization += 7;
+		while (*authorization == ' ')
+			authorization++;
+	}
+	return authorization;
+}
+
+static ramd_token_cache_entry_t *
+ramd_security_token_slot(const unsigned char *digest)
+{
+	uint32_t	slot = (uint32_t) digest[0] | (uint32_t) digest[1] << 8 |
+		(uint32_t) digest[2] << 16 | (uint32_t) digest[3] << 24;
+
+	return &g_token_cache[slot % RAMD_TOKEN_CACHE_SIZE];
+}
+
+/* Look up a live cache entry for digest; returns the current generation on a miss */
+static bool
+ramd_security_token_cache_lookup(const unsigned char *digest, int64_t now,
+								 char *user, size_t user_size,
+								 ramd_user_role_t *role, uint64_t *generation)
+{
+	ramd_token_cache_entry_t *entry = ramd_security_token_slot(digest);
+	bool		hit;
+
+	pthread_mutex_lock(&g_token_cache_mutex);
+	hit = entry->generation == g_token_generation && entry->expires_us > now &&
+		CRYPTO_memcmp(entry->digest, digest, SHA256_DIGEST_LENGTH) == 0;
+	if (hit)
+	{
+		strncpy(user, entry->user, user_size - 1);
+		user[user_size - 1] = '\0';
+		*role = entry->role;
+	}
+	*generation = g_token_generation;
+	pthread_mutex_unlock(&g_token_cache_mutex);
+
+	return hit;
+}
+
+/*
+ * Remember a validation.  Skipped if the tokens changed since generation
+ * was read, so a revocation racing with validation cannot be undone.
+ */
+static void
+ramd_security_token_cache_insert(const unsigned char *digest, int64_t now,
+								 const char *user, ramd_user_role_t role,
+								 uint64_t generation)
+{
+	ramd_token_cache_entry_t *entry = ramd_security_token_slot(digest);
+
+	pthread_mutex_lock(&g_token_cache_mutex);
+	if (generation == g_token_generation)
+	{
+		memcpy(entry->digest, digest, SHA256_DIGEST_LENGTH);
+		strncpy(entry->user, user, sizeof(entry->user) - 1);
+		entry->user[sizeof(entry->user) - 1] = '\0';
+		entry->role = role;
+		entry->generation = generation;
+		entry->expires_us = now + (int64_t) RAMD_TOKEN_CACHE_TTL_SECONDS * 1000000;
+	}
+	pthread_mutex_unlock(&g_token_cache_mutex);
+}
+
+/* Binary client key; unparsable names are hashed into the key instead */
+static void
+ramd_security_client_key(const char *client_ip, uint8_t key[16])
+{
+	struct in_addr v4;
+	uint64_t	h = 1469598103934665603ULL;
+
+	memset(key, 0, 16);
+	if (!client_ip)
+		return;
+
+	if (inet_pton(AF_INET, client_ip, &v4) == 1)
+	{
+		key[10] = 0xff;
+		key[11] = 0xff;
+		memcpy(key + 12, &v4, 4);
+		return;
+	}
+	if (inet_pton(AF_INET6, client_ip, key) == 1)
+		return;
+
+	for (const char *p = client_ip; *p; p++)
+		h = (h ^ (uint8_t) *p) * 1099511628211ULL;
+	key[0] = 0xfe;	/* outside any address range we would parse */
+	memcpy(key + 8, &h, sizeof(h));
+}
+
+/*
+ * Seeded FNV-1a over the key, so the bucket layout cannot be predicted,
+ * with a 64-bit finalizer so the high bits picking the shard are mixed too.
+ */
+static uint64_t
+ramd_security_client_hash(const uint8_t key[16])
+{
+	uint64_t	h = 1469598103934665603ULL ^ g_rate_limit_seed;
+
+	for (int i = 0; i < 16; i++)
+		h = (h ^ key[i]) * 1099511628211ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static void
+ramd_security_lru_unlink(ramd_rate_limit_shard_t *shard, int32_t idx)
+{
+	ramd_rate_limit_entry_t *e = &shard->entries[idx];
+
+	if (e->lru_prev >= 0)
+		shard->entries[e->lru_prev].lru_next = e->lru_next;
+	else
+		shard->lru_head = e->lru_next;
+	if (e->lru_next >= 0)
+		shard->entries[e->lru_next].lru_prev = e->lru_prev;
+	else
+		shard->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = -1;
+}
+
+static void
+ramd_security_lru_push_front(ramd_rate_limit_shard_t *shard, int32_t idx)
+{
+	ramd_rate_limit_entry_t *e = &shard->entries[idx];
+
+	e->lru_prev = -1;
+	e->lru_next = shard->lru_head;
+	if (shard->lru_head >= 0)
+		shard->entries[shard->lru_head].lru_prev = idx;
+	shard->lru_head = idx;
+	if (shard->lru_tail < 0)
+		shard->lru_tail = idx;
+}
+
+/* Take the least recently seen entry out of its hash chain for reuse */
+static int32_t
+ramd_security_evict_lru(ramd_rate_limit_shard_t *shard)
+{
+	int32_t		victim = shard->lru_tail;
+	int32_t    *link;
+
+	if (victim < 0)
+		return -1;
+
+	link = &shard->buckets[ramd_security_client_hash(shard->entries[victim].addr) %
+						   RAMD_RATE_LIMIT_BUCKETS];
+	while (*link >= 0 && *link != victim)
+		link = &shard->entries[*link].hash_next;
+	if (*link == victim)
+		*link = shard->entries[victim].hash_next;
+
+	ramd_security_lru_unlink(shard, victim);
+	return victim;
 }
 
 /* Check rate limiting */
 static bool
 ramd_security_check_rate_limit(const char *client_ip)
 {
-	time_t now = time(NULL);
-	int entry_index = -1;
+	ramd_rate_limit_shard_t *shard;
+	ramd_rate_limit_entry_t *entry = NULL;
+	uint8_t		key[16];
+	uint64_t	hash;
+	int32_t    *bucket;
+	int32_t		idx;
+	int64_t		now;
+	double		per_minute;
+	bool		allowed = true;
+	bool		newly_blocked = false;
 
 	if (!g_security_ctx || !g_security_ctx->enable_rate_limiting)
 		return true;
 
-	pthread_mutex_lock(&g_security_mutex);
+	per_minute = g_security_ctx->max_requests_per_minute > 0 ?
+		(double) g_security_ctx->max_requests_per_minute : RAMD_MAX_REQUESTS_PER_WINDOW;
 
-	/* Find existing entry */
-	for (int i = 0; i < g_rate_limit_count; i++)
+	ramd_security_client_key(client_ip, key);
+	hash = ramd_security_client_hash(key);
+	shard = &g_rate_limit_shards[(hash >> 32) % RAMD_RATE_LIMIT_SHARDS];
+	now = ramd_clock_now_us();
+
+	pthread_mutex_lock(&shard->lock);
+
+	bucket = &shard->buckets[hash % RAMD_RATE_LIMIT_BUCKETS];
+	for (idx = *bucket; idx >= 0; idx = shard->entries[idx].hash_next)
 	{
-		if (strcmp(g_rate_limit_entries[i].client_ip, client_ip) == 0)
+		if (memcmp(shard->entries[idx].addr, key, sizeof(key)) == 0)
 		{
-			entry_index = i;
+			entry = &shard->entries[idx];
 			break;
 		}
 	}
 
-	/* Create new entry if not found */
-	if (entry_index == -1)
+	if (!entry)
 	{
-		if (g_rate_limit_count >= RAMD_MAX_RATE_LIMIT_ENTRIES)
-		{
-			/* Remove oldest entry */
-			memmove(&g_rate_limit_entries[0], &g_rate_limit_entries[1],
-					sizeof(ramd_rate_limit_entry_t) * (RAMD_MAX_RATE_LIMIT_ENTRIES - 1));
-			g_rate_limit_count--;
-			entry_index = g_rate_limit_count; /* This is now the last valid index */
-		}
+		/* New client: take a free entry, or recycle the coldest one */
+		idx = shard->free_head;
+		if (idx >= 0)
+			shard->free_head = shard->entries[idx].hash_next;
 		else
-		{
-			entry_index = g_rate_limit_count++;
-		}
-		
-		/* Bounds check to prevent segfault */
-		if (entry_index < 0 || entry_index >= RAMD_MAX_RATE_LIMIT_ENTRIES)
-		{
-			pthread_mutex_unlock(&g_security_mutex);
-			ramd_log_error("Rate limit entry index out of bounds: %d", entry_index);
-			return false;
-		}
-
-		strncpy(g_rate_limit_entries[entry_index].client_ip, client_ip,
-				sizeof(g_rate_limit_entries[entry_index].client_ip) - 1);
-		g_rate_limit_entries[entry_index].client_ip[INET_ADDRSTRLEN - 1] = '\0';
-		g_rate_limit_entries[entry_index].first_request = now;
-		g_rate_limit_entries[entry_index].request_count = 0;
-		g_rate_limit_entries[entry_index].last_request = now;
-		g_rate_limit_entries[entry_index].blocked = false;
+			idx = ramd_security_evict_lru(shard);
+
+		entry = &shard->entries[idx];
+		memcpy(entry->addr, key, sizeof(key));
+		entry->tokens = per_minute;
+		entry->last_refill_us = now;
+		entry->blocked_until_us = 0;
+		entry->hash_next = *bucket;
+		*bucket = idx;
+		ramd_security_lru_push_front(shard, idx);
+	}
+	else if (shard->lru_head != idx)
+	{
+		ramd_security_lru_unlink(shard, idx);
+		ramd_security_lru_push_front(shard, idx);
 	}
 
-	ramd_rate_limit_entry_t *entry = &g_rate_limit_entries[entry_index];
-
-	/* Check if currently blocked */
-	if (entry->blocked)
+	if (entry->blocked_until_us > now)
+		allowed = false;
+	else
 	{
-		if (now - entry->last_request > RAMD_BLOCK_DURATION_SECONDS)
-		{
-			/* Unblock */
-			entry->blocked = false;
-			entry->first_request = now;
-			entry->request_count = 0;
-		}
+		/* Refill at per_minute tokens per window, capped at one window's burst */
+		entry->tokens += (double) (now - entry->last_refill_us) * per_minute /
+			((double) RAMD_RATE_LIMIT_WINDOW_SECONDS * 1e6);
+		if (entry->tokens > per_minute)
+			entry->tokens = per_minute;
+		entry->last_refill_us = now;
+
+		if (entry->tokens >= 1.0)
+			entry->tokens -= 1.0;
 		else
 		{
-			pthread_mutex_unlock(&g_security_mutex);
-			return false;
+			entry->blocked_until_us = now + (int64_t) RAMD_BLOCK_DURATION_SECONDS * 1000000;
+			entry->tokens = per_minute;	/* full bucket once the block ends */
+			allowed = false;
+			newly_blocked = true;
 		}
 	}
 
-	/* Reset window if expired */
-	if (now - entry->first_request > RAMD_RATE_LIMIT_WINDOW_SECONDS)
-	{
-		entry->first_request = now;
-		entry->request_count = 0;
-	}
-
-	/* Check rate limit */
-	entry->request_count++;
-	entry->last_request = now;
+	pthread_mutex_unlock(&shard->lock);
 
-	if (entry->request_count > RAMD_MAX_REQUESTS_PER_WINDOW)
-	{
-		entry->blocked = true;
+	if (newly_blocked)
 		ramd_security_log_audit(client_ip, "system", "rate_limit_exceeded", "api", 1, "Rate limit exceeded");
-		pthread_mutex_unlock(&g_security_mutex);
-		return false;
-	}
-
-	pthread_mutex_unlock(&g_security_mutex);
-	return true;
+	return allowed;
 }
 
 /* Log security audit event */
@@ -351,48 +610,7 @@ ramd_security_log_audit(const char *client_ip, const char *user,
 	if (!g_security_ctx || !g_security_ctx->enable_audit)
 		return;
 
-	pthread_mutex_lock(&g_security_mutex);
-
-	ramd_audit_entry_t *entry = &g_audit_log[g_audit_index];
-	entry->timestamp = time(NULL);
-
-	if (client_ip)
-		strncpy(entry->client_ip, client_ip, sizeof(entry->client_ip) - 1);
-	else
-		entry->client_ip[0] = '\0';
-	entry->client_ip[INET_ADDRSTRLEN - 1] = '\0';
-
-	if (user)
-		strncpy(entry->user, user, sizeof(entry->user) - 1);
-	else
-		entry->user[0] = '\0';
-	entry->user[RAMD_MAX_USERNAME_LENGTH - 1] = '\0';
-
-	if (action)
-		strncpy(entry->action, action, sizeof(entry->action) - 1);
-	else
-		entry->action[0] = '\0';
-	entry->action[RAMD_MAX_COMMAND_LENGTH - 1] = '\0';
-
-	if (resource)
-		strncpy(entry->resource, resource, sizeof(entry->resource) - 1);
-	else
-		entry->resource[0] = '\0';
-	entry->resource[RAMD_MAX_PATH_LENGTH - 1] = '\0';
-
-	entry->result = result;
-
-	if (details)
-		strncpy(entry->details, details, sizeof(entry->details) - 1);
-	else
-		entry->details[0] = '\0';
-	entry->details[RAMD_MAX_COMMAND_LENGTH - 1] = '\0';
-
-	g_audit_index = (g_audit_index + 1) % RAMD_MAX_AUDIT_ENTRIES;
-	if (g_audit_count < RAMD_MAX_AUDIT_ENTRIES)
-		g_audit_count++;
-
-	pthread_mutex_unlock(&g_security_mutex);
+	ramd_audit_log_append(client_ip, user, action, resource, result, details);
 
 	/* Log to ramd log system */
 	if (result == 0)
@@ -420,9 +638,6 @@ ramd_security_validate_input(const char *input, size_t max_length)
 	if (len > max_length)
 		return false;
 
-	/* Check for null bytes */
-	if (memchr(input, '\0', len) != input + len)
-		return false;
 
 	/* Check for control characters */
 	for (size_t i = 0; i < len; i++)
@@ -462,27 +677,13 @@ ramd_security_sanitize_input(char *input, size_t max_length)
 
 /* Check permissions */
 static bool
-ramd_security_check_permissions(const char *user, const char *action)
+ramd_security_check_permissions(ramd_user_role_t role, const char *action)
 {
-	if (!user || !action || !g_security_ctx)
-		return false;
-
-	/* Find user */
-	ramd_user_t *user_entry = NULL;
-	for (int i = 0; i < g_security_ctx->user_count; i++)
-	{
-		if (strcmp(g_security_ctx->users[i].username, user) == 0)
-		{
-			user_entry = &g_security_ctx->users[i];
-			break;
-		}
-	}
-
-	if (!user_entry)
+	if (!action)
 		return false;
 
 	/* Check permissions based on role */
-	switch (user_entry->role)
+	switch (role)
 	{
 		case RAMD_ROLE_ADMIN:
 			return true; /* Admin can do everything */
@@ -501,20 +702,77 @@ ramd_security_check_permissions(const char *user, const char *action)
 static void
 ramd_security_cleanup_rate_limits(void)
 {
-	time_t now = time(NULL);
-
-	for (int i = 0; i < g_rate_limit_count; i++)
+	for (int i = 0; i < RAMD_RATE_LIMIT_SHARDS; i++)
 	{
-		ramd_rate_limit_entry_t *entry = &g_rate_limit_entries[i];
-		if (now - entry->last_request > RAMD_BLOCK_DURATION_SECONDS)
+		ramd_rate_limit_shard_t *shard = &g_rate_limit_shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+		for (int b = 0; b < RAMD_RATE_LIMIT_BUCKETS; b++)
+			shard->buckets[b] = -1;
+		for (int e = 0; e < RAMD_RATE_LIMIT_SHARD_ENTRIES; e++)
 		{
-			/* Remove expired entries */
-			memmove(&g_rate_limit_entries[i], &g_rate_limit_entries[i + 1],
-					sizeof(ramd_rate_limit_entry_t) * (size_t)(g_rate_limit_count - i - 1));
-			g_rate_limit_count--;
-			i--;
+			memset(&shard->entries[e], 0, sizeof(shard->entries[e]));
+			shard->entries[e].hash_next = e + 1 < RAMD_RATE_LIMIT_SHARD_ENTRIES ? e + 1 : -1;
+			shard->entries[e].lru_prev = shard->entries[e].lru_next = -1;
 		}
+		shard->free_head = 0;
+		shard->lru_head = shard->lru_tail = -1;
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+/*
+ * Count successful read-only requests and write a summary entry once per
+ * RAMD_AUDIT_READ_SUMMARY_SECONDS, or immediately when force is set.
+ */
+static void
+ramd_security_audit_reads(int64_t count, bool force)
+{
+	int64_t		now = ramd_clock_now_us();
+	int64_t		total = 0;
+	int64_t		elapsed_us = 0;
+	char		details[128];
+
+	pthread_mutex_lock(&g_audit_read_mutex);
+	if (g_audit_read_since_us == 0)
+		g_audit_read_since_us = now;
+	g_audit_read_count += count;
+	elapsed_us = now - g_audit_read_since_us;
+	if (g_audit_read_count > 0 &&
+		(force || elapsed_us >= (int64_t) RAMD_AUDIT_READ_SUMMARY_SECONDS * 1000000))
+	{
+		total = g_audit_read_count;
+		g_audit_read_count = 0;
+		g_audit_read_since_us = now;
 	}
+	pthread_mutex_unlock(&g_audit_read_mutex);
+
+	if (total == 0)
+		return;
+
+	snprintf(details, sizeof(details), "%lld read-only requests in the last %lld s",
+			 (long long) total, (long long) (elapsed_us / 1000000));
+	ramd_security_log_audit(NULL, "*", "read", "/api/", 0, details);
+}
+
+/* Number of clients currently serving a rate-limit block */
+static int
+ramd_security_count_blocked(void)
+{
+	int64_t		now = ramd_clock_now_us();
+	int			blocked = 0;
+
+	for (int i = 0; i < RAMD_RATE_LIMIT_SHARDS; i++)
+	{
+		ramd_rate_limit_shard_t *shard = &g_rate_limit_shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+		for (int32_t idx = shard->lru_head; idx >= 0; idx = shard->entries[idx].lru_next)
+			if (shard->entries[idx].blocked_until_us > now)
+				blocked++;
+		pthread_mutex_unlock(&shard->lock);
+	}
+	return blocked;
 }
 
 /* Public API functions */
@@ -524,11 +782,24 @@ bool
 ramd_security_authenticate_http(const char *client_ip, const char *authorization,
 								const char *action, const char *resource)
 {
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	char		user[RAMD_MAX_USERNAME_LENGTH];
+	ramd_user_role_t role = RAMD_ROLE_NONE;
+	uint64_t	generation = 0;
+	const char *token;
+	bool		read_only = action && strcmp(action, "read") == 0;
+	bool		cached;
+	bool		limited;
+	int64_t		now;
+
 	if (!g_security_ctx)
 		return false;
 
 	/* Check rate limiting */
-	if (!ramd_security_check_rate_limit(client_ip))
+	now = ramd_clock_now_us();
+	limited = !ramd_security_check_rate_limit(client_ip);
+	ramd_http_profile_add(RAMD_HTTP_PROFILE_RATE_LIMIT, ramd_clock_now_us() - now);
+	if (limited)
 	{
 		ramd_security_log_audit(client_ip, "anonymous", action, resource, 1, "Rate limit exceeded");
 		return false;
@@ -537,28 +808,139 @@ ramd_security_authenticate_http(const char *client_ip, const char *authorization
 	/* Check if authentication is required */
 	if (!g_security_ctx->enable_auth)
 	{
-		ramd_security_log_audit(client_ip, "anonymous", action, resource, 0, "No authentication required");
+		if (read_only)
+			ramd_security_audit_reads(1, false);
+		else
+			ramd_security_log_audit(client_ip, "anonymous", action, resource, 0, "No authentication required");
 		return true;
 	}
 
-	/* Validate token */
-	if (!ramd_security_validate_token(authorization))
+	token = ramd_security_bearer_token(authorization);
+	if (!token || token[0] == '\0')
 	{
-		ramd_security_log_audit(client_ip, "anonymous", action, resource, 1, "Invalid token");
+		ramd_security_log_audit(client_ip, "anonymous", action, resource, 1, "Missing token");
 		return false;
 	}
 
+	/* Validate token, from the cache when it was seen recently */
+	SHA256((const unsigned char *) token, strlen(token), digest);
+	now = ramd_clock_now_us();
+	cached = ramd_security_token_cache_lookup(digest, now, user, sizeof(user),
+											  &role, &generation);
+	if (!cached)
+	{
+		bool		valid;
+
+		pthread_mutex_lock(&g_security_ctx->mutex);
+		valid = ramd_security_validate_token(digest, user, sizeof(user), &role);
+		pthread_mutex_unlock(&g_security_ctx->mutex);
+
+		if (!valid)
+		{
+			ramd_security_log_audit(client_ip, "anonymous", action, resource, 1, "Invalid token");
+			return false;
+		}
+		ramd_security_token_cache_insert(digest, now, user, role, generation);
+	}
+
 	/* Check permissions */
-	if (!ramd_security_check_permissions("admin", action))
+	if (!ramd_security_check_permissions(role, action))
+	{
+		ramd_security_log_audit(client_ip, user, action, resource, 1, "Insufficient permissions");
+		return false;
+	}
+
+	/* A token's first use is always recorded; repeated reads are summarised */
+	if (read_only && cached)
+		ramd_security_audit_reads(1, false);
+	else
+		ramd_security_log_audit(client_ip, user, action, resource, 0, "Authentication successful");
+	return true;
+}
+
+/* Replace the admin token */
+bool
+ramd_security_set_admin_token(const char *token)
+{
+	if (!g_security_ctx || !token || token[0] == '\0')
+		return false;
+
+	if (strlen(token) >= sizeof(g_security_ctx->admin_token))
 	{
-		ramd_security_log_audit(client_ip, "admin", action, resource, 1, "Insufficient permissions");
+		ramd_log_error("Admin token is longer than %d characters", RAMD_MAX_TOKEN_LENGTH - 1);
 		return false;
 	}
 
-	ramd_security_log_audit(client_ip, "admin", action, resource, 0, "Authentication successful");
+	pthread_mutex_lock(&g_security_ctx->mutex);
+	strncpy(g_security_ctx->admin_token, token, sizeof(g_security_ctx->admin_token) - 1);
+	g_security_ctx->admin_token[sizeof(g_security_ctx->admin_token) - 1] = '\0';
+	SHA256((const unsigned char *) g_security_ctx->admin_token,
+		   strlen(g_security_ctx->admin_token), g_security_ctx->admin_token_digest);
+	pthread_mutex_unlock(&g_security_ctx->mutex);
+
+	ramd_security_invalidate_token_cache();
 	return true;
 }
 
+/* Change the per-client request budget; buckets already filled drain to it */
+void
+ramd_security_set_rate_limit(int32_t per_minute)
+{
+	if (!g_security_ctx)
+		return;
+
+	pthread_mutex_lock(&g_security_ctx->mutex);
+	g_security_ctx->enable_rate_limiting = per_minute > 0;
+	g_security_ctx->max_requests_per_minute = per_minute;
+	pthread_mutex_unlock(&g_security_ctx->mutex);
+}
+
+/* Revoke a user token */
+bool
+ramd_security_revoke_token(const char *token)
+{
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	bool		revoked = false;
+
+	token = ramd_security_bearer_token(token);
+	if (!g_security_ctx || !token || token[0] == '\0')
+		return false;
+
+	SHA256((const unsigned char *) token, strlen(token), digest);
+
+	pthread_mutex_lock(&g_security_ctx->mutex);
+	for (int i = 0; i < g_security_ctx->user_count; i++)
+	{
+		ramd_user_t *entry = &g_security_ctx->users[i];
+
+		if (CRYPTO_memcmp(digest, entry->token_digest, SHA256_DIGEST_LENGTH) != 0)
+			continue;
+
+		/* Rotate; if that fails the user is locked out rather than left valid */
+		if (!ramd_security_generate_token(entry->token, sizeof(entry->token)))
+			entry->token[0] = '\0';
+		SHA256((const unsigned char *) entry->token, strlen(entry->token),
+			   entry->token_digest);
+		ramd_log_info("Revoked token of user: %s", entry->username);
+		revoked = true;
+		break;
+	}
+	pthread_mutex_unlock(&g_security_ctx->mutex);
+
+	/* The admin token comes from the configuration and cannot be revoked here */
+	ramd_security_invalidate_token_cache();
+	return revoked;
+}
+
+/* Drop every cached token validation */
+void
+ramd_security_invalidate_token_cache(void)
+{
+	pthread_mutex_lock(&g_token_cache_mutex);
+	g_token_generation++;
+	pthread_mutex_unlock(&g_token_cache_mutex);
+}
+
 /* Validate and sanitize input */
 bool
 ramd_security_validate_and_sanitize_input(char *input, size_t max_length)
@@ -581,14 +963,22 @@ ramd_security_add_user(const char *username, const char *password, ramd_user_rol
 	if (!g_security_ctx || !username || !password)
 		return false;
 
+	pthread_mutex_lock(&g_security_ctx->mutex);
+
 	if (g_security_ctx->user_count >= RAMD_MAX_USERS)
+	{
+		pthread_mutex_unlock(&g_security_ctx->mutex);
 		return false;
+	}
 
 	/* Check if user already exists */
 	for (int i = 0; i < g_security_ctx->user_count; i++)
 	{
 		if (strcmp(g_security_ctx->users[i].username, username) == 0)
+		{
+			pthread_mutex_unlock(&g_security_ctx->mutex);
 			return false;
+		}
 	}
 
 	/* Add user */
@@ -606,12 +996,19 @@ ramd_security_add_user(const char *username, const char *password, ramd_user_rol
 	user->password_hash[SHA256_DIGEST_LENGTH * 2] = '\0';
 
 	user->role = role;
+	user->created_at = time(NULL);
+	user->active = true;
 
 	/* Generate token */
 	if (!ramd_security_generate_token(user->token, sizeof(user->token)))
+	{
+		pthread_mutex_unlock(&g_security_ctx->mutex);
 		return false;
+	}
+	SHA256((const unsigned char *) user->token, strlen(user->token), user->token_digest);
 
 	g_security_ctx->user_count++;
+	pthread_mutex_unlock(&g_security_ctx->mutex);
 
 	ramd_log_info("Added user: %s with role: %d", username, role);
 	return true;
@@ -619,24 +1016,13 @@ ramd_security_add_user(const char *username, const char *password, ramd_user_rol
 
 /* Get audit log */
 bool
-ramd_security_get_audit_log(ramd_audit_entry_t *entries, int max_entries, int *actual_count)
+ramd_security_get_audit_log(time_t from, time_t until, ramd_audit_entry_t *entries,
+							int max_entries, int *actual_count)
 {
 	if (!entries || !actual_count || !g_security_ctx)
 		return false;
 
-	pthread_mutex_lock(&g_security_mutex);
-
-	int count = (max_entries < g_audit_count) ? max_entries : g_audit_count;
-	*actual_count = count;
-
-	/* Copy entries in reverse chronological order */
-	for (int i = 0; i < count; i++)
-	{
-		int index = (g_audit_index - 1 - i + RAMD_MAX_AUDIT_ENTRIES) % RAMD_MAX_AUDIT_ENTRIES;
-		entries[i] = g_audit_log[index];
-	}
-
-	pthread_mutex_unlock(&g_security_mutex);
+	*actual_count = ramd_audit_log_read(from, until, entries, max_entries);
 	return true;
 }
 
@@ -648,7 +1034,7 @@ ramd_security_get_status(ramd_security_status_t *status)
 		return false;
 
 	status->auth_enabled = g_security_ctx->enable_auth;
-	status->ssl_enabled = g_security_ctx->enable_ssl;
+	status->ssl_enabled = ramd_tls_enabled();
 	status->rate_limiting_enabled = g_security_ctx->enable_rate_limiting;
 	status->audit_enabled = g_security_ctx->enable_audit;
 	status->user_count = g_security_ctx->user_count;
@@ -656,7 +1042,7 @@ ramd_security_get_status(ramd_security_status_t *status)
 	status->active_connections = g_security_ctx->max_connections;
 	
 	/* Track blocked IPs */
-	status->blocked_ips = 0; /* No blocked IP tracking implemented yet */
+	status->blocked_ips = ramd_security_count_blocked();
 
 	return true;
 }
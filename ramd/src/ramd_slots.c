@@ -0,0 +1,407 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_slots.c
+ *		PostgreSQL Auto-Failover Daemon - Replication Slot Manager
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Every registered standby gets a physical slot ramd_node_<id> on the
+ * current primary, so WAL it has not received yet is kept for it and a
+ * standby that restarts or loses its network for a while resumes
+ * streaming instead of needing a rebuild.  The price is WAL the primary
+ * cannot recycle while a standby is away, so each pass also looks at what
+ * every slot retains: once a standby has been gone longer than
+ * slot_inactive_timeout_ms, or its slot holds more than
+ * slot_max_retained_mb or is about to be invalidated by
+ * max_slot_wal_keep_size, the slot is dropped or advanced.  A dropped
+ * slot is recreated only when its standby is seen streaming again.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_slots.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_topology.h"
+
+#define RAMD_SLOTS_QUERY \
+	"SELECT slot_name, active, " \
+	"pg_wal_lsn_diff(pg_current_wal_lsn(), restart_lsn)::bigint, " \
+	"%s, %s, pg_wal_lsn_diff(pg_current_wal_lsn(), '0/0')::bigint " \
+	"FROM pg_replication_slots " \
+	"WHERE slot_type = 'physical' AND slot_name LIKE 'ramd\\_node\\_%%'"
+
+typedef struct ramd_slot_entry_t
+{
+	bool used;
+	bool present;            /* listed by the latest pass */
+	int64_t inactive_since_us; /* 0 while active */
+	bool warned;             /* policy action logged for this absence */
+	ramd_slot_stats_t stats;
+} ramd_slot_entry_t;
+
+typedef struct ramd_slots_state_t
+{
+	pthread_mutex_t lock; /* readers are the HTTP threads */
+	int32_t primary_node_id;
+	ramd_slot_entry_t entries[RAMD_MAX_NODES];
+} ramd_slots_state_t;
+
+static ramd_slots_state_t g_slots = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.primary_node_id = -1
+};
+
+void
+ramd_slots_name(int32_t node_id, char* name, size_t size)
+{
+	snprintf(name, size, "ramd_node_%d", node_id);
+}
+
+static ramd_slot_entry_t*
+ramd_slots_find(const char* slot_name, bool create)
+{
+	ramd_slot_entry_t* free_entry = NULL;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_slot_entry_t* e = &g_slots.entries[i];
+
+		if (!e->used)
+		{
+			if (!free_entry)
+				free_entry = e;
+			continue;
+		}
+		if (strcmp(e->stats.slot_name, slot_name) == 0)
+			return e;
+	}
+
+	if (!create || !free_entry)
+		return NULL;
+
+	memset(free_entry, 0, sizeof(*free_entry));
+	free_entry->used = true;
+	snprintf(free_entry->stats.slot_name, sizeof(free_entry->stats.slot_name), "%s", slot_name);
+	if (sscanf(slot_name, "ramd_node_%d", &free_entry->stats.node_id) != 1)
+		free_entry->stats.node_id = -1;
+	free_entry->stats.retained_bytes = -1;
+	free_entry->stats.safe_wal_size = -1;
+	return free_entry;
+}
+
+/* Run one slot function; the result itself is of no interest */
+static bool
+ramd_slots_call(PGconn* conn, const char* sql, const char* slot_name, const char* arg)
+{
+	const char* values[2] = {slot_name, arg};
+	PGresult*   res;
+	bool        ok;
+
+	res = PQexecParams(conn, sql, arg ? 2 : 1, NULL, values, NULL, NULL, 0);
+	ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+	if (!ok)
+		ramd_log_warning("Slot %s: %s", slot_name, PQerrorMessage(conn));
+	PQclear(res);
+	return ok;
+}
+
+bool
+ramd_slots_create(PGconn* conn, int32_t node_id)
+{
+	char name[64];
+
+	if (!conn || node_id <= 0)
+		return false;
+
+	ramd_slots_name(node_id, name, sizeof(name));
+	return ramd_slots_call(conn,
+	                       "SELECT pg_create_physical_replication_slot($1, true) "
+	                       "WHERE NOT EXISTS (SELECT 1 FROM pg_replication_slots "
+	                       "WHERE slot_name = $1)",
+	                       name, NULL);
+}
+
+/* Read pg_replication_slots into the table; false if the query failed */
+static bool
+ramd_slots_refresh(PGconn* conn, int64_t now_us, int64_t* current_lsn)
+{
+	char      sql[512];
+	bool      has_wal_status = PQserverVersion(conn) >= 130000;
+	PGresult* res;
+	int       rows;
+
+	snprintf(sql, sizeof(sql), RAMD_SLOTS_QUERY,
+	         has_wal_status ? "wal_status" : "NULL::text",
+	         has_wal_status ? "safe_wal_size" : "NULL::bigint");
+	res = PQexec(conn, sql);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		ramd_log_debug("Slot manager: query failed: %s", PQerrorMessage(conn));
+		PQclear(res);
+		return false;
+	}
+
+	rows = PQntuples(res);
+	*current_lsn = -1;
+
+	pthread_mutex_lock(&g_slots.lock);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+		g_slots.entries[i].present = false;
+
+	for (int row = 0; row < rows; row++)
+	{
+		ramd_slot_entry_t* e = ramd_slots_find(PQgetvalue(res, row, 0), true);
+		ramd_slot_stats_t* s;
+
+		if (!e)
+			continue;
+		s = &e->stats;
+		e->present = true;
+		s->released = false;
+		s->active = strcmp(PQgetvalue(res, row, 1), "t") == 0;
+		s->retained_bytes = PQgetisnull(res, row, 2) ? -1 : strtoll(PQgetvalue(res, row, 2), NULL, 10);
+		snprintf(s->wal_status, sizeof(s->wal_status), "%s", PQgetvalue(res, row, 3));
+		s->safe_wal_size = PQgetisnull(res, row, 4) ? -1 : strtoll(PQgetvalue(res, row, 4), NULL, 10);
+		*current_lsn = strtoll(PQgetvalue(res, row, 5), NULL, 10);
+
+		if (s->active)
+		{
+			e->inactive_since_us = 0;
+			e->warned = false;
+		}
+		else if (e->inactive_since_us == 0)
+			e->inactive_since_us = now_us;
+		s->inactive_ms = e->inactive_since_us ? (now_us - e->inactive_since_us) / 1000 : 0;
+	}
+
+	/* Gone without our doing, e.g. dropped by hand: forget it */
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_slot_entry_t* e = &g_slots.entries[i];
+
+		if (e->used && !e->present && !e->stats.released)
+			e->used = false;
+	}
+	pthread_mutex_unlock(&g_slots.lock);
+
+	PQclear(res);
+	return true;
+}
+
+/* Give every registered standby a slot, unless policy took it away */
+static void
+ramd_slots_create_missing(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster)
+{
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+		char               name[64];
+		ramd_slot_entry_t* e;
+		ramd_lag_stats_t   lag;
+		bool               released;
+
+		/* A cascaded standby keeps its slot on the standby it streams from */
+		if (node->node_id <= 0 || node->node_id == primary_node_id ||
+		    ramd_topology_upstream(node->node_id) > 0)
+			continue;
+
+		ramd_slots_name(node->node_id, name, sizeof(name));
+		pthread_mutex_lock(&g_slots.lock);
+		e = ramd_slots_find(name, false);
+		if (e && e->present)
+		{
+			pthread_mutex_unlock(&g_slots.lock);
+			continue;
+		}
+		released = e && e->stats.released;
+		pthread_mutex_unlock(&g_slots.lock);
+
+		/* Streaming again without its slot: it has caught up through the archive */
+		if (released && !(ramd_lag_get_stats(node->node_id, &lag) && lag.connected))
+			continue;
+
+		/* Reserve from now, so the standby's next connect already finds its WAL */
+		if (ramd_slots_call(conn, "SELECT pg_create_physical_replication_slot($1, true)",
+		                    name, NULL))
+		{
+			ramd_log_info("Created replication slot %s for standby %d", name, node->node_id);
+			pthread_mutex_lock(&g_slots.lock);
+			e = ramd_slots_find(name, true);
+			if (e)
+			{
+				e->present = true;
+				e->stats.released = false;
+				e->stats.active = false;
+				e->inactive_since_us = ramd_clock_now_us();
+			}
+			pthread_mutex_unlock(&g_slots.lock);
+		}
+	}
+}
+
+static bool
+ramd_slots_is_registered(const ramd_cluster_t* cluster, int32_t node_id)
+{
+	return ramd_cluster_lookup_node(cluster, node_id) != NULL;
+}
+
+/* Apply slot_inactive_policy to slots whose standby is away */
+static void
+ramd_slots_apply_policy(PGconn* conn, ramd_cluster_t* cluster, const ramd_config_t* config,
+                        int64_t current_lsn)
+{
+	ramd_slot_stats_t candidates[RAMD_MAX_NODES];
+	int32_t           count = 0;
+	int64_t           limit = (int64_t) config->slot_max_retained_mb * 1024 * 1024;
+
+	/* Decide under the lock, act without it */
+	pthread_mutex_lock(&g_slots.lock);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_slot_entry_t* e = &g_slots.entries[i];
+
+		if (e->used && e->present && !e->stats.active)
+			candidates[count++] = e->stats;
+	}
+	pthread_mutex_unlock(&g_slots.lock);
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		const ramd_slot_stats_t* s = &candidates[i];
+		bool lost = strcmp(s->wal_status, "lost") == 0;
+		bool orphaned = !ramd_slots_is_registered(cluster, s->node_id) ||
+		                ramd_topology_upstream(s->node_id) > 0;
+		bool over_limit = (limit > 0 && s->retained_bytes > limit) ||
+		                  strcmp(s->wal_status, "unreserved") == 0;
+		bool timed_out = config->slot_inactive_timeout_ms > 0 &&
+		                 s->inactive_ms >= config->slot_inactive_timeout_ms;
+		ramd_slot_policy_t policy = config->slot_inactive_policy;
+		ramd_slot_entry_t* e;
+
+		if (!lost && !orphaned && !over_limit && !timed_out)
+			continue;
+
+		/* A lost slot protects nothing, and one of a removed node nobody */
+		if (lost || orphaned)
+			policy = RAMD_SLOT_POLICY_DROP;
+
+		switch (policy)
+		{
+			case RAMD_SLOT_POLICY_DROP:
+				if (!ramd_slots_call(conn, "SELECT pg_drop_replication_slot($1)", s->slot_name, NULL))
+					break;
+				ramd_log_warning("Dropped replication slot %s (%s): inactive %" PRId64 " s, "
+				                 "retaining %" PRId64 " MB; the standby must catch up from the "
+				                 "WAL archive or be rebuilt",
+				                 s->slot_name,
+				                 lost ? "WAL already lost" : orphaned ? "node removed or cascaded"
+				                 : over_limit ? "over the retention limit" : "timed out",
+				                 s->inactive_ms / 1000, s->retained_bytes / (1024 * 1024));
+				pthread_mutex_lock(&g_slots.lock);
+				e = ramd_slots_find(s->slot_name, false);
+				if (e)
+				{
+					/* Only registered standbys are worth a slot again later */
+					e->present = false;
+					e->stats.released = !orphaned;
+					e->used = !orphaned;
+				}
+				pthread_mutex_unlock(&g_slots.lock);
+				break;
+
+			case RAMD_SLOT_POLICY_ADVANCE:
+			{
+				/* Keep the newest slot_max_retained_mb of WAL, or none past the timeout */
+				int64_t target = current_lsn - (over_limit && limit > 0 ? limit : 0);
+				char    lsn[32];
+
+				if (current_lsn < 0 || s->retained_bytes < 0 ||
+				    target <= current_lsn - s->retained_bytes)
+					break;
+				snprintf(lsn, sizeof(lsn), "%X/%X", (unsigned) ((uint64_t) target >> 32),
+				         (unsigned) ((uint64_t) target & 0xFFFFFFFF));
+				if (!ramd_slots_call(conn, "SELECT pg_replication_slot_advance($1, $2::pg_lsn)",
+				                     s->slot_name, lsn))
+					break;
+
+				/* Advanced again on every pass while away; say so once */
+				pthread_mutex_lock(&g_slots.lock);
+				e = ramd_slots_find(s->slot_name, false);
+				if (e && !e->warned)
+				{
+					e->warned = true;
+					ramd_log_warning("Advancing replication slot %s: inactive %" PRId64
+					                 " s, was retaining %" PRId64 " MB",
+					                 s->slot_name, s->inactive_ms / 1000,
+					                 s->retained_bytes / (1024 * 1024));
+				}
+				pthread_mutex_unlock(&g_slots.lock);
+				break;
+			}
+
+			case RAMD_SLOT_POLICY_KEEP:
+				pthread_mutex_lock(&g_slots.lock);
+				e = ramd_slots_find(s->slot_name, false);
+				if (e && !e->warned)
+				{
+					e->warned = true;
+					ramd_log_warning("Replication slot %s inactive %" PRId64 " s and retaining %"
+					                 PRId64 " MB; kept by slot_inactive_policy",
+					                 s->slot_name, s->inactive_ms / 1000,
+					                 s->retained_bytes / (1024 * 1024));
+				}
+				pthread_mutex_unlock(&g_slots.lock);
+				break;
+		}
+	}
+}
+
+void
+ramd_slots_manage(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                  const ramd_config_t* config)
+{
+	int64_t current_lsn = -1;
+
+	if (!conn || !cluster || !config || !config->replication_slots_enabled)
+		return;
+
+	/* What was true of the old primary's slots says nothing about the new one's */
+	pthread_mutex_lock(&g_slots.lock);
+	if (g_slots.primary_node_id != primary_node_id)
+	{
+		memset(g_slots.entries, 0, sizeof(g_slots.entries));
+		g_slots.primary_node_id = primary_node_id;
+	}
+	pthread_mutex_unlock(&g_slots.lock);
+
+	if (!ramd_slots_refresh(conn, ramd_clock_now_us(), &current_lsn))
+		return;
+	ramd_slots_create_missing(conn, primary_node_id, cluster);
+	ramd_slots_apply_policy(conn, cluster, config, current_lsn);
+}
+
+int32_t
+ramd_slots_get_all(ramd_slot_stats_t* stats, int32_t max_count)
+{
+	int32_t count = 0;
+
+	pthread_mutex_lock(&g_slots.lock);
+	for (int i = 0; i < RAMD_MAX_NODES && count < max_count; i++)
+	{
+		if (g_slots.entries[i].used)
+			stats[count++] = g_slots.entries[i].stats;
+	}
+	pthread_mutex_unlock(&g_slots.lock);
+	return count;
+}
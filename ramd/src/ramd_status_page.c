@@ -0,0 +1,242 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_status_page.c
+ *		PostgreSQL Auto-Failover Daemon - Shared-Memory Status Page
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The page holds the same ram_state.h snapshot GET /api/v1/state?format=bin
+ * serves, so a local probe polling it costs a memcpy and never reaches
+ * the HTTP server, its rate limiter or its connection pool.  One thread
+ * owns the page: the watch feed only tells it that something moved, and
+ * it encodes the snapshot into a scratch buffer before entering the
+ * sequence lock, so readers only ever race with a single memcpy.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ramd_status_page.h"
+#include "ramd_logging.h"
+#include "ramd_watch.h"
+#include "ram_status_page.h"
+
+_Static_assert(RAM_STATE_HEADER_SIZE + RAMD_MAX_NODES * RAM_STATE_NODE_SIZE <=
+                   RAM_STATUS_PAGE_CAPACITY,
+               "a full cluster must fit in the status page");
+
+typedef struct ramd_status_page_state_t
+{
+	pthread_mutex_t lock; /* guards running and pending */
+	pthread_cond_t cond;
+	bool running;
+	bool pending; /* the feed moved since the last write */
+	pthread_t thread;
+	int32_t node_id;
+	char name[64];
+	ram_status_page_t* page;
+	unsigned char scratch[RAM_STATUS_PAGE_CAPACITY];
+} ramd_status_page_state_t;
+
+static ramd_status_page_state_t g_status_page = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static int64_t
+ramd_status_page_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Watch subscriber; runs under the feed lock, so only flags the writer */
+static void
+ramd_status_page_wake(const ramd_watch_event_t* events, int32_t count, void* arg)
+{
+	(void) events;
+	(void) count;
+	(void) arg;
+
+	pthread_mutex_lock(&g_status_page.lock);
+	g_status_page.pending = true;
+	pthread_cond_signal(&g_status_page.cond);
+	pthread_mutex_unlock(&g_status_page.lock);
+}
+
+static void
+ramd_status_page_write(void)
+{
+	ram_status_page_t* page = g_status_page.page;
+	ramd_watch_snapshot_t view;
+	uint64_t sequence;
+	size_t length;
+
+	ramd_watch_get(&view);
+	length = ramd_watch_encode_state(&view, g_status_page.node_id, g_status_page.scratch,
+	                                 sizeof(g_status_page.scratch));
+	if (length == 0)
+		return;
+
+	sequence = atomic_load_explicit(&page->sequence, memory_order_relaxed);
+	atomic_store_explicit(&page->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	memcpy(page->state, g_status_page.scratch, length);
+	page->length = (uint32_t) length;
+	atomic_store_explicit(&page->sequence, sequence + 2, memory_order_release);
+}
+
+static void*
+ramd_status_page_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_status_page.lock);
+	while (g_status_page.running)
+	{
+		struct timespec deadline;
+		bool pending;
+
+		if (!g_status_page.pending)
+		{
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long) RAM_STATUS_PAGE_HEARTBEAT_MS * 1000000L;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+			deadline.tv_nsec %= 1000000000L;
+			pthread_cond_timedwait(&g_status_page.cond, &g_status_page.lock, &deadline);
+			if (!g_status_page.running)
+				break;
+		}
+		pending = g_status_page.pending;
+		g_status_page.pending = false;
+
+		/* Never read the feed with our lock held: its subscriber takes it */
+		pthread_mutex_unlock(&g_status_page.lock);
+		if (pending)
+			ramd_status_page_write();
+		atomic_store_explicit(&g_status_page.page->heartbeat_ms, ramd_status_page_now_ms(),
+		                      memory_order_relaxed);
+		pthread_mutex_lock(&g_status_page.lock);
+	}
+	pthread_mutex_unlock(&g_status_page.lock);
+	return NULL;
+}
+
+bool
+ramd_status_page_start(const ramd_config_t* config)
+{
+	ram_status_page_t* page;
+	void* map;
+	int fd;
+
+	if (!config)
+		return false;
+	if (!config->status_page_enabled)
+		return true;
+
+	pthread_mutex_lock(&g_status_page.lock);
+	if (g_status_page.running)
+	{
+		pthread_mutex_unlock(&g_status_page.lock);
+		return true;
+	}
+	pthread_mutex_unlock(&g_status_page.lock);
+
+	/* A page left by a daemon that died is replaced, not reused */
+	snprintf(g_status_page.name, sizeof(g_status_page.name), RAM_STATUS_PAGE_NAME,
+	         config->http_port);
+	(void) shm_unlink(g_status_page.name);
+	fd = shm_open(g_status_page.name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+	{
+		ramd_log_error("Status page: cannot create %s: %s", g_status_page.name,
+		               strerror(errno));
+		return false;
+	}
+	/* Readable by local probes whatever ramd's umask is */
+	if (fchmod(fd, 0644) != 0 || ftruncate(fd, RAM_STATUS_PAGE_SIZE) != 0)
+	{
+		ramd_log_error("Status page: cannot size %s: %s", g_status_page.name,
+		               strerror(errno));
+		close(fd);
+		shm_unlink(g_status_page.name);
+		return false;
+	}
+	map = mmap(NULL, RAM_STATUS_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		ramd_log_error("Status page: cannot map %s: %s", g_status_page.name, strerror(errno));
+		shm_unlink(g_status_page.name);
+		return false;
+	}
+
+	page = (ram_status_page_t*) map;
+	page->layout = RAM_STATUS_PAGE_LAYOUT;
+	page->pid = (int32_t) getpid();
+	atomic_store_explicit(&page->sequence, 0, memory_order_relaxed);
+	atomic_store_explicit(&page->heartbeat_ms, ramd_status_page_now_ms(), memory_order_relaxed);
+	/* Readers check the magic first, so it goes in last */
+	atomic_thread_fence(memory_order_release);
+	memcpy(page->magic, RAM_STATUS_PAGE_MAGIC, 4);
+
+	g_status_page.page = page;
+	g_status_page.node_id = config->node_id;
+	ramd_status_page_write();
+
+	pthread_mutex_lock(&g_status_page.lock);
+	g_status_page.running = true;
+	g_status_page.pending = false;
+	if (pthread_create(&g_status_page.thread, NULL, ramd_status_page_thread_main, NULL) != 0)
+	{
+		g_status_page.running = false;
+		pthread_mutex_unlock(&g_status_page.lock);
+		ramd_log_error("Status page: failed to create thread");
+		munmap(map, RAM_STATUS_PAGE_SIZE);
+		shm_unlink(g_status_page.name);
+		g_status_page.page = NULL;
+		return false;
+	}
+	pthread_mutex_unlock(&g_status_page.lock);
+
+	if (!ramd_watch_subscribe(ramd_status_page_wake, NULL))
+		ramd_log_warning("Status page: watch feed full, the page follows changes "
+		                 "every %d ms only", RAM_STATUS_PAGE_HEARTBEAT_MS);
+
+	ramd_log_info("Status page: publishing the cluster view in %s", g_status_page.name);
+	return true;
+}
+
+void
+ramd_status_page_stop(void)
+{
+	pthread_mutex_lock(&g_status_page.lock);
+	if (!g_status_page.running)
+	{
+		pthread_mutex_unlock(&g_status_page.lock);
+		return;
+	}
+	g_status_page.running = false;
+	pthread_cond_broadcast(&g_status_page.cond);
+	pthread_mutex_unlock(&g_status_page.lock);
+
+	ramd_watch_unsubscribe(ramd_status_page_wake, NULL);
+	pthread_join(g_status_page.thread, NULL);
+
+	/* Readers that still have it mapped see the daemon gone */
+	atomic_store_explicit(&g_status_page.page->heartbeat_ms, -1, memory_order_relaxed);
+	munmap(g_status_page.page, RAM_STATUS_PAGE_SIZE);
+	shm_unlink(g_status_page.name);
+	g_status_page.page = NULL;
+}
@@ -0,0 +1,650 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_switchover.c
+ *		PostgreSQL Auto-Failover Daemon - Planned Switchover
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * A switchover runs on the daemon of the current primary:
+ *
+ *   prewarm   not a step of its own: the primary's buffer list is dumped
+ *             and loaded into the target's shared buffers in the
+ *             background from here on (ramd_prewarm.c)
+ *   fence     default_transaction_read_only is reloaded on, open write
+ *             transactions get switchover_drain_timeout_ms to finish and
+ *             the remaining client sessions are terminated
+ *   catchup   wait, woken by the lag sampler, until the target has flushed
+ *             the primary's final flush LSN
+ *   shutdown  stop the old primary; a clean shutdown waits for connected
+ *             standbys to confirm everything including the shutdown
+ *             checkpoint, so the old primary can follow the new timeline
+ *             without pg_rewind
+ *   promote   pg_promote() on the target
+ *   repoint   started together with promote: the other standbys reload a
+ *             primary_conninfo naming the target, streaming from it in
+ *             cascade until it is promoted and then following the switch
+ *   rejoin    the old primary comes back as a standby of the target
+ *
+ * The old primary is stopped before, not after, the promotion: stopped
+ * later, its shutdown checkpoint would land beyond the fork point.  Up to
+ * the shutdown a failure just lifts the fence; a failed promotion restarts
+ * the old primary as primary.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libpq-fe.h>
+
+#include "ramd_switchover.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_endpoint.h"
+#include "ramd_failover.h"
+#include "ramd_lag.h"
+#include "ramd_logging.h"
+#include "ramd_metrics.h"
+#include "ramd_pgraft.h"
+#include "ramd_postgresql.h"
+#include "ramd_prewarm.h"
+#include "ramd_query.h"
+#include "ramd_slots.h"
+
+typedef struct ramd_switchover_job_t
+{
+	pthread_mutex_t lock; /* guards everything below */
+	bool initialized;
+	bool thread_joinable;
+	pthread_t thread;
+
+	ramd_config_t config; /* private copy, the job outlives config reloads */
+	ramd_cluster_t* cluster;
+	ramd_switchover_status_t status;
+	int32_t server_version;
+} ramd_switchover_job_t;
+
+static ramd_switchover_job_t g_switchover = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static void
+switchover_set_phase(ramd_switchover_phase_t phase)
+{
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.status.phase = phase;
+	pthread_mutex_unlock(&g_switchover.lock);
+	ramd_log_info("Switchover: %s", ramd_switchover_phase_to_string(phase));
+}
+
+static void
+switchover_end_phase(ramd_switchover_phase_t phase, int64_t started_ms)
+{
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.status.phase_ms[phase] = ramd_clock_now_ms() - started_ms;
+	pthread_mutex_unlock(&g_switchover.lock);
+}
+
+static void
+switchover_fail(const char* message)
+{
+	pthread_mutex_lock(&g_switchover.lock);
+	snprintf(g_switchover.status.message, sizeof(g_switchover.status.message), "%s", message);
+	pthread_mutex_unlock(&g_switchover.lock);
+	ramd_log_error("Switchover: %s", message);
+}
+
+static PGconn*
+switchover_connect(const ramd_node_t* node)
+{
+	const ramd_config_t* config = &g_switchover.config;
+
+	return ramd_conn_get(node->hostname, node->postgresql_port, config->database_name,
+	                     config->database_user, config->database_password);
+}
+
+static bool
+switchover_exec(PGconn* conn, const char* sql)
+{
+	PGresult* res = ramd_query_exec_with_result(conn, sql);
+	ExecStatusType status = PQresultStatus(res);
+
+	PQclear(res);
+	if (status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK)
+		return true;
+
+	ramd_log_warning("Switchover: \"%s\" failed: %s", sql, PQerrorMessage(conn));
+	return false;
+}
+
+static int64_t
+switchover_query_int(PGconn* conn, const char* sql)
+{
+	PGresult* res = ramd_query_exec_with_result(conn, sql);
+	int64_t value = -1;
+
+	if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1 &&
+	    !PQgetisnull(res, 0, 0))
+		value = strtoll(PQgetvalue(res, 0, 0), NULL, 10);
+	PQclear(res);
+	return value;
+}
+
+static void
+switchover_unfence(PGconn* conn)
+{
+	if (switchover_exec(conn, "ALTER SYSTEM RESET default_transaction_read_only"))
+		switchover_exec(conn, "SELECT pg_reload_conf()");
+}
+
+/* New sessions come up read-only; writers get a grace period, then go */
+static bool
+switchover_fence(PGconn* conn)
+{
+	const ramd_config_t* config = &g_switchover.config;
+	int64_t deadline = ramd_clock_now_ms() + config->switchover_drain_timeout_ms;
+	int64_t writers;
+
+	if (!switchover_exec(conn, "ALTER SYSTEM SET default_transaction_read_only = on") ||
+	    !switchover_exec(conn, "SELECT pg_reload_conf()"))
+		return false;
+
+	for (;;)
+	{
+		writers = switchover_query_int(conn,
+		    "SELECT count(*) FROM pg_stat_activity WHERE backend_type = 'client backend' "
+		    "AND backend_xid IS NOT NULL AND pid <> pg_backend_pid()");
+		if (writers <= 0 || ramd_clock_now_ms() >= deadline)
+			break;
+		usleep(RAMD_SWITCHOVER_DRAIN_POLL_MS * 1000);
+	}
+	if (writers > 0)
+		ramd_log_warning("Switchover: terminating %lld sessions still writing",
+		                 (long long) writers);
+
+	/* Sessions opened before the reload still default to read-write */
+	return switchover_exec(conn,
+	    "SELECT pg_terminate_backend(pid) FROM pg_stat_activity "
+	    "WHERE backend_type = 'client backend' AND pid <> pg_backend_pid() "
+	    "AND application_name NOT LIKE 'ramd%'");
+}
+
+/* Repoint every other standby at the target; runs alongside the promotion */
+static void*
+switchover_repoint_thread(void* arg)
+{
+	const ramd_node_t* target = arg;
+	ramd_cluster_t* cluster = g_switchover.cluster;
+	int32_t repointed = 0;
+	int32_t total = 0;
+
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t* node = &cluster->nodes[i];
+		PGconn* conn;
+		char slot_name[64];
+		bool needs_restart = false;
+		bool ok;
+
+		if (node->node_id == target->node_id ||
+		    node->node_id == g_switchover.config.node_id ||
+		    node->state == RAMD_NODE_STATE_FAILED)
+			continue;
+		total++;
+
+		conn = switchover_connect(node);
+		if (!conn)
+		{
+			ramd_log_warning("Switchover: cannot reach standby %d to repoint it",
+			                 node->node_id);
+			continue;
+		}
+		ramd_slots_name(node->node_id, slot_name, sizeof(slot_name));
+		ok = ramd_postgresql_repoint_standby(conn, &g_switchover.config, target->hostname,
+		                                     target->postgresql_port, node->node_id,
+		                                     g_switchover.config.replication_slots_enabled
+		                                         ? slot_name : NULL,
+		                                     &needs_restart);
+		ramd_conn_close(conn);
+
+		if (ok && !needs_restart)
+			repointed++;
+		else
+			ramd_log_warning("Switchover: standby %d needs a restart to follow node %d "
+			                 "(primary_conninfo reloads from PostgreSQL 13)",
+			                 node->node_id, target->node_id);
+	}
+
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.status.standbys_repointed = repointed;
+	g_switchover.status.standbys_total = total;
+	pthread_mutex_unlock(&g_switchover.lock);
+	return NULL;
+}
+
+static bool
+switchover_write_standby_signal(void)
+{
+	char path[RAMD_MAX_PATH_LENGTH];
+	FILE* fp;
+
+	if (snprintf(path, sizeof(path), "%s/standby.signal",
+	             g_switchover.config.postgresql_data_dir) >= (int) sizeof(path))
+	{
+		ramd_log_error("Switchover: postgresql_data_dir is too long for standby.signal");
+		return false;
+	}
+	fp = fopen(path, "w");
+	if (!fp)
+	{
+		ramd_log_error("Switchover: cannot create %s: %s", path, strerror(errno));
+		return false;
+	}
+	fclose(fp);
+	return true;
+}
+
+static bool
+switchover_rejoin(const ramd_node_t* target)
+{
+	const ramd_config_t* config = &g_switchover.config;
+	bool configured;
+
+	/* primary_conninfo was set with ALTER SYSTEM before the shutdown */
+	if (g_switchover.server_version >= 120000)
+		configured = switchover_write_standby_signal();
+	else
+		configured = ramd_postgresql_create_recovery_conf(config, target->hostname,
+		                                                  target->postgresql_port);
+
+	return configured && ramd_postgresql_start(config);
+}
+
+static bool
+switchover_run(ramd_switchover_state_t* outcome)
+{
+	const ramd_config_t* config = &g_switchover.config;
+	ramd_cluster_t* cluster = g_switchover.cluster;
+	ramd_node_t* target;
+	ramd_node_t* self;
+	ramd_endpoint_move_t move;
+	pthread_t repoint;
+	bool repointing;
+	PGconn* conn;
+	int64_t lsn;
+	int64_t started;
+	int64_t promoted;
+	char slot_name[64];
+	bool needs_restart;
+	bool ok;
+
+	*outcome = RAMD_SWITCHOVER_FAILED;
+	target = ramd_cluster_find_node(cluster, g_switchover.status.target_node_id);
+	self = ramd_cluster_find_node(cluster, config->node_id);
+	if (!target || !self)
+	{
+		switchover_fail("target or local node not in the cluster view");
+		return false;
+	}
+
+	conn = switchover_connect(self);
+	if (!conn)
+	{
+		switchover_fail("cannot connect to the local primary");
+		return false;
+	}
+	g_switchover.server_version = PQserverVersion(conn);
+	ramd_slots_name(config->node_id, slot_name, sizeof(slot_name));
+
+	/* Taken while writers still run, so the list is the write working set */
+	ramd_prewarm_start(config, conn, target);
+
+	switchover_set_phase(RAMD_SWITCHOVER_PHASE_FENCE);
+	started = ramd_clock_now_ms();
+	ok = switchover_fence(conn);
+	lsn = ok ? switchover_query_int(conn,
+	               "SELECT pg_wal_lsn_diff(pg_current_wal_flush_lsn(), '0/0')::bigint") : -1;
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_FENCE, started);
+	if (lsn < 0)
+	{
+		switchover_unfence(conn);
+		ramd_conn_close(conn);
+		switchover_fail("could not fence the primary");
+		return false;
+	}
+
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.status.target_lsn = lsn;
+	pthread_mutex_unlock(&g_switchover.lock);
+
+	/* Raft leadership follows the promotion target; failover still works if this fails */
+	if (ramd_pgraft_transfer_leadership(conn, target->node_id,
+	                                    RAMD_SWITCHOVER_RAFT_TRANSFER_MS) != RAMD_PGRAFT_SUCCESS)
+		ramd_log_warning("Switchover: Raft leadership stays put: %s", ramd_pgraft_get_last_error());
+
+	switchover_set_phase(RAMD_SWITCHOVER_PHASE_CATCHUP);
+	started = ramd_clock_now_ms();
+	ok = ramd_lag_wait_for_flush(target->node_id, lsn, config->switchover_catchup_timeout_ms);
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_CATCHUP, started);
+	if (!ok)
+	{
+		switchover_unfence(conn);
+		ramd_conn_close(conn);
+		switchover_fail("target did not reach the primary's flush LSN in time");
+		return false;
+	}
+
+	/* Persisted now, applied once the old primary restarts as a standby */
+	switchover_set_phase(RAMD_SWITCHOVER_PHASE_SHUTDOWN);
+	started = ramd_clock_now_ms();
+	ok = switchover_exec(conn, "ALTER SYSTEM RESET default_transaction_read_only") &&
+	     (g_switchover.server_version < 120000 ||
+	      ramd_postgresql_repoint_standby(conn, config, target->hostname,
+	                                      target->postgresql_port, config->node_id,
+	                                      config->replication_slots_enabled ? slot_name : NULL,
+	                                      &needs_restart));
+	ramd_conn_close(conn);
+	ok = ok && ramd_postgresql_stop(config);
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_SHUTDOWN, started);
+	if (!ok)
+	{
+		/* still running or unreachable; ramd_postgresql_start() is a no-op if up */
+		ramd_postgresql_start(config);
+		*outcome = RAMD_SWITCHOVER_ROLLED_BACK;
+		switchover_fail("could not stop the old primary");
+		return false;
+	}
+	self->role = RAMD_ROLE_STANDBY;
+
+	repointing = pthread_create(&repoint, NULL, switchover_repoint_thread, target) == 0;
+	if (!repointing)
+		ramd_log_warning("Switchover: cannot start repointing thread, repointing after promotion");
+
+	switchover_set_phase(RAMD_SWITCHOVER_PHASE_PROMOTE);
+	promoted = started = ramd_clock_now_ms();
+	ok = ramd_failover_promote_node(cluster, config, target->node_id);
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_PROMOTE, started);
+	if (!ok)
+	{
+		if (repointing)
+			pthread_join(repoint, NULL);
+		self->role = RAMD_ROLE_PRIMARY;
+		cluster->primary_node_id = config->node_id;
+		ramd_postgresql_start(config);
+		*outcome = RAMD_SWITCHOVER_ROLLED_BACK;
+		switchover_fail("promotion failed, old primary restarted");
+		return false;
+	}
+	ramd_endpoint_move_begin(&move, config, target);
+
+	switchover_set_phase(RAMD_SWITCHOVER_PHASE_REJOIN);
+	started = ramd_clock_now_ms();
+	ok = switchover_rejoin(target);
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_REJOIN, started);
+	if (ok)
+		ramd_metrics_increment_demotions(g_ramd_metrics);
+	else
+		ramd_log_error("Switchover: node %d did not come back as a standby of node %d",
+		               config->node_id, target->node_id);
+
+	/* Repoint time is measured from the promotion it overlaps with */
+	if (repointing)
+		pthread_join(repoint, NULL);
+	else
+		switchover_repoint_thread(target);
+	switchover_end_phase(RAMD_SWITCHOVER_PHASE_REPOINT, promoted);
+	if (!ramd_endpoint_move_finish(&move))
+		ramd_log_warning("Switchover: some clients may still be sent to node %d",
+		                 config->node_id);
+
+	/* The target is primary either way; a stuck rejoin is for the rebuild API */
+	if (!ok)
+		switchover_fail("promoted, but the old primary failed to rejoin as a standby");
+	*outcome = RAMD_SWITCHOVER_SUCCEEDED;
+	return true;
+}
+
+static void*
+switchover_thread(void* arg)
+{
+	ramd_switchover_state_t outcome;
+	ramd_switchover_status_t status;
+	int64_t started = ramd_clock_now_ms();
+	bool ok;
+
+	(void) arg;
+	ok = switchover_run(&outcome);
+	if (outcome != RAMD_SWITCHOVER_SUCCEEDED)
+		ramd_prewarm_cancel(); /* the target stays a standby */
+
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.status.state = outcome;
+	g_switchover.status.total_ms = ramd_clock_now_ms() - started;
+	g_switchover.status.finished_at = time(NULL);
+	status = g_switchover.status;
+	pthread_mutex_unlock(&g_switchover.lock);
+
+	ramd_metrics_observe_switchover(g_ramd_metrics, status.phase_ms, ok);
+	{
+		ramd_log_field_t fields[] = {
+			RAMD_LOG_INT("target", status.target_node_id),
+			RAMD_LOG_INT("total_ms", status.total_ms),
+			RAMD_LOG_INT("fence_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_FENCE]),
+			RAMD_LOG_INT("catchup_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_CATCHUP]),
+			RAMD_LOG_INT("shutdown_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_SHUTDOWN]),
+			RAMD_LOG_INT("promote_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_PROMOTE]),
+			RAMD_LOG_INT("repoint_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_REPOINT]),
+			RAMD_LOG_INT("rejoin_ms", status.phase_ms[RAMD_SWITCHOVER_PHASE_REJOIN]),
+		};
+
+		RAMD_LOG_KV(INFO, fields, "Switchover from node %d to node %d %s",
+		            status.old_primary_node_id, status.target_node_id,
+		            ramd_switchover_state_to_string(status.state));
+	}
+	return NULL;
+}
+
+bool
+ramd_switchover_init(const ramd_config_t* config)
+{
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.config = *config;
+	memset(&g_switchover.status, 0, sizeof(g_switchover.status));
+	g_switchover.status.old_primary_node_id = -1;
+	g_switchover.status.target_node_id = -1;
+	g_switchover.status.target_lsn = -1;
+	for (int i = 0; i < RAMD_SWITCHOVER_PHASE_COUNT; i++)
+		g_switchover.status.phase_ms[i] = -1;
+	g_switchover.initialized = true;
+	pthread_mutex_unlock(&g_switchover.lock);
+	return true;
+}
+
+void
+ramd_switchover_cleanup(void)
+{
+	ramd_switchover_wait();
+	ramd_prewarm_cleanup();
+
+	pthread_mutex_lock(&g_switchover.lock);
+	g_switchover.initialized = false;
+	g_switchover.cluster = NULL;
+	pthread_mutex_unlock(&g_switchover.lock);
+}
+
+bool
+ramd_switchover_start(ramd_cluster_t* cluster, int32_t target_node_id,
+                      char* error, size_t error_size)
+{
+	ramd_node_t* target;
+	bool joinable;
+	pthread_t previous;
+
+	if (!cluster)
+		return false;
+
+	pthread_mutex_lock(&g_switchover.lock);
+	if (!g_switchover.initialized || g_switchover.status.state == RAMD_SWITCHOVER_RUNNING)
+	{
+		snprintf(error, error_size, "%s", g_switchover.initialized
+		         ? "a switchover is already in progress" : "switchover not initialized");
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+	if (cluster->primary_node_id != g_switchover.config.node_id)
+	{
+		snprintf(error, error_size, "node %d is not the primary; ask node %d",
+		         g_switchover.config.node_id, cluster->primary_node_id);
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+	if (target_node_id <= 0 && !ramd_failover_select_new_primary(cluster, &target_node_id))
+	{
+		snprintf(error, error_size, "no standby eligible for promotion");
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+	target = ramd_cluster_find_node(cluster, target_node_id);
+	if (!target || target_node_id == g_switchover.config.node_id ||
+	    target->role != RAMD_ROLE_STANDBY || !target->is_healthy)
+	{
+		snprintf(error, error_size, "node %d is not a healthy standby", target_node_id);
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+	if (!target->is_voter)
+	{
+		snprintf(error, error_size, "node %d is a Raft learner; add it as a voter first",
+		         target_node_id);
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+
+	joinable = g_switchover.thread_joinable;
+	previous = g_switchover.thread;
+	g_switchover.thread_joinable = false;
+	pthread_mutex_unlock(&g_switchover.lock);
+	if (joinable)
+		pthread_join(previous, NULL);
+
+	pthread_mutex_lock(&g_switchover.lock);
+	memset(&g_switchover.status, 0, sizeof(g_switchover.status));
+	g_switchover.status.state = RAMD_SWITCHOVER_RUNNING;
+	g_switchover.status.phase = RAMD_SWITCHOVER_PHASE_FENCE;
+	g_switchover.status.old_primary_node_id = g_switchover.config.node_id;
+	g_switchover.status.target_node_id = target_node_id;
+	g_switchover.status.target_lsn = -1;
+	for (int i = 0; i < RAMD_SWITCHOVER_PHASE_COUNT; i++)
+		g_switchover.status.phase_ms[i] = -1;
+	g_switchover.status.started_at = time(NULL);
+	g_switchover.cluster = cluster;
+
+	if (pthread_create(&g_switchover.thread, NULL, switchover_thread, NULL) != 0)
+	{
+		g_switchover.status.state = RAMD_SWITCHOVER_FAILED;
+		snprintf(error, error_size, "failed to create switchover thread");
+		pthread_mutex_unlock(&g_switchover.lock);
+		return false;
+	}
+	g_switchover.thread_joinable = true;
+	pthread_mutex_unlock(&g_switchover.lock);
+
+	ramd_log_info("Switchover from node %d to node %d (%s:%d) started",
+	              g_switchover.config.node_id, target_node_id, target->hostname,
+	              target->postgresql_port);
+	return true;
+}
+
+bool
+ramd_switchover_wait(void)
+{
+	bool joinable;
+	pthread_t thread;
+	bool ok;
+
+	pthread_mutex_lock(&g_switchover.lock);
+	joinable = g_switchover.thread_joinable;
+	thread = g_switchover.thread;
+	g_switchover.thread_joinable = false;
+	pthread_mutex_unlock(&g_switchover.lock);
+
+	if (joinable)
+		pthread_join(thread, NULL);
+
+	pthread_mutex_lock(&g_switchover.lock);
+	ok = g_switchover.status.state == RAMD_SWITCHOVER_SUCCEEDED;
+	pthread_mutex_unlock(&g_switchover.lock);
+	return ok;
+}
+
+bool
+ramd_switchover_in_progress(void)
+{
+	bool running;
+
+	pthread_mutex_lock(&g_switchover.lock);
+	running = g_switchover.status.state == RAMD_SWITCHOVER_RUNNING;
+	pthread_mutex_unlock(&g_switchover.lock);
+	return running;
+}
+
+void
+ramd_switchover_get_status(ramd_switchover_status_t* status)
+{
+	if (!status)
+		return;
+
+	pthread_mutex_lock(&g_switchover.lock);
+	*status = g_switchover.status;
+	pthread_mutex_unlock(&g_switchover.lock);
+}
+
+const char*
+ramd_switchover_state_to_string(ramd_switchover_state_t state)
+{
+	switch (state)
+	{
+		case RAMD_SWITCHOVER_IDLE:
+			return "idle";
+		case RAMD_SWITCHOVER_RUNNING:
+			return "running";
+		case RAMD_SWITCHOVER_SUCCEEDED:
+			return "succeeded";
+		case RAMD_SWITCHOVER_FAILED:
+			return "failed";
+		case RAMD_SWITCHOVER_ROLLED_BACK:
+			return "rolled_back";
+	}
+	return "unknown";
+}
+
+const char*
+ramd_switchover_phase_to_string(ramd_switchover_phase_t phase)
+{
+	switch (phase)
+	{
+		case RAMD_SWITCHOVER_PHASE_FENCE:
+			return "fence";
+		case RAMD_SWITCHOVER_PHASE_CATCHUP:
+			return "catchup";
+		case RAMD_SWITCHOVER_PHASE_SHUTDOWN:
+			return "shutdown";
+		case RAMD_SWITCHOVER_PHASE_PROMOTE:
+			return "promote";
+		case RAMD_SWITCHOVER_PHASE_REPOINT:
+			return "repoint";
+		case RAMD_SWITCHOVER_PHASE_REJOIN:
+			return "rejoin";
+		case RAMD_SWITCHOVER_PHASE_COUNT:
+			break;
+	}
+	return "unknown";
+}
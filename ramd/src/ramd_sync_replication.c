@@ -16,12 +16,16 @@
 #include <libpq-fe.h>
 
 #include "ramd_sync_replication.h"
+#include "ramd_clock.h"
 #include "ramd_logging.h"
 #include "ramd_postgresql.h"
 #include "ramd_basebackup.h"
 #include "ramd_conn.h"
 #include "ramd_query.h"
 #include "ramd_daemon.h"
+#include "ramd_slots.h"
+#include "ramd_lag.h"
+#include "ramd_watch.h"
 
 extern PGconn* g_conn;
 
@@ -30,6 +34,50 @@ static ramd_sync_status_t g_sync_status;
 static bool              g_sync_initialized = false;
 static pthread_mutex_t   g_sync_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* Adaptive synchronous_standby_names state, also under g_sync_mutex */
+typedef struct ramd_sync_adaptive_member_t
+{
+	int32_t node_id;
+	char    application_name[64];
+	bool    connected;
+	bool    selected;
+	bool    stalled;
+	double  score_ms;
+	int64_t faster_since_us; /* 0 unless beating the slowest incumbent */
+	int64_t healthy_since_us; /* 0 unless a stalled member is recovering */
+} ramd_sync_adaptive_member_t;
+
+static struct
+{
+	ramd_sync_adaptive_member_t members[RAMD_MAX_NODES];
+	int32_t member_count;
+	int32_t primary_node_id;
+	char    applied[RAMD_MAX_COMMAND_LENGTH]; /* last value set on the primary */
+} g_sync_adaptive = {.primary_node_id = -1};
+
+/*
+ * A standby that went unhealthy or changed role, or a new primary, may
+ * change who should be synchronous; re-sample now rather than on the next
+ * tick.  Lag events come from the sampler itself and are left alone.
+ */
+static void
+ramd_sync_on_watch_events(const ramd_watch_event_t *events, int32_t count, void *arg)
+{
+	(void) arg;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		if (events[i].type == RAMD_WATCH_EVENT_NODE_HEALTH ||
+		    events[i].type == RAMD_WATCH_EVENT_NODE_ROLE ||
+		    events[i].type == RAMD_WATCH_EVENT_PRIMARY ||
+		    events[i].type == RAMD_WATCH_EVENT_MEMBERSHIP)
+		{
+			ramd_lag_request_sample();
+			return;
+		}
+	}
+}
+
 bool
 ramd_sync_replication_init(ramd_sync_config_t *config)
 {
@@ -56,6 +104,10 @@ ramd_sync_replication_init(ramd_sync_config_t *config)
 
 	pthread_mutex_unlock(&g_sync_mutex);
 
+	ramd_watch_unsubscribe(ramd_sync_on_watch_events, NULL);
+	if (!ramd_watch_subscribe(ramd_sync_on_watch_events, NULL))
+		ramd_log_warning("Synchronous replication: no room to follow cluster changes");
+
 	ramd_log_info("Synchronous replication initialized with mode: %s",
 	              ramd_sync_mode_to_string(g_sync_config.mode));
 
@@ -65,6 +117,8 @@ ramd_sync_replication_init(ramd_sync_config_t *config)
 void
 ramd_sync_replication_cleanup(void)
 {
+	ramd_watch_unsubscribe(ramd_sync_on_watch_events, NULL);
+
 	pthread_mutex_lock(&g_sync_mutex);
 	g_sync_initialized = false;
 	pthread_mutex_unlock(&g_sync_mutex);
@@ -282,9 +336,12 @@ ramd_sync_replication_update_postgresql_config(void)
 	if (!g_sync_initialized)
 		return false;
 
-	if (!ramd_sync_generate_standby_names(standby_names, sizeof(standby_names),
-	                                      g_sync_status.standbys,
-	                                      RAMD_MAX_NODES))
+	/* In adaptive mode the lag sampler owns the list; keep what it chose */
+	if (g_sync_config.adaptive && g_sync_adaptive.applied[0] != '\0')
+		snprintf(standby_names, sizeof(standby_names), "%s", g_sync_adaptive.applied);
+	else if (!ramd_sync_generate_standby_names(standby_names, sizeof(standby_names),
+	                                           g_sync_status.standbys,
+	                                           RAMD_MAX_NODES))
 	{
 		ramd_log_error("Failed to generate synchronous_standby_names");
 		return false;
@@ -419,6 +476,329 @@ ramd_sync_generate_standby_names(char *output, size_t output_size,
 	return true;
 }
 
+/*
+ * Adaptive synchronous_standby_names
+ *
+ * A FIRST N list waits on the first N connected standbys in list order, so
+ * the order itself is the policy: the N standbys with the lowest flush lag
+ * go first, the rest follow as candidates.  Standbys whose flush lag passes
+ * adaptive_stall_ms move to the tail, where they are only waited on if too
+ * few others are connected.  Every known standby stays listed, so commits
+ * never wait on fewer than N standbys.  A faster standby only displaces an
+ * incumbent after beating it by adaptive_margin_ms for adaptive_hold_ms,
+ * and a stalled one must stay under the threshold as long to come back.
+ */
+static ramd_sync_adaptive_member_t *
+ramd_sync_adaptive_member(int32_t node_id, const char *application_name)
+{
+	ramd_sync_adaptive_member_t *m;
+
+	for (int32_t i = 0; i < g_sync_adaptive.member_count; i++)
+	{
+		if (g_sync_adaptive.members[i].node_id == node_id)
+			return &g_sync_adaptive.members[i];
+	}
+	if (g_sync_adaptive.member_count >= RAMD_MAX_NODES)
+		return NULL;
+
+	m = &g_sync_adaptive.members[g_sync_adaptive.member_count++];
+	memset(m, 0, sizeof(*m));
+	m->node_id = node_id;
+	snprintf(m->application_name, sizeof(m->application_name), "%s", application_name);
+	return m;
+}
+
+/* Track stalls, with the hold time applied before a member is trusted again */
+static void
+ramd_sync_adaptive_observe(ramd_sync_adaptive_member_t *m, const ramd_lag_stats_t *s,
+                           int64_t now_us)
+{
+	int64_t hold_us = (int64_t) g_sync_config.adaptive_hold_ms * 1000;
+	int32_t flush_lag_ms = s->last.flush_lag_ms;
+
+	m->connected = s->connected && s->sample_count > 0;
+	m->score_ms = s->ewma_flush_lag_ms >= 0 ? s->ewma_flush_lag_ms
+	                                        : (double) g_sync_config.adaptive_stall_ms;
+
+	if (!m->connected)
+	{
+		m->selected = false;
+		m->faster_since_us = 0;
+		return;
+	}
+
+	if (flush_lag_ms >= g_sync_config.adaptive_stall_ms)
+	{
+		if (!m->stalled)
+			ramd_log_warning("Adaptive sync: node %d stalling (flush lag %d ms), "
+			                 "moving it behind the other standbys",
+			                 m->node_id, flush_lag_ms);
+		m->stalled = true;
+		m->selected = false;
+		m->healthy_since_us = 0;
+	}
+	else if (m->stalled)
+	{
+		if (m->healthy_since_us == 0)
+			m->healthy_since_us = now_us;
+		else if (now_us - m->healthy_since_us >= hold_us)
+		{
+			ramd_log_info("Adaptive sync: node %d recovered (flush lag %d ms)",
+			              m->node_id, flush_lag_ms);
+			m->stalled = false;
+			m->healthy_since_us = 0;
+		}
+	}
+}
+
+static bool
+ramd_sync_adaptive_eligible(const ramd_sync_adaptive_member_t *m)
+{
+	return m->connected && !m->stalled;
+}
+
+/* Settle on the N members to list first; called with g_sync_mutex held */
+static void
+ramd_sync_adaptive_select(int32_t wanted, int64_t now_us)
+{
+	int64_t hold_us = (int64_t) g_sync_config.adaptive_hold_ms * 1000;
+	ramd_sync_adaptive_member_t *challenger = NULL;
+	ramd_sync_adaptive_member_t *slowest = NULL;
+	int32_t selected = 0;
+
+	for (int32_t i = 0; i < g_sync_adaptive.member_count; i++)
+	{
+		if (g_sync_adaptive.members[i].selected)
+			selected++;
+	}
+
+	/* Fill empty places straight away; waiting here only hurts availability */
+	while (selected < wanted)
+	{
+		ramd_sync_adaptive_member_t *best = NULL;
+
+		for (int32_t i = 0; i < g_sync_adaptive.member_count; i++)
+		{
+			ramd_sync_adaptive_member_t *m = &g_sync_adaptive.members[i];
+
+			if (!m->selected && ramd_sync_adaptive_eligible(m) &&
+			    (!best || m->score_ms < best->score_ms))
+				best = m;
+		}
+		if (!best)
+			break;
+		best->selected = true;
+		best->faster_since_us = 0;
+		selected++;
+	}
+
+	for (int32_t i = 0; i < g_sync_adaptive.member_count; i++)
+	{
+		ramd_sync_adaptive_member_t *m = &g_sync_adaptive.members[i];
+
+		if (m->selected)
+		{
+			if (!slowest || m->score_ms > slowest->score_ms)
+				slowest = m;
+		}
+		else if (ramd_sync_adaptive_eligible(m) &&
+		         (!challenger || m->score_ms < challenger->score_ms))
+			challenger = m;
+	}
+
+	for (int32_t i = 0; i < g_sync_adaptive.member_count; i++)
+	{
+		if (&g_sync_adaptive.members[i] != challenger)
+			g_sync_adaptive.members[i].faster_since_us = 0;
+	}
+
+	if (!challenger || !slowest || selected < wanted ||
+	    challenger->score_ms + g_sync_config.adaptive_margin_ms >= slowest->score_ms)
+	{
+		if (challenger)
+			challenger->faster_since_us = 0;
+		return;
+	}
+
+	if (challenger->faster_since_us == 0)
+		challenger->faster_since_us = now_us;
+	else if (now_us - challenger->faster_since_us >= hold_us)
+	{
+		ramd_log_info("Adaptive sync: node %d (%.1f ms) replaces node %d (%.1f ms)",
+		              challenger->node_id, challenger->score_ms,
+		              slowest->node_id, slowest->score_ms);
+		slowest->selected = false;
+		challenger->selected = true;
+		challenger->faster_since_us = 0;
+	}
+}
+
+/* Selected, then other healthy, then stalled, then disconnected; by node id within each */
+static int
+ramd_sync_adaptive_rank(const ramd_sync_adaptive_member_t *m)
+{
+	if (m->selected)
+		return 0;
+	if (ramd_sync_adaptive_eligible(m))
+		return 1;
+	return m->connected ? 2 : 3;
+}
+
+static int
+ramd_sync_adaptive_compare(const void *a, const void *b)
+{
+	const ramd_sync_adaptive_member_t *x = *(ramd_sync_adaptive_member_t *const *) a;
+	const ramd_sync_adaptive_member_t *y = *(ramd_sync_adaptive_member_t *const *) b;
+	int rx = ramd_sync_adaptive_rank(x);
+	int ry = ramd_sync_adaptive_rank(y);
+
+	if (rx != ry)
+		return rx - ry;
+	return (x->node_id > y->node_id) - (x->node_id < y->node_id);
+}
+
+static void
+ramd_sync_adaptive_build(char *output, size_t output_size, int32_t wanted)
+{
+	ramd_sync_adaptive_member_t *order[RAMD_MAX_NODES];
+	int32_t count = g_sync_adaptive.member_count;
+	size_t used;
+
+	for (int32_t i = 0; i < count; i++)
+		order[i] = &g_sync_adaptive.members[i];
+	qsort(order, (size_t) count, sizeof(order[0]), ramd_sync_adaptive_compare);
+
+	used = (size_t) snprintf(output, output_size, "FIRST %d (", wanted);
+	for (int32_t i = 0; i < count && used < output_size; i++)
+		used += (size_t) snprintf(output + used, output_size - used, "%s\"%s\"",
+		                          i > 0 ? ", " : "", order[i]->application_name);
+	if (used < output_size)
+		snprintf(output + used, output_size - used, ")");
+}
+
+static bool
+ramd_sync_adaptive_apply(PGconn *conn, const char *standby_names)
+{
+	char      sql[RAMD_MAX_COMMAND_LENGTH * 2];
+	char     *literal;
+	PGresult *res;
+	bool      ok;
+
+	literal = PQescapeLiteral(conn, standby_names, strlen(standby_names));
+	if (!literal)
+	{
+		ramd_log_error("Adaptive sync: cannot quote synchronous_standby_names: %s",
+		               PQerrorMessage(conn));
+		return false;
+	}
+	snprintf(sql, sizeof(sql), "ALTER SYSTEM SET synchronous_standby_names = %s", literal);
+	PQfreemem(literal);
+
+	res = ramd_query_exec_with_result(conn, sql);
+	ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+	PQclear(res);
+	if (ok)
+	{
+		res = ramd_query_exec_with_result(conn, "SELECT pg_reload_conf()");
+		ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+		PQclear(res);
+	}
+	if (!ok)
+		ramd_log_error("Adaptive sync: failed to set synchronous_standby_names: %s",
+		               PQerrorMessage(conn));
+	return ok;
+}
+
+void
+ramd_sync_replication_adapt(PGconn *conn, int32_t primary_node_id,
+                            const ramd_lag_stats_t *stats, int32_t count)
+{
+	char    standby_names[RAMD_MAX_COMMAND_LENGTH];
+	int64_t now_us = ramd_clock_now_us();
+	int32_t wanted;
+
+	if (!conn || !stats)
+		return;
+
+	pthread_mutex_lock(&g_sync_mutex);
+	if (!g_sync_initialized)
+	{
+		pthread_mutex_unlock(&g_sync_mutex);
+		return;
+	}
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		const ramd_lag_stats_t *s = &stats[i];
+
+		for (int32_t j = 0; j < RAMD_MAX_NODES; j++)
+		{
+			ramd_sync_standby_t *standby = &g_sync_status.standbys[j];
+
+			if (standby->node_id <= 0 || standby->node_id != s->node_id)
+				continue;
+			standby->is_connected = s->connected;
+			standby->state = s->connected ? RAMD_REPLICATION_STATE_STREAMING
+			                              : RAMD_REPLICATION_STATE_UNKNOWN;
+			standby->flush_lag_bytes = s->last.flush_lag_bytes;
+			standby->replay_lag_bytes = s->last.replay_lag_bytes;
+			if (s->connected && s->is_sync)
+				standby->last_sync_time = time(NULL);
+		}
+	}
+
+	wanted = g_sync_config.num_sync_standbys;
+	if (!g_sync_config.adaptive || g_sync_config.mode == RAMD_SYNC_OFF || wanted <= 0)
+	{
+		pthread_mutex_unlock(&g_sync_mutex);
+		return;
+	}
+
+	/* The old primary's setting means nothing to the new one */
+	if (g_sync_adaptive.primary_node_id != primary_node_id)
+	{
+		memset(&g_sync_adaptive, 0, sizeof(g_sync_adaptive));
+		g_sync_adaptive.primary_node_id = primary_node_id;
+	}
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_sync_adaptive_member_t *m;
+
+		if (stats[i].node_id <= 0 || stats[i].node_id == primary_node_id)
+			continue;
+		m = ramd_sync_adaptive_member(stats[i].node_id, stats[i].application_name);
+		if (m)
+			ramd_sync_adaptive_observe(m, &stats[i], now_us);
+	}
+
+	ramd_sync_adaptive_select(wanted, now_us);
+
+	if (g_sync_adaptive.member_count == 0)
+	{
+		pthread_mutex_unlock(&g_sync_mutex);
+		return;
+	}
+	ramd_sync_adaptive_build(standby_names, sizeof(standby_names), wanted);
+	if (strcmp(standby_names, g_sync_adaptive.applied) == 0)
+	{
+		pthread_mutex_unlock(&g_sync_mutex);
+		return;
+	}
+	pthread_mutex_unlock(&g_sync_mutex);
+
+	if (!ramd_sync_adaptive_apply(conn, standby_names))
+		return;
+
+	pthread_mutex_lock(&g_sync_mutex);
+	if (g_sync_adaptive.primary_node_id == primary_node_id)
+		snprintf(g_sync_adaptive.applied, sizeof(g_sync_adaptive.applied), "%s",
+		         standby_names);
+	pthread_mutex_unlock(&g_sync_mutex);
+
+	ramd_log_info("Adaptive sync: synchronous_standby_names = %s", standby_names);
+}
+
 bool
 ramd_sync_standby_promote_to_sync(int32_t node_id)
 {
@@ -491,22 +871,26 @@ ramd_sync_replication_check_lag(ramd_sync_standby_t *standby)
 bool
 ramd_sync_replication_wait_for_sync(int32_t timeout_ms)
 {
-	int32_t elapsed = 0;
-	int32_t check_interval = RAMD_DEFAULT_SYNC_TIMEOUT_MS;
+	int32_t wanted;
 
-	while (elapsed < timeout_ms)
-	{
-		if (g_sync_status.current_mode != RAMD_SYNC_OFF &&
-		    g_sync_status.num_sync_standbys_connected >= g_sync_config.num_sync_standbys)
-		{
-			return true;
-		}
+	pthread_mutex_lock(&g_sync_mutex);
+	wanted = g_sync_config.mode != RAMD_SYNC_OFF ? g_sync_config.num_sync_standbys : -1;
+	pthread_mutex_unlock(&g_sync_mutex);
 
-		usleep((useconds_t)(check_interval * 1000));
-		elapsed += check_interval;
-	}
+	if (wanted < 0)
+		return false;
 
-	return false;
+	/* Woken by the lag sampler as soon as enough standbys have flushed */
+	return ramd_lag_wait_for_sync(wanted, -1, timeout_ms);
+}
+
+bool
+ramd_sync_replication_wait_for_standby(int32_t node_id, int32_t timeout_ms)
+{
+	if (node_id <= 0)
+		return false;
+
+	return ramd_lag_wait_for_flush(node_id, -1, timeout_ms);
 }
 
 bool
@@ -548,6 +932,7 @@ ramd_sync_replication_configure_recovery(const ramd_config_t *config,
 	FILE    *recovery_file;
 	FILE    *auto_conf_file;
 	PGresult *res;
+	char     slot_name[64] = "";
 
 	if (!config || !primary_host)
 		return false;
@@ -555,6 +940,10 @@ ramd_sync_replication_configure_recovery(const ramd_config_t *config,
 	ramd_log_info("Configuring recovery for streaming replication from %s:%d",
 	              primary_host, primary_port);
 
+	/* The primary's slot manager creates it; until then the walreceiver retries */
+	if (config->replication_slots_enabled)
+		ramd_slots_name(config->node_id, slot_name, sizeof(slot_name));
+
 	snprintf(recovery_conf_path, sizeof(recovery_conf_path), "%s/recovery.conf",
 	         config->postgresql_data_dir);
 
@@ -581,6 +970,8 @@ ramd_sync_replication_configure_recovery(const ramd_config_t *config,
 		        primary_host, primary_port,
 		        config->replication_user, config->replication_user);
 		fprintf(recovery_file, "recovery_target_timeline = 'latest'\n");
+		if (slot_name[0] != '\0')
+			fprintf(recovery_file, "primary_slot_name = '%s'\n", slot_name);
 		fprintf(recovery_file, "trigger_file = '%s/failover.trigger'\n",
 		        config->postgresql_data_dir);
 
@@ -604,6 +995,8 @@ ramd_sync_replication_configure_recovery(const ramd_config_t *config,
 		        primary_host, primary_port,
 		        config->replication_user, config->replication_user);
 		fprintf(auto_conf_file, "recovery_target_timeline = 'latest'\n");
+		if (slot_name[0] != '\0')
+			fprintf(auto_conf_file, "primary_slot_name = '%s'\n", slot_name);
 		fprintf(auto_conf_file, "promote_trigger_file = '%s/failover.trigger'\n",
 		        config->postgresql_data_dir);
 
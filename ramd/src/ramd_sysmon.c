@@ -0,0 +1,546 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_sysmon.c
+ *		PostgreSQL Auto-Failover Daemon - Host Resource Sampler
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Once a second this samples what the host has to spare: CPU busy time
+ * for the host and for ramd, memory the kernel cannot reclaim, the PSI
+ * stall figures, and busy time and latency of the block device holding
+ * the PostgreSQL data directory, all from /proc.  The monitor adds its
+ * round trips to the peers.  Samples go into a performance_monitor_t
+ * ring, whose rolling average gives the host's load: the worst of the
+ * CPU, stall and disk figures, as a percentage.
+ *
+ * Load lowers the local node's health score, but never below the healthy
+ * threshold: a busy node is still a working one.  Peers learn it from the
+ * status query, which reads it off the application_name of the monitor's
+ * local session, and failover passes over a saturated standby for one
+ * that is not, so a standby that cannot keep up with its own disk is not
+ * the one that ends up taking the primary's writes.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(__linux__)
+#include <sys/sysmacros.h>
+#endif
+
+#include "ramd_sysmon.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+typedef struct ramd_sysmon_peer_t
+{
+	int32_t node_id; /* 0: unused */
+	int64_t rtt_us;
+} ramd_sysmon_peer_t;
+
+/* Cumulative counters from the previous sample, for the deltas */
+typedef struct ramd_sysmon_counters_t
+{
+	bool valid;
+	int64_t wall_us;
+	int64_t process_cpu_us;
+	bool host_valid;
+	unsigned long long host_busy;
+	unsigned long long host_total;
+	bool disk_valid;
+	unsigned long long disk_requests;
+	unsigned long long disk_request_ms;
+	unsigned long long disk_busy_ms;
+} ramd_sysmon_counters_t;
+
+typedef struct ramd_sysmon_t
+{
+	pthread_mutex_t lock; /* guards everything below but counters */
+	pthread_cond_t cond;  /* wakes the sampler to stop */
+	bool running;
+	pthread_t thread;
+	performance_monitor_t* history;
+	ramd_sysmon_peer_t peers[RAMD_MAX_NODES];
+	unsigned int disk_major;
+	unsigned int disk_minor;
+	bool disk_known; /* the data directory's device was found */
+	ramd_sysmon_counters_t counters; /* sampler thread only */
+} ramd_sysmon_t;
+
+static ramd_sysmon_t g_sysmon = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+static long long
+ramd_sysmon_epoch_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Busy and total jiffies of all CPUs; iowait counts as idle */
+static bool
+ramd_sysmon_read_host_cpu(unsigned long long* busy, unsigned long long* total)
+{
+	unsigned long long v[8] = {0};
+	FILE* file;
+	int n;
+
+	file = fopen("/proc/stat", "r");
+	if (!file)
+		return false;
+	n = fscanf(file, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+	           &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+	fclose(file);
+	if (n < 4)
+		return false;
+
+	*total = 0;
+	for (int i = 0; i < 8; i++)
+		*total += v[i];
+	*busy = *total - v[3] - v[4];
+	return true;
+}
+
+static int64_t
+ramd_sysmon_process_cpu_us(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return -1;
+	return (int64_t) usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec +
+	       (int64_t) usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+}
+
+/* Percent of memory not available to new allocations; -1 if unknown */
+static double
+ramd_sysmon_read_memory(void)
+{
+	char line[256];
+	long long total_kb = -1;
+	long long available_kb = -1;
+	FILE* file;
+
+	file = fopen("/proc/meminfo", "r");
+	if (!file)
+		return -1.0;
+	while (fgets(line, sizeof(line), file) && (total_kb < 0 || available_kb < 0))
+	{
+		if (sscanf(line, "MemTotal: %lld kB", &total_kb) == 1)
+			continue;
+		(void) sscanf(line, "MemAvailable: %lld kB", &available_kb);
+	}
+	fclose(file);
+
+	if (total_kb <= 0 || available_kb < 0)
+		return -1.0;
+	return 100.0 * (1.0 - (double) available_kb / (double) total_kb);
+}
+
+/* "some avg10" of a PSI file; -1 without PSI (kernels before 4.20) */
+static double
+ramd_sysmon_read_pressure(const char* resource)
+{
+	char path[64];
+	double avg10;
+	FILE* file;
+	int n;
+
+	snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+	file = fopen(path, "r");
+	if (!file)
+		return -1.0;
+	n = fscanf(file, "some avg10=%lf", &avg10);
+	fclose(file);
+	return n == 1 ? avg10 : -1.0;
+}
+
+/* Completed requests, the ms they took and the ms the device was busy */
+static bool
+ramd_sysmon_read_disk(unsigned long long* requests, unsigned long long* request_ms,
+                      unsigned long long* busy_ms)
+{
+	char line[512];
+	bool found = false;
+	FILE* file;
+
+	file = fopen("/proc/diskstats", "r");
+	if (!file)
+		return false;
+	while (!found && fgets(line, sizeof(line), file))
+	{
+		unsigned int major_id;
+		unsigned int minor_id;
+		char name[64];
+		unsigned long long reads, reads_merged, sectors_read, read_ms;
+		unsigned long long writes, writes_merged, sectors_written, write_ms;
+		unsigned long long in_flight, io_ms;
+
+		if (sscanf(line, "%u %u %63s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		           &major_id, &minor_id, name, &reads, &reads_merged, &sectors_read,
+		           &read_ms, &writes, &writes_merged, &sectors_written, &write_ms,
+		           &in_flight, &io_ms) != 13)
+			continue;
+		if (major_id != g_sysmon.disk_major || minor_id != g_sysmon.disk_minor)
+			continue;
+
+		*requests = reads + writes;
+		*request_ms = read_ms + write_ms;
+		*busy_ms = io_ms;
+		found = true;
+	}
+	fclose(file);
+	return found;
+}
+
+/* Worst round trip among the peers the monitor reached last */
+static double
+ramd_sysmon_worst_peer_rtt_ms(void)
+{
+	int64_t worst = -1;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		if (g_sysmon.peers[i].node_id != 0 && g_sysmon.peers[i].rtt_us > worst)
+			worst = g_sysmon.peers[i].rtt_us;
+	}
+	return worst >= 0 ? (double) worst / 1000.0 : -1.0;
+}
+
+static void
+ramd_sysmon_sample_once(void)
+{
+	ramd_sysmon_counters_t* last = &g_sysmon.counters;
+	ramd_sysmon_counters_t now;
+	performance_metrics_t sample;
+	double wall_ms;
+
+	memset(&now, 0, sizeof(now));
+	now.valid = true;
+	now.wall_us = ramd_clock_now_us();
+	now.process_cpu_us = ramd_sysmon_process_cpu_us();
+	now.host_valid = ramd_sysmon_read_host_cpu(&now.host_busy, &now.host_total);
+	now.disk_valid = g_sysmon.disk_known &&
+	                 ramd_sysmon_read_disk(&now.disk_requests, &now.disk_request_ms,
+	                                       &now.disk_busy_ms);
+
+	sample.timestamp = ramd_sysmon_epoch_ms();
+	sample.cpu_usage = -1.0;
+	sample.process_cpu_usage = -1.0;
+	sample.disk_io = -1.0;
+	sample.disk_latency_ms = -1.0;
+	sample.memory_usage = ramd_sysmon_read_memory();
+	sample.cpu_pressure = ramd_sysmon_read_pressure("cpu");
+	sample.io_pressure = ramd_sysmon_read_pressure("io");
+	sample.memory_pressure = ramd_sysmon_read_pressure("memory");
+
+	wall_ms = last->valid ? (double) (now.wall_us - last->wall_us) / 1000.0 : 0.0;
+	if (wall_ms > 0.0)
+	{
+		if (now.process_cpu_us >= 0 && last->process_cpu_us >= 0)
+			sample.process_cpu_usage =
+				(double) (now.process_cpu_us - last->process_cpu_us) / 10.0 / wall_ms;
+
+		if (now.host_valid && last->host_valid && now.host_total > last->host_total)
+			sample.cpu_usage = 100.0 * (double) (now.host_busy - last->host_busy) /
+			                   (double) (now.host_total - last->host_total);
+
+		if (now.disk_valid && last->disk_valid)
+		{
+			unsigned long long requests = now.disk_requests - last->disk_requests;
+
+			sample.disk_io = 100.0 * (double) (now.disk_busy_ms - last->disk_busy_ms) / wall_ms;
+			if (sample.disk_io > 100.0)
+				sample.disk_io = 100.0;
+			/* An idle device has no latency to speak of, which is not a slow one */
+			sample.disk_latency_ms = requests > 0
+				? (double) (now.disk_request_ms - last->disk_request_ms) / (double) requests
+				: 0.0;
+		}
+	}
+	*last = now;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	sample.network_rtt_ms = ramd_sysmon_worst_peer_rtt_ms();
+	performance_monitor_add_metrics(g_sysmon.history, &sample);
+	pthread_mutex_unlock(&g_sysmon.lock);
+}
+
+static void*
+ramd_sysmon_thread_main(void* arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	while (g_sysmon.running)
+	{
+		struct timespec deadline;
+
+		pthread_mutex_unlock(&g_sysmon.lock);
+		ramd_sysmon_sample_once();
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += RAMD_SYSMON_INTERVAL_MS / 1000;
+		deadline.tv_nsec += (long) (RAMD_SYSMON_INTERVAL_MS % 1000) * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		pthread_mutex_lock(&g_sysmon.lock);
+		if (g_sysmon.running)
+			pthread_cond_timedwait(&g_sysmon.cond, &g_sysmon.lock, &deadline);
+	}
+	pthread_mutex_unlock(&g_sysmon.lock);
+	return NULL;
+}
+
+bool
+ramd_sysmon_start(const ramd_config_t* config)
+{
+	struct stat st;
+
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	if (g_sysmon.running)
+	{
+		pthread_mutex_unlock(&g_sysmon.lock);
+		return true;
+	}
+
+	g_sysmon.history = performance_monitor_create(RAMD_SYSMON_HISTORY_SIZE);
+	if (!g_sysmon.history)
+	{
+		pthread_mutex_unlock(&g_sysmon.lock);
+		return false;
+	}
+	memset(g_sysmon.peers, 0, sizeof(g_sysmon.peers));
+	memset(&g_sysmon.counters, 0, sizeof(g_sysmon.counters));
+
+	/* Filesystems with no block device of their own (tmpfs, overlay) have major 0 */
+	g_sysmon.disk_known = stat(config->postgresql_data_dir, &st) == 0 && major(st.st_dev) != 0;
+	if (g_sysmon.disk_known)
+	{
+		g_sysmon.disk_major = major(st.st_dev);
+		g_sysmon.disk_minor = minor(st.st_dev);
+	}
+	else
+		ramd_log_info("System sampler: no block device found for %s, disk figures disabled",
+		              config->postgresql_data_dir);
+
+	g_sysmon.running = true;
+	if (pthread_create(&g_sysmon.thread, NULL, ramd_sysmon_thread_main, NULL) != 0)
+	{
+		g_sysmon.running = false;
+		performance_monitor_destroy(g_sysmon.history);
+		g_sysmon.history = NULL;
+		pthread_mutex_unlock(&g_sysmon.lock);
+		ramd_log_error("System sampler: cannot start thread: %s", strerror(errno));
+		return false;
+	}
+	pthread_mutex_unlock(&g_sysmon.lock);
+	return true;
+}
+
+void
+ramd_sysmon_stop(void)
+{
+	pthread_mutex_lock(&g_sysmon.lock);
+	if (!g_sysmon.running)
+	{
+		pthread_mutex_unlock(&g_sysmon.lock);
+		return;
+	}
+	g_sysmon.running = false;
+	pthread_cond_broadcast(&g_sysmon.cond);
+	pthread_mutex_unlock(&g_sysmon.lock);
+
+	pthread_join(g_sysmon.thread, NULL);
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	performance_monitor_destroy(g_sysmon.history);
+	g_sysmon.history = NULL;
+	pthread_mutex_unlock(&g_sysmon.lock);
+}
+
+void
+ramd_sysmon_note_peer_rtt(int32_t node_id, int64_t rtt_us)
+{
+	ramd_sysmon_peer_t* free_slot = NULL;
+
+	if (node_id <= 0)
+		return;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_sysmon_peer_t* peer = &g_sysmon.peers[i];
+
+		if (peer->node_id == node_id)
+		{
+			free_slot = peer;
+			break;
+		}
+		if (peer->node_id == 0 && !free_slot)
+			free_slot = peer;
+	}
+	if (free_slot)
+	{
+		free_slot->node_id = rtt_us >= 0 ? node_id : 0;
+		free_slot->rtt_us = rtt_us;
+	}
+	pthread_mutex_unlock(&g_sysmon.lock);
+}
+
+/* Caller holds the lock */
+static int32_t
+ramd_sysmon_load_locked(void)
+{
+	performance_metrics_t average;
+	double saturation;
+
+	if (!performance_monitor_get_average(g_sysmon.history, PERFORMANCE_HEALTH_WINDOW, &average))
+		return -1;
+	saturation = performance_metrics_saturation(&average);
+	return (int32_t) (saturation + 0.5);
+}
+
+int32_t
+ramd_sysmon_load(void)
+{
+	int32_t load;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	load = ramd_sysmon_load_locked();
+	pthread_mutex_unlock(&g_sysmon.lock);
+	return load;
+}
+
+float
+ramd_sysmon_health_for_load(int32_t load)
+{
+	float span = (float) (PERFORMANCE_SATURATED_PERCENT - RAMD_SYSMON_BUSY_LOAD);
+
+	if (load <= RAMD_SYSMON_BUSY_LOAD)
+		return RAMD_MAX_HEALTH_SCORE;
+	if (load >= (int32_t) PERFORMANCE_SATURATED_PERCENT)
+		return RAMD_SYSMON_SATURATED_HEALTH;
+	return RAMD_MAX_HEALTH_SCORE - (RAMD_MAX_HEALTH_SCORE - RAMD_SYSMON_SATURATED_HEALTH) *
+	                               (float) (load - RAMD_SYSMON_BUSY_LOAD) / span;
+}
+
+bool
+ramd_sysmon_load_is_saturated(int32_t load)
+{
+	return load >= (int32_t) PERFORMANCE_SATURATED_PERCENT;
+}
+
+bool
+ramd_sysmon_get_summary(ramd_sysmon_summary_t* summary)
+{
+	const performance_metrics_t* latest;
+	bool ok = false;
+
+	if (!summary)
+		return false;
+
+	memset(summary, 0, sizeof(*summary));
+	summary->load = -1;
+
+	pthread_mutex_lock(&g_sysmon.lock);
+	latest = performance_monitor_get_latest(g_sysmon.history);
+	if (latest)
+	{
+		summary->latest = *latest;
+		summary->sample_count = (int32_t) g_sysmon.history->count;
+		summary->load = ramd_sysmon_load_locked();
+		ok = performance_monitor_get_average(g_sysmon.history, PERFORMANCE_HEALTH_WINDOW,
+		                                     &summary->average) &&
+		     performance_monitor_get_percentile(g_sysmon.history, 0, 95.0, &summary->p95);
+	}
+	pthread_mutex_unlock(&g_sysmon.lock);
+	return ok;
+}
+
+typedef struct ramd_sysmon_series_t
+{
+	const char* name;
+	const char* help;
+	size_t offset;
+} ramd_sysmon_series_t;
+
+static const ramd_sysmon_series_t ramd_sysmon_series[] = {
+	{"ramd_host_cpu_percent", "Host CPU busy time",
+	 offsetof(performance_metrics_t, cpu_usage)},
+	{"ramd_process_cpu_percent", "CPU time used by the daemon, percent of one CPU",
+	 offsetof(performance_metrics_t, process_cpu_usage)},
+	{"ramd_host_memory_percent", "Host memory not available for new allocations",
+	 offsetof(performance_metrics_t, memory_usage)},
+	{"ramd_host_cpu_pressure_percent", "Time some task stalled on CPU (PSI avg10)",
+	 offsetof(performance_metrics_t, cpu_pressure)},
+	{"ramd_host_io_pressure_percent", "Time some task stalled on I/O (PSI avg10)",
+	 offsetof(performance_metrics_t, io_pressure)},
+	{"ramd_host_memory_pressure_percent", "Time some task stalled on memory (PSI avg10)",
+	 offsetof(performance_metrics_t, memory_pressure)},
+	{"ramd_data_device_busy_percent", "Busy time of the data directory's block device",
+	 offsetof(performance_metrics_t, disk_io)},
+	{"ramd_data_device_latency_ms", "Average time per request on the data directory's device",
+	 offsetof(performance_metrics_t, disk_latency_ms)},
+	{"ramd_peer_rtt_max_ms", "Slowest round trip to a peer in the last monitor cycle",
+	 offsetof(performance_metrics_t, network_rtt_ms)},
+};
+
+bool
+ramd_sysmon_render_prometheus(ramd_buffer_t* output)
+{
+	ramd_sysmon_summary_t summary;
+	bool ok = true;
+
+	if (!output)
+		return false;
+	if (!ramd_sysmon_get_summary(&summary))
+		return true; /* not started, or no sample yet */
+
+	ok &= ramd_buffer_appendf(output,
+		"\n# HELP ramd_host_load Worst host resource saturation over the last %d samples\n"
+		"# TYPE ramd_host_load gauge\n"
+		"ramd_host_load %d\n", PERFORMANCE_HEALTH_WINDOW, summary.load);
+
+	for (size_t i = 0; i < sizeof(ramd_sysmon_series) / sizeof(ramd_sysmon_series[0]); i++)
+	{
+		const ramd_sysmon_series_t* series = &ramd_sysmon_series[i];
+		const performance_metrics_t* stats[] = {&summary.latest, &summary.average, &summary.p95};
+		const char* labels[] = {"last", "avg", "p95"};
+
+		if (*(const double*) ((const char*) &summary.p95 + series->offset) < 0.0)
+			continue; /* never measured on this host */
+
+		ok &= ramd_buffer_appendf(output, "\n# HELP %s %s\n# TYPE %s gauge\n",
+		                          series->name, series->help, series->name);
+		for (size_t j = 0; j < 3; j++)
+		{
+			double value = *(const double*) ((const char*) stats[j] + series->offset);
+
+			if (value >= 0.0)
+				ok &= ramd_buffer_appendf(output, "%s{stat=\"%s\"} %.2f\n",
+				                          series->name, labels[j], value);
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,350 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_tls.c
+ *		PostgreSQL Auto-Failover Daemon - TLS for the HTTP API
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * With ssl_enabled, the HTTP listener speaks TLS 1.2 or later to every
+ * client that is not on loopback; local probes and the Unix socket stay
+ * plaintext since their bytes never leave the host.  Load balancers and
+ * monitoring open a fresh connection for each /health probe, so repeat
+ * handshakes are made cheap: TLS 1.3 clients get a session ticket, TLS
+ * 1.2 clients also find their session in a server-side cache, and a
+ * resumed handshake skips the certificate and its signature.  The ticket
+ * keys survive certificate reloads, so a reload does not send every
+ * client back to a full handshake.
+ *
+ * With ssl_ktls, OpenSSL hands the session keys to the kernel after the
+ * handshake where the kernel and the cipher allow it (the Linux tls
+ * module, AES-GCM), and records are sealed and opened under plain
+ * write() and read() from then on.  Where they do not, the connection
+ * silently stays in userspace; the status counts which ones got it.
+ *
+ * The certificate and key are checked for changes at most every
+ * RAMD_TLS_RELOAD_CHECK_MS, when a client connects.  A changed pair goes
+ * into a new context for the next connections while open ones finish on
+ * the old; a pair that does not load, for instance one caught half
+ * written, leaves the old one serving until the files change again.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <openssl/err.h>
+
+#include "ramd_tls.h"
+#include "ramd_clock.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+
+/* key name, HMAC secret and AES key, as SSL_CTX_get_tlsext_ticket_keys() wants */
+#define RAMD_TLS_TICKET_KEYS_LENGTH 80
+
+typedef struct ramd_tls_state_t
+{
+	pthread_mutex_t lock;
+	bool enabled;
+	bool ktls;
+	char cert_file[RAMD_MAX_PATH_LENGTH];
+	char key_file[RAMD_MAX_PATH_LENGTH];
+	SSL_CTX* ctx;      /* for new connections; sessions hold a reference */
+	char stamp[128];   /* sizes and modification times of the last attempt */
+	int64_t checked_ms;
+	int64_t loaded_ms;
+} ramd_tls_state_t;
+
+static ramd_tls_state_t g_tls = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static atomic_llong g_tls_handshakes;
+static atomic_llong g_tls_resumed;
+static atomic_llong g_tls_ktls_send;
+static atomic_llong g_tls_ktls_recv;
+static atomic_llong g_tls_reloads;
+
+static void
+ramd_tls_log_openssl(const char* what)
+{
+	char          reason[256];
+	unsigned long err = ERR_get_error();
+
+	if (err == 0)
+		snprintf(reason, sizeof(reason), "unknown error");
+	else
+		ERR_error_string_n(err, reason, sizeof(reason));
+	ERR_clear_error();
+	ramd_log_error("TLS: %s: %s", what, reason);
+}
+
+/* What changes when either file is replaced; a missing file counts too */
+static void
+ramd_tls_stamp(const char* cert_file, const char* key_file, char* out, size_t size)
+{
+	const char* paths[2] = {cert_file, key_file};
+	struct stat st;
+	size_t      len = 0;
+	int         i;
+
+	out[0] = '\0';
+	for (i = 0; i < 2 && len < size; i++)
+	{
+		if (stat(paths[i], &st) == 0)
+			len += (size_t) snprintf(out + len, size - len, "%lld.%lld.%ld;",
+			                         (long long) st.st_size, (long long) st.st_mtim.tv_sec,
+			                         (long) st.st_mtim.tv_nsec);
+		else
+			len += (size_t) snprintf(out + len, size - len, "-;");
+	}
+}
+
+/*
+ * A server context for cert_file and key_file.  Ticket keys are taken over
+ * from previous so tickets it issued still resume.
+ */
+static SSL_CTX*
+ramd_tls_context_new(const char* cert_file, const char* key_file, bool ktls,
+                     SSL_CTX* previous)
+{
+	unsigned char keys[RAMD_TLS_TICKET_KEYS_LENGTH];
+	SSL_CTX*      ctx;
+
+	ctx = SSL_CTX_new(TLS_server_method());
+	if (!ctx)
+	{
+		ramd_tls_log_openssl("cannot create a context");
+		return NULL;
+	}
+
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	SSL_CTX_set_options(ctx, SSL_OP_NO_COMPRESSION | SSL_OP_NO_RENEGOTIATION |
+	                             SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+	/*
+	 * The event loop writes whatever the socket takes and retries from the
+	 * same offset, and idle keep-alive connections should not pin 34 kB of
+	 * record buffers each.
+	 */
+	SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+	                          SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, RAMD_TLS_SESSION_CACHE_SIZE);
+	SSL_CTX_set_timeout(ctx, RAMD_TLS_SESSION_TIMEOUT_S);
+	SSL_CTX_set_session_id_context(ctx, (const unsigned char*) "ramd", 4);
+	SSL_CTX_set_num_tickets(ctx, RAMD_TLS_TICKETS_PER_HANDSHAKE);
+	if (previous &&
+	    SSL_CTX_get_tlsext_ticket_keys(previous, keys, sizeof(keys)) == 1)
+		SSL_CTX_set_tlsext_ticket_keys(ctx, keys, sizeof(keys));
+	OPENSSL_cleanse(keys, sizeof(keys));
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+	if (ktls)
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#else
+	(void) ktls;
+#endif
+
+	if (SSL_CTX_use_certificate_chain_file(ctx, cert_file) != 1)
+	{
+		ramd_tls_log_openssl(cert_file);
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	if (SSL_CTX_use_PrivateKey_file(ctx, key_file, SSL_FILETYPE_PEM) != 1 ||
+	    SSL_CTX_check_private_key(ctx) != 1)
+	{
+		ramd_tls_log_openssl(key_file);
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* Load the files again if they changed since the last attempt */
+static bool
+ramd_tls_load_locked(void)
+{
+	char     stamp[sizeof(g_tls.stamp)];
+	SSL_CTX* ctx;
+	bool     reload = g_tls.ctx != NULL;
+
+	g_tls.checked_ms = ramd_clock_now_ms();
+	ramd_tls_stamp(g_tls.cert_file, g_tls.key_file, stamp, sizeof(stamp));
+	if (strcmp(stamp, g_tls.stamp) == 0)
+		return g_tls.ctx != NULL;
+	memcpy(g_tls.stamp, stamp, sizeof(g_tls.stamp));
+
+	ctx = ramd_tls_context_new(g_tls.cert_file, g_tls.key_file, g_tls.ktls, g_tls.ctx);
+	if (!ctx)
+	{
+		if (reload)
+			ramd_log_warning("TLS: keeping the previous certificate until %s changes again",
+			                 g_tls.cert_file);
+		return false;
+	}
+
+	if (g_tls.ctx)
+		SSL_CTX_free(g_tls.ctx);
+	g_tls.ctx = ctx;
+	g_tls.loaded_ms = g_tls.checked_ms;
+	if (reload)
+	{
+		atomic_fetch_add(&g_tls_reloads, 1);
+		ramd_log_info("TLS: reloaded certificate %s", g_tls.cert_file);
+	}
+	else
+		ramd_log_info("TLS: HTTP API serves TLS with certificate %s%s", g_tls.cert_file,
+		              g_tls.ktls ? ", kernel TLS where available" : "");
+	return true;
+}
+
+bool
+ramd_tls_init(const ramd_config_t* config)
+{
+	atomic_store(&g_tls_handshakes, 0);
+	atomic_store(&g_tls_resumed, 0);
+	atomic_store(&g_tls_ktls_send, 0);
+	atomic_store(&g_tls_ktls_recv, 0);
+	atomic_store(&g_tls_reloads, 0);
+
+	if (!config)
+		return true;
+	return ramd_tls_configure(config);
+}
+
+bool
+ramd_tls_configure(const ramd_config_t* config)
+{
+	bool ok = true;
+
+	if (!config)
+		return false;
+
+	pthread_mutex_lock(&g_tls.lock);
+	if (g_tls.enabled == config->ssl_enabled && g_tls.ktls == config->ssl_ktls &&
+	    strcmp(g_tls.cert_file, config->ssl_cert_file) == 0 &&
+	    strcmp(g_tls.key_file, config->ssl_key_file) == 0)
+	{
+		pthread_mutex_unlock(&g_tls.lock);
+		return true;
+	}
+
+	g_tls.enabled = config->ssl_enabled;
+	g_tls.ktls = config->ssl_ktls;
+	strncpy(g_tls.cert_file, config->ssl_cert_file, sizeof(g_tls.cert_file) - 1);
+	g_tls.cert_file[sizeof(g_tls.cert_file) - 1] = '\0';
+	strncpy(g_tls.key_file, config->ssl_key_file, sizeof(g_tls.key_file) - 1);
+	g_tls.key_file[sizeof(g_tls.key_file) - 1] = '\0';
+	g_tls.stamp[0] = '\0';
+
+	if (!g_tls.enabled)
+	{
+		if (g_tls.ctx)
+		{
+			SSL_CTX_free(g_tls.ctx);
+			g_tls.ctx = NULL;
+			ramd_log_info("TLS: HTTP API serves plaintext");
+		}
+		pthread_mutex_unlock(&g_tls.lock);
+		return true;
+	}
+
+#if !defined(SSL_OP_ENABLE_KTLS) || defined(OPENSSL_NO_KTLS)
+	if (g_tls.ktls)
+		ramd_log_warning("TLS: ssl_ktls is set but this OpenSSL has no kernel TLS; "
+		                 "records are sealed in userspace");
+#endif
+
+	ok = ramd_tls_load_locked();
+	pthread_mutex_unlock(&g_tls.lock);
+	return ok;
+}
+
+void
+ramd_tls_cleanup(void)
+{
+	pthread_mutex_lock(&g_tls.lock);
+	if (g_tls.ctx)
+		SSL_CTX_free(g_tls.ctx);
+	g_tls.ctx = NULL;
+	g_tls.enabled = false;
+	g_tls.cert_file[0] = '\0';
+	g_tls.key_file[0] = '\0';
+	g_tls.stamp[0] = '\0';
+	pthread_mutex_unlock(&g_tls.lock);
+}
+
+bool
+ramd_tls_enabled(void)
+{
+	bool enabled;
+
+	pthread_mutex_lock(&g_tls.lock);
+	enabled = g_tls.enabled;
+	pthread_mutex_unlock(&g_tls.lock);
+	return enabled;
+}
+
+SSL*
+ramd_tls_session_new(int fd)
+{
+	SSL* ssl = NULL;
+
+	pthread_mutex_lock(&g_tls.lock);
+	if (g_tls.enabled && ramd_clock_now_ms() - g_tls.checked_ms >= RAMD_TLS_RELOAD_CHECK_MS)
+		(void) ramd_tls_load_locked();
+	if (g_tls.ctx)
+		ssl = SSL_new(g_tls.ctx);
+	pthread_mutex_unlock(&g_tls.lock);
+
+	if (!ssl)
+		return NULL;
+	if (SSL_set_fd(ssl, fd) != 1)
+	{
+		ramd_tls_log_openssl("cannot attach a session to the socket");
+		SSL_free(ssl);
+		return NULL;
+	}
+	SSL_set_accept_state(ssl);
+	return ssl;
+}
+
+void
+ramd_tls_note_handshake(SSL* ssl)
+{
+	atomic_fetch_add(&g_tls_handshakes, 1);
+	if (SSL_session_reused(ssl))
+		atomic_fetch_add(&g_tls_resumed, 1);
+#ifndef OPENSSL_NO_KTLS
+	if (BIO_get_ktls_send(SSL_get_wbio(ssl)))
+		atomic_fetch_add(&g_tls_ktls_send, 1);
+	if (BIO_get_ktls_recv(SSL_get_rbio(ssl)))
+		atomic_fetch_add(&g_tls_ktls_recv, 1);
+#endif
+}
+
+void
+ramd_tls_get_status(ramd_tls_status_t* status)
+{
+	if (!status)
+		return;
+
+	memset(status, 0, sizeof(*status));
+	pthread_mutex_lock(&g_tls.lock);
+	status->enabled = g_tls.enabled && g_tls.ctx != NULL;
+	status->ktls_requested = g_tls.ktls;
+	status->loaded_wall_ms = g_tls.ctx ? ramd_clock_wall_ms(g_tls.loaded_ms) : 0;
+	memcpy(status->cert_file, g_tls.cert_file, sizeof(status->cert_file)); /* same size */
+	pthread_mutex_unlock(&g_tls.lock);
+
+	status->handshakes = atomic_load(&g_tls_handshakes);
+	status->resumed = atomic_load(&g_tls_resumed);
+	status->ktls_send = atomic_load(&g_tls_ktls_send);
+	status->ktls_recv = atomic_load(&g_tls_ktls_recv);
+	status->reloads = atomic_load(&g_tls_reloads);
+}
@@ -0,0 +1,597 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_topology.c
+ *		PostgreSQL Auto-Failover Daemon - Cascading Replication Planner
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * With every standby streaming from the primary, each one costs the
+ * primary a walsender and a copy of the WAL on its network link.  When
+ * cascade_enabled is on, the asynchronous standbys of each zone (see
+ * node_zones) are arranged into a tree instead: one of them, the hub,
+ * streams from the primary and feeds up to cascade_max_fanout others,
+ * each of which feeds more in turn.  Synchronous standbys always stay on
+ * the primary, since a cascaded standby cannot acknowledge commits.
+ *
+ * The plan is redone after every lag sample and is sticky: a hub keeps
+ * its place while it stays healthy and within cascade_max_lag_ms, and a
+ * new one must be within half of that, so lag noise does not move
+ * standbys around.  A hub or feeder that fails simply drops out of the
+ * next plan and its standbys are moved to whoever is left, or back to
+ * the primary.  Standbys are repointed over SQL like in a failover, each
+ * with its slot created on the new upstream first; the slot it leaves
+ * behind on a standby is dropped once it is no longer in use.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libpq-fe.h>
+
+#include "ramd_topology.h"
+#include "ramd_clock.h"
+#include "ramd_conn.h"
+#include "ramd_defaults.h"
+#include "ramd_logging.h"
+#include "ramd_postgresql.h"
+#include "ramd_slots.h"
+
+typedef struct ramd_topology_entry_t
+{
+	bool used;
+	bool member;               /* in the cluster view on the latest pass */
+	bool eligible;             /* healthy standby; may be cascaded */
+	bool was_hub;              /* fed others straight off the primary last plan */
+	int64_t retry_at_us;       /* no repoint before this after one failed */
+	int32_t stale_upstream_id; /* standby still holding this node's slot, 0 if none */
+	ramd_topology_node_t info;
+} ramd_topology_entry_t;
+
+typedef struct ramd_topology_state_t
+{
+	pthread_mutex_t lock; /* readers are the HTTP threads and the slot manager */
+	int32_t primary_node_id;
+	ramd_topology_entry_t entries[RAMD_MAX_NODES];
+} ramd_topology_state_t;
+
+static ramd_topology_state_t g_topology = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.primary_node_id = -1
+};
+
+/* Look node_id up in "<node_id>:<zone>,..."; zone is left empty if absent */
+static void
+ramd_topology_zone(const char* zones, int32_t node_id, char* zone, size_t size)
+{
+	const char* p = zones;
+
+	zone[0] = '\0';
+	while (p && *p)
+	{
+		char*       end;
+		long        id = strtol(p, &end, 10);
+		const char* next = strchr(end, ',');
+
+		if (end != p && *end == ':' && id == node_id)
+		{
+			const char* z = end + 1;
+			size_t      length = next ? (size_t) (next - z) : strlen(z);
+
+			while (length > 0 && *z == ' ')
+			{
+				z++;
+				length--;
+			}
+			while (length > 0 && z[length - 1] == ' ')
+				length--;
+			if (length >= size)
+				length = size - 1;
+			memcpy(zone, z, length);
+			zone[length] = '\0';
+			return;
+		}
+		p = next ? next + 1 : NULL;
+	}
+}
+
+/* Named in sync_standby_names, so it must be able to become synchronous */
+static bool
+ramd_topology_named_sync(const ramd_config_t* config, int32_t node_id)
+{
+	const char* names = config->sync_standby_names;
+	const char* p = names;
+	char        name[64];
+	size_t      length;
+
+	ramd_slots_name(node_id, name, sizeof(name));
+	length = strlen(name);
+	while ((p = strstr(p, name)) != NULL)
+	{
+		if ((p == names || !(isalnum((unsigned char) p[-1]) || p[-1] == '_')) &&
+		    !(isalnum((unsigned char) p[length]) || p[length] == '_'))
+			return true;
+		p += length;
+	}
+	return false;
+}
+
+static ramd_topology_entry_t*
+ramd_topology_find(int32_t node_id, bool create)
+{
+	ramd_topology_entry_t* free_entry = NULL;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_topology_entry_t* e = &g_topology.entries[i];
+
+		if (!e->used)
+		{
+			if (!free_entry)
+				free_entry = e;
+			continue;
+		}
+		if (e->info.node_id == node_id)
+			return e;
+	}
+
+	if (!create || !free_entry)
+		return NULL;
+
+	memset(free_entry, 0, sizeof(*free_entry));
+	free_entry->used = true;
+	free_entry->info.node_id = node_id;
+	free_entry->info.applied_upstream_id = -1;
+	free_entry->info.replay_lag_ms = -1;
+	return free_entry;
+}
+
+/* Fold the cluster view and the primary's lag round into the table */
+static void
+ramd_topology_refresh(int32_t primary_node_id, const ramd_cluster_t* cluster,
+                      const ramd_config_t* config, const ramd_lag_stats_t* stats,
+                      int32_t count)
+{
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+		g_topology.entries[i].member = false;
+
+	for (int32_t i = 0; i < cluster->node_count; i++)
+	{
+		const ramd_node_t*     node = &cluster->nodes[i];
+		const ramd_lag_stats_t* lag = NULL;
+		ramd_topology_entry_t* e;
+
+		if (node->node_id <= 0 || node->node_id == primary_node_id)
+			continue;
+		e = ramd_topology_find(node->node_id, true);
+		if (!e)
+			continue;
+
+		for (int32_t j = 0; j < count; j++)
+		{
+			if (stats[j].node_id == node->node_id && stats[j].connected)
+				lag = &stats[j];
+		}
+
+		e->member = true;
+		ramd_topology_zone(config->node_zones, node->node_id, e->info.zone,
+		                   sizeof(e->info.zone));
+
+		/* A cascaded standby is not in pg_stat_replication; keep what we knew */
+		if (lag)
+		{
+			e->info.is_sync = lag->is_sync;
+			e->info.replay_lag_ms = lag->last.replay_lag_ms;
+		}
+		else
+			e->info.replay_lag_ms = -1;
+		if (ramd_topology_named_sync(config, node->node_id))
+			e->info.is_sync = true;
+
+		e->eligible = node->role != RAMD_ROLE_PRIMARY && node->is_healthy &&
+		              node->state != RAMD_NODE_STATE_FAILED &&
+		              node->state != RAMD_NODE_STATE_RECOVERING;
+
+		/* Rebuilt or restarted meanwhile; where it streams from is not known */
+		if (!e->eligible)
+		{
+			if (e->stale_upstream_id == 0 && e->info.applied_upstream_id > 0 &&
+			    e->info.applied_upstream_id != primary_node_id)
+				e->stale_upstream_id = e->info.applied_upstream_id;
+			e->info.applied_upstream_id = -1;
+		}
+	}
+
+	/* A node that left still has a slot on its upstream to clean up */
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_topology_entry_t* e = &g_topology.entries[i];
+
+		if (!e->used || e->member)
+			continue;
+		if (e->stale_upstream_id == 0 && e->info.applied_upstream_id > 0 &&
+		    e->info.applied_upstream_id != primary_node_id)
+			e->stale_upstream_id = e->info.applied_upstream_id;
+		e->info.applied_upstream_id = -1;
+		e->eligible = false;
+		if (e->stale_upstream_id == 0)
+			e->used = false;
+	}
+}
+
+static int
+ramd_topology_compare(const void* a, const void* b)
+{
+	const ramd_topology_entry_t* ea = *(const ramd_topology_entry_t* const*) a;
+	const ramd_topology_entry_t* eb = *(const ramd_topology_entry_t* const*) b;
+
+	return (ea->info.node_id > eb->info.node_id) - (ea->info.node_id < eb->info.node_id);
+}
+
+/* Plan one zone: a hub off the primary, the rest breadth first below it */
+static void
+ramd_topology_plan_zone(ramd_topology_entry_t** group, int32_t count,
+                        const ramd_config_t* config)
+{
+	ramd_topology_entry_t* feeders[RAMD_MAX_NODES];
+	int32_t                feeder_count = 0;
+	int32_t                hub = -1;
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		int32_t lag = group[i]->info.replay_lag_ms;
+
+		/* A hub streams from the primary, so its lag is measured */
+		if (lag < 0 || lag > config->cascade_max_lag_ms)
+			continue;
+		if (group[i]->was_hub)
+		{
+			hub = i;
+			break;
+		}
+		if (lag <= config->cascade_max_lag_ms / 2 &&
+		    (hub < 0 || lag < group[hub]->info.replay_lag_ms))
+			hub = i;
+	}
+	/* Its hub just failed: promote one of its standbys rather than scatter them all */
+	for (int32_t i = 0; i < count && hub < 0; i++)
+	{
+		if (group[i]->info.replay_lag_ms < 0)
+			hub = i;
+	}
+	if (hub < 0)
+		return;
+
+	feeders[feeder_count++] = group[hub];
+	for (int32_t i = 0; i < count; i++)
+	{
+		ramd_topology_entry_t* e = group[i];
+		ramd_topology_entry_t* upstream = NULL;
+
+		if (i == hub)
+			continue;
+		for (int32_t f = 0; f < feeder_count && !upstream; f++)
+		{
+			if (feeders[f]->info.downstream_count < config->cascade_max_fanout)
+				upstream = feeders[f];
+		}
+		if (!upstream)
+			break;
+
+		e->info.upstream_node_id = upstream->info.node_id;
+		e->info.depth = upstream->info.depth + 1;
+		upstream->info.downstream_count++;
+
+		/* Lag is only seen for direct standbys; a cascaded one feeds while healthy */
+		if (e->info.replay_lag_ms <= config->cascade_max_lag_ms)
+			feeders[feeder_count++] = e;
+	}
+}
+
+static void
+ramd_topology_plan(int32_t primary_node_id, const ramd_config_t* config)
+{
+	ramd_topology_entry_t* members[RAMD_MAX_NODES];
+	ramd_topology_entry_t* group[RAMD_MAX_NODES];
+	bool                   grouped[RAMD_MAX_NODES] = {false};
+	int32_t                count = 0;
+
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_topology_entry_t* e = &g_topology.entries[i];
+
+		if (!e->used || !e->member)
+			continue;
+		e->was_hub = e->info.upstream_node_id == primary_node_id &&
+		             e->info.downstream_count > 0;
+		e->info.upstream_node_id = primary_node_id;
+		e->info.depth = 1;
+		e->info.downstream_count = 0;
+		if (config->cascade_enabled && e->eligible && !e->info.is_sync)
+			members[count++] = e;
+	}
+	qsort(members, (size_t) count, sizeof(members[0]), ramd_topology_compare);
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		int32_t group_count = 0;
+
+		if (grouped[i])
+			continue;
+		for (int32_t j = i; j < count; j++)
+		{
+			if (!grouped[j] && strcmp(members[j]->info.zone, members[i]->info.zone) == 0)
+			{
+				grouped[j] = true;
+				group[group_count++] = members[j];
+			}
+		}
+		ramd_topology_plan_zone(group, group_count, config);
+	}
+}
+
+static PGconn*
+ramd_topology_connect(const ramd_node_t* node, const ramd_config_t* config)
+{
+	return ramd_conn_get(node->hostname, node->postgresql_port, config->database_name,
+	                     config->database_user, config->database_password);
+}
+
+/* Give node_id its slot on upstream_id, then point it there */
+static bool
+ramd_topology_repoint(PGconn* primary_conn, int32_t primary_node_id,
+                      const ramd_cluster_t* cluster, const ramd_config_t* config,
+                      int32_t node_id, int32_t upstream_id)
+{
+	const ramd_node_t* node = ramd_cluster_lookup_node(cluster, node_id);
+	const ramd_node_t* upstream = ramd_cluster_lookup_node(cluster, upstream_id);
+	char               slot_name[64];
+	PGconn*            conn;
+	bool               needs_restart = false;
+	bool               ok;
+
+	if (!node || !upstream)
+		return false;
+
+	ramd_slots_name(node_id, slot_name, sizeof(slot_name));
+	if (config->replication_slots_enabled)
+	{
+		if (upstream_id == primary_node_id)
+			ok = ramd_slots_create(primary_conn, node_id);
+		else
+		{
+			conn = ramd_topology_connect(upstream, config);
+			ok = conn && ramd_slots_create(conn, node_id);
+			ramd_conn_close(conn);
+		}
+		if (!ok)
+			return false;
+	}
+
+	conn = ramd_topology_connect(node, config);
+	ok = conn && ramd_postgresql_repoint_standby(conn, config, upstream->hostname,
+	                                             upstream->postgresql_port, node_id,
+	                                             config->replication_slots_enabled
+	                                                 ? slot_name : NULL,
+	                                             &needs_restart);
+	ramd_conn_close(conn);
+	if (!ok)
+		return false;
+
+	if (needs_restart)
+		ramd_log_warning("Cascade: standby %d follows node %d after its next restart "
+		                 "(primary_conninfo reloads from PostgreSQL 13)",
+		                 node_id, upstream_id);
+	else
+		ramd_log_info("Cascade: standby %d now streams from node %d%s",
+		              node_id, upstream_id,
+		              upstream_id == primary_node_id ? " (the primary)" : "");
+	return true;
+}
+
+/* Drop the slot node_id left behind on a standby it no longer streams from */
+static bool
+ramd_topology_drop_stale(const ramd_cluster_t* cluster, const ramd_config_t* config,
+                         int32_t node_id, int32_t upstream_id)
+{
+	const ramd_node_t* upstream = ramd_cluster_lookup_node(cluster, upstream_id);
+	char               slot_name[64];
+	const char*        values[1] = {slot_name};
+	PGconn*            conn;
+	PGresult*          res;
+	bool               ok;
+
+	/* Gone or failed: rebuilt or removed, its slots go with it */
+	if (!upstream || upstream->state == RAMD_NODE_STATE_FAILED)
+		return true;
+	if (!upstream->is_healthy)
+		return false;
+
+	conn = ramd_topology_connect(upstream, config);
+	if (!conn)
+		return false;
+
+	/* Fails while the walreceiver is still moving over; the next pass retries */
+	ramd_slots_name(node_id, slot_name, sizeof(slot_name));
+	res = PQexecParams(conn,
+	                   "SELECT pg_drop_replication_slot(slot_name) "
+	                   "FROM pg_replication_slots WHERE slot_name = $1",
+	                   1, NULL, values, NULL, NULL, 0);
+	ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+	PQclear(res);
+	ramd_conn_close(conn);
+	return ok;
+}
+
+/* Carry out the plan, parents first so a feeder is in place before its standbys */
+static void
+ramd_topology_apply(PGconn* conn, int32_t primary_node_id, const ramd_cluster_t* cluster,
+                    const ramd_config_t* config)
+{
+	ramd_topology_node_t moves[RAMD_MAX_NODES];
+	int32_t              stale_nodes[RAMD_MAX_NODES];
+	int32_t              stale_upstreams[RAMD_MAX_NODES];
+	int32_t              move_count = 0;
+	int32_t              stale_count = 0;
+	int64_t              now_us = ramd_clock_now_us();
+
+	pthread_mutex_lock(&g_topology.lock);
+	for (int i = 0; i < RAMD_MAX_NODES; i++)
+	{
+		ramd_topology_entry_t* e = &g_topology.entries[i];
+
+		if (!e->used)
+			continue;
+		/* Not while it is about to stream from there again */
+		if (e->stale_upstream_id > 0 && e->stale_upstream_id != e->info.upstream_node_id)
+		{
+			stale_nodes[stale_count] = e->info.node_id;
+			stale_upstreams[stale_count++] = e->stale_upstream_id;
+		}
+		if (!e->member || !e->eligible || now_us < e->retry_at_us ||
+		    e->info.upstream_node_id == e->info.applied_upstream_id)
+			continue;
+
+		/* Without cascading, leave alone what was never moved off the primary */
+		if (!config->cascade_enabled && e->info.applied_upstream_id < 0)
+			continue;
+		moves[move_count++] = e->info;
+	}
+	pthread_mutex_unlock(&g_topology.lock);
+
+	for (int32_t depth = 1; depth <= RAMD_MAX_NODES; depth++)
+	{
+		for (int32_t i = 0; i < move_count; i++)
+		{
+			const ramd_topology_node_t* m = &moves[i];
+			ramd_topology_entry_t*      e;
+			bool                        ok;
+
+			if (m->depth != depth)
+				continue;
+			ok = ramd_topology_repoint(conn, primary_node_id, cluster, config,
+			                           m->node_id, m->upstream_node_id);
+
+			pthread_mutex_lock(&g_topology.lock);
+			e = ramd_topology_find(m->node_id, false);
+			if (e && ok)
+			{
+				if (config->replication_slots_enabled && m->applied_upstream_id > 0 &&
+				    m->applied_upstream_id != primary_node_id &&
+				    m->applied_upstream_id != m->upstream_node_id)
+					e->stale_upstream_id = m->applied_upstream_id;
+				if (e->stale_upstream_id == m->upstream_node_id)
+					e->stale_upstream_id = 0;
+				e->info.applied_upstream_id = m->upstream_node_id;
+				e->retry_at_us = 0;
+			}
+			else if (e)
+			{
+				ramd_log_warning("Cascade: could not repoint standby %d to node %d; "
+				                 "retrying in %d ms", m->node_id, m->upstream_node_id,
+				                 RAMD_CASCADE_RETRY_MS);
+				e->retry_at_us = now_us + (int64_t) RAMD_CASCADE_RETRY_MS * 1000;
+			}
+			pthread_mutex_unlock(&g_topology.lock);
+		}
+	}
+
+	for (int32_t i = 0; i < stale_count; i++)
+	{
+		ramd_topology_entry_t* e;
+
+		if (!ramd_topology_drop_stale(cluster, config, stale_nodes[i], stale_upstreams[i]))
+			continue;
+
+		pthread_mutex_lock(&g_topology.lock);
+		e = ramd_topology_find(stale_nodes[i], false);
+		if (e && e->stale_upstream_id == stale_upstreams[i])
+		{
+			e->stale_upstream_id = 0;
+			if (!e->member)
+				e->used = false;
+		}
+		pthread_mutex_unlock(&g_topology.lock);
+	}
+}
+
+void
+ramd_topology_update(PGconn* conn, int32_t primary_node_id, ramd_cluster_t* cluster,
+                     const ramd_config_t* config, const ramd_lag_stats_t* stats,
+                     int32_t count)
+{
+	bool cascaded = false;
+
+	if (!conn || !cluster || !config)
+		return;
+
+	/* A failover repoints every standby to the new primary; start from there */
+	pthread_mutex_lock(&g_topology.lock);
+	if (g_topology.primary_node_id != primary_node_id || config->node_id != primary_node_id)
+	{
+		memset(g_topology.entries, 0, sizeof(g_topology.entries));
+		g_topology.primary_node_id = primary_node_id;
+	}
+	if (config->node_id != primary_node_id)
+	{
+		pthread_mutex_unlock(&g_topology.lock);
+		return;
+	}
+
+	for (int i = 0; i < RAMD_MAX_NODES && !cascaded; i++)
+	{
+		const ramd_topology_entry_t* e = &g_topology.entries[i];
+
+		cascaded = e->used && (e->stale_upstream_id > 0 ||
+		                       (e->info.applied_upstream_id > 0 &&
+		                        e->info.applied_upstream_id != primary_node_id));
+	}
+	if (!config->cascade_enabled && !cascaded)
+	{
+		pthread_mutex_unlock(&g_topology.lock);
+		return;
+	}
+
+	ramd_topology_refresh(primary_node_id, cluster, config, stats, count);
+	ramd_topology_plan(primary_node_id, config);
+	pthread_mutex_unlock(&g_topology.lock);
+
+	ramd_topology_apply(conn, primary_node_id, cluster, config);
+}
+
+int32_t
+ramd_topology_upstream(int32_t node_id)
+{
+	ramd_topology_entry_t* e;
+	int32_t                upstream = -1;
+
+	pthread_mutex_lock(&g_topology.lock);
+	e = ramd_topology_find(node_id, false);
+	if (e && e->info.applied_upstream_id > 0 &&
+	    e->info.applied_upstream_id != g_topology.primary_node_id)
+		upstream = e->info.applied_upstream_id;
+	pthread_mutex_unlock(&g_topology.lock);
+	return upstream;
+}
+
+int32_t
+ramd_topology_get_all(ramd_topology_node_t* nodes, int32_t max_count,
+                      int32_t* primary_node_id)
+{
+	int32_t count = 0;
+
+	pthread_mutex_lock(&g_topology.lock);
+	if (primary_node_id)
+		*primary_node_id = g_topology.primary_node_id;
+	for (int i = 0; i < RAMD_MAX_NODES && count < max_count; i++)
+	{
+		if (g_topology.entries[i].used && g_topology.entries[i].member)
+			nodes[count++] = g_topology.entries[i].info;
+	}
+	pthread_mutex_unlock(&g_topology.lock);
+	return count;
+}
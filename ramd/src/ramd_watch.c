@@ -0,0 +1,455 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_watch.c
+ *		PostgreSQL Auto-Failover Daemon - Cluster Change Feed
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * The monitor and the lag sampler publish after every cycle; only a real
+ * change bumps the version, so a long-polling client is answered once per
+ * change rather than once per refresh interval.  Lag is compared against
+ * the last published value, not the previous sample, so a slow drift is
+ * still reported once it adds up to a step.
+ *
+ * Every change is also kept as a typed event tagged with the version that
+ * published it, so subscribers and clients that are only behind by a few
+ * versions can act on what moved instead of diffing the whole view.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ramd_watch.h"
+#include "ram_state.h"
+#include "ramd_defaults.h"
+#include "ramd_lag.h"
+#include "ramd_daemon.h"
+
+typedef struct ramd_watch_subscription_t
+{
+	ramd_watch_subscriber_t subscriber;
+	void* arg;
+} ramd_watch_subscription_t;
+
+typedef struct ramd_watch_feed_t
+{
+	pthread_mutex_t lock;
+	ramd_watch_snapshot_t view;
+	ramd_watch_event_t events[RAMD_WATCH_EVENT_HISTORY];
+	uint64_t event_count;     /* ever recorded; the ring holds the latest */
+	uint64_t dropped_version; /* of the newest event pushed out of the ring */
+	ramd_watch_subscription_t subscriptions[RAMD_WATCH_MAX_SUBSCRIBERS];
+} ramd_watch_feed_t;
+
+static ramd_watch_feed_t g_watch = {
+	.lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static bool
+ramd_watch_lag_moved(int64_t before, int64_t after, int64_t step)
+{
+	if ((before < 0) != (after < 0))
+		return true;
+	return llabs(after - before) >= step;
+}
+
+static void
+ramd_watch_read_node(const ramd_cluster_t* cluster, const ramd_node_t* node,
+					 ramd_watch_node_t* out)
+{
+	ramd_lag_stats_t stats;
+
+	out->node_id = node->node_id;
+	strncpy(out->hostname, node->hostname, sizeof(out->hostname) - 1);
+	out->hostname[sizeof(out->hostname) - 1] = '\0';
+	out->postgresql_port = node->postgresql_port;
+	out->state = node->state;
+	out->role = node->role;
+	out->is_primary = node->node_id == cluster->primary_node_id;
+	out->is_leader = node->node_id == cluster->leader_node_id;
+	out->is_healthy = node->is_healthy;
+	out->is_voter = node->is_voter;
+
+	/* The sampler's figure is fresher than the monitor's when it has one */
+	if (ramd_lag_get_stats(node->node_id, &stats) && stats.connected)
+	{
+		out->replay_lag_ms = stats.last.replay_lag_ms;
+		out->replay_lag_bytes = stats.last.replay_lag_bytes;
+		out->flush_lsn = stats.flush_lsn;
+		out->replay_lsn = stats.replay_lsn;
+	}
+	else
+	{
+		out->replay_lag_ms = out->is_primary ? 0 : node->replication_lag_ms;
+		out->replay_lag_bytes = out->is_primary ? 0 : -1;
+		out->flush_lsn = out->is_primary ? ramd_lag_primary_flush_lsn() : -1;
+		out->replay_lsn = -1;
+	}
+}
+
+static bool
+ramd_watch_node_changed(const ramd_watch_node_t* before, const ramd_watch_node_t* after)
+{
+	return before->state != after->state ||
+		   before->role != after->role ||
+		   before->is_primary != after->is_primary ||
+		   before->is_leader != after->is_leader ||
+		   before->is_healthy != after->is_healthy ||
+		   before->is_voter != after->is_voter ||
+		   before->postgresql_port != after->postgresql_port ||
+		   strcmp(before->hostname, after->hostname) != 0 ||
+		   ramd_watch_lag_moved(before->replay_lag_ms, after->replay_lag_ms,
+								RAMD_WATCH_LAG_STEP_MS) ||
+		   ramd_watch_lag_moved(before->replay_lag_bytes, after->replay_lag_bytes,
+								RAMD_WATCH_LAG_STEP_BYTES);
+}
+
+static void
+ramd_watch_event(ramd_watch_event_t* batch, int32_t* count, uint64_t version,
+				 ramd_watch_event_type_t type, int32_t node_id,
+				 int64_t old_value, int64_t new_value)
+{
+	ramd_watch_event_t* e;
+
+	if (*count >= RAMD_WATCH_EVENT_HISTORY || old_value == new_value)
+		return;
+
+	e = &batch[(*count)++];
+	e->version = version;
+	e->type = type;
+	e->node_id = node_id;
+	e->old_value = old_value;
+	e->new_value = new_value;
+	e->at = time(NULL);
+}
+
+static void
+ramd_watch_node_events(ramd_watch_event_t* batch, int32_t* count, uint64_t version,
+					   const ramd_watch_node_t* before, const ramd_watch_node_t* after)
+{
+	int32_t id = after->node_id;
+
+	ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_NODE_STATE, id,
+					 before->state, after->state);
+	ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_NODE_ROLE, id,
+					 before->role, after->role);
+	ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_NODE_HEALTH, id,
+					 before->is_healthy, after->is_healthy);
+	if (ramd_watch_lag_moved(before->replay_lag_ms, after->replay_lag_ms,
+							 RAMD_WATCH_LAG_STEP_MS) ||
+		ramd_watch_lag_moved(before->replay_lag_bytes, after->replay_lag_bytes,
+							 RAMD_WATCH_LAG_STEP_BYTES))
+		ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_NODE_LAG, id,
+						 before->replay_lag_ms, after->replay_lag_ms);
+	if (before->postgresql_port != after->postgresql_port ||
+		strcmp(before->hostname, after->hostname) != 0)
+		ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_MEMBERSHIP, id, 0, 1);
+	ramd_watch_event(batch, count, version, RAMD_WATCH_EVENT_MEMBERSHIP, id,
+					 before->is_voter, after->is_voter);
+}
+
+void
+ramd_watch_publish(const ramd_cluster_t* cluster)
+{
+	ramd_watch_event_t batch[RAMD_WATCH_EVENT_HISTORY];
+	int32_t events = 0;
+	ramd_watch_snapshot_t* view = &g_watch.view;
+	ramd_watch_node_t current;
+	bool membership_changed;
+	bool cluster_changed;
+	int32_t failover_state;
+	int64_t raft_term;
+	uint64_t next;
+	bool changed = false;
+	int32_t count;
+
+	if (!cluster)
+		return;
+
+	count = cluster->node_count;
+	if (count > RAMD_MAX_NODES)
+		count = RAMD_MAX_NODES;
+
+	pthread_mutex_lock(&g_watch.lock);
+
+	if (view->epoch == 0)
+	{
+		struct timespec ts;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		view->epoch = (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+	}
+	next = view->version + 1;
+
+	membership_changed = count != view->node_count;
+	for (int i = 0; i < count && !membership_changed; i++)
+		membership_changed = cluster->nodes[i].node_id != view->nodes[i].node_id;
+
+	for (int i = 0; i < count; i++)
+	{
+		ramd_watch_read_node(cluster, &cluster->nodes[i], &current);
+		if (membership_changed || ramd_watch_node_changed(&view->nodes[i], &current))
+		{
+			if (!membership_changed)
+				ramd_watch_node_events(batch, &events, next, &view->nodes[i], &current);
+			current.version = next;
+			view->nodes[i] = current;
+			changed = true;
+		}
+	}
+	if (membership_changed)
+	{
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_MEMBERSHIP, -1,
+						 -1, count);
+		view->node_count = count;
+		view->full_since = next;
+		changed = true;
+	}
+
+	failover_state = g_ramd_daemon ? (int32_t) g_ramd_daemon->failover_context.state : 0;
+	raft_term = cluster->consensus_refreshed_ms != 0 && cluster->consensus.published ?
+		cluster->consensus.term : -1;
+	cluster_changed = view->primary_node_id != cluster->primary_node_id ||
+					  view->leader_node_id != cluster->leader_node_id ||
+					  view->has_quorum != cluster->has_quorum ||
+					  view->in_failover != cluster->in_failover ||
+					  view->failover_state != failover_state ||
+					  view->raft_term != raft_term ||
+					  strcmp(view->cluster_name, cluster->cluster_name) != 0;
+	if (cluster_changed)
+	{
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_PRIMARY, -1,
+						 view->primary_node_id, cluster->primary_node_id);
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_LEADER, -1,
+						 view->leader_node_id, cluster->leader_node_id);
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_QUORUM, -1,
+						 view->has_quorum, cluster->has_quorum);
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_FAILOVER, -1,
+						 view->failover_state, failover_state);
+		ramd_watch_event(batch, &events, next, RAMD_WATCH_EVENT_TERM, -1,
+						 view->raft_term, raft_term);
+		strncpy(view->cluster_name, cluster->cluster_name, sizeof(view->cluster_name) - 1);
+		view->cluster_name[sizeof(view->cluster_name) - 1] = '\0';
+		view->primary_node_id = cluster->primary_node_id;
+		view->leader_node_id = cluster->leader_node_id;
+		view->has_quorum = cluster->has_quorum;
+		view->in_failover = cluster->in_failover;
+		view->failover_state = failover_state;
+		view->raft_term = raft_term;
+		view->cluster_version = next;
+		changed = true;
+	}
+
+	if (changed)
+	{
+		view->version = next;
+		view->changed_at = time(NULL);
+		for (int32_t i = 0; i < events; i++)
+		{
+			ramd_watch_event_t* slot =
+				&g_watch.events[g_watch.event_count++ % RAMD_WATCH_EVENT_HISTORY];
+
+			if (g_watch.event_count > RAMD_WATCH_EVENT_HISTORY)
+				g_watch.dropped_version = slot->version;
+			*slot = batch[i];
+		}
+		for (int i = 0; i < RAMD_WATCH_MAX_SUBSCRIBERS; i++)
+		{
+			const ramd_watch_subscription_t* s = &g_watch.subscriptions[i];
+
+			if (s->subscriber)
+				s->subscriber(batch, events, s->arg);
+		}
+	}
+
+	pthread_mutex_unlock(&g_watch.lock);
+}
+
+uint64_t
+ramd_watch_version(void)
+{
+	uint64_t version;
+
+	pthread_mutex_lock(&g_watch.lock);
+	version = g_watch.view.version;
+	pthread_mutex_unlock(&g_watch.lock);
+	return version;
+}
+
+void
+ramd_watch_get(ramd_watch_snapshot_t* snapshot)
+{
+	if (!snapshot)
+		return;
+
+	pthread_mutex_lock(&g_watch.lock);
+	*snapshot = g_watch.view;
+	pthread_mutex_unlock(&g_watch.lock);
+}
+
+size_t
+ramd_watch_encode_state(const ramd_watch_snapshot_t* view, int32_t local_node_id,
+                        unsigned char* out, size_t size)
+{
+	size_t length;
+	uint32_t flags = 0;
+
+	if (!view || !out)
+		return 0;
+	length = RAM_STATE_HEADER_SIZE + (size_t) view->node_count * RAM_STATE_NODE_SIZE;
+	if (length > size)
+		return 0;
+	memset(out, 0, length);
+
+	if (view->has_quorum)
+		flags |= RAM_STATE_CLUSTER_HAS_QUORUM;
+	if (view->in_failover)
+		flags |= RAM_STATE_CLUSTER_IN_FAILOVER;
+
+	memcpy(out + RAM_STATE_H_MAGIC, RAM_STATE_MAGIC, 4);
+	ram_state_put_u16(out + RAM_STATE_H_SCHEMA_VERSION, RAM_STATE_SCHEMA_VERSION);
+	ram_state_put_u16(out + RAM_STATE_H_HEADER_SIZE, RAM_STATE_HEADER_SIZE);
+	ram_state_put_u16(out + RAM_STATE_H_NODE_SIZE, RAM_STATE_NODE_SIZE);
+	ram_state_put_u16(out + RAM_STATE_H_NODE_COUNT, (uint16_t) view->node_count);
+	ram_state_put_u32(out + RAM_STATE_H_FLAGS, flags);
+	ram_state_put_u64(out + RAM_STATE_H_EPOCH, view->epoch);
+	ram_state_put_u64(out + RAM_STATE_H_VERSION, view->version);
+	ram_state_put_i64(out + RAM_STATE_H_CHANGED_AT, (int64_t) view->changed_at);
+	ram_state_put_i64(out + RAM_STATE_H_RAFT_TERM, view->raft_term);
+	ram_state_put_i32(out + RAM_STATE_H_PRIMARY_NODE_ID, view->primary_node_id);
+	ram_state_put_i32(out + RAM_STATE_H_LEADER_NODE_ID, view->leader_node_id);
+	ram_state_put_i32(out + RAM_STATE_H_LOCAL_NODE_ID, local_node_id);
+	ram_state_put_i32(out + RAM_STATE_H_FAILOVER_STATE, view->failover_state);
+	ram_state_put_string(out + RAM_STATE_H_CLUSTER_NAME, RAM_STATE_NAME_LENGTH,
+	                     view->cluster_name);
+
+	for (int32_t i = 0; i < view->node_count; i++)
+	{
+		const ramd_watch_node_t* node = &view->nodes[i];
+		unsigned char* rec = out + RAM_STATE_HEADER_SIZE + (size_t) i * RAM_STATE_NODE_SIZE;
+		uint16_t node_flags = 0;
+
+		if (node->is_primary)
+			node_flags |= RAM_STATE_NODE_PRIMARY;
+		if (node->is_leader)
+			node_flags |= RAM_STATE_NODE_LEADER;
+		if (node->is_healthy)
+			node_flags |= RAM_STATE_NODE_HEALTHY;
+
+		ram_state_put_i32(rec + RAM_STATE_N_NODE_ID, node->node_id);
+		ram_state_put_i32(rec + RAM_STATE_N_POSTGRESQL_PORT, node->postgresql_port);
+		rec[RAM_STATE_N_STATE] = (unsigned char) node->state;
+		rec[RAM_STATE_N_ROLE] = (unsigned char) node->role;
+		ram_state_put_u16(rec + RAM_STATE_N_FLAGS, node_flags);
+		ram_state_put_i32(rec + RAM_STATE_N_REPLAY_LAG_MS, node->replay_lag_ms);
+		ram_state_put_i64(rec + RAM_STATE_N_REPLAY_LAG_BYTES, node->replay_lag_bytes);
+		ram_state_put_i64(rec + RAM_STATE_N_FLUSH_LSN, node->flush_lsn);
+		ram_state_put_i64(rec + RAM_STATE_N_REPLAY_LSN, node->replay_lsn);
+		ram_state_put_u64(rec + RAM_STATE_N_VERSION, node->version);
+		ram_state_put_string(rec + RAM_STATE_N_HOSTNAME, RAM_STATE_HOSTNAME_LENGTH,
+		                     node->hostname);
+	}
+
+	return length;
+}
+
+int32_t
+ramd_watch_events_since(uint64_t since, ramd_watch_event_t* events, int32_t max_count)
+{
+	uint64_t first;
+	int32_t  written = 0;
+
+	if (!events || max_count <= 0)
+		return 0;
+
+	pthread_mutex_lock(&g_watch.lock);
+	if (since < g_watch.dropped_version)
+	{
+		pthread_mutex_unlock(&g_watch.lock);
+		return -1;
+	}
+
+	/* Versions only grow along the ring, so walk back to the first one past since */
+	first = g_watch.event_count;
+	while (first > 0 && g_watch.event_count - first < RAMD_WATCH_EVENT_HISTORY &&
+		   g_watch.events[(first - 1) % RAMD_WATCH_EVENT_HISTORY].version > since)
+		first--;
+
+	for (uint64_t n = first; n < g_watch.event_count && written < max_count; n++)
+		events[written++] = g_watch.events[n % RAMD_WATCH_EVENT_HISTORY];
+	pthread_mutex_unlock(&g_watch.lock);
+	return written;
+}
+
+bool
+ramd_watch_subscribe(ramd_watch_subscriber_t subscriber, void* arg)
+{
+	bool added = false;
+
+	if (!subscriber)
+		return false;
+
+	pthread_mutex_lock(&g_watch.lock);
+	for (int i = 0; i < RAMD_WATCH_MAX_SUBSCRIBERS && !added; i++)
+	{
+		ramd_watch_subscription_t* s = &g_watch.subscriptions[i];
+
+		if (!s->subscriber)
+		{
+			s->subscriber = subscriber;
+			s->arg = arg;
+			added = true;
+		}
+	}
+	pthread_mutex_unlock(&g_watch.lock);
+	return added;
+}
+
+void
+ramd_watch_unsubscribe(ramd_watch_subscriber_t subscriber, void* arg)
+{
+	pthread_mutex_lock(&g_watch.lock);
+	for (int i = 0; i < RAMD_WATCH_MAX_SUBSCRIBERS; i++)
+	{
+		ramd_watch_subscription_t* s = &g_watch.subscriptions[i];
+
+		if (s->subscriber == subscriber && s->arg == arg)
+			s->subscriber = NULL;
+	}
+	pthread_mutex_unlock(&g_watch.lock);
+}
+
+const char*
+ramd_watch_event_type_to_string(ramd_watch_event_type_t type)
+{
+	switch (type)
+	{
+		case RAMD_WATCH_EVENT_MEMBERSHIP:
+			return "membership";
+		case RAMD_WATCH_EVENT_NODE_STATE:
+			return "node_state";
+		case RAMD_WATCH_EVENT_NODE_ROLE:
+			return "node_role";
+		case RAMD_WATCH_EVENT_NODE_HEALTH:
+			return "node_health";
+		case RAMD_WATCH_EVENT_NODE_LAG:
+			return "node_lag";
+		case RAMD_WATCH_EVENT_PRIMARY:
+			return "primary";
+		case RAMD_WATCH_EVENT_LEADER:
+			return "leader";
+		case RAMD_WATCH_EVENT_QUORUM:
+			return "quorum";
+		case RAMD_WATCH_EVENT_FAILOVER:
+			return "failover";
+		case RAMD_WATCH_EVENT_TERM:
+			return "term";
+		case RAMD_WATCH_EVENT_COUNT:
+			break;
+	}
+	return "unknown";
+}
@@ -0,0 +1,133 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_backup_test.c
+ *		PostgreSQL Auto-Failover Daemon - Backup Progress Parser Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Feeds ramd_backup_parse_progress() the lines pgbackrest, barman and the
+ * pg_basebackup it runs print while a job is under way, and checks what a
+ * job shows afterwards.  Prints one TAP line per case; "make check" runs
+ * it and fails on a non-zero exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "ramd.h"
+#include "ramd_backup.h"
+#include "ramd_daemon.h"
+
+/* Normally defined by ramd_main.c, which is not linked in */
+ramd_daemon_t *g_ramd_daemon = NULL;
+PGconn	   *g_conn = NULL;
+
+#define KB	((int64_t) 1024)
+#define MB	(KB * 1024)
+
+/* Lines of one job's output, and the job's progress once all are parsed */
+typedef struct ramd_backup_test_case_t
+{
+	const char *name;
+	const char *lines[8];
+	int64_t		bytes_done;
+	int64_t		bytes_total;
+	int			percent_done;
+} ramd_backup_test_case_t;
+
+static const ramd_backup_test_case_t g_cases[] = {
+	{
+		"pgbackrest backup",
+		{
+			"2024-05-14 09:12:03.102 P00   INFO: backup start archive = 000000010000000000000004, "
+			"lsn = 0/4000028",
+			"2024-05-14 09:12:03.418 P01 DETAIL: backup file /var/lib/postgresql/16/main/base/5/1255 "
+			"(776KB, 3.19%) checksum 7e3f0c5a1c4e2b9d8f6a0b1c2d3e4f5a6b7c8d9e",
+			"2024-05-14 09:12:03.561 P02 DETAIL: backup file /var/lib/postgresql/16/main/base/5/2608 "
+			"(bundle 1/0, 464KB, 5.10%) checksum 0a1b2c3d4e5f60718293a4b5c6d7e8f901234567",
+			"2024-05-14 09:12:09.904 P00   INFO: full backup size = 22.0MB, file total = 961",
+			NULL
+		},
+		776 * KB + 464 * KB, 22 * MB, 5
+	},
+	{
+		"pgbackrest restore",
+		{
+			"2024-05-14 10:40:11.250 P00   INFO: repo1: restore backup set 20240514-091203F, "
+			"recovery will start at 2024-05-14 09:12:03",
+			"2024-05-14 10:40:11.731 P01 DETAIL: restore file /var/lib/postgresql/16/main/base/5/1255 "
+			"(776KB, 3.19%) checksum 7e3f0c5a1c4e2b9d8f6a0b1c2d3e4f5a6b7c8d9e",
+			"2024-05-14 10:40:14.018 P00   INFO: restore size = 22.0MB, file total = 961",
+			NULL
+		},
+		776 * KB, 22 * MB, 3
+	},
+	{
+		"barman backup through pg_basebackup",
+		{
+			"Starting backup using postgres method for server pg (20240514T091203)",
+			"     0/22560 kB (0%), 0/1 tablespace",
+			"  8731/22560 kB (38%), 0/1 tablespace (...ql/16/main/base/5/16390)",
+			NULL
+		},
+		8731 * KB, 22560 * KB, 38
+	},
+	{
+		"barman backup finished",
+		{
+			"22560/22560 kB (100%), 1/1 tablespace",
+			"Backup size: 22.0 MiB",
+			NULL
+		},
+		22560 * KB, 22560 * KB, 100
+	},
+	{
+		"output without progress",
+		{
+			"2024-05-14 09:12:03.102 P00   INFO: backup command begin 2.51: --stanza=main",
+			"Starting remote restore for server pg using backup 20240514T091203",
+			"Your PostgreSQL server has been successfully prepared for recovery!",
+			NULL
+		},
+		-1, -1, -1
+	},
+};
+
+static bool
+ramd_backup_test_run(const ramd_backup_test_case_t *c)
+{
+	ramd_backup_job_t job = {0};
+
+	job.bytes_done = -1;
+	job.bytes_total = -1;
+	job.percent_done = -1;
+	for (int i = 0; c->lines[i]; i++)
+		ramd_backup_parse_progress(&job, c->lines[i]);
+
+	if (job.bytes_done == c->bytes_done && job.bytes_total == c->bytes_total &&
+		job.percent_done == c->percent_done)
+		return true;
+
+	printf("# bytes_done %lld, bytes_total %lld, percent_done %d; "
+		   "expected %lld, %lld, %d\n",
+		   (long long) job.bytes_done, (long long) job.bytes_total, job.percent_done,
+		   (long long) c->bytes_done, (long long) c->bytes_total, c->percent_done);
+	return false;
+}
+
+int
+main(void)
+{
+	size_t		count = sizeof(g_cases) / sizeof(g_cases[0]);
+	int			failed = 0;
+
+	printf("1..%zu\n", count);
+	for (size_t i = 0; i < count; i++)
+	{
+		bool		ok = ramd_backup_test_run(&g_cases[i]);
+
+		printf("%s %zu - %s\n", ok ? "ok" : "not ok", i + 1, g_cases[i].name);
+		if (!ok)
+			failed++;
+	}
+	return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_conf_test.c
+ *		PostgreSQL Auto-Failover Daemon - Configuration Schema Parser Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Builds ram_conf.h schemas up to and one past the size of the index,
+ * with keys chosen to collide and to wrap around its end, and runs lines
+ * a configuration file may hold through ram_conf_split() and
+ * ram_conf_set().  Prints one TAP line per case; "make check" runs it and
+ * fails on a non-zero exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+
+#include "ram_conf.h"
+
+#define RAMD_CONF_TEST_MAX_FIELDS	(RAM_CONF_INDEX_SLOTS / 2)
+#define RAMD_CONF_TEST_KEY_LENGTH	16
+
+typedef struct ramd_conf_test_target_t
+{
+	int32_t		i32;
+	int64_t		i64;
+	size_t		size;
+	bool		flag;
+	double		ratio;
+	char		name[8];
+	int32_t		mode;
+} ramd_conf_test_target_t;
+
+static int	g_test = 0;
+static int	g_failed = 0;
+
+/* Generated keys and a field per key, for schemas of any size */
+static char g_keys[RAMD_CONF_TEST_MAX_FIELDS + 1][RAMD_CONF_TEST_KEY_LENGTH];
+static ram_conf_field_t g_fields[RAMD_CONF_TEST_MAX_FIELDS + 1];
+
+static void
+ramd_conf_test_check(bool ok, const char *name)
+{
+	printf("%s %d - %s\n", ok ? "ok" : "not ok", ++g_test, name);
+	if (!ok)
+		g_failed++;
+}
+
+/* Accepts only "fast" and "safe" */
+static bool
+ramd_conf_test_parse_mode(void *member, const char *value)
+{
+	if (strcmp(value, "fast") == 0)
+		*(int32_t *) member = 1;
+	else if (strcmp(value, "safe") == 0)
+		*(int32_t *) member = 2;
+	else
+		return false;
+	return true;
+}
+
+static const ram_conf_field_t g_target_fields[] = {
+	RAM_CONF_FIELD(INT, ramd_conf_test_target_t, i32),
+	RAM_CONF_FIELD(INT, ramd_conf_test_target_t, i64),
+	RAM_CONF_FIELD(SIZE, ramd_conf_test_target_t, size),
+	RAM_CONF_FIELD_AS("enabled", BOOL, ramd_conf_test_target_t, flag),
+	RAM_CONF_FIELD(DOUBLE, ramd_conf_test_target_t, ratio),
+	RAM_CONF_FIELD(STRING, ramd_conf_test_target_t, name),
+	RAM_CONF_FIELD_CUSTOM(ramd_conf_test_target_t, mode, ramd_conf_test_parse_mode),
+};
+
+static uint32_t
+ramd_conf_test_slot(const char *key)
+{
+	return ram_conf_hash(key, strlen(key)) & (RAM_CONF_INDEX_SLOTS - 1);
+}
+
+/* A generated key "k<n>", n from *next on, whose home slot is slot */
+static void
+ramd_conf_test_key_at(char *key, uint32_t slot, int *next)
+{
+	do
+		snprintf(key, RAMD_CONF_TEST_KEY_LENGTH, "k%d", (*next)++);
+	while (ramd_conf_test_slot(key) != slot);
+}
+
+/* count fields over generated keys "f0", "f1" and so on */
+static void
+ramd_conf_test_fill(size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		snprintf(g_keys[i], sizeof(g_keys[i]), "f%zu", i);
+		g_fields[i] = (ram_conf_field_t) RAM_CONF_FIELD_AS(g_keys[i], INT,
+														   ramd_conf_test_target_t, i32);
+	}
+}
+
+static void
+ramd_conf_test_index(void)
+{
+	ram_conf_schema_t *schema = malloc(sizeof(ram_conf_schema_t));
+	char		missing[RAMD_CONF_TEST_KEY_LENGTH];
+	bool		ok;
+	int			next = 0;
+
+	if (!schema)
+	{
+		printf("Bail out! out of memory\n");
+		exit(1);
+	}
+
+	ramd_conf_test_fill(RAMD_CONF_TEST_MAX_FIELDS + 1);
+	ok = ram_conf_schema_init(schema, g_fields, RAMD_CONF_TEST_MAX_FIELDS);
+	for (size_t i = 0; ok && i < RAMD_CONF_TEST_MAX_FIELDS; i++)
+		ok = ram_conf_lookup(schema, g_keys[i]) == &g_fields[i];
+	ramd_conf_test_check(ok && !ram_conf_lookup(schema, "f256") && !ram_conf_lookup(schema, "f"),
+						 "RAM_CONF_INDEX_SLOTS / 2 fields index and are all found");
+	ramd_conf_test_check(!ram_conf_schema_init(schema, g_fields, RAMD_CONF_TEST_MAX_FIELDS + 1),
+						 "one field more than RAM_CONF_INDEX_SLOTS / 2 is refused");
+	ramd_conf_test_check(ram_conf_schema_init(schema, g_fields, 0) &&
+						 !ram_conf_lookup(schema, "f0") && !ram_conf_lookup(schema, ""),
+						 "an empty schema finds nothing");
+
+	/* Two keys homed on the last slot: the second wraps around to slot 0 */
+	ramd_conf_test_key_at(g_keys[0], RAM_CONF_INDEX_SLOTS - 1, &next);
+	ramd_conf_test_key_at(g_keys[1], RAM_CONF_INDEX_SLOTS - 1, &next);
+	ramd_conf_test_key_at(g_keys[2], 0, &next);
+	ramd_conf_test_key_at(missing, 0, &next);
+	for (int i = 0; i < 3; i++)
+		g_fields[i] = (ram_conf_field_t) RAM_CONF_FIELD_AS(g_keys[i], INT,
+														   ramd_conf_test_target_t, i32);
+	ok = ram_conf_schema_init(schema, g_fields, 3);
+	ramd_conf_test_check(ok && schema->slots[RAM_CONF_INDEX_SLOTS - 1] == 1 &&
+						 schema->slots[0] == 2 && schema->slots[1] == 3,
+						 "colliding keys probe linearly and wrap around the index");
+	ramd_conf_test_check(ram_conf_lookup(schema, g_keys[0]) == &g_fields[0] &&
+						 ram_conf_lookup(schema, g_keys[1]) == &g_fields[1] &&
+						 ram_conf_lookup(schema, g_keys[2]) == &g_fields[2] &&
+						 !ram_conf_lookup(schema, missing),
+						 "lookups follow the probe chain and stop at its end");
+
+	/* The duplicate collides with another key first */
+	g_fields[3] = g_fields[1];
+	ramd_conf_test_check(!ram_conf_schema_init(schema, g_fields, 4),
+						 "a key listed twice is refused");
+	free(schema);
+}
+
+/* Splits a copy of text and compares; NULL for a key or value that should be NULL */
+static bool
+ramd_conf_test_split(const char *text, bool result, const char *key, const char *value)
+{
+	char		line[128];
+	char	   *k;
+	char	   *v;
+	bool		split;
+
+	snprintf(line, sizeof(line), "%s", text);
+	split = ram_conf_split(line, &k, &v);
+	if (split == result && (key ? k && strcmp(k, key) == 0 : !k) &&
+		(value ? v && strcmp(v, value) == 0 : !v))
+		return true;
+	printf("# '%s' split into %d, '%s', '%s'\n", text, split, k ? k : "(null)",
+		   v ? v : "(null)");
+	return false;
+}
+
+static void
+ramd_conf_test_lines(void)
+{
+	bool		ok;
+
+	ramd_conf_test_check(ramd_conf_test_split("key=value", true, "key", "value") &&
+						 ramd_conf_test_split(" \tkey \t= \tvalue \t\r\n", true, "key", "value") &&
+						 ramd_conf_test_split("command = a=b c", true, "command", "a=b c"),
+						 "key and value are trimmed; later '=' belong to the value");
+	ramd_conf_test_check(ramd_conf_test_split("key =", true, "key", "") &&
+						 ramd_conf_test_split("= value", true, "", "value"),
+						 "empty values and keys are split, for ram_conf_set to judge");
+	ok = ramd_conf_test_split("", false, NULL, NULL) &&
+		ramd_conf_test_split(" \t\r\n", false, NULL, NULL) &&
+		ramd_conf_test_split("  # key = value", false, NULL, NULL);
+	ramd_conf_test_check(ok, "blank lines and comments have no key");
+	ramd_conf_test_check(ramd_conf_test_split("key value", false, "key value", NULL),
+						 "a line without '=' is refused with its key");
+}
+
+static void
+ramd_conf_test_values(void)
+{
+	ram_conf_schema_t schema;
+	ramd_conf_test_target_t t;
+	bool		ok;
+
+	memset(&t, 0, sizeof(t));
+	if (!ram_conf_schema_init(&schema, g_target_fields,
+							  sizeof(g_target_fields) / sizeof(g_target_fields[0])))
+	{
+		printf("Bail out! the test schema does not index\n");
+		exit(1);
+	}
+
+	ok = ram_conf_set(&schema, &t, "i32", "-2147483648") && t.i32 == INT32_MIN &&
+		ram_conf_set(&schema, &t, "i64", "-9223372036854775808") && t.i64 == INT64_MIN &&
+		ram_conf_set(&schema, &t, "size", "18446744073709551615") && t.size == SIZE_MAX &&
+		ram_conf_set(&schema, &t, "ratio", "0.25") && t.ratio == 0.25;
+	ramd_conf_test_check(ok, "numbers at the limits of their members");
+
+	ok = ram_conf_set(&schema, &t, "enabled", "TRUE") && t.flag &&
+		ram_conf_set(&schema, &t, "enabled", "0") && !t.flag &&
+		ram_conf_set(&schema, &t, "enabled", "1") && t.flag &&
+		ram_conf_set(&schema, &t, "enabled", "yes") && !t.flag;
+	ramd_conf_test_check(ok, "only true, in any case, and 1 are true");
+
+	ok = ram_conf_set(&schema, &t, "name", "1234567") && strcmp(t.name, "1234567") == 0 &&
+		ram_conf_set(&schema, &t, "name", "12345678") && strcmp(t.name, "1234567") == 0 &&
+		ram_conf_set(&schema, &t, "name", "") && t.name[0] == '\0';
+	ramd_conf_test_check(ok, "strings that fit, do not fit and are empty are terminated");
+
+	ok = ram_conf_set(&schema, &t, "mode", "safe") && t.mode == 2 &&
+		!ram_conf_set(&schema, &t, "mode", "reckless") && t.mode == 2;
+	ramd_conf_test_check(ok, "a custom parser's refusal fails the line and keeps the value");
+
+	ok = !ram_conf_set(&schema, &t, "I32", "1") && !ram_conf_set(&schema, &t, "i3", "1") &&
+		!ram_conf_set(&schema, &t, "i322", "1") && !ram_conf_set(&schema, &t, "", "1") &&
+		t.i32 == INT32_MIN;
+	ramd_conf_test_check(ok, "unknown keys, keys differing in case and prefixes are refused");
+}
+
+int
+main(void)
+{
+	printf("1..15\n");
+	ramd_conf_test_index();
+	ramd_conf_test_lines();
+	ramd_conf_test_values();
+	return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_http_parser_test.c
+ *		PostgreSQL Auto-Failover Daemon - HTTP Request Parser Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Feeds ramd_http_parser_feed() requests whole and a byte at a time, as
+ * they arrive off a slow socket, with fixed-length and chunked bodies at
+ * and past the header and body limits, and hands the headers it finds to
+ * ramd_http_parse_request().  Prints one TAP line per case; "make check"
+ * runs it and fails on a non-zero exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "ramd.h"
+#include "ramd_daemon.h"
+#include "ramd_http_api.h"
+
+/* Normally defined by ramd_main.c, which is not linked in */
+ramd_daemon_t *g_ramd_daemon = NULL;
+PGconn	   *g_conn = NULL;
+
+static int	g_test = 0;
+static int	g_failed = 0;
+
+/* One request's input, the connection buffer it is read into */
+typedef struct ramd_http_test_input_t
+{
+	char	   *buf;
+	size_t		length;
+	ramd_http_parser_t parser;
+} ramd_http_test_input_t;
+
+static void
+ramd_http_test_check(bool ok, const char *name)
+{
+	printf("%s %d - %s\n", ok ? "ok" : "not ok", ++g_test, name);
+	if (!ok)
+		g_failed++;
+}
+
+/*
+ * Read length bytes of text into input step bytes at a time, feeding the
+ * parser after each read the way the event loop does; step 0 reads it
+ * all at once.  Stops early once the parser is done or has failed.
+ */
+static ramd_http_parse_state_t
+ramd_http_test_feed(ramd_http_test_input_t *input, const char *text, size_t length,
+					size_t step)
+{
+	ramd_http_parse_state_t state = RAMD_HTTP_PARSE_HEADERS;
+	size_t		received = 0;
+
+	free(input->buf);
+	memset(input, 0, sizeof(*input));
+	input->buf = malloc(length + 1);
+	if (!input->buf)
+		return RAMD_HTTP_PARSE_ERROR;
+	input->buf[0] = '\0';
+
+	while (received < length)
+	{
+		size_t		n = step == 0 || length - received < step ? length - received : step;
+
+		memcpy(input->buf + received, text + received, n);
+		received += n;
+		input->buf[received] = '\0';
+		input->length = received;
+		state = ramd_http_parser_feed(&input->parser, input->buf, received);
+		if (state == RAMD_HTTP_PARSE_DONE || state == RAMD_HTTP_PARSE_ERROR)
+			break;
+	}
+	return state;
+}
+
+/* The parser reached DONE and holds body, ending after consumed bytes */
+static bool
+ramd_http_test_done(const ramd_http_test_input_t *input, ramd_http_parse_state_t state,
+					const char *body, size_t consumed)
+{
+	size_t		body_len = strlen(body);
+
+	if (state == RAMD_HTTP_PARSE_DONE && input->parser.body_len == body_len &&
+		input->parser.scan_pos == consumed &&
+		memcmp(input->buf + input->parser.header_len, body, body_len) == 0)
+		return true;
+	printf("# state %d, body_len %zu, scan_pos %zu; expected body_len %zu, scan_pos %zu\n",
+		   (int) state, input->parser.body_len, input->parser.scan_pos, body_len, consumed);
+	return false;
+}
+
+/* The parser failed with error */
+static bool
+ramd_http_test_error(const ramd_http_test_input_t *input, ramd_http_parse_state_t state,
+					 ramd_http_status_code_t error)
+{
+	if (state == RAMD_HTTP_PARSE_ERROR && input->parser.error == error)
+		return true;
+	printf("# state %d, error %d; expected error %d\n", (int) state,
+		   (int) input->parser.error, (int) error);
+	return false;
+}
+
+#define FEED(input, text, step) \
+	ramd_http_test_feed((input), (text), sizeof(text) - 1, (step))
+
+static void
+ramd_http_test_bodies(ramd_http_test_input_t *in)
+{
+	static const char get[] = "GET /api/v1/status?verbose=1 HTTP/1.1\r\nHost: x\r\n\r\n";
+	static const char post[] =
+		"POST /api/v1/failover HTTP/1.1\r\ncontent-length: 5\r\n\r\nhelloGET / HTTP/1.1\r\n\r\n";
+	static const char chunked[] =
+		"POST /x HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+		"5\r\nhello\r\n6;name=value\r\n world\r\n0\r\nX-Trailer: t\r\n\r\n";
+	char		headers[RAMD_HTTP_MAX_HEADER_SIZE + 2];
+	char		request[128];
+	ramd_http_parse_state_t state;
+	int			length;
+
+	state = FEED(in, get, 0);
+	ramd_http_test_check(ramd_http_test_done(in, state, "", sizeof(get) - 1) &&
+						 in->parser.header_len == sizeof(get) - 1,
+						 "request without a body");
+	state = FEED(in, get, 1);
+	ramd_http_test_check(ramd_http_test_done(in, state, "", sizeof(get) - 1) &&
+						 in->length == sizeof(get) - 1,
+						 "request without a body, a byte at a time");
+
+	state = FEED(in, post, 0);
+	ramd_http_test_check(ramd_http_test_done(in, state, "hello",
+											 sizeof(post) - 1 - strlen("GET / HTTP/1.1\r\n\r\n")),
+						 "fixed-length body stops before the pipelined request");
+	state = FEED(in, post, 1);
+	ramd_http_test_check(ramd_http_test_done(in, state, "hello",
+											 sizeof(post) - 1 - strlen("GET / HTTP/1.1\r\n\r\n")),
+						 "fixed-length body, a byte at a time");
+	state = ramd_http_test_feed(in, post, sizeof(post) - 1 - strlen("oGET / HTTP/1.1\r\n\r\n"), 0);
+	ramd_http_test_check(state == RAMD_HTTP_PARSE_BODY && in->parser.remaining == 1,
+						 "body one byte short waits for more");
+
+	state = FEED(in, chunked, 0);
+	ramd_http_test_check(ramd_http_test_done(in, state, "hello world", sizeof(chunked) - 1) &&
+						 in->parser.chunked,
+						 "chunked body with an extension and a trailer is joined in place");
+	state = FEED(in, chunked, 1);
+	ramd_http_test_check(ramd_http_test_done(in, state, "hello world", sizeof(chunked) - 1),
+						 "chunked body, a byte at a time");
+	state = FEED(in, chunked, 7);
+	ramd_http_test_check(ramd_http_test_done(in, state, "hello world", sizeof(chunked) - 1),
+						 "chunked body, seven bytes at a time");
+
+	length = snprintf(request, sizeof(request),
+					  "PUT /x HTTP/1.1\r\nContent-Length: %d\r\n\r\n", RAMD_HTTP_MAX_BODY_SIZE);
+	state = ramd_http_test_feed(in, request, (size_t) length, 0);
+	ramd_http_test_check(state == RAMD_HTTP_PARSE_BODY &&
+						 in->parser.remaining == RAMD_HTTP_MAX_BODY_SIZE,
+						 "body of RAMD_HTTP_MAX_BODY_SIZE is accepted");
+	length = snprintf(request, sizeof(request),
+					  "PUT /x HTTP/1.1\r\nContent-Length: %d\r\n\r\n",
+					  RAMD_HTTP_MAX_BODY_SIZE + 1);
+	state = ramd_http_test_feed(in, request, (size_t) length, 0);
+	ramd_http_test_check(ramd_http_test_error(in, state, RAMD_HTTP_413_PAYLOAD_TOO_LARGE),
+						 "body one byte over RAMD_HTTP_MAX_BODY_SIZE is refused");
+	length = snprintf(request, sizeof(request), "PUT /x HTTP/1.1\r\nTransfer-Encoding: chunked"
+					  "\r\n\r\n%x\r\n", RAMD_HTTP_MAX_BODY_SIZE + 1);
+	state = ramd_http_test_feed(in, request, (size_t) length, 0);
+	ramd_http_test_check(ramd_http_test_error(in, state, RAMD_HTTP_413_PAYLOAD_TOO_LARGE),
+						 "chunk over RAMD_HTTP_MAX_BODY_SIZE is refused");
+
+	/* Headers still without their blank line at the limit, then past it */
+	memset(headers, 'h', sizeof(headers));
+	state = ramd_http_test_feed(in, headers, RAMD_HTTP_MAX_HEADER_SIZE, 0);
+	ramd_http_test_check(state == RAMD_HTTP_PARSE_HEADERS,
+						 "headers of RAMD_HTTP_MAX_HEADER_SIZE wait for their end");
+	state = ramd_http_test_feed(in, headers, RAMD_HTTP_MAX_HEADER_SIZE + 1, 0);
+	ramd_http_test_check(ramd_http_test_error(in, state, RAMD_HTTP_413_PAYLOAD_TOO_LARGE),
+						 "headers past RAMD_HTTP_MAX_HEADER_SIZE are refused");
+}
+
+static void
+ramd_http_test_malformed_bodies(ramd_http_test_input_t *in)
+{
+	static const char *const bad_lengths[] = {
+		"GET / HTTP/1.1\r\nContent-Length: abc\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: 5x\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length:\r\n\r\n",
+		"GET / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n",
+	};
+	static const char *const bad_chunks[] = {
+		"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n",
+		"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 \r\nhello\r\n",
+		"POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXY",
+	};
+	char		size_line[128 + RAMD_MAX_HOSTNAME_LENGTH + 2];
+	ramd_http_parse_state_t state;
+	bool		ok;
+	size_t		i;
+	int			length;
+
+	ok = true;
+	for (i = 0; i < sizeof(bad_lengths) / sizeof(bad_lengths[0]); i++)
+	{
+		state = ramd_http_test_feed(in, bad_lengths[i], strlen(bad_lengths[i]), 0);
+		ok = ramd_http_test_error(in, state, RAMD_HTTP_400_BAD_REQUEST) && ok;
+	}
+	ramd_http_test_check(ok, "malformed and overflowing Content-Length is refused");
+
+	ok = true;
+	for (i = 0; i < sizeof(bad_chunks) / sizeof(bad_chunks[0]); i++)
+	{
+		state = ramd_http_test_feed(in, bad_chunks[i], strlen(bad_chunks[i]), 1);
+		ok = ramd_http_test_error(in, state, RAMD_HTTP_400_BAD_REQUEST) && ok;
+	}
+	ramd_http_test_check(ok, "malformed chunk sizes and framing are refused");
+
+	length = snprintf(size_line, sizeof(size_line),
+					  "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+	memset(size_line + length, '0', RAMD_MAX_HOSTNAME_LENGTH + 1);
+	state = ramd_http_test_feed(in, size_line, (size_t) length + RAMD_MAX_HOSTNAME_LENGTH + 1, 0);
+	ramd_http_test_check(ramd_http_test_error(in, state, RAMD_HTTP_400_BAD_REQUEST),
+						 "chunk size line without an end is refused");
+}
+
+/* Copies text so ramd_http_parse_request() may write into it */
+static bool
+ramd_http_test_parse(const char *text, char *buf, size_t size, ramd_http_request_t *request)
+{
+	size_t		length = strlen(text);
+
+	if (length >= size)
+		return false;
+	memcpy(buf, text, length + 1);
+	return ramd_http_parse_request(buf, length, request);
+}
+
+static void
+ramd_http_test_request_line(void)
+{
+	static const char *const malformed[] = {
+		"GET\r\n\r\n",
+		"GET  HTTP/1.1\r\n\r\n",
+		"BREW /pot HTTP/1.1\r\n\r\n",
+		"get / HTTP/1.1\r\n\r\n",
+		"\r\n\r\n",
+		"GET /",
+	};
+	char		authorization[RAMD_MAX_HOSTNAME_LENGTH + 64];
+	char		text[RAMD_MAX_HOSTNAME_LENGTH + 128];
+	ramd_http_request_t request;
+	const char *value;
+	size_t		value_len = 0;
+	char		buf[512];
+	bool		ok;
+	size_t		i;
+
+	ok = ramd_http_test_parse("PATCH /api/v1/config?key=a&x=%20 HTTP/1.1\r\n"
+							  "X-Name: \t padded \t\r\n\r\n", buf, sizeof(buf), &request);
+	value = ramd_http_get_header(&request, "x-name", &value_len);
+	ramd_http_test_check(ok && request.method == RAMD_HTTP_PATCH &&
+						 strcmp(request.path, "/api/v1/config") == 0 &&
+						 strcmp(request.query_string, "key=a&x=%20") == 0 && request.keep_alive &&
+						 value && value_len == 6 && strncmp(value, "padded", 6) == 0,
+						 "request line, query string and a header trimmed of blanks");
+	ok = ramd_http_test_parse("DELETE /api/v1/nodes/3 HTTP/1.1\r\n\r\n", buf, sizeof(buf),
+							  &request);
+	ramd_http_test_check(ok && request.method == RAMD_HTTP_DELETE &&
+						 strcmp(request.path, "/api/v1/nodes/3") == 0 &&
+						 request.query_string[0] == '\0' &&
+						 !ramd_http_get_header(&request, "Host", &value_len),
+						 "request without a query string or headers");
+
+	ok = true;
+	for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+	{
+		if (ramd_http_test_parse(malformed[i], buf, sizeof(buf), &request))
+		{
+			printf("# accepted '%s'\n", malformed[i]);
+			ok = false;
+		}
+	}
+	ramd_http_test_check(ok, "malformed request lines and unknown methods are refused");
+
+	ok = ramd_http_test_parse("GET / HTTP/1.0\r\n\r\n", buf, sizeof(buf), &request) &&
+		!request.keep_alive;
+	ok = ok && ramd_http_test_parse("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", buf,
+									sizeof(buf), &request) && request.keep_alive;
+	ok = ok && ramd_http_test_parse("GET / HTTP/1.1\r\nconnection: close\r\n\r\n", buf,
+									sizeof(buf), &request) && !request.keep_alive;
+	ok = ok && ramd_http_test_parse("GET /\r\n\r\n", buf, sizeof(buf), &request) &&
+		!request.keep_alive;
+	ramd_http_test_check(ok, "keep-alive follows the version and Connection");
+
+	/* Longer than the field: kept to what fits, and terminated */
+	memset(authorization, 'a', sizeof(authorization) - 1);
+	authorization[sizeof(authorization) - 1] = '\0';
+	snprintf(text, sizeof(text), "GET / HTTP/1.1\r\nAuthorization: %s\r\n\r\n", authorization);
+	ok = ramd_http_test_parse(text, buf, sizeof(buf), &request);
+	ramd_http_test_check(ok && strlen(request.authorization) == sizeof(request.authorization) - 1,
+						 "Authorization longer than its field is cut and terminated");
+}
+
+int
+main(void)
+{
+	ramd_http_test_input_t input = {0};
+
+	printf("1..21\n");
+	ramd_http_test_bodies(&input);
+	ramd_http_test_malformed_bodies(&input);
+	ramd_http_test_request_line();
+	free(input.buf);
+	return g_failed == 0 ? 0 : 1;
+}
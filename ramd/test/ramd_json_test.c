@@ -0,0 +1,323 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_json_test.c
+ *		PostgreSQL Auto-Failover Daemon - JSON Writer and Reader Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Drives the ram_json.h writer into its escaping, overflow, flush and
+ * nesting limits, and feeds the tokenizer well-formed, malformed and
+ * truncated documents and numbers at the edges of their types.  Prints
+ * one TAP line per case; "make check" runs it and fails on a non-zero
+ * exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ram_json.h"
+
+#define RAMD_JSON_TEST_TOKENS 64
+
+static int	g_test = 0;
+static int	g_failed = 0;
+
+static void
+ramd_json_test_check(bool ok, const char *name)
+{
+	printf("%s %d - %s\n", ok ? "ok" : "not ok", ++g_test, name);
+	if (!ok)
+		g_failed++;
+}
+
+/* Collects what a writer flushes */
+typedef struct ramd_json_test_sink_t
+{
+	char		data[256];
+	size_t		length;
+	int			flushes;
+} ramd_json_test_sink_t;
+
+static bool
+ramd_json_test_flush(void *context, const char *data, size_t length)
+{
+	ramd_json_test_sink_t *sink = (ramd_json_test_sink_t *) context;
+
+	if (length > sizeof(sink->data) - 1 - sink->length)
+		return false;
+	memcpy(sink->data + sink->length, data, length);
+	sink->length += length;
+	sink->data[sink->length] = '\0';
+	sink->flushes++;
+	return true;
+}
+
+/* Writes one string value alone and compares the document */
+static bool
+ramd_json_test_string(const char *value, size_t length, const char *expected)
+{
+	ram_json_writer_t w;
+	char		buf[128];
+
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	if (length == SIZE_MAX)
+		ram_json_string(&w, value);
+	else
+		ram_json_string_n(&w, value, length);
+	if (!ram_json_writer_finish(&w) || strcmp(buf, expected) != 0)
+	{
+		printf("# wrote %s, expected %s\n", buf, expected);
+		return false;
+	}
+	return true;
+}
+
+static void
+ramd_json_test_writer(void)
+{
+	ramd_json_test_sink_t sink = {{0}, 0, 0};
+	ram_json_writer_t w;
+	char		buf[128];
+	char		small[8];
+	bool		ok;
+	int			i;
+
+	ramd_json_test_check(ramd_json_test_string("a\"b\\c", SIZE_MAX, "\"a\\\"b\\\\c\""),
+						 "quote and backslash are escaped");
+	ramd_json_test_check(ramd_json_test_string("\n\r\t\b\f\x01\x1f", SIZE_MAX,
+											   "\"\\n\\r\\t\\b\\f\\u0001\\u001f\""),
+						 "control characters are escaped");
+	ramd_json_test_check(ramd_json_test_string("\xc3\xa9\x7f", SIZE_MAX, "\"\xc3\xa9\x7f\""),
+						 "bytes from 0x7f up are written as they are");
+	ramd_json_test_check(ramd_json_test_string("ab\0cd", SIZE_MAX, "\"ab\""),
+						 "a C string stops at its NUL");
+	ramd_json_test_check(ramd_json_test_string("ab\0cd", 5, "\"ab\\u0000cd\""),
+						 "an explicit length writes an embedded NUL as \\u0000");
+	ramd_json_test_check(ramd_json_test_string("abcd", 2, "\"ab\""),
+						 "an explicit length stops short of the NUL");
+	ramd_json_test_check(ramd_json_test_string(NULL, SIZE_MAX, "null"),
+						 "a NULL string is written as null");
+
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	ok = ram_json_array_begin(&w) && ram_json_int(&w, INT64_MIN) &&
+		ram_json_int(&w, INT64_MAX) && ram_json_uint(&w, UINT64_MAX) &&
+		ram_json_double(&w, NAN, 2) && ram_json_double(&w, 1.5, 2) &&
+		ram_json_array_end(&w) && ram_json_writer_finish(&w);
+	ramd_json_test_check(ok && strcmp(buf, "[-9223372036854775808,9223372036854775807,"
+									  "18446744073709551615,null,1.50]") == 0,
+						 "integer limits, and NaN as null");
+
+	/* "{"k":1}" is 7 bytes and needs an 8th for the terminator */
+	ram_json_writer_init(&w, small, sizeof(small), NULL, NULL);
+	ok = ram_json_object_begin(&w) && ram_json_kv_int(&w, "k", 1) &&
+		ram_json_object_end(&w) && ram_json_writer_finish(&w);
+	ramd_json_test_check(ok && strcmp(small, "{\"k\":1}") == 0,
+						 "document that exactly fits the buffer");
+	ram_json_writer_init(&w, small, sizeof(small), NULL, NULL);
+	ok = ram_json_object_begin(&w) && ram_json_kv_int(&w, "k", 10) &&
+		ram_json_object_end(&w);
+	ok = !ok && !ram_json_writer_finish(&w) && strlen(small) < sizeof(small);
+	ramd_json_test_check(ok, "document one byte too long fails, terminated");
+
+	ram_json_writer_init(&w, small, sizeof(small), ramd_json_test_flush, &sink);
+	ok = ram_json_array_begin(&w);
+	for (i = 0; i < 10 && ok; i++)
+		ok = ram_json_string(&w, "abcdefghij");
+	ok = ok && ram_json_array_end(&w) && ram_json_writer_finish(&w);
+	ramd_json_test_check(ok && sink.length == 2 + 10 * 12 + 9 && sink.flushes > 1 &&
+						 strncmp(sink.data, "[\"abcdefghij\",\"abcdefghij\",", 27) == 0,
+						 "output larger than the buffer goes through the flush callback");
+
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	ok = true;
+	for (i = 0; i < RAM_JSON_MAX_DEPTH && ok; i++)
+		ok = ram_json_array_begin(&w);
+	ramd_json_test_check(ok && !ram_json_array_begin(&w), "nesting stops at RAM_JSON_MAX_DEPTH");
+
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	ok = ram_json_object_begin(&w) && ram_json_key(&w, "k");
+	ramd_json_test_check(ok && !ram_json_object_end(&w) && !ram_json_writer_finish(&w),
+						 "closing an object after a key without a value fails");
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	ok = ram_json_array_begin(&w) && ram_json_int(&w, 1);
+	ramd_json_test_check(ok && !ram_json_writer_finish(&w),
+						 "finishing with a container open fails");
+	ram_json_writer_init(&w, buf, 0, NULL, NULL);
+	ramd_json_test_check(!ram_json_null(&w) && !ram_json_writer_finish(&w),
+						 "a writer without a buffer fails");
+}
+
+/* Tokenizes text and returns ram_json_parse()'s result */
+static int32_t
+ramd_json_test_parse(const char *text, ram_json_token_t *tokens, int32_t max_tokens)
+{
+	return ram_json_parse(text, strlen(text), tokens, max_tokens);
+}
+
+static void
+ramd_json_test_reader(void)
+{
+	static const struct
+	{
+		const char *text;
+		int32_t		result;
+	}			malformed[] = {
+		{"", RAM_JSON_ERROR_PARTIAL},
+		{"   ", RAM_JSON_ERROR_PARTIAL},
+		{"{", RAM_JSON_ERROR_PARTIAL},
+		{"[1,", RAM_JSON_ERROR_PARTIAL},
+		{"\"abc", RAM_JSON_ERROR_PARTIAL},
+		{"tru", RAM_JSON_ERROR_PARTIAL},
+		{"-", RAM_JSON_ERROR_PARTIAL},
+		{"[1,]", RAM_JSON_ERROR_INVALID},
+		{"{\"a\" 1}", RAM_JSON_ERROR_INVALID},
+		{"{\"a\":1,}", RAM_JSON_ERROR_INVALID},
+		{"{1:2}", RAM_JSON_ERROR_INVALID},
+		{"[1 2]", RAM_JSON_ERROR_INVALID},
+		{"[1}", RAM_JSON_ERROR_INVALID},
+		{"]", RAM_JSON_ERROR_INVALID},
+		{"1 2", RAM_JSON_ERROR_INVALID},
+		{"trux", RAM_JSON_ERROR_INVALID},
+		{"[-x]", RAM_JSON_ERROR_INVALID},
+	};
+	static const char document[] =
+		"{\"name\":\"n\\u00e9\\\"x\",\"id\":42,\"big\":9223372036854775807,"
+		"\"small\":-9223372036854775808,\"over\":9223372036854775808,"
+		"\"u\":18446744073709551615,\"uover\":18446744073709551616,"
+		"\"frac\":1.25,\"on\":true,\"list\":[1,[2,3],{\"x\":null}],\"empty\":{}}";
+	ram_json_token_t tokens[RAMD_JSON_TEST_TOKENS];
+	char		nested[2 * RAM_JSON_MAX_DEPTH + 3];
+	char		out[8];
+	int64_t		i64 = 0;
+	uint64_t	u64 = 0;
+	int32_t		i32 = 0;
+	double		d = 0;
+	bool		b = false;
+	int32_t		count;
+	int32_t		list;
+	int32_t		element;
+	int32_t		elements = 0;
+	bool		ok;
+	size_t		i;
+
+	ok = true;
+	for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++)
+	{
+		count = ramd_json_test_parse(malformed[i].text, tokens, RAMD_JSON_TEST_TOKENS);
+		if (count != malformed[i].result)
+		{
+			printf("# '%s' gave %d, expected %d\n", malformed[i].text, count,
+				   malformed[i].result);
+			ok = false;
+		}
+	}
+	ramd_json_test_check(ok, "malformed and truncated documents are refused");
+
+	count = ramd_json_test_parse(document, tokens, RAMD_JSON_TEST_TOKENS);
+	ramd_json_test_check(count == 30 && tokens[0].type == RAM_JSON_OBJECT &&
+						 tokens[0].size == 11 && tokens[0].next == count,
+						 "document tokenizes into one object");
+	ramd_json_test_check(ramd_json_test_parse(document, tokens, count - 1) ==
+						 RAM_JSON_ERROR_NOMEM,
+						 "one token too few is reported");
+
+	count = ramd_json_test_parse(document, tokens, RAMD_JSON_TEST_TOKENS);
+	ramd_json_test_check(ram_json_get_string(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "name"),
+											 out, sizeof(out)) &&
+						 strcmp(out, "n\xc3\xa9\"x") == 0,
+						 "escaped string is unescaped to UTF-8");
+	ramd_json_test_check(!ram_json_get_string(document, tokens,
+											  ram_json_object_get(document, tokens, 0, "name"),
+											  out, 5) && strlen(out) < 5,
+						 "string one byte too long fails, terminated");
+	ramd_json_test_check(ram_json_get_int64(document, tokens,
+											ram_json_object_get(document, tokens, 0, "big"),
+											&i64) && i64 == INT64_MAX &&
+						 ram_json_get_int64(document, tokens,
+											ram_json_object_get(document, tokens, 0, "small"),
+											&i64) && i64 == INT64_MIN,
+						 "int64 limits are read");
+	ramd_json_test_check(!ram_json_get_int64(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "over"),
+											 &i64) &&
+						 !ram_json_get_int32(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "big"),
+											 &i32),
+						 "integers past their type are refused");
+	ramd_json_test_check(ram_json_get_uint64(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "u"),
+											 &u64) && u64 == UINT64_MAX &&
+						 !ram_json_get_uint64(document, tokens,
+											  ram_json_object_get(document, tokens, 0, "uover"),
+											  &u64),
+						 "uint64 limit is read and one past it refused");
+	ramd_json_test_check(!ram_json_get_int64(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "frac"),
+											 &i64) &&
+						 ram_json_get_double(document, tokens,
+											 ram_json_object_get(document, tokens, 0, "frac"),
+											 &d) && d == 1.25,
+						 "fractions are doubles, not integers");
+	ramd_json_test_check(ram_json_get_bool(tokens, ram_json_object_get(document, tokens, 0, "on"),
+										   &b) && b &&
+						 ram_json_object_get(document, tokens, 0, "missing") < 0 &&
+						 ram_json_object_get(document, tokens, 0, "nam") < 0,
+						 "booleans, and keys that are absent or only a prefix");
+
+	list = ram_json_object_get(document, tokens, 0, "list");
+	for (element = ram_json_array_first(tokens, list); element >= 0;
+		 element = ram_json_array_next(tokens, list, element))
+		elements++;
+	ramd_json_test_check(elements == 3 &&
+						 ram_json_array_first(tokens,
+											  ram_json_object_get(document, tokens, 0, "empty")) < 0,
+						 "array walk skips nested values");
+
+	/* RAM_JSON_MAX_DEPTH arrays around a 1 parse; one more does not */
+	memset(nested, '[', RAM_JSON_MAX_DEPTH);
+	nested[RAM_JSON_MAX_DEPTH] = '1';
+	memset(nested + RAM_JSON_MAX_DEPTH + 1, ']', RAM_JSON_MAX_DEPTH);
+	nested[2 * RAM_JSON_MAX_DEPTH + 1] = '\0';
+	ramd_json_test_check(ramd_json_test_parse(nested, tokens, RAMD_JSON_TEST_TOKENS) ==
+						 RAM_JSON_MAX_DEPTH + 1,
+						 "nesting up to RAM_JSON_MAX_DEPTH parses");
+	memset(nested, '[', RAM_JSON_MAX_DEPTH + 1);
+	nested[RAM_JSON_MAX_DEPTH + 1] = '1';
+	memset(nested + RAM_JSON_MAX_DEPTH + 2, ']', RAM_JSON_MAX_DEPTH + 1);
+	nested[2 * RAM_JSON_MAX_DEPTH + 3 - 1] = '\0';
+	ramd_json_test_check(ramd_json_test_parse(nested, tokens, RAMD_JSON_TEST_TOKENS) ==
+						 RAM_JSON_ERROR_INVALID,
+						 "nesting one past RAM_JSON_MAX_DEPTH is refused");
+}
+
+/* What the writer escapes, the reader gives back byte for byte */
+static void
+ramd_json_test_round_trip(void)
+{
+	static const char value[] = "q\"b\\s/n\nt\tc\x01\x1f\xc3\xa9";
+	ram_json_token_t tokens[4];
+	ram_json_writer_t w;
+	char		buf[64];
+	char		out[32];
+
+	ram_json_writer_init(&w, buf, sizeof(buf), NULL, NULL);
+	ram_json_string(&w, value);
+	ramd_json_test_check(ram_json_writer_finish(&w) &&
+						 ram_json_parse(buf, strlen(buf), tokens, 4) == 1 &&
+						 ram_json_get_string(buf, tokens, 0, out, sizeof(out)) &&
+						 strcmp(out, value) == 0,
+						 "escaped string reads back unchanged");
+}
+
+int
+main(void)
+{
+	printf("1..29\n");
+	ramd_json_test_writer();
+	ramd_json_test_reader();
+	ramd_json_test_round_trip();
+	return g_failed == 0 ? 0 : 1;
+}
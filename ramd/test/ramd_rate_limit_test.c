@@ -0,0 +1,160 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_rate_limit_test.c
+ *		PostgreSQL Auto-Failover Daemon - HTTP Rate Limiter Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Sends requests through ramd_security_authenticate_http() on a virtual
+ * clock and checks the per-client token bucket: its burst, its refill and
+ * the cap on it, the block an empty bucket starts and when it ends, how
+ * client addresses are keyed, and that a client pushed out of a full
+ * shard comes back with a fresh bucket.  Prints one TAP line per case;
+ * "make check" runs it and fails on a non-zero exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "ramd.h"
+#include "ramd_clock.h"
+#include "ramd_daemon.h"
+#include "ramd_security.h"
+
+/* Normally defined by ramd_main.c, which is not linked in */
+ramd_daemon_t *g_ramd_daemon = NULL;
+PGconn	   *g_conn = NULL;
+
+#define SECOND_US		((int64_t) 1000000)
+
+/* Not exported by ramd_security.c; the block an empty bucket starts */
+#define RAMD_RATE_LIMIT_TEST_BLOCK_US	(300 * SECOND_US)
+
+/* More distinct clients than the limiter keeps in all of its shards */
+#define RAMD_RATE_LIMIT_TEST_CLIENTS	16384
+
+static int64_t g_now_us = 1000 * SECOND_US;
+static int	g_test = 0;
+static int	g_failed = 0;
+
+static int64_t
+ramd_rate_limit_test_clock(void)
+{
+	return g_now_us;
+}
+
+static void
+ramd_rate_limit_test_check(bool ok, const char *name)
+{
+	printf("%s %d - %s\n", ok ? "ok" : "not ok", ++g_test, name);
+	if (!ok)
+		g_failed++;
+}
+
+static bool
+ramd_rate_limit_test_request(const char *client_ip)
+{
+	return ramd_security_authenticate_http(client_ip, NULL, "read", "/api/v1/status");
+}
+
+/* How many of count requests from client_ip, all at the current instant, get through */
+static int
+ramd_rate_limit_test_burst(const char *client_ip, int count)
+{
+	int			allowed = 0;
+
+	for (int i = 0; i < count; i++)
+		if (ramd_rate_limit_test_request(client_ip))
+			allowed++;
+	return allowed;
+}
+
+static int
+ramd_rate_limit_test_blocked(void)
+{
+	ramd_security_status_t status;
+
+	if (!ramd_security_get_status(&status))
+		return -1;
+	return status.blocked_ips;
+}
+
+int
+main(void)
+{
+	ramd_security_context_t ctx;
+	char		client[INET_ADDRSTRLEN];
+	int64_t		blocked_at;
+	bool		ok;
+
+	ramd_clock_set(ramd_rate_limit_test_clock);
+	if (!ramd_security_init(&ctx))
+	{
+		printf("Bail out! ramd_security_init failed\n");
+		return 1;
+	}
+	ctx.enable_audit = false;
+
+	printf("1..14\n");
+
+	ramd_security_set_rate_limit(60);
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("10.0.0.1", 60) == 60,
+							   "a full bucket allows one minute's requests at once");
+	blocked_at = g_now_us;
+	ramd_rate_limit_test_check(!ramd_rate_limit_test_request("10.0.0.1") &&
+							   ramd_rate_limit_test_blocked() == 1,
+							   "the next request empties it and blocks the client");
+	ramd_rate_limit_test_check(ramd_rate_limit_test_request("10.0.0.2"),
+							   "another client is not affected");
+	ramd_rate_limit_test_check(!ramd_rate_limit_test_request("::ffff:10.0.0.1"),
+							   "the v4-mapped IPv6 form is the same client");
+
+	g_now_us = blocked_at + RAMD_RATE_LIMIT_TEST_BLOCK_US - 1;
+	ramd_rate_limit_test_check(!ramd_rate_limit_test_request("10.0.0.1"),
+							   "still blocked a microsecond before the block ends");
+	g_now_us = blocked_at + RAMD_RATE_LIMIT_TEST_BLOCK_US;
+	ramd_rate_limit_test_check(ramd_rate_limit_test_blocked() == 0 &&
+							   ramd_rate_limit_test_burst("10.0.0.1", 61) == 60,
+							   "a full bucket again once the block ends");
+
+	/* One token per second at 60 a minute */
+	g_now_us += 100 * SECOND_US;
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("10.0.0.3", 60) == 60,
+							   "second client spends its bucket");
+	g_now_us += SECOND_US;
+	ok = ramd_rate_limit_test_request("10.0.0.3");
+	ramd_rate_limit_test_check(ok && !ramd_rate_limit_test_request("10.0.0.3"),
+							   "a second refills exactly one token");
+	g_now_us += RAMD_RATE_LIMIT_TEST_BLOCK_US + 3600 * SECOND_US;
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("10.0.0.3", 61) == 60,
+							   "an hour idle refills no more than one minute's burst");
+
+	ramd_security_set_rate_limit(1);
+	g_now_us += RAMD_RATE_LIMIT_TEST_BLOCK_US;
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("2001:db8::1", 2) == 1,
+							   "a limit of one request a minute");
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("not-an-address", 2) == 1 &&
+							   ramd_rate_limit_test_burst("not-an-addres", 2) == 1 &&
+							   ramd_rate_limit_test_burst(NULL, 2) == 1,
+							   "unparsable and missing client names have buckets of their own");
+
+	ramd_security_set_rate_limit(0);
+	ramd_rate_limit_test_check(ramd_rate_limit_test_burst("2001:db8::1", 1000) == 1000,
+							   "a limit of 0 turns rate limiting off");
+
+	/* Block one client, then crowd it out of every shard */
+	ramd_security_set_rate_limit(10);
+	g_now_us += RAMD_RATE_LIMIT_TEST_BLOCK_US;
+	ok = ramd_rate_limit_test_burst("192.0.2.1", 11) == 10;
+	for (int i = 0; i < RAMD_RATE_LIMIT_TEST_CLIENTS; i++)
+	{
+		snprintf(client, sizeof(client), "198.18.%d.%d", i / 256, i % 256);
+		ok = ramd_rate_limit_test_request(client) && ok;
+	}
+	ramd_rate_limit_test_check(ok, "more clients than the limiter keeps are all served");
+	ramd_rate_limit_test_check(ramd_rate_limit_test_request("192.0.2.1"),
+							   "a blocked client pushed out of its shard starts afresh");
+
+	ramd_security_cleanup(&ctx);
+	ramd_clock_set(NULL);
+	return g_failed == 0 ? 0 : 1;
+}
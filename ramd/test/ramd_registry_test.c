@@ -0,0 +1,88 @@
+/*-------------------------------------------------------------------------
+ *
+ * ramd_registry_test.c
+ *		PostgreSQL Auto-Failover Daemon - Registry Key Tests
+ *
+ * Copyright (c) 2024-2025, pgElephant, Inc.
+ *
+ * Builds registry prefixes and keys at, and one past, the size of the
+ * buffer they go into, and from cluster names the registry has to refuse.
+ * Prints one TAP line per case; "make check" runs it and fails on a
+ * non-zero exit.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "ramd.h"
+#include "ramd_daemon.h"
+#include "ramd_registry.h"
+
+/* Normally defined by ramd_main.c, which is not linked in */
+ramd_daemon_t *g_ramd_daemon = NULL;
+PGconn	   *g_conn = NULL;
+
+static int	g_test = 0;
+static int	g_failed = 0;
+
+static void
+ramd_registry_test_check(bool ok, const char *name)
+{
+	printf("%s %d - %s\n", ok ? "ok" : "not ok", ++g_test, name);
+	if (!ok)
+		g_failed++;
+}
+
+int
+main(void)
+{
+	char		name[RAMD_REGISTRY_KEY_LENGTH + 8];
+	char		prefix[RAMD_REGISTRY_KEY_LENGTH];
+	char		key[RAMD_REGISTRY_KEY_LENGTH];
+	char		small[16];
+	size_t		fit;
+
+	printf("1..12\n");
+
+	ramd_registry_test_check(ramd_registry_make_prefix(prefix, sizeof(prefix), "main") &&
+							 strcmp(prefix, "/ramd/main/") == 0,
+							 "prefix of a short cluster name");
+	ramd_registry_test_check(!ramd_registry_make_prefix(prefix, sizeof(prefix), ""),
+							 "empty cluster name is refused");
+	ramd_registry_test_check(!ramd_registry_make_prefix(prefix, sizeof(prefix), "a/b"),
+							 "cluster name holding a '/' is refused");
+	ramd_registry_test_check(!ramd_registry_make_prefix(prefix, sizeof(prefix), NULL),
+							 "missing cluster name is refused");
+
+	/* "/ramd/" and "/" around the name, and the terminator */
+	fit = sizeof(prefix) - strlen("/ramd/") - strlen("/") - 1;
+	memset(name, 'c', fit);
+	name[fit] = '\0';
+	ramd_registry_test_check(ramd_registry_make_prefix(prefix, sizeof(prefix), name) &&
+							 strlen(prefix) == sizeof(prefix) - 1,
+							 "cluster name that exactly fits");
+	name[fit] = 'c';
+	name[fit + 1] = '\0';
+	ramd_registry_test_check(!ramd_registry_make_prefix(prefix, sizeof(prefix), name),
+							 "cluster name one byte too long is refused");
+
+	ramd_registry_test_check(ramd_registry_make_key(key, sizeof(key), "/ramd/main/", "nodes", 7) &&
+							 strcmp(key, "/ramd/main/nodes/7") == 0,
+							 "key with a node id");
+	ramd_registry_test_check(ramd_registry_make_key(key, sizeof(key), "/ramd/main/", "failover", 0) &&
+							 strcmp(key, "/ramd/main/failover") == 0,
+							 "key without a node id");
+	ramd_registry_test_check(ramd_registry_make_key(key, sizeof(key), "/ramd/main/", "nodes",
+													RAMD_MAX_NODES),
+							 "key for the highest node id");
+
+	/* "/r/nodes/12" is 11 bytes, "/r/nodes/123456" is 15 */
+	ramd_registry_test_check(ramd_registry_make_key(small, sizeof(small), "/r/", "nodes", 123456) &&
+							 strcmp(small, "/r/nodes/123456") == 0,
+							 "key that exactly fits");
+	ramd_registry_test_check(!ramd_registry_make_key(small, sizeof(small), "/r/", "nodes", 1234567),
+							 "key one byte too long is refused");
+	ramd_registry_test_check(!ramd_registry_make_key(small, sizeof(small), "/r/", "maintenance", 1),
+							 "leaf too long for the buffer is refused");
+
+	return g_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#!/bin/bash
+# endpoint_move_command for ramd: move an EC2 secondary private IP to the
+# new primary's network interface.
+#
+#   RAM_ENDPOINT_IP          the secondary private IP clients connect to
+#   RAM_ENDPOINT_INTERFACES  node_id=eni-id pairs, e.g. "1=eni-0a1,2=eni-0b2"
+#
+# Needs the aws CLI and ec2:AssignPrivateIpAddresses.  The IP still has to
+# be configured on the instance; endpoint_vip does that on the new primary.
+
+set -euo pipefail
+
+node_id="$1"
+
+eni=$(tr ',' '\n' <<< "${RAM_ENDPOINT_INTERFACES:?}" | sed -n "s/^${node_id}=//p")
+if [ -z "$eni" ]; then
+	echo "no interface listed for node ${node_id}" >&2
+	exit 1
+fi
+
+aws ec2 assign-private-ip-addresses \
+	--network-interface-id "$eni" \
+	--private-ip-addresses "${RAM_ENDPOINT_IP:?}" \
+	--allow-reassignment
@@ -0,0 +1,35 @@
+#!/bin/bash
+# endpoint_move_command for ramd: move a GCE alias IP range to the new
+# primary's instance.
+#
+#   RAM_ENDPOINT_IP         the alias range, e.g. "10.128.0.50/32"
+#   RAM_ENDPOINT_INSTANCES  node_id=instance pairs, e.g. "1=db1,2=db2"
+#   RAM_ENDPOINT_ZONE       zone of the instances
+#
+# Needs gcloud and compute.instances.updateNetworkInterface.  An alias
+# range can be on one instance only, so it is taken off the others first.
+
+set -euo pipefail
+
+node_id="$1"
+zone="${RAM_ENDPOINT_ZONE:?}"
+
+target=""
+for pair in ${RAM_ENDPOINT_INSTANCES//,/ }; do
+	id="${pair%%=*}"
+	instance="${pair#*=}"
+	if [ "$id" = "$node_id" ]; then
+		target="$instance"
+	else
+		gcloud compute instances network-interfaces update "$instance" \
+			--zone "$zone" --aliases "" >/dev/null 2>&1 || true
+	fi
+done
+
+if [ -z "$target" ]; then
+	echo "no instance listed for node ${node_id}" >&2
+	exit 1
+fi
+
+gcloud compute instances network-interfaces update "$target" \
+	--zone "$zone" --aliases "${RAM_ENDPOINT_IP:?}"
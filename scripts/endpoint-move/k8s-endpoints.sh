@@ -0,0 +1,18 @@
+#!/bin/bash
+# endpoint_move_command for ramd: point a selector-less Kubernetes Service
+# at the new primary by replacing its Endpoints.
+#
+#   RAM_ENDPOINT_SERVICE    the Service (and Endpoints) name
+#   RAM_ENDPOINT_NAMESPACE  its namespace, default "default"
+#
+# The host ramd passes must be an IP address.  Needs kubectl and patch
+# permission on the Endpoints.
+
+set -euo pipefail
+
+host="$2"
+port="$3"
+
+kubectl --namespace "${RAM_ENDPOINT_NAMESPACE:-default}" \
+	patch endpoints "${RAM_ENDPOINT_SERVICE:?}" --type merge --patch \
+	"{\"subsets\":[{\"addresses\":[{\"ip\":\"${host}\"}],\"ports\":[{\"name\":\"postgresql\",\"port\":${port}}]}]}"
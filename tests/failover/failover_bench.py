@@ -0,0 +1,493 @@
+#!/usr/bin/env python3
+"""
+Failover latency benchmark for RAM clusters
+
+Brings up an N-node cluster with docker compose, fails the primary, and times
+each phase of the failover that follows:
+
+  detection   fault injected -> a surviving ramd reports the primary unhealthy
+              or leaves the "normal" failover state
+  selection   detection -> a surviving ramd reports "promoting"
+  promotion   selection -> a survivor answers pg_is_in_recovery() = false
+  repointing  promotion -> every other survivor streams from the new primary
+  first_write promotion -> the first INSERT commits on the new primary
+
+"rto" is the time from injection to the first write.  Every run starts from a
+fresh cluster so runs do not influence each other, and the summary prints
+percentiles and a histogram per phase.
+
+Faults:
+
+  kill       kill -9 of the primary's postmaster
+  partition  disconnect the primary's container from the cluster network
+  stall      SIGSTOP every postgres process on the primary, as a hung disk
+             leaves them; ramd on that node keeps running
+
+The cluster needs streaming replication in place before a run can start.  If
+the compose file does not set it up, pass --bootstrap-cmd; it runs after
+"docker compose up" with RAM_BENCH_PROJECT, RAM_BENCH_COMPOSE_FILE and
+RAM_BENCH_NODES in its environment.
+
+Example:
+
+  python3 tests/failover/failover_bench.py --nodes 3 --runs 50 \\
+      --fault kill --json results.json
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import urllib.request
+from pathlib import Path
+
+import psycopg2
+
+REPO_ROOT = Path(__file__).resolve().parents[2]
+PHASES = ["detection", "selection", "promotion", "repointing", "first_write", "rto"]
+PG_PORT_BASE = 15432
+HTTP_PORT_BASE = 18080
+
+
+class Node:
+    """One cluster member, reached through its published ports"""
+
+    def __init__(self, index, project):
+        self.node_id = index + 1
+        self.service = f"node{self.node_id}"
+        self.container = f"{project}-{self.service}"
+        self.pg_port = PG_PORT_BASE + index
+        self.http_port = HTTP_PORT_BASE + index
+
+
+class Cluster:
+    """An N-node cluster managed through docker compose"""
+
+    def __init__(self, args):
+        self.args = args
+        self.project = args.project
+        self.network = f"{self.project}_ramnet"
+        self.nodes = [Node(i, self.project) for i in range(args.nodes)]
+        self.compose_file = args.compose_file or self._write_compose_file()
+        self.built = args.no_build
+
+    def _write_compose_file(self):
+        """Services in the shape of docker/docker-compose.yml, one per node"""
+        services = {}
+        for node in self.nodes:
+            services[node.service] = {
+                "build": {"context": str(REPO_ROOT), "dockerfile": "docker/Dockerfile"},
+                "image": f"{self.project}:latest",
+                "container_name": node.container,
+                "hostname": node.service,
+                "environment": {
+                    "POSTGRES_DB": "postgres",
+                    "POSTGRES_USER": "postgres",
+                    "POSTGRES_PASSWORD": self.args.password,
+                    "PGRAPT_NODE_ID": str(node.node_id),
+                    "PGRAPT_CLUSTER_ADDRESSES": ",".join(f"{n.service}:5432" for n in self.nodes),
+                    "RAMD_NODE_ID": str(node.node_id),
+                    "RAMD_CLUSTER_NAME": self.project,
+                },
+                "ports": [f"{node.pg_port}:5432", f"{node.http_port}:8080"],
+                "volumes": [
+                    f"{REPO_ROOT}/docker/ramd.conf:/etc/ramd/ramd.conf",
+                    f"{REPO_ROOT}/docker/postgresql.conf:/etc/postgresql/postgresql.conf",
+                    f"{REPO_ROOT}/docker/pg_hba.conf:/etc/postgresql/pg_hba.conf",
+                ],
+                "networks": ["ramnet"],
+                # Anything but "postgres" runs the entrypoint's postgres + ramd branch
+                "command": ["-c", "config_file=/etc/postgresql/postgresql.conf"],
+            }
+            if node.node_id > 1:
+                services[node.service]["depends_on"] = ["node1"]
+
+        # JSON is valid YAML, so no YAML library is needed
+        handle, path = tempfile.mkstemp(prefix=f"{self.project}-", suffix=".yml")
+        with os.fdopen(handle, "w") as f:
+            json.dump({"services": services, "networks": {"ramnet": {"driver": "bridge"}}}, f, indent=2)
+        return path
+
+    def compose(self, *args, check=True):
+        cmd = ["docker", "compose", "-p", self.project, "-f", self.compose_file, *args]
+        return subprocess.run(cmd, check=check, capture_output=True, text=True)
+
+    def up(self):
+        self.compose("down", "-v", "--remove-orphans", check=False)
+        if self.built:
+            self.compose("up", "-d")
+        else:
+            self.compose("up", "-d", "--build")
+            self.built = True
+
+        if self.args.bootstrap_cmd:
+            env = dict(os.environ,
+                       RAM_BENCH_PROJECT=self.project,
+                       RAM_BENCH_COMPOSE_FILE=self.compose_file,
+                       RAM_BENCH_NODES=str(len(self.nodes)))
+            subprocess.run(self.args.bootstrap_cmd, shell=True, check=True, env=env)
+
+    def down(self):
+        self.compose("down", "-v", "--remove-orphans", check=False)
+
+    def connect(self, node, timeout=1):
+        conn = psycopg2.connect(host="127.0.0.1", port=node.pg_port, user="postgres",
+                                password=self.args.password, dbname="postgres",
+                                connect_timeout=timeout,
+                                options="-c statement_timeout=1000")
+        conn.autocommit = True
+        return conn
+
+    def query(self, node, sql):
+        """One row of sql on node, or None if the node does not answer"""
+        try:
+            conn = self.connect(node)
+            try:
+                with conn.cursor() as cur:
+                    cur.execute(sql)
+                    return cur.fetchone()
+            finally:
+                conn.close()
+        except psycopg2.Error:
+            return None
+
+    def http_get(self, node, path, timeout=0.5):
+        """Decoded JSON from node's ramd, or None if it does not answer"""
+        request = urllib.request.Request(f"http://127.0.0.1:{node.http_port}{path}")
+        if self.args.token:
+            request.add_header("Authorization", f"Bearer {self.args.token}")
+        try:
+            with urllib.request.urlopen(request, timeout=timeout) as response:
+                return json.loads(response.read())
+        except (OSError, ValueError):
+            return None
+
+    def primary(self):
+        primaries = [n for n in self.nodes if self.query(n, "SELECT pg_is_in_recovery()") == (False,)]
+        return primaries[0] if len(primaries) == 1 else None
+
+    def wait_ready(self, timeout):
+        """The primary, once it has N-1 streaming standbys and every ramd is healthy"""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            primary = self.primary()
+            if primary:
+                row = self.query(primary, "SELECT count(*) FROM pg_stat_replication WHERE state = 'streaming'")
+                healthy = all((self.http_get(n, "/health") or {}).get("status") == "ok" for n in self.nodes)
+                if row and row[0] == len(self.nodes) - 1 and healthy:
+                    return primary
+            time.sleep(0.5)
+        raise RuntimeError(f"cluster not ready after {timeout}s")
+
+    def container_ip(self, node):
+        result = subprocess.run(
+            ["docker", "inspect", "-f", "{{range .NetworkSettings.Networks}}{{.IPAddress}} {{end}}",
+             node.container], capture_output=True, text=True)
+        return result.stdout.split()
+
+    def docker_exec(self, node, script):
+        subprocess.run(["docker", "exec", node.container, "sh", "-c", script],
+                       check=True, capture_output=True, text=True)
+
+
+SIGNAL_POSTGRES = (
+    'for p in /proc/[0-9]*; do '
+    '[ "$(cat $p/comm 2>/dev/null)" = postgres ] && kill -{sig} "${{p#/proc/}}"; '
+    'done; true'
+)
+
+
+def inject(cluster, node, fault):
+    if fault == "kill":
+        cluster.docker_exec(node, 'kill -9 "$(head -1 /var/lib/postgresql/data/postmaster.pid)"')
+    elif fault == "partition":
+        subprocess.run(["docker", "network", "disconnect", cluster.network, node.container],
+                       check=True, capture_output=True)
+    elif fault == "stall":
+        cluster.docker_exec(node, SIGNAL_POSTGRES.format(sig="STOP"))
+
+
+def heal(cluster, node, fault):
+    if fault == "partition":
+        subprocess.run(["docker", "network", "connect", cluster.network, node.container],
+                       capture_output=True)
+    elif fault == "stall":
+        subprocess.run(["docker", "exec", node.container, "sh", "-c", SIGNAL_POSTGRES.format(sig="CONT")],
+                       capture_output=True)
+
+
+class Observer:
+    """
+    Polls one surviving node and records, relative to injection, when it
+    first shows each milestone.  One per survivor, so a slow node does not
+    delay what the others see.
+    """
+
+    def __init__(self, cluster, node, old_primary, t0, run):
+        self.cluster = cluster
+        self.node = node
+        self.old_primary = old_primary
+        self.t0 = t0
+        self.run = run
+        self.seen = {}
+
+    def mark(self, milestone):
+        if milestone not in self.seen:
+            self.seen[milestone] = time.monotonic() - self.t0
+
+    def poll(self):
+        cluster = self.cluster
+        status = cluster.http_get(self.node, "/api/v1/cluster/status") or {}
+        state = status.get("failover_state")
+        if state and state != "normal":
+            self.mark("detection")
+        if state in ("promoting", "recovering", "completed"):
+            self.mark("selection")
+
+        if "detection" not in self.seen:
+            nodes = ((cluster.http_get(self.node, "/api/v1/nodes") or {}).get("data") or {}).get("nodes", [])
+            for entry in nodes:
+                if entry.get("hostname") in (self.old_primary.service, self.old_primary.container) \
+                        and not entry.get("is_healthy", True):
+                    self.mark("detection")
+
+        if cluster.query(self.node, "SELECT pg_is_in_recovery()") == (False,):
+            self.mark("promotion")
+            self.run.promoted(self.node)
+            return
+
+        new_primary = self.run.new_primary
+        if new_primary:
+            row = cluster.query(self.node, "SELECT status, sender_host FROM pg_stat_wal_receiver")
+            if row and row[0] == "streaming" and row[1] in self.run.new_primary_names:
+                self.mark("repointing")
+
+    def loop(self, deadline, stop):
+        interval = self.cluster.args.poll_ms / 1000.0
+        while not stop.is_set() and time.monotonic() < deadline:
+            started = time.monotonic()
+            self.poll()
+            time.sleep(max(0.0, interval - (time.monotonic() - started)))
+
+
+class Run:
+    """One fault injection and the failover it provokes"""
+
+    def __init__(self, cluster, old_primary):
+        self.cluster = cluster
+        self.old_primary = old_primary
+        self.survivors = [n for n in cluster.nodes if n is not old_primary]
+        self.lock = threading.Lock()
+        self.new_primary = None
+        self.new_primary_names = set()
+        self.first_write = None
+
+    def promoted(self, node):
+        with self.lock:
+            if self.new_primary is None:
+                # Names first, so an observer that sees new_primary can match them
+                self.new_primary_names = {node.service, node.container, *self.cluster.container_ip(node)}
+                self.new_primary = node
+
+    def writer(self, t0, deadline, stop):
+        """INSERT on each survivor in turn until one commits"""
+        conns = {}
+        while self.first_write is None and not stop.is_set() and time.monotonic() < deadline:
+            for node in self.survivors:
+                try:
+                    conn = conns.get(node.service) or self.cluster.connect(node, timeout=1)
+                    conns[node.service] = conn
+                    with conn.cursor() as cur:
+                        cur.execute("INSERT INTO ram_failover_bench DEFAULT VALUES")
+                    self.first_write = time.monotonic() - t0
+                    break
+                except psycopg2.Error:
+                    stale = conns.pop(node.service, None)
+                    if stale:
+                        stale.close()
+            time.sleep(self.cluster.args.poll_ms / 1000.0)
+        for conn in conns.values():
+            conn.close()
+
+    def execute(self, fault, timeout):
+        stop = threading.Event()
+        t0 = time.monotonic()
+        deadline = t0 + timeout
+        inject(self.cluster, self.old_primary, fault)
+
+        observers = [Observer(self.cluster, n, self.old_primary, t0, self) for n in self.survivors]
+        threads = [threading.Thread(target=o.loop, args=(deadline, stop), daemon=True) for o in observers]
+        threads.append(threading.Thread(target=self.writer, args=(t0, deadline, stop), daemon=True))
+        for thread in threads:
+            thread.start()
+        threads[-1].join()
+
+        # Give standbys still connecting to the new primary the rest of the time
+        while time.monotonic() < deadline and self.new_primary and \
+                not all("repointing" in o.seen for o in observers if o.node is not self.new_primary):
+            time.sleep(0.05)
+        stop.set()
+        for thread in threads:
+            thread.join()
+        return self.milestones(observers)
+
+    def milestones(self, observers):
+        """Phase durations in milliseconds, None where the phase never finished"""
+        def earliest(name):
+            times = [o.seen[name] for o in observers if name in o.seen]
+            return min(times) if times else None
+
+        followers = [o for o in observers if o.node is not self.new_primary]
+        detection = earliest("detection")
+        selection = earliest("selection")
+        promotion = earliest("promotion")
+        repointing = None
+        if promotion is not None and all("repointing" in o.seen for o in followers):
+            repointing = max([o.seen["repointing"] for o in followers], default=promotion)
+
+        # A state shorter than the poll interval is never seen; count it as zero length
+        if promotion is not None:
+            selection = promotion if selection is None else min(selection, promotion)
+        if selection is not None:
+            detection = selection if detection is None else min(detection, selection)
+
+        def span(start, end):
+            return None if start is None or end is None else max(0.0, end - start) * 1000.0
+
+        return {
+            "detection": span(0.0, detection),
+            "selection": span(detection, selection),
+            "promotion": span(selection, promotion),
+            "repointing": span(promotion, repointing),
+            "first_write": span(promotion, self.first_write),
+            "rto": span(0.0, self.first_write),
+            "new_primary": self.new_primary.service if self.new_primary else None,
+        }
+
+
+def percentile(sorted_values, fraction):
+    if not sorted_values:
+        return None
+    rank = fraction * (len(sorted_values) - 1)
+    low = math.floor(rank)
+    high = math.ceil(rank)
+    return sorted_values[low] + (sorted_values[high] - sorted_values[low]) * (rank - low)
+
+
+def summarize(results):
+    summary = {}
+    for phase in PHASES:
+        values = sorted(r[phase] for r in results if r.get(phase) is not None)
+        summary[phase] = {
+            "count": len(values),
+            "missing": len(results) - len(values),
+            "min": values[0] if values else None,
+            "p50": percentile(values, 0.50),
+            "p90": percentile(values, 0.90),
+            "p99": percentile(values, 0.99),
+            "max": values[-1] if values else None,
+        }
+    return summary
+
+
+def print_histogram(phase, values, width=40):
+    """Power-of-two millisecond buckets, as latency distributions are long-tailed"""
+    if not values:
+        return
+    buckets = {}
+    for value in values:
+        bucket = 0 if value < 1 else int(math.log2(value)) + 1
+        buckets[bucket] = buckets.get(bucket, 0) + 1
+    peak = max(buckets.values())
+    print(f"\n{phase} (ms)")
+    for bucket in range(min(buckets), max(buckets) + 1):
+        count = buckets.get(bucket, 0)
+        low = 0 if bucket == 0 else 2 ** (bucket - 1)
+        high = 2 ** bucket
+        bar = "#" * max(1 if count else 0, round(count * width / peak))
+        print(f"  [{low:>6}, {high:>6})  {count:>5}  {bar}")
+
+
+def print_report(results, summary):
+    def fmt(value):
+        return "-" if value is None else f"{value:.1f}"
+
+    print(f"\n{'phase':<12} {'n':>4} {'miss':>4} {'min':>9} {'p50':>9} {'p90':>9} {'p99':>9} {'max':>9}")
+    for phase in PHASES:
+        s = summary[phase]
+        print(f"{phase:<12} {s['count']:>4} {s['missing']:>4} {fmt(s['min']):>9} {fmt(s['p50']):>9} "
+              f"{fmt(s['p90']):>9} {fmt(s['p99']):>9} {fmt(s['max']):>9}")
+    for phase in PHASES:
+        print_histogram(phase, sorted(r[phase] for r in results if r.get(phase) is not None))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure failover latency of a RAM cluster, phase by phase")
+    parser.add_argument("--nodes", type=int, default=3, help="cluster size (default: 3)")
+    parser.add_argument("--runs", type=int, default=20, help="fault injections to measure (default: 20)")
+    parser.add_argument("--fault", choices=["kill", "partition", "stall"], default="kill",
+                        help="how the primary fails (default: kill)")
+    parser.add_argument("--timeout", type=float, default=120.0,
+                        help="seconds to wait for a failover to finish (default: 120)")
+    parser.add_argument("--ready-timeout", type=float, default=300.0,
+                        help="seconds to wait for a fresh cluster to be ready (default: 300)")
+    parser.add_argument("--poll-ms", type=int, default=20, help="milestone polling interval (default: 20)")
+    parser.add_argument("--compose-file", help="use this compose file instead of generating one; "
+                                               "services must be node1..nodeN with the same ports")
+    parser.add_argument("--bootstrap-cmd", help="shell command that sets up replication after compose up")
+    parser.add_argument("--project", default="ram-failover-bench", help="compose project name")
+    parser.add_argument("--password", default="postgres", help="PostgreSQL password")
+    parser.add_argument("--token", help="ramd API token, if authentication is enabled")
+    parser.add_argument("--no-build", action="store_true", help="reuse the existing image")
+    parser.add_argument("--keep", action="store_true", help="leave the last cluster running")
+    parser.add_argument("--json", help="write every run and the summary to this file")
+    args = parser.parse_args()
+
+    if args.nodes < 2:
+        parser.error("--nodes must be at least 2")
+
+    cluster = Cluster(args)
+    results = []
+    try:
+        for run_number in range(1, args.runs + 1):
+            cluster.up()
+            primary = cluster.wait_ready(args.ready_timeout)
+            conn = cluster.connect(primary, timeout=5)
+            with conn.cursor() as cur:
+                cur.execute("CREATE TABLE IF NOT EXISTS ram_failover_bench "
+                            "(id bigserial PRIMARY KEY, at timestamptz NOT NULL DEFAULT now())")
+            conn.close()
+
+            run = Run(cluster, primary)
+            try:
+                result = run.execute(args.fault, args.timeout)
+            finally:
+                heal(cluster, primary, args.fault)
+            result["run"] = run_number
+            result["old_primary"] = primary.service
+            results.append(result)
+            print(f"run {run_number}/{args.runs}: " +
+                  " ".join(f"{p}={'-' if result[p] is None else f'{result[p]:.0f}ms'}" for p in PHASES),
+                  flush=True)
+    except KeyboardInterrupt:
+        print("\ninterrupted; reporting completed runs", file=sys.stderr)
+    finally:
+        if not args.keep:
+            cluster.down()
+
+    summary = summarize(results)
+    print_report(results, summary)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"nodes": args.nodes, "fault": args.fault, "poll_ms": args.poll_ms,
+                       "runs": results, "summary": summary}, f, indent=2)
+    return 0 if results and summary["rto"]["count"] == len(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())